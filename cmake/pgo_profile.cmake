@@ -0,0 +1,46 @@
+# Prepare the profile collected in the "pgo" target for the optimized build
+# Usage: cmake -DPGO_DIR=... -DPGO_GEN_DIR=... -DPGO_USE_DIR=...
+#   -DPROJECT_NAME=... [-DLLVM_PROFDATA=...] -P pgo_profile.cmake
+
+# clang: merge raw profiles into ${PROJECT_NAME}.profdata
+FILE(GLOB PROFRAWS ${PGO_DIR}/*.profraw)
+IF (PROFRAWS)
+    IF (NOT LLVM_PROFDATA)
+        MESSAGE(FATAL_ERROR "llvm-profdata is required for merging clang profiles.")
+    ENDIF()
+    EXECUTE_PROCESS(COMMAND ${LLVM_PROFDATA} merge -output=${PGO_DIR}/${PROJECT_NAME}.profdata
+        ${PROFRAWS} RESULT_VARIABLE PGO_RESULT)
+    IF (NOT (${PGO_RESULT} EQUAL 0))
+        MESSAGE(FATAL_ERROR "llvm-profdata merge failed.")
+    ENDIF()
+    RETURN()
+ENDIF()
+
+# gcc: profiles are stored per object file, at the (mangled) object path
+# Objects of ${PROJECT_NAME}_bench in pgo-gen are mapped to the same sources
+# compiled for each target in pgo-use
+FILE(GLOB_RECURSE GCDAS RELATIVE ${PGO_DIR} ${PGO_DIR}/*.gcda)
+IF (NOT GCDAS)
+    MESSAGE(FATAL_ERROR "No profile found in ${PGO_DIR}.")
+ENDIF()
+SET(GEN_OBJ_DIR ${PGO_GEN_DIR}/CMakeFiles/${PROJECT_NAME}_bench.dir)
+STRING(REPLACE "/" "#" GEN_OBJ_DIR_MANGLED ${GEN_OBJ_DIR})
+STRING(REGEX REPLACE "^/" "" GEN_OBJ_DIR ${GEN_OBJ_DIR})
+SET(N_COPIED 0)
+FOREACH(GCDA ${GCDAS})
+    FOREACH(TARGET ${PROJECT_NAME} ${PROJECT_NAME}_tests ${PROJECT_NAME}_bench)
+        SET(USE_OBJ_DIR ${PGO_USE_DIR}/CMakeFiles/${TARGET}.dir)
+        STRING(REPLACE "/" "#" USE_OBJ_DIR_MANGLED ${USE_OBJ_DIR})
+        STRING(REGEX REPLACE "^/" "" USE_OBJ_DIR ${USE_OBJ_DIR})
+        STRING(REPLACE ${GEN_OBJ_DIR} ${USE_OBJ_DIR} USE_GCDA ${GCDA})
+        STRING(REPLACE ${GEN_OBJ_DIR_MANGLED} ${USE_OBJ_DIR_MANGLED} USE_GCDA ${USE_GCDA})
+        IF (NOT (${USE_GCDA} STREQUAL ${GCDA}))
+            GET_FILENAME_COMPONENT(USE_GCDA_DIR ${PGO_DIR}/${USE_GCDA} DIRECTORY)
+            FILE(MAKE_DIRECTORY ${USE_GCDA_DIR})
+            EXECUTE_PROCESS(COMMAND ${CMAKE_COMMAND} -E copy
+                ${PGO_DIR}/${GCDA} ${PGO_DIR}/${USE_GCDA})
+            MATH(EXPR N_COPIED "${N_COPIED} + 1")
+        ENDIF()
+    ENDFOREACH()
+ENDFOREACH()
+MESSAGE(STATUS "PGO: ${N_COPIED} profiles mapped into ${PGO_USE_DIR}")
@@ -36,8 +36,11 @@ class DMRGCI(lib.StreamObject):
         self.dmrg_args = {
             "startM": 250, "maxM": 500, "schedule": "default",
             "sweep_tol": 1E-6, "cutoff": 1E-14,
-            "memory": lib.param.MAX_MEMORY * 1E6
+            "memory": lib.param.MAX_MEMORY * 1E6,
+            "warm_start": True, "warm_start_sweeps": 4
         }
+        # key of the MPS left in scratch by the previous kernel call
+        self._warm_key = None
     
     @staticmethod
     def get_schedule(kwargs):
@@ -111,6 +114,18 @@ class DMRGCI(lib.StreamObject):
             schedule[2].extend([noise] * nswp)
         kwargs["schedule"] = schedule
         return schedule
+
+    def get_warm_start_schedule(self, bond_dims, dav_thrds, noises):
+        """Short schedule for restarting from the MPS of the previous
+        macro-iteration: the final bond dimension and Davidson threshold,
+        with the smallest nonzero noise in the first half of the sweeps."""
+        n_sweeps = max(int(self.dmrg_args["warm_start_sweeps"]), 2)
+        nz_noises = [x for x in noises if x != 0]
+        noise = min(nz_noises) if len(nz_noises) != 0 else 0.0
+        bond_dims = [bond_dims[-1]] * n_sweeps
+        dav_thrds = [dav_thrds[-1]] * n_sweeps
+        noises = [noise] * (n_sweeps // 2) + [0.0] * (n_sweeps - n_sweeps // 2)
+        return bond_dims, dav_thrds, noises
     
     def kernel(self, h1e, g2e, norb, nelec, ecore=0, ci0=None, **kwargs):
 
@@ -170,14 +185,31 @@ class DMRGCI(lib.StreamObject):
         self.hamil = hamil
 
         # MPS
+        # in DMRG-SCF, ci0 is the MPS of the previous macro-iteration,
+        # which is still in scratch and only needs a few sweeps to adapt
+        # to the slightly rotated orbitals
+        warm_key = (n_orbs, na, nb, tuple(orb_sym))
+        warm_start = ci0 is not None and self.dmrg_args["warm_start"] \
+            and self._warm_key == warm_key
         info = MPSInfo(n_sites, vacuum, target, hamil.basis)
-        info.set_bond_dimension(bond_dims[0])
-        mps = MPS(n_sites, 0, 2)
-        mps.initialize(info)
-        mps.random_canonicalize()
-        mps.tensors[mps.center].normalize()
-        mps.save_mutable()
-        info.save_mutable()
+        if warm_start:
+            mps = MPS(info)
+            mps.load_data()
+            mps.load_mutable()
+            info.load_mutable()
+            bond_dims, dav_thrds, noises = self.get_warm_start_schedule(
+                bond_dims, dav_thrds, noises)
+            if self.verbose >= 5:
+                print('warm start from previous MPS, M = %d, sweeps = %d' %
+                      (bond_dims[0], len(bond_dims)))
+        else:
+            info.set_bond_dimension(bond_dims[0])
+            mps = MPS(n_sites, 0, 2)
+            mps.initialize(info)
+            mps.random_canonicalize()
+            mps.tensors[mps.center].normalize()
+            mps.save_mutable()
+            info.save_mutable()
         forward = mps.center == 0
 
         # MPO
@@ -195,7 +227,7 @@ class DMRGCI(lib.StreamObject):
         dmrg.cutoff = self.dmrg_args["cutoff"]
         dmrg.iprint = max(min(self.verbose - 4, 3), 0)
         dmrg.noise_type = NoiseTypes.ReducedPerturbativeCollected
-        if "twodot_to_onedot" not in self.dmrg_args:
+        if warm_start or "twodot_to_onedot" not in self.dmrg_args:
             self.e_tot = dmrg.solve(len(bond_dims), forward, sweep_tol)
         else:
             tto = int(self.dmrg_args["twodot_to_onedot"])
@@ -210,6 +242,7 @@ class DMRGCI(lib.StreamObject):
             mps.save_data()
 
         self.mps = mps
+        self._warm_key = warm_key
         self.converged = True
         return self.e_tot, mps
 
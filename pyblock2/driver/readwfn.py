@@ -182,15 +182,15 @@ wave.initialize(target_state_info.quanta, wll, wrr, dot == 1)
 wave.load_wavefunction_info(llrr, wave_sites, 0, False)
 assert wave.onedot == (dot == 1)
 
-rots = []
-for i in range(1, center):
+
+def load_rot(i):
     rotation_matrix = VectorMatrix()
     if su2:
         load_rotation_matrix(VectorInt(range(i + 1)), rotation_matrix, -1)
     else:
         load_rotation_matrix(
             VectorInt(range(2 * (i + 1))), rotation_matrix, -1)
-    rots.append(rotation_matrix)
+    return rotation_matrix
 
 from block2 import SU2, SZ, Global, VectorDouble, VectorUInt16
 from block2 import init_memory, set_mkl_num_threads, QCTypes
@@ -274,8 +274,18 @@ for i in range(center + 1, n_sites):
 
 mps_info.save_mutable()
 
+# tensors are allocated, filled and written one site at a time,
+# so that only one rotation matrix and one MPS tensor are in memory
 mps = MPS(n_sites, center, dot)
-mps.initialize(mps_info)
+if dot == 1:
+    mps.canonical_form = mps.canonical_form[:center] + 'K' + \
+        mps.canonical_form[center + 1:]
+
+
+def write_tensor(i):
+    mps.save_tensor(i)
+    mps.unload_tensor(i)
+
 
 
 def swap_order_left(idx):
@@ -328,6 +338,8 @@ def swap_order_right(idx):
     return dd
 
 
+mps.initialize_tensor(mps_info, 0, 'L')
+mps.initialize_tensor(mps_info, n_sites - 1, 'R')
 if su2:
     if twos == 0:
         mps.tensors[0].data = np.array([1.0, 1.0, 1.0])
@@ -344,14 +356,17 @@ if su2:
 else:
     mps.tensors[0].data = np.array([1.0, 1.0, 1.0, 1.0])
     mps.tensors[n_sites - 1].data = np.array([1.0, 1.0, 1.0, 1.0])
+write_tensor(0)
+write_tensor(n_sites - 1)
 
 for i in range(1, center):
+    mps.initialize_tensor(mps_info, i, 'L')
     stl = stls[i - 1]
     str = site_sts[i][0]
     st = state_tensor_product(stl, str)
     st.collect_quanta()
     assert len(st.quanta) == len(rots[i - 1])
-    rot = rots[i - 1]
+    rot = load_rot(i)
     mps.tensors[i].data[:] = 0
     swod = swap_order_left(i)
     for k in range(len(rot)):
@@ -369,7 +384,10 @@ for i in range(1, center):
         assert mat.n == rot[k].ref.shape[1]
         xx = np.array(rot[k].ref, copy=True)
         mps.tensors[i][iq] = np.ascontiguousarray(xx[swod[q], :])
+    del rot
+    write_tensor(i)
 
+mps.initialize_tensor(mps_info, center, mps.canonical_form[center])
 wfn = mps.tensors[center]
 wfn.data[:] = 0
 
@@ -396,10 +414,9 @@ for (il, ir), mat in wave.non_zero_blocks:
     elif (not su2) and dot == 2 and qr.n == 2 and qr.twos == 0 and qr.pg == orb_sym[-1] ^ orb_sym[-2]:
         xx[:, :] *= -1
     wfn[iq] = f * np.ascontiguousarray(xx)
+write_tensor(center)
 
-mps.save_mutable()
 mps.save_data()
-mps.deallocate()
 max_bdim = max([x.n_states_total for x in mps_info.left_dims])
 if mps_info.bond_dim < max_bdim:
     mps_info.bond_dim = max_bdim
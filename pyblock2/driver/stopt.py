@@ -108,6 +108,7 @@ class SPDMRG:
         self.norm_qvpsi0  = self.norm_qvpsi0*self.norm_qvpsi0
 
         self.SPDMRG = StochasticPDMRG(self.mps_psi0, self.mps_qvpsi0, self.norm_qvpsi0) 
+        self.SPDMRG.proc_id = mrank
         self.n_sites = self.SPDMRG.n_sites
         if fcidump is not None:
             self.fcidump = fcidump
@@ -190,7 +190,7 @@ print(orig_cf, '->', mps.canonical_form, mps.center)
 center = mps.center
 
 mps.save_data()
-mps.load_mutable()
+# tensors are loaded one site at a time in the loops below
 
 # pyblock part
 
@@ -313,6 +313,7 @@ for i in range(1, center):
     str = site_sts[i][0]
     st = state_tensor_product(stl, str)
     st.collect_quanta()
+    mps.load_tensor(i)
     rot = [None] * len(st.quanta)
     swod = swap_order_left(i)
     for k in range(len(st.quanta)):
@@ -338,6 +339,8 @@ for i in range(1, center):
     else:
         save_rotation_matrix(VectorInt(range(2 * (i + 1))), mrot, 0)
         save_rotation_matrix(VectorInt(range(2 * (i + 1))), mrot, -1)
+    del rot, mrot
+    mps.unload_tensor(i)
 
 if su2:
     wave_sites = VectorInt(range(0, center + 1))
@@ -354,6 +357,7 @@ wave.clear()
 
 assert wave.onedot == (dot == 1)
 
+mps.load_tensor(center)
 wfn = mps.tensors[center]
 
 swl = swap_order_left(center)
@@ -376,6 +380,7 @@ for (il, ir), mat in wave.non_zero_blocks:
     xy[:, swr[qr]] = np.ascontiguousarray(xx)
     f = -1 if ql.twos == -2 or ql.twos == 2 else 1
     mat.ref[:, :] = f * np.ascontiguousarray(xy)
+mps.unload_tensor(center)
 
 
 wave.save_wavefunction_info(llrr, wave_sites, 0)
@@ -30,6 +30,7 @@
 #include <array>
 #include <cassert>
 #include <cstdint>
+#include <mutex>
 #include <unordered_map>
 #include <vector>
 
@@ -37,6 +38,120 @@ using namespace std;
 
 namespace block2 {
 
+/** Cache of spin coupling coefficients between CSF [+-] patterns.
+ * The coefficients only depend on the numbers of unpaired electrons and
+ * total spins of bra and ket, the effective operator pattern and its
+ * positions among the unpaired electrons (and the coupling direction), not
+ * on the spatial configuration. So they are computed once and reused for all
+ * configurations and operators. One cache can be shared by several CSFSpace
+ * objects and saved to disk for later runs. */
+struct CSFCouplingCache {
+    typedef long long LL;
+    struct Entry {
+        LL n_bra = 0, n_ket = 0;
+        vector<double> r;
+    };
+    static const int n_shards = 64;
+    array<unordered_map<string, Entry>, n_shards> data;
+    array<mutex, n_shards> locks;
+    CSFCouplingCache() {}
+    static string make_key(bool is_right, int n_unpaired_bra, int twos_bra,
+                           int n_unpaired_ket, int twos_ket, uint8_t ops,
+                           uint8_t op_types, const vector<int> &op_idxs) {
+        vector<uint16_t> k = {(uint16_t)is_right,       (uint16_t)ops,
+                              (uint16_t)op_types,       (uint16_t)twos_bra,
+                              (uint16_t)n_unpaired_bra, (uint16_t)twos_ket,
+                              (uint16_t)n_unpaired_ket};
+        for (auto &x : op_idxs)
+            k.push_back((uint16_t)x);
+        return string((const char *)k.data(), k.size() * sizeof(uint16_t));
+    }
+    int shard(const string &key) const {
+        return (int)(hash<string>()(key) % n_shards);
+    }
+    bool find(const string &key, Entry &entry) {
+        const int ish = shard(key);
+        lock_guard<mutex> lock(locks[ish]);
+        auto it = data[ish].find(key);
+        if (it == data[ish].end())
+            return false;
+        entry = it->second;
+        return true;
+    }
+    void insert(const string &key, const Entry &entry) {
+        const int ish = shard(key);
+        lock_guard<mutex> lock(locks[ish]);
+        data[ish][key] = entry;
+    }
+    size_t size() const {
+        size_t r = 0;
+        for (auto &d : data)
+            r += d.size();
+        return r;
+    }
+    void clear() {
+        for (int ish = 0; ish < n_shards; ish++) {
+            lock_guard<mutex> lock(locks[ish]);
+            data[ish].clear();
+        }
+    }
+    void save_data(ostream &ofs) const {
+        size_t n = size();
+        ofs.write((char *)&n, sizeof(n));
+        for (auto &d : data)
+            for (auto &kv : d) {
+                size_t lk = kv.first.size(), lr = kv.second.r.size();
+                ofs.write((char *)&lk, sizeof(lk));
+                ofs.write(kv.first.data(), lk);
+                ofs.write((char *)&kv.second.n_bra, sizeof(LL));
+                ofs.write((char *)&kv.second.n_ket, sizeof(LL));
+                ofs.write((char *)&lr, sizeof(lr));
+                ofs.write((char *)kv.second.r.data(), sizeof(double) * lr);
+            }
+    }
+    void load_data(istream &ifs) {
+        size_t n = 0;
+        ifs.read((char *)&n, sizeof(n));
+        for (size_t i = 0; i < n && ifs.good(); i++) {
+            size_t lk = 0, lr = 0;
+            ifs.read((char *)&lk, sizeof(lk));
+            string key(lk, 0);
+            ifs.read(&key[0], lk);
+            Entry entry;
+            ifs.read((char *)&entry.n_bra, sizeof(LL));
+            ifs.read((char *)&entry.n_ket, sizeof(LL));
+            ifs.read((char *)&lr, sizeof(lr));
+            entry.r.resize(lr);
+            ifs.read((char *)entry.r.data(), sizeof(double) * lr);
+            data[shard(key)][key] = entry;
+        }
+    }
+    void save_data(const string &filename) const {
+        if (Parsing::link_exists(filename))
+            Parsing::remove_file(filename);
+        ofstream ofs(filename.c_str(), ios::binary);
+        if (!ofs.good())
+            throw runtime_error("CSFCouplingCache::save_data on '" +
+                                filename + "' failed.");
+        save_data(ofs);
+        if (!ofs.good())
+            throw runtime_error("CSFCouplingCache::save_data on '" +
+                                filename + "' failed.");
+        ofs.close();
+    }
+    void load_data(const string &filename) {
+        ifstream ifs(filename.c_str(), ios::binary);
+        if (!ifs.good())
+            throw runtime_error("CSFCouplingCache::load_data on '" +
+                                filename + "' failed.");
+        load_data(ifs);
+        if (ifs.fail() || ifs.bad())
+            throw runtime_error("CSFCouplingCache::load_data on '" +
+                                filename + "' failed.");
+        ifs.close();
+    }
+};
+
 template <typename, typename = void> struct CSFSpace;
 
 template <typename S> struct CSFSpace<S, typename S::is_su2_t> {
@@ -62,6 +177,7 @@ template <typename S> struct CSFSpace<S, typename S::is_su2_t> {
     shared_ptr<Combinatorics> combinatorics;
     shared_ptr<StateInfo<S>> basis;
     shared_ptr<CG<S>> cg;
+    shared_ptr<CSFCouplingCache> coupling_cache; //!< nullptr means no cache.
     int n_orbs;
     int n_max_elec;
     int n_max_unpaired;
@@ -235,6 +351,7 @@ template <typename S> struct CSFSpace<S, typename S::is_su2_t> {
         }
         cg = make_shared<CG<S>>((n_max_unpaired + 1) * 2);
         cg->initialize();
+        coupling_cache = make_shared<CSFCouplingCache>();
     }
     LL n_configs() const { return n_unpaired_idxs.back(); }
     LL n_csfs() const { return csf_offsets.back(); }
@@ -868,6 +985,33 @@ template <typename S> struct CSFSpace<S, typename S::is_su2_t> {
                                  int n_unpaired_ket, int twos_ket, uint8_t ops,
                                  uint8_t op_types, const vector<int> &op_idxs,
                                  double scale, LL &n_bra, LL &n_ket) const {
+        if (coupling_cache != nullptr) {
+            const string key = CSFCouplingCache::make_key(
+                is_right, n_unpaired_bra, twos_bra, n_unpaired_ket, twos_ket,
+                ops, op_types, op_idxs);
+            CSFCouplingCache::Entry entry;
+            if (!coupling_cache->find(key, entry)) {
+                entry.r = compute_csf_apply_ops(
+                    n_unpaired_bra, twos_bra, n_unpaired_ket, twos_ket, ops,
+                    op_types, op_idxs, 1.0, entry.n_bra, entry.n_ket);
+                coupling_cache->insert(key, entry);
+            }
+            n_bra = entry.n_bra, n_ket = entry.n_ket;
+            if (scale != 1.0)
+                for (auto &x : entry.r)
+                    x *= scale;
+            return entry.r;
+        }
+        return compute_csf_apply_ops(n_unpaired_bra, twos_bra,
+                                     n_unpaired_ket, twos_ket, ops, op_types,
+                                     op_idxs, scale, n_bra, n_ket);
+    }
+    vector<double> compute_csf_apply_ops(int n_unpaired_bra, int twos_bra,
+                                         int n_unpaired_ket, int twos_ket,
+                                         uint8_t ops, uint8_t op_types,
+                                         const vector<int> &op_idxs,
+                                         double scale, LL &n_bra,
+                                         LL &n_ket) const {
         return is_right ? csf_apply_ops_impl<true>(n_unpaired_bra, twos_bra,
                                                    n_unpaired_ket, twos_ket,
                                                    ops, op_types, op_idxs,
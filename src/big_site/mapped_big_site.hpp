@@ -0,0 +1,393 @@
+
+/*
+ * block2: Efficient MPO implementation of quantum chemistry DMRG
+ * Copyright (C) 2020-2021 Huanchen Zhai <hczhai@caltech.edu>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#pragma once
+
+#include "../core/csr_sparse_matrix.hpp"
+#include "../core/integral.hpp"
+#include "../core/utils.hpp"
+#include "big_site.hpp"
+#ifdef __unix__
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <memory>
+#include <sstream>
+#include <unordered_map>
+
+using namespace std;
+
+namespace block2 {
+
+/** Read-only view of a big site operator file written by ``MappedBigSite``.
+ * On unix the file is mapped privately (copy-on-write), so that all
+ * processes on the same node share the physical pages of the page cache.
+ * Used as the allocator of all CSR blocks pointing into the mapping, so
+ * the mapping is released when the last such block is deallocated.
+ *
+ * File layout (all fields are 8-byte words): magic, number of operators,
+ * then for each operator: name length, name (zero padded to 8 bytes),
+ * factor, number of blocks (-1 for a zero non-CSR operator), and for each
+ * block (m, n, nnz, offset of its data in words). Block data has the
+ * in-memory layout of ``CSRMatrixRef`` (data, cols, rows).
+ */
+struct MappedBigSiteFile : Allocator<double> {
+    static const int64_t magic = 0x3130504F53474942LL;
+    struct Entry {
+        double factor;
+        int64_t n_blocks;
+        const int64_t *blocks; //!< m, n, nnz and offset of each block
+    };
+    int64_t *ptr = nullptr;
+    size_t len = 0; //!< Number of words
+    vector<int64_t> buffer; //!< Used when mmap is not available
+    unordered_map<string, Entry> entries;
+    MappedBigSiteFile(const string &filename) {
+#ifdef __unix__
+        int fd = open(filename.c_str(), O_RDONLY);
+        if (fd == -1)
+            return;
+        struct stat st;
+        if (fstat(fd, &st) == 0 && st.st_size >= 2 * sizeof(int64_t)) {
+            void *p = mmap(nullptr, st.st_size, PROT_READ | PROT_WRITE,
+                           MAP_PRIVATE, fd, 0);
+            if (p != MAP_FAILED)
+                ptr = (int64_t *)p, len = st.st_size / sizeof(int64_t);
+        }
+        close(fd);
+#else
+        ifstream ifs(filename.c_str(), ios::binary | ios::ate);
+        if (!ifs.good())
+            return;
+        buffer.resize((size_t)ifs.tellg() / sizeof(int64_t));
+        ifs.seekg(0);
+        ifs.read((char *)buffer.data(), buffer.size() * sizeof(int64_t));
+        if (!ifs.good())
+            buffer.clear();
+        ptr = buffer.data(), len = buffer.size();
+#endif
+        if (!parse())
+            entries.clear();
+    }
+    ~MappedBigSiteFile() override {
+#ifdef __unix__
+        if (ptr != nullptr)
+            munmap(ptr, len * sizeof(int64_t));
+#endif
+    }
+    // Blocks keep pointers into the mapping, which is released with this
+    double *allocate(size_t n) override {
+        throw runtime_error("MappedBigSiteFile::allocate is not supported.");
+    }
+    void deallocate(void *ptr, size_t n) override {}
+    static size_t block_words(int64_t m, int64_t n, int64_t nnz) {
+        return CSRMatrixRef((MKL_INT)m, (MKL_INT)n, (MKL_INT)nnz, nullptr,
+                            nullptr, nullptr)
+            .memory_size();
+    }
+    bool parse() {
+        if (len < 2 || ptr[0] != magic)
+            return false;
+        size_t k = 2;
+        for (int64_t i = 0; i < ptr[1]; i++) {
+            if (k + 1 > len || ptr[k] < 0)
+                return false;
+            size_t lw = (ptr[k] + 7) / 8;
+            if (k + 1 + lw + 2 > len)
+                return false;
+            string name((const char *)(ptr + k + 1), ptr[k]);
+            k += 1 + lw;
+            Entry e;
+            memcpy(&e.factor, ptr + k, sizeof(double));
+            e.n_blocks = ptr[k + 1], e.blocks = ptr + k + 2;
+            k += 2 + 4 * max(e.n_blocks, (int64_t)0);
+            if (k > len)
+                return false;
+            for (int64_t j = 0; j < e.n_blocks; j++) {
+                const int64_t *b = e.blocks + j * 4;
+                if (b[3] < 0 ||
+                    b[3] + block_words(b[0], b[1], b[2]) > (int64_t)len)
+                    return false;
+            }
+            entries[name] = e;
+        }
+        return true;
+    }
+    const double *block_data(const Entry &e, int64_t j) const {
+        return (const double *)(ptr + e.blocks[j * 4 + 3]);
+    }
+};
+
+/** Big site wrapper keeping the operators of the wrapped big site in an
+ * on-disk, memory-mappable operator store. Operators found in the store
+ * are mapped instead of rebuilt, so that subsequent runs and other MPI
+ * processes on the same node reuse them. Missing operators are built by
+ * the wrapped big site and added to the store, which is replaced
+ * atomically (concurrent writers may drop each other's additions, which
+ * are then simply rebuilt next time). Only CSR operators and zero
+ * operators are stored. This should wrap the raw big site (and be wrapped
+ * by ``SimplifiedBigSite`` or ``ParallelBigSite``).
+ */
+template <typename S> struct MappedBigSite : BigSite<S> {
+    shared_ptr<BigSite<S>> big_site;
+    string directory; //!< Directory of the operator store
+    string key; //!< Identifies the big site (see ``make_key``)
+    bool read_only = false; //!< If true, the store is never written
+    mutable size_t n_loaded = 0, n_built = 0; //!< Number of operators
+    MappedBigSite(const shared_ptr<BigSite<S>> &big_site,
+                  const string &directory, const string &key)
+        : BigSite<S>(*big_site), big_site(big_site), directory(directory),
+          key(key) {}
+    virtual ~MappedBigSite() = default;
+    /** FNV-1a hash of the integrals (as hex string). */
+    static string integral_hash(const shared_ptr<FCIDUMP> &fcidump) {
+        uint64_t h = 0xCBF29CE484222325ULL;
+        auto update = [&h](const void *p, size_t n) {
+            for (size_t i = 0; i < n; i++)
+                h = (h ^ ((const uint8_t *)p)[i]) * 0x100000001B3ULL;
+        };
+        update(&fcidump->const_e, sizeof(double));
+        if (fcidump->total_memory != 0)
+            update(fcidump->data, sizeof(double) * fcidump->total_memory);
+        for (auto &p : fcidump->params)
+            update(p.first.c_str(), p.first.length()),
+                update(p.second.c_str(), p.second.length());
+        stringstream ss;
+        ss << hex << setw(16) << setfill('0') << h;
+        return ss.str();
+    }
+    /** Key of a big site.
+     * @param n_orbs Number of orbitals in the big site.
+     * @param n_elec Number of electrons (or maximal number of electrons) in
+     * the big site.
+     * @param excitation Excitation level (or number of holes/particles)
+     * allowed in the big site.
+     * @param fcidump Integrals used to build the operators.
+     */
+    static string make_key(int n_orbs, int n_elec, int excitation,
+                           const shared_ptr<FCIDUMP> &fcidump) {
+        stringstream ss;
+        ss << "N" << n_orbs << ".E" << n_elec << ".X" << excitation << "."
+           << integral_hash(fcidump);
+        return ss.str();
+    }
+    string get_filename(uint16_t m) const {
+        stringstream ss;
+        ss << directory << "/BIGSITE." << key << ".M" << m << ".OPS";
+        return ss.str();
+    }
+    static string op_name(const shared_ptr<OpElement<S>> &op) {
+        string name = op->get_name();
+        if (name.length() != 0 && name.back() == '\n')
+            name.pop_back();
+        return name;
+    }
+    shared_ptr<SparseMatrix<S>>
+    load_op(const shared_ptr<MappedBigSiteFile> &mfile,
+            const shared_ptr<OpElement<S>> &op) const {
+        auto it = mfile->entries.find(op_name(op));
+        if (it == mfile->entries.end())
+            return nullptr;
+        const MappedBigSiteFile::Entry &e = it->second;
+        if (e.n_blocks == -1) {
+            shared_ptr<SparseMatrix<S>> zero =
+                make_shared<SparseMatrix<S>>(nullptr);
+            zero->factor = 0.0;
+            return zero;
+        }
+        shared_ptr<SparseMatrixInfo<S>> info =
+            big_site->find_site_op_info(op->q_label);
+        if (info == nullptr || info->n != e.n_blocks)
+            return nullptr;
+        for (int i = 0; i < info->n; i++)
+            if (info->n_states_bra[i] != e.blocks[i * 4] ||
+                info->n_states_ket[i] != e.blocks[i * 4 + 1])
+                return nullptr;
+        shared_ptr<CSRSparseMatrix<S>> mat = make_shared<CSRSparseMatrix<S>>();
+        mat->info = info;
+        mat->factor = e.factor;
+        mat->csr_data.resize(info->n);
+        for (int i = 0; i < info->n; i++) {
+            const int64_t *b = e.blocks + i * 4;
+            mat->csr_data[i] = make_shared<CSRMatrixRef>(
+                (MKL_INT)b[0], (MKL_INT)b[1], (MKL_INT)b[2], nullptr, nullptr,
+                nullptr);
+            mat->csr_data[i]->alloc = mfile;
+            mat->csr_data[i]->allocate((double *)mfile->block_data(e, i));
+        }
+        return mat;
+    }
+    /** Write all operators in the old store and the new operators. */
+    void
+    save_ops(const string &filename,
+             const shared_ptr<MappedBigSiteFile> &mfile,
+             const unordered_map<shared_ptr<OpExpr<S>>,
+                                 shared_ptr<SparseMatrix<S>>> &kops) const {
+        // name, factor and (m, n, nnz, data, cols, rows) of each block
+        struct Block {
+            int64_t m, n, nnz;
+            const double *data;
+            const MKL_INT *cols, *rows;
+        };
+        vector<pair<string, pair<double, vector<Block>>>> items;
+        vector<bool> has_blocks;
+        unordered_map<string, size_t> idx;
+        for (auto &p : kops) {
+            const string name =
+                op_name(dynamic_pointer_cast<OpElement<S>>(p.first));
+            const shared_ptr<SparseMatrix<S>> &mat = p.second;
+            if (mat == nullptr || idx.count(name))
+                continue;
+            if (mat->get_type() == SparseMatrixTypes::CSR) {
+                shared_ptr<CSRSparseMatrix<S>> cmat =
+                    dynamic_pointer_cast<CSRSparseMatrix<S>>(mat);
+                vector<Block> blocks(cmat->csr_data.size());
+                for (size_t i = 0; i < blocks.size(); i++) {
+                    const CSRMatrixRef &r = *cmat->csr_data[i];
+                    blocks[i] = Block{r.m, r.n, r.nnz, r.data, r.cols, r.rows};
+                }
+                idx[name] = items.size(), has_blocks.push_back(true);
+                items.push_back(
+                    make_pair(name, make_pair(mat->factor, blocks)));
+            } else if (mat->factor == 0) {
+                idx[name] = items.size(), has_blocks.push_back(false);
+                items.push_back(
+                    make_pair(name, make_pair(0.0, vector<Block>())));
+            }
+        }
+        if (items.size() == 0)
+            return;
+        if (mfile != nullptr)
+            for (auto &p : mfile->entries) {
+                if (idx.count(p.first))
+                    continue;
+                const MappedBigSiteFile::Entry &e = p.second;
+                vector<Block> blocks(max(e.n_blocks, (int64_t)0));
+                for (size_t i = 0; i < blocks.size(); i++) {
+                    const int64_t *b = e.blocks + i * 4;
+                    const double *data = mfile->block_data(e, i);
+                    const MKL_INT *cols = (const MKL_INT *)(data + b[2]);
+                    blocks[i] = Block{b[0], b[1], b[2], data, cols,
+                                      cols + b[2]};
+                }
+                idx[p.first] = items.size();
+                has_blocks.push_back(e.n_blocks != -1);
+                items.push_back(
+                    make_pair(p.first, make_pair(e.factor, blocks)));
+            }
+        vector<int64_t> header(2);
+        header[0] = MappedBigSiteFile::magic, header[1] = items.size();
+        size_t n_index = 2;
+        for (auto &it : items)
+            n_index += 1 + (it.first.length() + 7) / 8 + 2 +
+                       4 * it.second.second.size();
+        size_t offset = n_index;
+        for (size_t k = 0; k < items.size(); k++) {
+            const string &name = items[k].first;
+            header.push_back(name.length());
+            vector<int64_t> sname((name.length() + 7) / 8, 0);
+            memcpy(sname.data(), name.c_str(), name.length());
+            header.insert(header.end(), sname.begin(), sname.end());
+            int64_t factor;
+            memcpy(&factor, &items[k].second.first, sizeof(double));
+            header.push_back(factor);
+            header.push_back(has_blocks[k] ? items[k].second.second.size()
+                                           : -1);
+            for (auto &b : items[k].second.second) {
+                header.insert(header.end(), {b.m, b.n, b.nnz, (int64_t)offset});
+                offset += MappedBigSiteFile::block_words(b.m, b.n, b.nnz);
+            }
+        }
+        assert(header.size() == n_index);
+        stringstream ss;
+#ifdef __unix__
+        ss << filename << ".tmp." << getpid();
+#else
+        ss << filename << ".tmp";
+#endif
+        const string tmp_filename = ss.str();
+        ofstream ofs(tmp_filename.c_str(), ios::binary);
+        if (!ofs.good())
+            throw runtime_error("MappedBigSite::save_ops on '" +
+                                tmp_filename + "' failed.");
+        ofs.write((char *)header.data(), sizeof(int64_t) * header.size());
+        vector<char> pad(sizeof(double) * 2, 0);
+        for (auto &it : items)
+            for (auto &b : it.second.second) {
+                size_t sz = sizeof(double) * b.nnz;
+                ofs.write((char *)b.data, sizeof(double) * b.nnz);
+                if (b.nnz != b.m * b.n) {
+                    ofs.write((char *)b.cols, sizeof(MKL_INT) * b.nnz);
+                    ofs.write((char *)b.rows, sizeof(MKL_INT) * b.m);
+                    MKL_INT nnz = (MKL_INT)b.nnz;
+                    ofs.write((char *)&nnz, sizeof(MKL_INT));
+                    sz += sizeof(MKL_INT) * (b.nnz + b.m + 1);
+                }
+                ofs.write(pad.data(),
+                          sizeof(double) * MappedBigSiteFile::block_words(
+                                               b.m, b.n, b.nnz) -
+                              sz);
+            }
+        if (!ofs.good())
+            throw runtime_error("MappedBigSite::save_ops on '" +
+                                tmp_filename + "' failed.");
+        ofs.close();
+        if (!Parsing::rename_file(tmp_filename, filename))
+            throw runtime_error("MappedBigSite::save_ops on '" + filename +
+                                "' failed.");
+    }
+    void get_site_ops(
+        uint16_t m,
+        unordered_map<shared_ptr<OpExpr<S>>, shared_ptr<SparseMatrix<S>>> &ops)
+        const override {
+        const string filename = get_filename(m);
+        shared_ptr<MappedBigSiteFile> mfile =
+            Parsing::file_exists(filename)
+                ? make_shared<MappedBigSiteFile>(filename)
+                : nullptr;
+        unordered_map<shared_ptr<OpExpr<S>>, shared_ptr<SparseMatrix<S>>> kops;
+        for (auto &p : ops) {
+            assert(p.second == nullptr);
+            shared_ptr<OpElement<S>> op =
+                dynamic_pointer_cast<OpElement<S>>(p.first);
+            if (mfile != nullptr)
+                p.second = load_op(mfile, op);
+            if (p.second == nullptr)
+                kops[p.first] = nullptr;
+        }
+        n_loaded += ops.size() - kops.size();
+        if (kops.size() == 0)
+            return;
+        big_site->get_site_ops(m, kops);
+        n_built += kops.size();
+        for (auto &p : kops)
+            ops[p.first] = p.second;
+        if (!read_only)
+            save_ops(filename, mfile, kops);
+    }
+};
+
+} // namespace block2
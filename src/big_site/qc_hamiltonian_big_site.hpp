@@ -63,6 +63,9 @@ template <typename S> struct HamiltonianQCBigSite : HamiltonianQC<S> {
     shared_ptr<Rule<S>> rule = nullptr;
     shared_ptr<ParallelRule<S>> parallel_rule = nullptr;
     shared_ptr<HamiltonianQC<S>> full_hamil;
+    //! Expected number of products with each big-site operator, used to
+    //! optimize persisted sparse (MKL) handles; 0 means no optimization
+    int csr_expected_calls = 1000;
     HamiltonianQCBigSite(S vacuum, int n_orbs_total,
                          const vector<typename S::pg_t> &orb_sym,
                          const shared_ptr<FCIDUMP> &fcidump,
@@ -91,11 +94,14 @@ template <typename S> struct HamiltonianQCBigSite : HamiltonianQC<S> {
             vector<vector<pair<S, shared_ptr<SparseMatrixInfo<S>>>>>(
                 full_hamil->site_op_infos.begin() + n_orbs_left,
                 full_hamil->site_op_infos.end() - n_orbs_right);
+        // big sites have many quanta to look up
         if (big_left != nullptr) {
+            big_left->basis->build_index();
             basis.insert(basis.begin(), big_left->basis);
             site_op_infos.insert(site_op_infos.begin(), big_left->op_infos);
         }
         if (big_right != nullptr) {
+            big_right->basis->build_index();
             basis.push_back(big_right->basis);
             site_op_infos.push_back(big_right->op_infos);
         }
@@ -119,6 +125,19 @@ template <typename S> struct HamiltonianQCBigSite : HamiltonianQC<S> {
         }
         full_hamil->deallocate();
     }
+    // Big-site operators are used many times in Davidson, so their sparse
+    // handles are kept and optimized once
+    void optimize_csr_ops(
+        const unordered_map<shared_ptr<OpExpr<S>>, shared_ptr<SparseMatrix<S>>>
+            &ops) const {
+        if (csr_expected_calls <= 0)
+            return;
+        for (auto &p : ops)
+            if (p.second != nullptr &&
+                p.second->get_type() == SparseMatrixTypes::CSR)
+                dynamic_pointer_cast<CSRSparseMatrix<S>>(p.second)->optimize(
+                    csr_expected_calls);
+    }
     void get_site_ops(
         uint16_t m,
         unordered_map<shared_ptr<OpExpr<S>>, shared_ptr<SparseMatrix<S>>> &ops)
@@ -129,10 +148,12 @@ template <typename S> struct HamiltonianQCBigSite : HamiltonianQC<S> {
         if (delayed != DelayedOpNames::None) {
             ph = make_shared<HamiltonianQCBigSite<S>>(*this);
             ph->delayed = DelayedOpNames::None;
+            // delayed operators are rebuilt for each use
+            ph->csr_expected_calls = 0;
         }
         if (m == n_sites - 1 && big_right != nullptr) {
             if (!(delayed & DelayedOpNames::RightBig))
-                big_right->get_site_ops(m, ops);
+                big_right->get_site_ops(m, ops), optimize_csr_ops(ops);
             else {
                 for (auto &p : ops) {
                     OpElement<S> &op =
@@ -144,7 +165,7 @@ template <typename S> struct HamiltonianQCBigSite : HamiltonianQC<S> {
             }
         } else if (m == 0 && big_left != nullptr) {
             if (!(delayed & DelayedOpNames::LeftBig))
-                big_left->get_site_ops(m, ops);
+                big_left->get_site_ops(m, ops), optimize_csr_ops(ops);
             else {
                 for (auto &p : ops) {
                     OpElement<S> &op =
@@ -40,8 +40,11 @@
 #include "sci_fock_big_site.hpp"
 #include "../core/sparse_matrix.hpp"
 #include "../core/state_info.hpp"
+#include "../core/threading.hpp"
 #include "../core/utils.hpp"
+#include <algorithm>
 #include <cstdio>
+#include <functional>
 #include <iostream>
 #include <vector>
 
@@ -94,6 +97,54 @@ void allocateEmptyMatrices(std::vector<EntryTuple> &vec) {
     }
 }
 
+/** Estimated cost of filling mat: number of (bra, ket) determinant pairs
+ * (pairLoop) or of ket determinants visited over all QN blocks. */
+template <typename S>
+size_t opCost(const block2::CSRSparseMatrix<S> &mat, bool pairLoop) {
+    size_t cost = 1;
+    for (int i = 0; i < mat.info->n; ++i) {
+        cost += pairLoop ? (size_t)mat.info->n_states_bra[i] *
+                               mat.info->n_states_ket[i]
+                         : (size_t)mat.info->n_states_ket[i];
+    }
+    return cost;
+}
+
+/** Estimated cost of all operators in groups sharing a pair loop. */
+template <typename S, typename Groups>
+size_t groupCost(const Groups &groups) {
+    size_t cost = 0;
+    for (const auto &pairs : groups)
+        cost += opCost<S>(pairs.second.at(0).mat, true) * pairs.second.size();
+    return cost;
+}
+
+/** Split each group into chunks proportional to its share of totCost and
+ * append them as tasks. */
+template <typename S, typename Groups, typename Fill>
+void addGroupTasks(
+    std::vector<std::pair<size_t, std::function<void()>>> &tasks,
+    Groups &groups, Fill fill, size_t totCost, int ntg) {
+    typedef typename Groups::mapped_type Entries;
+    for (auto &pairs : groups) {
+        const Entries &entries = pairs.second;
+        const size_t nEntries = entries.size();
+        const size_t cost = opCost<S>(entries.at(0).mat, true);
+        const size_t nChunks =
+            std::min(nEntries, cost * nEntries * ntg / totCost + (size_t)1);
+        for (size_t ic = 0; ic < nChunks; ++ic) {
+            Entries chunk(entries.begin() + nEntries * ic / nChunks,
+                          entries.begin() + nEntries * (ic + 1) / nChunks);
+            const S deltaQN = pairs.first;
+            tasks.emplace_back(cost * chunk.size(),
+                               [fill, deltaQN, chunk]() mutable {
+                                   fill(deltaQN, chunk);
+                               });
+        }
+    }
+    groups.clear();
+}
+
 } // namespace sci_detail
 
 template <typename S>
@@ -178,6 +229,11 @@ void SCIFockBigSite<S, typename S::is_sz_t>::get_site_ops(
     // have not yet optimized it Same for C and D, which is fast
     unordered_map<S, std::vector<entryTuple2>> opsQ, opsP, opsPD;
     unordered_map<S, std::vector<entryTuple1>> opsR, opsRD;
+    // Operators are built as independent tasks, each with a cost estimated
+    // from the number of determinants it visits. The tasks are distributed
+    // over threads dynamically, largest first, and each task fills its own
+    // CSR matrices, so that nothing needs to be merged afterwards.
+    std::vector<std::pair<size_t, std::function<void()>>> tasks;
     for (auto &p : ops) {
         shared_ptr<OpElement<S>> pop =
             dynamic_pointer_cast<OpElement<S>>(p.first);
@@ -193,7 +249,7 @@ void SCIFockBigSite<S, typename S::is_sz_t>::get_site_ops(
         //      So here, the CSRMatrices are only initialized (i.e., their
         //      sizes are set)
         mat.initialize(BigSite<S>::find_site_op_info(op.q_label));
-        const auto &delta_qn = op.q_label;
+        const S delta_qn = op.q_label;
         if (false and op.name == OpNames::R) { // DEBUG
             cout << "m == " << iSite << "allocate" << op.name << "s"
                  << (int)op.site_index[0] << "," << (int)op.site_index[1]
@@ -225,7 +281,8 @@ void SCIFockBigSite<S, typename S::is_sz_t>::get_site_ops(
         }
         switch (op.name) {
         case OpNames::I:
-            fillOp_I(mat);
+            tasks.emplace_back(sci_detail::opCost(mat, false),
+                               [this, &mat]() { fillOp_I(mat); });
             break;
         case OpNames::N:
             fillOp_N(mat);
@@ -234,13 +291,20 @@ void SCIFockBigSite<S, typename S::is_sz_t>::get_site_ops(
             fillOp_NN(mat);
             break;
         case OpNames::H:
-            fillOp_H(mat);
+            tasks.emplace_back(sci_detail::opCost(mat, true),
+                               [this, &mat]() { fillOp_H(mat); });
             break;
         case OpNames::C:
-            fillOp_C(delta_qn, mat, ii);
+            tasks.emplace_back(sci_detail::opCost(mat, false),
+                               [this, &mat, delta_qn, ii]() {
+                                   fillOp_C(delta_qn, mat, ii);
+                               });
             break;
         case OpNames::D:
-            fillOp_D(delta_qn, mat, ii);
+            tasks.emplace_back(sci_detail::opCost(mat, false),
+                               [this, &mat, delta_qn, ii]() {
+                                   fillOp_D(delta_qn, mat, ii);
+                               });
             break;
         case OpNames::R:
             opsR[delta_qn].emplace_back(mat, ii);
@@ -249,13 +313,22 @@ void SCIFockBigSite<S, typename S::is_sz_t>::get_site_ops(
             opsRD[delta_qn].emplace_back(mat, ii);
             break;
         case OpNames::A:
-            fillOp_A(delta_qn, mat, ii, jj);
+            tasks.emplace_back(sci_detail::opCost(mat, false),
+                               [this, &mat, delta_qn, ii, jj]() {
+                                   fillOp_A(delta_qn, mat, ii, jj);
+                               });
             break;
         case OpNames::AD:
-            fillOp_AD(delta_qn, mat, ii, jj);
+            tasks.emplace_back(sci_detail::opCost(mat, false),
+                               [this, &mat, delta_qn, ii, jj]() {
+                                   fillOp_AD(delta_qn, mat, ii, jj);
+                               });
             break;
         case OpNames::B:
-            fillOp_B(delta_qn, mat, ii, jj);
+            tasks.emplace_back(sci_detail::opCost(mat, false),
+                               [this, &mat, delta_qn, ii, jj]() {
+                                   fillOp_B(delta_qn, mat, ii, jj);
+                               });
             break;
         case OpNames::P:
             opsP[delta_qn].emplace_back(mat, ii, jj);
@@ -270,31 +343,54 @@ void SCIFockBigSite<S, typename S::is_sz_t>::get_site_ops(
             assert(false);
         }
     }
-    for (auto &pairs : opsR) {
-        fillOp_R(pairs.first, pairs.second);
-        pairs.second.clear();
-        pairs.second.shrink_to_fit();
-    }
-    for (auto &pairs : opsRD) {
-        fillOp_RD(pairs.first, pairs.second);
-        pairs.second.clear();
-        pairs.second.shrink_to_fit();
-    }
-    for (auto &pairs : opsP) {
-        fillOp_P(pairs.first, pairs.second);
-        pairs.second.clear();
-        pairs.second.shrink_to_fit();
-    }
-    for (auto &pairs : opsPD) {
-        fillOp_PD(pairs.first, pairs.second);
-        pairs.second.clear();
-        pairs.second.shrink_to_fit();
-    }
-    for (auto &pairs : opsQ) {
-        fillOp_Q(pairs.first, pairs.second);
-        pairs.second.clear();
-        pairs.second.shrink_to_fit();
-    }
+    int ntg = threading->activate_global();
+#ifdef _SCI_USE_OMP_ON
+    ntg = 1; // the loops within each operator are parallelized instead
+#endif
+    // Operators in one group share the loop over determinant pairs.
+    // A group is split into several tasks only when it is larger than its
+    // share of the total cost, so that the shared work is not repeated
+    // needlessly.
+    size_t totCost = 1;
+    for (const auto &t : tasks)
+        totCost += t.first;
+    totCost += sci_detail::groupCost<S>(opsR) +
+               sci_detail::groupCost<S>(opsRD) +
+               sci_detail::groupCost<S>(opsP) +
+               sci_detail::groupCost<S>(opsPD) +
+               sci_detail::groupCost<S>(opsQ);
+    sci_detail::addGroupTasks<S>(
+        tasks, opsR,
+        [this](const S &q, std::vector<entryTuple1> &e) { fillOp_R(q, e); },
+        totCost, ntg);
+    sci_detail::addGroupTasks<S>(
+        tasks, opsRD,
+        [this](const S &q, std::vector<entryTuple1> &e) { fillOp_RD(q, e); },
+        totCost, ntg);
+    sci_detail::addGroupTasks<S>(
+        tasks, opsP,
+        [this](const S &q, std::vector<entryTuple2> &e) { fillOp_P(q, e); },
+        totCost, ntg);
+    sci_detail::addGroupTasks<S>(
+        tasks, opsPD,
+        [this](const S &q, std::vector<entryTuple2> &e) { fillOp_PD(q, e); },
+        totCost, ntg);
+    sci_detail::addGroupTasks<S>(
+        tasks, opsQ,
+        [this](const S &q, std::vector<entryTuple2> &e) { fillOp_Q(q, e); },
+        totCost, ntg);
+    // largest first, so that the dynamic schedule ends balanced
+    std::stable_sort(tasks.begin(), tasks.end(),
+                     [](const std::pair<size_t, std::function<void()>> &a,
+                        const std::pair<size_t, std::function<void()>> &b) {
+                         return a.first > b.first;
+                     });
+#ifndef _SCI_USE_OMP_ON
+#pragma omp parallel for schedule(dynamic) num_threads(ntg)
+#endif
+    for (int it = 0; it < (int)tasks.size(); ++it)
+        tasks[it].second();
+    threading->activate_normal();
     finalize();
 }
 
@@ -933,7 +1029,6 @@ size_t SCIFockBigSite<S, typename S::is_sz_t>::fillCoeffs(
         }
     }
     auto sparsity = (mat.size() - nCount) / static_cast<double>(mat.size());
-    summSparsity += sparsity;
     const auto isSparse =
         sparsity > sparsityThresh and mat.size() >= sparsityStart;
     if (not isSparse) {
@@ -980,15 +1075,19 @@ size_t SCIFockBigSite<S, typename S::is_sz_t>::fillCoeffs(
         cooMat.fillCSR(mat);
         coeffs(0, iRow).resize(0);
     }
-    if (isSparse) {
-        ++numSparse;
-        //                                     vv bit of overestimation for CSR
-        //                                     format
-        usedMem += nCount * (sizeof(double) +
-                             2 * sizeof(int)); // int in native implementation
-    } else {
-        ++numDense;
-        usedMem += mat.size() * sizeof(double);
+    // statistics are shared by operators built on different threads
+#pragma omp critical(sci_fock_stats)
+    {
+        summSparsity += sparsity;
+        if (isSparse) {
+            ++numSparse;
+            // bit of overestimation for CSR format
+            // (int in native implementation)
+            usedMem += nCount * (sizeof(double) + 2 * sizeof(int));
+        } else {
+            ++numDense;
+            usedMem += mat.size() * sizeof(double);
+        }
     }
     return nCount;
 }
@@ -1057,6 +1156,45 @@ void SCIFockBigSite<S, typename S::is_sz_t>::fillOp_H(
         const auto o2Bra =
             offsets[braQN].second; // openMP cant handle auto [...] -.-
         const auto sizBra = o2Bra - o1Bra;
+        // For large blocks, generate the singles and doubles of each ket and
+        // look them up, instead of comparing all pairs of determinants
+        if (ketQN == braQN and sizKet > 0 and
+            fragSpace[o1Ket].nExcitations() * 4 < (size_t)sizBra) {
+#ifdef _SCI_USE_OMP_ON
+#pragma omp parallel for default(shared) schedule(dynamic)
+#endif
+            for (int jj = 0; jj < sizKet; ++jj) {
+                auto &coeffs = allOpCoeffs(getThreadID(), 0);
+                const auto jD = o1Ket + jj;
+                const auto &ket = fragSpace[jD];
+                coeffs.emplace_back(make_pair(jj, jj),
+                                    ket.Energy(ints1, ints2, ket.getClosed()));
+                ket.forEachExcitation([&](const SCIFockDeterminant &bra,
+                                          const int *cre, const int *des,
+                                          int nExc) {
+                    const auto map_val = fragIndexMap.find(bra);
+                    if (map_val == fragIndexMap.cend()) {
+                        return; // may not be in there
+                    }
+                    const int iD = map_val->second;
+                    if (iD <= jD or iD >= o2Bra) {
+                        return; // ATTENTION: Exploit symmetry
+                    }
+                    const auto Hij =
+                        nExc == 1 ? ket.Hij_1Excite(cre[0], des[0], ints1,
+                                                    ints2)
+                                  : ket.Hij_2Excite(des[0], des[1], cre[0],
+                                                    cre[1], ints1, ints2);
+                    if (std::abs(Hij) > eps) {
+                        coeffs.emplace_back(make_pair(iD - o1Bra, jj), Hij);
+                    }
+                });
+            }
+            nonZeros +=
+                fillCoeffs<true>(smat, allOpCoeffs, 0, mat[sym], summSparsityH,
+                                 numSparseH, numDenseH, usedMemH);
+            continue;
+        }
 #ifdef _SCI_USE_OMP_ON
 #pragma omp parallel for collapse(2) default(shared) schedule(dynamic)
 #endif
@@ -1148,13 +1286,16 @@ void SCIFockBigSite<S, typename S::is_sz_t>::fillOp_H(
             fillCoeffs<true>(smat, allOpCoeffs, 0, mat[sym], summSparsityH,
                              numSparseH, numDenseH, usedMemH);
     }
-    if (nonZeros == 0) { // oops!
-        sci_detail::setMatrixToZero(mat);
-        numZeroH += 1;
+#pragma omp critical(sci_fock_stats)
+    {
+        if (nonZeros == 0) { // oops!
+            sci_detail::setMatrixToZero(mat);
+            numZeroH += 1;
+        }
+        timeH += clock.get_time();
+        qnCountsH += qnSiz;
+        totCountsH += 1;
     }
-    timeH += clock.get_time();
-    qnCountsH += qnSiz;
-    totCountsH += 1;
 }
 template <typename S>
 template <bool Cop>
@@ -1189,21 +1330,11 @@ void SCIFockBigSite<S, typename S::is_sz_t>::fillOp_C_impl(const S &deltaQN,
         for (int jj = 0; jj < sizKet; ++jj) {
             const auto iThread = getThreadID();
             const auto jD = o1Ket + jj;
-            const auto &ket = fragSpace[jD];
-            const auto closedKet = ket.getClosed();
-            std::pair<int, std::vector<int>> applResult;
-            if /* constexpr */ (Cop) {
-                applResult = SCIFockDeterminant::applyCreator(closedKet, iOrbL);
-            } else {
-                applResult =
-                    SCIFockDeterminant::applyAnnihilator(closedKet, iOrbL);
-            }
-            const auto phase = applResult.first;
-            const auto closedBra = applResult.second;
-            // const auto [phase, closedBra] = applResult;
+            // Apply the operator directly on the bit representation
+            SCIFockDeterminant bra = fragSpace[jD];
+            const auto phase = Cop ? bra.create(iOrbL) : bra.annihilate(iOrbL);
             if (phase != 0) {
                 // Find the determinant
-                SCIFockDeterminant bra(ket.norbs, closedBra);
                 const auto map_val = fragIndexMap.find(bra);
                 int iD = map_val == fragIndexMap.cend() ? -1 : map_val->second;
                 if (iD >= 0) { // may not be in there
@@ -1223,18 +1354,21 @@ void SCIFockBigSite<S, typename S::is_sz_t>::fillOp_C_impl(const S &deltaQN,
                                   numSparseD, numDenseD, usedMemD);
         }
     }
-    if (nonZeros == 0) {
-        sci_detail::setMatrixToZero(mat);
-        Cop ? numZeroC += 1 : numZeroD += 1;
-    }
-    if /* constexpr */ (Cop) {
-        timeC += clock.get_time();
-        qnCountsC += qnSiz;
-        totCountsC += 1;
-    } else {
-        timeD += clock.get_time();
-        qnCountsD += qnSiz;
-        totCountsD += 1;
+#pragma omp critical(sci_fock_stats)
+    {
+        if (nonZeros == 0) {
+            sci_detail::setMatrixToZero(mat);
+            Cop ? numZeroC += 1 : numZeroD += 1;
+        }
+        if /* constexpr */ (Cop) {
+            timeC += clock.get_time();
+            qnCountsC += qnSiz;
+            totCountsC += 1;
+        } else {
+            timeD += clock.get_time();
+            qnCountsD += qnSiz;
+            totCountsD += 1;
+        }
     }
 }
 template <typename S>
@@ -1287,22 +1421,13 @@ void SCIFockBigSite<S, typename S::is_sz_t>::fillOp_R_impl(
                 std::vector<int> closed;
                 const auto iD = o1Bra + ii;
                 const auto iThread = getThreadID();
-#ifdef _SCI_USE_OMP_ON
-                auto bra = fragSpace[iD]; // copy to ease life
-#else
-                auto &bra = const_cast<SCIFockDeterminant &>(
-                    fragSpace[iD]); // will be restored
-#endif
+                // copy, as other threads may use the same determinant
+                auto bra = fragSpace[iD];
                 if /* constexpr */ (not Dagger) {
                     closed = bra.getClosed(); // TODO could be saved...
                 }
                 const auto jD = o1Ket + jj;
-#ifdef _SCI_USE_OMP_ON
                 auto ket = fragSpace[jD];
-#else
-                auto &ket = const_cast<SCIFockDeterminant &>(
-                    fragSpace[jD]); // will be restored
-#endif
                 assert(Dagger ? bra.nEl() - 1 == ket.nEl()
                               : bra.nEl() == ket.nEl() - 1);
                 if /* constexpr */ (Dagger) {
@@ -1436,21 +1561,24 @@ void SCIFockBigSite<S, typename S::is_sz_t>::fillOp_R_impl(
             }
         }
     }
-    for (int xx = 0; xx < entrySize; ++xx) {
-        if (nonZeros[xx] == 0) {
-            auto &mat = entries[xx].mat;
-            sci_detail::setMatrixToZero(mat);
-            Dagger ? numZeroRD += 1 : numZeroR += 1;
+#pragma omp critical(sci_fock_stats)
+    {
+        for (int xx = 0; xx < entrySize; ++xx) {
+            if (nonZeros[xx] == 0) {
+                auto &mat = entries[xx].mat;
+                sci_detail::setMatrixToZero(mat);
+                Dagger ? numZeroRD += 1 : numZeroR += 1;
+            }
+        }
+        if /* constexpr */ (Dagger) {
+            timeRD += clock.get_time();
+            qnCountsRD += qnSiz * entrySize;
+            totCountsRD += 1;
+        } else {
+            timeR += clock.get_time();
+            qnCountsR += qnSiz * entrySize;
+            totCountsR += 1;
         }
-    }
-    if /* constexpr */ (Dagger) {
-        timeRD += clock.get_time();
-        qnCountsRD += qnSiz * entrySize;
-        totCountsRD += 1;
-    } else {
-        timeR += clock.get_time();
-        qnCountsR += qnSiz * entrySize;
-        totCountsR += 1;
     }
     if (doAllocateEmptyMats()) {
         sci_detail::allocateEmptyMatrices<S>(entries);
@@ -1487,10 +1615,6 @@ void SCIFockBigSite<S, typename S::is_sz_t>::fillOp_AB_impl(const S &deltaQN,
     const auto qnSiz = qnPairs.size();
     size_t nonZeros = 0;
     sci_detail::COOSparseMat<double> smat;
-#ifndef _SCI_USE_OMP_ON
-    std::pair<int, std::vector<int>> applResult;
-    std::pair<int, std::vector<int>> applResult2;
-#endif
     for (int itQN = 0; itQN < qnSiz; ++itQN) {
         const auto ketQN = qnPairs[itQN].first;
         const auto braQN = qnPairs[itQN].second;
@@ -1508,39 +1632,27 @@ void SCIFockBigSite<S, typename S::is_sz_t>::fillOp_AB_impl(const S &deltaQN,
 #pragma omp parallel for default(shared) schedule(dynamic)
 #endif
         for (int jj = 0; jj < sizKet; ++jj) {
-#ifdef _SCI_USE_OMP_ON
-            std::pair<int, std::vector<int>> applResult;
-            std::pair<int, std::vector<int>> applResult2;
-#endif
             const auto iThread = getThreadID();
             const auto jD = o1Ket + jj;
-            const auto &ket = fragSpace[jD];
-            const auto closedKet = ket.getClosed();
+            // Apply both operators directly on the bit representation
+            SCIFockDeterminant bra = fragSpace[jD];
+            int phase1;
             if /* constexpr */ (Type == 0 or Type == 2) { // A: i j; B: i' j
-                applResult =
-                    SCIFockDeterminant::applyAnnihilator(closedKet, jOrbL);
+                phase1 = bra.annihilate(jOrbL);
             } else { // A': j' i'
                 // static_assert(Type == 1);
-                applResult = SCIFockDeterminant::applyCreator(closedKet, iOrbL);
+                phase1 = bra.create(iOrbL);
             }
-            const auto &phase1 = applResult.first;
-            const auto &closedKet2 = applResult.second;
-            // const auto &[phase1, closedKet2] = applResult;
             if (phase1 != 0) {
+                int phase2;
                 if /* constexpr */ (Type == 0) { // A: i j
-                    applResult2 =
-                        SCIFockDeterminant::applyAnnihilator(closedKet2, iOrbL);
+                    phase2 = bra.annihilate(iOrbL);
                 } else { // A': j' i'; B: i' j
                     // static_assert(Type == 1 or Type == 2);
-                    applResult2 = SCIFockDeterminant::applyCreator(
-                        closedKet2, Type == 1 ? jOrbL : iOrbL);
+                    phase2 = bra.create(Type == 1 ? jOrbL : iOrbL);
                 }
-                const auto phase2 = applResult2.first;
-                const auto closedBra = applResult2.second;
-                // const auto [phase2, closedBra] = applResult2;
                 if (phase2 != 0) {
                     // Find the determinant
-                    SCIFockDeterminant bra(ket.norbs, closedBra);
                     const auto map_val = fragIndexMap.find(bra);
                     int iD =
                         map_val == fragIndexMap.cend() ? -1 : map_val->second;
@@ -1567,30 +1679,33 @@ void SCIFockBigSite<S, typename S::is_sz_t>::fillOp_AB_impl(const S &deltaQN,
                                   numSparseB, numDenseB, usedMemB);
         }
     }
-    if (nonZeros == 0) {
-        sci_detail::setMatrixToZero(mat);
-    }
-    if /* constexpr */ (Type == 0) {
-        timeA += clock.get_time();
-        qnCountsA += qnSiz;
-        totCountsA += 1;
-        if (nonZeros == 0) {
-            numZeroA++;
-        }
-    } else if /* constexpr */ (Type == 1) {
-        timeAD += clock.get_time();
-        qnCountsAD += qnSiz;
-        totCountsAD += 1;
+#pragma omp critical(sci_fock_stats)
+    {
         if (nonZeros == 0) {
-            numZeroAD++;
+            sci_detail::setMatrixToZero(mat);
         }
-    } else {
-        // static_assert(Type == 2);
-        timeB += clock.get_time();
-        qnCountsB += qnSiz;
-        totCountsB += 1;
-        if (nonZeros == 0) {
-            numZeroB++;
+        if /* constexpr */ (Type == 0) {
+            timeA += clock.get_time();
+            qnCountsA += qnSiz;
+            totCountsA += 1;
+            if (nonZeros == 0) {
+                numZeroA++;
+            }
+        } else if /* constexpr */ (Type == 1) {
+            timeAD += clock.get_time();
+            qnCountsAD += qnSiz;
+            totCountsAD += 1;
+            if (nonZeros == 0) {
+                numZeroAD++;
+            }
+        } else {
+            // static_assert(Type == 2);
+            timeB += clock.get_time();
+            qnCountsB += qnSiz;
+            totCountsB += 1;
+            if (nonZeros == 0) {
+                numZeroB++;
+            }
         }
     }
 }
@@ -1753,21 +1868,24 @@ void SCIFockBigSite<S, typename S::is_sz_t>::fillOp_P_impl(
             }
         }
     }
-    for (int xx = 0; xx < entrySize; ++xx) {
-        if (nonZeros[xx] == 0) {
-            auto &mat = entries[xx].mat;
-            sci_detail::setMatrixToZero(mat);
-            Dagger ? numZeroPD += 1 : numZeroP += 1;
+#pragma omp critical(sci_fock_stats)
+    {
+        for (int xx = 0; xx < entrySize; ++xx) {
+            if (nonZeros[xx] == 0) {
+                auto &mat = entries[xx].mat;
+                sci_detail::setMatrixToZero(mat);
+                Dagger ? numZeroPD += 1 : numZeroP += 1;
+            }
+        }
+        if /* constexpr */ (Dagger) {
+            timePD += clock.get_time();
+            qnCountsPD += qnSiz * entrySize;
+            totCountsPD += 1;
+        } else {
+            timeP += clock.get_time();
+            qnCountsP += qnSiz * entrySize;
+            totCountsP += 1;
         }
-    }
-    if /* constexpr */ (Dagger) {
-        timePD += clock.get_time();
-        qnCountsPD += qnSiz * entrySize;
-        totCountsPD += 1;
-    } else {
-        timeP += clock.get_time();
-        qnCountsP += qnSiz * entrySize;
-        totCountsP += 1;
     }
     if (doAllocateEmptyMats()) {
         sci_detail::allocateEmptyMatrices<S>(entries);
@@ -1901,16 +2019,19 @@ void SCIFockBigSite<S, typename S::is_sz_t>::fillOp_Q(
                 numSparseQ, numDenseQ, usedMemQ);
         }
     }
-    for (int xx = 0; xx < entrySize; ++xx) {
-        if (nonZeros[xx] == 0) {
-            auto &mat = entries[xx].mat;
-            sci_detail::setMatrixToZero(mat);
-            numZeroQ += 1;
+#pragma omp critical(sci_fock_stats)
+    {
+        for (int xx = 0; xx < entrySize; ++xx) {
+            if (nonZeros[xx] == 0) {
+                auto &mat = entries[xx].mat;
+                sci_detail::setMatrixToZero(mat);
+                numZeroQ += 1;
+            }
         }
+        timeQ += clock.get_time();
+        qnCountsQ += qnSiz * entrySize;
+        totCountsQ += 1;
     }
-    timeQ += clock.get_time();
-    qnCountsQ += qnSiz * entrySize;
-    totCountsQ += 1;
     if (doAllocateEmptyMats()) {
         sci_detail::allocateEmptyMatrices<S>(entries);
     }
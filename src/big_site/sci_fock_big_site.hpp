@@ -329,7 +329,9 @@ struct SCIFockBigSite<S, typename S::is_sz_t> : public BigSite<S> {
 
     int getThreadID() const {
 #ifdef _OPENMP
-        return omp_get_thread_num();
+        // with ompThreads == 1, whole operators are built on different
+        // threads (see get_site_ops) and the loops within them are serial
+        return ompThreads == 1 ? 0 : omp_get_thread_num();
 #else
         return 0;
 #endif
@@ -47,10 +47,14 @@ static_assert(fragmentDetLen % 2 == 0 and fragmentDetLen > 0,
               "fragmentDetLen must be even!");
 
 inline int BitCount(long x) {
+#ifdef __GNUC__
+    return __builtin_popcountl((unsigned long)x);
+#else
     x = (x & 0x5555555555555555ULL) + ((x >> 1) & 0x5555555555555555ULL);
     x = (x & 0x3333333333333333ULL) + ((x >> 2) & 0x3333333333333333ULL);
     x = (x & 0x0F0F0F0F0F0F0F0FULL) + ((x >> 4) & 0x0F0F0F0F0F0F0F0FULL);
     return (x * 0x0101010101010101ULL) >> 56;
+#endif
 
     // unsigned int u2=u>>32, u1=u;
 
@@ -163,19 +167,16 @@ struct SCIFockDeterminant {
     }
 
     std::size_t getHash() const noexcept {
-        // This is what is used in boost/container_hash/hash.hpp hash_combine;
-        // see also https://stackoverflow.com/a/27216842
-        // TODO: All info is in repr. So why do I hash norbs etc?
-        auto seed = (std::size_t)(norbs);
-        seed ^=
-            (std::size_t)(nAlphaEl) + 0x9e3779b9 + (seed << 6) + (seed >> 2);
-        seed ^= (std::size_t)(nBetaEl) + 0x9e3779b9 + (seed << 6) + (seed >> 2);
+        // All info is in repr (the electron numbers follow from it), so only
+        // the used words are mixed, one multiply-xorshift step per word.
         // I want to avoid computing and storing the lexical order for all the
         // different determinant types (nel, norb)
+        uint64_t seed = 0x9e3779b97f4a7c15ULL;
         for (int i = 0; i < EffDetLen; i++) {
-            seed ^= repr[i] + 0x9e3779b9 + (seed << 6) + (seed >> 2);
+            seed = (seed ^ (uint64_t)repr[i]) * 0xff51afd7ed558ccdULL;
+            seed ^= seed >> 32;
         }
-        return seed;
+        return (std::size_t)seed;
     }
 
     /** Number of electrons this determinant represents. */
@@ -282,6 +283,103 @@ struct SCIFockDeterminant {
     }
     void parity(const int start, const int end, double &parity) const;
 
+    /** Number of occupied orbitals with index smaller than i. */
+    int nOccupiedBelow(const int i) const {
+        constexpr long one = 1;
+        int n = 0;
+        for (int k = 0; k < i / 64; ++k) {
+            n += sci_detail::BitCount(repr[k]);
+        }
+        const long mask = (one << (i % 64)) - one;
+        return n + sci_detail::BitCount(repr[i / 64] & mask);
+    }
+    /** Apply creator operator on orbital iOrb in place.
+     *
+     * @return Phase (same as applyCreator). If phase is 0, the result is 0
+     * and the determinant is unchanged.
+     */
+    int create(const int iOrb) {
+        if (getocc(iOrb)) {
+            return 0; // Go to Fermi Hell
+        }
+        const int phase = nOccupiedBelow(iOrb) % 2 == 0 ? 1 : -1;
+        setocc(iOrb, true);
+        (iOrb % 2 == 0 ? nAlphaEl : nBetaEl) += 1;
+        return phase;
+    }
+    /** Apply annihilation operator on orbital iOrb in place.
+     *
+     * @return Phase (same as applyAnnihilator). If phase is 0, the result is
+     * 0 and the determinant is unchanged.
+     */
+    int annihilate(const int iOrb) {
+        if (not getocc(iOrb)) {
+            return 0; // Go to Fermi Hell
+        }
+        const int phase = nOccupiedBelow(iOrb) % 2 == 0 ? 1 : -1;
+        setocc(iOrb, false);
+        (iOrb % 2 == 0 ? nAlphaEl : nBetaEl) -= 1;
+        return phase;
+    }
+    /** Number of spin-conserving single and double excitations. */
+    std::size_t nExcitations() const {
+        const std::size_t na = nAlphaEl, nb = nBetaEl;
+        const std::size_t va = norbs / 2 - na, vb = norbs / 2 - nb;
+        const auto pairs = [](std::size_t n) { return n * (n - (n != 0)) / 2; };
+        return na * va + nb * vb + pairs(na) * pairs(va) +
+               pairs(nb) * pairs(vb) + na * va * nb * vb;
+    }
+    /** Call f(bra, cre, des, nExc) for all spin-conserving single (nExc ==
+     * 1) and double (nExc == 2) excitations bra of this determinant. cre
+     * (occupied in bra only) and des (occupied in this only) are sorted, as
+     * in the comparison of bra with this determinant. */
+    template <typename F> void forEachExcitation(F &&f) const {
+        std::vector<int> occ = getClosed(), vir;
+        vir.reserve(norbs - occ.size());
+        for (int i = 0; i < norbs; ++i) {
+            if (not getocc(i)) {
+                vir.push_back(i);
+            }
+        }
+        SCIFockDeterminant bra = *this;
+        int cre[2], des[2];
+        for (const int i : occ) {
+            bra.setocc(i, false);
+            des[0] = i;
+            for (const int a : vir) {
+                if ((i ^ a) & 1) {
+                    continue; // spin flip
+                }
+                bra.setocc(a, true);
+                cre[0] = a;
+                f(bra, cre, des, 1);
+                bra.setocc(a, false);
+            }
+            bra.setocc(i, true);
+        }
+        for (size_t ii = 0; ii < occ.size(); ++ii) {
+            bra.setocc(des[0] = occ[ii], false);
+            for (size_t jj = ii + 1; jj < occ.size(); ++jj) {
+                bra.setocc(des[1] = occ[jj], false);
+                const int nbDes = (des[0] & 1) + (des[1] & 1);
+                for (size_t aa = 0; aa < vir.size(); ++aa) {
+                    bra.setocc(cre[0] = vir[aa], true);
+                    for (size_t bb = aa + 1; bb < vir.size(); ++bb) {
+                        if ((cre[0] & 1) + (vir[bb] & 1) != nbDes) {
+                            continue; // spin flip
+                        }
+                        bra.setocc(cre[1] = vir[bb], true);
+                        f(bra, cre, des, 2);
+                        bra.setocc(cre[1], false);
+                    }
+                    bra.setocc(cre[0], false);
+                }
+                bra.setocc(des[1], true);
+            }
+            bra.setocc(des[0], true);
+        }
+    }
+
     /** The represenation where each index represents an orbital. */
     std::vector<short> getRepArrayVec() const {
         std::vector<short> repArray(norbs);
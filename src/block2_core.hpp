@@ -26,6 +26,7 @@
 #include "core/batch_gemm.hpp"
 #include "core/cg.hpp"
 #include "core/complex_matrix_functions.hpp"
+#include "core/compressed_stream.hpp"
 #include "core/csr_matrix.hpp"
 #include "core/csr_matrix_functions.hpp"
 #include "core/csr_operator_functions.hpp"
@@ -39,6 +40,7 @@
 #include "core/hubbard.hpp"
 #include "core/integral.hpp"
 #include "core/integral_compressed.hpp"
+#include "core/integral_df.hpp"
 #include "core/integral_dyall.hpp"
 #include "core/matching.hpp"
 #include "core/matrix.hpp"
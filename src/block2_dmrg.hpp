@@ -23,11 +23,13 @@
 #include "dmrg/archived_mpo.hpp"
 #include "dmrg/determinant.hpp"
 #include "dmrg/effective_hamiltonian.hpp"
+#include "dmrg/general_mpo.hpp"
 #include "dmrg/moving_environment.hpp"
 #include "dmrg/mpo.hpp"
 #include "dmrg/mpo_fusing.hpp"
 #include "dmrg/mpo_simplification.hpp"
 #include "dmrg/mps.hpp"
+#include "dmrg/mps_trajectory.hpp"
 #include "dmrg/mps_unfused.hpp"
 #include "dmrg/orbital_ordering.hpp"
 #include "dmrg/parallel_mpo.hpp"
@@ -40,6 +42,7 @@
 #include "dmrg/qc_parallel_rule.hpp"
 #include "dmrg/qc_pdm1.hpp"
 #include "dmrg/qc_pdm2.hpp"
+#include "dmrg/qc_pdm3.hpp"
 #include "dmrg/qc_rule.hpp"
 #include "dmrg/qc_sum_mpo.hpp"
 #include "dmrg/state_averaged.hpp"
@@ -22,3 +22,4 @@
 
 #include "ic/wick.hpp"
 #include "ic/nd_array.hpp"
+#include "ic/wick_kernel.hpp"
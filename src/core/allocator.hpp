@@ -25,12 +25,19 @@
 
 #include "fp_codec.hpp"
 #include "utils.hpp"
+#ifdef _OPENMP
+#include "omp.h"
+#endif
 #ifdef _HAS_TBB
 #include "tbb/scalable_allocator.h"
 #endif
 #include <algorithm>
 #ifdef __unix__
 #include <execinfo.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 #endif
 #include <cassert>
 #include <cstdint>
@@ -39,8 +46,11 @@
 #include <functional>
 #include <future>
 #include <iostream>
+#include <list>
+#include <map>
 #include <memory>
 #include <string>
+#include <tuple>
 #include <vector>
 
 using namespace std;
@@ -93,6 +103,298 @@ template <typename T> struct Allocator {
     virtual shared_ptr<Allocator<T>> copy() const { return nullptr; }
 };
 
+/** Per-tag statistics of stack memory usage, for attributing stack memory
+ * to different parts of an algorithm. Shared by all stacks of a data frame.
+ * Optionally, a timeline of the used memory is recorded.
+ */
+struct StackMemoryTags {
+    /** One point of the memory timeline, taken after an allocation or
+     * deallocation. */
+    struct Sample {
+        double time;  //!< Time (in seconds) since the timeline started.
+        int stack;    //!< Index of the stack (as in
+                      //!< ``DataFrame::peak_used_memory``).
+        size_t used,  //!< Used memory (in Bytes) of the stack.
+            total;    //!< Used memory (in Bytes) of all stacks.
+        int tag,      //!< Tag (phase) of the event.
+            site;     //!< Site of the event (-1 if not in a sweep).
+    };
+    vector<string> names; //!< Name of each tag. Tag 0 is for allocations
+                          //!< made outside any tagged scope.
+    vector<size_t> used,  //!< Current used memory (in Bytes) for each tag.
+        peak;             //!< Peak used memory (in Bytes) for each tag.
+    int current = 0;      //!< Tag for new allocations.
+    int site = -1; //!< Current site, set by sweep algorithms for the timeline.
+    size_t total = 0; //!< Current used memory (in Bytes) of all tags.
+    size_t timeline_stride =
+        0; //!< If zero, no timeline is recorded. Otherwise every
+           //!< ``timeline_stride``-th event is recorded in ``timeline``
+           //!< (the peak of total memory is always kept in ``peak_sample``).
+    size_t n_events = 0;    //!< Number of events since the timeline started.
+    vector<Sample> timeline; //!< Recorded samples.
+    Sample peak_sample; //!< The event where total used memory is maximal.
+    vector<size_t> peak_used; //!< Used memory of each tag at ``peak_sample``.
+    chrono::steady_clock::time_point t0; //!< Start time of the timeline.
+    /** Default constructor. */
+    StackMemoryTags() : names{"other"}, used(1, 0), peak(1, 0) {
+        start_timeline(0);
+    }
+    /** Find a tag by name, creating it if it is not registered.
+     * @param name Name of the tag.
+     * @return The index of the tag.
+     */
+    int get(const string &name) {
+        for (size_t i = 0; i < names.size(); i++)
+            if (names[i] == name)
+                return (int)i;
+        names.push_back(name);
+        used.push_back(0);
+        peak.push_back(0);
+        return (int)names.size() - 1;
+    }
+    /** Record a change in memory usage of one tag.
+     * @param tag The index of the tag.
+     * @param n_bytes Number of bytes added.
+     * @param add If false, the memory is released.
+     */
+    void update(int tag, size_t n_bytes, bool add) {
+        if (add) {
+            peak[tag] = max(peak[tag], used[tag] += n_bytes);
+            total += n_bytes;
+        } else {
+            n_bytes = min(used[tag], n_bytes);
+            used[tag] -= n_bytes, total -= n_bytes;
+        }
+    }
+    /** Reset peak statistics to the current usage. */
+    void reset_peak() {
+        peak = used;
+        peak_sample.total = 0;
+    }
+    /** Clear the timeline and start recording.
+     * @param stride Record every ``stride``-th event (0 for no recording,
+     * 1 for all events).
+     */
+    void start_timeline(size_t stride = 1) {
+        timeline_stride = stride, n_events = 0;
+        timeline.clear();
+        peak_sample = Sample{0, -1, 0, 0, 0, -1};
+        peak_used.clear();
+        t0 = chrono::steady_clock::now();
+    }
+    /** Record the memory usage after an event of one stack.
+     * @param stack The index of the stack.
+     * @param stack_used Used memory (in Bytes) of the stack.
+     */
+    void record(int stack, size_t stack_used) {
+        if (timeline_stride == 0)
+            return;
+        const double t =
+            chrono::duration<double>(chrono::steady_clock::now() - t0).count();
+        const Sample sp = {t, stack, stack_used, total, current, site};
+        if (total > peak_sample.total)
+            peak_sample = sp, peak_used = used;
+        if (n_events++ % timeline_stride == 0)
+            timeline.push_back(sp);
+    }
+    /** Write the timeline as CSV (one line per sample).
+     * @param os The output stream.
+     */
+    void write_timeline(ostream &os) const {
+        os << "time,stack,used,total,tag,site" << endl;
+        for (auto &sp : timeline)
+            os << fixed << setprecision(6) << sp.time << "," << sp.stack
+               << "," << sp.used << "," << sp.total << "," << names[sp.tag]
+               << "," << sp.site << endl;
+    }
+    /** Report the site and phase (tag) where the peak of total used memory
+     * was reached, and the memory of each tag at that point.
+     * @return The report.
+     */
+    string peak_report() const {
+        stringstream ss;
+        ss << " | Peak = " << Parsing::to_size_string(peak_sample.total)
+           << " at T = " << fixed << setprecision(3) << peak_sample.time
+           << " | Site = " << peak_sample.site
+           << " | Tag = " << names[peak_sample.tag]
+           << " | Stack = " << peak_sample.stack;
+        for (size_t i = 0; i < peak_used.size(); i++)
+            if (peak_used[i] != 0)
+                ss << " | Mem[" << names[i]
+                   << "] = " << Parsing::to_size_string(peak_used[i]);
+        return ss.str();
+    }
+    /** Print the current and peak used memory of each tag.
+     * @param os The output stream.
+     * @param c The object to be printed.
+     * @return The output stream.
+     */
+    friend ostream &operator<<(ostream &os, const StackMemoryTags &c) {
+        for (size_t i = 0; i < c.names.size(); i++)
+            os << " | Mem[" << c.names[i]
+               << "] = " << Parsing::to_size_string(c.used[i]) << " / "
+               << Parsing::to_size_string(c.peak[i]);
+        return os;
+    }
+};
+
+/** Types of scratch files, for I/O statistics. */
+enum struct ScratchFileTypes : uint8_t {
+    Left,  //!< Left environments (renormalized operators).
+    Right, //!< Right environments (renormalized operators).
+    MPS,   //!< MPS tensors and MPS infos.
+    Other, //!< Other files.
+    Count
+};
+
+/** Size, bandwidth and latency statistics of scratch file I/O, per file and
+ * per file type. Only synchronous transfers between memory and disk are
+ * recorded (not hits in buffers or async saving). A warning is printed when
+ * the bandwidth of a large transfer falls below a threshold, so that jobs
+ * starved by a slow file system can be detected.
+ */
+struct IOMonitor {
+    /** Statistics of reading or writing. */
+    struct Stats {
+        size_t count = 0,   //!< Number of transfers.
+            bytes = 0,      //!< Total size (in Bytes).
+            n_slow = 0;     //!< Number of transfers below the threshold.
+        double time = 0,    //!< Total time (in seconds).
+            max_time = 0;   //!< Max latency of one transfer (in seconds).
+        /** Record one transfer.
+         * @param n_bytes Size of the transfer (in Bytes).
+         * @param t Time of the transfer (in seconds).
+         * @param slow Whether the transfer is below the threshold.
+         */
+        void add(size_t n_bytes, double t, bool slow) {
+            count++, bytes += n_bytes, n_slow += slow;
+            time += t, max_time = max(max_time, t);
+        }
+        /** Average bandwidth (in Bytes per second). */
+        double bandwidth() const { return time == 0 ? 0 : bytes / time; }
+    };
+    static const int n_types = (int)ScratchFileTypes::Count;
+    double min_bandwidth; //!< Threshold of bandwidth (in Bytes per second)
+                          //!< for warnings (0 for no warnings).
+    size_t min_bytes = 1 << 20; //!< Smaller transfers (dominated by latency)
+                                //!< are not checked against the threshold.
+    int max_warnings = 10; //!< Max number of printed warnings.
+    int n_warnings = 0;    //!< Number of printed warnings.
+    Stats stats[n_types][2]; //!< Statistics of each type (second index is
+                             //!< 0 for reading and 1 for writing).
+    map<string, pair<Stats, Stats>> files; //!< Statistics of reading and
+                                           //!< writing for each file.
+    mutex mtx; //!< Lock for recording from multiple threads.
+    /** Constructor.
+     * @param min_bandwidth Threshold of bandwidth (in Bytes per second) for
+     * warnings (0 for no warnings).
+     */
+    IOMonitor(double min_bandwidth = 0) : min_bandwidth(min_bandwidth) {}
+    /** Name of a file type.
+     * @param t The file type.
+     * @return The name.
+     */
+    static const char *name(ScratchFileTypes t) {
+        static const char *names[] = {"left", "right", "mps", "other"};
+        return names[(int)t];
+    }
+    /** Type of a scratch file, from its filename.
+     * @param filename The filename.
+     * @return The file type.
+     */
+    static ScratchFileTypes file_type(const string &filename) {
+        const string fn = filename.substr(filename.find_last_of('/') + 1);
+        if (fn.find(".MPS.") != string::npos)
+            return ScratchFileTypes::MPS;
+        else if (fn.find(".LEFT.") != string::npos)
+            return ScratchFileTypes::Left;
+        else if (fn.find(".RIGHT.") != string::npos)
+            return ScratchFileTypes::Right;
+        else
+            return ScratchFileTypes::Other;
+    }
+    /** Record one transfer.
+     * @param filename The filename.
+     * @param write Whether the file is written (or read).
+     * @param n_bytes Size of the transfer (in Bytes).
+     * @param t Time of the transfer (in seconds).
+     */
+    void record(const string &filename, bool write, size_t n_bytes,
+                double t) {
+        const bool slow = min_bandwidth != 0 && n_bytes >= min_bytes &&
+                          n_bytes < min_bandwidth * t;
+        lock_guard<mutex> lock(mtx);
+        stats[(int)file_type(filename)][write].add(n_bytes, t, slow);
+        pair<Stats, Stats> &f = files[filename];
+        (write ? f.second : f.first).add(n_bytes, t, slow);
+        if (slow && n_warnings < max_warnings) {
+            stringstream ss;
+            ss << "warning: slow scratch " << (write ? "write" : "read")
+               << " of '" << filename
+               << "': " << Parsing::to_size_string(n_bytes) << " in "
+               << scientific << setprecision(2) << t << " s ("
+               << Parsing::to_size_string((size_t)(n_bytes / t)) << "/s < "
+               << Parsing::to_size_string((size_t)min_bandwidth) << "/s)";
+            if (++n_warnings == max_warnings)
+                ss << endl
+                   << "warning: further slow scratch I/O warnings are "
+                      "suppressed.";
+            cout << ss.str() << endl;
+        }
+    }
+    /** Clear the statistics of each type (statistics of files are kept). */
+    void reset() {
+        for (int i = 0; i < n_types; i++)
+            stats[i][0] = stats[i][1] = Stats();
+    }
+    /** Clear all statistics. */
+    void clear() {
+        reset();
+        files.clear();
+        n_warnings = 0;
+    }
+    /** Report the statistics of each type with non-zero transfers: number
+     * of transfers, size, average bandwidth, average and max latency, and
+     * number of slow transfers.
+     * @return The report.
+     */
+    string report() const {
+        stringstream ss;
+        for (int i = 0; i < n_types; i++)
+            for (int w = 0; w < 2; w++) {
+                const Stats &x = stats[i][w];
+                if (x.count == 0)
+                    continue;
+                ss << " | IO[" << name((ScratchFileTypes)i) << "."
+                   << (w ? "write" : "read") << "] n = " << x.count
+                   << " | size = " << Parsing::to_size_string(x.bytes)
+                   << " | BW = "
+                   << Parsing::to_size_string((size_t)x.bandwidth()) << "/s"
+                   << " | Tavg = " << scientific << setprecision(2)
+                   << x.time / x.count << " | Tmax = " << x.max_time
+                   << " | slow = " << x.n_slow << endl;
+            }
+        return ss.str();
+    }
+    /** Write the statistics of each file as CSV (one line per file).
+     * @param os The output stream.
+     */
+    void write_csv(ostream &os) const {
+        os << "file,type,n_read,read_bytes,read_time,n_write,write_bytes,"
+              "write_time,max_time,n_slow"
+           << endl;
+        for (auto &f : files)
+            os << f.first << "," << name(file_type(f.first)) << ","
+               << f.second.first.count << "," << f.second.first.bytes << ","
+               << fixed << setprecision(6) << f.second.first.time << ","
+               << f.second.second.count << "," << f.second.second.bytes << ","
+               << f.second.second.time << ","
+               << max(f.second.first.max_time, f.second.second.max_time)
+               << "," << f.second.first.n_slow + f.second.second.n_slow
+               << endl;
+    }
+};
+
 /** Stack memory allocator.
  * @tparam T The type of the element in the array. */
 template <typename T> struct StackAllocator : Allocator<T> {
@@ -100,7 +402,16 @@ template <typename T> struct StackAllocator : Allocator<T> {
         used,    //!< Occupied size of the stack (in number of elements).
         shift; //!< Temporary shift introduced due to deallocation in the middle
                //!< of the stack.
-    T *data;   //!< Pointer to the first elemenet in the stack.
+    size_t align = 1; //!< Each allocation is rounded up to a multiple of
+                      //!< this number of elements (must be a power of two).
+    T *data;          //!< Pointer to the first elemenet in the stack.
+    shared_ptr<StackMemoryTags> tags =
+        nullptr; //!< Tag statistics for memory attribution. If nullptr,
+                 //!< allocations are not attributed.
+    vector<pair<int, pair<size_t, size_t>>>
+        tag_blocks; //!< Tag, start and number of elements of each attributed
+                    //!< live block in the stack.
+    int tag_stack = 0; //!< Index of this stack in the memory timeline.
     /** Constructor.
      * @param ptr Pointer to the first elemenet in the stack. The stack should
      * be pre-allocated.
@@ -110,20 +421,57 @@ template <typename T> struct StackAllocator : Allocator<T> {
         : size(max_size), used(0), shift(0), data(ptr) {}
     /** Default constructor. */
     StackAllocator() : size(0), used(0), shift(0), data(0) {}
+    /** Size of an allocation after rounding for alignment.
+     * @param n Number of elements in the array.
+     * @return Number of elements actually occupied in the stack.
+     */
+    size_t aligned_size(size_t n) const {
+        return (n + align - 1) & ~(align - 1);
+    }
+    /** Attribute a block in the stack to the current tag.
+     * @param start Index of the first element of the block.
+     * @param n Number of elements in the block.
+     */
+    void tag_block(size_t start, size_t n) {
+        if (n == 0)
+            return;
+        tag_blocks.push_back(make_pair(tags->current, make_pair(start, n)));
+        tags->update(tags->current, n * sizeof(T), true);
+    }
+    /** Release the attribution of all blocks no longer in the used part of
+     * the stack. */
+    void untag_unused() {
+        while (!tag_blocks.empty() && tag_blocks.back().second.first >= used) {
+            tags->update(tag_blocks.back().first,
+                         tag_blocks.back().second.second * sizeof(T), false);
+            tag_blocks.pop_back();
+        }
+    }
+    /** Record the used memory in the timeline of tags (if enabled). */
+    void record_usage() const {
+        if (tags != nullptr)
+            tags->record(tag_stack, used * sizeof(T));
+    }
     /** Allocate a length n array.
      * @param n Number of elements in the array.
      * @return The allocated pointer.
      */
     T *allocate(size_t n) override {
         assert(shift == 0);
+        n = aligned_size(n);
         if (used + n >= size) {
             cout << "exceeding allowed memory"
                  << " (size=" << size << ", trying to allocate " << n << ") "
                  << (sizeof(T) == 4 ? " (uint32)" : " (double)") << endl;
             print_trace();
             return 0;
-        } else
-            return data + (used += n) - n;
+        }
+        if (tags != nullptr) {
+            tag_block(used, n), used += n;
+            record_usage();
+            return data + used - n;
+        }
+        return data + (used += n) - n;
     }
     /** Deallocate a length n array.
      * Must be invoked in the reverse order of allocation.
@@ -133,11 +481,14 @@ template <typename T> struct StackAllocator : Allocator<T> {
     void deallocate(void *ptr, size_t n) override {
         if (n == 0)
             return;
+        n = aligned_size(n);
         if (used < n || ptr != data + used - n) {
             cout << "deallocation not happening in reverse order" << endl;
             print_trace();
         } else
             used -= n;
+        if (tags != nullptr)
+            untag_unused(), record_usage();
     }
     /** Change the allocated size in middle of stack memory
      * and introduce a shift for moving memory after it.
@@ -147,11 +498,23 @@ template <typename T> struct StackAllocator : Allocator<T> {
      * @return The new pointer.
      */
     T *reallocate(T *ptr, size_t n, size_t new_n) override {
+        n = aligned_size(n), new_n = aligned_size(new_n);
+        if (tags != nullptr)
+            for (auto it = tag_blocks.rbegin(); it != tag_blocks.rend(); ++it)
+                if (it->second.first == (size_t)(ptr - data) &&
+                    it->second.second == n) {
+                    tags->update(it->first, n * sizeof(T), false);
+                    tags->update(it->first, new_n * sizeof(T), true);
+                    it->second = make_pair(it->second.first + shift, new_n);
+                    break;
+                }
         ptr += shift;
         shift += new_n - n;
         used = used + new_n - n;
         if (ptr == data + used - new_n)
             shift = 0;
+        if (tags != nullptr)
+            record_usage();
         return (T *)ptr;
     }
     /** Print the status of the allocator.
@@ -284,6 +647,18 @@ struct DataFrame {
     string restart_dir_optimal_mps_per_sweep =
         ""; //!< If not empty, save the optimal MPS from each sweep to this dir
             //!< with sweep index as suffix.
+    string restart_dir_site =
+        ""; //!< If not empty, save MPS, environments and sweep state to this
+            //!< dir during DMRG sweeps (every ``restart_site_interval``
+            //!< sites), so that an interrupted sweep can be resumed at that
+            //!< site.
+    int restart_site_interval = 1; //!< Number of sites between two
+                                   //!< checkpoints in ``restart_dir_site``.
+    bool restart_site_distributed =
+        false; //!< Whether environments in ``restart_dir_site`` are saved
+               //!< as one file per block with operators from all procs, so
+               //!< that the sweep can be resumed with a different number of
+               //!< procs.
     string prefix = "F", //!< Filename prefix for common scratch files (such as
                          //!< MPS tensors).
         prefix_distri =
@@ -329,11 +704,38 @@ struct DataFrame {
     //!< Buffers for Async saving.
     mutable vector<shared_future<void>> save_futures;
     //!< Async saving files.
+    mutable vector<
+        vector<pair<string, shared_future<shared_ptr<stringstream>>>>>
+        prefetch_futures;
+    //!< Async reading files (for each data frame) which will be loaded soon.
     bool load_buffering = false, //!< Whether load buffering should be used. If
                                  //!< true, memory usage will increase.
         save_buffering =
             false; //!< Whether async saving and saving buffering should be
                    //!< used. If true, memory usage will increase.
+    bool prefetch_buffering =
+        false; //!< Whether scratch files that will be loaded soon should be
+               //!< read into memory asynchronously. If true, memory usage will
+               //!< increase.
+    int max_prefetch = 2; //!< Max number of prefetched files for each frame.
+    bool async_mps_save =
+        false; //!< Whether MPS tensors and MPS state infos written during
+               //!< sweeps should be saved to disk by helper threads, so that
+               //!< the writing overlaps with the next site. If true, memory
+               //!< usage will increase.
+    mutable vector<pair<string, shared_future<void>>> mps_save_futures;
+    //!< Async saving of MPS files (in the order of submission).
+    shared_ptr<StackMemoryTags> mem_tags =
+        nullptr; //!< Per-tag stack memory statistics. Only available after
+                 //!< ``track_memory_tags`` is invoked.
+    shared_ptr<IOMonitor> io_monitor =
+        nullptr; //!< Scratch file I/O statistics. Only available after
+                 //!< ``monitor_io`` is invoked.
+    bool thread_arenas =
+        false; //!< Whether temporary matrices in operator-level parallel tasks
+               //!< should be allocated from per-thread stacks carved from the
+               //!< unused part of the secondary double stack. If false (or if
+               //!< there is not enough space), the heap is used.
     bool use_main_stack =
         true; //!< Whether main stack should be used for storing blocked
               //!< operators in enlarged blocks. If false, these blocked
@@ -345,6 +747,49 @@ struct DataFrame {
     shared_ptr<FPCodec<double>> fp_codec =
         nullptr; //!< Floating-point compression codec. If nullptr,
                  //!< floating-point compression will not be used.
+    bool mmap_scratch =
+        false; //!< Whether scratch files should be written in a page-aligned
+               //!< layout and loaded by mapping the file directly into the
+               //!< double stack (zero-copy, copy-on-write). Only effective on
+               //!< unix systems and when fp_codec is nullptr. Should be set
+               //!< before any scratch files are written.
+    bool zero_copy_save =
+        false; //!< Whether scratch files should be written directly from the
+               //!< stack memory, without copying the data frame into a
+               //!< buffer stream. With save_buffering, the writing is async
+               //!< and reset / load_data on that data frame will wait for it.
+               //!< The data frame must not be changed in other ways before
+               //!< that. Only effective on unix systems and when fp_codec is
+               //!< nullptr and ram_cache_size is zero.
+    bool direct_io =
+        false; //!< Whether zero-copy saving should bypass the page cache
+               //!< (O_DIRECT). Only effective with mmap_scratch, where the
+               //!< double data is page-aligned in the file.
+    bool huge_pages = false; //!< Whether the double stacks should be backed by
+                             //!< transparent huge pages. Set by
+                             //!< ``use_huge_pages``.
+    mutable vector<size_t>
+        mapped_sizes; //!< Size (in bytes) of the file mapping currently
+                      //!< attached to the double stack of each data frame.
+    size_t ram_cache_size =
+        0; //!< Max total size (in bytes) of scratch files also kept in memory
+           //!< (the memory tier). Least recently used files are dropped
+           //!< first. If zero, the memory tier will not be used. Not used
+           //!< when mmap_scratch is effective.
+    size_t local_disk_size =
+        0; //!< Max total size (in bytes) of scratch files kept in save_dir
+           //!< (the local disk tier). Least recently used files are moved to
+           //!< spill_dir, leaving a symbolic link in save_dir. If zero or
+           //!< spill_dir is empty, there is no limit.
+    string spill_dir = ""; //!< Scratch folder (usually in a shared filesystem)
+                           //!< for files spilled from save_dir.
+    mutable list<tuple<string, shared_ptr<stringstream>, size_t>>
+        ram_cache; //!< Files in the memory tier (most recently used first).
+    mutable list<pair<string, size_t>>
+        local_files; //!< Files in the local disk tier (most recently used
+                     //!< first). Only tracked when local_disk_size is used.
+    mutable size_t ram_cache_used = 0, //!< Current size of the memory tier.
+        local_disk_used = 0; //!< Current size of the local disk tier.
     // isize and dsize are in Bytes
     /** Constructor.
      * @param isize Max size (in bytes) of all integer stacks.
@@ -365,13 +810,18 @@ struct DataFrame {
         load_buffers.resize(n_frames);
         save_buffers.resize(n_frames);
         save_futures.resize(n_frames);
+        prefetch_futures.resize(n_frames);
+        mapped_sizes.resize(n_frames);
         this->isize = isize >> 2;
         this->dsize = dsize >> 3;
+        // double stack frames are page-aligned so that scratch files
+        // can be mapped onto them
+        const size_t dpage = page_size() / sizeof(double);
         size_t imain = (size_t)(imain_ratio * this->isize);
-        size_t dmain = (size_t)(dmain_ratio * this->dsize);
+        size_t dmain = (size_t)(dmain_ratio * this->dsize) / dpage * dpage;
         size_t ir = (this->isize - imain) / (n_frames - 1);
-        size_t dr = (this->dsize - dmain) / (n_frames - 1);
-        double *dptr = new double[this->dsize];
+        size_t dr = (this->dsize - dmain) / (n_frames - 1) / dpage * dpage;
+        double *dptr = allocate_stack(this->dsize);
         uint32_t *iptr = new uint32_t[this->isize];
         iallocs.push_back(make_shared<StackAllocator<uint32_t>>(iptr, imain));
         dallocs.push_back(make_shared<StackAllocator<double>>(dptr, dmain));
@@ -402,9 +852,284 @@ struct DataFrame {
      * @param i The index of the data frame to be reset.
      */
     void reset(int i) {
+        wait_save_direct(i);
         iallocs[i]->used = 0;
         dallocs[i]->used = 0;
+        if (mem_tags != nullptr) {
+            iallocs[i]->untag_unused(), dallocs[i]->untag_unused();
+            iallocs[i]->record_usage(), dallocs[i]->record_usage();
+        }
         present_filenames[i] = "";
+        unmap_data(i);
+    }
+    /** Start attributing stack memory to tags. Memory already in the stacks
+     * is attributed to the ``other`` tag. Afterwards, allocations made inside
+     * a ``MemoryTagScope`` (and data loaded to a frame inside the scope) are
+     * attributed to the tag of the scope.
+     */
+    void track_memory_tags() {
+        if (mem_tags != nullptr)
+            return;
+        mem_tags = make_shared<StackMemoryTags>();
+        for (int i = 0; i < n_frames; i++) {
+            iallocs[i]->tags = mem_tags, dallocs[i]->tags = mem_tags;
+            dallocs[i]->tag_stack = i, iallocs[i]->tag_stack = i + n_frames;
+            iallocs[i]->tag_block(0, iallocs[i]->used);
+            dallocs[i]->tag_block(0, dallocs[i]->used);
+        }
+    }
+    /** Start recording the timeline of stack memory usage (time, stack, used
+     * memory, tag and site of allocations and deallocations), which also
+     * starts attributing stack memory to tags.
+     * @param stride Record every ``stride``-th event (1 for all events).
+     * The peak of total used memory is always recorded.
+     */
+    void track_memory_timeline(size_t stride = 1) {
+        track_memory_tags();
+        mem_tags->start_timeline(stride);
+    }
+    /** Start recording size, bandwidth and latency of scratch file I/O.
+     * @param min_bandwidth Threshold of bandwidth (in Bytes per second) for
+     * warnings of slow transfers (0 for no warnings).
+     */
+    void monitor_io(double min_bandwidth = 0) {
+        io_monitor = make_shared<IOMonitor>(min_bandwidth);
+    }
+    /** Record one synchronous transfer of a scratch file (if I/O is
+     * monitored).
+     * @param filename The filename.
+     * @param write Whether the file was written (or read).
+     * @param n_bytes Size of the transfer (in Bytes).
+     * @param t The IO time.
+     * @return The IO time.
+     */
+    double record_io(const string &filename, bool write, size_t n_bytes,
+                     double t) const {
+        if (io_monitor != nullptr)
+            io_monitor->record(filename, write, n_bytes, t);
+        return t;
+    }
+    /** Attribute the whole content of one data frame to the current tag,
+     * after the frame is loaded.
+     * @param i The index of the data frame.
+     */
+    void tag_loaded_data(int i) const {
+        if (mem_tags == nullptr)
+            return;
+        const size_t iused = iallocs[i]->used, dused = dallocs[i]->used;
+        iallocs[i]->used = dallocs[i]->used = 0;
+        iallocs[i]->untag_unused(), dallocs[i]->untag_unused();
+        iallocs[i]->used = iused, dallocs[i]->used = dused;
+        iallocs[i]->tag_block(0, iused), dallocs[i]->tag_block(0, dused);
+        iallocs[i]->record_usage(), dallocs[i]->record_usage();
+    }
+    /** Size of one memory page (in bytes).
+     * @return The page size.
+     */
+    static size_t page_size() {
+#ifdef __unix__
+        static const size_t psz = (size_t)sysconf(_SC_PAGESIZE);
+        return psz;
+#else
+        return 4096;
+#endif
+    }
+    /** Allocate page-aligned memory for the double stacks.
+     * @param n Number of elements.
+     * @return The allocated pointer.
+     */
+    static double *allocate_stack(size_t n) {
+#ifdef __unix__
+        void *ptr = mmap(nullptr, sizeof(double) * n, PROT_READ | PROT_WRITE,
+                         MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (ptr == MAP_FAILED)
+            throw runtime_error("DataFrame::allocate_stack failed.");
+        return (double *)ptr;
+#else
+        return new double[n];
+#endif
+    }
+    /** Deallocate memory allocated by ``allocate_stack``.
+     * @param ptr The allocated pointer.
+     * @param n Number of elements.
+     */
+    static void deallocate_stack(double *ptr, size_t n) {
+#ifdef __unix__
+        munmap(ptr, sizeof(double) * n);
+#else
+        delete[] ptr;
+#endif
+    }
+    /** Back the double stacks with transparent huge pages, reducing TLB
+     * misses in large GEMM. Only effective on linux. Should be called
+     * before the stacks are used (and before ``first_touch``).
+     * @return ``true`` if the kernel accepted the request.
+     */
+    bool use_huge_pages() {
+#if defined(__unix__) && defined(MADV_HUGEPAGE)
+        huge_pages = madvise(dallocs[0]->data, sizeof(double) * dsize,
+                             MADV_HUGEPAGE) == 0;
+#endif
+        return huge_pages;
+    }
+    /** Round every allocation in the double stacks to a multiple of the given
+     * number of bytes, so that all arrays passed to BLAS are aligned (the
+     * stacks themselves are page-aligned). All stacks must be empty.
+     * @param n_bytes The alignment (in bytes). Must be a power of two and a
+     * multiple of ``sizeof(double)``. Use 8 for no alignment.
+     */
+    void set_alignment(size_t n_bytes) {
+        if (n_bytes < sizeof(double) || (n_bytes & (n_bytes - 1)) != 0)
+            throw runtime_error("DataFrame::set_alignment: invalid alignment.");
+        for (int i = 0; i < n_frames; i++) {
+            if (dallocs[i]->used != 0)
+                throw runtime_error(
+                    "DataFrame::set_alignment: stacks are not empty.");
+            dallocs[i]->align = n_bytes / sizeof(double);
+        }
+    }
+    /** Split the unused part of the double stack of one data frame into
+     * stacks of equal size (one for each thread). The returned stacks do not
+     * own the memory and are only valid when no other allocation happens in
+     * that data frame before they are released.
+     * @param i The index of the data frame.
+     * @param n Number of stacks.
+     * @return The stacks, or an empty vector if there is no unused space.
+     */
+    vector<shared_ptr<StackAllocator<double>>> split_free_stack(int i,
+                                                                int n) const {
+        vector<shared_ptr<StackAllocator<double>>> r;
+        if (i >= n_frames)
+            return r;
+        // keep each stack on a separate cache line
+        const size_t cl = 64 / sizeof(double);
+        size_t ist = max(dallocs[i]->used, mapped_sizes[i] / sizeof(double));
+        ist = (ist + cl - 1) / cl * cl;
+        if (ist >= dallocs[i]->size)
+            return r;
+        size_t sz = (dallocs[i]->size - ist) / n / cl * cl;
+        if (sz == 0)
+            return r;
+        for (int k = 0; k < n; k++) {
+            r.push_back(make_shared<StackAllocator<double>>(
+                dallocs[i]->data + ist + k * sz, sz));
+            r.back()->align = dallocs[i]->align;
+        }
+        return r;
+    }
+    /** First-touch the unused pages of all double stacks from a team of
+     * threads, so that the physical pages are placed on the NUMA nodes of
+     * the threads that will later work on them. Each data frame is divided
+     * into contiguous chunks (one chunk per thread, static schedule), so
+     * every frame is spread over all sockets, instead of being placed on the
+     * socket of the first thread writing to it. Should be called after the
+     * threading scheme is set (and threads are bound, for example using
+     * ``OMP_PROC_BIND=spread``) and before the stacks are used. Pages
+     * already holding data (or mapped from scratch files) are not touched.
+     * @param n_threads Number of threads. If zero, the max number of openMP
+     * threads is used.
+     */
+    void first_touch(int n_threads = 0) const {
+#ifdef _OPENMP
+        if (n_threads == 0)
+            n_threads = omp_get_max_threads();
+#endif
+        const size_t dpage = page_size() / sizeof(double);
+        for (int i = 0; i < n_frames; i++) {
+            if (mapped_sizes[i] != 0)
+                continue;
+            size_t ist = (dallocs[i]->used + dpage - 1) / dpage;
+            size_t ied = dallocs[i]->size / dpage;
+            double *ptr = dallocs[i]->data;
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static) num_threads(n_threads)
+#endif
+            for (size_t ip = ist; ip < ied; ip++)
+                memset(ptr + ip * dpage, 0, sizeof(double) * dpage);
+        }
+    }
+    /** Offset (in bytes) of the double stack in the page-aligned
+     * scratch file layout used by ``mmap_scratch``.
+     * @param iused Number of elements in the integer stack.
+     * @return The offset of the double data.
+     */
+    static size_t mapped_data_offset(size_t iused) {
+        const size_t psz = page_size();
+        size_t off = sizeof(size_t) * 2 + sizeof(uint32_t) * iused;
+        return (off + psz - 1) / psz * psz;
+    }
+    /** Detach the file mapping from the double stack of one data frame,
+     * replacing it with anonymous memory.
+     * @param i The index of the data frame.
+     */
+    void unmap_data(int i) const {
+        if (mapped_sizes[i] == 0)
+            return;
+#ifdef __unix__
+        if (mmap(dallocs[i]->data, mapped_sizes[i], PROT_READ | PROT_WRITE,
+                 MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED, -1,
+                 0) == MAP_FAILED)
+            throw runtime_error("DataFrame::unmap_data failed.");
+#ifdef MADV_HUGEPAGE
+        if (huge_pages)
+            madvise(dallocs[i]->data, mapped_sizes[i], MADV_HUGEPAGE);
+#endif
+#endif
+        mapped_sizes[i] = 0;
+    }
+    /** Load one data frame from disk by mapping the scratch file onto
+     * the double stack. Only files written in the page-aligned layout can be
+     * mapped. The mapping is private so the file is never modified.
+     * @param i The index of the data frame.
+     * @param filename The filename for the data frame.
+     * @return ``true`` if the data is loaded, ``false`` if the file is not
+     * in the page-aligned layout.
+     */
+    bool load_data_mapped(int i, const string &filename) const {
+#ifdef __unix__
+        int fd = open(filename.c_str(), O_RDONLY);
+        if (fd == -1)
+            throw runtime_error("DataFrame::load_data on '" + filename +
+                                "' failed.");
+        size_t used[2];
+        struct stat st;
+        if (pread(fd, used, sizeof(used), 0) != (ssize_t)sizeof(used) ||
+            fstat(fd, &st) != 0) {
+            close(fd);
+            throw runtime_error("DataFrame::load_data on '" + filename +
+                                "' failed.");
+        }
+        const size_t off = mapped_data_offset(used[0]);
+        const size_t psz = page_size();
+        if ((size_t)st.st_size != off + sizeof(double) * used[1] ||
+            used[0] > iallocs[i]->size || used[1] > dallocs[i]->size) {
+            close(fd);
+            return false;
+        }
+        const size_t ilen = sizeof(uint32_t) * used[0];
+        if (pread(fd, iallocs[i]->data, ilen, sizeof(used)) != (ssize_t)ilen) {
+            close(fd);
+            throw runtime_error("DataFrame::load_data on '" + filename +
+                                "' failed.");
+        }
+        const size_t dlen = (sizeof(double) * used[1] + psz - 1) / psz * psz;
+        unmap_data(i);
+        if (dlen != 0 &&
+            mmap(dallocs[i]->data, dlen, PROT_READ | PROT_WRITE,
+                 MAP_PRIVATE | MAP_FIXED, fd, (off_t)off) == MAP_FAILED) {
+            close(fd);
+            throw runtime_error("DataFrame::load_data on '" + filename +
+                                "' failed.");
+        }
+        close(fd);
+        mapped_sizes[i] = dlen;
+        iallocs[i]->used = used[0];
+        dallocs[i]->used = used[1];
+        tag_loaded_data(i);
+        return true;
+#else
+        return false;
+#endif
     }
     /** Reset saving and loading buffers for one data frame.
      * Contents in the loading buffer will be deleted.
@@ -416,6 +1141,221 @@ struct DataFrame {
         if (save_buffering && save_futures[i].valid())
             save_futures[i].wait();
         save_buffers[i] = make_pair("", nullptr);
+        for (const auto &pf : prefetch_futures[i])
+            pf.second.wait();
+        prefetch_futures[i].clear();
+    }
+    /** Read the whole scratch file into a buffer stream.
+     * @param filename The filename for the data frame.
+     * @return The buffer stream, or nullptr if reading failed.
+     */
+    static shared_ptr<stringstream> buffer_load_data(const string &filename) {
+        TracerScope _tr("buffer_load_data");
+        ifstream ifs(filename.c_str(), ios::binary);
+        if (!ifs.good())
+            return nullptr;
+        shared_ptr<stringstream> ss = make_shared<stringstream>();
+        *ss << ifs.rdbuf();
+        if (ifs.bad() || !ss->good())
+            return nullptr;
+        ifs.close();
+        return ss;
+    }
+    /** Start reading one scratch file asynchronously, so that the
+     * subsequent ``load_data`` for the same file can be served from memory.
+     * Only effective when ``prefetch_buffering`` is true.
+     * @param i The index of the data frame the file will be loaded into.
+     * @param filename The filename for the data frame.
+     */
+    void prefetch_data(int i, const string &filename) const {
+        if (!prefetch_buffering || present_filenames[i] == filename ||
+            load_buffers[i].first == filename ||
+            save_buffers[i].first == filename)
+            return;
+        for (const auto &pf : prefetch_futures[i])
+            if (pf.first == filename)
+                return;
+        if (!Parsing::file_exists(filename))
+            return;
+#ifdef __unix__
+        // mapped files only need to be in page cache
+        if (mmap_scratch && fp_codec == nullptr) {
+            int fd = open(filename.c_str(), O_RDONLY);
+            if (fd != -1) {
+                posix_fadvise(fd, 0, 0, POSIX_FADV_WILLNEED);
+                close(fd);
+            }
+            return;
+        }
+#endif
+        while ((int)prefetch_futures[i].size() >= max(max_prefetch, 1)) {
+            prefetch_futures[i].front().second.wait();
+            prefetch_futures[i].erase(prefetch_futures[i].begin());
+        }
+        prefetch_futures[i].push_back(make_pair(
+            filename,
+            async(launch::async, &DataFrame::buffer_load_data, filename)
+                .share()));
+    }
+    /** Wait until async saving of one scratch file (if any) finishes.
+     * @param filename The filename for the data frame.
+     */
+    void wait_save_data(const string &filename) const {
+        for (int i = 0; i < n_frames; i++)
+            if (save_buffers[i].first == filename && save_futures[i].valid())
+                save_futures[i].wait();
+    }
+    /** Write a serialized MPS file (not a data frame) to disk
+     * asynchronously. Writes to the same file are kept in order.
+     * @param filename The filename for the file.
+     * @param ss The buffer stream with contents of the file.
+     */
+    void save_file_async(const string &filename,
+                         const shared_ptr<stringstream> &ss) const {
+        wait_save_file(filename);
+        for (int j = (int)mps_save_futures.size() - 1; j >= 0; j--)
+            if (mps_save_futures[j].second.wait_for(chrono::seconds(0)) ==
+                future_status::ready) {
+                mps_save_futures[j].second.get();
+                mps_save_futures.erase(mps_save_futures.begin() + j);
+            }
+        mps_save_futures.push_back(make_pair(
+            filename, async(launch::async, &DataFrame::buffer_save_data,
+                            filename, ss, &tasync)
+                          .share()));
+    }
+    /** Wait until async saving of one MPS file (if any) finishes.
+     * @param filename The filename for the file.
+     */
+    void wait_save_file(const string &filename) const {
+        for (int j = (int)mps_save_futures.size() - 1; j >= 0; j--)
+            if (mps_save_futures[j].first == filename) {
+                shared_future<void> ft = mps_save_futures[j].second;
+                mps_save_futures.erase(mps_save_futures.begin() + j);
+                ft.get();
+            }
+    }
+    /** Wait until async saving of all MPS files finishes. */
+    void wait_save_files() const {
+        vector<pair<string, shared_future<void>>> fts;
+        fts.swap(mps_save_futures);
+        for (const auto &ft : fts)
+            ft.second.get();
+    }
+    /** Add contents of one scratch file to the memory tier.
+     * @param filename The filename for the data frame.
+     * @param ss The buffer stream with contents of the file.
+     * @param sz Size of the contents in bytes.
+     */
+    void cache_data(const string &filename, const shared_ptr<stringstream> &ss,
+                    size_t sz) const {
+        discard_cached_data(filename);
+        if (sz > ram_cache_size)
+            return;
+        ram_cache.push_front(make_tuple(filename, ss, sz));
+        ram_cache_used += sz;
+        while (ram_cache_used > ram_cache_size) {
+            ram_cache_used -= get<2>(ram_cache.back());
+            ram_cache.pop_back();
+        }
+    }
+    /** Find contents of one scratch file in the memory tier.
+     * The file will be marked as the most recently used one.
+     * @param filename The filename for the data frame.
+     * @return The buffer stream, or nullptr if the file is not in memory.
+     */
+    shared_ptr<stringstream> find_cached_data(const string &filename) const {
+        for (auto it = ram_cache.begin(); it != ram_cache.end(); ++it)
+            if (get<0>(*it) == filename) {
+                ram_cache.splice(ram_cache.begin(), ram_cache, it);
+                return get<1>(ram_cache.front());
+            }
+        return nullptr;
+    }
+    /** Remove contents of one scratch file from the memory tier.
+     * @param filename The filename for the data frame.
+     */
+    void discard_cached_data(const string &filename) const {
+        for (auto it = ram_cache.begin(); it != ram_cache.end(); ++it)
+            if (get<0>(*it) == filename) {
+                ram_cache_used -= get<2>(*it);
+                ram_cache.erase(it);
+                return;
+            }
+    }
+    /** Mark one scratch file in save_dir as the most recently used one, and
+     * move least recently used files to spill_dir if local_disk_size is
+     * exceeded.
+     * @param filename The filename for the data frame.
+     * @param sz Size of the file in bytes. If zero, the file is only marked
+     * as used when it is already tracked.
+     */
+    void use_local_data(const string &filename, size_t sz = 0) const {
+        if (local_disk_size == 0 || spill_dir == "")
+            return;
+        for (auto it = local_files.begin(); it != local_files.end(); ++it)
+            if (it->first == filename) {
+                if (sz == 0) {
+                    local_files.splice(local_files.begin(), local_files, it);
+                    return;
+                }
+                local_disk_used -= it->second;
+                local_files.erase(it);
+                break;
+            }
+        if (sz == 0)
+            return;
+        local_files.push_front(make_pair(filename, sz));
+        local_disk_used += sz;
+        while (local_disk_used > local_disk_size && local_files.size() > 1) {
+            const string fn = local_files.back().first;
+            local_disk_used -= local_files.back().second;
+            local_files.pop_back();
+            if (!Parsing::file_exists(fn) || Parsing::link_exists(fn))
+                continue;
+            if (!Parsing::path_exists(spill_dir))
+                Parsing::mkdir(spill_dir);
+            const string spill_fn = Parsing::abs_path(spill_dir) + "/" +
+                                    Parsing::get_filename(fn);
+            wait_save_data(fn);
+            Parsing::copy_file(fn, spill_fn);
+            if (!Parsing::symlink_file(spill_fn, fn))
+                throw runtime_error("DataFrame::use_local_data on '" + fn +
+                                    "' failed.");
+        }
+    }
+    /** Remove one scratch file from all storage tiers.
+     * @param filename The filename for the data frame.
+     */
+    void remove_data(const string &filename) const {
+        discard_prefetch(filename);
+        discard_cached_data(filename);
+        for (auto it = local_files.begin(); it != local_files.end(); ++it)
+            if (it->first == filename) {
+                local_disk_used -= it->second;
+                local_files.erase(it);
+                break;
+            }
+        if (spill_dir != "" && Parsing::link_exists(filename)) {
+            const string spill_fn = Parsing::abs_path(spill_dir) + "/" +
+                                    Parsing::get_filename(filename);
+            if (Parsing::read_link(filename) == spill_fn)
+                Parsing::remove_file(spill_fn);
+        }
+        if (Parsing::link_exists(filename) || Parsing::file_exists(filename))
+            Parsing::remove_file(filename);
+    }
+    /** Discard prefetched contents of one scratch file (in all frames),
+     * when the file is going to be changed.
+     * @param filename The filename for the data frame.
+     */
+    void discard_prefetch(const string &filename) const {
+        for (auto &pfs : prefetch_futures)
+            for (int j = (int)pfs.size() - 1; j >= 0; j--)
+                if (pfs[j].first == filename) {
+                    pfs[j].second.wait();
+                    pfs.erase(pfs.begin() + j);
+                }
     }
     /** Rename one scratch file.
      * @param old_filename original filename.
@@ -423,9 +1363,21 @@ struct DataFrame {
      */
     void rename_data(const string &old_filename,
                      const string &new_filename) const {
+        discard_prefetch(old_filename);
+        discard_prefetch(new_filename);
+        discard_cached_data(new_filename);
         if (!Parsing::rename_file(old_filename, new_filename))
             throw runtime_error("Renaming '" + old_filename + "' to '" +
                                 new_filename + "' failed.");
+        for (auto &rc : ram_cache)
+            if (get<0>(rc) == old_filename)
+                get<0>(rc) = new_filename;
+        for (auto &lf : local_files)
+            if (lf.first == new_filename)
+                lf.first = "";
+        for (auto &lf : local_files)
+            if (lf.first == old_filename)
+                lf.first = new_filename;
         for (auto &fn : present_filenames)
             fn = "";
     }
@@ -434,6 +1386,7 @@ struct DataFrame {
      * @param ifs The input stream.
      */
     void load_data_from(int i, istream &ifs) const {
+        unmap_data(i);
         ifs.read((char *)&iallocs[i]->used, sizeof(iallocs[i]->used));
         ifs.read((char *)&dallocs[i]->used, sizeof(dallocs[i]->used));
         ifs.read((char *)iallocs[i]->data, sizeof(uint32_t) * iallocs[i]->used);
@@ -444,16 +1397,19 @@ struct DataFrame {
             ifs.read((char *)dallocs[i]->data,
                      sizeof(double) * dallocs[i]->used);
         fpread += _t2.get_time();
+        tag_loaded_data(i);
     }
     /** Load one data frame from disk.
      * @param i The index of the data frame.
      * @param filename The filename for the data frame.
      */
     void load_data(int i, const string &filename) const {
+        TracerScope _tr("load_data", i);
         _t.get_time();
-        if (present_filenames[i] == filename) {
+        if (present_filenames[i] == filename)
             return;
-        } else if (load_buffers[i].first == filename) {
+        wait_save_direct(i);
+        if (load_buffers[i].first == filename) {
             shared_ptr<stringstream> ss = make_shared<stringstream>();
             if (load_buffering && present_filenames[i] != "")
                 save_data_to(i, *ss);
@@ -462,21 +1418,63 @@ struct DataFrame {
             load_data_from(i, *load_buffers[i].second);
             load_buffers[i] = make_pair(present_filenames[i], ss);
             present_filenames[i] = filename;
-            tread += _t.get_time();
+            tread += count_io(i, false, _t.get_time());
             return;
         } else if (load_buffering && present_filenames[i] != "") {
             shared_ptr<stringstream> ss = make_shared<stringstream>();
             save_data_to(i, *ss);
             load_buffers[i] = make_pair(present_filenames[i], ss);
         }
-        if (save_buffers[i].first == filename) {
+        if (save_buffers[i].first == filename &&
+            save_buffers[i].second != nullptr) {
             if (save_futures[i].valid())
                 save_futures[i].wait();
             save_buffers[i].second->clear();
             save_buffers[i].second->seekg(0);
             load_data_from(i, *save_buffers[i].second);
             present_filenames[i] = filename;
-            tread += _t.get_time();
+            tread += count_io(i, false, _t.get_time());
+            return;
+        }
+        for (size_t j = 0; j < prefetch_futures[i].size(); j++)
+            if (prefetch_futures[i][j].first == filename) {
+                shared_ptr<stringstream> ss =
+                    prefetch_futures[i][j].second.get();
+                prefetch_futures[i].erase(prefetch_futures[i].begin() + j);
+                if (ss == nullptr)
+                    break;
+                load_data_from(i, *ss);
+                if (ss->fail() || ss->bad())
+                    throw runtime_error("DataFrame::load_data on '" +
+                                        filename + "' failed.");
+                tread += count_io(i, false, _t.get_time());
+                update_peak_used_memory();
+                present_filenames[i] = filename;
+                use_local_data(filename);
+                return;
+            }
+        shared_ptr<stringstream> css = find_cached_data(filename);
+        if (css != nullptr) {
+            wait_save_data(filename);
+            css->clear();
+            css->seekg(0);
+            load_data_from(i, *css);
+            tread += count_io(i, false, _t.get_time());
+            update_peak_used_memory();
+            present_filenames[i] = filename;
+            use_local_data(filename);
+            return;
+        }
+        // the file may be still being written from another frame
+        if (zero_copy_save)
+            wait_save_data(filename);
+        if (mmap_scratch && fp_codec == nullptr &&
+            load_data_mapped(i, filename)) {
+            tread += record_io(filename, false, saved_data_size(i, true),
+                               count_io(i, false, _t.get_time()));
+            update_peak_used_memory();
+            present_filenames[i] = filename;
+            use_local_data(filename);
             return;
         }
         ifstream ifs(filename.c_str(), ios::binary);
@@ -487,10 +1485,13 @@ struct DataFrame {
         if (ifs.fail() || ifs.bad())
             throw runtime_error("DataFrame::load_data on '" + filename +
                                 "' failed.");
+        const size_t sz = (size_t)ifs.tellg();
         ifs.close();
-        tread += _t.get_time();
+        tread += record_io(filename, false, sz,
+                           count_io(i, false, _t.get_time()));
         update_peak_used_memory();
         present_filenames[i] = filename;
+        use_local_data(filename);
     }
     /** Save one data frame into output stream.
      * @param i The index of the data frame.
@@ -509,6 +1510,120 @@ struct DataFrame {
                       sizeof(double) * dallocs[i]->used);
         fpwrite += _t2.get_time();
     }
+    /** Save one data frame into output stream, using the page-aligned layout
+     * for ``mmap_scratch``.
+     * @param i The index of the data frame.
+     * @param ofs The output stream.
+     */
+    void save_data_mapped_to(int i, ostream &ofs) const {
+        ofs.write((char *)&iallocs[i]->used, sizeof(iallocs[i]->used));
+        ofs.write((char *)&dallocs[i]->used, sizeof(dallocs[i]->used));
+        ofs.write((char *)iallocs[i]->data,
+                  sizeof(uint32_t) * iallocs[i]->used);
+        const size_t off = sizeof(size_t) * 2 +
+                           sizeof(uint32_t) * iallocs[i]->used;
+        const vector<char> pad(mapped_data_offset(iallocs[i]->used) - off, 0);
+        ofs.write(pad.data(), pad.size());
+        ofs.write((char *)dallocs[i]->data, sizeof(double) * dallocs[i]->used);
+    }
+    /** Wait for the async zero-copy saving of one data frame, before the
+     * stack memory of the data frame is changed.
+     * @param i The index of the data frame.
+     */
+    void wait_save_direct(int i) const {
+        if (save_buffers[i].first != "" && save_buffers[i].second == nullptr &&
+            save_futures[i].valid())
+            save_futures[i].wait();
+    }
+    /** Add the data size of one data frame and the IO time to kernel
+     * counters (for roofline analysis).
+     * @param i The index of the data frame.
+     * @param write Whether the data frame was written (or read).
+     * @param t The IO time.
+     * @return The IO time.
+     */
+    double count_io(int i, bool write, double t) const {
+        kernel_counters_().add(write ? KernelTypes::Write : KernelTypes::Read,
+                               0, saved_data_size(i, false), t);
+        return t;
+    }
+    /** Size of the scratch file for one data frame.
+     * @param i The index of the data frame.
+     * @param mapped Whether the page-aligned layout is used.
+     * @return The file size in bytes.
+     */
+    size_t saved_data_size(int i, bool mapped) const {
+        return (mapped ? mapped_data_offset(iallocs[i]->used)
+                       : sizeof(size_t) * 2 +
+                             sizeof(uint32_t) * iallocs[i]->used) +
+               sizeof(double) * dallocs[i]->used;
+    }
+#ifdef __unix__
+    /** Write a memory range into a file at given offset.
+     * @param fd The file descriptor.
+     * @param ptr The memory range.
+     * @param len Number of bytes.
+     * @param off Offset in the file.
+     * @return ``true`` if succeeded.
+     */
+    static bool write_range(int fd, const void *ptr, size_t len, size_t off) {
+        while (len != 0) {
+            ssize_t r = pwrite(fd, ptr, len, (off_t)off);
+            if (r <= 0)
+                return false;
+            ptr = (const char *)ptr + r, len -= (size_t)r, off += (size_t)r;
+        }
+        return true;
+    }
+    /** Save one data frame to disk directly from the stack memory,
+     * without intermediate copies. The integer stack (including headers of
+     * sparse matrix infos) and the double stack are written into the file
+     * as they are, in the same layout as ``save_data_to`` (or
+     * ``save_data_mapped_to`` if ``mapped`` is true).
+     * @param i The index of the data frame.
+     * @param filename The filename for the data frame.
+     * @param mapped Whether the page-aligned layout should be used.
+     * @param tw Pointer to the time recorder for saving.
+     */
+    void save_data_direct(int i, const string &filename, bool mapped,
+                          double *tw) const {
+        TracerScope _tr("save_data_direct", i);
+        Timer tx;
+        tx.get_time();
+        int fd = open(filename.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (fd == -1)
+            throw runtime_error("DataFrame::save_data on '" + filename +
+                                "' failed.");
+        const size_t used[2] = {iallocs[i]->used, dallocs[i]->used};
+        const size_t off = mapped ? mapped_data_offset(used[0])
+                                  : sizeof(used) + sizeof(uint32_t) * used[0];
+        const size_t dlen = sizeof(double) * used[1];
+        bool ok = write_range(fd, used, sizeof(used), 0) &&
+                  write_range(fd, iallocs[i]->data, sizeof(uint32_t) * used[0],
+                              sizeof(used));
+        size_t dst = 0;
+#ifdef O_DIRECT
+        // full pages of double data (page-aligned in both memory and file)
+        const size_t psz = page_size();
+        if (ok && direct_io && mapped && dlen >= psz) {
+            int dfd = open(filename.c_str(), O_WRONLY | O_DIRECT);
+            if (dfd != -1) {
+                dst = dlen / psz * psz;
+                ok = write_range(dfd, dallocs[i]->data, dst, off);
+                close(dfd);
+            }
+        }
+#endif
+        ok = ok && write_range(fd, (char *)dallocs[i]->data + dst, dlen - dst,
+                               off + dst);
+        // padding is a hole when the double data is empty
+        ok = ok && ftruncate(fd, (off_t)(off + dlen)) == 0;
+        if (close(fd) != 0 || !ok)
+            throw runtime_error("DataFrame::save_data on '" + filename +
+                                "' failed.");
+        *tw += tx.get_time();
+    }
+#endif
     /** Save the data in buffer stream into disk.
      * @param filename The filename for saving data.
      * @param ss The buffer stream.
@@ -517,6 +1632,7 @@ struct DataFrame {
     static void buffer_save_data(const string &filename,
                                  const shared_ptr<stringstream> &ss,
                                  double *tasync) {
+        TracerScope _tr("buffer_save_data", (size_t)ss->tellp());
         Timer tx;
         tx.get_time();
         if (Parsing::link_exists(filename))
@@ -539,52 +1655,115 @@ struct DataFrame {
      * @param filename The filename for the data frame.
      */
     void save_data(int i, const string &filename) const {
+        TracerScope _tr("save_data", i);
+        discard_prefetch(filename);
+        discard_cached_data(filename);
         if (!partition_can_write) {
             update_peak_used_memory();
             present_filenames[i] = filename;
             return;
         }
         _t.get_time();
-        if (save_buffering) {
+        const bool mapped = mmap_scratch && fp_codec == nullptr;
+        // a spilled file is replaced by a new file in save_dir
+        if (spill_dir != "" && Parsing::link_exists(filename))
+            remove_data(filename);
+#ifdef __unix__
+        if (zero_copy_save && fp_codec == nullptr && ram_cache_size == 0) {
+            if (save_futures[i].valid())
+                save_futures[i].wait();
+            // the old file may still be mapped in some frame
+            if (Parsing::link_exists(filename) || Parsing::file_exists(filename))
+                Parsing::remove_file(filename);
+            const size_t sz = saved_data_size(i, mapped);
+            if (save_buffering) {
+                save_buffers[i] = make_pair(filename, nullptr);
+                save_futures[i] =
+                    async(launch::async, &DataFrame::save_data_direct, this, i,
+                          filename, mapped, &tasync);
+                twrite += count_io(i, true, _t.get_time());
+            } else {
+                double tsync = 0;
+                save_data_direct(i, filename, mapped, &tsync);
+                twrite += record_io(filename, true, sz,
+                                    count_io(i, true, _t.get_time()));
+            }
+            update_peak_used_memory();
+            present_filenames[i] = filename;
+            use_local_data(filename, sz);
+            return;
+        }
+#endif
+        if ((save_buffering || ram_cache_size != 0) && !mapped) {
             if (save_futures[i].valid())
                 save_futures[i].wait();
             shared_ptr<stringstream> ss = make_shared<stringstream>();
             save_data_to(i, *ss);
-            save_buffers[i] = make_pair(filename, ss);
-            save_futures[i] = async(launch::async, &DataFrame::buffer_save_data,
-                                    filename, ss, &tasync);
-            twrite += _t.get_time();
+            const size_t sz = (size_t)ss->tellp();
+            if (ram_cache_size != 0)
+                cache_data(filename, ss, sz);
+            if (save_buffering) {
+                save_buffers[i] = make_pair(filename, ss);
+                save_futures[i] =
+                    async(launch::async, &DataFrame::buffer_save_data,
+                          filename, ss, &tasync);
+                twrite += count_io(i, true, _t.get_time());
+            } else {
+                double tsync = 0;
+                buffer_save_data(filename, ss, &tsync);
+                twrite += record_io(filename, true, sz,
+                                    count_io(i, true, _t.get_time()));
+            }
             update_peak_used_memory();
             present_filenames[i] = filename;
+            use_local_data(filename, sz);
             return;
         }
-        if (Parsing::link_exists(filename))
+        // the old file may still be mapped in some frame, so it
+        // must be unlinked rather than truncated
+        if (Parsing::link_exists(filename) ||
+            (mapped && Parsing::file_exists(filename)))
             Parsing::remove_file(filename);
         ofstream ofs(filename.c_str(), ios::binary);
         if (!ofs.good())
             throw runtime_error("DataFrame::save_data on '" + filename +
                                 "' failed.");
-        save_data_to(i, ofs);
+        if (mapped)
+            save_data_mapped_to(i, ofs);
+        else
+            save_data_to(i, ofs);
         if (!ofs.good())
             throw runtime_error("DataFrame::save_data on '" + filename +
                                 "' failed.");
+        const size_t sz = (size_t)ofs.tellp();
         ofs.close();
-        twrite += _t.get_time();
+        twrite += record_io(filename, true, sz,
+                            count_io(i, true, _t.get_time()));
         update_peak_used_memory();
         present_filenames[i] = filename;
+        use_local_data(filename, sz);
     }
     /** Deallocate the memory allocated for all stacks.
      * Note that this method is automatically invoked at deconstruction.
      */
     void deallocate() {
-        delete[] iallocs[0]->data;
-        delete[] dallocs[0]->data;
-        iallocs.clear();
-        dallocs.clear();
+        // zero-copy saving may still be reading the stacks
         if (save_buffering)
             for (const auto &ft : save_futures)
                 if (ft.valid())
                     ft.wait();
+        for (const auto &ft : mps_save_futures)
+            ft.second.wait();
+        mps_save_futures.clear();
+        delete[] iallocs[0]->data;
+        deallocate_stack(dallocs[0]->data, dsize);
+        iallocs.clear();
+        dallocs.clear();
+        for (auto &pfs : prefetch_futures) {
+            for (const auto &pf : pfs)
+                pf.second.wait();
+            pfs.clear();
+        }
     }
     /** Return the current used memory in all stacks.
      * @return The current used memory in Bytes.
@@ -608,6 +1787,25 @@ struct DataFrame {
     void reset_peak_used_memory() const {
         memset(peak_used_memory.data(), 0,
                sizeof(size_t) * peak_used_memory.size());
+        if (mem_tags != nullptr)
+            mem_tags->reset_peak();
+    }
+    /** Reset the data frame for another calculation, keeping the allocated
+     * stacks and the options. Pending async saving is finished; all stacks
+     * are marked as unused; buffers, tiered caches, IO statistics and peak
+     * memory statistics are cleared.
+     */
+    void reset_state() {
+        wait_save_files();
+        for (int i = 0; i < n_frames; i++)
+            reset_buffer(i), reset(i);
+        ram_cache.clear(), local_files.clear();
+        ram_cache_used = local_disk_used = 0;
+        tread = twrite = tasync = fpread = fpwrite = 0;
+        if (io_monitor != nullptr)
+            io_monitor->clear();
+        reset_peak_used_memory();
+        activate(0);
     }
     /** Print the status of the data frame.
      * @param os The output stream.
@@ -618,7 +1816,15 @@ struct DataFrame {
         os << " UseMainStack = " << df.use_main_stack
            << " MinDiskUsage = " << df.minimal_disk_usage
            << " IBuf = " << df.load_buffering << " OBuf = " << df.save_buffering
-           << endl;
+           << " PBuf = " << df.prefetch_buffering
+           << " ZeroCopy = " << df.zero_copy_save << " DIO = " << df.direct_io
+           << " MMap = " << df.mmap_scratch
+           << " HugePages = " << df.huge_pages
+           << " Align = " << df.dallocs[0]->align * sizeof(double) << endl;
+        if (df.ram_cache_size != 0 || df.local_disk_size != 0)
+            os << " RAMTier = " << Parsing::to_size_string(df.ram_cache_size)
+               << " LocalTier = " << Parsing::to_size_string(df.local_disk_size)
+               << " SpillDir = " << df.spill_dir << endl;
         if (df.fp_codec != nullptr)
             os << " FPCompression: prec = " << scientific << setprecision(2)
                << df.fp_codec->prec << " chunk = " << fixed
@@ -635,6 +1841,35 @@ struct DataFrame {
     }
 };
 
+/** Scope for attributing stack memory allocated in a data frame to a tag.
+ * The previous tag is restored when the scope ends. Has no effect if memory
+ * tags are not tracked in the data frame. */
+struct MemoryTagScope {
+    shared_ptr<StackMemoryTags> tags; //!< Tag statistics of the data frame.
+    int old_tag = 0;                  //!< Tag before entering the scope.
+    /** Constructor.
+     * @param df The data frame.
+     * @param name The name of the tag.
+     */
+    MemoryTagScope(const shared_ptr<DataFrame> &df, const string &name)
+        : tags(df == nullptr ? nullptr : df->mem_tags) {
+        if (tags != nullptr)
+            old_tag = tags->current, tags->current = tags->get(name);
+    }
+    /** Change the tag for the rest of the scope.
+     * @param name The name of the tag.
+     */
+    void set(const string &name) {
+        if (tags != nullptr)
+            tags->current = tags->get(name);
+    }
+    /** Destructor. */
+    ~MemoryTagScope() {
+        if (tags != nullptr)
+            tags->current = old_tag;
+    }
+};
+
 /** Implementation of the ``frame`` global variable. */
 inline shared_ptr<DataFrame> &frame_() {
     static shared_ptr<DataFrame> frame;
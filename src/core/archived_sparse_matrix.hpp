@@ -28,11 +28,215 @@
 
 #include "csr_sparse_matrix.hpp"
 #include "sparse_matrix.hpp"
+#include <chrono>
+#include <fstream>
+#include <future>
+#include <list>
+#include <mutex>
+#include <sstream>
 
 using namespace std;
 
 namespace block2 {
 
+/** Asynchronous disk I/O for archived sparse matrices.
+ * Writes are performed by background tasks in the order of submission for
+ * each file, with the total size of the buffers being written bounded.
+ * Archived matrices needed later can be read ahead in background. Reads
+ * overlapping a pending write are served from the write buffer or wait for it.
+ */
+struct ArchiveIO {
+    //! Pending background write of one buffer.
+    struct Write {
+        string filename;
+        int64_t lo, hi; //!< Byte range in the file.
+        shared_ptr<vector<char>> buf;
+        shared_future<void> fut;
+    };
+    //! Pending background read of one buffer.
+    struct Read {
+        string filename;
+        int64_t lo, hi; //!< Byte range in the file.
+        shared_future<shared_ptr<vector<char>>> fut;
+    };
+    size_t max_write_bytes; //!< Max total bytes of the buffers being written.
+    int max_prefetch;       //!< Max number of buffers being read ahead.
+    size_t write_bytes = 0; //!< Total bytes of the buffers being written.
+    list<Write> writes;     //!< Pending writes in the order of submission.
+    list<Read> reads;       //!< Pending reads in the order of submission.
+    mutex mtx;
+    /** Constructor.
+     * @param max_write_bytes Max total bytes of the buffers being written.
+     * When exceeded, new writes wait for the oldest ones.
+     * @param max_prefetch Max number of buffers being read ahead. When
+     * exceeded, the oldest read-ahead buffer is dropped.
+     */
+    ArchiveIO(size_t max_write_bytes = (size_t)1 << 30, int max_prefetch = 16)
+        : max_write_bytes(max_write_bytes), max_prefetch(max_prefetch) {}
+    ~ArchiveIO() { wait(); }
+    /** Write a buffer to disk file (in background thread).
+     * @param filename The name of the disk file.
+     * @param offset Byte offset in the file.
+     * @param buf The data to write.
+     * @param prev The previous write to the same file, which must finish
+     * first.
+     */
+    static void write_file(const string &filename, int64_t offset,
+                           const shared_ptr<vector<char>> &buf,
+                           const shared_future<void> &prev) {
+        if (prev.valid())
+            prev.wait();
+        ofstream ofs(filename.c_str(), ios::binary | ios::out | ios::app);
+        ofs.close();
+        ofs.open(filename.c_str(), ios::binary | ios::in);
+        if (!ofs.good())
+            throw runtime_error("ArchiveIO::write_file on '" + filename +
+                                "' failed.");
+        ofs.seekp(offset);
+        ofs.write(buf->data(), buf->size());
+        ofs.close();
+    }
+    /** Read a buffer from disk file.
+     * @param filename The name of the disk file.
+     * @param offset Byte offset in the file.
+     * @param bytes Max number of bytes to read.
+     * @return The data read (can be shorter than bytes at end of file).
+     */
+    static shared_ptr<vector<char>> read_file(const string &filename,
+                                              int64_t offset, size_t bytes) {
+        shared_ptr<vector<char>> buf = make_shared<vector<char>>(bytes);
+        ifstream ifs(filename.c_str(), ios::binary);
+        if (!ifs.good())
+            throw runtime_error("ArchiveIO::read_file on '" + filename +
+                                "' failed.");
+        ifs.seekg(offset);
+        ifs.read(buf->data(), bytes);
+        buf->resize((size_t)ifs.gcount());
+        ifs.close();
+        return buf;
+    }
+    // Remove finished writes (and the oldest ones until there is room for
+    // extra bytes). Lock must be held.
+    void retire_writes(size_t extra) {
+        for (auto it = writes.begin(); it != writes.end();)
+            if (it->fut.wait_for(chrono::seconds(0)) == future_status::ready) {
+                it->fut.get();
+                write_bytes -= it->buf->size();
+                it = writes.erase(it);
+            } else
+                it++;
+        while (!writes.empty() && write_bytes + extra > max_write_bytes) {
+            writes.front().fut.get();
+            write_bytes -= writes.front().buf->size();
+            writes.pop_front();
+        }
+    }
+    /** Submit a buffer to be written to disk file in background.
+     * @param filename The name of the disk file.
+     * @param offset Byte offset in the file.
+     * @param buf The data to write. Must not be changed afterwards.
+     */
+    void write(const string &filename, int64_t offset,
+               const shared_ptr<vector<char>> &buf) {
+        lock_guard<mutex> lock(mtx);
+        int64_t lo = offset, hi = offset + (int64_t)buf->size();
+        retire_writes(buf->size());
+        // read-ahead buffers overlapping this write become outdated
+        for (auto it = reads.begin(); it != reads.end();)
+            if (it->filename == filename && it->lo < hi && lo < it->hi)
+                it = reads.erase(it);
+            else
+                it++;
+        shared_future<void> prev;
+        for (auto it = writes.rbegin(); it != writes.rend(); it++)
+            if (it->filename == filename) {
+                prev = it->fut;
+                break;
+            }
+        Write w;
+        w.filename = filename, w.lo = lo, w.hi = hi, w.buf = buf;
+        w.fut = async(launch::async, &ArchiveIO::write_file, filename, offset,
+                      buf, prev)
+                    .share();
+        writes.push_back(w);
+        write_bytes += buf->size();
+    }
+    /** Start reading a buffer from disk file in background.
+     * @param filename The name of the disk file.
+     * @param offset Byte offset in the file.
+     * @param bytes Max number of bytes to read.
+     */
+    void prefetch(const string &filename, int64_t offset, size_t bytes) {
+        lock_guard<mutex> lock(mtx);
+        int64_t lo = offset, hi = offset + (int64_t)bytes;
+        for (auto &w : writes)
+            if (w.filename == filename && w.lo < hi && lo < w.hi)
+                return;
+        for (auto &r : reads)
+            if (r.filename == filename && r.lo == lo && r.hi == hi)
+                return;
+        if (max_prefetch <= 0)
+            return;
+        while ((int)reads.size() >= max_prefetch)
+            reads.pop_front();
+        Read r;
+        r.filename = filename, r.lo = lo, r.hi = hi;
+        r.fut = async(launch::async, &ArchiveIO::read_file, filename, offset,
+                      bytes)
+                    .share();
+        reads.push_back(r);
+    }
+    /** Read a buffer from disk file, using pending writes and read-ahead
+     * buffers when possible.
+     * @param filename The name of the disk file.
+     * @param offset Byte offset in the file.
+     * @param bytes Max number of bytes to read.
+     * @return The data read. Must not be changed.
+     */
+    shared_ptr<vector<char>> read(const string &filename, int64_t offset,
+                                  size_t bytes) {
+        unique_lock<mutex> lock(mtx);
+        int64_t lo = offset, hi = offset + (int64_t)bytes;
+        // the latest pending write overlapping the range
+        for (auto it = writes.rbegin(); it != writes.rend(); it++)
+            if (it->filename == filename && it->lo < hi && lo < it->hi) {
+                if (it->lo == lo && it->hi <= hi)
+                    return it->buf;
+                shared_future<void> fut = it->fut;
+                lock.unlock();
+                fut.wait();
+                return read_file(filename, offset, bytes);
+            }
+        for (auto it = reads.begin(); it != reads.end(); it++)
+            if (it->filename == filename && it->lo == lo && it->hi == hi) {
+                shared_future<shared_ptr<vector<char>>> fut = it->fut;
+                reads.erase(it);
+                lock.unlock();
+                return fut.get();
+            }
+        lock.unlock();
+        return read_file(filename, offset, bytes);
+    }
+    /** Wait for all pending writes and drop all read-ahead buffers. */
+    void wait() {
+        lock_guard<mutex> lock(mtx);
+        reads.clear();
+        for (auto &w : writes)
+            w.fut.get();
+        writes.clear();
+        write_bytes = 0;
+    }
+};
+
+/** Global asynchronous disk I/O for archived sparse matrices. If nullptr
+ * (default), archived sparse matrices are read and written synchronously.
+ * @return Reference to the global ArchiveIO object.
+ */
+inline shared_ptr<ArchiveIO> &archive_io_() {
+    static shared_ptr<ArchiveIO> aio;
+    return aio;
+}
+
 /** Block-sparse Matrix associated with disk storage, representing sparse
  * operator.
  * @tparam S Quantum label type.
@@ -91,10 +295,20 @@ template <typename S> struct ArchivedSparseMatrix : SparseMatrix<S> {
             mat->factor = factor;
             if (total_memory != 0) {
                 mat->data = alloc->allocate(mat->total_memory);
-                ifstream ifs(filename.c_str(), ios::binary);
-                ifs.seekg(sizeof(double) * offset);
-                ifs.read((char *)mat->data, sizeof(double) * mat->total_memory);
-                ifs.close();
+                if (archive_io_() != nullptr) {
+                    shared_ptr<vector<char>> buf = archive_io_()->read(
+                        filename, sizeof(double) * offset,
+                        sizeof(double) * mat->total_memory);
+                    assert(buf->size() >= sizeof(double) * mat->total_memory);
+                    memcpy(mat->data, buf->data(),
+                           sizeof(double) * mat->total_memory);
+                } else {
+                    ifstream ifs(filename.c_str(), ios::binary);
+                    ifs.seekg(sizeof(double) * offset);
+                    ifs.read((char *)mat->data,
+                             sizeof(double) * mat->total_memory);
+                    ifs.close();
+                }
             } else
                 mat->data = nullptr;
             return mat;
@@ -106,18 +320,44 @@ template <typename S> struct ArchivedSparseMatrix : SparseMatrix<S> {
             mat->factor = factor;
             mat->total_memory = 0;
             if (info->n != 0) {
-                ifstream ifs(filename.c_str(), ios::binary);
-                ifs.seekg(sizeof(double) * offset);
+                shared_ptr<istream> ifs;
+                if (archive_io_() != nullptr && total_memory != 0) {
+                    shared_ptr<vector<char>> buf = archive_io_()->read(
+                        filename, sizeof(double) * offset,
+                        sizeof(double) * total_memory);
+                    ifs = make_shared<istringstream>(
+                        string(buf->data(), buf->size()));
+                } else {
+                    // size unknown: all pending writes must finish
+                    if (archive_io_() != nullptr)
+                        archive_io_()->wait();
+                    shared_ptr<ifstream> fs =
+                        make_shared<ifstream>(filename.c_str(), ios::binary);
+                    fs->seekg(sizeof(double) * offset);
+                    ifs = fs;
+                }
                 for (int i = 0; i < info->n; i++) {
                     mat->csr_data[i] = make_shared<CSRMatrixRef>();
-                    mat->csr_data[i]->load_data(ifs);
+                    mat->csr_data[i]->load_data(*ifs);
                 }
-                ifs.close();
             }
             return mat;
         } else
             throw runtime_error("Unknown SparseType");
     }
+    /** Start reading the sparse matrix data from disk in background, if
+     * asynchronous disk I/O is enabled.
+     */
+    void prefetch_archive() {
+        if (archive_io_() == nullptr || info == nullptr)
+            return;
+        size_t mem = sparse_type == SparseMatrixTypes::Normal
+                         ? (size_t)info->get_total_memory()
+                         : (size_t)total_memory;
+        if (mem != 0)
+            archive_io_()->prefetch(filename, sizeof(double) * offset,
+                                    sizeof(double) * mem);
+    }
     /** Write the sparse matrix data to disk.
      * @param mat A normal or CSR sparse matrix (with data in memory).
      */
@@ -129,7 +369,13 @@ template <typename S> struct ArchivedSparseMatrix : SparseMatrix<S> {
         total_memory = mat->total_memory;
         if (sparse_type == SparseMatrixTypes::Normal) {
             sparse_type = SparseMatrixTypes::Normal;
-            if (total_memory != 0) {
+            if (total_memory != 0 && archive_io_() != nullptr)
+                archive_io_()->write(
+                    filename, sizeof(double) * offset,
+                    make_shared<vector<char>>(
+                        (char *)mat->data,
+                        (char *)(mat->data + total_memory)));
+            else if (total_memory != 0) {
                 ofstream ofs(filename.c_str(),
                              ios::binary | ios::out | ios::app);
                 ofs.close();
@@ -143,6 +389,18 @@ template <typename S> struct ArchivedSparseMatrix : SparseMatrix<S> {
             if (info->n != 0) {
                 shared_ptr<CSRSparseMatrix<S>> smat =
                     dynamic_pointer_cast<CSRSparseMatrix<S>>(mat);
+                if (archive_io_() != nullptr) {
+                    stringstream ss;
+                    for (int i = 0; i < info->n; i++)
+                        smat->csr_data[i]->save_data(ss);
+                    string str = ss.str();
+                    total_memory =
+                        (str.size() + sizeof(double) - 1) / sizeof(double);
+                    archive_io_()->write(
+                        filename, sizeof(double) * offset,
+                        make_shared<vector<char>>(str.begin(), str.end()));
+                    return;
+                }
                 ofstream ofs(filename.c_str(),
                              ios::binary | ios::out | ios::app);
                 ofs.close();
@@ -46,12 +46,71 @@ template <typename S> struct ArchivedTensorFunctions : TensorFunctions<S> {
      */
     ArchivedTensorFunctions(const shared_ptr<OperatorFunctions<S>> &opf)
         : TensorFunctions<S>(opf) {}
+    /** Get a copy of this driver (with the same disk file and offset).
+     * @return A copy of this driver for tensor functions.
+     */
+    shared_ptr<TensorFunctions<S>> copy() const override {
+        shared_ptr<ArchivedTensorFunctions<S>> r =
+            make_shared<ArchivedTensorFunctions<S>>(opf->copy());
+        r->filename = filename, r->offset = offset;
+        return r;
+    }
     /** Get the type of this driver for tensor functions.
      * @return Type of this driver for tensor functions.
      */
     TensorFunctionsTypes get_type() const override {
         return TensorFunctionsTypes::Archived;
     }
+    /** Start reading an archived operand in background, if asynchronous
+     * disk I/O is enabled.
+     * @param ops Symbol lookup table for the operand.
+     * @param x Symbol of the operand.
+     */
+    static void prefetch_operand(
+        const unordered_map<shared_ptr<OpExpr<S>>, shared_ptr<SparseMatrix<S>>>
+            &ops,
+        const shared_ptr<OpExpr<S>> &x) {
+        auto it = ops.find(x);
+        if (it != ops.end() &&
+            it->second->get_type() == SparseMatrixTypes::Archived)
+            dynamic_pointer_cast<ArchivedSparseMatrix<S>>(it->second)
+                ->prefetch_archive();
+    }
+    /** Start reading the archived operands of a tensor product in background,
+     * if asynchronous disk I/O is enabled.
+     * @param expr Symbolic expression of the tensor product.
+     * @param lop Symbol lookup table for left operands.
+     * @param rop Symbol lookup table for right operands.
+     */
+    static void prefetch_operands(
+        const shared_ptr<OpExpr<S>> &expr,
+        const unordered_map<shared_ptr<OpExpr<S>>, shared_ptr<SparseMatrix<S>>>
+            &lop,
+        const unordered_map<shared_ptr<OpExpr<S>>, shared_ptr<SparseMatrix<S>>>
+            &rop) {
+        if (archive_io_() == nullptr || expr->get_type() != OpTypes::Prod)
+            return;
+        shared_ptr<OpProduct<S>> op = dynamic_pointer_cast<OpProduct<S>>(expr);
+        prefetch_operand(lop, op->a);
+        if (op->b != nullptr)
+            prefetch_operand(rop, op->b);
+    }
+    /** Start reading the archived operand of the next non-zero element of a
+     * symbolic vector in background, if asynchronous disk I/O is enabled.
+     * @param a Symbol lookup table for the operand.
+     * @param mat Symbolic vector.
+     * @param i Index of the current element.
+     */
+    static void prefetch_next(const shared_ptr<OperatorTensor<S>> &a,
+                              const shared_ptr<Symbolic<S>> &mat, size_t i) {
+        if (archive_io_() == nullptr)
+            return;
+        for (size_t j = i + 1; j < mat->data.size(); j++)
+            if (mat->data[j]->get_type() != OpTypes::Zero) {
+                prefetch_operand(a->ops, abs_value(mat->data[j]));
+                break;
+            }
+    }
     /** Save the content of an operator tensor into disk,
      * transforming its internal representation to sparse matrices with internal
      * data stored in disk file, and deallocating its memory data.
@@ -230,6 +289,10 @@ template <typename S> struct ArchivedTensorFunctions : TensorFunctions<S> {
                     S vdq = pks[k];
                     int iv = (int)(lower_bound(vdqs.begin(), vdqs.end(), vdq) -
                                    vdqs.begin());
+                    // vdq may be out of the streamed part of vmats
+                    if (vidx == -1 &&
+                        (iv == (int)vdqs.size() || vdqs[iv] != vdq))
+                        continue;
                     shared_ptr<SparseMatrix<S>> vmat =
                         vidx == -1 ? (*vmats)[iv] : (*vmats)[vidx++];
                     cmat->info->cinfo = cinfos[ij][k];
@@ -261,6 +324,10 @@ template <typename S> struct ArchivedTensorFunctions : TensorFunctions<S> {
                     S vdq = pks[k];
                     int iv = (int)(lower_bound(vdqs.begin(), vdqs.end(), vdq) -
                                    vdqs.begin());
+                    // vdq may be out of the streamed part of vmats
+                    if (vidx == -1 &&
+                        (iv == (int)vdqs.size() || vdqs[iv] != vdq))
+                        continue;
                     shared_ptr<SparseMatrix<S>> vmat =
                         vidx == -1 ? (*vmats)[iv] : (*vmats)[vidx++];
                     cmat->info->cinfo = cinfos[ij][k];
@@ -334,6 +401,41 @@ template <typename S> struct ArchivedTensorFunctions : TensorFunctions<S> {
                 }
         }
     }
+    /** Tensor product multiplication operation for several roots at once:
+     * vmats = expr x cmats.
+     * @param expr Symbolic expression in form of sum of tensor products.
+     * @param lopt Symbol lookup table for left operands in the tensor products.
+     * @param ropt Symbol lookup table for right operands in the tensor
+     * products.
+     * @param cmats Input wavefunctions of all roots, one after another.
+     * @param vmats Output results of all roots, one after another.
+     * @param nroots Number of roots in cmats and vmats.
+     * @param cinfos Lookup table of sparse matrix connection info, where the
+     * key is the combined quantum number of the vmat and cmat.
+     * @param opdq The delta quantum number of expr.
+     * @param factor Scaling factor applied to the results.
+     * @param all_reduce If true, the output result is accumulated and
+     * broadcast to all processors.
+     */
+    void tensor_product_multi_multiply_panel(
+        const shared_ptr<OpExpr<S>> &expr,
+        const shared_ptr<OperatorTensor<S>> &lopt,
+        const shared_ptr<OperatorTensor<S>> &ropt,
+        const shared_ptr<SparseMatrixGroup<S>> &cmats,
+        const shared_ptr<SparseMatrixGroup<S>> &vmats, int nroots,
+        const unordered_map<
+            S, shared_ptr<typename SparseMatrixInfo<S>::ConnectionInfo>>
+            &cinfos,
+        S opdq, double factor, bool all_reduce) const override {
+        unordered_map<S, int> vdqs;
+        vdqs.reserve(vmats->n / nroots);
+        for (int iv = 0; iv < vmats->n / nroots; iv++)
+            vdqs[vmats->infos[iv]->delta_quantum] = iv;
+        for (int ic = 0; ic < cmats->n / nroots; ic++)
+            this->tensor_product_multi_multiply_roots(expr, lopt, ropt, cmats,
+                                                      vmats, nroots, ic, vdqs,
+                                                      cinfos, opdq, factor);
+    }
     /** Tensor product multiplication operation (single-root case): vmat = expr
      * x cmat.
      * @param expr Symbolic expression in form of sum of tensor products.
@@ -375,8 +477,12 @@ template <typename S> struct ArchivedTensorFunctions : TensorFunctions<S> {
         } break;
         case OpTypes::Sum: {
             shared_ptr<OpSum<S>> op = dynamic_pointer_cast<OpSum<S>>(expr);
-            for (auto &x : op->strings)
-                tensor_product_multiply(x, lopt, ropt, cmat, vmat, opdq, false);
+            for (size_t k = 0; k < op->strings.size(); k++) {
+                if (k + 1 < op->strings.size())
+                    prefetch_operands(op->strings[k + 1], lopt->ops, ropt->ops);
+                tensor_product_multiply(op->strings[k], lopt, ropt, cmat, vmat,
+                                        opdq, false);
+            }
         } break;
         case OpTypes::Zero:
             break;
@@ -420,8 +526,11 @@ template <typename S> struct ArchivedTensorFunctions : TensorFunctions<S> {
         } break;
         case OpTypes::Sum: {
             shared_ptr<OpSum<S>> op = dynamic_pointer_cast<OpSum<S>>(expr);
-            for (auto &x : op->strings)
-                tensor_product_diagonal(x, lopt, ropt, mat, opdq);
+            for (size_t k = 0; k < op->strings.size(); k++) {
+                if (k + 1 < op->strings.size())
+                    prefetch_operands(op->strings[k + 1], lopt->ops, ropt->ops);
+                tensor_product_diagonal(op->strings[k], lopt, ropt, mat, opdq);
+            }
         } break;
         case OpTypes::Zero:
             break;
@@ -532,8 +641,11 @@ template <typename S> struct ArchivedTensorFunctions : TensorFunctions<S> {
         } break;
         case OpTypes::Sum: {
             shared_ptr<OpSum<S>> op = dynamic_pointer_cast<OpSum<S>>(expr);
-            for (auto &x : op->strings)
-                tensor_product(x, lop, rop, omat);
+            for (size_t k = 0; k < op->strings.size(); k++) {
+                if (k + 1 < op->strings.size())
+                    prefetch_operands(op->strings[k + 1], lop, rop);
+                tensor_product(op->strings[k], lop, rop, omat);
+            }
         } break;
         case OpTypes::Zero:
             break;
@@ -562,6 +674,7 @@ template <typename S> struct ArchivedTensorFunctions : TensorFunctions<S> {
                      const shared_ptr<SparseMatrix<S>> &mpst_bra,
                      const shared_ptr<SparseMatrix<S>> &mpst_ket,
                      shared_ptr<OperatorTensor<S>> &c) const override {
+        TracerScope _tr("left_rotate");
         for (auto &p : c->ops) {
             shared_ptr<OpElement<S>> op =
                 dynamic_pointer_cast<OpElement<S>>(p.first);
@@ -576,6 +689,7 @@ template <typename S> struct ArchivedTensorFunctions : TensorFunctions<S> {
         for (size_t i = 0; i < a->lmat->data.size(); i++)
             if (a->lmat->data[i]->get_type() != OpTypes::Zero) {
                 auto pa = abs_value(a->lmat->data[i]);
+                prefetch_next(a, a->lmat, i);
                 shared_ptr<SparseMatrix<S>> mata =
                     dynamic_pointer_cast<ArchivedSparseMatrix<S>>(a->ops.at(pa))
                         ->load_archive();
@@ -607,6 +721,7 @@ template <typename S> struct ArchivedTensorFunctions : TensorFunctions<S> {
                       const shared_ptr<SparseMatrix<S>> &mpst_bra,
                       const shared_ptr<SparseMatrix<S>> &mpst_ket,
                       shared_ptr<OperatorTensor<S>> &c) const override {
+        TracerScope _tr("right_rotate");
         for (auto &p : c->ops) {
             shared_ptr<OpElement<S>> op =
                 dynamic_pointer_cast<OpElement<S>>(p.first);
@@ -621,6 +736,7 @@ template <typename S> struct ArchivedTensorFunctions : TensorFunctions<S> {
         for (size_t i = 0; i < a->rmat->data.size(); i++)
             if (a->rmat->data[i]->get_type() != OpTypes::Zero) {
                 auto pa = abs_value(a->rmat->data[i]);
+                prefetch_next(a, a->rmat, i);
                 shared_ptr<SparseMatrix<S>> mata =
                     dynamic_pointer_cast<ArchivedSparseMatrix<S>>(a->ops.at(pa))
                         ->load_archive();
@@ -762,6 +878,16 @@ template <typename S> struct ArchivedTensorFunctions : TensorFunctions<S> {
         if (opf->seq->mode == SeqTypes::Auto)
             opf->seq->auto_perform();
     }
+    /** Delete unnecessary operators after numerical_transform. Nothing is
+     * done here, since the data of archived operators is not in memory.
+     * @param a Symbol lookup table for symbols in the symbolic tensors.
+     * @param names Operator names before numerical_transform.
+     * @param new_names Operator names after numerical_transform.
+     */
+    void post_numerical_transform(
+        const shared_ptr<OperatorTensor<S>> &a,
+        const shared_ptr<Symbolic<S>> &names,
+        const shared_ptr<Symbolic<S>> &new_names) const override {}
     /** Tensor product operation in left blocking: c = a x b.
      * @param a Operator a (left block tensor).
      * @param b Operator b (dot block single-site tensor).
@@ -778,6 +904,7 @@ template <typename S> struct ArchivedTensorFunctions : TensorFunctions<S> {
                        shared_ptr<OperatorTensor<S>> &c,
                        const shared_ptr<Symbolic<S>> &cexprs = nullptr,
                        OpNamesSet delayed = OpNamesSet()) const override {
+        TracerScope _tr("left_contract");
         if (a == nullptr)
             left_assign(b, c);
         else {
@@ -820,6 +947,7 @@ template <typename S> struct ArchivedTensorFunctions : TensorFunctions<S> {
                         shared_ptr<OperatorTensor<S>> &c,
                         const shared_ptr<Symbolic<S>> &cexprs = nullptr,
                         OpNamesSet delayed = OpNamesSet()) const override {
+        TracerScope _tr("right_contract");
         if (a == nullptr)
             right_assign(b, c);
         else {
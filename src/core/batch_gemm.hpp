@@ -28,10 +28,12 @@
 #endif
 #include <algorithm>
 #include <cassert>
+#include <cstring>
 #include <iomanip>
 #include <iostream>
 #include <map>
 #include <memory>
+#include <tuple>
 #include <utility>
 #include <vector>
 
@@ -50,6 +52,14 @@ extern void dgemm(const char *transa, const char *transb, const MKL_INT *m,
                   const double *a, const MKL_INT *lda, const double *b,
                   const MKL_INT *ldb, const double *beta, double *c,
                   const MKL_INT *ldc) noexcept;
+
+// matrix multiplication (single precision)
+// mat [c] = float [alpha] * mat [a] * mat [b] + float [beta] * mat [c]
+extern void sgemm(const char *transa, const char *transb, const MKL_INT *m,
+                  const MKL_INT *n, const MKL_INT *k, const float *alpha,
+                  const float *a, const MKL_INT *lda, const float *b,
+                  const MKL_INT *ldb, const float *beta, float *c,
+                  const MKL_INT *ldc) noexcept;
 }
 
 typedef enum { CblasRowMajor = 101, CblasColMajor = 102 } CBLAS_LAYOUT;
@@ -84,6 +94,84 @@ inline void cblas_dgemm_batch(
 
 #endif
 
+// Row-major [c] = alpha * [a](.T) x [b](.T) + beta * [c]
+// Plain loop kernel for tiny blocks, where the overhead of a BLAS call is
+// larger than the arithmetic. The inner loop runs over contiguous rows of
+// [b] and [c] when [b] is not transposed, so it can be vectorized
+inline void small_dgemm(bool conja, bool conjb, MKL_INT m, MKL_INT n,
+                        MKL_INT k, double alpha, const double *a, MKL_INT lda,
+                        const double *b, MKL_INT ldb, double beta, double *c,
+                        MKL_INT ldc) {
+    for (MKL_INT i = 0; i < m; i++) {
+        double *__restrict__ cr = c + (size_t)i * ldc;
+        if (beta == 0.0)
+            memset(cr, 0, sizeof(double) * n);
+        else if (beta != 1.0)
+            for (MKL_INT j = 0; j < n; j++)
+                cr[j] *= beta;
+        for (MKL_INT p = 0; p < k; p++) {
+            const double x =
+                alpha * (conja ? a[(size_t)p * lda + i] : a[(size_t)i * lda + p]);
+            if (!conjb) {
+                const double *__restrict__ br = b + (size_t)p * ldb;
+                for (MKL_INT j = 0; j < n; j++)
+                    cr[j] += x * br[j];
+            } else
+                for (MKL_INT j = 0; j < n; j++)
+                    cr[j] += x * b[(size_t)j * ldb + p];
+        }
+    }
+}
+
+// Whether a DGEMM shape should use small_dgemm
+inline bool is_small_dgemm(MKL_INT m, MKL_INT n, MKL_INT k) {
+    const MKL_INT sz = threading->small_gemm_size;
+    return m <= sz && n <= sz && k <= sz;
+}
+
+// Batched DGEMM on host, where groups of small shapes use small_dgemm
+// and the groups of other shapes are passed to cblas_dgemm_batch
+inline void host_dgemm_batch(
+    const CBLAS_LAYOUT Layout, const CBLAS_TRANSPOSE *TransA_Array,
+    const CBLAS_TRANSPOSE *TransB_Array, const MKL_INT *M_Array,
+    const MKL_INT *N_Array, const MKL_INT *K_Array, const double *alpha_Array,
+    const double **A_Array, const MKL_INT *lda_Array, const double **B_Array,
+    const MKL_INT *ldb_Array, const double *beta_Array, double **C_Array,
+    const MKL_INT *ldc_Array, const MKL_INT group_count,
+    const MKL_INT *group_size) {
+    if (threading->small_gemm_size == 0)
+        return cblas_dgemm_batch(Layout, TransA_Array, TransB_Array, M_Array,
+                                 N_Array, K_Array, alpha_Array, A_Array,
+                                 lda_Array, B_Array, ldb_Array, beta_Array,
+                                 C_Array, ldc_Array, group_count, group_size);
+    assert(Layout == CblasRowMajor);
+    // [igl, ig) is the current range of groups for cblas_dgemm_batch
+    MKL_INT igl = 0, il = 0;
+    for (MKL_INT ig = 0, i = 0; ig <= group_count; ig++) {
+        if (ig < group_count &&
+            !is_small_dgemm(M_Array[ig], N_Array[ig], K_Array[ig])) {
+            i += group_size[ig];
+            continue;
+        }
+        if (ig != igl)
+            cblas_dgemm_batch(Layout, TransA_Array + igl, TransB_Array + igl,
+                              M_Array + igl, N_Array + igl, K_Array + igl,
+                              alpha_Array + igl, A_Array + il, lda_Array + igl,
+                              B_Array + il, ldb_Array + igl, beta_Array + igl,
+                              C_Array + il, ldc_Array + igl, ig - igl,
+                              group_size + igl);
+        if (ig == group_count)
+            break;
+        for (MKL_INT j = 0; j < group_size[ig]; j++, i++)
+            small_dgemm(TransA_Array[ig] != CblasNoTrans,
+                        TransB_Array[ig] != CblasNoTrans, M_Array[ig],
+                        N_Array[ig], K_Array[ig], alpha_Array[ig], A_Array[i],
+                        lda_Array[ig], B_Array[i], ldb_Array[ig],
+                        beta_Array[ig], C_Array[i], ldc_Array[ig]);
+        igl = ig + 1, il = i;
+    }
+}
+
 inline void threaded_dgemm_batch(
     const CBLAS_LAYOUT Layout, const CBLAS_TRANSPOSE *TransA_Array,
     const CBLAS_TRANSPOSE *TransB_Array, const MKL_INT *M_Array,
@@ -111,11 +199,78 @@ inline void threaded_dgemm_batch(
         const MKL_INT lda = lda_Array[ig], ldb = ldb_Array[ig],
                       ldc = ldc_Array[ig];
         const MKL_INT gsize = group_size[ig];
-        dgemm(trb, tra, &n, &m, &k, &alpha, B_Array[i], &ldb, A_Array[i], &lda,
-              &beta, C_Array[i], &ldc);
+        if (is_small_dgemm(m, n, k))
+            small_dgemm(TransA_Array[ig] != CblasNoTrans,
+                        TransB_Array[ig] != CblasNoTrans, m, n, k, alpha,
+                        A_Array[i], lda, B_Array[i], ldb, beta, C_Array[i],
+                        ldc);
+        else
+            dgemm(trb, tra, &n, &m, &k, &alpha, B_Array[i], &ldb, A_Array[i],
+                  &lda, &beta, C_Array[i], &ldc);
+    }
+}
+
+// Batched SGEMM with the same groups as a batched DGEMM
+// (alpha and beta are given in double precision)
+inline void sgemm_batch(const CBLAS_TRANSPOSE *TransA_Array,
+                        const CBLAS_TRANSPOSE *TransB_Array,
+                        const MKL_INT *M_Array, const MKL_INT *N_Array,
+                        const MKL_INT *K_Array, const double *alpha_Array,
+                        const float **A_Array, const MKL_INT *lda_Array,
+                        const float **B_Array, const MKL_INT *ldb_Array,
+                        const double *beta_Array, float **C_Array,
+                        const MKL_INT *ldc_Array, const MKL_INT group_count,
+                        const MKL_INT *group_size) {
+    vector<float> falpha(alpha_Array, alpha_Array + group_count);
+    vector<float> fbeta(beta_Array, beta_Array + group_count);
+#ifdef _HAS_INTEL_MKL
+    if (!(threading->type & ThreadingTypes::Quanta)) {
+        cblas_sgemm_batch(CblasRowMajor, TransA_Array, TransB_Array, M_Array,
+                          N_Array, K_Array, falpha.data(), A_Array, lda_Array,
+                          B_Array, ldb_Array, fbeta.data(), C_Array, ldc_Array,
+                          group_count, group_size);
+        return;
+    }
+#endif
+    vector<MKL_INT> gidxs;
+    for (MKL_INT ig = 0; ig < group_count; ig++)
+        gidxs.insert(gidxs.end(), group_size[ig], ig);
+    int ntq = (threading->type & ThreadingTypes::Quanta)
+                  ? threading->activate_quanta()
+                  : 1;
+#pragma omp parallel for schedule(dynamic) num_threads(ntq)
+    for (MKL_INT i = 0; i < (MKL_INT)gidxs.size(); i++) {
+        const MKL_INT ig = gidxs[i];
+        const char *tra = TransA_Array[ig] == CblasNoTrans ? "n" : "t";
+        const char *trb = TransB_Array[ig] == CblasNoTrans ? "n" : "t";
+        const MKL_INT m = M_Array[ig], n = N_Array[ig], k = K_Array[ig];
+        const MKL_INT lda = lda_Array[ig], ldb = ldb_Array[ig],
+                      ldc = ldc_Array[ig];
+        sgemm(trb, tra, &n, &m, &k, &falpha[ig], B_Array[i], &ldb, A_Array[i],
+              &lda, &fbeta[ig], C_Array[i], &ldc);
     }
 }
 
+// Signature of batched DGEMM implementations (same as cblas_dgemm_batch)
+typedef void (*dgemm_batch_t)(
+    const CBLAS_LAYOUT Layout, const CBLAS_TRANSPOSE *TransA_Array,
+    const CBLAS_TRANSPOSE *TransB_Array, const MKL_INT *M_Array,
+    const MKL_INT *N_Array, const MKL_INT *K_Array, const double *alpha_Array,
+    const double **A_Array, const MKL_INT *lda_Array, const double **B_Array,
+    const MKL_INT *ldb_Array, const double *beta_Array, double **C_Array,
+    const MKL_INT *ldc_Array, const MKL_INT group_count,
+    const MKL_INT *group_size);
+
+// External batched DGEMM used when threading->gemm_backend is
+// GEMMBackendTypes::External. It is called with host pointers and must have
+// finished writing all outputs when it returns. Each call contains groups
+// without output conflicts, so the whole call can be launched as one device
+// batch (for example cublasDgemmBatched for each group)
+inline auto dgemm_batch_backend_() -> dgemm_batch_t & {
+    static dgemm_batch_t backend = nullptr;
+    return backend;
+}
+
 inline void single_dgemm(
     const CBLAS_LAYOUT Layout, const CBLAS_TRANSPOSE *TransA_Array,
     const CBLAS_TRANSPOSE *TransB_Array, const MKL_INT *M_Array,
@@ -130,7 +285,12 @@ inline void single_dgemm(
     const double alpha = alpha_Array[ig] * scale, beta = beta_Array[ig];
     const MKL_INT lda = lda_Array[ig], ldb = ldb_Array[ig], ldc = ldc_Array[ig];
     const MKL_INT gsize = group_size[ig];
-    dgemm(trb, tra, &n, &m, &k, &alpha, B, &ldb, A, &lda, &beta, C, &ldc);
+    if (is_small_dgemm(m, n, k))
+        small_dgemm(TransA_Array[ig] != CblasNoTrans,
+                    TransB_Array[ig] != CblasNoTrans, m, n, k, alpha, A, lda,
+                    B, ldb, beta, C, ldc);
+    else
+        dgemm(trb, tra, &n, &m, &k, &alpha, B, &ldb, A, &lda, &beta, C, &ldc);
 }
 
 // The parameters for a series of DGEMM operations
@@ -141,6 +301,9 @@ struct BatchGEMM {
     vector<double> alpha, beta;
     vector<const double *> a, b;
     vector<double *> c;
+    // single precision copies of a, b and c (see BatchGEMMSeq::prepare_single)
+    vector<const float *> sa, sb;
+    vector<float *> sc;
     size_t work, nflop;
     BatchGEMM() : work(0), nflop(0) {}
     void resize(size_t nn) {
@@ -352,30 +515,83 @@ struct BatchGEMM {
     // Execute DGEMM operation groups from index ii to ii + nn
     void perform(MKL_INT ii = 0, MKL_INT kk = 0, MKL_INT nn = 0) {
         if (nn != 0 || gp.size() != 0) {
-            if (threading->type & ThreadingTypes::Quanta)
+            KernelCounters &kc = kernel_counters_();
+            Timer t;
+            if (kc.enabled)
+                t.get_time();
+            if (threading->gemm_backend == GEMMBackendTypes::External) {
+                if (dgemm_batch_backend_() == nullptr)
+                    throw runtime_error(
+                        "BatchGEMM::perform: no external backend registered.");
+                dgemm_batch_backend_()(
+                    layout, &ta[ii], &tb[ii], &m[ii], &n[ii], &k[ii],
+                    &alpha[ii], &a[kk], &lda[ii], &b[kk], &ldb[ii], &beta[ii],
+                    &c[kk], &ldc[ii], nn == 0 ? (MKL_INT)gp.size() : nn,
+                    &gp[ii]);
+            } else if (threading->type & ThreadingTypes::Quanta)
                 threaded_dgemm_batch(
                     layout, &ta[ii], &tb[ii], &m[ii], &n[ii], &k[ii],
                     &alpha[ii], &a[kk], &lda[ii], &b[kk], &ldb[ii], &beta[ii],
                     &c[kk], &ldc[ii], nn == 0 ? (MKL_INT)gp.size() : nn,
                     &gp[ii]);
             else
-                cblas_dgemm_batch(layout, &ta[ii], &tb[ii], &m[ii], &n[ii],
-                                  &k[ii], &alpha[ii], &a[kk], &lda[ii], &b[kk],
-                                  &ldb[ii], &beta[ii], &c[kk], &ldc[ii],
-                                  nn == 0 ? (MKL_INT)gp.size() : nn, &gp[ii]);
+                host_dgemm_batch(layout, &ta[ii], &tb[ii], &m[ii], &n[ii],
+                                 &k[ii], &alpha[ii], &a[kk], &lda[ii], &b[kk],
+                                 &ldb[ii], &beta[ii], &c[kk], &ldc[ii],
+                                 nn == 0 ? (MKL_INT)gp.size() : nn, &gp[ii]);
+            if (kc.enabled)
+                count_kernel(ii, nn == 0 ? (MKL_INT)gp.size() : nn,
+                             t.get_time());
+        }
+    }
+    // Add FLOP and bytes of operation groups from index ii to ii + nn
+    // to kernel counters
+    void count_kernel(MKL_INT ii, MKL_INT nn, double t) const {
+        uint64_t nflop = 0, nbytes = 0;
+        for (MKL_INT i = ii; i < ii + nn; i++) {
+            nflop += MatrixFunctions::gemm_flop(m[i], n[i], k[i]) * gp[i];
+            nbytes += MatrixFunctions::gemm_bytes(m[i], n[i], k[i]) * gp[i];
         }
+        kernel_counters_().add(KernelTypes::BatchGEMM, nflop, nbytes, t);
+    }
+    // Execute operation groups from index ii to ii + nn as SGEMM
+    // using the single precision copies of the arrays
+    void perform_float(MKL_INT ii = 0, MKL_INT kk = 0, MKL_INT nn = 0) {
+        if (nn != 0 || gp.size() != 0)
+            sgemm_batch(&ta[ii], &tb[ii], &m[ii], &n[ii], &k[ii], &alpha[ii],
+                        &sa[kk], &lda[ii], &sb[kk], &ldb[ii], &beta[ii],
+                        &sc[kk], &ldc[ii], nn == 0 ? (MKL_INT)gp.size() : nn,
+                        &gp[ii]);
     }
     inline void perform_single(MKL_INT ii, const double *a, const double *b,
                                double *c, double scale) {
+        KernelCounters &kc = kernel_counters_();
+        Timer t;
+        if (kc.enabled)
+            t.get_time();
         single_dgemm(layout, &ta[ii], &tb[ii], &m[ii], &n[ii], &k[ii],
                      &alpha[ii], a, &lda[ii], b, &ldb[ii], &beta[ii], c,
                      &ldc[ii], &gp[ii], scale);
+        if (kc.enabled)
+            kc.add(KernelTypes::BatchGEMM,
+                   MatrixFunctions::gemm_flop(m[ii], n[ii], k[ii]),
+                   MatrixFunctions::gemm_bytes(m[ii], n[ii], k[ii]),
+                   t.get_time());
     }
     inline void perform_single(MKL_INT ii, const double *a, const double *b,
                                double *c) {
+        KernelCounters &kc = kernel_counters_();
+        Timer t;
+        if (kc.enabled)
+            t.get_time();
         single_dgemm(layout, &ta[ii], &tb[ii], &m[ii], &n[ii], &k[ii],
                      &alpha[ii], a, &lda[ii], b, &ldb[ii], &beta[ii], c,
                      &ldc[ii], &gp[ii]);
+        if (kc.enabled)
+            kc.add(KernelTypes::BatchGEMM,
+                   MatrixFunctions::gemm_flop(m[ii], n[ii], k[ii]),
+                   MatrixFunctions::gemm_bytes(m[ii], n[ii], k[ii]),
+                   t.get_time());
     }
     void clear() {
         ta.clear(), tb.clear();
@@ -383,6 +599,7 @@ struct BatchGEMM {
         lda.clear(), ldb.clear(), ldc.clear();
         alpha.clear(), beta.clear();
         a.clear(), b.clear(), c.clear();
+        sa.clear(), sb.clear(), sc.clear();
         work = nflop = 0;
     }
     friend ostream &operator<<(ostream &os, const BatchGEMM &c) {
@@ -429,10 +646,30 @@ struct BatchGEMMSeq {
     vector<BatchGEMMRef> refs;
     size_t cumulative_nflop = 0;
     size_t max_batch_flops = 1LU << 30;
-    size_t max_work, max_rwork;
+    size_t max_work = 0, max_rwork = 0;
     double *work, *rwork;
     SeqTypes mode;
     bool no_check = true;
+    // input and output shifts currently applied to prepared batches
+    size_t applied_cshift = 0, applied_vshift = 0;
+    // Davidson residual (squared norm) above which the prepared batches
+    // (in automatic mode) are performed in single precision. Zero to disable
+    double single_prec_thrd = 0.0;
+    // whether operator() currently uses single precision
+    bool single_prec = false;
+    // single precision operands, work arrays, input and output vectors
+    shared_ptr<vector<float>> sdata;
+    float *swork = nullptr, *scin = nullptr, *svout = nullptr;
+    // whether an intermediate (a x ket) shared by several rotations
+    // is computed only once (not used in tasked mode)
+    bool reuse_work = true;
+    // intermediates in current batch: (a, ket) => (work, GEMM index)
+    map<tuple<const double *, MKL_INT, MKL_INT, const double *, MKL_INT,
+              MKL_INT, bool>,
+        pair<double *, size_t>>
+        work_cache;
+    // for each GEMM in batch[0], the last GEMM in batch[1] reading its output
+    vector<size_t> work_reach;
     BatchGEMMSeq(size_t max_batch_flops = 1LU << 30,
                  SeqTypes mode = SeqTypes::None)
         : max_batch_flops(max_batch_flops), mode(mode), vdata(nullptr) {
@@ -447,6 +684,11 @@ struct BatchGEMMSeq {
         seq->batch.push_back(make_shared<BatchGEMM>());
         seq->batch.push_back(make_shared<BatchGEMM>());
         seq->cjc.clear();
+        seq->applied_cshift = seq->applied_vshift = 0;
+        seq->single_prec = false;
+        seq->sdata = nullptr;
+        seq->work_cache.clear();
+        seq->work_reach.clear();
         return seq;
     }
     // [a] = cfactor * [a] + scale * [b]
@@ -471,6 +713,26 @@ struct BatchGEMMSeq {
                 double scale) {
         MatrixRef work((double *)0 + batch[0]->work, a.m,
                        conj_ket ? ket.m : ket.n);
+        if (reuse_work && !(mode & SeqTypes::Tasked)) {
+            auto key =
+                make_tuple(a.data, a.m, a.n, ket.data, ket.m, ket.n, conj_ket);
+            auto it = work_cache.find(key);
+            if (it != work_cache.end()) {
+                // empty GEMM to keep the i-th GEMMs in batch[0] and batch[1]
+                // paired
+                batch[0]->dgemm(false, false, 0, 0, 0, 1.0, a.data, 1,
+                                ket.data, 1, 0.0, it->second.first, 1);
+                batch[1]->multiply(
+                    bra, conj_bra,
+                    MatrixRef(it->second.first, work.m, work.n), false, c,
+                    scale, 1.0);
+                if (work_reach.size() <= it->second.second)
+                    work_reach.resize(it->second.second + 1, 0);
+                work_reach[it->second.second] = batch[1]->gp.size() - 1;
+                return;
+            }
+            work_cache[key] = make_pair(work.data, batch[0]->gp.size());
+        }
         batch[0]->multiply(a, false, ket, conj_ket, work, 1.0, 0.0);
         batch[1]->multiply(bra, conj_bra, work, false, c, scale, 1.0);
         if (mode & SeqTypes::Tasked)
@@ -650,18 +912,21 @@ struct BatchGEMMSeq {
         // no need to divide
         if (max_batch_flops == 0) {
             if (batch[0]->gp.size() != 0)
-                refs.push_back(BatchGEMMRef(batch[0], batch[0]->nflop,
-                                            batch[0]->work, 0, 0,
-                                            (MKL_INT)batch[0]->gp.size(), 0));
-            refs.push_back(BatchGEMMRef(batch[1], batch[1]->nflop,
-                                        batch[1]->work, 0, 0,
-                                        (MKL_INT)batch[1]->gp.size(), 0));
+                refs.push_back(BatchGEMMRef(
+                    batch[0], batch[0]->nflop, batch[0]->work, 0, 0,
+                    (MKL_INT)batch[0]->gp.size(), (MKL_INT)batch[0]->c.size()));
+            refs.push_back(BatchGEMMRef(
+                batch[1], batch[1]->nflop, batch[1]->work, 0, 0,
+                (MKL_INT)batch[1]->gp.size(), (MKL_INT)batch[1]->c.size()));
             return;
         }
-        size_t cur = 0, cur0 = 0, cwork = 0, pwork = 0;
+        size_t cur = 0, cur0 = 0, cwork = 0, pwork = 0, reach = 0;
         MKL_INT ip = 0, kp = 0;
         for (MKL_INT i = 0, k = 0; i < batch[1]->gp.size();
              k += batch[1]->gp[i++]) {
+            // a reused intermediate must stay in the batch where it is formed
+            if (i < work_reach.size())
+                reach = max(reach, work_reach[i]);
             cur += (size_t)batch[1]->m[i] * batch[1]->n[i] * batch[1]->k[i] *
                    batch[1]->gp[i];
             if (batch[0]->gp.size() != 0) {
@@ -669,7 +934,8 @@ struct BatchGEMMSeq {
                         batch[0]->k[i] * batch[0]->gp[i];
                 cwork += (size_t)batch[0]->m[i] * batch[0]->n[i];
             }
-            if (max_batch_flops != 0 && cur >= max_batch_flops) {
+            if (max_batch_flops != 0 && cur >= max_batch_flops &&
+                reach <= (size_t)i) {
                 if (batch[0]->gp.size() != 0)
                     refs.push_back(BatchGEMMRef(batch[0], cur0, cwork - pwork,
                                                 ip, kp, i + 1 - ip,
@@ -901,7 +1167,123 @@ struct BatchGEMMSeq {
         }
     }
     // Deallocate work arrays
-    void deallocate() { vdata = nullptr; }
+    void deallocate() { vdata = nullptr, sdata = nullptr; }
+    // Build single precision copies of the prepared batches (in automatic
+    // mode) for input vector (c) and output vector (v) of the current
+    // pointers. All other operands (such as renormalized operators) are
+    // converted once here, and the copies of the two vectors are updated
+    // in each perform_single_prec. Writes to the output vector must
+    // accumulate (beta = 1)
+    void prepare_single(const MatrixRef &c, const MatrixRef &v) {
+        vector<shared_ptr<BatchGEMM>> bs = batch;
+        bs.insert(bs.end(), post_batch.begin(), post_batch.end());
+        const double *cp = c.data, *vp = v.data;
+        const double *wp = vdata == nullptr ? nullptr : vdata->data();
+        const size_t csz = c.size(), vsz = v.size();
+        const size_t wsz = vdata == nullptr ? 0 : vdata->size();
+        // 0 = other, 1 = input, 2 = output, 3 = work
+        auto region = [cp, vp, wp, csz, vsz, wsz](const double *p) -> int {
+            return p >= cp && p < cp + csz
+                       ? 1
+                       : (p >= vp && p < vp + vsz
+                              ? 2
+                              : (p >= wp && p < wp + wsz ? 3 : 0));
+        };
+        vector<pair<const double *, const double *>> ivs;
+        for (auto &b : bs)
+            for (size_t ig = 0, i = 0; ig < b->gp.size(); ig++) {
+                const bool ta = b->ta[ig] != CblasNoTrans;
+                const bool tb = b->tb[ig] != CblasNoTrans;
+                const size_t la = (size_t)((ta ? b->k[ig] : b->m[ig]) - 1) *
+                                      b->lda[ig] +
+                                  (ta ? b->m[ig] : b->k[ig]);
+                const size_t lb = (size_t)((tb ? b->n[ig] : b->k[ig]) - 1) *
+                                      b->ldb[ig] +
+                                  (tb ? b->k[ig] : b->n[ig]);
+                for (MKL_INT j = 0; j < b->gp[ig]; j++, i++) {
+                    if (region(b->a[i]) == 0)
+                        ivs.push_back(make_pair(b->a[i], b->a[i] + la));
+                    if (region(b->b[i]) == 0)
+                        ivs.push_back(make_pair(b->b[i], b->b[i] + lb));
+                    assert(region(b->c[i]) != 0);
+                    assert(region(b->c[i]) != 2 || b->beta[ig] == 1.0);
+                }
+            }
+        // merge overlapping intervals of other operands
+        sort(ivs.begin(), ivs.end());
+        vector<pair<const double *, const double *>> mivs;
+        vector<size_t> offs;
+        size_t nst = 0;
+        for (auto &r : ivs)
+            if (mivs.size() != 0 && r.first <= mivs.back().second)
+                mivs.back().second = max(mivs.back().second, r.second);
+            else
+                mivs.push_back(r);
+        offs.reserve(mivs.size());
+        for (auto &r : mivs)
+            offs.push_back(nst), nst += r.second - r.first;
+        sdata = make_shared<vector<float>>(nst + wsz + csz + vsz);
+        swork = sdata->data() + nst;
+        scin = swork + wsz, svout = scin + csz;
+        int ntg = threading->activate_global();
+#pragma omp parallel for schedule(dynamic) num_threads(ntg)
+        for (int ir = 0; ir < (int)mivs.size(); ir++)
+            for (const double *p = mivs[ir].first; p < mivs[ir].second; p++)
+                (*sdata)[offs[ir] + (p - mivs[ir].first)] = (float)*p;
+        threading->activate_normal();
+        auto tr = [&](const double *p) -> float * {
+            switch (region(p)) {
+            case 1:
+                return scin + (p - cp);
+            case 2:
+                return svout + (p - vp);
+            case 3:
+                return swork + (p - wp);
+            default:
+                size_t ir =
+                    upper_bound(mivs.begin(), mivs.end(),
+                                make_pair(p, (const double *)nullptr),
+                                [](const pair<const double *, const double *> &x,
+                                   const pair<const double *, const double *> &y) {
+                                    return x.first < y.first;
+                                }) -
+                    mivs.begin() - 1;
+                return sdata->data() + offs[ir] + (p - mivs[ir].first);
+            }
+        };
+        for (auto &b : bs) {
+            b->sa.resize(b->a.size()), b->sb.resize(b->b.size());
+            b->sc.resize(b->c.size());
+            for (size_t i = 0; i < b->a.size(); i++)
+                b->sa[i] = tr(b->a[i]), b->sb[i] = tr(b->b[i]),
+                b->sc[i] = tr(b->c[i]);
+        }
+    }
+    // Perform prepared batches in single precision
+    // (in automatic mode), [v] += H [c]
+    void perform_single_prec(const MatrixRef &c, const MatrixRef &v) {
+        if (sdata == nullptr)
+            prepare_single(c, v);
+        const size_t csz = c.size(), vsz = v.size();
+        assert(svout + vsz == sdata->data() + sdata->size());
+        for (size_t i = 0; i < csz; i++)
+            scin[i] = (float)c.data[i];
+        memset(svout, 0, sizeof(float) * vsz);
+        float *srwork = swork + max_work;
+        size_t ipost = 0;
+        for (auto b : refs) {
+            if (b.rwork != 0)
+                memset(srwork, 0, sizeof(float) * b.rwork);
+            cumulative_nflop += b.nflop;
+            if (b.n != 0)
+                b.batch->perform_float(b.i, b.k, b.n);
+            for (size_t ib = ipost; ib < ipost + b.ipost; ib++)
+                post_batch[ib]->perform_float();
+            ipost += b.ipost;
+        }
+        for (size_t i = 0; i < vsz; i++)
+            v.data[i] += svout[i];
+    }
     // Perform non-confliciting batched DGEMM
     void simple_perform() {
         divide_batch();
@@ -912,11 +1294,26 @@ struct BatchGEMMSeq {
         deallocate();
         clear();
     }
+    // FLOP count of each task in tasked mode
+    // (a task is the i-th GEMM of batch[1], after the i-th GEMM of batch[0])
+    vector<size_t> task_costs() const {
+        vector<size_t> costs(batch[1]->c.size());
+        const bool b0 = batch[0]->c.size() != 0;
+        for (size_t i = 0; i < costs.size(); i++) {
+            costs[i] = (size_t)batch[1]->m[i] * batch[1]->n[i] * batch[1]->k[i];
+            if (b0)
+                costs[i] +=
+                    (size_t)batch[0]->m[i] * batch[0]->n[i] * batch[0]->k[i];
+        }
+        return costs;
+    }
     // SeqTypes::Auto:
     //   Perform possibly confliciting batched DGEMM
     //   An analysis is performed to automatically resolve conflicts
     // SeqTypes::Tasked:
     //   Each thread write to thread-copied outputs
+    //   (or to threading->deterministic_slots copies, each filled by a fixed
+    //   range of tasks in order, for results independent of thread count)
     void auto_perform(const MatrixRef &v = MatrixRef(nullptr, 0, 0)) {
         if (mode == SeqTypes::Auto) {
             prepare();
@@ -926,24 +1323,36 @@ struct BatchGEMMSeq {
             clear();
         } else if (mode & SeqTypes::Tasked) {
             int ntop = threading->activate_operator();
-            vector<MatrixRef> vts(ntop, v);
+            const int nslot = threading->get_reduce_slots(ntop);
+            vector<MatrixRef> vts(nslot, v);
             assert(batch[0]->c.size() == 0);
+            WorkStealingSchedule sched(task_costs(), nslot,
+                                       threading->deterministic_slots == 0);
 #pragma omp parallel num_threads(ntop)
             {
                 int tid = threading->get_thread_id();
                 shared_ptr<VectorAllocator<double>> d_alloc =
                     make_shared<VectorAllocator<double>>();
-                if (tid != 0)
-                    vts[tid].allocate(d_alloc);
-                size_t t_vshift = vts[tid].data - v.data;
-#pragma omp for schedule(static)
-                for (int i = 0; i < (int)batch[1]->c.size(); i++)
-                    batch[1]->perform_single(i, batch[1]->a[i], batch[1]->b[i],
-                                             batch[1]->c[i] + t_vshift);
+                for (int is = tid == 0 ? ntop : tid; is < nslot; is += ntop)
+                    vts[is].allocate(d_alloc);
+                for (int is = tid; is < nslot; is += ntop) {
+                    TracerScope _tr("tasks", tid);
+                    size_t t_vshift = vts[is].data - v.data;
+                    for (size_t i = 0; sched.next(is, i);)
+                        batch[1]->perform_single((MKL_INT)i, batch[1]->a[i],
+                                                 batch[1]->b[i],
+                                                 batch[1]->c[i] + t_vshift);
+                }
+#pragma omp barrier
+                TracerScope _trr("reduce", tid);
+                if (threading->reduce_chunk != 0)
+                    chunked_reduce(vts);
+                else {
 #pragma omp single
-                parallel_reduce(vts, 0, ntop);
-                if (tid != 0)
-                    vts[tid].deallocate(d_alloc);
+                    parallel_reduce(vts, 0, nslot);
+                }
+                for (int is = tid == 0 ? ntop : tid; is < nslot; is += ntop)
+                    vts[is].deallocate(d_alloc);
             }
             threading->activate_normal();
             cumulative_nflop += batch[1]->nflop;
@@ -974,6 +1383,7 @@ struct BatchGEMMSeq {
     }
     // Directly perform batched DGEMM
     void perform() {
+        TracerScope _tr("batch_gemm_seq", refs.size());
         size_t ipost = 0;
         for (auto b : refs) {
             if (b.rwork != 0)
@@ -986,6 +1396,14 @@ struct BatchGEMMSeq {
         }
         assert(ipost == post_batch.size());
     }
+    // mats[0] += mats[1] + ... by all threads of the parallel region
+    void chunked_reduce(const vector<MatrixRef> &mats) const {
+        vector<double *> xs(mats.size());
+        for (size_t i = 0; i < mats.size(); i++)
+            xs[i] = mats[i].data;
+        MatrixFunctions::chunked_reduce(xs, mats[0].size(),
+                                        threading->reduce_chunk);
+    }
     void parallel_reduce(const vector<MatrixRef> &mats, int i, int j) const {
         assert(j > i);
         if (j - i == 1)
@@ -1003,6 +1421,30 @@ struct BatchGEMMSeq {
 #endif
         MatrixFunctions::iadd(mats[i], mats[m], 1.0);
     }
+    // Point the prepared batches to new input (c) and output (v) vectors
+    // (in automatic mode). Pointers are moved by the difference to the
+    // vectors of the previous call and are not restored after performing,
+    // so that the prepared batches are reused as they are and repeated
+    // multiplications (as in Davidson) only update pointers that change
+    void rebase(size_t cshift, size_t vshift) {
+        if (cshift != applied_cshift) {
+            const ptrdiff_t d = (ptrdiff_t)(cshift - applied_cshift);
+            for (size_t i = 0; i < batch[0]->a.size(); i++)
+                batch[0]->a[i] += d;
+            applied_cshift = cshift;
+        }
+        if (vshift != applied_vshift) {
+            const ptrdiff_t d = (ptrdiff_t)(vshift - applied_vshift);
+            size_t ipost = 0;
+            for (auto &b : refs) {
+                if (b.ipost != 0)
+                    for (auto &pc : post_batch[ipost + b.ipost - 1]->c)
+                        pc += d;
+                ipost += b.ipost;
+            }
+            applied_vshift = vshift;
+        }
+    }
     // Matrix multiply vector (c) => vector (v)
     // (in automatic mode)
     void operator()(const MatrixRef &c, const MatrixRef &v,
@@ -1011,56 +1453,54 @@ struct BatchGEMMSeq {
         size_t vshift = v.data - (double *)0;
         if (mode == SeqTypes::Auto) {
             assert(scale == 1.0);
-            for (size_t i = 0; i < batch[0]->a.size(); i++)
-                batch[0]->a[i] += cshift;
-            size_t ipost = 0;
-            for (auto b : refs) {
-                if (b.ipost != 0)
-                    for (size_t i = 0;
-                         i < post_batch[ipost + b.ipost - 1]->c.size(); i++)
-                        post_batch[ipost + b.ipost - 1]->c[i] += vshift;
-                ipost += b.ipost;
-            }
-            perform();
-            for (size_t i = 0; i < batch[0]->a.size(); i++)
-                batch[0]->a[i] -= cshift;
-            ipost = 0;
-            for (auto b : refs) {
-                if (b.ipost != 0)
-                    for (size_t i = 0;
-                         i < post_batch[ipost + b.ipost - 1]->c.size(); i++)
-                        post_batch[ipost + b.ipost - 1]->c[i] -= vshift;
-                ipost += b.ipost;
-            }
+            rebase(cshift, vshift);
+            if (single_prec)
+                perform_single_prec(c, v);
+            else
+                perform();
         } else if (mode & SeqTypes::Tasked) {
             int ntop = threading->activate_operator();
-            vector<MatrixRef> vts(ntop, v);
+            const int nslot = threading->get_reduce_slots(ntop);
+            vector<MatrixRef> vts(nslot, v);
             vector<MatrixRef> works(ntop,
                                     MatrixRef(nullptr, (MKL_INT)max_work, 1));
             if (batch[0]->c.size() == 0 && batch[1]->c.size() == 0)
                 return;
             assert(max_rwork == 0 && max_work != 0);
+            assert(batch[0]->c.size() == batch[1]->c.size());
+            WorkStealingSchedule sched(task_costs(), nslot,
+                                       threading->deterministic_slots == 0);
 #pragma omp parallel num_threads(ntop)
             {
                 int tid = threading->get_thread_id();
                 shared_ptr<VectorAllocator<double>> d_alloc =
                     make_shared<VectorAllocator<double>>();
-                if (tid != 0)
-                    vts[tid].allocate(d_alloc);
+                for (int is = tid == 0 ? ntop : tid; is < nslot; is += ntop)
+                    vts[is].allocate(d_alloc);
                 works[tid].allocate(d_alloc);
-                size_t t_vshift = vts[tid].data - (double *)0;
-#pragma omp for schedule(static)
-                for (int i = 0; i < (int)batch[0]->c.size(); i++) {
-                    batch[0]->perform_single(i, batch[0]->a[i] + cshift,
-                                             batch[0]->b[i], works[tid].data);
-                    batch[1]->perform_single(i, batch[1]->a[i], works[tid].data,
-                                             batch[1]->c[i] + t_vshift, scale);
+                for (int is = tid; is < nslot; is += ntop) {
+                    TracerScope _tr("tasks", tid);
+                    size_t t_vshift = vts[is].data - (double *)0;
+                    for (size_t i = 0; sched.next(is, i);) {
+                        batch[0]->perform_single(
+                            (MKL_INT)i, batch[0]->a[i] + cshift,
+                            batch[0]->b[i], works[tid].data);
+                        batch[1]->perform_single(
+                            (MKL_INT)i, batch[1]->a[i], works[tid].data,
+                            batch[1]->c[i] + t_vshift, scale);
+                    }
                 }
+#pragma omp barrier
+                TracerScope _trr("reduce", tid);
+                if (threading->reduce_chunk != 0)
+                    chunked_reduce(vts);
+                else {
 #pragma omp single
-                parallel_reduce(vts, 0, ntop);
+                    parallel_reduce(vts, 0, nslot);
+                }
                 works[tid].deallocate(d_alloc);
-                if (tid != 0)
-                    vts[tid].deallocate(d_alloc);
+                for (int is = tid == 0 ? ntop : tid; is < nslot; is += ntop)
+                    vts[is].deallocate(d_alloc);
             }
             threading->activate_normal();
             cumulative_nflop += batch[0]->nflop;
@@ -1068,6 +1508,113 @@ struct BatchGEMMSeq {
         } else
             assert(false);
     }
+    // Perform refs[ib:jb + 1] and their post batches (starting at ipost)
+    // with the input and output vectors moved by dc and dv (in automatic mode)
+    void perform_refs(size_t ib, size_t jb, size_t ipost, ptrdiff_t dc,
+                      ptrdiff_t dv) {
+        for (size_t ir = ib, ip = ipost; ir <= jb; ip += refs[ir++].ipost) {
+            BatchGEMMRef &b = refs[ir];
+            if (dc != 0 && b.batch == batch[0])
+                for (MKL_INT i = b.k; i < b.k + b.nk; i++)
+                    batch[0]->a[i] += dc;
+            if (dv != 0 && b.ipost != 0)
+                for (auto &pc : post_batch[ip + b.ipost - 1]->c)
+                    pc += dv;
+            if (b.rwork != 0)
+                memset(rwork, 0, sizeof(double) * b.rwork);
+            cumulative_nflop += b.nflop;
+            b.perform();
+            for (size_t k = ip; k < ip + b.ipost; k++)
+                post_batch[k]->perform();
+            if (dc != 0 && b.batch == batch[0])
+                for (MKL_INT i = b.k; i < b.k + b.nk; i++)
+                    batch[0]->a[i] -= dc;
+            if (dv != 0 && b.ipost != 0)
+                for (auto &pc : post_batch[ip + b.ipost - 1]->c)
+                    pc -= dv;
+        }
+    }
+    // Matrix multiply several vectors (cs) => (vs)
+    // (in automatic or tasked mode)
+    // Each batch (or task) is performed for all vectors in turn, so that its
+    // operator blocks are read once from memory for the whole panel
+    void operator()(const vector<MatrixRef> &cs, const vector<MatrixRef> &vs) {
+        assert(cs.size() == vs.size());
+        const size_t nv = cs.size();
+        if (nv == 0)
+            return;
+        if (mode == SeqTypes::Auto && !single_prec) {
+            rebase(cs[0].data - (double *)0, vs[0].data - (double *)0);
+            size_t ipost = 0;
+            for (size_t ib = 0, jb = 0; ib < refs.size(); ib = ++jb) {
+                // a batch of batch[1] closes each group of batches
+                while (refs[jb].batch != batch[1])
+                    jb++;
+                for (size_t j = 0; j < nv; j++)
+                    perform_refs(ib, jb, ipost, cs[j].data - cs[0].data,
+                                 vs[j].data - vs[0].data);
+                for (size_t ir = ib; ir <= jb; ir++)
+                    ipost += refs[ir].ipost;
+            }
+            assert(ipost == post_batch.size());
+        } else if (mode & SeqTypes::Tasked) {
+            if (batch[0]->c.size() == 0 && batch[1]->c.size() == 0)
+                return;
+            assert(max_rwork == 0 && max_work != 0);
+            assert(batch[0]->c.size() == batch[1]->c.size());
+            int ntop = threading->activate_operator();
+            const int nslot = threading->get_reduce_slots(ntop);
+            // thread-private outputs for each vector
+            vector<vector<MatrixRef>> vts(nv);
+            for (size_t j = 0; j < nv; j++)
+                vts[j].resize(nslot, vs[j]);
+            vector<MatrixRef> works(ntop,
+                                    MatrixRef(nullptr, (MKL_INT)max_work, 1));
+            WorkStealingSchedule sched(task_costs(), nslot,
+                                       threading->deterministic_slots == 0);
+#pragma omp parallel num_threads(ntop)
+            {
+                int tid = threading->get_thread_id();
+                shared_ptr<VectorAllocator<double>> d_alloc =
+                    make_shared<VectorAllocator<double>>();
+                for (int is = tid == 0 ? ntop : tid; is < nslot; is += ntop)
+                    for (size_t j = 0; j < nv; j++)
+                        vts[j][is].allocate(d_alloc);
+                works[tid].allocate(d_alloc);
+                for (int is = tid; is < nslot; is += ntop) {
+                    TracerScope _tr("tasks", tid);
+                    for (size_t i = 0; sched.next(is, i);)
+                        for (size_t j = 0; j < nv; j++) {
+                            batch[0]->perform_single(
+                                (MKL_INT)i,
+                                batch[0]->a[i] + (cs[j].data - (double *)0),
+                                batch[0]->b[i], works[tid].data);
+                            batch[1]->perform_single(
+                                (MKL_INT)i, batch[1]->a[i], works[tid].data,
+                                batch[1]->c[i] +
+                                    (vts[j][is].data - (double *)0));
+                        }
+                }
+#pragma omp barrier
+                TracerScope _trr("reduce", tid);
+                for (size_t j = 0; j < nv; j++)
+                    if (threading->reduce_chunk != 0)
+                        chunked_reduce(vts[j]);
+                    else {
+#pragma omp single
+                        parallel_reduce(vts[j], 0, nslot);
+                    }
+                works[tid].deallocate(d_alloc);
+                for (int is = tid == 0 ? ntop : tid; is < nslot; is += ntop)
+                    for (size_t j = nv; j > 0; j--)
+                        vts[j - 1][is].deallocate(d_alloc);
+            }
+            threading->activate_normal();
+            cumulative_nflop += (batch[0]->nflop + batch[1]->nflop) * nv;
+        } else
+            for (size_t j = 0; j < nv; j++)
+                (*this)(cs[j], vs[j]);
+    }
     // Clear all DGEMM parameters
     void clear() {
         for (auto b : batch)
@@ -1075,7 +1622,11 @@ struct BatchGEMMSeq {
         post_batch.clear();
         refs.clear();
         cjc.clear();
+        work_cache.clear();
+        work_reach.clear();
         max_rwork = max_work = 0;
+        applied_cshift = applied_vshift = 0;
+        sdata = nullptr;
     }
     friend ostream &operator<<(ostream &os, const BatchGEMMSeq &c) {
         os << endl;
@@ -21,7 +21,10 @@
 #pragma once
 
 #include <cmath>
+#include <cstdint>
 #include <memory>
+#include <unordered_map>
+#include <vector>
 
 using namespace std;
 
@@ -31,6 +34,8 @@ template <typename, typename = void> struct CG;
 
 // Trivial CG factors for Abelian symmetry
 template <typename S> struct CG<S, typename S::is_sz_t> {
+    // Known at compile time, so that kernels can skip all CG factors
+    static const bool abelian = true;
     CG() {}
     CG(int n_sqrt_fact) {}
     void initialize(double *ptr = 0) {}
@@ -43,6 +48,14 @@ template <typename S> struct CG<S, typename S::is_sz_t> {
                           int tjg, int tjh, int tji) const noexcept {
         return 1.0L;
     }
+    void wigner_6j_batch(size_t n, const int *tjs, long double *r) const {
+        for (size_t i = 0; i < n; i++)
+            r[i] = 1.0L;
+    }
+    void wigner_9j_batch(size_t n, const int *tjs, long double *r) const {
+        for (size_t i = 0; i < n; i++)
+            r[i] = 1.0L;
+    }
     long double racah(int ta, int tb, int tc, int td, int te,
                       int tf) const noexcept {
         return 1.0L;
@@ -50,10 +63,12 @@ template <typename S> struct CG<S, typename S::is_sz_t> {
     long double transpose_cg(int td, int tl, int tr) const noexcept {
         return 1.0L;
     }
+    static void clear_cache() {}
 };
 
 // CG factors for SU(2) symmetry
 template <typename S> struct CG<S, typename S::is_su2_t> {
+    static const bool abelian = false;
     shared_ptr<vector<double>> vdata;
     long double *sqrt_fact;
     int n_sf;
@@ -119,13 +134,98 @@ template <typename S> struct CG<S, typename S::is_su2_t> {
         }
         return r;
     }
-    // Albert Messiah, Quantum Mechanics. Vol 2. Eq. (C.36)
-    // Adapted from Sebastian's CheMPS2 code Wigner.cpp
+    // Lazily filled tables of 6j and 9j symbols, keyed by the packed
+    // arguments (7 bits each). The values do not depend on the CG object,
+    // so each thread keeps one table shared by all CG objects it uses,
+    // which needs no locking. Symbols with any 2j >= 128 are not tabulated.
+    // A table is dropped when it grows beyond cache_max_size entries.
+    static size_t &cache_max_size() {
+        static size_t max_size = (size_t)1 << 20;
+        return max_size;
+    }
+    static unordered_map<uint64_t, long double> &wigner_6j_cache() {
+        static thread_local unordered_map<uint64_t, long double> cache;
+        return cache;
+    }
+    static unordered_map<uint64_t, long double> &wigner_9j_cache() {
+        static thread_local unordered_map<uint64_t, long double> cache;
+        return cache;
+    }
+    // Only clears the tables of the calling thread
+    static void clear_cache() {
+        wigner_6j_cache().clear();
+        wigner_9j_cache().clear();
+    }
+    static bool cache_key(const int *tjs, int n, uint64_t &key) {
+        key = 0;
+        for (int i = 0; i < n; i++) {
+            if ((unsigned)tjs[i] >= 128U)
+                return false;
+            key = (key << 7) | (uint64_t)tjs[i];
+        }
+        return true;
+    }
     long double wigner_6j(int tja, int tjb, int tjc, int tjd, int tje,
                           int tjf) const {
         if (!triangle(tja, tjb, tjc) || !triangle(tja, tje, tjf) ||
             !triangle(tjd, tjb, tjf) || !triangle(tjd, tje, tjc))
             return 0;
+        const int tjs[6] = {tja, tjb, tjc, tjd, tje, tjf};
+        uint64_t key;
+        if (cache_max_size() == 0 || !cache_key(tjs, 6, key))
+            return compute_wigner_6j(tja, tjb, tjc, tjd, tje, tjf);
+        unordered_map<uint64_t, long double> &cache = wigner_6j_cache();
+        unordered_map<uint64_t, long double>::const_iterator it =
+            cache.find(key);
+        if (it != cache.end())
+            return it->second;
+        const long double r = compute_wigner_6j(tja, tjb, tjc, tjd, tje, tjf);
+        if (cache.size() >= cache_max_size())
+            cache.clear();
+        cache[key] = r;
+        return r;
+    }
+    long double wigner_9j(int tja, int tjb, int tjc, int tjd, int tje, int tjf,
+                          int tjg, int tjh, int tji) const {
+        if (!triangle(tja, tjb, tjc) || !triangle(tjd, tje, tjf) ||
+            !triangle(tjg, tjh, tji) || !triangle(tja, tjd, tjg) ||
+            !triangle(tjb, tje, tjh) || !triangle(tjc, tjf, tji))
+            return 0;
+        const int tjs[9] = {tja, tjb, tjc, tjd, tje, tjf, tjg, tjh, tji};
+        uint64_t key;
+        if (cache_max_size() == 0 || !cache_key(tjs, 9, key))
+            return compute_wigner_9j(tja, tjb, tjc, tjd, tje, tjf, tjg, tjh,
+                                     tji);
+        unordered_map<uint64_t, long double> &cache = wigner_9j_cache();
+        unordered_map<uint64_t, long double>::const_iterator it =
+            cache.find(key);
+        if (it != cache.end())
+            return it->second;
+        const long double r =
+            compute_wigner_9j(tja, tjb, tjc, tjd, tje, tjf, tjg, tjh, tji);
+        if (cache.size() >= cache_max_size())
+            cache.clear();
+        cache[key] = r;
+        return r;
+    }
+    // Batched lookups: tjs holds the 6 (or 9) arguments of each of
+    // the n symbols, one symbol after another
+    void wigner_6j_batch(size_t n, const int *tjs, long double *r) const {
+        for (size_t i = 0; i < n; i++, tjs += 6)
+            r[i] = wigner_6j(tjs[0], tjs[1], tjs[2], tjs[3], tjs[4], tjs[5]);
+    }
+    void wigner_9j_batch(size_t n, const int *tjs, long double *r) const {
+        for (size_t i = 0; i < n; i++, tjs += 9)
+            r[i] = wigner_9j(tjs[0], tjs[1], tjs[2], tjs[3], tjs[4], tjs[5],
+                             tjs[6], tjs[7], tjs[8]);
+    }
+    // Albert Messiah, Quantum Mechanics. Vol 2. Eq. (C.36)
+    // Adapted from Sebastian's CheMPS2 code Wigner.cpp
+    long double compute_wigner_6j(int tja, int tjb, int tjc, int tjd, int tje,
+                                  int tjf) const {
+        if (!triangle(tja, tjb, tjc) || !triangle(tja, tje, tjf) ||
+            !triangle(tjd, tjb, tjf) || !triangle(tjd, tje, tjc))
+            return 0;
         const int alpha1 = (tja + tjb + tjc) >> 1,
                   alpha2 = (tja + tje + tjf) >> 1,
                   alpha3 = (tjd + tjb + tjf) >> 1,
@@ -153,8 +253,8 @@ template <typename S> struct CG<S, typename S::is_su2_t> {
     }
     // Albert Messiah, Quantum Mechanics. Vol 2. Eq. (C.41)
     // Adapted from Sebastian's CheMPS2 code Wigner.cpp
-    long double wigner_9j(int tja, int tjb, int tjc, int tjd, int tje, int tjf,
-                          int tjg, int tjh, int tji) const {
+    long double compute_wigner_9j(int tja, int tjb, int tjc, int tjd, int tje,
+                                  int tjf, int tjg, int tjh, int tji) const {
         if (!triangle(tja, tjb, tjc) || !triangle(tjd, tje, tjf) ||
             !triangle(tjg, tjh, tji) || !triangle(tja, tjd, tjg) ||
             !triangle(tjb, tje, tjh) || !triangle(tjc, tjf, tji))
@@ -108,6 +108,20 @@ extern void zgels(const char *trans, const MKL_INT *m, const MKL_INT *n,
 #endif
 }
 
+// Recycled subspace of GCROT(m, k) for the next solve with a shifted matrix
+// (A + shift) us[i] = cs[i], with orthonormal cs[i]
+struct ComplexGCROTRecycle {
+    // cs[0:ncs] followed by us[0:ncs], each of size n (only at root proc)
+    vector<complex<double>> data;
+    int ncs = 0;
+    size_t n = 0;
+    complex<double> shift = 0.0;
+    void clear() {
+        data.clear();
+        ncs = 0, n = 0, shift = 0.0;
+    }
+};
+
 // Dense complex number matrix operations
 struct ComplexMatrixFunctions {
     // a = re + im i
@@ -167,6 +181,17 @@ struct ComplexMatrixFunctions {
               &inc);
         return r;
     }
+    // dot product (a ^ T, b)
+    static complex<double> complex_tdot(const ComplexMatrixRef &a,
+                                        const ComplexMatrixRef &b) {
+        static const complex<double> x = 1.0, zz = 0.0;
+        assert(a.m == b.m && a.n == b.n);
+        MKL_INT n = a.m * a.n, inc = 1;
+        complex<double> r;
+        zgemm("T", "N", &inc, &inc, &n, &x, a.data, &n, b.data, &n, &zz, &r,
+              &inc);
+        return r;
+    }
     static double norm(const ComplexMatrixRef &a) {
         MKL_INT n = a.m * a.n, inc = 1;
         return dznrm2(&n, a.data, &inc);
@@ -385,12 +410,15 @@ struct ComplexMatrixFunctions {
     //   EXPOKIT: Software Package for Computing Matrix Exponentials.
     //   ACM - Transactions On Mathematical Software, 24(1):130-156, 1998
     // lwork = n*(m+1)+n+(m+2)^2+4*(m+2)^2+ideg+1
+    // t_next: if not nullptr, reduced to the smallest step size suggested by
+    //   the local error estimates (unchanged if the Krylov space is exact)
     template <typename MatMul, typename PComm>
     static MKL_INT expo_krylov(MatMul &op, MKL_INT n, MKL_INT m, double t,
                                complex<double> *v, complex<double> *w,
                                double &tol, double anorm, complex<double> *work,
                                MKL_INT lwork, bool iprint,
-                               const PComm &pcomm = nullptr) {
+                               const PComm &pcomm = nullptr,
+                               double *t_next = nullptr) {
         const MKL_INT inc = 1;
         const double sqr1 = sqrt(0.1);
         const complex<double> zero = 0.0;
@@ -574,6 +602,8 @@ struct ComplexMatrixFunctions {
                 pcomm->broadcast(w, n, pcomm->root);
                 beta = tmp[0], t_new = tmp[1], t_now = tmp[2];
             }
+            if (t_next != nullptr && k1 != 0)
+                *t_next = min(*t_next, t_new);
             if (mxstep != 0 && nstep >= mxstep) {
                 iflag = 1;
                 break;
@@ -581,32 +611,55 @@ struct ComplexMatrixFunctions {
         }
         return nmult;
     }
+    // [br, bi] = op * [ar, ai] for a real op
+    // Both parts are given to the operator as one panel,
+    // if it has a multiply_panel method
+    template <typename MatMul>
+    static auto real_op_multiply(MatMul &op, const MatrixRef &ar,
+                                 const MatrixRef &ai, const MatrixRef &br,
+                                 const MatrixRef &bi, int)
+        -> decltype(op.multiply_panel(vector<MatrixRef>{ar, ai},
+                                      vector<MatrixRef>{br, bi})) {
+        br.clear(), bi.clear();
+        return op.multiply_panel(vector<MatrixRef>{ar, ai},
+                                 vector<MatrixRef>{br, bi});
+    }
+    template <typename MatMul>
+    static void real_op_multiply(MatMul &op, const MatrixRef &ar,
+                                 const MatrixRef &ai, const MatrixRef &br,
+                                 const MatrixRef &bi, long) {
+        br.clear(), bi.clear();
+        op(ar, br), op(ai, bi);
+    }
     // apply exponential of a real matrix to a vector
     // vr/vi: real/imag part of input/output vector
+    // t_next: if not nullptr, reduced to the suggested next step size |t|
     template <typename MatMul, typename PComm>
     static int expo_apply(MatMul &op, complex<double> t, double anorm,
                           MatrixRef &vr, MatrixRef &vi, double consta = 0.0,
                           bool iprint = false, const PComm &pcomm = nullptr,
-                          double conv_thrd = 5E-6,
-                          int deflation_max_size = 20) {
+                          double conv_thrd = 5E-6, int deflation_max_size = 20,
+                          double *t_next = nullptr) {
         const MKL_INT vm = vr.m, vn = vr.n, n = vm * vn;
         assert(vi.m == vr.m && vi.n == vr.n);
-        auto cop = [&op, vm, vn, n](const ComplexMatrixRef &a,
-                                    const ComplexMatrixRef &b) -> void {
-            vector<double> dar(n), dai(n), dbr(n, 0), dbi(n, 0);
-            extract_complex(a, MatrixRef(dar.data(), vm, vn),
-                            MatrixRef(dai.data(), vm, vn));
-            op(MatrixRef(dar.data(), vm, vn), MatrixRef(dbr.data(), vm, vn));
-            op(MatrixRef(dai.data(), vm, vn), MatrixRef(dbi.data(), vm, vn));
-            fill_complex(b, MatrixRef(dbr.data(), vm, vn),
-                         MatrixRef(dbi.data(), vm, vn));
+        // real and imag parts of input and output, reused for all matvecs
+        vector<double> work((size_t)n * 4);
+        MatrixRef ar(work.data(), vm, vn), ai(work.data() + n, vm, vn);
+        MatrixRef br(work.data() + n * 2, vm, vn);
+        MatrixRef bi(work.data() + n * 3, vm, vn);
+        auto cop = [&op, &ar, &ai, &br, &bi](const ComplexMatrixRef &a,
+                                             const ComplexMatrixRef &b) {
+            extract_complex(a, ar, ai);
+            real_op_multiply(op, ar, ai, br, bi, 0);
+            fill_complex(b, br, bi);
         };
         vector<complex<double>> v(n);
         ComplexMatrixRef cv(v.data(), vm, vn);
         fill_complex(cv, vr, vi);
         MKL_INT nmult =
             expo_apply_complex_op(cop, t, anorm, cv, consta, iprint,
-                                  (PComm)pcomm, conv_thrd, deflation_max_size);
+                                  (PComm)pcomm, conv_thrd, deflation_max_size,
+                                  t_next);
         extract_complex(cv, vr, vi);
         return nmult;
     }
@@ -618,7 +671,8 @@ struct ComplexMatrixFunctions {
                                      double consta = 0.0, bool iprint = false,
                                      const PComm &pcomm = nullptr,
                                      double conv_thrd = 5E-6,
-                                     int deflation_max_size = 20) {
+                                     int deflation_max_size = 20,
+                                     double *t_next = nullptr) {
         MKL_INT vm = v.m, vn = v.n, n = vm * vn;
         double abst = abs(t);
         assert(abst != 0);
@@ -670,7 +724,7 @@ struct ComplexMatrixFunctions {
             anorm = 1.0;
         MKL_INT nmult = ComplexMatrixFunctions::expo_krylov(
             lop, n, m, abst, v.data, w.data(), conv_thrd, anorm, work.data(),
-            lwork, iprint, (PComm)pcomm);
+            lwork, iprint, (PComm)pcomm, t_next);
         memcpy(v.data, w.data(), sizeof(complex<double>) * w.size());
         return (int)nmult;
     }
@@ -687,13 +741,17 @@ struct ComplexMatrixFunctions {
         }
     }
     // GCROT(m, k) method for solving x in linear equation H x = b
+    // If recycle is not nullptr, the subspace kept from the previous solve
+    // (with H = A + recycle->shift) is used to start the solve with
+    // H = A + shift, and the final subspace is stored in recycle
     template <typename MatMul, typename PComm>
     static complex<double>
     gcrotmk(MatMul &op, const ComplexDiagonalMatrix &aa, ComplexMatrixRef x,
             ComplexMatrixRef b, int &nmult, int &niter, int m = 20, int k = -1,
             bool iprint = false, const PComm &pcomm = nullptr,
             double conv_thrd = 5E-6, int max_iter = 5000,
-            int soft_max_iter = -1) {
+            int soft_max_iter = -1, ComplexGCROTRecycle *recycle = nullptr,
+            complex<double> shift = 0.0) {
         ComplexMatrixRef r(nullptr, x.m, x.n), w(nullptr, x.m, x.n);
         double ff[4];
         double &beta = ff[0], &rr = ff[1];
@@ -724,6 +782,46 @@ struct ComplexMatrixFunctions {
             uzs[i].data = pcus.data() + uzs[i].size() * (i + nn);
         }
         int ncs = 0, icu = 0;
+        if (recycle != nullptr && recycle->ncs != 0 && recycle->n == x.size()) {
+            if (pcomm == nullptr || pcomm->root == pcomm->rank) {
+                // (H + ds) us[i] = cs[i] + ds us[i], then orthonormalize
+                const complex<double> ds = shift - recycle->shift;
+                const size_t n = x.size();
+                for (int i = 0; i < min(recycle->ncs, k); i++) {
+                    copy(cvs[ncs], ComplexMatrixRef(recycle->data.data() +
+                                                        n * i,
+                                                    x.m, x.n));
+                    copy(uzs[ncs],
+                         ComplexMatrixRef(recycle->data.data() +
+                                              n * (recycle->ncs + i),
+                                          x.m, x.n));
+                    iadd(cvs[ncs], uzs[ncs], ds);
+                    for (int j = 0; j < ncs; j++) {
+                        complex<double> g = complex_dot(cvs[j], cvs[ncs]);
+                        iadd(cvs[ncs], cvs[j], -g);
+                        iadd(uzs[ncs], uzs[j], -g);
+                    }
+                    double cn = norm(cvs[ncs]);
+                    if (cn < 1E-10)
+                        continue;
+                    iscale(cvs[ncs], 1 / cn);
+                    iscale(uzs[ncs], 1 / cn);
+                    complex<double> gamma = complex_dot(cvs[ncs], r);
+                    iadd(r, cvs[ncs], -gamma);
+                    iadd(x, uzs[ncs], gamma);
+                    ncs++;
+                }
+                func = complex_dot(x, b);
+                beta = norm(r);
+            }
+            if (pcomm != nullptr) {
+                pcomm->broadcast(&ncs, 1, pcomm->root);
+                pcomm->broadcast(&beta, 4, pcomm->root);
+            }
+            if (iprint)
+                cout << "Recycled " << ncs << " vectors" << scientific
+                     << setw(13) << setprecision(2) << beta * beta << endl;
+        }
         ComplexMatrixRef bmat(nullptr, k, k + m);
         ComplexMatrixRef hmat(nullptr, k + m + 1, k + m);
         ComplexMatrixRef ys(nullptr, k + m, 1);
@@ -821,6 +919,21 @@ struct ComplexMatrixFunctions {
         }
         nmult = jiter;
         niter = xiter + 1;
+        if (recycle != nullptr) {
+            recycle->clear();
+            recycle->ncs = ncs, recycle->n = x.size(), recycle->shift = shift;
+            if (pcomm == nullptr || pcomm->root == pcomm->rank) {
+                recycle->data.resize(x.size() * 2 * ncs);
+                for (int i = 0; i < ncs; i++) {
+                    memcpy(recycle->data.data() + x.size() * i,
+                           cvs[(icu + i) % nn].data,
+                           sizeof(complex<double>) * x.size());
+                    memcpy(recycle->data.data() + x.size() * (ncs + i),
+                           uzs[(icu + i) % nn].data,
+                           sizeof(complex<double>) * x.size());
+                }
+            }
+        }
         hys.deallocate();
         bys.deallocate();
         ys.deallocate();
@@ -832,6 +945,128 @@ struct ComplexMatrixFunctions {
             pcomm->broadcast(x.data, x.size(), pcomm->root);
         return func;
     }
+    // COCG method for solving xs[j] in linear equations
+    // (H + shifts[j]) xs[j] = b with complex symmetric H, for all shifts
+    // together. The systems advance in lockstep, so that the search
+    // directions of all unconverged systems are multiplied by H as one panel
+    // in op(ps, qs), with qs = H ps. The preconditioner for system j is
+    // (diag + shifts[j]) ^ (-1), if diag is not empty.
+    // Returns xs[j] ^ H b for each shift
+    template <typename MatMul, typename PComm>
+    static vector<complex<double>>
+    shifted_cocg(MatMul &op, const DiagonalMatrix &diag,
+                 const vector<complex<double>> &shifts,
+                 const vector<ComplexMatrixRef> &xs, ComplexMatrixRef b,
+                 int &nmult, int &niter, bool iprint = false,
+                 const PComm &pcomm = nullptr, double conv_thrd = 5E-6,
+                 int max_iter = 5000, int soft_max_iter = -1) {
+        const int nw = (int)shifts.size();
+        const size_t n = b.size();
+        assert((int)xs.size() == nw);
+        vector<complex<double>> work(n * 4 * nw);
+        vector<ComplexMatrixRef> rs, zs, ps, qs;
+        for (int j = 0; j < nw; j++) {
+            rs.push_back(ComplexMatrixRef(work.data() + n * (4 * j), b.m, b.n));
+            zs.push_back(
+                ComplexMatrixRef(work.data() + n * (4 * j + 1), b.m, b.n));
+            ps.push_back(
+                ComplexMatrixRef(work.data() + n * (4 * j + 2), b.m, b.n));
+            qs.push_back(
+                ComplexMatrixRef(work.data() + n * (4 * j + 3), b.m, b.n));
+        }
+        // rnorms[j] and funcs[j] are broadcast together
+        vector<double> ff(nw * 3, 0);
+        double *rnorms = ff.data();
+        complex<double> *funcs = (complex<double> *)(ff.data() + nw);
+        vector<complex<double>> rhos(nw);
+        auto precondition = [&diag, &shifts](const ComplexMatrixRef &z,
+                                             const ComplexMatrixRef &r,
+                                             int j) {
+            copy(z, r);
+            if (diag.size() != 0) {
+                assert(diag.size() == r.size());
+                for (MKL_INT i = 0; i < diag.n; i++) {
+                    complex<double> d = diag.data[i] + shifts[j];
+                    if (abs(d) > 1E-12)
+                        z.data[i] /= d;
+                }
+            }
+        };
+        // mult = indices of systems multiplied in the next panel
+        vector<int> mult(nw);
+        for (int j = 0; j < nw; j++)
+            mult[j] = j, qs[j].clear();
+        op(xs, qs);
+        nmult = nw;
+        if (pcomm == nullptr || pcomm->root == pcomm->rank) {
+            for (int j = 0; j < nw; j++) {
+                copy(rs[j], b);
+                iadd(rs[j], qs[j], -1.0);
+                iadd(rs[j], xs[j], -shifts[j]); // r = b - Ax
+                precondition(zs[j], rs[j], j);
+                copy(ps[j], zs[j]);
+                rhos[j] = complex_tdot(zs[j], rs[j]);
+                funcs[j] = complex_dot(xs[j], b);
+                rnorms[j] = norm(rs[j]);
+            }
+        }
+        if (pcomm != nullptr)
+            pcomm->broadcast(ff.data(), ff.size(), pcomm->root);
+        int xiter = 0;
+        while (true) {
+            mult.clear();
+            double max_rr = 0;
+            for (int j = 0; j < nw; j++) {
+                max_rr = max(max_rr, rnorms[j] * rnorms[j]);
+                if (rnorms[j] * rnorms[j] >= conv_thrd)
+                    mult.push_back(j);
+            }
+            if (iprint)
+                cout << setw(6) << xiter << setw(6) << nmult << setw(6)
+                     << mult.size() << scientific << setw(13)
+                     << setprecision(2) << max_rr << endl;
+            if (mult.size() == 0 || xiter >= max_iter ||
+                (soft_max_iter != -1 && xiter >= soft_max_iter))
+                break;
+            xiter++;
+            vector<ComplexMatrixRef> mps, mqs;
+            for (int j : mult) {
+                if (pcomm != nullptr)
+                    pcomm->broadcast(ps[j].data, ps[j].size(), pcomm->root);
+                qs[j].clear();
+                mps.push_back(ps[j]), mqs.push_back(qs[j]);
+            }
+            op(mps, mqs);
+            nmult += (int)mult.size();
+            if (pcomm == nullptr || pcomm->root == pcomm->rank) {
+                for (int j : mult) {
+                    iadd(qs[j], ps[j], shifts[j]);
+                    complex<double> alpha = rhos[j] / complex_tdot(ps[j], qs[j]);
+                    iadd(xs[j], ps[j], alpha);
+                    iadd(rs[j], qs[j], -alpha);
+                    funcs[j] = complex_dot(xs[j], b);
+                    rnorms[j] = norm(rs[j]);
+                    if (rnorms[j] * rnorms[j] < conv_thrd)
+                        continue;
+                    precondition(zs[j], rs[j], j);
+                    complex<double> rho = complex_tdot(zs[j], rs[j]);
+                    iadd(ps[j], zs[j], 1.0, rho / rhos[j]);
+                    rhos[j] = rho;
+                }
+            }
+            if (pcomm != nullptr)
+                pcomm->broadcast(ff.data(), ff.size(), pcomm->root);
+        }
+        if (xiter >= max_iter && mult.size() != 0) {
+            cout << "Error : linear solver shifted COCG not converged!" << endl;
+            assert(false);
+        }
+        niter = xiter + 1;
+        if (pcomm != nullptr)
+            for (int j = 0; j < nw; j++)
+                pcomm->broadcast(xs[j].data, xs[j].size(), pcomm->root);
+        return vector<complex<double>>(funcs, funcs + nw);
+    }
 };
 
 } // namespace block2
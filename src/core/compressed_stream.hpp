@@ -0,0 +1,334 @@
+
+/*
+ * block2: Efficient MPO implementation of quantum chemistry DMRG
+ * Copyright (C) 2020-2021 Huanchen Zhai <hczhai@caltech.edu>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+/** File streams with optional gzip or zstd compression. */
+
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <stdexcept>
+#include <streambuf>
+#include <string>
+#include <vector>
+#ifdef _HAS_ZLIB
+#include <zlib.h>
+#endif
+#ifdef _HAS_ZSTD
+#include <zstd.h>
+#endif
+
+using namespace std;
+
+namespace block2 {
+
+/** Compression format of a file. */
+enum struct CompressionTypes : uint8_t {
+    None, //!< Uncompressed.
+    GZip, //!< gzip (requires zlib, ``-D_HAS_ZLIB``).
+    ZStd  //!< Zstandard (requires libzstd, ``-D_HAS_ZSTD``).
+};
+
+/** Utilities for compressed files. */
+struct CompressedFile {
+    /** Compression format determined from the file name extension.
+     * @param filename File name (``.gz`` for gzip, ``.zst`` for zstd).
+     * @return The compression format.
+     */
+    static CompressionTypes type_of(const string &filename) {
+        auto ends_with = [&filename](const string &ext) {
+            return filename.size() > ext.size() &&
+                   filename.compare(filename.size() - ext.size(), ext.size(),
+                                    ext) == 0;
+        };
+        if (ends_with(".gz"))
+            return CompressionTypes::GZip;
+        else if (ends_with(".zst"))
+            return CompressionTypes::ZStd;
+        else
+            return CompressionTypes::None;
+    }
+    /** Whether the compression format is supported in this build.
+     * @param ct The compression format.
+     * @return ``true`` if files of this format can be read and written.
+     */
+    static bool is_supported(CompressionTypes ct) {
+        switch (ct) {
+        case CompressionTypes::None:
+            return true;
+        case CompressionTypes::GZip:
+#ifdef _HAS_ZLIB
+            return true;
+#else
+            return false;
+#endif
+        case CompressionTypes::ZStd:
+#ifdef _HAS_ZSTD
+            return true;
+#else
+            return false;
+#endif
+        default:
+            return false;
+        }
+    }
+    /** Read the whole (decompressed) content of a file.
+     * @param filename File name, with the compression format determined
+     *   from the extension.
+     * @return The file content.
+     */
+    static string read(const string &filename) {
+        const CompressionTypes ct = type_of(filename);
+        if (!is_supported(ct))
+            throw runtime_error("CompressedFile::read on '" + filename +
+                                "': compression format not supported.");
+        string r;
+        const size_t chunk = (size_t)1 << 20;
+        if (ct == CompressionTypes::GZip) {
+#ifdef _HAS_ZLIB
+            gzFile fp = gzopen(filename.c_str(), "rb");
+            if (fp == nullptr)
+                throw runtime_error("CompressedFile::read on '" + filename +
+                                    "' failed.");
+            gzbuffer(fp, (unsigned int)chunk);
+            int nr = 0;
+            do {
+                size_t sz = r.size();
+                r.resize(sz + chunk);
+                nr = gzread(fp, &r[sz], (unsigned int)chunk);
+                r.resize(sz + max(nr, 0));
+            } while (nr > 0);
+            gzclose(fp);
+            if (nr < 0)
+                throw runtime_error("CompressedFile::read on '" + filename +
+                                    "': invalid gzip data.");
+#endif
+            return r;
+        }
+        FILE *fp = fopen(filename.c_str(), "rb");
+        if (fp == nullptr)
+            throw runtime_error("CompressedFile::read on '" + filename +
+                                "' failed.");
+        if (ct == CompressionTypes::None) {
+            fseek(fp, 0, SEEK_END);
+            r.resize((size_t)ftell(fp));
+            fseek(fp, 0, SEEK_SET);
+            size_t nr = r.size() == 0 ? 0 : fread(&r[0], 1, r.size(), fp);
+            fclose(fp);
+            if (nr != r.size())
+                throw runtime_error("CompressedFile::read on '" + filename +
+                                    "' failed.");
+            return r;
+        }
+#ifdef _HAS_ZSTD
+        ZSTD_DCtx *dctx = ZSTD_createDCtx();
+        vector<char> ibuf(ZSTD_DStreamInSize()), obuf(ZSTD_DStreamOutSize());
+        size_t nr, ret = 0;
+        while ((nr = fread(ibuf.data(), 1, ibuf.size(), fp)) != 0) {
+            ZSTD_inBuffer in = {ibuf.data(), nr, 0};
+            while (in.pos < in.size) {
+                ZSTD_outBuffer out = {obuf.data(), obuf.size(), 0};
+                ret = ZSTD_decompressStream(dctx, &out, &in);
+                if (ZSTD_isError(ret)) {
+                    ZSTD_freeDCtx(dctx);
+                    fclose(fp);
+                    throw runtime_error("CompressedFile::read on '" +
+                                        filename + "': " +
+                                        ZSTD_getErrorName(ret));
+                }
+                r.append(obuf.data(), out.pos);
+            }
+        }
+        ZSTD_freeDCtx(dctx);
+#endif
+        fclose(fp);
+        return r;
+    }
+};
+
+/** Output stream buffer writing to a file, compressed according to the file
+ * name extension. Data is buffered and compressed in large blocks. */
+struct CompressedFileBuffer : streambuf {
+    CompressionTypes ct;  //!< Compression format.
+    string filename;      //!< File name.
+    vector<char> buffer;  //!< Put area.
+    FILE *fp = nullptr;   //!< Output file (uncompressed and zstd).
+#ifdef _HAS_ZLIB
+    gzFile gzfp = nullptr; //!< Output file (gzip).
+#endif
+#ifdef _HAS_ZSTD
+    ZSTD_CCtx *cctx = nullptr; //!< Compression context (zstd).
+    vector<char> zbuf;         //!< Compressed output (zstd).
+#endif
+    bool failed = false; //!< Whether any write failed.
+    /** Constructor.
+     * @param filename File name (``.gz`` for gzip, ``.zst`` for zstd, and
+     *   uncompressed otherwise).
+     * @param level Compression level (negative for the library default).
+     * @param n_workers Number of worker threads for zstd compression (zero
+     *   for compressing in the calling thread).
+     * @param buffer_size Size of the put area in bytes.
+     */
+    CompressedFileBuffer(const string &filename, int level = -1,
+                         int n_workers = 0,
+                         size_t buffer_size = (size_t)1 << 22)
+        : ct(CompressedFile::type_of(filename)), filename(filename),
+          buffer(buffer_size) {
+        if (!CompressedFile::is_supported(ct))
+            throw runtime_error("CompressedFileBuffer on '" + filename +
+                                "': compression format not supported.");
+        if (ct == CompressionTypes::GZip) {
+#ifdef _HAS_ZLIB
+            string mode = "wb";
+            if (level >= 0)
+                mode += to_string(min(level, 9));
+            gzfp = gzopen(filename.c_str(), mode.c_str());
+            if (gzfp == nullptr)
+                throw runtime_error("CompressedFileBuffer on '" + filename +
+                                    "' failed.");
+            gzbuffer(gzfp, (unsigned int)buffer_size);
+#endif
+        } else {
+            fp = fopen(filename.c_str(), "wb");
+            if (fp == nullptr)
+                throw runtime_error("CompressedFileBuffer on '" + filename +
+                                    "' failed.");
+#ifdef _HAS_ZSTD
+            if (ct == CompressionTypes::ZStd) {
+                cctx = ZSTD_createCCtx();
+                if (level >= 0)
+                    ZSTD_CCtx_setParameter(cctx, ZSTD_c_compressionLevel,
+                                           level);
+                // fails silently when libzstd is built without threads
+                if (n_workers > 0)
+                    ZSTD_CCtx_setParameter(cctx, ZSTD_c_nbWorkers, n_workers);
+                zbuf.resize(ZSTD_CStreamOutSize());
+            }
+#endif
+        }
+        setp(buffer.data(), buffer.data() + buffer.size());
+    }
+    ~CompressedFileBuffer() override {
+        // errors are only reported by an explicit close
+        if (is_open()) {
+            try {
+                close();
+            } catch (const runtime_error &) {
+            }
+        }
+    }
+    /** Whether the file is still open. */
+    bool is_open() const {
+#ifdef _HAS_ZLIB
+        if (gzfp != nullptr)
+            return true;
+#endif
+        return fp != nullptr;
+    }
+    /** Compress and write a block of data.
+     * @param p Pointer to the data.
+     * @param n Number of bytes.
+     * @param end Whether this is the last block (zstd frame is ended).
+     */
+    void write_block(const char *p, size_t n, bool end = false) {
+        if (ct == CompressionTypes::None) {
+            if (n != 0 && fwrite(p, 1, n, fp) != n)
+                failed = true;
+        } else if (ct == CompressionTypes::GZip) {
+#ifdef _HAS_ZLIB
+            for (size_t k = 0; k < n;) {
+                unsigned int nw =
+                    (unsigned int)min(n - k, (size_t)1 << 30);
+                if (gzwrite(gzfp, p + k, nw) != (int)nw) {
+                    failed = true;
+                    break;
+                }
+                k += nw;
+            }
+#endif
+        } else {
+#ifdef _HAS_ZSTD
+            ZSTD_inBuffer in = {p, n, 0};
+            const ZSTD_EndDirective mode = end ? ZSTD_e_end : ZSTD_e_continue;
+            size_t ret;
+            do {
+                ZSTD_outBuffer out = {zbuf.data(), zbuf.size(), 0};
+                ret = ZSTD_compressStream2(cctx, &out, &in, mode);
+                if (ZSTD_isError(ret) ||
+                    fwrite(zbuf.data(), 1, out.pos, fp) != out.pos) {
+                    failed = true;
+                    break;
+                }
+            } while (end ? ret != 0 : in.pos != in.size);
+#endif
+        }
+    }
+    /** Flush the put area, finish compression and close the file.
+     * Throws if any write failed. */
+    void close() {
+        write_block(pbase(), pptr() - pbase(), true);
+        setp(buffer.data(), buffer.data() + buffer.size());
+#ifdef _HAS_ZLIB
+        if (gzfp != nullptr && gzclose(gzfp) != Z_OK)
+            failed = true;
+        gzfp = nullptr;
+#endif
+#ifdef _HAS_ZSTD
+        if (cctx != nullptr)
+            ZSTD_freeCCtx(cctx);
+        cctx = nullptr;
+#endif
+        if (fp != nullptr && fclose(fp) != 0)
+            failed = true;
+        fp = nullptr;
+        if (failed)
+            throw runtime_error("CompressedFileBuffer on '" + filename +
+                                "' failed.");
+    }
+
+  protected:
+    int_type overflow(int_type c) override {
+        write_block(pbase(), pptr() - pbase());
+        setp(buffer.data(), buffer.data() + buffer.size());
+        if (!traits_type::eq_int_type(c, traits_type::eof())) {
+            *pptr() = traits_type::to_char_type(c);
+            pbump(1);
+        }
+        return failed ? traits_type::eof() : traits_type::not_eof(c);
+    }
+    streamsize xsputn(const char *s, streamsize n) override {
+        // large writes bypass the put area
+        if ((size_t)n >= buffer.size()) {
+            write_block(pbase(), pptr() - pbase());
+            setp(buffer.data(), buffer.data() + buffer.size());
+            write_block(s, (size_t)n);
+            return failed ? 0 : n;
+        }
+        return streambuf::xsputn(s, n);
+    }
+    int sync() override {
+        write_block(pbase(), pptr() - pbase());
+        setp(buffer.data(), buffer.data() + buffer.size());
+        return failed ? -1 : 0;
+    }
+};
+
+} // namespace block2
@@ -40,6 +40,14 @@ struct CSRMatrixRef {
     MKL_INT m, n, nnz; // m is rows, n is cols, nnz is number of nonzeros
     double *data;
     MKL_INT *rows, *cols;
+#ifdef _HAS_INTEL_MKL
+    // Persisted (optimized) MKL sparse handle referencing this matrix
+    // Created by CSRMatrixFunctions::optimize and reset when data changes
+    mutable shared_ptr<sparse_matrix_t> mkl_handle = nullptr;
+#endif
+    // Device copy owned by csrmm_backend_() (for example device CSR arrays
+    // with a cuSPARSE descriptor), reset when data changes
+    mutable shared_ptr<void> device_data = nullptr;
     CSRMatrixRef()
         : m(0), n(0), nnz(0), data(nullptr), rows(nullptr), cols(nullptr) {}
     CSRMatrixRef(MKL_INT m, MKL_INT n, MKL_INT nnz = 0) : m(m), n(n), nnz(nnz) {
@@ -111,6 +119,10 @@ struct CSRMatrixRef {
     }
     double sparsity() const { return 1.0 - (double)nnz / (m * n); }
     void allocate(double *ptr = nullptr) {
+#ifdef _HAS_INTEL_MKL
+        mkl_handle = nullptr;
+#endif
+        device_data = nullptr;
         if (ptr == nullptr) {
             if (alloc == nullptr)
                 alloc = dalloc;
@@ -125,6 +137,10 @@ struct CSRMatrixRef {
         }
     }
     void deallocate() {
+#ifdef _HAS_INTEL_MKL
+        mkl_handle = nullptr;
+#endif
+        device_data = nullptr;
         if (alloc == nullptr)
             data = nullptr;
         else {
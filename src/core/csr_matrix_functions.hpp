@@ -55,6 +55,8 @@ struct MKLSparseAllocator : Allocator<double> {
     };
     static shared_ptr<sparse_matrix_t>
     to_mkl_sparse_matrix(const CSRMatrixRef &mat, bool conj = false) {
+        if (!conj && mat.mkl_handle != nullptr)
+            return mat.mkl_handle;
         if (mat.alloc != nullptr) {
             auto &r = *mat.alloc.get();
             if (typeid(r).hash_code() == typeid(MKLSparseAllocator).hash_code())
@@ -98,17 +100,79 @@ struct MKLSparseAllocator : Allocator<double> {
 
 #endif
 
+// External sparse-dense product, with the semantics of
+// CSRMatrixFunctions::multiply: c = cfactor * c + scale * op(x) * op(y),
+// where x = s, y = d if sparse_left, otherwise x = d, y = s
+// (op(x) = x^T if its conj flag is set). All pointers are host pointers
+typedef void (*csrmm_t)(const CSRMatrixRef &s, bool conjs, const MatrixRef &d,
+                        bool conjd, bool sparse_left, const MatrixRef &c,
+                        double scale, double cfactor);
+
+// Backend used by the sparse-dense CSRMatrixFunctions::multiply for CSR
+// blocks with at least CSRMatrixFunctions::csrmm_offload_nnz() nonzeros,
+// for example a cuSPARSE SpMM wrapper. It may keep a device copy of s in
+// s.device_data (reused while the host data is unchanged), may be called
+// from several threads concurrently, and must have finished writing c when
+// it returns
+inline auto csrmm_backend_() -> csrmm_t & {
+    static csrmm_t backend = nullptr;
+    return backend;
+}
+
 // CSR matrix operations
 struct CSRMatrixFunctions {
+    // Minimal number of nonzeros for using csrmm_backend_() when it is
+    // registered (0 means always host)
+    static MKL_INT &csrmm_offload_nnz() {
+        static MKL_INT offload_nnz = 0;
+        return offload_nnz;
+    }
+    static bool csrmm_offload(const CSRMatrixRef &s) {
+        return csrmm_backend_() != nullptr && csrmm_offload_nnz() != 0 &&
+               s.nnz >= csrmm_offload_nnz();
+    }
     // a = b
     static void copy(const CSRMatrixRef &a, const CSRMatrixRef &b) {
         const MKL_INT na = a.memory_size(), nb = b.memory_size(), inc = 1;
         assert(na == nb);
         dcopy(&na, b.data, &inc, a.data, &inc);
+#ifdef _HAS_INTEL_MKL
+        a.mkl_handle = nullptr;
+#endif
+        a.device_data = nullptr;
     }
     static void iscale(const CSRMatrixRef &a, double scale) {
         const MKL_INT inc = 1;
         dscal(&a.nnz, &scale, a.data, &inc);
+#ifdef _HAS_INTEL_MKL
+        a.mkl_handle = nullptr;
+#endif
+        a.device_data = nullptr;
+    }
+    // Attach a persisted sparse handle to a, optimized for the expected
+    // number of sparse-dense products (MKL inspector-executor)
+    // The data of a must not change while the handle is used
+    static void optimize(const CSRMatrixRef &a, MKL_INT expected_calls) {
+#ifdef _HAS_INTEL_MKL
+        if (a.nnz == a.size() || a.nnz == 0 || a.mkl_handle != nullptr)
+            return;
+        shared_ptr<sparse_matrix_t> spa =
+            MKLSparseAllocator::to_mkl_sparse_matrix(a);
+        const struct matrix_descr mt {
+            SPARSE_MATRIX_TYPE_GENERAL, SPARSE_FILL_MODE_LOWER,
+                SPARSE_DIAG_NON_UNIT
+        };
+        // hints for both multiply (sparse * dense and dense * sparse)
+        for (sparse_operation_t op :
+             {SPARSE_OPERATION_NON_TRANSPOSE, SPARSE_OPERATION_TRANSPOSE})
+            for (sparse_layout_t lt :
+                 {SPARSE_LAYOUT_ROW_MAJOR, SPARSE_LAYOUT_COLUMN_MAJOR})
+                mkl_sparse_set_mm_hint(*spa, op, mt, lt, max(a.m, a.n),
+                                       expected_calls);
+        sparse_status_t st = mkl_sparse_optimize(*spa);
+        assert(st == SPARSE_STATUS_SUCCESS);
+        a.mkl_handle = spa;
+#endif
     }
     static double norm(const CSRMatrixRef &a) {
         const MKL_INT inc = 1;
@@ -261,8 +325,6 @@ struct CSRMatrixFunctions {
                          double scale, double cfactor) {
         shared_ptr<VectorAllocator<double>> d_alloc =
             make_shared<VectorAllocator<double>>();
-        shared_ptr<VectorAllocator<uint32_t>> i_alloc =
-            make_shared<VectorAllocator<uint32_t>>();
         if (a.nnz == a.size() || b.nnz == b.size()) {
             if (c.nnz == c.size()) {
                 if (a.nnz == a.size() && b.nnz == b.size())
@@ -294,91 +356,187 @@ struct CSRMatrixFunctions {
             }
             return;
         } else if (c.nnz == c.size()) {
-            MatrixRef bd(d_alloc->allocate(b.size()), b.m, b.n);
-            b.to_dense(bd);
-            multiply(a, conja, bd, conjb, c.dense_ref(), scale, cfactor);
-            bd.deallocate(d_alloc);
+            // sparse product scattered into c (no dense copy of b)
+            CSRMatrixRef r(c.m, c.n, 0, nullptr, nullptr, nullptr);
+            multiply(a, conja, b, conjb, r, scale, 0.0);
+            MatrixRef cd = c.dense_ref();
+            if (cfactor == 0.0)
+                cd.clear();
+            else if (cfactor != 1.0)
+                MatrixFunctions::iscale(cd, cfactor);
+            if (r.nnz == r.size())
+                MatrixFunctions::iadd(cd, r.dense_ref(), 1.0);
+            else
+                for (MKL_INT i = 0; i < r.m; i++)
+                    for (MKL_INT j = r.rows[i]; j < r.rows[i + 1]; j++)
+                        cd(i, r.cols[j]) += r.data[j];
+            r.deallocate();
             return;
         }
         vector<CSRMatrixRef> tmps;
-        MKL_INT *arows = a.rows, *acols = a.cols, *brows = b.rows,
-                *bcols = b.cols;
-        double *adata = a.data, *bdata = b.data;
         const MKL_INT am = conja ? a.n : a.m, an = conja ? a.m : a.n;
         const MKL_INT bm = conjb ? b.n : b.m, bn = conjb ? b.m : b.n;
         assert(am == c.m && bn == c.n && an == bm);
         if (conja)
-            tmps.push_back(a.transpose(d_alloc)), arows = tmps.back().rows,
-                                                  acols = tmps.back().cols,
-                                                  adata = tmps.back().data;
+            tmps.push_back(a.transpose(d_alloc));
         if (conjb)
-            tmps.push_back(b.transpose(d_alloc)), brows = tmps.back().rows,
-                                                  bcols = tmps.back().cols,
-                                                  bdata = tmps.back().data;
-        MKL_INT *r_idx = (MKL_INT *)i_alloc->allocate((c.m + 1) * _MINTSZ);
-        vector<MKL_INT> tcols, rcols;
-        vector<double> tdata, rdata;
-        for (MKL_INT i = 0, jp, jr, inc = 1; i < am; i++) {
-            r_idx[i] = (MKL_INT)rcols.size();
-            jp = c.rows[i], jr = i == c.m - 1 ? c.nnz : c.rows[i + 1];
-            jr = jr - jp;
-            tcols.clear(), tdata.clear();
-            if (jr != 0 && cfactor != 0) {
-                tcols.resize(jr), tdata.resize(jr);
-                memcpy(tcols.data(), c.cols + jp, jr * sizeof(MKL_INT));
-                memcpy(tdata.data(), c.data + jp, jr * sizeof(double));
-                dscal(&jr, &cfactor, tdata.data(), &inc);
-            }
-            jp = arows[i], jr = i == am - 1 ? a.nnz : arows[i + 1];
-            for (MKL_INT j = jp; j < jr; j++) {
-                MKL_INT kp = brows[acols[j]],
-                        kr = acols[j] == bm - 1 ? b.nnz : brows[acols[j] + 1];
-                for (MKL_INT k = kp; k < kr; k++)
-                    tcols.push_back(bcols[k]),
-                        tdata.push_back(adata[j] * bdata[k] * scale);
-            }
-            if (tcols.size() != 0) {
-                MKL_INT *idx =
-                    (MKL_INT *)i_alloc->allocate(tcols.size() * _MINTSZ);
-                for (MKL_INT l = 0; l < (MKL_INT)tcols.size(); l++)
-                    idx[l] = l;
-                sort(idx, idx + tcols.size(), [&tcols](MKL_INT ti, MKL_INT tj) {
-                    return tcols[ti] < tcols[tj];
-                });
-                rcols.push_back(tcols[idx[0]]), rdata.push_back(tdata[idx[0]]);
-                for (MKL_INT l = 1; l < (MKL_INT)tcols.size(); l++)
-                    if (rcols.back() == tcols[idx[l]])
-                        rdata.back() += tdata[idx[l]];
-                    else if (abs(rdata.back()) < TINY)
-                        rcols.back() = tcols[idx[l]],
-                        rdata.back() = tdata[idx[l]];
-                    else
-                        rcols.push_back(tcols[idx[l]]),
-                            rdata.push_back(tdata[idx[l]]);
-                i_alloc->deallocate(idx, tcols.size() * _MINTSZ);
-            }
-        }
-        r_idx[am] = (MKL_INT)rcols.size();
+            tmps.push_back(b.transpose(d_alloc));
+        const CSRMatrixRef &ta = conja ? tmps[0] : a;
+        const CSRMatrixRef &tb = conjb ? tmps.back() : b;
+        const bool acc = cfactor != 0 && c.nnz != 0;
+        vector<MKL_INT> r_idx(am + 1);
+        multiply_symbolic(ta, tb, acc ? &c : nullptr, r_idx.data());
+        // when c is not accumulated, the product replaces c in its
+        // allocator (if it is a stack), using the predicted size
+        shared_ptr<Allocator<double>> c_alloc = c.alloc;
+        if (!acc && c.data != nullptr)
+            c.deallocate();
         CSRMatrixRef r(c.m, c.n, r_idx[am], nullptr, nullptr, nullptr);
-        r.alloc = d_alloc;
+        r.alloc = !acc && dynamic_pointer_cast<StackAllocator<double>>(c_alloc)
+                      ? c_alloc
+                      : d_alloc;
         r.allocate();
-        if (r.nnz != r.size()) {
-            memcpy(r.rows, r_idx, (r.m + 1) * sizeof(MKL_INT));
-            memcpy(r.cols, rcols.data(), r.nnz * sizeof(MKL_INT));
-        }
-        memcpy(r.data, rdata.data(), r.nnz * sizeof(double));
-        c.deallocate();
+        multiply_numeric(ta, tb, acc ? &c : nullptr, r_idx.data(), r, scale,
+                         cfactor);
+        if (acc)
+            c.deallocate();
         c = r;
-        i_alloc->deallocate(r_idx, (c.m + 1) * _MINTSZ);
         for (MKL_INT it = conja + conjb - 1; it >= 0; it--)
             tmps[it].deallocate();
     }
+    // Minimal number of nonzeros in the operands of a sparse-sparse
+    // product for parallelizing it over rows (only outside of other
+    // parallel regions)
+    static MKL_INT &multiply_parallel_nnz() {
+        static MKL_INT parallel_nnz = 1 << 14;
+        return parallel_nnz;
+    }
+    static int multiply_threads(const CSRMatrixRef &a, const CSRMatrixRef &b) {
+#ifdef _OPENMP
+        if (!omp_in_parallel() && a.nnz + b.nnz >= multiply_parallel_nnz())
+            return omp_get_max_threads();
+#endif
+        return 1;
+    }
+    // Symbolic phase of the sparse-sparse product a * b (+ c): r_idx[i] is
+    // set to the index of the first nonzero of row i of the product (with
+    // the pattern of c merged if c is not nullptr). r_idx has length a.m + 1
+    // and r_idx[a.m] is the number of nonzeros of the product.
+    static void multiply_symbolic(const CSRMatrixRef &a, const CSRMatrixRef &b,
+                                  const CSRMatrixRef *c, MKL_INT *r_idx) {
+        const MKL_INT am = a.m, bn = b.n;
+        int ntg = multiply_threads(a, b);
+        r_idx[0] = 0;
+#pragma omp parallel num_threads(ntg)
+        {
+            vector<MKL_INT> mask(bn, -1);
+#pragma omp for schedule(dynamic, 64)
+            for (MKL_INT i = 0; i < am; i++) {
+                MKL_INT k = 0;
+                if (c != nullptr) {
+                    MKL_INT jp = c->rows[i],
+                            jr = i == c->m - 1 ? c->nnz : c->rows[i + 1];
+                    for (MKL_INT j = jp; j < jr; j++)
+                        mask[c->cols[j]] = i, k++;
+                }
+                MKL_INT jp = a.rows[i],
+                        jr = i == am - 1 ? a.nnz : a.rows[i + 1];
+                for (MKL_INT j = jp; j < jr; j++) {
+                    MKL_INT kp = b.rows[a.cols[j]],
+                            kr = a.cols[j] == b.m - 1 ? b.nnz
+                                                      : b.rows[a.cols[j] + 1];
+                    for (MKL_INT kk = kp; kk < kr; kk++)
+                        if (mask[b.cols[kk]] != i)
+                            mask[b.cols[kk]] = i, k++;
+                }
+                r_idx[i + 1] = k;
+            }
+        }
+        for (MKL_INT i = 0; i < am; i++)
+            r_idx[i + 1] += r_idx[i];
+    }
+    // Number of nonzeros of op(a) * op(b) (a and b in CSR format), for
+    // allocating the output of the sparse-sparse multiply in advance
+    static MKL_INT multiply_nnz(const CSRMatrixRef &a, bool conja,
+                                const CSRMatrixRef &b, bool conjb) {
+        if (a.nnz == a.size() || b.nnz == b.size())
+            return (MKL_INT)((size_t)(conja ? a.n : a.m) * (conjb ? b.m : b.n));
+        shared_ptr<VectorAllocator<double>> d_alloc =
+            make_shared<VectorAllocator<double>>();
+        CSRMatrixRef ta = conja ? a.transpose(d_alloc) : a;
+        CSRMatrixRef tb = conjb ? b.transpose(d_alloc) : b;
+        vector<MKL_INT> r_idx(ta.m + 1);
+        multiply_symbolic(ta, tb, nullptr, r_idx.data());
+        return r_idx[ta.m];
+    }
+    // Numeric phase of the sparse-sparse product:
+    // r = scale * a * b (+ cfactor * c), with the pattern r_idx from
+    // multiply_symbolic and r allocated with r_idx[a.m] nonzeros
+    static void multiply_numeric(const CSRMatrixRef &a, const CSRMatrixRef &b,
+                                 const CSRMatrixRef *c, const MKL_INT *r_idx,
+                                 const CSRMatrixRef &r, double scale,
+                                 double cfactor) {
+        const MKL_INT am = a.m, bn = b.n;
+        const bool dense = r.nnz == r.size();
+        if (dense)
+            memset(r.data, 0, sizeof(double) * r.size());
+        else
+            memcpy(r.rows, r_idx, sizeof(MKL_INT) * (am + 1));
+        int ntg = multiply_threads(a, b);
+#pragma omp parallel num_threads(ntg)
+        {
+            vector<MKL_INT> mask(dense ? 0 : bn, -1);
+            vector<double> work(dense ? 0 : bn);
+#pragma omp for schedule(dynamic, 64)
+            for (MKL_INT i = 0; i < am; i++) {
+                double *rd = dense ? r.data + (size_t)i * bn : work.data();
+                MKL_INT *rc = dense ? nullptr : r.cols + r_idx[i];
+                MKL_INT k = 0;
+                if (c != nullptr) {
+                    MKL_INT jp = c->rows[i],
+                            jr = i == c->m - 1 ? c->nnz : c->rows[i + 1];
+                    for (MKL_INT j = jp; j < jr; j++) {
+                        if (!dense)
+                            mask[c->cols[j]] = i, rc[k++] = c->cols[j];
+                        rd[c->cols[j]] = c->data[j] * cfactor;
+                    }
+                }
+                MKL_INT jp = a.rows[i],
+                        jr = i == am - 1 ? a.nnz : a.rows[i + 1];
+                for (MKL_INT j = jp; j < jr; j++) {
+                    const double x = a.data[j] * scale;
+                    MKL_INT kp = b.rows[a.cols[j]],
+                            kr = a.cols[j] == b.m - 1 ? b.nnz
+                                                      : b.rows[a.cols[j] + 1];
+                    for (MKL_INT kk = kp; kk < kr; kk++) {
+                        const MKL_INT col = b.cols[kk];
+                        if (dense)
+                            rd[col] += x * b.data[kk];
+                        else if (mask[col] != i)
+                            mask[col] = i, rc[k++] = col,
+                            rd[col] = x * b.data[kk];
+                        else
+                            rd[col] += x * b.data[kk];
+                    }
+                }
+                if (!dense) {
+                    assert(k == r_idx[i + 1] - r_idx[i]);
+                    sort(rc, rc + k);
+                    for (MKL_INT l = 0; l < k; l++)
+                        r.data[r_idx[i] + l] = rd[rc[l]];
+                }
+            }
+        }
+    }
     static void multiply(const MatrixRef &a, bool conja, const CSRMatrixRef &b,
                          bool conjb, const MatrixRef &c, double scale,
                          double cfactor) {
         if (b.nnz == b.size())
             return MatrixFunctions::multiply(a, conja, b.dense_ref(), conjb, c,
                                              scale, cfactor);
+        if (csrmm_offload(b))
+            return csrmm_backend_()(b, conjb, a, conja, false, c, scale,
+                                    cfactor);
 #ifdef _HAS_INTEL_MKL
         struct matrix_descr mt;
         mt.type = SPARSE_MATRIX_TYPE_GENERAL;
@@ -462,6 +620,9 @@ struct CSRMatrixFunctions {
         if (a.nnz == a.size())
             return MatrixFunctions::multiply(a.dense_ref(), conja, b, conjb, c,
                                              scale, cfactor);
+        if (csrmm_offload(a))
+            return csrmm_backend_()(a, conja, b, conjb, true, c, scale,
+                                    cfactor);
 #ifdef _HAS_INTEL_MKL
         const struct matrix_descr mt {
             SPARSE_MATRIX_TYPE_GENERAL, SPARSE_FILL_MODE_LOWER,
@@ -113,6 +113,11 @@ template <typename S> struct CSRSparseMatrix : SparseMatrix<S> {
                 csr_data[i]->save_data(ofs);
         }
     }
+    // Keep optimized sparse handles for repeated multiplication
+    void optimize(MKL_INT expected_calls) const {
+        for (auto &mat : csr_data)
+            CSRMatrixFunctions::optimize(*mat, expected_calls);
+    }
     CSRMatrixRef &operator[](S q) const { return (*this)[info->find_state(q)]; }
     CSRMatrixRef &operator[](int idx) const {
         assert(idx != -1 && idx < csr_data.size());
@@ -134,6 +139,10 @@ template <typename S> struct CSRSparseMatrix : SparseMatrix<S> {
                 shared_ptr<CSRMatrixRef> mat = cother->csr_data[i];
                 csr_data[i] = make_shared<CSRMatrixRef>(
                     mat->m, mat->n, mat->nnz, mat->data, mat->rows, mat->cols);
+#ifdef _HAS_INTEL_MKL
+                csr_data[i]->mkl_handle = mat->mkl_handle;
+#endif
+                csr_data[i]->device_data = mat->device_data;
             }
     }
     void selective_copy_from(const shared_ptr<SparseMatrix<S>> &other,
@@ -23,6 +23,8 @@
 #include "csr_sparse_matrix.hpp"
 #include "sparse_matrix.hpp"
 #include "expr.hpp"
+#include <list>
+#include <mutex>
 
 using namespace std;
 
@@ -80,6 +82,131 @@ template <typename S> struct DelayedSparseMatrix<S> : SparseMatrix<S> {
     }
 };
 
+// Bounded cache of materialized delayed site operators
+// Keyed by site index, operator and quanta of the (possibly selective) info
+// Least recently used operators are evicted when the memory of the cached
+// operators exceeds max_memory (number of doubles)
+// The cache can be shared by threads
+template <typename S> struct DelayedSparseMatrixCache {
+    struct Entry {
+        size_t hash;
+        uint16_t m;
+        shared_ptr<OpExpr<S>> op;
+        S delta_quantum;
+        vector<S> quanta;
+        vector<ubond_t> n_states_bra, n_states_ket;
+        // data of an operator owning its data,
+        // or the operator itself (sharing external data)
+        vector<double> data;
+        double factor;
+        shared_ptr<SparseMatrix<S>> view;
+        bool match(uint16_t xm, const shared_ptr<OpExpr<S>> &xop,
+                   const shared_ptr<SparseMatrixInfo<S>> &info) const {
+            return m == xm && delta_quantum == info->delta_quantum &&
+                   (int)quanta.size() == info->n && op == xop &&
+                   equal(quanta.begin(), quanta.end(), info->quanta) &&
+                   equal(n_states_bra.begin(), n_states_bra.end(),
+                         info->n_states_bra) &&
+                   equal(n_states_ket.begin(), n_states_ket.end(),
+                         info->n_states_ket);
+        }
+    };
+    size_t max_memory, used = 0;
+    size_t n_hits = 0, n_misses = 0;
+    // most recently used first
+    list<Entry> entries;
+    unordered_multimap<size_t, typename list<Entry>::iterator> index;
+    mutex mtx;
+    DelayedSparseMatrixCache(size_t max_memory) : max_memory(max_memory) {}
+    static size_t
+    hash_key(uint16_t m, const shared_ptr<OpExpr<S>> &op,
+             const shared_ptr<SparseMatrixInfo<S>> &info) noexcept {
+        size_t h = (size_t)m;
+        h ^= hash_value(op) + 0x9E3779B9 + (h << 6) + (h >> 2);
+        h ^= info->delta_quantum.hash() + 0x9E3779B9 + (h << 6) + (h >> 2);
+        h ^= (size_t)info->n + 0x9E3779B9 + (h << 6) + (h >> 2);
+        return h;
+    }
+    typename list<Entry>::iterator
+    find_entry(size_t h, uint16_t m, const shared_ptr<OpExpr<S>> &op,
+               const shared_ptr<SparseMatrixInfo<S>> &info) {
+        auto r = index.equal_range(h);
+        for (auto it = r.first; it != r.second; it++)
+            if (it->second->match(m, op, info))
+                return it->second;
+        return entries.end();
+    }
+    // Return a copy of the cached operator, or nullptr if not cached
+    shared_ptr<SparseMatrix<S>>
+    find(uint16_t m, const shared_ptr<OpExpr<S>> &op,
+         const shared_ptr<SparseMatrixInfo<S>> &info) {
+        const size_t h = hash_key(m, op, info);
+        lock_guard<mutex> lock(mtx);
+        auto it = find_entry(h, m, op, info);
+        if (it == entries.end()) {
+            n_misses++;
+            return nullptr;
+        }
+        n_hits++;
+        entries.splice(entries.begin(), entries, it);
+        if (it->view != nullptr)
+            return make_shared<SparseMatrix<S>>(*it->view);
+        shared_ptr<SparseMatrix<S>> mat = make_shared<SparseMatrix<S>>();
+        mat->allocate(info);
+        assert(mat->total_memory == it->data.size());
+        memcpy(mat->data, it->data.data(), sizeof(double) * it->data.size());
+        mat->factor = it->factor;
+        return mat;
+    }
+    // Add a copy of a built operator (only normal SparseMatrix)
+    void insert(uint16_t m, const shared_ptr<OpExpr<S>> &op,
+                const shared_ptr<SparseMatrix<S>> &mat) {
+        const bool is_view = mat->alloc == nullptr;
+        if (mat->get_type() != SparseMatrixTypes::Normal ||
+            (!is_view && mat->total_memory > max_memory))
+            return;
+        const shared_ptr<SparseMatrixInfo<S>> &info = mat->info;
+        const size_t h = hash_key(m, op, info);
+        lock_guard<mutex> lock(mtx);
+        if (find_entry(h, m, op, info) != entries.end())
+            return;
+        while (!is_view && used + mat->total_memory > max_memory)
+            evict();
+        entries.push_front(Entry());
+        Entry &x = entries.front();
+        x.hash = h, x.m = m, x.op = op, x.delta_quantum = info->delta_quantum;
+        x.quanta = vector<S>(info->quanta, info->quanta + info->n);
+        x.n_states_bra = vector<ubond_t>(info->n_states_bra,
+                                         info->n_states_bra + info->n);
+        x.n_states_ket = vector<ubond_t>(info->n_states_ket,
+                                         info->n_states_ket + info->n);
+        if (is_view)
+            x.view = make_shared<SparseMatrix<S>>(*mat);
+        else
+            x.data = vector<double>(mat->data, mat->data + mat->total_memory);
+        x.factor = mat->factor;
+        used += x.data.size();
+        index.insert(make_pair(h, entries.begin()));
+    }
+    // Remove the least recently used operator (lock must be held)
+    void evict() {
+        assert(!entries.empty());
+        auto r = index.equal_range(entries.back().hash);
+        for (auto it = r.first; it != r.second; it++)
+            if (&*it->second == &entries.back()) {
+                index.erase(it);
+                break;
+            }
+        used -= entries.back().data.size();
+        entries.pop_back();
+    }
+    void clear() {
+        lock_guard<mutex> lock(mtx);
+        while (!entries.empty())
+            evict();
+    }
+};
+
 // Delayed site operator
 template <typename S>
 struct DelayedSparseMatrix<S, OpExpr<S>> : DelayedSparseMatrix<S> {
@@ -163,6 +163,10 @@ template <typename S> struct DelayedTensorFunctions : TensorFunctions<S> {
                     S vdq = pks[k];
                     int iv = (int)(lower_bound(vdqs.begin(), vdqs.end(), vdq) -
                                    vdqs.begin());
+                    // vdq may be out of the streamed part of vmats
+                    if (vidx == -1 &&
+                        (iv == (int)vdqs.size() || vdqs[iv] != vdq))
+                        continue;
                     shared_ptr<SparseMatrix<S>> vmat =
                         vidx == -1 ? (*vmats)[iv] : (*vmats)[vidx++];
                     cmat->info->cinfo = cinfos[ij][k];
@@ -198,6 +202,10 @@ template <typename S> struct DelayedTensorFunctions : TensorFunctions<S> {
                     S vdq = pks[k];
                     int iv = (int)(lower_bound(vdqs.begin(), vdqs.end(), vdq) -
                                    vdqs.begin());
+                    // vdq may be out of the streamed part of vmats
+                    if (vidx == -1 &&
+                        (iv == (int)vdqs.size() || vdqs[iv] != vdq))
+                        continue;
                     shared_ptr<SparseMatrix<S>> vmat =
                         vidx == -1 ? (*vmats)[iv] : (*vmats)[vidx++];
                     cmat->info->cinfo = cinfos[ij][k];
@@ -258,6 +266,26 @@ template <typename S> struct DelayedTensorFunctions : TensorFunctions<S> {
                 }
         }
     }
+    // vmats = expr x cmats, for nroots wavefunctions at once
+    void tensor_product_multi_multiply_panel(
+        const shared_ptr<OpExpr<S>> &expr,
+        const shared_ptr<OperatorTensor<S>> &lopt,
+        const shared_ptr<OperatorTensor<S>> &ropt,
+        const shared_ptr<SparseMatrixGroup<S>> &cmats,
+        const shared_ptr<SparseMatrixGroup<S>> &vmats, int nroots,
+        const unordered_map<
+            S, shared_ptr<typename SparseMatrixInfo<S>::ConnectionInfo>>
+            &cinfos,
+        S opdq, double factor, bool all_reduce) const override {
+        unordered_map<S, int> vdqs;
+        vdqs.reserve(vmats->n / nroots);
+        for (int iv = 0; iv < vmats->n / nroots; iv++)
+            vdqs[vmats->infos[iv]->delta_quantum] = iv;
+        for (int ic = 0; ic < cmats->n / nroots; ic++)
+            this->tensor_product_multi_multiply_roots(expr, lopt, ropt, cmats,
+                                                      vmats, nroots, ic, vdqs,
+                                                      cinfos, opdq, factor);
+    }
     // vmat = expr x cmat
     void tensor_product_multiply(const shared_ptr<OpExpr<S>> &expr,
                                  const shared_ptr<OperatorTensor<S>> &lopt,
@@ -465,6 +493,7 @@ template <typename S> struct DelayedTensorFunctions : TensorFunctions<S> {
                      const shared_ptr<SparseMatrix<S>> &mpst_bra,
                      const shared_ptr<SparseMatrix<S>> &mpst_ket,
                      shared_ptr<OperatorTensor<S>> &c) const override {
+        TracerScope _tr("left_rotate");
         for (auto &p : c->ops) {
             shared_ptr<OpElement<S>> op =
                 dynamic_pointer_cast<OpElement<S>>(p.first);
@@ -491,6 +520,7 @@ template <typename S> struct DelayedTensorFunctions : TensorFunctions<S> {
                       const shared_ptr<SparseMatrix<S>> &mpst_bra,
                       const shared_ptr<SparseMatrix<S>> &mpst_ket,
                       shared_ptr<OperatorTensor<S>> &c) const override {
+        TracerScope _tr("right_rotate");
         for (auto &p : c->ops) {
             shared_ptr<OpElement<S>> op =
                 dynamic_pointer_cast<OpElement<S>>(p.first);
@@ -580,6 +610,7 @@ template <typename S> struct DelayedTensorFunctions : TensorFunctions<S> {
                        shared_ptr<OperatorTensor<S>> &c,
                        const shared_ptr<Symbolic<S>> &cexprs = nullptr,
                        OpNamesSet delayed = OpNamesSet()) const override {
+        TracerScope _tr("left_contract");
         if (a == nullptr)
             left_assign(b, c);
         else {
@@ -606,6 +637,7 @@ template <typename S> struct DelayedTensorFunctions : TensorFunctions<S> {
                         shared_ptr<OperatorTensor<S>> &c,
                         const shared_ptr<Symbolic<S>> &cexprs = nullptr,
                         OpNamesSet delayed = OpNamesSet()) const override {
+        TracerScope _tr("right_contract");
         if (a == nullptr)
             right_assign(b, c);
         else {
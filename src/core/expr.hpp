@@ -26,8 +26,10 @@
 #include <initializer_list>
 #include <iomanip>
 #include <iostream>
+#include <limits>
 #include <memory>
 #include <sstream>
+#include <unordered_map>
 #include <vector>
 
 using namespace std;
@@ -349,9 +351,10 @@ template <typename S> struct OpProduct : OpExpr<S> {
         return OpProduct(a, b, factor * d, conj);
     }
     bool operator==(const OpProduct &other) const {
-        return *a == *other.a &&
-               (b == nullptr ? other.b == nullptr
-                             : (other.b != nullptr && *b == *other.b)) &&
+        return (a == other.a || (a != nullptr && other.a != nullptr &&
+                                 *a == *other.a)) &&
+               (b == other.b ||
+                (b != nullptr && other.b != nullptr && *b == *other.b)) &&
                factor == other.factor && conj == other.conj;
     }
     size_t hash() const noexcept {
@@ -519,18 +522,27 @@ template <typename S> struct OpExprRef : OpExpr<S> {
     OpTypes get_type() const override { return OpTypes::ExprRef; }
 };
 
+template <typename S> struct OpElementPool;
+
+// If pool is not nullptr, each OpElement is stored as its index in pool
 template <typename S>
-inline void save_expr(const shared_ptr<OpExpr<S>> &x, ostream &ofs) {
+inline void save_expr(const shared_ptr<OpExpr<S>> &x, ostream &ofs,
+                      OpElementPool<S> *pool = nullptr) {
     OpTypes tp = x->get_type();
     ofs.write((char *)&tp, sizeof(tp));
     if (tp == OpTypes::Zero)
         ;
     else if (tp == OpTypes::Elem) {
         shared_ptr<OpElement<S>> op = dynamic_pointer_cast<OpElement<S>>(x);
-        ofs.write((char *)&op->name, sizeof(op->name));
-        ofs.write((char *)&op->site_index, sizeof(op->site_index));
-        ofs.write((char *)&op->factor, sizeof(op->factor));
-        ofs.write((char *)&op->q_label, sizeof(op->q_label));
+        if (pool != nullptr) {
+            uint32_t idx = pool->index(op);
+            ofs.write((char *)&idx, sizeof(idx));
+        } else {
+            ofs.write((char *)&op->name, sizeof(op->name));
+            ofs.write((char *)&op->site_index, sizeof(op->site_index));
+            ofs.write((char *)&op->factor, sizeof(op->factor));
+            ofs.write((char *)&op->q_label, sizeof(op->q_label));
+        }
     } else if (tp == OpTypes::Prod) {
         shared_ptr<OpProduct<S>> op = dynamic_pointer_cast<OpProduct<S>>(x);
         ofs.write((char *)&op->factor, sizeof(op->factor));
@@ -539,22 +551,22 @@ inline void save_expr(const shared_ptr<OpExpr<S>> &x, ostream &ofs) {
             (uint8_t)((uint8_t)(op->a != nullptr) | ((op->b != nullptr) << 1));
         ofs.write((char *)&has_ab, sizeof(has_ab));
         if (has_ab & 1)
-            save_expr<S>(op->a, ofs);
+            save_expr<S>(op->a, ofs, pool);
         if (has_ab & 2)
-            save_expr<S>(op->b, ofs);
+            save_expr<S>(op->b, ofs, pool);
     } else if (tp == OpTypes::Sum) {
         shared_ptr<OpSum<S>> op = dynamic_pointer_cast<OpSum<S>>(x);
         int sz = (int)op->strings.size();
         ofs.write((char *)&sz, sizeof(sz));
         for (int i = 0; i < sz; i++)
-            save_expr<S>(op->strings[i], ofs);
+            save_expr<S>(op->strings[i], ofs, pool);
     } else if (tp == OpTypes::ElemRef) {
         shared_ptr<OpElementRef<S>> op =
             dynamic_pointer_cast<OpElementRef<S>>(x);
         ofs.write((char *)&op->factor, sizeof(op->factor));
         ofs.write((char *)&op->trans, sizeof(op->trans));
         assert(op->op != nullptr);
-        save_expr<S>(op->op, ofs);
+        save_expr<S>(op->op, ofs, pool);
     } else if (tp == OpTypes::SumProd) {
         shared_ptr<OpSumProd<S>> op = dynamic_pointer_cast<OpSumProd<S>>(x);
         ofs.write((char *)&op->factor, sizeof(op->factor));
@@ -564,16 +576,16 @@ inline void save_expr(const shared_ptr<OpExpr<S>> &x, ostream &ofs) {
                       ((op->c != nullptr) << 2));
         ofs.write((char *)&has_abc, sizeof(has_abc));
         if (has_abc & 1)
-            save_expr<S>(op->a, ofs);
+            save_expr<S>(op->a, ofs, pool);
         if (has_abc & 2)
-            save_expr<S>(op->b, ofs);
+            save_expr<S>(op->b, ofs, pool);
         if (has_abc & 4)
-            save_expr<S>(op->c, ofs);
+            save_expr<S>(op->c, ofs, pool);
         assert(op->ops.size() == op->conjs.size());
         int sz = (int)op->ops.size();
         ofs.write((char *)&sz, sizeof(sz));
         for (int i = 0; i < sz; i++)
-            save_expr<S>(op->ops[i], ofs);
+            save_expr<S>(op->ops[i], ofs, pool);
         for (int i = 0; i < sz; i++) {
             bool x = op->conjs[i];
             ofs.write((char *)&x, sizeof(x));
@@ -582,21 +594,27 @@ inline void save_expr(const shared_ptr<OpExpr<S>> &x, ostream &ofs) {
         shared_ptr<OpExprRef<S>> op = dynamic_pointer_cast<OpExprRef<S>>(x);
         ofs.write((char *)&op->is_local, sizeof(op->is_local));
         assert(op->op != nullptr);
-        save_expr<S>(op->op, ofs);
+        save_expr<S>(op->op, ofs, pool);
         uint8_t has_orig = op->orig != nullptr;
         ofs.write((char *)&has_orig, sizeof(has_orig));
         if (has_orig & 1)
-            save_expr<S>(op->orig, ofs);
+            save_expr<S>(op->orig, ofs, pool);
     } else
         assert(false);
 }
 
-template <typename S> inline shared_ptr<OpExpr<S>> load_expr(istream &ifs) {
+template <typename S>
+inline shared_ptr<OpExpr<S>> load_expr(istream &ifs,
+                                       const OpElementPool<S> *pool = nullptr) {
     OpTypes tp;
     ifs.read((char *)&tp, sizeof(tp));
     if (tp == OpTypes::Zero)
         return make_shared<OpExpr<S>>();
-    else if (tp == OpTypes::Elem) {
+    else if (tp == OpTypes::Elem && pool != nullptr) {
+        uint32_t idx;
+        ifs.read((char *)&idx, sizeof(idx));
+        return (*pool)[idx];
+    } else if (tp == OpTypes::Elem) {
         OpNames name;
         SiteIndex site_index;
         double factor;
@@ -613,25 +631,35 @@ template <typename S> inline shared_ptr<OpExpr<S>> load_expr(istream &ifs) {
         ifs.read((char *)&conj, sizeof(conj));
         ifs.read((char *)&has_ab, sizeof(has_ab));
         shared_ptr<OpElement<S>> a =
-            (has_ab & 1) ? dynamic_pointer_cast<OpElement<S>>(load_expr<S>(ifs))
-                         : nullptr;
+            (has_ab & 1)
+                ? dynamic_pointer_cast<OpElement<S>>(load_expr<S>(ifs, pool))
+                : nullptr;
         shared_ptr<OpElement<S>> b =
-            (has_ab & 2) ? dynamic_pointer_cast<OpElement<S>>(load_expr<S>(ifs))
-                         : nullptr;
-        return make_shared<OpProduct<S>>(a, b, factor, conj);
+            (has_ab & 2)
+                ? dynamic_pointer_cast<OpElement<S>>(load_expr<S>(ifs, pool))
+                : nullptr;
+        shared_ptr<OpProduct<S>> r =
+            make_shared<OpProduct<S>>(a, b, factor, conj);
+        // keep the shared pool elements instead of the copies
+        if (pool != nullptr && a != nullptr && a->factor == 1.0)
+            r->a = a;
+        if (pool != nullptr && b != nullptr && b->factor == 1.0)
+            r->b = b;
+        return r;
     } else if (tp == OpTypes::Sum) {
         int sz;
         ifs.read((char *)&sz, sizeof(sz));
         vector<shared_ptr<OpProduct<S>>> strings(sz);
         for (int i = 0; i < sz; i++)
-            strings[i] = dynamic_pointer_cast<OpProduct<S>>(load_expr<S>(ifs));
+            strings[i] =
+                dynamic_pointer_cast<OpProduct<S>>(load_expr<S>(ifs, pool));
         return make_shared<OpSum<S>>(strings);
     } else if (tp == OpTypes::ElemRef) {
         int8_t factor, trans;
         ifs.read((char *)&factor, sizeof(factor));
         ifs.read((char *)&trans, sizeof(trans));
         shared_ptr<OpElement<S>> op =
-            dynamic_pointer_cast<OpElement<S>>(load_expr<S>(ifs));
+            dynamic_pointer_cast<OpElement<S>>(load_expr<S>(ifs, pool));
         return make_shared<OpElementRef<S>>(op, trans, factor);
     } else if (tp == OpTypes::SumProd) {
         double factor;
@@ -641,39 +669,46 @@ template <typename S> inline shared_ptr<OpExpr<S>> load_expr(istream &ifs) {
         ifs.read((char *)&has_abc, sizeof(has_abc));
         shared_ptr<OpElement<S>> a =
             (has_abc & 1)
-                ? dynamic_pointer_cast<OpElement<S>>(load_expr<S>(ifs))
+                ? dynamic_pointer_cast<OpElement<S>>(load_expr<S>(ifs, pool))
                 : nullptr;
         shared_ptr<OpElement<S>> b =
             (has_abc & 2)
-                ? dynamic_pointer_cast<OpElement<S>>(load_expr<S>(ifs))
+                ? dynamic_pointer_cast<OpElement<S>>(load_expr<S>(ifs, pool))
                 : nullptr;
         shared_ptr<OpElement<S>> c =
             (has_abc & 4)
-                ? dynamic_pointer_cast<OpElement<S>>(load_expr<S>(ifs))
+                ? dynamic_pointer_cast<OpElement<S>>(load_expr<S>(ifs, pool))
                 : nullptr;
         int sz;
         ifs.read((char *)&sz, sizeof(sz));
         vector<shared_ptr<OpElement<S>>> ops(sz);
         vector<bool> conjs(sz);
         for (int i = 0; i < sz; i++)
-            ops[i] = dynamic_pointer_cast<OpElement<S>>(load_expr<S>(ifs));
+            ops[i] =
+                dynamic_pointer_cast<OpElement<S>>(load_expr<S>(ifs, pool));
         for (int i = 0; i < sz; i++) {
             bool x;
             ifs.read((char *)&x, sizeof(x));
             conjs[i] = x;
         }
         assert(a == nullptr || b == nullptr);
-        return b == nullptr
-                   ? make_shared<OpSumProd<S>>(a, ops, conjs, factor, conj, c)
-                   : make_shared<OpSumProd<S>>(ops, b, conjs, factor, conj, c);
+        shared_ptr<OpSumProd<S>> r =
+            b == nullptr
+                ? make_shared<OpSumProd<S>>(a, ops, conjs, factor, conj, c)
+                : make_shared<OpSumProd<S>>(ops, b, conjs, factor, conj, c);
+        if (pool != nullptr && a != nullptr && a->factor == 1.0)
+            r->a = a;
+        if (pool != nullptr && b != nullptr && b->factor == 1.0)
+            r->b = b;
+        return r;
     } else if (tp == OpTypes::ExprRef) {
         bool is_local;
         ifs.read((char *)&is_local, sizeof(is_local));
-        shared_ptr<OpExpr<S>> op = load_expr<S>(ifs);
+        shared_ptr<OpExpr<S>> op = load_expr<S>(ifs, pool);
         uint8_t has_orig;
         ifs.read((char *)&has_orig, sizeof(has_orig));
         shared_ptr<OpExpr<S>> orig =
-            (has_orig & 1) ? load_expr<S>(ifs) : nullptr;
+            (has_orig & 1) ? load_expr<S>(ifs, pool) : nullptr;
         return make_shared<OpExprRef<S>>(op, is_local, orig);
     } else {
         assert(false);
@@ -735,7 +770,9 @@ template <typename S> inline string to_str(const shared_ptr<OpExpr<S>> &x) {
 template <typename S>
 inline bool operator==(const shared_ptr<OpExpr<S>> &a,
                        const shared_ptr<OpExpr<S>> &b) {
-    if (a->get_type() != b->get_type())
+    if (a.get() == b.get())
+        return true;
+    else if (a->get_type() != b->get_type())
         return false;
     switch (a->get_type()) {
     case OpTypes::Zero:
@@ -1048,3 +1085,156 @@ template <typename S> struct hash<shared_ptr<block2::OpExpr<S>>> {
 };
 
 } // namespace std
+
+namespace block2 {
+
+// Hash-consing table of operator expressions
+// Equal OpElement and OpProduct nodes are interned as one shared node, so
+// that interned nodes can be compared by pointer. Products are keyed by the
+// interned pointers of their operands. Sums and SumProds are kept (their
+// operands are interned in place). Interning is not thread-safe
+template <typename S> struct OpExprInterner {
+    struct ProdKey {
+        OpElement<S> *a, *b;
+        double factor;
+        uint8_t conj;
+        bool operator==(const ProdKey &other) const {
+            return a == other.a && b == other.b && factor == other.factor &&
+                   conj == other.conj;
+        }
+    };
+    struct ProdKeyHash {
+        size_t operator()(const ProdKey &k) const noexcept {
+            size_t h = std::hash<double>{}(k.factor);
+            h ^= (size_t)k.a + 0x9E3779B9 + (h << 6) + (h >> 2);
+            h ^= (size_t)k.b + 0x9E3779B9 + (h << 6) + (h >> 2);
+            h ^= k.conj + 0x9E3779B9 + (h << 6) + (h >> 2);
+            return h;
+        }
+    };
+    unordered_map<OpElement<S>, shared_ptr<OpElement<S>>> elems;
+    unordered_map<ProdKey, shared_ptr<OpProduct<S>>, ProdKeyHash> prods;
+    // number of nodes replaced by an equal interned node
+    size_t n_shared = 0;
+    shared_ptr<OpElement<S>> intern(const shared_ptr<OpElement<S>> &x) {
+        if (x == nullptr)
+            return x;
+        auto it = elems.emplace(*x, x).first;
+        // OpElement::operator== ignores quantum numbers and small factors
+        if (it->second->q_label != x->q_label ||
+            it->second->factor != x->factor)
+            return x;
+        n_shared += it->second != x;
+        return it->second;
+    }
+    shared_ptr<OpProduct<S>> intern_product(const shared_ptr<OpProduct<S>> &x) {
+        if (x->get_type() == OpTypes::SumProd) {
+            shared_ptr<OpSumProd<S>> sp = dynamic_pointer_cast<OpSumProd<S>>(x);
+            sp->a = intern(sp->a), sp->b = intern(sp->b);
+            for (auto &op : sp->ops)
+                op = intern(op);
+            return x;
+        }
+        x->a = intern(x->a), x->b = intern(x->b);
+        auto it =
+            prods.emplace(ProdKey{x->a.get(), x->b.get(), x->factor, x->conj}, x)
+                .first;
+        n_shared += it->second != x;
+        return it->second;
+    }
+    shared_ptr<OpExpr<S>> intern(const shared_ptr<OpExpr<S>> &x) {
+        switch (x->get_type()) {
+        case OpTypes::Elem:
+            return intern(dynamic_pointer_cast<OpElement<S>>(x));
+        case OpTypes::Prod:
+        case OpTypes::SumProd:
+            return intern_product(dynamic_pointer_cast<OpProduct<S>>(x));
+        case OpTypes::Sum:
+            for (auto &r : dynamic_pointer_cast<OpSum<S>>(x)->strings)
+                r = intern_product(r);
+            return x;
+        default:
+            return x;
+        }
+    }
+};
+
+// Pooled storage of operator elements for serialization
+// Each distinct element (including quantum number and factor) is stored
+// once in the pool and referenced by its index in save_expr/load_expr.
+// Loaded elements are shared by all expressions referencing them
+template <typename S> struct OpElementPool {
+    struct ElemKey {
+        OpNames name;
+        uint64_t site;
+        double factor;
+        S q_label;
+        bool operator==(const ElemKey &other) const {
+            return name == other.name && site == other.site &&
+                   factor == other.factor && q_label == other.q_label;
+        }
+    };
+    struct ElemKeyHash {
+        size_t operator()(const ElemKey &k) const noexcept {
+            size_t h = (size_t)k.name;
+            h ^= (size_t)k.site + 0x9E3779B9 + (h << 6) + (h >> 2);
+            h ^= std::hash<double>{}(k.factor) + 0x9E3779B9 + (h << 6) +
+                 (h >> 2);
+            h ^= k.q_label.hash() + 0x9E3779B9 + (h << 6) + (h >> 2);
+            return h;
+        }
+    };
+    vector<shared_ptr<OpElement<S>>> elems;
+    unordered_map<ElemKey, uint32_t, ElemKeyHash> indices;
+    size_t size() const { return elems.size(); }
+    const shared_ptr<OpElement<S>> &operator[](uint32_t idx) const {
+        assert(idx < elems.size());
+        return elems[idx];
+    }
+    // Index of x in the pool, x is added if not present
+    uint32_t index(const shared_ptr<OpElement<S>> &x) {
+        ElemKey k{x->name, x->site_index.data, x->factor, x->q_label};
+        auto it = indices.emplace(k, (uint32_t)elems.size());
+        if (it.second) {
+            assert(elems.size() < (size_t)numeric_limits<uint32_t>::max());
+            elems.push_back(x);
+        }
+        return it.first->second;
+    }
+    // Elements are stored as separate arrays of each field
+    void save_data(ostream &ofs) const {
+        size_t n = elems.size();
+        vector<OpNames> names(n);
+        vector<SiteIndex> site_indices(n);
+        vector<double> factors(n);
+        vector<S> q_labels(n);
+        for (size_t i = 0; i < n; i++) {
+            names[i] = elems[i]->name, site_indices[i] = elems[i]->site_index;
+            factors[i] = elems[i]->factor, q_labels[i] = elems[i]->q_label;
+        }
+        ofs.write((char *)&n, sizeof(n));
+        ofs.write((char *)names.data(), sizeof(OpNames) * n);
+        ofs.write((char *)site_indices.data(), sizeof(SiteIndex) * n);
+        ofs.write((char *)factors.data(), sizeof(double) * n);
+        ofs.write((char *)q_labels.data(), sizeof(S) * n);
+    }
+    void load_data(istream &ifs) {
+        size_t n;
+        ifs.read((char *)&n, sizeof(n));
+        vector<OpNames> names(n);
+        vector<SiteIndex> site_indices(n);
+        vector<double> factors(n);
+        vector<S> q_labels(n);
+        ifs.read((char *)names.data(), sizeof(OpNames) * n);
+        ifs.read((char *)site_indices.data(), sizeof(SiteIndex) * n);
+        ifs.read((char *)factors.data(), sizeof(double) * n);
+        ifs.read((char *)q_labels.data(), sizeof(S) * n);
+        elems.clear(), indices.clear();
+        elems.reserve(n);
+        for (size_t i = 0; i < n; i++)
+            index(make_shared<OpElement<S>>(names[i], site_indices[i],
+                                            q_labels[i], factors[i]));
+    }
+};
+
+} // namespace block2
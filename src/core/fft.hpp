@@ -29,6 +29,7 @@
 #include <cmath>
 #include <complex>
 #include <cstring>
+#include <map>
 #include <memory>
 #include <vector>
 
@@ -394,6 +395,8 @@ struct DFT {
  */
 template <typename F, int P, int... Q>
 struct FactorizedFFT : FactorizedFFT<F, Q...> {
+    map<size_t, shared_ptr<BasicFFT<P>>>
+        radix_ffts; //!< Cached radix-P FFT backends for each array length.
     /** Default constructor. */
     FactorizedFFT() : FactorizedFFT<F, Q...>(P) {}
     /** Constructor.
@@ -402,6 +405,11 @@ struct FactorizedFFT : FactorizedFFT<F, Q...> {
      */
     FactorizedFFT(int max_factor)
         : FactorizedFFT<F, Q...>(max(max_factor, P)) {}
+    /** Remove all cached FFT backends. */
+    void clear_backends() override {
+        radix_ffts.clear();
+        FactorizedFFT<F, Q...>::clear_backends();
+    }
     /** Perform independent FFTs for p arrays, each with length q.
      * @param arr A pointer to the array of complex numbers (as a matrix).
      * @param p Number of rows (FFTs).
@@ -413,10 +421,11 @@ struct FactorizedFFT : FactorizedFFT<F, Q...> {
                       int b) override {
         switch (b) {
         case P: {
-            BasicFFT<P> fft;
-            fft.init(q);
-            for (int ip = 0; ip < p; ip++)
-                fft.fft(arr + ip * q, q, forth);
+            shared_ptr<BasicFFT<P>> &fft = radix_ffts[q];
+            if (fft == nullptr)
+                fft = make_shared<BasicFFT<P>>(), fft->init(q);
+            for (size_t ip = 0; ip < p; ip++)
+                fft->fft(arr + ip * q, q, forth);
         } break;
         default:
             FactorizedFFT<F, Q...>::fft_internal(arr, p, q, forth, b);
@@ -435,6 +444,16 @@ struct FactorizedFFT : FactorizedFFT<F, Q...> {
 template <typename F, int P> struct FactorizedFFT<F, P> {
     const int max_factor = P; //!< Maximal radix number.
     shared_ptr<Prime> prime;  //!< Instance for prime number algorithms.
+    map<size_t, pair<vector<size_t>, vector<int>>>
+        plans; //!< Cached factors and radices for each array length.
+    map<size_t, vector<complex<double>>>
+        twiddles; //!< Cached roots exp(-i2pi k/n) for the Cooley-Tukey
+                  //!< twiddle factors for each array length n.
+    map<size_t, shared_ptr<BasicFFT<P>>>
+        radix_ffts; //!< Cached radix-P FFT backends for each array length.
+    map<size_t, shared_ptr<F>>
+        prime_ffts; //!< Cached prime number FFT backends (with their
+                    //!< convolution kernels) for each array length.
     /** Default constructor. */
     FactorizedFFT() : prime(make_shared<Prime>()) {}
     /** Constructor.
@@ -443,11 +462,66 @@ template <typename F, int P> struct FactorizedFFT<F, P> {
      */
     FactorizedFFT(int max_factor)
         : max_factor(max(max_factor, P)), prime(make_shared<Prime>()) {}
+    virtual ~FactorizedFFT() = default;
     /** Precompute for array length n for both forward and backward FFT.
-     * For FactorizedFFT this method does nothing.
+     * The factorization, twiddle factors and FFT backends for n are cached
+     * (by transforming a zero array), so that later FFTs with the same
+     * array length do not recompute them.
      * @param n The array length.
      */
-    void init(size_t n) {}
+    void init(size_t n) {
+        vector<complex<double>> arx(n);
+        fft(arx.data(), n, true);
+    }
+    /** Remove all cached plans and FFT backends. */
+    void clear() {
+        plans.clear(), twiddles.clear();
+        clear_backends();
+    }
+    /** Remove all cached FFT backends. */
+    virtual void clear_backends() { radix_ffts.clear(), prime_ffts.clear(); }
+    /** Get the factors and radices for array length n (cached).
+     * @param n The array length.
+     * @return The factors of n and the radix for each factor (zero if radix
+     *   based FFT should not be used).
+     */
+    const pair<vector<size_t>, vector<int>> &get_plan(size_t n) {
+        typename map<size_t, pair<vector<size_t>, vector<int>>>::iterator it =
+            plans.find(n);
+        if (it != plans.end())
+            return it->second;
+        vector<pair<typename Prime::LL, int>> factors;
+        prime->factors((Prime::LL)n, factors);
+        pair<vector<size_t>, vector<int>> &plan = plans[n];
+        vector<size_t> &pr = plan.first;
+        vector<int> &b = plan.second;
+        pr.reserve(factors.size());
+        b.reserve(factors.size());
+        for (auto &f : factors) {
+            if (f.first <= max_factor)
+                pr.push_back((size_t)Prime::power(f.first, f.second)),
+                    b.push_back(f.first);
+            else
+                for (int i = 0; i < f.second; i++)
+                    pr.push_back((size_t)f.first), b.push_back(0);
+        }
+        return plan;
+    }
+    /** Get the roots exp(-i2pi k/n) for k = 0, 1, ..., n - 1 (cached).
+     * @param n The array length.
+     * @return The array of roots.
+     */
+    const vector<complex<double>> &get_twiddles(size_t n) {
+        const static double pi = acos(-1);
+        vector<complex<double>> &w = twiddles[n];
+        if (w.size() != n) {
+            w.resize(n);
+            for (size_t i = 0; i < n; i++)
+                w[i] =
+                    complex<double>(cos(2 * pi * i / n), -sin(2 * pi * i / n));
+        }
+        return w;
+    }
     /** Perform independent FFTs for p arrays, each with length q.
      * @param arr A pointer to the array of complex numbers (as a matrix).
      * @param p Number of rows (FFTs).
@@ -459,16 +533,18 @@ template <typename F, int P> struct FactorizedFFT<F, P> {
                               bool forth, int b) {
         switch (b) {
         case P: {
-            BasicFFT<P> fft;
-            fft.init(q);
-            for (int ip = 0; ip < p; ip++)
-                fft.fft(arr + ip * q, q, forth);
+            shared_ptr<BasicFFT<P>> &fft = radix_ffts[q];
+            if (fft == nullptr)
+                fft = make_shared<BasicFFT<P>>(), fft->init(q);
+            for (size_t ip = 0; ip < p; ip++)
+                fft->fft(arr + ip * q, q, forth);
         } break;
         default: {
-            F fft = F(make_shared<Prime>());
-            fft.init(q);
-            for (int ip = 0; ip < p; ip++)
-                fft.fft(arr + ip * q, q, forth);
+            shared_ptr<F> &fft = prime_ffts[q];
+            if (fft == nullptr)
+                fft = make_shared<F>(prime), fft->init(q);
+            for (size_t ip = 0; ip < p; ip++)
+                fft->fft(arr + ip * q, q, forth);
         } break;
         }
     }
@@ -484,12 +560,12 @@ template <typename F, int P> struct FactorizedFFT<F, P> {
      */
     void cooley_tukey(complex<double> *arr, size_t n, bool forth,
                       const size_t *pr, const int *b, size_t np) {
-        const complex<double> ipi(0, forth ? acos(-1) : -acos(-1));
         size_t p = pr[0];
         assert(n % p == 0);
         const size_t q = n / p;
         if (q == 1)
             return fft_internal(arr, q, p, forth, b[0]);
+        const vector<complex<double>> &w = get_twiddles(n);
         vector<complex<double>> arx(arr, arr + n);
         for (int ip = 0; ip < p; ip++)
             for (int iq = 0; iq < q; iq++)
@@ -500,9 +576,10 @@ template <typename F, int P> struct FactorizedFFT<F, P> {
             for (int ip = 0; ip < p; ip++)
                 cooley_tukey(arr + ip * q, q, forth, pr + 1, b + 1, np - 1);
         for (size_t ip = 0; ip < p; ip++)
-            for (int iq = 0; iq < q; iq++)
+            for (size_t iq = 0; iq < q; iq++)
                 arx[iq * p + ip] =
-                    arr[ip * q + iq] * exp(ipi * (-2.0 * ip * iq / n));
+                    arr[ip * q + iq] *
+                    (forth ? w[ip * iq % n] : conj(w[ip * iq % n]));
         fft_internal(arx.data(), q, p, forth, b[0]);
         for (int ip = 0; ip < p; ip++)
             for (int iq = 0; iq < q; iq++)
@@ -524,21 +601,29 @@ template <typename F, int P> struct FactorizedFFT<F, P> {
     void fft(complex<double> *arr, size_t n, bool forth) {
         if (n <= 1)
             return;
-        vector<pair<typename Prime::LL, int>> factors;
-        prime->factors((Prime::LL)n, factors);
-        vector<size_t> pr;
-        vector<int> b;
-        pr.reserve(factors.size());
-        b.reserve(factors.size());
-        for (auto &f : factors) {
-            if (f.first <= max_factor)
-                pr.push_back((size_t)Prime::power(f.first, f.second)),
-                    b.push_back(f.first);
-            else
-                for (int i = 0; i < f.second; i++)
-                    pr.push_back((size_t)f.first), b.push_back(0);
-        }
-        cooley_tukey(arr, n, forth, pr.data(), b.data(), b.size());
+        const pair<vector<size_t>, vector<int>> &plan = get_plan(n);
+        cooley_tukey(arr, n, forth, plan.first.data(), plan.second.data(),
+                     plan.second.size());
+    }
+    /** Perform inplace FFTs for a batch of arrays with the same length,
+     * stored contiguously. The plan and FFT backends are shared by all
+     * arrays in the batch.
+     * @param arr A pointer to the arrays of complex numbers (as a matrix).
+     * @param n_batch Number of arrays.
+     * @param n Number of elements in each array.
+     * @param forth Whether this is forward transform.
+     */
+    void fft_batch(complex<double> *arr, size_t n_batch, size_t n,
+                   bool forth) {
+        if (n <= 1)
+            return;
+        const pair<vector<size_t>, vector<int>> &plan = get_plan(n);
+        // a single factor is done by one backend for all arrays
+        if (plan.second.size() == 1)
+            return fft_internal(arr, n_batch, n, forth, plan.second[0]);
+        for (size_t ib = 0; ib < n_batch; ib++)
+            cooley_tukey(arr + ib * n, n, forth, plan.first.data(),
+                         plan.second.data(), plan.second.size());
     }
     template <typename FL> static void fftshift(FL *arr, size_t n, bool forth) {
         vector<FL> arx(arr, arr + n);
@@ -23,8 +23,10 @@
 #pragma once
 
 #include "threading.hpp"
+#include <algorithm>
 #include <cassert>
 #include <cstdint>
+#include <cstring>
 #include <iostream>
 #include <sstream>
 #include <string>
@@ -170,6 +172,11 @@ struct FPCodec {
                               //!< processed at one time.
     size_t n_parallel_chunks =
         4096; //!< Number of chunks to be processed in the same batch.
+    bool indexed = false; //!< Whether ``write_array`` should use the indexed
+                          //!< container format, where the compressed length
+                          //!< of all chunks is stored before the chunks, so
+                          //!< that each batch can be read at once and any
+                          //!< range of the array can be decoded on demand.
     /** Default constructor. */
     FPCodec() : prec(0), prec_u(0) {}
     /** Constructor.
@@ -253,12 +260,70 @@ struct FPCodec {
         }
         return enc.finish_encode();
     }
+    /** Compress array of floating-point data into memory, using all threads.
+     * The compressed length of all chunks is stored before the chunks.
+     * @param data The original floating-point array.
+     * @param len The length of the original floating-point array.
+     * @param cpsd Output array for the compressed data (resized if needed).
+     * @return Length of the array for the compressed data.
+     */
+    size_t encode_array(T *data, size_t len, vector<T> &cpsd) const {
+        static_assert(sizeof(T) >= sizeof(size_t), "index does not fit in T");
+        ndata += len;
+        size_t nchunk = (size_t)(len / chunk_size + !!(len % chunk_size));
+        if (cpsd.size() < nchunk * (chunk_size + 2))
+            cpsd.resize(nchunk * (chunk_size + 2));
+        // each chunk is first compressed into its own slot of the array
+        size_t *cplens = (size_t *)cpsd.data();
+        T *pdata = cpsd.data() + nchunk;
+        int ntg = threading->activate_global();
+#pragma omp parallel for schedule(dynamic) num_threads(ntg)
+        for (int64_t ic = 0; ic < (int64_t)nchunk; ic++) {
+            size_t cklen = min(chunk_size, len - ic * chunk_size);
+            cplens[ic] = encode(data + ic * chunk_size, cklen,
+                                pdata + ic * (chunk_size + 1));
+        }
+        threading->activate_normal();
+        size_t cplen = nchunk;
+        for (size_t ic = 0; ic < nchunk; ic++) {
+            memmove(cpsd.data() + cplen, pdata + ic * (chunk_size + 1),
+                    sizeof(T) * cplens[ic]);
+            cplen += cplens[ic];
+        }
+        ncpsd += cplen;
+        return cplen;
+    }
+    /** Decompress array of floating-point data compressed by ``encode_array``,
+     * using all threads.
+     * @param cpsd The compressed floating-point array.
+     * @param len The length of the original floating-point array.
+     * @param data Output array for storing original data. Memory should be
+     * pre-allocated with length = len.
+     */
+    void decode_array(T *cpsd, size_t len, T *data) const {
+        size_t nchunk = (size_t)(len / chunk_size + !!(len % chunk_size));
+        const size_t *cplens = (const size_t *)cpsd;
+        vector<size_t> offsets(nchunk + 1, nchunk);
+        for (size_t ic = 0; ic < nchunk; ic++)
+            offsets[ic + 1] = offsets[ic] + cplens[ic];
+        int ntg = threading->activate_global();
+#pragma omp parallel for schedule(dynamic) num_threads(ntg)
+        for (int64_t ic = 0; ic < (int64_t)nchunk; ic++) {
+            size_t cklen = min(chunk_size, len - ic * chunk_size);
+            size_t dclen = decode(cpsd + offsets[ic], cklen,
+                                  data + ic * chunk_size);
+            assert(dclen == cplens[ic]);
+        }
+        threading->activate_normal();
+    }
     /** Compress array of floating-point data and write into file stream.
      * @param ofs Output stream.
      * @param data The original floating-point array.
      * @param len The length of the original floating-point array.
      */
     void write_array(ostream &ofs, T *data, size_t len) const {
+        if (indexed)
+            return write_array_indexed(ofs, data, len);
         const string magic = "fpc", tail = "end";
         ofs.write((char *)magic.c_str(), 4);
         ofs.write((char *)&chunk_size, sizeof(chunk_size));
@@ -304,6 +369,8 @@ struct FPCodec {
         string magic = "???";
         size_t chunk_size;
         ifs.read((char *)magic.c_str(), 4);
+        if (magic == "fpi")
+            return read_array_indexed(ifs, data, len);
         assert(magic == "fpc");
         ifs.read((char *)&chunk_size, sizeof(chunk_size));
         size_t nchunk = (size_t)(len / chunk_size + !!(len % chunk_size));
@@ -340,6 +407,175 @@ struct FPCodec {
         ifs.read((char *)magic.c_str(), 4);
         assert(magic == "end");
     }
+    /** Compress array of floating-point data and write into file stream,
+     * using the indexed container format.
+     * @param ofs Output stream. Must be seekable.
+     * @param data The original floating-point array.
+     * @param len The length of the original floating-point array.
+     */
+    void write_array_indexed(ostream &ofs, T *data, size_t len) const {
+        const string magic = "fpi", tail = "end";
+        ofs.write((char *)magic.c_str(), 4);
+        ofs.write((char *)&chunk_size, sizeof(chunk_size));
+        ndata += len;
+        size_t nchunk = (size_t)(len / chunk_size + !!(len % chunk_size));
+        size_t nbatch = (size_t)(nchunk / n_parallel_chunks +
+                                 !!(nchunk % n_parallel_chunks));
+        ofs.write((char *)&nchunk, sizeof(nchunk));
+        // the index is filled after all chunks are compressed
+        vector<size_t> cplens(nchunk, 0);
+        const streampos index_pos = ofs.tellp();
+        ofs.write((char *)cplens.data(), sizeof(size_t) * nchunk);
+        T *pdata = new T[(chunk_size + 1) * min(nchunk, n_parallel_chunks)];
+        int ntg = threading->activate_global();
+#pragma omp parallel num_threads(ntg)
+        for (size_t ib = 0; ib < nbatch; ib++) {
+            size_t n_this_chunk =
+                min(nchunk - ib * n_parallel_chunks, n_parallel_chunks);
+            size_t *bcplens = cplens.data() + ib * n_parallel_chunks;
+#pragma omp for schedule(dynamic)
+            for (size_t ic = 0; ic < n_this_chunk; ic++) {
+                size_t batch_offset =
+                    (ic + ib * n_parallel_chunks) * chunk_size;
+                size_t cklen = min(chunk_size, len - batch_offset);
+                bcplens[ic] = encode(data + batch_offset, cklen,
+                                     pdata + ic * (chunk_size + 1));
+            }
+#pragma omp single
+            for (size_t ic = 0; ic < n_this_chunk; ic++) {
+                ofs.write((char *)(pdata + ic * (chunk_size + 1)),
+                          sizeof(T) * bcplens[ic]);
+                ncpsd += bcplens[ic];
+            }
+        }
+        delete[] pdata;
+        threading->activate_normal();
+        ofs.write((char *)tail.c_str(), 4);
+        const streampos end_pos = ofs.tellp();
+        ofs.seekp(index_pos);
+        ofs.write((char *)cplens.data(), sizeof(size_t) * nchunk);
+        ofs.seekp(end_pos);
+    }
+    /** Read the chunk index of the indexed container format.
+     * @param ifs Input stream, after the chunk size.
+     * @param nchunk Expected number of chunks.
+     * @param cplens Compressed length of each chunk (output).
+     */
+    static void read_index(istream &ifs, size_t nchunk,
+                           vector<size_t> &cplens) {
+        size_t nck;
+        ifs.read((char *)&nck, sizeof(nck));
+        assert(nck == nchunk);
+        cplens.resize(nchunk);
+        ifs.read((char *)cplens.data(), sizeof(size_t) * nchunk);
+    }
+    /** Read from file stream and decompress the data, in the indexed container
+     * format. Each batch of chunks is read at once and then decoded by all
+     * threads.
+     * @param ifs Input stream, after the magic string.
+     * @param data The floating-point array for storing the original data.
+     * @param len The length of the original floating-point array.
+     */
+    void read_array_indexed(istream &ifs, T *data, size_t len) const {
+        string magic = "???";
+        size_t chunk_size;
+        ifs.read((char *)&chunk_size, sizeof(chunk_size));
+        size_t nchunk = (size_t)(len / chunk_size + !!(len % chunk_size));
+        vector<size_t> cplens, cpoffs(nchunk + 1, 0);
+        read_index(ifs, nchunk, cplens);
+        for (size_t ic = 0; ic < nchunk; ic++) {
+            assert(cplens[ic] <= chunk_size + 1);
+            cpoffs[ic + 1] = cpoffs[ic] + cplens[ic];
+        }
+        size_t nbatch = (size_t)(nchunk / n_parallel_chunks +
+                                 !!(nchunk % n_parallel_chunks));
+        T *pdata = new T[(chunk_size + 1) * min(nchunk, n_parallel_chunks)];
+        int ntg = threading->activate_global();
+#pragma omp parallel num_threads(ntg)
+        for (size_t ib = 0; ib < nbatch; ib++) {
+            size_t icst = ib * n_parallel_chunks;
+            size_t n_this_chunk = min(nchunk - icst, n_parallel_chunks);
+#pragma omp single
+            ifs.read((char *)pdata,
+                     sizeof(T) * (cpoffs[icst + n_this_chunk] - cpoffs[icst]));
+#pragma omp for schedule(dynamic)
+            for (size_t ic = 0; ic < n_this_chunk; ic++) {
+                size_t batch_offset = (ic + icst) * chunk_size;
+                size_t cklen = min(chunk_size, len - batch_offset);
+                size_t dclen =
+                    decode(pdata + (cpoffs[ic + icst] - cpoffs[icst]), cklen,
+                           data + batch_offset);
+                assert(dclen == cplens[ic + icst]);
+            }
+        }
+        delete[] pdata;
+        threading->activate_normal();
+        ifs.read((char *)magic.c_str(), 4);
+        assert(magic == "end");
+    }
+    /** Decompress only part of the data from file stream. Only the chunks
+     * containing the required range are read (the other chunks are skipped
+     * using the index, or using the chunk headers in the non-indexed
+     * format). After return the stream is positioned after the compressed
+     * data.
+     * @param ifs Input stream. Must be seekable.
+     * @param len The length of the original floating-point array.
+     * @param start Index of the first required element.
+     * @param n Number of required elements.
+     * @param data The floating-point array (of length n) for storing the
+     * required part of the original data.
+     */
+    void read_array_range(istream &ifs, size_t len, size_t start, size_t n,
+                          T *data) const {
+        assert(start + n <= len);
+        string magic = "???";
+        size_t chunk_size;
+        ifs.read((char *)magic.c_str(), 4);
+        assert(magic == "fpc" || magic == "fpi");
+        const bool idx = magic == "fpi";
+        ifs.read((char *)&chunk_size, sizeof(chunk_size));
+        size_t nchunk = (size_t)(len / chunk_size + !!(len % chunk_size));
+        vector<size_t> cplens;
+        if (idx)
+            read_index(ifs, nchunk, cplens);
+        else
+            cplens.resize(nchunk);
+        // file position of each chunk
+        vector<streamoff> cpoffs(nchunk + 1);
+        cpoffs[0] = ifs.tellg();
+        for (size_t ic = 0; ic < nchunk; ic++) {
+            if (!idx) {
+                ifs.seekg(cpoffs[ic]);
+                ifs.read((char *)&cplens[ic], sizeof(size_t));
+                cpoffs[ic] += sizeof(size_t);
+            }
+            assert(cplens[ic] <= chunk_size + 1);
+            cpoffs[ic + 1] = cpoffs[ic] + (streamoff)(sizeof(T) * cplens[ic]);
+        }
+        const size_t icst = n == 0 ? 0 : start / chunk_size;
+        const size_t iced = n == 0 ? 0 : (start + n - 1) / chunk_size + 1;
+        vector<vector<T>> pdata(iced - icst);
+        for (size_t ic = icst; ic < iced; ic++) {
+            pdata[ic - icst].resize(cplens[ic]);
+            ifs.seekg(cpoffs[ic]);
+            ifs.read((char *)pdata[ic - icst].data(), sizeof(T) * cplens[ic]);
+        }
+        int ntg = threading->activate_global();
+#pragma omp parallel for schedule(dynamic) num_threads(ntg)
+        for (size_t ic = icst; ic < iced; ic++) {
+            size_t cklen = min(chunk_size, len - ic * chunk_size);
+            vector<T> ddata(cklen);
+            decode(pdata[ic - icst].data(), cklen, ddata.data());
+            size_t ist = max(start, ic * chunk_size);
+            size_t ied = min(start + n, ic * chunk_size + cklen);
+            memcpy(data + (ist - start), ddata.data() + (ist - ic * chunk_size),
+                   sizeof(T) * (ied - ist));
+        }
+        threading->activate_normal();
+        ifs.seekg(cpoffs[nchunk]);
+        ifs.read((char *)magic.c_str(), 4);
+        assert(magic == "end");
+    }
     /** Read from file stream (but not decompress the data).
      * @param ifs Input stream.
      * @param len The length of the original floating-point array.
@@ -351,13 +587,19 @@ struct FPCodec {
                      size_t &chunk_size) const {
         string magic = "???";
         ifs.read((char *)magic.c_str(), 4);
-        assert(magic == "fpc");
+        assert(magic == "fpc" || magic == "fpi");
         ifs.read((char *)&chunk_size, sizeof(chunk_size));
         size_t nchunk = (size_t)(len / chunk_size + !!(len % chunk_size));
         chunks.resize(nchunk);
+        vector<size_t> cplens;
+        if (magic == "fpi")
+            read_index(ifs, nchunk, cplens);
         for (size_t ic = 0; ic < nchunk; ic++) {
             size_t cplen;
-            ifs.read((char *)&cplen, sizeof(cplen));
+            if (magic == "fpi")
+                cplen = cplens[ic];
+            else
+                ifs.read((char *)&cplen, sizeof(cplen));
             assert(cplen <= chunk_size + 1);
             chunks[ic].resize(cplen);
             ifs.read((char *)chunks[ic].data(), sizeof(T) * cplen);
@@ -524,6 +766,15 @@ template <typename T> struct CompressedVector {
         icache = (icache + 1) % ncache;
         return cache_data[old_icache].second[k];
     }
+    /** Read a range of elements from the array.
+     * @param i Array index of the first element.
+     * @param n Number of elements.
+     * @param data Output array.
+     */
+    virtual void get_range(size_t i, size_t n, T *data) const {
+        for (size_t j = 0; j < n; j++)
+            data[j] = (*this)[i + j];
+    }
     /** Get the size of the array. */
     size_t size() const { return arr_len; }
 };
@@ -537,10 +788,14 @@ template <typename T> struct CompressedVectorMT : CompressedVector<T> {
     using CompressedVector<T>::arr_len;
     using CompressedVector<T>::ncache;
     using CompressedVector<T>::fpc;
-    mutable vector<int> icaches; //!< Index of next available cache (head of the
-                                 //!< circular queue) for each thread.
+    mutable vector<int> icaches; //!< Index of the most recently used cache for
+                                 //!< each thread.
     mutable vector<vector<pair<size_t, vector<T>>>>
         cache_datas; //!< Cached data of decompressed chunks for each thread.
+    mutable vector<vector<size_t>>
+        cache_ticks; //!< Time of last use of each cached chunk for each
+                     //!< thread. The least recently used chunk is replaced.
+    mutable vector<size_t> ticks; //!< Current time for each thread.
     shared_ptr<CompressedVector<T>>
         ref_cv; //!< Pointer to the single-thread compressed array.
     /** Constructor.
@@ -553,7 +808,42 @@ template <typename T> struct CompressedVectorMT : CompressedVector<T> {
                                               ref_cv->ncache) {
         ref_cv->finalize();
         cache_datas.resize(ntg);
+        cache_ticks.resize(ntg);
         icaches.resize(ntg);
+        ticks.resize(ntg);
+    }
+    /** Get one decompressed chunk from the cache of the current thread.
+     * @param ichunk Index of the chunk.
+     * @return Pointer to the decompressed data of the chunk.
+     */
+    const T *get_chunk(size_t ichunk) const {
+        int tid = threading->get_thread_id();
+        int &icache = icaches[tid];
+        vector<pair<size_t, vector<T>>> &cache_data = cache_datas[tid];
+        vector<size_t> &cache_tick = cache_ticks[tid];
+        size_t tick = ++ticks[tid];
+        if (icache < (int)cache_data.size() &&
+            cache_data[icache].first == ichunk) {
+            cache_tick[icache] = tick;
+            return cache_data[icache].second.data();
+        }
+        for (size_t j = 0; j < cache_data.size(); j++)
+            if (cache_data[j].first == ichunk) {
+                icache = (int)j, cache_tick[j] = tick;
+                return cache_data[j].second.data();
+            }
+        if ((int)cache_data.size() < ncache) {
+            icache = (int)cache_data.size();
+            cache_data.push_back(make_pair(0, vector<T>(chunk_size)));
+            cache_tick.push_back(0);
+        } else
+            icache = (int)(min_element(cache_tick.begin(), cache_tick.end()) -
+                           cache_tick.begin());
+        cache_data[icache].first = ichunk, cache_tick[icache] = tick;
+        fpc.decode(ref_cv->cp_data[ichunk].data(),
+                   min(chunk_size, arr_len - ichunk * chunk_size),
+                   cache_data[icache].second.data());
+        return cache_data[icache].second.data();
     }
     /** Write one element into the array (not supported, will cause assertion
      * failure).
@@ -570,22 +860,25 @@ template <typename T> struct CompressedVectorMT : CompressedVector<T> {
      * @return The array elemenet.
      */
     T operator[](size_t i) const {
-        size_t ichunk = i / chunk_size, k = i % chunk_size;
-        int tid = threading->get_thread_id();
-        int &icache = icaches[tid];
-        vector<pair<size_t, vector<T>>> &cache_data = cache_datas[tid];
-        for (size_t j = 0; j < cache_data.size(); j++)
-            if (cache_data[j].first == ichunk)
-                return cache_data[j].second[k];
-        if (icache >= (int)cache_data.size())
-            cache_data.push_back(make_pair(0, vector<T>(chunk_size)));
-        cache_data[icache].first = ichunk;
-        fpc.decode(ref_cv->cp_data[ichunk].data(),
-                   min(chunk_size, arr_len - ichunk * chunk_size),
-                   cache_data[icache].second.data());
-        int old_icache = icache;
-        icache = (icache + 1) % ncache;
-        return cache_data[old_icache].second[k];
+        return get_chunk(i / chunk_size)[i % chunk_size];
+    }
+    /** Read a range of elements from the array. Chunks fully inside the
+     * range are decompressed directly into the output, without the cache.
+     * @param i Array index of the first element.
+     * @param n Number of elements.
+     * @param data Output array.
+     */
+    void get_range(size_t i, size_t n, T *data) const override {
+        for (size_t ic = i / chunk_size; n != 0; ic++) {
+            const size_t ist = ic * chunk_size,
+                         alen = min(chunk_size, arr_len - ist);
+            const size_t k = i - ist, len = min(n, alen - k);
+            if (k == 0 && len == alen)
+                fpc.decode(ref_cv->cp_data[ic].data(), alen, data);
+            else
+                memcpy(data, get_chunk(ic) + k, sizeof(T) * len);
+            i += len, n -= len, data += len;
+        }
     }
     /** Get the size of the array. */
     size_t size() const { return arr_len; }
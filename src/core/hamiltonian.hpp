@@ -78,6 +78,10 @@ template <typename S> struct Hamiltonian {
     // For storing pre-computed CG factors for sparse matrix functions
     shared_ptr<OperatorFunctions<S>> opf = nullptr;
     DelayedOpNames delayed = DelayedOpNames::None;
+    // If not nullptr, materialized delayed site operators are memoized
+    // (shared by all copies of this Hamiltonian)
+    // The cache should be cleared before deallocating this Hamiltonian
+    shared_ptr<DelayedSparseMatrixCache<S>> delayed_cache = nullptr;
     static vector<typename S::pg_t>
     combine_orb_sym(const vector<uint8_t> &orb_sym, const vector<int> &k_sym,
                     int k_mod) {
@@ -231,12 +235,17 @@ struct DelayedSparseMatrix<S, Hamiltonian<S>>
         unordered_map<shared_ptr<OpExpr<S>>, shared_ptr<SparseMatrix<S>>> ops;
         assert(hamil != nullptr);
         assert(hamil->delayed == DelayedOpNames::None);
+        const shared_ptr<DelayedSparseMatrixCache<S>> &cache =
+            hamil->delayed_cache;
+        shared_ptr<SparseMatrix<S>> new_mat =
+            cache == nullptr ? nullptr : cache->find(m, op, this->info);
+        if (new_mat != nullptr)
+            return new_mat;
         ops[op] = nullptr;
         hamil->get_site_ops(m, ops);
         if (this->info->n == ops.at(op)->info->n)
-            return ops.at(op);
+            new_mat = ops.at(op);
         else {
-            shared_ptr<SparseMatrix<S>> new_mat;
             if (ops.at(op)->get_type() == SparseMatrixTypes::Normal)
                 new_mat = make_shared<SparseMatrix<S>>();
             else
@@ -245,8 +254,10 @@ struct DelayedSparseMatrix<S, Hamiltonian<S>>
             new_mat->selective_copy_from(ops.at(op), false);
             new_mat->factor = ops.at(op)->factor;
             ops.at(op)->deallocate();
-            return new_mat;
         }
+        if (cache != nullptr)
+            cache->insert(m, op, new_mat);
+        return new_mat;
     }
     shared_ptr<DelayedSparseMatrix<S>> copy() override {
         return make_shared<DelayedSparseMatrix>(*this);
@@ -74,15 +74,32 @@ struct HubbardFCIDUMP : FCIDUMP {
              uint16_t l) const override {
         return i == j && j == k && k == l ? const_u : 0;
     }
+    // Visit the n on-site elements of each spin block
+    void for_each_v(const function<void(uint8_t, uint8_t, uint16_t, uint16_t,
+                                        uint16_t, uint16_t, double)> &f)
+        const override {
+        const uint16_t n = n_sites();
+        if (const_u == 0.0)
+            return;
+        for (uint8_t sl = 0; sl < 2; sl++)
+            for (uint8_t sr = 0; sr < 2; sr++)
+                for (uint16_t i = 0; i < n; i++)
+                    f(sl, sr, i, i, i, i, const_u);
+    }
     double e() const override { return 0.0; }
     void deallocate() override {}
 };
 
+// Hubbard model in momentum space, with orbital k of momentum 2 pi k / n
+// No integrals are stored: t is diagonal (band energies) and
+// v(i, j, k, l) = U / n if k_i - k_j + k_k - k_l = 0 (mod n), otherwise 0
 struct HubbardKSpaceFCIDUMP : FCIDUMP {
     double const_u, const_t;
     const double _pi = acos(-1);
+    // cos_k[i] = -2 cos(2 pi i / n + pi), band energy is const_t * cos_k[i]
+    vector<double> cos_k;
     HubbardKSpaceFCIDUMP(uint16_t n_sites, double t = 1, double u = 2)
-        : FCIDUMP(), const_u(u), const_t(t) {
+        : FCIDUMP(), const_u(u), const_t(t), cos_k(n_sites) {
         params.clear();
         params["norb"] = Parsing::to_string(n_sites);
         params["nelec"] = Parsing::to_string(n_sites);
@@ -105,24 +122,62 @@ struct HubbardKSpaceFCIDUMP : FCIDUMP {
         params["ksym"] = ss.str();
         params["kmod"] = Parsing::to_string(n_sites);
         params["kisym"] = Parsing::to_string(n_sites / 2);
+        for (uint16_t i = 0; i < n_sites; i++)
+            cos_k[i] = -2 * cos(2 * _pi * i / n_sites + _pi);
+    }
+    // Momentum index l such that k_i - k_j + k_k - k_l = 0 (mod n)
+    uint16_t conserved(uint16_t i, uint16_t j, uint16_t k) const {
+        const int n = (int)cos_k.size();
+        return (uint16_t)((i + n - j + k) % n);
     }
     double t(uint16_t i, uint16_t j) const override {
-        return i == j ? -2 * const_t * cos(2 * _pi * i / n_sites() + _pi) : 0;
+        return i == j ? const_t * cos_k[i] : 0;
     }
     // One-electron integral element (SZ)
     double t(uint8_t s, uint16_t i, uint16_t j) const override {
-        return i == j ? -2 * const_t * cos(2 * _pi * i / n_sites() + _pi) : 0;
+        return i == j ? const_t * cos_k[i] : 0;
     }
     // Two-electron integral element (SU(2))
     double v(uint16_t i, uint16_t j, uint16_t k, uint16_t l) const override {
-        const int n = n_sites();
-        return (i + n - j + k + n - l) % n == 0 ? const_u / n : 0;
+        return conserved(i, j, k) == l ? const_u / cos_k.size() : 0;
     }
     // Two-electron integral element (SZ)
     double v(uint8_t sl, uint8_t sr, uint16_t i, uint16_t j, uint16_t k,
              uint16_t l) const override {
-        const int n = n_sites();
-        return (i + n - j + k + n - l) % n == 0 ? const_u / n : 0;
+        return conserved(i, j, k) == l ? const_u / cos_k.size() : 0;
+    }
+    // Only one nonzero element per row k
+    void v_block(uint16_t i, uint16_t j, double *r) const override {
+        const uint16_t n = (uint16_t)cos_k.size();
+        memset(r, 0, sizeof(double) * n * n);
+        for (uint16_t k = 0; k < n; k++)
+            r[(size_t)k * n + conserved(i, j, k)] = const_u / n;
+    }
+    void v_block(uint8_t sl, uint8_t sr, uint16_t i, uint16_t j,
+                 double *r) const override {
+        v_block(i, j, r);
+    }
+    void for_each_t(const function<void(uint8_t, uint16_t, uint16_t, double)>
+                        &f) const override {
+        for (uint8_t s = 0; s < 2; s++)
+            for (uint16_t i = 0; i < (uint16_t)cos_k.size(); i++)
+                if (const_t * cos_k[i] != 0.0)
+                    f(s, i, i, const_t * cos_k[i]);
+    }
+    // Visit the n^3 momentum-conserving elements of each spin block
+    void for_each_v(const function<void(uint8_t, uint8_t, uint16_t, uint16_t,
+                                        uint16_t, uint16_t, double)> &f)
+        const override {
+        const uint16_t n = (uint16_t)cos_k.size();
+        if (const_u == 0.0)
+            return;
+        for (uint8_t sl = 0; sl < 2; sl++)
+            for (uint8_t sr = 0; sr < 2; sr++)
+                for (uint16_t i = 0; i < n; i++)
+                    for (uint16_t j = 0; j < n; j++)
+                        for (uint16_t k = 0; k < n; k++)
+                            f(sl, sr, i, j, k, conserved(i, j, k),
+                              const_u / n);
     }
     double e() const override { return 0.0; }
     void deallocate() override {}
@@ -20,22 +20,140 @@
 
 #pragma once
 
+#include "compressed_stream.hpp"
+#include "matrix_functions.hpp"
 #include "threading.hpp"
 #include "utils.hpp"
+#include <algorithm>
 #include <array>
 #include <cassert>
 #include <cstdint>
+#include <cstdio>
+#include <cstdlib>
 #include <cstring>
 #include <fstream>
+#include <functional>
 #include <iomanip>
+#include <limits>
 #include <map>
 #include <memory>
+#include <sstream>
 #include <vector>
 
 using namespace std;
 
 namespace block2 {
 
+// Blocked kernels for orbital rotation and reordering of integrals
+struct IntegralTransform {
+    // Edge length of tiles in blocked transpose and permutation copy
+    static const size_t tile = 64;
+    // Two quarter-transformations r[a] = C^T x[a] C (C = rot_mat (old, new))
+    // applied to nb independent n x n blocks, each stored as a full (n * n)
+    // or packed lower triangular (n * (n + 1) / 2) matrix, with strides sx
+    // and sr between blocks. x and r may be the same array
+    static void rotate_blocks(uint32_t n, size_t nb, const double *x,
+                              bool x_packed, size_t sx, double *r,
+                              bool r_packed, size_t sr,
+                              const vector<double> &rot_mat) {
+        assert(rot_mat.size() == (size_t)n * n);
+        assert(nb <= (size_t)numeric_limits<int>::max());
+        if (n == 0 || nb == 0)
+            return;
+        const size_t nn = (size_t)n * n;
+        MatrixRef c((double *)rot_mat.data(), n, n);
+        int ntg = threading->activate_global();
+        vector<double> work((size_t)ntg * 2 * nn);
+#pragma omp parallel num_threads(ntg)
+        {
+            int tid = threading->get_thread_id();
+            double *px = work.data() + (size_t)tid * 2 * nn, *pw = px + nn;
+#pragma omp for schedule(dynamic)
+            for (int a = 0; a < (int)nb; a++) {
+                const double *xa = x + (size_t)a * sx;
+                double *ra = r + (size_t)a * sr;
+                if (x_packed) {
+                    for (uint32_t i = 0, ij = 0; i < n; i++)
+                        for (uint32_t j = 0; j <= i; j++, ij++)
+                            px[(size_t)i * n + j] = px[(size_t)j * n + i] =
+                                xa[ij];
+                } else
+                    memcpy(px, xa, sizeof(double) * nn);
+                MatrixFunctions::multiply(MatrixRef(px, n, n), false, c,
+                                          false, MatrixRef(pw, n, n), 1.0,
+                                          0.0);
+                if (r_packed) {
+                    MatrixFunctions::multiply(c, true, MatrixRef(pw, n, n),
+                                              false, MatrixRef(px, n, n), 1.0,
+                                              0.0);
+                    for (uint32_t i = 0, ij = 0; i < n; i++, ij += i)
+                        memcpy(ra + ij, px + (size_t)i * n,
+                               sizeof(double) * (i + 1));
+                } else
+                    MatrixFunctions::multiply(c, true, MatrixRef(pw, n, n),
+                                              false, MatrixRef(ra, n, n), 1.0,
+                                              0.0);
+            }
+        }
+        threading->activate_normal();
+    }
+    // r[j][i] = x[i][j] for an m x n matrix x
+    static void transpose(size_t m, size_t n, const double *x, double *r) {
+        const size_t mt = (m + tile - 1) / tile, nt = (n + tile - 1) / tile;
+        assert(mt * nt <= (size_t)numeric_limits<int>::max());
+        int ntg = threading->activate_global();
+#pragma omp parallel for schedule(static) num_threads(ntg)
+        for (int it = 0; it < (int)(mt * nt); it++) {
+            const size_t i0 = (it / nt) * tile, j0 = (it % nt) * tile;
+            const size_t i1 = min(i0 + tile, m), j1 = min(j0 + tile, n);
+            for (size_t i = i0; i < i1; i++)
+                for (size_t j = j0; j < j1; j++)
+                    r[j * m + i] = x[i * n + j];
+        }
+        threading->activate_normal();
+    }
+};
+
+// Integral arrays in FCIDUMP text format, one line per nonzero element
+// Each array is split into rows of at most n lines (n_text_rows and
+// write_text_row), which are formatted independently in parallel
+struct IntegralText {
+    // Append one line with value x and one-based indices
+    static void append(string &buf, double x, uint32_t i, uint32_t j,
+                       uint32_t k, uint32_t l) {
+        char line[128];
+        int nc = snprintf(line, sizeof(line), "%20.16f%4u%4u%4u%4u\n", x, i,
+                          j, k, l);
+        buf.append(line, min((size_t)nc, sizeof(line) - 1));
+    }
+    // Write all rows of x in order, in batches of about 64K lines per
+    // thread; the previous batch is written out by the master thread while
+    // the other threads format the current batch
+    template <typename T> static void write(ostream &os, const T &x) {
+        const size_t nr = x.n_text_rows();
+        int ntg = threading->activate_global();
+        const size_t nb = (size_t)ntg * max((size_t)1, ((size_t)1 << 16) /
+                                                           max((size_t)x.n,
+                                                               (size_t)1));
+        assert(nb <= (size_t)numeric_limits<int>::max());
+        vector<string> bufs[2] = {vector<string>(nb), vector<string>(nb)};
+#pragma omp parallel num_threads(ntg)
+        for (size_t ib = 0, ic = 0; ib < nr + nb; ib += nb, ic ^= 1) {
+#pragma omp master
+            if (ib != 0)
+                for (const string &b : bufs[ic ^ 1])
+                    os.write(b.data(), b.size());
+#pragma omp for schedule(dynamic, 16)
+            for (int k = 0; k < (int)nb; k++) {
+                bufs[ic][k].clear();
+                if (ib + k < nr)
+                    x.write_text_row(ib + k, bufs[ic][k]);
+            }
+        }
+        threading->activate_normal();
+    }
+};
+
 // Symmetric/general 2D array for storage of one-electron integrals
 struct TInt {
     // Number of orbitals
@@ -66,50 +184,20 @@ struct TInt {
                 (*this)(i, j) = other(ord[i], ord[j]);
     }
     void rotate(const TInt &other, const vector<double> &rot_mat) {
-        assert(n == other.n);
-        vector<double> tmp((size_t)n * n);
-        int ntg = threading->activate_global();
-#pragma omp parallel num_threads(ntg)
-        {
-#ifdef _MSC_VER
-#pragma omp for schedule(dynamic)
-            for (int ij = 0; ij < n * n; ij++) {
-                int i = ij / n, j = ij % n;
-#else
-#pragma omp for schedule(dynamic) collapse(2)
-            for (int i = 0; i < n; i++)
-                for (int j = 0; j < n; j++) {
-#endif
-                double x = 0;
-                for (int q = 0; q < n; q++)
-                    x += other(i, q) * rot_mat[q * n + j];
-                tmp[(size_t)i * n + j] = x;
-            }
-#ifdef _MSC_VER
-#pragma omp for schedule(dynamic)
-            for (int ij = 0; ij < n * n; ij++) {
-                int i = ij / n, j = ij % n;
-#else
-#pragma omp for schedule(dynamic) collapse(2)
-            for (int i = 0; i < n; i++)
-                for (int j = 0; j < n; j++) {
-#endif
-                if (!general && j > i)
-                    continue;
-                double x = 0;
-                for (int q = 0; q < n; q++)
-                    x += tmp[(size_t)q * n + j] * rot_mat[q * n + i];
-                (*this)(i, j) = x;
-            }
-        }
+        assert(n == other.n && general == other.general);
+        IntegralTransform::rotate_blocks(n, 1, other.data, !general, 0, data,
+                                         !general, 0, rot_mat);
+    }
+    // row i: elements (i, j) with j <= i (or all j if general)
+    size_t n_text_rows() const { return n; }
+    void write_text_row(size_t ir, string &buf) const {
+        const uint16_t i = (uint16_t)ir;
+        for (uint16_t j = 0; j < (general ? n : i + 1); j++)
+            if ((*this)(i, j) != 0.0)
+                IntegralText::append(buf, (*this)(i, j), i + 1, j + 1, 0, 0);
     }
     friend ostream &operator<<(ostream &os, TInt x) {
-        os << fixed << setprecision(16);
-        for (uint16_t i = 0; i < x.n; i++)
-            for (uint16_t j = 0; j < (x.general ? x.n : i + 1); j++)
-                if (x(i, j) != 0.0)
-                    os << setw(20) << x(i, j) << setw(4) << i + 1 << setw(4)
-                       << j + 1 << setw(4) << 0 << setw(4) << 0 << endl;
+        IntegralText::write(os, x);
         return os;
     }
 };
@@ -131,104 +219,47 @@ struct V1Int {
     }
     void reorder(const V1Int &other, const vector<uint16_t> &ord) {
         assert(n == other.n);
-        for (uint32_t i = 0; i < n; i++)
-            for (uint32_t j = 0; j < n; j++)
-                for (uint32_t k = 0; k < n; k++)
-                    for (uint32_t l = 0; l < n; l++)
-                        (*this)(i, j, k, l) =
-                            other(ord[i], ord[j], ord[k], ord[l]);
+        const size_t nn = (size_t)n * n;
+        assert(nn <= (size_t)numeric_limits<int>::max());
+        int ntg = threading->activate_global();
+#pragma omp parallel for schedule(dynamic) num_threads(ntg)
+        for (int ij = 0; ij < (int)nn; ij++) {
+            const double *po = other.data +
+                               ((size_t)ord[ij / n] * n + ord[ij % n]) * nn;
+            double *pr = data + (size_t)ij * nn;
+            for (uint32_t k = 0; k < n; k++, pr += n) {
+                const double *pok = po + (size_t)ord[k] * n;
+                for (uint32_t l = 0; l < n; l++)
+                    pr[l] = pok[ord[l]];
+            }
+        }
+        threading->activate_normal();
     }
+    // Quarter-transformations of k and l for all ij,
+    // then of i and j for all kl after a transpose
     void rotate(const V1Int &other, const vector<double> &rot_mat) {
         assert(n == other.n);
+        const size_t nn = (size_t)n * n;
         vector<double> tmp(size());
-#ifdef _MSC_VER
-        assert((size_t)n * n * n * n <= (size_t)numeric_limits<int>::max());
-#endif
-        int ntg = threading->activate_global();
-#pragma omp parallel num_threads(ntg)
-        {
-#ifdef _MSC_VER
-#pragma omp for schedule(dynamic)
-            for (int ijkl = 0; ijkl < n * n * n * n; ijkl++) {
-                int i = ijkl / (n * n * n), j = (ijkl / (n * n)) % n,
-                    k = (ijkl / n) % n, l = ijkl % n;
-#else
-#pragma omp for schedule(dynamic) collapse(4)
-            for (int i = 0; i < n; i++)
-                for (int j = 0; j < n; j++)
-                    for (int k = 0; k < n; k++)
-                        for (int l = 0; l < n; l++) {
-#endif
-                double x = 0;
-                for (int q = 0; q < n; q++)
-                    x += other(i, j, k, q) * rot_mat[q * n + l];
-                tmp[(((size_t)i * n + j) * n + k) * n + l] = x;
-            }
-#ifdef _MSC_VER
-#pragma omp for schedule(dynamic)
-            for (int ijkl = 0; ijkl < n * n * n * n; ijkl++) {
-                int i = ijkl / (n * n * n), j = (ijkl / (n * n)) % n,
-                    k = (ijkl / n) % n, l = ijkl % n;
-#else
-#pragma omp for schedule(dynamic) collapse(4)
-            for (int i = 0; i < n; i++)
-                for (int j = 0; j < n; j++)
-                    for (int k = 0; k < n; k++)
-                        for (int l = 0; l < n; l++) {
-#endif
-                double x = 0;
-                for (int q = 0; q < n; q++)
-                    x += tmp[(((size_t)i * n + j) * n + q) * n + l] *
-                         rot_mat[q * n + k];
-                (*this)(i, j, k, l) = x;
-            }
-#ifdef _MSC_VER
-#pragma omp for schedule(dynamic)
-            for (int ijkl = 0; ijkl < n * n * n * n; ijkl++) {
-                int i = ijkl / (n * n * n), j = (ijkl / (n * n)) % n,
-                    k = (ijkl / n) % n, l = ijkl % n;
-#else
-#pragma omp for schedule(dynamic) collapse(4)
-            for (int i = 0; i < n; i++)
-                for (int j = 0; j < n; j++)
-                    for (int k = 0; k < n; k++)
-                        for (int l = 0; l < n; l++) {
-#endif
-                double x = 0;
-                for (int q = 0; q < n; q++)
-                    x += (*this)(i, q, k, l) * rot_mat[q * n + j];
-                tmp[(((size_t)i * n + j) * n + k) * n + l] = x;
-            }
-#ifdef _MSC_VER
-#pragma omp for schedule(dynamic)
-            for (int ijkl = 0; ijkl < n * n * n * n; ijkl++) {
-                int i = ijkl / (n * n * n), j = (ijkl / (n * n)) % n,
-                    k = (ijkl / n) % n, l = ijkl % n;
-#else
-#pragma omp for schedule(dynamic) collapse(4)
-            for (int i = 0; i < n; i++)
-                for (int j = 0; j < n; j++)
-                    for (int k = 0; k < n; k++)
-                        for (int l = 0; l < n; l++) {
-#endif
-                double x = 0;
-                for (int q = 0; q < n; q++)
-                    x += tmp[(((size_t)q * n + j) * n + k) * n + l] *
-                         rot_mat[q * n + i];
-                (*this)(i, j, k, l) = x;
-            }
-        }
+        IntegralTransform::rotate_blocks(n, nn, other.data, false, nn,
+                                         tmp.data(), false, nn, rot_mat);
+        IntegralTransform::transpose(nn, nn, tmp.data(), data);
+        IntegralTransform::rotate_blocks(n, nn, data, false, nn, tmp.data(),
+                                         false, nn, rot_mat);
+        IntegralTransform::transpose(nn, nn, tmp.data(), data);
+    }
+    // row (i * n + j) * n + k: elements (i, j, k, l) for all l
+    size_t n_text_rows() const { return (size_t)n * n * n; }
+    void write_text_row(size_t ir, string &buf) const {
+        const uint16_t i = (uint16_t)(ir / n / n), j = (uint16_t)(ir / n % n);
+        const uint16_t k = (uint16_t)(ir % n);
+        for (uint16_t l = 0; l < n; l++)
+            if ((*this)(i, j, k, l) != 0.0)
+                IntegralText::append(buf, (*this)(i, j, k, l), i + 1, j + 1,
+                                     k + 1, l + 1);
     }
     friend ostream &operator<<(ostream &os, V1Int x) {
-        os << fixed << setprecision(16);
-        for (uint32_t i = 0; i < x.n; i++)
-            for (uint32_t j = 0; j < x.n; j++)
-                for (uint32_t k = 0; k < x.n; k++)
-                    for (uint32_t l = 0; l < x.n; l++)
-                        if (x(i, j, k, l) != 0.0)
-                            os << setw(20) << x(i, j, k, l) << setw(4) << i + 1
-                               << setw(4) << j + 1 << setw(4) << k + 1
-                               << setw(4) << l + 1 << endl;
+        IntegralText::write(os, x);
         return os;
     }
 };
@@ -256,109 +287,54 @@ struct V4Int {
     double operator()(uint16_t i, uint16_t j, uint16_t k, uint16_t l) const {
         return *(data + find_index(i, j, k, l));
     }
+    // Permuted pair indices
+    // pord[find_index(i, j)] = find_index(ord[i], ord[j])
+    vector<size_t> reorder_pairs(const vector<uint16_t> &ord) const {
+        vector<size_t> pord(m);
+        for (uint32_t i = 0, ij = 0; i < n; i++)
+            for (uint32_t j = 0; j <= i; j++, ij++)
+                pord[ij] = find_index((uint32_t)ord[i], (uint32_t)ord[j]);
+        return pord;
+    }
     void reorder(const V4Int &other, const vector<uint16_t> &ord) {
         assert(n == other.n);
-        for (uint32_t i = 0; i < n; i++)
-            for (uint32_t j = 0; j <= i; j++)
-                for (uint32_t k = 0; k < n; k++)
-                    for (uint32_t l = 0; l <= k; l++)
-                        (*this)(i, j, k, l) =
-                            other(ord[i], ord[j], ord[k], ord[l]);
+        const vector<size_t> pord = reorder_pairs(ord);
+        int ntg = threading->activate_global();
+#pragma omp parallel for schedule(dynamic) num_threads(ntg)
+        for (int ij = 0; ij < (int)m; ij++) {
+            const double *po = other.data + pord[ij] * m;
+            double *pr = data + (size_t)ij * m;
+            for (uint32_t kl = 0; kl < m; kl++)
+                pr[kl] = po[pord[kl]];
+        }
+        threading->activate_normal();
     }
+    // Quarter-transformations of k and l for all ij,
+    // then of i and j for all kl after a transpose
     void rotate(const V4Int &other, const vector<double> &rot_mat) {
         assert(n == other.n);
-        vector<double> tmp((size_t)n * n * n * n), tmp2((size_t)n * n * n * n);
-#ifdef _MSC_VER
-        assert((size_t)n * n * n * n <= (size_t)numeric_limits<int>::max());
-#endif
-        int ntg = threading->activate_global();
-#pragma omp parallel num_threads(ntg)
-        {
-#ifdef _MSC_VER
-#pragma omp for schedule(dynamic)
-            for (int ijkl = 0; ijkl < n * n * n * n; ijkl++) {
-                int i = ijkl / (n * n * n), j = (ijkl / (n * n)) % n,
-                    k = (ijkl / n) % n, l = ijkl % n;
-#else
-#pragma omp for schedule(dynamic) collapse(4)
-            for (int i = 0; i < n; i++)
-                for (int j = 0; j < n; j++)
-                    for (int k = 0; k < n; k++)
-                        for (int l = 0; l < n; l++) {
-#endif
-                double x = 0;
-                for (int q = 0; q < n; q++)
-                    x += other(i, j, k, q) * rot_mat[q * n + l];
-                tmp[(((size_t)i * n + j) * n + k) * n + l] = x;
-            }
-#ifdef _MSC_VER
-#pragma omp for schedule(dynamic)
-            for (int ijkl = 0; ijkl < n * n * n * n; ijkl++) {
-                int i = ijkl / (n * n * n), j = (ijkl / (n * n)) % n,
-                    k = (ijkl / n) % n, l = ijkl % n;
-#else
-#pragma omp for schedule(dynamic) collapse(4)
-            for (int i = 0; i < n; i++)
-                for (int j = 0; j < n; j++)
-                    for (int k = 0; k < n; k++)
-                        for (int l = 0; l < n; l++) {
-#endif
-                double x = 0;
-                for (int q = 0; q < n; q++)
-                    x += tmp[(((size_t)i * n + j) * n + q) * n + l] *
-                         rot_mat[q * n + k];
-                tmp2[(((size_t)i * n + j) * n + k) * n + l] = x;
-            }
-#ifdef _MSC_VER
-#pragma omp for schedule(dynamic)
-            for (int ijkl = 0; ijkl < n * n * n * n; ijkl++) {
-                int i = ijkl / (n * n * n), j = (ijkl / (n * n)) % n,
-                    k = (ijkl / n) % n, l = ijkl % n;
-#else
-#pragma omp for schedule(dynamic) collapse(4)
-            for (int i = 0; i < n; i++)
-                for (int j = 0; j < n; j++)
-                    for (int k = 0; k < n; k++)
-                        for (int l = 0; l < n; l++) {
-#endif
-                double x = 0;
-                for (int q = 0; q < n; q++)
-                    x += tmp2[(((size_t)i * n + q) * n + k) * n + l] *
-                         rot_mat[q * n + j];
-                tmp[(((size_t)i * n + j) * n + k) * n + l] = x;
-            }
-#ifdef _MSC_VER
-#pragma omp for schedule(dynamic)
-            for (int ijkl = 0; ijkl < n * n * n * n; ijkl++) {
-                int i = ijkl / (n * n * n), j = (ijkl / (n * n)) % n,
-                    k = (ijkl / n) % n, l = ijkl % n;
-#else
-#pragma omp for schedule(dynamic) collapse(4)
-            for (int i = 0; i < n; i++)
-                for (int j = 0; j < n; j++)
-                    for (int k = 0; k < n; k++)
-                        for (int l = 0; l < n; l++) {
-                            if (j > i || l > k)
-                                continue;
-#endif
-                double x = 0;
-                for (int q = 0; q < n; q++)
-                    x += tmp[(((size_t)q * n + j) * n + k) * n + l] *
-                         rot_mat[q * n + i];
-                (*this)(i, j, k, l) = x;
-            }
-        }
+        vector<double> tmp(size());
+        IntegralTransform::rotate_blocks(n, m, other.data, true, m, data, true,
+                                         m, rot_mat);
+        IntegralTransform::transpose(m, m, data, tmp.data());
+        IntegralTransform::rotate_blocks(n, m, tmp.data(), true, m, tmp.data(),
+                                         true, m, rot_mat);
+        IntegralTransform::transpose(m, m, tmp.data(), data);
+    }
+    // row (i * n + j) * n + k: elements (i, j, k, l) with j <= i, l <= k
+    size_t n_text_rows() const { return (size_t)n * n * n; }
+    void write_text_row(size_t ir, string &buf) const {
+        const uint16_t i = (uint16_t)(ir / n / n), j = (uint16_t)(ir / n % n);
+        const uint16_t k = (uint16_t)(ir % n);
+        if (j > i)
+            return;
+        for (uint16_t l = 0; l <= k; l++)
+            if ((*this)(i, j, k, l) != 0.0)
+                IntegralText::append(buf, (*this)(i, j, k, l), i + 1, j + 1,
+                                     k + 1, l + 1);
     }
     friend ostream &operator<<(ostream &os, V4Int x) {
-        os << fixed << setprecision(16);
-        for (uint32_t i = 0; i < x.n; i++)
-            for (uint32_t j = 0; j <= i; j++)
-                for (uint32_t k = 0; k < x.n; k++)
-                    for (uint32_t l = 0; l <= k; l++)
-                        if (x(i, j, k, l) != 0.0)
-                            os << setw(20) << x(i, j, k, l) << setw(4) << i + 1
-                               << setw(4) << j + 1 << setw(4) << k + 1
-                               << setw(4) << l + 1 << endl;
+        IntegralText::write(os, x);
         return os;
     }
 };
@@ -386,118 +362,137 @@ struct V8Int {
     double operator()(uint16_t i, uint16_t j, uint16_t k, uint16_t l) const {
         return *(data + find_index(i, j, k, l));
     }
-    void reorder(const V8Int &other, const vector<uint16_t> &ord) {
-        assert(n == other.n);
+    vector<size_t> reorder_pairs(const vector<uint16_t> &ord) const {
+        vector<size_t> pord(m);
         for (uint32_t i = 0, ij = 0; i < n; i++)
             for (uint32_t j = 0; j <= i; j++, ij++)
-                for (uint32_t k = 0, kl = 0; k <= i; k++)
-                    for (uint32_t l = 0; l <= k; l++, kl++)
-                        if (ij >= kl)
-                            (*this)(i, j, k, l) =
-                                other(ord[i], ord[j], ord[k], ord[l]);
+                pord[ij] = find_index((uint32_t)ord[i], (uint32_t)ord[j]);
+        return pord;
     }
-    void rotate(const V8Int &other, const vector<double> &rot_mat) {
+    // Permutation copy in tiles of (ij, kl), so that the source elements
+    // of one tile are confined to a few rows and columns
+    void reorder(const V8Int &other, const vector<uint16_t> &ord) {
         assert(n == other.n);
-        vector<double> tmp((size_t)n * n * n * n), tmp2((size_t)n * n * n * n);
-#ifdef _MSC_VER
-        assert((size_t)n * n * n * n <= (size_t)numeric_limits<int>::max());
-#endif
+        const vector<size_t> pord = reorder_pairs(ord);
+        const size_t tile = IntegralTransform::tile;
+        const size_t mt = (m + tile - 1) / tile;
+        assert(mt * (mt + 1) / 2 <= (size_t)numeric_limits<int>::max());
         int ntg = threading->activate_global();
-#pragma omp parallel num_threads(ntg)
-        {
-#ifdef _MSC_VER
-#pragma omp for schedule(dynamic)
-            for (int ijkl = 0; ijkl < n * n * n * n; ijkl++) {
-                int i = ijkl / (n * n * n), j = (ijkl / (n * n)) % n,
-                    k = (ijkl / n) % n, l = ijkl % n;
-#else
-#pragma omp for schedule(dynamic) collapse(4)
-            for (int i = 0; i < n; i++)
-                for (int j = 0; j < n; j++)
-                    for (int k = 0; k < n; k++)
-                        for (int l = 0; l < n; l++) {
-#endif
-                double x = 0;
-                for (int q = 0; q < n; q++)
-                    x += other(i, j, k, q) * rot_mat[q * n + l];
-                tmp[(((size_t)i * n + j) * n + k) * n + l] = x;
-            }
-#ifdef _MSC_VER
-#pragma omp for schedule(dynamic)
-            for (int ijkl = 0; ijkl < n * n * n * n; ijkl++) {
-                int i = ijkl / (n * n * n), j = (ijkl / (n * n)) % n,
-                    k = (ijkl / n) % n, l = ijkl % n;
-#else
-#pragma omp for schedule(dynamic) collapse(4)
-            for (int i = 0; i < n; i++)
-                for (int j = 0; j < n; j++)
-                    for (int k = 0; k < n; k++)
-                        for (int l = 0; l < n; l++) {
-#endif
-                double x = 0;
-                for (int q = 0; q < n; q++)
-                    x += tmp[(((size_t)i * n + j) * n + q) * n + l] *
-                         rot_mat[q * n + k];
-                tmp2[(((size_t)i * n + j) * n + k) * n + l] = x;
-            }
-#ifdef _MSC_VER
-#pragma omp for schedule(dynamic)
-            for (int ijkl = 0; ijkl < n * n * n * n; ijkl++) {
-                int i = ijkl / (n * n * n), j = (ijkl / (n * n)) % n,
-                    k = (ijkl / n) % n, l = ijkl % n;
-#else
-#pragma omp for schedule(dynamic) collapse(4)
-            for (int i = 0; i < n; i++)
-                for (int j = 0; j < n; j++)
-                    for (int k = 0; k < n; k++)
-                        for (int l = 0; l < n; l++) {
-#endif
-                double x = 0;
-                for (int q = 0; q < n; q++)
-                    x += tmp2[(((size_t)i * n + q) * n + k) * n + l] *
-                         rot_mat[q * n + j];
-                tmp[(((size_t)i * n + j) * n + k) * n + l] = x;
-            }
-#ifdef _MSC_VER
-#pragma omp for schedule(dynamic)
-            for (int ijkl = 0; ijkl < n * n * n * n; ijkl++) {
-                int i = ijkl / (n * n * n), j = (ijkl / (n * n)) % n,
-                    k = (ijkl / n) % n, l = ijkl % n;
-#else
-#pragma omp for schedule(dynamic) collapse(4)
-            for (int i = 0; i < n; i++)
-                for (int j = 0; j < n; j++)
-                    for (int k = 0; k < n; k++)
-                        for (int l = 0; l < n; l++) {
-                            if (j > i || l > k ||
-                                (k * (k + 1) >> 1) + l > (i * (i + 1) >> 1) + j)
-                                continue;
-#endif
-                double x = 0;
-                for (int q = 0; q < n; q++)
-                    x += tmp[(((size_t)q * n + j) * n + k) * n + l] *
-                         rot_mat[q * n + i];
-                (*this)(i, j, k, l) = x;
+#pragma omp parallel for schedule(dynamic) num_threads(ntg)
+        for (int it = 0; it < (int)(mt * (mt + 1) / 2); it++) {
+            size_t ib = 0;
+            while ((ib + 1) * (ib + 2) / 2 <= (size_t)it)
+                ib++;
+            const size_t jb = it - ib * (ib + 1) / 2;
+            const size_t i0 = ib * tile, i1 = min(i0 + tile, (size_t)m);
+            const size_t j0 = jb * tile;
+            for (size_t ij = i0; ij < i1; ij++) {
+                double *pr = data + find_index((uint32_t)ij, 0);
+                const size_t j1 = min(j0 + tile, ij + 1);
+                for (size_t kl = j0; kl < j1; kl++)
+                    pr[kl] = other.data[find_index((uint32_t)pord[ij],
+                                                   (uint32_t)pord[kl])];
             }
         }
+        threading->activate_normal();
+    }
+    // Quarter-transformations of k and l for all ij in the unpacked
+    // [ij][kl] matrix, then of i and j for all kl after a transpose
+    void rotate(const V8Int &other, const vector<double> &rot_mat) {
+        assert(n == other.n);
+        vector<double> tmp((size_t)m * m), tmp2((size_t)m * m);
+        int ntg = threading->activate_global();
+#pragma omp parallel for schedule(dynamic) num_threads(ntg)
+        for (int ij = 0; ij < (int)m; ij++)
+            memcpy(tmp2.data() + (size_t)ij * m,
+                   other.data + find_index((uint32_t)ij, 0),
+                   sizeof(double) * (ij + 1));
+        // tmp2 holds the lower triangle, fill the upper triangle of tmp
+        IntegralTransform::transpose(m, m, tmp2.data(), tmp.data());
+        ntg = threading->activate_global();
+#pragma omp parallel for schedule(dynamic) num_threads(ntg)
+        for (int ij = 0; ij < (int)m; ij++)
+            memcpy(tmp.data() + (size_t)ij * m, tmp2.data() + (size_t)ij * m,
+                   sizeof(double) * (ij + 1));
+        threading->activate_normal();
+        IntegralTransform::rotate_blocks(n, m, tmp.data(), true, m, tmp.data(),
+                                         true, m, rot_mat);
+        IntegralTransform::transpose(m, m, tmp.data(), tmp2.data());
+        IntegralTransform::rotate_blocks(n, m, tmp2.data(), true, m,
+                                         tmp2.data(), true, m, rot_mat);
+        ntg = threading->activate_global();
+#pragma omp parallel for schedule(dynamic) num_threads(ntg)
+        for (int ij = 0; ij < (int)m; ij++)
+            memcpy(data + find_index((uint32_t)ij, 0),
+                   tmp2.data() + (size_t)ij * m, sizeof(double) * (ij + 1));
+        threading->activate_normal();
+    }
+    // row (i * n + j) * n + k: elements (i, j, k, l) with j <= i, k <= i,
+    // l <= k and (k, l) <= (i, j)
+    size_t n_text_rows() const { return (size_t)n * n * n; }
+    void write_text_row(size_t ir, string &buf) const {
+        const uint16_t i = (uint16_t)(ir / n / n), j = (uint16_t)(ir / n % n);
+        const uint16_t k = (uint16_t)(ir % n);
+        if (j > i || k > i)
+            return;
+        const size_t ij = find_index((uint32_t)i, (uint32_t)j);
+        const size_t kl0 = find_index((uint32_t)k, 0u);
+        for (uint16_t l = 0; l <= k && kl0 + l <= ij; l++)
+            if ((*this)(i, j, k, l) != 0.0)
+                IntegralText::append(buf, (*this)(i, j, k, l), i + 1, j + 1,
+                                     k + 1, l + 1);
     }
     friend ostream &operator<<(ostream &os, V8Int x) {
-        os << fixed << setprecision(16);
-        for (uint32_t i = 0, ij = 0; i < x.n; i++)
-            for (uint32_t j = 0; j <= i; j++, ij++)
-                for (uint32_t k = 0, kl = 0; k <= i; k++)
-                    for (uint32_t l = 0; l <= k; l++, kl++)
-                        if (ij >= kl && x(i, j, k, l) != 0.0)
-                            os << setw(20) << x(i, j, k, l) << setw(4) << i + 1
-                               << setw(4) << j + 1 << setw(4) << k + 1
-                               << setw(4) << l + 1 << endl;
+        IntegralText::write(os, x);
         return os;
     }
 };
 
+// Expanded view of two-electron integrals, with each spin block stored as a
+// dense [npair][npair] matrix and pair indices precomputed for all (i, j),
+// so that elements are found without index canonicalization
+// For 8-fold and 4-fold integrals npair = n(n+1)/2, otherwise npair = n^2
+struct VExpandedInt {
+    uint16_t n;
+    uint32_t m;
+    // pidx[i * n + j]: pair index of (i, j)
+    vector<uint32_t> pidx;
+    shared_ptr<vector<double>> vdata;
+    // offset and (ij, kl) strides of spin block sl * 2 + sr
+    // (for sl = 1, sr = 0 the (0, 1) block is used with swapped strides)
+    array<size_t, 4> offsets, sij, skl;
+    VExpandedInt(uint16_t n, bool general)
+        : n(n), m(general ? (uint32_t)n * n : (uint32_t)n * (n + 1) / 2),
+          pidx((size_t)n * n) {
+        for (uint32_t i = 0; i < n; i++)
+            for (uint32_t j = 0; j < n; j++)
+                pidx[i * n + j] =
+                    general ? i * n + j
+                            : (i < j ? j * (j + 1) / 2 + i : i * (i + 1) / 2 + j);
+    }
+    double operator()(uint8_t sl, uint8_t sr, uint16_t i, uint16_t j,
+                      uint16_t k, uint16_t l) const {
+        const int b = (sl << 1) | sr;
+        return (*vdata)[offsets[b] + pidx[(size_t)i * n + j] * sij[b] +
+                        pidx[(size_t)k * n + l] * skl[b]];
+    }
+    double operator()(uint16_t i, uint16_t j, uint16_t k, uint16_t l) const {
+        return (*vdata)[(size_t)pidx[(size_t)i * n + j] * m +
+                        pidx[(size_t)k * n + l]];
+    }
+    // Contiguous row of spin block (0, 0) (SU(2)) for pair (i, j),
+    // indexed by pidx[k * n + l]
+    const double *row(uint16_t i, uint16_t j) const {
+        return vdata->data() + (size_t)pidx[(size_t)i * n + j] * m;
+    }
+    size_t size() const { return vdata == nullptr ? 0 : vdata->size(); }
+};
+
 // One- and two-electron integrals
 struct FCIDUMP {
     shared_ptr<vector<double>> vdata;
+    // node-local shared storage of data, used instead of vdata
+    shared_ptr<double> shared_data;
     map<string, string> params;
     vector<TInt> ts;
     vector<V8Int> vs;
@@ -507,6 +502,9 @@ struct FCIDUMP {
     double *data;
     size_t total_memory;
     bool uhf, general;
+    // Optional expanded two-electron integrals (see expand_integrals)
+    // Reset when the integrals are changed by methods of this class
+    shared_ptr<VExpandedInt> vexp;
     FCIDUMP() : const_e(0.0), uhf(false), total_memory(0), vdata(nullptr) {}
     // Initialize integrals: U(1) case
     // Two-electron integrals can be three general rank-4 arrays
@@ -522,6 +520,7 @@ struct FCIDUMP {
         vs.clear();
         vabs.clear();
         vgs.clear();
+        vexp = nullptr;
         this->const_e = e;
         params["norb"] = Parsing::to_string(n_sites);
         params["nelec"] = Parsing::to_string(n_elec);
@@ -588,6 +587,7 @@ struct FCIDUMP {
         vs.clear();
         vabs.clear();
         vgs.clear();
+        vexp = nullptr;
         this->const_e = e;
         params["norb"] = Parsing::to_string(n_sites);
         params["nelec"] = Parsing::to_string(n_elec);
@@ -631,6 +631,7 @@ struct FCIDUMP {
         vs.clear();
         vabs.clear();
         vgs.clear();
+        vexp = nullptr;
         this->const_e = e;
         params["norb"] = Parsing::to_string(n_sites);
         params["nelec"] = Parsing::to_string(n_elec);
@@ -652,11 +653,27 @@ struct FCIDUMP {
         memcpy(ts[0].data, t, sizeof(double) * lt);
         uhf = false;
     }
-    // Writing FCIDUMP file to disk
-    virtual void write(const string &filename) const {
-        ofstream ofs(filename.c_str());
+    // Writing FCIDUMP file to disk, in text format, or in binary format
+    // (same as save_data) if binary is true
+    // The file is compressed with gzip or zstd if filename ends with ".gz"
+    // or ".zst" (compress_level < 0 for the library default)
+    virtual void write(const string &filename, bool binary = false,
+                       int compress_level = -1) const {
+        CompressedFileBuffer fb(filename, compress_level,
+                                threading->n_threads_global);
+        ostream ofs(&fb);
+        if (binary)
+            save_data(ofs);
+        else
+            write_text(ofs);
+        ofs.flush();
         if (!ofs.good())
             throw runtime_error("FCIDUMP::write on '" + filename + "' failed.");
+        fb.close();
+    }
+    // Writing FCIDUMP in text format
+    // Integral lines are formatted in parallel and streamed to ofs
+    virtual void write_text(ostream &ofs) const {
         ofs << " &FCI NORB=" << setw(4) << (int)n_sites()
             << ",NELEC=" << setw(4) << (int)n_elec() << ",MS2=" << setw(4)
             << (int)twos() << "," << endl;
@@ -674,10 +691,10 @@ struct FCIDUMP {
         if (ts[0].general)
             ofs << "  ITGENERAL=1," << endl;
         ofs << " &END" << endl;
-        auto write_const = [](ofstream &os, double x) {
-            os << fixed << setprecision(16);
-            os << setw(20) << x << setw(4) << 0 << setw(4) << 0 << setw(4) << 0
-               << setw(4) << 0 << endl;
+        auto write_const = [](ostream &os, double x) {
+            string buf;
+            IntegralText::append(buf, x, 0, 0, 0, 0);
+            os << buf;
         };
         if (!uhf) {
             if (general)
@@ -699,28 +716,116 @@ struct FCIDUMP {
                 ofs << ts[i], write_const(ofs, 0.0);
             write_const(ofs, this->const_e);
         }
-        if (!ofs.good())
-            throw runtime_error("FCIDUMP::write on '" + filename + "' failed.");
-        ofs.close();
     }
-    // Parsing a FCIDUMP file
-    virtual void read(const string &filename) {
+    // Parsing a FCIDUMP file on the first proc of each node, with the
+    // integrals stored once per node in memory shared by all procs on it
+    // All procs in pcomm must call this, and later deallocate, together;
+    // the shared integrals must not be changed
+    template <typename PComm>
+    void read_node_shared(const string &filename, const PComm &pcomm) {
+        const bool is_node_root = pcomm->get_node_rank() == 0;
+        if (is_node_root || pcomm->rank == pcomm->root)
+            read(filename);
+        // header: n, uhf, general, tgeneral, total_memory, nts, nvs, nvabs,
+        // nvgs, offsets of the arrays in data, params (as chars)
+        vector<long long int> hdr(9, 0);
+        if (pcomm->rank == pcomm->root) {
+            hdr[0] = n_sites(), hdr[1] = uhf, hdr[2] = general;
+            hdr[3] = ts[0].general, hdr[4] = (long long int)total_memory;
+            hdr[5] = ts.size(), hdr[6] = vs.size(), hdr[7] = vabs.size();
+            hdr[8] = vgs.size();
+            for (auto &x : ts)
+                hdr.push_back(x.data - data);
+            for (auto &x : vs)
+                hdr.push_back(x.data - data);
+            for (auto &x : vabs)
+                hdr.push_back(x.data - data);
+            for (auto &x : vgs)
+                hdr.push_back(x.data - data);
+            for (auto &p : params) {
+                hdr.insert(hdr.end(), p.first.begin(), p.first.end());
+                hdr.push_back(0);
+                hdr.insert(hdr.end(), p.second.begin(), p.second.end());
+                hdr.push_back(0);
+            }
+        }
+        long long int nhdr = (long long int)hdr.size();
+        pcomm->broadcast(&nhdr, 1, pcomm->root);
+        hdr.resize(nhdr);
+        pcomm->broadcast(hdr.data(), hdr.size(), pcomm->root);
+        pcomm->broadcast(&const_e, 1, pcomm->root);
+        uint16_t n = (uint16_t)hdr[0];
+        uhf = hdr[1], general = hdr[2], total_memory = (size_t)hdr[4];
+        shared_data = pcomm->allocate_node_shared(total_memory);
+        if (is_node_root)
+            memcpy(shared_data.get(), data, sizeof(double) * total_memory);
+        vdata = nullptr;
+        data = shared_data.get();
+        ts = vector<TInt>(hdr[5], TInt(n, hdr[3]));
+        vs = vector<V8Int>(hdr[6], V8Int(n));
+        vabs = vector<V4Int>(hdr[7], V4Int(n));
+        vgs = vector<V1Int>(hdr[8], V1Int(n));
+        size_t ih = 9;
+        for (auto &x : ts)
+            x.data = data + hdr[ih++];
+        for (auto &x : vs)
+            x.data = data + hdr[ih++];
+        for (auto &x : vabs)
+            x.data = data + hdr[ih++];
+        for (auto &x : vgs)
+            x.data = data + hdr[ih++];
         params.clear();
-        ts.clear();
-        vs.clear();
-        vabs.clear();
-        const_e = 0.0;
-        ifstream ifs(filename.c_str());
+        while (ih < hdr.size()) {
+            string kv[2];
+            for (int k = 0; k < 2; ih++)
+                if (hdr[ih] == 0)
+                    k++;
+                else
+                    kv[k].push_back((char)hdr[ih]);
+            params[kv[0]] = kv[1];
+        }
+        // integrals are only used after the copy on the node is completed
+        pcomm->barrier();
+    }
+    // Tag at the beginning of a FCIDUMP file in binary format
+    static string binary_tag() { return "B2FCIDMP"; }
+    // Whether the file is a FCIDUMP in binary format (written by save_data)
+    static bool is_binary(const string &filename) {
+        ifstream ifs(filename.c_str(), ios::binary);
         if (!ifs.good())
-            throw runtime_error("FCIDUMP::read on '" + filename + "' failed.");
-        vector<string> lines = Parsing::readlines(&ifs);
-        if (ifs.bad())
-            throw runtime_error("FCIDUMP::read on '" + filename + "' failed.");
-        ifs.close();
+            return false;
+        string tag(binary_tag().size(), '\0');
+        ifs.read(&tag[0], tag.size());
+        return ifs.gcount() == (streamsize)tag.size() && tag == binary_tag();
+    }
+    // Parsing a FCIDUMP file in text format (optionally compressed with gzip
+    // or zstd) into parameters and integral entries
+    static void read_text(const string &filename, map<string, string> &params,
+                          vector<array<uint16_t, 4>> &int_idx,
+                          vector<double> &int_val) {
+        parse_text(CompressedFile::read(filename), filename, params, int_idx,
+                   int_val);
+    }
+    // Parsing the content buf of a FCIDUMP file in text format into
+    // parameters and integral entries (value and 1-based indices, in the
+    // order of the file)
+    // The integral lines are parsed in parallel, with each thread working on
+    // a byte range of the file starting at a line boundary
+    static void parse_text(const string &buf, const string &filename,
+                           map<string, string> &params,
+                           vector<array<uint16_t, 4>> &int_idx,
+                           vector<double> &int_val) {
         vector<string> pars;
         size_t il = 0;
-        for (; il < lines.size(); il++) {
-            string l(Parsing::lower(lines[il]));
+        while (il < buf.size()) {
+            size_t iq = buf.find('\n', il);
+            iq = iq == string::npos ? buf.size() : iq;
+            string l = buf.substr(il, iq - il);
+            il = iq + 1;
+            if (l.find("!") != string::npos)
+                l.resize(l.find("!"));
+            l.erase(remove(l.begin(), l.end(), '\r'), l.end());
+            Parsing::lower(l);
             if (l.find("&fci") != string::npos)
                 l.replace(l.find("&fci"), 4, "");
             if (l.find("/") != string::npos || l.find("&end") != string::npos)
@@ -728,7 +833,7 @@ struct FCIDUMP {
             else
                 pars.push_back(l);
         }
-        il++;
+        il = min(il, buf.size());
         string par = Parsing::join(pars.begin(), pars.end(), ",");
         for (size_t ip = 0; ip < par.length(); ip++)
             if (par[ip] == ' ')
@@ -748,26 +853,95 @@ struct FCIDUMP {
                                         : params[p_key] + "," + cc;
             }
         }
-        size_t int_sz = lines.size() > il ? lines.size() - il : 0;
-        vector<array<uint16_t, 4>> int_idx(int_sz);
-        vector<double> int_val(int_sz);
         int ntg = threading->activate_global();
-#pragma omp parallel for schedule(static) num_threads(ntg)
-        for (int64_t ill = 0; ill < (int64_t)int_sz; ill++) {
-            string ll = Parsing::trim(lines[il + ill]);
-            if (ll.length() == 0 || ll[0] == '!') {
-                int_idx[ill][0] = numeric_limits<uint16_t>::max();
-                continue;
+        vector<size_t> bounds(ntg + 1, buf.size());
+        bounds[0] = il;
+        for (int it = 1; it < ntg; it++) {
+            size_t ib = il + (buf.size() - il) * it / ntg;
+            if (ib <= bounds[it - 1])
+                bounds[it] = bounds[it - 1];
+            else {
+                size_t iq = buf.find('\n', ib - 1);
+                bounds[it] = iq == string::npos ? buf.size() : iq + 1;
+            }
+        }
+        vector<vector<array<uint16_t, 4>>> th_idx(ntg);
+        vector<vector<double>> th_val(ntg);
+        vector<uint8_t> th_err(ntg, 0);
+        const char *pbuf = buf.c_str();
+#pragma omp parallel num_threads(ntg)
+        {
+            int tid = threading->get_thread_id();
+            vector<array<uint16_t, 4>> &idx = th_idx[tid];
+            vector<double> &val = th_val[tid];
+            // about 45 bytes per line in files written by FCIDUMP::write
+            idx.reserve((bounds[tid + 1] - bounds[tid]) / 40);
+            val.reserve((bounds[tid + 1] - bounds[tid]) / 40);
+            const char *p = pbuf + bounds[tid], *pend = pbuf + bounds[tid + 1];
+            while (p < pend) {
+                const char *q = (const char *)memchr(p, '\n', pend - p);
+                q = q == nullptr ? pend : q;
+                const char *qc = (const char *)memchr(p, '!', q - p);
+                qc = qc == nullptr ? q : qc;
+                while (p < qc && isspace(*p))
+                    p++;
+                if (p < qc) {
+                    char *pe;
+                    val.push_back(strtod(p, &pe));
+                    array<uint16_t, 4> x;
+                    for (int k = 0; k < 4; k++)
+                        x[k] = (uint16_t)strtol(pe, &pe, 10);
+                    if (pe > qc) {
+                        th_err[tid] = 1;
+                        break;
+                    }
+                    idx.push_back(x);
+                }
+                p = q + 1;
             }
-            vector<string> ls = Parsing::split(ll, " ", true);
-            assert(ls.size() == 5);
-            int_idx[ill] = array<uint16_t, 4>{(uint16_t)Parsing::to_int(ls[1]),
-                                              (uint16_t)Parsing::to_int(ls[2]),
-                                              (uint16_t)Parsing::to_int(ls[3]),
-                                              (uint16_t)Parsing::to_int(ls[4])};
-            int_val[ill] = Parsing::to_double(ls[0]);
         }
         threading->activate_normal();
+        if (find(th_err.begin(), th_err.end(), 1) != th_err.end())
+            throw runtime_error("FCIDUMP::read on '" + filename +
+                                "': invalid integral line.");
+        size_t int_sz = 0;
+        for (int it = 0; it < ntg; it++)
+            int_sz += th_val[it].size();
+        int_idx.clear(), int_idx.reserve(int_sz);
+        int_val.clear(), int_val.reserve(int_sz);
+        for (int it = 0; it < ntg; it++) {
+            int_idx.insert(int_idx.end(), th_idx[it].begin(), th_idx[it].end());
+            int_val.insert(int_val.end(), th_val[it].begin(), th_val[it].end());
+        }
+    }
+    // Parsing a FCIDUMP file (text or binary format, optionally compressed
+    // with gzip or zstd if filename ends with ".gz" or ".zst")
+    virtual void read(const string &filename) {
+        if (is_binary(filename)) {
+            load_data(filename);
+            return;
+        }
+        string buf = CompressedFile::read(filename);
+        if (buf.compare(0, binary_tag().size(), binary_tag()) == 0) {
+            istringstream iss(buf);
+            buf = string();
+            load_data(iss);
+            if (iss.fail() || iss.bad())
+                throw runtime_error("FCIDUMP::load_data on '" + filename +
+                                    "' failed.");
+            return;
+        }
+        params.clear();
+        ts.clear();
+        vs.clear();
+        vabs.clear();
+        vgs.clear();
+        vexp = nullptr;
+        const_e = 0.0;
+        vector<array<uint16_t, 4>> int_idx;
+        vector<double> int_val;
+        parse_text(buf, filename, params, int_idx, int_val);
+        buf = string();
         uint16_t n = (uint16_t)Parsing::to_int(params["norb"]);
         uhf = params.count("iuhf") != 0 && Parsing::to_int(params["iuhf"]) == 1;
         general = params.count("igeneral") != 0 &&
@@ -796,8 +970,6 @@ struct FCIDUMP {
                 vgs[0].clear();
             }
             for (size_t i = 0; i < int_val.size(); i++) {
-                if (int_idx[i][0] == numeric_limits<uint16_t>::max())
-                    continue;
                 if (int_idx[i][0] + int_idx[i][1] + int_idx[i][2] +
                         int_idx[i][3] ==
                     0)
@@ -848,8 +1020,6 @@ struct FCIDUMP {
             }
             int ip = 0;
             for (size_t i = 0; i < int_val.size(); i++) {
-                if (int_idx[i][0] == numeric_limits<uint16_t>::max())
-                    continue;
                 if (int_idx[i][0] + int_idx[i][1] + int_idx[i][2] +
                         int_idx[i][3] ==
                     0) {
@@ -879,10 +1049,119 @@ struct FCIDUMP {
             }
         }
     }
+    // Reading a FCIDUMP in binary format
+    // The integrals are read into the storage with one bulk read
+    void load_data(istream &ifs) {
+        string tag(binary_tag().size(), '\0');
+        ifs.read(&tag[0], tag.size());
+        if (tag != binary_tag())
+            throw runtime_error("FCIDUMP::load_data: not a binary FCIDUMP.");
+        params.clear();
+        vexp = nullptr;
+        int nparams = 0;
+        ifs.read((char *)&nparams, sizeof(nparams));
+        for (int i = 0; i < nparams; i++) {
+            string kv[2];
+            for (int k = 0; k < 2; k++) {
+                size_t len = 0;
+                ifs.read((char *)&len, sizeof(len));
+                kv[k].resize(len);
+                ifs.read(&kv[k][0], len);
+            }
+            params[kv[0]] = kv[1];
+        }
+        ifs.read((char *)&const_e, sizeof(const_e));
+        uint8_t flags[3];
+        ifs.read((char *)flags, sizeof(flags));
+        uhf = flags[0], general = flags[1];
+        int nts = 0, nvs = 0, nvabs = 0, nvgs = 0;
+        ifs.read((char *)&nts, sizeof(nts));
+        ifs.read((char *)&nvs, sizeof(nvs));
+        ifs.read((char *)&nvabs, sizeof(nvabs));
+        ifs.read((char *)&nvgs, sizeof(nvgs));
+        ifs.read((char *)&total_memory, sizeof(total_memory));
+        vector<size_t> offsets(nts + nvs + nvabs + nvgs);
+        ifs.read((char *)offsets.data(), sizeof(size_t) * offsets.size());
+        uint16_t n = n_sites();
+        vdata = make_shared<vector<double>>(total_memory);
+        shared_data = nullptr;
+        data = vdata->data();
+        ifs.read((char *)data, sizeof(double) * total_memory);
+        ts = vector<TInt>(nts, TInt(n, flags[2]));
+        vs = vector<V8Int>(nvs, V8Int(n));
+        vabs = vector<V4Int>(nvabs, V4Int(n));
+        vgs = vector<V1Int>(nvgs, V1Int(n));
+        size_t ih = 0;
+        for (auto &x : ts)
+            x.data = data + offsets[ih++];
+        for (auto &x : vs)
+            x.data = data + offsets[ih++];
+        for (auto &x : vabs)
+            x.data = data + offsets[ih++];
+        for (auto &x : vgs)
+            x.data = data + offsets[ih++];
+    }
+    void load_data(const string &filename) {
+        ifstream ifs(filename.c_str(), ios::binary);
+        if (!ifs.good())
+            throw runtime_error("FCIDUMP::load_data on '" + filename +
+                                "' failed.");
+        load_data(ifs);
+        if (ifs.fail() || ifs.bad())
+            throw runtime_error("FCIDUMP::load_data on '" + filename +
+                                "' failed.");
+        ifs.close();
+    }
+    // Writing a FCIDUMP in binary format, which can be read by read or
+    // load_data much faster than the text format
+    void save_data(ostream &ofs) const {
+        ofs.write(binary_tag().c_str(), binary_tag().size());
+        int nparams = (int)params.size();
+        ofs.write((char *)&nparams, sizeof(nparams));
+        for (auto &p : params)
+            for (const string &x : {p.first, p.second}) {
+                size_t len = x.size();
+                ofs.write((char *)&len, sizeof(len));
+                ofs.write(x.c_str(), len);
+            }
+        ofs.write((char *)&const_e, sizeof(const_e));
+        uint8_t flags[3] = {uhf, general, ts[0].general};
+        ofs.write((char *)flags, sizeof(flags));
+        int nts = (int)ts.size(), nvs = (int)vs.size();
+        int nvabs = (int)vabs.size(), nvgs = (int)vgs.size();
+        ofs.write((char *)&nts, sizeof(nts));
+        ofs.write((char *)&nvs, sizeof(nvs));
+        ofs.write((char *)&nvabs, sizeof(nvabs));
+        ofs.write((char *)&nvgs, sizeof(nvgs));
+        ofs.write((char *)&total_memory, sizeof(total_memory));
+        vector<size_t> offsets;
+        for (auto &x : ts)
+            offsets.push_back(x.data - data);
+        for (auto &x : vs)
+            offsets.push_back(x.data - data);
+        for (auto &x : vabs)
+            offsets.push_back(x.data - data);
+        for (auto &x : vgs)
+            offsets.push_back(x.data - data);
+        ofs.write((char *)offsets.data(), sizeof(size_t) * offsets.size());
+        ofs.write((char *)data, sizeof(double) * total_memory);
+    }
+    void save_data(const string &filename) const {
+        ofstream ofs(filename.c_str(), ios::binary);
+        if (!ofs.good())
+            throw runtime_error("FCIDUMP::save_data on '" + filename +
+                                "' failed.");
+        save_data(ofs);
+        if (!ofs.good())
+            throw runtime_error("FCIDUMP::save_data on '" + filename +
+                                "' failed.");
+        ofs.close();
+    }
     // Remove integral elements that violate point group symmetry
     // orbsym: in XOR convention
     virtual double symmetrize(const vector<uint8_t> &orbsym) {
         uint16_t n = n_sites();
+        vexp = nullptr;
         assert((int)orbsym.size() == n);
         double error = 0.0;
         for (auto &t : ts)
@@ -918,6 +1197,7 @@ struct FCIDUMP {
     // orbsym: in Lz convention
     virtual double symmetrize(const vector<int16_t> &orbsym) {
         uint16_t n = n_sites();
+        vexp = nullptr;
         assert((int)orbsym.size() == n);
         double error = 0.0;
         for (auto &t : ts)
@@ -953,6 +1233,7 @@ struct FCIDUMP {
     // ksym: k symmetry
     virtual double symmetrize(const vector<int> &ksym, int kmod) {
         uint16_t n = n_sites();
+        vexp = nullptr;
         assert((int)ksym.size() == n);
         if (vabs.size() != 0 || vs.size() != 0)
             cout << "WARNING: k symmetry should not be used together with "
@@ -1085,6 +1366,11 @@ struct FCIDUMP {
             }
         } else
             spin_occ = iocc;
+        auto vx = [this](uint8_t sl, uint8_t sr, uint16_t i, uint16_t j,
+                         uint16_t k, uint16_t l) {
+            return vexp != nullptr ? (*vexp)(sl, sr, i, j, k, l)
+                                   : v(sl, sr, i, j, k, l);
+        };
         for (uint16_t i = 0; i < n_block_sites; i++)
             for (uint8_t si = 0; si < 2; si++)
                 if (spin_occ[i * 2 + si]) {
@@ -1093,12 +1379,12 @@ struct FCIDUMP {
                         for (uint8_t sj = 0; sj < 2; sj++)
                             if (spin_occ[j * 2 + sj]) {
                                 energy +=
-                                    0.5 * v(si, sj, i + i_begin, i + i_begin,
-                                            j + i_begin, j + i_begin);
+                                    0.5 * vx(si, sj, i + i_begin, i + i_begin,
+                                             j + i_begin, j + i_begin);
                                 if (si == sj)
-                                    energy -= 0.5 * v(si, sj, i + i_begin,
-                                                      j + i_begin, j + i_begin,
-                                                      i + i_begin);
+                                    energy -= 0.5 * vx(si, sj, i + i_begin,
+                                                       j + i_begin, j + i_begin,
+                                                       i + i_begin);
                             }
                 }
         return energy;
@@ -1204,6 +1490,7 @@ struct FCIDUMP {
     }
     virtual void reorder(const vector<uint16_t> &ord) {
         uint16_t n = n_sites();
+        vexp = nullptr;
         assert(ord.size() == n);
         shared_ptr<vector<double>> rdata =
             make_shared<vector<double>>(total_memory);
@@ -1228,6 +1515,7 @@ struct FCIDUMP {
             rvs[i].reorder(vs[i], ord);
         }
         vdata = rdata;
+        shared_data = nullptr;
         data = rdata->data();
         ts = rts, vgs = rvgs, vabs = rvabs, vs = rvs;
         if (params.count("orbsym"))
@@ -1239,6 +1527,7 @@ struct FCIDUMP {
     // rot_mat: (old, new)
     virtual void rotate(const vector<double> &rot_mat) {
         uint16_t n = n_sites();
+        vexp = nullptr;
         assert((int)rot_mat.size() == (int)n * n);
         shared_ptr<vector<double>> rdata =
             make_shared<vector<double>>(total_memory);
@@ -1263,12 +1552,14 @@ struct FCIDUMP {
             rvs[i].rotate(vs[i], rot_mat);
         }
         vdata = rdata;
+        shared_data = nullptr;
         data = rdata->data();
         ts = rts, vgs = rvgs, vabs = rvabs, vs = rvs;
     }
     virtual shared_ptr<FCIDUMP> deep_copy() const {
         shared_ptr<FCIDUMP> fcidump = make_shared<FCIDUMP>(*this);
-        fcidump->vdata = make_shared<vector<double>>(*vdata);
+        fcidump->vdata = make_shared<vector<double>>(data, data + total_memory);
+        fcidump->shared_data = nullptr;
         fcidump->data = fcidump->vdata->data();
         vector<TInt> rts(ts);
         vector<V1Int> rvgs(vgs);
@@ -1284,6 +1575,103 @@ struct FCIDUMP {
             fcidump->vs[i].data = vs[i].data - data + fcidump->data;
         return fcidump;
     }
+    // Integrals of the active space [n_core, n_core + n_active), with the
+    // doubly occupied core orbitals [0, n_core) folded into effective
+    // one-electron integrals and const_e, and the remaining (empty)
+    // orbitals dropped
+    // t'_pq(s) = t_pq(s) + sum_c [sum_s' v_pqcc(s, s') - v_pccq(s, s)]
+    // E_core = sum_c sum_s t_cc(s)
+    //        + 1/2 sum_cd [sum_ss' v_ccdd(s, s') - sum_s v_cddc(s, s)]
+    // Only the virtual t and v are used, so this works for any subclass
+    shared_ptr<FCIDUMP> fold_frozen_core(uint16_t n_core,
+                                         uint16_t n_active) const {
+        const uint16_t n = n_sites(), na = n_active;
+        assert(n_core + n_active <= n);
+        assert(n_elec() >= 2 * n_core);
+        const bool tgen = ts.size() != 0 && ts[0].general;
+        const int ns = uhf ? 2 : 1;
+        double ecore = const_e;
+        for (uint16_t c = 0; c < n_core; c++)
+            for (uint8_t s = 0; s < 2; s++) {
+                ecore += t(s, c, c);
+                for (uint16_t d = 0; d < n_core; d++) {
+                    for (uint8_t sp = 0; sp < 2; sp++)
+                        ecore += 0.5 * v(s, sp, c, c, d, d);
+                    ecore -= 0.5 * v(s, s, c, d, d, c);
+                }
+            }
+        vector<TInt> rts(ns, TInt(na, tgen));
+        vector<vector<double>> rtd(ns, vector<double>(rts[0].size()));
+        for (int s = 0; s < ns; s++)
+            rts[s].data = rtd[s].data();
+        int ntg = threading->activate_global();
+#pragma omp parallel for schedule(dynamic) num_threads(ntg)
+        for (int p = 0; p < (int)na; p++)
+            for (uint16_t q = 0; q < (tgen ? na : p + 1); q++)
+                for (int s = 0; s < ns; s++) {
+                    const uint16_t ip = p + n_core, iq = q + n_core;
+                    double x = t((uint8_t)s, ip, iq);
+                    for (uint16_t c = 0; c < n_core; c++) {
+                        for (uint8_t sp = 0; sp < 2; sp++)
+                            x += v((uint8_t)s, sp, ip, iq, c, c);
+                        x -= v((uint8_t)s, (uint8_t)s, ip, c, c, iq);
+                    }
+                    rts[s](p, q) = x;
+                }
+        // (sl, sr) of stored two-electron blocks: (0, 0) or
+        // (0, 0), (1, 1), (0, 1)
+        const uint8_t bsl[3] = {0, 1, 0}, bsr[3] = {0, 1, 1};
+        const int nb = uhf ? 3 : 1;
+        vector<vector<double>> rvd(nb);
+        for (int b = 0; b < nb; b++) {
+            V1Int vg(na);
+            V4Int v4(na);
+            V8Int v8(na);
+            rvd[b].resize(general ? vg.size()
+                                  : (b == 2 ? v4.size() : v8.size()));
+            vg.data = v4.data = v8.data = rvd[b].data();
+#pragma omp parallel for schedule(dynamic) num_threads(ntg)
+            for (int i = 0; i < (int)na; i++)
+                for (uint16_t j = 0; j < na; j++)
+                    for (uint16_t k = 0; k < na; k++)
+                        for (uint16_t l = 0; l < na; l++) {
+                            if (!general && (j > i || l > k))
+                                continue;
+                            double x =
+                                v(bsl[b], bsr[b], i + n_core, j + n_core,
+                                  k + n_core, l + n_core);
+                            if (general)
+                                vg(i, j, k, l) = x;
+                            else if (b == 2)
+                                v4(i, j, k, l) = x;
+                            else
+                                v8(i, j, k, l) = x;
+                        }
+        }
+        threading->activate_normal();
+        shared_ptr<FCIDUMP> r = make_shared<FCIDUMP>();
+        if (uhf)
+            r->initialize_sz(na, n_elec() - 2 * n_core, twos(), isym(), ecore,
+                             rtd[0].data(), rtd[0].size(), rtd[1].data(),
+                             rtd[1].size(), rvd[0].data(), rvd[0].size(),
+                             rvd[1].data(), rvd[1].size(), rvd[2].data(),
+                             rvd[2].size());
+        else
+            r->initialize_su2(na, n_elec() - 2 * n_core, twos(), isym(), ecore,
+                              rtd[0].data(), rtd[0].size(), rvd[0].data(),
+                              rvd[0].size());
+        // per-orbital parameters are restricted to the active orbitals
+        for (auto &p : params)
+            if (r->params.count(p.first) == 0) {
+                if (p.first == "orbsym" || p.first == "ksym") {
+                    vector<string> xs = Parsing::split(p.second, ",", true);
+                    r->params[p.first] = Parsing::join(
+                        xs.begin() + n_core, xs.begin() + n_core + na, ",");
+                } else
+                    r->params[p.first] = p.second;
+            }
+        return r;
+    }
     // One-electron integral element (SU(2))
     virtual double t(uint16_t i, uint16_t j) const { return ts[0](i, j); }
     // One-electron integral element (SZ)
@@ -1307,15 +1695,122 @@ struct FCIDUMP {
         } else
             return general ? vgs[0](i, j, k, l) : vs[0](i, j, k, l);
     }
+    // Two-electron integral elements v(i, j, k, l) for all k, l (SU(2))
+    // r: n_sites x n_sites array
+    virtual void v_block(uint16_t i, uint16_t j, double *r) const {
+        const uint16_t n = n_sites();
+        for (uint16_t k = 0; k < n; k++)
+            for (uint16_t l = 0; l < n; l++)
+                r[(size_t)k * n + l] = v(i, j, k, l);
+    }
+    // Two-electron integral elements v(i, j, k, l) for all k, l (SZ)
+    // r: n_sites x n_sites array
+    virtual void v_block(uint8_t sl, uint8_t sr, uint16_t i, uint16_t j,
+                         double *r) const {
+        const uint16_t n = n_sites();
+        for (uint16_t k = 0; k < n; k++)
+            for (uint16_t l = 0; l < n; l++)
+                r[(size_t)k * n + l] = v(sl, sr, i, j, k, l);
+    }
+    // Call f(s, i, j, t) for all nonzero one-electron integral elements
+    // (SZ, both spins)
+    virtual void for_each_t(
+        const function<void(uint8_t, uint16_t, uint16_t, double)> &f) const {
+        const uint16_t n = n_sites();
+        for (uint8_t s = 0; s < 2; s++)
+            for (uint16_t i = 0; i < n; i++)
+                for (uint16_t j = 0; j < n; j++) {
+                    double x = t(s, i, j);
+                    if (x != 0.0)
+                        f(s, i, j, x);
+                }
+    }
+    // Call f(sl, sr, i, j, k, l, v) for all nonzero two-electron integral
+    // elements (SZ, all four spin blocks)
+    // Lattice models override this to visit only the elements allowed by
+    // conservation laws, without checking all n^4 index combinations
+    virtual void for_each_v(
+        const function<void(uint8_t, uint8_t, uint16_t, uint16_t, uint16_t,
+                            uint16_t, double)> &f) const {
+        const uint16_t n = n_sites();
+        vector<double> r((size_t)n * n);
+        for (uint8_t sl = 0; sl < 2; sl++)
+            for (uint8_t sr = 0; sr < 2; sr++)
+                for (uint16_t i = 0; i < n; i++)
+                    for (uint16_t j = 0; j < n; j++) {
+                        v_block(sl, sr, i, j, r.data());
+                        for (uint16_t k = 0; k < n; k++)
+                            for (uint16_t l = 0; l < n; l++)
+                                if (r[(size_t)k * n + l] != 0.0)
+                                    f(sl, sr, i, j, k, l,
+                                      r[(size_t)k * n + l]);
+                    }
+    }
+    // Build the expanded view vexp of two-electron integrals from v_block
+    // Memory: (1 or 3) x npair^2 doubles
+    void expand_integrals() {
+        const uint16_t n = n_sites();
+        const bool gen = general;
+        shared_ptr<VExpandedInt> x = make_shared<VExpandedInt>(n, gen);
+        const size_t mm = (size_t)x->m * x->m;
+        // spin blocks stored: (0, 0) or (0, 0), (1, 1), (0, 1)
+        const int nb = uhf ? 3 : 1;
+        const uint8_t bsl[3] = {0, 1, 0}, bsr[3] = {0, 1, 1};
+        x->vdata = make_shared<vector<double>>(mm * nb);
+        for (int b = 0; b < 4; b++)
+            x->offsets[b] = 0, x->sij[b] = x->m, x->skl[b] = 1;
+        if (uhf) {
+            x->offsets[3] = mm, x->offsets[1] = x->offsets[2] = mm * 2;
+            x->sij[2] = 1, x->skl[2] = x->m;
+        }
+        assert((size_t)n * n <= (size_t)numeric_limits<int>::max());
+        int ntg = threading->activate_global();
+        vector<vector<double>> vkls(ntg, vector<double>((size_t)n * n));
+#pragma omp parallel num_threads(ntg)
+        {
+            vector<double> &vkl = vkls[threading->get_thread_id()];
+#pragma omp for schedule(dynamic)
+            for (int ij = 0; ij < (int)n * n; ij++) {
+                const uint16_t i = ij / n, j = ij % n;
+                if (!gen && j > i)
+                    continue;
+                for (int b = 0; b < nb; b++) {
+                    if (uhf)
+                        v_block(bsl[b], bsr[b], i, j, vkl.data());
+                    else
+                        v_block(i, j, vkl.data());
+                    double *r = x->vdata->data() + mm * b +
+                                (size_t)x->pidx[ij] * x->m;
+                    for (uint16_t k = 0; k < n; k++)
+                        for (uint16_t l = 0; l < (gen ? n : k + 1); l++)
+                            r[x->pidx[(size_t)k * n + l]] =
+                                vkl[(size_t)k * n + l];
+                }
+            }
+        }
+        threading->activate_normal();
+        vexp = x;
+    }
     virtual double e() const { return const_e; }
+    // Stable hash of the integrals, core energy and number of sites
+    // (electron number, spin and target symmetry are not included)
+    virtual uint64_t content_hash() const {
+        const uint64_t hdr[4] = {(uint64_t)n_sites(), (uint64_t)uhf,
+                                 (uint64_t)general, (uint64_t)total_memory};
+        uint64_t h = Parsing::hash_bytes(hdr, sizeof(hdr));
+        h = Parsing::hash_bytes(&const_e, sizeof(const_e), h);
+        return Parsing::hash_bytes(data, sizeof(double) * total_memory, h);
+    }
     virtual void deallocate() {
         assert(total_memory != 0);
         vdata = nullptr;
+        shared_data = nullptr;
         data = nullptr;
         ts.clear();
         vs.clear();
         vabs.clear();
         vgs.clear();
+        vexp = nullptr;
     }
 };
 
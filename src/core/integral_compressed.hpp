@@ -85,6 +85,10 @@ struct CompressedV1Int {
         return ((const CompressedVector<double>
                      &)(*cps_data))[(((size_t)i * n + j) * n + k) * n + l];
     }
+    // Elements (i, j, k, l) for all k, l, stored in r as n x n array
+    void get_block(uint16_t i, uint16_t j, double *r) const {
+        cps_data->get_range(((size_t)i * n + j) * n * n, (size_t)n * n, r);
+    }
     void reorder(const CompressedV1Int &other, const vector<uint16_t> &ord) {
         assert(n == other.n);
         for (uint32_t i = 0; i < n; i++)
@@ -133,6 +137,14 @@ struct CompressedV4Int {
         return ((const CompressedVector<double>
                      &)(*cps_data))[find_index(i, j, k, l)];
     }
+    // Elements (i, j, k, l) for all k, l, stored in r as n x n array
+    void get_block(uint16_t i, uint16_t j, double *r) const {
+        vector<double> rp(m);
+        cps_data->get_range(find_index(i, j) * m, m, rp.data());
+        for (uint32_t k = 0; k < n; k++)
+            for (uint32_t l = 0; l < n; l++)
+                r[(size_t)k * n + l] = rp[find_index(k, l)];
+    }
     void reorder(const CompressedV4Int &other, const vector<uint16_t> &ord) {
         assert(n == other.n);
         for (uint32_t i = 0; i < n; i++)
@@ -181,6 +193,20 @@ struct CompressedV8Int {
         return ((const CompressedVector<double>
                      &)(*cps_data))[find_index(i, j, k, l)];
     }
+    // Elements (i, j, k, l) for all k, l, stored in r as n x n array
+    // Pairs kl not after ij are contiguous in storage, the others are read
+    // in storage order
+    void get_block(uint16_t i, uint16_t j, double *r) const {
+        const CompressedVector<double> &cv = *cps_data;
+        const size_t p = find_index((uint32_t)i, (uint32_t)j);
+        vector<double> rp(m);
+        cv.get_range(p * (p + 1) >> 1, p + 1, rp.data());
+        for (size_t q = p + 1; q < m; q++)
+            rp[q] = cv[(q * (q + 1) >> 1) + p];
+        for (uint32_t k = 0; k < n; k++)
+            for (uint32_t l = 0; l < n; l++)
+                r[(size_t)k * n + l] = rp[find_index(k, l)];
+    }
     void reorder(const CompressedV8Int &other, const vector<uint16_t> &ord) {
         assert(n == other.n);
         for (uint32_t i = 0, ij = 0; i < n; i++)
@@ -232,6 +258,7 @@ struct CompressedFCIDUMP : FCIDUMP {
         cps_vs.clear();
         cps_vabs.clear();
         cps_vgs.clear();
+        vexp = nullptr;
         this->const_e = e;
         params["norb"] = Parsing::to_string(n_sites);
         params["nelec"] = Parsing::to_string(n_elec);
@@ -290,6 +317,7 @@ struct CompressedFCIDUMP : FCIDUMP {
         cps_vs.clear();
         cps_vabs.clear();
         cps_vgs.clear();
+        vexp = nullptr;
         this->const_e = e;
         params["norb"] = Parsing::to_string(n_sites);
         params["nelec"] = Parsing::to_string(n_elec);
@@ -318,11 +346,8 @@ struct CompressedFCIDUMP : FCIDUMP {
         uhf = false;
         freeze();
     }
-    // Writing FCIDUMP file to disk
-    void write(const string &filename) const override {
-        ofstream ofs(filename.c_str());
-        if (!ofs.good())
-            throw runtime_error("FCIDUMP::write on '" + filename + "' failed.");
+    // Writing FCIDUMP in text format
+    void write_text(ostream &ofs) const override {
         ofs << " &FCI NORB=" << setw(4) << (int)n_sites()
             << ",NELEC=" << setw(4) << (int)n_elec() << ",MS2=" << setw(4)
             << (int)twos() << "," << endl;
@@ -336,7 +361,7 @@ struct CompressedFCIDUMP : FCIDUMP {
         if (cps_ts[0].general)
             ofs << "  ITGENERAL=1," << endl;
         ofs << " &END" << endl;
-        auto write_const = [](ofstream &os, double x) {
+        auto write_const = [](ostream &os, double x) {
             os << fixed << setprecision(16);
             os << setw(20) << x << setw(4) << 0 << setw(4) << 0 << setw(4) << 0
                << setw(4) << 0 << endl;
@@ -361,75 +386,18 @@ struct CompressedFCIDUMP : FCIDUMP {
                 ofs << cps_ts[i], write_const(ofs, 0.0);
             write_const(ofs, this->const_e);
         }
-        if (!ofs.good())
-            throw runtime_error("FCIDUMP::write on '" + filename + "' failed.");
-        ofs.close();
     }
     // Parsing a FCIDUMP file
     void read(const string &filename) override {
         params.clear();
+        vexp = nullptr;
         cps_ts.clear();
         cps_vs.clear();
         cps_vabs.clear();
         const_e = 0.0;
-        ifstream ifs(filename.c_str());
-        if (!ifs.good())
-            throw runtime_error("FCIDUMP::read on '" + filename + "' failed.");
-        vector<string> lines = Parsing::readlines(&ifs);
-        if (ifs.bad())
-            throw runtime_error("FCIDUMP::read on '" + filename + "' failed.");
-        ifs.close();
-        vector<string> pars;
-        size_t il = 0;
-        for (; il < lines.size(); il++) {
-            string l(Parsing::lower(lines[il]));
-            if (l.find("&fci") != string::npos)
-                l.replace(l.find("&fci"), 4, "");
-            if (l.find("/") != string::npos || l.find("&end") != string::npos)
-                break;
-            else
-                pars.push_back(l);
-        }
-        il++;
-        string par = Parsing::join(pars.begin(), pars.end(), ",");
-        for (size_t ip = 0; ip < par.length(); ip++)
-            if (par[ip] == ' ')
-                par[ip] = ',';
-        pars = Parsing::split(par, ",", true);
-        string p_key = "";
-        for (auto &c : pars) {
-            if (c.find("=") != string::npos || p_key.length() == 0) {
-                vector<string> cs = Parsing::split(c, "=", true);
-                p_key = Parsing::trim(cs[0]);
-                params[p_key] = cs.size() == 2 ? Parsing::trim(cs[1]) : "";
-            } else {
-                string cc = Parsing::trim(c);
-                if (cc.length() != 0)
-                    params[p_key] = params[p_key].length() == 0
-                                        ? cc
-                                        : params[p_key] + "," + cc;
-            }
-        }
-        size_t int_sz = lines.size() > il ? lines.size() - il : 0;
-        vector<array<uint16_t, 4>> int_idx(int_sz);
-        vector<double> int_val(int_sz);
-        int ntg = threading->activate_global();
-#pragma omp parallel for schedule(static) num_threads(ntg)
-        for (int64_t ill = 0; ill < (int64_t)int_sz; ill++) {
-            string ll = Parsing::trim(lines[il + ill]);
-            if (ll.length() == 0 || ll[0] == '!') {
-                int_idx[ill][0] = numeric_limits<uint16_t>::max();
-                continue;
-            }
-            vector<string> ls = Parsing::split(ll, " ", true);
-            assert(ls.size() == 5);
-            int_idx[ill] = array<uint16_t, 4>{(uint16_t)Parsing::to_int(ls[1]),
-                                              (uint16_t)Parsing::to_int(ls[2]),
-                                              (uint16_t)Parsing::to_int(ls[3]),
-                                              (uint16_t)Parsing::to_int(ls[4])};
-            int_val[ill] = Parsing::to_double(ls[0]);
-        }
-        threading->activate_normal();
+        vector<array<uint16_t, 4>> int_idx;
+        vector<double> int_val;
+        read_text(filename, params, int_idx, int_val);
         uint16_t n = (uint16_t)Parsing::to_int(params["norb"]);
         uhf = params.count("iuhf") != 0 && Parsing::to_int(params["iuhf"]) == 1;
         general = params.count("igeneral") != 0 &&
@@ -453,8 +421,6 @@ struct CompressedFCIDUMP : FCIDUMP {
                 cps_vgs[0].clear();
             }
             for (size_t i = 0; i < int_val.size(); i++) {
-                if (int_idx[i][0] == numeric_limits<uint16_t>::max())
-                    continue;
                 if (int_idx[i][0] + int_idx[i][1] + int_idx[i][2] +
                         int_idx[i][3] ==
                     0)
@@ -506,8 +472,6 @@ struct CompressedFCIDUMP : FCIDUMP {
             }
             int ip = 0;
             for (size_t i = 0; i < int_val.size(); i++) {
-                if (int_idx[i][0] == numeric_limits<uint16_t>::max())
-                    continue;
                 if (int_idx[i][0] + int_idx[i][1] + int_idx[i][2] +
                         int_idx[i][3] ==
                     0) {
@@ -542,6 +506,7 @@ struct CompressedFCIDUMP : FCIDUMP {
     // orbsym: in XOR convention
     double symmetrize(const vector<uint8_t> &orbsym) override {
         uint16_t n = n_sites();
+        vexp = nullptr;
         assert((int)orbsym.size() == n);
         double error = 0.0;
         unfreeze();
@@ -619,6 +584,7 @@ struct CompressedFCIDUMP : FCIDUMP {
     }
     void reorder(const vector<uint16_t> &ord) override {
         uint16_t n = n_sites();
+        vexp = nullptr;
         assert(ord.size() == n);
         vector<CompressedTInt> rts(cps_ts);
         vector<CompressedV1Int> rvgs(cps_vgs);
@@ -679,6 +645,29 @@ struct CompressedFCIDUMP : FCIDUMP {
         } else
             return general ? cps_vgs[0](i, j, k, l) : cps_vs[0](i, j, k, l);
     }
+    // Two-electron integral elements v(i, j, k, l) for all k, l (SU(2))
+    void v_block(uint16_t i, uint16_t j, double *r) const override {
+        if (general)
+            cps_vgs[0].get_block(i, j, r);
+        else
+            cps_vs[0].get_block(i, j, r);
+    }
+    // Two-electron integral elements v(i, j, k, l) for all k, l (SZ)
+    void v_block(uint8_t sl, uint8_t sr, uint16_t i, uint16_t j,
+                 double *r) const override {
+        if (!uhf)
+            v_block(i, j, r);
+        else if (sl == sr && general)
+            cps_vgs[sl].get_block(i, j, r);
+        else if (sl == sr)
+            cps_vs[sl].get_block(i, j, r);
+        else if (sl == 0 && sr == 1 && general)
+            cps_vgs[2].get_block(i, j, r);
+        else if (sl == 0 && sr == 1)
+            cps_vabs[0].get_block(i, j, r);
+        else
+            FCIDUMP::v_block(sl, sr, i, j, r);
+    }
     void freeze() {
         int ntg = threading->activate_global();
         for (auto &cs : cps_ts)
@@ -722,6 +711,7 @@ struct CompressedFCIDUMP : FCIDUMP {
                                   ->ref_cv;
     }
     void deallocate() override {
+        vexp = nullptr;
         cps_ts.clear();
         cps_vs.clear();
         cps_vabs.clear();
@@ -0,0 +1,346 @@
+
+/*
+ * block2: Efficient MPO implementation of quantum chemistry DMRG
+ * Copyright (C) 2020-2021 Huanchen Zhai <hczhai@caltech.edu>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#pragma once
+
+#include "integral.hpp"
+#include "matrix_functions.hpp"
+
+using namespace std;
+
+namespace block2 {
+
+// Density fitting (or Cholesky) factors of two-electron integrals
+// v(i, j, k, l) = sum_P L[P][ij] L[P][kl], ij is a symmetric pair index
+// Stored as data[ij * n_aux + P], so that each pair is contiguous
+struct DFInt {
+    // Number of orbitals
+    uint16_t n;
+    // Number of auxiliary functions (or Cholesky vectors)
+    uint32_t n_aux;
+    double *data;
+    DFInt(uint16_t n, uint32_t n_aux) : n(n), n_aux(n_aux), data(nullptr) {}
+    size_t n_pairs() const { return (size_t)n * (n + 1) >> 1; }
+    size_t find_index(uint16_t i, uint16_t j) const {
+        return i < j ? ((size_t)j * (j + 1) >> 1) + i
+                     : ((size_t)i * (i + 1) >> 1) + j;
+    }
+    size_t size() const { return n_pairs() * n_aux; }
+    void clear() { memset(data, 0, sizeof(double) * size()); }
+    double *pair(uint16_t i, uint16_t j) {
+        return data + find_index(i, j) * n_aux;
+    }
+    const double *pair(uint16_t i, uint16_t j) const {
+        return data + find_index(i, j) * n_aux;
+    }
+    // Two-electron integral element with factors of ij from this and
+    // factors of kl from other (for integrals between different spins)
+    double contract(const DFInt &other, uint16_t i, uint16_t j, uint16_t k,
+                    uint16_t l) const {
+        const double *pij = pair(i, j), *pkl = other.pair(k, l);
+        double r = 0;
+        for (uint32_t ip = 0; ip < n_aux; ip++)
+            r += pij[ip] * pkl[ip];
+        return r;
+    }
+    double operator()(uint16_t i, uint16_t j, uint16_t k, uint16_t l) const {
+        return contract(*this, i, j, k, l);
+    }
+    // Two-electron integral elements for all kl pairs (lower triangular
+    // order), with factors of ij from this and factors of kl from other
+    void contract_pairs(const DFInt &other, uint16_t i, uint16_t j,
+                        double *r) const {
+        assert(n_aux == other.n_aux);
+        MatrixFunctions::multiply(
+            MatrixRef(other.data, (MKL_INT)other.n_pairs(), n_aux), false,
+            MatrixRef((double *)pair(i, j), n_aux, 1), false,
+            MatrixRef(r, (MKL_INT)other.n_pairs(), 1), 1.0, 0.0);
+    }
+    void reorder(const DFInt &other, const vector<uint16_t> &ord) {
+        assert(n == other.n && n_aux == other.n_aux);
+        for (uint16_t i = 0; i < n; i++)
+            for (uint16_t j = 0; j <= i; j++)
+                memcpy(pair(i, j), other.pair(ord[i], ord[j]),
+                       sizeof(double) * n_aux);
+    }
+    // rot_mat: (old, new)
+    void rotate(const DFInt &other, const vector<double> &rot_mat) {
+        assert(n == other.n && n_aux == other.n_aux);
+        const size_t m = (size_t)n * n_aux;
+        vector<double> tx((size_t)n * m), ty((size_t)n * m);
+        MatrixRef c((double *)rot_mat.data(), n, n);
+        for (uint16_t i = 0; i < n; i++)
+            for (uint16_t j = 0; j < n; j++)
+                memcpy(tx.data() + i * m + (size_t)j * n_aux,
+                       other.pair(i, j), sizeof(double) * n_aux);
+        // ty[i][q][P] = sum_j tx[i][j][P] * c[j][q]
+        for (uint16_t i = 0; i < n; i++)
+            MatrixFunctions::multiply(
+                c, true, MatrixRef(tx.data() + i * m, n, n_aux), false,
+                MatrixRef(ty.data() + i * m, n, n_aux), 1.0, 0.0);
+        // tx[p][q][P] = sum_i c[i][p] * ty[i][q][P]
+        MatrixFunctions::multiply(c, true, MatrixRef(ty.data(), n, m), false,
+                                  MatrixRef(tx.data(), n, m), 1.0, 0.0);
+        for (uint16_t i = 0; i < n; i++)
+            for (uint16_t j = 0; j <= i; j++)
+                memcpy(pair(i, j), tx.data() + i * m + (size_t)j * n_aux,
+                       sizeof(double) * n_aux);
+    }
+};
+
+// One-electron integrals and density fitting (or Cholesky) factors of
+// two-electron integrals, with O(N^2 n_aux) memory
+// Two-electron integral elements are computed from the factors on demand
+struct DFFCIDUMP : FCIDUMP {
+    shared_ptr<vector<double>> vdata_df;
+    // one set of factors, or two (alpha and beta) for UHF
+    vector<DFInt> dfs;
+    // Residual diagonal threshold for Cholesky decomposition in read
+    double cutoff;
+    DFFCIDUMP(double cutoff = 1E-8) : FCIDUMP(), cutoff(cutoff) {
+        general = false;
+    }
+    virtual ~DFFCIDUMP() = default;
+    void initialize_ts(uint16_t n_sites, uint16_t n_elec, uint16_t twos,
+                       uint16_t isym, double e, const vector<const double *> &t,
+                       const vector<size_t> &lt) {
+        params.clear();
+        ts.clear();
+        vs.clear();
+        vabs.clear();
+        vgs.clear();
+        vexp = nullptr;
+        this->const_e = e;
+        params["norb"] = Parsing::to_string(n_sites);
+        params["nelec"] = Parsing::to_string(n_elec);
+        params["ms2"] = Parsing::to_string(twos);
+        params["isym"] = Parsing::to_string(isym);
+        params["iuhf"] = t.size() == 2 ? "1" : "0";
+        total_memory = 0;
+        for (size_t i = 0; i < t.size(); i++) {
+            ts.push_back(TInt(n_sites));
+            if (lt[i] != ts[i].size())
+                ts[i].general = true;
+            assert(lt[i] == ts[i].size());
+            total_memory += lt[i];
+        }
+        vdata = make_shared<vector<double>>(total_memory);
+        shared_data = nullptr;
+        data = vdata->data();
+        for (size_t i = 0, it = 0; i < t.size(); it += lt[i++]) {
+            ts[i].data = data + it;
+            memcpy(ts[i].data, t[i], sizeof(double) * lt[i]);
+        }
+        uhf = t.size() == 2;
+        general = false;
+    }
+    // Set the factors from l (one array per spin)
+    // l: n_aux x (n_sites * (n_sites + 1) / 2) array, with pair index
+    // ij = i * (i + 1) / 2 + j for i >= j
+    void initialize_dfs(const vector<const double *> &l,
+                        const vector<size_t> &ll) {
+        const uint16_t n = n_sites();
+        const size_t np = (size_t)n * (n + 1) >> 1;
+        assert(ll[0] % np == 0);
+        const uint32_t n_aux = (uint32_t)(ll[0] / np);
+        dfs = vector<DFInt>(l.size(), DFInt(n, n_aux));
+        vdata_df = make_shared<vector<double>>(dfs[0].size() * l.size());
+        for (size_t i = 0; i < l.size(); i++) {
+            assert(ll[i] == dfs[i].size());
+            dfs[i].data = vdata_df->data() + dfs[0].size() * i;
+            for (size_t ij = 0; ij < np; ij++)
+                for (uint32_t ip = 0; ip < n_aux; ip++)
+                    dfs[i].data[ij * n_aux + ip] = l[i][ip * np + ij];
+        }
+    }
+    // Initialize integrals: SU(2) case
+    void initialize_df_su2(uint16_t n_sites, uint16_t n_elec, uint16_t twos,
+                           uint16_t isym, double e, const double *t, size_t lt,
+                           const double *l, size_t ll) {
+        initialize_ts(n_sites, n_elec, twos, isym, e, {t}, {lt});
+        initialize_dfs({l}, {ll});
+    }
+    // Initialize integrals: U(1) case
+    // The alpha and beta factors must have the same number of auxiliary
+    // functions
+    void initialize_df_sz(uint16_t n_sites, uint16_t n_elec, uint16_t twos,
+                          uint16_t isym, double e, const double *ta,
+                          size_t lta, const double *tb, size_t ltb,
+                          const double *la, size_t lla, const double *lb,
+                          size_t llb) {
+        initialize_ts(n_sites, n_elec, twos, isym, e, {ta, tb}, {lta, ltb});
+        initialize_dfs({la, lb}, {lla, llb});
+    }
+    // Pivoted Cholesky decomposition of two-electron integrals in fcidump
+    // Vectors are added until the largest residual diagonal element is
+    // smaller than cutoff
+    void initialize_cholesky(const shared_ptr<FCIDUMP> &fcidump,
+                             double cutoff) {
+        assert(!fcidump->uhf && !fcidump->general);
+        const uint16_t n = fcidump->n_sites();
+        const size_t np = (size_t)n * (n + 1) >> 1;
+        initialize_ts(n, fcidump->n_elec(), fcidump->twos(), fcidump->isym(),
+                      fcidump->e(), {fcidump->ts[0].data},
+                      {fcidump->ts[0].size()});
+        params = fcidump->params;
+        vector<uint16_t> pi(np), pj(np);
+        vector<double> diag(np);
+        for (uint16_t i = 0; i < n; i++)
+            for (uint16_t j = 0; j <= i; j++) {
+                const size_t ij = ((size_t)i * (i + 1) >> 1) + j;
+                pi[ij] = i, pj[ij] = j, diag[ij] = fcidump->v(i, j, i, j);
+            }
+        // Cholesky vectors, each over all pairs
+        vector<vector<double>> lvecs;
+        vector<double> col((size_t)n * n);
+        while (lvecs.size() < np) {
+            const size_t p = max_element(diag.begin(), diag.end()) - diag.begin();
+            if (diag[p] < cutoff)
+                break;
+            fcidump->v_block(pi[p], pj[p], col.data());
+            vector<double> lx(np);
+            for (size_t kl = 0; kl < np; kl++)
+                lx[kl] = col[(size_t)pi[kl] * n + pj[kl]];
+            for (const auto &lv : lvecs)
+                for (size_t kl = 0; kl < np; kl++)
+                    lx[kl] -= lv[kl] * lv[p];
+            const double f = 1.0 / sqrt(diag[p]);
+            for (size_t kl = 0; kl < np; kl++)
+                lx[kl] *= f, diag[kl] -= lx[kl] * lx[kl];
+            diag[p] = 0;
+            lvecs.push_back(move(lx));
+        }
+        const uint32_t n_aux = (uint32_t)lvecs.size();
+        dfs = vector<DFInt>(1, DFInt(n, n_aux));
+        vdata_df = make_shared<vector<double>>(dfs[0].size());
+        dfs[0].data = vdata_df->data();
+        for (size_t kl = 0; kl < np; kl++)
+            for (uint32_t ip = 0; ip < n_aux; ip++)
+                dfs[0].data[kl * n_aux + ip] = lvecs[ip][kl];
+    }
+    // Parsing a FCIDUMP file (text or binary format), followed by the
+    // Cholesky decomposition of the two-electron integrals
+    void read(const string &filename) override {
+        shared_ptr<FCIDUMP> fd = make_shared<FCIDUMP>();
+        fd->read(filename);
+        initialize_cholesky(fd, cutoff);
+        fd->deallocate();
+    }
+    // FCIDUMP with full two-electron integrals
+    shared_ptr<FCIDUMP> to_fcidump() const {
+        shared_ptr<FCIDUMP> fd = make_shared<FCIDUMP>();
+        const uint16_t n = n_sites();
+        if (!uhf) {
+            vector<double> v = g2e_8fold();
+            fd->initialize_su2(n, n_elec(), twos(), isym(), const_e,
+                               ts[0].data, ts[0].size(), v.data(), v.size());
+        } else {
+            vector<double> vv[3];
+            for (uint8_t s = 0; s < 3; s++) {
+                const uint8_t sl = s == 1, sr = s != 0;
+                for (uint16_t i = 0; i < n; i++)
+                    for (uint16_t j = 0; j <= i; j++)
+                        for (uint16_t k = 0; k < (s == 2 ? n : i + 1); k++)
+                            for (uint16_t l = 0; l <= k; l++)
+                                if (s == 2 || i > k || (i == k && j >= l))
+                                    vv[s].push_back(v(sl, sr, i, j, k, l));
+            }
+            fd->initialize_sz(n, n_elec(), twos(), isym(), const_e, ts[0].data,
+                              ts[0].size(), ts[1].data, ts[1].size(),
+                              vv[0].data(), vv[0].size(), vv[1].data(),
+                              vv[1].size(), vv[2].data(), vv[2].size());
+        }
+        fd->params = params;
+        return fd;
+    }
+    // Writing FCIDUMP file (with full two-electron integrals) to disk
+    void write(const string &filename, bool binary = false,
+               int compress_level = -1) const override {
+        shared_ptr<FCIDUMP> fd = to_fcidump();
+        fd->write(filename, binary, compress_level);
+        fd->deallocate();
+    }
+    void reorder(const vector<uint16_t> &ord) override {
+        FCIDUMP::reorder(ord);
+        shared_ptr<vector<double>> rdata =
+            make_shared<vector<double>>(vdata_df->size());
+        vector<DFInt> rdfs(dfs);
+        for (size_t i = 0; i < dfs.size(); i++) {
+            rdfs[i].data = dfs[i].data - vdata_df->data() + rdata->data();
+            rdfs[i].reorder(dfs[i], ord);
+        }
+        vdata_df = rdata, dfs = rdfs;
+    }
+    void rotate(const vector<double> &rot_mat) override {
+        FCIDUMP::rotate(rot_mat);
+        shared_ptr<vector<double>> rdata =
+            make_shared<vector<double>>(vdata_df->size());
+        vector<DFInt> rdfs(dfs);
+        for (size_t i = 0; i < dfs.size(); i++) {
+            rdfs[i].data = dfs[i].data - vdata_df->data() + rdata->data();
+            rdfs[i].rotate(dfs[i], rot_mat);
+        }
+        vdata_df = rdata, dfs = rdfs;
+    }
+    shared_ptr<FCIDUMP> deep_copy() const override {
+        shared_ptr<DFFCIDUMP> fd = make_shared<DFFCIDUMP>(*this);
+        fd->vdata = make_shared<vector<double>>(data, data + total_memory);
+        fd->shared_data = nullptr;
+        fd->data = fd->vdata->data();
+        for (size_t i = 0; i < ts.size(); i++)
+            fd->ts[i].data = ts[i].data - data + fd->data;
+        fd->vdata_df = make_shared<vector<double>>(*vdata_df);
+        for (size_t i = 0; i < dfs.size(); i++)
+            fd->dfs[i].data =
+                dfs[i].data - vdata_df->data() + fd->vdata_df->data();
+        return fd;
+    }
+    // Two-electron integral element (SU(2))
+    double v(uint16_t i, uint16_t j, uint16_t k, uint16_t l) const override {
+        return dfs[0](i, j, k, l);
+    }
+    // Two-electron integral element (SZ)
+    double v(uint8_t sl, uint8_t sr, uint16_t i, uint16_t j, uint16_t k,
+             uint16_t l) const override {
+        return uhf ? dfs[sl].contract(dfs[sr], i, j, k, l) : dfs[0](i, j, k, l);
+    }
+    // Two-electron integral elements v(i, j, k, l) for all k, l (SU(2))
+    void v_block(uint16_t i, uint16_t j, double *r) const override {
+        v_block(0, 0, i, j, r);
+    }
+    // Two-electron integral elements v(i, j, k, l) for all k, l (SZ)
+    void v_block(uint8_t sl, uint8_t sr, uint16_t i, uint16_t j,
+                 double *r) const override {
+        const uint16_t n = n_sites();
+        const DFInt &dl = dfs[uhf ? sl : 0], &dr = dfs[uhf ? sr : 0];
+        vector<double> rp(dr.n_pairs());
+        dl.contract_pairs(dr, i, j, rp.data());
+        for (uint16_t k = 0; k < n; k++)
+            for (uint16_t l = 0; l < n; l++)
+                r[(size_t)k * n + l] = rp[dr.find_index(k, l)];
+    }
+    void deallocate() override {
+        FCIDUMP::deallocate();
+        vdata_df = nullptr;
+        dfs.clear();
+    }
+};
+
+} // namespace block2
@@ -130,4 +130,115 @@ struct KuhnMunkres {
     }
 };
 
+/** Hopcroft-Karp algorithm for finding the maximum cardinality matching
+ * of a sparse bipartite graph, and the minimum vertex cover from it.
+ * Complexity: O(E sqrt(V)).
+ */
+struct HopcroftKarp {
+    int n;                   //!< Number of left vertices.
+    int m;                   //!< Number of right vertices.
+    vector<int> adj_ptr;     //!< CSR row pointers of left to right edges.
+    vector<int> adj;         //!< CSR column indices of left to right edges.
+    vector<int> match_left;  //!< Matched right vertex of each left vertex.
+    vector<int> match_right; //!< Matched left vertex of each right vertex.
+    vector<int> dist;        //!< BFS layer of left vertices (working array).
+    /** Constructor.
+     * @param edges List of edges (left index, right index).
+     * @param n Number of left vertices.
+     * @param m Number of right vertices.
+     */
+    HopcroftKarp(const vector<pair<int, int>> &edges, int n, int m)
+        : n(n), m(m) {
+        adj_ptr.resize(n + 1, 0);
+        for (auto &e : edges)
+            adj_ptr[e.first + 1]++;
+        for (int i = 0; i < n; i++)
+            adj_ptr[i + 1] += adj_ptr[i];
+        adj.resize(edges.size());
+        vector<int> pos(adj_ptr.begin(), adj_ptr.end() - 1);
+        for (auto &e : edges)
+            adj[pos[e.first]++] = e.second;
+        match_left.resize(n, -1), match_right.resize(m, -1);
+        dist.resize(n);
+    }
+    /** Build BFS layers from free left vertices.
+     * @return ``true`` if a free right vertex is reachable.
+     */
+    bool bfs() {
+        vector<int> que;
+        que.reserve(n);
+        for (int u = 0; u < n; u++)
+            if (match_left[u] == -1)
+                dist[u] = 0, que.push_back(u);
+            else
+                dist[u] = -1;
+        bool found = false;
+        for (size_t iq = 0; iq < que.size(); iq++) {
+            int u = que[iq];
+            for (int k = adj_ptr[u]; k < adj_ptr[u + 1]; k++) {
+                int w = match_right[adj[k]];
+                if (w == -1)
+                    found = true;
+                else if (dist[w] == -1)
+                    dist[w] = dist[u] + 1, que.push_back(w);
+            }
+        }
+        return found;
+    }
+    /** Find an augmenting path along the BFS layers.
+     * @param u Starting left vertex.
+     * @return ``true`` if an augmenting path is found.
+     */
+    bool dfs(int u) {
+        for (int k = adj_ptr[u]; k < adj_ptr[u + 1]; k++) {
+            int v = adj[k], w = match_right[v];
+            if (w == -1 || (dist[w] == dist[u] + 1 && dfs(w))) {
+                match_left[u] = v, match_right[v] = u;
+                return true;
+            }
+        }
+        dist[u] = -1;
+        return false;
+    }
+    /** Find a maximum matching.
+     * @return the size of the matching.
+     */
+    int solve() {
+        int r = 0;
+        while (bfs())
+            for (int u = 0; u < n; u++)
+                if (match_left[u] == -1 && dfs(u))
+                    r++;
+        return r;
+    }
+    /** Find a minimum vertex cover using Koenig's theorem.
+     * Must be called after ``solve``.
+     * @return flags of left and right vertices in the cover.
+     */
+    pair<vector<char>, vector<char>> min_vertex_cover() const {
+        // alternating paths from free left vertices
+        vector<char> vis_left(n, 0), vis_right(m, 0);
+        vector<int> que;
+        que.reserve(n);
+        for (int u = 0; u < n; u++)
+            if (match_left[u] == -1)
+                vis_left[u] = 1, que.push_back(u);
+        for (size_t iq = 0; iq < que.size(); iq++) {
+            int u = que[iq];
+            for (int k = adj_ptr[u]; k < adj_ptr[u + 1]; k++) {
+                int v = adj[k];
+                if (vis_right[v])
+                    continue;
+                vis_right[v] = 1;
+                int w = match_right[v];
+                if (w != -1 && !vis_left[w])
+                    vis_left[w] = 1, que.push_back(w);
+            }
+        }
+        for (int u = 0; u < n; u++)
+            vis_left[u] = !vis_left[u];
+        return make_pair(vis_left, vis_right);
+    }
+};
+
 } // namespace block2
@@ -26,11 +26,22 @@
 #include <cmath>
 #include <cstring>
 #include <iostream>
+#include <random>
 #include <utility>
 #include <vector>
 
 using namespace std;
 
+// Compile simple vectorizable kernels for several instruction sets,
+// selected at runtime according to the host CPU (GCC on x86-64 Linux)
+#if defined(__GNUC__) && !defined(__clang__) && !defined(__INTEL_COMPILER) && \
+    defined(__x86_64__) && defined(__linux__)
+#define _SIMD_TARGET_CLONES                                                    \
+    __attribute__((target_clones("avx512f", "avx2", "default")))
+#else
+#define _SIMD_TARGET_CLONES
+#endif
+
 namespace block2 {
 
 extern "C" {
@@ -128,27 +139,89 @@ extern void dgels(const char *trans, const MKL_INT *m, const MKL_INT *n,
 #endif
 }
 
-enum struct DavidsonTypes : uint8_t {
+// External symmetric eigensolver for large blocks, with the semantics of
+// dsyev("V", "U", &n, a, &n, w, ...): a is n x n column-major (lda = n),
+// overwritten by the eigenvectors, and w gets the ascending eigenvalues
+typedef void (*dsyev_t)(MKL_INT n, double *a, double *w);
+
+// External thin SVD for large blocks, with the semantics of
+// dgesvd("S", "S", &m, &n, a, &m, s, u, &m, vt, &k, ...) where
+// k = min(m, n): a is m x n column-major, destroyed on return
+typedef void (*dgesvd_t)(MKL_INT m, MKL_INT n, double *a, double *s,
+                         double *u, double *vt);
+
+// Backends used by MatrixFunctions::eigs and MatrixFunctions::svd for
+// blocks not smaller than MatrixFunctions::lapack_offload_size(), for
+// example cuSOLVER syevd / gesvdj or MAGMA wrappers. They are called with
+// host pointers, may be called from several threads concurrently, and must
+// have finished writing all outputs when they return
+inline auto dsyev_backend_() -> dsyev_t & {
+    static dsyev_t backend = nullptr;
+    return backend;
+}
+
+inline auto dgesvd_backend_() -> dgesvd_t & {
+    static dgesvd_t backend = nullptr;
+    return backend;
+}
+
+enum struct DavidsonTypes : uint16_t {
     Normal = 0,
     GreaterThan = 1,
     LessThan = 2,
     CloseTo = 4,
+    Lanczos = 8,
     Harmonic = 16,
     HarmonicGreaterThan = 16 | 1,
     HarmonicLessThan = 16 | 2,
     HarmonicCloseTo = 16 | 4,
     DavidsonPrecond = 32,
-    NoPrecond = 64
+    NoPrecond = 64,
+    Block = 128,
+    Chebyshev = 256,
+    JacobiDavidson = 512,
+    Distributed = 1024
 };
 
 inline bool operator&(DavidsonTypes a, DavidsonTypes b) {
-    return ((uint8_t)a & (uint8_t)b) != 0;
+    return ((uint16_t)a & (uint16_t)b) != 0;
 }
 
 inline DavidsonTypes operator|(DavidsonTypes a, DavidsonTypes b) {
-    return DavidsonTypes((uint8_t)a | (uint8_t)b);
+    return DavidsonTypes((uint16_t)a | (uint16_t)b);
 }
 
+// Convergence history of Davidson solves (appended by each solve)
+struct DavidsonTelemetry {
+    // per iteration: squared residual norm and Ritz value of the current
+    // root, index of the current root, subspace size and matvec time
+    vector<double> residuals, eigvals, tmults;
+    vector<int> roots, subspaces;
+    // number of solves, subspace restarts (collapses to deflation_min_size)
+    // and recomputations of all sigma vectors (after a precision change)
+    int n_solves = 0, n_restarts = 0, n_recomputes = 0;
+    // at the end of the last solve: distance from the highest target root
+    // to the next Ritz value (0 if the subspace has no more vectors)
+    double gap = 0;
+    void clear() { *this = DavidsonTelemetry(); }
+    int n_iters() const { return (int)residuals.size(); }
+    double tmult() const {
+        double r = 0;
+        for (auto t : tmults)
+            r += t;
+        return r;
+    }
+    friend ostream &operator<<(ostream &os, const DavidsonTelemetry &t) {
+        os << " Nrst = " << t.n_restarts << " Gap = " << scientific
+           << setprecision(2) << t.gap << " Tmult = " << fixed
+           << setprecision(2) << t.tmult();
+        if (t.n_iters() != 0)
+            os << " Res = " << scientific << setprecision(2)
+               << t.residuals[0] << " -> " << t.residuals.back();
+        return os;
+    }
+};
+
 // Dense matrix operations
 struct MatrixFunctions {
     // a = b
@@ -182,6 +255,24 @@ struct MatrixFunctions {
                 daxpy(&a.n, &scale, b.data + i, &a.m, a.data + i * a.n, &inc);
         }
     }
+    // xs[0] += xs[1] + ... + xs[nx - 1] (each of n elements)
+    // The vectors are divided into chunks of chunk elements, distributed
+    // among threads, and each chunk is summed pairwise over the vectors
+    // while it is in cache. Must be called by all threads of a parallel region
+    static void chunked_reduce(const vector<double *> &xs, size_t n,
+                               size_t chunk) {
+        const size_t nx = xs.size(), nc = (n + chunk - 1) / chunk;
+        const double one = 1.0;
+        const MKL_INT inc = 1;
+#pragma omp for schedule(static)
+        for (int ic = 0; ic < (int)nc; ic++) {
+            const size_t st = (size_t)ic * chunk;
+            const MKL_INT len = (MKL_INT)min(chunk, n - st);
+            for (size_t d = 1; d < nx; d <<= 1)
+                for (size_t t = 0; t + d < nx; t += d << 1)
+                    daxpy(&len, &one, xs[t + d] + st, &inc, xs[t] + st, &inc);
+        }
+    }
     static double norm(const MatrixRef &a) {
         MKL_INT n = a.m * a.n, inc = 1;
         return dnrm2(&n, a.data, &inc);
@@ -268,6 +359,10 @@ struct MatrixFunctions {
         // if assertion failes here, check whether it is the case
         // where different bra and ket are used with the transpose rule
         // use no-transpose-rule to fix it
+        KernelCounters &kc = kernel_counters_();
+        Timer t;
+        if (kc.enabled)
+            t.get_time();
         if (!conja && !conjb) {
             assert(a.n >= b.m && c.m == a.m && c.n >= b.n);
             dgemm("n", "n", &b.n, &c.m, &b.m, &scale, b.data, &b.n, a.data,
@@ -285,20 +380,78 @@ struct MatrixFunctions {
             dgemm("t", "t", &b.m, &c.m, &b.n, &scale, b.data, &b.n, a.data,
                   &a.n, &cfactor, c.data, &c.n);
         }
+        if (kc.enabled)
+            kc.add(KernelTypes::GEMM, gemm_flop(c.m, c.n, conjb ? b.n : b.m),
+                   gemm_bytes(c.m, c.n, conjb ? b.n : b.m), t.get_time());
+    }
+    // nominal FLOP of c[m, n] += a[m, k] * b[k, n]
+    static uint64_t gemm_flop(MKL_INT m, MKL_INT n, MKL_INT k) {
+        return (uint64_t)2 * m * n * k;
+    }
+    // nominal memory traffic of c[m, n] += a[m, k] * b[k, n]
+    static uint64_t gemm_bytes(MKL_INT m, MKL_INT n, MKL_INT k) {
+        return sizeof(double) *
+               ((uint64_t)m * k + (uint64_t)k * n + (uint64_t)2 * m * n);
+    }
+    // Maximal number of elements in one column tile of the intermediate
+    // of rotate and three_rotate
+    static size_t &rotate_tile_size() {
+        static size_t tile_size = 1 << 16;
+        return tile_size;
+    }
+    // c += scale_x * x(.T) * (scale_a * a * b(.T))
+    // a has am rows and leading dimension lda, c has cm rows and leading
+    // dimension ldc
+    // The intermediate (a * b) is computed in tiles of its columns, and each
+    // tile is multiplied into c immediately, so that only one tile of the
+    // intermediate is stored
+    static void tiled_rotate(const double *a, MKL_INT am, MKL_INT lda,
+                             const MatrixRef &b, bool conjb, double scale_a,
+                             const MatrixRef &x, bool conjx, double scale_x,
+                             double *c, MKL_INT cm, MKL_INT ldc) {
+        const MKL_INT bn = conjb ? b.m : b.n, ak = conjb ? b.n : b.m;
+        assert(lda >= ak && (conjx ? x.m : x.n) >= am);
+        assert((conjx ? x.n : x.m) >= cm);
+        if (am == 0 || bn == 0 || cm == 0)
+            return;
+        const MKL_INT tn = (MKL_INT)min(
+            (size_t)bn, max(rotate_tile_size() / max(am, (MKL_INT)1),
+                            (size_t)1));
+        shared_ptr<VectorAllocator<double>> d_alloc =
+            make_shared<VectorAllocator<double>>();
+        MatrixRef work(nullptr, am, tn);
+        work.allocate(d_alloc);
+        KernelCounters &kc = kernel_counters_();
+        Timer t;
+        if (kc.enabled)
+            t.get_time();
+        const double zero = 0.0, one = 1.0;
+        for (MKL_INT j = 0; j < bn; j += tn) {
+            const MKL_INT wn = min(tn, bn - j);
+            // work = scale_a * a * b(.T)[:, j:j + wn]
+            dgemm(conjb ? "t" : "n", "n", &wn, &am, &ak, &scale_a,
+                  conjb ? &b(j, 0) : &b(0, j), &b.n, a, &lda, &zero,
+                  work.data, &wn);
+            // c[:, j:j + wn] += scale_x * x(.T) * work
+            dgemm("n", conjx ? "t" : "n", &wn, &cm, &am, &scale_x, work.data,
+                  &wn, x.data, &x.n, &one, c + j, &ldc);
+        }
+        if (kc.enabled)
+            kc.add(KernelTypes::GEMM,
+                   gemm_flop(am, bn, ak) + gemm_flop(cm, bn, am),
+                   gemm_bytes(am, bn, ak) + gemm_bytes(cm, bn, am),
+                   t.get_time());
+        work.deallocate(d_alloc);
     }
     // c = bra(.T) * a * ket(.T)
     // return nflop
     static size_t rotate(const MatrixRef &a, const MatrixRef &c,
                          const MatrixRef &bra, bool conj_bra,
                          const MatrixRef &ket, bool conj_ket, double scale) {
-        shared_ptr<VectorAllocator<double>> d_alloc =
-            make_shared<VectorAllocator<double>>();
-        MatrixRef work(nullptr, a.m, conj_ket ? ket.m : ket.n);
-        work.allocate(d_alloc);
-        multiply(a, false, ket, conj_ket, work, 1.0, 0.0);
-        multiply(bra, conj_bra, work, false, c, scale, 1.0);
-        work.deallocate(d_alloc);
-        return (size_t)ket.m * ket.n * work.m + (size_t)work.m * work.n * c.m;
+        tiled_rotate(a.data, a.m, a.n, ket, conj_ket, 1.0, bra, conj_bra, scale,
+                     c.data, c.m, c.n);
+        const MKL_INT wn = conj_ket ? ket.m : ket.n;
+        return (size_t)ket.m * ket.n * a.m + (size_t)a.m * wn * c.m;
     }
     // c(.T) = bra.T * a(.T) * ket
     // return nflop
@@ -326,55 +479,41 @@ struct MatrixFunctions {
                                const MatrixRef &da, bool dconja,
                                const MatrixRef &db, bool dconjb, bool dleft,
                                double scale, uint32_t stride) {
-        shared_ptr<VectorAllocator<double>> d_alloc =
-            make_shared<VectorAllocator<double>>();
         if (dleft) {
             dconja ^= conj_bra, dconjb ^= conj_bra;
             MKL_INT am = (dconja ? da.m : da.n) * (dconjb ? db.m : db.n);
             MKL_INT cm = (dconja ? da.n : da.m) * (dconjb ? db.n : db.m);
             uint32_t ast = conj_bra ? stride / bra.n : stride % bra.n;
             uint32_t cst = conj_bra ? stride % bra.n : stride / bra.n;
-            MatrixRef work(nullptr, am, conj_ket ? ket.m : ket.n);
-            work.allocate(d_alloc);
-            // work = a * ket
-            multiply(MatrixRef(&a(ast, 0), am, a.n), false, ket, conj_ket, work,
-                     1.0, 0.0);
+            const MKL_INT wn = conj_ket ? ket.m : ket.n;
             if (da.m == 1 && da.n == 1)
-                // c = (1 x db) * work
-                multiply(db, dconjb, work, false,
-                         MatrixRef(&c(cst, 0), cm, c.n), scale * *da.data, 1.0);
+                // c = (1 x db) * (a * ket)
+                tiled_rotate(&a(ast, 0), am, a.n, ket, conj_ket, 1.0, db,
+                             dconjb, scale * *da.data, &c(cst, 0), cm, c.n);
             else if (db.m == 1 && db.n == 1)
-                // c = (da x 1) * work
-                multiply(da, dconja, work, false,
-                         MatrixRef(&c(cst, 0), cm, c.n), scale * *db.data, 1.0);
+                // c = (da x 1) * (a * ket)
+                tiled_rotate(&a(ast, 0), am, a.n, ket, conj_ket, 1.0, da,
+                             dconja, scale * *db.data, &c(cst, 0), cm, c.n);
             else
                 assert(false);
-            work.deallocate(d_alloc);
-            return (size_t)ket.m * ket.n * work.m +
-                   (size_t)work.m * work.n * cm;
+            return (size_t)ket.m * ket.n * am + (size_t)am * wn * cm;
         } else {
             dconja ^= conj_ket, dconjb ^= conj_ket;
             MKL_INT kn = (dconja ? da.m : da.n) * (dconjb ? db.m : db.n);
             MKL_INT km = (dconja ? da.n : da.m) * (dconjb ? db.n : db.m);
             uint32_t ast = conj_ket ? stride % ket.n : stride / ket.n;
             uint32_t cst = conj_ket ? stride / ket.n : stride % ket.n;
-            MatrixRef work(nullptr, a.m, kn);
-            work.allocate(d_alloc);
             if (da.m == 1 && da.n == 1)
-                // work = a * (1 x db)
-                multiply(MatrixRef(&a(0, ast), a.m, a.n), false, db, dconjb,
-                         work, *da.data * scale, 0.0);
+                // c = bra * (a * (1 x db))
+                tiled_rotate(&a(0, ast), a.m, a.n, db, dconjb, *da.data * scale,
+                             bra, conj_bra, 1.0, &c(0, cst), c.m, c.n);
             else if (db.m == 1 && db.n == 1)
-                // work = a * (da x 1)
-                multiply(MatrixRef(&a(0, ast), a.m, a.n), false, da, dconja,
-                         work, *db.data * scale, 0.0);
+                // c = bra * (a * (da x 1))
+                tiled_rotate(&a(0, ast), a.m, a.n, da, dconja, *db.data * scale,
+                             bra, conj_bra, 1.0, &c(0, cst), c.m, c.n);
             else
                 assert(false);
-            // c = bra * work
-            multiply(bra, conj_bra, work, false,
-                     MatrixRef(&c(0, cst), c.m, c.n), 1.0, 1.0);
-            work.deallocate(d_alloc);
-            return (size_t)km * kn * work.m + (size_t)work.m * work.n * c.m;
+            return (size_t)km * kn * a.m + (size_t)a.m * kn * c.m;
         }
     }
     // dleft == true : c = a * ket
@@ -458,13 +597,43 @@ struct MatrixFunctions {
         }
     }
     // only diagonal elements so no conj parameters
+    // c[i * ldc + j] += scale * a[i] * b[j], with contiguous b
+    _SIMD_TARGET_CLONES static void
+    outer_product_kernel(MKL_INT m, MKL_INT n, double scale, const double *a,
+                         MKL_INT inca, const double *b, double *c,
+                         MKL_INT ldc) {
+        for (MKL_INT i = 0; i < m; i++) {
+            const double x = scale * a[i * inca];
+            double *__restrict__ cr = c + i * ldc;
+            for (MKL_INT j = 0; j < n; j++)
+                cr[j] += x * b[j];
+        }
+    }
+    // c[i * ldc + j] += scale * a[i * inca] * b[j * incb]
+    // outer product of two strided vectors (such as matrix diagonals)
+    // b is gathered once so that the inner loop is contiguous
+    static void outer_product(MKL_INT m, MKL_INT n, double scale,
+                              const double *a, MKL_INT inca, const double *b,
+                              MKL_INT incb, double *c, MKL_INT ldc) {
+        if (m == 0 || n == 0)
+            return;
+        if (incb == 1)
+            outer_product_kernel(m, n, scale, a, inca, b, c, ldc);
+        else {
+            shared_ptr<VectorAllocator<double>> d_alloc =
+                make_shared<VectorAllocator<double>>();
+            double *bb = d_alloc->allocate(n);
+            for (MKL_INT j = 0; j < n; j++)
+                bb[j] = b[j * incb];
+            outer_product_kernel(m, n, scale, a, inca, bb, c, ldc);
+            d_alloc->deallocate(bb, n);
+        }
+    }
     static void tensor_product_diagonal(const MatrixRef &a, const MatrixRef &b,
                                         const MatrixRef &c, double scale) {
         assert(a.m == a.n && b.m == b.n && c.m == a.n && c.n == b.n);
-        const double cfactor = 1.0;
-        const MKL_INT k = 1, lda = a.n + 1, ldb = b.n + 1;
-        dgemm("t", "n", &b.n, &a.n, &k, &scale, b.data, &ldb, a.data, &lda,
-              &cfactor, c.data, &c.n);
+        outer_product(a.n, b.n, scale, a.data, a.n + 1, b.data, b.n + 1, c.data,
+                      c.n);
     }
     // diagonal element of three-matrix tensor product
     static void
@@ -473,14 +642,13 @@ struct MatrixFunctions {
                                   bool dconja, const MatrixRef &db, bool dconjb,
                                   bool dleft, double scale, uint32_t stride) {
         assert(a.m == a.n && b.m == b.n && c.m == a.n && c.n == b.n);
-        const double cfactor = 1.0;
         const MKL_INT dstrm = (MKL_INT)stride / (dleft ? a.m : b.m);
         const MKL_INT dstrn = (MKL_INT)stride % (dleft ? a.m : b.m);
         if (dstrn != dstrm)
             return;
         assert(da.m == da.n && db.m == db.n);
         const MKL_INT ddstr = 0;
-        const MKL_INT k = 1, lda = a.n + 1, ldb = b.n + 1;
+        const MKL_INT lda = a.n + 1, ldb = b.n + 1;
         const MKL_INT ldda = da.n + 1, lddb = db.n + 1;
         if (da.m == 1 && da.n == 1) {
             scale *= *da.data;
@@ -491,13 +659,12 @@ struct MatrixFunctions {
             if (dn > 0) {
                 if (dleft)
                     // (1 x db) x b
-                    dgemm("t", "n", &b.n, &dn, &k, &scale, b.data, &ldb, bdata,
-                          &lddb, &cfactor, &c(max(dstrn, dstrm), (MKL_INT)0),
-                          &c.n);
+                    outer_product(dn, b.n, scale, bdata, lddb, b.data, ldb,
+                                  &c(max(dstrn, dstrm), (MKL_INT)0), c.n);
                 else
                     // a x (1 x db)
-                    dgemm("t", "n", &dn, &a.n, &k, &scale, bdata, &lddb, a.data,
-                          &lda, &cfactor, &c(0, max(dstrn, dstrm)), &c.n);
+                    outer_product(a.n, dn, scale, a.data, lda, bdata, lddb,
+                                  &c(0, max(dstrn, dstrm)), c.n);
             }
         } else if (db.m == 1 && db.n == 1) {
             scale *= *db.data;
@@ -508,13 +675,12 @@ struct MatrixFunctions {
             if (dn > 0) {
                 if (dleft)
                     // (da x 1) x b
-                    dgemm("t", "n", &b.n, &dn, &k, &scale, b.data, &ldb, adata,
-                          &ldda, &cfactor, &c(max(dstrn, dstrm), (MKL_INT)0),
-                          &c.n);
+                    outer_product(dn, b.n, scale, adata, ldda, b.data, ldb,
+                                  &c(max(dstrn, dstrm), (MKL_INT)0), c.n);
                 else
                     // a x (da x 1)
-                    dgemm("t", "n", &dn, &a.n, &k, &scale, adata, &ldda, a.data,
-                          &lda, &cfactor, &c(0, max(dstrn, dstrm)), &c.n);
+                    outer_product(a.n, dn, scale, a.data, lda, adata, ldda,
+                                  &c(0, max(dstrn, dstrm)), c.n);
             }
         } else
             assert(false);
@@ -639,19 +805,44 @@ struct MatrixFunctions {
             assert(false);
         }
     }
+    // Minimal block dimension for using dsyev_backend_() and
+    // dgesvd_backend_() when they are registered (0 means always host)
+    static MKL_INT &lapack_offload_size() {
+        static MKL_INT offload_size = 0;
+        return offload_size;
+    }
     // SVD; original matrix will be destroyed
     static void svd(const MatrixRef &a, const MatrixRef &l, const MatrixRef &s,
                     const MatrixRef &r) {
+        MKL_INT k = min(a.m, a.n), info = 0, lwork = 34 * max(a.m, a.n);
+        assert(a.m == l.m && a.n == r.n && l.n == k && r.m == k && s.n == k);
+        KernelCounters &kc = kernel_counters_();
+        Timer t;
+        if (kc.enabled)
+            t.get_time();
+        // Golub-Reinsch with thin U and V: 14 m n^2 + 8 n^3 (m >= n)
+        const uint64_t mx = max(a.m, a.n);
+        const uint64_t nflop =
+            (uint64_t)14 * mx * k * k + (uint64_t)8 * k * k * k;
+        const uint64_t nbytes =
+            sizeof(double) * ((uint64_t)a.m * a.n + (uint64_t)(a.m + a.n) * k);
+        if (dgesvd_backend_() != nullptr && lapack_offload_size() != 0 &&
+            k >= lapack_offload_size()) {
+            dgesvd_backend_()(a.n, a.m, a.data, s.data, r.data, l.data);
+            if (kc.enabled)
+                kc.add(KernelTypes::SVD, nflop, nbytes, t.get_time());
+            return;
+        }
         shared_ptr<VectorAllocator<double>> d_alloc =
             make_shared<VectorAllocator<double>>();
-        MKL_INT k = min(a.m, a.n), info = 0, lwork = 34 * max(a.m, a.n);
         // double work[lwork];
         double *work = d_alloc->allocate(lwork);
-        assert(a.m == l.m && a.n == r.n && l.n == k && r.m == k && s.n == k);
         dgesvd("S", "S", &a.n, &a.m, a.data, &a.n, s.data, r.data, &a.n, l.data,
                &k, work, &lwork, &info);
         assert(info == 0);
         d_alloc->deallocate(work, lwork);
+        if (kc.enabled)
+            kc.add(KernelTypes::SVD, nflop, nbytes, t.get_time());
     }
     // SVD for parallelism over sites; PRB 87, 155137 (2013)
     static void accurate_svd(const MatrixRef &a, const MatrixRef &l,
@@ -697,6 +888,116 @@ struct MatrixFunctions {
         }
         d_alloc->deallocate(aa.data, aa.size());
     }
+    // Gaussian random matrix with a fixed seed, for randomized range finders
+    static void random_gaussian(const MatrixRef &a, unsigned int seed) {
+        mt19937 gen(seed);
+        normal_distribution<double> dist(0.0, 1.0);
+        for (size_t i = 0; i < a.size(); i++)
+            a.data[i] = dist(gen);
+    }
+    // Orthonormal basis q (m x p) for the range of a (m x n) ~ a * a.T
+    // Halko, Martinsson & Tropp, SIAM Rev. 53, 217 (2011)
+    static void randomized_range(const MatrixRef &a, const MatrixRef &q,
+                                 int n_power_iter = 2) {
+        shared_ptr<VectorAllocator<double>> d_alloc =
+            make_shared<VectorAllocator<double>>();
+        const MKL_INT p = q.n;
+        assert(q.m == a.m && p <= min(a.m, a.n));
+        MatrixRef omega(nullptr, a.n, p), y(nullptr, a.m, p),
+            z(nullptr, a.n, p), rr(nullptr, p, p);
+        omega.allocate(d_alloc);
+        y.allocate(d_alloc);
+        z.allocate(d_alloc);
+        rr.allocate(d_alloc);
+        random_gaussian(omega, (unsigned int)(a.m * 31 + a.n * 7 + p));
+        multiply(a, false, omega, false, y, 1.0, 0.0);
+        for (int it = 0; it < n_power_iter; it++) {
+            qr(y, q, rr);
+            multiply(a, true, q, false, z, 1.0, 0.0);
+            qr(z, omega, rr);
+            multiply(a, false, omega, false, y, 1.0, 0.0);
+        }
+        qr(y, q, rr);
+        rr.deallocate(d_alloc);
+        z.deallocate(d_alloc);
+        y.deallocate(d_alloc);
+        omega.deallocate(d_alloc);
+    }
+    // Leading s.n singular triplets of a (m x n) by randomized SVD
+    // l: m x k, s: 1 x k, r: k x n; original matrix is not changed
+    // return squared norm of the discarded part of a
+    static double truncated_svd(const MatrixRef &a, const MatrixRef &l,
+                                const MatrixRef &s, const MatrixRef &r,
+                                int n_oversample = 10, int n_power_iter = 2) {
+        shared_ptr<VectorAllocator<double>> d_alloc =
+            make_shared<VectorAllocator<double>>();
+        const MKL_INT k = s.n, p = min(k + n_oversample, min(a.m, a.n));
+        assert(a.m == l.m && a.n == r.n && l.n == k && r.m == k && k <= p);
+        MatrixRef q(nullptr, a.m, p), b(nullptr, p, a.n), ql(nullptr, a.m, p);
+        MatrixRef bl(nullptr, p, p), bs(nullptr, 1, p), br(nullptr, p, a.n);
+        q.allocate(d_alloc);
+        b.allocate(d_alloc);
+        ql.allocate(d_alloc);
+        bl.allocate(d_alloc);
+        bs.allocate(d_alloc);
+        br.allocate(d_alloc);
+        randomized_range(a, q, n_power_iter);
+        // a ~ q * b = (q * bl) * bs * br
+        multiply(q, true, a, false, b, 1.0, 0.0);
+        svd(b, bl, bs, br);
+        multiply(q, false, bl, false, ql, 1.0, 0.0);
+        for (MKL_INT i = 0; i < a.m; i++)
+            memcpy(l.data + i * k, ql.data + i * p, sizeof(double) * k);
+        memcpy(s.data, bs.data, sizeof(double) * k);
+        memcpy(r.data, br.data, sizeof(double) * k * a.n);
+        double tail = dot(a, a);
+        for (MKL_INT i = 0; i < k; i++)
+            tail -= s.data[i] * s.data[i];
+        br.deallocate(d_alloc);
+        bs.deallocate(d_alloc);
+        bl.deallocate(d_alloc);
+        ql.deallocate(d_alloc);
+        b.deallocate(d_alloc);
+        q.deallocate(d_alloc);
+        return max(tail, 0.0);
+    }
+    // Largest w.n eigenvalues of a positive semi-definite matrix a (n x n)
+    // by randomized subspace iteration; v: k x n eigenvectors (as rows)
+    // original matrix is not changed
+    // return the trace of the discarded part of a
+    static double truncated_eigs(const MatrixRef &a, const MatrixRef &v,
+                                 const DiagonalMatrix &w,
+                                 int n_oversample = 10, int n_power_iter = 2) {
+        shared_ptr<VectorAllocator<double>> d_alloc =
+            make_shared<VectorAllocator<double>>();
+        const MKL_INT k = w.n, p = min(k + n_oversample, a.m);
+        assert(a.m == a.n && v.m == k && v.n == a.n && k <= p);
+        MatrixRef q(nullptr, a.m, p), aq(nullptr, a.m, p), b(nullptr, p, p);
+        DiagonalMatrix bw(nullptr, p);
+        q.allocate(d_alloc);
+        aq.allocate(d_alloc);
+        b.allocate(d_alloc);
+        bw.allocate(d_alloc);
+        randomized_range(a, q, n_power_iter);
+        // b = q.T * a * q
+        multiply(a, false, q, false, aq, 1.0, 0.0);
+        multiply(q, true, aq, false, b, 1.0, 0.0);
+        eigs(b, bw);
+        // eigenvalues are in ascending order
+        multiply(MatrixRef(b.data + (p - k) * p, k, p), false, q, true, v, 1.0,
+                 0.0);
+        memcpy(w.data, bw.data + (p - k), sizeof(double) * k);
+        double tail = 0;
+        for (MKL_INT i = 0; i < a.m; i++)
+            tail += a(i, i);
+        for (MKL_INT i = 0; i < k; i++)
+            tail -= w.data[i];
+        bw.deallocate(d_alloc);
+        b.deallocate(d_alloc);
+        aq.deallocate(d_alloc);
+        q.deallocate(d_alloc);
+        return max(tail, 0.0);
+    }
     // LQ factorization
     static void lq(const MatrixRef &a, const MatrixRef &l, const MatrixRef &q) {
         shared_ptr<VectorAllocator<double>> d_alloc =
@@ -784,15 +1085,32 @@ struct MatrixFunctions {
     }
     // eigenvectors are row vectors
     static void eigs(const MatrixRef &a, const DiagonalMatrix &w) {
+        assert(a.m == a.n && w.n == a.n);
+        KernelCounters &kc = kernel_counters_();
+        Timer t;
+        if (kc.enabled)
+            t.get_time();
+        // tridiagonalization and QR with eigenvectors: about 9 n^3
+        const uint64_t nflop = (uint64_t)9 * a.n * a.n * a.n;
+        const uint64_t nbytes =
+            sizeof(double) * ((uint64_t)2 * a.n * a.n + a.n);
+        if (dsyev_backend_() != nullptr && lapack_offload_size() != 0 &&
+            a.n >= lapack_offload_size()) {
+            dsyev_backend_()(a.n, a.data, w.data);
+            if (kc.enabled)
+                kc.add(KernelTypes::Eigs, nflop, nbytes, t.get_time());
+            return;
+        }
         shared_ptr<VectorAllocator<double>> d_alloc =
             make_shared<VectorAllocator<double>>();
-        assert(a.m == a.n && w.n == a.n);
         MKL_INT lwork = 34 * a.n, info;
         // double work[lwork];
         double *work = d_alloc->allocate(lwork);
         dsyev("V", "U", &a.n, a.data, &a.n, w.data, work, &lwork, &info);
         assert(info == 0);
         d_alloc->deallocate(work, lwork);
+        if (kc.enabled)
+            kc.add(KernelTypes::Eigs, nflop, nbytes, t.get_time());
     }
     // z = r / aa
     static void cg_precondition(const MatrixRef &z, const MatrixRef &r,
@@ -831,10 +1149,231 @@ struct MatrixFunctions {
                 q.data[i] /= ld - aa.data[i];
         t.deallocate();
     }
+    // Number of GCROT steps for the Jacobi-Davidson correction equation
+    static int &jacobi_davidson_inner_steps() {
+        static int n_steps = 10;
+        return n_steps;
+    }
+    // If not nullptr, davidson appends its convergence history here
+    static shared_ptr<DavidsonTelemetry> &davidson_telemetry() {
+        static shared_ptr<DavidsonTelemetry> telemetry = nullptr;
+        return telemetry;
+    }
+    // Jacobi-Davidson correction is used for the lowest roots only when
+    // the squared residual norm is below this value; for interior roots
+    // (CloseTo), the shift replaces the Ritz value above this value
+    static double &jacobi_davidson_switch_thrd() {
+        static double thrd = 1E-2;
+        return thrd;
+    }
+    // Right-preconditioned operator v -> (1 - U U^T) (op - ld) K^-1 v of
+    // the Jacobi-Davidson correction equation, where the projected
+    // preconditioner K^-1 = (1 - Y (U^T Y)^-1 U^T) diag(aa - ld)^-1 maps
+    // into the orthogonal complement of U, with Y = diag(aa - ld)^-1 U
+    // Sleijpen & Van der Vorst, SIAM J. Matrix Anal. Appl. 17, 401 (1996)
+    // us: orthonormal columns of U; ys: columns of Y; mi: (U^T Y)^-1
+    // aa: diag elements of a (no diagonal part in K if empty)
+    // The preconditioner is only applied on the root
+    template <typename MatMul, typename PComm> struct JacobiDavidsonOperator {
+        MatMul &op;
+        const DiagonalMatrix &aa;
+        const vector<MatrixRef> &us, &ys, &ors;
+        const vector<double> &or_normsqs;
+        MatrixRef mi, z;
+        double ld;
+        const PComm &pcomm;
+        JacobiDavidsonOperator(MatMul &op, const DiagonalMatrix &aa,
+                               const vector<MatrixRef> &us,
+                               const vector<MatrixRef> &ys,
+                               const vector<MatrixRef> &ors,
+                               const vector<double> &or_normsqs,
+                               const MatrixRef &mi, const MatrixRef &z,
+                               double ld, const PComm &pcomm)
+            : op(op), aa(aa), us(us), ys(ys), ors(ors), or_normsqs(or_normsqs),
+              mi(mi), z(z), ld(ld), pcomm(pcomm) {}
+        void project_ors(const MatrixRef &x) const {
+            for (size_t j = 0; j < ors.size(); j++)
+                if (or_normsqs[j] > 1E-14)
+                    iadd(x, ors[j], -dot(ors[j], x) / or_normsqs[j]);
+        }
+        // x = diag(aa - ld)^-1 x
+        void diag_precondition(const MatrixRef &x) const {
+            for (MKL_INT i = 0; i < aa.n; i++)
+                if (abs(aa.data[i] - ld) > 1E-12)
+                    x.data[i] /= aa.data[i] - ld;
+        }
+        // x = K^-1 x
+        void precondition(const MatrixRef &x) const {
+            const int nu = (int)us.size();
+            diag_precondition(x);
+            vector<double> ux(nu);
+            for (int j = 0; j < nu; j++)
+                ux[j] = dot(us[j], x);
+            for (int i = 0; i < nu; i++) {
+                double c = 0;
+                for (int j = 0; j < nu; j++)
+                    c += mi(i, j) * ux[j];
+                iadd(x, ys[i], -c);
+            }
+            project_ors(x);
+        }
+        void operator()(const MatrixRef &b, const MatrixRef &c) {
+            if (pcomm == nullptr || pcomm->root == pcomm->rank) {
+                copy(z, b);
+                precondition(z);
+            }
+            if (pcomm != nullptr)
+                pcomm->broadcast(z.data, z.size(), pcomm->root);
+            op(z, c);
+            if (pcomm == nullptr || pcomm->root == pcomm->rank) {
+                for (size_t j = 0; j < us.size(); j++)
+                    iadd(c, us[j], -dot(us[j], c));
+                iadd(c, z, -ld);
+                project_ors(c);
+            }
+        }
+    };
+    // Jacobi-Davidson correction: q = approximate solution of
+    // (1 - U U^T) (op - ld) (1 - U U^T) q = -r, with q orthogonal to U
+    // us: the converged Ritz vectors followed by the current one
+    // r: residual of the current Ritz vector; ld: target (Ritz) value
+    // aa: diag elements of a (for precondition)
+    // The equation is solved by a few right-preconditioned GCROT steps,
+    // reducing the residual norm by 10x at most. us, r, and aa are only
+    // used on the root. Returns the number of matvecs
+    template <typename MatMul, typename PComm>
+    static int jacobi_davidson_correction(
+        MatMul &op, const DiagonalMatrix &aa, const MatrixRef &q,
+        const vector<MatrixRef> &us, const MatrixRef &r, double ld,
+        const vector<MatrixRef> &ors, const vector<double> &or_normsqs,
+        const PComm &pcomm) {
+        const bool is_root = pcomm == nullptr || pcomm->root == pcomm->rank;
+        const int nu = (int)us.size();
+        const int n_steps = max(jacobi_davidson_inner_steps(), 2);
+        if (pcomm != nullptr)
+            pcomm->broadcast(&ld, 1, pcomm->root);
+        vector<MatrixRef> ys(is_root ? nu : 0,
+                             MatrixRef(nullptr, q.m, q.n));
+        MatrixRef mi(nullptr, nu, nu), z(nullptr, q.m, q.n);
+        z.allocate();
+        if (is_root) {
+            mi.allocate();
+            for (int i = 0; i < nu; i++) {
+                ys[i].allocate();
+                copy(ys[i], us[i]);
+            }
+        }
+        JacobiDavidsonOperator<MatMul, PComm> jop(
+            op, aa, us, ys, ors, or_normsqs, mi, z, ld, pcomm);
+        if (is_root) {
+            for (int i = 0; i < nu; i++)
+                jop.diag_precondition(ys[i]);
+            for (int i = 0; i < nu; i++)
+                for (int j = 0; j < nu; j++)
+                    mi(i, j) = dot(us[i], ys[j]);
+            inverse(mi);
+            iscale(r, -1);
+        }
+        double inner_thrd = is_root ? 1E-2 * dot(r, r) : 0.0;
+        if (pcomm != nullptr)
+            pcomm->broadcast(&inner_thrd, 1, pcomm->root);
+        q.clear();
+        int nmult = 0, niter = 0;
+        gcrotmk(jop, DiagonalMatrix(nullptr, 0), q, r, nmult, niter,
+                n_steps - 1, 1, 0.0, false, pcomm, inner_thrd, 5000,
+                n_steps + 1);
+        if (is_root) {
+            jop.precondition(q);
+            for (int i = nu - 1; i >= 0; i--)
+                ys[i].deallocate();
+            mi.deallocate();
+        }
+        z.deallocate();
+        return nmult;
+    }
+    // Let the operator choose the precision of the next matvecs with
+    // the current Davidson residual, if it has a precision_hint method.
+    // Returns true if previous sigma vectors should be recomputed
+    template <typename MatMul>
+    static auto davidson_precision_hint(MatMul &op, double qq,
+                                        double conv_thrd, int)
+        -> decltype(op.precision_hint(qq, conv_thrd)) {
+        return op.precision_hint(qq, conv_thrd);
+    }
+    template <typename MatMul>
+    static bool davidson_precision_hint(MatMul &op, double qq,
+                                        double conv_thrd, long) {
+        return false;
+    }
+    // sigmas[i:j] = op * bs[i:j]
+    // The vectors are given to the operator as one panel,
+    // if it has a multiply_panel method
+    template <typename MatMul>
+    static auto davidson_multiply(MatMul &op, const vector<MatrixRef> &bs,
+                                  const vector<MatrixRef> &sigmas, int i,
+                                  int j, int)
+        -> decltype(op.multiply_panel(bs, sigmas)) {
+        for (int k = i; k < j; k++)
+            sigmas[k].clear();
+        return op.multiply_panel(
+            vector<MatrixRef>(bs.begin() + i, bs.begin() + j),
+            vector<MatrixRef>(sigmas.begin() + i, sigmas.begin() + j));
+    }
+    template <typename MatMul>
+    static void davidson_multiply(MatMul &op, const vector<MatrixRef> &bs,
+                                  const vector<MatrixRef> &sigmas, int i,
+                                  int j, long) {
+        for (int k = i; k < j; k++) {
+            sigmas[k].clear();
+            op(bs[k], sigmas[k]);
+        }
+    }
+    // Order of the m = ld.n Ritz values in ld, as targeted by davidson_type
+    static void davidson_sort_roots(vector<int> &eigval_idxs,
+                                    const DiagonalMatrix &ld, double shift,
+                                    DavidsonTypes davidson_type) {
+        const int m = ld.n;
+        for (int i = 0; i < m; i++)
+            eigval_idxs[i] = i;
+        if (davidson_type & DavidsonTypes::CloseTo)
+            sort(eigval_idxs.begin(), eigval_idxs.begin() + m,
+                 [&ld, shift](int i, int j) {
+                     return abs(ld.data[i] - shift) < abs(ld.data[j] - shift);
+                 });
+        else if (davidson_type & DavidsonTypes::LessThan)
+            sort(eigval_idxs.begin(), eigval_idxs.begin() + m,
+                 [&ld, shift](int i, int j) {
+                     if ((shift >= ld.data[i]) != (shift >= ld.data[j]))
+                         return shift >= ld.data[i];
+                     else if (shift >= ld.data[i])
+                         return shift - ld.data[i] < shift - ld.data[j];
+                     else
+                         return ld.data[i] - shift > ld.data[j] - shift;
+                 });
+        else if (davidson_type & DavidsonTypes::GreaterThan)
+            sort(eigval_idxs.begin(), eigval_idxs.begin() + m,
+                 [&ld, shift](int i, int j) {
+                     if ((shift > ld.data[i]) != (shift > ld.data[j]))
+                         return shift > ld.data[j];
+                     else if (shift > ld.data[i])
+                         return shift - ld.data[i] > shift - ld.data[j];
+                     else
+                         return ld.data[i] - shift < ld.data[j] - shift;
+                 });
+    }
     // Davidson algorithm
     // aa: diag elements of a (for precondition)
     // bs: input/output vector
     // ors: orthogonal states to be projected out
+    // rvs: recycled subspace vectors; on input, added to the initial
+    // subspace (zero or linearly dependent vectors are dropped); on output,
+    // the next Ritz vectors after the k roots (zero if not converged)
+    // With DavidsonTypes::Block, one correction vector is added for each
+    // unconverged root in every iteration, and the new vectors are
+    // multiplied by the operator together
+    // With DavidsonTypes::JacobiDavidson, the correction of the lowest
+    // unconverged root is refined by solving the Jacobi-Davidson correction
+    // equation, and ndav also counts the matvecs in the inner solver
     template <typename MatMul, typename PComm>
     static vector<double>
     davidson(MatMul &op, const DiagonalMatrix &aa, vector<MatrixRef> &vs,
@@ -843,7 +1382,8 @@ struct MatrixFunctions {
              double conv_thrd = 5E-6, int max_iter = 5000,
              int soft_max_iter = -1, int deflation_min_size = 2,
              int deflation_max_size = 50,
-             const vector<MatrixRef> &ors = vector<MatrixRef>()) {
+             const vector<MatrixRef> &ors = vector<MatrixRef>(),
+             const vector<MatrixRef> &rvs = vector<MatrixRef>()) {
         assert(!(davidson_type & DavidsonTypes::Harmonic));
         shared_ptr<VectorAllocator<double>> d_alloc =
             make_shared<VectorAllocator<double>>();
@@ -890,13 +1430,49 @@ struct MatrixFunctions {
             }
             iscale(bs[i], 1.0 / sqrt(normsq));
         }
+        int mr = k, nr = (int)rvs.size();
+        for (int i = 0; i < nr && mr < deflation_max_size - 1; i++) {
+            copy(bs[mr], rvs[i]);
+            for (int j = 0; j < nor; j++)
+                if (or_normsqs[j] > 1E-14)
+                    iadd(bs[mr], ors[j], -dot(ors[j], bs[mr]) / or_normsqs[j]);
+            for (int j = 0; j < mr; j++)
+                iadd(bs[mr], bs[j], -dot(bs[j], bs[mr]));
+            double normsq = dot(bs[mr], bs[mr]);
+            if (normsq < 1E-8)
+                continue;
+            iscale(bs[mr], 1.0 / sqrt(normsq));
+            mr++;
+        }
         vector<double> eigvals(k);
         vector<int> eigval_idxs(deflation_max_size);
         MatrixRef q(nullptr, bs[0].m, bs[0].n);
-        if (pcomm == nullptr || pcomm->root == pcomm->rank)
+        const bool block = davidson_type & DavidsonTypes::Block;
+        const bool jacobi = davidson_type & DavidsonTypes::JacobiDavidson;
+        // correction vectors of other unconverged roots (block mode)
+        vector<MatrixRef> qs(block ? k - 1 : 0,
+                             MatrixRef(nullptr, bs[0].m, bs[0].n));
+        // Ritz vectors and residual for the correction equation
+        vector<MatrixRef> jus(jacobi ? k : 0,
+                              MatrixRef(nullptr, bs[0].m, bs[0].n));
+        MatrixRef jr(nullptr, bs[0].m, bs[0].n);
+        if (pcomm == nullptr || pcomm->root == pcomm->rank || jacobi)
             q.allocate();
-        int ck = 0, msig = 0, m = k, xiter = 0;
-        double qq;
+        if (pcomm == nullptr || pcomm->root == pcomm->rank) {
+            if (jacobi) {
+                jr.allocate();
+                for (int i = 0; i < k; i++)
+                    jus[i].allocate();
+            }
+            for (int i = 0; i < (int)qs.size(); i++)
+                qs[i].allocate();
+        }
+        int ck = 0, msig = 0, m = mr, xiter = 0, nq = 1, njd = 0;
+        double qq, jld = 0, xeig = 0;
+        const shared_ptr<DavidsonTelemetry> tel = davidson_telemetry();
+        Timer tx;
+        if (tel != nullptr)
+            tel->n_solves++;
         if (iprint)
             cout << endl;
         while (xiter < max_iter &&
@@ -905,10 +1481,12 @@ struct MatrixFunctions {
             if (pcomm != nullptr && xiter != 1)
                 pcomm->broadcast(pbs.data + bs[0].size() * msig,
                                  bs[0].size() * (m - msig), pcomm->root);
-            for (int i = msig; i < m; i++, msig++) {
-                sigmas[i].clear();
-                op(bs[i], sigmas[i]);
-            }
+            if (tel != nullptr)
+                tx.get_time();
+            davidson_multiply(op, bs, sigmas, msig, m, 0);
+            if (tel != nullptr)
+                tel->tmults.push_back(tx.get_time());
+            msig = m;
             if (pcomm == nullptr || pcomm->root == pcomm->rank) {
                 DiagonalMatrix ld(nullptr, m);
                 MatrixRef alpha(nullptr, m, m);
@@ -962,34 +1540,7 @@ struct MatrixFunctions {
                 for (int i = m - 1; i >= 0; i--)
                     tmp[i].deallocate();
                 alpha.deallocate();
-                for (int i = 0; i < m; i++)
-                    eigval_idxs[i] = i;
-                if (davidson_type & DavidsonTypes::CloseTo)
-                    sort(eigval_idxs.begin(), eigval_idxs.begin() + m,
-                         [&ld, shift](int i, int j) {
-                             return abs(ld.data[i] - shift) <
-                                    abs(ld.data[j] - shift);
-                         });
-                else if (davidson_type & DavidsonTypes::LessThan)
-                    sort(eigval_idxs.begin(), eigval_idxs.begin() + m,
-                         [&ld, shift](int i, int j) {
-                             if ((shift >= ld.data[i]) != (shift >= ld.data[j]))
-                                 return shift >= ld.data[i];
-                             else if (shift >= ld.data[i])
-                                 return shift - ld.data[i] < shift - ld.data[j];
-                             else
-                                 return ld.data[i] - shift > ld.data[j] - shift;
-                         });
-                else if (davidson_type & DavidsonTypes::GreaterThan)
-                    sort(eigval_idxs.begin(), eigval_idxs.begin() + m,
-                         [&ld, shift](int i, int j) {
-                             if ((shift > ld.data[i]) != (shift > ld.data[j]))
-                                 return shift > ld.data[j];
-                             else if (shift > ld.data[i])
-                                 return shift - ld.data[i] > shift - ld.data[j];
-                             else
-                                 return ld.data[i] - shift < ld.data[j] - shift;
-                         });
+                davidson_sort_roots(eigval_idxs, ld, shift, davidson_type);
                 for (int i = 0; i < ck; i++) {
                     int ii = eigval_idxs[i];
                     copy(q, sigmas[ii]);
@@ -1006,15 +1557,48 @@ struct MatrixFunctions {
                     if (or_normsqs[j] > 1E-14)
                         iadd(q, ors[j], -dot(ors[j], q) / or_normsqs[j]);
                 qq = dot(q, q);
+                xeig = ld.data[ick];
+                if (tel != nullptr)
+                    tel->gap = k < m ? abs(ld.data[eigval_idxs[k]] -
+                                           ld.data[eigval_idxs[k - 1]])
+                                     : 0;
                 if (iprint)
                     cout << setw(6) << xiter << setw(6) << m << setw(6) << ck
                          << fixed << setw(15) << setprecision(8) << ld.data[ick]
                          << scientific << setw(13) << setprecision(2) << qq
                          << endl;
+                if (jacobi) {
+                    copy(jr, q);
+                    for (int i = 0; i <= ck; i++)
+                        copy(jus[i], bs[eigval_idxs[i]]);
+                    // far from convergence, the shift is a better target
+                    // than the Ritz value for interior roots
+                    jld = (davidson_type & DavidsonTypes::CloseTo) &&
+                                  qq >= jacobi_davidson_switch_thrd()
+                              ? shift
+                              : ld.data[ick];
+                }
                 if (davidson_type & DavidsonTypes::DavidsonPrecond)
                     davidson_precondition(q, ld.data[ick], aa);
                 else if (!(davidson_type & DavidsonTypes::NoPrecond))
                     olsen_precondition(q, bs[ick], ld.data[ick], aa);
+                nq = 1;
+                for (int i = ck + 1; i < k && block; i++) {
+                    int ii = eigval_idxs[i];
+                    const MatrixRef &xq = qs[nq - 1];
+                    copy(xq, sigmas[ii]);
+                    iadd(xq, bs[ii], -ld(ii, ii));
+                    for (int j = 0; j < nor; j++)
+                        if (or_normsqs[j] > 1E-14)
+                            iadd(xq, ors[j], -dot(ors[j], xq) / or_normsqs[j]);
+                    if (dot(xq, xq) < conv_thrd)
+                        continue;
+                    if (davidson_type & DavidsonTypes::DavidsonPrecond)
+                        davidson_precondition(xq, ld.data[ii], aa);
+                    else if (!(davidson_type & DavidsonTypes::NoPrecond))
+                        olsen_precondition(xq, bs[ii], ld.data[ii], aa);
+                    nq++;
+                }
                 eigvals.resize(ck + 1);
                 if (ck + 1 != 0)
                     for (int i = 0; i <= ck; i++)
@@ -1024,15 +1608,39 @@ struct MatrixFunctions {
             if (pcomm != nullptr) {
                 pcomm->broadcast(&qq, 1, pcomm->root);
                 pcomm->broadcast(&ck, 1, pcomm->root);
+                if (block)
+                    pcomm->broadcast(&nq, 1, pcomm->root);
+            }
+            if (tel != nullptr) {
+                tel->residuals.push_back(qq), tel->eigvals.push_back(xeig);
+                tel->roots.push_back(ck), tel->subspaces.push_back(m);
+            }
+            if (davidson_precision_hint(op, qq, conv_thrd, 0)) {
+                // recompute all sigma vectors with the new precision
+                msig = 0;
+                if (tel != nullptr)
+                    tel->n_recomputes++;
+                continue;
             }
             if (qq < conv_thrd) {
                 ck++;
                 if (ck == k)
                     break;
             } else {
+                if (jacobi && ((davidson_type & DavidsonTypes::CloseTo) ||
+                               qq < jacobi_davidson_switch_thrd()))
+                    njd += jacobi_davidson_correction(
+                        op,
+                        (davidson_type & DavidsonTypes::NoPrecond)
+                            ? DiagonalMatrix(nullptr, 0)
+                            : aa,
+                        q, vector<MatrixRef>(jus.begin(), jus.begin() + ck + 1),
+                        jr, jld, ors, or_normsqs, pcomm);
                 bool do_deflation = false;
-                if (m >= deflation_max_size) {
+                if (m + nq > deflation_max_size) {
                     m = msig = deflation_min_size;
+                    if (tel != nullptr)
+                        tel->n_restarts++;
                     do_deflation =
                         (davidson_type & DavidsonTypes::LessThan) ||
                         (davidson_type & DavidsonTypes::GreaterThan) ||
@@ -1064,15 +1672,42 @@ struct MatrixFunctions {
                         for (int i = m - 1; i >= 0; i--)
                             tmp[i].deallocate();
                     }
-                    for (int j = 0; j < m; j++)
-                        iadd(q, bs[j], -dot(bs[j], q));
-                    for (int j = 0; j < nor; j++)
-                        if (or_normsqs[j] > 1E-14)
-                            iadd(q, ors[j], -dot(ors[j], q) / or_normsqs[j]);
+                    // the Jacobi-Davidson correction can be close to the
+                    // subspace, so it is orthogonalized twice
+                    for (int it = 0; it < (jacobi ? 2 : 1); it++) {
+                        for (int j = 0; j < m; j++)
+                            iadd(q, bs[j], -dot(bs[j], q));
+                        for (int j = 0; j < nor; j++)
+                            if (or_normsqs[j] > 1E-14)
+                                iadd(q, ors[j],
+                                     -dot(ors[j], q) / or_normsqs[j]);
+                    }
                     iscale(q, 1.0 / sqrt(dot(q, q)));
                     copy(bs[m], q);
+                    int mq = 1;
+                    for (int iq = 1; iq < nq && m + mq < deflation_max_size;
+                         iq++) {
+                        const MatrixRef &xq = qs[iq - 1];
+                        iscale(xq, 1.0 / sqrt(dot(xq, xq)));
+                        for (int j = 0; j < m + mq; j++)
+                            iadd(xq, bs[j], -dot(bs[j], xq));
+                        for (int j = 0; j < nor; j++)
+                            if (or_normsqs[j] > 1E-14)
+                                iadd(xq, ors[j],
+                                     -dot(ors[j], xq) / or_normsqs[j]);
+                        // skip linearly dependent corrections
+                        double normsq = dot(xq, xq);
+                        if (normsq < 1E-8)
+                            continue;
+                        iscale(xq, 1.0 / sqrt(normsq));
+                        copy(bs[m + mq], xq);
+                        mq++;
+                    }
+                    nq = mq;
                 }
-                m++;
+                if (pcomm != nullptr && block)
+                    pcomm->broadcast(&nq, 1, pcomm->root);
+                m += nq;
             }
             if (xiter == soft_max_iter)
                 break;
@@ -1083,18 +1718,723 @@ struct MatrixFunctions {
             cout << "Error : only " << ck << " converged!" << endl;
             assert(false);
         }
-        if (pcomm == nullptr || pcomm->root == pcomm->rank)
+        if (pcomm == nullptr || pcomm->root == pcomm->rank) {
             for (int i = 0; i < k; i++)
                 copy(vs[i], bs[eigval_idxs[i]]);
+            for (int i = 0; i < nr; i++)
+                if (ck == k && k + i < m)
+                    copy(rvs[i], bs[eigval_idxs[k + i]]);
+                else
+                    rvs[i].clear();
+        }
         if (pcomm != nullptr) {
             pcomm->broadcast(eigvals.data(), eigvals.size(), pcomm->root);
             for (int j = 0; j < k; j++)
                 pcomm->broadcast(vs[j].data, vs[j].size(), pcomm->root);
+            for (int j = 0; j < nr; j++)
+                pcomm->broadcast(rvs[j].data, rvs[j].size(), pcomm->root);
         }
-        if (pcomm == nullptr || pcomm->root == pcomm->rank)
+        if (pcomm == nullptr || pcomm->root == pcomm->rank) {
+            for (int i = (int)qs.size() - 1; i >= 0; i--)
+                qs[i].deallocate();
+            if (jacobi) {
+                for (int i = k - 1; i >= 0; i--)
+                    jus[i].deallocate();
+                jr.deallocate();
+            }
+        }
+        if (pcomm == nullptr || pcomm->root == pcomm->rank || jacobi)
             q.deallocate();
         d_alloc->deallocate(pss.data, deflation_max_size * vs[0].size());
         d_alloc->deallocate(pbs.data, deflation_max_size * vs[0].size());
+        ndav = xiter + njd;
+        return eigvals;
+    }
+    // Olsen precondition for vectors distributed over procs
+    template <typename PComm>
+    static void distributed_olsen_precondition(const MatrixRef &q,
+                                               const MatrixRef &c, double ld,
+                                               const DiagonalMatrix &aa,
+                                               const PComm &pcomm) {
+        assert(aa.size() == c.size());
+        MatrixRef t(nullptr, c.m, c.n);
+        t.allocate();
+        copy(t, c);
+        for (MKL_INT i = 0; i < aa.n; i++)
+            if (abs(ld - aa.data[i]) > 1E-12)
+                t.data[i] /= ld - aa.data[i];
+        double tqct[2] = {dot(t, q), dot(c, t)};
+        pcomm->allreduce_sum(tqct, 2);
+        iadd(q, c, -tqct[0] / tqct[1]);
+        for (MKL_INT i = 0; i < aa.n; i++)
+            if (abs(ld - aa.data[i]) > 1E-12)
+                q.data[i] /= ld - aa.data[i];
+        t.deallocate();
+    }
+    // Davidson algorithm with vectors distributed over procs
+    // counts: number of vector elements owned by each proc
+    // op(b, c): c += (contribution of this proc to a) x b, for full
+    // vectors b and c, without reduction over procs
+    // Each proc only stores its part of the subspace and sigma vectors.
+    // The new subspace vector is gathered before each matvec, and the
+    // result is summed and scattered to the owners after it
+    // aa, vs and ors are full vectors; only vs is changed
+    template <typename MatMul, typename PComm>
+    static vector<double> distributed_davidson(
+        MatMul &op, const DiagonalMatrix &aa, vector<MatrixRef> &vs,
+        const vector<size_t> &counts, double shift,
+        DavidsonTypes davidson_type, int &ndav, bool iprint,
+        const PComm &pcomm, double conv_thrd = 5E-6, int max_iter = 5000,
+        int soft_max_iter = -1, int deflation_min_size = 2,
+        int deflation_max_size = 50,
+        const vector<MatrixRef> &ors = vector<MatrixRef>()) {
+        assert(!(davidson_type & DavidsonTypes::Harmonic));
+        assert(!(davidson_type & DavidsonTypes::Block));
+        assert(!(davidson_type & DavidsonTypes::JacobiDavidson));
+        assert((int)counts.size() == pcomm->size);
+        shared_ptr<VectorAllocator<double>> d_alloc =
+            make_shared<VectorAllocator<double>>();
+        size_t off = 0;
+        for (int i = 0; i < pcomm->rank; i++)
+            off += counts[i];
+        const MKL_INT nl = (MKL_INT)counts[pcomm->rank];
+        int k = (int)vs.size(), nor = (int)ors.size();
+        if (deflation_min_size < k)
+            deflation_min_size = k;
+        if (deflation_max_size < k + k / 2)
+            deflation_max_size = k + k / 2;
+        double *pbs = d_alloc->allocate(deflation_max_size * nl);
+        double *pss = d_alloc->allocate(deflation_max_size * nl);
+        double *pors = d_alloc->allocate(nor * nl);
+        vector<MatrixRef> bs(deflation_max_size, MatrixRef(nullptr, nl, 1));
+        vector<MatrixRef> sigmas(deflation_max_size, MatrixRef(nullptr, nl, 1));
+        vector<MatrixRef> lors(nor, MatrixRef(nullptr, nl, 1));
+        for (int i = 0; i < deflation_max_size; i++) {
+            bs[i].data = pbs + (size_t)nl * i;
+            sigmas[i].data = pss + (size_t)nl * i;
+        }
+        for (int i = 0; i < nor; i++) {
+            lors[i].data = pors + (size_t)nl * i;
+            copy(lors[i], MatrixRef(ors[i].data + off, nl, 1));
+        }
+        DiagonalMatrix laa(aa.size() == 0 ? nullptr : aa.data + off,
+                           aa.size() == 0 ? 0 : nl);
+        vector<double> xdots(max(deflation_max_size, nor));
+        auto pnormsq = [&pcomm](const MatrixRef &x) {
+            double r = dot(x, x);
+            pcomm->allreduce_sum(&r, 1);
+            return r;
+        };
+        // x -= sum_i ys[i] (ys[i] . x) / normsqs[i] (classical Gram-Schmidt)
+        auto project = [&pcomm, &xdots](const MatrixRef &x,
+                                        const vector<MatrixRef> &ys, int n,
+                                        const double *normsqs) {
+            for (int i = 0; i < n; i++)
+                xdots[i] = dot(ys[i], x);
+            pcomm->allreduce_sum(xdots.data(), n);
+            for (int i = 0; i < n; i++)
+                if (normsqs == nullptr)
+                    iadd(x, ys[i], -xdots[i]);
+                else if (normsqs[i] > 1E-14)
+                    iadd(x, ys[i], -xdots[i] / normsqs[i]);
+        };
+        vector<double> or_normsqs(nor);
+        for (int i = 0; i < nor; i++) {
+            project(lors[i], lors, i, or_normsqs.data());
+            or_normsqs[i] = pnormsq(lors[i]);
+        }
+        for (int i = 0; i < k; i++) {
+            copy(bs[i], MatrixRef(vs[i].data + off, nl, 1));
+            project(bs[i], lors, nor, or_normsqs.data());
+            for (int it = 0; it < 2; it++)
+                project(bs[i], bs, i, nullptr);
+            double normsq = pnormsq(bs[i]);
+            if (normsq < 1E-14) {
+                cout << "Cannot generate initial guess " << i
+                     << " for Davidson orthogonal to all given states!" << endl;
+                assert(false);
+            }
+            iscale(bs[i], 1.0 / sqrt(normsq));
+        }
+        vector<double> eigvals(k);
+        vector<int> eigval_idxs(deflation_max_size);
+        MatrixRef q(nullptr, nl, 1);
+        MatrixRef fb(nullptr, (MKL_INT)vs[0].size(), 1);
+        MatrixRef fc(nullptr, (MKL_INT)vs[0].size(), 1);
+        q.allocate(d_alloc);
+        fb.allocate(d_alloc);
+        fc.allocate(d_alloc);
+        MatrixRef lfb(fb.data + off, nl, 1), lfc(fc.data + off, nl, 1);
+        const bool is_root = pcomm->root == pcomm->rank;
+        int ck = 0, msig = 0, m = k, xiter = 0;
+        double qq;
+        if (iprint && is_root)
+            cout << endl;
+        while (xiter < max_iter &&
+               (soft_max_iter == -1 || xiter < soft_max_iter)) {
+            xiter++;
+            for (int i = msig; i < m; i++) {
+                copy(lfb, bs[i]);
+                pcomm->allgather(fb.data, counts);
+                fc.clear();
+                op(fb, fc);
+                pcomm->reduce_scatter_sum(fc.data, counts);
+                copy(sigmas[i], lfc);
+            }
+            msig = m;
+            DiagonalMatrix ld(nullptr, m);
+            MatrixRef alpha(nullptr, m, m);
+            ld.allocate();
+            alpha.allocate();
+            alpha.clear();
+            vector<MatrixRef> tmp(m, MatrixRef(nullptr, nl, 1));
+            for (int i = 0; i < m; i++)
+                tmp[i].allocate();
+            int ntg = threading->activate_global();
+#pragma omp parallel for schedule(dynamic) num_threads(ntg)
+            for (int ij = 0; ij < m * m; ij++) {
+                int i = ij / m, j = ij % m;
+                if (j <= i)
+                    alpha(i, j) = dot(bs[i], sigmas[j]);
+            }
+            pcomm->allreduce_sum(alpha.data, (size_t)m * m);
+            // all procs must use the same Ritz vectors
+            if (is_root)
+                eigs(alpha, ld);
+            pcomm->broadcast(alpha.data, (size_t)m * m, pcomm->root);
+            pcomm->broadcast(ld.data, m, pcomm->root);
+#pragma omp parallel num_threads(ntg)
+            {
+#pragma omp for schedule(static)
+                for (int j = 0; j < m; j++) {
+                    copy(tmp[j], bs[j]);
+                    iscale(bs[j], alpha(j, j));
+                }
+#pragma omp for schedule(static)
+                for (int j = 0; j < m; j++)
+                    for (int i = 0; i < m; i++)
+                        if (i != j)
+                            iadd(bs[j], tmp[i], alpha(j, i));
+#pragma omp for schedule(static)
+                for (int j = 0; j < m; j++) {
+                    copy(tmp[j], sigmas[j]);
+                    iscale(sigmas[j], alpha(j, j));
+                }
+#pragma omp for schedule(static)
+                for (int j = 0; j < m; j++)
+                    for (int i = 0; i < m; i++)
+                        if (i != j)
+                            iadd(sigmas[j], tmp[i], alpha(j, i));
+            }
+            threading->activate_normal();
+            for (int i = m - 1; i >= 0; i--)
+                tmp[i].deallocate();
+            alpha.deallocate();
+            davidson_sort_roots(eigval_idxs, ld, shift, davidson_type);
+            for (int i = 0; i < ck; i++) {
+                int ii = eigval_idxs[i];
+                copy(q, sigmas[ii]);
+                iadd(q, bs[ii], -ld(ii, ii));
+                if (pnormsq(q) >= conv_thrd) {
+                    ck = i;
+                    break;
+                }
+            }
+            int ick = eigval_idxs[ck];
+            copy(q, sigmas[ick]);
+            iadd(q, bs[ick], -ld(ick, ick));
+            project(q, lors, nor, or_normsqs.data());
+            qq = pnormsq(q);
+            if (iprint && is_root)
+                cout << setw(6) << xiter << setw(6) << m << setw(6) << ck
+                     << fixed << setw(15) << setprecision(8) << ld.data[ick]
+                     << scientific << setw(13) << setprecision(2) << qq
+                     << endl;
+            if (davidson_type & DavidsonTypes::DavidsonPrecond)
+                davidson_precondition(q, ld.data[ick], laa);
+            else if (!(davidson_type & DavidsonTypes::NoPrecond))
+                distributed_olsen_precondition(q, bs[ick], ld.data[ick], laa,
+                                               pcomm);
+            eigvals.resize(ck + 1);
+            for (int i = 0; i <= ck; i++)
+                eigvals[i] = ld.data[eigval_idxs[i]];
+            ld.deallocate();
+            if (qq < conv_thrd) {
+                ck++;
+                if (ck == k)
+                    break;
+            } else {
+                if (m >= deflation_max_size) {
+                    m = msig = deflation_min_size;
+                    if ((davidson_type & DavidsonTypes::LessThan) ||
+                        (davidson_type & DavidsonTypes::GreaterThan) ||
+                        (davidson_type & DavidsonTypes::CloseTo)) {
+                        vector<MatrixRef> tmp(m, MatrixRef(nullptr, nl, 1));
+                        for (int i = 0; i < m; i++)
+                            tmp[i].allocate();
+                        for (int j = 0; j < m; j++)
+                            copy(tmp[j], bs[eigval_idxs[j]]);
+                        for (int j = 0; j < m; j++)
+                            copy(bs[j], tmp[j]);
+                        for (int j = 0; j < m; j++)
+                            copy(tmp[j], sigmas[eigval_idxs[j]]);
+                        for (int j = 0; j < m; j++)
+                            copy(sigmas[j], tmp[j]);
+                        for (int i = m - 1; i >= 0; i--)
+                            tmp[i].deallocate();
+                    }
+                }
+                // classical Gram-Schmidt is repeated for stability
+                for (int it = 0; it < 2; it++) {
+                    project(q, bs, m, nullptr);
+                    project(q, lors, nor, or_normsqs.data());
+                }
+                iscale(q, 1.0 / sqrt(pnormsq(q)));
+                copy(bs[m++], q);
+            }
+            if (xiter == soft_max_iter)
+                break;
+        }
+        if (xiter == soft_max_iter)
+            eigvals.resize(k, 0);
+        if (xiter == max_iter) {
+            cout << "Error : only " << ck << " converged!" << endl;
+            assert(false);
+        }
+        for (int i = 0; i < k; i++) {
+            copy(MatrixRef(vs[i].data + off, nl, 1), bs[eigval_idxs[i]]);
+            pcomm->allgather(vs[i].data, counts);
+        }
+        fc.deallocate(d_alloc);
+        fb.deallocate(d_alloc);
+        q.deallocate(d_alloc);
+        d_alloc->deallocate(pors, nor * nl);
+        d_alloc->deallocate(pss, deflation_max_size * nl);
+        d_alloc->deallocate(pbs, deflation_max_size * nl);
+        ndav = xiter;
+        return eigvals;
+    }
+    // Thick-restart Lanczos algorithm for the lowest eigenvalues
+    // Only the Krylov basis is stored (no sigma vectors as in Davidson)
+    // and no preconditioner is needed
+    // vs: input/output vector (the sum of vs is the initial Krylov vector)
+    // ors: orthogonal states to be projected out
+    // deflation_min_size: min number of Ritz vectors kept at restart
+    // deflation_max_size: max size of the Krylov basis
+    template <typename MatMul, typename PComm>
+    static vector<double> thick_restart_lanczos(
+        MatMul &op, vector<MatrixRef> &vs, int &ndav, bool iprint = false,
+        const PComm &pcomm = nullptr, double conv_thrd = 5E-6,
+        int max_iter = 5000, int soft_max_iter = -1,
+        int deflation_min_size = 2, int deflation_max_size = 50,
+        const vector<MatrixRef> &ors = vector<MatrixRef>()) {
+        shared_ptr<VectorAllocator<double>> d_alloc =
+            make_shared<VectorAllocator<double>>();
+        const int k = (int)vs.size(), nor = (int)ors.size();
+        const MKL_INT nv = (MKL_INT)vs[0].size();
+        const int mmax = max(deflation_max_size, k + 2);
+        // keep at least half of the basis at restart
+        const int nkeep =
+            min(max(deflation_min_size, k + (mmax - k) / 2), mmax - 1);
+        MatrixRef pbs(nullptr, (MKL_INT)((mmax + 1) * (size_t)nv), 1);
+        pbs.data = d_alloc->allocate((mmax + 1) * (size_t)nv);
+        vector<MatrixRef> bs(mmax + 1, MatrixRef(nullptr, vs[0].m, vs[0].n));
+        for (int i = 0; i <= mmax; i++)
+            bs[i].data = pbs.data + (size_t)nv * i;
+        MatrixRef w(nullptr, vs[0].m, vs[0].n);
+        w.allocate(d_alloc);
+        // projected matrix and its eigenvectors (row i is the i-th vector)
+        MatrixRef t(nullptr, mmax, mmax), alpha(nullptr, mmax, mmax);
+        DiagonalMatrix ld(nullptr, mmax);
+        t.allocate(d_alloc);
+        alpha.allocate(d_alloc);
+        ld.allocate(d_alloc);
+        t.clear();
+        vector<double> or_normsqs(nor);
+        for (int i = 0; i < nor; i++) {
+            for (int j = 0; j < i; j++)
+                if (or_normsqs[j] > 1E-14)
+                    iadd(ors[i], ors[j], -dot(ors[j], ors[i]) / or_normsqs[j]);
+            or_normsqs[i] = dot(ors[i], ors[i]);
+        }
+        auto project = [&ors, &or_normsqs, nor](const MatrixRef &x) {
+            for (int j = 0; j < nor; j++)
+                if (or_normsqs[j] > 1E-14)
+                    iadd(x, ors[j], -dot(ors[j], x) / or_normsqs[j]);
+        };
+        // x -= bs[0:m] * (bs[0:m].T * x), twice for stability
+        auto orthogonalize = [&bs, &t](const MatrixRef &x, int m, int col) {
+            for (int ip = 0; ip < 2; ip++)
+                for (int i = 0; i < m; i++) {
+                    const double h = dot(bs[i], x);
+                    iadd(x, bs[i], -h);
+                    if (col != -1)
+                        t(i, col) = t(col, i) = (ip == 0 ? 0.0 : t(i, col)) + h;
+                }
+        };
+        // row i of alpha(m x m) is the i-th Ritz vector in the basis
+        auto ritz = [&bs, &t, &alpha, &ld](int m) {
+            MatrixRef a(alpha.data, m, m);
+            for (int i = 0; i < m; i++)
+                for (int j = 0; j < m; j++)
+                    a(i, j) = t(i, j);
+            eigs(a, DiagonalMatrix(ld.data, m));
+            return a;
+        };
+        if (pcomm == nullptr || pcomm->root == pcomm->rank) {
+            bs[0].clear();
+            for (int i = 0; i < k; i++)
+                iadd(bs[0], vs[i], 1.0);
+            project(bs[0]);
+            const double normsq = dot(bs[0], bs[0]);
+            if (normsq < 1E-14) {
+                cout << "Cannot generate initial guess for Lanczos "
+                        "orthogonal to all given states!"
+                     << endl;
+                assert(false);
+            }
+            iscale(bs[0], 1.0 / sqrt(normsq));
+        }
+        vector<double> eigvals(k, 0);
+        int ck = 0, m = 0, xiter = 0;
+        if (iprint)
+            cout << endl;
+        while (xiter < max_iter &&
+               (soft_max_iter == -1 || xiter < soft_max_iter)) {
+            xiter++;
+            if (pcomm != nullptr)
+                pcomm->broadcast(bs[m].data, nv, pcomm->root);
+            w.clear();
+            op(bs[m], w);
+            if (pcomm == nullptr || pcomm->root == pcomm->rank) {
+                project(w);
+                orthogonalize(w, m + 1, m);
+                const double beta = sqrt(dot(w, w));
+                m++;
+                MatrixRef a = ritz(m);
+                for (ck = 0; ck < k && ck < m; ck++)
+                    if (beta * beta * a(ck, m - 1) * a(ck, m - 1) >= conv_thrd)
+                        break;
+                const int ick = min(ck, m - 1);
+                if (iprint)
+                    cout << setw(6) << xiter << setw(6) << m << setw(6) << ck
+                         << fixed << setw(15) << setprecision(8)
+                         << ld.data[ick] << scientific << setw(13)
+                         << setprecision(2)
+                         << beta * beta * a(ick, m - 1) * a(ick, m - 1)
+                         << endl;
+                if (ck < k) {
+                    if (beta > 1E-12)
+                        iscale(w, 1.0 / beta);
+                    else
+                        // invariant subspace with fewer than k vectors
+                        for (MKL_INT ix = 0; ix < nv; ix++) {
+                            w.clear();
+                            w.data[(m + ix) % nv] = 1.0;
+                            project(w);
+                            orthogonalize(w, m, -1);
+                            const double normsq = dot(w, w);
+                            if (normsq > 1E-8) {
+                                iscale(w, 1.0 / sqrt(normsq));
+                                break;
+                            }
+                        }
+                    copy(bs[m], w);
+                }
+                if (ck < k && m == mmax) {
+                    // bs[0:nkeep] = alpha[0:nkeep] * bs[0:m], in column tiles
+                    const MKL_INT tn = (MKL_INT)min(
+                        (size_t)nv, max(rotate_tile_size() / m, (size_t)1));
+                    MatrixRef work(nullptr, m, tn);
+                    work.allocate(d_alloc);
+                    const MKL_INT mk = m, nk = nkeep;
+                    const double zero = 0.0, one = 1.0;
+                    for (MKL_INT j = 0; j < nv; j += tn) {
+                        const MKL_INT wn = min(tn, nv - j);
+                        for (int i = 0; i < m; i++)
+                            memcpy(work.data + (size_t)wn * i, bs[i].data + j,
+                                   sizeof(double) * wn);
+                        dgemm("n", "n", &wn, &nk, &mk, &one, work.data, &wn,
+                              a.data, &mk, &zero, pbs.data + j, &nv);
+                    }
+                    work.deallocate(d_alloc);
+                    copy(bs[nkeep], bs[m]);
+                    t.clear();
+                    for (int i = 0; i < nkeep; i++)
+                        t(i, i) = ld.data[i];
+                    m = nkeep;
+                }
+            }
+            if (pcomm != nullptr) {
+                pcomm->broadcast(&ck, 1, pcomm->root);
+                pcomm->broadcast(&m, 1, pcomm->root);
+            }
+            if (ck >= k)
+                break;
+        }
+        if (xiter == max_iter && ck < k) {
+            cout << "Error : only " << ck << " converged!" << endl;
+            assert(false);
+        }
+        if (pcomm == nullptr || pcomm->root == pcomm->rank) {
+            MatrixRef a = ritz(m);
+            for (int i = 0; i < k && i < m; i++) {
+                eigvals[i] = ld.data[i];
+                vs[i].clear();
+                for (int j = 0; j < m; j++)
+                    iadd(vs[i], bs[j], a(i, j));
+            }
+        }
+        if (pcomm != nullptr) {
+            pcomm->broadcast(eigvals.data(), eigvals.size(), pcomm->root);
+            for (int j = 0; j < k; j++)
+                pcomm->broadcast(vs[j].data, vs[j].size(), pcomm->root);
+        }
+        ld.deallocate(d_alloc);
+        alpha.deallocate(d_alloc);
+        t.deallocate(d_alloc);
+        w.deallocate(d_alloc);
+        d_alloc->deallocate(pbs.data, (mmax + 1) * (size_t)nv);
+        ndav = xiter;
+        return eigvals;
+    }
+    // Chebyshev-filtered subspace iteration for the lowest eigenvalues
+    // Zhou, Saad, Tiago & Chelikowsky, J. Comput. Phys. 219, 172 (2006)
+    // A block of fixed size (k roots plus guard vectors) is filtered by a
+    // Chebyshev polynomial damping the unwanted interval [a, b] of the
+    // spectrum and then refined by Rayleigh-Ritz. Only panel matvecs on
+    // the whole block and dense products are needed, which suits many
+    // roots. b is estimated by a few Lanczos steps, a is the largest Ritz
+    // value in the block.
+    // vs: input/output vector
+    // ors: orthogonal states to be projected out
+    // deflation_min_size: min size of the block
+    // degree: degree of the Chebyshev polynomial (number of matvecs on the
+    // block per iteration)
+    template <typename MatMul, typename PComm>
+    static vector<double> chebyshev_filtered_subspace(
+        MatMul &op, vector<MatrixRef> &vs, int &ndav, bool iprint = false,
+        const PComm &pcomm = nullptr, double conv_thrd = 5E-6,
+        int max_iter = 5000, int soft_max_iter = -1,
+        int deflation_min_size = 2,
+        const vector<MatrixRef> &ors = vector<MatrixRef>(), int degree = 8) {
+        shared_ptr<VectorAllocator<double>> d_alloc =
+            make_shared<VectorAllocator<double>>();
+        const int k = (int)vs.size(), nor = (int)ors.size();
+        const MKL_INT nv = (MKL_INT)vs[0].size();
+        const int p = (int)min(
+            min((MKL_INT)max(deflation_min_size, k + max(k / 4, 2)), nv),
+            max(nv - (MKL_INT)nor, (MKL_INT)k));
+        const bool is_root = pcomm == nullptr || pcomm->root == pcomm->rank;
+        // three blocks of p vectors, each stored as one (p x nv) matrix
+        double *pdata = d_alloc->allocate(3 * (size_t)p * nv);
+        double *px = pdata, *py = px + (size_t)p * nv,
+               *pw = py + (size_t)p * nv;
+        MatrixRef h(nullptr, p, p);
+        DiagonalMatrix ld(nullptr, p);
+        h.allocate(d_alloc);
+        ld.allocate(d_alloc);
+        vector<double> or_normsqs(nor);
+        for (int i = 0; i < nor; i++) {
+            for (int j = 0; j < i; j++)
+                if (or_normsqs[j] > 1E-14)
+                    iadd(ors[i], ors[j], -dot(ors[j], ors[i]) / or_normsqs[j]);
+            or_normsqs[i] = dot(ors[i], ors[i]);
+        }
+        auto project = [&ors, &or_normsqs, nor](const MatrixRef &x) {
+            for (int j = 0; j < nor; j++)
+                if (or_normsqs[j] > 1E-14)
+                    iadd(x, ors[j], -dot(ors[j], x) / or_normsqs[j]);
+        };
+        auto row = [&vs, nv](double *pb, int i) {
+            return MatrixRef(pb + (size_t)nv * i, vs[0].m, vs[0].n);
+        };
+        auto block = [p, nv](double *pb) { return MatrixRef(pb, p, nv); };
+        int xiter = 0;
+        // pw[0:p] = op * pb[0:p], as one panel
+        auto block_multiply = [&](double *pb) {
+            if (pcomm != nullptr)
+                pcomm->broadcast(pb, (size_t)p * nv, pcomm->root);
+            vector<MatrixRef> bs(p, MatrixRef(nullptr, vs[0].m, vs[0].n));
+            vector<MatrixRef> sigmas = bs;
+            for (int i = 0; i < p; i++)
+                bs[i] = row(pb, i), sigmas[i] = row(pw, i);
+            davidson_multiply(op, bs, sigmas, 0, p, 0);
+            if (is_root)
+                for (int i = 0; i < p; i++)
+                    project(sigmas[i]);
+            xiter++;
+        };
+        unsigned int seed = 0;
+        // pb[0:p] = orthonormal basis of pb[0:p], by symmetric
+        // orthogonalization done twice, with pt as workspace
+        // dependent vectors are replaced by random vectors in the first pass
+        auto orthonormalize = [&](double *&pb, double *&pt) {
+            for (int it = 0; it < 2; it++) {
+                multiply(block(pb), false, block(pb), true, h, 1.0, 0.0);
+                eigs(h, ld);
+                const double thrd = 1E-12 * ld.data[p - 1];
+                for (int i = 0; i < p; i++)
+                    iscale(MatrixRef(h.data + (size_t)p * i, 1, p),
+                           ld.data[i] > thrd ? 1.0 / sqrt(ld.data[i]) : 0.0);
+                multiply(h, false, block(pb), false, block(pt), 1.0, 0.0);
+                swap(pb, pt);
+                for (int i = 0; i < p && it == 0; i++)
+                    if (ld.data[i] <= thrd) {
+                        random_gaussian(row(pb, i), seed++);
+                        project(row(pb, i));
+                    }
+            }
+        };
+        int ck = 0;
+        // Rayleigh-Ritz for the orthonormal block py
+        // on return px = Ritz vectors, py = op * px, ld = Ritz values
+        auto rayleigh_ritz = [&]() {
+            block_multiply(py);
+            if (is_root) {
+                multiply(block(py), false, block(pw), true, h, 1.0, 0.0);
+                for (int i = 0; i < p; i++)
+                    for (int j = 0; j < i; j++)
+                        h(i, j) = h(j, i) = 0.5 * (h(i, j) + h(j, i));
+                eigs(h, ld);
+                multiply(h, false, block(py), false, block(px), 1.0, 0.0);
+                multiply(h, false, block(pw), false, block(py), 1.0, 0.0);
+                double qq = 0;
+                for (ck = 0; ck < k; ck++) {
+                    const MatrixRef r = row(pw, ck);
+                    copy(r, row(py, ck));
+                    iadd(r, row(px, ck), -ld.data[ck]);
+                    qq = dot(r, r);
+                    if (qq >= conv_thrd)
+                        break;
+                }
+                const int ick = min(ck, k - 1);
+                if (iprint)
+                    cout << setw(6) << xiter << setw(6) << p << setw(6) << ck
+                         << fixed << setw(15) << setprecision(8)
+                         << ld.data[ick] << scientific << setw(13)
+                         << setprecision(2) << qq << endl;
+            }
+            if (pcomm != nullptr)
+                pcomm->broadcast(&ck, 1, pcomm->root);
+        };
+        // upper bound of the spectrum from a few Lanczos steps
+        // (largest Ritz value plus the last off-diagonal element)
+        double upper = 0;
+        {
+            const int nl = (int)min((MKL_INT)10, nv);
+            MatrixRef v0 = row(px, 0), v1 = row(py, 0), wl = row(pw, 0);
+            vector<double> alphas, betas;
+            if (is_root) {
+                v0.clear(), v1.clear();
+                for (int i = 0; i < k; i++)
+                    iadd(v1, vs[i], 1.0);
+                project(v1);
+                if (dot(v1, v1) < 1E-14) {
+                    random_gaussian(v1, seed++);
+                    project(v1);
+                }
+                iscale(v1, 1.0 / sqrt(dot(v1, v1)));
+            }
+            for (int i = 0, brk = 0; i < nl && !brk; i++) {
+                if (pcomm != nullptr)
+                    pcomm->broadcast(v1.data, nv, pcomm->root);
+                wl.clear();
+                op(v1, wl);
+                xiter++;
+                if (is_root) {
+                    project(wl);
+                    iadd(wl, v0, betas.size() == 0 ? 0.0 : -betas.back());
+                    alphas.push_back(dot(v1, wl));
+                    iadd(wl, v1, -alphas.back());
+                    betas.push_back(sqrt(dot(wl, wl)));
+                    brk = betas.back() < 1E-12;
+                    if (!brk)
+                        iscale(wl, 1.0 / betas.back());
+                    copy(v0, v1);
+                    copy(v1, wl);
+                }
+                if (pcomm != nullptr)
+                    pcomm->broadcast(&brk, 1, pcomm->root);
+            }
+            if (is_root) {
+                const int m = (int)alphas.size();
+                MatrixRef t(nullptr, m, m);
+                DiagonalMatrix tw(nullptr, m);
+                t.allocate(d_alloc);
+                tw.allocate(d_alloc);
+                t.clear();
+                for (int i = 0; i < m; i++) {
+                    t(i, i) = alphas[i];
+                    if (i + 1 < m)
+                        t(i, i + 1) = t(i + 1, i) = betas[i];
+                }
+                eigs(t, tw);
+                upper = tw.data[m - 1] + betas.back();
+                tw.deallocate(d_alloc);
+                t.deallocate(d_alloc);
+            }
+        }
+        if (is_root) {
+            for (int i = 0; i < p; i++) {
+                if (i < k)
+                    copy(row(py, i), vs[i]);
+                else
+                    random_gaussian(row(py, i), seed++);
+                project(row(py, i));
+            }
+            orthonormalize(py, px);
+        }
+        if (iprint)
+            cout << endl;
+        rayleigh_ritz();
+        while (ck < k && xiter < max_iter &&
+               (soft_max_iter == -1 || xiter < soft_max_iter)) {
+            double c = 0, e = 0, sigma = 0, sigma1 = 0;
+            if (is_root) {
+                // filter interval [a, b]; the norm is kept at ld[0]
+                const double a = ld.data[p - 1];
+                const double b = max(upper, a + 1E-8 * max(abs(a), 1.0));
+                c = (a + b) / 2, e = (b - a) / 2;
+                sigma = sigma1 = e / (ld.data[0] - c);
+                // py = (sigma1 / e) * (op - c) * px
+                iadd(block(py), block(px), -c);
+                iscale(block(py), sigma1 / e);
+            }
+            for (int d = 2; d <= degree; d++) {
+                block_multiply(py);
+                if (is_root) {
+                    const double sigma2 = 1.0 / (2.0 / sigma1 - sigma);
+                    // px = 2 sigma2 / e * (op - c) * py - sigma sigma2 * px
+                    iscale(block(px), -sigma * sigma2);
+                    iadd(block(px), block(pw), 2.0 * sigma2 / e);
+                    iadd(block(px), block(py), -2.0 * sigma2 * c / e);
+                    sigma = sigma2;
+                }
+                swap(px, py);
+            }
+            if (is_root)
+                orthonormalize(py, px);
+            rayleigh_ritz();
+        }
+        if (xiter >= max_iter && ck < k) {
+            cout << "Error : only " << ck << " converged!" << endl;
+            assert(false);
+        }
+        vector<double> eigvals(k, 0);
+        if (is_root)
+            for (int i = 0; i < k; i++) {
+                eigvals[i] = ld.data[i];
+                copy(vs[i], row(px, i));
+            }
+        if (pcomm != nullptr) {
+            pcomm->broadcast(eigvals.data(), eigvals.size(), pcomm->root);
+            for (int j = 0; j < k; j++)
+                pcomm->broadcast(vs[j].data, vs[j].size(), pcomm->root);
+        }
+        ld.deallocate(d_alloc);
+        h.deallocate(d_alloc);
+        d_alloc->deallocate(pdata, 3 * (size_t)p * nv);
         ndav = xiter;
         return eigvals;
     }
@@ -1104,6 +2444,10 @@ struct MatrixFunctions {
     // shift: solve for eigenvalues near this value
     // davidson_type: whether eigenvalues should be above/below/near shift
     // ors: orthogonal states to be projected out
+    // rvs: recycled subspace vectors (only used for non-harmonic variants)
+    // With DavidsonTypes::Lanczos, thick-restart Lanczos is used instead
+    // With DavidsonTypes::Chebyshev, Chebyshev-filtered subspace iteration
+    // is used instead
     template <typename MatMul, typename PComm>
     static vector<double> harmonic_davidson(
         MatMul &op, const DiagonalMatrix &aa, vector<MatrixRef> &vs,
@@ -1111,11 +2455,29 @@ struct MatrixFunctions {
         bool iprint = false, const PComm &pcomm = nullptr,
         double conv_thrd = 5E-6, int max_iter = 5000, int soft_max_iter = -1,
         int deflation_min_size = 2, int deflation_max_size = 50,
-        const vector<MatrixRef> &ors = vector<MatrixRef>()) {
+        const vector<MatrixRef> &ors = vector<MatrixRef>(),
+        const vector<MatrixRef> &rvs = vector<MatrixRef>()) {
+        if (davidson_type & DavidsonTypes::Lanczos) {
+            for (size_t i = 0; i < rvs.size(); i++)
+                rvs[i].clear();
+            return thick_restart_lanczos(op, vs, ndav, iprint, pcomm,
+                                         conv_thrd, max_iter, soft_max_iter,
+                                         deflation_min_size,
+                                         deflation_max_size, ors);
+        }
+        if (davidson_type & DavidsonTypes::Chebyshev) {
+            for (size_t i = 0; i < rvs.size(); i++)
+                rvs[i].clear();
+            return chebyshev_filtered_subspace(
+                op, vs, ndav, iprint, pcomm, conv_thrd, max_iter,
+                soft_max_iter, deflation_min_size, ors);
+        }
         if (!(davidson_type & DavidsonTypes::Harmonic))
             return davidson(op, aa, vs, shift, davidson_type, ndav, iprint,
                             pcomm, conv_thrd, max_iter, soft_max_iter,
-                            deflation_min_size, deflation_max_size, ors);
+                            deflation_min_size, deflation_max_size, ors, rvs);
+        for (size_t i = 0; i < rvs.size(); i++)
+            rvs[i].clear();
         shared_ptr<VectorAllocator<double>> d_alloc =
             make_shared<VectorAllocator<double>>();
         int k = (int)vs.size(), nor = (int)ors.size();
@@ -1463,17 +2825,115 @@ struct MatrixFunctions {
         }
         return make_pair(iput, ns);
     }
+    // s-step Arnoldi / Lanczos process for the Krylov basis of expo_krylov
+    // In each round, s matrix-vector products of scaled powers of the last
+    // basis vector are formed without any orthogonalization, then the block
+    // is orthogonalized (CGS2) and Hessenberg columns are recovered from
+    // the change-of-basis coefficients, so in parallel only the last basis
+    // vector has to be broadcast once per round (instead of once per step)
+    // v: n x (m+1) basis, v[0] normalized on input
+    // h: Hessenberg matrix, h[j * ldh + i] = H(i, j), zeroed on input
+    // return number of basis vectors m' (m' < m for happy breakdown)
+    // hbrk: last subdiagonal element of H
+    template <typename MatMul, typename PComm>
+    static MKL_INT s_step_arnoldi(MatMul &op, MKL_INT n, MKL_INT m,
+                                  MKL_INT s, double *v, double *h, MKL_INT ldh,
+                                  bool symmetric, double break_tol,
+                                  double &hbrk, MKL_INT &nmult,
+                                  const PComm &pcomm) {
+        const MKL_INT inc = 1;
+        const double one = 1.0, zero = 0.0, mone = -1.0;
+        // rr[c * (m + 1) + i]: coefficient of v[i] in power c of this round
+        vector<double> rr((s + 1) * (m + 1)), sigma(s), cc(m + 1);
+        for (MKL_INT j = 0; j < m;) {
+            const MKL_INT sb = min(s, m - j);
+            // matrix powers: p[c + 1] = A p[c] / sigma[c], p[0] = v[j]
+            for (MKL_INT c = 0; c < sb; c++) {
+                nmult++;
+                op(v + (j + c) * n, v + (j + c + 1) * n);
+                sigma[c] = dnrm2(&n, v + (j + c + 1) * n, &inc);
+                if (sigma[c] == 0.0)
+                    sigma[c] = 1.0;
+                double p1 = 1.0 / sigma[c];
+                dscal(&n, &p1, v + (j + c + 1) * n, &inc);
+            }
+            double info[2] = {(double)(j + sb), 0.0};
+            if (pcomm == nullptr || pcomm->root == pcomm->rank) {
+                memset(rr.data(), 0, sizeof(double) * rr.size());
+                rr[j] = 1.0;
+                for (MKL_INT c = 1; c <= sb; c++) {
+                    double *pc = v + (j + c) * n, *rc = rr.data() + c * (m + 1);
+                    MKL_INT nq = j + c;
+                    // block classical Gram-Schmidt, twice
+                    for (int it = 0; it < 2; it++) {
+                        dgemv("t", &n, &nq, &one, v, &n, pc, &inc, &zero,
+                              cc.data(), &inc);
+                        dgemv("n", &n, &nq, &mone, v, &n, cc.data(), &inc,
+                              &one, pc, &inc);
+                        daxpy(&nq, &one, cc.data(), &inc, rc, &inc);
+                    }
+                    rc[nq] = dnrm2(&n, pc, &inc);
+                    if (rc[nq] != 0.0) {
+                        double p1 = 1.0 / rc[nq];
+                        dscal(&n, &p1, pc, &inc);
+                    }
+                }
+                // A p[c] = sigma[c] p[c + 1] gives column j + c of H
+                for (MKL_INT c = 0; c < sb; c++) {
+                    const double *rc = rr.data() + c * (m + 1);
+                    const MKL_INT jc = j + c;
+                    double *hc = h + jc * ldh;
+                    for (MKL_INT i = 0; i <= jc + 1; i++)
+                        hc[i] = sigma[c] * rr[(c + 1) * (m + 1) + i];
+                    for (MKL_INT r = 0; r < jc; r++)
+                        if (rc[r] != 0.0)
+                            for (MKL_INT i = 0; i <= r + 1; i++)
+                                hc[i] -= rc[r] * h[r * ldh + i];
+                    double p1 = 1.0 / rc[jc];
+                    for (MKL_INT i = 0; i <= jc + 1; i++)
+                        hc[i] *= p1;
+                    if (symmetric) {
+                        for (MKL_INT i = 0; i + 1 < jc; i++)
+                            hc[i] = 0.0;
+                        if (jc != 0)
+                            hc[jc - 1] = h[(jc - 1) * ldh + jc];
+                    }
+                    info[1] = hc[jc + 1];
+                    if (hc[jc + 1] <= break_tol) {
+                        info[0] = (double)(jc + 1);
+                        hc[jc + 1] = 0.0;
+                        break;
+                    }
+                    if (symmetric)
+                        h[(jc + 1) * ldh + jc] = hc[jc + 1];
+                }
+            }
+            if (pcomm != nullptr)
+                pcomm->broadcast(info, 2, pcomm->root);
+            hbrk = info[1];
+            if ((MKL_INT)info[0] != j + sb)
+                return (MKL_INT)info[0];
+            j += sb;
+            if (pcomm != nullptr)
+                pcomm->broadcast(v + j * n, n, pcomm->root);
+        }
+        return m;
+    }
     // Computes w = exp(t*A)*v - for a (sparse) symmetric / general matrix A.
     // Adapted from expokit fortran code dsexpv.f/dgexpy.f:
     //   Roger B. Sidje (rbs@maths.uq.edu.au)
     //   EXPOKIT: Software Package for Computing Matrix Exponentials.
     //   ACM - Transactions On Mathematical Software, 24(1):130-156, 1998
     // lwork = n*(m+1)+n+(m+2)^2+4*(m+2)^2+ideg+1
+    // s_step > 1: Krylov basis built by s_step_arnoldi in rounds of s_step
+    // t_next: if not nullptr, reduced to the smallest step size suggested by
+    //   the local error estimates (unchanged if the Krylov space is exact)
     template <typename MatMul, typename PComm>
     static MKL_INT expo_krylov(MatMul &op, MKL_INT n, MKL_INT m, double t,
                                double *v, double *w, double &tol, double anorm,
                                double *work, MKL_INT lwork, bool symmetric,
-                               bool iprint, const PComm &pcomm = nullptr) {
+                               bool iprint, const PComm &pcomm = nullptr,
+                               int s_step = 1, double *t_next = nullptr) {
         const MKL_INT inc = 1;
         const double sqr1 = sqrt(0.1), zero = 0.0;
         const MKL_INT mxstep = symmetric ? 500 : 1000, mxreject = 0, ideg = 6;
@@ -1524,55 +2984,70 @@ struct MatrixFunctions {
             // Lanczos loop / Arnoldi loop
             MKL_INT j1v = iv + n;
             double hj1j = 0.0;
-            for (MKL_INT j = 0; j < m; j++) {
-                nmult++;
-                op(work + j1v - n, work + j1v);
-                if (pcomm == nullptr || pcomm->root == pcomm->rank) {
-                    if (symmetric) {
-                        if (j != 0) {
-                            p1 = -work[ih + j * mh + j - 1];
-                            daxpy(&n, &p1, work + j1v - n - n, &inc, work + j1v,
-                                  &inc);
-                        }
-                        double hjj =
-                            -ddot(&n, work + j1v - n, &inc, work + j1v, &inc);
-                        work[ih + j * (mh + 1)] = -hjj;
-                        daxpy(&n, &hjj, work + j1v - n, &inc, work + j1v, &inc);
-                        hj1j = dnrm2(&n, work + j1v, &inc);
-                    } else {
-                        for (MKL_INT i = 0; i <= j; i++) {
-                            double hij = -ddot(&n, work + iv + i * n, &inc,
-                                               work + j1v, &inc);
-                            daxpy(&n, &hij, work + iv + i * n, &inc, work + j1v,
-                                  &inc);
-                            work[ih + j * mh + i] = -hij;
-                        }
-                        hj1j = dnrm2(&n, work + j1v, &inc);
-                    }
-                }
-                if (pcomm != nullptr)
-                    pcomm->broadcast(&hj1j, 1, pcomm->root);
-                // if "happy breakdown" go straightforward at the end
-                if (hj1j <= break_tol) {
+            if (s_step > 1) {
+                mbrkdwn = s_step_arnoldi(op, n, m, (MKL_INT)s_step, work + iv,
+                                         work + ih, mh, symmetric, break_tol,
+                                         hj1j, nmult, pcomm);
+                if (mbrkdwn != m) {
                     if (iprint)
-                        cout << "happy breakdown: mbrkdwn =" << j + 1
+                        cout << "happy breakdown: mbrkdwn =" << mbrkdwn
                              << " h = " << hj1j << endl;
                     k1 = 0, ibrkflag = 1;
-                    mbrkdwn = j + 1, tbrkdwn = t_now;
+                    tbrkdwn = t_now;
                     t_step = t_out - t_now;
-                    break;
                 }
-                if (pcomm == nullptr || pcomm->root == pcomm->rank) {
-                    work[ih + j * mh + j + 1] = hj1j;
-                    if (symmetric)
-                        work[ih + (j + 1) * mh + j] = hj1j;
-                    hj1j = 1.0 / hj1j;
-                    dscal(&n, &hj1j, work + j1v, &inc);
+                j1v = iv + (mbrkdwn + 1) * n;
+            } else
+                for (MKL_INT j = 0; j < m; j++) {
+                    nmult++;
+                    op(work + j1v - n, work + j1v);
+                    if (pcomm == nullptr || pcomm->root == pcomm->rank) {
+                        if (symmetric) {
+                            if (j != 0) {
+                                p1 = -work[ih + j * mh + j - 1];
+                                daxpy(&n, &p1, work + j1v - n - n, &inc,
+                                      work + j1v, &inc);
+                            }
+                            double hjj = -ddot(&n, work + j1v - n, &inc,
+                                               work + j1v, &inc);
+                            work[ih + j * (mh + 1)] = -hjj;
+                            daxpy(&n, &hjj, work + j1v - n, &inc, work + j1v,
+                                  &inc);
+                            hj1j = dnrm2(&n, work + j1v, &inc);
+                        } else {
+                            for (MKL_INT i = 0; i <= j; i++) {
+                                double hij = -ddot(&n, work + iv + i * n, &inc,
+                                                   work + j1v, &inc);
+                                daxpy(&n, &hij, work + iv + i * n, &inc,
+                                      work + j1v, &inc);
+                                work[ih + j * mh + i] = -hij;
+                            }
+                            hj1j = dnrm2(&n, work + j1v, &inc);
+                        }
+                    }
+                    if (pcomm != nullptr)
+                        pcomm->broadcast(&hj1j, 1, pcomm->root);
+                    // if "happy breakdown" go straightforward at the end
+                    if (hj1j <= break_tol) {
+                        if (iprint)
+                            cout << "happy breakdown: mbrkdwn =" << j + 1
+                                 << " h = " << hj1j << endl;
+                        k1 = 0, ibrkflag = 1;
+                        mbrkdwn = j + 1, tbrkdwn = t_now;
+                        t_step = t_out - t_now;
+                        break;
+                    }
+                    if (pcomm == nullptr || pcomm->root == pcomm->rank) {
+                        work[ih + j * mh + j + 1] = hj1j;
+                        if (symmetric)
+                            work[ih + (j + 1) * mh + j] = hj1j;
+                        hj1j = 1.0 / hj1j;
+                        dscal(&n, &hj1j, work + j1v, &inc);
+                    }
+                    if (pcomm != nullptr)
+                        pcomm->broadcast(work + j1v, n, pcomm->root);
+                    j1v += n;
                 }
-                if (pcomm != nullptr)
-                    pcomm->broadcast(work + j1v, n, pcomm->root);
-                j1v += n;
-            }
             if (k1 != 0) {
                 nmult++;
                 op(work + j1v - n, work + j1v);
@@ -1669,6 +3144,8 @@ struct MatrixFunctions {
                 pcomm->broadcast(w, n, pcomm->root);
                 beta = tmp[0], t_new = tmp[1], t_now = tmp[2];
             }
+            if (t_next != nullptr && k1 != 0)
+                *t_next = min(*t_next, t_new);
             if (mxstep != 0 && nstep >= mxstep) {
                 iflag = 1;
                 break;
@@ -1678,11 +3155,14 @@ struct MatrixFunctions {
     }
     // apply exponential of a matrix to a vector
     // v: input/output vector
+    // s_step: number of Krylov vectors generated per orthogonalization round
+    // t_next: if not nullptr, reduced to the suggested next step size
     template <typename MatMul, typename PComm>
     static int expo_apply(MatMul &op, double t, double anorm, MatrixRef &v,
                           double consta, bool symmetric, bool iprint = false,
                           const PComm &pcomm = nullptr, double conv_thrd = 5E-6,
-                          int deflation_max_size = 20) {
+                          int deflation_max_size = 20, int s_step = 1,
+                          double *t_next = nullptr) {
         MKL_INT vm = v.m, vn = v.n, n = vm * vn;
         if (n < 4) {
             const MKL_INT lwork = 4 * n * n + 7;
@@ -1720,7 +3200,7 @@ struct MatrixFunctions {
             anorm = 1.0;
         MKL_INT nmult = MatrixFunctions::expo_krylov(
             lop, n, m, t, v.data, w.data(), conv_thrd, anorm, work.data(),
-            lwork, symmetric, iprint, (PComm)pcomm);
+            lwork, symmetric, iprint, (PComm)pcomm, s_step, t_next);
         memcpy(v.data, w.data(), sizeof(double) * n);
         return (int)nmult;
     }
@@ -64,6 +64,33 @@ inline NoiseTypes operator|(NoiseTypes a, NoiseTypes b) {
     return NoiseTypes((uint8_t)a | (uint8_t)b);
 }
 
+// One block-pair step of v = (a x b) @ c:
+// v[v_off] += factor * a(.T) * c[c_off] * b(.T)
+// c and v blocks are stored as offsets, so that the same instruction can
+// be applied to different wavefunction data
+struct TensorProductInstruction {
+    MatrixRef a, b;
+    size_t c_off, v_off;
+    MKL_INT cm, cn, vm, vn;
+    uint8_t conj;
+    double factor;
+    TensorProductInstruction(const MatrixRef &a, const MatrixRef &b,
+                             size_t c_off, size_t v_off, MKL_INT cm,
+                             MKL_INT cn, MKL_INT vm, MKL_INT vn, uint8_t conj,
+                             double factor)
+        : a(a), b(b), c_off(c_off), v_off(v_off), cm(cm), cn(cn), vm(vm),
+          vn(vn), conj(conj), factor(factor) {}
+};
+
+// Flat instruction list lowered from a symbolic expression
+// Instructions of term i are in [term_offsets[i], term_offsets[i + 1])
+struct TensorProductProgram {
+    vector<TensorProductInstruction> instrs;
+    vector<size_t> term_offsets = vector<size_t>(1, 0);
+    size_t n_terms() const { return term_offsets.size() - 1; }
+    void end_term() { term_offsets.push_back(instrs.size()); }
+};
+
 // SparseMatrix operations
 template <typename S> struct OperatorFunctions {
     shared_ptr<CG<S>> cg;
@@ -121,13 +148,33 @@ template <typename S> struct OperatorFunctions {
 #pragma omp taskwait
 #endif
         // avoid possible int32 overflow
-        for (int j = 0; j < mats[i]->n; j++)
+        for (int j = 0; j < mats[i]->n; j++) {
+            SparseMatrixView<S> vi = mats[i]->view(j), vm = mats[m]->view(j);
             MatrixFunctions::iadd(
-                MatrixRef((*mats[i])[j]->data, 1,
-                          (MKL_INT)(*mats[i])[j]->total_memory),
-                MatrixRef((*mats[m])[j]->data, 1,
-                          (MKL_INT)(*mats[m])[j]->total_memory),
-                1.0);
+                MatrixRef(vi.data, 1, (MKL_INT)vi.total_memory),
+                MatrixRef(vm.data, 1, (MKL_INT)vm.total_memory), 1.0);
+        }
+    }
+    // mats[0] += mats[1] + ... by all threads of the parallel region,
+    // in chunks of threading->reduce_chunk elements
+    virtual void
+    chunked_reduce(const vector<shared_ptr<SparseMatrix<S>>> &mats) const {
+        assert(mats[0]->get_type() == SparseMatrixTypes::Normal);
+        vector<double *> xs(mats.size());
+        for (size_t i = 0; i < mats.size(); i++)
+            xs[i] = mats[i]->data;
+        MatrixFunctions::chunked_reduce(xs, mats[0]->total_memory,
+                                        threading->reduce_chunk);
+    }
+    virtual void
+    chunked_reduce(const vector<shared_ptr<SparseMatrixGroup<S>>> &mats) const {
+        vector<double *> xs(mats.size());
+        for (int j = 0; j < mats[0]->n; j++) {
+            for (size_t i = 0; i < mats.size(); i++)
+                xs[i] = mats[i]->view(j).data;
+            MatrixFunctions::chunked_reduce(xs, mats[0]->view(j).total_memory,
+                                            threading->reduce_chunk);
+        }
     }
     // a += b * scale
     virtual void iadd(const shared_ptr<SparseMatrix<S>> &a,
@@ -135,6 +182,9 @@ template <typename S> struct OperatorFunctions {
                       bool conj = false) const {
         assert(a->get_type() == SparseMatrixTypes::Normal &&
                b->get_type() == SparseMatrixTypes::Normal);
+        // b can be a zero operator without data
+        if (b->factor == 0.0)
+            return;
         if (a->info == b->info && !conj) {
             if (seq->mode != SeqTypes::None && seq->mode != SeqTypes::Tasked) {
                 seq->iadd(MatrixRef(a->data, 1, (MKL_INT)a->total_memory),
@@ -163,7 +213,7 @@ template <typename S> struct OperatorFunctions {
                 if (bq != S(S::invalid) &&
                     ((ib = b->info->find_state(bq)) != -1)) {
                     double factor = scale * b->factor;
-                    if (conj)
+                    if (!CG<S>::abelian && conj)
                         factor *= cg->transpose_cg(bdq.twos(), bra.twos(),
                                                    ket.twos());
                     if (seq->mode != SeqTypes::None &&
@@ -471,6 +521,60 @@ template <typename S> struct OperatorFunctions {
         if (seq->mode == SeqTypes::Simple)
             seq->simple_perform();
     }
+    // Append instructions of v = (a x b) @ c to prog
+    // Only the operator data of a and b and the block layout of c and v
+    // are used, so that prog remains valid when c and v data change
+    // but the c factor must be applied when prog is executed
+    void compile_tensor_product_multiply(
+        uint8_t conj, const shared_ptr<SparseMatrix<S>> &a,
+        const shared_ptr<SparseMatrix<S>> &b,
+        const shared_ptr<SparseMatrix<S>> &c,
+        const shared_ptr<SparseMatrix<S>> &v, S opdq, double scale,
+        TensorProductProgram &prog) const {
+        assert(a->get_type() == SparseMatrixTypes::Normal &&
+               b->get_type() == SparseMatrixTypes::Normal);
+        scale = scale * a->factor * b->factor;
+        if (abs(scale) < TINY)
+            return;
+        S adq = a->info->delta_quantum, bdq = b->info->delta_quantum;
+        assert(c->info->cinfo != nullptr);
+        shared_ptr<typename SparseMatrixInfo<S>::ConnectionInfo> cinfo =
+            c->info->cinfo;
+        S abdq = opdq.combine((conj & 1) ? -adq : adq, (conj & 2) ? bdq : -bdq);
+        int ik = (int)(lower_bound(cinfo->quanta + cinfo->n[conj],
+                                   cinfo->quanta + cinfo->n[conj + 1], abdq) -
+                       cinfo->quanta);
+        assert(ik < cinfo->n[conj + 1]);
+        int ixa = cinfo->idx[ik];
+        int ixb = ik == cinfo->n[4] - 1 ? cinfo->nc : cinfo->idx[ik + 1];
+        for (int il = ixa; il < ixb; il++) {
+            int ia = cinfo->ia[il], ib = cinfo->ib[il], ic = cinfo->ic[il],
+                iv = (int)cinfo->stride[il];
+            prog.instrs.push_back(TensorProductInstruction(
+                (*a)[ia], (*b)[ib], c->info->n_states_total[ic],
+                v->info->n_states_total[iv], (MKL_INT)c->info->n_states_bra[ic],
+                (MKL_INT)c->info->n_states_ket[ic],
+                (MKL_INT)v->info->n_states_bra[iv],
+                (MKL_INT)v->info->n_states_ket[iv], conj,
+                scale * cinfo->factor[il]));
+        }
+    }
+    // v += scale * (instructions of term i in prog) @ c
+    void compiled_tensor_product_multiply(const TensorProductProgram &prog,
+                                          size_t i,
+                                          const shared_ptr<SparseMatrix<S>> &c,
+                                          const shared_ptr<SparseMatrix<S>> &v,
+                                          double scale = 1.0) const {
+        assert(v->factor == 1.0);
+        for (size_t k = prog.term_offsets[i]; k < prog.term_offsets[i + 1];
+             k++) {
+            const TensorProductInstruction &x = prog.instrs[k];
+            seq->cumulative_nflop += MatrixFunctions::rotate(
+                MatrixRef(c->data + x.c_off, x.cm, x.cn),
+                MatrixRef(v->data + x.v_off, x.vm, x.vn), x.a, x.conj & 1, x.b,
+                !(x.conj & 2), scale * x.factor);
+        }
+    }
     virtual void three_tensor_product_multiply(
         uint8_t conj, const shared_ptr<SparseMatrix<S>> &a,
         const shared_ptr<SparseMatrix<S>> &b,
@@ -664,17 +768,20 @@ template <typename S> struct OperatorFunctions {
                     if (bl != S(S::invalid)) {
                         int ib = b->info->find_state(bl);
                         if (ib != -1) {
-                            int aqpj = aqprime.multiplicity() - 1,
-                                cqj = cq.multiplicity() - 1,
-                                cqpj = cqprime.multiplicity() - 1;
-                            double factor =
-                                cg->racah(cqpj, bdq, cqj, adq, aqpj, cdq);
-                            factor *= sqrt((cdq + 1) * (aqpj + 1)) *
-                                      (((adq + bdq - cdq) & 2) ? -1 : 1);
-                            if (cja)
+                            double factor = 1.0;
+                            if (!CG<S>::abelian) {
+                                int aqpj = aqprime.multiplicity() - 1,
+                                    cqj = cq.multiplicity() - 1,
+                                    cqpj = cqprime.multiplicity() - 1;
+                                factor =
+                                    cg->racah(cqpj, bdq, cqj, adq, aqpj, cdq);
+                                factor *= sqrt((cdq + 1) * (aqpj + 1)) *
+                                          (((adq + bdq - cdq) & 2) ? -1 : 1);
+                            }
+                            if (!CG<S>::abelian && cja)
                                 factor *= cg->transpose_cg(
                                     (-sadq).twos(), cq.twos(), aqprime.twos());
-                            if (cjb)
+                            if (!CG<S>::abelian && cjb)
                                 factor *= cg->transpose_cg((-sbdq).twos(),
                                                            aqprime.twos(),
                                                            cqprime.twos());
@@ -757,6 +864,48 @@ template <typename S> struct OperatorFunctions {
         if (noise != 0)
             tmp.deallocate();
     }
+    // Sum of products with transposed tensors (without noise):
+    // [b] += sum_i [a_i] x [a_i]^T or [a_i]^T x [a_i]
+    // All block products are performed as batched DGEMM. Products adding to
+    // the same block of b are put in different batches
+    static void
+    trans_product_batch(const vector<shared_ptr<SparseMatrix<S>>> &as,
+                        const shared_ptr<SparseMatrix<S>> &b,
+                        bool trace_right) {
+        assert(b->get_type() == SparseMatrixTypes::Normal);
+        assert(b->factor == 1.0);
+        // for each block of b: (index of a, block in a)
+        vector<vector<pair<int, int>>> prods(b->info->n);
+        size_t max_prods = 0;
+        for (int i = 0; i < (int)as.size(); i++) {
+            const shared_ptr<SparseMatrix<S>> &a = as[i];
+            assert(a->get_type() == SparseMatrixTypes::Normal);
+            if (abs(a->factor * a->factor) < TINY)
+                continue;
+            for (int ia = 0; ia < a->info->n; ia++) {
+                S qb = trace_right
+                           ? a->info->quanta[ia].get_bra(a->info->delta_quantum)
+                           : -a->info->quanta[ia].get_ket();
+                int ib = b->info->find_state(qb);
+                if (ib == -1)
+                    continue;
+                prods[ib].push_back(make_pair(i, ia));
+                max_prods = max(max_prods, prods[ib].size());
+            }
+        }
+        BatchGEMMSeq seq(0, SeqTypes::Simple);
+        for (size_t k = 0; k < max_prods; k++) {
+            for (int ib = 0; ib < b->info->n; ib++)
+                if (k < prods[ib].size()) {
+                    const shared_ptr<SparseMatrix<S>> &a =
+                        as[prods[ib][k].first];
+                    const int ia = prods[ib][k].second;
+                    seq.multiply((*a)[ia], !trace_right, (*a)[ia], trace_right,
+                                 (*b)[ib], a->factor * a->factor, 1.0);
+                }
+            seq.simple_perform();
+        }
+    }
 };
 
 } // namespace block2
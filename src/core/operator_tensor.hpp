@@ -166,6 +166,7 @@ template <typename S> struct OperatorTensor {
                 mat->info = pmat->info;
                 mat->factor = pmat->factor;
                 mat->sparse_type = pmat->sparse_type;
+                mat->total_memory = pmat->total_memory;
                 r->ops[p.first] = mat;
             } else if (p.second->get_type() == SparseMatrixTypes::Delayed)
                 r->ops[p.first] =
@@ -25,12 +25,16 @@
 #include "allocator.hpp"
 #include "csr_operator_functions.hpp"
 #include "csr_sparse_matrix.hpp"
+#include "fp_codec.hpp"
 #include "mpi.h"
 #include "parallel_rule.hpp"
 #include "sparse_matrix.hpp"
 #include <chrono>
+#include <fstream>
 #include <ios>
 #include <memory>
+#include <numeric>
+#include <sstream>
 #include <thread>
 
 using namespace std;
@@ -85,7 +89,60 @@ template <typename S> struct MPICommunicator : ParallelCommunicator<S> {
     Timer _t;
     const size_t chunk_size = 1 << 30;
     vector<MPI_Request> reqs;
-    MPI_Comm comm;
+    MPI_Comm comm, node_comm = MPI_COMM_NULL;
+    // If not nullptr, double arrays with at least compress_min_len elements
+    // are compressed in broadcast and reduce_sum
+    // With a nonzero codec->prec, the results are only accurate to prec
+    shared_ptr<FPCodec<double>> codec = nullptr;
+    size_t compress_min_len = (size_t)1 << 16;
+    // If true, allreduce_sum and reduce_sum of double arrays with at least
+    // hierarchical_min_len elements are done within each node first, and
+    // then only between one leader proc of each node
+    bool hierarchical = false;
+    size_t hierarchical_min_len = (size_t)1 << 12;
+    // If true, allreduce_sum and reduce_sum of double arrays are summed in
+    // the rank order, so that the results do not depend on the reduction
+    // algorithm chosen by the MPI library (takes precedence over
+    // codec and hierarchical)
+    bool reproducible = false;
+    // If nonzero, groups of ranks_per_node consecutive ranks are used as
+    // nodes in hierarchical reductions, instead of shared memory nodes
+    int ranks_per_node = 0;
+    // Communicators of the hierarchy: procs on the same node, and leaders
+    // (first proc) of all nodes (MPI_COMM_NULL on other procs)
+    MPI_Comm hier_node_comm = MPI_COMM_NULL, hier_leader_comm = MPI_COMM_NULL;
+    // Node index and rank in node of each proc
+    vector<int> hier_nodes, hier_node_ranks;
+    // Communication event, with time in seconds since start_trace
+    struct TraceEvent {
+        const char *name;
+        size_t bytes;
+        double t_start, t_end;
+        int sweep, site;
+    };
+    // If true, every communication is recorded in trace_events
+    bool trace = false;
+    double trace_t0 = 0;
+    vector<TraceEvent> trace_events;
+    // Records the enclosing communication when it goes out of scope
+    // (also as an event of the thread tracer, if enabled)
+    struct TraceScope {
+        MPICommunicator *comm;
+        const char *name;
+        size_t bytes;
+        double t_start;
+        TracerScope tscope;
+        TraceScope(MPICommunicator *comm, const char *name, size_t bytes)
+            : comm(comm), name(name), bytes(bytes),
+              t_start(comm->trace ? MPI_Wtime() : 0), tscope(name, bytes) {}
+        ~TraceScope() {
+            if (comm->trace)
+                comm->trace_events.push_back(TraceEvent{
+                    name, bytes, t_start - comm->trace_t0,
+                    MPI_Wtime() - comm->trace_t0, comm->trace_sweep,
+                    comm->trace_site});
+        }
+    };
     MPICommunicator(int root = 0)
         : ParallelCommunicator<S>(MPI::size(), MPI::rank(), root) {
         para_type = ParallelTypes::Distributed;
@@ -96,6 +153,15 @@ template <typename S> struct MPICommunicator : ParallelCommunicator<S> {
         para_type = ParallelTypes::Distributed;
     }
     ~MPICommunicator() override {
+        for (MPI_Comm *c : {&hier_leader_comm, &hier_node_comm})
+            if (*c != MPI_COMM_NULL) {
+                int ierr = MPI_Comm_free(c);
+                assert(ierr == 0);
+            }
+        if (node_comm != MPI_COMM_NULL) {
+            int ierr = MPI_Comm_free(&node_comm);
+            assert(ierr == 0);
+        }
         if (comm != MPI_COMM_WORLD && comm != MPI_COMM_NULL) {
             int ierr = MPI_Comm_free(&comm);
             assert(ierr == 0);
@@ -117,6 +183,7 @@ template <typename S> struct MPICommunicator : ParallelCommunicator<S> {
         return make_shared<MPICommunicator<S>>(icomm, isize, jrank);
     }
     void barrier() override {
+        TraceScope _ts(this, "barrier", 0);
         if (comm == MPI_COMM_NULL)
             return;
         _t.get_time();
@@ -124,7 +191,87 @@ template <typename S> struct MPICommunicator : ParallelCommunicator<S> {
         assert(ierr == 0);
         tidle += _t.get_time();
     }
+    // Send or receive data in pieces of chunk_size
+    void send_chunked(double *data, size_t len, int dest, int tag) {
+        for (size_t offset = 0; offset < len; offset += chunk_size) {
+            int ierr = MPI_Send(data + offset, min(chunk_size, len - offset),
+                                MPI_DOUBLE, dest, tag, comm);
+            assert(ierr == 0);
+        }
+    }
+    void recv_chunked(double *data, size_t len, int source, int tag) {
+        for (size_t offset = 0; offset < len; offset += chunk_size) {
+            int ierr = MPI_Recv(data + offset, min(chunk_size, len - offset),
+                                MPI_DOUBLE, source, tag, comm,
+                                MPI_STATUS_IGNORE);
+            assert(ierr == 0);
+        }
+    }
+    void compressed_broadcast(double *data, size_t len, int owner) {
+        _t.get_time();
+        vector<double> cpsd;
+        unsigned long long cplen = 0;
+        if (rank == owner)
+            cplen = codec->encode_array(data, len, cpsd);
+        int ierr = MPI_Bcast(&cplen, 1, MPI_UNSIGNED_LONG_LONG, owner, comm);
+        assert(ierr == 0);
+        cpsd.resize(cplen);
+        for (size_t offset = 0; offset < cplen; offset += chunk_size) {
+            ierr = MPI_Bcast(cpsd.data() + offset,
+                             min(chunk_size, (size_t)cplen - offset),
+                             MPI_DOUBLE, owner, comm);
+            assert(ierr == 0);
+        }
+        // with lossy compression, the owner also uses the decoded data,
+        // so that all procs have the same data
+        if (rank != owner || codec->prec != 0)
+            codec->decode_array(cpsd.data(), len, data);
+        tcomm += _t.get_time();
+    }
+    // Binomial tree reduction, where the partial sums are
+    // compressed before sending
+    // data is not changed on procs other than owner
+    void compressed_reduce_sum(double *data, size_t len, int owner) {
+        _t.get_time();
+        const int vrank = (rank - owner + size) % size;
+        vector<double> cpsd, rdata, psum;
+        double *sum = data;
+        for (int step = 1; step < size; step <<= 1) {
+            if (vrank & step) {
+                unsigned long long cplen = codec->encode_array(sum, len, cpsd);
+                int dest = (vrank - step + owner) % size;
+                int ierr = MPI_Send(&cplen, 1, MPI_UNSIGNED_LONG_LONG, dest, 12,
+                                    comm);
+                assert(ierr == 0);
+                send_chunked(cpsd.data(), cplen, dest, 13);
+                break;
+            } else if (vrank + step < size) {
+                unsigned long long cplen;
+                int source = (vrank + step + owner) % size;
+                int ierr = MPI_Recv(&cplen, 1, MPI_UNSIGNED_LONG_LONG, source,
+                                    12, comm, MPI_STATUS_IGNORE);
+                assert(ierr == 0);
+                cpsd.resize(cplen);
+                recv_chunked(cpsd.data(), cplen, source, 13);
+                rdata.resize(len);
+                codec->decode_array(cpsd.data(), len, rdata.data());
+                if (rank != owner && sum == data) {
+                    psum = vector<double>(data, data + len);
+                    sum = psum.data();
+                }
+                int ntg = threading->activate_global();
+#pragma omp parallel for schedule(static) num_threads(ntg)
+                for (int64_t i = 0; i < (int64_t)len; i++)
+                    sum[i] += rdata[i];
+                threading->activate_normal();
+            }
+        }
+        tcomm += _t.get_time();
+    }
     void broadcast(double *data, size_t len, int owner) override {
+        TraceScope _ts(this, "broadcast", sizeof(double) * len);
+        if (codec != nullptr && len >= compress_min_len && size > 1)
+            return compressed_broadcast(data, len, owner);
         _t.get_time();
         for (size_t offset = 0; offset < len; offset += chunk_size) {
             int ierr = MPI_Bcast(data + offset, min(chunk_size, len - offset),
@@ -134,6 +281,7 @@ template <typename S> struct MPICommunicator : ParallelCommunicator<S> {
         tcomm += _t.get_time();
     }
     void broadcast(complex<double> *data, size_t len, int owner) override {
+        TraceScope _ts(this, "broadcast", sizeof(complex<double>) * len);
         _t.get_time();
         for (size_t offset = 0; offset < len; offset += chunk_size) {
             int ierr = MPI_Bcast((double *)(data + offset),
@@ -144,6 +292,7 @@ template <typename S> struct MPICommunicator : ParallelCommunicator<S> {
         tcomm += _t.get_time();
     }
     void ibroadcast(double *data, size_t len, int owner) override {
+        TraceScope _ts(this, "ibroadcast", sizeof(double) * len);
         _t.get_time();
         for (size_t offset = 0; offset < len; offset += chunk_size) {
             MPI_Request req;
@@ -155,12 +304,14 @@ template <typename S> struct MPICommunicator : ParallelCommunicator<S> {
         tcomm += _t.get_time();
     }
     void broadcast(int *data, size_t len, int owner) override {
+        TraceScope _ts(this, "broadcast", sizeof(int) * len);
         _t.get_time();
         int ierr = MPI_Bcast(data, len, MPI_INT, owner, comm);
         assert(ierr == 0);
         tcomm += _t.get_time();
     }
     void broadcast(long long int *data, size_t len, int owner) override {
+        TraceScope _ts(this, "broadcast", sizeof(long long int) * len);
         _t.get_time();
         int ierr = MPI_Bcast(data, len, MPI_LONG_LONG, owner, comm);
         assert(ierr == 0);
@@ -170,6 +321,7 @@ template <typename S> struct MPICommunicator : ParallelCommunicator<S> {
         if (mat->get_type() == SparseMatrixTypes::Normal)
             broadcast(mat->data, mat->total_memory, owner);
         else if (mat->get_type() == SparseMatrixTypes::CSR) {
+            TraceScope _ts(this, "broadcast_csr", 0);
             _t.get_time();
             // remove mkl pointer
             // csr sparse matrix cannot be allocated by mkl sparse matrix
@@ -228,7 +380,157 @@ template <typename S> struct MPICommunicator : ParallelCommunicator<S> {
         } else
             assert(false);
     }
+    // Build the node and leader communicators for hierarchical reductions
+    // Returns false if there is no more than one proc on each node
+    bool init_hierarchy() {
+        int ierr;
+        if (hier_node_comm == MPI_COMM_NULL) {
+            if (ranks_per_node != 0)
+                ierr = MPI_Comm_split(comm, rank / ranks_per_node, rank,
+                                      &hier_node_comm);
+            else
+                ierr = MPI_Comm_split_type(comm, MPI_COMM_TYPE_SHARED, rank,
+                                           MPI_INFO_NULL, &hier_node_comm);
+            assert(ierr == 0);
+            int info[2] = {0, 0};
+            ierr = MPI_Comm_rank(hier_node_comm, &info[1]);
+            assert(ierr == 0);
+            ierr = MPI_Comm_split(comm, info[1] == 0 ? 0 : MPI_UNDEFINED, rank,
+                                  &hier_leader_comm);
+            assert(ierr == 0);
+            if (info[1] == 0) {
+                ierr = MPI_Comm_rank(hier_leader_comm, &info[0]);
+                assert(ierr == 0);
+            }
+            ierr = MPI_Bcast(&info[0], 1, MPI_INT, 0, hier_node_comm);
+            assert(ierr == 0);
+            vector<int> infos(size * 2);
+            ierr = MPI_Allgather(info, 2, MPI_INT, infos.data(), 2, MPI_INT,
+                                 comm);
+            assert(ierr == 0);
+            hier_nodes.resize(size), hier_node_ranks.resize(size);
+            for (int i = 0; i < size; i++)
+                hier_nodes[i] = infos[i * 2], hier_node_ranks[i] = infos[i * 2 + 1];
+        }
+        return *max_element(hier_node_ranks.begin(), hier_node_ranks.end()) !=
+               0;
+    }
+    // Reduce within the node to the node leader, then between
+    // node leaders to the leader of the node of owner (all if owner = -1)
+    void hierarchical_reduce(double *data, size_t len, int owner) {
+        const bool is_leader = hier_node_ranks[rank] == 0;
+        for (size_t offset = 0; offset < len; offset += chunk_size) {
+            int ierr = MPI_Reduce(is_leader ? MPI_IN_PLACE : data + offset,
+                                  data + offset, min(chunk_size, len - offset),
+                                  MPI_DOUBLE, MPI_SUM, 0, hier_node_comm);
+            assert(ierr == 0);
+        }
+        if (!is_leader)
+            return;
+        const int lowner = owner == -1 ? -1 : hier_nodes[owner];
+        for (size_t offset = 0; offset < len; offset += chunk_size) {
+            int ierr;
+            if (owner == -1)
+                ierr = MPI_Allreduce(MPI_IN_PLACE, data + offset,
+                                     min(chunk_size, len - offset), MPI_DOUBLE,
+                                     MPI_SUM, hier_leader_comm);
+            else
+                ierr = MPI_Reduce(hier_nodes[rank] == lowner ? MPI_IN_PLACE
+                                                             : data + offset,
+                                  data + offset, min(chunk_size, len - offset),
+                                  MPI_DOUBLE, MPI_SUM, lowner, hier_leader_comm);
+            assert(ierr == 0);
+        }
+    }
+    void hierarchical_allreduce_sum(double *data, size_t len) {
+        _t.get_time();
+        hierarchical_reduce(data, len, -1);
+        for (size_t offset = 0; offset < len; offset += chunk_size) {
+            int ierr = MPI_Bcast(data + offset, min(chunk_size, len - offset),
+                                 MPI_DOUBLE, 0, hier_node_comm);
+            assert(ierr == 0);
+        }
+        tcomm += _t.get_time();
+    }
+    void hierarchical_reduce_sum(double *data, size_t len, int owner) {
+        _t.get_time();
+        // node leaders other than owner reduce a copy of data
+        const bool is_leader = hier_node_ranks[rank] == 0;
+        vector<double> pdata;
+        if (is_leader && rank != owner)
+            pdata = vector<double>(data, data + len);
+        hierarchical_reduce(pdata.size() != 0 ? pdata.data() : data, len,
+                            owner);
+        if (hier_node_ranks[owner] != 0 &&
+            hier_nodes[rank] == hier_nodes[owner]) {
+            if (is_leader)
+                send_chunked(pdata.data(), len, owner, 14);
+            else if (rank == owner) {
+                int leader = 0;
+                while (hier_nodes[leader] != hier_nodes[owner] ||
+                       hier_node_ranks[leader] != 0)
+                    leader++;
+                recv_chunked(data, len, leader, 14);
+            }
+        }
+        tcomm += _t.get_time();
+    }
+    // Each proc sums one block of the arrays of all procs in the rank order
+    // (as in a reduce-scatter), then the blocks are gathered to owner
+    // (all if owner = -1). Same communication volume as MPI_Allreduce
+    // data is not changed on procs other than owner
+    void reproducible_reduce_sum(double *data, size_t len, int owner) {
+        _t.get_time();
+        vector<int> counts(size), displs(size), rcounts(size), rdispls(size);
+        vector<double> rdata, psum;
+        for (size_t offset = 0; offset < len; offset += chunk_size) {
+            const size_t clen = min(chunk_size, len - offset);
+            for (int i = 0; i < size; i++) {
+                displs[i] = (int)(clen * i / size);
+                counts[i] = (int)(clen * (i + 1) / size) - displs[i];
+            }
+            const int mc = counts[rank];
+            for (int i = 0; i < size; i++)
+                rcounts[i] = mc, rdispls[i] = mc * i;
+            rdata.resize((size_t)mc * size);
+            int ierr = MPI_Alltoallv(data + offset, counts.data(),
+                                     displs.data(), MPI_DOUBLE, rdata.data(),
+                                     rcounts.data(), rdispls.data(),
+                                     MPI_DOUBLE, comm);
+            assert(ierr == 0);
+            double *sum = data + offset + displs[rank];
+            if (owner != -1 && rank != owner) {
+                psum.resize(mc);
+                sum = psum.data();
+            }
+            int ntg = threading->activate_global();
+#pragma omp parallel for schedule(static) num_threads(ntg)
+            for (int k = 0; k < mc; k++) {
+                double x = rdata[k];
+                for (int i = 1; i < size; i++)
+                    x += rdata[(size_t)mc * i + k];
+                sum[k] = x;
+            }
+            threading->activate_normal();
+            if (owner == -1)
+                ierr = MPI_Allgatherv(MPI_IN_PLACE, 0, MPI_DATATYPE_NULL,
+                                      data + offset, counts.data(),
+                                      displs.data(), MPI_DOUBLE, comm);
+            else
+                ierr = MPI_Gatherv(rank == owner ? MPI_IN_PLACE : sum, mc,
+                                   MPI_DOUBLE, data + offset, counts.data(),
+                                   displs.data(), MPI_DOUBLE, owner, comm);
+            assert(ierr == 0);
+        }
+        tcomm += _t.get_time();
+    }
     void allreduce_sum(double *data, size_t len) override {
+        TraceScope _ts(this, "allreduce_sum", sizeof(double) * len);
+        if (reproducible && size > 1)
+            return reproducible_reduce_sum(data, len, -1);
+        if (hierarchical && len >= hierarchical_min_len && size > 1 &&
+            init_hierarchy())
+            return hierarchical_allreduce_sum(data, len);
         _t.get_time();
         for (size_t offset = 0; offset < len; offset += chunk_size) {
             int ierr = MPI_Allreduce(MPI_IN_PLACE, data + offset,
@@ -239,6 +541,9 @@ template <typename S> struct MPICommunicator : ParallelCommunicator<S> {
         tcomm += _t.get_time();
     }
     void allreduce_sum(complex<double> *data, size_t len) override {
+        TraceScope _ts(this, "allreduce_sum", sizeof(complex<double>) * len);
+        if (reproducible && size > 1)
+            return reproducible_reduce_sum((double *)data, len * 2, -1);
         _t.get_time();
         for (size_t offset = 0; offset < len; offset += chunk_size) {
             int ierr = MPI_Allreduce(MPI_IN_PLACE, (double *)(data + offset),
@@ -248,7 +553,21 @@ template <typename S> struct MPICommunicator : ParallelCommunicator<S> {
         }
         tcomm += _t.get_time();
     }
+    void iallreduce_sum(double *data, size_t len) override {
+        TraceScope _ts(this, "iallreduce_sum", sizeof(double) * len);
+        _t.get_time();
+        for (size_t offset = 0; offset < len; offset += chunk_size) {
+            MPI_Request req;
+            int ierr = MPI_Iallreduce(MPI_IN_PLACE, data + offset,
+                                      min(chunk_size, len - offset),
+                                      MPI_DOUBLE, MPI_SUM, comm, &req);
+            assert(ierr == 0);
+            reqs.push_back(req);
+        }
+        tcomm += _t.get_time();
+    }
     void allreduce_max(double *data, size_t len) override {
+        TraceScope _ts(this, "allreduce_max", sizeof(double) * len);
         _t.get_time();
         for (size_t offset = 0; offset < len; offset += chunk_size) {
             int ierr = MPI_Allreduce(MPI_IN_PLACE, data + offset,
@@ -262,6 +581,7 @@ template <typename S> struct MPICommunicator : ParallelCommunicator<S> {
         allreduce_max(vs.data(), vs.size());
     }
     void allreduce_min(double *data, size_t len) override {
+        TraceScope _ts(this, "allreduce_min", sizeof(double) * len);
         _t.get_time();
         for (size_t offset = 0; offset < len; offset += chunk_size) {
             int ierr = MPI_Allreduce(MPI_IN_PLACE, data + offset,
@@ -292,6 +612,7 @@ template <typename S> struct MPICommunicator : ParallelCommunicator<S> {
         }
     }
     void allreduce_sum(vector<S> &vs) override {
+        TraceScope _ts(this, "allgather_quanta", sizeof(S) * vs.size());
         _t.get_time();
         uint32_t sz = (uint32_t)vs.size(), maxsz;
         int ierr = MPI_Allreduce(&sz, &maxsz, 1, MPI_UINT32_T, MPI_MAX, comm);
@@ -308,7 +629,149 @@ template <typename S> struct MPICommunicator : ParallelCommunicator<S> {
         vs = vsrecv;
         tcomm += _t.get_time();
     }
+    void fetch(const vector<double *> &datas, const vector<size_t> &lens,
+               const vector<int> &owners) override {
+        size_t tlen = 0;
+        for (size_t i = 0; i < datas.size(); i++)
+            if (owners[i] != rank && datas[i] != nullptr)
+                tlen += lens[i];
+        TraceScope _ts(this, "fetch", sizeof(double) * tlen);
+        if (size == 1)
+            return;
+        _t.get_time();
+        // owned arrays are attached to a dynamic window, and their
+        // addresses are sent to all procs
+        MPI_Win win;
+        int ierr = MPI_Win_create_dynamic(MPI_INFO_NULL, comm, &win);
+        assert(ierr == 0);
+        vector<MPI_Aint> addrs(datas.size(), 0);
+        for (size_t i = 0; i < datas.size(); i++)
+            if (owners[i] == rank && lens[i] != 0) {
+                ierr = MPI_Win_attach(win, datas[i], sizeof(double) * lens[i]);
+                assert(ierr == 0);
+                ierr = MPI_Get_address(datas[i], &addrs[i]);
+                assert(ierr == 0);
+            }
+        ierr = MPI_Allreduce(MPI_IN_PLACE, addrs.data(), (int)addrs.size(),
+                             MPI_AINT, MPI_SUM, comm);
+        assert(ierr == 0);
+        // owners do not take part in the gets
+        ierr = MPI_Win_lock_all(MPI_MODE_NOCHECK, win);
+        assert(ierr == 0);
+        for (size_t i = 0; i < datas.size(); i++)
+            if (owners[i] != rank && datas[i] != nullptr)
+                for (size_t offset = 0; offset < lens[i];
+                     offset += chunk_size) {
+                    ierr = MPI_Get(datas[i] + offset,
+                                   min(chunk_size, lens[i] - offset),
+                                   MPI_DOUBLE, owners[i],
+                                   addrs[i] + sizeof(double) * offset,
+                                   min(chunk_size, lens[i] - offset),
+                                   MPI_DOUBLE, win);
+                    assert(ierr == 0);
+                }
+        ierr = MPI_Win_unlock_all(win);
+        assert(ierr == 0);
+        // owned arrays must stay attached until all gets are complete
+        ierr = MPI_Barrier(comm);
+        assert(ierr == 0);
+        for (size_t i = 0; i < datas.size(); i++)
+            if (owners[i] == rank && lens[i] != 0) {
+                ierr = MPI_Win_detach(win, datas[i]);
+                assert(ierr == 0);
+            }
+        ierr = MPI_Win_free(&win);
+        assert(ierr == 0);
+        tcomm += _t.get_time();
+    }
+    void dynamic_for(size_t n, size_t chunk,
+                     const function<void(size_t, size_t)> &f) override {
+        TraceScope _ts(this, "dynamic_for", 0);
+        if (size == 1) {
+            for (size_t i = 0; i < n; i += chunk)
+                f(i, min(n, i + chunk));
+            return;
+        }
+        Timer t;
+        t.get_time();
+        // the index of the next task is a counter on root
+        long long *counter;
+        MPI_Win win;
+        int ierr = MPI_Win_allocate(rank == root ? sizeof(long long) : 0,
+                                    sizeof(long long), MPI_INFO_NULL, comm,
+                                    &counter, &win);
+        assert(ierr == 0);
+        if (rank == root) {
+            ierr = MPI_Win_lock(MPI_LOCK_EXCLUSIVE, root, 0, win);
+            assert(ierr == 0);
+            *counter = 0;
+            ierr = MPI_Win_unlock(root, win);
+            assert(ierr == 0);
+        }
+        ierr = MPI_Barrier(comm);
+        assert(ierr == 0);
+        ierr = MPI_Win_lock_all(0, win);
+        assert(ierr == 0);
+        const long long inc = (long long)chunk;
+        for (;;) {
+            long long start;
+            ierr = MPI_Fetch_and_op(&inc, &start, MPI_LONG_LONG, root, 0,
+                                    MPI_SUM, win);
+            assert(ierr == 0);
+            ierr = MPI_Win_flush(root, win);
+            assert(ierr == 0);
+            if ((size_t)start >= n)
+                break;
+            tcomm += t.get_time();
+            f((size_t)start, min(n, (size_t)start + chunk));
+            t.get_time();
+        }
+        ierr = MPI_Win_unlock_all(win);
+        assert(ierr == 0);
+        ierr = MPI_Win_free(&win);
+        assert(ierr == 0);
+        tcomm += t.get_time();
+    }
+    void write_ordered(const string &filename, const string &data) override {
+        TraceScope _ts(this, "write_ordered", data.size());
+        _t.get_time();
+        vector<uint64_t> lens(size);
+        lens[rank] = data.size();
+        int ierr = MPI_Allgather(MPI_IN_PLACE, 1, MPI_UINT64_T, lens.data(), 1,
+                                 MPI_UINT64_T, comm);
+        assert(ierr == 0);
+        MPI_Offset offset = sizeof(int) + sizeof(uint64_t) * size;
+        for (int i = 0; i < rank; i++)
+            offset += lens[i];
+        MPI_File fh;
+        ierr = MPI_File_open(comm, filename.c_str(),
+                             MPI_MODE_CREATE | MPI_MODE_WRONLY, MPI_INFO_NULL,
+                             &fh);
+        if (ierr != 0)
+            throw runtime_error("MPICommunicator::write_ordered on '" +
+                                filename + "' failed.");
+        ierr = MPI_File_set_size(fh, 0);
+        assert(ierr == 0);
+        if (rank == root) {
+            ierr = MPI_File_write_at(fh, 0, &size, 1, MPI_INT,
+                                     MPI_STATUS_IGNORE);
+            assert(ierr == 0);
+            ierr = MPI_File_write_at(fh, sizeof(int), lens.data(), size,
+                                     MPI_UINT64_T, MPI_STATUS_IGNORE);
+            assert(ierr == 0);
+        }
+        for (size_t i = 0; i < data.size(); i += chunk_size) {
+            ierr = MPI_File_write_at(fh, offset + i, data.data() + i,
+                                     min(chunk_size, data.size() - i),
+                                     MPI_CHAR, MPI_STATUS_IGNORE);
+            assert(ierr == 0);
+        }
+        ierr = MPI_File_close(&fh);
+        assert(ierr == 0);
+        tcomm += _t.get_time();
+    }
     void allreduce_logical_or(bool &v) override {
+        TraceScope _ts(this, "allreduce_logical_or", sizeof(bool));
         _t.get_time();
         int ierr =
             MPI_Allreduce(MPI_IN_PLACE, &v, 1, MPI_C_BOOL, MPI_LOR, comm);
@@ -316,6 +779,7 @@ template <typename S> struct MPICommunicator : ParallelCommunicator<S> {
         tcomm += _t.get_time();
     }
     void allreduce_logical_or(char *data, size_t len) override {
+        TraceScope _ts(this, "allreduce_logical_or", len);
         _t.get_time();
         int ierr =
             MPI_Allreduce(MPI_IN_PLACE, data, len, MPI_CHAR, MPI_LOR, comm);
@@ -323,6 +787,7 @@ template <typename S> struct MPICommunicator : ParallelCommunicator<S> {
         tcomm += _t.get_time();
     }
     void allreduce_xor(char *data, size_t len) override {
+        TraceScope _ts(this, "allreduce_xor", len);
         _t.get_time();
         int ierr =
             MPI_Allreduce(MPI_IN_PLACE, data, len, MPI_CHAR, MPI_BXOR, comm);
@@ -330,6 +795,14 @@ template <typename S> struct MPICommunicator : ParallelCommunicator<S> {
         tcomm += _t.get_time();
     }
     void reduce_sum(double *data, size_t len, int owner) override {
+        TraceScope _ts(this, "reduce_sum", sizeof(double) * len);
+        if (reproducible && size > 1)
+            return reproducible_reduce_sum(data, len, owner);
+        if (codec != nullptr && len >= compress_min_len && size > 1)
+            return compressed_reduce_sum(data, len, owner);
+        if (hierarchical && len >= hierarchical_min_len && size > 1 &&
+            init_hierarchy())
+            return hierarchical_reduce_sum(data, len, owner);
         _t.get_time();
         for (size_t offset = 0; offset < len; offset += chunk_size) {
             int ierr = MPI_Reduce(rank == owner ? MPI_IN_PLACE : data + offset,
@@ -340,6 +813,7 @@ template <typename S> struct MPICommunicator : ParallelCommunicator<S> {
         tcomm += _t.get_time();
     }
     void ireduce_sum(double *data, size_t len, int owner) override {
+        TraceScope _ts(this, "ireduce_sum", sizeof(double) * len);
         _t.get_time();
         for (size_t offset = 0; offset < len; offset += chunk_size) {
             MPI_Request req;
@@ -352,6 +826,7 @@ template <typename S> struct MPICommunicator : ParallelCommunicator<S> {
         tcomm += _t.get_time();
     }
     void reduce_sum(uint64_t *data, size_t len, int owner) override {
+        TraceScope _ts(this, "reduce_sum", sizeof(uint64_t) * len);
         _t.get_time();
         int ierr = MPI_Reduce(rank == owner ? MPI_IN_PLACE : data, data, len,
                               MPI_UINT64_T, MPI_SUM, owner, comm);
@@ -371,6 +846,7 @@ template <typename S> struct MPICommunicator : ParallelCommunicator<S> {
         if (mat->get_type() == SparseMatrixTypes::Normal)
             return reduce_sum(mat->data, mat->total_memory, owner);
         else if (mat->get_type() == SparseMatrixTypes::CSR) {
+            TraceScope _ts(this, "reduce_sum_csr", 0);
             _t.get_time();
             // remove mkl pointer
             shared_ptr<CSRSparseMatrix<S>> cmat =
@@ -439,11 +915,143 @@ template <typename S> struct MPICommunicator : ParallelCommunicator<S> {
             tcomm += _t.get_time();
         }
     }
+    void reduce_scatter_sum(double *data,
+                            const vector<size_t> &counts) override {
+        TraceScope _ts(this, "reduce_scatter_sum",
+                       sizeof(double) *
+                           accumulate(counts.begin(), counts.end(), (size_t)0));
+        assert((int)counts.size() == size);
+        size_t len = 0, offset = 0;
+        for (int i = 0; i < size; i++)
+            len += counts[i], offset += i < rank ? counts[i] : 0;
+        // large vectors are reduced to each owner in chunks
+        if (len > chunk_size) {
+            for (int i = 0, j = 0; i < size; j += counts[i++])
+                reduce_sum(data + j, counts[i], i);
+            return;
+        }
+        _t.get_time();
+        vector<int> icounts(counts.begin(), counts.end());
+        // the reduced part is stored at the beginning of data
+        int ierr = MPI_Reduce_scatter(MPI_IN_PLACE, data, icounts.data(),
+                                      MPI_DOUBLE, MPI_SUM, comm);
+        assert(ierr == 0);
+        if (offset != 0)
+            memmove(data + offset, data, sizeof(double) * counts[rank]);
+        tcomm += _t.get_time();
+    }
+    void allgather(double *data, const vector<size_t> &counts) override {
+        TraceScope _ts(this, "allgather", sizeof(double) * accumulate(counts.begin(), counts.end(), (size_t)0));
+        assert((int)counts.size() == size);
+        size_t len = 0;
+        for (int i = 0; i < size; i++)
+            len += counts[i];
+        if (len > chunk_size) {
+            for (int i = 0, j = 0; i < size; j += counts[i++])
+                broadcast(data + j, counts[i], i);
+            return;
+        }
+        _t.get_time();
+        vector<int> icounts(counts.begin(), counts.end()), displs(size, 0);
+        for (int i = 1; i < size; i++)
+            displs[i] = displs[i - 1] + icounts[i - 1];
+        int ierr =
+            MPI_Allgatherv(MPI_IN_PLACE, 0, MPI_DATATYPE_NULL, data,
+                           icounts.data(), displs.data(), MPI_DOUBLE, comm);
+        assert(ierr == 0);
+        tcomm += _t.get_time();
+    }
+    // Clear trace_events and start recording (collective)
+    void start_trace() {
+        int ierr = MPI_Barrier(comm);
+        assert(ierr == 0);
+        trace_events.clear();
+        trace_t0 = MPI_Wtime();
+        trace = true;
+    }
+    // Stop recording and write the events of all procs as a Chrome trace
+    // (JSON) file on root, where each proc is shown as one process
+    // (collective)
+    void write_trace(const string &filename) {
+        trace = false;
+        stringstream ss;
+        ss << fixed << setprecision(3);
+        ss << "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":" << rank
+           << ",\"args\":{\"name\":\"rank " << rank << "\"}},\n";
+        for (auto &ev : trace_events)
+            ss << "{\"name\":\"" << ev.name << "\",\"ph\":\"X\",\"pid\":"
+               << rank << ",\"tid\":0,\"ts\":" << ev.t_start * 1E6
+               << ",\"dur\":" << (ev.t_end - ev.t_start) * 1E6
+               << ",\"args\":{\"bytes\":" << ev.bytes
+               << ",\"sweep\":" << ev.sweep << ",\"site\":" << ev.site
+               << "}},\n";
+        const string str = ss.str();
+        int len = (int)str.length(), ierr;
+        vector<int> lens(rank == root ? size : 0), displs;
+        ierr = MPI_Gather(&len, 1, MPI_INT, lens.data(), 1, MPI_INT, root,
+                          comm);
+        assert(ierr == 0);
+        vector<char> all;
+        if (rank == root) {
+            displs.resize(size + 1, 0);
+            for (int i = 0; i < size; i++)
+                displs[i + 1] = displs[i] + lens[i];
+            all.resize(displs[size]);
+        }
+        ierr = MPI_Gatherv(str.data(), len, MPI_CHAR, all.data(),
+                           lens.data(), displs.data(), MPI_CHAR, root, comm);
+        assert(ierr == 0);
+        if (rank == root) {
+            ofstream ofs(filename.c_str());
+            if (!ofs.good())
+                throw runtime_error("MPICommunicator::write_trace on '" +
+                                    filename + "' failed.");
+            // remove the last comma
+            ofs << "{\"traceEvents\":[\n";
+            ofs.write(all.data(), all.size() - 2);
+            ofs << "\n]}\n";
+            ofs.close();
+        }
+    }
+    int get_node_rank() override {
+        int ierr, node_rank;
+        if (node_comm == MPI_COMM_NULL) {
+            ierr = MPI_Comm_split_type(comm, MPI_COMM_TYPE_SHARED, rank,
+                                       MPI_INFO_NULL, &node_comm);
+            assert(ierr == 0);
+        }
+        ierr = MPI_Comm_rank(node_comm, &node_rank);
+        assert(ierr == 0);
+        return node_rank;
+    }
+    // The memory is owned by the first proc on the node, and the window
+    // is freed when the last reference on this proc is released
+    shared_ptr<double> allocate_node_shared(size_t len) override {
+        const int node_rank = get_node_rank();
+        MPI_Win win;
+        double *ptr;
+        int ierr = MPI_Win_allocate_shared(
+            node_rank == 0 ? (MPI_Aint)(len * sizeof(double)) : 0,
+            sizeof(double), MPI_INFO_NULL, node_comm, &ptr, &win);
+        assert(ierr == 0);
+        if (node_rank != 0) {
+            MPI_Aint wsz;
+            int disp;
+            ierr = MPI_Win_shared_query(win, 0, &wsz, &disp, &ptr);
+            assert(ierr == 0);
+        }
+        return shared_ptr<double>(ptr, [win](double *) mutable {
+            int ierr = MPI_Win_free(&win);
+            assert(ierr == 0);
+        });
+    }
     void waitall() override {
+        TraceScope _ts(this, "waitall", 0);
         _t.get_time();
         int ierr =
             MPI_Waitall((int)reqs.size(), reqs.data(), MPI_STATUSES_IGNORE);
         assert(ierr == 0);
+        reqs.clear();
         twait += _t.get_time();
     }
 };
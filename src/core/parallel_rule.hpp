@@ -22,6 +22,7 @@
 
 #include "expr.hpp"
 #include "sparse_matrix.hpp"
+#include <functional>
 #include <memory>
 
 using namespace std;
@@ -39,6 +40,8 @@ template <typename S> struct ParallelCommunicator {
     int size, rank, root, group, grank, gsize, ngroup;
     ParallelTypes para_type = ParallelTypes::Serial;
     double tcomm = 0.0, tidle = 0.0, twait = 0.0; // Runtime for communication
+    // Sweep and site of the current communications, for tracing
+    int trace_sweep = -1, trace_site = -1;
     ParallelCommunicator()
         : size(1), rank(0), root(0), group(0), grank(0), gsize(1), ngroup(1) {}
     ParallelCommunicator(int size, int rank, int root)
@@ -83,6 +86,9 @@ template <typename S> struct ParallelCommunicator {
         assert(size == 1);
     }
     virtual void allreduce_sum(vector<S> &vs) { assert(size == 1); }
+    virtual void iallreduce_sum(double *data, size_t len) {
+        assert(size == 1);
+    }
     virtual void allreduce_logical_or(char *data, size_t len) { assert(size == 1); }
     virtual void allreduce_xor(char *data, size_t len) { assert(size == 1); }
     virtual void allreduce_min(double *data, size_t len) { assert(size == 1); }
@@ -112,8 +118,172 @@ template <typename S> struct ParallelCommunicator {
     virtual void reduce_sum(uint64_t *data, size_t len, int owner) {
         assert(size == 1);
     }
+    // Sum of data[off_i : off_i + counts[i]] over procs is stored in the
+    // owned part (i = rank) of data; the other parts are left undefined
+    virtual void reduce_scatter_sum(double *data, const vector<size_t> &counts) {
+        assert(size == 1);
+    }
+    // data[off_i : off_i + counts[i]] of proc i is copied to all procs
+    virtual void allgather(double *data, const vector<size_t> &counts) {
+        assert(size == 1);
+    }
+    // datas[i] (of lens[i] doubles) of proc owners[i] is copied to all other
+    // procs where datas[i] is not nullptr, by one-sided gets from the owner
+    // The same lens and owners must be given on all procs
+    virtual void fetch(const vector<double *> &datas, const vector<size_t> &lens,
+                       const vector<int> &owners) {
+        assert(size == 1);
+    }
+    // Tasks [0, n) are taken in chunks of up to chunk tasks, each by the
+    // first free proc, and f(start, end) is called for each taken chunk
+    virtual void dynamic_for(size_t n, size_t chunk,
+                             const function<void(size_t, size_t)> &f) {
+        assert(size == 1);
+        for (size_t i = 0; i < n; i += chunk)
+            f(i, min(n, i + chunk));
+    }
+    // The data of all procs is written into one file in rank order, after
+    // a header with the number of procs and the data length of each proc
+    virtual void write_ordered(const string &filename, const string &data) {
+        assert(size == 1);
+        ofstream ofs(filename.c_str(), ios::binary);
+        if (!ofs.good())
+            throw runtime_error("ParallelCommunicator::write_ordered on '" +
+                                filename + "' failed.");
+        int nproc = 1;
+        uint64_t len = data.size();
+        ofs.write((char *)&nproc, sizeof(nproc));
+        ofs.write((char *)&len, sizeof(len));
+        ofs.write(data.data(), len);
+        if (!ofs.good())
+            throw runtime_error("ParallelCommunicator::write_ordered on '" +
+                                filename + "' failed.");
+        ofs.close();
+    }
     virtual void allreduce_logical_or(bool &v) { assert(size == 1); }
     virtual void waitall() { assert(size == 1); }
+    // Rank of this proc among the procs on the same node
+    virtual int get_node_rank() { return 0; }
+    // Memory of len doubles shared by all procs on the same node
+    // Must be allocated and released by all procs together
+    virtual shared_ptr<double> allocate_node_shared(size_t len) {
+        assert(size == 1);
+        return shared_ptr<double>(new double[len], default_delete<double[]>());
+    }
+};
+
+// Per-rank times of phases at each site of a sweep, gathered over procs
+// to report the load imbalance (max / mean over ranks) of each phase and
+// the critical path (slowest rank at each site) of the last phase
+struct LoadBalanceRecorder {
+    vector<string> phases;
+    vector<int> sites;
+    // local times, [site][phase]
+    vector<double> times;
+    // gathered times, [rank][site][phase]
+    vector<double> all_times;
+    int n_ranks = 1;
+    LoadBalanceRecorder(const vector<string> &phases = vector<string>())
+        : phases(phases) {}
+    void clear(const vector<string> &new_phases) {
+        phases = new_phases;
+        clear();
+    }
+    void clear() {
+        sites.clear(), times.clear(), all_times.clear();
+        n_ranks = 1;
+    }
+    void add(int site, const vector<double> &t) {
+        assert(t.size() == phases.size());
+        sites.push_back(site);
+        times.insert(times.end(), t.begin(), t.end());
+    }
+    // collective, all procs must have recorded the same sites
+    template <typename S>
+    void gather(const shared_ptr<ParallelCommunicator<S>> &comm) {
+        n_ranks = comm == nullptr ? 1 : comm->size;
+        const int rank = comm == nullptr ? 0 : comm->rank;
+        all_times.assign(times.size() * n_ranks, 0.0);
+        copy(times.begin(), times.end(),
+             all_times.begin() + times.size() * rank);
+        if (n_ranks != 1)
+            comm->allgather(all_times.data(),
+                            vector<size_t>(n_ranks, times.size()));
+    }
+    double time(int irank, int isite, int iph) const {
+        return all_times[(irank * sites.size() + isite) * phases.size() + iph];
+    }
+    // max / mean over ranks of the total time of a phase
+    double imbalance(int iph) const {
+        double mx = 0, sum = 0;
+        for (int ir = 0; ir < n_ranks; ir++) {
+            double t = 0;
+            for (size_t is = 0; is < sites.size(); is++)
+                t += time(ir, (int)is, iph);
+            mx = max(mx, t), sum += t;
+        }
+        return sum == 0 ? 1.0 : mx * n_ranks / sum;
+    }
+    // sum over sites of max (critical path) and mean over ranks of the
+    // time of a phase, and the slowest rank at each site
+    double critical_path(int iph, double &mean, vector<int> &slowest) const {
+        double cp = 0;
+        mean = 0;
+        slowest.assign(sites.size(), 0);
+        for (size_t is = 0; is < sites.size(); is++) {
+            for (int ir = 0; ir < n_ranks; ir++) {
+                const double t = time(ir, (int)is, iph);
+                mean += t / n_ranks;
+                if (t > time(slowest[is], (int)is, iph))
+                    slowest[is] = ir;
+            }
+            cp += time(slowest[is], (int)is, iph);
+        }
+        return cp;
+    }
+    // imbalance ratio of each phase, critical path of the last phase,
+    // the rank most often on it and the n_worst most imbalanced sites
+    string report(int n_worst = 3) const {
+        stringstream ss;
+        if (sites.size() == 0 || phases.size() == 0)
+            return ss.str();
+        ss << fixed << setprecision(3) << " | Load balance (" << n_ranks
+           << " ranks) | imbalance (max/mean):";
+        for (int ip = 0; ip < (int)phases.size(); ip++)
+            ss << " " << phases[ip] << " = " << imbalance(ip);
+        ss << endl;
+        const int iph = (int)phases.size() - 1;
+        double mean;
+        vector<int> slowest;
+        const double cp = critical_path(iph, mean, slowest);
+        vector<int> n_slowest(n_ranks, 0);
+        for (int r : slowest)
+            n_slowest[r]++;
+        const int rcp =
+            (int)(max_element(n_slowest.begin(), n_slowest.end()) -
+                  n_slowest.begin());
+        ss << " | Critical path (" << phases[iph] << ") = " << cp
+           << " | mean = " << mean
+           << " | efficiency = " << (cp == 0 ? 1.0 : mean / cp)
+           << " | slowest rank = " << rcp << " (" << n_slowest[rcp] << " / "
+           << sites.size() << " sites)" << endl;
+        vector<pair<double, int>> ratios;
+        for (size_t is = 0; is < sites.size(); is++) {
+            double mx = 0, sum = 0;
+            for (int ir = 0; ir < n_ranks; ir++)
+                mx = max(mx, time(ir, (int)is, iph)),
+                sum += time(ir, (int)is, iph);
+            ratios.push_back(make_pair(sum == 0 ? 1.0 : mx * n_ranks / sum,
+                                       (int)is));
+        }
+        sort(ratios.begin(), ratios.end(), greater<pair<double, int>>());
+        ss << " | Worst sites:";
+        for (int k = 0; k < min(n_worst, (int)ratios.size()); k++)
+            ss << " " << sites[ratios[k].second] << " (" << ratios[k].first
+               << ", rank " << slowest[ratios[k].second] << ")";
+        ss << endl;
+        return ss.str();
+    }
 };
 
 struct ParallelProperty {
@@ -124,7 +294,11 @@ struct ParallelProperty {
         : owner(owner), ptype(ptype) {}
 };
 
-enum struct ParallelCommTypes : uint8_t { None = 0, NonBlocking = 1 };
+enum struct ParallelCommTypes : uint8_t {
+    None = 0,
+    NonBlocking = 1,
+    OneSided = 2
+};
 
 enum struct ParallelRulePartitionTypes : uint8_t { Left, Right, Middle };
 
@@ -140,6 +314,15 @@ inline ParallelCommTypes operator|(ParallelCommTypes a, ParallelCommTypes b) {
 template <typename S> struct ParallelRule {
     shared_ptr<ParallelCommunicator<S>> comm;
     ParallelCommTypes comm_type;
+    // If true, the contraction and rotation time of each computed operator
+    // is passed to record_cost (only meaningful if GEMMs are not batched)
+    bool record_costs = false;
+    // If true, the expectation values of Number operators (NPDM elements)
+    // are computed by whichever proc is free, dynamic_chunk at a time,
+    // instead of by their owners. The rule must then make all operators in
+    // their expressions Repeated. Not used with ParallelTypes::NewScheme
+    bool dynamic_tasks = false;
+    size_t dynamic_chunk = 16;
     ParallelRule(const shared_ptr<ParallelCommunicator<S>> &comm,
                  ParallelCommTypes comm_type = ParallelCommTypes::None)
         : comm(comm), comm_type(comm_type) {
@@ -167,6 +350,9 @@ template <typename S> struct ParallelRule {
     operator()(const shared_ptr<OpElement<S>> &op) const {
         return ParallelProperty();
     }
+    // Measured cost of computing op on this proc
+    virtual void record_cost(const shared_ptr<OpElement<S>> &op,
+                             double cost) const {}
     bool is_root() const noexcept { return comm->rank == comm->root; }
     bool available(const shared_ptr<OpExpr<S>> &op,
                    int node = -1) const noexcept {
@@ -197,6 +383,11 @@ template <typename S> struct ParallelRule {
         ParallelProperty pp = (*this)(dynamic_pointer_cast<OpElement<S>>(op));
         return pp.ptype & ParallelOpTypes::Number;
     }
+    // Whether expectations of Number operators are dynamic tasks
+    bool dynamic_expect() const noexcept {
+        return dynamic_tasks &&
+               !(get_parallel_type() & ParallelTypes::NewScheme);
+    }
     template <typename T>
     void distributed_apply(T f, const vector<shared_ptr<OpExpr<S>>> &ops,
                            const vector<shared_ptr<OpExpr<S>>> &exprs,
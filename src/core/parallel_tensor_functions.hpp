@@ -51,6 +51,54 @@ template <typename S> struct ParallelTensorFunctions : TensorFunctions<S> {
         opf->seq->operator()(b, c, scale);
         rule->comm->allreduce_sum(c.data, c.size());
     }
+    void multiply_panel(const vector<MatrixRef> &bs,
+                        const vector<MatrixRef> &cs) override {
+        opf->seq->operator()(bs, cs);
+        // one reduction for contiguous outputs
+        size_t n = 0, j = 0;
+        for (; j < cs.size() && cs[j].data == cs[0].data + n; j++)
+            n += cs[j].size();
+        if (j == cs.size()) {
+            if (n != 0)
+                rule->comm->allreduce_sum(cs[0].data, n);
+        } else
+            for (j = 0; j < cs.size(); j++)
+                rule->comm->allreduce_sum(cs[j].data, cs[j].size());
+    }
+    // Pass the measured time of each operator in names to the rule
+    void record_costs(const shared_ptr<Symbolic<S>> &names,
+                      const vector<double> &costs) const {
+        for (size_t i = 0; i < costs.size(); i++)
+            if (costs[i] != 0)
+                rule->record_cost(dynamic_pointer_cast<OpElement<S>>(
+                                      abs_value(names->data[i])),
+                                  costs[i]);
+    }
+    // Send rotated repeated operators in names from owners to all procs
+    void broadcast_repeated(const shared_ptr<Symbolic<S>> &names,
+                            const shared_ptr<OperatorTensor<S>> &c) const {
+        vector<double *> datas;
+        vector<size_t> lens;
+        vector<int> owners;
+        for (size_t i = 0; i < names->data.size(); i++)
+            if (names->data[i]->get_type() != OpTypes::Zero) {
+                auto pa = abs_value(names->data[i]);
+                if (!rule->repeat(pa))
+                    continue;
+                const shared_ptr<SparseMatrix<S>> &mat = c->ops.at(pa);
+                if ((rule->comm_type & ParallelCommTypes::OneSided) &&
+                    mat->get_type() == SparseMatrixTypes::Normal) {
+                    datas.push_back(mat->data);
+                    lens.push_back(mat->info->get_total_memory());
+                    owners.push_back(rule->owner(pa));
+                } else if (!(rule->comm_type & ParallelCommTypes::NonBlocking))
+                    rule->comm->broadcast(mat, rule->owner(pa));
+                else
+                    rule->comm->ibroadcast(mat, rule->owner(pa));
+            }
+        if (rule->comm_type & ParallelCommTypes::OneSided)
+            rule->comm->fetch(datas, lens, owners);
+    }
     // c = a
     void left_assign(const shared_ptr<OperatorTensor<S>> &a,
                      shared_ptr<OperatorTensor<S>> &c) const override {
@@ -203,6 +251,30 @@ template <typename S> struct ParallelTensorFunctions : TensorFunctions<S> {
             TensorFunctions<S>::tensor_product_multi_multiply(
                 expr, lopt, ropt, cmats, vmats, cinfos, opdq, factor, false);
     }
+    // vmats = expr x cmats, for nroots wavefunctions at once
+    void tensor_product_multi_multiply_panel(
+        const shared_ptr<OpExpr<S>> &expr,
+        const shared_ptr<OperatorTensor<S>> &lopt,
+        const shared_ptr<OperatorTensor<S>> &ropt,
+        const shared_ptr<SparseMatrixGroup<S>> &cmats,
+        const shared_ptr<SparseMatrixGroup<S>> &vmats, int nroots,
+        const unordered_map<
+            S, shared_ptr<typename SparseMatrixInfo<S>::ConnectionInfo>>
+            &cinfos,
+        S opdq, double factor, bool all_reduce) const override {
+        if (expr->get_type() == OpTypes::ExprRef) {
+            shared_ptr<OpExprRef<S>> op =
+                dynamic_pointer_cast<OpExprRef<S>>(expr);
+            TensorFunctions<S>::tensor_product_multi_multiply_panel(
+                op->op, lopt, ropt, cmats, vmats, nroots, cinfos, opdq, factor,
+                false);
+            if (all_reduce)
+                rule->comm->allreduce_sum(vmats);
+        } else
+            TensorFunctions<S>::tensor_product_multi_multiply_panel(
+                expr, lopt, ropt, cmats, vmats, nroots, cinfos, opdq, factor,
+                false);
+    }
     vector<pair<shared_ptr<OpExpr<S>>, double>> tensor_product_expectation(
         const vector<shared_ptr<OpExpr<S>>> &names,
         const vector<shared_ptr<OpExpr<S>>> &exprs,
@@ -216,40 +288,117 @@ template <typename S> struct ParallelTensorFunctions : TensorFunctions<S> {
         S ket_dq = cmat->info->delta_quantum;
         S bra_dq = vmat->info->delta_quantum;
         rule->set_partition(ParallelRulePartitionTypes::Middle);
-        vector<shared_ptr<OpExpr<S>>> pnames;
-        vector<shared_ptr<OpExpr<S>>> pexprs;
-        vector<size_t> pidxs;
+        vector<size_t> pidxs, didxs;
         for (size_t k = 0; k < exprs.size(); k++) {
             expectations[k] = make_pair(names[k], 0.0);
             S opdq = dynamic_pointer_cast<OpElement<S>>(names[k])->q_label;
             if (opdq.combine(bra_dq, ket_dq) == S(S::invalid))
                 continue;
             shared_ptr<OpExpr<S>> expr = exprs[k];
-            if (!rule->number(names[k]) || rule->own(names[k]))
+            if (rule->dynamic_expect() && rule->number(names[k]))
+                didxs.push_back(k);
+            else if (!rule->number(names[k]) || rule->own(names[k]))
                 pidxs.push_back(k);
         }
-        pnames.reserve(pidxs.size());
-        pexprs.reserve(pidxs.size());
-        for (size_t kk = 0; kk < pidxs.size(); kk++) {
-            pnames.push_back(names[pidxs[kk]]);
-            shared_ptr<OpExpr<S>> expr = exprs[pidxs[kk]];
-            if (expr->get_type() == OpTypes::ExprRef) {
-                shared_ptr<OpExprRef<S>> op =
-                    dynamic_pointer_cast<OpExprRef<S>>(expr);
-                expr = dynamic_pointer_cast<OpExprRef<S>>(expr)->op;
+        // expectations of names[idxs[i0 : i1]] are stored in results
+        auto f = [&names, &exprs, &lopt, &ropt, &cmat, &vmat, &results,
+                  this](const vector<size_t> &idxs, size_t i0, size_t i1) {
+            vector<shared_ptr<OpExpr<S>>> pnames;
+            vector<shared_ptr<OpExpr<S>>> pexprs;
+            pnames.reserve(i1 - i0);
+            pexprs.reserve(i1 - i0);
+            for (size_t kk = i0; kk < i1; kk++) {
+                pnames.push_back(names[idxs[kk]]);
+                shared_ptr<OpExpr<S>> expr = exprs[idxs[kk]];
+                if (expr->get_type() == OpTypes::ExprRef)
+                    expr = dynamic_pointer_cast<OpExprRef<S>>(expr)->op;
+                pexprs.push_back(expr);
             }
-            pexprs.push_back(expr);
-        }
-        vector<pair<shared_ptr<OpExpr<S>>, double>> pexpectations =
-            TensorFunctions<S>::tensor_product_expectation(pnames, pexprs, lopt,
-                                                           ropt, cmat, vmat);
-        for (size_t kk = 0; kk < pidxs.size(); kk++)
-            results[pidxs[kk]] = pexpectations[kk].second;
+            vector<pair<shared_ptr<OpExpr<S>>, double>> pexpectations =
+                this->TensorFunctions<S>::tensor_product_expectation(
+                    pnames, pexprs, lopt, ropt, cmat, vmat);
+            for (size_t kk = i0; kk < i1; kk++)
+                results[idxs[kk]] = pexpectations[kk - i0].second;
+        };
+        f(pidxs, 0, pidxs.size());
+        if (didxs.size() != 0)
+            rule->comm->dynamic_for(didxs.size(), rule->dynamic_chunk,
+                                    [&f, &didxs](size_t i0, size_t i1) {
+                                        f(didxs, i0, i1);
+                                    });
         rule->comm->allreduce_sum(results.data(), results.size());
         for (size_t i = 0; i < names.size(); i++)
             expectations[i].second = results[i];
         return expectations;
     }
+    // Number of pieces of vmat reduced separately in non-blocking mode
+    static int &nonblocking_chunks() {
+        static int n_chunks = 8;
+        return n_chunks;
+    }
+    // vmat = expr x cmat summed over all procs, where the reduction of
+    // each completed piece of vmat overlaps with computing the rest
+    // Returns false if expr cannot be compiled into a flat program
+    bool nonblocking_tensor_product_multiply(
+        const shared_ptr<OpExpr<S>> &expr,
+        const shared_ptr<OperatorTensor<S>> &lopt,
+        const shared_ptr<OperatorTensor<S>> &ropt,
+        const shared_ptr<SparseMatrix<S>> &cmat,
+        const shared_ptr<SparseMatrix<S>> &vmat, S opdq) const {
+        shared_ptr<TensorProductProgram> prog =
+            TensorFunctions<S>::compile_tensor_product_multiply(
+                expr, lopt, ropt, cmat, vmat, opdq);
+        if (prog == nullptr)
+            return false;
+        // regroup instructions by output block, so that
+        // different groups never write to the same block
+        vector<size_t> idxs(prog->instrs.size());
+        for (size_t i = 0; i < idxs.size(); i++)
+            idxs[i] = i;
+        stable_sort(idxs.begin(), idxs.end(), [&prog](size_t i, size_t j) {
+            return prog->instrs[i].v_off < prog->instrs[j].v_off;
+        });
+        TensorProductProgram gprog;
+        gprog.instrs.reserve(idxs.size());
+        for (size_t i = 0; i < idxs.size(); i++) {
+            const TensorProductInstruction &x = prog->instrs[idxs[i]];
+            if (i != 0 && x.v_off != gprog.instrs.back().v_off)
+                gprog.end_term();
+            gprog.instrs.push_back(x);
+        }
+        if (idxs.size() != 0)
+            gprog.end_term();
+        prog = nullptr;
+        const double factor = cmat->factor;
+        const size_t chunk =
+            max((size_t)1, vmat->total_memory /
+                               (size_t)max(1, nonblocking_chunks()));
+        const shared_ptr<SparseMatrixInfo<S>> &info = vmat->info;
+        size_t ig = 0;
+        for (int ib = 0; ib < info->n;) {
+            size_t start = info->n_states_total[ib], end = start;
+            for (; ib < info->n && end - start < chunk; ib++)
+                end = (size_t)info->n_states_total[ib] +
+                      (size_t)info->n_states_bra[ib] * info->n_states_ket[ib];
+            size_t jg = ig;
+            while (jg < gprog.n_terms() &&
+                   gprog.instrs[gprog.term_offsets[jg]].v_off < end)
+                jg++;
+            if (jg != ig && abs(factor) >= TINY)
+                this->parallel_for(
+                    jg - ig,
+                    [&gprog, &cmat, &vmat, ig,
+                     factor](const shared_ptr<TensorFunctions<S>> &tf,
+                             size_t i) {
+                        tf->opf->compiled_tensor_product_multiply(
+                            gprog, ig + i, cmat, vmat, factor);
+                    });
+            rule->comm->iallreduce_sum(vmat->data + start, end - start);
+            ig = jg;
+        }
+        rule->comm->waitall();
+        return true;
+    }
     // vmat = expr x cmat
     void tensor_product_multiply(const shared_ptr<OpExpr<S>> &expr,
                                  const shared_ptr<OperatorTensor<S>> &lopt,
@@ -260,6 +409,13 @@ template <typename S> struct ParallelTensorFunctions : TensorFunctions<S> {
         if (expr->get_type() == OpTypes::ExprRef) {
             shared_ptr<OpExprRef<S>> op =
                 dynamic_pointer_cast<OpExprRef<S>>(expr);
+            // reduction overlapped with computation, if op can be compiled
+            if (all_reduce &&
+                (rule->comm_type & ParallelCommTypes::NonBlocking) &&
+                opf->seq->mode == SeqTypes::None &&
+                nonblocking_tensor_product_multiply(op->op, lopt, ropt, cmat,
+                                                    vmat, opdq))
+                return;
             TensorFunctions<S>::tensor_product_multiply(
                 op->op, lopt, ropt, cmat, vmat, opdq, false);
             if (all_reduce)
@@ -289,6 +445,7 @@ template <typename S> struct ParallelTensorFunctions : TensorFunctions<S> {
                      const shared_ptr<SparseMatrix<S>> &mpst_bra,
                      const shared_ptr<SparseMatrix<S>> &mpst_ket,
                      shared_ptr<OperatorTensor<S>> &c) const override {
+        TracerScope _tr("left_rotate");
         for (size_t i = 0; i < a->lmat->data.size(); i++)
             if (a->lmat->data[i]->get_type() != OpTypes::Zero) {
                 auto pa = abs_value(a->lmat->data[i]);
@@ -302,8 +459,9 @@ template <typename S> struct ParallelTensorFunctions : TensorFunctions<S> {
             }
         bool repeat = true,
              no_repeat = !(rule->comm_type & ParallelCommTypes::NonBlocking);
-        auto f = [&a, &c, &mpst_bra, &mpst_ket, this, &repeat, &no_repeat](
-                     const shared_ptr<TensorFunctions<S>> &tf, size_t i) {
+        vector<double> costs(rule->record_costs ? a->lmat->data.size() : 0);
+        auto f = [&a, &c, &mpst_bra, &mpst_ket, this, &repeat, &no_repeat,
+                  &costs](const shared_ptr<TensorFunctions<S>> &tf, size_t i) {
             if (a->lmat->data[i]->get_type() != OpTypes::Zero) {
                 auto pa = abs_value(a->lmat->data[i]);
                 bool req = true;
@@ -314,31 +472,30 @@ template <typename S> struct ParallelTensorFunctions : TensorFunctions<S> {
                     req = this->rule->own(pa) &&
                           ((repeat && this->rule->repeat(pa)) ||
                            (no_repeat && !this->rule->repeat(pa)));
-                if (req)
+                if (req) {
+                    Timer t;
+                    t.get_time();
                     tf->opf->tensor_rotate(a->ops.at(pa), c->ops.at(pa),
                                            mpst_bra, mpst_ket, false);
+                    if (costs.size() != 0)
+                        costs[i] = t.get_time();
+                }
             }
         };
         parallel_for(a->lmat->data.size(), f);
         if (opf->seq->mode == SeqTypes::Auto)
             opf->seq->auto_perform();
+        record_costs(a->lmat, costs);
         if (rule->get_parallel_type() & ParallelTypes::NewScheme)
             return;
-        for (size_t i = 0; i < a->lmat->data.size(); i++)
-            if (a->lmat->data[i]->get_type() != OpTypes::Zero) {
-                auto pa = abs_value(a->lmat->data[i]);
-                if (rule->repeat(pa)) {
-                    if (!(rule->comm_type & ParallelCommTypes::NonBlocking))
-                        rule->comm->broadcast(c->ops.at(pa), rule->owner(pa));
-                    else
-                        rule->comm->ibroadcast(c->ops.at(pa), rule->owner(pa));
-                }
-            }
+        broadcast_repeated(a->lmat, c);
         if (rule->comm_type & ParallelCommTypes::NonBlocking) {
             repeat = false, no_repeat = true;
+            memset(costs.data(), 0, sizeof(double) * costs.size());
             parallel_for(a->lmat->data.size(), f);
             if (opf->seq->mode == SeqTypes::Auto)
                 opf->seq->auto_perform();
+            record_costs(a->lmat, costs);
             rule->comm->waitall();
         }
     }
@@ -347,6 +504,7 @@ template <typename S> struct ParallelTensorFunctions : TensorFunctions<S> {
                       const shared_ptr<SparseMatrix<S>> &mpst_bra,
                       const shared_ptr<SparseMatrix<S>> &mpst_ket,
                       shared_ptr<OperatorTensor<S>> &c) const override {
+        TracerScope _tr("right_rotate");
         for (size_t i = 0; i < a->rmat->data.size(); i++)
             if (a->rmat->data[i]->get_type() != OpTypes::Zero) {
                 auto pa = abs_value(a->rmat->data[i]);
@@ -360,8 +518,9 @@ template <typename S> struct ParallelTensorFunctions : TensorFunctions<S> {
             }
         bool repeat = true,
              no_repeat = !(rule->comm_type & ParallelCommTypes::NonBlocking);
-        auto f = [&a, &c, &mpst_bra, &mpst_ket, this, &repeat, &no_repeat](
-                     const shared_ptr<TensorFunctions<S>> &tf, size_t i) {
+        vector<double> costs(rule->record_costs ? a->rmat->data.size() : 0);
+        auto f = [&a, &c, &mpst_bra, &mpst_ket, this, &repeat, &no_repeat,
+                  &costs](const shared_ptr<TensorFunctions<S>> &tf, size_t i) {
             if (a->rmat->data[i]->get_type() != OpTypes::Zero) {
                 auto pa = abs_value(a->rmat->data[i]);
                 bool req = true;
@@ -372,31 +531,30 @@ template <typename S> struct ParallelTensorFunctions : TensorFunctions<S> {
                     req = this->rule->own(pa) &&
                           ((repeat && this->rule->repeat(pa)) ||
                            (no_repeat && !this->rule->repeat(pa)));
-                if (req)
+                if (req) {
+                    Timer t;
+                    t.get_time();
                     tf->opf->tensor_rotate(a->ops.at(pa), c->ops.at(pa),
                                            mpst_bra, mpst_ket, true);
+                    if (costs.size() != 0)
+                        costs[i] = t.get_time();
+                }
             }
         };
         parallel_for(a->rmat->data.size(), f);
         if (opf->seq->mode == SeqTypes::Auto)
             opf->seq->auto_perform();
+        record_costs(a->rmat, costs);
         if (rule->get_parallel_type() & ParallelTypes::NewScheme)
             return;
-        for (size_t i = 0; i < a->rmat->data.size(); i++)
-            if (a->rmat->data[i]->get_type() != OpTypes::Zero) {
-                auto pa = abs_value(a->rmat->data[i]);
-                if (rule->repeat(pa)) {
-                    if (!(rule->comm_type & ParallelCommTypes::NonBlocking))
-                        rule->comm->broadcast(c->ops.at(pa), rule->owner(pa));
-                    else
-                        rule->comm->ibroadcast(c->ops.at(pa), rule->owner(pa));
-                }
-            }
+        broadcast_repeated(a->rmat, c);
         if (rule->comm_type & ParallelCommTypes::NonBlocking) {
             repeat = false, no_repeat = true;
+            memset(costs.data(), 0, sizeof(double) * costs.size());
             parallel_for(a->rmat->data.size(), f);
             if (opf->seq->mode == SeqTypes::Auto)
                 opf->seq->auto_perform();
+            record_costs(a->rmat, costs);
             rule->comm->waitall();
         }
     }
@@ -599,6 +757,7 @@ template <typename S> struct ParallelTensorFunctions : TensorFunctions<S> {
                        shared_ptr<OperatorTensor<S>> &c,
                        const shared_ptr<Symbolic<S>> &cexprs = nullptr,
                        OpNamesSet delayed = OpNamesSet()) const override {
+        TracerScope _tr("left_contract");
         if (a == nullptr)
             left_assign(b, c);
         else {
@@ -619,24 +778,31 @@ template <typename S> struct ParallelTensorFunctions : TensorFunctions<S> {
                     mats[i] = c->ops.at(op);
                 }
             }
-            auto f = [&a, &b, &mats,
+            auto f = [&a, &b, &c, &mats,
                       this](const vector<shared_ptr<OpExpr<S>>> &local_exprs) {
                 for (size_t i = 0; i < local_exprs.size(); i++)
                     if (frame->use_main_stack && local_exprs[i] != nullptr) {
                         assert(mats[i]->data == nullptr);
                         mats[i]->allocate(mats[i]->info);
                     }
+                vector<double> costs(
+                    rule->record_costs ? local_exprs.size() : 0, 0.0);
                 this->parallel_for(
                     local_exprs.size(),
-                    [&a, &b, &mats, &local_exprs](
+                    [&a, &b, &mats, &local_exprs, &costs](
                         const shared_ptr<TensorFunctions<S>> &tf, size_t i) {
                         if (local_exprs[i] != nullptr) {
                             if (!frame->use_main_stack)
                                 mats[i]->allocate(mats[i]->info);
+                            Timer t;
+                    t.get_time();
                             tf->tensor_product(local_exprs[i], a->ops, b->ops,
                                                mats[i]);
+                            if (costs.size() != 0)
+                                costs[i] = t.get_time();
                         }
                     });
+                record_costs(c->lmat, costs);
                 if (this->opf->seq->mode == SeqTypes::Auto)
                     this->opf->seq->auto_perform();
             };
@@ -649,6 +815,7 @@ template <typename S> struct ParallelTensorFunctions : TensorFunctions<S> {
                         shared_ptr<OperatorTensor<S>> &c,
                         const shared_ptr<Symbolic<S>> &cexprs = nullptr,
                         OpNamesSet delayed = OpNamesSet()) const override {
+        TracerScope _tr("right_contract");
         if (a == nullptr)
             right_assign(b, c);
         else {
@@ -669,24 +836,31 @@ template <typename S> struct ParallelTensorFunctions : TensorFunctions<S> {
                     mats[i] = c->ops.at(op);
                 }
             }
-            auto f = [&a, &b, &mats,
+            auto f = [&a, &b, &c, &mats,
                       this](const vector<shared_ptr<OpExpr<S>>> &local_exprs) {
                 for (size_t i = 0; i < local_exprs.size(); i++)
                     if (frame->use_main_stack && local_exprs[i] != nullptr) {
                         assert(mats[i]->data == nullptr);
                         mats[i]->allocate(mats[i]->info);
                     }
+                vector<double> costs(
+                    rule->record_costs ? local_exprs.size() : 0, 0.0);
                 this->parallel_for(
                     local_exprs.size(),
-                    [&a, &b, &mats, &local_exprs](
+                    [&a, &b, &mats, &local_exprs, &costs](
                         const shared_ptr<TensorFunctions<S>> &tf, size_t i) {
                         if (local_exprs[i] != nullptr) {
                             if (!frame->use_main_stack)
                                 mats[i]->allocate(mats[i]->info);
+                            Timer t;
+                    t.get_time();
                             tf->tensor_product(local_exprs[i], b->ops, a->ops,
                                                mats[i]);
+                            if (costs.size() != 0)
+                                costs[i] = t.get_time();
                         }
                     });
+                record_costs(c->rmat, costs);
                 if (this->opf->seq->mode == SeqTypes::Auto)
                     this->opf->seq->auto_perform();
             };
@@ -55,6 +55,8 @@ struct SparseMatrixInfo<
     S delta_quantum;
     bool is_fermion;
     bool is_wavefunction;
+    // Whether blocks are stored in an order other than the quanta order
+    bool block_permuted;
     // Number of non-zero blocks
     int n;
     static bool cmp_op_info(const pair<S, shared_ptr<SparseMatrixInfo>> &p,
@@ -75,6 +77,105 @@ struct SparseMatrixInfo<
         uint16_t *ia, *ib, *ic;
         int n[5], nc;
         ConnectionInfo() : nc(-1) { memset(n, -1, sizeof(n)); }
+        // Content-addressed cache of computed connection data, reused across
+        // sites and sweeps when the same quanta meet again.
+        // The key only covers what the result depends on: quanta and delta
+        // quanta (and bond dimensions for 'initialize_tp').
+        // Max size in number of uint32_t; zero disables the cache.
+        static size_t &cache_max_size() {
+            static size_t max_size = (size_t)1 << 24;
+            return max_size;
+        }
+        static unordered_map<size_t, pair<vector<int>, vector<uint32_t>>> &
+        cache() {
+            static unordered_map<size_t, pair<vector<int>, vector<uint32_t>>>
+                data;
+            return data;
+        }
+        static size_t &cache_size() {
+            static size_t size = 0;
+            return size;
+        }
+        static void clear_cache() { cache().clear(), cache_size() = 0; }
+        static void hash_data(size_t &h, const void *data, size_t len) {
+            // FNV-1a
+            const uint8_t *p = (const uint8_t *)data;
+            for (size_t i = 0; i < len; i++)
+                h = (h ^ p[i]) * (size_t)1099511628211ULL;
+        }
+        static void hash_state_info(size_t &h, const StateInfo<S> &info,
+                                    bool with_states) {
+            hash_data(h, &info.n, sizeof(info.n));
+            hash_data(h, info.quanta, info.n * sizeof(S));
+            if (with_states)
+                hash_data(h, info.n_states, info.n * sizeof(ubond_t));
+        }
+        static void hash_info(size_t &h,
+                              const shared_ptr<SparseMatrixInfo> &info,
+                              bool with_states) {
+            hash_data(h, &info->delta_quantum, sizeof(S));
+            hash_data(h, &info->is_fermion, sizeof(info->is_fermion));
+            hash_data(h, &info->n, sizeof(info->n));
+            hash_data(h, info->quanta, info->n * sizeof(S));
+            if (with_states)
+                hash_data(h, info->n_states_ket, info->n * sizeof(ubond_t));
+        }
+        static size_t
+        hash_key(int kind, const vector<S> &dqs,
+                 const vector<pair<uint8_t, S>> &subdq,
+                 const vector<pair<S, shared_ptr<SparseMatrixInfo>>> &ainfos,
+                 const vector<pair<S, shared_ptr<SparseMatrixInfo>>> &binfos) {
+            size_t h = (size_t)14695981039346656037ULL;
+            hash_data(h, &kind, sizeof(kind));
+            hash_data(h, dqs.data(), dqs.size() * sizeof(S));
+            for (auto &sq : subdq)
+                hash_data(h, &sq.first, sizeof(sq.first)),
+                    hash_data(h, &sq.second, sizeof(sq.second));
+            for (auto &p : ainfos)
+                hash_info(h, p.second, false);
+            h = h * 31 + ainfos.size();
+            for (auto &p : binfos)
+                hash_info(h, p.second, false);
+            h = h * 31 + binfos.size();
+            return h;
+        }
+        void allocate_data() {
+            uint32_t *ptr = ialloc->allocate(n[4] * (sizeof(S) >> 2) + n[4]);
+            uint32_t *cptr = ialloc->allocate((nc << 2) + nc - (nc >> 1));
+            quanta = (S *)ptr;
+            idx = ptr + n[4] * (sizeof(S) >> 2);
+            stride = cptr;
+            factor = (double *)(cptr + nc);
+            ia = (uint16_t *)(cptr + nc + nc + nc), ib = ia + nc, ic = ib + nc;
+        }
+        bool load_cache(size_t key) {
+            auto it = cache().find(key);
+            if (it == cache().end())
+                return false;
+            memcpy(n, it->second.first.data(), sizeof(n));
+            nc = it->second.first[5];
+            allocate_data();
+            const size_t lp = n[4] * (sizeof(S) >> 2) + n[4];
+            memcpy(quanta, it->second.second.data(), lp * sizeof(uint32_t));
+            memcpy(stride, it->second.second.data() + lp,
+                   ((nc << 2) + nc - (nc >> 1)) * sizeof(uint32_t));
+            return true;
+        }
+        void save_cache(size_t key) const {
+            const size_t lp = n[4] * (sizeof(S) >> 2) + n[4];
+            const size_t lc = (nc << 2) + nc - (nc >> 1);
+            if (lp + lc > cache_max_size())
+                return;
+            if (cache_size() + lp + lc > cache_max_size())
+                clear_cache();
+            vector<uint32_t> data(lp + lc);
+            memcpy(data.data(), quanta, lp * sizeof(uint32_t));
+            memcpy(data.data() + lp, stride, lc * sizeof(uint32_t));
+            cache()[key] =
+                make_pair(vector<int>{n[0], n[1], n[2], n[3], n[4], nc},
+                          std::move(data));
+            cache_size() += lp + lc;
+        }
         // Compute non-zero-block indices for 'tensor_product_diagonal'
         void initialize_diag(
             S cdq, S opdq, const vector<pair<uint8_t, S>> &subdq,
@@ -86,6 +187,13 @@ struct SparseMatrixInfo<
                 n[4] = nc = 0;
                 return;
             }
+            size_t key = 0;
+            if (cache_max_size() != 0) {
+                key = hash_key(0, vector<S>{cdq, opdq}, subdq, ainfos, binfos);
+                hash_info(key, cinfo, false);
+                if (load_cache(key))
+                    return;
+            }
             vector<uint32_t> vidx(subdq.size());
             vector<uint16_t> via, vib, vic;
             vector<double> vf;
@@ -116,15 +224,20 @@ struct SparseMatrixInfo<
                     if (ia != -1 && ib != -1 && aq == aq.get_bra(adq) &&
                         bq == bq.get_bra(bdq)) {
                         double factor =
-                            sqrt(cdq.multiplicity() * opdq.multiplicity() *
-                                 aq.multiplicity() * bq.multiplicity()) *
-                            cg->wigner_9j(aq.twos(), bq.twos(), cdq.twos(),
-                                          adq.twos(), bdq.twos(), opdq.twos(),
-                                          aq.twos(), bq.twos(), cdq.twos());
-                        if (cja)
+                            CG<S>::abelian
+                                ? 1.0
+                                : sqrt(cdq.multiplicity() *
+                                       opdq.multiplicity() *
+                                       aq.multiplicity() * bq.multiplicity()) *
+                                      cg->wigner_9j(aq.twos(), bq.twos(),
+                                                    cdq.twos(), adq.twos(),
+                                                    bdq.twos(), opdq.twos(),
+                                                    aq.twos(), bq.twos(),
+                                                    cdq.twos());
+                        if (!CG<S>::abelian && cja)
                             factor *= cg->transpose_cg(adq.twos(), aq.twos(),
                                                        aq.twos());
-                        if (cjb)
+                        if (!CG<S>::abelian && cjb)
                             factor *= cg->transpose_cg(bdq.twos(), bq.twos(),
                                                        bq.twos());
                         factor *= (binfo->is_fermion && (aq.n() & 1)) ? -1 : 1;
@@ -142,13 +255,7 @@ struct SparseMatrixInfo<
                 if (n[i] == -1)
                     n[i] = n[i + 1];
             nc = (int)vic.size();
-            uint32_t *ptr = ialloc->allocate(n[4] * (sizeof(S) >> 2) + n[4]);
-            uint32_t *cptr = ialloc->allocate((nc << 2) + nc - (nc >> 1));
-            quanta = (S *)ptr;
-            idx = ptr + n[4] * (sizeof(S) >> 2);
-            stride = cptr;
-            factor = (double *)(cptr + nc);
-            ia = (uint16_t *)(cptr + nc + nc + nc), ib = ia + nc, ic = ib + nc;
+            allocate_data();
             for (int i = 0; i < n[4]; i++)
                 quanta[i] = subdq[i].second;
             memcpy(idx, vidx.data(), n[4] * sizeof(uint32_t));
@@ -157,6 +264,8 @@ struct SparseMatrixInfo<
             memcpy(ia, via.data(), nc * sizeof(uint16_t));
             memcpy(ib, vib.data(), nc * sizeof(uint16_t));
             memcpy(ic, vic.data(), nc * sizeof(uint16_t));
+            if (cache_max_size() != 0)
+                save_cache(key);
         }
         // Compute non-zero-block indices for 'tensor_product_multiply'
         void initialize_wfn(
@@ -170,6 +279,15 @@ struct SparseMatrixInfo<
                 n[4] = nc = 0;
                 return;
             }
+            size_t key = 0;
+            if (cache_max_size() != 0) {
+                key = hash_key(1, vector<S>{cdq, vdq, opdq}, subdq, ainfos,
+                               binfos);
+                hash_info(key, cinfo, false);
+                hash_info(key, vinfo, false);
+                if (load_cache(key))
+                    return;
+            }
             vector<uint32_t> vidx(subdq.size()), viv;
             vector<uint16_t> via, vib, vic;
             vector<double> vf;
@@ -216,24 +334,28 @@ struct SparseMatrixInfo<
                                     cdq.combine(lqprime, -rqprime));
                                 if (ia != -1 && ic != -1) {
                                     double factor =
-                                        sqrt(cdq.multiplicity() *
-                                             opdq.multiplicity() *
-                                             lq.multiplicity() *
-                                             rq.multiplicity()) *
-                                        cg->wigner_9j(
-                                            lqprime.twos(), rqprime.twos(),
-                                            cdq.twos(), adq.twos(), bdq.twos(),
-                                            opdq.twos(), lq.twos(), rq.twos(),
-                                            vdq.twos());
+                                        CG<S>::abelian
+                                            ? 1.0
+                                            : sqrt(cdq.multiplicity() *
+                                                   opdq.multiplicity() *
+                                                   lq.multiplicity() *
+                                                   rq.multiplicity()) *
+                                                  cg->wigner_9j(
+                                                      lqprime.twos(),
+                                                      rqprime.twos(),
+                                                      cdq.twos(), adq.twos(),
+                                                      bdq.twos(), opdq.twos(),
+                                                      lq.twos(), rq.twos(),
+                                                      vdq.twos());
                                     factor *=
                                         (binfo->is_fermion && (lqprime.n() & 1))
                                             ? -1
                                             : 1;
-                                    if (cja)
+                                    if (!CG<S>::abelian && cja)
                                         factor *= cg->transpose_cg(
                                             adq.twos(), lq.twos(),
                                             lqprime.twos());
-                                    if (cjb)
+                                    if (!CG<S>::abelian && cjb)
                                         factor *= cg->transpose_cg(
                                             bdq.twos(), rq.twos(),
                                             rqprime.twos());
@@ -275,13 +397,7 @@ struct SparseMatrixInfo<
                 if (n[i] == -1)
                     n[i] = n[i + 1];
             nc = (int)viv.size();
-            uint32_t *ptr = ialloc->allocate(n[4] * (sizeof(S) >> 2) + n[4]);
-            uint32_t *cptr = ialloc->allocate((nc << 2) + nc - (nc >> 1));
-            quanta = (S *)ptr;
-            idx = ptr + n[4] * (sizeof(S) >> 2);
-            stride = cptr;
-            factor = (double *)(cptr + nc);
-            ia = (uint16_t *)(cptr + nc + nc + nc), ib = ia + nc, ic = ib + nc;
+            allocate_data();
             for (int i = 0; i < n[4]; i++)
                 quanta[i] = subdq[i].second;
             memcpy(idx, vidx.data(), n[4] * sizeof(uint32_t));
@@ -290,6 +406,8 @@ struct SparseMatrixInfo<
             memcpy(ia, via.data(), nc * sizeof(uint16_t));
             memcpy(ib, vib.data(), nc * sizeof(uint16_t));
             memcpy(ic, vic.data(), nc * sizeof(uint16_t));
+            if (cache_max_size() != 0)
+                save_cache(key);
         }
         // Compute non-zero-block indices for 'tensor_product'
         void initialize_tp(
@@ -306,6 +424,17 @@ struct SparseMatrixInfo<
                 n[4] = nc = 0;
                 return;
             }
+            size_t key = 0;
+            if (cache_max_size() != 0) {
+                key = hash_key(2, vector<S>{cdq}, subdq, ainfos, binfos);
+                for (const StateInfo<S> *si :
+                     {&bra, &ket, &bra_a, &bra_b, &ket_a, &ket_b, &bra_cinfo,
+                      &ket_cinfo})
+                    hash_state_info(key, *si, true);
+                hash_info(key, cinfo, true);
+                if (load_cache(key))
+                    return;
+            }
             vector<uint32_t> vidx(subdq.size()), vstride;
             vector<uint16_t> via, vib, vic;
             vector<double> vf;
@@ -362,24 +491,28 @@ struct SparseMatrixInfo<
                                     S cq = cinfo->quanta[ic].get_bra(cdq);
                                     S cqprime = cinfo->quanta[ic].get_ket();
                                     double factor =
-                                        sqrt(cqprime.multiplicity() *
-                                             cdq.multiplicity() *
-                                             aq.multiplicity() *
-                                             bq.multiplicity()) *
-                                        cg->wigner_9j(
-                                            aqprime.twos(), bqprime.twos(),
-                                            cqprime.twos(), adq.twos(),
-                                            bdq.twos(), cdq.twos(), aq.twos(),
-                                            bq.twos(), cq.twos());
+                                        CG<S>::abelian
+                                            ? 1.0
+                                            : sqrt(cqprime.multiplicity() *
+                                                   cdq.multiplicity() *
+                                                   aq.multiplicity() *
+                                                   bq.multiplicity()) *
+                                                  cg->wigner_9j(
+                                                      aqprime.twos(),
+                                                      bqprime.twos(),
+                                                      cqprime.twos(),
+                                                      adq.twos(), bdq.twos(),
+                                                      cdq.twos(), aq.twos(),
+                                                      bq.twos(), cq.twos());
                                     factor *=
                                         (binfo->is_fermion && (aqprime.n() & 1))
                                             ? -1
                                             : 1;
-                                    if (cja)
+                                    if (!CG<S>::abelian && cja)
                                         factor *= cg->transpose_cg(
                                             adq.twos(), aq.twos(),
                                             aqprime.twos());
-                                    if (cjb)
+                                    if (!CG<S>::abelian && cjb)
                                         factor *= cg->transpose_cg(
                                             bdq.twos(), bq.twos(),
                                             bqprime.twos());
@@ -408,13 +541,7 @@ struct SparseMatrixInfo<
                 if (n[i] == -1)
                     n[i] = n[i + 1];
             nc = (int)vstride.size();
-            uint32_t *ptr = ialloc->allocate(n[4] * (sizeof(S) >> 2) + n[4]);
-            uint32_t *cptr = ialloc->allocate((nc << 2) + nc - (nc >> 1));
-            quanta = (S *)ptr;
-            idx = ptr + n[4] * (sizeof(S) >> 2);
-            stride = cptr;
-            factor = (double *)(cptr + nc);
-            ia = (uint16_t *)(cptr + nc + nc + nc), ib = ia + nc, ic = ib + nc;
+            allocate_data();
             for (int i = 0; i < n[4]; i++)
                 quanta[i] = subdq[i].second;
             memcpy(idx, vidx.data(), n[4] * sizeof(uint32_t));
@@ -423,6 +550,8 @@ struct SparseMatrixInfo<
             memcpy(ia, via.data(), nc * sizeof(uint16_t));
             memcpy(ib, vib.data(), nc * sizeof(uint16_t));
             memcpy(ic, vic.data(), nc * sizeof(uint16_t));
+            if (cache_max_size() != 0)
+                save_cache(key);
         }
         void reallocate(bool clean) {
             size_t length =
@@ -482,7 +611,7 @@ struct SparseMatrixInfo<
     };
     shared_ptr<ConnectionInfo> cinfo;
     SparseMatrixInfo(const shared_ptr<Allocator<uint32_t>> &alloc = nullptr)
-        : n(-1), cinfo(nullptr), alloc(alloc) {}
+        : n(-1), block_permuted(false), cinfo(nullptr), alloc(alloc) {}
     SparseMatrixInfo
     deep_copy(const shared_ptr<Allocator<uint32_t>> &alloc = nullptr) const {
         SparseMatrixInfo other;
@@ -502,6 +631,7 @@ struct SparseMatrixInfo<
         memcpy(other.quanta, quanta,
                (n * (sizeof(S) >> 2) + n + _DBL_MEM_SIZE(n)) *
                    sizeof(uint32_t));
+        other.block_permuted = block_permuted;
     }
     void load_data(const string &filename) {
         ifstream ifs(filename.c_str(), ios::binary);
@@ -537,6 +667,12 @@ struct SparseMatrixInfo<
         n_states_ket = (ubond_t *)(ptr + n * (sizeof(S) >> 2)) + n;
         n_states_total = ptr + n * (sizeof(S) >> 2) + _DBL_MEM_SIZE(n);
         cinfo = nullptr;
+        // the block order is kept in the saved offsets
+        block_permuted = false;
+        for (int i = 0; i < n - 1 && !block_permuted; i++)
+            block_permuted = n_states_total[i + 1] !=
+                             n_states_total[i] +
+                                 (uint32_t)n_states_bra[i] * n_states_ket[i];
     }
     void save_data(const string &filename) const {
         if (Parsing::link_exists(filename))
@@ -793,6 +929,7 @@ struct SparseMatrixInfo<
         for (int i = 0; i < n; i++)
             quanta[i] = q[idx[i]], n_states_bra[i] = nqb[idx[i]],
             n_states_ket[i] = nqk[idx[i]];
+        block_permuted = false;
         n_states_total[0] = 0;
         for (int i = 0; i < n - 1; i++) {
             n_states_total[i + 1] =
@@ -800,10 +937,54 @@ struct SparseMatrixInfo<
             assert(n_states_total[i + 1] >= n_states_total[i]);
         }
     }
+    // Store blocks in memory in the given order of block indices, instead
+    // of the quanta order. Only block offsets change, so access through
+    // operator[] and the ConnectionInfo are unaffected. Data allocated
+    // with another block order must be moved with selective_copy_from.
+    // Operations that split or fuse wavefunction blocks (SVD, left_split,
+    // swap_to_fused, ...) expect the quanta order.
+    void set_block_order(const vector<int> &order) {
+        assert((int)order.size() == n);
+        uint32_t p = 0;
+        block_permuted = false;
+        for (int k = 0; k < n; k++) {
+            n_states_total[order[k]] = p;
+            p += (uint32_t)n_states_bra[order[k]] * n_states_ket[order[k]];
+            block_permuted = block_permuted || order[k] != k;
+        }
+    }
+    // Block indices in the order they are stored in memory
+    vector<int> get_block_order() const {
+        vector<int> order(n);
+        for (int i = 0; i < n; i++)
+            order[i] = i;
+        if (block_permuted)
+            stable_sort(order.begin(), order.end(), [this](int i, int j) {
+                return n_states_total[i] < n_states_total[j];
+            });
+        return order;
+    }
+    // Block order with all blocks of the same row (bra) quantum adjacent,
+    // which is the access pattern of multiplication by a left operator
+    vector<int> get_bra_major_block_order() const {
+        vector<int> order(n);
+        for (int i = 0; i < n; i++)
+            order[i] = i;
+        stable_sort(order.begin(), order.end(), [this](int i, int j) {
+            return quanta[i].get_bra(delta_quantum) <
+                   quanta[j].get_bra(delta_quantum);
+        });
+        return order;
+    }
     uint32_t get_total_memory() const {
         if (n == 0)
             return 0;
-        else {
+        else if (block_permuted) {
+            uint32_t tmem = 0;
+            for (int i = 0; i < n; i++)
+                tmem += (uint32_t)n_states_bra[i] * n_states_ket[i];
+            return tmem;
+        } else {
             uint32_t tmem = n_states_total[n - 1] +
                             (uint32_t)n_states_bra[n - 1] * n_states_ket[n - 1];
             assert(tmem >= n_states_total[n - 1]);
@@ -823,6 +1004,7 @@ struct SparseMatrixInfo<
         n_states_total =
             ptr + length * (sizeof(S) >> 2) + _DBL_MEM_SIZE(length);
         n = length;
+        block_permuted = false;
     }
     void deallocate() {
         assert(n != -1);
@@ -873,6 +1055,34 @@ enum struct SparseMatrixTypes : uint8_t {
     Delayed = 3
 };
 
+// Non-owning view of the data of a block-sparse matrix
+// Used in hot loops where only block access is needed, so that no
+// SparseMatrix or shared_ptr (with atomic reference counting) is created
+// The underlying info and data must outlive the view
+template <typename S> struct SparseMatrixView {
+    const SparseMatrixInfo<S> *info;
+    double *data;
+    size_t total_memory;
+    SparseMatrixView() : info(nullptr), data(nullptr), total_memory(0) {}
+    SparseMatrixView(const SparseMatrixInfo<S> *info, double *data,
+                     size_t total_memory)
+        : info(info), data(data), total_memory(total_memory) {}
+    MatrixRef operator[](S q) const { return (*this)[info->find_state(q)]; }
+    MatrixRef operator[](int idx) const {
+        assert(idx != -1);
+        return MatrixRef(data + info->n_states_total[idx],
+                         (int)info->n_states_bra[idx],
+                         (int)info->n_states_ket[idx]);
+    }
+    // whole data as a column vector
+    MatrixRef flat() const {
+        assert(total_memory <= (size_t)numeric_limits<MKL_INT>::max());
+        return MatrixRef(data, (MKL_INT)total_memory, 1);
+    }
+    double norm() const { return MatrixFunctions::norm(flat()); }
+    void iscale(double d) const { MatrixFunctions::iscale(flat(), d); }
+};
+
 // Block-sparse Matrix
 // Representing operator, wavefunction, density matrix and MPS tensors
 template <typename S> struct SparseMatrix {
@@ -905,6 +1115,8 @@ template <typename S> struct SparseMatrix {
                    const shared_ptr<Allocator<uint32_t>> &i_alloc = nullptr) {
         if (alloc == nullptr)
             alloc = dalloc;
+        Timer t;
+        t.get_time();
         ifstream ifs(filename.c_str(), ios::binary);
         if (!ifs.good())
             throw runtime_error("SparseMatrix:load_data on '" + filename +
@@ -918,7 +1130,10 @@ template <typename S> struct SparseMatrix {
         if (ifs.fail() || ifs.bad())
             throw runtime_error("SparseMatrix:load_data on '" + filename +
                                 "' failed.");
+        const size_t sz = (size_t)ifs.tellg();
         ifs.close();
+        if (frame_() != nullptr)
+            frame_()->record_io(filename, false, sz, t.get_time());
     }
     virtual void save_data(ostream &ofs, bool pointer_only = false) const {
         ofs.write((char *)&factor, sizeof(factor));
@@ -934,6 +1149,8 @@ template <typename S> struct SparseMatrix {
             ofs.write((char *)data, sizeof(double) * total_memory);
     }
     void save_data(const string &filename, bool save_info = false) const {
+        Timer t;
+        t.get_time();
         if (Parsing::link_exists(filename))
             Parsing::remove_file(filename);
         ofstream ofs(filename.c_str(), ios::binary);
@@ -946,7 +1163,10 @@ template <typename S> struct SparseMatrix {
         if (!ofs.good())
             throw runtime_error("SparseMatrix:save_data on '" + filename +
                                 "' failed.");
+        const size_t sz = (size_t)ofs.tellp();
         ofs.close();
+        if (frame_() != nullptr)
+            frame_()->record_io(filename, true, sz, t.get_time());
     }
     virtual void copy_data_from(const shared_ptr<SparseMatrix> &other,
                                 bool ref = false) {
@@ -1017,6 +1237,9 @@ template <typename S> struct SparseMatrix {
                          (int)info->n_states_bra[idx],
                          (int)info->n_states_ket[idx]);
     }
+    SparseMatrixView<S> view() const {
+        return SparseMatrixView<S>(info.get(), data, total_memory);
+    }
     double trace() const {
         double r = 0;
         for (int i = 0; i < info->n; i++)
@@ -1188,11 +1411,83 @@ template <typename S> struct SparseMatrix {
         }
         return pinv;
     }
+    // SVD of each block of a list of matrices (matrices may be destroyed)
+    // With bond_dim != 0 and rand_min_size != 0, blocks with both dims
+    // at least rand_min_size only compute the leading singular triplets by
+    // randomized SVD, whose number is doubled until the discarded part of
+    // the block cannot contain a singular value above the bond_dim-th one
+    static void block_svd(const vector<MatrixRef> &mats,
+                          vector<shared_ptr<Tensor>> &l,
+                          vector<shared_ptr<Tensor>> &s,
+                          vector<shared_ptr<Tensor>> &r, ubond_t bond_dim,
+                          double svd_eps, int rand_min_size) {
+        const int n = (int)mats.size();
+        l.resize(n), s.resize(n), r.resize(n);
+        vector<MKL_INT> nks(n);
+        vector<double> tails(n, 0);
+        vector<uint8_t> todo(n, 1);
+        size_t ntot = 0;
+        for (int i = 0; i < n; i++)
+            ntot += (size_t)min(mats[i].m, mats[i].n);
+        for (int i = 0; i < n; i++) {
+            nks[i] = min(mats[i].m, mats[i].n);
+            if (bond_dim == 0 || rand_min_size == 0 || svd_eps != 0 ||
+                nks[i] < rand_min_size)
+                continue;
+            // twice the proportional share of the bond dimension
+            MKL_INT nk = max((MKL_INT)(2 * (size_t)bond_dim * nks[i] / ntot),
+                             (MKL_INT)2);
+            if (nk * 2 <= nks[i])
+                nks[i] = nk;
+        }
+        for (bool more = true; more;) {
+            vector<size_t> costs(n, 0);
+            for (int i = 0; i < n; i++)
+                if (todo[i])
+                    costs[i] = (size_t)mats[i].m * mats[i].n * nks[i] + 1;
+            threading->parallel_by_cost(costs, [&](int i) {
+                MKL_INT nxl = mats[i].m, nxr = mats[i].n, nxk = nks[i];
+                l[i] = make_shared<Tensor>(vector<MKL_INT>{nxl, nxk});
+                s[i] = make_shared<Tensor>(vector<MKL_INT>{nxk});
+                r[i] = make_shared<Tensor>(vector<MKL_INT>{nxk, nxr});
+                if (nxk != min(nxl, nxr))
+                    tails[i] = MatrixFunctions::truncated_svd(
+                        mats[i], l[i]->ref(), s[i]->ref().flip_dims(),
+                        r[i]->ref());
+                else if (svd_eps != 0)
+                    MatrixFunctions::accurate_svd(mats[i], l[i]->ref(),
+                                                  s[i]->ref().flip_dims(),
+                                                  r[i]->ref(), svd_eps);
+                else
+                    MatrixFunctions::svd(mats[i], l[i]->ref(),
+                                         s[i]->ref().flip_dims(), r[i]->ref());
+                todo[i] = 0;
+            });
+            more = false;
+            vector<double> svals;
+            for (int i = 0; i < n; i++)
+                svals.insert(svals.end(), s[i]->data.begin(), s[i]->data.end());
+            double thrd = 1E-12;
+            if (svals.size() > bond_dim && bond_dim != 0) {
+                nth_element(svals.begin(), svals.begin() + (bond_dim - 1),
+                            svals.end(), greater<double>());
+                thrd = max(thrd, svals[bond_dim - 1]);
+            }
+            for (int i = 0; i < n; i++) {
+                const MKL_INT nxk = min(mats[i].m, mats[i].n);
+                if (nks[i] == nxk || tails[i] <= thrd * thrd)
+                    continue;
+                nks[i] = nks[i] * 4 <= nxk ? nks[i] * 2 : nxk;
+                todo[i] = 1, more = true;
+            }
+        }
+    }
     // l will have the same number of non-zero blocks as this matrix
     // s will be labelled by right q labels
     void left_svd(vector<S> &rqs, vector<shared_ptr<Tensor>> &l,
                   vector<shared_ptr<Tensor>> &s, vector<shared_ptr<Tensor>> &r,
-                  ubond_t bond_dim = 0, double svd_eps = 0) const {
+                  ubond_t bond_dim = 0, double svd_eps = 0,
+                  int rand_min_size = 0) const {
         map<S, MKL_INT> qs_mp;
         for (int i = 0; i < info->n; i++) {
             S q = info->is_wavefunction ? -info->quanta[i].get_ket()
@@ -1221,33 +1516,15 @@ template <typename S> struct SparseMatrix {
         }
         for (int ir = 0; ir < nr; ir++)
             assert(it[ir] == tmp[ir + 1] - tmp[ir]);
-        vector<shared_ptr<Tensor>> merged_l(nr);
-        r.resize(nr);
-        s.resize(nr);
-        int ntg = threading->activate_global();
-#pragma omp parallel for schedule(dynamic) num_threads(ntg)
+        vector<shared_ptr<Tensor>> merged_l;
+        vector<MatrixRef> mats;
+        mats.reserve(nr);
         for (int ir = 0; ir < nr; ir++) {
             MKL_INT nxr = sz[ir], nxl = (tmp[ir + 1] - tmp[ir]) / nxr;
             assert((tmp[ir + 1] - tmp[ir]) % nxr == 0);
-            MKL_INT nxk = min(nxl, nxr);
-            shared_ptr<Tensor> tsl =
-                make_shared<Tensor>(vector<MKL_INT>{nxl, nxk});
-            shared_ptr<Tensor> tss = make_shared<Tensor>(vector<MKL_INT>{nxk});
-            shared_ptr<Tensor> tsr =
-                make_shared<Tensor>(vector<MKL_INT>{nxk, nxr});
-            if (svd_eps != 0)
-                MatrixFunctions::accurate_svd(
-                    MatrixRef(dt + tmp[ir], nxl, nxr), tsl->ref(),
-                    tss->ref().flip_dims(), tsr->ref(), svd_eps);
-            else
-                MatrixFunctions::svd(MatrixRef(dt + tmp[ir], nxl, nxr),
-                                     tsl->ref(), tss->ref().flip_dims(),
-                                     tsr->ref());
-            merged_l[ir] = tsl;
-            s[ir] = tss;
-            r[ir] = tsr;
-        }
-        threading->activate_normal();
+            mats.push_back(MatrixRef(dt + tmp[ir], nxl, nxr));
+        }
+        block_svd(mats, merged_l, s, r, bond_dim, svd_eps, rand_min_size);
         vector<double> svals;
         for (int ir = 0; ir < nr; ir++)
             svals.insert(svals.end(), s[ir]->data.begin(), s[ir]->data.end());
@@ -1283,7 +1560,8 @@ template <typename S> struct SparseMatrix {
     // s will be labelled by left q labels
     void right_svd(vector<S> &lqs, vector<shared_ptr<Tensor>> &l,
                    vector<shared_ptr<Tensor>> &s, vector<shared_ptr<Tensor>> &r,
-                   ubond_t bond_dim = 0, double svd_eps = 0) const {
+                   ubond_t bond_dim = 0, double svd_eps = 0,
+                   int rand_min_size = 0) const {
         map<S, MKL_INT> qs_mp;
         for (int i = 0; i < info->n; i++) {
             S q = info->quanta[i].get_bra(info->delta_quantum);
@@ -1314,33 +1592,15 @@ template <typename S> struct SparseMatrix {
         }
         for (int il = 0; il < nl; il++)
             assert(it[il] == (tmp[il + 1] - tmp[il]) / sz[il]);
-        vector<shared_ptr<Tensor>> merged_r(nl);
-        l.resize(nl);
-        s.resize(nl);
-        int ntg = threading->activate_global();
-#pragma omp parallel for schedule(dynamic) num_threads(ntg)
+        vector<shared_ptr<Tensor>> merged_r;
+        vector<MatrixRef> mats;
+        mats.reserve(nl);
         for (int il = 0; il < nl; il++) {
             MKL_INT nxl = sz[il], nxr = (tmp[il + 1] - tmp[il]) / nxl;
             assert((tmp[il + 1] - tmp[il]) % nxl == 0);
-            MKL_INT nxk = min(nxl, nxr);
-            shared_ptr<Tensor> tsl =
-                make_shared<Tensor>(vector<MKL_INT>{nxl, nxk});
-            shared_ptr<Tensor> tss = make_shared<Tensor>(vector<MKL_INT>{nxk});
-            shared_ptr<Tensor> tsr =
-                make_shared<Tensor>(vector<MKL_INT>{nxk, nxr});
-            if (svd_eps != 0)
-                MatrixFunctions::accurate_svd(
-                    MatrixRef(dt + tmp[il], nxl, nxr), tsl->ref(),
-                    tss->ref().flip_dims(), tsr->ref(), svd_eps);
-            else
-                MatrixFunctions::svd(MatrixRef(dt + tmp[il], nxl, nxr),
-                                     tsl->ref(), tss->ref().flip_dims(),
-                                     tsr->ref());
-            l[il] = tsl;
-            s[il] = tss;
-            merged_r[il] = tsr;
-        }
-        threading->activate_normal();
+            mats.push_back(MatrixRef(dt + tmp[il], nxl, nxr));
+        }
+        block_svd(mats, l, s, merged_r, bond_dim, svd_eps, rand_min_size);
         vector<double> svals;
         for (int il = 0; il < nl; il++)
             svals.insert(svals.end(), s[il]->data.begin(), s[il]->data.end());
@@ -1495,7 +1755,7 @@ template <typename S> struct SparseMatrix {
             int ik = r.find_state(ket);
             int bbed = ib == old_fused.n - 1 ? old_fused_cinfo.n
                                              : old_fused_cinfo.n_states[ib + 1];
-            MKL_INT p = info->n_states_total[i], xp = xinfo->n_states_total[i];
+            MKL_INT p = info->n_states_total[i], xp = xinfo->n_states_total[ix];
             for (int bb = old_fused_cinfo.n_states[ib]; bb < bbed; bb++) {
                 uint16_t ibba = old_fused_cinfo.quanta[bb].data >> 16,
                          ibbb = old_fused_cinfo.quanta[bb].data & 0xFFFFU;
@@ -1960,7 +2220,7 @@ template <typename S> struct SparseMatrixGroup {
     vector<pair<S, double>> delta_quanta() const {
         vector<pair<S, double>> r(n);
         for (int i = 0; i < n; i++)
-            r[i] = make_pair(infos[i]->delta_quantum, (*this)[i]->norm());
+            r[i] = make_pair(infos[i]->delta_quantum, view(i).norm());
         sort(r.begin(), r.end(),
              [](const pair<S, double> &a, const pair<S, double> &b) {
                  return a.second > b.second;
@@ -1974,9 +2234,7 @@ template <typename S> struct SparseMatrixGroup {
         else {
             double normsq = 0.0;
             for (int i = 0; i < n; i++) {
-                assert((*this)[i]->total_memory <=
-                       (size_t)numeric_limits<MKL_INT>::max());
-                double norm = (*this)[i]->norm();
+                double norm = view(i).norm();
                 normsq += norm * norm;
             }
             return sqrt(abs(normsq));
@@ -1988,7 +2246,7 @@ template <typename S> struct SparseMatrixGroup {
                                     d);
         else
             for (int i = 0; i < n; i++)
-                (*this)[i]->iscale(d);
+                view(i).iscale(d);
     }
     void normalize() const { iscale(1 / norm()); }
     static void
@@ -1999,6 +2257,11 @@ template <typename S> struct SparseMatrixGroup {
         for (auto &mat : mats)
             mat->iscale(1 / sqrt(normsq));
     }
+    SparseMatrixView<S> view(int idx) const {
+        assert(idx >= 0 && idx < n);
+        return SparseMatrixView<S>(infos[idx].get(), data + offsets[idx],
+                                   infos[idx]->get_total_memory());
+    }
     shared_ptr<SparseMatrix<S>> operator[](int idx) const {
         assert(idx >= 0 && idx < n);
         shared_ptr<SparseMatrix<S>> r = make_shared<SparseMatrix<S>>();
@@ -2067,28 +2330,16 @@ template <typename S> struct SparseMatrixGroup {
         }
         for (int ir = 0; ir < nr; ir++)
             assert(it[ir] == tmp[ir + 1] - tmp[ir]);
-        vector<shared_ptr<Tensor>> merged_l(nr);
-        r.resize(nr);
-        s.resize(nr);
-        int ntg = threading->activate_global();
-#pragma omp parallel for schedule(dynamic) num_threads(ntg)
+        vector<shared_ptr<Tensor>> merged_l;
+        vector<MatrixRef> mats;
+        mats.reserve(nr);
         for (int ir = 0; ir < nr; ir++) {
             MKL_INT nxr = (MKL_INT)sz[ir],
                     nxl = (MKL_INT)((tmp[ir + 1] - tmp[ir]) / nxr);
             assert((tmp[ir + 1] - tmp[ir]) % nxr == 0);
-            MKL_INT nxk = min(nxl, nxr);
-            shared_ptr<Tensor> tsl =
-                make_shared<Tensor>(vector<MKL_INT>{nxl, nxk});
-            shared_ptr<Tensor> tss = make_shared<Tensor>(vector<MKL_INT>{nxk});
-            shared_ptr<Tensor> tsr =
-                make_shared<Tensor>(vector<MKL_INT>{nxk, nxr});
-            MatrixFunctions::svd(MatrixRef(dt + tmp[ir], nxl, nxr), tsl->ref(),
-                                 tss->ref().flip_dims(), tsr->ref());
-            merged_l[ir] = tsl;
-            s[ir] = tss;
-            r[ir] = tsr;
-        }
-        threading->activate_normal();
+            mats.push_back(MatrixRef(dt + tmp[ir], nxl, nxr));
+        }
+        SparseMatrix<S>::block_svd(mats, merged_l, s, r, 0, 0, 0);
         memset(it.data(), 0, sizeof(size_t) * nr);
         l.resize(xinfos.size());
         for (int ii = 0; ii < (int)xinfos.size(); ii++) {
@@ -2179,28 +2430,16 @@ template <typename S> struct SparseMatrixGroup {
         }
         for (int il = 0; il < nl; il++)
             assert(it[il] == (tmp[il + 1] - tmp[il]) / sz[il]);
-        vector<shared_ptr<Tensor>> merged_r(nl);
-        l.resize(nl);
-        s.resize(nl);
-        int ntg = threading->activate_global();
-#pragma omp parallel for schedule(dynamic) num_threads(ntg)
+        vector<shared_ptr<Tensor>> merged_r;
+        vector<MatrixRef> mats;
+        mats.reserve(nl);
         for (int il = 0; il < nl; il++) {
             MKL_INT nxl = (MKL_INT)sz[il],
                     nxr = (MKL_INT)((tmp[il + 1] - tmp[il]) / nxl);
             assert((tmp[il + 1] - tmp[il]) % nxl == 0);
-            MKL_INT nxk = min(nxl, nxr);
-            shared_ptr<Tensor> tsl =
-                make_shared<Tensor>(vector<MKL_INT>{nxl, nxk});
-            shared_ptr<Tensor> tss = make_shared<Tensor>(vector<MKL_INT>{nxk});
-            shared_ptr<Tensor> tsr =
-                make_shared<Tensor>(vector<MKL_INT>{nxk, nxr});
-            MatrixFunctions::svd(MatrixRef(dt + tmp[il], nxl, nxr), tsl->ref(),
-                                 tss->ref().flip_dims(), tsr->ref());
-            l[il] = tsl;
-            s[il] = tss;
-            merged_r[il] = tsr;
-        }
-        threading->activate_normal();
+            mats.push_back(MatrixRef(dt + tmp[il], nxl, nxr));
+        }
+        SparseMatrix<S>::block_svd(mats, l, s, merged_r, 0, 0, 0);
         memset(it.data(), 0, sizeof(size_t) * nl);
         r.resize(xinfos.size());
         for (int ii = 0; ii < (int)xinfos.size(); ii++) {
@@ -52,6 +52,44 @@ typedef int32_t total_bond_t;
 #endif
 #endif
 
+// Open addressing hash table from quantum numbers to their positions in
+// a quanta array, for O(1) find_state when there are many quanta.
+// It is only valid for the array (address and length) it was built for.
+template <typename S> struct QuantaIndex {
+    vector<int> table;
+    const S *quanta;
+    int n, shift;
+    QuantaIndex(const S *quanta, int n) : quanta(quanta), n(n), shift(64) {
+        size_t sz = 1;
+        for (; sz < (size_t)n * 2; sz <<= 1)
+            shift--;
+        table.resize(sz, -1);
+        for (int i = 0; i < n; i++) {
+            size_t h = slot(quanta[i]);
+            while (table[h] != -1)
+                h = (h + 1) & (sz - 1);
+            table[h] = i;
+        }
+    }
+    // Smallest number of quanta for which an index is built
+    static int &min_size() {
+        static int min_size = 32;
+        return min_size;
+    }
+    bool valid_for(const S *q, int nq) const { return quanta == q && n == nq; }
+    size_t slot(S q) const {
+        return shift == 64 ? 0
+                           : (size_t)(((uint64_t)q.hash() *
+                                       (uint64_t)11400714819323198485ULL) >>
+                                      shift);
+    }
+    int find(S q) const {
+        for (size_t h = slot(q);; h = (h + 1) & (table.size() - 1))
+            if (table[h] == -1 || quanta[table[h]] == q)
+                return table[h];
+    }
+};
+
 template <typename, typename = void> struct StateInfo;
 
 // A collection of quantum symmetry labels and their quantity
@@ -66,10 +104,12 @@ struct StateInfo<S,
     ubond_t *n_states;
     int n;
     total_bond_t n_states_total;
+    // Optional index for find_state, see build_index
+    shared_ptr<QuantaIndex<S>> index;
     StateInfo()
         : quanta(nullptr), n_states(nullptr), n_states_total(0), n(0),
-          vdata(nullptr) {}
-    StateInfo(S q) : vdata(nullptr) {
+          vdata(nullptr), index(nullptr) {}
+    StateInfo(S q) : vdata(nullptr), index(nullptr) {
         allocate(1);
         quanta[0] = q, n_states[0] = 1, n_states_total = 1;
     }
@@ -81,6 +121,7 @@ struct StateInfo<S,
         ifs.read((char *)ptr, sizeof(uint32_t) * _SI_MEM_SIZE(n));
         quanta = (S *)ptr;
         n_states = (ubond_t *)(ptr + n * (sizeof(S) >> 2));
+        index = nullptr;
     }
     void load_data(const string &filename) {
         ifstream ifs(filename.c_str(), ios::binary);
@@ -120,8 +161,10 @@ struct StateInfo<S,
         n = length;
         quanta = (S *)ptr;
         n_states = (ubond_t *)(ptr + length * (sizeof(S) >> 2));
+        index = nullptr;
     }
     void reallocate(int length) {
+        index = nullptr;
         if (length < n) {
             memmove((uint32_t *)(quanta + length), (uint32_t *)n_states,
                     length * sizeof(ubond_t));
@@ -142,6 +185,7 @@ struct StateInfo<S,
         vdata = nullptr;
         quanta = nullptr;
         n_states = nullptr;
+        index = nullptr;
     }
     StateInfo deep_copy() const {
         StateInfo other;
@@ -155,6 +199,7 @@ struct StateInfo<S,
         memcpy(other.quanta, quanta, _SI_MEM_SIZE(n) * sizeof(uint32_t));
     }
     void sort_states() {
+        index = nullptr;
         vector<int> idx(n);
         vector<S> q(quanta, quanta + n);
         vector<ubond_t> nq(n_states, n_states + n);
@@ -190,7 +235,17 @@ struct StateInfo<S,
         for (int i = 0; i < n; i++)
             n_states_total += n_states[i];
     }
+    // Build the hash index used by find_state (only for many quanta).
+    // The index is dropped when quanta is reallocated or sorted here,
+    // but must be rebuilt after quanta is modified in place elsewhere.
+    void build_index() {
+        index = n >= QuantaIndex<S>::min_size()
+                    ? make_shared<QuantaIndex<S>>(quanta, n)
+                    : nullptr;
+    }
     int find_state(S q) const {
+        if (index != nullptr && index->valid_for(quanta, n))
+            return index->find(q);
         auto p = lower_bound(quanta, quanta + n, q);
         if (p == quanta + n || *p != q)
             return -1;
@@ -229,6 +284,7 @@ struct StateInfo<S,
         c.allocate(cref.n);
         memcpy(c.quanta, cref.quanta, c.n * sizeof(S));
         memset(c.n_states, 0, c.n * sizeof(ubond_t));
+        c.build_index();
         for (int i = 0; i < a.n; i++)
             for (int j = 0; j < b.n; j++) {
                 S qc = a.quanta[i] + b.quanta[j];
@@ -248,50 +304,79 @@ struct StateInfo<S,
     }
     // Tensor product of StateInfo a and b
     // Resulting state that larger than target will be removed
+    // States above target are never generated, and the remaining products
+    // are sorted and merged in one pass
     static StateInfo tensor_product(const StateInfo &a, const StateInfo &b,
                                     S target) {
-        int nc = 0;
+        vector<pair<S, ubond_t>> qs;
+        qs.reserve((size_t)a.n * b.n);
         for (int i = 0; i < a.n; i++)
-            for (int j = 0; j < b.n; j++)
-                nc += (a.quanta[i] + b.quanta[j]).count();
-        StateInfo c;
-        c.allocate(nc);
-        for (int i = 0, ic = 0; i < a.n; i++)
             for (int j = 0; j < b.n; j++) {
                 S qc = a.quanta[i] + b.quanta[j];
-                for (int k = 0; k < qc.count(); k++) {
-                    c.quanta[ic + k] = qc[k];
-                    uint32_t nprod =
-                        (uint32_t)a.n_states[i] * (uint32_t)b.n_states[j];
-                    c.n_states[ic + k] = (ubond_t)min(
-                        nprod, (uint32_t)numeric_limits<ubond_t>::max());
-                }
-                ic += qc.count();
+                uint32_t nprod =
+                    (uint32_t)a.n_states[i] * (uint32_t)b.n_states[j];
+                if (nprod == 0)
+                    continue;
+                for (int k = 0; k < qc.count(); k++)
+                    if (qc[k].n() <= target.n())
+                        qs.push_back(make_pair(
+                            qc[k],
+                            (ubond_t)min(
+                                nprod,
+                                (uint32_t)numeric_limits<ubond_t>::max())));
             }
-        c.sort_states();
-        c.collect(target);
+        sort(qs.begin(), qs.end(),
+             [](const pair<S, ubond_t> &x, const pair<S, ubond_t> &y) {
+                 return x.first < y.first;
+             });
+        int nc = 0;
+        for (size_t i = 0; i < qs.size(); i++)
+            if (nc == 0 || qs[i].first != qs[nc - 1].first)
+                qs[nc++] = qs[i];
+            else
+                qs[nc - 1].second = (ubond_t)min(
+                    (uint32_t)qs[nc - 1].second + qs[i].second,
+                    (uint32_t)numeric_limits<ubond_t>::max());
+        StateInfo c;
+        c.allocate(nc);
+        for (int i = 0; i < nc; i++) {
+            c.quanta[i] = qs[i].first, c.n_states[i] = qs[i].second;
+            c.n_states_total += c.n_states[i];
+        }
         return c;
     }
     // Connection info for tensor product c of StateInfo a and b
     // For determining stride in tensor product of two SparseMatrix
     static StateInfo get_connection_info(const StateInfo &a, const StateInfo &b,
                                          const StateInfo &c) {
-        map<S, vector<S>> mp;
-        int nc = 0, iab = 0;
+        // (quantum number in c, packed index pair in a and b)
+        vector<pair<S, S>> mp;
         for (int i = 0; i < a.n; i++)
             for (int j = 0; j < b.n; j++) {
                 S qc = a.quanta[i] + b.quanta[j];
-                nc += qc.count();
                 for (int k = 0; k < qc.count(); k++)
-                    mp[qc[k]].push_back(S((i << 16) + j));
+                    mp.push_back(make_pair(qc[k], S((i << 16) + j)));
             }
+        const int nc = (int)mp.size();
+        // stable, so that pairs of each quantum number keep their order
+        stable_sort(mp.begin(), mp.end(),
+                    [](const pair<S, S> &x, const pair<S, S> &y) {
+                        return x.first < y.first;
+                    });
         StateInfo ci;
         ci.allocate(nc);
+        int iab = 0;
         for (int ic = 0; ic < c.n; ic++) {
-            vector<S> &v = mp.at(c.quanta[ic]);
+            typename vector<pair<S, S>>::iterator p = lower_bound(
+                mp.begin(), mp.end(), make_pair(c.quanta[ic], S()),
+                [](const pair<S, S> &x, const pair<S, S> &y) {
+                    return x.first < y.first;
+                });
+            if (p == mp.end() || p->first != c.quanta[ic])
+                throw out_of_range("StateInfo::get_connection_info");
             ci.n_states[ic] = iab;
-            memcpy(ci.quanta + iab, v.data(), v.size() * sizeof(S));
-            iab += (int)v.size();
+            for (; p != mp.end() && p->first == c.quanta[ic]; ++p)
+                ci.quanta[iab++] = p->second;
         }
         ci.reallocate(iab);
         ci.n_states_total = c.n;
@@ -160,7 +160,8 @@ inline ostream &operator<<(ostream &os, const shared_ptr<Symbolic<S>> sym) {
 }
 
 template <typename S>
-inline void save_symbolic(const shared_ptr<Symbolic<S>> &x, ostream &ofs) {
+inline void save_symbolic(const shared_ptr<Symbolic<S>> &x, ostream &ofs,
+                          OpElementPool<S> *pool = nullptr) {
     SymTypes tp = x->get_type();
     ofs.write((char *)&tp, sizeof(tp));
     ofs.write((char *)&x->m, sizeof(x->m));
@@ -169,7 +170,7 @@ inline void save_symbolic(const shared_ptr<Symbolic<S>> &x, ostream &ofs) {
     ofs.write((char *)&sz, sizeof(sz));
     for (int i = 0; i < sz; i++) {
         assert(x->data[i] != nullptr);
-        save_expr(x->data[i], ofs);
+        save_expr(x->data[i], ofs, pool);
     }
     if (tp == SymTypes::RVec)
         assert(x->m == 1 && sz == x->n);
@@ -184,7 +185,8 @@ inline void save_symbolic(const shared_ptr<Symbolic<S>> &x, ostream &ofs) {
 }
 
 template <typename S>
-inline shared_ptr<Symbolic<S>> load_symbolic(istream &ifs) {
+inline shared_ptr<Symbolic<S>>
+load_symbolic(istream &ifs, const OpElementPool<S> *pool = nullptr) {
     SymTypes tp;
     int m, n, sz;
     ifs.read((char *)&tp, sizeof(tp));
@@ -193,7 +195,7 @@ inline shared_ptr<Symbolic<S>> load_symbolic(istream &ifs) {
     ifs.read((char *)&sz, sizeof(sz));
     vector<shared_ptr<OpExpr<S>>> data(sz);
     for (int i = 0; i < sz; i++)
-        data[i] = load_expr<S>(ifs);
+        data[i] = load_expr<S>(ifs, pool);
     if (tp == SymTypes::RVec) {
         assert(m == 1 && sz == n);
         return make_shared<SymbolicRowVector<S>>(n, data);
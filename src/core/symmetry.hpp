@@ -23,6 +23,7 @@
 #include <cstdint>
 #include <sstream>
 #include <string>
+#include <type_traits>
 
 using namespace std;
 
@@ -463,6 +464,155 @@ struct SZLZ {
     }
 };
 
+// Quantum number with particle number, projected spin,
+// point group irreducible representation, and K space symmetry
+// (non-spin-adapted), with bit widths chosen at compile time
+// KMod is the modulo of the K space symmetry, where zero means 1 << KB
+// N/2S are signed; KMod/K/PG are unsigned; PG is multiplied by XOR
+// (N: NB bits) - (0) - (2S: SB bits) - (KMod: KMB bits) - (K: KB bits)
+//     - (pg: PB bits)
+// SZPacked<16, 16, 0, 0, 16> has the same layout as SZLongLong
+// SZPacked<16, 16, 14, 14, 4> has the same layout as SZKLong
+template <int NB, int SB, int KMB, int KB, int PB, typename T = uint64_t>
+struct SZPacked {
+    typedef void is_sz_t;
+    typedef uint32_t pg_t;
+    typedef typename make_signed<T>::type signed_t;
+    static_assert(is_unsigned<T>::value, "storage type must be unsigned");
+    static_assert(NB > 0 && NB <= 32 && SB > 0 && SB <= 32,
+                  "N and 2S must have 1 ~ 32 bits");
+    static_assert(KMB >= 0 && KB >= 0 && PB >= 0 && KMB + KB + PB <= 32,
+                  "KMod, K and PG must fit in 32 bits");
+    static_assert(NB + SB + KMB + KB + PB <= (int)sizeof(T) * 8,
+                  "bit fields exceed the storage type");
+    static constexpr int n_bits = (int)sizeof(T) * 8;
+    static constexpr int k_shift = PB, kmod_shift = PB + KB;
+    static constexpr int twos_shift = PB + KB + KMB, n_shift = n_bits - NB;
+    static constexpr T n_mask = (((T)1 << NB) - 1) << n_shift;
+    static constexpr T twos_mask = (((T)1 << SB) - 1) << twos_shift;
+    static constexpr T kmod_mask = (((T)1 << KMB) - 1) << kmod_shift;
+    static constexpr T k_mask = (((T)1 << KB) - 1) << k_shift;
+    static constexpr T pg_pg_mask = ((T)1 << PB) - 1;
+    static constexpr T pg_mask = ((T)1 << twos_shift) - 1;
+    T data;
+    // S(invalid) must have maximal particle number n
+    const static T invalid = (T)(~(T)0) >> 1;
+    SZPacked() : data(0) {}
+    SZPacked(T data) : data(data) {}
+    SZPacked(int n, int twos, int pg) : data(encode(n, twos, pg)) {}
+    SZPacked(int n, int twos, int kmod, int k, int pg)
+        : data(encode(n, twos, (int)pg_combine(pg, k, kmod))) {}
+    static constexpr T encode(int n, int twos, int pg) noexcept {
+        return (((T)n << n_shift) & n_mask) |
+               (((T)twos << twos_shift) & twos_mask) |
+               ((T)(pg_t)pg & pg_mask);
+    }
+    // sign-extend the field of width bits starting at shift
+    static constexpr int decode(T x, int shift, int bits) noexcept {
+        return (int)((signed_t)(x << (n_bits - shift - bits)) >>
+                     (n_bits - bits));
+    }
+    int n() const { return decode(data, n_shift, NB); }
+    int twos() const { return decode(data, twos_shift, SB); }
+    int pg() const { return (int)(data & pg_mask); }
+    int pg_pg() const { return (int)(data & pg_pg_mask); }
+    int pg_k() const { return (int)((data & k_mask) >> k_shift); }
+    int pg_k_mod() const { return (int)((data & kmod_mask) >> kmod_shift); }
+    void set_n(int n) {
+        data = (data & ~n_mask) | (((T)n << n_shift) & n_mask);
+    }
+    void set_twos(int twos) {
+        data = (data & ~twos_mask) | (((T)twos << twos_shift) & twos_mask);
+    }
+    void set_pg(int pg) { data = (data & ~pg_mask) | ((T)(pg_t)pg & pg_mask); }
+    int multiplicity() const noexcept { return 1; }
+    bool is_fermion() const noexcept { return twos() & 1; }
+    bool operator==(SZPacked other) const noexcept {
+        return (data & ~kmod_mask) == (other.data & ~kmod_mask);
+    }
+    bool operator!=(SZPacked other) const noexcept {
+        return (data & ~kmod_mask) != (other.data & ~kmod_mask);
+    }
+    bool operator<(SZPacked other) const noexcept {
+        return (data & ~kmod_mask) < (other.data & ~kmod_mask);
+    }
+    // k and kmod are unshifted; kmod == 0 means modulo 1 << KB
+    static constexpr T k_add(T k, T kmod) noexcept {
+        return kmod == 0 ? k & (((T)1 << KB) - 1) : (k >= kmod ? k - kmod : k);
+    }
+    static constexpr T k_neg(T k, T kmod) noexcept {
+        return k == 0 ? 0 : (kmod == 0 ? ((T)1 << KB) - k : kmod - k);
+    }
+    // only the KMod/K/PG bits of the result are set
+    static constexpr T pg_add(T a, T b) noexcept {
+        return ((a ^ b) & pg_pg_mask) | ((a | b) & kmod_mask) |
+               (k_add(((a & k_mask) + (b & k_mask)) >> k_shift,
+                      ((a | b) & kmod_mask) >> kmod_shift)
+                << k_shift);
+    }
+    static constexpr T pg_neg(T a) noexcept {
+        return (a & (pg_pg_mask | kmod_mask)) |
+               (k_neg((a & k_mask) >> k_shift,
+                      (a & kmod_mask) >> kmod_shift)
+                << k_shift);
+    }
+    SZPacked operator-() const noexcept {
+        return SZPacked((((~data) + ((T)1 << n_shift)) & n_mask) |
+                        (((~data) + ((T)1 << twos_shift)) & twos_mask) |
+                        pg_neg(data));
+    }
+    SZPacked operator-(SZPacked other) const noexcept {
+        return *this + (-other);
+    }
+    SZPacked operator+(SZPacked other) const noexcept {
+        return SZPacked((((data & n_mask) + (other.data & n_mask)) & n_mask) |
+                        (((data & twos_mask) + (other.data & twos_mask)) &
+                         twos_mask) |
+                        pg_add(data, other.data));
+    }
+    SZPacked operator[](int i) const noexcept { return *this; }
+    SZPacked get_ket() const noexcept { return *this; }
+    SZPacked get_bra(SZPacked dq) const noexcept { return *this + dq; }
+    static inline int pg_inv(int a) noexcept {
+        return (int)pg_neg((T)(pg_t)a);
+    }
+    static inline int pg_mul(int a, int b) noexcept {
+        return (int)pg_add((T)(pg_t)a, (T)(pg_t)b);
+    }
+    static inline pg_t pg_combine(int pg, int k = 0, int kmod = 0) noexcept {
+        return (pg_t)((((T)kmod << kmod_shift) & kmod_mask) |
+                      (((T)k << k_shift) & k_mask) |
+                      ((T)pg & pg_pg_mask));
+    }
+    static inline bool pg_equal(int a, int b) noexcept {
+        return (((T)(pg_t)a ^ (T)(pg_t)b) & (pg_mask & ~kmod_mask)) == 0;
+    }
+    SZPacked combine(SZPacked bra, SZPacked ket) const {
+        return ket + *this == bra ? ket : SZPacked(invalid);
+    }
+    size_t hash() const noexcept { return (size_t)(data & ~kmod_mask); }
+    int count() const noexcept { return 1; }
+    string to_str() const {
+        stringstream ss;
+        ss << "< N=" << n() << " SZ=";
+        if (twos() & 1)
+            ss << twos() << "/2";
+        else
+            ss << (twos() >> 1);
+        if (KB != 0) {
+            ss << " K=" << pg_k();
+            if (pg_k_mod())
+                ss << "/" << pg_k_mod();
+        }
+        ss << " PG=" << pg_pg() << " >";
+        return ss.str();
+    }
+    friend ostream &operator<<(ostream &os, SZPacked c) {
+        os << c.to_str();
+        return os;
+    }
+};
+
 // Quantum number with particle number, SU(2) spin
 // and point group irreducible representation (spin-adapted)
 // (N: 8bits) - (2SL: 8bits) - (2S: 8bits) - (0: 5bits) - (pg: 3bits)
@@ -1202,4 +1352,27 @@ inline void swap(block2::SU2K &a, block2::SU2K &b) {
     a.data ^= b.data, b.data ^= a.data, a.data ^= b.data;
 }
 
+template <int NB, int SB, int KMB, int KB, int PB, typename T>
+struct hash<block2::SZPacked<NB, SB, KMB, KB, PB, T>> {
+    size_t operator()(
+        const block2::SZPacked<NB, SB, KMB, KB, PB, T> &s) const noexcept {
+        return s.hash();
+    }
+};
+
+template <int NB, int SB, int KMB, int KB, int PB, typename T>
+struct less<block2::SZPacked<NB, SB, KMB, KB, PB, T>> {
+    bool operator()(
+        const block2::SZPacked<NB, SB, KMB, KB, PB, T> &lhs,
+        const block2::SZPacked<NB, SB, KMB, KB, PB, T> &rhs) const noexcept {
+        return lhs < rhs;
+    }
+};
+
+template <int NB, int SB, int KMB, int KB, int PB, typename T>
+inline void swap(block2::SZPacked<NB, SB, KMB, KB, PB, T> &a,
+                 block2::SZPacked<NB, SB, KMB, KB, PB, T> &b) {
+    a.data ^= b.data, b.data ^= a.data, a.data ^= b.data;
+}
+
 } // namespace std
@@ -43,6 +43,8 @@ enum struct TensorFunctionsTypes : uint8_t {
 // Operations for operator tensors
 template <typename S> struct TensorFunctions {
     shared_ptr<OperatorFunctions<S>> opf;
+    // stack for temporary matrices in parallel tasks (per thread)
+    shared_ptr<StackAllocator<double>> d_arena = nullptr;
     TensorFunctions(const shared_ptr<OperatorFunctions<S>> &opf) : opf(opf) {}
     virtual ~TensorFunctions() = default;
     virtual TensorFunctionsTypes get_type() const {
@@ -55,6 +57,28 @@ template <typename S> struct TensorFunctions {
                             double scale = 1.0) {
         opf->seq->operator()(b, c, scale);
     }
+    // [c] = [H_eff] x [b] for several vectors at once
+    virtual void multiply_panel(const vector<MatrixRef> &bs,
+                                const vector<MatrixRef> &cs) {
+        opf->seq->operator()(bs, cs);
+    }
+    // Switch the matvec back to double precision once the Davidson
+    // residual is below the threshold for single precision
+    // Returns true if the precision is changed
+    bool precision_hint(double qq, double conv_thrd) {
+        if (!opf->seq->single_prec ||
+            qq >= max(opf->seq->single_prec_thrd, conv_thrd))
+            return false;
+        opf->seq->single_prec = false;
+        return true;
+    }
+    // allocator for one temporary matrix of size n in a parallel task
+    shared_ptr<Allocator<double>> temp_allocator(size_t n) const {
+        if (d_arena != nullptr &&
+            d_arena->used + d_arena->aligned_size(n) < d_arena->size)
+            return d_arena;
+        return make_shared<VectorAllocator<double>>();
+    }
     template <typename T> void serial_for(size_t n, T op) const {
         shared_ptr<TensorFunctions<S>> tf =
             make_shared<TensorFunctions<S>>(*this);
@@ -75,10 +99,29 @@ template <typename S> struct TensorFunctions {
                 tfs.push_back(this->copy());
                 tfs[i]->opf->seq->cumulative_nflop = 0;
             }
+            // per-thread arenas are released when all tasks finish
+            vector<shared_ptr<StackAllocator<double>>> arenas;
+            if (frame->thread_arenas)
+                arenas = frame->split_free_stack(1, ntop);
+            for (size_t i = 0; i < arenas.size(); i++)
+                tfs[i]->d_arena = arenas[i];
+            TracerScope _tr("parallel_for", n);
+            // with static scheduling, the collected tasks (if any)
+            // of all threads are in the same order as in serial
+            if (threading->deterministic_slots != 0) {
+#pragma omp parallel for schedule(static) num_threads(ntop)
+                for (int i = 0; i < (int)n; i++) {
+                    int tid = threading->get_thread_id();
+                    TracerScope _trt("parallel_for_task", i);
+                    op(tfs[tid], (size_t)i);
+                }
+            } else {
 #pragma omp parallel for schedule(dynamic) num_threads(ntop)
-            for (int i = 0; i < (int)n; i++) {
-                int tid = threading->get_thread_id();
-                op(tfs[tid], (size_t)i);
+                for (int i = 0; i < (int)n; i++) {
+                    int tid = threading->get_thread_id();
+                    TracerScope _trt("parallel_for_task", i);
+                    op(tfs[tid], (size_t)i);
+                }
             }
             tf_sz[1].first = opf->seq->batch[0]->gp.size();
             tf_sz[1].second = opf->seq->batch[1]->gp.size();
@@ -131,13 +174,14 @@ template <typename S> struct TensorFunctions {
         shared_ptr<TensorFunctions<S>> tf =
             make_shared<TensorFunctions<S>>(*this);
         int ntop = threading->activate_operator();
-        if (ntop == 1) {
+        const int nslot = threading->get_reduce_slots(ntop);
+        if (nslot == 1) {
             for (size_t i = 0; i < n; i++)
                 op(tf, mat, i);
         } else {
             vector<shared_ptr<SM>> mats(1, mat);
             vector<shared_ptr<TensorFunctions<S>>> tfs(1, tf);
-            mats.resize(ntop, nullptr);
+            mats.resize(nslot, nullptr);
             for (int i = 1; i < ntop; i++) {
                 tfs.push_back(this->copy());
                 tfs[i]->opf->seq->cumulative_nflop = 0;
@@ -145,20 +189,38 @@ template <typename S> struct TensorFunctions {
 #pragma omp parallel num_threads(ntop)
             {
                 int tid = threading->get_thread_id();
-                if (tid != 0) {
+                for (int is = tid == 0 ? ntop : tid; is < nslot; is += ntop) {
                     shared_ptr<VectorAllocator<double>> d_alloc =
                         make_shared<VectorAllocator<double>>();
-                    mats[tid] = make_shared<SM>(d_alloc);
-                    mats[tid]->allocate_like(mat);
+                    mats[is] = make_shared<SM>(d_alloc);
+                    mats[is]->allocate_like(mat);
                 }
+                if (threading->deterministic_slots != 0) {
+                    // each slot takes a fixed range of tasks in order
+                    for (int is = tid; is < nslot; is += ntop)
+                        for (size_t i = n * is / nslot;
+                             i < n * (is + 1) / nslot; i++) {
+                            TracerScope _trt("parallel_reduce_task", i);
+                            op(tfs[tid], mats[is], i);
+                        }
+#pragma omp barrier
+                } else {
 #pragma omp for schedule(dynamic)
-                for (int i = 0; i < (int)n; i++)
-                    op(tfs[tid], mats[tid], (size_t)i);
+                    for (int i = 0; i < (int)n; i++) {
+                        TracerScope _trt("parallel_reduce_task", i);
+                        op(tfs[tid], mats[tid], (size_t)i);
+                    }
+                }
+                TracerScope _trr("reduce");
+                if (threading->reduce_chunk != 0)
+                    tfs[tid]->opf->chunked_reduce(mats);
+                else {
 #pragma omp single
-                tfs[tid]->opf->parallel_reduce(mats, 0, ntop);
-                if (tid != 0) {
-                    mats[tid]->deallocate();
-                    mats[tid] = nullptr;
+                    tfs[tid]->opf->parallel_reduce(mats, 0, nslot);
+                }
+                for (int is = tid == 0 ? ntop : tid; is < nslot; is += ntop) {
+                    mats[is]->deallocate();
+                    mats[is] = nullptr;
                 }
             }
             for (int i = 1; i < ntop; i++)
@@ -289,8 +351,8 @@ template <typename S> struct TensorFunctions {
             if (trace_right) {
                 assert(lopt->ops.count(op->a) != 0 &&
                        ropt->ops.count(i_op) != 0);
-                shared_ptr<SparseMatrix<S>> lmat = lopt->ops.at(op->a);
-                shared_ptr<SparseMatrix<S>> rmat = ropt->ops.at(i_op);
+                const shared_ptr<SparseMatrix<S>> &lmat = lopt->ops.at(op->a);
+                const shared_ptr<SparseMatrix<S>> &rmat = ropt->ops.at(i_op);
                 S opdq = (op->conj & 1) ? -op->a->q_label : op->a->q_label;
                 S pks = cmat->info->delta_quantum + opdq;
                 int ij = (int)(lower_bound(
@@ -301,6 +363,10 @@ template <typename S> struct TensorFunctions {
                     S vdq = pks[k];
                     int iv = (int)(lower_bound(vdqs.begin(), vdqs.end(), vdq) -
                                    vdqs.begin());
+                    // vdq may be out of the streamed part of vmats
+                    if (vidx == -1 &&
+                        (iv == (int)vdqs.size() || vdqs[iv] != vdq))
+                        continue;
                     if (tvidx >= 0 && tvidx != iv)
                         continue;
                     shared_ptr<SparseMatrix<S>> vmat =
@@ -318,8 +384,8 @@ template <typename S> struct TensorFunctions {
             } else {
                 assert(lopt->ops.count(i_op) != 0 &&
                        ropt->ops.count(op->b) != 0);
-                shared_ptr<SparseMatrix<S>> lmat = lopt->ops.at(i_op);
-                shared_ptr<SparseMatrix<S>> rmat = ropt->ops.at(op->b);
+                const shared_ptr<SparseMatrix<S>> &lmat = lopt->ops.at(i_op);
+                const shared_ptr<SparseMatrix<S>> &rmat = ropt->ops.at(op->b);
                 S opdq = (op->conj & 2) ? -op->b->q_label : op->b->q_label;
                 S pks = cmat->info->delta_quantum + opdq;
                 int ij =
@@ -331,6 +397,10 @@ template <typename S> struct TensorFunctions {
                     S vdq = pks[k];
                     int iv = (int)(lower_bound(vdqs.begin(), vdqs.end(), vdq) -
                                    vdqs.begin());
+                    // vdq may be out of the streamed part of vmats
+                    if (vidx == -1 &&
+                        (iv == (int)vdqs.size() || vdqs[iv] != vdq))
+                        continue;
                     if (tvidx >= 0 && tvidx != iv)
                         continue;
                     shared_ptr<SparseMatrix<S>> vmat =
@@ -378,8 +448,8 @@ template <typename S> struct TensorFunctions {
             if (trace_right) {
                 assert(lopt->ops.count(op->a) != 0 &&
                        ropt->ops.count(i_op) != 0);
-                shared_ptr<SparseMatrix<S>> lmat = lopt->ops.at(op->a);
-                shared_ptr<SparseMatrix<S>> rmat = ropt->ops.at(i_op);
+                const shared_ptr<SparseMatrix<S>> &lmat = lopt->ops.at(op->a);
+                const shared_ptr<SparseMatrix<S>> &rmat = ropt->ops.at(i_op);
                 S opdq = (op->conj & 1) ? -op->a->q_label : op->a->q_label;
                 S pks = cmat->info->delta_quantum + opdq;
                 int ij = (int)(lower_bound(
@@ -390,6 +460,10 @@ template <typename S> struct TensorFunctions {
                     S vdq = pks[k];
                     int iv = (int)(lower_bound(vdqs.begin(), vdqs.end(), vdq) -
                                    vdqs.begin());
+                    // vdq may be out of the streamed part of vmats
+                    if (vidx == -1 &&
+                        (iv == (int)vdqs.size() || vdqs[iv] != vdq))
+                        continue;
                     if (tvidx >= 0 && tvidx != iv)
                         continue;
                     shared_ptr<SparseMatrix<S>> vmat =
@@ -407,8 +481,8 @@ template <typename S> struct TensorFunctions {
             } else {
                 assert(lopt->ops.count(i_op) != 0 &&
                        ropt->ops.count(op->b) != 0);
-                shared_ptr<SparseMatrix<S>> lmat = lopt->ops.at(i_op);
-                shared_ptr<SparseMatrix<S>> rmat = ropt->ops.at(op->b);
+                const shared_ptr<SparseMatrix<S>> &lmat = lopt->ops.at(i_op);
+                const shared_ptr<SparseMatrix<S>> &rmat = ropt->ops.at(op->b);
                 S opdq = (op->conj & 2) ? -op->b->q_label : op->b->q_label;
                 S pks = cmat->info->delta_quantum + opdq;
                 int ij =
@@ -420,6 +494,10 @@ template <typename S> struct TensorFunctions {
                     S vdq = pks[k];
                     int iv = (int)(lower_bound(vdqs.begin(), vdqs.end(), vdq) -
                                    vdqs.begin());
+                    // vdq may be out of the streamed part of vmats
+                    if (vidx == -1 &&
+                        (iv == (int)vdqs.size() || vdqs[iv] != vdq))
+                        continue;
                     if (tvidx >= 0 && tvidx != iv)
                         continue;
                     shared_ptr<SparseMatrix<S>> vmat =
@@ -556,6 +634,84 @@ template <typename S> struct TensorFunctions {
             break;
         }
     }
+    // vmats[j * nv + iv] += expr x cmats[j * nc + ic] for all roots j
+    // (nc = cmats->n / nroots, nv = vmats->n / nroots)
+    // the product with block ic is done for all roots in turn, so that the
+    // operator blocks of expr are read once from memory for all roots
+    void tensor_product_multi_multiply_roots(
+        const shared_ptr<OpExpr<S>> &expr,
+        const shared_ptr<OperatorTensor<S>> &lopt,
+        const shared_ptr<OperatorTensor<S>> &ropt,
+        const shared_ptr<SparseMatrixGroup<S>> &cmats,
+        const shared_ptr<SparseMatrixGroup<S>> &vmats, int nroots, int ic,
+        const unordered_map<S, int> &vdqs,
+        const unordered_map<
+            S, shared_ptr<typename SparseMatrixInfo<S>::ConnectionInfo>>
+            &cinfos,
+        S opdq, double factor) const {
+        const int nc = cmats->n / nroots, nv = vmats->n / nroots;
+        shared_ptr<SparseMatrixInfo<S>> pcmat_info =
+            make_shared<SparseMatrixInfo<S>>(*cmats->infos[ic]);
+        S cdq = pcmat_info->delta_quantum;
+        S vdq = opdq + cdq;
+        for (int iv = 0; iv < vdq.count(); iv++)
+            if (vdqs.count(vdq[iv])) {
+                pcmat_info->cinfo = cinfos.at(opdq.combine(vdq[iv], cdq));
+                const int jv = vdqs.at(vdq[iv]);
+                for (int j = 0; j < nroots; j++) {
+                    shared_ptr<SparseMatrix<S>> pcmat = (*cmats)[j * nc + ic];
+                    pcmat->factor = factor;
+                    pcmat->info = pcmat_info;
+                    tensor_product_multiply(expr, lopt, ropt, pcmat,
+                                            (*vmats)[j * nv + jv], opdq, false);
+                }
+            }
+    }
+    // vmats = expr x cmats, for nroots wavefunctions at once
+    // cmats (vmats) holds the wavefunctions of all roots one after another,
+    // each with the same n / nroots blocks
+    virtual void tensor_product_multi_multiply_panel(
+        const shared_ptr<OpExpr<S>> &expr,
+        const shared_ptr<OperatorTensor<S>> &lopt,
+        const shared_ptr<OperatorTensor<S>> &ropt,
+        const shared_ptr<SparseMatrixGroup<S>> &cmats,
+        const shared_ptr<SparseMatrixGroup<S>> &vmats, int nroots,
+        const unordered_map<
+            S, shared_ptr<typename SparseMatrixInfo<S>::ConnectionInfo>>
+            &cinfos,
+        S opdq, double factor, bool all_reduce) const {
+        assert(cmats->n % nroots == 0 && vmats->n % nroots == 0);
+        const int nc = cmats->n / nroots, nv = vmats->n / nroots;
+        unordered_map<S, int> vdqs;
+        vdqs.reserve(nv);
+        for (int iv = 0; iv < nv; iv++)
+            vdqs[vmats->infos[iv]->delta_quantum] = iv;
+        switch (expr->get_type()) {
+        case OpTypes::Sum: {
+            shared_ptr<OpSum<S>> op = dynamic_pointer_cast<OpSum<S>>(expr);
+            parallel_reduce(
+                op->strings.size() * nc, vmats,
+                [&op, &lopt, &ropt, &cmats, nroots, &vdqs, &cinfos, opdq,
+                 factor](const shared_ptr<TensorFunctions<S>> &tf,
+                         const shared_ptr<SparseMatrixGroup<S>> &vmats,
+                         size_t idx) {
+                    const size_t i = idx % op->strings.size(),
+                                 ic = idx / op->strings.size();
+                    tf->tensor_product_multi_multiply_roots(
+                        op->strings[i], lopt, ropt, cmats, vmats, nroots,
+                        (int)ic, vdqs, cinfos, opdq, factor);
+                });
+        } break;
+        case OpTypes::Zero:
+            break;
+        default:
+            for (int ic = 0; ic < nc; ic++)
+                tensor_product_multi_multiply_roots(expr, lopt, ropt, cmats,
+                                                    vmats, nroots, ic, vdqs,
+                                                    cinfos, opdq, factor);
+            break;
+        }
+    }
     // fast expectation algorithm for NPDM, by reusing partially contracted
     // left part, assuming there are smaller number of unique left operators
     virtual vector<pair<shared_ptr<OpExpr<S>>, double>>
@@ -599,7 +755,7 @@ template <typename S> struct TensorFunctions {
                     throw runtime_error(
                         "Tensor product expectation with delayed "
                         "contraction not yet supported.");
-                shared_ptr<SparseMatrix<S>> lmat = lopt->ops.at(op->a);
+                const shared_ptr<SparseMatrix<S>> &lmat = lopt->ops.at(op->a);
                 shared_ptr<SparseMatrix<S>> rmat =
                     make_shared<SparseMatrix<S>>(d_alloc);
                 rmat->info = ropt->ops.at(op->b)->info;
@@ -623,7 +779,8 @@ template <typename S> struct TensorFunctions {
                         throw runtime_error(
                             "Tensor product expectation with delayed "
                             "contraction not yet supported.");
-                    shared_ptr<SparseMatrix<S>> lmat = lopt->ops.at(op->a);
+                    const shared_ptr<SparseMatrix<S>> &lmat =
+                        lopt->ops.at(op->a);
                     shared_ptr<SparseMatrix<S>> rmat =
                         make_shared<SparseMatrix<S>>(d_alloc);
                     rmat->info = ropt->ops.at(op->b)->info;
@@ -656,14 +813,18 @@ template <typename S> struct TensorFunctions {
                          const shared_ptr<TensorFunctions<S>> &tf, size_t i) {
                          uint8_t conj = get<0>(vparts[i]);
                          S opdq = get<1>(vparts[i]);
-                         shared_ptr<SparseMatrix<S>> lmat =
+                         const shared_ptr<SparseMatrix<S>> &lmat =
                              lopt->ops.at(get<2>(vparts[i]));
-                         shared_ptr<SparseMatrix<S>> rmat = get<3>(vparts[i]);
+                         const shared_ptr<SparseMatrix<S>> &rmat =
+                             get<3>(vparts[i]);
                          tf->opf->tensor_partial_expectation(conj, lmat, rmat,
                                                              cmat, vmat, opdq);
                      });
-        vector<size_t> prod_idxs;
-        prod_idxs.reserve(exprs.size());
+        // all (term, string) pairs are distributed in one parallel loop
+        // with thread-private accumulators, so that many terms with few
+        // strings (as in NPDM) still use all threads
+        vector<pair<size_t, shared_ptr<OpProduct<S>>>> prods;
+        prods.reserve(exprs.size());
         for (size_t k = 0; k < exprs.size(); k++) {
             shared_ptr<OpExpr<S>> expr = exprs[k];
             S opdq = dynamic_pointer_cast<OpElement<S>>(names[k])->q_label;
@@ -672,25 +833,13 @@ template <typename S> struct TensorFunctions {
                 continue;
             switch (expr->get_type()) {
             case OpTypes::Prod:
-                prod_idxs.push_back(k);
+                prods.push_back(
+                    make_pair(k, dynamic_pointer_cast<OpProduct<S>>(expr)));
                 break;
             case OpTypes::Sum: {
                 shared_ptr<OpSum<S>> sop = dynamic_pointer_cast<OpSum<S>>(expr);
-                int ntop = threading->activate_operator();
-                double r = 0;
-#pragma omp parallel for schedule(dynamic) num_threads(ntop) reduction(+ : r)
-                for (int j = 0; j < (int)sop->strings.size(); j++) {
-                    shared_ptr<OpProduct<S>> op = sop->strings[j];
-                    shared_ptr<SparseMatrix<S>> rmat = ropt->ops.at(op->b);
-                    shared_ptr<SparseMatrix<S>> lmat =
-                        partials
-                            .at(make_tuple(op->conj, rmat->info->delta_quantum,
-                                           opdq))
-                            .at(op->a);
-                    r += opf->dot_product(lmat, rmat, op->factor);
-                }
-                threading->activate_normal();
-                expectations[k] = make_pair(names[k], r);
+                for (auto &op : sop->strings)
+                    prods.push_back(make_pair(k, op));
             } break;
             case OpTypes::Zero:
                 break;
@@ -699,24 +848,28 @@ template <typename S> struct TensorFunctions {
                 break;
             }
         }
-        parallel_for(
-            prod_idxs.size(),
-            [&prod_idxs, &ropt, &partials, &exprs, &names, &expectations](
-                const shared_ptr<TensorFunctions<S>> &tf, size_t pk) {
-                size_t k = prod_idxs[pk];
-                shared_ptr<OpExpr<S>> expr = exprs[k];
-                S opdq = dynamic_pointer_cast<OpElement<S>>(names[k])->q_label;
-                shared_ptr<OpProduct<S>> op =
-                    dynamic_pointer_cast<OpProduct<S>>(expr);
-                shared_ptr<SparseMatrix<S>> rmat = ropt->ops.at(op->b);
-                shared_ptr<SparseMatrix<S>> lmat =
-                    partials
-                        .at(make_tuple(op->conj, rmat->info->delta_quantum,
-                                       opdq))
-                        .at(op->a);
-                expectations[k] = make_pair(
-                    names[k], tf->opf->dot_product(lmat, rmat, op->factor));
-            });
+        const int ntop =
+            threading->n_threads_op != 0 ? threading->n_threads_op : 1;
+        vector<vector<double>> accs(ntop, vector<double>(exprs.size(), 0.0));
+        parallel_for(prods.size(), [&prods, &ropt, &partials, &names, &accs,
+                                    ntop](
+                                       const shared_ptr<TensorFunctions<S>> &tf,
+                                       size_t i) {
+            const int tid = ntop == 1 ? 0 : threading->get_thread_id();
+            const size_t k = prods[i].first;
+            const shared_ptr<OpProduct<S>> &op = prods[i].second;
+            S opdq = dynamic_pointer_cast<OpElement<S>>(names[k])->q_label;
+            const shared_ptr<SparseMatrix<S>> &rmat = ropt->ops.at(op->b);
+            shared_ptr<SparseMatrix<S>> lmat =
+                partials
+                    .at(make_tuple(op->conj, rmat->info->delta_quantum, opdq))
+                    .at(op->a);
+            accs[tid][k] +=
+                tf->opf->dot_product(lmat, rmat, op->factor);
+        });
+        for (int it = 0; it < ntop; it++)
+            for (size_t k = 0; k < exprs.size(); k++)
+                expectations[k].second += accs[it][k];
         for (auto &vpart : vparts)
             get<3>(vpart)->deallocate();
         return expectations;
@@ -738,15 +891,17 @@ template <typename S> struct TensorFunctions {
             bool dleft = lopt->get_type() == OperatorTensorTypes::Delayed;
             assert((dleft ? lopt : ropt)->get_type() ==
                    OperatorTensorTypes::Delayed);
-            shared_ptr<SparseMatrix<S>> lmat = lopt->ops.at(op->a);
-            shared_ptr<SparseMatrix<S>> rmat = ropt->ops.at(op->b);
+            const shared_ptr<SparseMatrix<S>> &lmat = lopt->ops.at(op->a);
+            const shared_ptr<SparseMatrix<S>> &rmat = ropt->ops.at(op->b);
             shared_ptr<DelayedOperatorTensor<S>> dopt =
                 dynamic_pointer_cast<DelayedOperatorTensor<S>>(dleft ? lopt
                                                                      : ropt);
             assert(dopt->lopt->ops.count(op->ops[0]) != 0);
             assert(dopt->ropt->ops.count(op->ops[1]) != 0);
-            shared_ptr<SparseMatrix<S>> dlmat = dopt->lopt->ops.at(op->ops[0]);
-            shared_ptr<SparseMatrix<S>> drmat = dopt->ropt->ops.at(op->ops[1]);
+            const shared_ptr<SparseMatrix<S>> &dlmat =
+                dopt->lopt->ops.at(op->ops[0]);
+            const shared_ptr<SparseMatrix<S>> &drmat =
+                dopt->ropt->ops.at(op->ops[1]);
             uint8_t dconj = (uint8_t)op->conjs[0] | (op->conjs[1] << 1);
             opf->three_tensor_product_multiply(op->conj, lmat, rmat, cmat, vmat,
                                                dconj, dlmat, drmat, dleft, opdq,
@@ -757,8 +912,8 @@ template <typename S> struct TensorFunctions {
                 dynamic_pointer_cast<OpProduct<S>>(expr);
             assert(op->a != nullptr && op->b != nullptr);
             assert(lopt->ops.count(op->a) != 0 && ropt->ops.count(op->b) != 0);
-            shared_ptr<SparseMatrix<S>> lmat = lopt->ops.at(op->a);
-            shared_ptr<SparseMatrix<S>> rmat = ropt->ops.at(op->b);
+            const shared_ptr<SparseMatrix<S>> &lmat = lopt->ops.at(op->a);
+            const shared_ptr<SparseMatrix<S>> &rmat = ropt->ops.at(op->b);
             opf->tensor_product_multiply(op->conj, lmat, rmat, cmat, vmat, opdq,
                                          op->factor);
         } break;
@@ -780,6 +935,63 @@ template <typename S> struct TensorFunctions {
             break;
         }
     }
+    // Lower expr into a flat instruction list for repeated vmat = expr x cmat
+    // Returns nullptr if expr contains terms other than products of
+    // normal operators (delayed, CSR or three-operator terms)
+    shared_ptr<TensorProductProgram> compile_tensor_product_multiply(
+        const shared_ptr<OpExpr<S>> &expr,
+        const shared_ptr<OperatorTensor<S>> &lopt,
+        const shared_ptr<OperatorTensor<S>> &ropt,
+        const shared_ptr<SparseMatrix<S>> &cmat,
+        const shared_ptr<SparseMatrix<S>> &vmat, S opdq) const {
+        vector<shared_ptr<OpProduct<S>>> terms;
+        if (expr->get_type() == OpTypes::Prod)
+            terms.push_back(dynamic_pointer_cast<OpProduct<S>>(expr));
+        else if (expr->get_type() == OpTypes::Sum)
+            terms = dynamic_pointer_cast<OpSum<S>>(expr)->strings;
+        else if (expr->get_type() != OpTypes::Zero)
+            return nullptr;
+        if (cmat->get_type() != SparseMatrixTypes::Normal ||
+            vmat->get_type() != SparseMatrixTypes::Normal)
+            return nullptr;
+        shared_ptr<TensorProductProgram> prog =
+            make_shared<TensorProductProgram>();
+        for (auto &op : terms) {
+            if (op->get_type() != OpTypes::Prod)
+                return nullptr;
+            assert(op->a != nullptr && op->b != nullptr);
+            assert(lopt->ops.count(op->a) != 0 && ropt->ops.count(op->b) != 0);
+            const shared_ptr<SparseMatrix<S>> &lmat = lopt->ops.at(op->a);
+            const shared_ptr<SparseMatrix<S>> &rmat = ropt->ops.at(op->b);
+            if (lmat->get_type() != SparseMatrixTypes::Normal ||
+                rmat->get_type() != SparseMatrixTypes::Normal)
+                return nullptr;
+            opf->compile_tensor_product_multiply(op->conj, lmat, rmat, cmat,
+                                                 vmat, opdq, op->factor, *prog);
+            prog->end_term();
+        }
+        return prog;
+    }
+    // vmat = expr x cmat, with expr lowered by compile_tensor_product_multiply
+    void compiled_tensor_product_multiply(
+        const shared_ptr<TensorProductProgram> &prog,
+        const shared_ptr<SparseMatrix<S>> &cmat,
+        const shared_ptr<SparseMatrix<S>> &vmat) const {
+        const double factor = cmat->factor;
+        if (abs(factor) < TINY || prog->n_terms() == 0)
+            return;
+        else if (prog->n_terms() == 1)
+            opf->compiled_tensor_product_multiply(*prog, 0, cmat, vmat, factor);
+        else
+            parallel_reduce(
+                prog->n_terms(), vmat,
+                [&prog, &cmat, factor](const shared_ptr<TensorFunctions<S>> &tf,
+                                       const shared_ptr<SparseMatrix<S>> &vmat,
+                                       size_t i) {
+                    tf->opf->compiled_tensor_product_multiply(*prog, i, cmat,
+                                                              vmat, factor);
+                });
+    }
     // mat = diag(expr)
     virtual void
     tensor_product_diagonal(const shared_ptr<OpExpr<S>> &expr,
@@ -796,15 +1008,17 @@ template <typename S> struct TensorFunctions {
             bool dleft = lopt->get_type() == OperatorTensorTypes::Delayed;
             assert((dleft ? lopt : ropt)->get_type() ==
                    OperatorTensorTypes::Delayed);
-            shared_ptr<SparseMatrix<S>> lmat = lopt->ops.at(op->a);
-            shared_ptr<SparseMatrix<S>> rmat = ropt->ops.at(op->b);
+            const shared_ptr<SparseMatrix<S>> &lmat = lopt->ops.at(op->a);
+            const shared_ptr<SparseMatrix<S>> &rmat = ropt->ops.at(op->b);
             shared_ptr<DelayedOperatorTensor<S>> dopt =
                 dynamic_pointer_cast<DelayedOperatorTensor<S>>(dleft ? lopt
                                                                      : ropt);
             assert(dopt->lopt->ops.count(op->ops[0]) != 0);
             assert(dopt->ropt->ops.count(op->ops[1]) != 0);
-            shared_ptr<SparseMatrix<S>> dlmat = dopt->lopt->ops.at(op->ops[0]);
-            shared_ptr<SparseMatrix<S>> drmat = dopt->ropt->ops.at(op->ops[1]);
+            const shared_ptr<SparseMatrix<S>> &dlmat =
+                dopt->lopt->ops.at(op->ops[0]);
+            const shared_ptr<SparseMatrix<S>> &drmat =
+                dopt->ropt->ops.at(op->ops[1]);
             uint8_t dconj = (uint8_t)op->conjs[0] | (op->conjs[1] << 1);
             opf->three_tensor_product_diagonal(op->conj, lmat, rmat, mat, dconj,
                                                dlmat, drmat, dleft, opdq,
@@ -815,8 +1029,8 @@ template <typename S> struct TensorFunctions {
                 dynamic_pointer_cast<OpProduct<S>>(expr);
             assert(op->a != nullptr && op->b != nullptr);
             assert(lopt->ops.count(op->a) != 0 && ropt->ops.count(op->b) != 0);
-            shared_ptr<SparseMatrix<S>> lmat = lopt->ops.at(op->a);
-            shared_ptr<SparseMatrix<S>> rmat = ropt->ops.at(op->b);
+            const shared_ptr<SparseMatrix<S>> &lmat = lopt->ops.at(op->a);
+            const shared_ptr<SparseMatrix<S>> &rmat = ropt->ops.at(op->b);
             opf->tensor_product_diagonal(op->conj, lmat, rmat, mat, opdq,
                                          op->factor);
         } break;
@@ -869,8 +1083,8 @@ template <typename S> struct TensorFunctions {
                 dynamic_pointer_cast<OpProduct<S>>(expr);
             assert(op->b != nullptr);
             assert(lop.count(op->a) != 0 && rop.count(op->b) != 0);
-            shared_ptr<SparseMatrix<S>> lmat = lop.at(op->a);
-            shared_ptr<SparseMatrix<S>> rmat = rop.at(op->b);
+            const shared_ptr<SparseMatrix<S>> &lmat = lop.at(op->a);
+            const shared_ptr<SparseMatrix<S>> &rmat = rop.at(op->b);
             // here in parallel when not allocated mat->factor = 0, mat->data =
             // 0 but if mat->info->n = 0, mat->data also = 0
             opf->tensor_product(op->conj, lmat, rmat, mat, op->factor);
@@ -881,10 +1095,7 @@ template <typename S> struct TensorFunctions {
             assert((op->a == nullptr) ^ (op->b == nullptr));
             assert(op->ops.size() != 0);
             bool has_intermediate = false;
-            shared_ptr<VectorAllocator<double>> d_alloc =
-                make_shared<VectorAllocator<double>>();
-            shared_ptr<SparseMatrix<S>> tmp =
-                make_shared<SparseMatrix<S>>(d_alloc);
+            shared_ptr<SparseMatrix<S>> tmp = nullptr;
             if (op->c != nullptr && ((op->b == nullptr && rop.count(op->c)) ||
                                      (op->a == nullptr && lop.count(op->c)))) {
                 has_intermediate = true;
@@ -896,6 +1107,8 @@ template <typename S> struct TensorFunctions {
                 shared_ptr<OpExpr<S>> opb =
                     abs_value((shared_ptr<OpExpr<S>>)op->ops[0]);
                 assert(lop.count(op->a) != 0 && rop.count(opb) != 0);
+                tmp = make_shared<SparseMatrix<S>>(
+                    temp_allocator(rop.at(opb)->info->get_total_memory()));
                 tmp->allocate(rop.at(opb)->info);
                 for (size_t i = 0; i < op->ops.size(); i++) {
                     opf->iadd(
@@ -909,6 +1122,8 @@ template <typename S> struct TensorFunctions {
                 shared_ptr<OpExpr<S>> opa =
                     abs_value((shared_ptr<OpExpr<S>>)op->ops[0]);
                 assert(lop.count(opa) != 0 && rop.count(op->b) != 0);
+                tmp = make_shared<SparseMatrix<S>>(
+                    temp_allocator(lop.at(opa)->info->get_total_memory()));
                 tmp->allocate(lop.at(opa)->info);
                 for (size_t i = 0; i < op->ops.size(); i++) {
                     opf->iadd(
@@ -945,6 +1160,7 @@ template <typename S> struct TensorFunctions {
                              const shared_ptr<SparseMatrix<S>> &mpst_bra,
                              const shared_ptr<SparseMatrix<S>> &mpst_ket,
                              shared_ptr<OperatorTensor<S>> &c) const {
+        TracerScope _tr("left_rotate");
         for (auto &p : c->ops) {
             shared_ptr<OpElement<S>> op =
                 dynamic_pointer_cast<OpElement<S>>(p.first);
@@ -968,6 +1184,7 @@ template <typename S> struct TensorFunctions {
                               const shared_ptr<SparseMatrix<S>> &mpst_bra,
                               const shared_ptr<SparseMatrix<S>> &mpst_ket,
                               shared_ptr<OperatorTensor<S>> &c) const {
+        TracerScope _tr("right_rotate");
         for (auto &p : c->ops) {
             shared_ptr<OpElement<S>> op =
                 dynamic_pointer_cast<OpElement<S>>(p.first);
@@ -1028,7 +1245,7 @@ template <typename S> struct TensorFunctions {
             for (int k = 0; k < maxk[i]; k++) {
                 for (auto &ex : exs[i]) {
                     if (k < ex->ops.size()) {
-                        shared_ptr<SparseMatrix<S>> xmat = a->ops.at(
+                        const shared_ptr<SparseMatrix<S>> &xmat = a->ops.at(
                             abs_value((shared_ptr<OpExpr<S>>)ex->ops[k]));
                         assert(xmat->get_type() != SparseMatrixTypes::Delayed);
                         tf->opf->iadd(a->ops.at(ex->c), xmat,
@@ -1066,7 +1283,7 @@ template <typename S> struct TensorFunctions {
                 (1 /
                  dynamic_pointer_cast<OpElement<S>>(names->data[k])->factor);
             assert(a->ops.count(nop) != 0);
-            shared_ptr<SparseMatrix<S>> anop = a->ops.at(nop);
+            const shared_ptr<SparseMatrix<S>> &anop = a->ops.at(nop);
             switch (expr->get_type()) {
             case OpTypes::Sum:
                 trs.push_back(
@@ -1407,6 +1624,7 @@ template <typename S> struct TensorFunctions {
                                shared_ptr<OperatorTensor<S>> &c,
                                const shared_ptr<Symbolic<S>> &cexprs = nullptr,
                                OpNamesSet delayed = OpNamesSet()) const {
+        TracerScope _tr("left_contract");
         if (frame->use_main_stack)
             for (auto &p : c->ops) {
                 shared_ptr<OpElement<S>> op =
@@ -1451,6 +1669,7 @@ template <typename S> struct TensorFunctions {
                                 shared_ptr<OperatorTensor<S>> &c,
                                 const shared_ptr<Symbolic<S>> &cexprs = nullptr,
                                 OpNamesSet delayed = OpNamesSet()) const {
+        TracerScope _tr("right_contract");
         if (frame->use_main_stack)
             for (auto &p : c->ops) {
                 shared_ptr<OpElement<S>> op =
@@ -32,6 +32,8 @@
 #endif
 #include "mkl.h"
 #endif
+#include <algorithm>
+#include <atomic>
 #include <cassert>
 #include <cstdint>
 #include <cstring>
@@ -110,8 +112,9 @@ enum struct SeqTypes : uint8_t {
                 //!< This option normally requires a large amount of time for
                 //!< preprocessing and it will introduce a large number of
                 //!< temporary arrays, which is not memory friendly.
-    Tasked = 4, //!< GEMM will be evenly divided into ``n_threads`` groups,
-                //!< Different groups are executed in different threads.
+    Tasked = 4, //!< GEMM will be divided into ``n_threads`` groups of similar
+                //!< FLOP counts. Different groups are executed in different
+                //!< threads, and idle threads steal GEMM from other groups.
                 //!< Since different threads may write into the same output
                 //!< array, there is an additional reduction step after all
                 //!< GEMM finishes. This mode is mainly implemented for
@@ -134,6 +137,17 @@ inline SeqTypes operator|(SeqTypes a, SeqTypes b) {
     return SeqTypes((uint8_t)a | (uint8_t)b);
 }
 
+/**
+ * Backend for executing batches of dense matrix multiplications in
+ * ``BatchGEMM`` (used with ``SeqTypes::Simple`` and ``SeqTypes::Auto``).
+ */
+enum struct GEMMBackendTypes : uint8_t {
+    Host = 0,    //!< ``cblas_dgemm_batch`` (or its ``dgemm`` fallback) on host.
+    External = 1 //!< The batched DGEMM function registered with
+                 //!< ``dgemm_batch_backend_()``, for example a GPU batched
+                 //!< or grouped GEMM wrapper.
+};
+
 /**
  * Global information for threading schemes.
  */
@@ -141,6 +155,9 @@ struct Threading {
     ThreadingTypes type;                //!< Type of the threading scheme.
     SeqTypes seq_type = SeqTypes::None; //!< Method of dense matrix
                                         //!< multiplication parallelism.
+    GEMMBackendTypes gemm_backend =
+        GEMMBackendTypes::Host; //!< Backend for batched dense matrix
+                                //!< multiplication.
     int n_threads_op = 0,     //!< Number of threads for parallelism over
                               //!< renormalized operators.
         n_threads_quanta = 0, //!< Number of threads for parallelism over
@@ -149,6 +166,28 @@ struct Threading {
                               //!< dense matrix multiplications.
         n_threads_global = 0, //!< Number of threads for general tasks
         n_levels = 0;         //!< Number of nested threading layers
+    int small_gemm_size = 0; //!< Batched DGEMM with all of m, n and k not
+                             //!< larger than this are computed by a plain
+                             //!< loop kernel instead of BLAS. Zero to disable.
+    size_t reduce_chunk = 0; //!< Thread-private outputs are summed by all
+                             //!< threads in chunks of this number of
+                             //!< elements, each reduced pairwise over the
+                             //!< threads. Zero for a task-based tree reduction
+                             //!< of the whole outputs.
+    int deterministic_slots = 0; //!< If nonzero, parallel reductions are done
+                                 //!< over this fixed number of output copies,
+                                 //!< each filled by tasks in a fixed order and
+                                 //!< summed in a fixed order, so that results
+                                 //!< do not depend on the number of threads
+                                 //!< or scheduling. Zero for dynamic
+                                 //!< scheduling with one copy per thread.
+    /** Number of output copies in a parallel reduction.
+     * @param ntop Number of threads of the reduction.
+     * @return Number of output copies (including the output itself).
+     */
+    int get_reduce_slots(int ntop) const {
+        return deterministic_slots != 0 ? deterministic_slots : ntop;
+    }
     /** Whether openmp compiler option is set. */
     bool openmp_available() const {
 #ifdef _OPENMP
@@ -210,7 +249,11 @@ struct Threading {
 #endif
     }
     /** Return a string indicating which ``SeqTypes`` is used. */
-    string get_seq_type() const {
+    string get_seq_type() const { return seq_type_name(seq_type); }
+    /** Return the name of a ``SeqTypes``.
+     * @param seq_type The ``SeqTypes``.
+     */
+    static string seq_type_name(SeqTypes seq_type) {
         if (seq_type == SeqTypes::Auto)
             return "Auto";
         else if (seq_type == SeqTypes::Tasked)
@@ -293,6 +336,37 @@ struct Threading {
         return 1;
 #endif
     }
+    /** Run independent tasks of non-uniform costs (such as dense
+     * factorizations of symmetry blocks), largest first. Tasks costing more
+     * than the average share of one thread are run one by one with
+     * parallelism inside MKL. The other tasks are run concurrently as a
+     * general task with sequential MKL.
+     * @param costs Cost (FLOP count) of each task. Zero for a skipped task.
+     * @param f Function taking the index of a task.
+     */
+    template <typename F>
+    void parallel_by_cost(const vector<size_t> &costs, F f) const {
+        const int n = (int)costs.size();
+        vector<int> idx;
+        idx.reserve(n);
+        size_t total = 0;
+        for (int i = 0; i < n; i++)
+            if (costs[i] != 0)
+                idx.push_back(i), total += costs[i];
+        stable_sort(idx.begin(), idx.end(),
+                    [&costs](int i, int j) { return costs[i] > costs[j]; });
+        const int nx = (int)idx.size();
+        int ntg = n_threads_global != 0 ? n_threads_global : 1, ib = 0;
+        if (ntg > 1 && nx != 0 && costs[idx[0]] > total / ntg &&
+            activate_global_mkl() > 1)
+            for (; ib < nx && costs[idx[ib]] > total / ntg; ib++)
+                f(idx[ib]);
+        ntg = activate_global();
+#pragma omp parallel for schedule(dynamic) num_threads(ntg)
+        for (int i = ib; i < nx; i++)
+            f(idx[i]);
+        activate_normal();
+    }
     /** Default constructor.
      * Uses ``ThreadingTypes::Global | ThreadingTypes::BatchedGEMM``
      * with maximal available number of threads, and ``SeqTypes::None``
@@ -443,6 +517,12 @@ struct Threading {
            << " TBB = " << th.tbb_available()
            << " MKL = " << th.get_mkl_threading_type() << " "
            << th.get_mkl_version() << " SeqType = " << th.get_seq_type()
+           << " GEMMBackend = "
+           << (th.gemm_backend == GEMMBackendTypes::External ? "External"
+                                                             : "Host")
+           << " SmallGEMM = " << th.small_gemm_size
+           << " ReduceChunk = " << th.reduce_chunk
+           << " DeterministicSlots = " << th.deterministic_slots
            << " MKLIntLen = " << sizeof(MKL_INT) << endl;
         os << " THREADING = " << th.n_levels << " layers : "
            << ((th.type & ThreadingTypes::Global) ? "Global | " : "")
@@ -458,6 +538,75 @@ struct Threading {
     }
 };
 
+/** Work-stealing schedule for a list of tasks with non-uniform costs.
+ * Tasks are first divided into contiguous ranges of similar total cost, one
+ * range for each thread. Each thread takes tasks from the front of its own
+ * range. When its range is empty, it steals tasks from the back of the range
+ * with most remaining tasks. Without stealing, the tasks of each range are
+ * taken in order, so that the tasks of a range can be performed
+ * deterministically. */
+struct WorkStealingSchedule {
+    int n_threads; //!< Number of ranges (threads).
+    bool steal;    //!< Whether tasks can be stolen from other ranges.
+    unique_ptr<atomic<uint64_t>[]>
+        ranges; //!< Remaining range of each thread, packed as (lo << 32 | hi).
+    /** Constructor.
+     * @param costs Cost (FLOP count) of each task.
+     * @param n_threads Number of threads.
+     * @param steal Whether tasks can be stolen from other ranges.
+     */
+    WorkStealingSchedule(const vector<size_t> &costs, int n_threads,
+                         bool steal = true)
+        : n_threads(n_threads), steal(steal),
+          ranges(new atomic<uint64_t>[n_threads]) {
+        assert(costs.size() < ((uint64_t)1 << 32));
+        size_t total = 0, cur = 0;
+        for (size_t c : costs)
+            total += c;
+        uint64_t lo = 0, hi = 0;
+        for (int it = 0; it < n_threads; it++) {
+            const size_t target = total / n_threads * (it + 1) +
+                                  total % n_threads * (it + 1) / n_threads;
+            while (hi < costs.size() &&
+                   (it == n_threads - 1 || cur + costs[hi] / 2 < target))
+                cur += costs[hi++];
+            ranges[it] = (lo << 32) | hi;
+            lo = hi;
+        }
+    }
+    /** Get the next task for a thread.
+     * @param tid Thread id (or index of the range, without stealing).
+     * @param i Index of the next task (output).
+     * @return false if all tasks have been taken.
+     */
+    bool next(int tid, size_t &i) {
+        atomic<uint64_t> &own = ranges[tid % n_threads];
+        for (uint64_t r = own.load(); (r >> 32) < (r & 0xFFFFFFFFULL);)
+            if (own.compare_exchange_weak(r, r + ((uint64_t)1 << 32))) {
+                i = (size_t)(r >> 32);
+                return true;
+            }
+        if (!steal)
+            return false;
+        for (;;) {
+            int iv = -1;
+            uint64_t rv = 0, nv = 0;
+            for (int it = 0; it < n_threads; it++) {
+                const uint64_t r = ranges[it].load();
+                const uint64_t nr = (r & 0xFFFFFFFFULL) - (r >> 32);
+                if ((r >> 32) < (r & 0xFFFFFFFFULL) && nr > nv)
+                    iv = it, rv = r, nv = nr;
+            }
+            if (iv == -1)
+                return false;
+            if (ranges[iv].compare_exchange_weak(rv, rv - 1)) {
+                i = (size_t)(rv & 0xFFFFFFFFULL) - 1;
+                return true;
+            }
+        }
+    }
+};
+
 /** Implementation of the ``threading`` global variable. */
 inline shared_ptr<Threading> &threading_() {
     static shared_ptr<Threading> threading = make_shared<Threading>();
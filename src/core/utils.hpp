@@ -21,12 +21,16 @@
 #pragma once
 
 #include <algorithm>
+#include <atomic>
 #include <cassert>
 #include <chrono>
+#include <cstdint>
 #include <cstdio>
 #include <fstream>
 #include <iomanip>
 #include <iostream>
+#include <memory>
+#include <mutex>
 #include <random>
 #include <sstream>
 #include <string>
@@ -40,6 +44,15 @@
 #include <io.h>
 #endif
 #include <vector>
+#ifdef _HAS_PERF_EVENT
+#include <cstring>
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#ifdef _OPENMP
+#include "omp.h"
+#endif
+#endif
 
 using namespace std;
 
@@ -74,6 +87,533 @@ struct Timer {
     }
 };
 
+// Kernel types for roofline accounting
+enum struct KernelTypes : uint8_t {
+    GEMM,
+    BatchGEMM,
+    Eigs,
+    SVD,
+    Read,
+    Write,
+    Count
+};
+
+// Per-kernel FLOP, memory traffic and wall time counters (roofline)
+// Disabled by default. FLOP counts a multiply-add as two operations
+// (unlike the nflop of Davidson); bytes is the nominal traffic of the
+// operands (each read once, outputs read and written) or the scratch data
+// read/written by DataFrame. Counters are atomic and can be updated from
+// multiple threads; time is the sum over threads
+struct KernelCounters {
+    static const int n_kernels = (int)KernelTypes::Count;
+    bool enabled = false;
+    atomic<uint64_t> calls[n_kernels], flop[n_kernels], bytes[n_kernels],
+        nsec[n_kernels];
+    KernelCounters() { reset(); }
+    static const char *name(KernelTypes k) {
+        static const char *names[] = {"gemm", "batch_gemm", "eigs",
+                                      "svd",  "read",       "write"};
+        return names[(int)k];
+    }
+    void reset() {
+        for (int i = 0; i < n_kernels; i++)
+            calls[i] = flop[i] = bytes[i] = nsec[i] = 0;
+    }
+    void add(KernelTypes k, uint64_t nflop, uint64_t nbytes, double t) {
+        if (!enabled)
+            return;
+        calls[(int)k] += 1, flop[(int)k] += nflop, bytes[(int)k] += nbytes;
+        nsec[(int)k] += (uint64_t)(t * 1E9);
+    }
+    double time(KernelTypes k) const { return nsec[(int)k] * 1E-9; }
+    uint64_t total_flop() const {
+        uint64_t r = 0;
+        for (int i = 0; i < n_kernels; i++)
+            r += flop[i];
+        return r;
+    }
+    uint64_t total_bytes() const {
+        uint64_t r = 0;
+        for (int i = 0; i < n_kernels; i++)
+            r += bytes[i];
+        return r;
+    }
+    // one line per kernel with non-zero calls:
+    // GFLOP, GB, time, GFLOP/s, GB/s and arithmetic intensity (FLOP/byte)
+    string summary(const string &prefix = " | ") const {
+        stringstream ss;
+        ss << fixed << setprecision(3);
+        for (int i = 0; i < n_kernels; i++) {
+            if (calls[i] == 0)
+                continue;
+            const double t = time((KernelTypes)i);
+            const double gf = flop[i] * 1E-9, gb = bytes[i] * 1E-9;
+            ss << prefix << setw(10) << left << name((KernelTypes)i)
+               << right << " calls = " << setw(9) << calls[i]
+               << " | GFLOP = " << setw(10) << gf << " | GB = " << setw(9)
+               << gb << " | T = " << setw(8) << t
+               << " | GFLOP/s = " << setw(8) << (t == 0 ? 0 : gf / t)
+               << " | GB/s = " << setw(8) << (t == 0 ? 0 : gb / t)
+               << " | FLOP/B = "
+               << (bytes[i] == 0 ? 0 : (double)flop[i] / bytes[i]) << endl;
+        }
+        return ss.str();
+    }
+};
+
+inline KernelCounters &kernel_counters_() {
+    static KernelCounters counters;
+    return counters;
+}
+
+// Hardware events counted by HardwareCounters
+enum struct HardwareEvents : uint8_t { Cycles, Instructions, LLCMisses, Count };
+
+// Hardware performance counters of the CPU (Linux perf_event), accumulated
+// per named phase (user space only)
+// Requires -D_HAS_PERF_EVENT and permission to monitor the own process
+// (perf_event_paranoid <= 2), otherwise start fails and the counters stay
+// disabled. Counters are opened for the calling thread and each thread of
+// the default OpenMP team and summed over threads; values are scaled when
+// the PMU is multiplexed. Memory bandwidth is estimated as one cache line
+// per LLC miss. Phases must be measured from a single (main) thread
+struct HardwareCounters {
+    static const int n_events = (int)HardwareEvents::Count;
+    static const int cache_line = 64;
+    struct Phase {
+        string name;
+        size_t count = 0;
+        double time = 0;
+        double values[n_events];
+        Phase(const string &name) : name(name) {
+            for (int k = 0; k < n_events; k++)
+                values[k] = 0;
+        }
+    };
+    bool enabled = false;
+    // event fds of all threads (the first of each thread is the leader)
+    vector<int> fds;
+    vector<Phase> phases;
+    mutex mtx;
+    HardwareCounters() {}
+    ~HardwareCounters() { stop(); }
+    static bool supported() {
+#ifdef _HAS_PERF_EVENT
+        return true;
+#else
+        return false;
+#endif
+    }
+    static const char *name(HardwareEvents k) {
+        static const char *names[] = {"cycles", "instructions", "llc_misses"};
+        return names[(int)k];
+    }
+#ifdef _HAS_PERF_EVENT
+    static int open_event(uint64_t config, int group_fd) {
+        struct perf_event_attr pe;
+        memset(&pe, 0, sizeof(pe));
+        pe.type = PERF_TYPE_HARDWARE;
+        pe.size = sizeof(pe);
+        pe.config = config;
+        pe.disabled = group_fd == -1;
+        pe.exclude_kernel = 1;
+        pe.exclude_hv = 1;
+        pe.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED |
+                         PERF_FORMAT_TOTAL_TIME_RUNNING;
+        return (int)syscall(__NR_perf_event_open, &pe, 0, -1, group_fd, 0);
+    }
+    // open and enable one event group for the calling thread
+    bool open_thread() {
+        static const uint64_t configs[] = {PERF_COUNT_HW_CPU_CYCLES,
+                                           PERF_COUNT_HW_INSTRUCTIONS,
+                                           PERF_COUNT_HW_CACHE_MISSES};
+        int gfds[n_events];
+        for (int k = 0; k < n_events; k++) {
+            gfds[k] = open_event(configs[k], k == 0 ? -1 : gfds[0]);
+            if (gfds[k] == -1) {
+                for (int j = 0; j < k; j++)
+                    close(gfds[j]);
+                return false;
+            }
+        }
+        ioctl(gfds[0], PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+        ioctl(gfds[0], PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+        lock_guard<mutex> lock(mtx);
+        fds.insert(fds.end(), gfds, gfds + n_events);
+        return true;
+    }
+#endif
+    // returns whether the counters are available (and enabled)
+    bool start() {
+        stop();
+#ifdef _HAS_PERF_EVENT
+        bool ok = open_thread();
+#ifdef _OPENMP
+#pragma omp parallel reduction(&& : ok)
+        if (omp_get_thread_num() != 0)
+            ok = open_thread();
+#endif
+        if (!ok)
+            stop();
+        enabled = ok;
+#endif
+        return enabled;
+    }
+    void stop() {
+#ifdef _HAS_PERF_EVENT
+        for (int fd : fds)
+            close(fd);
+#endif
+        fds.clear();
+        enabled = false;
+    }
+    void reset() { phases.clear(); }
+    // current values summed over threads
+    void read(double *values) const {
+        for (int k = 0; k < n_events; k++)
+            values[k] = 0;
+#ifdef _HAS_PERF_EVENT
+        struct {
+            uint64_t nr, time_enabled, time_running, values[n_events];
+        } buf;
+        for (size_t i = 0; i < fds.size(); i += n_events)
+            if (::read(fds[i], &buf, sizeof(buf)) == (ssize_t)sizeof(buf) &&
+                buf.time_running != 0)
+                for (int k = 0; k < n_events; k++)
+                    values[k] += (double)buf.values[k] * buf.time_enabled /
+                                 buf.time_running;
+#endif
+    }
+    // index of the phase with the given name (created if not existing)
+    size_t phase(const string &name) {
+        for (size_t i = 0; i < phases.size(); i++)
+            if (phases[i].name == name)
+                return i;
+        phases.push_back(Phase(name));
+        return phases.size() - 1;
+    }
+    // one line per phase: time, cycles, IPC, LLC misses and
+    // estimated memory bandwidth
+    string summary(const string &prefix = " | ") const {
+        stringstream ss;
+        ss << fixed << setprecision(3);
+        for (auto &ph : phases) {
+            const double *v = ph.values;
+            const double bw = (double)cache_line *
+                              v[(int)HardwareEvents::LLCMisses] * 1E-9;
+            ss << prefix << setw(10) << left << ph.name << right
+               << " calls = " << setw(7) << ph.count << " | T = " << setw(8)
+               << ph.time << " | Gcycles = " << setw(9)
+               << v[(int)HardwareEvents::Cycles] * 1E-9 << " | IPC = "
+               << setw(6)
+               << (v[(int)HardwareEvents::Cycles] == 0
+                       ? 0
+                       : v[(int)HardwareEvents::Instructions] /
+                             v[(int)HardwareEvents::Cycles])
+               << " | LLC miss (M) = " << setw(9)
+               << v[(int)HardwareEvents::LLCMisses] * 1E-6
+               << " | mem GB/s ~ " << (ph.time == 0 ? 0 : bw / ph.time)
+               << endl;
+        }
+        return ss.str();
+    }
+};
+
+inline HardwareCounters &hardware_counters_() {
+    static HardwareCounters counters;
+    return counters;
+}
+
+// Hardware counters of a code region, added to the phase name when the
+// scope is destroyed (no-op when the counters are disabled)
+struct HardwareCounterScope {
+    size_t idx;
+    double values[HardwareCounters::n_events];
+    Timer t;
+    bool active;
+    HardwareCounterScope(const string &name)
+        : active(hardware_counters_().enabled) {
+        if (active) {
+            idx = hardware_counters_().phase(name);
+            hardware_counters_().read(values);
+            t.get_time();
+        }
+    }
+    ~HardwareCounterScope() {
+        HardwareCounters &hc = hardware_counters_();
+        if (!active || !hc.enabled || idx >= hc.phases.size())
+            return;
+        const double tx = t.get_time();
+        double after[HardwareCounters::n_events];
+        hc.read(after);
+        HardwareCounters::Phase &ph = hc.phases[idx];
+        ph.count++, ph.time += tx;
+        for (int k = 0; k < HardwareCounters::n_events; k++)
+            ph.values[k] += after[k] - values[k];
+    }
+};
+
+// Hierarchical wall time recorder (sweep -> site -> phase)
+// Scopes with the same path are merged, accumulating time and count
+// Scopes opened by begin also record the FLOP and bytes of kernel_counters_
+// (when enabled) spent inside them
+struct TimingTree {
+    struct Node {
+        string name;
+        double time = 0;
+        size_t count = 0;
+        uint64_t flop = 0, bytes = 0;
+        vector<int> children;
+        Node(const string &name) : name(name) {}
+    };
+    struct Scope {
+        int node;
+        double start;
+        uint64_t flop, bytes;
+    };
+    vector<Node> nodes;
+    // open scopes, with their start times and counters
+    vector<Scope> stack;
+    // if not empty, the report of each sweep is written to
+    // "<filename>.<isweep>.json" (or ".csv")
+    string filename;
+    bool csv = false;
+    int isweep = 0;
+    TimingTree(const string &filename = "", bool csv = false)
+        : filename(filename), csv(csv) {
+        clear();
+    }
+    static double now() {
+        Timer t;
+        t.get_time();
+        return t.current;
+    }
+    void clear() {
+        nodes.clear();
+        nodes.push_back(Node("root"));
+        stack.clear();
+    }
+    int current() const { return stack.size() == 0 ? 0 : stack.back().node; }
+    // child of node p with the given name (created if not existing)
+    int child(int p, const string &name) {
+        for (int c : nodes[p].children)
+            if (nodes[c].name == name)
+                return c;
+        nodes.push_back(Node(name));
+        nodes[p].children.push_back((int)nodes.size() - 1);
+        return (int)nodes.size() - 1;
+    }
+    void begin(const string &name) {
+        const KernelCounters &kc = kernel_counters_();
+        Scope sc = {child(current(), name), now(), kc.total_flop(),
+                    kc.total_bytes()};
+        stack.push_back(sc);
+    }
+    void end() {
+        assert(stack.size() != 0);
+        const KernelCounters &kc = kernel_counters_();
+        const Scope &sc = stack.back();
+        Node &x = nodes[sc.node];
+        x.time += now() - sc.start, x.count++;
+        const uint64_t flop = kc.total_flop(), bytes = kc.total_bytes();
+        // skipped if the counters are reset inside the scope
+        if (flop >= sc.flop && bytes >= sc.bytes)
+            x.flop += flop - sc.flop, x.bytes += bytes - sc.bytes;
+        stack.pop_back();
+    }
+    // time measured elsewhere, added below the current scope
+    // (name can be a path such as "update/davidson")
+    void add(const string &name, double t) {
+        int p = current();
+        for (size_t i = 0, j; i < name.length(); i = j + 1) {
+            j = name.find('/', i);
+            if (j == string::npos)
+                j = name.length();
+            p = child(p, name.substr(i, j - i));
+        }
+        nodes[p].time += t, nodes[p].count++;
+    }
+    // add differences of cumulative counters (zero differences skipped)
+    void add(const vector<pair<string, double>> &before,
+             const vector<pair<string, double>> &after) {
+        assert(before.size() == after.size());
+        for (size_t i = 0; i < after.size(); i++)
+            if (after[i].second != before[i].second)
+                add(after[i].first, after[i].second - before[i].second);
+    }
+    void write_json(ostream &os, int p = 0, int indent = 0) const {
+        const string pad(indent, ' ');
+        os << pad << "{\"name\": \"" << nodes[p].name << "\", \"time\": "
+           << fixed << setprecision(6) << nodes[p].time
+           << ", \"count\": " << nodes[p].count;
+        if (nodes[p].flop != 0 || nodes[p].bytes != 0)
+            os << ", \"flop\": " << nodes[p].flop
+               << ", \"bytes\": " << nodes[p].bytes;
+        if (nodes[p].children.size() != 0) {
+            os << ", \"children\": [" << endl;
+            for (size_t i = 0; i < nodes[p].children.size(); i++) {
+                write_json(os, nodes[p].children[i], indent + 2);
+                os << (i == nodes[p].children.size() - 1 ? "" : ",") << endl;
+            }
+            os << pad << "]";
+        }
+        os << "}";
+    }
+    // one line per node: path,count,time,flop,bytes
+    void write_csv(ostream &os, int p = 0, const string &path = "") const {
+        if (p == 0)
+            os << "path,count,time,flop,bytes" << endl;
+        else
+            os << path << "," << nodes[p].count << "," << fixed
+               << setprecision(6) << nodes[p].time << "," << nodes[p].flop
+               << "," << nodes[p].bytes << endl;
+        for (int c : nodes[p].children)
+            write_csv(os, c,
+                      p == 0 ? nodes[c].name : path + "/" + nodes[c].name);
+    }
+    string to_json() const {
+        stringstream ss;
+        write_json(ss);
+        return ss.str();
+    }
+    string to_csv() const {
+        stringstream ss;
+        write_csv(ss);
+        return ss.str();
+    }
+    // write the report of the current sweep (if filename is set)
+    void save() {
+        if (filename != "") {
+            stringstream ss;
+            ss << filename << "." << isweep << (csv ? ".csv" : ".json");
+            ofstream ofs(ss.str().c_str());
+            if (!ofs.good())
+                throw runtime_error("TimingTree::save on '" + ss.str() +
+                                    "' failed.");
+            if (csv)
+                write_csv(ofs);
+            else
+                write_json(ofs), ofs << endl;
+            ofs.close();
+        }
+        isweep++;
+    }
+};
+
+// Low-overhead event tracer for threads, exported as a Chrome trace
+// (chrome://tracing or ui.perfetto.dev)
+// Disabled by default. Each thread records complete events into its own
+// ring buffer of capacity events (the oldest events are overwritten),
+// so that recording needs no locking. Threads are numbered in the order
+// of their first event after start
+struct EventTracer {
+    struct Event {
+        const char *name; // must be a string literal
+        double t_start, t_end; // seconds since start
+        uint64_t arg;
+    };
+    struct Ring {
+        vector<Event> events;
+        size_t n = 0; // number of events recorded (including overwritten)
+        int tid;
+        Ring(size_t capacity, int tid) : events(capacity), tid(tid) {}
+        void push(const Event &ev) { events[n++ % events.size()] = ev; }
+    };
+    bool enabled = false;
+    size_t capacity = (size_t)1 << 16;
+    atomic<int> generation;
+    mutex mtx;
+    vector<shared_ptr<Ring>> rings;
+    chrono::steady_clock::time_point t0;
+    EventTracer() : generation(0), t0(chrono::steady_clock::now()) {}
+    double now() const {
+        return chrono::duration<double>(chrono::steady_clock::now() - t0)
+            .count();
+    }
+    // clear all events and start recording
+    void start() {
+        lock_guard<mutex> lock(mtx);
+        rings.clear();
+        generation++;
+        t0 = chrono::steady_clock::now();
+        enabled = true;
+    }
+    // stop recording (must be done before writing)
+    void stop() { enabled = false; }
+    // ring buffer of the calling thread
+    Ring &ring() {
+        static thread_local shared_ptr<Ring> r = nullptr;
+        static thread_local int gen = -1;
+        if (gen != generation) {
+            lock_guard<mutex> lock(mtx);
+            r = make_shared<Ring>(capacity, (int)rings.size());
+            rings.push_back(r);
+            gen = generation;
+        }
+        return *r;
+    }
+    void record(const char *name, double t_start, double t_end,
+                uint64_t arg = 0) {
+        Event ev = {name, t_start, t_end, arg};
+        ring().push(ev);
+    }
+    // number of events kept in ring buffers
+    size_t size() const {
+        size_t r = 0;
+        for (auto &rg : rings)
+            r += min(rg->n, rg->events.size());
+        return r;
+    }
+    // one process (pid) with one track per thread
+    void write_json(ostream &os, int pid = 0) const {
+        os << fixed << setprecision(3) << "{\"traceEvents\":[";
+        for (size_t ir = 0; ir < rings.size(); ir++) {
+            const Ring &rg = *rings[ir];
+            os << (ir == 0 ? "\n" : ",\n")
+               << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":" << pid
+               << ",\"tid\":" << rg.tid << ",\"args\":{\"name\":\"thread "
+               << rg.tid << "\"}}";
+            const size_t cap = rg.events.size();
+            for (size_t i = rg.n > cap ? rg.n - cap : 0; i < rg.n; i++) {
+                const Event &ev = rg.events[i % cap];
+                os << ",\n{\"name\":\"" << ev.name
+                   << "\",\"ph\":\"X\",\"pid\":" << pid
+                   << ",\"tid\":" << rg.tid << ",\"ts\":" << ev.t_start * 1E6
+                   << ",\"dur\":" << (ev.t_end - ev.t_start) * 1E6
+                   << ",\"args\":{\"arg\":" << ev.arg << "}}";
+            }
+        }
+        os << "\n]}" << endl;
+    }
+    void save(const string &filename, int pid = 0) const {
+        ofstream ofs(filename.c_str());
+        if (!ofs.good())
+            throw runtime_error("EventTracer::save on '" + filename +
+                                "' failed.");
+        write_json(ofs, pid);
+        ofs.close();
+    }
+};
+
+inline EventTracer &tracer_() {
+    static EventTracer tracer;
+    return tracer;
+}
+
+// Records the enclosing scope as one event of tracer_() (when enabled)
+struct TracerScope {
+    const char *name;
+    uint64_t arg;
+    double t_start;
+    TracerScope(const char *name, uint64_t arg = 0)
+        : name(name), arg(arg),
+          t_start(tracer_().enabled ? tracer_().now() : -1) {}
+    ~TracerScope() {
+        if (t_start >= 0 && tracer_().enabled)
+            tracer_().record(name, t_start, tracer_().now(), arg);
+    }
+};
+
 // Random number generator for multi-thread
 struct RandomMT {
     mt19937 rng;
@@ -219,6 +759,23 @@ struct Parsing {
             return "??? B";
         }
     }
+    // Stable 64-bit FNV-1a hash (over 8-byte little-endian words, then the
+    // remaining bytes), independent of platform and standard library
+    static uint64_t hash_bytes(const void *data, size_t n,
+                               uint64_t h = 14695981039346656037ULL) {
+        const uint64_t prime = 1099511628211ULL;
+        const uint8_t *p = (const uint8_t *)data;
+        size_t i = 0;
+        for (; i + 8 <= n; i += 8) {
+            uint64_t w = 0;
+            for (int k = 7; k >= 0; k--)
+                w = (w << 8) | p[i + k];
+            h = (h ^ w) * prime;
+        }
+        for (; i < n; i++)
+            h = (h ^ p[i]) * prime;
+        return h;
+    }
     static bool rename_file(const string &old_name, const string &new_name) {
         return rename(old_name.c_str(), new_name.c_str()) == 0;
     }
@@ -243,9 +800,9 @@ struct Parsing {
 #ifdef _WIN32
         return "";
 #else
-        char buf[255];
-        ssize_t cnt = readlink(name.c_str(), buf, 255);
-        return string(buf, cnt);
+        char buf[4096];
+        ssize_t cnt = readlink(name.c_str(), buf, 4096);
+        return cnt < 0 ? string() : string(buf, cnt);
 #endif
     }
     static bool link_file(const string &source, const string &name) {
@@ -262,6 +819,30 @@ struct Parsing {
             remove_file(name);
         assert(get_pathname(source) == get_pathname(name));
         return symlink(get_filename(source).c_str(), name.c_str()) == 0;
+#endif
+    }
+    // absolute path of an existing file or dir
+    static string abs_path(const string &name) {
+#ifdef _WIN32
+        return name;
+#else
+        char *buf = realpath(name.c_str(), nullptr);
+        if (buf == nullptr)
+            return name;
+        string r(buf);
+        free(buf);
+        return r;
+#endif
+    }
+    // symbolic link with arbitrary (absolute) target path
+    static bool symlink_file(const string &target, const string &name) {
+#ifdef _WIN32
+        copy_file(target, name);
+        return true;
+#else
+        if (link_exists(name) || file_exists(name))
+            remove_file(name);
+        return symlink(target.c_str(), name.c_str()) == 0;
 #endif
     }
     static void copy_file(const string &source, const string &dest) {
@@ -135,6 +135,77 @@ template <typename D, uint8_t L = 4> struct TRIE {
         }
         return r;
     }
+    // evaluates the coefficients of all determinants (in parallel)
+    // contract(j, d, pmat) returns the partial contraction for det[d] = j
+    // from the partial contraction pmat of det[0 : d], or nullptr if the
+    // subtree is pruned; at the last site it holds the single coefficient
+    // the trie is expanded breadth-first until there are n_split subtrees
+    // per thread, then each subtree is traversed depth-first by one thread
+    // with empty dets all determinants are enumerated and added to the trie
+    template <typename M, typename F>
+    void traverse_evaluate(const M &zmat, F contract, int n_split = 4) {
+        const bool has_dets = dets.size() != 0;
+        // (trie node or -1 if not in trie, j, d, partial contraction, det)
+        typedef tuple<int, uint8_t, int, M, vector<uint8_t>> node_t;
+        int ntg = threading->activate_global();
+        vector<vector<pair<vector<uint8_t>, double>>> found(ntg);
+        auto step = [this, has_dets, &contract, &found](
+                        const node_t &p, vector<node_t> &next, int tid) {
+            const int cur = get<0>(p), d = get<2>(p);
+            const uint8_t j = get<1>(p);
+            M cmp = contract(j, d, get<3>(p));
+            if (cmp == nullptr)
+                return;
+            vector<uint8_t> det = get<4>(p);
+            det[d] = j;
+            if (d == n_sites - 1) {
+                if (has_dets)
+                    vals[lower_bound(dets.begin(), dets.end(), cur) -
+                         dets.begin()] = cmp->data[0];
+                else
+                    found[tid].push_back(make_pair(det, cmp->data[0]));
+            } else
+                for (uint8_t jj = 0; jj < L; jj++)
+                    if (!has_dets || data[cur][jj] != 0)
+                        next.push_back(make_tuple(has_dets ? data[cur][jj] : -1,
+                                                  jj, d + 1, cmp, det));
+        };
+        vector<node_t> ptrs, pptrs;
+        for (uint8_t j = 0; j < L; j++)
+            if (!has_dets || data[0][j] != 0)
+                ptrs.push_back(make_tuple(has_dets ? data[0][j] : -1, j, 0,
+                                          zmat, vector<uint8_t>(n_sites)));
+        while (!ptrs.empty() && (int)ptrs.size() < ntg * n_split) {
+            check_signal_()();
+            for (auto &p : ptrs)
+                step(p, pptrs, 0);
+            ptrs.swap(pptrs);
+            pptrs.clear();
+        }
+        check_signal_()();
+#pragma omp parallel for schedule(dynamic) num_threads(ntg)
+        for (int ip = 0; ip < (int)ptrs.size(); ip++) {
+            const int tid = threading->get_thread_id();
+            vector<node_t> stack(1, ptrs[ip]);
+            while (!stack.empty()) {
+                node_t p = stack.back();
+                stack.pop_back();
+                step(p, stack, tid);
+            }
+        }
+        if (!has_dets) {
+            vector<pair<vector<uint8_t>, double>> dvs;
+            for (auto &f : found)
+                dvs.insert(dvs.end(), f.begin(), f.end());
+            sort(dvs.begin(), dvs.end());
+            for (auto &dv : dvs) {
+                push_back(dv.first);
+                vals.push_back(dv.second);
+            }
+        }
+        sort_dets();
+        threading->activate_normal();
+    }
     vector<double> get_state_occupation() const {
         int ntg = threading->activate_global();
         vector<vector<double>> pop(ntg);
@@ -157,6 +228,249 @@ template <typename D, uint8_t L = 4> struct TRIE {
                 rpop[k] += pop[itg][k];
         return rpop;
     }
+    // left quantum number after adding site state j with quantum number sq
+    // j = 1 (2) increases (decreases) twos by one
+    template <typename S> static S next_quantum(S q, S sq, uint8_t j) {
+        S qs = q + sq;
+        int twos = q.twos() + (j == 1 ? 1 : (j == 2 ? -1 : 0));
+        for (int k = 0; k < qs.count(); k++)
+            if (qs[k].twos() == twos)
+                return qs[k];
+        assert(false);
+        return qs[0];
+    }
+    // construct an MPS from the (selected) CI vector in this trie, as the
+    // initial MPS for DMRG, using a left-to-right sweep of truncated SVDs
+    // the SVD at each site is done through the Gram matrix of the left
+    // index, accumulated by streaming over unique suffixes, so that the
+    // CI matrix is never formed; quantum number blocks are in parallel
+    // info: bond dimension is used for truncation and left dims are saved
+    // cutoff: min squared singular value kept
+    // the MPS has canonical form LL...LK (center at the last site, dot = 1)
+    template <typename S>
+    shared_ptr<MPS<S>> construct_mps(const shared_ptr<MPSInfo<S>> &info,
+                                     double cutoff = 1E-14) const {
+        assert(enable_look_up && vals.size() == dets.size());
+        assert(info->n_sites == n_sites);
+        const int n_dets = (int)dets.size();
+        int ntg = threading->activate_global();
+        vector<vector<uint8_t>> xdets(n_dets);
+#pragma omp parallel for schedule(static) num_threads(ntg)
+        for (int k = 0; k < n_dets; k++)
+            xdets[k] = (*this)[k];
+        // sorted by reversed determinant, so that determinants sharing
+        // the same suffix are contiguous
+        vector<int> idx(n_dets);
+        for (int k = 0; k < n_dets; k++)
+            idx[k] = k;
+        sort(idx.begin(), idx.end(), [&xdets, this](int a, int b) {
+            for (int i = n_sites - 1; i >= 0; i--)
+                if (xdets[a][i] != xdets[b][i])
+                    return xdets[a][i] < xdets[b][i];
+            return false;
+        });
+        // each entry is a range of idx sharing det[i:], with the left
+        // quantum number and coefficients of left states in [0, i)
+        vector<int> ebeg(n_dets + 1);
+        vector<S> eqs(n_dets, info->vacuum);
+        vector<vector<double>> evs(n_dets);
+        for (int k = 0; k <= n_dets; k++)
+            ebeg[k] = k;
+        for (int k = 0; k < n_dets; k++)
+            evs[k] = vector<double>(1, vals[idx[k]]);
+        shared_ptr<UnfusedMPS<S>> umps = make_shared<UnfusedMPS<S>>();
+        umps->info = info;
+        umps->n_sites = n_sites;
+        umps->center = n_sites - 1;
+        umps->dot = 1;
+        umps->canonical_form = string(n_sites - 1, 'L') + "K";
+        umps->tensors.resize(n_sites);
+        for (int i = 0; i < n_sites; i++) {
+            check_signal_()();
+            const StateInfo<S> &basis = *info->basis[i];
+            const int n_ents = (int)ebeg.size() - 1;
+            const bool last = i == n_sites - 1;
+            // site state, new left quantum number of each entry
+            vector<uint8_t> ejs(n_ents);
+            vector<S> nqs(n_ents);
+            for (int e = 0; e < n_ents; e++) {
+                ejs[e] = xdets[idx[ebeg[e]]][i];
+                nqs[e] = next_quantum(
+                    eqs[e], D::site_quantum(basis, ejs[e]), ejs[e]);
+            }
+            // groups of entries sharing det[i + 1:] (the columns)
+            vector<int> gbeg;
+            for (int e = 0; e < n_ents; e++) {
+                const vector<uint8_t> &da = xdets[idx[ebeg[e]]];
+                bool same = e != 0;
+                if (same) {
+                    const vector<uint8_t> &db = xdets[idx[ebeg[e - 1]]];
+                    for (int k = i + 1; k < n_sites && same; k++)
+                        same = da[k] == db[k];
+                }
+                if (!same)
+                    gbeg.push_back(e);
+            }
+            gbeg.push_back(n_ents);
+            const int n_grps = (int)gbeg.size() - 1;
+            // quantum number blocks and their rows: (left quantum, j)
+            map<S, int> bmap;
+            vector<S> bqs;
+            vector<vector<int>> bgrps;
+            vector<map<pair<S, uint8_t>, pair<int, int>>> brows;
+            vector<int> bdims, gblk(n_grps);
+            for (int g = 0; g < n_grps; g++) {
+                S q = nqs[gbeg[g]];
+                if (!bmap.count(q)) {
+                    bmap[q] = (int)bqs.size(), bqs.push_back(q);
+                    bgrps.push_back(vector<int>());
+                    brows.push_back(map<pair<S, uint8_t>, pair<int, int>>());
+                    bdims.push_back(0);
+                }
+                int b = gblk[g] = bmap.at(q);
+                bgrps[b].push_back(g);
+                for (int e = gbeg[g]; e < gbeg[g + 1]; e++) {
+                    assert(nqs[e] == q);
+                    pair<S, uint8_t> r = make_pair(eqs[e], ejs[e]);
+                    if (!brows[b].count(r)) {
+                        brows[b][r] = make_pair(bdims[b], (int)evs[e].size());
+                        bdims[b] += (int)evs[e].size();
+                    }
+                }
+            }
+            const int n_blks = (int)bqs.size();
+            // column of the group (coefficients of the rows)
+            auto fill_column = [&](int b, int g, double *x, int stride) {
+                for (int e = gbeg[g]; e < gbeg[g + 1]; e++) {
+                    const int off =
+                        brows[b].at(make_pair(eqs[e], ejs[e])).first;
+                    for (size_t a = 0; a < evs[e].size(); a++)
+                        x[(off + a) * stride] = evs[e][a];
+                }
+            };
+            // kept left singular vectors of each block (one per row)
+            vector<vector<double>> bus(n_blks);
+            vector<int> bms(n_blks, 0);
+            if (last) {
+                // the wavefunction is the (normalized) only column
+                assert(n_grps == 1 && n_blks == 1 && bqs[0] == info->target);
+                bms[0] = 1;
+                bus[0].assign(bdims[0], 0.0);
+                fill_column(0, 0, bus[0].data(), 1);
+                double norm = 0;
+                for (auto &x : bus[0])
+                    norm += x * x;
+                for (auto &x : bus[0])
+                    x /= sqrt(norm);
+            } else {
+                // eigenvalues and eigenvectors of the Gram matrix
+                vector<vector<double>> bws(n_blks), bvs(n_blks);
+#pragma omp parallel for schedule(dynamic) num_threads(ntg)
+                for (int b = 0; b < n_blks; b++) {
+                    const int nr = bdims[b], nbatch = 64;
+                    bvs[b].assign((size_t)nr * nr, 0.0);
+                    bws[b].resize(nr);
+                    vector<double> xs((size_t)nr * nbatch);
+                    MatrixRef gmat(bvs[b].data(), nr, nr);
+                    for (size_t ig = 0; ig < bgrps[b].size(); ig += nbatch) {
+                        const int nc =
+                            (int)min(bgrps[b].size() - ig, (size_t)nbatch);
+                        memset(xs.data(), 0, sizeof(double) * nr * nc);
+                        for (int c = 0; c < nc; c++)
+                            fill_column(b, bgrps[b][ig + c], xs.data() + c, nc);
+                        MatrixRef xmat(xs.data(), nr, nc);
+                        MatrixFunctions::multiply(xmat, false, xmat, true, gmat,
+                                                  1.0, 1.0);
+                    }
+                    MatrixFunctions::eigs(gmat,
+                                          DiagonalMatrix(bws[b].data(), nr));
+                }
+                vector<pair<double, int>> ws;
+                for (int b = 0; b < n_blks; b++)
+                    for (int k = 0; k < bdims[b]; k++)
+                        if (bws[b][k] > cutoff)
+                            ws.push_back(make_pair(bws[b][k], b));
+                sort(ws.begin(), ws.end(), greater<pair<double, int>>());
+                for (size_t k = 0; k < ws.size() && k < info->bond_dim; k++)
+                    bms[ws[k].second]++;
+                // eigenvalues are in ascending order
+                for (int b = 0; b < n_blks; b++) {
+                    const size_t nr = bdims[b];
+                    bus[b].resize(bms[b] * nr);
+                    for (int k = 0; k < bms[b]; k++)
+                        memcpy(bus[b].data() + k * nr,
+                               bvs[b].data() + (nr - 1 - k) * nr,
+                               sizeof(double) * nr);
+                }
+            }
+            // site tensor
+            shared_ptr<SparseTensor<S>> ts = make_shared<SparseTensor<S>>();
+            ts->data.resize(basis.n);
+            for (int b = 0; b < n_blks; b++) {
+                const int m = bms[b], nr = bdims[b];
+                for (auto &r : brows[b]) {
+                    if (m == 0)
+                        break;
+                    const int off = r.second.first, dl = r.second.second;
+                    shared_ptr<Tensor> t = make_shared<Tensor>(dl, 1, m);
+                    for (int a = 0; a < dl; a++)
+                        for (int k = 0; k < m; k++)
+                            t->data[(size_t)a * m + k] =
+                                bus[b][(size_t)k * nr + off + a];
+                    int im = basis.find_state(
+                        D::site_quantum(basis, r.first.second));
+                    assert(im != -1 && basis.n_states[im] == 1);
+                    ts->data[im].push_back(
+                        make_pair(make_pair(r.first.first, bqs[b]), t));
+                }
+            }
+            umps->tensors[i] = ts;
+            if (last)
+                break;
+            // project the columns onto kept states
+            vector<int> gkeep;
+            for (int g = 0; g < n_grps; g++)
+                if (bms[gblk[g]] != 0)
+                    gkeep.push_back(g);
+            vector<int> nebeg(gkeep.size() + 1);
+            vector<S> neqs(gkeep.size());
+            vector<vector<double>> nevs(gkeep.size());
+#pragma omp parallel for schedule(static) num_threads(ntg)
+            for (int ig = 0; ig < (int)gkeep.size(); ig++) {
+                const int g = gkeep[ig], b = gblk[g], m = bms[b];
+                const int nr = bdims[b];
+                nebeg[ig] = ebeg[gbeg[g]];
+                neqs[ig] = bqs[b];
+                nevs[ig].assign(m, 0.0);
+                for (int e = gbeg[g]; e < gbeg[g + 1]; e++) {
+                    const int off =
+                        brows[b].at(make_pair(eqs[e], ejs[e])).first;
+                    for (int k = 0; k < m; k++)
+                        for (size_t a = 0; a < evs[e].size(); a++)
+                            nevs[ig][k] +=
+                                bus[b][(size_t)k * nr + off + a] * evs[e][a];
+                }
+            }
+            nebeg[gkeep.size()] = ebeg[n_ents];
+            ebeg.swap(nebeg), eqs.swap(neqs), evs.swap(nevs);
+            // new left bond dimension
+            int n_kept = 0;
+            for (int b = 0; b < n_blks; b++)
+                n_kept += bms[b] != 0;
+            info->left_dims[i + 1] = make_shared<StateInfo<S>>();
+            info->left_dims[i + 1]->allocate(n_kept);
+            for (int b = 0, k = 0; b < n_blks; b++)
+                if (bms[b] != 0) {
+                    info->left_dims[i + 1]->quanta[k] = bqs[b];
+                    info->left_dims[i + 1]->n_states[k++] = (ubond_t)bms[b];
+                }
+            info->left_dims[i + 1]->sort_states();
+            info->save_left_dims(i + 1);
+            info->left_dims[i + 1]->deallocate();
+        }
+        threading->activate_normal();
+        return umps->finalize();
+    }
 };
 
 template <typename, typename = void> struct DeterminantTRIE;
@@ -174,18 +488,23 @@ struct DeterminantTRIE<S, typename S::is_sz_t> : TRIE<DeterminantTRIE<S>> {
     using TRIE<DeterminantTRIE<S>>::sort_dets;
     DeterminantTRIE(int n_sites, bool enable_look_up = false)
         : TRIE<DeterminantTRIE<S>>(n_sites, enable_look_up) {}
+    // quantum number of site state j in the site basis
+    static S site_quantum(const StateInfo<S> &basis, uint8_t j) {
+        const int n = (j + 1) >> 1, twos = j == 1 ? 1 : (j == 2 ? -1 : 0);
+        for (int k = 0; k < basis.n; k++)
+            if (basis.quanta[k].n() == n && basis.quanta[k].twos() == twos)
+                return basis.quanta[k];
+        assert(false);
+        return basis.quanta[0];
+    }
     // set the value for each determinant to the overlap between mps
     void evaluate(const shared_ptr<UnfusedMPS<S>> &mps, double cutoff = 0) {
         vals.resize(dets.size());
         memset(vals.data(), 0, sizeof(double) * vals.size());
-        bool has_dets = dets.size() != 0;
         shared_ptr<VectorAllocator<uint32_t>> i_alloc =
             make_shared<VectorAllocator<uint32_t>>();
         shared_ptr<VectorAllocator<double>> d_alloc =
             make_shared<VectorAllocator<double>>();
-        vector<
-            tuple<int, int, int, shared_ptr<SparseMatrix<S>>, vector<uint8_t>>>
-            ptrs;
         vector<vector<shared_ptr<SparseMatrixInfo<S>>>> pinfos(n_sites + 1);
         pinfos[0].resize(1);
         pinfos[0][0] = make_shared<SparseMatrixInfo<S>>(i_alloc);
@@ -216,40 +535,19 @@ struct DeterminantTRIE<S, typename S::is_sz_t> : TRIE<DeterminantTRIE<S>> {
                                              false);
             }
         }
-        if (!has_dets) {
-            for (uint8_t j = 0; j < (uint8_t)data[0].size(); j++)
-                if (data[0][j] == 0) {
-                    data[0][j] = (int)data.size();
-                    data.push_back(array<int, 4>{0, 0, 0, 0});
-                }
-        }
         shared_ptr<SparseMatrix<S>> zmat =
             make_shared<SparseMatrix<S>>(d_alloc);
         zmat->allocate(pinfos[0][0]);
         for (size_t j = 0; j < zmat->total_memory; j++)
             zmat->data[j] = 1.0;
-        vector<uint8_t> zdet(n_sites);
-        for (uint8_t j = 0; j < (int)data[0].size(); j++)
-            if (data[0][j] != 0)
-                ptrs.push_back(make_tuple(data[0][j], j, 0, zmat, zdet));
-        vector<
-            tuple<int, int, int, shared_ptr<SparseMatrix<S>>, vector<uint8_t>>>
-            pptrs;
-        int ntg = threading->activate_global();
-        int ngroup = ntg * 4;
-        vector<shared_ptr<SparseMatrix<S>>> ccmp(ngroup);
-#pragma omp parallel num_threads(ntg)
-        // depth-first traverse of trie
-        while (!ptrs.empty()) {
-            check_signal_()();
-            int pstart = max(0, (int)ptrs.size() - ngroup);
-#pragma omp for schedule(static)
-            for (int ip = pstart; ip < (int)ptrs.size(); ip++) {
+        // the remaining sites are right-canonical, so the norm of the
+        // partial contraction bounds all coefficients in its subtree
+        this->traverse_evaluate(
+            zmat, [&mps, &pinfos, cutoff,
+                   this](uint8_t j, int d,
+                         const shared_ptr<SparseMatrix<S>> &pmp) {
                 shared_ptr<VectorAllocator<double>> pd_alloc =
                     make_shared<VectorAllocator<double>>();
-                auto &p = ptrs[ip];
-                int j = get<1>(p), d = get<2>(p);
-                shared_ptr<SparseMatrix<S>> pmp = get<3>(p);
                 shared_ptr<SparseMatrix<S>> cmp =
                     make_shared<SparseMatrix<S>>(pd_alloc);
                 cmp->allocate(pinfos[d + 1][j]);
@@ -262,62 +560,13 @@ struct DeterminantTRIE<S, typename S::is_sz_t> : TRIE<DeterminantTRIE<S>> {
                                               (*cmp)[ket], 1.0, 1.0);
                 }
                 if (cmp->info->n == 0 || (cutoff != 0 && cmp->norm() < cutoff))
-                    ccmp[ip - pstart] = nullptr;
-                else
-                    ccmp[ip - pstart] = cmp;
-            }
-#pragma omp single
-            {
-                for (int ip = pstart; ip < (int)ptrs.size(); ip++) {
-                    if (ccmp[ip - pstart] == nullptr)
-                        continue;
-                    auto &p = ptrs[ip];
-                    int cur = get<0>(p), j = get<1>(p), d = get<2>(p);
-                    vector<uint8_t> det = get<4>(p);
-                    det[d] = j;
-                    shared_ptr<SparseMatrix<S>> cmp = ccmp[ip - pstart];
-                    if (d == n_sites - 1) {
-                        assert(cmp->total_memory == 1 &&
-                               cmp->info->find_state(mps->info->target) == 0);
-                        if (!has_dets) {
-                            dets.push_back(cur);
-                            vals.push_back(cmp->data[0]);
-                            if (enable_look_up) {
-                                invs.resize(data.size());
-                                for (int i = 0, curx = 0; i < n_sites; i++) {
-                                    uint8_t jj = det[i];
-                                    invs[data[curx][jj]] = curx;
-                                    curx = data[curx][jj];
-                                }
-                            }
-                        } else
-                            vals[lower_bound(dets.begin(), dets.end(), cur) -
-                                 dets.begin()] = cmp->data[0];
-                    } else {
-                        if (!has_dets) {
-                            for (uint8_t jj = 0; jj < (uint8_t)data[cur].size();
-                                 jj++)
-                                if (data[cur][jj] == 0) {
-                                    data[cur][jj] = (int)data.size();
-                                    data.push_back(array<int, 4>{0, 0, 0, 0});
-                                }
-                        }
-                        for (uint8_t jj = 0; jj < (uint8_t)data[cur].size();
-                             jj++)
-                            if (data[cur][jj] != 0)
-                                pptrs.push_back(make_tuple(data[cur][jj], jj,
-                                                           d + 1, cmp, det));
-                    }
-                    ccmp[ip - pstart] = nullptr;
-                }
-                ptrs.resize(pstart);
-                ptrs.insert(ptrs.end(), pptrs.begin(), pptrs.end());
-                pptrs.clear();
-            }
-        }
+                    return shared_ptr<SparseMatrix<S>>(nullptr);
+                assert(d != n_sites - 1 ||
+                       (cmp->total_memory == 1 &&
+                        cmp->info->find_state(mps->info->target) == 0));
+                return cmp;
+            });
         pinfos.clear();
-        sort_dets();
-        threading->activate_normal();
     }
 };
 
@@ -334,18 +583,23 @@ struct DeterminantTRIE<S, typename S::is_su2_t> : TRIE<DeterminantTRIE<S>> {
     using TRIE<DeterminantTRIE<S>>::sort_dets;
     DeterminantTRIE(int n_sites, bool enable_look_up = false)
         : TRIE<DeterminantTRIE<S>>(n_sites, enable_look_up) {}
+    // quantum number of site state j in the site basis
+    static S site_quantum(const StateInfo<S> &basis, uint8_t j) {
+        const int n = (j + 1) >> 1;
+        for (int k = 0; k < basis.n; k++)
+            if (basis.quanta[k].n() == n)
+                return basis.quanta[k];
+        assert(false);
+        return basis.quanta[0];
+    }
     // set the value for each CSF to the overlap between mps
     void evaluate(const shared_ptr<UnfusedMPS<S>> &mps, double cutoff = 0) {
         vals.resize(dets.size());
         memset(vals.data(), 0, sizeof(double) * vals.size());
-        bool has_dets = dets.size() != 0;
         shared_ptr<VectorAllocator<uint32_t>> i_alloc =
             make_shared<VectorAllocator<uint32_t>>();
         shared_ptr<VectorAllocator<double>> d_alloc =
             make_shared<VectorAllocator<double>>();
-        vector<
-            tuple<int, int, int, shared_ptr<SparseMatrix<S>>, vector<uint8_t>>>
-            ptrs;
         vector<vector<shared_ptr<SparseMatrixInfo<S>>>> pinfos(n_sites + 1);
         pinfos[0].resize(1);
         pinfos[0][0] = make_shared<SparseMatrixInfo<S>>(i_alloc);
@@ -380,40 +634,19 @@ struct DeterminantTRIE<S, typename S::is_su2_t> : TRIE<DeterminantTRIE<S>> {
                                              false);
             }
         }
-        if (!has_dets) {
-            for (uint8_t j = 0; j < (uint8_t)data[0].size(); j++)
-                if (data[0][j] == 0) {
-                    data[0][j] = (int)data.size();
-                    data.push_back(array<int, 4>{0, 0, 0, 0});
-                }
-        }
         shared_ptr<SparseMatrix<S>> zmat =
             make_shared<SparseMatrix<S>>(d_alloc);
         zmat->allocate(pinfos[0][0]);
         for (size_t j = 0; j < zmat->total_memory; j++)
             zmat->data[j] = 1.0;
-        vector<uint8_t> zdet(n_sites);
-        for (uint8_t j = 0; j < (int)data[0].size(); j++)
-            if (data[0][j] != 0)
-                ptrs.push_back(make_tuple(data[0][j], j, 0, zmat, zdet));
-        vector<
-            tuple<int, int, int, shared_ptr<SparseMatrix<S>>, vector<uint8_t>>>
-            pptrs;
-        int ntg = threading->activate_global();
-        int ngroup = ntg * 4;
-        vector<shared_ptr<SparseMatrix<S>>> ccmp(ngroup);
-#pragma omp parallel num_threads(ntg)
-        // depth-first traverse of trie
-        while (!ptrs.empty()) {
-            check_signal_()();
-            int pstart = max(0, (int)ptrs.size() - ngroup);
-#pragma omp for schedule(static)
-            for (int ip = pstart; ip < (int)ptrs.size(); ip++) {
+        // the remaining sites are right-canonical, so the norm of the
+        // partial contraction bounds all coefficients in its subtree
+        this->traverse_evaluate(
+            zmat, [&mps, &pinfos, cutoff,
+                   this](uint8_t j, int d,
+                         const shared_ptr<SparseMatrix<S>> &pmp) {
                 shared_ptr<VectorAllocator<double>> pd_alloc =
                     make_shared<VectorAllocator<double>>();
-                auto &p = ptrs[ip];
-                int j = get<1>(p), d = get<2>(p);
-                shared_ptr<SparseMatrix<S>> pmp = get<3>(p);
                 shared_ptr<SparseMatrix<S>> cmp =
                     make_shared<SparseMatrix<S>>(pd_alloc);
                 cmp->allocate(pinfos[d + 1][j]);
@@ -430,62 +663,13 @@ struct DeterminantTRIE<S, typename S::is_su2_t> : TRIE<DeterminantTRIE<S>> {
                                               (*cmp)[ket], 1.0, 1.0);
                 }
                 if (cmp->info->n == 0 || (cutoff != 0 && cmp->norm() < cutoff))
-                    ccmp[ip - pstart] = nullptr;
-                else
-                    ccmp[ip - pstart] = cmp;
-            }
-#pragma omp single
-            {
-                for (int ip = pstart; ip < (int)ptrs.size(); ip++) {
-                    if (ccmp[ip - pstart] == nullptr)
-                        continue;
-                    auto &p = ptrs[ip];
-                    int cur = get<0>(p), j = get<1>(p), d = get<2>(p);
-                    vector<uint8_t> det = get<4>(p);
-                    det[d] = j;
-                    shared_ptr<SparseMatrix<S>> cmp = ccmp[ip - pstart];
-                    if (d == n_sites - 1) {
-                        assert(cmp->total_memory == 1 &&
-                               cmp->info->find_state(mps->info->target) == 0);
-                        if (!has_dets) {
-                            dets.push_back(cur);
-                            vals.push_back(cmp->data[0]);
-                            if (enable_look_up) {
-                                invs.resize(data.size());
-                                for (int i = 0, curx = 0; i < n_sites; i++) {
-                                    uint8_t jj = det[i];
-                                    invs[data[curx][jj]] = curx;
-                                    curx = data[curx][jj];
-                                }
-                            }
-                        } else
-                            vals[lower_bound(dets.begin(), dets.end(), cur) -
-                                 dets.begin()] = cmp->data[0];
-                    } else {
-                        if (!has_dets) {
-                            for (uint8_t jj = 0; jj < (uint8_t)data[cur].size();
-                                 jj++)
-                                if (data[cur][jj] == 0) {
-                                    data[cur][jj] = (int)data.size();
-                                    data.push_back(array<int, 4>{0, 0, 0, 0});
-                                }
-                        }
-                        for (uint8_t jj = 0; jj < (uint8_t)data[cur].size();
-                             jj++)
-                            if (data[cur][jj] != 0)
-                                pptrs.push_back(make_tuple(data[cur][jj], jj,
-                                                           d + 1, cmp, det));
-                    }
-                    ccmp[ip - pstart] = nullptr;
-                }
-                ptrs.resize(pstart);
-                ptrs.insert(ptrs.end(), pptrs.begin(), pptrs.end());
-                pptrs.clear();
-            }
-        }
+                    return shared_ptr<SparseMatrix<S>>(nullptr);
+                assert(d != n_sites - 1 ||
+                       (cmp->total_memory == 1 &&
+                        cmp->info->find_state(mps->info->target) == 0));
+                return cmp;
+            });
         pinfos.clear();
-        sort_dets();
-        threading->activate_normal();
     }
 };
 
@@ -578,12 +762,19 @@ template <typename S> struct DeterminantMPSInfo : MPSInfo<S> {
     void set_left_bond_dimension(int i,
                                  const vector<vector<vector<uint8_t>>> &dets) {
         this->left_dims[0] = make_shared<StateInfo<S>>(this->vacuum);
-        for (int j = 0; j < i; j++) {
-            set<vector<uint8_t>, typename DeterminantQC<S>::det_less> mp;
+        // prefixes of all lengths are collected in parallel
+        vector<set<vector<uint8_t>, typename DeterminantQC<S>::det_less>> mps(
+            i);
+        int ntg = threading->activate_global();
+#pragma omp parallel for schedule(dynamic) num_threads(ntg)
+        for (int j = 0; j < i; j++)
             for (auto &idets : dets)
                 for (auto &jdet : idets)
-                    mp.insert(
+                    mps[j].insert(
                         vector<uint8_t>(jdet.begin(), jdet.begin() + j + 1));
+        threading->activate_normal();
+        for (int j = 0; j < i; j++) {
+            const auto &mp = mps[j];
             this->left_dims[j + 1]->allocate((int)mp.size());
             auto it = mp.begin();
             for (int k = 0; k < this->left_dims[j + 1]->n; k++, it++) {
@@ -608,12 +799,19 @@ template <typename S> struct DeterminantMPSInfo : MPSInfo<S> {
                                   const vector<vector<vector<uint8_t>>> &dets) {
         this->right_dims[this->n_sites] =
             make_shared<StateInfo<S>>(this->vacuum);
-        for (int j = this->n_sites - 1; j > i; j--) {
-            set<vector<uint8_t>, typename DeterminantQC<S>::det_less> mp;
+        // suffixes of all lengths are collected in parallel
+        vector<set<vector<uint8_t>, typename DeterminantQC<S>::det_less>> mps(
+            max(this->n_sites - i - 1, 0));
+        int ntg = threading->activate_global();
+#pragma omp parallel for schedule(dynamic) num_threads(ntg)
+        for (int j = i + 1; j < this->n_sites; j++)
             for (auto &idets : dets)
                 for (auto &jdet : idets)
-                    mp.insert(
+                    mps[j - i - 1].insert(
                         vector<uint8_t>(jdet.begin() + (j - i), jdet.end()));
+        threading->activate_normal();
+        for (int j = this->n_sites - 1; j > i; j--) {
+            const auto &mp = mps[j - i - 1];
             this->right_dims[j]->allocate((int)mp.size());
             auto it = mp.begin();
             for (int k = 0; k < this->right_dims[j]->n; k++, it++) {
@@ -636,8 +834,10 @@ template <typename S> struct DeterminantMPSInfo : MPSInfo<S> {
     }
     vector<vector<vector<uint8_t>>> get_determinants(StateInfo<S> &st,
                                                      int i_begin, int i_end) {
-        vector<vector<vector<uint8_t>>> dets;
-        dets.reserve(st.n);
+        // quantum numbers are handled in parallel
+        vector<vector<vector<uint8_t>>> pdets(st.n);
+        int ntg = threading->activate_global();
+#pragma omp parallel for schedule(dynamic) num_threads(ntg)
         for (int j = 0; j < st.n; j++) {
             vector<vector<uint8_t>> dd =
                 det->distribute(st.quanta[j], i_begin, i_end);
@@ -652,10 +852,15 @@ template <typename S> struct DeterminantMPSInfo : MPSInfo<S> {
             sort(dd_idx.begin(), dd_idx.end(), [&dd_energies](int ii, int jj) {
                 return dd_energies[ii] < dd_energies[jj];
             });
-            dets.push_back(vector<vector<uint8_t>>());
             for (int k = 0; k < n_states; k++)
-                dets.back().push_back(dd[dd_idx[k]]);
+                pdets[j].push_back(dd[dd_idx[k]]);
         }
+        threading->activate_normal();
+        vector<vector<vector<uint8_t>>> dets;
+        dets.reserve(st.n);
+        for (auto &dd : pdets)
+            if (dd.size() != 0)
+                dets.push_back(move(dd));
         st.deallocate();
         return dets;
     }
@@ -30,6 +30,7 @@
 #include <cassert>
 #include <functional>
 #include <iostream>
+#include <limits>
 #include <memory>
 #include <utility>
 #include <vector>
@@ -52,6 +53,12 @@ enum struct ExpectationTypes : uint8_t { Real, Complex };
 
 enum struct LinearSolverTypes : uint8_t { CG, MinRes, GCROT };
 
+// step scaling factor for an RK4 step with relative embedded (midpoint rule,
+// third order in the step size) error estimate err and tolerance tol
+inline double rk4_step_factor(double err, double tol) {
+    return 0.9 * pow(tol / err, 1.0 / 3.0);
+}
+
 template <typename S, typename = MPS<S>> struct EffectiveHamiltonian;
 
 // Effective Hamiltonian
@@ -70,6 +77,9 @@ template <typename S> struct EffectiveHamiltonian<S, MPS<S>> {
     bool compute_diag;
     vector<shared_ptr<typename SparseMatrixInfo<S>::ConnectionInfo>> wfn_infos;
     vector<S> operator_quanta;
+    // Flat instruction lists of the expressions, compiled at the first
+    // matvec with each expression
+    map<int, shared_ptr<TensorProductProgram>> programs;
     EffectiveHamiltonian(
         const vector<pair<S, shared_ptr<SparseMatrixInfo<S>>>> &left_op_infos,
         const vector<pair<S, shared_ptr<SparseMatrixInfo<S>>>> &right_op_infos,
@@ -130,6 +140,13 @@ template <typename S> struct EffectiveHamiltonian<S, MPS<S>> {
                 break;
             }
     }
+    // Whether expressions are lowered to flat instruction lists for matvec
+    // Only used without batched gemm (SeqTypes::None) and for expressions
+    // of products of normal operators
+    static bool &compiled_multiply() {
+        static bool compiled = true;
+        return compiled;
+    }
     // prepare batch gemm
     void precompute() const {
         if (tf->opf->seq->mode == SeqTypes::Auto) {
@@ -153,11 +170,18 @@ template <typename S> struct EffectiveHamiltonian<S, MPS<S>> {
             tf->opf->seq->clear();
         }
     }
-    shared_ptr<SparseMatrixGroup<S>>
-    perturbative_noise(bool trace_right, int iL, int iR, FuseTypes ftype,
-                       const shared_ptr<MPSInfo<S>> &mps_info,
-                       const NoiseTypes noise_type,
-                       const shared_ptr<ParallelRule<S>> &para_rule = nullptr) {
+    // Perturbed wavefunctions for perturbative noise
+    // If fold is not nullptr (reduced noise only), the perturbed
+    // wavefunctions are generated in groups of at most max_mem doubles
+    // (at least one wavefunction per group). Each group is passed to fold
+    // and deallocated, and nullptr is returned
+    shared_ptr<SparseMatrixGroup<S>> perturbative_noise(
+        bool trace_right, int iL, int iR, FuseTypes ftype,
+        const shared_ptr<MPSInfo<S>> &mps_info, const NoiseTypes noise_type,
+        const shared_ptr<ParallelRule<S>> &para_rule = nullptr,
+        size_t max_mem = 0,
+        const function<void(const shared_ptr<SparseMatrixGroup<S>> &)> &fold =
+            nullptr) {
         shared_ptr<VectorAllocator<uint32_t>> i_alloc =
             make_shared<VectorAllocator<uint32_t>>();
         shared_ptr<VectorAllocator<double>> d_alloc =
@@ -226,8 +250,23 @@ template <typename S> struct EffectiveHamiltonian<S, MPS<S>> {
         bool do_reduce = !(noise_type & NoiseTypes::Collected);
         bool reduced = noise_type & NoiseTypes::Reduced;
         bool low_mem = noise_type & NoiseTypes::LowMem;
+        const bool streamed = reduced && fold != nullptr;
+        // first perturbed wavefunction of each group
+        vector<size_t> groups = {0};
+        if (streamed) {
+            for (size_t j = 0, mem = 0; j < infos.size(); j++) {
+                const size_t jmem = infos[j]->get_total_memory();
+                if (mem != 0 && mem + jmem > max_mem)
+                    groups.push_back(j), mem = 0;
+                mem += jmem;
+            }
+        }
+        groups.push_back(infos.size());
         if (reduced)
-            perturb_ket->allocate(infos);
+            perturb_ket->allocate(
+                streamed ? vector<shared_ptr<SparseMatrixInfo<S>>>(
+                               infos.begin(), infos.begin() + groups[1])
+                         : infos);
         else {
             vector<shared_ptr<SparseMatrixInfo<S>>> all_infos;
             all_infos.reserve(all_perturb_ket_labels.size());
@@ -266,6 +305,45 @@ template <typename S> struct EffectiveHamiltonian<S, MPS<S>> {
                 assert(cinfos[j][k]->n[4] == 1);
             }
         }
+        for (size_t ig = 0; ig + 1 < groups.size(); ig++) {
+            if (ig != 0)
+                perturb_ket->allocate(vector<shared_ptr<SparseMatrixInfo<S>>>(
+                    infos.begin() + groups[ig],
+                    infos.begin() + groups[ig + 1]));
+            perturbative_noise_multiply(
+                trace_right, psubsl, cinfos,
+                streamed ? vector<S>(perturb_ket_labels.begin() + groups[ig],
+                                     perturb_ket_labels.begin() +
+                                         groups[ig + 1])
+                         : perturb_ket_labels,
+                perturb_ket, reduced, low_mem, do_reduce, para_rule);
+            if (streamed) {
+                fold(perturb_ket);
+                perturb_ket->deallocate();
+            }
+        }
+        for (int j = (int)cinfos.size() - 1; j >= 0; j--)
+            for (int k = (int)cinfos[j].size() - 1; k >= 0; k--)
+                cinfos[j][k]->deallocate();
+        if (streamed) {
+            for (int j = (int)infos.size() - 1; j >= 0; j--)
+                infos[j]->deallocate();
+            return nullptr;
+        }
+        return perturb_ket;
+    }
+    // perturb_ket = (H_eff with identity on one side) x ket for perturbed
+    // wavefunctions with quanta perturb_ket_labels
+    void perturbative_noise_multiply(
+        bool trace_right, const vector<pair<uint8_t, S>> &psubsl,
+        const vector<
+            vector<shared_ptr<typename SparseMatrixInfo<S>::ConnectionInfo>>>
+            &cinfos,
+        const vector<S> &perturb_ket_labels,
+        const shared_ptr<SparseMatrixGroup<S>> &perturb_ket, bool reduced,
+        bool low_mem, bool do_reduce,
+        const shared_ptr<ParallelRule<S>> &para_rule) {
+        shared_ptr<OpExpr<S>> pexpr = op->mat->data[0];
         int vidx = reduced ? -1 : 0;
         // perform multiplication
         tf->tensor_product_partial_multiply(pexpr, op->lopt, op->ropt,
@@ -296,10 +374,6 @@ template <typename S> struct EffectiveHamiltonian<S, MPS<S>> {
             if (para_rule != nullptr && do_reduce)
                 para_rule->comm->reduce_sum(perturb_ket, para_rule->comm->root);
         }
-        for (int j = (int)cinfos.size() - 1; j >= 0; j--)
-            for (int k = (int)cinfos[j].size() - 1; k >= 0; k--)
-                cinfos[j][k]->deallocate();
-        return perturb_ket;
     }
     int get_mpo_bond_dimension() const {
         if (op->mat->data.size() == 0)
@@ -338,17 +412,81 @@ template <typename S> struct EffectiveHamiltonian<S, MPS<S>> {
                     operator_quanta.begin();
         assert(ic < operator_quanta.size() && wfn_infos[ic] != nullptr);
         cmat->info->cinfo = wfn_infos[ic];
+        if (compiled_multiply() &&
+            tf->get_type() == TensorFunctionsTypes::Normal &&
+            tf->opf->seq->mode == SeqTypes::None) {
+            if (!programs.count(idx))
+                programs[idx] = tf->compile_tensor_product_multiply(
+                    op->mat->data[idx], op->lopt, op->ropt, cmat, vmat,
+                    idx_opdq);
+            if (programs.at(idx) != nullptr)
+                return tf->compiled_tensor_product_multiply(programs.at(idx),
+                                                            cmat, vmat);
+        }
         tf->tensor_product_multiply(op->mat->data[idx], op->lopt, op->ropt,
                                     cmat, vmat, idx_opdq, all_reduce);
     }
+    // Time for preparing and performing n_mult matvecs with [ket]
+    // using each candidate SeqTypes
+    vector<double>
+    time_seq_types(const vector<SeqTypes> &candidates, int n_mult,
+                   const shared_ptr<ParallelRule<S>> &para_rule = nullptr) {
+        shared_ptr<BatchGEMMSeq> seq = tf->opf->seq;
+        const SeqTypes mode = seq->mode;
+        frame->activate(0);
+        MatrixRef b(ket->data, (MKL_INT)ket->total_memory, 1);
+        MatrixRef c(nullptr, (MKL_INT)bra->total_memory, 1);
+        c.allocate();
+        vector<double> times;
+        Timer t;
+        for (SeqTypes st : candidates) {
+            seq->mode = st;
+            t.get_time();
+            precompute();
+            for (int i = 0; i < n_mult; i++) {
+                c.clear();
+                if (st == SeqTypes::Auto || (st & SeqTypes::Tasked))
+                    (*tf)(b, c);
+                else
+                    (*this)(b, c);
+            }
+            post_precompute();
+            times.push_back(t.get_time());
+        }
+        seq->mode = mode;
+        seq->cumulative_nflop = 0;
+        c.deallocate();
+        // all processors should select the same candidate
+        if (para_rule != nullptr)
+            para_rule->comm->broadcast(times.data(), times.size(),
+                                       para_rule->comm->root);
+        return times;
+    }
+    // Number of elements of [ket] owned by each of nproc procs,
+    // for splitting the wavefunction at quantum number block boundaries
+    vector<size_t> distributed_counts(int nproc) const {
+        vector<size_t> counts(nproc, 0);
+        const size_t total = ket->total_memory;
+        for (int i = 0; i < ket->info->n; i++) {
+            size_t sz = (size_t)ket->info->n_states_bra[i] *
+                        ket->info->n_states_ket[i];
+            size_t mid = ket->info->n_states_total[i] + sz / 2;
+            counts[min((int)(mid * nproc / total), nproc - 1)] += sz;
+        }
+        return counts;
+    }
     // Find eigenvalues and eigenvectors of [H_eff]
     // energy, ndav, nflop, tdav
+    // With DavidsonTypes::Distributed and para_rule, the Davidson vectors
+    // are distributed over procs (recycle_bra is not used)
     tuple<double, int, size_t, double>
     eigs(bool iprint = false, double conv_thrd = 5E-6, int max_iter = 5000,
          int soft_max_iter = -1,
          DavidsonTypes davidson_type = DavidsonTypes::Normal, double shift = 0,
          const shared_ptr<ParallelRule<S>> &para_rule = nullptr,
          const vector<shared_ptr<SparseMatrix<S>>> &ortho_bra =
+             vector<shared_ptr<SparseMatrix<S>>>(),
+         const vector<shared_ptr<SparseMatrix<S>>> &recycle_bra =
              vector<shared_ptr<SparseMatrix<S>>>()) {
         int ndav = 0;
         assert(compute_diag);
@@ -360,22 +498,56 @@ template <typename S> struct EffectiveHamiltonian<S, MPS<S>> {
         for (size_t i = 0; i < ortho_bra.size(); i++)
             ors[i] = MatrixRef(ortho_bra[i]->data,
                                (MKL_INT)ortho_bra[i]->total_memory, 1);
+        vector<MatrixRef> rvs =
+            vector<MatrixRef>(recycle_bra.size(), MatrixRef(nullptr, 0, 0));
+        for (size_t i = 0; i < recycle_bra.size(); i++)
+            rvs[i] = MatrixRef(recycle_bra[i]->data,
+                               (MKL_INT)recycle_bra[i]->total_memory, 1);
         frame->activate(0);
         Timer t;
         t.get_time();
         tf->opf->seq->cumulative_nflop = 0;
         precompute();
-        vector<double> eners =
-            (tf->opf->seq->mode == SeqTypes::Auto ||
-             (tf->opf->seq->mode & SeqTypes::Tasked))
-                ? MatrixFunctions::harmonic_davidson(
-                      *tf, aa, bs, shift, davidson_type, ndav, iprint,
-                      para_rule == nullptr ? nullptr : para_rule->comm,
-                      conv_thrd, max_iter, soft_max_iter, 2, 50, ors)
-                : MatrixFunctions::harmonic_davidson(
-                      *this, aa, bs, shift, davidson_type, ndav, iprint,
-                      para_rule == nullptr ? nullptr : para_rule->comm,
-                      conv_thrd, max_iter, soft_max_iter, 2, 50, ors);
+        // early iterations use single precision matvec, if enabled
+        tf->opf->seq->single_prec =
+            tf->opf->seq->mode == SeqTypes::Auto &&
+            tf->opf->seq->single_prec_thrd != 0 &&
+            !(davidson_type & DavidsonTypes::Harmonic) &&
+            !(davidson_type & DavidsonTypes::Lanczos) &&
+            !(davidson_type & DavidsonTypes::Chebyshev) &&
+            !(davidson_type & DavidsonTypes::JacobiDavidson) &&
+            !(davidson_type & DavidsonTypes::Distributed);
+        vector<double> eners;
+        if ((davidson_type & DavidsonTypes::Distributed) &&
+            para_rule != nullptr) {
+            // the matvec result is not reduced here, as
+            // distributed_davidson sums it only to the owners
+            const bool seq_tasked = tf->opf->seq->mode == SeqTypes::Auto ||
+                                    (tf->opf->seq->mode & SeqTypes::Tasked);
+            auto partial_op = [this, seq_tasked](const MatrixRef &b,
+                                                 const MatrixRef &c) {
+                if (seq_tasked)
+                    tf->TensorFunctions<S>::operator()(b, c);
+                else
+                    (*this)(b, c, 0, 1.0, false);
+            };
+            eners = MatrixFunctions::distributed_davidson(
+                partial_op, aa, bs, distributed_counts(para_rule->comm->size),
+                shift, davidson_type, ndav, iprint, para_rule->comm, conv_thrd,
+                max_iter, soft_max_iter, 2, 50, ors);
+        } else
+            eners =
+                (tf->opf->seq->mode == SeqTypes::Auto ||
+                 (tf->opf->seq->mode & SeqTypes::Tasked))
+                    ? MatrixFunctions::harmonic_davidson(
+                          *tf, aa, bs, shift, davidson_type, ndav, iprint,
+                          para_rule == nullptr ? nullptr : para_rule->comm,
+                          conv_thrd, max_iter, soft_max_iter, 2, 50, ors, rvs)
+                    : MatrixFunctions::harmonic_davidson(
+                          *this, aa, bs, shift, davidson_type, ndav, iprint,
+                          para_rule == nullptr ? nullptr : para_rule->comm,
+                          conv_thrd, max_iter, soft_max_iter, 2, 50, ors, rvs);
+        tf->opf->seq->single_prec = false;
         post_precompute();
         uint64_t nflop = tf->opf->seq->cumulative_nflop;
         if (para_rule != nullptr)
@@ -384,6 +556,7 @@ template <typename S> struct EffectiveHamiltonian<S, MPS<S>> {
         return make_tuple(eners[0], ndav, (size_t)nflop, t.get_time());
     }
     // [bra] = ([H_eff] + omega + i eta)^(-1) x [ket]
+    // recycle: GCROT subspace kept between frequencies with the same [H_eff]
     // (real gf, imag gf), (nmult, niter), nflop, tmult
     tuple<pair<double, double>, pair<int, int>, size_t, double>
     greens_function(double const_e, double omega, double eta,
@@ -391,7 +564,8 @@ template <typename S> struct EffectiveHamiltonian<S, MPS<S>> {
                     pair<int, int> gcrotmk_size, bool iprint = false,
                     double conv_thrd = 5E-6, int max_iter = 5000,
                     int soft_max_iter = -1,
-                    const shared_ptr<ParallelRule<S>> &para_rule = nullptr) {
+                    const shared_ptr<ParallelRule<S>> &para_rule = nullptr,
+                    ComplexGCROTRecycle *recycle = nullptr) {
         int nmult = 0, nmultx = 0, niter = 0;
         frame->activate(0);
         Timer t;
@@ -457,7 +631,8 @@ template <typename S> struct EffectiveHamiltonian<S, MPS<S>> {
             op, aa, cbra, cket, nmultx, niter, gcrotmk_size.first,
             gcrotmk_size.second, iprint,
             para_rule == nullptr ? nullptr : para_rule->comm, conv_thrd,
-            max_iter, soft_max_iter);
+            max_iter, soft_max_iter, recycle,
+            complex<double>(const_e + omega, eta));
         gf = conj(gf);
         ComplexMatrixFunctions::extract_complex(cbra, rbra, ibra);
         if (compute_diag)
@@ -474,6 +649,106 @@ template <typename S> struct EffectiveHamiltonian<S, MPS<S>> {
         return make_tuple(make_pair(real(gf), imag(gf)),
                           make_pair(nmult, niter), (size_t)nflop, t.get_time());
     }
+    // [rbras[j] + i ibras[j]] = ([H_eff] + omegas[j] + i eta)^(-1) x [ket]
+    // for all frequencies together, with ibras[j] as initial guesses
+    // [H_eff] is applied to all unconverged frequencies as one panel
+    // (real gf, imag gf) for each frequency, (nmult, niter), nflop, tmult
+    tuple<vector<pair<double, double>>, pair<int, int>, size_t, double>
+    greens_function_multi(double const_e, const vector<double> &omegas,
+                          double eta, const vector<MatrixRef> &rbras,
+                          const vector<MatrixRef> &ibras, bool iprint = false,
+                          double conv_thrd = 5E-6, int max_iter = 5000,
+                          int soft_max_iter = -1,
+                          const shared_ptr<ParallelRule<S>> &para_rule =
+                              nullptr) {
+        const int nw = (int)omegas.size();
+        const MKL_INT n = (MKL_INT)ket->total_memory;
+        assert((int)rbras.size() == nw && (int)ibras.size() == nw);
+        int nmult = 0, niter = 0;
+        frame->activate(0);
+        Timer t;
+        t.get_time();
+        MatrixRef mket(ket->data, n, 1);
+        ComplexMatrixRef cket(nullptr, n, 1);
+        cket.allocate();
+        vector<complex<double>> cbras((size_t)n * nw);
+        vector<ComplexMatrixRef> xs;
+        vector<complex<double>> shifts;
+        for (int j = 0; j < nw; j++) {
+            xs.push_back(ComplexMatrixRef(cbras.data() + (size_t)n * j, n, 1));
+            shifts.push_back(complex<double>(const_e + omegas[j], eta));
+        }
+        precompute();
+        const function<void(const vector<MatrixRef> &,
+                            const vector<MatrixRef> &)> &f =
+            [this](const vector<MatrixRef> &a, const vector<MatrixRef> &b) {
+                if (this->tf->opf->seq->mode == SeqTypes::Auto ||
+                    (this->tf->opf->seq->mode & SeqTypes::Tasked))
+                    return this->tf->multiply_panel(a, b);
+                else
+                    for (size_t k = 0; k < a.size(); k++)
+                        (*this)(a[k], b[k]);
+            };
+        // real and imag parts of all vectors form one real panel
+        vector<double> xbs, xcs;
+        auto op = [n, &f, &xbs, &xcs](const vector<ComplexMatrixRef> &bs,
+                                      const vector<ComplexMatrixRef> &cs) {
+            const size_t nb = bs.size();
+            xbs.resize((size_t)n * 2 * nb);
+            xcs.resize((size_t)n * 2 * nb);
+            vector<MatrixRef> mbs, mcs;
+            for (size_t k = 0; k < nb * 2; k++) {
+                mbs.push_back(MatrixRef(xbs.data() + (size_t)n * k, n, 1));
+                mcs.push_back(MatrixRef(xcs.data() + (size_t)n * k, n, 1));
+                mcs.back().clear();
+            }
+            for (size_t k = 0; k < nb; k++)
+                ComplexMatrixFunctions::extract_complex(bs[k], mbs[k * 2],
+                                                        mbs[k * 2 + 1]);
+            f(mbs, mcs);
+            for (size_t k = 0; k < nb; k++)
+                ComplexMatrixFunctions::fill_complex(cs[k], mcs[k * 2],
+                                                     mcs[k * 2 + 1]);
+        };
+        tf->opf->seq->cumulative_nflop = 0;
+        // initial guess for real part from imag part
+        vector<MatrixRef> hibras;
+        vector<double> hbuf((size_t)n * nw);
+        for (int j = 0; j < nw; j++) {
+            hibras.push_back(MatrixRef(hbuf.data() + (size_t)n * j, n, 1));
+            hibras.back().clear();
+        }
+        f(ibras, hibras);
+        for (int j = 0; j < nw; j++) {
+            MatrixFunctions::copy(rbras[j], hibras[j]);
+            MatrixFunctions::iadd(rbras[j], ibras[j], const_e + omegas[j]);
+            MatrixFunctions::iscale(rbras[j], -1 / eta);
+            ComplexMatrixFunctions::fill_complex(xs[j], rbras[j], ibras[j]);
+        }
+        cket.clear();
+        ComplexMatrixFunctions::fill_complex(
+            cket, mket, MatrixRef(nullptr, mket.m, mket.n));
+        // solve bras
+        vector<complex<double>> gfs = ComplexMatrixFunctions::shifted_cocg(
+            op, compute_diag ? DiagonalMatrix(diag->data, n)
+                             : DiagonalMatrix(nullptr, 0),
+            shifts, xs, cket, nmult, niter, iprint,
+            para_rule == nullptr ? nullptr : para_rule->comm, conv_thrd,
+            max_iter, soft_max_iter);
+        vector<pair<double, double>> rgfs(nw);
+        for (int j = 0; j < nw; j++) {
+            rgfs[j] = make_pair(real(gfs[j]), -imag(gfs[j]));
+            ComplexMatrixFunctions::extract_complex(xs[j], rbras[j], ibras[j]);
+        }
+        cket.deallocate();
+        post_precompute();
+        uint64_t nflop = tf->opf->seq->cumulative_nflop;
+        if (para_rule != nullptr)
+            para_rule->comm->reduce_sum(&nflop, 1, para_rule->comm->root);
+        tf->opf->seq->cumulative_nflop = 0;
+        return make_tuple(rgfs, make_pair(nmult * 2 + nw, niter),
+                          (size_t)nflop, t.get_time());
+    }
     // [ibra] = (([H_eff] + omega)^2 + eta^2)^(-1) x (-eta [ket])
     // [rbra] = -([H_eff] + omega) (1/eta) [bra]
     // (real gf, imag gf), (nmult, numltp), nflop, tmult
@@ -768,7 +1043,8 @@ template <typename S> struct EffectiveHamiltonian<S, MPS<S>> {
                         (*this)(ktmp, btmp, (int)i, 1.0, true);
                         r = MatrixFunctions::dot(btmp, rtmp);
                     } else {
-                        if (para_rule->own(op->dops[i])) {
+                        if (!para_rule->dynamic_expect() &&
+                            para_rule->own(op->dops[i])) {
                             btmp.clear();
                             (*this)(ktmp, btmp, (int)i, 1.0, false);
                             r = MatrixFunctions::dot(btmp, rtmp);
@@ -779,6 +1055,19 @@ template <typename S> struct EffectiveHamiltonian<S, MPS<S>> {
                     expectations.push_back(make_pair(op->dops[i], r));
                 }
             }
+            if (para_rule != nullptr && para_rule->dynamic_expect())
+                para_rule->comm->dynamic_for(
+                    results.size(), para_rule->dynamic_chunk,
+                    [this, &ktmp, &btmp, &rtmp, &results,
+                     &results_idx](size_t i0, size_t i1) {
+                        // results_idx is also the index in op->dops
+                        for (size_t k = i0; k < i1; k++) {
+                            btmp.clear();
+                            (*this)(ktmp, btmp, (int)results_idx[k], 1.0,
+                                    false);
+                            results[k] = MatrixFunctions::dot(btmp, rtmp);
+                        }
+                    });
             btmp.deallocate();
             if (results.size() != 0) {
                 assert(para_rule != nullptr);
@@ -798,6 +1087,19 @@ template <typename S> struct EffectiveHamiltonian<S, MPS<S>> {
         tf->opf->seq->cumulative_nflop = 0;
         return make_tuple(expectations, (size_t)nflop, t.get_time());
     }
+    // [c] = scale [H_eff] [b] for a zero [c], using the batch prepared by
+    // precompute (if any), so that all RK4 stages share one preparation
+    void rk4_multiply(const MatrixRef &b, const MatrixRef &c, double scale) {
+        if (tf->opf->seq->mode == SeqTypes::Auto) {
+            // the automatic batch cannot be scaled
+            (*tf)(b, c);
+            if (scale != 1.0)
+                MatrixFunctions::iscale(c, scale);
+        } else if (tf->opf->seq->mode & SeqTypes::Tasked)
+            (*tf)(b, c, scale);
+        else
+            (*this)(b, c, 0, scale);
+    }
     // return |ket> and beta [H_eff] |ket>
     pair<vector<shared_ptr<SparseMatrix<S>>>, tuple<int, size_t, double>>
     first_rk4_apply(double beta, double const_e,
@@ -815,22 +1117,25 @@ template <typename S> struct EffectiveHamiltonian<S, MPS<S>> {
         Timer t;
         t.get_time();
         assert(op->mat->data.size() > 0);
-        precompute();
-        const function<void(const MatrixRef &, const MatrixRef &, double)> &f =
-            [this](const MatrixRef &a, const MatrixRef &b, double scale) {
-                if (this->tf->opf->seq->mode == SeqTypes::Auto ||
-                    (this->tf->opf->seq->mode & SeqTypes::Tasked))
-                    return this->tf->operator()(a, b, scale);
-                else
-                    return (*this)(a, b, 0, scale);
-            };
         tf->opf->seq->cumulative_nflop = 0;
-        f(kk, r1, beta);
+        // r0 = projection of |ket> (identity term only)
+        // it is applied directly and not through the batch (or compiled
+        // program) of H, which is prepared once for the matvec below
         shared_ptr<OpExpr<S>> expr = op->mat->data[0];
         op->mat->data[0] = make_shared<OpExpr<S>>();
         add_const_term(1.0, para_rule);
-        f(kk, r0, 1.0);
+        const SeqTypes mode = tf->opf->seq->mode;
+        tf->opf->seq->mode = tf->opf->seq->mode & SeqTypes::Simple
+                                 ? SeqTypes::Simple
+                                 : SeqTypes::None;
+        cmat->data = kk.data, vmat->data = r0.data, cmat->factor = 1.0;
+        tf->tensor_product_multiply(op->mat->data[0], op->lopt, op->ropt, cmat,
+                                    vmat, opdq, true);
+        tf->opf->seq->mode = mode;
         op->mat->data[0] = expr;
+        // r1 = beta H |ket>
+        precompute();
+        rk4_multiply(kk, r1, beta);
         // if (const_e != 0)
         //     MatrixFunctions::iadd(r1, r0, beta * const_e);
         post_precompute();
@@ -874,19 +1179,11 @@ template <typename S> struct EffectiveHamiltonian<S, MPS<S>> {
             vector<double>{16.0 / 81.0, 20.0 / 81.0, 20.0 / 81.0, -2.0 / 81.0},
             vector<double>{1.0 / 6.0, 2.0 / 6.0, 2.0 / 6.0, 1.0 / 6.0}};
         precompute();
-        const function<void(const MatrixRef &, const MatrixRef &, double)> &f =
-            [this](const MatrixRef &a, const MatrixRef &b, double scale) {
-                if (this->tf->opf->seq->mode == SeqTypes::Auto ||
-                    (this->tf->opf->seq->mode & SeqTypes::Tasked))
-                    return this->tf->operator()(a, b, scale);
-                else
-                    return (*this)(a, b, 0, scale);
-            };
         // k1 ~ k3
         for (int i = 1; i < 4; i++) {
             MatrixFunctions::copy(r[0], v);
             MatrixFunctions::iadd(r[0], k[i - 1], ks[i]);
-            f(r[0], k[i], beta);
+            rk4_multiply(r[0], k[i], beta);
         }
         // r0 ~ r2
         for (int i = 0; i < 3; i++) {
@@ -900,7 +1197,7 @@ template <typename S> struct EffectiveHamiltonian<S, MPS<S>> {
         double energy = -const_e;
         if (eval_energy) {
             k[0].clear();
-            f(r[2], k[0], 1.0);
+            rk4_multiply(r[2], k[0], 1.0);
             energy = MatrixFunctions::dot(r[2], k[0]) / (norm * norm);
         }
         for (int i = 3; i >= 1; i--)
@@ -915,9 +1212,12 @@ template <typename S> struct EffectiveHamiltonian<S, MPS<S>> {
     }
     // [ket] = exp( [H_eff] ) | [ket] > (RK4 approximation)
     // k1~k4, energy, norm, nexpo, nflop, texpo
+    // step_factor: if not nullptr, reduced to the step scaling factor
+    //   suggested by the embedded midpoint-rule error estimate and step_tol
     pair<vector<MatrixRef>, tuple<double, double, int, size_t, double>>
     rk4_apply(double beta, double const_e, bool eval_energy = false,
-              const shared_ptr<ParallelRule<S>> &para_rule = nullptr) {
+              const shared_ptr<ParallelRule<S>> &para_rule = nullptr,
+              double *step_factor = nullptr, double step_tol = 1E-6) {
         MatrixRef v(ket->data, (MKL_INT)ket->total_memory, 1);
         vector<MatrixRef> k, r;
         Timer t;
@@ -940,22 +1240,14 @@ template <typename S> struct EffectiveHamiltonian<S, MPS<S>> {
             vector<double>{16.0 / 81.0, 20.0 / 81.0, 20.0 / 81.0, -2.0 / 81.0},
             vector<double>{1.0 / 6.0, 2.0 / 6.0, 2.0 / 6.0, 1.0 / 6.0}};
         precompute();
-        const function<void(const MatrixRef &, const MatrixRef &, double)> &f =
-            [this](const MatrixRef &a, const MatrixRef &b, double scale) {
-                if (this->tf->opf->seq->mode == SeqTypes::Auto ||
-                    (this->tf->opf->seq->mode & SeqTypes::Tasked))
-                    return this->tf->operator()(a, b, scale);
-                else
-                    return (*this)(a, b, 0, scale);
-            };
         // k0 ~ k3
         for (int i = 0; i < 4; i++) {
             if (i == 0)
-                f(v, k[i], beta);
+                rk4_multiply(v, k[i], beta);
             else {
                 MatrixFunctions::copy(r[0], v);
                 MatrixFunctions::iadd(r[0], k[i - 1], ks[i]);
-                f(r[0], k[i], beta);
+                rk4_multiply(r[0], k[i], beta);
             }
         }
         // r0 ~ r2
@@ -966,11 +1258,23 @@ template <typename S> struct EffectiveHamiltonian<S, MPS<S>> {
             for (size_t j = 0; j < 4; j++)
                 MatrixFunctions::iadd(r[i], k[j], cs[i][j] * factor);
         }
+        if (step_factor != nullptr) {
+            // RK4 minus midpoint rule: (k0 - 4 k1 + 2 k2 + k3) / 6
+            MatrixFunctions::iscale(k[1], -4.0);
+            MatrixFunctions::iadd(k[1], k[0], 1.0);
+            MatrixFunctions::iadd(k[1], k[2], 2.0);
+            MatrixFunctions::iadd(k[1], k[3], 1.0);
+            double vnorm = MatrixFunctions::norm(v);
+            double err = MatrixFunctions::norm(k[1]) / 6.0;
+            if (err != 0 && vnorm != 0)
+                *step_factor = min(*step_factor,
+                                   rk4_step_factor(err / vnorm, step_tol));
+        }
         double norm = MatrixFunctions::norm(r[2]);
         double energy = -const_e;
         if (eval_energy) {
             k[0].clear();
-            f(r[2], k[0], 1.0);
+            rk4_multiply(r[2], k[0], 1.0);
             energy = MatrixFunctions::dot(r[2], k[0]) / (norm * norm);
         }
         for (int i = 3; i >= 0; i--)
@@ -985,9 +1289,13 @@ template <typename S> struct EffectiveHamiltonian<S, MPS<S>> {
     }
     // [ket] = exp( [H_eff] ) | [ket] > (exact)
     // energy, norm, nexpo, nflop, texpo
+    // s_step: number of Krylov vectors per orthogonalization round
+    // step_factor: if not nullptr, reduced to the ratio between the step size
+    //   suggested by the Krylov error estimate and |beta|
     tuple<double, double, int, size_t, double>
     expo_apply(double beta, double const_e, bool symmetric, bool iprint = false,
-               const shared_ptr<ParallelRule<S>> &para_rule = nullptr) {
+               const shared_ptr<ParallelRule<S>> &para_rule = nullptr,
+               int s_step = 1, double *step_factor = nullptr) {
         assert(compute_diag);
         double anorm = MatrixFunctions::norm(
             MatrixRef(diag->data, (MKL_INT)diag->total_memory, 1));
@@ -996,14 +1304,19 @@ template <typename S> struct EffectiveHamiltonian<S, MPS<S>> {
         t.get_time();
         tf->opf->seq->cumulative_nflop = 0;
         precompute();
+        double t_next = numeric_limits<double>::infinity();
         int nexpo = (tf->opf->seq->mode == SeqTypes::Auto ||
                      (tf->opf->seq->mode & SeqTypes::Tasked))
                         ? MatrixFunctions::expo_apply(
                               *tf, beta, anorm, v, const_e, symmetric, iprint,
-                              para_rule == nullptr ? nullptr : para_rule->comm)
+                              para_rule == nullptr ? nullptr : para_rule->comm,
+                              5E-6, 20, s_step, &t_next)
                         : MatrixFunctions::expo_apply(
                               *this, beta, anorm, v, const_e, symmetric, iprint,
-                              para_rule == nullptr ? nullptr : para_rule->comm);
+                              para_rule == nullptr ? nullptr : para_rule->comm,
+                              5E-6, 20, s_step, &t_next);
+        if (step_factor != nullptr && beta != 0)
+            *step_factor = min(*step_factor, t_next / abs(beta));
         double norm = MatrixFunctions::norm(v);
         MatrixRef tmp(nullptr, (MKL_INT)ket->total_memory, 1);
         tmp.allocate();
@@ -1024,6 +1337,7 @@ template <typename S> struct EffectiveHamiltonian<S, MPS<S>> {
     }
     void deallocate() {
         frame->activate(0);
+        programs.clear();
         for (int i = (int)wfn_infos.size() - 1; i >= 0; i--)
             if (wfn_infos[i] != nullptr)
                 wfn_infos[i]->deallocate();
@@ -1086,6 +1400,178 @@ template <typename S> struct LinearEffectiveHamiltonian {
             r += h_effs[ih]->op->get_total_memory();
         return r;
     }
+    // [c] += scale * [H_eff[ih]] x [b]
+    void multiply_term(size_t ih, const MatrixRef &b, const MatrixRef &c,
+                       double scale = 1.0) {
+        if (h_effs[ih]->tf->opf->seq->mode == SeqTypes::Auto ||
+            (h_effs[ih]->tf->opf->seq->mode & SeqTypes::Tasked))
+            h_effs[ih]->tf->operator()(b, c, scale);
+        else
+            h_effs[ih]->operator()(b, c, 0, scale);
+    }
+    // Find the lowest eigenvalue e of sum_i f(e)[i] [H_eff[i]], where the
+    // coefficients f(e) depend on the eigenvalue itself (as in AQCC),
+    // starting from the coefficients f(e_guess).
+    // The Davidson subspace keeps the sigma vectors and projected
+    // sub-blocks of each term separately, so that coefficients are
+    // updated self-consistently in the subspace (with at most
+    // max_coeff_iter iterations per Davidson step) without recomputing
+    // any term. coeffs is set to f(e) on return.
+    // energy, ndav, nflop, tdav
+    tuple<double, int, size_t, double> eigs_self_consistent(
+        const function<vector<double>(double)> &f, double e_guess,
+        bool iprint = false,
+        double conv_thrd = 5E-6, int max_iter = 5000, int soft_max_iter = -1,
+        const shared_ptr<ParallelRule<S>> &para_rule = nullptr,
+        int max_coeff_iter = 100, int deflation_max_size = 20) {
+        assert(h_effs.size() != 0);
+        const shared_ptr<ParallelCommunicator<S>> pcomm =
+            para_rule == nullptr ? nullptr : para_rule->comm;
+        const bool is_root = pcomm == nullptr || pcomm->root == pcomm->rank;
+        const shared_ptr<TensorFunctions<S>> &tf = h_effs[0]->tf;
+        const int nt = (int)h_effs.size(), mx = max(deflation_max_size, 2);
+        const MKL_INT n = (MKL_INT)h_effs[0]->ket->total_memory;
+        shared_ptr<VectorAllocator<double>> d_alloc =
+            make_shared<VectorAllocator<double>>();
+        // bs[0:mx], sigmas[t][0:mx], x, sx[t], q, diag
+        double *pw = d_alloc->allocate((size_t)(mx + 1) * (nt + 1) * n + n);
+        vector<MatrixRef> bs(mx, MatrixRef(nullptr, n, 1));
+        vector<vector<MatrixRef>> sigmas(nt, bs);
+        MatrixRef x(pw + (size_t)mx * n, n, 1), q(nullptr, n, 1);
+        vector<MatrixRef> sx(nt, x);
+        DiagonalMatrix aa(pw + (size_t)(mx + 1) * (nt + 1) * n, n);
+        for (int i = 0; i < mx; i++)
+            bs[i].data = pw + (size_t)i * n;
+        for (int t = 0; t < nt; t++) {
+            for (int i = 0; i < mx; i++)
+                sigmas[t][i].data = pw + (size_t)((t + 1) * (mx + 1) + i) * n;
+            sx[t].data = pw + (size_t)((t + 1) * (mx + 1) + mx) * n;
+        }
+        q.data = d_alloc->allocate(n);
+        // projected sub-blocks of each term
+        vector<vector<double>> hs(nt, vector<double>((size_t)mx * mx));
+        MatrixFunctions::copy(bs[0], MatrixRef(h_effs[0]->ket->data, n, 1));
+        MatrixFunctions::iscale(
+            bs[0], 1.0 / sqrt(MatrixFunctions::dot(bs[0], bs[0])));
+        for (int t = 0; t < nt; t++) {
+            assert(h_effs[t]->compute_diag);
+            h_effs[t]->precompute();
+        }
+        frame->activate(0);
+        Timer tt;
+        tt.get_time();
+        tf->opf->seq->cumulative_nflop = 0;
+        int m = 1, msig = 0, ndav = 0, xiter = 0;
+        double e = e_guess, qq = 0;
+        bool e_init = false;
+        if (iprint)
+            cout << endl;
+        while (xiter < max_iter &&
+               (soft_max_iter == -1 || xiter < soft_max_iter)) {
+            xiter++;
+            if (pcomm != nullptr && xiter != 1)
+                pcomm->broadcast(bs[msig].data, (size_t)n * (m - msig),
+                                 pcomm->root);
+            for (int j = msig; j < m; j++, ndav++)
+                for (int t = 0; t < nt; t++) {
+                    sigmas[t][j].clear();
+                    multiply_term(t, bs[j], sigmas[t][j]);
+                }
+            if (is_root) {
+                for (int t = 0; t < nt; t++)
+                    for (int j = msig; j < m; j++)
+                        for (int i = 0; i <= j; i++)
+                            hs[t][i * mx + j] = hs[t][j * mx + i] =
+                                MatrixFunctions::dot(bs[i], sigmas[t][j]);
+                MatrixRef alpha(nullptr, m, m);
+                DiagonalMatrix ld(nullptr, m);
+                alpha.allocate();
+                ld.allocate();
+                // self-consistent coefficients in the subspace
+                for (int it = 0; it < max_coeff_iter; it++) {
+                    coeffs = f(e);
+                    assert((int)coeffs.size() == nt);
+                    alpha.clear();
+                    for (int t = 0; t < nt; t++)
+                        for (int i = 0; i < m; i++)
+                            for (int j = 0; j < m; j++)
+                                alpha(i, j) += coeffs[t] * hs[t][i * mx + j];
+                    MatrixFunctions::eigs(alpha, ld);
+                    const double de = abs(ld.data[0] - e);
+                    e = ld.data[0];
+                    if (e_init && de < 1E-12)
+                        break;
+                    e_init = true;
+                }
+                x.clear(), q.clear();
+                for (int t = 0; t < nt; t++)
+                    sx[t].clear();
+                for (int i = 0; i < m; i++) {
+                    MatrixFunctions::iadd(x, bs[i], alpha(0, i));
+                    for (int t = 0; t < nt; t++)
+                        MatrixFunctions::iadd(sx[t], sigmas[t][i],
+                                              alpha(0, i));
+                }
+                for (int t = 0; t < nt; t++)
+                    MatrixFunctions::iadd(q, sx[t], coeffs[t]);
+                MatrixFunctions::iadd(q, x, -e);
+                qq = MatrixFunctions::dot(q, q);
+                ld.deallocate();
+                alpha.deallocate();
+                if (iprint)
+                    cout << setw(6) << xiter << setw(6) << m << fixed
+                         << setw(15) << setprecision(8) << e << scientific
+                         << setw(13) << setprecision(2) << qq << endl;
+            }
+            if (pcomm != nullptr)
+                pcomm->broadcast(&qq, 1, pcomm->root);
+            if (qq < conv_thrd)
+                break;
+            if (is_root) {
+                aa.clear();
+                for (int t = 0; t < nt; t++)
+                    MatrixFunctions::iadd(
+                        MatrixRef(aa.data, n, 1),
+                        MatrixRef(h_effs[t]->diag->data, n, 1), coeffs[t]);
+                MatrixFunctions::olsen_precondition(q, x, e, aa);
+                // thick restart with the current Ritz vector
+                if (m == mx) {
+                    MatrixFunctions::copy(bs[0], x);
+                    for (int t = 0; t < nt; t++) {
+                        MatrixFunctions::copy(sigmas[t][0], sx[t]);
+                        hs[t][0] = MatrixFunctions::dot(x, sx[t]);
+                    }
+                    m = 1;
+                }
+                for (int k = 0; k < 2; k++)
+                    for (int i = 0; i < m; i++)
+                        MatrixFunctions::iadd(
+                            q, bs[i], -MatrixFunctions::dot(bs[i], q));
+                MatrixFunctions::copy(bs[m], q);
+                MatrixFunctions::iscale(
+                    bs[m], 1.0 / sqrt(MatrixFunctions::dot(bs[m], bs[m])));
+            }
+            if (pcomm != nullptr)
+                pcomm->broadcast(&m, 1, pcomm->root);
+            msig = m, m++;
+        }
+        if (is_root)
+            MatrixFunctions::copy(MatrixRef(h_effs[0]->ket->data, n, 1), x);
+        if (pcomm != nullptr) {
+            pcomm->broadcast(h_effs[0]->ket->data, n, pcomm->root);
+            pcomm->broadcast(&e, 1, pcomm->root);
+            coeffs = f(e);
+        }
+        for (int t = 0; t < nt; t++)
+            h_effs[t]->post_precompute();
+        uint64_t nflop = tf->opf->seq->cumulative_nflop;
+        if (para_rule != nullptr)
+            para_rule->comm->reduce_sum(&nflop, 1, para_rule->comm->root);
+        tf->opf->seq->cumulative_nflop = 0;
+        d_alloc->deallocate(q.data, n);
+        d_alloc->deallocate(pw, (size_t)(mx + 1) * (nt + 1) * n + n);
+        return make_tuple(e, ndav, (size_t)nflop, tt.get_time());
+    }
     // Find eigenvalues and eigenvectors of [H_eff]
     // energy, ndav, nflop, tdav
     tuple<double, int, size_t, double>
@@ -1418,7 +1904,7 @@ template <typename S> struct EffectiveHamiltonian<S, MultiMPS<S>> {
             // perform multiplication
             for (int ii = 0, pvidx = vidx; ii < (int)ket.size(); ii++) {
                 vidx = pvidx;
-                double ket_norm = (*ket[ii])[i]->norm();
+                double ket_norm = ket[ii]->view(i).norm();
                 if (abs(ket_norm) > TINY)
                     tf->tensor_product_partial_multiply(
                         (weights[ii] / ket_norm) * pexpr, op->lopt, op->ropt,
@@ -1496,6 +1982,43 @@ template <typename S> struct EffectiveHamiltonian<S, MultiMPS<S>> {
                                           op->ropt, cmat, vmat, wfn_infos[ic],
                                           idx_opdq, factor, all_reduce);
     }
+    // [cs] = [H_eff[idx]] x [bs] for several vectors (roots) at once
+    // contiguous vectors are multiplied together, reading each operator
+    // block once for all of them
+    void multiply_panel(const vector<MatrixRef> &bs,
+                        const vector<MatrixRef> &cs, int idx = 0,
+                        double factor = 1.0, bool all_reduce = true) {
+        assert(bs.size() == cs.size());
+        const int nroots = (int)bs.size();
+        bool contiguous = true;
+        for (int j = 0; j < nroots && contiguous; j++)
+            contiguous = bs[j].data == bs[0].data + cmat->total_memory * j &&
+                         cs[j].data == cs[0].data + vmat->total_memory * j;
+        if (nroots <= 1 || !contiguous) {
+            for (int j = 0; j < nroots; j++)
+                (*this)(bs[j], cs[j], idx, factor, all_reduce);
+            return;
+        }
+        vector<shared_ptr<SparseMatrixInfo<S>>> cinfos, vinfos;
+        for (int j = 0; j < nroots; j++) {
+            cinfos.insert(cinfos.end(), cmat->infos.begin(), cmat->infos.end());
+            vinfos.insert(vinfos.end(), vmat->infos.begin(), vmat->infos.end());
+        }
+        shared_ptr<SparseMatrixGroup<S>> cmats =
+            make_shared<SparseMatrixGroup<S>>();
+        shared_ptr<SparseMatrixGroup<S>> vmats =
+            make_shared<SparseMatrixGroup<S>>();
+        cmats->allocate(cinfos, bs[0].data);
+        vmats->allocate(vinfos, cs[0].data);
+        S idx_opdq = dynamic_pointer_cast<OpElement<S>>(op->dops[idx])->q_label;
+        size_t ic = lower_bound(operator_quanta.begin(), operator_quanta.end(),
+                                idx_opdq) -
+                    operator_quanta.begin();
+        assert(ic < operator_quanta.size());
+        tf->tensor_product_multi_multiply_panel(
+            op->mat->data[idx], op->lopt, op->ropt, cmats, vmats, nroots,
+            wfn_infos[ic], idx_opdq, factor, all_reduce);
+    }
     // Find eigenvalues and eigenvectors of [H_eff]
     // energies, ndav, nflop, tdav
     tuple<vector<double>, int, size_t, double>
@@ -1567,12 +2090,28 @@ template <typename S> struct EffectiveHamiltonian<S, MultiMPS<S>> {
         }
         return expr;
     }
+    // rr[ib * nket + ik] or rr[ik] = < bra | hket >, hket = H_eff [ket[ik]]
+    void expect_contract(const MatrixRef &hket, MatrixRef &rtmp, int ik,
+                         bool all_pairs, vector<double> &rr) const {
+        if (!all_pairs) {
+            rtmp.data = bra[ik]->data;
+            rr[ik] = MatrixFunctions::dot(hket, rtmp);
+        } else
+            for (size_t ib = 0; ib < bra.size(); ib++) {
+                rtmp.data = bra[ib]->data;
+                rr[ib * ket.size() + ik] = MatrixFunctions::dot(hket, rtmp);
+            }
+    }
     // X = < [bra] | [H_eff] | [ket] >
+    // all_pairs: X[ib * nket + ik] = < bra[ib] | H_eff | ket[ik] > for all
+    // pairs of roots (transition expectations), otherwise X[i] for ib = ik
+    // each H_eff [ket] is computed once and contracted with all bras
     // expectations, nflop, tmult
     tuple<vector<pair<shared_ptr<OpExpr<S>>, vector<double>>>, size_t, double>
     expect(double const_e, ExpectationAlgorithmTypes algo_type,
            ExpectationTypes ex_type,
-           const shared_ptr<ParallelRule<S>> &para_rule = nullptr) {
+           const shared_ptr<ParallelRule<S>> &para_rule = nullptr,
+           bool all_pairs = false) {
         shared_ptr<OpExpr<S>> expr = nullptr;
         if (const_e != 0 && op->mat->data.size() > 0)
             expr = add_const_term(const_e, para_rule);
@@ -1589,14 +2128,18 @@ template <typename S> struct EffectiveHamiltonian<S, MultiMPS<S>> {
         tf->opf->seq->cumulative_nflop = 0;
         vector<pair<shared_ptr<OpExpr<S>>, vector<double>>> expectations;
         expectations.reserve(op->mat->data.size());
+        const size_t nr = all_pairs ? bra.size() * ket.size() : ket.size();
+        if (all_pairs && ex_type != ExpectationTypes::Real)
+            throw runtime_error(
+                "EffectiveHamiltonian::expect: all_pairs requires real MPS.");
         vector<double> results;
         vector<size_t> results_idx;
-        results.reserve(op->mat->data.size() * ket.size());
+        results.reserve(op->mat->data.size() * nr);
         results_idx.reserve(op->mat->data.size());
         if (para_rule != nullptr)
             para_rule->set_partition(ParallelRulePartitionTypes::Middle);
         for (size_t i = 0; i < op->mat->data.size(); i++) {
-            vector<double> rr(ket.size(), 0);
+            vector<double> rr(nr, 0);
             if (dynamic_pointer_cast<OpElement<S>>(op->dops[i])->name ==
                 OpNames::Zero)
                 continue;
@@ -1604,19 +2147,17 @@ template <typename S> struct EffectiveHamiltonian<S, MultiMPS<S>> {
                 if (para_rule == nullptr || !para_rule->number(op->dops[i])) {
                     for (int j = 0; j < (int)ket.size(); j++) {
                         ktmp.data = ket[j]->data;
-                        rtmp.data = bra[j]->data;
                         btmp.clear();
                         (*this)(ktmp, btmp, (int)i, 1.0, true);
-                        rr[j] = MatrixFunctions::dot(btmp, rtmp);
+                        expect_contract(btmp, rtmp, j, all_pairs, rr);
                     }
                 } else {
                     if (para_rule->own(op->dops[i])) {
                         for (int j = 0; j < (int)ket.size(); j++) {
                             ktmp.data = ket[j]->data;
-                            rtmp.data = bra[j]->data;
                             btmp.clear();
                             (*this)(ktmp, btmp, (int)i, 1.0, false);
-                            rr[j] = MatrixFunctions::dot(btmp, rtmp);
+                            expect_contract(btmp, rtmp, j, all_pairs, rr);
                         }
                     }
                     results.insert(results.end(), rr.begin(), rr.end());
@@ -1657,9 +2198,9 @@ template <typename S> struct EffectiveHamiltonian<S, MultiMPS<S>> {
         if (results.size() != 0) {
             assert(para_rule != nullptr);
             para_rule->comm->allreduce_sum(results.data(), results.size());
-            for (size_t i = 0; i < results.size(); i += ket.size())
-                memcpy(expectations[results_idx[i]].second.data(),
-                       results.data() + i, sizeof(double) * ket.size());
+            for (size_t i = 0; i < results.size(); i += nr)
+                memcpy(expectations[results_idx[i / nr]].second.data(),
+                       results.data() + i, sizeof(double) * nr);
         }
         tf->opf->seq->mode = mode;
         uint64_t nflop = tf->opf->seq->cumulative_nflop;
@@ -1670,9 +2211,12 @@ template <typename S> struct EffectiveHamiltonian<S, MultiMPS<S>> {
     }
     // [ket] = exp( [H_eff] ) | [ket] > (RK4 approximation)
     // k1~k4, energy, norm, nexpo, nflop, texpo
+    // step_factor: if not nullptr, reduced to the step scaling factor
+    //   suggested by the embedded midpoint-rule error estimate and step_tol
     pair<vector<MatrixRef>, tuple<double, double, int, size_t, double>>
     rk4_apply(complex<double> beta, double const_e, bool eval_energy = false,
-              const shared_ptr<ParallelRule<S>> &para_rule = nullptr) {
+              const shared_ptr<ParallelRule<S>> &para_rule = nullptr,
+              double *step_factor = nullptr, double step_tol = 1E-6) {
         assert(ket.size() == 2);
         MatrixRef vr(ket[0]->data, (MKL_INT)ket[0]->total_memory, 1);
         MatrixRef vi(ket[1]->data, (MKL_INT)ket[1]->total_memory, 1);
@@ -1693,6 +2237,10 @@ template <typename S> struct EffectiveHamiltonian<S, MultiMPS<S>> {
             k.push_back(MatrixRef(nullptr, (MKL_INT)ket[1]->total_memory, 1));
             k[i + i + 1].allocate(), k[i + i + 1].clear();
         }
+        // H applied to the real and imag parts as one panel
+        MatrixRef hre(nullptr, (MKL_INT)ket[0]->total_memory, 1);
+        MatrixRef him(nullptr, (MKL_INT)ket[1]->total_memory, 1);
+        hre.allocate(), him.allocate();
         tf->opf->seq->cumulative_nflop = 0;
         const vector<double> ks = vector<double>{0.0, 0.5, 0.5, 1.0};
         const vector<vector<double>> cs = vector<vector<double>>{
@@ -1704,18 +2252,21 @@ template <typename S> struct EffectiveHamiltonian<S, MultiMPS<S>> {
         const function<void(const MatrixRef &, const MatrixRef &,
                             const MatrixRef &, const MatrixRef &,
                             complex<double>)> &f =
-            [this](const MatrixRef &are, const MatrixRef &aim,
-                   const MatrixRef &bre, const MatrixRef &bim,
-                   complex<double> scale) {
+            [this, &hre, &him](const MatrixRef &are, const MatrixRef &aim,
+                               const MatrixRef &bre, const MatrixRef &bim,
+                               complex<double> scale) {
                 if (this->tf->opf->seq->mode == SeqTypes::Auto ||
                     (this->tf->opf->seq->mode & SeqTypes::Tasked)) {
+                    hre.clear(), him.clear();
+                    this->tf->multiply_panel(vector<MatrixRef>{are, aim},
+                                             vector<MatrixRef>{hre, him});
                     if (scale.real() != 0) {
-                        this->tf->operator()(are, bre, scale.real());
-                        this->tf->operator()(aim, bim, scale.real());
+                        MatrixFunctions::iadd(bre, hre, scale.real());
+                        MatrixFunctions::iadd(bim, him, scale.real());
                     }
                     if (scale.imag() != 0) {
-                        this->tf->operator()(are, bim, scale.imag());
-                        this->tf->operator()(aim, bre, -scale.imag());
+                        MatrixFunctions::iadd(bim, hre, scale.imag());
+                        MatrixFunctions::iadd(bre, him, -scale.imag());
                     }
                 } else {
                     if (scale.real() != 0) {
@@ -1768,6 +2319,23 @@ template <typename S> struct EffectiveHamiltonian<S, MultiMPS<S>> {
                 }
             }
         }
+        if (step_factor != nullptr) {
+            // RK4 minus midpoint rule: (k0 - 4 k1 + 2 k2 + k3) / 6
+            for (int j = 0; j < 2; j++) {
+                MatrixFunctions::iscale(k[2 + j], -4.0);
+                MatrixFunctions::iadd(k[2 + j], k[0 + j], 1.0);
+                MatrixFunctions::iadd(k[2 + j], k[4 + j], 2.0);
+                MatrixFunctions::iadd(k[2 + j], k[6 + j], 1.0);
+            }
+            double vnorm = sqrt(MatrixFunctions::dot(vr, vr) +
+                                MatrixFunctions::dot(vi, vi));
+            double err = sqrt(MatrixFunctions::dot(k[2], k[2]) +
+                              MatrixFunctions::dot(k[3], k[3])) /
+                         6.0;
+            if (err != 0 && vnorm != 0)
+                *step_factor = min(*step_factor,
+                                   rk4_step_factor(err / vnorm, step_tol));
+        }
         double norm_re = MatrixFunctions::norm(r[2 + 2]);
         double norm_im = MatrixFunctions::norm(r[2 + 2 + 1]);
         double norm = sqrt(norm_re * norm_re + norm_im * norm_im);
@@ -1780,6 +2348,7 @@ template <typename S> struct EffectiveHamiltonian<S, MultiMPS<S>> {
                       MatrixFunctions::dot(r[2 + 2 + 1], k[1])) /
                      (norm * norm);
         }
+        him.deallocate(), hre.deallocate();
         for (int i = 3; i >= 0; i--)
             k[i + i + 1].deallocate(), k[i + i].deallocate();
         post_precompute();
@@ -1793,9 +2362,12 @@ template <typename S> struct EffectiveHamiltonian<S, MultiMPS<S>> {
     // [ket] = exp( [H_eff] ) | [ket] > (exact)
     // energy, norm, nexpo, nflop, texpo
     // nexpo is number of complex matrix multiplications
+    // step_factor: if not nullptr, reduced to the ratio between the step size
+    //   suggested by the Krylov error estimate and |beta|
     tuple<double, double, int, size_t, double>
     expo_apply(complex<double> beta, double const_e, bool iprint = false,
-               const shared_ptr<ParallelRule<S>> &para_rule = nullptr) {
+               const shared_ptr<ParallelRule<S>> &para_rule = nullptr,
+               double *step_factor = nullptr) {
         assert(compute_diag);
         assert(ket.size() == 2);
         double anorm = MatrixFunctions::norm(
@@ -1806,14 +2378,19 @@ template <typename S> struct EffectiveHamiltonian<S, MultiMPS<S>> {
         t.get_time();
         tf->opf->seq->cumulative_nflop = 0;
         precompute();
+        double t_next = numeric_limits<double>::infinity();
         int nexpo = (tf->opf->seq->mode == SeqTypes::Auto ||
                      (tf->opf->seq->mode & SeqTypes::Tasked))
                         ? ComplexMatrixFunctions::expo_apply(
                               *tf, beta, anorm, vr, vi, const_e, iprint,
-                              para_rule == nullptr ? nullptr : para_rule->comm)
+                              para_rule == nullptr ? nullptr : para_rule->comm,
+                              5E-6, 20, &t_next)
                         : ComplexMatrixFunctions::expo_apply(
                               *this, beta, anorm, vr, vi, const_e, iprint,
-                              para_rule == nullptr ? nullptr : para_rule->comm);
+                              para_rule == nullptr ? nullptr : para_rule->comm,
+                              5E-6, 20, &t_next);
+        if (step_factor != nullptr && beta != 0.0)
+            *step_factor = min(*step_factor, t_next / abs(beta));
         double norm_re = MatrixFunctions::norm(vr);
         double norm_im = MatrixFunctions::norm(vi);
         double norm = sqrt(norm_re * norm_re + norm_im * norm_im);
@@ -1825,7 +2402,8 @@ template <typename S> struct EffectiveHamiltonian<S, MultiMPS<S>> {
         tmp_im.clear();
         if (tf->opf->seq->mode == SeqTypes::Auto ||
             (tf->opf->seq->mode & SeqTypes::Tasked))
-            (*tf)(vr, tmp_re), (*tf)(vi, tmp_im);
+            tf->multiply_panel(vector<MatrixRef>{vr, vi},
+                               vector<MatrixRef>{tmp_re, tmp_im});
         else
             (*this)(vr, tmp_re), (*this)(vi, tmp_im);
         double energy = (MatrixFunctions::dot(vr, tmp_re) +
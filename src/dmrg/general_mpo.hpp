@@ -0,0 +1,439 @@
+
+/*
+ * block2: Efficient MPO implementation of quantum chemistry DMRG
+ * Copyright (C) 2020-2021 Huanchen Zhai <hczhai@caltech.edu>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#pragma once
+
+#include "../core/expr.hpp"
+#include "../core/hamiltonian.hpp"
+#include "../core/integral.hpp"
+#include "../core/matching.hpp"
+#include "../core/operator_tensor.hpp"
+#include "../core/symbolic.hpp"
+#include "../core/tensor_functions.hpp"
+#include "mpo.hpp"
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <functional>
+#include <map>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+using namespace std;
+
+namespace block2 {
+
+template <typename, typename = void> struct GeneralMPO;
+
+// MPO for a general sum of fermionic operator strings (non-spin-adapted)
+// At each bond, the operator strings form a bipartite graph between
+// (left operator, site operator) and right suffix. The new left operators
+// are chosen from a minimum vertex cover of this graph, which gives the
+// minimal bond dimension for the given set of terms
+// (Ren et al., J. Chem. Phys. 153, 084118 (2020))
+template <typename S> struct GeneralMPO<S, typename S::is_sz_t> : MPO<S> {
+    using MPO<S>::n_sites;
+    // Number of terms removed by cutoff or vanishing site operators
+    size_t n_dropped_terms = 0;
+    // Operator strings of the quantum chemistry Hamiltonian
+    // H = sum t_ij C_is D_js + 1/2 sum v_ijkl C_is C_kt D_lt D_js
+    // Only the nonzero elements visited by FCIDUMP::for_each_t and
+    // FCIDUMP::for_each_v are generated (n^3 two-electron terms for
+    // momentum-conserving lattice models), and same-spin terms with
+    // i = k or j = l (which vanish) are skipped
+    static void fcidump_terms(const shared_ptr<FCIDUMP> &fcidump,
+                              vector<string> &exprs,
+                              vector<vector<uint16_t>> &sites,
+                              vector<vector<uint8_t>> &spins,
+                              vector<double> &coeffs, double cutoff = 0.0) {
+        fcidump->for_each_t([&](uint8_t s, uint16_t i, uint16_t j, double x) {
+            if (abs(x) > cutoff) {
+                exprs.push_back("CD");
+                sites.push_back(vector<uint16_t>{i, j});
+                spins.push_back(vector<uint8_t>{s, s});
+                coeffs.push_back(x);
+            }
+        });
+        fcidump->for_each_v([&](uint8_t s, uint8_t t, uint16_t i, uint16_t j,
+                                uint16_t k, uint16_t l, double x) {
+            if (abs(x) > cutoff && (s != t || (i != k && j != l))) {
+                exprs.push_back("CCDD");
+                sites.push_back(vector<uint16_t>{i, k, l, j});
+                spins.push_back(vector<uint8_t>{s, t, t, s});
+                coeffs.push_back(0.5 * x);
+            }
+        });
+    }
+    // exprs[i]: operator string of term i, each char is 'C' or 'D'
+    // sites[i] / spins[i]: orbital index / spin (0 = alpha, 1 = beta)
+    // of each operator in the string, coeffs[i]: coefficient of term i
+    // Terms with empty string are added to the constant energy
+    GeneralMPO(const shared_ptr<Hamiltonian<S>> &hamil,
+               const vector<string> &exprs,
+               const vector<vector<uint16_t>> &sites,
+               const vector<vector<uint8_t>> &spins,
+               const vector<double> &coeffs, double cutoff = 1E-14,
+               double const_e = 0.0)
+        : MPO<S>(hamil->n_sites) {
+        assert(hamil->delayed == DelayedOpNames::None);
+        assert(sites.size() == exprs.size() && spins.size() == exprs.size() &&
+               coeffs.size() == exprs.size());
+        assert(n_sites >= 3 && n_sites < 4096);
+        shared_ptr<VectorAllocator<double>> d_alloc =
+            make_shared<VectorAllocator<double>>();
+        const int sz[2] = {1, -1};
+        shared_ptr<OpElement<S>> i_op =
+            make_shared<OpElement<S>>(OpNames::I, SiteIndex(), hamil->vacuum);
+        shared_ptr<OpElement<S>> h_op =
+            make_shared<OpElement<S>>(OpNames::H, SiteIndex(), hamil->vacuum);
+        MPO<S>::op = h_op;
+        MPO<S>::const_e = const_e;
+        MPO<S>::tf = make_shared<TensorFunctions<S>>(hamil->opf);
+        MPO<S>::site_op_infos = hamil->site_op_infos;
+        MPO<S>::basis = hamil->basis;
+        // elementary site operators, order: C alpha, C beta, D alpha, D beta
+        vector<array<shared_ptr<OpElement<S>>, 4>> elem_ops(n_sites);
+        vector<array<shared_ptr<SparseMatrix<S>>, 4>> elem_mats(n_sites);
+        // site operators for on-site strings, index 0 is identity
+        vector<map<vector<uint8_t>, int>> site_op_idx(n_sites);
+        vector<vector<shared_ptr<OpElement<S>>>> site_ops(n_sites);
+        vector<vector<shared_ptr<SparseMatrix<S>>>> site_mats(n_sites);
+        for (uint16_t m = 0; m < n_sites; m++) {
+            unordered_map<shared_ptr<OpExpr<S>>, shared_ptr<SparseMatrix<S>>>
+                ops;
+            for (uint8_t s = 0; s < 2; s++) {
+                elem_ops[m][s] = make_shared<OpElement<S>>(
+                    OpNames::C, SiteIndex({m}, {s}),
+                    S(1, sz[s], hamil->orb_sym[m]));
+                elem_ops[m][s + 2] = make_shared<OpElement<S>>(
+                    OpNames::D, SiteIndex({m}, {s}),
+                    S(-1, -sz[s], S::pg_inv(hamil->orb_sym[m])));
+            }
+            ops[i_op] = nullptr;
+            for (int k = 0; k < 4; k++)
+                ops[elem_ops[m][k]] = nullptr;
+            hamil->get_site_ops(m, ops);
+            for (int k = 0; k < 4; k++)
+                elem_mats[m][k] = ops.at(elem_ops[m][k]);
+            site_op_idx[m][vector<uint8_t>()] = 0;
+            site_ops[m].push_back(i_op);
+            site_mats[m].push_back(ops.at(i_op));
+        }
+        // find index of the site operator for an on-site string
+        // products are built from cached prefixes; -1 means zero operator
+        function<int(uint16_t, const vector<uint8_t> &)> get_site_op =
+            [&](uint16_t m, const vector<uint8_t> &code) -> int {
+            auto it = site_op_idx[m].find(code);
+            if (it != site_op_idx[m].end())
+                return it->second;
+            int r = -1;
+            uint8_t c = code.back();
+            int ip =
+                get_site_op(m, vector<uint8_t>(code.begin(), code.end() - 1));
+            if (ip != -1) {
+                shared_ptr<SparseMatrix<S>> mat = nullptr;
+                S q = site_ops[m][ip]->q_label + elem_ops[m][c]->q_label;
+                if (code.size() == 1)
+                    mat = elem_mats[m][c];
+                else {
+                    shared_ptr<SparseMatrixInfo<S>> info =
+                        hamil->find_site_op_info(m, q);
+                    if (info != nullptr) {
+                        mat = make_shared<SparseMatrix<S>>(d_alloc);
+                        mat->allocate(info);
+                        hamil->opf->product(0, site_mats[m][ip],
+                                            elem_mats[m][c], mat);
+                    }
+                }
+                if (mat != nullptr && mat->factor != 0.0 &&
+                    mat->info->n != 0 && mat->norm() >= TINY) {
+                    r = (int)site_ops[m].size();
+                    assert(r < (1 << 24));
+                    site_ops[m].push_back(
+                        code.size() == 1
+                            ? elem_ops[m][c]
+                            : make_shared<OpElement<S>>(
+                                  OpNames::X,
+                                  SiteIndex({m, (uint16_t)(r & 0xFFF),
+                                             (uint16_t)(r >> 12)},
+                                            {}),
+                                  q));
+                    site_mats[m].push_back(mat);
+                }
+            }
+            site_op_idx[m][code] = r;
+            return r;
+        };
+        // suffix of operator strings: (site, site operator, next suffix)
+        // index 0 is the empty suffix
+        vector<uint16_t> node_site(1, n_sites);
+        vector<int> node_op(1, 0), node_next(1, 0);
+        unordered_map<uint64_t, int> node_idx;
+        // working items: (left operator, right suffix, coefficient)
+        vector<int> item_left, item_right;
+        vector<double> item_coeff;
+        for (size_t it = 0; it < exprs.size(); it++) {
+            const string &expr = exprs[it];
+            assert(sites[it].size() == expr.size() &&
+                   spins[it].size() == expr.size());
+            if (abs(coeffs[it]) < cutoff) {
+                n_dropped_terms++;
+                continue;
+            } else if (expr.length() == 0) {
+                MPO<S>::const_e += coeffs[it];
+                continue;
+            }
+            // reorder operators by site, fermion sign from permutation
+            vector<int> perm(expr.length());
+            for (int i = 0; i < (int)perm.size(); i++)
+                perm[i] = i;
+            stable_sort(perm.begin(), perm.end(), [&sites, it](int i, int j) {
+                return sites[it][i] < sites[it][j];
+            });
+            int n_inv = 0;
+            for (size_t i = 0; i < expr.length(); i++)
+                for (size_t j = i + 1; j < expr.length(); j++)
+                    n_inv += sites[it][i] > sites[it][j];
+            vector<pair<uint16_t, int>> groups;
+            S q = hamil->vacuum;
+            for (size_t i = 0, j; i < perm.size(); i = j) {
+                uint16_t m = sites[it][perm[i]];
+                assert(m < n_sites);
+                vector<uint8_t> code;
+                for (j = i; j < perm.size() && sites[it][perm[j]] == m; j++) {
+                    assert(expr[perm[j]] == 'C' || expr[perm[j]] == 'D');
+                    assert(spins[it][perm[j]] < 2);
+                    code.push_back((uint8_t)((expr[perm[j]] == 'C' ? 0 : 2) +
+                                             spins[it][perm[j]]));
+                }
+                int iop = get_site_op(m, code);
+                if (iop == -1) {
+                    groups.clear();
+                    break;
+                }
+                groups.push_back(make_pair(m, iop));
+                q = q + site_ops[m][iop]->q_label;
+            }
+            if (groups.size() == 0) {
+                n_dropped_terms++;
+                continue;
+            }
+            assert(q == h_op->q_label);
+            int node = 0;
+            for (int ig = (int)groups.size() - 1; ig >= 0; ig--) {
+                assert(groups[ig].second < (1 << 16));
+                uint64_t key = ((uint64_t)node << 32) |
+                               ((uint64_t)groups[ig].first << 16) |
+                               (uint64_t)groups[ig].second;
+                auto p = node_idx.find(key);
+                if (p == node_idx.end()) {
+                    node_idx[key] = (int)node_site.size();
+                    node_site.push_back(groups[ig].first);
+                    node_op.push_back(groups[ig].second);
+                    node_next.push_back(node);
+                    node = (int)node_site.size() - 1;
+                } else
+                    node = p->second;
+            }
+            item_left.push_back(0);
+            item_right.push_back(node);
+            item_coeff.push_back((n_inv & 1) ? -coeffs[it] : coeffs[it]);
+        }
+        assert(item_left.size() != 0);
+        // delta quanta of left operators at current bond
+        vector<S> left_q(1, hamil->vacuum);
+        // site operators at the last site for each right operator
+        vector<shared_ptr<OpExpr<S>>> last_ops;
+        for (uint16_t m = 0; m < n_sites; m++) {
+            // build bipartite graph
+            unordered_map<uint64_t, int> u_idx;
+            unordered_map<int, int> v_idx;
+            vector<pair<int, int>> us;
+            vector<int> vs;
+            unordered_map<uint64_t, int> e_idx;
+            vector<pair<int, int>> edges;
+            vector<double> ews;
+            for (size_t it = 0; it < item_left.size(); it++) {
+                int node = item_right[it], iop = 0;
+                if (node_site[node] == m)
+                    iop = node_op[node], node = node_next[node];
+                uint64_t ukey =
+                    ((uint64_t)item_left[it] << 32) | (uint64_t)iop;
+                auto pu = u_idx.find(ukey);
+                int iu, iv;
+                if (pu == u_idx.end()) {
+                    iu = u_idx[ukey] = (int)us.size();
+                    us.push_back(make_pair(item_left[it], iop));
+                } else
+                    iu = pu->second;
+                auto pv = v_idx.find(node);
+                if (pv == v_idx.end()) {
+                    iv = v_idx[node] = (int)vs.size();
+                    vs.push_back(node);
+                } else
+                    iv = pv->second;
+                uint64_t ekey = ((uint64_t)iu << 32) | (uint64_t)iv;
+                auto pe = e_idx.find(ekey);
+                if (pe == e_idx.end()) {
+                    e_idx[ekey] = (int)edges.size();
+                    edges.push_back(make_pair(iu, iv));
+                    ews.push_back(item_coeff[it]);
+                } else
+                    ews[pe->second] += item_coeff[it];
+            }
+            size_t ie = 0;
+            for (size_t i = 0; i < edges.size(); i++)
+                if (abs(ews[i]) >= cutoff)
+                    edges[ie] = edges[i], ews[ie++] = ews[i];
+                else
+                    n_dropped_terms++;
+            edges.resize(ie), ews.resize(ie);
+            // assign new left operators from vertex cover
+            // at the first and last bond, left and right operators must be
+            // site operators, so all left or right vertices are taken
+            vector<int> u_new(us.size(), -1), v_new(vs.size(), -1);
+            int n_new = 0;
+            if (m == n_sites - 1) {
+                assert(vs.size() <= 1 && (vs.size() == 0 || vs[0] == 0));
+                if (vs.size() != 0)
+                    v_new[0] = n_new++;
+            } else if (m == 0) {
+                for (size_t iu = 0; iu < us.size(); iu++)
+                    u_new[iu] = n_new++;
+            } else if (m == n_sites - 2) {
+                for (size_t iv = 0; iv < vs.size(); iv++)
+                    v_new[iv] = n_new++;
+            } else {
+                HopcroftKarp hk(edges, (int)us.size(), (int)vs.size());
+                hk.solve();
+                pair<vector<char>, vector<char>> cover = hk.min_vertex_cover();
+                for (size_t iu = 0; iu < us.size(); iu++)
+                    if (cover.first[iu])
+                        u_new[iu] = n_new++;
+                for (size_t iv = 0; iv < vs.size(); iv++)
+                    if (cover.second[iv])
+                        v_new[iv] = n_new++;
+            }
+            assert(n_new != 0);
+            vector<S> new_q(n_new);
+            map<pair<int, int>, map<int, double>> mat_terms;
+            item_left.clear(), item_right.clear(), item_coeff.clear();
+            vector<char> v_done(vs.size(), 0);
+            for (size_t iu = 0; iu < us.size(); iu++)
+                if (u_new[iu] != -1) {
+                    mat_terms[make_pair(us[iu].first, u_new[iu])]
+                             [us[iu].second] += 1.0;
+                    new_q[u_new[iu]] = left_q[us[iu].first] +
+                                       site_ops[m][us[iu].second]->q_label;
+                }
+            for (size_t i = 0; i < edges.size(); i++) {
+                int iu = edges[i].first, iv = edges[i].second;
+                if (u_new[iu] != -1) {
+                    item_left.push_back(u_new[iu]);
+                    item_right.push_back(vs[iv]);
+                    item_coeff.push_back(ews[i]);
+                } else {
+                    assert(v_new[iv] != -1);
+                    mat_terms[make_pair(us[iu].first, v_new[iv])]
+                             [us[iu].second] += ews[i];
+                    if (!v_done[iv]) {
+                        v_done[iv] = 1;
+                        new_q[v_new[iv]] = left_q[us[iu].first] +
+                                           site_ops[m][us[iu].second]->q_label;
+                        item_left.push_back(v_new[iv]);
+                        item_right.push_back(vs[iv]);
+                        item_coeff.push_back(1.0);
+                    }
+                }
+            }
+            // site tensor
+            shared_ptr<Symbolic<S>> pmat;
+            if (m == 0)
+                pmat = make_shared<SymbolicRowVector<S>>(n_new);
+            else if (m == n_sites - 1)
+                pmat = make_shared<SymbolicColumnVector<S>>((int)left_q.size());
+            else
+                pmat =
+                    make_shared<SymbolicMatrix<S>>((int)left_q.size(), n_new);
+            shared_ptr<OperatorTensor<S>> opt =
+                make_shared<OperatorTensor<S>>();
+            opt->ops[i_op] = site_mats[m][0];
+            for (auto &mt : mat_terms) {
+                shared_ptr<OpExpr<S>> x = nullptr;
+                for (auto &r : mt.second) {
+                    if (abs(r.second) < TINY)
+                        continue;
+                    shared_ptr<OpExpr<S>> xop = site_ops[m][r.first];
+                    opt->ops[xop] = site_mats[m][r.first];
+                    if (r.second != 1.0)
+                        xop = r.second * xop;
+                    x = x == nullptr ? xop : x + xop;
+                }
+                if (x != nullptr)
+                    (*pmat)[{mt.first.first, mt.first.second}] = x;
+            }
+            opt->lmat = opt->rmat = pmat;
+            // operator names
+            shared_ptr<SymbolicRowVector<S>> plop =
+                make_shared<SymbolicRowVector<S>>(n_new);
+            if (m == 0) {
+                for (size_t iu = 0; iu < us.size(); iu++)
+                    (*plop)[u_new[iu]] = site_ops[m][us[iu].second];
+            } else if (m == n_sites - 1)
+                (*plop)[0] = h_op;
+            else
+                for (int ib = 0; ib < n_new; ib++)
+                    (*plop)[ib] = make_shared<OpElement<S>>(
+                        OpNames::XL,
+                        SiteIndex(
+                            {m, (uint16_t)(ib & 0xFFF), (uint16_t)(ib >> 12)},
+                            {}),
+                        new_q[ib]);
+            this->left_operator_names.push_back(plop);
+            shared_ptr<SymbolicColumnVector<S>> prop =
+                make_shared<SymbolicColumnVector<S>>((int)left_q.size());
+            for (int ia = 0; ia < (int)left_q.size(); ia++)
+                (*prop)[ia] =
+                    m == 0 ? h_op
+                           : (m == n_sites - 1
+                                  ? last_ops[ia]
+                                  : make_shared<OpElement<S>>(
+                                        OpNames::XR,
+                                        SiteIndex({(uint16_t)(m - 1),
+                                                   (uint16_t)(ia & 0xFFF),
+                                                   (uint16_t)(ia >> 12)},
+                                                  {}),
+                                        h_op->q_label - left_q[ia]));
+            if (m == n_sites - 2) {
+                last_ops.resize(n_new);
+                for (size_t iv = 0; iv < vs.size(); iv++)
+                    last_ops[v_new[iv]] =
+                        vs[iv] == 0 ? i_op : site_ops[m + 1][node_op[vs[iv]]];
+            }
+            this->right_operator_names.push_back(prop);
+            this->tensors.push_back(opt);
+            left_q = new_q;
+        }
+    }
+};
+
+} // namespace block2
@@ -100,6 +100,15 @@ template <typename S> struct MovingEnvironment {
     Timer _t, _t2;
     bool iprint = false;
     bool save_partition_info = false;
+    // Whether partitions left on disk by a previous run should be reused in
+    // init_environments when their signatures (from MPS tensors and MPO)
+    // still match. Signatures are also written for new partitions
+    bool reuse_environments = false;
+    // Signatures of left/right blocks (only when reuse_environments)
+    vector<size_t> left_signatures, right_signatures;
+    // Renormalized operators with norm below this value are dropped after
+    // rotation (zero = no screening)
+    double screening_cutoff = 0.0;
     OpNamesSet delayed_contraction = OpNamesSet();
     int fuse_center;
     MovingEnvironment(const shared_ptr<MPO<S>> &mpo,
@@ -131,6 +140,17 @@ template <typename S> struct MovingEnvironment {
     // Contract and renormalize left block by one site
     // new site = i - 1
     void left_contract_rotate(int i, bool preserve_data = false) {
+        MemoryTagScope mts(frame, "left_env");
+        if (reuse_environments && frame->partition_can_write) {
+            Parsing::remove_file(get_left_partition_signature_filename(i));
+            // partitions linked from another environment must not be
+            // overwritten
+            for (bool info : {false, true})
+                if (Parsing::link_exists(
+                        get_left_partition_filename(i, info)))
+                    Parsing::remove_file(
+                        get_left_partition_filename(i, info));
+        }
         mpo->load_left_operators(i - 1);
         mpo->load_tensor(i - 1);
         vector<pair<S, shared_ptr<SparseMatrixInfo<S>>>> left_op_infos_notrunc;
@@ -223,6 +243,7 @@ template <typename S> struct MovingEnvironment {
             mpo->unload_left_operators(i);
         }
         tint += _t.get_time();
+        screen_operators(envs[i]->left);
         frame->activate(0);
         if (bra != ket)
             ket->unload_tensor(i - 1);
@@ -231,15 +252,31 @@ template <typename S> struct MovingEnvironment {
             new_left->deallocate();
         Partition<S>::deallocate_op_infos_notrunc(left_op_infos_notrunc);
         frame->save_data(1, get_left_partition_filename(i));
-        if (save_partition_info) {
+        if (save_partition_info || reuse_environments) {
             frame->activate(1);
             envs[i]->save_data(true, get_left_partition_filename(i, true));
             frame->activate(0);
         }
+        if (reuse_environments) {
+            left_signatures[i] = combine_signature(left_signatures[i - 1],
+                                                   get_site_signature(i - 1));
+            save_partition_signature(true, i);
+        }
     }
     // Contract and renormalize right block by one site
     // new site = i + dot
     void right_contract_rotate(int i, bool preserve_data = false) {
+        MemoryTagScope mts(frame, "right_env");
+        if (reuse_environments && frame->partition_can_write) {
+            Parsing::remove_file(get_right_partition_signature_filename(i));
+            // partitions linked from another environment must not be
+            // overwritten
+            for (bool info : {false, true})
+                if (Parsing::link_exists(
+                        get_right_partition_filename(i, info)))
+                    Parsing::remove_file(
+                        get_right_partition_filename(i, info));
+        }
         mpo->load_right_operators(i + dot);
         mpo->load_tensor(i + dot);
         vector<pair<S, shared_ptr<SparseMatrixInfo<S>>>> right_op_infos_notrunc;
@@ -340,6 +377,7 @@ template <typename S> struct MovingEnvironment {
             mpo->unload_right_operators(i + dot - 1);
         }
         tint += _t.get_time();
+        screen_operators(envs[i]->right);
         frame->activate(0);
         if (bra != ket)
             ket->unload_tensor(i + dot);
@@ -348,11 +386,16 @@ template <typename S> struct MovingEnvironment {
             new_right->deallocate();
         Partition<S>::deallocate_op_infos_notrunc(right_op_infos_notrunc);
         frame->save_data(1, get_right_partition_filename(i));
-        if (save_partition_info) {
+        if (save_partition_info || reuse_environments) {
             frame->activate(1);
             envs[i]->save_data(false, get_right_partition_filename(i, true));
             frame->activate(0);
         }
+        if (reuse_environments) {
+            right_signatures[i] = combine_signature(
+                right_signatures[i + 1], get_site_signature(i + dot));
+            save_partition_signature(false, i);
+        }
     }
     void left_contract_rotate_unordered(
         int i, const shared_ptr<ParallelRule<S>> &rule = nullptr) {
@@ -538,6 +581,219 @@ template <typename S> struct MovingEnvironment {
            << Parsing::to_string(i);
         return ss.str();
     }
+    // Drop renormalized operators with norm below screening_cutoff.
+    // As for zero complementary operators in the parallel case, a dropped
+    // operator keeps its symbol but has zero factor and no data, so that it
+    // is skipped in contractions. The remaining operators are compacted in
+    // the stack, so that dropped operators are not written to disk
+    void screen_operators(const shared_ptr<OperatorTensor<S>> &opt) const {
+        if (screening_cutoff == 0.0 || opt == nullptr)
+            return;
+        vector<shared_ptr<SparseMatrix<S>>> mats;
+        vector<uint8_t> dropped;
+        mats.reserve(opt->ops.size());
+        for (auto &p : opt->ops)
+            if (p.second->get_type() == SparseMatrixTypes::Normal &&
+                p.second->data != nullptr && p.second->total_memory != 0 &&
+                p.second->alloc == dalloc && p.second->data >= dalloc->data &&
+                p.second->data < dalloc->data + dalloc->used)
+                mats.push_back(p.second);
+        sort(mats.begin(), mats.end(),
+             [](const shared_ptr<SparseMatrix<S>> &a,
+                const shared_ptr<SparseMatrix<S>> &b) {
+                 return a->data < b->data;
+             });
+        mats.resize(unique(mats.begin(), mats.end()) - mats.begin());
+        // symbols sharing data through different matrices are not expected
+        for (size_t k = 1; k < mats.size(); k++)
+            if (mats[k]->data == mats[k - 1]->data)
+                return;
+        dropped.resize(mats.size(), 0);
+        for (auto &p : opt->ops) {
+            shared_ptr<OpElement<S>> op =
+                dynamic_pointer_cast<OpElement<S>>(p.first);
+            auto it = lower_bound(mats.begin(), mats.end(), p.second,
+                                  [](const shared_ptr<SparseMatrix<S>> &a,
+                                     const shared_ptr<SparseMatrix<S>> &b) {
+                                      return a->data < b->data;
+                                  });
+            if (it == mats.end() || *it != p.second)
+                continue;
+            // identity is used to decide whether the site should be optimized
+            if (op != nullptr && op->name != OpNames::I &&
+                abs(p.second->factor) * p.second->norm() < screening_cutoff)
+                dropped[it - mats.begin()] |= 1;
+            else
+                dropped[it - mats.begin()] |= 2;
+        }
+        // compaction is only possible when the operators fill the top of the
+        // stack without gaps
+        bool contiguous = mats.size() != 0;
+        size_t offset = contiguous ? mats[0]->data - dalloc->data : 0;
+        for (size_t k = 0; k < mats.size() && contiguous; k++)
+            if (mats[k]->data != dalloc->data + offset)
+                contiguous = false;
+            else
+                offset += dalloc->aligned_size(mats[k]->total_memory);
+        contiguous = contiguous && offset == dalloc->used;
+        for (size_t k = 0; k < mats.size(); k++) {
+            const bool drop = dropped[k] == 1;
+            if (drop)
+                mats[k]->factor = 0.0;
+            if (contiguous)
+                mats[k]->reallocate(drop ? 0 : mats[k]->total_memory);
+        }
+    }
+    string get_left_partition_signature_filename(int i) const {
+        stringstream ss;
+        ss << frame->save_dir << "/" << frame->prefix_distri << ".PART.SIG."
+           << tag << ".LEFT." << Parsing::to_string(i);
+        return ss.str();
+    }
+    string get_right_partition_signature_filename(int i) const {
+        stringstream ss;
+        ss << frame->save_dir << "/" << frame->prefix_distri << ".PART.SIG."
+           << tag << ".RIGHT." << Parsing::to_string(i);
+        return ss.str();
+    }
+    static size_t combine_signature(size_t h, size_t x) {
+        return h ^ (x + 0x9E3779B9 + (h << 6) + (h >> 2));
+    }
+    static size_t get_expr_signature(const shared_ptr<OpExpr<S>> &x) {
+        if (x->get_type() == OpTypes::Zero || x->get_type() == OpTypes::Elem ||
+            x->get_type() == OpTypes::Prod)
+            return hash_value(x);
+        else if (x->get_type() == OpTypes::Sum) {
+            size_t h = 0;
+            for (auto &r : dynamic_pointer_cast<OpSum<S>>(x)->strings)
+                h = combine_signature(h, r->hash());
+            return h;
+        } else
+            return (size_t)x->get_type();
+    }
+    static size_t get_symbolic_signature(const shared_ptr<Symbolic<S>> &mat) {
+        if (mat == nullptr)
+            return 0;
+        size_t h = combine_signature((size_t)mat->m, (size_t)mat->n);
+        for (auto &x : mat->data)
+            h = combine_signature(h, get_expr_signature(x));
+        return h;
+    }
+    static size_t get_matrix_signature(const shared_ptr<SparseMatrix<S>> &mat) {
+        if (mat == nullptr)
+            return 0;
+        size_t h = combine_signature(mat->total_memory,
+                                     std::hash<double>{}(mat->factor));
+        if (mat->info != nullptr)
+            for (int i = 0; i < mat->info->n; i++)
+                h = combine_signature(h, mat->info->quanta[i].hash());
+        if (mat->get_type() == SparseMatrixTypes::Normal &&
+            mat->data != nullptr)
+            for (size_t k = 0; k < mat->total_memory; k++)
+                h = combine_signature(h, std::hash<double>{}(mat->data[k]));
+        return h;
+    }
+    // Signature of all MPO tensors and operator names
+    size_t get_mpo_signature() const {
+        size_t h = combine_signature((size_t)n_sites, (size_t)dot);
+        for (int i = 0; i < n_sites; i++) {
+            mpo->load_tensor(i);
+            h = combine_signature(h,
+                                  get_symbolic_signature(mpo->tensors[i]->lmat));
+            h = combine_signature(h,
+                                  get_symbolic_signature(mpo->tensors[i]->rmat));
+            // order of ops is not deterministic
+            size_t hops = 0;
+            for (auto &p : mpo->tensors[i]->ops)
+                hops += combine_signature(get_expr_signature(p.first),
+                                          get_matrix_signature(p.second));
+            h = combine_signature(h, hops);
+            mpo->unload_tensor(i);
+            if (i < (int)mpo->left_operator_names.size()) {
+                mpo->load_left_operators(i);
+                h = combine_signature(
+                    h, get_symbolic_signature(mpo->left_operator_names[i]));
+                mpo->unload_left_operators(i);
+            }
+            if (i < (int)mpo->right_operator_names.size()) {
+                mpo->load_right_operators(i);
+                h = combine_signature(
+                    h, get_symbolic_signature(mpo->right_operator_names[i]));
+                mpo->unload_right_operators(i);
+            }
+        }
+        if (mpo->schemer != nullptr) {
+            h = combine_signature(h, (size_t)mpo->schemer->left_trans_site);
+            h = combine_signature(h, (size_t)mpo->schemer->right_trans_site);
+        }
+        return h;
+    }
+    // Signature of bra and ket tensors at site i
+    size_t get_site_signature(int i) const {
+        bra->load_tensor(i);
+        if (bra != ket)
+            ket->load_tensor(i);
+        size_t h = combine_signature(get_matrix_signature(bra->tensors[i]),
+                                     get_matrix_signature(ket->tensors[i]));
+        if (bra != ket)
+            ket->unload_tensor(i);
+        bra->unload_tensor(i);
+        return h;
+    }
+    void save_partition_signature(bool left, int i) const {
+        if (!frame->partition_can_write)
+            return;
+        const string filename = left
+                                    ? get_left_partition_signature_filename(i)
+                                    : get_right_partition_signature_filename(i);
+        const size_t sig = left ? left_signatures[i] : right_signatures[i];
+        ofstream ofs(filename.c_str(), ios::binary);
+        if (!ofs.good())
+            throw runtime_error("MovingEnvironment:save_partition_signature "
+                                "on '" +
+                                filename + "' failed.");
+        ofs.write((char *)&sig, sizeof(sig));
+        ofs.close();
+    }
+    // Whether the partition on disk was generated from the same MPS/MPO
+    bool check_partition_signature(bool left, int i) const {
+        const string filename = left
+                                    ? get_left_partition_signature_filename(i)
+                                    : get_right_partition_signature_filename(i);
+        if (!Parsing::file_exists(filename) ||
+            !Parsing::file_exists(left ? get_left_partition_filename(i)
+                                       : get_right_partition_filename(i)) ||
+            !Parsing::file_exists(left ? get_left_partition_filename(i, true)
+                                       : get_right_partition_filename(i, true)))
+            return false;
+        size_t sig = 0;
+        ifstream ifs(filename.c_str(), ios::binary);
+        ifs.read((char *)&sig, sizeof(sig));
+        if (ifs.fail() || ifs.bad())
+            return false;
+        ifs.close();
+        return sig == (left ? left_signatures[i] : right_signatures[i]);
+    }
+    // Start reading partitions that will be loaded in the next move_to
+    // and eff_ham in background, so that disk reading can overlap with
+    // the eigenvalue solver (only when frame->prefetch_buffering)
+    void prefetch_environments(bool forward) const {
+        if (!frame->prefetch_buffering)
+            return;
+        if (forward) {
+            if (envs[center]->left != nullptr && center != 0)
+                frame->prefetch_data(1, get_left_partition_filename(center));
+            if (center + 1 < n_sites && envs[center + 1]->right != nullptr)
+                frame->prefetch_data(1,
+                                     get_right_partition_filename(center + 1));
+        } else {
+            if (envs[center]->right != nullptr)
+                frame->prefetch_data(1, get_right_partition_filename(center));
+            if (center - 1 > 0 && envs[center - 1]->left != nullptr)
+                frame->prefetch_data(1,
+                                     get_left_partition_filename(center - 1));
+        }
+    }
     void shallow_copy_to(const shared_ptr<MovingEnvironment<S>> &me) const {
         for (int i = 0; i < n_sites; i++) {
             me->envs[i] = make_shared<Partition<S>>(*envs[i]);
@@ -559,32 +815,53 @@ template <typename S> struct MovingEnvironment {
         shallow_copy_to(me);
         return me;
     }
+    // Multi-center MPSs moved together in unordered sweeps
+    // (the ket, and the bra if it is a different MPS)
+    vector<shared_ptr<ParallelMPS<S>>> get_para_mpss() const {
+        vector<shared_ptr<ParallelMPS<S>>> r;
+        if (!(ket->get_type() & MPSTypes::MultiCenter))
+            return r;
+        r.push_back(dynamic_pointer_cast<ParallelMPS<S>>(ket));
+        if (bra != ket) {
+            if (!(bra->get_type() & MPSTypes::MultiCenter))
+                throw runtime_error("MovingEnvironment: bra and ket must both "
+                                    "be multi-center MPS.");
+            r.push_back(dynamic_pointer_cast<ParallelMPS<S>>(bra));
+            if (r[1]->conn_centers != r[0]->conn_centers)
+                throw runtime_error("MovingEnvironment: bra and ket must have "
+                                    "the same connection centers.");
+        }
+        return r;
+    }
     virtual void finalize_environments(bool renormalize_ops = true) {
         if (!(ket->get_type() & MPSTypes::MultiCenter))
             return;
-        shared_ptr<ParallelMPS<S>> para_mps =
-            dynamic_pointer_cast<ParallelMPS<S>>(ket);
+        vector<shared_ptr<ParallelMPS<S>>> para_mpss = get_para_mpss();
+        shared_ptr<ParallelMPS<S>> para_mps = para_mpss[0];
         shared_ptr<CG<S>> cg = mpo->tf->opf->cg;
         assert(para_mps->conn_matrices.size() != 0);
         para_mps->enable_parallel_writing();
         if (para_mps->rule != nullptr)
             para_mps->rule->comm->barrier();
-        if (para_mps->canonical_form[para_mps->n_sites - 1] == 'C')
-            para_mps->canonical_form[para_mps->n_sites - 1] = 'S';
-        else if (para_mps->canonical_form[para_mps->n_sites - 1] == 'K') {
-            if (para_mps->rule == nullptr ||
-                para_mps->rule->comm->group ==
-                    para_mps->ncenter % para_mps->rule->comm->ngroup)
-                para_mps->flip_fused_form(para_mps->n_sites - 1, cg, para_rule);
-            para_mps->canonical_form[para_mps->n_sites - 1] = 'S';
-        }
-        if (para_mps->canonical_form[0] == 'C')
-            para_mps->canonical_form[0] = 'K';
-        else if (para_mps->canonical_form[0] == 'S') {
-            if (para_mps->rule == nullptr ||
-                para_mps->rule->comm->group == 0 % para_mps->rule->comm->ngroup)
-                para_mps->flip_fused_form(0, cg, para_rule);
-            para_mps->canonical_form[0] = 'K';
+        for (auto &xmps : para_mpss) {
+            if (xmps->canonical_form[xmps->n_sites - 1] == 'C')
+                xmps->canonical_form[xmps->n_sites - 1] = 'S';
+            else if (xmps->canonical_form[xmps->n_sites - 1] == 'K') {
+                if (para_mps->rule == nullptr ||
+                    para_mps->rule->comm->group ==
+                        para_mps->ncenter % para_mps->rule->comm->ngroup)
+                    xmps->flip_fused_form(xmps->n_sites - 1, cg, para_rule);
+                xmps->canonical_form[xmps->n_sites - 1] = 'S';
+            }
+            if (xmps->canonical_form[0] == 'C')
+                xmps->canonical_form[0] = 'K';
+            else if (xmps->canonical_form[0] == 'S') {
+                if (para_mps->rule == nullptr ||
+                    para_mps->rule->comm->group ==
+                        0 % para_mps->rule->comm->ngroup)
+                    xmps->flip_fused_form(0, cg, para_rule);
+                xmps->canonical_form[0] = 'K';
+            }
         }
         vector<int> conn_idxs(para_mps->ncenter);
         for (int i = 0; i < para_mps->ncenter; i++)
@@ -602,17 +879,21 @@ template <typename S> struct MovingEnvironment {
                 if (para_mps->rule == nullptr ||
                     para_mps->rule->comm->group ==
                         0 % para_mps->rule->comm->ngroup) {
-                    para_mps->center = 0;
+                    for (auto &xmps : para_mpss)
+                        xmps->center = 0;
                     while (para_mps->center != para_mps->conn_centers[ip] - 1) {
-                        para_mps->move_right(cg, para_rule);
+                        for (auto &xmps : para_mpss)
+                            xmps->move_right(cg, para_rule);
                         check_signal_()();
                         if (renormalize_ops)
                             left_contract_rotate_unordered(para_mps->center);
                     }
                 }
-                for (int i = 0; i < para_mps->conn_centers[ip] - 1; i++)
-                    para_mps->canonical_form[i] = 'L';
-                para_mps->canonical_form[para_mps->conn_centers[ip] - 1] = 'S';
+                for (auto &xmps : para_mpss) {
+                    for (int i = 0; i < xmps->conn_centers[ip] - 1; i++)
+                        xmps->canonical_form[i] = 'L';
+                    xmps->canonical_form[xmps->conn_centers[ip] - 1] = 'S';
+                }
             }
             for (int ipx = 0; ipx < (int)conn_idxs.size(); ipx++) {
                 int ip = conn_idxs[ipx];
@@ -632,29 +913,34 @@ template <typename S> struct MovingEnvironment {
                         para_mps->rule->comm->group ==
                             (ip + 1) % para_mps->rule->comm->ngroup) {
                         center = para_mps->conn_centers[ip] - 1;
-                        if (para_mps->canonical_form[center] == 'C' &&
-                            para_mps->canonical_form[center + 1] == 'C')
-                            para_mps->canonical_form[center] = 'K',
-                            para_mps->canonical_form[center + 1] = 'S';
-                        else if (para_mps->canonical_form[center] == 'S' &&
-                                 para_mps->canonical_form[center + 1] == 'K') {
-                            para_mps->flip_fused_form(center, cg, para_rule);
-                            para_mps->flip_fused_form(center + 1, cg,
+                        for (auto &xmps : para_mpss) {
+                            if (xmps->canonical_form[center] == 'C' &&
+                                xmps->canonical_form[center + 1] == 'C')
+                                xmps->canonical_form[center] = 'K',
+                                xmps->canonical_form[center + 1] = 'S';
+                            else if (xmps->canonical_form[center] == 'S' &&
+                                     xmps->canonical_form[center + 1] == 'K') {
+                                xmps->flip_fused_form(center, cg, para_rule);
+                                xmps->flip_fused_form(center + 1, cg,
                                                       para_rule);
+                            }
+                            assert(xmps->canonical_form[center] == 'K' &&
+                                   xmps->canonical_form[center + 1] == 'S');
+                            xmps->para_merge(ip, para_rule); // LS
+                            xmps->center = xmps->conn_centers[ip];
                         }
-                        assert(para_mps->canonical_form[center] == 'K' &&
-                               para_mps->canonical_form[center + 1] == 'S');
-                        para_mps->para_merge(ip, para_rule); // LS
-                        para_mps->center = para_mps->conn_centers[ip];
                         if (l_form) {
-                            para_mps->move_left(cg, para_rule);
-                            para_mps->move_right(cg, para_rule);
+                            for (auto &xmps : para_mpss) {
+                                xmps->move_left(cg, para_rule);
+                                xmps->move_right(cg, para_rule);
+                            }
                             check_signal_()();
                             if (renormalize_ops)
                                 left_contract_rotate_unordered(
                                     para_mps->center);
                             while (para_mps->center != pj) {
-                                para_mps->move_right(cg, para_rule);
+                                for (auto &xmps : para_mpss)
+                                    xmps->move_right(cg, para_rule);
                                 check_signal_()();
                                 if (renormalize_ops)
                                     left_contract_rotate_unordered(
@@ -662,19 +948,22 @@ template <typename S> struct MovingEnvironment {
                             }
                         } else
                             while (para_mps->center != pi) {
-                                para_mps->move_left(cg, para_rule);
+                                for (auto &xmps : para_mpss)
+                                    xmps->move_left(cg, para_rule);
                                 check_signal_()();
                                 if (renormalize_ops)
                                     right_contract_rotate_unordered(
                                         para_mps->center - para_mps->dot + 1);
                             }
                     }
-                    for (int i = pi; i <= pj; i++)
-                        para_mps->canonical_form[i] = l_form ? 'L' : 'R';
-                    if (l_form)
-                        para_mps->canonical_form[pj] = 'S';
-                    else
-                        para_mps->canonical_form[pi] = 'K';
+                    for (auto &xmps : para_mpss) {
+                        for (int i = pi; i <= pj; i++)
+                            xmps->canonical_form[i] = l_form ? 'L' : 'R';
+                        if (l_form)
+                            xmps->canonical_form[pj] = 'S';
+                        else
+                            xmps->canonical_form[pi] = 'K';
+                    }
                 } else
                     new_conn_idxs.push_back(ip);
             }
@@ -684,31 +973,38 @@ template <typename S> struct MovingEnvironment {
                 if (para_mps->rule == nullptr ||
                     para_mps->rule->comm->group ==
                         para_mps->ncenter % para_mps->rule->comm->ngroup) {
-                    para_mps->center = para_mps->n_sites - 1;
+                    for (auto &xmps : para_mpss)
+                        xmps->center = xmps->n_sites - 1;
                     while (para_mps->center != para_mps->conn_centers[ip]) {
-                        para_mps->move_left(cg, para_rule);
+                        for (auto &xmps : para_mpss)
+                            xmps->move_left(cg, para_rule);
                         check_signal_()();
                         if (renormalize_ops)
                             right_contract_rotate_unordered(para_mps->center -
                                                             para_mps->dot + 1);
                     }
                 }
-                for (int i = para_mps->conn_centers[ip] + 1; i < n_sites; i++)
-                    para_mps->canonical_form[i] = 'R';
-                para_mps->canonical_form[para_mps->conn_centers[ip]] = 'K';
+                for (auto &xmps : para_mpss) {
+                    for (int i = xmps->conn_centers[ip] + 1; i < n_sites; i++)
+                        xmps->canonical_form[i] = 'R';
+                    xmps->canonical_form[xmps->conn_centers[ip]] = 'K';
+                }
             }
             conn_idxs = new_conn_idxs;
         }
-        para_mps->conn_matrices.clear();
-        para_mps->conn_centers.clear();
-        para_mps->ncenter = 0;
-        // for two-site
-        para_mps->center = para_mps->n_sites - 2;
+        for (auto &xmps : para_mpss) {
+            xmps->conn_matrices.clear();
+            xmps->conn_centers.clear();
+            xmps->ncenter = 0;
+            // for two-site
+            xmps->center = xmps->n_sites - 2;
+        }
         center = para_mps->center;
         if (para_mps->rule != nullptr)
             para_mps->rule->comm->barrier();
         if (para_mps->rule == nullptr || para_mps->rule->comm->group == 0)
-            para_mps->save_data();
+            for (auto &xmps : para_mpss)
+                xmps->save_data();
         if (renormalize_ops) {
             frame->activate(1);
             for (int i = 0; i < n_sites; i++) {
@@ -727,8 +1023,8 @@ template <typename S> struct MovingEnvironment {
         bool init = false) {
         assert(pj >= pi + 2 && pi % 2 == 0);
         assert(ket->get_type() & MPSTypes::MultiCenter);
-        shared_ptr<ParallelMPS<S>> para_mps =
-            dynamic_pointer_cast<ParallelMPS<S>>(ket);
+        vector<shared_ptr<ParallelMPS<S>>> para_mpss = get_para_mpss();
+        shared_ptr<ParallelMPS<S>> para_mps = para_mpss[0];
         shared_ptr<CG<S>> cg = mpo->tf->opf->cg;
         int pm = (pi + pj) / 2;
         if (pm % 2 != 0 && !(pj == pi + 2))
@@ -740,7 +1036,8 @@ template <typename S> struct MovingEnvironment {
                 para_mps->rule->comm->group ==
                     pi % para_mps->rule->comm->ngroup) {
                 while (para_mps->center != para_mps->conn_centers[pm - 1]) {
-                    para_mps->move_right(cg, para_rule);
+                    for (auto &xmps : para_mpss)
+                        xmps->move_right(cg, para_rule);
                     check_signal_()();
                     if (iprint)
                         cout << "init .. L = " << para_mps->center << endl;
@@ -776,7 +1073,8 @@ template <typename S> struct MovingEnvironment {
                 para_mps->rule->comm->group ==
                     pm % para_mps->rule->comm->ngroup) {
                 while (para_mps->center != para_mps->conn_centers[pm - 1]) {
-                    para_mps->move_left(cg, para_rule);
+                    for (auto &xmps : para_mpss)
+                        xmps->move_left(cg, para_rule);
                     check_signal_()();
                     if (iprint)
                         cout << "init .. R = "
@@ -784,29 +1082,34 @@ template <typename S> struct MovingEnvironment {
                     right_contract_rotate_unordered(para_mps->center -
                                                     para_mps->dot + 1);
                 }
-                para_mps->flip_fused_form(para_mps->center, cg, para_rule);
-            }
-        }
-        for (int i = (pi == 0 ? 0 : para_mps->conn_centers[pi - 1]);
-             i < (pj == para_mps->ncenter + 1 ? n_sites
-                                              : para_mps->conn_centers[pj - 1]);
-             i++) {
-            if (para_mps->tensors[i] == nullptr)
-                para_mps->tensors[i] = make_shared<SparseMatrix<S>>();
-            if (i == para_mps->conn_centers[pm - 1])
-                para_mps->canonical_form[i] = 'S';
-            else if (i < para_mps->conn_centers[pm - 1])
-                para_mps->canonical_form[i] = 'L';
-            else
-                para_mps->canonical_form[i] = 'R';
+                for (auto &xmps : para_mpss)
+                    xmps->flip_fused_form(xmps->center, cg, para_rule);
+            }
         }
+        for (auto &xmps : para_mpss)
+            for (int i = (pi == 0 ? 0 : xmps->conn_centers[pi - 1]);
+                 i < (pj == xmps->ncenter + 1 ? n_sites
+                                              : xmps->conn_centers[pj - 1]);
+                 i++) {
+                if (xmps->tensors[i] == nullptr)
+                    xmps->tensors[i] = make_shared<SparseMatrix<S>>();
+                if (i == xmps->conn_centers[pm - 1])
+                    xmps->canonical_form[i] = 'S';
+                else if (i < xmps->conn_centers[pm - 1])
+                    xmps->canonical_form[i] = 'L';
+                else
+                    xmps->canonical_form[i] = 'R';
+            }
         if (pcomm != nullptr)
             pcomm->barrier();
         // LLSR -> LKSR
         if (para_mps->rule == nullptr ||
             para_mps->rule->comm->group == pi % para_mps->rule->comm->ngroup) {
-            para_mps->center = para_mps->conn_centers[pm - 1];
-            auto rmat = para_mps->para_split(pm - 1, para_rule);
+            vector<shared_ptr<SparseMatrix<S>>> rmats;
+            for (auto &xmps : para_mpss) {
+                xmps->center = xmps->conn_centers[pm - 1];
+                rmats.push_back(xmps->para_split(pm - 1, para_rule));
+            }
             check_signal_()();
             if (iprint)
                 cout << "init .. R = " << para_mps->center - para_mps->dot
@@ -814,14 +1117,16 @@ template <typename S> struct MovingEnvironment {
             right_contract_rotate_unordered(para_mps->center - para_mps->dot);
             if (para_rule != nullptr)
                 para_rule->comm->barrier();
-            if (para_rule == nullptr || para_rule->is_root()) {
-                para_mps->tensors[para_mps->center] = rmat;
-                para_mps->save_tensor(para_mps->center);
-            }
+            if (para_rule == nullptr || para_rule->is_root())
+                for (size_t k = 0; k < para_mpss.size(); k++) {
+                    para_mpss[k]->tensors[para_mps->center] = rmats[k];
+                    para_mpss[k]->save_tensor(para_mps->center);
+                }
             if (para_rule != nullptr)
                 para_rule->comm->barrier();
         }
-        para_mps->canonical_form[para_mps->conn_centers[pm - 1] - 1] = 'K';
+        for (auto &xmps : para_mpss)
+            xmps->canonical_form[xmps->conn_centers[pm - 1] - 1] = 'K';
         shared_ptr<ParallelCommunicator<S>> lpcomm = nullptr, rpcomm = nullptr;
         if (pcomm != nullptr) {
             if (pj - pi > para_mps->rule->comm->ngroup)
@@ -839,14 +1144,17 @@ template <typename S> struct MovingEnvironment {
             }
         }
         if (pm > pi + 1) {
-            para_mps->center = para_mps->conn_centers[pm - 1] - 1;
+            for (auto &xmps : para_mpss)
+                xmps->center = xmps->conn_centers[pm - 1] - 1;
             init_parallel_environments(pi, pm, lpcomm);
         }
         if (pj > pm + 1) {
-            para_mps->center = para_mps->conn_centers[pm - 1];
+            for (auto &xmps : para_mpss)
+                xmps->center = xmps->conn_centers[pm - 1];
             init_parallel_environments(pm, pj, rpcomm);
         } else if (pm % 2 == 0) {
-            para_mps->center = para_mps->conn_centers[pm - 1];
+            for (auto &xmps : para_mpss)
+                xmps->center = xmps->conn_centers[pm - 1];
             int j = pj == para_mps->ncenter + 1
                         ? n_sites - 1
                         : para_mps->conn_centers[pj - 1] - 1;
@@ -855,21 +1163,23 @@ template <typename S> struct MovingEnvironment {
                 para_mps->rule->comm->group ==
                     pm % para_mps->rule->comm->ngroup) {
                 while (para_mps->center != j) {
-                    para_mps->move_right(cg, para_rule);
+                    for (auto &xmps : para_mpss)
+                        xmps->move_right(cg, para_rule);
                     check_signal_()();
                     if (iprint)
                         cout << "init .. L = " << para_mps->center << endl;
                     left_contract_rotate_unordered(para_mps->center);
                 }
             }
-            for (int i = para_mps->conn_centers[pm - 1]; i < j; i++)
-                para_mps->canonical_form[i] = 'L';
-            para_mps->canonical_form[j] = 'S';
+            for (auto &xmps : para_mpss) {
+                for (int i = xmps->conn_centers[pm - 1]; i < j; i++)
+                    xmps->canonical_form[i] = 'L';
+                xmps->canonical_form[j] = 'S';
+            }
         }
     }
-    // Generate contracted environment blocks for all center sites
-    virtual void init_environments(bool iprint = false) {
-        this->iprint = iprint;
+    // Create empty partitions (and the singlet embedding left block)
+    void initialize_partitions() {
         envs.clear();
         envs.resize(n_sites);
         for (int i = 0; i < n_sites; i++) {
@@ -878,6 +1188,12 @@ template <typename S> struct MovingEnvironment {
             if (i != n_sites - 1 && dot == 2)
                 envs[i]->middle.push_back(mpo->tensors[i + 1]);
         }
+        left_signatures.clear(), right_signatures.clear();
+        if (reuse_environments) {
+            const size_t h = get_mpo_signature();
+            left_signatures.resize(n_sites + 1, h);
+            right_signatures.resize(n_sites + 1, h);
+        }
         // singlet embedding
         if (bra->info->vacuum != bra->info->left_dims_fci[0]->quanta[0] ||
             ket->info->vacuum != ket->info->left_dims_fci[0]->quanta[0]) {
@@ -900,9 +1216,14 @@ template <typename S> struct MovingEnvironment {
             envs[0]->left->ops[make_shared<OpExpr<S>>()] = xmat;
             envs[0]->left_op_infos.push_back(make_pair(dq, xinfo));
         }
+    }
+    // Generate contracted environment blocks for all center sites
+    virtual void init_environments(bool iprint = false) {
+        this->iprint = iprint;
+        initialize_partitions();
         if (ket->get_type() & MPSTypes::MultiCenter) {
-            shared_ptr<ParallelMPS<S>> para_mps =
-                dynamic_pointer_cast<ParallelMPS<S>>(ket);
+            vector<shared_ptr<ParallelMPS<S>>> para_mpss = get_para_mpss();
+            shared_ptr<ParallelMPS<S>> para_mps = para_mpss[0];
             para_mps->enable_parallel_writing();
             if (para_mps->rule == nullptr || para_mps->rule->comm->group == 0) {
                 frame->activate(1);
@@ -917,28 +1238,42 @@ template <typename S> struct MovingEnvironment {
             if (para_mps->rule != nullptr)
                 para_mps->rule->comm->barrier();
             shared_ptr<CG<S>> cg = mpo->tf->opf->cg;
-            while (para_mps->center != 0) {
-                if (iprint && (para_mps->rule == nullptr ||
-                               0 % para_mps->rule->comm->ngroup ==
-                                   para_mps->rule->comm->group))
-                    cout << "pre init .. " << para_mps->center << " : "
-                         << para_mps->canonical_form << endl;
-                para_mps->move_left(cg, para_mps->rule);
-            }
+            // one-site wavefunction at either end left by two-site sweeps
+            for (auto &xmps : para_mpss)
+                if (xmps->canonical_form[0] == 'C' &&
+                    xmps->canonical_form[1] != 'C')
+                    xmps->canonical_form[0] = 'K', xmps->center = 0;
+                else if (xmps->canonical_form[n_sites - 1] == 'C' &&
+                         xmps->canonical_form[n_sites - 2] != 'C')
+                    xmps->canonical_form[n_sites - 1] = 'S',
+                    xmps->center = n_sites - 1;
+            for (auto &xmps : para_mpss)
+                while (xmps->center != 0) {
+                    if (iprint && (para_mps->rule == nullptr ||
+                                   0 % para_mps->rule->comm->ngroup ==
+                                       para_mps->rule->comm->group))
+                        cout << "pre init .. " << xmps->center << " : "
+                             << xmps->canonical_form << endl;
+                    xmps->move_left(cg, para_mps->rule);
+                }
             assert(para_mps->conn_centers.size() != 0);
-            para_mps->ncenter = (int)para_mps->conn_centers.size();
-            para_mps->conn_matrices.resize(para_mps->ncenter);
-            for (int i = 0; i < para_mps->ncenter; i++)
-                para_mps->conn_matrices[i] = make_shared<SparseMatrix<S>>();
+            for (auto &xmps : para_mpss) {
+                xmps->ncenter = (int)xmps->conn_centers.size();
+                xmps->conn_matrices.resize(xmps->ncenter);
+                for (int i = 0; i < xmps->ncenter; i++)
+                    xmps->conn_matrices[i] = make_shared<SparseMatrix<S>>();
+            }
             init_parallel_environments(
                 0, para_mps->ncenter + 1,
                 para_mps->rule == nullptr ? nullptr : para_mps->rule->comm,
                 true);
-            para_mps->center = para_mps->conn_centers[0];
+            for (auto &xmps : para_mpss)
+                xmps->center = xmps->conn_centers[0];
             if (para_mps->rule != nullptr)
                 para_mps->rule->comm->barrier();
             if (para_mps->rule == nullptr || para_mps->rule->comm->group == 0)
-                para_mps->save_data();
+                for (auto &xmps : para_mpss)
+                    xmps->save_data();
             frame->activate(1);
             for (int i = 0; i < n_sites; i++) {
                 envs[i]->load_data(true, get_left_partition_filename(i, true));
@@ -950,21 +1285,375 @@ template <typename S> struct MovingEnvironment {
             para_mps->disable_parallel_writing();
         } else if (bra->info->get_warm_up_type() == WarmUpTypes::None &&
                    ket->info->get_warm_up_type() == WarmUpTypes::None) {
-            for (int i = 1; i <= center; i++) {
+            int il = 1, ir = n_sites - dot - 1;
+            if (reuse_environments)
+                reuse_partitions(il, ir);
+            if (il != 1 && envs[il - 1]->left != nullptr)
+                frame->load_data(1, get_left_partition_filename(il - 1));
+            for (int i = il; i <= center; i++) {
                 check_signal_()();
                 if (iprint)
                     cout << "init .. L = " << i << endl;
                 left_contract_rotate(i);
             }
-            for (int i = n_sites - dot - 1; i >= center; i--) {
+            if (ir != n_sites - dot - 1 && envs[ir + 1]->right != nullptr)
+                frame->load_data(1, get_right_partition_filename(ir + 1));
+            for (int i = ir; i >= center; i--) {
                 check_signal_()();
                 if (iprint)
                     cout << "init .. R = " << i << endl;
                 right_contract_rotate(i);
             }
+            if (reuse_environments)
+                environment_registry()[get_environment_key()] = tag;
         }
         frame->reset(1);
     }
+    // Tags of the last environment initialized with reuse_environments for
+    // each key of get_environment_key, so that environments with other tags
+    // (for example for Expect or Linear after DMRG) can find its partitions
+    static map<string, string> &environment_registry() {
+        static map<string, string> registry;
+        return registry;
+    }
+    // Key of environments that may share partitions: bra/ket tags and MPO
+    // (blocks at different centers are then matched by signatures)
+    string get_environment_key() const {
+        stringstream ss;
+        ss << bra->info->tag << "/" << ket->info->tag << "/"
+           << (left_signatures.size() != 0 ? left_signatures[0]
+                                           : get_mpo_signature());
+        return ss.str();
+    }
+    // Link partitions with matching signatures (and without matching ones
+    // for this tag) of the environment with tag src_tag into this
+    // environment. Signatures must be computed
+    void import_partitions(const string &src_tag) {
+        MovingEnvironment<S> src(*this);
+        src.tag = src_tag;
+        auto link = [this, &src](bool left, int i) {
+            if (check_partition_signature(left, i) ||
+                !src.check_partition_signature(left, i))
+                return;
+            if (iprint)
+                cout << "init .. " << (left ? "L" : "R") << " = " << i
+                     << " (linked from " << src.tag << ")" << endl;
+            for (bool info : {false, true})
+                Parsing::link_file(
+                    left ? src.get_left_partition_filename(i, info)
+                         : src.get_right_partition_filename(i, info),
+                    left ? get_left_partition_filename(i, info)
+                         : get_right_partition_filename(i, info));
+            Parsing::link_file(
+                left ? src.get_left_partition_signature_filename(i)
+                     : src.get_right_partition_signature_filename(i),
+                left ? get_left_partition_signature_filename(i)
+                     : get_right_partition_signature_filename(i));
+        };
+        if (frame->partition_can_write) {
+            for (int i = 1; i <= center; i++)
+                link(true, i);
+            for (int i = n_sites - dot - 1; i >= center; i--)
+                link(false, i);
+        }
+        if (para_rule != nullptr)
+            para_rule->comm->barrier();
+    }
+    // Load partition infos of blocks on disk whose signatures match, from
+    // the boundaries towards center. il/ir are set to the first left/right
+    // blocks that still need to be contracted
+    void reuse_partitions(int &il, int &ir) {
+        for (int i = 1; i <= center; i++)
+            left_signatures[i] = combine_signature(left_signatures[i - 1],
+                                                   get_site_signature(i - 1));
+        for (int i = n_sites - dot - 1; i >= center; i--)
+            right_signatures[i] = combine_signature(
+                right_signatures[i + 1], get_site_signature(i + dot));
+        map<string, string> &registry = environment_registry();
+        auto it = registry.find(get_environment_key());
+        if (it != registry.end() && it->second != tag)
+            import_partitions(it->second);
+        for (; il <= center && check_partition_signature(true, il); il++)
+            ;
+        for (; ir >= center && check_partition_signature(false, ir); ir--)
+            ;
+        // all procs must contract the same blocks
+        if (para_rule != nullptr) {
+            double nr[2] = {(double)il, (double)(n_sites - ir)};
+            para_rule->comm->allreduce_min(nr, 2);
+            il = (int)nr[0], ir = n_sites - (int)nr[1];
+        }
+        frame->activate(1);
+        for (int i = 1; i < il; i++) {
+            if (iprint)
+                cout << "init .. L = " << i << " (reused)" << endl;
+            envs[i]->load_data(true, get_left_partition_filename(i, true));
+        }
+        for (int i = n_sites - dot - 1; i > ir; i--) {
+            if (iprint)
+                cout << "init .. R = " << i << " (reused)" << endl;
+            envs[i]->load_data(false, get_right_partition_filename(i, true));
+        }
+        frame->activate(0);
+    }
+    // Save the environment blocks needed for continuing the sweep from
+    // the current center (left blocks up to center and right blocks from
+    // center) into dir, for restarting in the middle of a sweep
+    void save_environments(const string &dir) const {
+        assert(!(ket->get_type() & MPSTypes::MultiCenter));
+        if (!frame->partition_can_write)
+            return;
+        frame->activate(1);
+        for (int i = 0; i < n_sites; i++) {
+            // singlet embedding left block is not stored on disk
+            if (i != 0 && i <= center && envs[i]->left != nullptr) {
+                const string fn = get_left_partition_filename(i);
+                frame->wait_save_data(fn);
+                Parsing::copy_file(fn, dir + "/" + Parsing::get_filename(fn));
+                envs[i]->save_data(
+                    true, dir + "/" +
+                              Parsing::get_filename(
+                                  get_left_partition_filename(i, true)));
+            }
+            if (i >= center && envs[i]->right != nullptr) {
+                const string fn = get_right_partition_filename(i);
+                frame->wait_save_data(fn);
+                Parsing::copy_file(fn, dir + "/" + Parsing::get_filename(fn));
+                envs[i]->save_data(
+                    false, dir + "/" +
+                               Parsing::get_filename(
+                                   get_right_partition_filename(i, true)));
+            }
+        }
+        frame->activate(0);
+    }
+    // Load environment blocks saved by save_environments, instead of
+    // init_environments. The center is taken from ket
+    void load_environments(const string &dir) {
+        assert(!(ket->get_type() & MPSTypes::MultiCenter));
+        center = ket->center;
+        initialize_partitions();
+        frame->reset_buffer(1);
+        frame->activate(1);
+        for (int i = 0; i < n_sites; i++) {
+            const string lfn = get_left_partition_filename(i),
+                         lifn = dir + "/" +
+                                Parsing::get_filename(
+                                    get_left_partition_filename(i, true));
+            if (i != 0 && i <= center && Parsing::file_exists(lifn)) {
+                frame->remove_data(lfn);
+                Parsing::copy_file(dir + "/" + Parsing::get_filename(lfn),
+                                   lfn);
+                envs[i]->load_data(true, lifn);
+            }
+            const string rfn = get_right_partition_filename(i),
+                         rifn = dir + "/" +
+                                Parsing::get_filename(
+                                    get_right_partition_filename(i, true));
+            if (i >= center && Parsing::file_exists(rifn)) {
+                frame->remove_data(rfn);
+                Parsing::copy_file(dir + "/" + Parsing::get_filename(rfn),
+                                   rfn);
+                envs[i]->load_data(false, rifn);
+            }
+        }
+        frame->activate(0);
+        frame->reset(1);
+    }
+    string get_distributed_partition_filename(const string &dir, int i,
+                                              bool left) const {
+        stringstream ss;
+        ss << dir << "/" << frame->prefix << ".PART.DIST." << tag
+           << (left ? ".LEFT." : ".RIGHT.") << Parsing::to_string(i);
+        return ss.str();
+    }
+    // Write the operators of opt owned by this proc, after the structure of
+    // opt (symbols, operator infos and factors) if this is the first proc
+    void save_distributed_partition(
+        ostream &ofs, const shared_ptr<OperatorTensor<S>> &opt,
+        const vector<pair<S, shared_ptr<SparseMatrixInfo<S>>>> &op_infos,
+        bool left, bool first) const {
+        if (para_rule != nullptr)
+            para_rule->set_partition(left ? ParallelRulePartitionTypes::Left
+                                          : ParallelRulePartitionTypes::Right);
+        for (auto &op : opt->ops)
+            if (op.second->get_type() != SparseMatrixTypes::Normal)
+                throw runtime_error("MovingEnvironment::save_distributed_"
+                                    "environments: only normal sparse "
+                                    "matrices are supported.");
+        if (first) {
+            shared_ptr<OperatorTensor<S>> xopt =
+                make_shared<OperatorTensor<S>>();
+            xopt->lmat = opt->lmat, xopt->rmat = opt->rmat;
+            for (auto &op : opt->ops) {
+                shared_ptr<SparseMatrix<S>> mat =
+                    make_shared<SparseMatrix<S>>();
+                mat->info = op.second->info;
+                mat->factor = op.second->factor;
+                xopt->ops[op.first] = mat;
+            }
+            xopt->save_data(ofs, false);
+            int sz = (int)op_infos.size();
+            ofs.write((char *)&sz, sizeof(sz));
+            for (auto &op_info : op_infos) {
+                ofs.write((char *)&op_info.first, sizeof(op_info.first));
+                op_info.second->save_data(ofs, false);
+            }
+        }
+        vector<pair<shared_ptr<OpExpr<S>>, shared_ptr<SparseMatrix<S>>>> mats;
+        for (auto &op : opt->ops)
+            if (op.second->data != nullptr && op.second->total_memory != 0 &&
+                (para_rule == nullptr || para_rule->own(op.first)))
+                mats.push_back(op);
+        int nop = (int)mats.size();
+        ofs.write((char *)&nop, sizeof(nop));
+        for (auto &op : mats) {
+            save_expr(op.first, ofs);
+            op.second->save_data(ofs, false);
+        }
+    }
+    // Build opt in the stack of the current frame from a file written by
+    // save_distributed_partition of all procs. Operators not available
+    // on this proc under the current parallel rule are not allocated
+    void load_distributed_partition(
+        const string &filename, shared_ptr<OperatorTensor<S>> &opt,
+        vector<pair<S, shared_ptr<SparseMatrixInfo<S>>>> &op_infos,
+        bool left) const {
+        if (para_rule != nullptr)
+            para_rule->set_partition(left ? ParallelRulePartitionTypes::Left
+                                          : ParallelRulePartitionTypes::Right);
+        ifstream ifs(filename.c_str(), ios::binary);
+        if (!ifs.good())
+            throw runtime_error("MovingEnvironment::load_distributed_"
+                                "partition on '" +
+                                filename + "' failed.");
+        int nproc = 0;
+        ifs.read((char *)&nproc, sizeof(nproc));
+        vector<uint64_t> lens(nproc);
+        ifs.read((char *)lens.data(), sizeof(uint64_t) * nproc);
+        shared_ptr<OperatorTensor<S>> xopt = make_shared<OperatorTensor<S>>();
+        xopt->load_data(ifs, false);
+        int sz = 0;
+        ifs.read((char *)&sz, sizeof(sz));
+        op_infos.resize(sz);
+        for (int i = 0; i < sz; i++) {
+            ifs.read((char *)&op_infos[i].first, sizeof(op_infos[i].first));
+            op_infos[i].second = make_shared<SparseMatrixInfo<S>>(ialloc);
+            op_infos[i].second->load_data(ifs, false);
+        }
+        opt = make_shared<OperatorTensor<S>>();
+        opt->lmat = xopt->lmat, opt->rmat = xopt->rmat;
+        for (auto &op : xopt->ops) {
+            shared_ptr<SparseMatrix<S>> mat = make_shared<SparseMatrix<S>>();
+            mat->info = Partition<S>::find_op_info(
+                op_infos, op.second->info->delta_quantum);
+            if (mat->info == nullptr)
+                mat->info = make_shared<SparseMatrixInfo<S>>(
+                    op.second->info->deep_copy(ialloc));
+            mat->factor = op.second->factor;
+            opt->ops[op.first] = mat;
+        }
+        shared_ptr<VectorAllocator<double>> d_alloc =
+            make_shared<VectorAllocator<double>>();
+        for (int ip = 0; ip < nproc; ip++) {
+            int nop = 0;
+            ifs.read((char *)&nop, sizeof(nop));
+            for (int i = 0; i < nop; i++) {
+                shared_ptr<OpExpr<S>> expr = load_expr<S>(ifs);
+                assert(opt->ops.count(expr) != 0);
+                shared_ptr<SparseMatrix<S>> mat = opt->ops.at(expr);
+                if (para_rule == nullptr || para_rule->available(expr)) {
+                    mat->alloc = dalloc;
+                    mat->load_data(ifs, false);
+                    assert(mat->total_memory == mat->info->get_total_memory());
+                } else {
+                    SparseMatrix<S> xmat(d_alloc);
+                    xmat.load_data(ifs, false);
+                    xmat.deallocate();
+                }
+            }
+        }
+        if (ifs.fail() || ifs.bad())
+            throw runtime_error("MovingEnvironment::load_distributed_"
+                                "partition on '" +
+                                filename + "' failed.");
+        ifs.close();
+    }
+    // Save the environment blocks of save_environments into one file per
+    // block in dir, holding the operators of all procs. Must be called by
+    // all procs. The saved blocks can be loaded by
+    // load_distributed_environments with a different number of procs
+    void save_distributed_environments(const string &dir) const {
+        assert(!(ket->get_type() & MPSTypes::MultiCenter));
+        if (para_rule != nullptr &&
+            (para_rule->get_parallel_type() & ParallelTypes::NewScheme))
+            throw runtime_error("MovingEnvironment::save_distributed_"
+                                "environments: partial operators are not "
+                                "supported.");
+        shared_ptr<ParallelCommunicator<S>> comm =
+            para_rule != nullptr
+                ? para_rule->comm
+                : make_shared<ParallelCommunicator<S>>(1, 0, 0);
+        frame->activate(1);
+        for (int i = 0; i < n_sites; i++)
+            for (int k = 0; k < 2; k++) {
+                const bool left = k == 0;
+                // singlet embedding left block is not stored on disk
+                if (left ? (i == 0 || i > center) : i < center)
+                    continue;
+                const shared_ptr<OperatorTensor<S>> &opt =
+                    left ? envs[i]->left : envs[i]->right;
+                if (opt == nullptr)
+                    continue;
+                const string fn = left ? get_left_partition_filename(i)
+                                       : get_right_partition_filename(i);
+                frame->wait_save_data(fn);
+                frame->load_data(1, fn);
+                stringstream ss;
+                save_distributed_partition(
+                    ss, opt,
+                    left ? envs[i]->left_op_infos : envs[i]->right_op_infos,
+                    left, comm->rank == 0);
+                comm->write_ordered(
+                    get_distributed_partition_filename(dir, i, left), ss.str());
+            }
+        frame->activate(0);
+    }
+    // Load environment blocks saved by save_distributed_environments,
+    // instead of init_environments. The operators are distributed by the
+    // current parallel rule. The center is taken from ket
+    void load_distributed_environments(const string &dir) {
+        assert(!(ket->get_type() & MPSTypes::MultiCenter));
+        center = ket->center;
+        initialize_partitions();
+        frame->reset_buffer(1);
+        for (int i = 0; i < n_sites; i++)
+            for (int k = 0; k < 2; k++) {
+                const bool left = k == 0;
+                const string dfn =
+                    get_distributed_partition_filename(dir, i, left);
+                if ((left ? (i == 0 || i > center) : i < center) ||
+                    !Parsing::file_exists(dfn))
+                    continue;
+                const string fn = left ? get_left_partition_filename(i)
+                                       : get_right_partition_filename(i);
+                frame->remove_data(fn);
+                frame->reset(1);
+                frame->activate(1);
+                if (left)
+                    load_distributed_partition(dfn, envs[i]->left,
+                                               envs[i]->left_op_infos, true);
+                else
+                    load_distributed_partition(dfn, envs[i]->right,
+                                               envs[i]->right_op_infos, false);
+                frame->save_data(1, fn);
+                envs[i]->save_data(
+                    left, left ? get_left_partition_filename(i, true)
+                               : get_right_partition_filename(i, true));
+            }
+        frame->activate(0);
+        frame->reset(1);
+    }
     void partial_prepare(int a, int b) {
         assert(a >= 0 && b <= n_sites);
         tctr = trot = tmid = tint = tdctr = tdiag = tinfo = 0;
@@ -1018,6 +1707,16 @@ template <typename S> struct MovingEnvironment {
                 if (envs[i]->right != nullptr)
                     frame->rename_data(get_right_partition_filename(i),
                                        get_right_partition_filename(i + 1));
+            if (reuse_environments) {
+                // partition infos are not renamed
+                for (int i = n_sites - 1; i >= center; i--) {
+                    right_signatures[i + 1] = right_signatures[i];
+                    Parsing::remove_file(
+                        get_right_partition_signature_filename(i + 1));
+                }
+                Parsing::remove_file(
+                    get_right_partition_signature_filename(center));
+            }
             for (int i = n_sites - 1; i >= 0; i--) {
                 envs[i]->middle.resize(1);
                 if (i > 0) {
@@ -1075,11 +1774,8 @@ template <typename S> struct MovingEnvironment {
             if (envs[center]->left != nullptr)
                 new_data_name = get_left_partition_filename(center);
             if (frame->minimal_disk_usage && !preserve_data &&
-                envs[center - 1]->right != nullptr) {
-                string old_data_name = get_right_partition_filename(center - 1);
-                if (Parsing::file_exists(old_data_name))
-                    Parsing::remove_file(old_data_name);
-            }
+                envs[center - 1]->right != nullptr)
+                frame->remove_data(get_right_partition_filename(center - 1));
         } else if (i < center) {
             if (envs[center]->right != nullptr &&
                 !(cached_info.first == OpCachingTypes::Right &&
@@ -1090,11 +1786,8 @@ template <typename S> struct MovingEnvironment {
             if (envs[center]->right != nullptr)
                 new_data_name = get_right_partition_filename(center);
             if (frame->minimal_disk_usage && !preserve_data &&
-                envs[center + 1]->left != nullptr) {
-                string old_data_name = get_left_partition_filename(center + 1);
-                if (Parsing::file_exists(old_data_name))
-                    Parsing::remove_file(old_data_name);
-            }
+                envs[center + 1]->left != nullptr)
+                frame->remove_data(get_left_partition_filename(center + 1));
         }
         if (para_rule != nullptr)
             para_rule->comm->barrier();
@@ -1544,6 +2237,7 @@ template <typename S> struct MovingEnvironment {
                                                  hops, mpo->tf, compute_diag);
         tdiag += _t2.get_time();
         frame->update_peak_used_memory();
+        prefetch_environments(forward);
         return efh;
     }
     // Generate effective hamiltonian at current center site
@@ -1665,6 +2359,7 @@ template <typename S> struct MovingEnvironment {
                 mpo->op, hops, mpo->tf, compute_diag);
         tdiag += _t2.get_time();
         frame->update_peak_used_memory();
+        prefetch_environments(forward);
         return efh;
     }
     // Absorb wfn matrix into adjacent MPS tensor in one-site algorithm
@@ -1913,6 +2608,12 @@ template <typename S> struct MovingEnvironment {
         mps->tensors[i] = mps->tensors[i + 1] = nullptr;
         mps->wfns = old_wfns;
     }
+    // Whether the noise is added by trans_product as random numbers
+    // (otherwise the density matrix is formed in batches)
+    static bool has_random_noise(double noise, NoiseTypes noise_type) {
+        return noise != 0 && ((noise_type & NoiseTypes::Wavefunction) ||
+                              (noise_type & NoiseTypes::DensityMatrix));
+    }
     // Density matrix of a MPS tensor
     static shared_ptr<SparseMatrix<S>>
     density_matrix(S vacuum, const shared_ptr<SparseMatrix<S>> &psi,
@@ -1928,16 +2629,21 @@ template <typename S> struct MovingEnvironment {
         dm->allocate(dm_info);
         assert(psi->factor == 1);
         psi->factor = sqrt(scale);
-        OperatorFunctions<S>::trans_product(psi, dm, trace_right, sqrt(noise),
-                                            noise_type);
-        psi->factor = 1;
+        // products of wavefunction and perturbed wavefunctions in one batch
+        vector<shared_ptr<SparseMatrix<S>>> mats;
+        if (has_random_noise(noise, noise_type))
+            OperatorFunctions<S>::trans_product(psi, dm, trace_right,
+                                                sqrt(noise), noise_type);
+        else
+            mats.push_back(psi);
         if ((noise_type & NoiseTypes::Perturbative) && noise != 0) {
             assert(pkets != nullptr);
             scale_perturbative_noise(noise, noise_type, pkets);
             for (int i = 1; i < pkets->n; i++)
-                OperatorFunctions<S>::trans_product(
-                    (*pkets)[i], dm, trace_right, 0.0, NoiseTypes::None);
+                mats.push_back((*pkets)[i]);
         }
+        OperatorFunctions<S>::trans_product_batch(mats, dm, trace_right);
+        psi->factor = 1;
         return dm;
     }
     // Density matrix of a MultiMPS tensor
@@ -1953,20 +2659,24 @@ template <typename S> struct MovingEnvironment {
         shared_ptr<SparseMatrix<S>> dm = make_shared<SparseMatrix<S>>();
         dm->allocate(dm_info);
         assert(weights.size() == psi.size());
+        vector<shared_ptr<SparseMatrix<S>>> mats;
         for (size_t i = 0; i < psi.size(); i++)
             for (int j = 0; j < psi[i]->n; j++) {
                 shared_ptr<SparseMatrix<S>> wfn = (*psi[i])[j];
                 wfn->factor = sqrt(weights[i] * scale);
-                OperatorFunctions<S>::trans_product(wfn, dm, trace_right,
-                                                    sqrt(noise), noise_type);
+                if (has_random_noise(noise, noise_type))
+                    OperatorFunctions<S>::trans_product(
+                        wfn, dm, trace_right, sqrt(noise), noise_type);
+                else
+                    mats.push_back(wfn);
             }
         if ((noise_type & NoiseTypes::Perturbative) && noise != 0) {
             assert(pkets != nullptr);
             scale_perturbative_noise(noise, noise_type, pkets);
             for (int i = 1; i < pkets->n; i++)
-                OperatorFunctions<S>::trans_product(
-                    (*pkets)[i], dm, trace_right, 0.0, NoiseTypes::None);
+                mats.push_back((*pkets)[i]);
         }
+        OperatorFunctions<S>::trans_product_batch(mats, dm, trace_right);
         return dm;
     }
     // Add wavefunction to density matrix
@@ -1975,8 +2685,8 @@ template <typename S> struct MovingEnvironment {
                                        bool trace_right, double scale = 1.0) {
         assert(psi->factor == 1);
         psi->factor = sqrt(scale);
-        OperatorFunctions<S>::trans_product(psi, dm, trace_right, 0.0,
-                                            NoiseTypes::None);
+        OperatorFunctions<S>::trans_product_batch(
+            vector<shared_ptr<SparseMatrix<S>>>{psi}, dm, trace_right);
         psi->factor = 1;
     }
     // Density matrix with perturbed wavefunctions as noise
@@ -1984,9 +2694,10 @@ template <typename S> struct MovingEnvironment {
         const shared_ptr<SparseMatrix<S>> &dm, bool trace_right, double noise,
         NoiseTypes noise_type, const shared_ptr<SparseMatrixGroup<S>> &mats) {
         scale_perturbative_noise(noise, noise_type, mats);
+        vector<shared_ptr<SparseMatrix<S>>> pmats;
         for (int i = 1; i < mats->n; i++)
-            OperatorFunctions<S>::trans_product((*mats)[i], dm, trace_right,
-                                                0.0, NoiseTypes::None);
+            pmats.push_back((*mats)[i]);
+        OperatorFunctions<S>::trans_product_batch(pmats, dm, trace_right);
     }
     // Density matrix of several MPS tensors summed with weights
     static void
@@ -1994,15 +2705,15 @@ template <typename S> struct MovingEnvironment {
                                 const shared_ptr<SparseMatrix<S>> &psi,
                                 bool trace_right, const vector<MatrixRef> &mats,
                                 const vector<double> &weights) {
-        double *ptr = psi->data;
         assert(psi->factor == 1.0);
         assert(mats.size() == weights.size() - 1);
+        vector<shared_ptr<SparseMatrix<S>>> wfns;
         for (size_t i = 1; i < weights.size(); i++) {
-            psi->data = mats[i - 1].data;
-            psi->factor = sqrt(weights[i]);
-            OperatorFunctions<S>::trans_product(psi, dm, trace_right, 0.0);
+            wfns.push_back(make_shared<SparseMatrix<S>>(*psi));
+            wfns.back()->data = mats[i - 1].data;
+            wfns.back()->factor = sqrt(weights[i]);
         }
-        psi->data = ptr, psi->factor = 1.0;
+        OperatorFunctions<S>::trans_product_batch(wfns, dm, trace_right);
     }
     // Density matrix of several MPS tensors summed with weights
     static void density_matrix_add_matrix_groups(
@@ -2011,16 +2722,17 @@ template <typename S> struct MovingEnvironment {
         const vector<MatrixRef> &mats, const vector<double> &weights) {
         int p = 0, np = psi.size() * psi[0]->n;
         assert(mats.size() == (weights.size() - 1) * np);
+        vector<shared_ptr<SparseMatrix<S>>> wfns;
         for (size_t k = 1; k < weights.size(); k++)
             for (size_t i = 0; i < psi.size(); i++)
                 for (int j = 0; j < psi[i]->n; j++) {
                     shared_ptr<SparseMatrix<S>> wfn = (*psi[i])[j];
                     wfn->data = mats[p++].data;
                     wfn->factor = sqrt(weights[k] / np);
-                    OperatorFunctions<S>::trans_product(wfn, dm, trace_right,
-                                                        0.0);
+                    wfns.push_back(wfn);
                 }
         assert((size_t)p == mats.size());
+        OperatorFunctions<S>::trans_product_batch(wfns, dm, trace_right);
     }
     // Direct add noise to wavefunction (before svd)
     static void wavefunction_add_noise(const shared_ptr<SparseMatrix<S>> &psi,
@@ -2045,44 +2757,133 @@ template <typename S> struct MovingEnvironment {
             return;
         if (!(noise_type & NoiseTypes::Unscaled)) {
             for (int i = 0; i < mats->n; i++) {
-                double mat_norm = (*mats)[i]->norm();
+                double mat_norm = mats->view(i).norm();
                 if (abs(mat_norm) > TINY)
-                    (*mats)[i]->iscale(1 / mat_norm);
+                    mats->view(i).iscale(1 / mat_norm);
             }
         }
         double norm = mats->norm();
         if (abs(norm) > TINY)
             mats->iscale(sqrt(noise) / norm);
     }
+    // Diagonalize each block of density matrix (eigenvectors as rows)
+    // With rand_min_size != 0, blocks with size at least rand_min_size only
+    // compute the leading eigenpairs by randomized subspace iteration, whose
+    // number is doubled until the discarded trace of the block is below the
+    // k-th (reduced) eigenvalue or the cutoff
+    // return the total discarded trace
+    static double
+    density_matrix_eigs(const shared_ptr<SparseMatrix<S>> &dm, int k,
+                        double cutoff, TruncationTypes trunc_type,
+                        int rand_min_size,
+                        vector<shared_ptr<VectorAllocator<double>>> &d_allocs,
+                        vector<DiagonalMatrix> &eigen_values,
+                        vector<MatrixRef> &eigen_values_reduced) {
+        const int n = dm->info->n;
+        vector<MKL_INT> nks(n);
+        vector<double> tails(n, 0), factors(n, 1.0);
+        vector<MatrixRef> vecs(n, MatrixRef(nullptr, 0, 0));
+        vector<uint8_t> todo(n, 1);
+        size_t ntot = 0;
+        for (int i = 0; i < n; i++)
+            ntot += dm->info->n_states_bra[i];
+        for (int i = 0; i < n; i++) {
+            if (trunc_type & TruncationTypes::Reduced)
+                factors[i] = 1.0 / dm->info->quanta[i].multiplicity();
+            else if (trunc_type & TruncationTypes::ReducedInversed)
+                factors[i] = dm->info->quanta[i].multiplicity();
+            nks[i] = dm->info->n_states_bra[i];
+            if (k == -1 || rand_min_size == 0 || nks[i] < rand_min_size ||
+                ((ubond_t)trunc_type >> 2) != 0)
+                continue;
+            // twice the proportional share of the bond dimension
+            MKL_INT nk =
+                max((MKL_INT)(2 * (size_t)k * nks[i] / ntot), (MKL_INT)2);
+            if (nk * 2 <= nks[i])
+                nks[i] = nk;
+        }
+        for (bool more = true; more;) {
+            vector<size_t> costs(n, 0);
+            for (int i = 0; i < n; i++)
+                if (todo[i])
+                    costs[i] = (size_t)dm->info->n_states_bra[i] *
+                                   dm->info->n_states_bra[i] * nks[i] +
+                               1;
+            threading->parallel_by_cost(costs, [&](int i) {
+                if (d_allocs[i] == nullptr)
+                    d_allocs[i] = make_shared<VectorAllocator<double>>();
+                else {
+                    eigen_values_reduced[i].deallocate(d_allocs[i]);
+                    eigen_values[i].deallocate(d_allocs[i]);
+                    vecs[i].deallocate(d_allocs[i]);
+                    vecs[i] = MatrixRef(nullptr, 0, 0);
+                }
+                const MKL_INT nb = dm->info->n_states_bra[i];
+                DiagonalMatrix w(nullptr, nks[i]);
+                w.allocate(d_allocs[i]);
+                if (nks[i] == nb)
+                    MatrixFunctions::eigs((*dm)[i], w);
+                else {
+                    vecs[i] = MatrixRef(nullptr, nks[i], nb);
+                    vecs[i].allocate(d_allocs[i]);
+                    tails[i] =
+                        MatrixFunctions::truncated_eigs((*dm)[i], vecs[i], w);
+                }
+                MatrixRef wr(nullptr, w.n, 1);
+                wr.allocate(d_allocs[i]);
+                MatrixFunctions::copy(wr, MatrixRef(w.data, w.n, 1));
+                MatrixFunctions::iscale(wr, factors[i]);
+                eigen_values[i] = w;
+                eigen_values_reduced[i] = wr;
+                todo[i] = 0;
+            });
+            more = false;
+            vector<double> wvals;
+            for (int i = 0; i < n; i++)
+                wvals.insert(wvals.end(), eigen_values_reduced[i].data,
+                             eigen_values_reduced[i].data +
+                                 eigen_values_reduced[i].size());
+            double thrd = cutoff;
+            if (k != -1 && (int)wvals.size() > k) {
+                nth_element(wvals.begin(), wvals.begin() + (k - 1),
+                            wvals.end(), greater<double>());
+                thrd = max(thrd, wvals[k - 1]);
+            }
+            for (int i = 0; i < n; i++) {
+                const MKL_INT nb = dm->info->n_states_bra[i];
+                if (nks[i] == nb || tails[i] * factors[i] <= thrd)
+                    continue;
+                nks[i] = nks[i] * 4 <= nb ? nks[i] * 2 : nb;
+                todo[i] = 1, more = true;
+            }
+        }
+        double error = 0;
+        for (int i = 0; i < n; i++)
+            if (vecs[i].data != nullptr) {
+                MatrixFunctions::copy(
+                    MatrixRef((*dm)[i].data, vecs[i].m, vecs[i].n), vecs[i]);
+                error += tails[i];
+            }
+        for (int i = n - 1; i >= 0; i--)
+            if (vecs[i].data != nullptr)
+                vecs[i].deallocate(d_allocs[i]);
+        return error;
+    }
     // Diagonalize density matrix and truncate to k eigenvalues
     static double truncate_density_matrix(const shared_ptr<SparseMatrix<S>> &dm,
                                           vector<pair<int, int>> &ss, int k,
                                           double cutoff,
-                                          TruncationTypes trunc_type) {
+                                          TruncationTypes trunc_type,
+                                          int rand_min_size = 0) {
         vector<shared_ptr<VectorAllocator<double>>> d_allocs(dm->info->n);
         vector<DiagonalMatrix> eigen_values(dm->info->n,
                                             DiagonalMatrix(nullptr, 0));
         vector<MatrixRef> eigen_values_reduced(dm->info->n,
                                                MatrixRef(nullptr, 0, 0));
-        int ntg = threading->activate_global();
-#pragma omp parallel for schedule(dynamic) num_threads(ntg)
-        for (int i = 0; i < dm->info->n; i++) {
-            d_allocs[i] = make_shared<VectorAllocator<double>>();
-            DiagonalMatrix w(nullptr, dm->info->n_states_bra[i]);
-            w.allocate(d_allocs[i]);
-            MatrixFunctions::eigs((*dm)[i], w);
-            MatrixRef wr(nullptr, w.n, 1);
-            wr.allocate(d_allocs[i]);
-            MatrixFunctions::copy(wr, MatrixRef(w.data, w.n, 1));
-            if (trunc_type & TruncationTypes::Reduced)
-                MatrixFunctions::iscale(
-                    wr, 1.0 / dm->info->quanta[i].multiplicity());
-            else if (trunc_type & TruncationTypes::ReducedInversed)
-                MatrixFunctions::iscale(wr, dm->info->quanta[i].multiplicity());
-            eigen_values[i] = w;
-            eigen_values_reduced[i] = wr;
-        }
-        threading->activate_normal();
+        // discarded trace of blocks with only leading eigenpairs computed
+        const double tail_error =
+            density_matrix_eigs(dm, k, cutoff, trunc_type, rand_min_size,
+                                d_allocs, eigen_values, eigen_values_reduced);
         int k_total = 0;
         for (int i = 0; i < dm->info->n; i++)
             k_total += eigen_values[i].n;
@@ -2155,7 +2956,7 @@ template <typename S> struct MovingEnvironment {
             eigen_values_reduced[i].deallocate(d_allocs[i]);
             eigen_values[i].deallocate(d_allocs[i]);
         }
-        return error;
+        return error + tail_error;
     }
     // Truncate and keep k singular values
     static double truncate_singular_values(const vector<S> &qs,
@@ -2384,6 +3185,8 @@ template <typename S> struct MovingEnvironment {
         return winfo;
     }
     // Split wavefunction to two MPS tensors using svd
+    // rand_min_size: min block size for randomized truncated svd
+    // (0 to disable; see SparseMatrix::block_svd)
     static double split_wavefunction_svd(
         S opdq, const shared_ptr<SparseMatrix<S>> &wfn, int k, bool trace_right,
         bool normalize, shared_ptr<SparseMatrix<S>> &left,
@@ -2393,9 +3196,12 @@ template <typename S> struct MovingEnvironment {
         const shared_ptr<SparseMatrixGroup<S>> &mwfn = nullptr,
         const vector<shared_ptr<SparseMatrix<S>>> &xwfns =
             vector<shared_ptr<SparseMatrix<S>>>(),
-        const vector<double> &weights = vector<double>()) {
+        const vector<double> &weights = vector<double>(),
+        int rand_min_size = 0) {
         vector<shared_ptr<Tensor>> l, s, r;
         vector<S> qs;
+        // discarded weight of blocks with only leading triplets computed
+        double tail_error = 0;
         // for perturbative SVD
         if (mwfn != nullptr) {
             vector<vector<shared_ptr<Tensor>>> xlr;
@@ -2423,6 +3229,17 @@ template <typename S> struct MovingEnvironment {
                 xmwfn->left_svd(qs, xlr, s, r, xxwfns, weights);
                 l = xlr.back();
             }
+        } else if (rand_min_size != 0 && k != -1 &&
+                   trunc_type == TruncationTypes::Physical) {
+            if (trace_right)
+                wfn->right_svd(qs, l, s, r, (ubond_t)k, 0, rand_min_size);
+            else
+                wfn->left_svd(qs, l, s, r, (ubond_t)k, 0, rand_min_size);
+            tail_error = wfn->norm() * wfn->norm();
+            for (auto &ts : s)
+                for (auto x : ts->data)
+                    tail_error -= x * x;
+            tail_error = max(tail_error, 0.0);
         } else {
             if (trace_right)
                 wfn->right_svd(qs, l, s, r);
@@ -2432,7 +3249,8 @@ template <typename S> struct MovingEnvironment {
         // ss: pair<quantum index in dm, reduced matrix index in dm>
         vector<pair<int, int>> ss;
         double error = MovingEnvironment<S>::truncate_singular_values(
-            qs, s, ss, k, cutoff, trunc_type);
+                           qs, s, ss, k, cutoff, trunc_type) +
+                       tail_error;
         // ilr: row index in singular values list
         // im: number of states
         vector<int> ilr;
@@ -2550,16 +3368,19 @@ template <typename S> struct MovingEnvironment {
         return error;
     }
     // Split wavefunction to two MPS tensors by solving eigenvalue problem
+    // rand_min_size: min block size for randomized truncated eigensolver
+    // (0 to disable; see density_matrix_eigs)
     static double split_density_matrix(
         const shared_ptr<SparseMatrix<S>> &dm,
         const shared_ptr<SparseMatrix<S>> &wfn, int k, bool trace_right,
         bool normalize, shared_ptr<SparseMatrix<S>> &left,
         shared_ptr<SparseMatrix<S>> &right, double cutoff,
-        TruncationTypes trunc_type = TruncationTypes::Physical) {
+        TruncationTypes trunc_type = TruncationTypes::Physical,
+        int rand_min_size = 0) {
         // ss: pair<quantum index in dm, reduced matrix index in dm>
         vector<pair<int, int>> ss;
         double error = MovingEnvironment<S>::truncate_density_matrix(
-            dm, ss, k, cutoff, trunc_type);
+            dm, ss, k, cutoff, trunc_type, rand_min_size);
         // ilr: row index in dm
         // im: number of states
         vector<int> ilr;
@@ -26,6 +26,7 @@
 #include "../core/symbolic.hpp"
 #include "../core/tensor_functions.hpp"
 #include "mps.hpp"
+#include <cstring>
 #include <iomanip>
 #include <memory>
 #include <sstream>
@@ -143,6 +144,10 @@ template <typename S> struct MPO {
     vector<vector<size_t>> archive_marks;
     size_t archive_schemer_mark;
     string archive_filename = "";
+    // Pooled operator elements of symbolics in archive file
+    // Only used for symbolics stored before op_pool_end (in the loaded file)
+    shared_ptr<OpElementPool<S>> op_pool = nullptr;
+    size_t op_pool_end = 0;
     MPO(int n_sites)
         : n_sites(n_sites), sparse_form(n_sites, 'N'), const_e(0.0),
           op(nullptr), schemer(nullptr), tf(nullptr) {}
@@ -265,6 +270,93 @@ template <typename S> struct MPO {
         total = left_total.back() + right_total.back();
         return vector<size_t>{psz * 8, peak * 8, total * 8};
     }
+    // dry-run prediction of stack memory (in bytes) for each sweep position
+    // without doing any numerics; for each site: 0 = main double stack,
+    // 1 = secondary double stack, 2 = main integer stack,
+    // 3 = secondary integer stack (same layout as DataFrame::peak_used_memory)
+    // secondary stack: left and right environments loaded from disk
+    // main stack: n_wfn wavefunction sized arrays and the larger of
+    // the enlarged + renormalized left/right block operators
+    virtual vector<vector<size_t>>
+    estimate_stack_memory(shared_ptr<MPSInfo<S>> info, int dot,
+                          int n_wfn = 2) {
+        shared_ptr<VectorAllocator<uint32_t>> i_alloc =
+            make_shared<VectorAllocator<uint32_t>>();
+        shared_ptr<SparseMatrixInfo<S>> mat_info =
+            make_shared<SparseMatrixInfo<S>>(i_alloc);
+        // number of doubles and integers for all operators in a block
+        auto block_memory = [&mat_info](const shared_ptr<Symbolic<S>> &names,
+                                        const StateInfo<S> &t) {
+            size_t dsz = 0, isz = 0;
+            map<S, size_t> mpsz;
+            for (auto xop : names->data) {
+                if (xop->get_type() == OpTypes::Zero)
+                    continue;
+                shared_ptr<OpElement<S>> op =
+                    dynamic_pointer_cast<OpElement<S>>(xop);
+                if (!mpsz.count(op->q_label)) {
+                    mat_info->initialize(t, t, op->q_label,
+                                         op->q_label.is_fermion());
+                    mpsz[op->q_label] = mat_info->get_total_memory();
+                    isz += mat_info->n * (sizeof(S) >> 2) + mat_info->n +
+                           _DBL_MEM_SIZE(mat_info->n);
+                    mat_info->deallocate();
+                }
+                dsz += mpsz.at(op->q_label);
+            }
+            return make_pair(dsz, isz);
+        };
+        vector<vector<size_t>> r;
+        for (int i = 0; i < n_sites; i++) {
+            if (dot == 2 && i == n_sites - 1)
+                break;
+            // dseco, iseco, dmain, imain in number of elements
+            size_t mem[4] = {0, 0, 0, 0};
+            pair<size_t, size_t> pl, pr;
+            if (i != 0) {
+                load_left_operators(i - 1);
+                pl = block_memory(left_operator_names[i - 1],
+                                  *info->left_dims[i]);
+                unload_left_operators(i - 1);
+                mem[0] += pl.first, mem[1] += pl.second;
+            }
+            if (i + dot != n_sites) {
+                load_right_operators(i + dot);
+                pr = block_memory(right_operator_names[i + dot],
+                                  *info->right_dims[i + dot]);
+                unload_right_operators(i + dot);
+                mem[0] += pr.first, mem[1] += pr.second;
+            }
+            const int iR = i + dot - 1;
+            StateInfo<S> tl = StateInfo<S>::tensor_product(
+                *info->left_dims[i], *info->basis[i],
+                *info->left_dims_fci[i + 1]);
+            StateInfo<S> tr = StateInfo<S>::tensor_product(
+                *info->basis[iR], *info->right_dims[iR + 1],
+                *info->right_dims_fci[iR]);
+            mat_info->initialize(tl, dot == 2 ? tr : *info->right_dims[i + 1],
+                                 info->target, false, true);
+            mem[2] += n_wfn * (size_t)mat_info->get_total_memory();
+            mem[3] += mat_info->n * (sizeof(S) >> 2) + mat_info->n +
+                      _DBL_MEM_SIZE(mat_info->n);
+            mat_info->deallocate();
+            load_left_operators(i);
+            pl = block_memory(left_operator_names[i], tl);
+            pair<size_t, size_t> plr =
+                block_memory(left_operator_names[i], *info->left_dims[i + 1]);
+            unload_left_operators(i);
+            load_right_operators(iR);
+            pr = block_memory(right_operator_names[iR], tr);
+            pair<size_t, size_t> prr =
+                block_memory(right_operator_names[iR], *info->right_dims[iR]);
+            unload_right_operators(iR);
+            mem[2] += max(pl.first + plr.first, pr.first + prr.first);
+            mem[3] += max(pl.second + plr.second, pr.second + prr.second);
+            r.push_back(vector<size_t>{mem[2] * 8, mem[0] * 8, mem[3] * 4,
+                                       mem[1] * 4});
+        }
+        return r;
+    }
     virtual void deallocate() {
         for (int16_t m = n_sites - 1; m >= 0; m--)
             if (tensors[m] != nullptr)
@@ -311,6 +403,10 @@ template <typename S> struct MPO {
         if (archive_filename != "")
             schemer->unload_data();
     }
+    // Element pool used by archived symbolic at mark
+    const OpElementPool<S> *archive_pool(size_t mark) const {
+        return mark < op_pool_end ? op_pool.get() : nullptr;
+    }
     void load_left_operators(int i) {
         if (archive_filename == "")
             return;
@@ -322,11 +418,13 @@ template <typename S> struct MPO {
         ifs.clear();
         ifs.seekg(archive_marks[i][1]);
         if (archive_marks[i][1] != 0)
-            left_operator_names[i] = load_symbolic<S>(ifs);
+            left_operator_names[i] =
+                load_symbolic<S>(ifs, archive_pool(archive_marks[i][1]));
         ifs.clear();
         ifs.seekg(archive_marks[i][4]);
         if (archive_marks[i][4] != 0)
-            left_operator_exprs[i] = load_symbolic<S>(ifs);
+            left_operator_exprs[i] =
+                load_symbolic<S>(ifs, archive_pool(archive_marks[i][4]));
         if (ifs.fail() || ifs.bad())
             throw runtime_error("MPO:load_left_operators on '" +
                                 archive_filename + "' failed.");
@@ -350,11 +448,13 @@ template <typename S> struct MPO {
         ifs.clear();
         ifs.seekg(archive_marks[i][2]);
         if (archive_marks[i][2] != 0)
-            right_operator_names[i] = load_symbolic<S>(ifs);
+            right_operator_names[i] =
+                load_symbolic<S>(ifs, archive_pool(archive_marks[i][2]));
         ifs.clear();
         ifs.seekg(archive_marks[i][5]);
         if (archive_marks[i][5] != 0)
-            right_operator_exprs[i] = load_symbolic<S>(ifs);
+            right_operator_exprs[i] =
+                load_symbolic<S>(ifs, archive_pool(archive_marks[i][5]));
         if (ifs.fail() || ifs.bad())
             throw runtime_error("MPO:load_right_operators on '" +
                                 archive_filename + "' failed.");
@@ -378,11 +478,13 @@ template <typename S> struct MPO {
         ifs.clear();
         ifs.seekg(archive_marks[i][3]);
         if (archive_marks[i][3] != 0)
-            middle_operator_names[i] = load_symbolic<S>(ifs);
+            middle_operator_names[i] =
+                load_symbolic<S>(ifs, archive_pool(archive_marks[i][3]));
         ifs.clear();
         ifs.seekg(archive_marks[i][6]);
         if (archive_marks[i][6] != 0)
-            middle_operator_exprs[i] = load_symbolic<S>(ifs);
+            middle_operator_exprs[i] =
+                load_symbolic<S>(ifs, archive_pool(archive_marks[i][6]));
         if (ifs.fail() || ifs.bad())
             throw runtime_error("MPO:load_middle_operators on '" +
                                 archive_filename + "' failed.");
@@ -395,7 +497,109 @@ template <typename S> struct MPO {
             middle_operator_exprs[i] = nullptr;
         }
     }
+    // Start an empty archive file for streaming construction
+    // Per-site data will then be appended by save_tensor, etc.
+    void init_archive(const string &filename) {
+        archive_filename = filename;
+        archive_marks = vector<vector<size_t>>(n_sites + 1, vector<size_t>(7));
+        archive_schemer_mark = 0;
+        op_pool = nullptr;
+        op_pool_end = 0;
+        ofstream ofs(archive_filename.c_str(), ios::binary);
+        if (!ofs.good())
+            throw runtime_error("MPO:init_archive on '" + archive_filename +
+                                "' failed.");
+        // mark zero is used for absent data
+        ofs.write((char *)&n_sites, sizeof(n_sites));
+        ofs.close();
+    }
+    // Append symbolic/tensor data to the archive file
+    // Returns its offset in the file
+    template <typename F> size_t append_archive(F f) const {
+        ofstream ofs(archive_filename.c_str(), ios::binary | ios::app);
+        if (!ofs.good())
+            throw runtime_error("MPO:append_archive on '" + archive_filename +
+                                "' failed.");
+        ofs.seekp(0, ios::end);
+        size_t mark = (size_t)ofs.tellp();
+        f(ofs);
+        if (ofs.fail() || ofs.bad())
+            throw runtime_error("MPO:append_archive on '" + archive_filename +
+                                "' failed.");
+        ofs.close();
+        return mark;
+    }
+    // Archive site tensor and remove it from memory
+    void save_tensor(int i) {
+        if (archive_filename == "")
+            return;
+        assert(i < n_sites && tensors[i] != nullptr);
+        archive_marks[i][0] = append_archive(
+            [this, i](ostream &ofs) { tensors[i]->save_data(ofs); });
+        tensors[i] = nullptr;
+    }
+    void save_schemer() {
+        if (archive_filename == "" || schemer == nullptr)
+            return;
+        archive_schemer_mark =
+            append_archive([this](ostream &ofs) { schemer->save_data(ofs); });
+        schemer->unload_data();
+    }
+    // Archive one site symbolic and remove it from memory
+    // k is the column in archive_marks (1-3: left/right/middle names,
+    // 4-6: left/right/middle exprs); absent data keeps its previous mark
+    void archive_symbolic(vector<shared_ptr<Symbolic<S>>> &syms, int i,
+                          int k) {
+        if (archive_filename == "" || (int)syms.size() <= i ||
+            syms[i] == nullptr)
+            return;
+        archive_marks[i][k] = append_archive(
+            [&syms, i](ostream &ofs) { save_symbolic<S>(syms[i], ofs); });
+        syms[i] = nullptr;
+    }
+    void save_left_operators(int i) {
+        archive_symbolic(left_operator_names, i, 1);
+        archive_symbolic(left_operator_exprs, i, 4);
+    }
+    void save_right_operators(int i) {
+        archive_symbolic(right_operator_names, i, 2);
+        archive_symbolic(right_operator_exprs, i, 5);
+    }
+    void save_middle_operators(int i) {
+        archive_symbolic(middle_operator_names, i, 3);
+        archive_symbolic(middle_operator_exprs, i, 6);
+    }
+    // Read section index at the end of a file written by save_data(filename)
+    // Returns empty vector if there is no index
+    static vector<size_t> load_archive_index(istream &ifs) {
+        vector<size_t> index;
+        const size_t pos = (size_t)ifs.tellg();
+        ifs.seekg(0, ios::end);
+        const size_t end = (size_t)ifs.tellg();
+        size_t mark = 0, n = 0;
+        char magic[8];
+        if (end >= pos + sizeof(mark) + sizeof(magic)) {
+            ifs.seekg(end - sizeof(mark) - sizeof(magic));
+            ifs.read((char *)&mark, sizeof(mark));
+            ifs.read(magic, sizeof(magic));
+            if (memcmp(magic, "MPOINDEX", sizeof(magic)) == 0 && mark > pos &&
+                mark < end) {
+                ifs.seekg(mark);
+                ifs.read((char *)&n, sizeof(n));
+                index.resize(n);
+                ifs.read((char *)index.data(), sizeof(size_t) * n);
+            }
+        }
+        ifs.clear();
+        ifs.seekg(pos);
+        return index;
+    }
     virtual void load_data(istream &ifs, bool minimal = false) {
+        // with section index, only header and basis are read here
+        // and all other data is loaded when visited
+        vector<size_t> index;
+        if (minimal)
+            index = load_archive_index(ifs);
         ifs.read((char *)&n_sites, sizeof(n_sites));
         ifs.read((char *)&const_e, sizeof(const_e));
         sparse_form = string(n_sites, 'N');
@@ -408,17 +612,32 @@ template <typename S> struct MPO {
         else
             tf = make_shared<TensorFunctions<S>>(
                 make_shared<CSROperatorFunctions<S>>(cg));
-        bool has_op, has_schemer;
+        bool has_op;
+        // bit 0: has schemer, bit 1: symbolics use element pool
+        uint8_t has_schemer;
         ifs.read((char *)&has_op, sizeof(has_op));
         ifs.read((char *)&has_schemer, sizeof(has_schemer));
         if (has_op)
             op = dynamic_pointer_cast<OpElement<S>>(load_expr<S>(ifs));
-        if (has_schemer) {
+        op_pool = nullptr;
+        if (has_schemer & 2) {
+            op_pool = make_shared<OpElementPool<S>>();
+            op_pool->load_data(ifs);
+        }
+        if (has_schemer & 1) {
             schemer = make_shared<MPOSchemer<S>>(0, 0);
             if (minimal)
                 archive_schemer_mark = (size_t)ifs.tellg();
-            schemer->load_data(ifs, minimal);
+            if (index.size() != 0) {
+                ifs.read((char *)&schemer->left_trans_site,
+                         sizeof(schemer->left_trans_site));
+                ifs.read((char *)&schemer->right_trans_site,
+                         sizeof(schemer->right_trans_site));
+            } else
+                schemer->load_data(ifs, minimal);
         }
+        if (index.size() != 0)
+            ifs.seekg(index[0]);
         int sz, sub_sz;
         ifs.read((char *)&sz, sizeof(sz));
         site_op_infos.resize(sz);
@@ -438,15 +657,34 @@ template <typename S> struct MPO {
         archive_marks.resize(n_sites + 1);
         for (int i = 0; i <= n_sites; i++)
             archive_marks[i].resize(7);
-        ifs.read((char *)&sz, sizeof(sz));
-        tensors.resize(sz);
-        for (int i = 0; i < sz; i++) {
-            tensors[i] = make_shared<OperatorTensor<S>>();
-            if (minimal)
-                archive_marks[i][0] = (size_t)ifs.tellg();
-            tensors[i]->load_data(ifs);
-            if (minimal)
-                tensors[i] = nullptr;
+        if (index.size() != 0) {
+            vector<shared_ptr<Symbolic<S>>> *syms[6] = {
+                &left_operator_names,  &right_operator_names,
+                &middle_operator_names, &left_operator_exprs,
+                &right_operator_exprs, &middle_operator_exprs};
+            size_t ix = 2;
+            for (int k = 0; k < 7; k++) {
+                sz = (int)index[ix++];
+                assert(sz <= n_sites + 1);
+                if (k == 0)
+                    tensors = vector<shared_ptr<OperatorTensor<S>>>(sz);
+                else
+                    *syms[k - 1] = vector<shared_ptr<Symbolic<S>>>(sz);
+                for (int i = 0; i < sz; i++)
+                    archive_marks[i][k] = index[ix++];
+            }
+            ifs.seekg(index[1]);
+        } else {
+            ifs.read((char *)&sz, sizeof(sz));
+            tensors.resize(sz);
+            for (int i = 0; i < sz; i++) {
+                tensors[i] = make_shared<OperatorTensor<S>>();
+                if (minimal)
+                    archive_marks[i][0] = (size_t)ifs.tellg();
+                tensors[i]->load_data(ifs);
+                if (minimal)
+                    tensors[i] = nullptr;
+            }
         }
         ifs.read((char *)&sz, sizeof(sz));
         basis.resize(sz);
@@ -454,12 +692,14 @@ template <typename S> struct MPO {
             basis[i] = make_shared<StateInfo<S>>();
             basis[i]->load_data(ifs);
         }
+        if (index.size() != 0)
+            return;
         ifs.read((char *)&sz, sizeof(sz));
         left_operator_names.resize(sz);
         for (int i = 0; i < sz; i++) {
             if (minimal)
                 archive_marks[i][1] = (size_t)ifs.tellg();
-            left_operator_names[i] = load_symbolic<S>(ifs);
+            left_operator_names[i] = load_symbolic<S>(ifs, op_pool.get());
             if (minimal)
                 left_operator_names[i] = nullptr;
         }
@@ -468,7 +708,8 @@ template <typename S> struct MPO {
         for (int i = 0; i < sz; i++) {
             if (minimal)
                 archive_marks[i][2] = (size_t)ifs.tellg();
-            right_operator_names[i] = load_symbolic<S>(ifs);
+            right_operator_names[i] =
+                load_symbolic<S>(ifs, op_pool.get());
             if (minimal)
                 right_operator_names[i] = nullptr;
         }
@@ -477,7 +718,8 @@ template <typename S> struct MPO {
         for (int i = 0; i < sz; i++) {
             if (minimal)
                 archive_marks[i][3] = (size_t)ifs.tellg();
-            middle_operator_names[i] = load_symbolic<S>(ifs);
+            middle_operator_names[i] =
+                load_symbolic<S>(ifs, op_pool.get());
             if (minimal)
                 middle_operator_names[i] = nullptr;
         }
@@ -486,7 +728,8 @@ template <typename S> struct MPO {
         for (int i = 0; i < sz; i++) {
             if (minimal)
                 archive_marks[i][4] = (size_t)ifs.tellg();
-            left_operator_exprs[i] = load_symbolic<S>(ifs);
+            left_operator_exprs[i] =
+                load_symbolic<S>(ifs, op_pool.get());
             if (minimal)
                 left_operator_exprs[i] = nullptr;
         }
@@ -495,7 +738,8 @@ template <typename S> struct MPO {
         for (int i = 0; i < sz; i++) {
             if (minimal)
                 archive_marks[i][5] = (size_t)ifs.tellg();
-            right_operator_exprs[i] = load_symbolic<S>(ifs);
+            right_operator_exprs[i] =
+                load_symbolic<S>(ifs, op_pool.get());
             if (minimal)
                 right_operator_exprs[i] = nullptr;
         }
@@ -504,10 +748,14 @@ template <typename S> struct MPO {
         for (int i = 0; i < sz; i++) {
             if (minimal)
                 archive_marks[i][6] = (size_t)ifs.tellg();
-            middle_operator_exprs[i] = load_symbolic<S>(ifs);
+            middle_operator_exprs[i] =
+                load_symbolic<S>(ifs, op_pool.get());
             if (minimal)
                 middle_operator_exprs[i] = nullptr;
         }
+        // loaded elements are already shared by the symbolics
+        if (!minimal)
+            op_pool = nullptr;
     }
     void load_data(const string &filename, bool minimal = false) {
         if (minimal)
@@ -518,20 +766,44 @@ template <typename S> struct MPO {
         load_data(ifs, minimal);
         if (ifs.fail() || ifs.bad())
             throw runtime_error("MPO:load_data on '" + filename + "' failed.");
+        if (minimal) {
+            ifs.seekg(0, ios::end);
+            op_pool_end = (size_t)ifs.tellg();
+        }
         ifs.close();
     }
-    virtual void save_data(ostream &ofs) const {
+    virtual void save_data(ostream &ofs) const { save_data(ofs, nullptr); }
+    // If index is not nullptr, file offsets of site operator infos, basis
+    // and each site tensor and symbolic will be stored in index
+    void save_data(ostream &ofs, vector<size_t> *index) const {
         assert(archive_filename == "");
+        // offsets of tensors, left/right/middle names and exprs
+        vector<size_t> marks[7];
+        size_t sop_mark, basis_mark;
         ofs.write((char *)&n_sites, sizeof(n_sites));
         ofs.write((char *)&const_e, sizeof(const_e));
         ofs.write((char *)&sparse_form[0], sizeof(char) * n_sites);
-        bool has_op = op != nullptr, has_schemer = schemer != nullptr;
+        bool has_op = op != nullptr;
+        uint8_t has_schemer = (uint8_t)(schemer != nullptr) | 2;
         ofs.write((char *)&has_op, sizeof(has_op));
         ofs.write((char *)&has_schemer, sizeof(has_schemer));
         if (has_op)
             save_expr<S>(op, ofs);
-        if (has_schemer)
+        const vector<shared_ptr<Symbolic<S>>> *syms[6] = {
+            &left_operator_names,  &right_operator_names,
+            &middle_operator_names, &left_operator_exprs,
+            &right_operator_exprs, &middle_operator_exprs};
+        // collect the element pool before the symbolics, so that the
+        // file can be read sequentially
+        OpElementPool<S> pool;
+        ostream null_ofs(nullptr);
+        for (int k = 0; k < 6; k++)
+            for (auto &x : *syms[k])
+                save_symbolic<S>(x, null_ofs, &pool);
+        pool.save_data(ofs);
+        if (has_schemer & 1)
             schemer->save_data(ofs);
+        sop_mark = (size_t)ofs.tellp();
         int sz = (int)site_op_infos.size();
         ofs.write((char *)&sz, sizeof(sz));
         for (int i = 0; i < sz; i++) {
@@ -546,42 +818,46 @@ template <typename S> struct MPO {
         }
         sz = (int)tensors.size();
         ofs.write((char *)&sz, sizeof(sz));
-        for (int i = 0; i < sz; i++)
+        for (int i = 0; i < sz; i++) {
+            marks[0].push_back((size_t)ofs.tellp());
             tensors[i]->save_data(ofs);
+        }
+        basis_mark = (size_t)ofs.tellp();
         sz = (int)basis.size();
         ofs.write((char *)&sz, sizeof(sz));
         for (int i = 0; i < sz; i++)
             basis[i]->save_data(ofs);
-        sz = (int)left_operator_names.size();
-        ofs.write((char *)&sz, sizeof(sz));
-        for (int i = 0; i < sz; i++)
-            save_symbolic<S>(left_operator_names[i], ofs);
-        sz = (int)right_operator_names.size();
-        ofs.write((char *)&sz, sizeof(sz));
-        for (int i = 0; i < sz; i++)
-            save_symbolic<S>(right_operator_names[i], ofs);
-        sz = (int)middle_operator_names.size();
-        ofs.write((char *)&sz, sizeof(sz));
-        for (int i = 0; i < sz; i++)
-            save_symbolic<S>(middle_operator_names[i], ofs);
-        sz = (int)left_operator_exprs.size();
-        ofs.write((char *)&sz, sizeof(sz));
-        for (int i = 0; i < sz; i++)
-            save_symbolic<S>(left_operator_exprs[i], ofs);
-        sz = (int)right_operator_exprs.size();
-        ofs.write((char *)&sz, sizeof(sz));
-        for (int i = 0; i < sz; i++)
-            save_symbolic<S>(right_operator_exprs[i], ofs);
-        sz = (int)middle_operator_exprs.size();
-        ofs.write((char *)&sz, sizeof(sz));
-        for (int i = 0; i < sz; i++)
-            save_symbolic<S>(middle_operator_exprs[i], ofs);
+        for (int k = 0; k < 6; k++) {
+            sz = (int)syms[k]->size();
+            ofs.write((char *)&sz, sizeof(sz));
+            for (int i = 0; i < sz; i++) {
+                marks[k + 1].push_back((size_t)ofs.tellp());
+                save_symbolic<S>((*syms[k])[i], ofs, &pool);
+            }
+        }
+        if (index != nullptr) {
+            index->clear();
+            index->push_back(sop_mark);
+            index->push_back(basis_mark);
+            for (int k = 0; k < 7; k++) {
+                index->push_back(marks[k].size());
+                index->insert(index->end(), marks[k].begin(), marks[k].end());
+            }
+        }
     }
     void save_data(const string &filename) const {
         ofstream ofs(filename.c_str(), ios::binary);
         if (!ofs.good())
             throw runtime_error("MPO:save_data on '" + filename + "' failed.");
-        save_data(ofs);
+        vector<size_t> index;
+        save_data(ofs, &index);
+        // section index for lazy loading, placed after all data
+        // so that the file can still be read sequentially
+        size_t mark = (size_t)ofs.tellp(), n = index.size();
+        ofs.write((char *)&n, sizeof(n));
+        ofs.write((char *)index.data(), sizeof(size_t) * n);
+        ofs.write((char *)&mark, sizeof(mark));
+        ofs.write("MPOINDEX", 8);
         if (!ofs.good())
             throw runtime_error("MPO:save_data on '" + filename + "' failed.");
         ofs.close();
@@ -593,6 +869,64 @@ template <typename S> struct MPO {
         for (int i = 1; i < n_sites - 1; i++)
             tensors[i]->lmat = tensors[i]->rmat = 0;
     }
+    // Choose CSR or dense storage for each site operator separately
+    // Operators with ratio of zero elements above sparsity are stored as CSR
+    // others in the same site are kept dense as wrapped CSR matrices
+    // Sites without sparse operators stay in Normal form
+    // Returns number of operators converted to CSR
+    size_t auto_sparse_form(double sparsity) {
+        size_t n_csr = 0;
+        for (int m = 0; m < n_sites; m++) {
+            load_tensor(m);
+            bool has_sparse = false;
+            for (auto &op : tensors[m]->ops)
+                if (op.second->get_type() == SparseMatrixTypes::CSR ||
+                    (op.second->total_memory != 0 &&
+                     op.second->sparsity() > sparsity)) {
+                    has_sparse = true;
+                    break;
+                }
+            if (!has_sparse) {
+                unload_tensor(m);
+                continue;
+            }
+            for (auto &op : tensors[m]->ops) {
+                if (op.second->get_type() != SparseMatrixTypes::Normal)
+                    continue;
+                shared_ptr<CSRSparseMatrix<S>> smat =
+                    make_shared<CSRSparseMatrix<S>>();
+                // operators shared with other sites are released by their
+                // other owners; unshared stack memory cannot be released
+                // out of order, so such operators are kept dense
+                bool shared = op.second.use_count() != 1;
+                bool heap = dynamic_pointer_cast<VectorAllocator<double>>(
+                                op.second->alloc) != nullptr;
+                if (op.second->total_memory != 0 &&
+                    op.second->sparsity() > sparsity && (shared || heap)) {
+                    smat->from_dense(op.second);
+                    if (!shared)
+                        op.second->deallocate();
+                    n_csr++;
+                } else {
+                    smat->wrap_dense(op.second);
+                    if (shared)
+                        smat->alloc = nullptr;
+                }
+                op.second = smat;
+            }
+            sparse_form[m] = 'S';
+            save_tensor(m);
+        }
+        if (tf != nullptr && sparse_form.find('S') != string::npos &&
+            tf->opf->get_type() == SparseMatrixTypes::Normal) {
+            shared_ptr<OperatorFunctions<S>> opf =
+                make_shared<CSROperatorFunctions<S>>(tf->opf->cg);
+            opf->seq = tf->opf->seq;
+            tf = tf->copy();
+            tf->opf = opf;
+        }
+        return n_csr;
+    }
     shared_ptr<MPO<S>> deep_copy() const {
         stringstream ss;
         save_data(ss);
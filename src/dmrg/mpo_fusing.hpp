@@ -173,6 +173,89 @@ template <typename S> struct FusedMPO : MPO<S> {
         if (this->schemer != nullptr && this->schemer->right_trans_site >= b)
             this->schemer->right_trans_site--;
     }
+    // Estimated number of doubles for storing all operators
+    // of a fused edge site (dense blocks, delta quantum ignored)
+    static size_t estimated_op_size(const shared_ptr<StateInfo<S>> &fused,
+                                    size_t n_ops) {
+        size_t sz = 0;
+        for (int i = 0; i < fused->n; i++)
+            sz += (size_t)fused->n_states[i] * fused->n_states[i];
+        return sz * n_ops;
+    }
+    // Choose how many edge sites to fuse at each end (n_extl, n_extr)
+    // A site is added to an edge block only when the fused basis dimension
+    // does not exceed max_bond_dim (so the MPS bond is not truncated there
+    // and no accuracy is lost), and the estimated operator storage of the
+    // fused site does not exceed max_op_size
+    // At least min_sites sites are kept in the fused MPO
+    static pair<int, int> plan_edge_fusion(const shared_ptr<MPO<S>> &mpo,
+                                           const shared_ptr<MPSInfo<S>> &info,
+                                           ubond_t max_bond_dim,
+                                           size_t max_op_size,
+                                           int min_sites = 4) {
+        const int n = mpo->n_sites;
+        assert(info->n_sites == n);
+        vector<shared_ptr<StateInfo<S>>> tmps;
+        int n_extl = 1, n_extr = 1;
+        shared_ptr<StateInfo<S>> cur = info->basis[0];
+        for (int k = 1; n - (n_extl + 1) - n_extr + 2 >= min_sites; k++) {
+            if (mpo->tensors[k - 1]->lmat != mpo->tensors[k - 1]->rmat ||
+                mpo->tensors[k]->lmat != mpo->tensors[k]->rmat)
+                break;
+            shared_ptr<StateInfo<S>> fused = make_shared<StateInfo<S>>(
+                StateInfo<S>::tensor_product(*cur, *info->basis[k],
+                                             *info->left_dims_fci[k + 1]));
+            tmps.push_back(fused);
+            if (fused->n_states_total > max_bond_dim ||
+                estimated_op_size(fused,
+                                  mpo->left_operator_names[k]->data.size()) >
+                    max_op_size)
+                break;
+            cur = fused, n_extl++;
+        }
+        cur = info->basis[n - 1];
+        for (int k = n - 2; n - n_extl - (n_extr + 1) + 2 >= min_sites; k--) {
+            if (mpo->tensors[k + 1]->lmat != mpo->tensors[k + 1]->rmat ||
+                mpo->tensors[k]->lmat != mpo->tensors[k]->rmat)
+                break;
+            shared_ptr<StateInfo<S>> fused = make_shared<StateInfo<S>>(
+                StateInfo<S>::tensor_product(*info->basis[k], *cur,
+                                             *info->right_dims_fci[k]));
+            tmps.push_back(fused);
+            if (fused->n_states_total > max_bond_dim ||
+                estimated_op_size(fused,
+                                  mpo->right_operator_names[k]->data.size()) >
+                    max_op_size)
+                break;
+            cur = fused, n_extr++;
+        }
+        for (int i = (int)tmps.size() - 1; i >= 0; i--)
+            tmps[i]->deallocate();
+        return make_pair(n_extl, n_extr);
+    }
+    // Fuse the first n_extl and the last n_extr sites into one site each
+    // The fused bases are projected onto the quanta in info (if not nullptr)
+    // basis is updated to the basis of the returned MPO
+    static shared_ptr<MPO<S>>
+    fuse_edges(shared_ptr<MPO<S>> mpo, vector<shared_ptr<StateInfo<S>>> &basis,
+               int n_extl, int n_extr,
+               const shared_ptr<MPSInfo<S>> &info = nullptr) {
+        for (int i = 0; i < n_extl - 1; i++) {
+            mpo = make_shared<FusedMPO<S>>(
+                mpo, basis, 0, 1,
+                info == nullptr ? nullptr : info->left_dims_fci[i + 2]);
+            basis = mpo->basis;
+        }
+        for (int i = 0; i < n_extr - 1; i++) {
+            mpo = make_shared<FusedMPO<S>>(
+                mpo, basis, mpo->n_sites - 2, mpo->n_sites - 1,
+                info == nullptr ? nullptr
+                                : info->right_dims_fci[mpo->n_sites - 2 +
+                                                       n_extl - 1]);
+            basis = mpo->basis;
+        }
+        return mpo;
+    }
     AncillaTypes get_ancilla_type() const override { return ancilla_type; }
     void deallocate() override {
         for (int16_t m = this->n_sites - 1; m >= 0; m--)
@@ -74,6 +74,24 @@ template <typename S> struct SimplifiedMPO : MPO<S> {
             x = x->copy();
         MPO<S>::left_operator_exprs.resize(MPO<S>::n_sites);
         MPO<S>::right_operator_exprs.resize(MPO<S>::n_sites);
+        // if site tensors of the original mpo are archived (streaming
+        // construction), exprs are archived one site at a time in the
+        // same file, only operator names and the two boundary sites are
+        // kept in memory
+        const bool stream = mpo->archive_filename != "";
+        if (stream) {
+            MPO<S>::archive_filename = mpo->archive_filename;
+            MPO<S>::archive_marks = mpo->archive_marks;
+            for (auto &mk : MPO<S>::archive_marks)
+                for (int k = 1; k < 7; k++)
+                    mk[k] = 0;
+            MPO<S>::load_tensor(0);
+            MPO<S>::load_tensor(MPO<S>::n_sites - 1);
+        }
+        // a site in the middle that can be loaded and archived
+        auto streamed = [stream, this](int i) {
+            return stream && i != 0 && i != MPO<S>::n_sites - 1;
+        };
         // for comp operators created in the middle site,
         // if all integrals related to the comp operators are zero,
         // label this comp operator as zero
@@ -113,6 +131,8 @@ template <typename S> struct SimplifiedMPO : MPO<S> {
         int ntg = threading->activate_global();
         // left blocking
         for (int i = 0; i < MPO<S>::n_sites; i++) {
+            if (streamed(i))
+                MPO<S>::load_tensor(i);
             if (i == 0) {
                 MPO<S>::tensors[i] = MPO<S>::tensors[i]->copy();
                 if (MPO<S>::tensors[i]->lmat == MPO<S>::tensors[i]->rmat)
@@ -155,9 +175,15 @@ template <typename S> struct SimplifiedMPO : MPO<S> {
                         MPO<S>::left_operator_names[i]->data[j] =
                             MPO<S>::left_operator_exprs[i]->data[j];
             }
+            if (streamed(i)) {
+                MPO<S>::archive_symbolic(MPO<S>::left_operator_exprs, i, 4);
+                MPO<S>::unload_tensor(i);
+            }
         }
         // right blocking
         for (int i = MPO<S>::n_sites - 1; i >= 0; i--) {
+            if (streamed(i))
+                MPO<S>::load_tensor(i);
             if (i == MPO<S>::n_sites - 1) {
                 MPO<S>::tensors[i] = MPO<S>::tensors[i]->copy();
                 if (MPO<S>::tensors[i]->lmat == MPO<S>::tensors[i]->rmat)
@@ -200,6 +226,10 @@ template <typename S> struct SimplifiedMPO : MPO<S> {
                         MPO<S>::right_operator_names[i]->data[j] =
                             MPO<S>::right_operator_exprs[i]->data[j];
             }
+            if (streamed(i)) {
+                MPO<S>::archive_symbolic(MPO<S>::right_operator_exprs, i, 5);
+                MPO<S>::unload_tensor(i);
+            }
         }
         // construct super blocking contraction formula
         // first case is that the blocking formula is already given
@@ -207,7 +237,7 @@ template <typename S> struct SimplifiedMPO : MPO<S> {
         if (mpo->middle_operator_exprs.size() != 0) {
             MPO<S>::middle_operator_names = mpo->middle_operator_names;
             MPO<S>::middle_operator_exprs = mpo->middle_operator_exprs;
-            assert(MPO<S>::schemer == nullptr);
+            assert(MPO<S>::schemer == nullptr && !stream);
             // if some operators are erased in left/right operator names
             // they should not appear in middle operator exprs
             // and the expr should be zero
@@ -263,6 +293,8 @@ template <typename S> struct SimplifiedMPO : MPO<S> {
             // figure out the mutual dependence of from right to left
             // px[.][j] is 1 if left operator is useful in next blocking
             for (int i = MPO<S>::n_sites - 1; i >= 0; i--) {
+                if (streamed(i))
+                    MPO<S>::load_tensor(i);
                 if (i != MPO<S>::n_sites - 1) {
                     // if a left operator is not useful in next blocking
                     // and not useful in super block
@@ -397,9 +429,13 @@ template <typename S> struct SimplifiedMPO : MPO<S> {
                                 px[!(i & 1)][mat->indices[j].first] = 1;
                     }
                 }
+                if (streamed(i))
+                    MPO<S>::unload_tensor(i);
             }
             // figure out the mutual dependence of from left to right
             for (int i = 0; i < MPO<S>::n_sites; i++) {
+                if (streamed(i))
+                    MPO<S>::load_tensor(i);
                 if (i != 0) {
                     if (MPO<S>::schemer == nullptr ||
                         i != MPO<S>::schemer->right_trans_site) {
@@ -526,12 +562,15 @@ template <typename S> struct SimplifiedMPO : MPO<S> {
                                 px[!(i & 1)][mat->indices[j].second] = 1;
                     }
                 }
+                if (streamed(i))
+                    MPO<S>::unload_tensor(i);
             }
             MPO<S>::middle_operator_names.resize(MPO<S>::n_sites - 1);
             MPO<S>::middle_operator_exprs.resize(MPO<S>::n_sites - 1);
             shared_ptr<SymbolicColumnVector<S>> mpo_op =
                 make_shared<SymbolicColumnVector<S>>(1);
             (*mpo_op)[0] = mpo->op;
+#pragma omp parallel for schedule(dynamic) num_threads(stream ? ntg : 1)
             for (int i = 0; i < MPO<S>::n_sites - 1; i++) {
                 MPO<S>::middle_operator_names[i] = mpo_op;
                 if (MPO<S>::schemer == nullptr ||
@@ -547,9 +586,33 @@ template <typename S> struct SimplifiedMPO : MPO<S> {
                         (shared_ptr<Symbolic<S>>)
                             MPO<S>::schemer->left_new_operator_names *
                         MPO<S>::right_operator_names[i + 1];
+                // in streaming mode, middle exprs are simplified here
+                // since operator names will be compressed in simplify
+                if (stream) {
+                    shared_ptr<Symbolic<S>> mexpr =
+                        MPO<S>::middle_operator_exprs[i];
+                    for (size_t j = 0; j < mexpr->data.size(); j++)
+                        mexpr->data[j] = simplify_expr(mexpr->data[j]);
+                    intern_symbolics({mexpr});
+#pragma omp critical
+                    MPO<S>::save_middle_operators(i);
+                }
             }
         }
         simplify();
+        if (stream) {
+            MPO<S>::save_tensor(0);
+            if (MPO<S>::n_sites > 1)
+                MPO<S>::save_tensor(MPO<S>::n_sites - 1);
+            intern_symbolics({MPO<S>::schemer == nullptr
+                                  ? nullptr
+                                  : MPO<S>::schemer->left_new_operator_exprs,
+                              MPO<S>::schemer == nullptr
+                                  ? nullptr
+                                  : MPO<S>::schemer->right_new_operator_exprs});
+            MPO<S>::save_schemer();
+        } else
+            intern_exprs();
         threading->activate_normal();
     }
     shared_ptr<OpExpr<S>> simplify_expr(const shared_ptr<OpExpr<S>> &expr,
@@ -595,7 +658,10 @@ template <typename S> struct SimplifiedMPO : MPO<S> {
                 vector<shared_ptr<OpProduct<S>>> &px = mp.at(a);
                 int g = -1;
                 for (size_t k = 0; k < px.size(); k++)
-                    if (px[k]->b == b && px[k]->conj == conj) {
+                    if ((px[k]->b == b ||
+                         (b != nullptr && px[k]->b != nullptr &&
+                          *px[k]->b == *b)) &&
+                        px[k]->conj == conj) {
                         g = (int)k;
                         break;
                     }
@@ -857,14 +923,30 @@ template <typename S> struct SimplifiedMPO : MPO<S> {
                 return this->left_operator_names[i]->data.size() >
                        this->left_operator_names[j]->data.size();
             });
+        const bool stream = MPO<S>::archive_filename != "";
 #pragma omp parallel for schedule(dynamic) num_threads(ntg)
         for (int ii = 0; ii < MPO<S>::n_sites; ii++) {
             int i = gidx[ii];
+            if (stream) {
+                // only exprs are archived at this point
+                MPO<S>::load_left_operators(i);
+                MPO<S>::load_right_operators(i);
+            }
             simplify_symbolic(MPO<S>::left_operator_names[i],
                               MPO<S>::left_operator_exprs[i]);
             simplify_symbolic(MPO<S>::right_operator_names[i],
                               MPO<S>::right_operator_exprs[i]);
-            if (i < MPO<S>::n_sites - 1) {
+            if (stream) {
+                intern_symbolics({MPO<S>::left_operator_names[i],
+                                  MPO<S>::right_operator_names[i],
+                                  MPO<S>::left_operator_exprs[i],
+                                  MPO<S>::right_operator_exprs[i]});
+#pragma omp critical
+                {
+                    MPO<S>::save_left_operators(i);
+                    MPO<S>::save_right_operators(i);
+                }
+            } else if (i < MPO<S>::n_sites - 1) {
                 shared_ptr<Symbolic<S>> mexpr =
                     MPO<S>::middle_operator_exprs[i];
                 for (size_t j = 0; j < mexpr->data.size(); j++)
@@ -872,6 +954,38 @@ template <typename S> struct SimplifiedMPO : MPO<S> {
             }
         }
     }
+    // Share equal operator and product nodes within the given symbolics
+    void intern_symbolics(const vector<shared_ptr<Symbolic<S>>> &xs) const {
+        OpExprInterner<S> interner;
+        for (auto &x : xs)
+            if (x != nullptr)
+                for (auto &r : x->data)
+                    r = interner.intern(r);
+    }
+    // Share equal operator and product nodes among the expressions of all
+    // sites, so that repeated subexpressions are stored once
+    void intern_exprs() {
+        OpExprInterner<S> interner;
+        auto intern = [&interner](const shared_ptr<Symbolic<S>> &x) {
+            if (x != nullptr)
+                for (auto &r : x->data)
+                    r = interner.intern(r);
+        };
+        for (int i = 0; i < MPO<S>::n_sites; i++) {
+            intern(MPO<S>::left_operator_names[i]);
+            intern(MPO<S>::right_operator_names[i]);
+            intern(MPO<S>::left_operator_exprs[i]);
+            intern(MPO<S>::right_operator_exprs[i]);
+        }
+        for (size_t i = 0; i < MPO<S>::middle_operator_exprs.size(); i++)
+            intern(MPO<S>::middle_operator_exprs[i]);
+        if (MPO<S>::schemer != nullptr) {
+            intern(MPO<S>::schemer->left_new_operator_names);
+            intern(MPO<S>::schemer->left_new_operator_exprs);
+            intern(MPO<S>::schemer->right_new_operator_names);
+            intern(MPO<S>::schemer->right_new_operator_exprs);
+        }
+    }
     AncillaTypes get_ancilla_type() const override {
         return prim_mpo->get_ancilla_type();
     }
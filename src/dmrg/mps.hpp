@@ -759,6 +759,7 @@ template <typename S> struct MPSInfo {
         return ss.str();
     }
     void shallow_copy_to(const shared_ptr<MPSInfo<S>> &info) const {
+        frame->wait_save_files();
         if (frame->prefix_can_write)
             for (int i = 0; i < n_sites + 1; i++) {
                 Parsing::link_file(get_filename(true, i),
@@ -781,6 +782,7 @@ template <typename S> struct MPSInfo {
         return info;
     }
     void copy_mutable(const string &dir) const {
+        frame->wait_save_files();
         if (frame->prefix_can_write) {
             for (int i = 0; i < n_sites + 1; i++) {
                 Parsing::copy_file(get_filename(true, i),
@@ -792,6 +794,7 @@ template <typename S> struct MPSInfo {
         }
     }
     void save_mutable() const {
+        frame->wait_save_files();
         if (frame->prefix_can_write)
             for (int i = 0; i < n_sites + 1; i++) {
                 left_dims[i]->save_data(get_filename(true, i));
@@ -799,10 +802,12 @@ template <typename S> struct MPSInfo {
             }
     }
     void load_mutable_left() const {
+        frame->wait_save_files();
         for (int i = 0; i <= n_sites; i++)
             left_dims[i]->load_data(get_filename(true, i));
     }
     void load_mutable_right() const {
+        frame->wait_save_files();
         for (int i = n_sites; i >= 0; i--)
             right_dims[i]->load_data(get_filename(false, i));
     }
@@ -816,18 +821,29 @@ template <typename S> struct MPSInfo {
         for (int i = n_sites; i >= 0; i--)
             left_dims[i]->deallocate();
     }
+    void save_dims(const shared_ptr<StateInfo<S>> &dims,
+                   const string &filename) const {
+        if (frame->async_mps_save) {
+            shared_ptr<stringstream> ss = make_shared<stringstream>();
+            dims->save_data(*ss);
+            frame->save_file_async(filename, ss);
+        } else
+            dims->save_data(filename);
+    }
     void save_left_dims(int i) const {
         if (frame->prefix_can_write)
-            left_dims[i]->save_data(get_filename(true, i));
+            save_dims(left_dims[i], get_filename(true, i));
     }
     void save_right_dims(int i) const {
         if (frame->prefix_can_write)
-            right_dims[i]->save_data(get_filename(false, i));
+            save_dims(right_dims[i], get_filename(false, i));
     }
     void load_left_dims(int i) {
+        frame->wait_save_file(get_filename(true, i));
         left_dims[i]->load_data(get_filename(true, i));
     }
     void load_right_dims(int i) {
+        frame->wait_save_file(get_filename(false, i));
         right_dims[i]->load_data(get_filename(false, i));
     }
     void deallocate_left() {
@@ -1150,7 +1166,9 @@ template <typename S> struct MRCIMPSInfo : MPSInfo<S> {
         // restrictions
         MPSInfo<S>::set_bond_dimension_full_fci(left_vacuum, right_vacuum);
         // Restrict left_dims_fci
-        for (int i = 0; i < n_inactive; ++i) {
+        // left_dims_fci[i] describes sites [0, i), so the last restricted
+        // bond is the one enclosing all inactive orbitals
+        for (int i = 1; i <= n_inactive; ++i) {
             auto &state_info = left_dims_fci[i];
             int max_n = 0;
             for (int q = 0; q < state_info->n; ++q)
@@ -1160,14 +1178,27 @@ template <typename S> struct MRCIMPSInfo : MPSInfo<S> {
                 if (state_info->quanta[q].n() < max_n - ci_order ||
                     state_info->quanta[q].twos() > ci_order)
                     state_info->n_states[q] = 0;
+            state_info->collect();
         }
+        // Quanta beyond the inactive space can only be reached through the
+        // restricted bonds. Rebuilding them avoids allocating wavefunction
+        // blocks that are zero by the excitation constraint.
+        for (int i = n_inactive; i < n_sites && n_inactive != 0; i++)
+            left_dims_fci[i + 1] =
+                make_shared<StateInfo<S>>(StateInfo<S>::tensor_product(
+                    *left_dims_fci[i], *basis[i], target));
         // Restrict right_dims_fci
         for (int i = n_sites - n_external; i < n_sites; ++i) {
             auto &state_info = right_dims_fci[i];
             for (int q = 0; q < state_info->n; ++q)
                 if (state_info->quanta[q].n() > ci_order)
                     state_info->n_states[q] = 0;
+            state_info->collect();
         }
+        for (int i = n_sites - n_external - 1; i >= 0 && n_external != 0; i--)
+            right_dims_fci[i] =
+                make_shared<StateInfo<S>>(StateInfo<S>::tensor_product(
+                    *basis[i], *right_dims_fci[i + 1], target));
     }
     shared_ptr<MPSInfo<S>> shallow_copy(const string &new_tag) const override {
         shared_ptr<MPSInfo<S>> info = make_shared<MRCIMPSInfo<S>>(*this);
@@ -1315,77 +1346,81 @@ template <typename S> struct MPS {
             }
         return vector<size_t>{peak * 8, total * 8};
     }
-    void initialize_left(const shared_ptr<MPSInfo<S>> &info, int i_right) {
+    // Allocate the tensor at site i only, with the shape given by the
+    // canonical form ``form`` ('L', 'R', 'K', 'S', or 'C' for the center)
+    // This allows large MPS to be filled and saved one site at a time
+    void initialize_tensor(const shared_ptr<MPSInfo<S>> &info, int i,
+                           char form) {
         shared_ptr<VectorAllocator<uint32_t>> i_alloc =
             make_shared<VectorAllocator<uint32_t>>();
         shared_ptr<VectorAllocator<double>> d_alloc =
             make_shared<VectorAllocator<double>>();
         this->info = info;
-        vector<shared_ptr<SparseMatrixInfo<S>>> mat_infos;
-        mat_infos.resize(n_sites);
         tensors.resize(n_sites);
-        for (int i = 0; i <= i_right; i++) {
+        shared_ptr<SparseMatrixInfo<S>> mat_info =
+            make_shared<SparseMatrixInfo<S>>(i_alloc);
+        if (form == 'C' && dot == 1)
+            form = 'K';
+        if (form == 'L') {
             StateInfo<S> t = StateInfo<S>::tensor_product(
                 *info->left_dims[i], *info->basis[i],
                 *info->left_dims_fci[i + 1]);
-            mat_infos[i] = make_shared<SparseMatrixInfo<S>>(i_alloc);
-            mat_infos[i]->initialize(t, *info->left_dims[i + 1], info->vacuum,
-                                     false);
-            tensors[i] = make_shared<SparseMatrix<S>>(d_alloc);
-            tensors[i]->allocate(mat_infos[i]);
-        }
+            mat_info->initialize(t, *info->left_dims[i + 1], info->vacuum,
+                                 false);
+        } else if (form == 'R') {
+            StateInfo<S> t = StateInfo<S>::tensor_product(
+                *info->basis[i], *info->right_dims[i + 1],
+                *info->right_dims_fci[i]);
+            mat_info->initialize(*info->right_dims[i], t, info->vacuum,
+                                 false);
+        } else if (form == 'K') {
+            StateInfo<S> t = StateInfo<S>::tensor_product(
+                *info->left_dims[i], *info->basis[i],
+                *info->left_dims_fci[i + 1]);
+            mat_info->initialize(t, *info->right_dims[i + 1], info->target,
+                                 false, true);
+        } else if (form == 'S') {
+            StateInfo<S> t = StateInfo<S>::tensor_product(
+                *info->basis[i], *info->right_dims[i + 1],
+                *info->right_dims_fci[i]);
+            mat_info->initialize(*info->left_dims[i], t, info->target, false,
+                                 true);
+        } else if (form == 'C') {
+            StateInfo<S> tl = StateInfo<S>::tensor_product(
+                *info->left_dims[i], *info->basis[i],
+                *info->left_dims_fci[i + 1]);
+            StateInfo<S> tr = StateInfo<S>::tensor_product(
+                *info->basis[i + 1], *info->right_dims[i + 2],
+                *info->right_dims_fci[i + 1]);
+            mat_info->initialize(tl, tr, info->target, false, true);
+        } else
+            throw runtime_error("MPS::initialize_tensor: unknown form " +
+                                string(1, form));
+        tensors[i] = make_shared<SparseMatrix<S>>(d_alloc);
+        tensors[i]->allocate(mat_info);
+    }
+    void initialize_left(const shared_ptr<MPSInfo<S>> &info, int i_right) {
+        this->info = info;
+        tensors.resize(n_sites);
+        for (int i = 0; i <= i_right; i++)
+            initialize_tensor(info, i, 'L');
     }
     void initialize_right(const shared_ptr<MPSInfo<S>> &info, int i_left) {
-        shared_ptr<VectorAllocator<uint32_t>> i_alloc =
-            make_shared<VectorAllocator<uint32_t>>();
-        shared_ptr<VectorAllocator<double>> d_alloc =
-            make_shared<VectorAllocator<double>>();
         this->info = info;
-        vector<shared_ptr<SparseMatrixInfo<S>>> mat_infos;
-        mat_infos.resize(n_sites);
         tensors.resize(n_sites);
-        for (int i = i_left; i < n_sites; i++) {
-            StateInfo<S> t = StateInfo<S>::tensor_product(
-                *info->basis[i], *info->right_dims[i + 1],
-                *info->right_dims_fci[i]);
-            mat_infos[i] = make_shared<SparseMatrixInfo<S>>(i_alloc);
-            mat_infos[i]->initialize(*info->right_dims[i], t, info->vacuum,
-                                     false);
-            tensors[i] = make_shared<SparseMatrix<S>>(d_alloc);
-            tensors[i]->allocate(mat_infos[i]);
-        }
+        for (int i = i_left; i < n_sites; i++)
+            initialize_tensor(info, i, 'R');
     }
     virtual void initialize(const shared_ptr<MPSInfo<S>> &info,
                             bool init_left = true, bool init_right = true) {
-        shared_ptr<VectorAllocator<uint32_t>> i_alloc =
-            make_shared<VectorAllocator<uint32_t>>();
-        shared_ptr<VectorAllocator<double>> d_alloc =
-            make_shared<VectorAllocator<double>>();
         this->info = info;
-        shared_ptr<SparseMatrixInfo<S>> mat_info;
         tensors.resize(n_sites);
         if (init_left)
             initialize_left(info, center - 1);
         if (center >= 0 && center < n_sites && (init_left || init_right)) {
-            mat_info = make_shared<SparseMatrixInfo<S>>(i_alloc);
-            if (dot == 1) {
-                StateInfo<S> t = StateInfo<S>::tensor_product(
-                    *info->left_dims[center], *info->basis[center],
-                    *info->left_dims_fci[center + dot]);
-                mat_info->initialize(t, *info->right_dims[center + dot],
-                                     info->target, false, true);
+            if (dot == 1)
                 canonical_form[center] = 'K';
-            } else {
-                StateInfo<S> tl = StateInfo<S>::tensor_product(
-                    *info->left_dims[center], *info->basis[center],
-                    *info->left_dims_fci[center + 1]);
-                StateInfo<S> tr = StateInfo<S>::tensor_product(
-                    *info->basis[center + 1], *info->right_dims[center + dot],
-                    *info->right_dims_fci[center + 1]);
-                mat_info->initialize(tl, tr, info->target, false, true);
-            }
-            tensors[center] = make_shared<SparseMatrix<S>>(d_alloc);
-            tensors[center]->allocate(mat_info);
+            initialize_tensor(info, center, 'C');
         }
         if (init_right)
             initialize_right(info, center + dot);
@@ -1833,6 +1868,169 @@ template <typename S> struct MPS {
             left->deallocate();
         }
     }
+    // remove bond quanta whose MPS blocks have (near) zero norm
+    // and shrink left_dims/right_dims accordingly
+    // the center tensor must be fused as in dynamic_canonicalize
+    // returns the number of removed quanta
+    int compact(double cutoff = 1E-14) {
+        shared_ptr<VectorAllocator<uint32_t>> i_alloc =
+            make_shared<VectorAllocator<uint32_t>>();
+        shared_ptr<VectorAllocator<double>> d_alloc =
+            make_shared<VectorAllocator<double>>();
+        if (dot == 1 && center >= 0 && center < n_sites &&
+            tensors[center] != nullptr)
+            assert(canonical_form[center] == 'K');
+        // bond quanta having a large enough block in mat
+        auto kept_states = [cutoff](const shared_ptr<SparseMatrix<S>> &mat,
+                                    const StateInfo<S> &x)
+            -> shared_ptr<StateInfo<S>> {
+            shared_ptr<StateInfo<S>> nx =
+                make_shared<StateInfo<S>>(x.deep_copy());
+            for (int k = 0; k < nx->n; k++) {
+                int ik = mat->info->find_state(nx->quanta[k]);
+                if (ik == -1 || MatrixFunctions::norm((*mat)[ik]) < cutoff)
+                    nx->n_states[k] = 0;
+            }
+            nx->collect();
+            return nx;
+        };
+        // identity blocks mapping the old bond to the kept states
+        auto projector = [&i_alloc, &d_alloc,
+                          this](const StateInfo<S> &x)
+            -> shared_ptr<SparseMatrix<S>> {
+            shared_ptr<SparseMatrixInfo<S>> pinfo =
+                make_shared<SparseMatrixInfo<S>>(i_alloc);
+            pinfo->initialize(x, x, info->vacuum, false);
+            shared_ptr<SparseMatrix<S>> pmat =
+                make_shared<SparseMatrix<S>>(d_alloc);
+            pmat->allocate(pinfo);
+            for (int k = 0; k < pinfo->n; k++)
+                for (MKL_INT j = 0; j < (MKL_INT)pinfo->n_states_bra[k]; j++)
+                    (*pmat)[k](j, j) = 1.0;
+            return pmat;
+        };
+        // copy the kept blocks of mat into a new tensor with info xinfo
+        auto copy_blocks = [&d_alloc](const shared_ptr<SparseMatrix<S>> &mat,
+                                      const shared_ptr<SparseMatrixInfo<S>>
+                                          &xinfo)
+            -> shared_ptr<SparseMatrix<S>> {
+            shared_ptr<SparseMatrix<S>> xmat =
+                make_shared<SparseMatrix<S>>(d_alloc);
+            xmat->allocate(xinfo);
+            for (int k = 0; k < xinfo->n; k++) {
+                int ik = mat->info->find_state(xinfo->quanta[k]);
+                assert(ik != -1);
+                MatrixFunctions::copy((*xmat)[k], (*mat)[ik]);
+            }
+            return xmat;
+        };
+        auto release = [](const shared_ptr<SparseMatrix<S>> &mat) {
+            mat->info->deallocate();
+            mat->deallocate();
+        };
+        int n_removed = 0;
+        for (int i = 0; i < center; i++) {
+            assert(tensors[i] != nullptr);
+            shared_ptr<StateInfo<S>> ol = info->left_dims[i + 1];
+            shared_ptr<StateInfo<S>> nl = kept_states(tensors[i], *ol);
+            if (nl->n == 0 || nl->n == ol->n)
+                continue;
+            StateInfo<S> t = StateInfo<S>::tensor_product(
+                *info->left_dims[i], *info->basis[i],
+                *info->left_dims_fci[i + 1]);
+            shared_ptr<SparseMatrixInfo<S>> linfo =
+                make_shared<SparseMatrixInfo<S>>(i_alloc);
+            linfo->initialize(t, *nl, info->vacuum, false);
+            t.deallocate();
+            shared_ptr<SparseMatrix<S>> left = copy_blocks(tensors[i], linfo);
+            shared_ptr<SparseMatrix<S>> pmat = projector(*nl);
+            StateInfo<S> l = *ol, m = *info->basis[i + 1];
+            StateInfo<S> lm = StateInfo<S>::tensor_product(
+                             l, m, *info->left_dims_fci[i + 2]),
+                         r;
+            StateInfo<S> nlm = StateInfo<S>::tensor_product(
+                *nl, m, *info->left_dims_fci[i + 2]);
+            StateInfo<S> lmc = StateInfo<S>::get_connection_info(l, m, lm);
+            if (i + 1 == center && dot == 1)
+                r = *info->right_dims[center + dot];
+            else if (i + 1 == center && dot == 2)
+                r = StateInfo<S>::tensor_product(
+                    *info->basis[center + 1], *info->right_dims[center + dot],
+                    *info->right_dims_fci[center + 1]);
+            else
+                r = *info->left_dims[i + 2];
+            assert(tensors[i + 1] != nullptr);
+            shared_ptr<SparseMatrix<S>> next =
+                tensors[i + 1]->left_multiply(pmat, l, m, r, lm, lmc, nlm);
+            if (i + 1 == center && dot == 2)
+                r.deallocate();
+            lmc.deallocate();
+            nlm.deallocate();
+            lm.deallocate();
+            release(pmat);
+            release(tensors[i]), release(tensors[i + 1]);
+            tensors[i] = left, tensors[i + 1] = next;
+            n_removed += ol->n - nl->n;
+            info->left_dims[i + 1] = nl;
+        }
+        for (int i = n_sites - 1; i >= center + dot; i--) {
+            assert(tensors[i] != nullptr);
+            shared_ptr<StateInfo<S>> orr = info->right_dims[i];
+            shared_ptr<StateInfo<S>> nr = kept_states(tensors[i], *orr);
+            if (nr->n == 0 || nr->n == orr->n)
+                continue;
+            StateInfo<S> t = StateInfo<S>::tensor_product(
+                *info->basis[i], *info->right_dims[i + 1],
+                *info->right_dims_fci[i]);
+            shared_ptr<SparseMatrixInfo<S>> rinfo =
+                make_shared<SparseMatrixInfo<S>>(i_alloc);
+            rinfo->initialize(*nr, t, info->vacuum, false);
+            t.deallocate();
+            shared_ptr<SparseMatrix<S>> right = copy_blocks(tensors[i], rinfo);
+            shared_ptr<SparseMatrix<S>> pmat = projector(*nr);
+            int ip = i - 1 == center + 1 && dot == 2 ? i - 2 : i - 1;
+            assert(tensors[ip] != nullptr);
+            shared_ptr<SparseMatrix<S>> prev;
+            if (dot == 1 && i - 1 == center) {
+                shared_ptr<SparseMatrixInfo<S>> winfo =
+                    make_shared<SparseMatrixInfo<S>>(i_alloc);
+                winfo->initialize_contract(tensors[ip]->info, pmat->info);
+                prev = make_shared<SparseMatrix<S>>(d_alloc);
+                prev->allocate(winfo);
+                prev->contract(tensors[ip], pmat);
+            } else {
+                StateInfo<S> m = *info->basis[i - 1], r = *orr;
+                StateInfo<S> mr = StateInfo<S>::tensor_product(
+                    m, r, *info->right_dims_fci[i - 1]);
+                StateInfo<S> nmr = StateInfo<S>::tensor_product(
+                    m, *nr, *info->right_dims_fci[i - 1]);
+                StateInfo<S> mrc = StateInfo<S>::get_connection_info(m, r, mr);
+                StateInfo<S> l;
+                if (ip == i - 2)
+                    l = StateInfo<S>::tensor_product(
+                        *info->left_dims[center], *info->basis[center],
+                        *info->left_dims_fci[center + 1]);
+                else
+                    l = *info->right_dims[i - 1];
+                prev = tensors[ip]->right_multiply(pmat, l, m, r, mr, mrc, nmr);
+                if (ip == i - 2)
+                    l.deallocate();
+                mrc.deallocate();
+                nmr.deallocate();
+                mr.deallocate();
+            }
+            release(pmat);
+            release(tensors[i]), release(tensors[ip]);
+            tensors[i] = right, tensors[ip] = prev;
+            n_removed += orr->n - nr->n;
+            info->right_dims[i] = nr;
+        }
+        if (n_removed != 0) {
+            info->save_mutable();
+            save_mutable();
+        }
+        return n_removed;
+    }
     void canonicalize() {
         shared_ptr<VectorAllocator<uint32_t>> i_alloc =
             make_shared<VectorAllocator<uint32_t>>();
@@ -1957,6 +2155,7 @@ template <typename S> struct MPS {
         return ss.str();
     }
     void shallow_copy_to(const shared_ptr<MPS<S>> &mps) const {
+        frame->wait_save_files();
         if (frame->prefix_can_write)
             for (int i = 0; i < n_sites; i++)
                 Parsing::link_file(get_filename(i), mps->get_filename(i));
@@ -1988,6 +2187,7 @@ template <typename S> struct MPS {
         return xmps;
     }
     virtual void copy_data(const string &dir) const {
+        frame->wait_save_files();
         if (frame->prefix_can_write) {
             for (int i = 0; i < n_sites; i++)
                 if (tensors[i] != nullptr)
@@ -2052,6 +2252,7 @@ template <typename S> struct MPS {
             make_shared<VectorAllocator<uint32_t>>();
         shared_ptr<VectorAllocator<double>> d_alloc =
             make_shared<VectorAllocator<double>>();
+        frame->wait_save_files();
         for (int i = 0; i < center; i++)
             if (tensors[i] != nullptr) {
                 tensors[i]->alloc = d_alloc;
@@ -2063,6 +2264,7 @@ template <typename S> struct MPS {
             make_shared<VectorAllocator<uint32_t>>();
         shared_ptr<VectorAllocator<double>> d_alloc =
             make_shared<VectorAllocator<double>>();
+        frame->wait_save_files();
         for (int i = center + dot; i < n_sites; i++)
             if (tensors[i] != nullptr) {
                 tensors[i]->alloc = d_alloc;
@@ -2074,6 +2276,7 @@ template <typename S> struct MPS {
             make_shared<VectorAllocator<uint32_t>>();
         shared_ptr<VectorAllocator<double>> d_alloc =
             make_shared<VectorAllocator<double>>();
+        frame->wait_save_files();
         for (int i = 0; i < n_sites; i++)
             if (tensors[i] != nullptr) {
                 tensors[i]->alloc = d_alloc;
@@ -2081,6 +2284,7 @@ template <typename S> struct MPS {
             }
     }
     virtual void save_mutable() const {
+        frame->wait_save_files();
         if (frame->prefix_can_write)
             for (int i = 0; i < n_sites; i++)
                 if (tensors[i] != nullptr)
@@ -2089,7 +2293,14 @@ template <typename S> struct MPS {
     virtual void save_tensor(int i) const {
         if (frame->prefix_can_write) {
             assert(tensors[i] != nullptr);
-            tensors[i]->save_data(get_filename(i), true);
+            if (frame->async_mps_save) {
+                // the tensor may be unloaded before the file is written
+                shared_ptr<stringstream> ss = make_shared<stringstream>();
+                tensors[i]->info->save_data(*ss);
+                tensors[i]->save_data(*ss);
+                frame->save_file_async(get_filename(i), ss);
+            } else
+                tensors[i]->save_data(get_filename(i), true);
         }
     }
     virtual void load_tensor(int i) {
@@ -2098,6 +2309,7 @@ template <typename S> struct MPS {
         shared_ptr<VectorAllocator<double>> d_alloc =
             make_shared<VectorAllocator<double>>();
         assert(tensors[i] != nullptr);
+        frame->wait_save_file(get_filename(i));
         tensors[i]->alloc = d_alloc;
         tensors[i]->load_data(get_filename(i), true, i_alloc);
     }
@@ -0,0 +1,347 @@
+
+/*
+ * block2: Efficient MPO implementation of quantum chemistry DMRG
+ * Copyright (C) 2020-2021 Huanchen Zhai <hczhai@caltech.edu>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#pragma once
+
+#include "../core/fp_codec.hpp"
+#include "../core/parallel_rule.hpp"
+#include "../core/sparse_matrix.hpp"
+#include "mps.hpp"
+#include "state_averaged.hpp"
+#include "sweep_algorithm_td.hpp"
+#include <complex>
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+namespace block2 {
+
+// Trajectory of MPS snapshots (for time evolution)
+// All snapshots are appended to one data file, and each snapshot only
+// writes the MPS tensors (and MPSInfo bond dimensions) that changed since
+// the previous snapshot; unchanged items refer to the earlier copy.
+// Floating-point data is compressed with codec (error bounded by its
+// precision; no compression if codec is nullptr). The index file records
+// the items of each snapshot together with the time evolution state, so
+// that TimeEvolution can be restarted from any snapshot.
+template <typename S> struct MPSTrajectory {
+    // kinds of stored items
+    enum struct ItemTypes : uint8_t {
+        Data,      // MPS::save_data (index -1)
+        LeftDims,  // MPSInfo left_dims[i]
+        RightDims, // MPSInfo right_dims[i]
+        Tensor,    // MPS tensors[i]
+        Wavefunction // MultiMPS wfns[i] (at the center)
+    };
+    struct Item {
+        ItemTypes type;
+        int index;
+        uint64_t hash;
+        // position in the data file
+        size_t offset;
+    };
+    struct Snapshot {
+        // total_beta and next_beta of the TimeEvolution
+        complex<double> time, next_beta;
+        bool forward;
+        TETypes mode;
+        int n_sub_sweeps;
+        double energy, normsq;
+        vector<Item> items;
+    };
+    string filename;
+    shared_ptr<FPCodec<double>> codec;
+    vector<Snapshot> snapshots;
+    // sizes of uncompressed and written data in the last snapshot (bytes)
+    size_t last_raw_size = 0, last_stored_size = 0;
+    // filename + ".idx" and filename + ".dat" are used;
+    // existing files are truncated unless restart is true
+    MPSTrajectory(const string &filename, bool restart = false,
+                  const shared_ptr<FPCodec<double>> &codec =
+                      make_shared<FPCodec<double>>(1E-12, 1024))
+        : filename(filename), codec(codec) {
+        if (restart && Parsing::file_exists(index_filename()))
+            load_index();
+        else if (frame->prefix_can_write) {
+            ofstream(index_filename().c_str(), ios::binary | ios::trunc);
+            ofstream(data_filename().c_str(), ios::binary | ios::trunc);
+        }
+    }
+    virtual ~MPSTrajectory() = default;
+    string index_filename() const { return filename + ".idx"; }
+    string data_filename() const { return filename + ".dat"; }
+    // FNV-1a
+    static uint64_t hash_bytes(const char *p, size_t n,
+                               uint64_t h = 14695981039346656037ULL) {
+        for (size_t i = 0; i < n; i++)
+            h = (h ^ (uint8_t)p[i]) * 1099511628211ULL;
+        return h;
+    }
+    static string read_file(const string &fn) {
+        ifstream ifs(fn.c_str(), ios::binary);
+        if (!ifs.good())
+            throw runtime_error("MPSTrajectory::read_file on '" + fn +
+                                "' failed.");
+        stringstream ss;
+        ss << ifs.rdbuf();
+        return ss.str();
+    }
+    void load_index() {
+        ifstream ifs(index_filename().c_str(), ios::binary);
+        if (!ifs.good())
+            throw runtime_error("MPSTrajectory::load_index on '" +
+                                index_filename() + "' failed.");
+        snapshots.clear();
+        Snapshot snap;
+        while (ifs.peek() != EOF) {
+            size_t n_items;
+            ifs.read((char *)&snap.time, sizeof(snap.time));
+            ifs.read((char *)&snap.next_beta, sizeof(snap.next_beta));
+            ifs.read((char *)&snap.forward, sizeof(snap.forward));
+            ifs.read((char *)&snap.mode, sizeof(snap.mode));
+            ifs.read((char *)&snap.n_sub_sweeps, sizeof(snap.n_sub_sweeps));
+            ifs.read((char *)&snap.energy, sizeof(snap.energy));
+            ifs.read((char *)&snap.normsq, sizeof(snap.normsq));
+            ifs.read((char *)&n_items, sizeof(n_items));
+            snap.items.resize(n_items);
+            if (n_items != 0)
+                ifs.read((char *)&snap.items[0], sizeof(Item) * n_items);
+            if (ifs.fail() || ifs.bad())
+                throw runtime_error("MPSTrajectory::load_index on '" +
+                                    index_filename() + "' failed.");
+            snapshots.push_back(snap);
+        }
+    }
+    void save_index(const Snapshot &snap) const {
+        ofstream ofs(index_filename().c_str(), ios::binary | ios::app);
+        if (!ofs.good())
+            throw runtime_error("MPSTrajectory::save_index on '" +
+                                index_filename() + "' failed.");
+        size_t n_items = snap.items.size();
+        ofs.write((char *)&snap.time, sizeof(snap.time));
+        ofs.write((char *)&snap.next_beta, sizeof(snap.next_beta));
+        ofs.write((char *)&snap.forward, sizeof(snap.forward));
+        ofs.write((char *)&snap.mode, sizeof(snap.mode));
+        ofs.write((char *)&snap.n_sub_sweeps, sizeof(snap.n_sub_sweeps));
+        ofs.write((char *)&snap.energy, sizeof(snap.energy));
+        ofs.write((char *)&snap.normsq, sizeof(snap.normsq));
+        ofs.write((char *)&n_items, sizeof(n_items));
+        if (n_items != 0)
+            ofs.write((char *)&snap.items[0], sizeof(Item) * n_items);
+        if (!ofs.good())
+            throw runtime_error("MPSTrajectory::save_index on '" +
+                                index_filename() + "' failed.");
+    }
+    // an item is stored as the bytes before the floating-point data
+    // (header), then the (compressed) floating-point data
+    void add_item(ofstream &ofs, Snapshot &snap, ItemTypes type, int index,
+                  const string &header, double *data, size_t len) {
+        uint64_t hash = hash_bytes(header.data(), header.size());
+        hash = hash_bytes((const char *)data, sizeof(double) * len, hash);
+        last_raw_size += header.size() + sizeof(double) * len;
+        if (snapshots.size() != 0)
+            for (const auto &it : snapshots.back().items)
+                if (it.type == type && it.index == index && it.hash == hash) {
+                    snap.items.push_back(it);
+                    return;
+                }
+        const size_t offset = (size_t)ofs.tellp();
+        const size_t header_size = header.size();
+        ofs.write((char *)&header_size, sizeof(header_size));
+        ofs.write(header.data(), header_size);
+        ofs.write((char *)&len, sizeof(len));
+        if (len != 0) {
+            if (codec != nullptr)
+                codec->write_array(ofs, data, len);
+            else
+                ofs.write((char *)data, sizeof(double) * len);
+        }
+        last_stored_size += (size_t)ofs.tellp() - offset;
+        snap.items.push_back(Item{type, index, hash, offset});
+    }
+    // append a snapshot of mps (which must be saved to disk)
+    void save(const shared_ptr<MPS<S>> &mps, complex<double> time = 0.0,
+              complex<double> next_beta = 0.0, bool forward = true,
+              TETypes mode = TETypes::TangentSpace, int n_sub_sweeps = 1,
+              double energy = 0.0, double normsq = 1.0) {
+        frame->wait_save_files();
+        Snapshot snap{time,   next_beta, forward, mode,
+                      n_sub_sweeps, energy,    normsq, vector<Item>()};
+        last_raw_size = last_stored_size = 0;
+        if (frame->prefix_can_write) {
+            ofstream ofs(data_filename().c_str(), ios::binary | ios::app);
+            if (!ofs.good())
+                throw runtime_error("MPSTrajectory::save on '" +
+                                    data_filename() + "' failed.");
+            ofs.seekp(0, ios::end);
+            add_item(ofs, snap, ItemTypes::Data, -1,
+                     read_file(mps->get_filename(-1)), nullptr, 0);
+            for (int i = 0; i <= mps->n_sites; i++) {
+                add_item(ofs, snap, ItemTypes::LeftDims, i,
+                         read_file(mps->info->get_filename(true, i)), nullptr,
+                         0);
+                add_item(ofs, snap, ItemTypes::RightDims, i,
+                         read_file(mps->info->get_filename(false, i)),
+                         nullptr, 0);
+            }
+            for (int i = 0; i < mps->n_sites; i++)
+                if (mps->tensors[i] != nullptr) {
+                    mps->load_tensor(i);
+                    stringstream ss;
+                    mps->tensors[i]->info->save_data(ss);
+                    ss.write((char *)&mps->tensors[i]->factor,
+                             sizeof(mps->tensors[i]->factor));
+                    add_item(ofs, snap, ItemTypes::Tensor, i, ss.str(),
+                             mps->tensors[i]->data,
+                             mps->tensors[i]->total_memory);
+                    mps->unload_tensor(i);
+                }
+            if (mps->get_type() & MPSTypes::MultiWfn) {
+                shared_ptr<MultiMPS<S>> mmps =
+                    dynamic_pointer_cast<MultiMPS<S>>(mps);
+                mmps->load_wavefunction(mmps->center);
+                for (int j = 0; j < mmps->nroots; j++) {
+                    const auto &wfn = mmps->wfns[j];
+                    stringstream ss;
+                    ss.write((char *)&wfn->n, sizeof(wfn->n));
+                    ss.write((char *)&wfn->offsets[0],
+                             sizeof(size_t) * wfn->n);
+                    if (j == 0)
+                        for (int k = 0; k < wfn->n; k++)
+                            wfn->infos[k]->save_data(ss);
+                    add_item(ofs, snap, ItemTypes::Wavefunction, j, ss.str(),
+                             wfn->data, wfn->total_memory);
+                }
+                mmps->unload_wavefunction(mmps->center);
+            }
+            if (!ofs.good())
+                throw runtime_error("MPSTrajectory::save on '" +
+                                    data_filename() + "' failed.");
+            ofs.close();
+            save_index(snap);
+        }
+        snapshots.push_back(snap);
+    }
+    // append a snapshot of the state of te (te->me->ket)
+    void save(const shared_ptr<TimeEvolution<S>> &te) {
+        save(te->me->ket, te->total_beta, te->next_beta, te->forward,
+             te->mode, te->n_sub_sweeps,
+             te->energies.size() == 0 ? 0.0 : te->energies.back(),
+             te->normsqs.size() == 0 ? 1.0 : te->normsqs.back());
+    }
+    // write snapshot isnap (negative for counting from the end) to the files
+    // of mps (the tag of mps->info can be different from the saved one);
+    // MPS::load_data is done, while the MPSInfo bond dimensions are only
+    // written to files
+    void restore(int isnap, const shared_ptr<MPS<S>> &mps,
+                 const shared_ptr<ParallelRule<S>> &para_rule = nullptr) const {
+        if (isnap < 0)
+            isnap += (int)snapshots.size();
+        assert(isnap >= 0 && isnap < (int)snapshots.size());
+        frame->wait_save_files();
+        if (frame->prefix_can_write) {
+            ifstream ifs(data_filename().c_str(), ios::binary);
+            if (!ifs.good())
+                throw runtime_error("MPSTrajectory::restore on '" +
+                                    data_filename() + "' failed.");
+            const Snapshot &snap = snapshots[isnap];
+            vector<double> data;
+            for (const auto &it : snap.items) {
+                string fn;
+                switch (it.type) {
+                case ItemTypes::Data:
+                    fn = mps->get_filename(-1);
+                    break;
+                case ItemTypes::LeftDims:
+                    fn = mps->info->get_filename(true, it.index);
+                    break;
+                case ItemTypes::RightDims:
+                    fn = mps->info->get_filename(false, it.index);
+                    break;
+                case ItemTypes::Tensor:
+                    fn = mps->get_filename(it.index);
+                    break;
+                case ItemTypes::Wavefunction:
+                    fn = dynamic_pointer_cast<MultiMPS<S>>(mps)
+                             ->get_wfn_filename(it.index);
+                    break;
+                }
+                size_t header_size, len;
+                ifs.seekg(it.offset);
+                ifs.read((char *)&header_size, sizeof(header_size));
+                string header(header_size, ' ');
+                if (header_size != 0)
+                    ifs.read(&header[0], header_size);
+                ifs.read((char *)&len, sizeof(len));
+                data.resize(len);
+                if (len != 0) {
+                    if (codec != nullptr)
+                        codec->read_array(ifs, data.data(), len);
+                    else
+                        ifs.read((char *)data.data(), sizeof(double) * len);
+                }
+                if (ifs.fail() || ifs.bad())
+                    throw runtime_error("MPSTrajectory::restore on '" +
+                                        data_filename() + "' failed.");
+                if (Parsing::link_exists(fn))
+                    Parsing::remove_file(fn);
+                ofstream ofs(fn.c_str(), ios::binary);
+                if (!ofs.good())
+                    throw runtime_error("MPSTrajectory::restore on '" + fn +
+                                        "' failed.");
+                ofs.write(header.data(), header_size);
+                // tensor and wavefunction files store the length
+                // right before the data
+                if (it.type == ItemTypes::Tensor ||
+                    it.type == ItemTypes::Wavefunction) {
+                    ofs.write((char *)&len, sizeof(len));
+                    ofs.write((char *)data.data(), sizeof(double) * len);
+                }
+                if (!ofs.good())
+                    throw runtime_error("MPSTrajectory::restore on '" + fn +
+                                        "' failed.");
+            }
+        }
+        if (para_rule != nullptr)
+            para_rule->comm->barrier();
+        mps->load_data();
+    }
+    // restore snapshot isnap to te->me->ket and the state of te,
+    // so that te->solve can continue from there
+    // (the environments of te->me must be initialized again afterwards)
+    void restore(int isnap, const shared_ptr<TimeEvolution<S>> &te) const {
+        if (isnap < 0)
+            isnap += (int)snapshots.size();
+        restore(isnap, te->me->ket, te->me->para_rule);
+        const Snapshot &snap = snapshots[isnap];
+        te->total_beta = snap.time;
+        te->next_beta = snap.next_beta;
+        te->forward = snap.forward;
+        te->mode = snap.mode;
+        te->n_sub_sweeps = snap.n_sub_sweeps;
+    }
+};
+
+} // namespace block2
@@ -81,6 +81,11 @@ struct TransSparseTensor<S1, S2, typename S1::is_su2_t, typename S2::is_sz_t> {
             TransStateInfo<S2, S1>::backward_connection(right_dim,
                                                         tr_right_dim);
         vector<map<pair<S2, S2>, shared_ptr<Tensor>>> mp(tr_basis->n);
+        // target blocks are allocated serially, then the (disjoint) copies
+        // into the target blocks are done in parallel
+        // (target, source, factor, left shift, right shift)
+        typedef tuple<Tensor *, Tensor *, double, MKL_INT, MKL_INT> task_t;
+        vector<task_t> tasks;
         for (int ip = 0; ip < basis->n; ip++) {
             S1 mq = basis->quanta[ip];
             for (auto &r : spt->data[ip]) {
@@ -142,13 +147,22 @@ struct TransSparseTensor<S1, S2, typename S1::is_su2_t, typename S2::is_sz_t> {
                             assert(
                                 tr_basis->n_states[tr_basis->find_state(mqz)] ==
                                 1);
-                            for (MKL_INT i = 0; i < r.second->shape[0]; i++)
-                                for (MKL_INT j = 0; j < r.second->shape[2]; j++)
-                                    (*x)({i + lsh, 0, j + rsh}) =
-                                        factor * (*r.second)({i, 0, j});
+                            tasks.push_back(make_tuple(
+                                x.get(), r.second.get(), factor, lsh, rsh));
                         }
             }
         }
+        int ntg = threading->activate_global();
+#pragma omp parallel for schedule(dynamic) num_threads(ntg)
+        for (int it = 0; it < (int)tasks.size(); it++) {
+            Tensor &x = *get<0>(tasks[it]);
+            Tensor &t = *get<1>(tasks[it]);
+            const double factor = get<2>(tasks[it]);
+            const MKL_INT lsh = get<3>(tasks[it]), rsh = get<4>(tasks[it]);
+            for (MKL_INT i = 0; i < t.shape[0]; i++)
+                for (MKL_INT j = 0; j < t.shape[2]; j++)
+                    x({i + lsh, 0, j + rsh}) = factor * t({i, 0, j});
+        }
         shared_ptr<SparseTensor<S2>> rst = make_shared<SparseTensor<S2>>();
         rst->data.resize(tr_basis->n);
         for (int i = 0; i < tr_basis->n; i++)
@@ -440,6 +454,14 @@ template <typename S> struct UnfusedMPS {
     }
     // select one sz component from SZ Unfused MPS transformed from SU2 MPS
     void resolve_singlet_embedding(int twosz) {
+        S lq = resolve_singlet_embedding_info(info, twosz);
+        for (int i = 0; i < n_sites; i++)
+            tensors[i] = resolve_singlet_embedding_tensor(i, tensors[i], lq);
+    }
+    // the MPSInfo part of resolve_singlet_embedding
+    // returns the selected left vacuum quantum
+    static S resolve_singlet_embedding_info(const shared_ptr<MPSInfo<S>> &info,
+                                            int twosz) {
         assert(info->target.twos() == 0);
         vector<S> lqs;
         int lidx = -1;
@@ -457,7 +479,7 @@ template <typename S> struct UnfusedMPS {
         info->left_dims[0] = make_shared<StateInfo<S>>(lq);
         info->target = info->target - lq;
         info->set_bond_dimension_fci();
-        for (int i = 0; i <= n_sites; i++) {
+        for (int i = 0; i <= info->n_sites; i++) {
             for (int j = 0; j < info->left_dims[i]->n; j++)
                 info->left_dims[i]->quanta[j] =
                     info->left_dims[i]->quanta[j] - lq;
@@ -465,20 +487,28 @@ template <typename S> struct UnfusedMPS {
         }
         info->save_mutable();
         info->deallocate_mutable();
-        shared_ptr<SparseTensor<S>> rst = make_shared<SparseTensor<S>>();
-        rst->data.resize(info->basis[0]->n);
-        for (int i = 0; i < info->basis[0]->n; i++) {
-            for (auto &x : tensors[0]->data[i])
-                if (x.first.first == lq)
-                    rst->data[i].push_back(x);
+        return lq;
+    }
+    // the site tensor part of resolve_singlet_embedding
+    static shared_ptr<SparseTensor<S>>
+    resolve_singlet_embedding_tensor(int i,
+                                     const shared_ptr<SparseTensor<S>> &spt,
+                                     S lq) {
+        shared_ptr<SparseTensor<S>> rst = spt;
+        if (i == 0) {
+            rst = make_shared<SparseTensor<S>>();
+            rst->data.resize(spt->data.size());
+            for (size_t j = 0; j < spt->data.size(); j++)
+                for (auto &x : spt->data[j])
+                    if (x.first.first == lq)
+                        rst->data[j].push_back(x);
         }
-        tensors[0] = rst;
-        for (int i = 0; i < n_sites; i++)
-            for (size_t j = 0; j < tensors[i]->data.size(); j++)
-                for (auto &x : tensors[i]->data[j]) {
-                    x.first.first = x.first.first - lq;
-                    x.first.second = x.first.second - lq;
-                }
+        for (size_t j = 0; j < rst->data.size(); j++)
+            for (auto &x : rst->data[j]) {
+                x.first.first = x.first.first - lq;
+                x.first.second = x.first.second - lq;
+            }
+        return rst;
     }
 };
 
@@ -489,6 +519,32 @@ struct TransUnfusedMPS;
 // only works for normal nstate = 1 basis
 template <typename S1, typename S2>
 struct TransUnfusedMPS<S1, S2, typename S1::is_su2_t, typename S2::is_sz_t> {
+    // transform one site tensor, mutable info should be loaded
+    static shared_ptr<SparseTensor<S2>>
+    forward_tensor(int i, const shared_ptr<SparseTensor<S1>> &spt,
+                   const shared_ptr<MPSInfo<S1>> &info, char form,
+                   const shared_ptr<CG<S1>> &cg) {
+        if (form == 'L')
+            return TransSparseTensor<S1, S2>::forward(
+                spt, info->basis[i], info->left_dims[i], info->left_dims[i + 1],
+                cg, true);
+        else if (form == 'R') {
+            shared_ptr<StateInfo<S1>> ri =
+                make_shared<StateInfo<S1>>(StateInfo<S1>::complementary(
+                    *info->right_dims[i], info->target));
+            shared_ptr<StateInfo<S1>> rj =
+                make_shared<StateInfo<S1>>(StateInfo<S1>::complementary(
+                    *info->right_dims[i + 1], info->target));
+            return TransSparseTensor<S1, S2>::forward(spt, info->basis[i], ri,
+                                                      rj, cg, true);
+        } else {
+            shared_ptr<StateInfo<S1>> ri =
+                make_shared<StateInfo<S1>>(StateInfo<S1>::complementary(
+                    *info->right_dims[i + 1], info->target));
+            return TransSparseTensor<S1, S2>::forward(
+                spt, info->basis[i], info->left_dims[i], ri, cg, true);
+        }
+    }
     static shared_ptr<UnfusedMPS<S2>>
     forward(const shared_ptr<UnfusedMPS<S1>> &umps, const string &xtag,
             const shared_ptr<CG<S1>> &cg) {
@@ -507,31 +563,57 @@ struct TransUnfusedMPS<S1, S2, typename S1::is_su2_t, typename S2::is_sz_t> {
         fmps->dot = umps->dot;
         umps->info->load_mutable();
         for (int i = 0; i < umps->n_sites; i++)
-            if (umps->canonical_form[i] == 'L')
-                fmps->tensors[i] = TransSparseTensor<S1, S2>::forward(
-                    umps->tensors[i], umps->info->basis[i],
-                    umps->info->left_dims[i], umps->info->left_dims[i + 1], cg,
-                    true);
-            else if (umps->canonical_form[i] == 'R') {
-                shared_ptr<StateInfo<S1>> ri =
-                    make_shared<StateInfo<S1>>(StateInfo<S1>::complementary(
-                        *umps->info->right_dims[i], umps->info->target));
-                shared_ptr<StateInfo<S1>> rj =
-                    make_shared<StateInfo<S1>>(StateInfo<S1>::complementary(
-                        *umps->info->right_dims[i + 1], umps->info->target));
-                fmps->tensors[i] = TransSparseTensor<S1, S2>::forward(
-                    umps->tensors[i], umps->info->basis[i], ri, rj, cg, true);
-            } else {
-                shared_ptr<StateInfo<S1>> ri =
-                    make_shared<StateInfo<S1>>(StateInfo<S1>::complementary(
-                        *umps->info->right_dims[i + 1], umps->info->target));
-                fmps->tensors[i] = TransSparseTensor<S1, S2>::forward(
-                    umps->tensors[i], umps->info->basis[i],
-                    umps->info->left_dims[i], ri, cg, true);
-            }
+            fmps->tensors[i] = forward_tensor(i, umps->tensors[i], umps->info,
+                                              umps->canonical_form[i], cg);
         umps->info->deallocate_mutable();
         return fmps;
     }
+    // Transform SU2 MPS to SZ MPS without the intermediate Unfused MPS
+    // site tensors are loaded, transformed, saved and unloaded one by one
+    // if resolve is true, the sz = twosz component of the singlet embedding
+    // is selected, as in UnfusedMPS::resolve_singlet_embedding
+    static shared_ptr<MPS<S2>> transform(const shared_ptr<MPS<S1>> &mps,
+                                         const string &xtag,
+                                         const shared_ptr<CG<S1>> &cg,
+                                         bool resolve = false,
+                                         int twosz = 0) {
+        assert(mps->info->target.twos() == 0);
+        S2 target(mps->info->target.n(), mps->info->target.twos(),
+                  mps->info->target.pg());
+        mps->info->load_mutable();
+        shared_ptr<MPSInfo<S2>> info =
+            TransMPSInfo<S1, S2>::forward(mps->info, target);
+        info->tag = xtag;
+        info->save_mutable();
+        S2 lq = info->vacuum;
+        if (resolve)
+            lq = UnfusedMPS<S2>::resolve_singlet_embedding_info(info, twosz);
+        info->load_mutable();
+        shared_ptr<MPS<S2>> xmps = make_shared<MPS<S2>>(info);
+        xmps->canonical_form = mps->canonical_form;
+        xmps->center = mps->center;
+        xmps->n_sites = mps->n_sites;
+        xmps->dot = mps->dot;
+        xmps->tensors.resize(xmps->n_sites);
+        for (int i = 0; i < xmps->n_sites; i++) {
+            shared_ptr<SparseTensor<S2>> spt = forward_tensor(
+                i, UnfusedMPS<S1>::forward_mps_tensor(i, mps), mps->info,
+                mps->canonical_form[i], cg);
+            if (resolve)
+                spt = UnfusedMPS<S2>::resolve_singlet_embedding_tensor(i, spt,
+                                                                       lq);
+            xmps->tensors[i] =
+                UnfusedMPS<S2>::backward_mps_tensor(i, xmps, spt);
+            spt = nullptr;
+            xmps->save_tensor(i);
+            xmps->unload_tensor(i);
+        }
+        info->save_mutable();
+        xmps->save_data();
+        info->deallocate_mutable();
+        mps->info->deallocate_mutable();
+        return xmps;
+    }
 };
 
 } // namespace block2
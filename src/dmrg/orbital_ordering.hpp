@@ -22,6 +22,8 @@
 
 #include "../core/integral.hpp"
 #include "../core/matrix_functions.hpp"
+#include "../core/parallel_rule.hpp"
+#include "../core/threading.hpp"
 #include "../core/utils.hpp"
 #include <algorithm>
 #include <cassert>
@@ -35,6 +37,10 @@ using namespace std;
 
 namespace block2 {
 
+// Genetic algorithm for orbital ordering
+// Fitness evaluation and breeding are parallelized over threads (evop must be
+// thread-safe). With a communicator, each MPI proc evolves an independent
+// island, and the best configurations migrate between islands periodically
 template <typename EvalOp> struct GAOptimization {
     EvalOp evop;
     uint16_t n_sites, n_bits, n_bunit;
@@ -43,30 +49,66 @@ template <typename EvalOp> struct GAOptimization {
     int n_elite = 1;
     double clone_rate = 0.1;
     double mutate_rate = 0.1;
-    vector<double> cumu_probs, probs;
+    // Number of generations between two migrations (0 means no migration)
+    int n_migrate_gens = 100;
+    // Number of best configurations sent to the next island in a migration
+    int n_migrants = 2;
+    vector<double> cumu_probs, probs, costs;
     vector<uint16_t> ords;
+    // One random number generator per thread
+    vector<RandomMT> rands;
     GAOptimization(uint16_t n_sites, const vector<uint16_t> &ford, EvalOp &evop,
                    int n_configs)
         : ford(ford), n_sites(n_sites), evop(evop), n_configs(n_configs) {
         probs.resize(n_configs);
         cumu_probs.resize(n_configs);
-        ords.resize(2 * n_sites * n_configs);
+        costs.resize(n_configs);
+        ords.resize((size_t)2 * n_sites * n_configs);
         for (n_bunit = 0; (1 << n_bunit) < (int)(sizeof(uint16_t) * 8);
              n_bunit++)
             ;
         n_bits = (n_sites >> n_bunit) + !!(n_sites & ((1 << n_bunit) - 1));
     }
+    // Seeds of thread random number generators are drawn from Random,
+    // and are different for different islands
+    void initialize_rands(int island = 0) {
+        int ntg = threading->activate_global();
+        threading->activate_normal();
+        unsigned rand_sd = (unsigned)Random::rand_int(1, 1 << 30);
+        rands.clear();
+        for (int i = 0; i < ntg; i++)
+            rands.push_back(RandomMT(rand_sd + (unsigned)(island * ntg + i)));
+    }
     vector<uint16_t> find_best() {
         size_t i = max_element(probs.begin(), probs.end()) - probs.begin();
         vector<uint16_t> r(n_sites);
         memcpy(r.data(), ords.data() + i * n_sites, n_sites * sizeof(uint16_t));
         return r;
     }
+    // Best configuration among all islands
+    template <typename S>
+    vector<uint16_t>
+    find_best(const shared_ptr<ParallelCommunicator<S>> &comm) {
+        vector<uint16_t> r = find_best();
+        size_t i = max_element(probs.begin(), probs.end()) - probs.begin();
+        vector<double> fs(comm->size, 0);
+        fs[comm->rank] = costs[i];
+        comm->allreduce_sum(fs.data(), fs.size());
+        int owner = (int)(min_element(fs.begin(), fs.end()) - fs.begin());
+        vector<int> ir(r.begin(), r.end());
+        comm->broadcast(ir.data(), ir.size(), owner);
+        return vector<uint16_t>(ir.begin(), ir.end());
+    }
     void evaluate(int ir) {
-        uint16_t irr = ir * n_sites * n_configs;
+        size_t irr = (size_t)ir * n_sites * n_configs;
+        int ntg = threading->activate_global();
+#pragma omp parallel for schedule(dynamic) num_threads(ntg)
+        for (int i = 0; i < n_configs; i++)
+            costs[i] = evop(ords.data() + irr + (size_t)i * n_sites);
+        threading->activate_normal();
         double ssq_prob = 0, sum_prob = 0, min_prob = 1E99;
         for (int i = 0; i < n_configs; i++) {
-            probs[i] = sqrt(abs(evop(ords.data() + irr + i * n_sites)));
+            probs[i] = sqrt(abs(costs[i]));
             sum_prob += probs[i];
             ssq_prob += probs[i] * probs[i];
             min_prob = min(min_prob, probs[i]);
@@ -86,7 +128,7 @@ template <typename EvalOp> struct GAOptimization {
         cumu_probs[n_configs - 1] = 1.0;
     }
     void initialize(int ir) {
-        uint16_t irr = ir * n_sites * n_configs;
+        size_t irr = (size_t)ir * n_sites * n_configs;
         if (ford.size() != 0)
             memcpy(ords.data() + irr, ford.data(), n_sites * sizeof(uint16_t));
         vector<uint16_t> idx(n_sites);
@@ -94,25 +136,23 @@ template <typename EvalOp> struct GAOptimization {
             idx[i] = i;
         for (int i = ford.size() != 0; i < n_configs; i++) {
             for (uint16_t j = 0; j < n_sites; j++)
-                swap(idx[j], idx[Random::rand_int(j, n_sites)]);
-            memcpy(ords.data() + irr + i * n_sites, idx.data(),
+                swap(idx[j], idx[rands[0].rand_int(j, n_sites)]);
+            memcpy(ords.data() + irr + (size_t)i * n_sites, idx.data(),
                    n_sites * sizeof(uint16_t));
         }
     }
-    void point_mutate(int ic) {
-        int itrial = Random::rand_int(1, 4);
+    void point_mutate(size_t ic, RandomMT &rd) {
+        int itrial = rd.rand_int(1, 4);
         for (int i = 0; i < itrial; i++) {
-            int ja = Random::rand_int(0, n_sites),
-                jb = Random::rand_int(0, n_sites);
+            int ja = rd.rand_int(0, n_sites), jb = rd.rand_int(0, n_sites);
             swap(ords[ic + ja], ords[ic + jb]);
         }
     }
-    void global_mutate(int ic) {
-        vector<uint16_t> tmp;
-        tmp.reserve(n_sites + 4);
+    void global_mutate(size_t ic, RandomMT &rd) {
+        vector<uint16_t> tmp(n_sites + 4);
         memcpy(tmp.data(), ords.data() + ic, n_sites * sizeof(uint16_t));
         for (int i = 0; i < 4; i++)
-            tmp[n_sites + i] = Random::rand_int(0, n_sites);
+            tmp[n_sites + i] = rd.rand_int(0, n_sites);
         const uint16_t *m = tmp.data() + n_sites;
         sort(tmp.data() + n_sites, tmp.data() + (n_sites + 4));
         memcpy(ords.data() + (ic + m[0]), tmp.data() + m[2],
@@ -122,14 +162,12 @@ template <typename EvalOp> struct GAOptimization {
         memcpy(ords.data() + (ic + m[0] + m[3] - m[1]), tmp.data() + m[0],
                (m[1] - m[0]) * sizeof(uint16_t));
     }
-    void cross_over(int ia, int ib, int ic) {
-        vector<uint16_t> tmp;
-        tmp.reserve(n_sites * 2 + n_bits);
+    void cross_over(size_t ia, size_t ib, size_t ic, RandomMT &rd) {
+        vector<uint16_t> tmp(n_sites * 2 + n_bits);
         for (uint16_t i = 0; i < n_sites; i++)
             tmp[ords[ia + i]] = i, tmp[ords[ib + i] + n_sites] = i;
         for (uint16_t i = 0; i < n_bits; i++)
-            tmp[n_sites + n_sites + i] =
-                (uint16_t)Random::rand_int(0, 1 << n_bits);
+            tmp[n_sites + n_sites + i] = (uint16_t)rd.rand_int(0, 1 << n_bits);
         const uint16_t *ma = tmp.data(), *mb = tmp.data() + n_sites;
         const uint16_t *mask = tmp.data() + n_sites + n_sites;
         memcpy(ords.data() + ic, ords.data() + ib, n_sites * sizeof(uint16_t));
@@ -148,10 +186,15 @@ template <typename EvalOp> struct GAOptimization {
             if ((mask[i >> n_bunit] >> (i & n_bmask)) & 1)
                 ords[ic + i] = ords[ia + i];
     }
+    int select(RandomMT &rd) const {
+        return (int)(lower_bound(cumu_probs.begin(), cumu_probs.end(),
+                                 rd.rand_double()) -
+                     cumu_probs.begin());
+    }
     void optimize(int ip) {
         int ir = !ip;
-        uint16_t irr = ir * n_sites * n_configs;
-        uint16_t ipp = ip * n_sites * n_configs;
+        size_t irr = (size_t)ir * n_sites * n_configs;
+        size_t ipp = (size_t)ip * n_sites * n_configs;
         vector<uint16_t> idx(n_configs);
         for (int i = 0; i < n_configs; i++)
             idx[i] = i;
@@ -159,35 +202,66 @@ template <typename EvalOp> struct GAOptimization {
             return this->probs[i] > this->probs[j];
         });
         for (int i = 0; i < n_elite; i++)
-            memcpy(ords.data() + irr + i * n_sites,
-                   ords.data() + ipp + idx[i] * n_sites,
+            memcpy(ords.data() + irr + (size_t)i * n_sites,
+                   ords.data() + ipp + (size_t)idx[i] * n_sites,
                    n_sites * sizeof(uint16_t));
-        for (int i = n_elite; i < n_configs; i++) {
-            if (Random::rand_double() < clone_rate) {
-                int j = (int)(lower_bound(cumu_probs.begin(), cumu_probs.end(),
-                                          Random::rand_double()) -
-                              cumu_probs.begin());
-                memcpy(ords.data() + irr + i * n_sites,
-                       ords.data() + ipp + j * n_sites,
-                       n_sites * sizeof(uint16_t));
-            } else {
-                int ja = (int)(lower_bound(cumu_probs.begin(), cumu_probs.end(),
-                                           Random::rand_double()) -
-                               cumu_probs.begin());
-                int jb = (int)(lower_bound(cumu_probs.begin(), cumu_probs.end(),
-                                           Random::rand_double()) -
-                               cumu_probs.begin());
-                cross_over(ipp + ja * n_sites, ipp + jb * n_sites,
-                           irr + i * n_sites);
+        int ntg = threading->activate_global();
+        assert((int)rands.size() >= ntg);
+#pragma omp parallel num_threads(ntg)
+        {
+            RandomMT &rd = rands[threading->get_thread_id()];
+#pragma omp for schedule(static)
+            for (int i = n_elite; i < n_configs; i++) {
+                const size_t ic = irr + (size_t)i * n_sites;
+                if (rd.rand_double() < clone_rate) {
+                    int j = select(rd);
+                    memcpy(ords.data() + ic,
+                           ords.data() + ipp + (size_t)j * n_sites,
+                           n_sites * sizeof(uint16_t));
+                } else {
+                    int ja = select(rd), jb = select(rd);
+                    cross_over(ipp + (size_t)ja * n_sites,
+                               ipp + (size_t)jb * n_sites, ic, rd);
+                }
+                if (rd.rand_double() < mutate_rate)
+                    point_mutate(ic, rd);
+                if (rd.rand_double() < mutate_rate)
+                    global_mutate(ic, rd);
             }
-            if (Random::rand_double() < mutate_rate)
-                point_mutate(irr + i * n_sites);
-            if (Random::rand_double() < mutate_rate)
-                global_mutate(irr + i * n_sites);
         }
+        threading->activate_normal();
+        evaluate(ir);
+    }
+    // Replace the worst configurations of population ir by the best
+    // configurations of the previous island (ring topology)
+    template <typename S>
+    void migrate(int ir, const shared_ptr<ParallelCommunicator<S>> &comm) {
+        const int nm = min(n_migrants, n_configs - n_elite);
+        if (nm <= 0)
+            return;
+        size_t irr = (size_t)ir * n_sites * n_configs;
+        vector<uint16_t> idx(n_configs);
+        for (int i = 0; i < n_configs; i++)
+            idx[i] = i;
+        sort(idx.begin(), idx.end(), [this](uint16_t i, uint16_t j) {
+            return this->probs[i] > this->probs[j];
+        });
+        const size_t mz = (size_t)nm * n_sites;
+        vector<double> mords(mz * comm->size, 0);
+        for (int i = 0; i < nm; i++)
+            for (uint16_t j = 0; j < n_sites; j++)
+                mords[mz * comm->rank + (size_t)i * n_sites + j] =
+                    ords[irr + (size_t)idx[i] * n_sites + j];
+        comm->allreduce_sum(mords.data(), mords.size());
+        const int src = (comm->rank + comm->size - 1) % comm->size;
+        for (int i = 0; i < nm; i++)
+            for (uint16_t j = 0; j < n_sites; j++)
+                ords[irr + (size_t)idx[n_configs - 1 - i] * n_sites + j] =
+                    (uint16_t)mords[mz * src + (size_t)i * n_sites + j];
         evaluate(ir);
     }
     vector<uint16_t> solve(int n_generations = 10000) {
+        initialize_rands();
         initialize(n_generations & 1);
         evaluate(n_generations & 1);
         for (int i = 0, ip = n_generations & 1; i < n_generations;
@@ -195,6 +269,154 @@ template <typename EvalOp> struct GAOptimization {
             optimize(ip);
         return find_best();
     }
+    // One island per MPI proc
+    template <typename S>
+    vector<uint16_t> solve(int n_generations,
+                           const shared_ptr<ParallelCommunicator<S>> &comm) {
+        initialize_rands(comm->rank);
+        initialize(n_generations & 1);
+        evaluate(n_generations & 1);
+        for (int i = 0, ip = n_generations & 1; i < n_generations;
+             i++, ip = !ip) {
+            optimize(ip);
+            if (comm->size > 1 && n_migrate_gens > 0 &&
+                (i + 1) % n_migrate_gens == 0 && i + 1 != n_generations)
+                migrate(!ip, comm);
+        }
+        return find_best(comm);
+    }
+};
+
+// Cost of an orbital ordering for exchange matrix kmat
+struct KMatEvaluator {
+    uint16_t n_sites;
+    const double *kmat;
+    double rsum;
+    KMatEvaluator(uint16_t n_sites, const vector<double> &kmat)
+        : n_sites(n_sites), kmat(kmat.data()), rsum(0) {
+        for (uint16_t i = 0; i < n_sites; i++)
+            for (uint16_t j = i + 1; j < n_sites; j++)
+                rsum += kmat[i * n_sites + j];
+    }
+    double operator()(const uint16_t *ord) const {
+        double r = 0;
+        for (uint16_t i = 0; i < n_sites; i++)
+            for (uint16_t j = i + 1, ii = ord[i]; j < n_sites; j++)
+                r += kmat[ii * n_sites + ord[j]] * (j - i) * (j - i);
+        return r / rsum;
+    }
+};
+
+// Sparse weighted graph of orbitals (sites) in CSR format
+// Self loops are not stored
+struct OrbitalGraph {
+    int n;
+    vector<int> rows, cols;
+    vector<double> vals, degrees;
+    OrbitalGraph(int n = 0) : n(n), rows(n + 1, 0) {}
+    // Graph from dense matrix kmat, keeping off-diagonal elements with
+    // absolute value larger than cutoff
+    static OrbitalGraph from_matrix(uint16_t n_sites,
+                                    const vector<double> &kmat,
+                                    double cutoff = 1E-12) {
+        assert(kmat.size() == (size_t)n_sites * n_sites);
+        OrbitalGraph g(n_sites);
+        for (uint16_t i = 0; i < n_sites; i++) {
+            for (uint16_t j = 0; j < n_sites; j++)
+                if (i != j && abs(kmat[i * n_sites + j]) > cutoff)
+                    g.cols.push_back(j),
+                        g.vals.push_back(kmat[i * n_sites + j]);
+            g.rows[i + 1] = (int)g.cols.size();
+        }
+        g.compute_degrees();
+        return g;
+    }
+    // Graph from a list of undirected edges (i, j) with weights w
+    static OrbitalGraph from_edges(int n, const vector<int> &is,
+                                   const vector<int> &js,
+                                   const vector<double> &ws) {
+        assert(is.size() == js.size() && is.size() == ws.size());
+        vector<vector<pair<int, double>>> adj(n);
+        for (size_t k = 0; k < is.size(); k++)
+            if (is[k] != js[k]) {
+                adj[is[k]].push_back(make_pair(js[k], ws[k]));
+                adj[js[k]].push_back(make_pair(is[k], ws[k]));
+            }
+        return from_adjacency(adj);
+    }
+    // Duplicated entries in a row are summed
+    static OrbitalGraph from_adjacency(vector<vector<pair<int, double>>> &adj) {
+        OrbitalGraph g((int)adj.size());
+        for (int i = 0; i < g.n; i++) {
+            sort(adj[i].begin(), adj[i].end(),
+                 [](const pair<int, double> &a, const pair<int, double> &b) {
+                     return a.first < b.first;
+                 });
+            for (size_t k = 0; k < adj[i].size(); k++)
+                if (k != 0 && adj[i][k].first == adj[i][k - 1].first)
+                    g.vals.back() += adj[i][k].second;
+                else
+                    g.cols.push_back(adj[i][k].first),
+                        g.vals.push_back(adj[i][k].second);
+            g.rows[i + 1] = (int)g.cols.size();
+        }
+        g.compute_degrees();
+        return g;
+    }
+    void compute_degrees() {
+        degrees.assign(n, 0);
+        for (int i = 0; i < n; i++)
+            for (int k = rows[i]; k < rows[i + 1]; k++)
+                degrees[i] += abs(vals[k]);
+    }
+    size_t nnz() const { return cols.size(); }
+    // y += L x, where L is the graph Laplacian
+    void laplacian_multiply(const double *x, double *y) const {
+        int ntg = threading->activate_global();
+#pragma omp parallel for schedule(static) num_threads(ntg)
+        for (int i = 0; i < n; i++) {
+            double r = degrees[i] * x[i];
+            for (int k = rows[i]; k < rows[i + 1]; k++)
+                r -= vals[k] * x[cols[k]];
+            y[i] += r;
+        }
+        threading->activate_normal();
+    }
+    // Dense Laplacian (n x n)
+    vector<double> laplacian() const {
+        vector<double> lmat((size_t)n * n, 0);
+        for (int i = 0; i < n; i++) {
+            lmat[(size_t)i * n + i] = degrees[i];
+            for (int k = rows[i]; k < rows[i + 1]; k++)
+                lmat[(size_t)i * n + cols[k]] -= vals[k];
+        }
+        return lmat;
+    }
+    // Coarse graph from heavy edge matching
+    // cmap[i] is the coarse vertex of fine vertex i
+    OrbitalGraph coarsen(vector<int> &cmap) const {
+        cmap.assign(n, -1);
+        int nc = 0;
+        for (int i = 0; i < n; i++) {
+            if (cmap[i] != -1)
+                continue;
+            int jm = -1;
+            double wm = 0;
+            for (int k = rows[i]; k < rows[i + 1]; k++)
+                if (cmap[cols[k]] == -1 && abs(vals[k]) > wm)
+                    jm = cols[k], wm = abs(vals[k]);
+            cmap[i] = nc;
+            if (jm != -1)
+                cmap[jm] = nc;
+            nc++;
+        }
+        vector<vector<pair<int, double>>> adj(nc);
+        for (int i = 0; i < n; i++)
+            for (int k = rows[i]; k < rows[i + 1]; k++)
+                if (cmap[i] != cmap[cols[k]])
+                    adj[cmap[i]].push_back(make_pair(cmap[cols[k]], vals[k]));
+        return from_adjacency(adj);
+    }
 };
 
 struct OrbitalOrdering {
@@ -225,24 +447,34 @@ struct OrbitalOrdering {
                                    int n_configs = 54, int n_elite = 5,
                                    double clone_rate = 0.1,
                                    double mutate_rate = 0.1) {
-        double rsum = 0;
-        for (uint16_t i = 0; i < n_sites; i++)
-            for (uint16_t j = i + 1; j < n_sites; j++)
-                rsum += kmat[i * n_sites + j];
-        auto eval_op = [n_sites, rsum, &kmat](uint16_t *ord) {
-            double r = 0;
-            for (uint16_t i = 0; i < n_sites; i++)
-                for (uint16_t j = i + 1, ii = ord[i]; j < n_sites; j++)
-                    r += kmat[ii * n_sites + ord[j]] * (j - i) * (j - i);
-            return r / rsum;
-        };
+        KMatEvaluator eval_op(n_sites, kmat);
         vector<uint16_t> ford = fiedler(n_sites, kmat);
-        GAOptimization<decltype(eval_op)> ga(n_sites, ford, eval_op, n_configs);
+        GAOptimization<KMatEvaluator> ga(n_sites, ford, eval_op, n_configs);
         ga.n_elite = n_elite;
         ga.clone_rate = clone_rate;
         ga.mutate_rate = mutate_rate;
         return ga.solve(n_generations);
     }
+    // Island model: one population per MPI proc, with migration of
+    // n_migrants best configurations every n_migrate_gens generations
+    template <typename S>
+    static vector<uint16_t>
+    ga_opt_islands(uint16_t n_sites, const vector<double> &kmat,
+                   const shared_ptr<ParallelCommunicator<S>> &comm,
+                   int n_generations = 10000, int n_configs = 54,
+                   int n_elite = 5, double clone_rate = 0.1,
+                   double mutate_rate = 0.1, int n_migrate_gens = 100,
+                   int n_migrants = 2) {
+        KMatEvaluator eval_op(n_sites, kmat);
+        vector<uint16_t> ford = fiedler(n_sites, kmat);
+        GAOptimization<KMatEvaluator> ga(n_sites, ford, eval_op, n_configs);
+        ga.n_elite = n_elite;
+        ga.clone_rate = clone_rate;
+        ga.mutate_rate = mutate_rate;
+        ga.n_migrate_gens = n_migrate_gens;
+        ga.n_migrants = n_migrants;
+        return ga.solve(n_generations, comm);
+    }
     static vector<uint16_t> fiedler(uint16_t n_sites,
                                     const vector<double> &kmat) {
         assert(kmat.size() == n_sites * n_sites);
@@ -271,6 +503,120 @@ struct OrbitalOrdering {
         });
         return ord;
     }
+    // Ordering from the Fiedler vector x: sort by components of x,
+    // with the sign fixed by the first non-zero component
+    static vector<uint16_t> fiedler_ordering(const vector<double> &x) {
+        double factor = 1.0;
+        for (size_t i = 0; i < x.size(); i++)
+            if (abs(x[i]) > 1E-12) {
+                factor = x[i] > 0 ? 1.0 : -1.0;
+                break;
+            }
+        vector<uint16_t> ord(x.size());
+        for (size_t i = 0; i < x.size(); i++)
+            ord[i] = (uint16_t)i;
+        stable_sort(ord.begin(), ord.end(),
+                    [&x, factor](uint16_t i, uint16_t j) {
+                        return x[i] * factor < x[j] * factor;
+                    });
+        return ord;
+    }
+    // Initial guess for Lanczos, orthogonal to the constant vector
+    static vector<double> ramp(int n) {
+        vector<double> x(n);
+        for (int i = 0; i < n; i++)
+            x[i] = i - (n - 1) * 0.5;
+        return x;
+    }
+    // Fiedler vector from the dense Laplacian
+    static vector<double> dense_fiedler_vector(const OrbitalGraph &g) {
+        vector<double> x(g.n, 0);
+        if (g.n < 2)
+            return x;
+        vector<double> lmat = g.laplacian(), wmat(g.n);
+        MatrixFunctions::eigs(MatrixRef(lmat.data(), g.n, g.n),
+                              DiagonalMatrix(wmat.data(), g.n));
+        memcpy(x.data(), lmat.data() + g.n, sizeof(double) * g.n);
+        return x;
+    }
+    // Fiedler vector from thick-restart Lanczos, starting from x
+    // The constant vector is shifted above the spectrum of the Laplacian
+    // (L + sigma |1><1| / n), so that the Fiedler vector is the lowest root
+    // Iterations are stopped after max_iter matrix-vector products
+    // (the result is then an approximate Fiedler vector)
+    static vector<double> lanczos_fiedler_vector(const OrbitalGraph &g,
+                                                 vector<double> x,
+                                                 int max_iter = 5000,
+                                                 double conv_thrd = 1E-12) {
+        // the Krylov basis (at most 50 vectors) must not exhaust the space
+        if (g.n <= 100)
+            return dense_fiedler_vector(g);
+        assert((int)x.size() == g.n);
+        const double dmax = *max_element(g.degrees.begin(), g.degrees.end());
+        const double sigma = 2 * dmax + 1;
+        const int n = g.n;
+        double xsum = 0;
+        for (int i = 0; i < n; i++)
+            xsum += x[i];
+        for (int i = 0; i < n; i++)
+            x[i] -= xsum / n;
+        vector<MatrixRef> vs(1, MatrixRef(x.data(), n, 1));
+        auto op = [&g, sigma, n](const MatrixRef &a, const MatrixRef &b) {
+            g.laplacian_multiply(a.data, b.data);
+            double asum = 0;
+            for (int i = 0; i < n; i++)
+                asum += a.data[i];
+            for (int i = 0; i < n; i++)
+                b.data[i] += sigma * asum / n;
+        };
+        int ndav = 0;
+        MatrixFunctions::thick_restart_lanczos(
+            op, vs, ndav, false, shared_ptr<ParallelCommunicator<SZ>>(),
+            conv_thrd * max(dmax * dmax, 1E-100), max_iter + 1, max_iter);
+        return x;
+    }
+    // Fiedler ordering from a sparse graph
+    // coarse_size = 0: Lanczos on the graph itself
+    // coarse_size > 0: multilevel spectral ordering. The graph is coarsened
+    //   by heavy edge matching until it has at most coarse_size vertices, the
+    //   Fiedler vector of the coarsest graph is computed densely and then
+    //   interpolated to the finer graphs and refined by a few Lanczos steps
+    static vector<uint16_t> graph_fiedler(const OrbitalGraph &g,
+                                          int coarse_size = 0,
+                                          int refine_iter = 100) {
+        if (coarse_size <= 0)
+            return fiedler_ordering(lanczos_fiedler_vector(g, ramp(g.n)));
+        vector<OrbitalGraph> gs(1, g);
+        vector<vector<int>> cmaps;
+        while (gs.back().n > coarse_size) {
+            vector<int> cmap;
+            OrbitalGraph gc = gs.back().coarsen(cmap);
+            // no sufficient edges left for matching
+            if (gc.n * 10 > gs.back().n * 9)
+                break;
+            gs.push_back(gc);
+            cmaps.push_back(cmap);
+        }
+        vector<double> x = gs.back().n <= max(coarse_size, 2)
+                               ? dense_fiedler_vector(gs.back())
+                               : lanczos_fiedler_vector(gs.back(),
+                                                        ramp(gs.back().n));
+        for (int il = (int)cmaps.size() - 1; il >= 0; il--) {
+            vector<double> xf(gs[il].n);
+            for (int i = 0; i < gs[il].n; i++)
+                xf[i] = x[cmaps[il][i]];
+            x = lanczos_fiedler_vector(gs[il], xf, refine_iter);
+        }
+        return fiedler_ordering(x);
+    }
+    // Fiedler ordering using the sparse Laplacian from thresholded kmat
+    static vector<uint16_t> sparse_fiedler(uint16_t n_sites,
+                                           const vector<double> &kmat,
+                                           double cutoff = 1E-12,
+                                           int coarse_size = 0) {
+        return graph_fiedler(OrbitalGraph::from_matrix(n_sites, kmat, cutoff),
+                             coarse_size);
+    }
 };
 
 } // namespace block2
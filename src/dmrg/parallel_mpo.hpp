@@ -83,9 +83,12 @@ template <typename S> struct ClassicParallelMPO : MPO<S> {
             x = x->copy();
             for (size_t j = 0; j < x->data.size(); j++) {
                 assert(x->data[j]->get_type() != OpTypes::ExprRef);
+                // dynamic tasks need the full expression on all procs
+                const auto &op = MPO<S>::middle_operator_names[ix]->data[j];
                 x->data[j] = rule->localize_expr(
-                    x->data[j],
-                    rule->owner(MPO<S>::middle_operator_names[ix]->data[j]));
+                    x->data[j], rule->dynamic_expect() && rule->number(op)
+                                    ? rule->comm->rank
+                                    : rule->owner(op));
             }
         }
         // this will change schemer in original mpo
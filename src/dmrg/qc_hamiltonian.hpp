@@ -24,6 +24,7 @@
 #include "../core/hamiltonian.hpp"
 #include "../core/integral.hpp"
 #include "../core/sparse_matrix.hpp"
+#include "../core/threading.hpp"
 #include <map>
 #include <memory>
 #include <unordered_map>
@@ -35,6 +36,59 @@ namespace block2 {
 
 template <typename, typename = void> struct HamiltonianQC;
 
+// Site operators of HamiltonianQC, which only depend on the vacuum and
+// orbital symmetries. When several HamiltonianQC (for example, for energy
+// and property MPOs) are constructed with the same cache, the site operators
+// are built once and shared; they are deallocated by the last Hamiltonian
+template <typename S> struct HamiltonianQCSiteOps {
+    S vacuum;
+    vector<typename S::pg_t> orb_sym;
+    shared_ptr<CG<S>> cg;
+    vector<shared_ptr<StateInfo<S>>> basis;
+    vector<vector<pair<S, shared_ptr<SparseMatrixInfo<S>>>>> site_op_infos;
+    vector<unordered_map<shared_ptr<OpExpr<S>>, shared_ptr<SparseMatrix<S>>>>
+        site_norm_ops;
+    unordered_map<typename S::pg_t,
+                  vector<unordered_map<OpNames, shared_ptr<SparseMatrix<S>>>>>
+        op_prims;
+    // Number of live Hamiltonians sharing the cached site operators
+    int n_refs = 0;
+    HamiltonianQCSiteOps() {}
+    bool empty() const { return n_refs == 0; }
+    // Copy cached site operators into the Hamiltonian
+    template <typename H> void load(H &hamil) {
+        assert(!empty() && hamil.vacuum == vacuum && hamil.orb_sym == orb_sym);
+        hamil.opf = make_shared<OperatorFunctions<S>>(cg);
+        hamil.basis = basis;
+        hamil.site_op_infos = site_op_infos;
+        hamil.site_norm_ops = site_norm_ops;
+        hamil.op_prims = op_prims;
+        n_refs++;
+    }
+    // Keep site operators of the Hamiltonian in cache
+    template <typename H> void save(const H &hamil) {
+        assert(empty());
+        vacuum = hamil.vacuum, orb_sym = hamil.orb_sym;
+        cg = hamil.opf->cg;
+        basis = hamil.basis;
+        site_op_infos = hamil.site_op_infos;
+        site_norm_ops = hamil.site_norm_ops;
+        op_prims = hamil.op_prims;
+        n_refs = 1;
+    }
+    // Returns true if the caller is the last user and
+    // should deallocate the site operators
+    bool release() {
+        assert(!empty());
+        if (--n_refs != 0)
+            return false;
+        cg = nullptr;
+        basis.clear(), site_op_infos.clear();
+        site_norm_ops.clear(), op_prims.clear();
+        return true;
+    }
+};
+
 // Quantum chemistry Hamiltonian (non-spin-adapted)
 template <typename S>
 struct HamiltonianQC<S, typename S::is_sz_t> : Hamiltonian<S> {
@@ -57,14 +111,24 @@ struct HamiltonianQC<S, typename S::is_sz_t> : Hamiltonian<S> {
     shared_ptr<FCIDUMP> fcidump;
     // Chemical potenital parameter in Hamiltonian
     double mu = 0;
+    // Two-electron integrals smaller than this are treated as zero
+    double v_cutoff = 0;
+    // If not nullptr, site operators are shared with other Hamiltonians
+    shared_ptr<HamiltonianQCSiteOps<S>> site_ops = nullptr;
     HamiltonianQC()
         : Hamiltonian<S>(S(), 0, vector<typename S::pg_t>()), fcidump(nullptr) {
     }
-    HamiltonianQC(S vacuum, int n_sites,
-                  const vector<typename S::pg_t> &orb_sym,
-                  const shared_ptr<FCIDUMP> &fcidump)
-        : Hamiltonian<S>(vacuum, n_sites, orb_sym), fcidump(fcidump) {
+    HamiltonianQC(
+        S vacuum, int n_sites, const vector<typename S::pg_t> &orb_sym,
+        const shared_ptr<FCIDUMP> &fcidump,
+        const shared_ptr<HamiltonianQCSiteOps<S>> &site_ops = nullptr)
+        : Hamiltonian<S>(vacuum, n_sites, orb_sym), fcidump(fcidump),
+          site_ops(site_ops) {
         // SZ does not need CG factors
+        if (site_ops != nullptr && !site_ops->empty()) {
+            site_ops->load(*this);
+            return;
+        }
         opf = make_shared<OperatorFunctions<S>>(make_shared<CG<S>>());
         opf->cg->initialize();
         basis.resize(n_sites);
@@ -73,6 +137,8 @@ struct HamiltonianQC<S, typename S::is_sz_t> : Hamiltonian<S> {
         for (uint16_t m = 0; m < n_sites; m++)
             basis[m] = get_site_basis(m);
         init_site_ops();
+        if (site_ops != nullptr)
+            site_ops->save(*this);
     }
     virtual void set_mu(double mu) { this->mu = mu; }
     virtual shared_ptr<StateInfo<S>> get_site_basis(uint16_t m) const {
@@ -598,6 +664,8 @@ struct HamiltonianQC<S, typename S::is_sz_t> : Hamiltonian<S> {
         }
     }
     void deallocate() override {
+        if (site_ops != nullptr && !site_ops->release())
+            return;
         for (auto &op_prims : this->op_prims)
             for (auto &ops_map : op_prims.second)
                 for (auto &p : ops_map)
@@ -610,9 +678,36 @@ struct HamiltonianQC<S, typename S::is_sz_t> : Hamiltonian<S> {
         opf->cg->deallocate();
         Hamiltonian<S>::deallocate();
     }
+    // Drop two-electron integrals smaller than cutoff, both in MPO and in
+    // complementary operators. Returns number and norm of dropped integrals
+    pair<size_t, double> set_v_cutoff(double cutoff) {
+        v_cutoff = cutoff;
+        size_t n_dropped = 0;
+        double norm = 0.0;
+        int ntg = threading->activate_global();
+#pragma omp parallel num_threads(ntg) reduction(+ : n_dropped, norm)
+        {
+            vector<double> vkl((size_t)n_sites * n_sites);
+#pragma omp for schedule(static)
+            for (int i = 0; i < (int)n_sites; i++)
+                for (uint16_t j = 0; j < n_sites; j++)
+                    for (uint8_t sl = 0; sl < 2; sl++)
+                        for (uint8_t sr = 0; sr < 2; sr++) {
+                            fcidump->v_block(sl, sr, (uint16_t)i, j,
+                                             vkl.data());
+                            for (auto &x : vkl)
+                                if (x != 0.0 && abs(x) < cutoff)
+                                    n_dropped++, norm += x * x;
+                        }
+        }
+        return make_pair(n_dropped, sqrt(norm));
+    }
     double v(uint8_t sl, uint8_t sr, uint16_t i, uint16_t j, uint16_t k,
              uint16_t l) const {
-        return fcidump->v(sl, sr, i, j, k, l);
+        double r = fcidump->vexp != nullptr
+                       ? (*fcidump->vexp)(sl, sr, i, j, k, l)
+                       : fcidump->v(sl, sr, i, j, k, l);
+        return abs(r) < v_cutoff ? 0.0 : r;
     }
     double t(uint8_t s, uint16_t i, uint16_t j) const {
         return i == j ? fcidump->t(s, i, i) - mu : fcidump->t(s, i, j);
@@ -642,15 +737,25 @@ struct HamiltonianQC<S, typename S::is_su2_t> : Hamiltonian<S> {
     shared_ptr<FCIDUMP> fcidump;
     // Chemical potenital parameter in Hamiltonian
     double mu = 0;
+    // Two-electron integrals smaller than this are treated as zero
+    double v_cutoff = 0;
+    // If not nullptr, site operators are shared with other Hamiltonians
+    shared_ptr<HamiltonianQCSiteOps<S>> site_ops = nullptr;
     HamiltonianQC()
         : Hamiltonian<S>(S(), 0, vector<typename S::pg_t>()), fcidump(nullptr) {
     }
-    HamiltonianQC(S vacuum, int n_sites,
-                  const vector<typename S::pg_t> &orb_sym,
-                  const shared_ptr<FCIDUMP> &fcidump)
-        : Hamiltonian<S>(vacuum, n_sites, orb_sym), fcidump(fcidump) {
+    HamiltonianQC(
+        S vacuum, int n_sites, const vector<typename S::pg_t> &orb_sym,
+        const shared_ptr<FCIDUMP> &fcidump,
+        const shared_ptr<HamiltonianQCSiteOps<S>> &site_ops = nullptr)
+        : Hamiltonian<S>(vacuum, n_sites, orb_sym), fcidump(fcidump),
+          site_ops(site_ops) {
         // SU2 does not support UHF orbitals
         assert(!fcidump->uhf);
+        if (site_ops != nullptr && !site_ops->empty()) {
+            site_ops->load(*this);
+            return;
+        }
         opf = make_shared<OperatorFunctions<S>>(make_shared<CG<S>>(100));
         opf->cg->initialize();
         basis.resize(n_sites);
@@ -659,6 +764,8 @@ struct HamiltonianQC<S, typename S::is_su2_t> : Hamiltonian<S> {
         for (uint16_t m = 0; m < n_sites; m++)
             basis[m] = get_site_basis(m);
         init_site_ops();
+        if (site_ops != nullptr)
+            site_ops->save(*this);
     }
     virtual void set_mu(double mu) { this->mu = mu; }
     virtual shared_ptr<StateInfo<S>> get_site_basis(uint16_t m) const {
@@ -1023,6 +1130,8 @@ struct HamiltonianQC<S, typename S::is_su2_t> : Hamiltonian<S> {
         }
     }
     void deallocate() override {
+        if (site_ops != nullptr && !site_ops->release())
+            return;
         for (auto &op_prims : this->op_prims)
             for (auto &ops_map : op_prims.second)
                 for (auto &p : ops_map)
@@ -1035,8 +1144,31 @@ struct HamiltonianQC<S, typename S::is_su2_t> : Hamiltonian<S> {
         opf->cg->deallocate();
         Hamiltonian<S>::deallocate();
     }
+    // Drop two-electron integrals smaller than cutoff, both in MPO and in
+    // complementary operators. Returns number and norm of dropped integrals
+    pair<size_t, double> set_v_cutoff(double cutoff) {
+        v_cutoff = cutoff;
+        size_t n_dropped = 0;
+        double norm = 0.0;
+        int ntg = threading->activate_global();
+#pragma omp parallel num_threads(ntg) reduction(+ : n_dropped, norm)
+        {
+            vector<double> vkl((size_t)n_sites * n_sites);
+#pragma omp for schedule(static)
+            for (int i = 0; i < (int)n_sites; i++)
+                for (uint16_t j = 0; j < n_sites; j++) {
+                    fcidump->v_block((uint16_t)i, j, vkl.data());
+                    for (auto &x : vkl)
+                        if (x != 0.0 && abs(x) < cutoff)
+                            n_dropped++, norm += x * x;
+                }
+        }
+        return make_pair(n_dropped, sqrt(norm));
+    }
     double v(uint16_t i, uint16_t j, uint16_t k, uint16_t l) const {
-        return fcidump->v(i, j, k, l);
+        double r = fcidump->vexp != nullptr ? (*fcidump->vexp)(i, j, k, l)
+                                            : fcidump->v(i, j, k, l);
+        return abs(r) < v_cutoff ? 0.0 : r;
     }
     double t(uint16_t i, uint16_t j) const {
         return i == j ? fcidump->t(i, i) - mu : fcidump->t(i, j);
@@ -594,13 +594,18 @@ template <typename S> struct MPOQC<S, typename S::is_sz_t> : MPO<S> {
     QCTypes mode;
     const bool symmetrized_p = true;
     MPOQC(const shared_ptr<HamiltonianQC<S>> &hamil, QCTypes mode = QCTypes::NC,
-          int trans_center = -1, bool symmetrized_p = true)
+          int trans_center = -1, const string &archive_filename = "",
+          bool symmetrized_p = true)
         : MPO<S>(hamil->n_sites), mode(mode), symmetrized_p(symmetrized_p) {
         shared_ptr<OpExpr<S>> h_op =
             make_shared<OpElement<S>>(OpNames::H, SiteIndex(), hamil->vacuum);
         shared_ptr<OpExpr<S>> i_op =
             make_shared<OpElement<S>>(OpNames::I, SiteIndex(), hamil->vacuum);
         uint16_t n_sites = hamil->n_sites;
+        // if archive_filename is given, site tensors are archived
+        // as soon as they are built, to reduce peak memory
+        if (archive_filename != "")
+            MPO<S>::init_archive(archive_filename);
         if (hamil->opf != nullptr &&
             hamil->opf->get_type() == SparseMatrixTypes::CSR) {
             if (hamil->get_n_orbs_left() > 0)
@@ -698,7 +703,16 @@ template <typename S> struct MPOQC<S, typename S::is_sz_t> : MPO<S> {
                     OpNames::R, SiteIndex({m}, {s}),
                     S(-1, -sz[s], S::pg_inv(hamil->orb_sym[m])), -1.0);
             }
-        for (uint16_t i = 0; i < n_orbs; i++)
+        int ntg = threading->activate_global();
+        // two-index operators (independent for each i)
+#ifdef _MSC_VER
+#pragma omp parallel for schedule(static) num_threads(ntg)
+        for (int ii = 0; ii < (int)n_orbs; ii++) {
+            uint16_t i = (uint16_t)ii;
+#else
+#pragma omp parallel for schedule(static) num_threads(ntg)
+        for (uint16_t i = 0; i < n_orbs; i++) {
+#endif
             for (uint16_t j = 0; j < n_orbs; j++)
                 for (uint8_t s = 0; s < 4; s++) {
                     SiteIndex sidx({i, j},
@@ -732,6 +746,7 @@ template <typename S> struct MPOQC<S, typename S::is_sz_t> : MPO<S> {
                           S::pg_inv(S::pg_mul(hamil->orb_sym[i],
                                               S::pg_inv(hamil->orb_sym[j])))));
                 }
+        }
         bool need_repeat_m = mode == QCTypes::Conventional &&
                              trans_l + 1 == trans_r - 1 && trans_l + 1 >= 0 &&
                              trans_l + 1 < n_sites;
@@ -740,7 +755,11 @@ template <typename S> struct MPOQC<S, typename S::is_sz_t> : MPO<S> {
         this->tensors.resize(n_sites, nullptr);
         for (uint16_t m = 0; m < n_sites; m++)
             this->tensors[m] = make_shared<OperatorTensor<S>>();
-        int ntg = threading->activate_global();
+        SeqTypes seqt = hamil->opf->seq->mode;
+        hamil->opf->seq->mode = SeqTypes::None;
+        const uint16_t m_start = hamil->get_n_orbs_left() > 0 ? 1 : 0;
+        const uint16_t m_end =
+            hamil->get_n_orbs_right() > 0 ? n_sites - 1 : n_sites;
 #ifdef _MSC_VER
 #pragma omp parallel for schedule(dynamic) num_threads(ntg)
         for (int xxm = 0; xxm < (int)(n_sites + need_repeat_m); xxm++) {
@@ -1566,12 +1585,14 @@ template <typename S> struct MPOQC<S, typename S::is_sz_t> : MPO<S> {
                 }
                 this->right_operator_names[pm] = prop;
             }
+            // streaming: a site (not visited twice) is finished here
+            if (MPO<S>::archive_filename != "" && pm >= m_start &&
+                pm < m_end && !(need_repeat_m && pm == trans_l + 1)) {
+                hamil->filter_site_ops(pm, {opt->lmat, opt->rmat}, opt->ops);
+#pragma omp critical
+                this->save_tensor(pm);
+            }
         }
-        SeqTypes seqt = hamil->opf->seq->mode;
-        hamil->opf->seq->mode = SeqTypes::None;
-        const uint16_t m_start = hamil->get_n_orbs_left() > 0 ? 1 : 0;
-        const uint16_t m_end =
-            hamil->get_n_orbs_right() > 0 ? n_sites - 1 : n_sites;
 #pragma omp parallel for schedule(dynamic) num_threads(ntg)
 #ifdef _MSC_VER
         for (int m = (int)m_start; m < (int)m_end; m++) {
@@ -1579,6 +1600,8 @@ template <typename S> struct MPOQC<S, typename S::is_sz_t> : MPO<S> {
         for (uint16_t m = m_start; m < m_end; m++) {
 #endif
             shared_ptr<OperatorTensor<S>> opt = this->tensors[m];
+            if (opt == nullptr)
+                continue;
             hamil->filter_site_ops((uint16_t)m, {opt->lmat, opt->rmat},
                                    opt->ops);
         }
@@ -1592,6 +1615,9 @@ template <typename S> struct MPOQC<S, typename S::is_sz_t> : MPO<S> {
                                    opt->ops);
         }
         hamil->opf->seq->mode = seqt;
+        for (uint16_t m = 0; m < n_sites; m++)
+            if (this->tensors[m] != nullptr)
+                this->save_tensor(m);
         if (mode == QCTypes(QCTypes::NC | QCTypes::CN) ||
             mode == QCTypes::Conventional) {
             uint16_t m, pm;
@@ -1739,7 +1765,8 @@ template <typename S> struct MPOQC<S, typename S::is_sz_t> : MPO<S> {
     }
     void deallocate() override {
         for (int16_t m = this->n_sites - 1; m >= 0; m--)
-            this->tensors[m]->deallocate();
+            if (this->tensors[m] != nullptr)
+                this->tensors[m]->deallocate();
     }
 };
 
@@ -1747,13 +1774,17 @@ template <typename S> struct MPOQC<S, typename S::is_sz_t> : MPO<S> {
 template <typename S> struct MPOQC<S, typename S::is_su2_t> : MPO<S> {
     QCTypes mode;
     MPOQC(const shared_ptr<HamiltonianQC<S>> &hamil, QCTypes mode = QCTypes::NC,
-          int trans_center = -1)
+          int trans_center = -1, const string &archive_filename = "")
         : MPO<S>(hamil->n_sites), mode(mode) {
         shared_ptr<OpExpr<S>> h_op =
             make_shared<OpElement<S>>(OpNames::H, SiteIndex(), hamil->vacuum);
         shared_ptr<OpExpr<S>> i_op =
             make_shared<OpElement<S>>(OpNames::I, SiteIndex(), hamil->vacuum);
         uint16_t n_sites = hamil->n_sites;
+        // if archive_filename is given, site tensors are archived
+        // as soon as they are built, to reduce peak memory
+        if (archive_filename != "")
+            MPO<S>::init_archive(archive_filename);
         if (hamil->opf != nullptr &&
             hamil->opf->get_type() == SparseMatrixTypes::CSR) {
             if (hamil->get_n_orbs_left() > 0)
@@ -1829,7 +1860,16 @@ template <typename S> struct MPOQC<S, typename S::is_su2_t> : MPO<S> {
                 OpNames::R, SiteIndex(m),
                 S(-1, 1, S::pg_inv(hamil->orb_sym[m])), 2.0);
         }
-        for (uint16_t i = 0; i < n_orbs; i++)
+        int ntg = threading->activate_global();
+        // two-index operators (independent for each i)
+#ifdef _MSC_VER
+#pragma omp parallel for schedule(static) num_threads(ntg)
+        for (int ii = 0; ii < (int)n_orbs; ii++) {
+            uint16_t i = (uint16_t)ii;
+#else
+#pragma omp parallel for schedule(static) num_threads(ntg)
+        for (uint16_t i = 0; i < n_orbs; i++) {
+#endif
             for (uint16_t j = 0; j < n_orbs; j++)
                 for (uint8_t s = 0; s < 2; s++) {
                     a_op[i][j][s] = make_shared<OpElement<S>>(
@@ -1861,6 +1901,7 @@ template <typename S> struct MPOQC<S, typename S::is_su2_t> : MPO<S> {
                           S::pg_inv(S::pg_mul(hamil->orb_sym[i],
                                               S::pg_inv(hamil->orb_sym[j])))));
                 }
+        }
         bool need_repeat_m = mode == QCTypes::Conventional &&
                              trans_l + 1 == trans_r - 1 && trans_l + 1 >= 0 &&
                              trans_l + 1 < n_sites;
@@ -1869,7 +1910,11 @@ template <typename S> struct MPOQC<S, typename S::is_su2_t> : MPO<S> {
         this->tensors.resize(n_sites, nullptr);
         for (uint16_t m = 0; m < n_sites; m++)
             this->tensors[m] = make_shared<OperatorTensor<S>>();
-        int ntg = threading->activate_global();
+        SeqTypes seqt = hamil->opf->seq->mode;
+        hamil->opf->seq->mode = SeqTypes::None;
+        const uint16_t m_start = hamil->get_n_orbs_left() > 0 ? 1 : 0;
+        const uint16_t m_end =
+            hamil->get_n_orbs_right() > 0 ? n_sites - 1 : n_sites;
 #ifdef _MSC_VER
 #pragma omp parallel for schedule(dynamic) num_threads(ntg)
         for (int xxm = 0; xxm < (int)(n_sites + need_repeat_m); xxm++) {
@@ -2545,12 +2590,14 @@ template <typename S> struct MPOQC<S, typename S::is_su2_t> : MPO<S> {
                 }
                 this->right_operator_names[pm] = prop;
             }
+            // streaming: a site (not visited twice) is finished here
+            if (MPO<S>::archive_filename != "" && pm >= m_start &&
+                pm < m_end && !(need_repeat_m && pm == trans_l + 1)) {
+                hamil->filter_site_ops(pm, {opt->lmat, opt->rmat}, opt->ops);
+#pragma omp critical
+                this->save_tensor(pm);
+            }
         }
-        SeqTypes seqt = hamil->opf->seq->mode;
-        hamil->opf->seq->mode = SeqTypes::None;
-        const uint16_t m_start = hamil->get_n_orbs_left() > 0 ? 1 : 0;
-        const uint16_t m_end =
-            hamil->get_n_orbs_right() > 0 ? n_sites - 1 : n_sites;
 #pragma omp parallel for schedule(dynamic) num_threads(ntg)
 #ifdef _MSC_VER
         for (int m = (int)m_start; m < (int)m_end; m++) {
@@ -2558,6 +2605,8 @@ template <typename S> struct MPOQC<S, typename S::is_su2_t> : MPO<S> {
         for (uint16_t m = m_start; m < m_end; m++) {
 #endif
             shared_ptr<OperatorTensor<S>> opt = this->tensors[m];
+            if (opt == nullptr)
+                continue;
             hamil->filter_site_ops((uint16_t)m, {opt->lmat, opt->rmat},
                                    opt->ops);
         }
@@ -2571,6 +2620,9 @@ template <typename S> struct MPOQC<S, typename S::is_su2_t> : MPO<S> {
                                    opt->ops);
         }
         hamil->opf->seq->mode = seqt;
+        for (uint16_t m = 0; m < n_sites; m++)
+            if (this->tensors[m] != nullptr)
+                this->save_tensor(m);
         if (mode == QCTypes(QCTypes::NC | QCTypes::CN) ||
             mode == QCTypes::Conventional) {
             uint16_t m, pm;
@@ -2730,7 +2782,8 @@ template <typename S> struct MPOQC<S, typename S::is_su2_t> : MPO<S> {
     }
     void deallocate() override {
         for (int16_t m = this->n_sites - 1; m >= 0; m--)
-            this->tensors[m]->deallocate();
+            if (this->tensors[m] != nullptr)
+                this->tensors[m]->deallocate();
     }
 };
 
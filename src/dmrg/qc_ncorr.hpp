@@ -26,8 +26,10 @@
 #include "../core/symbolic.hpp"
 #include "../core/tensor_functions.hpp"
 #include "mpo.hpp"
+#include <algorithm>
 #include <cassert>
 #include <memory>
+#include <vector>
 
 using namespace std;
 
@@ -35,206 +37,231 @@ namespace block2 {
 
 template <typename, typename = void> struct NPC1MPOQC;
 
+// Build "MPO" for charge/spin correlation from a set of site pairs (i <= j).
+// For each pair, both (i, j) and (j, i) expectations are generated.
+// Diagonal pairs (i, i) are always generated.
+// b(m, s) is the local operator of kind s at site m;
+// nn(i, j, s) is the product of b(i, bl[s]) and b(j, br[s]) and
+// pdm1(i, j, s) is its expectation name. The (j, i) counterpart of
+// pdm1(i, j, s) is pdm1(j, i, swp[s]).
+// The left block after site m only keeps b(j, s) for sites j <= m which
+// still have a partner to the right of m, so that the bond dimension only
+// reflects the requested pairs.
+template <typename S, typename FB, typename FN, typename FP>
+inline void
+build_npc1_mpo(MPO<S> &mpo, const shared_ptr<Hamiltonian<S>> &hamil,
+               const vector<pair<int, int>> &pairs, uint8_t nb, uint8_t nnn,
+               FB &&b, FN &&nn, FP &&pdm1, const vector<uint8_t> &bl,
+               const vector<uint8_t> &br, const vector<uint8_t> &swp) {
+    const int n_sites = mpo.n_sites;
+    shared_ptr<OpExpr<S>> i_op =
+        make_shared<OpElement<S>>(OpNames::I, SiteIndex(), hamil->vacuum);
+    shared_ptr<OpElement<S>> zero_op =
+        make_shared<OpElement<S>>(OpNames::Zero, SiteIndex(), hamil->vacuum);
+    // partners[j] = sorted sites i <= j with requested pair (i, j)
+    vector<vector<uint16_t>> partners(n_sites);
+    vector<int> max_partner(n_sites, -1);
+    for (auto &pq : pairs) {
+        int i = min(pq.first, pq.second), j = max(pq.first, pq.second);
+        assert(i >= 0 && j < n_sites);
+        partners[j].push_back((uint16_t)i);
+        max_partner[i] = max(max_partner[i], j);
+    }
+    // diagonal pairs are always included (they are local to each site),
+    // so that every site has at least one middle operator
+    for (int m = 0; m < n_sites; m++) {
+        partners[m].push_back((uint16_t)m);
+        max_partner[m] = max(max_partner[m], m);
+    }
+    for (auto &pp : partners) {
+        sort(pp.begin(), pp.end());
+        pp.resize(distance(pp.begin(), unique(pp.begin(), pp.end())));
+    }
+    // kept[m] = sites j <= m whose b operators are in the left block after m
+    // kpos[j] = position of j in kept[m] (valid for the current m)
+    vector<vector<uint16_t>> kept(n_sites);
+    vector<int> kpos(n_sites, -1), kpos_prev;
+    mpo.const_e = 0.0;
+    mpo.op = zero_op;
+    mpo.schemer = nullptr;
+    mpo.tf = make_shared<TensorFunctions<S>>(hamil->opf);
+    mpo.site_op_infos = hamil->site_op_infos;
+    int llshape = 1;
+    for (uint16_t m = 0; m < n_sites; m++) {
+        if (m != n_sites - 1) {
+            if (m != 0)
+                for (uint16_t j : kept[m - 1])
+                    if (max_partner[j] > m)
+                        kept[m].push_back(j);
+            if (max_partner[m] > m)
+                kept[m].push_back(m);
+        }
+        kpos_prev = kpos;
+        for (int k = 0; k < (int)kept[m].size(); k++)
+            kpos[kept[m][k]] = k;
+        const int nk = (int)kept[m].size(), nkp = m == 0 ? 0
+                                                      : (int)kept[m - 1].size();
+        const int np = m != n_sites - 1 ? (int)partners[m].size() : 0;
+        int lshape = 1 + nb * nk + nnn * np;
+        // left operator names
+        shared_ptr<SymbolicRowVector<S>> plop =
+            make_shared<SymbolicRowVector<S>>(lshape);
+        (*plop)[0] = i_op;
+        for (uint8_t s = 0; s < nb; s++)
+            for (int k = 0; k < nk; k++)
+                (*plop)[1 + nk * s + k] = b(kept[m][k], s);
+        for (uint8_t s = 0; s < nnn; s++)
+            for (int k = 0; k < np; k++)
+                (*plop)[1 + nb * nk + np * s + k] = nn(partners[m][k], m, s);
+        mpo.left_operator_names.push_back(plop);
+        // right operator names
+        const int rshape = m != n_sites - 1 ? 1 : 1 + nnn + nb;
+        shared_ptr<SymbolicColumnVector<S>> prop =
+            make_shared<SymbolicColumnVector<S>>(rshape);
+        (*prop)[0] = i_op;
+        if (m == n_sites - 1) {
+            for (uint8_t s = 0; s < nnn; s++)
+                (*prop)[1 + s] = nn(m, m, s);
+            for (uint8_t s = 0; s < nb; s++)
+                (*prop)[1 + nnn + s] = b(m, s);
+        }
+        mpo.right_operator_names.push_back(prop);
+        // middle operators
+        if (m != n_sites - 1) {
+            vector<shared_ptr<OpExpr<S>>> mop, mexpr;
+            for (uint8_t s = 0; s < nnn; s++)
+                for (uint16_t j : partners[m]) {
+                    shared_ptr<OpExpr<S>> expr = nn(j, m, s) * i_op;
+                    mop.push_back(pdm1(j, m, s)), mexpr.push_back(expr);
+                    if (j != m)
+                        mop.push_back(pdm1(m, j, swp[s])),
+                            mexpr.push_back(expr);
+                }
+            if (m == n_sites - 2)
+                for (uint8_t s = 0; s < nnn; s++)
+                    for (uint16_t j : partners[m + 1]) {
+                        if (j == m + 1) {
+                            mop.push_back(pdm1(j, j, s));
+                            mexpr.push_back(i_op * nn(j, j, s));
+                            continue;
+                        }
+                        shared_ptr<OpExpr<S>> expr =
+                            b(j, bl[s]) * b(m + 1, br[s]);
+                        mop.push_back(pdm1(j, m + 1, s)), mexpr.push_back(expr);
+                        mop.push_back(pdm1(m + 1, j, swp[s]));
+                        mexpr.push_back(expr);
+                    }
+            shared_ptr<SymbolicColumnVector<S>> pmop =
+                make_shared<SymbolicColumnVector<S>>((int)mop.size());
+            shared_ptr<SymbolicColumnVector<S>> pmexpr =
+                make_shared<SymbolicColumnVector<S>>((int)mexpr.size());
+            pmop->data = mop, pmexpr->data = mexpr;
+            mpo.middle_operator_names.push_back(pmop);
+            mpo.middle_operator_exprs.push_back(pmexpr);
+        }
+        // site tensors
+        shared_ptr<OperatorTensor<S>> opt = make_shared<OperatorTensor<S>>();
+        const int lrshape = m != n_sites - 1 ? lshape : 1;
+        shared_ptr<Symbolic<S>> plmat = nullptr, prmat = nullptr;
+        if (m == 0)
+            plmat = make_shared<SymbolicRowVector<S>>(lrshape);
+        else if (m == n_sites - 1)
+            plmat = make_shared<SymbolicColumnVector<S>>(llshape);
+        else
+            plmat = make_shared<SymbolicMatrix<S>>(llshape, lrshape);
+        (*plmat)[{0, 0}] = i_op;
+        if (m != n_sites - 1) {
+            int p = 1;
+            for (uint8_t s = 0; s < nb; s++)
+                for (int k = 0; k < nk; k++, p++)
+                    if (kept[m][k] != m)
+                        (*plmat)[{1 + nkp * s + kpos_prev[kept[m][k]], p}] =
+                            i_op;
+                    else
+                        (*plmat)[{0, p}] = b(m, s);
+            for (uint8_t s = 0; s < nnn; s++)
+                for (int k = 0; k < np; k++, p++)
+                    if (partners[m][k] != m)
+                        (*plmat)[{1 + nkp * bl[s] +
+                                      kpos_prev[partners[m][k]],
+                                  p}] = b(m, br[s]);
+                    else
+                        (*plmat)[{0, p}] = nn(m, m, s);
+            assert(p == lrshape);
+        }
+        if (m == n_sites - 1) {
+            prmat = make_shared<SymbolicColumnVector<S>>(1 + nnn + nb);
+            prmat->data[0] = i_op;
+            for (uint8_t s = 0; s < nnn; s++)
+                prmat->data[1 + s] = nn(m, m, s);
+            for (uint8_t s = 0; s < nb; s++)
+                prmat->data[1 + nnn + s] = b(m, s);
+        } else {
+            if (m == n_sites - 2)
+                prmat = make_shared<SymbolicMatrix<S>>(1, 1 + nnn + nb);
+            else if (m == 0)
+                prmat = make_shared<SymbolicRowVector<S>>(1);
+            else
+                prmat = make_shared<SymbolicMatrix<S>>(1, 1);
+            (*prmat)[{0, 0}] = i_op;
+        }
+        opt->lmat = plmat, opt->rmat = prmat;
+        hamil->filter_site_ops(m, {opt->lmat, opt->rmat}, opt->ops);
+        mpo.tensors.push_back(opt);
+        llshape = lshape;
+    }
+}
+
+// all site pairs (i <= j)
+inline vector<pair<int, int>> npc1_all_pairs(int n_sites) {
+    vector<pair<int, int>> pairs;
+    pairs.reserve((size_t)n_sites * (n_sites + 1) / 2);
+    for (int j = 0; j < n_sites; j++)
+        for (int i = 0; i <= j; i++)
+            pairs.push_back(make_pair(i, j));
+    return pairs;
+}
+
 // "MPO" for charge/spin correlation (non-spin-adapted)
 // NN[0~3] = n_{p,sp} x n_{q,sq}
 // NN[4] = ad_{pa} a_{pb} x ad_{qb} a_{qa}
 // NN[5] = ad_{pb} a_{pa} x ad_{qa} a_{qb}
 template <typename S> struct NPC1MPOQC<S, typename S::is_sz_t> : MPO<S> {
     NPC1MPOQC(const shared_ptr<Hamiltonian<S>> &hamil)
+        : NPC1MPOQC(hamil, npc1_all_pairs(hamil->n_sites)) {}
+    // only correlations between the given site pairs (and on-site ones)
+    NPC1MPOQC(const shared_ptr<Hamiltonian<S>> &hamil,
+              const vector<pair<int, int>> &pairs)
         : MPO<S>(hamil->n_sites) {
-        const auto n_sites = MPO<S>::n_sites;
-        shared_ptr<OpExpr<S>> i_op =
-            make_shared<OpElement<S>>(OpNames::I, SiteIndex(), hamil->vacuum);
-        shared_ptr<OpElement<S>> zero_op = make_shared<OpElement<S>>(
-            OpNames::Zero, SiteIndex(), hamil->vacuum);
-#ifdef _MSC_VER
-        vector<vector<shared_ptr<OpExpr<S>>>> b_op(
-            n_sites, vector<shared_ptr<OpExpr<S>>>(4));
-        vector<vector<vector<shared_ptr<OpExpr<S>>>>> nn_op(
-            n_sites, vector<vector<shared_ptr<OpExpr<S>>>>(
-                         n_sites, vector<shared_ptr<OpExpr<S>>>(6)));
-        vector<vector<vector<shared_ptr<OpExpr<S>>>>> pdm1_op(
-            n_sites, vector<vector<shared_ptr<OpExpr<S>>>>(
-                         n_sites, vector<shared_ptr<OpExpr<S>>>(6)));
-#else
-        shared_ptr<OpExpr<S>> b_op[n_sites][4];
-        shared_ptr<OpExpr<S>> nn_op[n_sites][n_sites][6];
-        shared_ptr<OpExpr<S>> pdm1_op[n_sites][n_sites][6];
-#endif
         const int sz_minus[4] = {0, -2, 2, 0};
-        for (uint16_t m = 0; m < n_sites; m++)
-            for (uint8_t s = 0; s < 4; s++)
-                b_op[m][s] = make_shared<OpElement<S>>(
+        const S vacuum = hamil->vacuum;
+        build_npc1_mpo<S>(
+            *this, hamil, pairs, 4, 6,
+            [&sz_minus](uint16_t m, uint8_t s) -> shared_ptr<OpExpr<S>> {
+                return make_shared<OpElement<S>>(
                     OpNames::B,
                     SiteIndex({m, m}, {(uint8_t)(s & 1), (uint8_t)(s >> 1)}),
                     S(0, sz_minus[s], 0));
-        for (uint16_t i = 0; i < n_sites; i++)
-            for (uint16_t j = 0; j < n_sites; j++) {
-                for (uint8_t s = 0; s < 4; s++) {
-                    SiteIndex sidx({i, j},
-                                   {(uint8_t)(s & 1), (uint8_t)(s >> 1)});
-                    nn_op[i][j][s] = make_shared<OpElement<S>>(
-                        OpNames::NN, sidx, hamil->vacuum);
-                    pdm1_op[i][j][s] = make_shared<OpElement<S>>(
-                        OpNames::PDM1, sidx, hamil->vacuum);
-                }
-                for (uint8_t s = 0; s < 2; s++) {
-                    SiteIndex sidx({i, j},
-                                   {(uint8_t)s, (uint8_t)0, (uint8_t)1});
-                    nn_op[i][j][4 + s] = make_shared<OpElement<S>>(
-                        OpNames::NN, sidx, hamil->vacuum);
-                    pdm1_op[i][j][4 + s] = make_shared<OpElement<S>>(
-                        OpNames::PDM1, sidx, hamil->vacuum);
-                }
-            }
-        MPO<S>::const_e = 0.0;
-        MPO<S>::op = zero_op;
-        MPO<S>::schemer = nullptr;
-        MPO<S>::tf = make_shared<TensorFunctions<S>>(hamil->opf);
-        MPO<S>::site_op_infos = hamil->site_op_infos;
-        for (uint16_t m = 0; m < n_sites; m++) {
-            int lshape = m != n_sites - 1 ? 1 + 10 * (m + 1) : 1;
-            int rshape = m != n_sites - 1 ? 1 : 11;
-            // left operator names
-            shared_ptr<SymbolicRowVector<S>> plop =
-                make_shared<SymbolicRowVector<S>>(lshape);
-            (*plop)[0] = i_op;
-            if (m != n_sites - 1)
-                for (uint16_t j = 0; j <= m; j++) {
-                    for (uint8_t s = 0; s < 4; s++)
-                        (*plop)[1 + (m + 1) * s + j] = b_op[j][s];
-                    for (uint8_t s = 0; s < 6; s++)
-                        (*plop)[1 + (m + 1) * (4 + s) + j] = nn_op[j][m][s];
-                }
-            this->left_operator_names.push_back(plop);
-            // right operator names
-            shared_ptr<SymbolicColumnVector<S>> prop =
-                make_shared<SymbolicColumnVector<S>>(rshape);
-            (*prop)[0] = i_op;
-            if (m == n_sites - 1) {
-                for (uint8_t s = 0; s < 6; s++)
-                    (*prop)[1 + s] = nn_op[m][m][s];
-                for (uint8_t s = 0; s < 4; s++)
-                    (*prop)[7 + s] = b_op[m][s];
-            }
-            this->right_operator_names.push_back(prop);
-            // middle operators
-            if (m != n_sites - 1) {
-                int mshape = m != n_sites - 2 ? 6 * (2 * m + 1) : 24 * (m + 1);
-                shared_ptr<SymbolicColumnVector<S>> pmop =
-                    make_shared<SymbolicColumnVector<S>>(mshape);
-                shared_ptr<SymbolicColumnVector<S>> pmexpr =
-                    make_shared<SymbolicColumnVector<S>>(mshape);
-                int p = 0;
-                for (uint8_t s = 0; s < 6; s++) {
-                    for (uint16_t j = 0; j <= m; j++) {
-                        shared_ptr<OpExpr<S>> expr = nn_op[j][m][s] * i_op;
-                        (*pmop)[p + 2 * j] = pdm1_op[j][m][s];
-                        (*pmexpr)[p + 2 * j] = expr;
-                        if (j != m) {
-                            (*pmop)[p + 2 * j + 1] =
-                                s < 4 ? pdm1_op[m][j][((s & 1) << 1) | (s >> 1)]
-                                      : pdm1_op[m][j][s ^ 1];
-                            (*pmexpr)[p + 2 * j + 1] = expr;
-                        }
-                    }
-                    p += 2 * m + 1;
-                }
-                if (m == n_sites - 2) {
-                    for (uint8_t s = 0; s < 4; s++) {
-                        for (uint16_t j = 0; j <= m; j++) {
-                            shared_ptr<OpExpr<S>> expr =
-                                b_op[j][(s & 1) | ((s & 1) << 1)] *
-                                b_op[m + 1][(s >> 1) | ((s >> 1) << 1)];
-                            (*pmop)[p + 2 * j] = pdm1_op[j][m + 1][s];
-                            (*pmop)[p + 2 * j + 1] =
-                                pdm1_op[m + 1][j][((s & 1) << 1) | (s >> 1)];
-                            (*pmexpr)[p + 2 * j] = (*pmexpr)[p + 2 * j + 1] =
-                                expr;
-                        }
-                        (*pmop)[p + 2 * (m + 1)] = pdm1_op[m + 1][m + 1][s];
-                        (*pmexpr)[p + 2 * (m + 1)] =
-                            i_op * nn_op[m + 1][m + 1][s];
-                        p += 2 * m + 3;
-                    }
-                    for (uint8_t s = 0; s < 2; s++) {
-                        for (uint16_t j = 0; j <= m; j++) {
-                            shared_ptr<OpExpr<S>> expr =
-                                b_op[j][s | ((!s) << 1)] *
-                                b_op[m + 1][(!s) | (s << 1)];
-                            (*pmop)[p + 2 * j] = pdm1_op[j][m + 1][s + 4];
-                            (*pmop)[p + 2 * j + 1] =
-                                pdm1_op[m + 1][j][(s + 4) ^ 1];
-                            (*pmexpr)[p + 2 * j] = (*pmexpr)[p + 2 * j + 1] =
-                                expr;
-                        }
-                        (*pmop)[p + 2 * (m + 1)] = pdm1_op[m + 1][m + 1][s + 4];
-                        (*pmexpr)[p + 2 * (m + 1)] =
-                            i_op * nn_op[m + 1][m + 1][s + 4];
-                        p += 2 * m + 3;
-                    }
-                    assert(p == mshape);
-                }
-                this->middle_operator_names.push_back(pmop);
-                this->middle_operator_exprs.push_back(pmexpr);
-            }
-            // site tensors
-            shared_ptr<OperatorTensor<S>> opt =
-                make_shared<OperatorTensor<S>>();
-            int llshape = 1 + 10 * m;
-            int lrshape = m != n_sites - 1 ? 1 + 10 * (m + 1) : 1;
-            shared_ptr<Symbolic<S>> plmat = nullptr, prmat = nullptr;
-            if (m == 0)
-                plmat = make_shared<SymbolicRowVector<S>>(lrshape);
-            else if (m == n_sites - 1)
-                plmat = make_shared<SymbolicColumnVector<S>>(llshape);
-            else
-                plmat = make_shared<SymbolicMatrix<S>>(llshape, lrshape);
-            (*plmat)[{0, 0}] = i_op;
-            if (m != n_sites - 1) {
-                int pi = 0, pb[4] = {1, 1 + m, 1 + m + m, 1 + m + m + m}, p = 1;
-                for (uint8_t s = 0; s < 4; s++) {
-                    for (uint16_t i = 0; i < m; i++)
-                        (*plmat)[{pb[s] + i, p + i}] = i_op;
-                    (*plmat)[{pi, p + m}] = b_op[m][s];
-                    p += m + 1;
-                }
-                for (uint8_t s = 0; s < 4; s++) {
-                    for (uint16_t i = 0; i < m; i++)
-                        (*plmat)[{pb[(s & 1) | ((s & 1) << 1)] + i, p + i}] =
-                            b_op[m][(s >> 1) | ((s >> 1) << 1)];
-                    (*plmat)[{pi, p + m}] = nn_op[m][m][s];
-                    p += m + 1;
-                }
-                for (uint8_t s = 0; s < 2; s++) {
-                    for (uint16_t i = 0; i < m; i++)
-                        (*plmat)[{pb[s | ((!s) << 1)] + i, p + i}] =
-                            b_op[m][(!s) | (s << 1)];
-                    (*plmat)[{pi, p + m}] = nn_op[m][m][s + 4];
-                    p += m + 1;
-                }
-                assert(p == lrshape);
-            }
-            if (m == n_sites - 1) {
-                prmat = make_shared<SymbolicColumnVector<S>>(11);
-                prmat->data[0] = i_op;
-                for (uint8_t s = 0; s < 6; s++)
-                    prmat->data[1 + s] = nn_op[m][m][s];
-                for (uint8_t s = 0; s < 4; s++)
-                    prmat->data[7 + s] = b_op[m][s];
-            } else {
-                if (m == n_sites - 2)
-                    prmat = make_shared<SymbolicMatrix<S>>(1, 11);
-                else if (m == 0)
-                    prmat = make_shared<SymbolicRowVector<S>>(1);
-                else
-                    prmat = make_shared<SymbolicMatrix<S>>(1, 1);
-                (*prmat)[{0, 0}] = i_op;
-            }
-            opt->lmat = plmat, opt->rmat = prmat;
-            hamil->filter_site_ops(m, {opt->lmat, opt->rmat}, opt->ops);
-            this->tensors.push_back(opt);
-        }
+            },
+            [&vacuum](uint16_t i, uint16_t j,
+                      uint8_t s) -> shared_ptr<OpExpr<S>> {
+                return make_shared<OpElement<S>>(
+                    OpNames::NN,
+                    s < 4 ? SiteIndex({i, j},
+                                      {(uint8_t)(s & 1), (uint8_t)(s >> 1)})
+                          : SiteIndex({i, j}, {(uint8_t)(s - 4), 0, 1}),
+                    vacuum);
+            },
+            [&vacuum](uint16_t i, uint16_t j,
+                      uint8_t s) -> shared_ptr<OpExpr<S>> {
+                return make_shared<OpElement<S>>(
+                    OpNames::PDM1,
+                    s < 4 ? SiteIndex({i, j},
+                                      {(uint8_t)(s & 1), (uint8_t)(s >> 1)})
+                          : SiteIndex({i, j}, {(uint8_t)(s - 4), 0, 1}),
+                    vacuum);
+            },
+            {0, 3, 0, 3, 2, 1}, {0, 0, 3, 3, 1, 2}, {0, 2, 1, 3, 5, 4});
     }
     void deallocate() override {}
     // s == 0: n_{p,sp} x n_{q,sq}
@@ -291,156 +318,29 @@ template <typename S> struct NPC1MPOQC<S, typename S::is_sz_t> : MPO<S> {
 // where Epq = 1pdm spatial
 template <typename S> struct NPC1MPOQC<S, typename S::is_su2_t> : MPO<S> {
     NPC1MPOQC(const shared_ptr<Hamiltonian<S>> &hamil)
+        : NPC1MPOQC(hamil, npc1_all_pairs(hamil->n_sites)) {}
+    // only correlations between the given site pairs (and on-site ones)
+    NPC1MPOQC(const shared_ptr<Hamiltonian<S>> &hamil,
+              const vector<pair<int, int>> &pairs)
         : MPO<S>(hamil->n_sites) {
-        const auto n_sites = MPO<S>::n_sites;
-        shared_ptr<OpExpr<S>> i_op =
-            make_shared<OpElement<S>>(OpNames::I, SiteIndex(), hamil->vacuum);
-        shared_ptr<OpElement<S>> zero_op = make_shared<OpElement<S>>(
-            OpNames::Zero, SiteIndex(), hamil->vacuum);
-#ifdef _MSC_VER
-        vector<vector<shared_ptr<OpExpr<S>>>> b_op(
-            n_sites, vector<shared_ptr<OpExpr<S>>>(2));
-        vector<vector<vector<shared_ptr<OpExpr<S>>>>> nn_op(
-            n_sites, vector<vector<shared_ptr<OpExpr<S>>>>(
-                         n_sites, vector<shared_ptr<OpExpr<S>>>(2)));
-        vector<vector<vector<shared_ptr<OpExpr<S>>>>> pdm1_op(
-            n_sites, vector<vector<shared_ptr<OpExpr<S>>>>(
-                         n_sites, vector<shared_ptr<OpExpr<S>>>(2)));
-#else
-        shared_ptr<OpExpr<S>> b_op[n_sites][2];
-        shared_ptr<OpExpr<S>> nn_op[n_sites][n_sites][2];
-        shared_ptr<OpExpr<S>> pdm1_op[n_sites][n_sites][2];
-#endif
-        for (uint16_t m = 0; m < n_sites; m++)
-            for (uint8_t s = 0; s < 2; s++)
-                b_op[m][s] = make_shared<OpElement<S>>(
+        const S vacuum = hamil->vacuum;
+        build_npc1_mpo<S>(
+            *this, hamil, pairs, 2, 2,
+            [](uint16_t m, uint8_t s) -> shared_ptr<OpExpr<S>> {
+                return make_shared<OpElement<S>>(
                     OpNames::B, SiteIndex(m, m, s), S(0, s * 2, 0));
-        for (uint16_t i = 0; i < n_sites; i++)
-            for (uint16_t j = 0; j < n_sites; j++)
-                for (uint8_t s = 0; s < 2; s++) {
-                    nn_op[i][j][s] = make_shared<OpElement<S>>(
-                        OpNames::NN, SiteIndex(i, j, s), hamil->vacuum);
-                    pdm1_op[i][j][s] = make_shared<OpElement<S>>(
-                        OpNames::PDM1, SiteIndex(i, j, s), hamil->vacuum);
-                }
-        MPO<S>::const_e = 0.0;
-        MPO<S>::op = zero_op;
-        MPO<S>::schemer = nullptr;
-        MPO<S>::tf = make_shared<TensorFunctions<S>>(hamil->opf);
-        MPO<S>::site_op_infos = hamil->site_op_infos;
-        for (uint16_t m = 0; m < n_sites; m++) {
-            int lshape = m != n_sites - 1 ? 1 + 4 * (m + 1) : 1;
-            int rshape = m != n_sites - 1 ? 1 : 5;
-            // left operator names
-            shared_ptr<SymbolicRowVector<S>> plop =
-                make_shared<SymbolicRowVector<S>>(lshape);
-            (*plop)[0] = i_op;
-            if (m != n_sites - 1)
-                for (uint16_t j = 0; j <= m; j++) {
-                    for (uint8_t s = 0; s < 2; s++)
-                        (*plop)[1 + (m + 1) * s + j] = b_op[j][s];
-                    for (uint8_t s = 0; s < 2; s++)
-                        (*plop)[1 + (m + 1) * (2 + s) + j] = nn_op[j][m][s];
-                }
-            this->left_operator_names.push_back(plop);
-            // right operator names
-            shared_ptr<SymbolicColumnVector<S>> prop =
-                make_shared<SymbolicColumnVector<S>>(rshape);
-            (*prop)[0] = i_op;
-            if (m == n_sites - 1) {
-                (*prop)[1] = nn_op[m][m][0];
-                (*prop)[2] = nn_op[m][m][1];
-                (*prop)[3] = b_op[m][0];
-                (*prop)[4] = b_op[m][1];
-            }
-            this->right_operator_names.push_back(prop);
-            // middle operators
-            if (m != n_sites - 1) {
-                int mshape = m != n_sites - 2 ? 2 * (2 * m + 1) : 8 * (m + 1);
-                shared_ptr<SymbolicColumnVector<S>> pmop =
-                    make_shared<SymbolicColumnVector<S>>(mshape);
-                shared_ptr<SymbolicColumnVector<S>> pmexpr =
-                    make_shared<SymbolicColumnVector<S>>(mshape);
-                int p = 0;
-                for (uint8_t s = 0; s < 2; s++) {
-                    for (uint16_t j = 0; j <= m; j++) {
-                        shared_ptr<OpExpr<S>> expr = nn_op[j][m][s] * i_op;
-                        (*pmop)[p + 2 * j] = pdm1_op[m][j][s],
-                                        (*pmexpr)[p + 2 * j] = expr;
-                        if (j != m)
-                            (*pmop)[p + 2 * j + 1] = pdm1_op[j][m][s],
-                                                (*pmexpr)[p + 2 * j + 1] = expr;
-                    }
-                    p += 2 * m + 1;
-                }
-                if (m == n_sites - 2) {
-                    for (uint8_t s = 0; s < 2; s++) {
-                        for (uint16_t j = 0; j <= m; j++) {
-                            shared_ptr<OpExpr<S>> expr =
-                                b_op[j][s] * b_op[m + 1][s];
-                            (*pmop)[p + 2 * j] = pdm1_op[j][m + 1][s];
-                            (*pmop)[p + 2 * j + 1] = pdm1_op[m + 1][j][s];
-                            (*pmexpr)[p + 2 * j] = (*pmexpr)[p + 2 * j + 1] =
-                                expr;
-                        }
-                        p += 2 * (m + 1);
-                        (*pmop)[p] = pdm1_op[m + 1][m + 1][s];
-                        (*pmexpr)[p] = i_op * nn_op[m + 1][m + 1][s];
-                        p++;
-                    }
-                }
-                this->middle_operator_names.push_back(pmop);
-                this->middle_operator_exprs.push_back(pmexpr);
-            }
-            // site tensors
-            shared_ptr<OperatorTensor<S>> opt =
-                make_shared<OperatorTensor<S>>();
-            int llshape = 1 + 4 * m;
-            int lrshape = m != n_sites - 1 ? 1 + 4 * (m + 1) : 1;
-            shared_ptr<Symbolic<S>> plmat = nullptr, prmat = nullptr;
-            if (m == 0)
-                plmat = make_shared<SymbolicRowVector<S>>(lrshape);
-            else if (m == n_sites - 1)
-                plmat = make_shared<SymbolicColumnVector<S>>(llshape);
-            else
-                plmat = make_shared<SymbolicMatrix<S>>(llshape, lrshape);
-            (*plmat)[{0, 0}] = i_op;
-            if (m != n_sites - 1) {
-                int pi = 0, pb[2] = {1, 1 + m}, p = 1;
-                for (uint8_t s = 0; s < 2; s++) {
-                    for (uint16_t i = 0; i < m; i++)
-                        (*plmat)[{pb[s] + i, p + i}] = i_op;
-                    (*plmat)[{pi, p + m}] = b_op[m][s];
-                    p += m + 1;
-                }
-                for (uint8_t s = 0; s < 2; s++) {
-                    for (uint16_t i = 0; i < m; i++)
-                        (*plmat)[{pb[s] + i, p + i}] = b_op[m][s];
-                    (*plmat)[{pi, p + m}] = nn_op[m][m][s];
-                    p += m + 1;
-                }
-                assert(p == lrshape);
-            }
-            if (m == n_sites - 1) {
-                prmat = make_shared<SymbolicColumnVector<S>>(5);
-                prmat->data[0] = i_op;
-                prmat->data[1] = nn_op[m][m][0];
-                prmat->data[2] = nn_op[m][m][1];
-                prmat->data[3] = b_op[m][0];
-                prmat->data[4] = b_op[m][1];
-            } else {
-                if (m == n_sites - 2)
-                    prmat = make_shared<SymbolicMatrix<S>>(1, 5);
-                else if (m == 0)
-                    prmat = make_shared<SymbolicRowVector<S>>(1);
-                else
-                    prmat = make_shared<SymbolicMatrix<S>>(1, 1);
-                (*prmat)[{0, 0}] = i_op;
-            }
-            opt->lmat = plmat, opt->rmat = prmat;
-            hamil->filter_site_ops(m, {opt->lmat, opt->rmat}, opt->ops);
-            this->tensors.push_back(opt);
-        }
+            },
+            [&vacuum](uint16_t i, uint16_t j,
+                      uint8_t s) -> shared_ptr<OpExpr<S>> {
+                return make_shared<OpElement<S>>(OpNames::NN,
+                                                 SiteIndex(i, j, s), vacuum);
+            },
+            [&vacuum](uint16_t i, uint16_t j,
+                      uint8_t s) -> shared_ptr<OpExpr<S>> {
+                return make_shared<OpElement<S>>(OpNames::PDM1,
+                                                 SiteIndex(i, j, s), vacuum);
+            },
+            {0, 1}, {0, 1}, {0, 1});
     }
     void deallocate() override {}
     template <typename FL>
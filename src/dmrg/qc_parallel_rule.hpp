@@ -21,7 +21,9 @@
 #pragma once
 
 #include "../core/parallel_rule.hpp"
+#include <algorithm>
 #include <memory>
+#include <vector>
 
 using namespace std;
 
@@ -30,6 +32,11 @@ namespace block2 {
 // Rule for parallel dispatcher for quantum chemistry MPO
 template <typename S> struct ParallelRuleQC : ParallelRule<S> {
     using ParallelRule<S>::comm;
+    // Owners of two-index operators (indexed by find_index)
+    // If empty or too short, owners are assigned cyclically
+    vector<int> pair_owners;
+    // Measured cost of two-index operators on this proc
+    mutable vector<double> pair_costs;
     ParallelRuleQC(const shared_ptr<ParallelCommunicator<S>> &comm,
                    ParallelCommTypes comm_type = ParallelCommTypes::None)
         : ParallelRule<S>(comm, comm_type) {}
@@ -41,6 +48,58 @@ template <typename S> struct ParallelRuleQC : ParallelRule<S> {
         return i < j ? ((int)j * (j + 1) >> 1) + i
                      : ((int)i * (i + 1) >> 1) + j;
     }
+    static bool is_pair_op(OpNames name) {
+        return name == OpNames::A || name == OpNames::AD ||
+               name == OpNames::P || name == OpNames::PD ||
+               name == OpNames::B || name == OpNames::BD ||
+               name == OpNames::Q || name == OpNames::TEMP;
+    }
+    int pair_owner(int idx) const {
+        return idx < (int)pair_owners.size() ? pair_owners[idx]
+                                             : idx % comm->size;
+    }
+    void record_cost(const shared_ptr<OpElement<S>> &op,
+                     double cost) const override {
+        if (!is_pair_op(op->name))
+            return;
+        int idx = find_index(op->site_index[0], op->site_index[1]);
+        if (idx >= (int)pair_costs.size())
+            pair_costs.resize(idx + 1, 0.0);
+        pair_costs[idx] += cost;
+    }
+    // Reassign two-index operators to procs using the costs recorded on
+    // all procs (largest cost first, to the least loaded proc)
+    // Costs are cleared. Returns true if any owner is changed, in which
+    // case the MPO must be parallelized again and environments rebuilt
+    bool rebalance() {
+        double n = (double)pair_costs.size();
+        comm->allreduce_max(&n, 1);
+        pair_costs.resize((size_t)n, 0.0);
+        comm->allreduce_sum(pair_costs.data(), pair_costs.size());
+        vector<int> idxs(pair_costs.size());
+        for (int i = 0; i < (int)idxs.size(); i++)
+            idxs[i] = i;
+        stable_sort(idxs.begin(), idxs.end(), [this](int i, int j) {
+            return pair_costs[i] > pair_costs[j];
+        });
+        vector<double> loads(comm->size, 0.0);
+        vector<int> owners(idxs.size());
+        bool changed = false;
+        for (int ix : idxs) {
+            // operators never computed keep their owners
+            if (pair_costs[ix] == 0.0)
+                owners[ix] = pair_owner(ix);
+            else {
+                owners[ix] = (int)(min_element(loads.begin(), loads.end()) -
+                                   loads.begin());
+                loads[owners[ix]] += pair_costs[ix];
+            }
+            changed = changed || owners[ix] != pair_owner(ix);
+        }
+        pair_owners = owners;
+        pair_costs.clear();
+        return changed;
+    }
     ParallelProperty
     operator()(const shared_ptr<OpElement<S>> &op) const override {
         SiteIndex si = op->site_index;
@@ -67,7 +126,7 @@ template <typename S> struct ParallelRuleQC : ParallelRule<S> {
         case OpNames::BD:
         case OpNames::Q:
         case OpNames::TEMP:
-            return ParallelProperty(find_index(si[0], si[1]) % comm->size,
+            return ParallelProperty(pair_owner(find_index(si[0], si[1])),
                                     ParallelOpTypes::None);
         case OpNames::X:
         case OpNames::XL:
@@ -132,12 +191,21 @@ template <typename S> struct ParallelRulePDM1QC : ParallelRule<S> {
         : ParallelRule<S>(comm, comm_type) {}
     shared_ptr<ParallelRule<S>> split(int gsize) const override {
         shared_ptr<ParallelRule<S>> r = ParallelRule<S>::split(gsize);
-        return make_shared<ParallelRulePDM1QC<S>>(r->comm, r->comm_type);
+        shared_ptr<ParallelRule<S>> rr =
+            make_shared<ParallelRulePDM1QC<S>>(r->comm, r->comm_type);
+        rr->dynamic_tasks = this->dynamic_tasks;
+        rr->dynamic_chunk = this->dynamic_chunk;
+        return rr;
     }
     void set_partition(ParallelRulePartitionTypes partition) const override {
         this->partition = partition;
     }
     static uint64_t find_index(uint32_t i, uint32_t j) { return i < j ? j : i; }
+    // Right operators are only needed by their owners without dynamic tasks
+    ParallelOpTypes right_type() const {
+        return this->dynamic_tasks ? ParallelOpTypes::Repeated
+                                   : ParallelOpTypes::None;
+    }
     ParallelProperty
     operator()(const shared_ptr<OpElement<S>> &op) const override {
         SiteIndex si = op->site_index;
@@ -152,14 +220,13 @@ template <typename S> struct ParallelRulePDM1QC : ParallelRule<S> {
             case OpNames::D:
             case OpNames::N:
             case OpNames::NN:
-                return ParallelProperty(si[0] % comm->size,
-                                        ParallelOpTypes::None);
+                return ParallelProperty(si[0] % comm->size, right_type());
             case OpNames::A:
             case OpNames::AD:
             case OpNames::B:
             case OpNames::BD:
                 return ParallelProperty(find_index(si[0], si[1]) % comm->size,
-                                        ParallelOpTypes::None);
+                                        right_type());
             default:
                 assert(false);
             }
@@ -188,7 +255,11 @@ template <typename S> struct ParallelRulePDM2QC : ParallelRule<S> {
         : ParallelRule<S>(comm, comm_type) {}
     shared_ptr<ParallelRule<S>> split(int gsize) const override {
         shared_ptr<ParallelRule<S>> r = ParallelRule<S>::split(gsize);
-        return make_shared<ParallelRulePDM2QC<S>>(r->comm, r->comm_type);
+        shared_ptr<ParallelRule<S>> rr =
+            make_shared<ParallelRulePDM2QC<S>>(r->comm, r->comm_type);
+        rr->dynamic_tasks = this->dynamic_tasks;
+        rr->dynamic_chunk = this->dynamic_chunk;
+        return rr;
     }
     void set_partition(ParallelRulePartitionTypes partition) const override {
         this->partition = partition;
@@ -205,6 +276,11 @@ template <typename S> struct ParallelRulePDM2QC : ParallelRule<S> {
         else
             return find_index(arr[2], arr[3]);
     }
+    // Right operators are only needed by their owners without dynamic tasks
+    ParallelOpTypes right_type() const {
+        return this->dynamic_tasks ? ParallelOpTypes::Repeated
+                                   : ParallelOpTypes::None;
+    }
     ParallelProperty
     operator()(const shared_ptr<OpElement<S>> &op) const override {
         SiteIndex si = op->site_index;
@@ -226,7 +302,7 @@ template <typename S> struct ParallelRulePDM2QC : ParallelRule<S> {
             case OpNames::B:
             case OpNames::BD:
                 return ParallelProperty(find_index(si[0], si[1]) % comm->size,
-                                        ParallelOpTypes::None);
+                                        right_type());
             case OpNames::CCD:
             case OpNames::CDC:
             case OpNames::CDD:
@@ -234,8 +310,7 @@ template <typename S> struct ParallelRulePDM2QC : ParallelRule<S> {
             case OpNames::DCD:
             case OpNames::DDC:
             case OpNames::CCDD:
-                return ParallelProperty(si[0] % comm->size,
-                                        ParallelOpTypes::None);
+                return ParallelProperty(si[0] % comm->size, right_type());
             default:
                 assert(false);
             }
@@ -263,7 +338,11 @@ template <typename S> struct ParallelRuleNPDMQC : ParallelRule<S> {
         : ParallelRule<S>(comm, comm_type) {}
     shared_ptr<ParallelRule<S>> split(int gsize) const override {
         shared_ptr<ParallelRule<S>> r = ParallelRule<S>::split(gsize);
-        return make_shared<ParallelRuleNPDMQC<S>>(r->comm, r->comm_type);
+        shared_ptr<ParallelRule<S>> rr =
+            make_shared<ParallelRuleNPDMQC<S>>(r->comm, r->comm_type);
+        rr->dynamic_tasks = this->dynamic_tasks;
+        rr->dynamic_chunk = this->dynamic_chunk;
+        return rr;
     }
     static uint64_t find_index(uint32_t i, uint32_t j) {
         return i < j ? ((int)j * (j + 1) >> 1) + i
@@ -45,6 +45,9 @@ using namespace std;
 
 namespace block2 {
 
+inline double pdm2_conj(double x) { return x; }
+inline complex<double> pdm2_conj(const complex<double> &x) { return conj(x); }
+
 template <typename, typename = void> struct PDM2MPOQC;
 
 // "MPO" for two particle density matrix (non-spin-adapted)
@@ -54,7 +57,10 @@ template <typename S> struct PDM2MPOQC<S, typename S::is_sz_t> : MPO<S> {
                           s_bbbb = 1U << PIJKL(1, 1, 1, 1),
                           s_abba = 1U << PIJKL(0, 1, 1, 0),
                           s_minimal = s_aaaa | s_abba | s_bbbb;
-    PDM2MPOQC(const shared_ptr<Hamiltonian<S>> &hamil, uint16_t mask = s_all)
+    // symm_unique: only compute one element in each set of elements
+    // related by permutation symmetry (see get_matrix_packed)
+    PDM2MPOQC(const shared_ptr<Hamiltonian<S>> &hamil, uint16_t mask = s_all,
+              bool symm_unique = false)
         : MPO<S>(hamil->n_sites) {
         const auto n_sites = MPO<S>::n_sites;
         shared_ptr<OpExpr<S>> i_op =
@@ -1146,38 +1152,146 @@ template <typename S> struct PDM2MPOQC<S, typename S::is_sz_t> : MPO<S> {
                 }
             }
         }
+        if (symm_unique)
+            remove_symm_redundant(mask);
+    }
+    // spin-orbital index of the operator in a 2pdm expectation
+    static array<uint16_t, 4> spin_orbital_index(const SiteIndex &si) {
+        return array<uint16_t, 4>{(uint16_t)(si[0] * 2 + si.s(0)),
+                                  (uint16_t)(si[1] * 2 + si.s(1)),
+                                  (uint16_t)(si[2] * 2 + si.s(2)),
+                                  (uint16_t)(si[3] * 2 + si.s(3))};
+    }
+    // dm2[a, b, c, d] = -dm2[b, a, c, d] = -dm2[a, b, d, c]
+    //                 = conj(dm2[d, c, b, a])
+    // returns the eight related indices with sign and conj flag
+    static vector<tuple<array<uint16_t, 4>, int, bool>>
+    symm_images(const array<uint16_t, 4> &x) {
+        const uint16_t a = x[0], b = x[1], c = x[2], d = x[3];
+        return vector<tuple<array<uint16_t, 4>, int, bool>>{
+            make_tuple(array<uint16_t, 4>{a, b, c, d}, 1, false),
+            make_tuple(array<uint16_t, 4>{b, a, c, d}, -1, false),
+            make_tuple(array<uint16_t, 4>{a, b, d, c}, -1, false),
+            make_tuple(array<uint16_t, 4>{b, a, d, c}, 1, false),
+            make_tuple(array<uint16_t, 4>{d, c, b, a}, 1, true),
+            make_tuple(array<uint16_t, 4>{c, d, b, a}, -1, true),
+            make_tuple(array<uint16_t, 4>{d, c, a, b}, -1, true),
+            make_tuple(array<uint16_t, 4>{c, d, a, b}, 1, true)};
+    }
+    // keep only the element with the smallest index among the related
+    // elements allowed by mask, and drop elements that are always zero
+    void remove_symm_redundant(uint16_t mask) {
+        for (size_t m = 0; m < this->middle_operator_names.size(); m++) {
+            auto pmop = dynamic_pointer_cast<SymbolicColumnVector<S>>(
+                this->middle_operator_names[m]);
+            auto pmexpr = dynamic_pointer_cast<SymbolicColumnVector<S>>(
+                this->middle_operator_exprs[m]);
+            if (pmop == nullptr)
+                continue;
+            vector<size_t> kept;
+            for (size_t i = 0; i < pmop->data.size(); i++) {
+                shared_ptr<OpElement<S>> op =
+                    dynamic_pointer_cast<OpElement<S>>(pmop->data[i]);
+                array<uint16_t, 4> x = spin_orbital_index(op->site_index);
+                if (x[0] == x[1] || x[2] == x[3])
+                    continue;
+                bool unique = true;
+                for (auto &g : symm_images(x)) {
+                    const array<uint16_t, 4> &y = get<0>(g);
+                    if ((mask & (1U << PIJKL(y[0] & 1, y[1] & 1, y[2] & 1,
+                                             y[3] & 1))) &&
+                        y < x) {
+                        unique = false;
+                        break;
+                    }
+                }
+                if (unique)
+                    kept.push_back(i);
+            }
+            shared_ptr<SymbolicColumnVector<S>> nmop =
+                make_shared<SymbolicColumnVector<S>>((int)kept.size());
+            shared_ptr<SymbolicColumnVector<S>> nmexpr =
+                make_shared<SymbolicColumnVector<S>>((int)kept.size());
+            for (size_t i = 0; i < kept.size(); i++) {
+                (*nmop)[i] = pmop->data[kept[i]];
+                (*nmexpr)[i] = pmexpr->data[kept[i]];
+            }
+            this->middle_operator_names[m] = nmop;
+            this->middle_operator_exprs[m] = nmexpr;
+        }
     }
     void deallocate() override {
         for (int16_t m = this->n_sites - 1; m >= 0; m--)
             this->tensors[m]->deallocate();
     }
+    // packed 2pdm: for spin-orbital pairs P = a * (a - 1) / 2 + b (a > b)
+    // and Q = d * (d - 1) / 2 + c (d > c), M[P, Q] = dm2[a, b, c, d] is
+    // hermitian, and its lower triangle M[P, Q] (P >= Q) is stored at
+    // P * (P + 1) / 2 + Q, which is 1/8 of the size of the dense 2pdm
     template <typename FL>
-    static shared_ptr<GTensor<FL>> get_matrix(
+    static shared_ptr<GTensor<FL>> get_matrix_packed(
         const vector<vector<pair<shared_ptr<OpExpr<S>>, FL>>> &expectations,
         uint16_t n_sites) {
-        shared_ptr<GTensor<FL>> r = make_shared<GTensor<FL>>(vector<MKL_INT>{
-            n_sites * 2, n_sites * 2, n_sites * 2, n_sites * 2});
+        const size_t n_pairs = (size_t)n_sites * (n_sites * 2 - 1);
+        shared_ptr<GTensor<FL>> r = make_shared<GTensor<FL>>(
+            vector<MKL_INT>{(MKL_INT)(n_pairs * (n_pairs + 1) / 2)});
         r->clear();
         for (auto &v : expectations)
             for (auto &x : v) {
                 shared_ptr<OpElement<S>> op =
                     dynamic_pointer_cast<OpElement<S>>(x.first);
                 assert(op->name == OpNames::PDM2);
-                (*r)({op->site_index[0] * 2 + op->site_index.s(0),
-                      op->site_index[1] * 2 + op->site_index.s(1),
-                      op->site_index[2] * 2 + op->site_index.s(2),
-                      op->site_index[3] * 2 + op->site_index.s(3)}) = x.second;
+                array<uint16_t, 4> idx = spin_orbital_index(op->site_index);
+                size_t a = idx[0], b = idx[1], c = idx[2], d = idx[3];
+                if (a == b || c == d)
+                    continue;
+                FL f = x.second;
+                if (a < b)
+                    swap(a, b), f = -f;
+                if (d < c)
+                    swap(c, d), f = -f;
+                const size_t p = a * (a - 1) / 2 + b, q = d * (d - 1) / 2 + c;
+                if (p >= q)
+                    r->data[p * (p + 1) / 2 + q] = f;
+                else
+                    r->data[q * (q + 1) / 2 + p] = pdm2_conj(f);
             }
         return r;
     }
     template <typename FL>
-    static shared_ptr<GTensor<FL>> get_matrix_spatial(
-        const vector<vector<pair<shared_ptr<OpExpr<S>>, FL>>> &expectations,
-        uint16_t n_sites) {
+    static shared_ptr<GTensor<FL>>
+    unpack_matrix(const shared_ptr<GTensor<FL>> &packed, uint16_t n_sites) {
+        const uint16_t n = n_sites * 2;
+        shared_ptr<GTensor<FL>> r =
+            make_shared<GTensor<FL>>(vector<MKL_INT>{n, n, n, n});
+        r->clear();
+        for (uint16_t a = 0; a < n; a++)
+            for (uint16_t b = 0; b < a; b++)
+                for (uint16_t d = 0; d < n; d++)
+                    for (uint16_t c = 0; c < d; c++) {
+                        const size_t p = (size_t)a * (a - 1) / 2 + b,
+                                     q = (size_t)d * (d - 1) / 2 + c;
+                        const FL f =
+                            p >= q ? packed->data[p * (p + 1) / 2 + q]
+                                   : pdm2_conj(packed->data[q * (q + 1) / 2 + p]);
+                        (*r)({a, b, c, d}) = (*r)({b, a, d, c}) = f;
+                        (*r)({b, a, c, d}) = (*r)({a, b, d, c}) = -f;
+                    }
+        return r;
+    }
+    template <typename FL>
+    static shared_ptr<GTensor<FL>>
+    unpack_matrix_spatial(const shared_ptr<GTensor<FL>> &packed,
+                          uint16_t n_sites) {
+        return spin_sum_matrix(unpack_matrix(packed, n_sites), n_sites);
+    }
+    // spatial 2pdm from spin-orbital 2pdm t
+    template <typename FL>
+    static shared_ptr<GTensor<FL>>
+    spin_sum_matrix(const shared_ptr<GTensor<FL>> &t, uint16_t n_sites) {
         shared_ptr<GTensor<FL>> r = make_shared<GTensor<FL>>(
             vector<MKL_INT>{n_sites, n_sites, n_sites, n_sites});
         r->clear();
-        shared_ptr<GTensor<FL>> t = get_matrix(expectations, n_sites);
         for (uint16_t i = 0; i < n_sites; i++)
             for (uint16_t j = 0; j < n_sites; j++)
                 for (uint16_t k = 0; k < n_sites; k++)
@@ -1189,6 +1303,97 @@ template <typename S> struct PDM2MPOQC<S, typename S::is_sz_t> : MPO<S> {
                             (*t)({i * 2 + 1, j * 2 + 1, k * 2 + 1, l * 2 + 1});
         return r;
     }
+    // elements not computed (symm_unique or mask) are filled by symmetry
+    template <typename FL>
+    static shared_ptr<GTensor<FL>> get_matrix(
+        const vector<vector<pair<shared_ptr<OpExpr<S>>, FL>>> &expectations,
+        uint16_t n_sites) {
+        return unpack_matrix(get_matrix_packed(expectations, n_sites), n_sites);
+    }
+    template <typename FL>
+    static shared_ptr<GTensor<FL>> get_matrix_spatial(
+        const vector<vector<pair<shared_ptr<OpExpr<S>>, FL>>> &expectations,
+        uint16_t n_sites) {
+        return unpack_matrix_spatial(get_matrix_packed(expectations, n_sites),
+                                     n_sites);
+    }
+    // transition 2pdm < bra | a^\dagger_a a^\dagger_b a_c a_d | ket >, which
+    // is not hermitian, so only antisymmetry is used to fill elements
+    // (should be computed without symm_unique)
+    template <typename FL>
+    static shared_ptr<GTensor<FL>> get_transition_matrix(
+        const vector<vector<pair<shared_ptr<OpExpr<S>>, FL>>> &expectations,
+        uint16_t n_sites) {
+        const uint16_t n = n_sites * 2;
+        shared_ptr<GTensor<FL>> r =
+            make_shared<GTensor<FL>>(vector<MKL_INT>{n, n, n, n});
+        r->clear();
+        for (auto &v : expectations)
+            for (auto &x : v) {
+                shared_ptr<OpElement<S>> op =
+                    dynamic_pointer_cast<OpElement<S>>(x.first);
+                assert(op->name == OpNames::PDM2);
+                const array<uint16_t, 4> ix =
+                    spin_orbital_index(op->site_index);
+                (*r)({ix[0], ix[1], ix[2], ix[3]}) =
+                    (*r)({ix[1], ix[0], ix[3], ix[2]}) = x.second;
+                if (ix[0] != ix[1] && ix[2] != ix[3])
+                    (*r)({ix[1], ix[0], ix[2], ix[3]}) =
+                        (*r)({ix[0], ix[1], ix[3], ix[2]}) = -x.second;
+            }
+        return r;
+    }
+    template <typename FL>
+    static shared_ptr<GTensor<FL>> get_transition_matrix_spatial(
+        const vector<vector<pair<shared_ptr<OpExpr<S>>, FL>>> &expectations,
+        uint16_t n_sites) {
+        return spin_sum_matrix(get_transition_matrix(expectations, n_sites),
+                               n_sites);
+    }
+    // 1pdm from the partial trace of 2pdm, so that both are obtained from
+    // a single sweep: dm1[i, l] = sum_j dm2[i, j, j, l] / (n_elec - 1)
+    // only the aaaa, abba and bbbb blocks are used (baab is obtained from
+    // abba), so this also works for 2pdm computed with s_minimal
+    template <typename FL>
+    static GMatrix<FL> get_matrix_pdm1(
+        const vector<vector<pair<shared_ptr<OpExpr<S>>, FL>>> &expectations,
+        uint16_t n_sites, int n_elec) {
+        if (n_elec < 2)
+            throw runtime_error(
+                "1pdm cannot be obtained from 2pdm for less than 2 electrons!");
+        GMatrix<FL> r(nullptr, n_sites * 2, n_sites * 2);
+        r.allocate();
+        r.clear();
+        shared_ptr<GTensor<FL>> t = get_matrix(expectations, n_sites);
+        const FL f = (FL)(1.0 / (n_elec - 1));
+        for (uint16_t i = 0; i < n_sites; i++)
+            for (uint16_t l = 0; l < n_sites; l++) {
+                FL xa = 0, xb = 0;
+                for (uint16_t j = 0; j < n_sites; j++) {
+                    xa += (*t)({i * 2 + 0, j * 2 + 0, j * 2 + 0, l * 2 + 0}) +
+                          (*t)({i * 2 + 0, j * 2 + 1, j * 2 + 1, l * 2 + 0});
+                    xb += (*t)({i * 2 + 1, j * 2 + 1, j * 2 + 1, l * 2 + 1}) +
+                          (*t)({j * 2 + 0, i * 2 + 1, l * 2 + 1, j * 2 + 0});
+                }
+                r(i * 2 + 0, l * 2 + 0) = xa * f;
+                r(i * 2 + 1, l * 2 + 1) = xb * f;
+            }
+        return r;
+    }
+    template <typename FL>
+    static GMatrix<FL> get_matrix_pdm1_spatial(
+        const vector<vector<pair<shared_ptr<OpExpr<S>>, FL>>> &expectations,
+        uint16_t n_sites, int n_elec) {
+        GMatrix<FL> r(nullptr, n_sites, n_sites);
+        r.allocate();
+        r.clear();
+        GMatrix<FL> t = get_matrix_pdm1(expectations, n_sites, n_elec);
+        for (uint16_t i = 0; i < n_sites; i++)
+            for (uint16_t j = 0; j < n_sites; j++)
+                r(i, j) = t(2 * i + 0, 2 * j + 0) + t(2 * i + 1, 2 * j + 1);
+        t.deallocate();
+        return r;
+    }
 };
 
 // "MPO" for two particle density matrix (spin-adapted)
@@ -1198,7 +1403,10 @@ template <typename S> struct PDM2MPOQC<S, typename S::is_sz_t> : MPO<S> {
 // [pqrs][0] = (Cp \otimes_0 Cq) \otimes_0 (Dr \otimes_0 Ds)
 // [pqrs][1] = (Cp \otimes_1 Cq) \otimes_0 (Dr \otimes_1 Ds)
 template <typename S> struct PDM2MPOQC<S, typename S::is_su2_t> : MPO<S> {
-    PDM2MPOQC(const shared_ptr<Hamiltonian<S>> &hamil)
+    // symm_unique: only compute one element in each set of elements
+    // related by permutation symmetry (see get_matrix_packed)
+    PDM2MPOQC(const shared_ptr<Hamiltonian<S>> &hamil,
+              bool symm_unique = false)
         : MPO<S>(hamil->n_sites) {
         const auto n_sites = MPO<S>::n_sites;
         shared_ptr<OpExpr<S>> i_op =
@@ -2210,11 +2418,63 @@ template <typename S> struct PDM2MPOQC<S, typename S::is_su2_t> : MPO<S> {
                 }
             }
         }
+        if (symm_unique)
+            remove_symm_redundant();
+    }
+    // dm2[i, j, k, l] = dm2[j, i, l, k] = conj(dm2[l, k, j, i])
+    //                 = conj(dm2[k, l, i, j]) for the spatial 2pdm
+    // (the two spin components of elements with repeated indices
+    // are not related in the same way, so both are always kept)
+    static array<array<uint16_t, 4>, 4>
+    symm_images(const array<uint16_t, 4> &x) {
+        const uint16_t i = x[0], j = x[1], k = x[2], l = x[3];
+        return array<array<uint16_t, 4>, 4>{
+            array<uint16_t, 4>{i, j, k, l}, array<uint16_t, 4>{j, i, l, k},
+            array<uint16_t, 4>{l, k, j, i}, array<uint16_t, 4>{k, l, i, j}};
+    }
+    static bool is_symm_unique(const array<uint16_t, 4> &x) {
+        for (auto &y : symm_images(x))
+            if (y < x)
+                return false;
+        return true;
+    }
+    // keep only the element with the smallest index among the related
+    // elements, and drop elements that are always zero
+    void remove_symm_redundant() {
+        for (size_t m = 0; m < this->middle_operator_names.size(); m++) {
+            auto pmop = dynamic_pointer_cast<SymbolicColumnVector<S>>(
+                this->middle_operator_names[m]);
+            auto pmexpr = dynamic_pointer_cast<SymbolicColumnVector<S>>(
+                this->middle_operator_exprs[m]);
+            if (pmop == nullptr)
+                continue;
+            vector<size_t> kept;
+            for (size_t i = 0; i < pmop->data.size(); i++) {
+                shared_ptr<OpElement<S>> op =
+                    dynamic_pointer_cast<OpElement<S>>(pmop->data[i]);
+                const SiteIndex &si = op->site_index;
+                if (si.ss() == 1 && (si[0] == si[1] || si[2] == si[3]))
+                    continue;
+                if (is_symm_unique({si[0], si[1], si[2], si[3]}))
+                    kept.push_back(i);
+            }
+            shared_ptr<SymbolicColumnVector<S>> nmop =
+                make_shared<SymbolicColumnVector<S>>((int)kept.size());
+            shared_ptr<SymbolicColumnVector<S>> nmexpr =
+                make_shared<SymbolicColumnVector<S>>((int)kept.size());
+            for (size_t i = 0; i < kept.size(); i++) {
+                (*nmop)[i] = pmop->data[kept[i]];
+                (*nmexpr)[i] = pmexpr->data[kept[i]];
+            }
+            this->middle_operator_names[m] = nmop;
+            this->middle_operator_exprs[m] = nmexpr;
+        }
     }
     void deallocate() override {
         for (int16_t m = this->n_sites - 1; m >= 0; m--)
             this->tensors[m]->deallocate();
     }
+    // with symm_unique, only the symmetry-unique elements are present
     template <typename FL>
     static shared_ptr<GTensor<FL>> get_matrix_reduced(
         const vector<vector<pair<shared_ptr<OpExpr<S>>, FL>>> &expectations,
@@ -2232,23 +2492,81 @@ template <typename S> struct PDM2MPOQC<S, typename S::is_su2_t> : MPO<S> {
             }
         return r;
     }
-    // only for singlet
+    // packed spatial 2pdm: for pairs P = i * n_sites + j and
+    // Q = l * n_sites + k, M[P, Q] = dm2[i, j, k, l] is hermitian, and its
+    // lower triangle M[P, Q] (P >= Q) is stored at P * (P + 1) / 2 + Q
     template <typename FL>
-    static shared_ptr<GTensor<FL>> get_matrix(
+    static shared_ptr<GTensor<FL>> get_matrix_packed(
         const vector<vector<pair<shared_ptr<OpExpr<S>>, FL>>> &expectations,
         uint16_t n_sites) {
+        const size_t n_pairs = (size_t)n_sites * n_sites;
+        const MKL_INT n_packed = (MKL_INT)(n_pairs * (n_pairs + 1) / 2);
+        // the two spin components are collected separately,
+        // since an element can appear in more than one site
+        shared_ptr<GTensor<FL>> t =
+            make_shared<GTensor<FL>>(vector<MKL_INT>{n_packed, 2});
+        t->clear();
+        auto idx = [n_sites](size_t i, size_t j, size_t k, size_t l) {
+            const size_t p = i * n_sites + j, q = l * n_sites + k;
+            return p >= q ? make_pair(p * (p + 1) / 2 + q, false)
+                          : make_pair(q * (q + 1) / 2 + p, true);
+        };
+        for (auto &v : expectations)
+            for (auto &x : v) {
+                shared_ptr<OpElement<S>> op =
+                    dynamic_pointer_cast<OpElement<S>>(x.first);
+                assert(op->name == OpNames::PDM2);
+                const SiteIndex &si = op->site_index;
+                // only the spin components of the representative element
+                // are used, as they are not related for the other ones
+                if (!is_symm_unique({si[0], si[1], si[2], si[3]}))
+                    continue;
+                pair<size_t, bool> pa = idx(si[0], si[1], si[2], si[3]);
+                pair<size_t, bool> pb = idx(si[1], si[0], si[3], si[2]);
+                t->data[pa.first * 2 + si.ss()] =
+                    pa.second ? pdm2_conj(x.second) : x.second;
+                t->data[pb.first * 2 + si.ss()] =
+                    pb.second ? pdm2_conj(x.second) : x.second;
+            }
+        shared_ptr<GTensor<FL>> r =
+            make_shared<GTensor<FL>>(vector<MKL_INT>{n_packed});
+        for (MKL_INT i = 0; i < n_packed; i++)
+            r->data[i] = -t->data[i * 2 + 0] + sqrt(3) * t->data[i * 2 + 1];
+        return r;
+    }
+    template <typename FL>
+    static shared_ptr<GTensor<FL>>
+    unpack_matrix_spatial(const shared_ptr<GTensor<FL>> &packed,
+                          uint16_t n_sites) {
+        shared_ptr<GTensor<FL>> r = make_shared<GTensor<FL>>(
+            vector<MKL_INT>{n_sites, n_sites, n_sites, n_sites});
+        for (uint16_t i = 0; i < n_sites; i++)
+            for (uint16_t j = 0; j < n_sites; j++)
+                for (uint16_t k = 0; k < n_sites; k++)
+                    for (uint16_t l = 0; l < n_sites; l++) {
+                        const size_t p = (size_t)i * n_sites + j,
+                                     q = (size_t)l * n_sites + k;
+                        (*r)({i, j, k, l}) =
+                            p >= q
+                                ? packed->data[p * (p + 1) / 2 + q]
+                                : pdm2_conj(packed->data[q * (q + 1) / 2 + p]);
+                    }
+        return r;
+    }
+    // only for singlet
+    template <typename FL>
+    static shared_ptr<GTensor<FL>>
+    unpack_matrix(const shared_ptr<GTensor<FL>> &packed, uint16_t n_sites) {
         shared_ptr<GTensor<FL>> r = make_shared<GTensor<FL>>(vector<MKL_INT>{
             n_sites * 2, n_sites * 2, n_sites * 2, n_sites * 2});
         r->clear();
-        shared_ptr<GTensor<FL>> t = get_matrix_reduced(expectations, n_sites);
+        shared_ptr<GTensor<FL>> t = unpack_matrix_spatial(packed, n_sites);
         for (uint16_t i = 0; i < n_sites; i++)
             for (uint16_t j = 0; j < n_sites; j++)
                 for (uint16_t k = 0; k < n_sites; k++)
                     for (uint16_t l = 0; l <= k; l++) {
-                        FL a = -(*t)({i, j, k, l, 0}) +
-                               sqrt(3) * (*t)({i, j, k, l, 1});
-                        FL b = -(*t)({i, j, l, k, 0}) +
-                               sqrt(3) * (*t)({i, j, l, k, 1});
+                        FL a = (*t)({i, j, k, l});
+                        FL b = (*t)({i, j, l, k});
                         (*r)({i * 2 + 0, j * 2 + 0, k * 2 + 0, l * 2 + 0}) =
                             (*r)({i * 2 + 1, j * 2 + 1, k * 2 + 1, l * 2 + 1}) =
                                 (a - b) / 6.0;
@@ -2270,20 +2588,72 @@ template <typename S> struct PDM2MPOQC<S, typename S::is_su2_t> : MPO<S> {
                     }
         return r;
     }
+    // only for singlet
+    template <typename FL>
+    static shared_ptr<GTensor<FL>> get_matrix(
+        const vector<vector<pair<shared_ptr<OpExpr<S>>, FL>>> &expectations,
+        uint16_t n_sites) {
+        return unpack_matrix(get_matrix_packed(expectations, n_sites), n_sites);
+    }
     template <typename FL>
     static shared_ptr<GTensor<FL>> get_matrix_spatial(
+        const vector<vector<pair<shared_ptr<OpExpr<S>>, FL>>> &expectations,
+        uint16_t n_sites) {
+        return unpack_matrix_spatial(get_matrix_packed(expectations, n_sites),
+                                     n_sites);
+    }
+    // transition spatial 2pdm between two states, which is not hermitian,
+    // so no symmetry is used (should be computed without symm_unique)
+    template <typename FL>
+    static shared_ptr<GTensor<FL>> get_transition_matrix_spatial(
         const vector<vector<pair<shared_ptr<OpExpr<S>>, FL>>> &expectations,
         uint16_t n_sites) {
         shared_ptr<GTensor<FL>> r = make_shared<GTensor<FL>>(
             vector<MKL_INT>{n_sites, n_sites, n_sites, n_sites});
-        r->clear();
         shared_ptr<GTensor<FL>> t = get_matrix_reduced(expectations, n_sites);
+        for (size_t i = 0; i < r->size(); i++)
+            r->data[i] = -t->data[i * 2] + sqrt(3) * t->data[i * 2 + 1];
+        return r;
+    }
+    // 1pdm from the partial trace of 2pdm, so that both are obtained from
+    // a single sweep: dm1[i, l] = sum_j dm2[i, j, j, l] / (n_elec - 1)
+    template <typename FL>
+    static GMatrix<FL> get_matrix_pdm1_spatial(
+        const vector<vector<pair<shared_ptr<OpExpr<S>>, FL>>> &expectations,
+        uint16_t n_sites, int n_elec) {
+        if (n_elec < 2)
+            throw runtime_error(
+                "1pdm cannot be obtained from 2pdm for less than 2 electrons!");
+        GMatrix<FL> r(nullptr, n_sites, n_sites);
+        r.allocate();
+        r.clear();
+        shared_ptr<GTensor<FL>> t = get_matrix_spatial(expectations, n_sites);
+        const FL f = (FL)(1.0 / (n_elec - 1));
         for (uint16_t i = 0; i < n_sites; i++)
-            for (uint16_t j = 0; j < n_sites; j++)
-                for (uint16_t k = 0; k < n_sites; k++)
-                    for (uint16_t l = 0; l < n_sites; l++)
-                        (*r)({i, j, k, l}) = -(*t)({i, j, k, l, 0}) +
-                                             sqrt(3) * (*t)({i, j, k, l, 1});
+            for (uint16_t l = 0; l < n_sites; l++) {
+                FL x = 0;
+                for (uint16_t j = 0; j < n_sites; j++)
+                    x += (*t)({i, j, j, l});
+                r(i, l) = x * f;
+            }
+        return r;
+    }
+    // only for singlet
+    template <typename FL>
+    static GMatrix<FL> get_matrix_pdm1(
+        const vector<vector<pair<shared_ptr<OpExpr<S>>, FL>>> &expectations,
+        uint16_t n_sites, int n_elec) {
+        GMatrix<FL> r(nullptr, n_sites * 2, n_sites * 2);
+        r.allocate();
+        r.clear();
+        GMatrix<FL> t =
+            get_matrix_pdm1_spatial(expectations, n_sites, n_elec);
+        for (uint16_t i = 0; i < n_sites; i++)
+            for (uint16_t j = 0; j < n_sites; j++) {
+                r(2 * i + 0, 2 * j + 0) = t(i, j) / 2.0;
+                r(2 * i + 1, 2 * j + 1) = t(i, j) / 2.0;
+            }
+        t.deallocate();
         return r;
     }
 };
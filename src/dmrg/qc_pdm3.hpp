@@ -0,0 +1,270 @@
+
+/*
+ * block2: Efficient MPO implementation of quantum chemistry DMRG
+ * Copyright (C) 2020-2021 Huanchen Zhai <hczhai@caltech.edu>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#pragma once
+
+#include "../core/rule.hpp"
+#include "moving_environment.hpp"
+#include "mpo_simplification.hpp"
+#include "mps.hpp"
+#include "qc_mpo.hpp"
+#include "qc_pdm2.hpp"
+#include "qc_rule.hpp"
+#include "sweep_algorithm.hpp"
+#include <array>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <string>
+
+using namespace std;
+
+namespace block2 {
+
+template <typename, typename = void> struct PDM3Stream;
+
+// Three particle density matrix (non-spin-adapted), evaluated chunk by
+// chunk and streamed to disk, so that no O(N^6) array is ever formed
+//   dm3[i, j, k, l, m, n] = < a^\dagger_i a^\dagger_j a^\dagger_k a_l a_m a_n >
+//                         = < phi_k | a^\dagger_i a^\dagger_j a_l a_m | phi_n >
+// with |phi_p> = a_p |psi> obtained by compression. Chunk (k, n) is one
+// transition 2pdm sweep between |phi_k> and |phi_n>, and only the elements
+// with i > j > k and l > m > n are stored (all others follow from
+// antisymmetry). Chunks with the leading index k = proc_id (mod n_procs)
+// are evaluated, so that independent processes can share the work
+template <typename S> struct PDM3Stream<S, typename S::is_sz_t> {
+    shared_ptr<Hamiltonian<S>> hamil;
+    shared_ptr<MPS<S>> mps;
+    shared_ptr<MPO<S>> pdm2_mpo;
+    // cached |phi_p> (stored in the scratch folder)
+    map<uint16_t, shared_ptr<MPS<S>>> phis;
+    ubond_t bond_dim;
+    // compression sweeps for |phi_p>
+    int n_sweeps = 4;
+    double cutoff = 1E-14;
+    // chunk (k, n) is written to "<filename>.<k>.<n>"
+    string filename, tag = "PDM3";
+    int proc_id = 0, n_procs = 1;
+    uint8_t iprint = 1;
+    PDM3Stream(const shared_ptr<Hamiltonian<S>> &hamil,
+               const shared_ptr<MPS<S>> &mps, ubond_t bond_dim,
+               const string &filename = "")
+        : hamil(hamil), mps(mps), bond_dim(bond_dim), filename(filename) {
+        if (this->filename == "")
+            this->filename = frame_()->save_dir + "/" + tag;
+        pdm2_mpo = make_shared<SimplifiedMPO<S>>(
+            make_shared<PDM2MPOQC<S>>(hamil),
+            make_shared<NoTransposeRule<S>>(make_shared<RuleQC<S>>()), true,
+            true, OpNamesSet({OpNames::R, OpNames::RD}));
+    }
+    virtual ~PDM3Stream() = default;
+    uint16_t n_spin_orbs() const { return (uint16_t)(hamil->n_sites * 2); }
+    // number of pairs i > j > k in n spin orbitals
+    static size_t n_pairs(uint16_t n, uint16_t k) {
+        const size_t m = n - 1 - k;
+        return k + 2 >= n ? 0 : m * (m - 1) / 2;
+    }
+    // index of pair i > j > k
+    static size_t pair_index(uint16_t i, uint16_t j, uint16_t k) {
+        const size_t a = i - k - 1, b = j - k - 1;
+        return a * (a - 1) / 2 + b;
+    }
+    string chunk_filename(uint16_t k, uint16_t n) const {
+        stringstream ss;
+        ss << filename << "." << k << "." << n;
+        return ss.str();
+    }
+    // |phi_p> = a_p |psi>, fitted with the same center as |psi>
+    shared_ptr<MPS<S>> get_phi(uint16_t p) {
+        if (phis.count(p))
+            return phis.at(p);
+        const uint16_t ix = p / 2;
+        const uint8_t s = p % 2;
+        shared_ptr<OpElement<S>> d_op = make_shared<OpElement<S>>(
+            OpNames::D, SiteIndex({ix}, {s}),
+            S(-1, s ? 1 : -1, S::pg_inv(hamil->orb_sym[ix])));
+        shared_ptr<MPO<S>> dmpo = make_shared<SimplifiedMPO<S>>(
+            make_shared<SiteMPO<S>>(hamil, d_op),
+            make_shared<NoTransposeRule<S>>(make_shared<RuleQC<S>>()), true);
+        shared_ptr<MPSInfo<S>> info = make_shared<MPSInfo<S>>(
+            mps->n_sites, mps->info->vacuum, mps->info->target + d_op->q_label,
+            mps->info->basis);
+        info->tag = tag + "-PHI" + Parsing::to_string(p);
+        info->set_bond_dimension(bond_dim);
+        shared_ptr<MPS<S>> phi =
+            make_shared<MPS<S>>(mps->n_sites, mps->center, mps->dot);
+        phi->initialize(info);
+        phi->random_canonicalize();
+        phi->save_mutable();
+        phi->deallocate();
+        info->save_mutable();
+        info->deallocate_mutable();
+        const int center = mps->center;
+        shared_ptr<MovingEnvironment<S>> rme =
+            make_shared<MovingEnvironment<S>>(dmpo, phi, mps, tag + "-RHS");
+        rme->init_environments(iprint >= 2);
+        shared_ptr<Linear<S>> linear = make_shared<Linear<S>>(
+            rme, vector<ubond_t>{bond_dim},
+            vector<ubond_t>{mps->info->bond_dim});
+        linear->eq_type = EquationTypes::PerturbativeCompression;
+        linear->cutoff = cutoff;
+        linear->iprint = iprint >= 2 ? iprint - 1 : 0;
+        linear->solve(n_sweeps, mps->center == 0, 0);
+        if (mps->center != center)
+            linear->solve(1, mps->center == 0, 0);
+        dmpo->deallocate();
+        return phis[p] = phi;
+    }
+    // M[P, Q] = dm3[i, j, k, l, m, n] with
+    // P = pair_index(i, j, k) and Q = pair_index(l, m, n)
+    shared_ptr<GTensor<double>> compute_chunk(uint16_t k, uint16_t n) {
+        const uint16_t no = n_spin_orbs();
+        const size_t pk = n_pairs(no, k), pn = n_pairs(no, n);
+        shared_ptr<GTensor<double>> r = make_shared<GTensor<double>>(
+            vector<MKL_INT>{(MKL_INT)pk, (MKL_INT)pn});
+        r->clear();
+        if (pk == 0 || pn == 0)
+            return r;
+        shared_ptr<MPS<S>> bra = get_phi(k)->deep_copy(tag + "-BRA");
+        shared_ptr<MPS<S>> ket =
+            k == n ? bra : get_phi(n)->deep_copy(tag + "-KET");
+        shared_ptr<MovingEnvironment<S>> me =
+            make_shared<MovingEnvironment<S>>(pdm2_mpo, bra, ket, tag + "-EX");
+        me->init_environments(iprint >= 2);
+        shared_ptr<Expect<S>> ex = make_shared<Expect<S>>(
+            me, bra->info->bond_dim, ket->info->bond_dim);
+        ex->iprint = iprint >= 2 ? iprint - 1 : 0;
+        ex->solve(true, ket->center == 0);
+        for (auto &v : ex->expectations)
+            for (auto &x : v) {
+                shared_ptr<OpElement<S>> op =
+                    dynamic_pointer_cast<OpElement<S>>(x.first);
+                assert(op->name == OpNames::PDM2);
+                array<uint16_t, 4> ix =
+                    PDM2MPOQC<S>::spin_orbital_index(op->site_index);
+                if (ix[0] > ix[1] && ix[1] > k && ix[2] > ix[3] && ix[3] > n)
+                    r->data[pair_index(ix[0], ix[1], k) * pn +
+                            pair_index(ix[2], ix[3], n)] = x.second;
+            }
+        return r;
+    }
+    void save_chunk(uint16_t k, uint16_t n,
+                    const shared_ptr<GTensor<double>> &r) const {
+        ofstream ofs(chunk_filename(k, n).c_str(), ios::binary);
+        if (!ofs.good())
+            throw runtime_error("PDM3Stream::save_chunk on '" +
+                                chunk_filename(k, n) + "' failed.");
+        size_t shape[2] = {(size_t)r->shape[0], (size_t)r->shape[1]};
+        ofs.write((char *)shape, sizeof(shape));
+        ofs.write((char *)r->data.data(), sizeof(double) * r->size());
+        if (!ofs.good())
+            throw runtime_error("PDM3Stream::save_chunk on '" +
+                                chunk_filename(k, n) + "' failed.");
+        ofs.close();
+    }
+    shared_ptr<GTensor<double>> load_chunk(uint16_t k, uint16_t n) const {
+        ifstream ifs(chunk_filename(k, n).c_str(), ios::binary);
+        if (!ifs.good())
+            throw runtime_error("PDM3Stream::load_chunk on '" +
+                                chunk_filename(k, n) + "' failed.");
+        size_t shape[2];
+        ifs.read((char *)shape, sizeof(shape));
+        shared_ptr<GTensor<double>> r = make_shared<GTensor<double>>(
+            vector<MKL_INT>{(MKL_INT)shape[0], (MKL_INT)shape[1]});
+        ifs.read((char *)r->data.data(), sizeof(double) * r->size());
+        if (ifs.fail())
+            throw runtime_error("PDM3Stream::load_chunk on '" +
+                                chunk_filename(k, n) + "' failed.");
+        ifs.close();
+        return r;
+    }
+    // evaluates and saves all chunks belonging to this process
+    // returns the number of chunks saved
+    size_t solve() {
+        Timer t;
+        t.get_time();
+        const uint16_t no = n_spin_orbs();
+        size_t nc = 0;
+        for (uint16_t k = 0; k < no; k++) {
+            if (k % n_procs != proc_id)
+                continue;
+            for (uint16_t n = 0; n < no; n++, nc++)
+                save_chunk(k, n, compute_chunk(k, n));
+            if (iprint >= 1)
+                cout << "PDM3 | K = " << setw(4) << k << " / " << setw(4) << no
+                     << " | T = " << fixed << setprecision(3) << t.get_time()
+                     << endl;
+        }
+        return nc;
+    }
+    // dense spin-free 3pdm from all saved chunks (for small active spaces)
+    //   dm3[i, j, k, l, m, n] = sum_{stu} < a^\dagger_{is} a^\dagger_{jt}
+    //                                        a^\dagger_{ku} a_{lu} a_{mt} a_{ns} >
+    shared_ptr<GTensor<double>> get_matrix_spatial() const {
+        const uint16_t no = n_spin_orbs();
+        const MKL_INT ns = hamil->n_sites;
+        shared_ptr<GTensor<double>> r = make_shared<GTensor<double>>(
+            vector<MKL_INT>{ns, ns, ns, ns, ns, ns});
+        r->clear();
+        // permutations of three indices with parity
+        const int perm[6][3] = {{0, 1, 2}, {1, 2, 0}, {2, 0, 1},
+                                {1, 0, 2}, {0, 2, 1}, {2, 1, 0}};
+        const int perm_sign[6] = {1, 1, 1, -1, -1, -1};
+        for (uint16_t k = 0; k < no; k++)
+            for (uint16_t n = 0; n < no; n++) {
+                if (n_pairs(no, k) == 0 || n_pairs(no, n) == 0)
+                    continue;
+                shared_ptr<GTensor<double>> m = load_chunk(k, n);
+                const size_t pn = m->shape[1];
+                for (uint16_t i = k + 2; i < no; i++)
+                    for (uint16_t j = k + 1; j < i; j++)
+                        for (uint16_t l = n + 2; l < no; l++)
+                            for (uint16_t mm = n + 1; mm < l; mm++) {
+                                const double v =
+                                    m->data[pair_index(i, j, k) * pn +
+                                            pair_index(l, mm, n)];
+                                if (v == 0)
+                                    continue;
+                                const uint16_t a[3] = {i, j, k},
+                                               b[3] = {l, mm, n};
+                                for (int pa = 0; pa < 6; pa++)
+                                    for (int pb = 0; pb < 6; pb++) {
+                                        const uint16_t x[6] = {
+                                            a[perm[pa][0]], a[perm[pa][1]],
+                                            a[perm[pa][2]], b[perm[pb][0]],
+                                            b[perm[pb][1]], b[perm[pb][2]]};
+                                        if ((x[0] & 1) != (x[5] & 1) ||
+                                            (x[1] & 1) != (x[4] & 1) ||
+                                            (x[2] & 1) != (x[3] & 1))
+                                            continue;
+                                        size_t ix = 0;
+                                        for (int q = 0; q < 6; q++)
+                                            ix = ix * ns + (x[q] >> 1);
+                                        r->data[ix] += perm_sign[pa] *
+                                                       perm_sign[pb] * v;
+                                    }
+                            }
+            }
+        return r;
+    }
+    void deallocate() { pdm2_mpo->deallocate(); }
+};
+
+} // namespace block2
@@ -33,6 +33,7 @@
 #include <cstring>
 #include <iomanip>
 #include <iostream>
+#include <map>
 #include <memory>
 #include <string>
 #include <tuple>
@@ -64,6 +65,22 @@ inline bool has_abort_file() {
     return stop;
 }
 
+// Cumulative io and communication times, so that the differences around
+// each site can be recorded in a TimingTree
+template <typename S>
+inline vector<pair<string, double>>
+sweep_timing_counters(const shared_ptr<ParallelRule<S>> &para_rule) {
+    vector<pair<string, double>> r = {{"io/read", frame->tread},
+                                      {"io/write", frame->twrite},
+                                      {"io/async", frame->tasync}};
+    if (para_rule != nullptr) {
+        r.push_back(make_pair("comm/comm", para_rule->comm->tcomm));
+        r.push_back(make_pair("comm/idle", para_rule->comm->tidle));
+        r.push_back(make_pair("comm/wait", para_rule->comm->twait));
+    }
+    return r;
+}
+
 // Density Matrix Renormalization Group
 template <typename S> struct DMRG {
     shared_ptr<MovingEnvironment<S>> me;
@@ -83,12 +100,69 @@ template <typename S> struct DMRG {
     int davidson_soft_max_iter = -1;
     double davidson_shift = 0.0;
     DavidsonTypes davidson_type = DavidsonTypes::Normal;
+    // if not nullptr, environments of a cheaper MPO (for example, the
+    // simplified DiagonalMPO of the Hamiltonian) with the same MPS, whose
+    // effective Hamiltonian diagonal is the Davidson preconditioner, so that
+    // the diagonal of the full effective Hamiltonian is not computed
+    // (not used for MultiMPS)
+    shared_ptr<MovingEnvironment<S>> diag_me = nullptr;
+    // adaptive Davidson threshold: each site uses davidson_adaptive_factor
+    // times the larger of the discarded weight at the previous site and the
+    // noise, bounded below by the threshold of the sweep and above by
+    // davidson_adaptive_max_thrd (zero factor to disable)
+    double davidson_adaptive_factor = 0.0;
+    double davidson_adaptive_max_thrd = 1E-4;
+    // discarded weight at the previous site (negative if unknown)
+    double davidson_last_error = -1.0;
+    // number of Davidson matvecs in the current sweep and in each sweep
+    size_t sweep_davidson_mults = 0;
+    vector<size_t> davidson_mults;
+    // bond dimensions (in decreasing order) of extra sweeps without noise
+    // run by solve after the schedule, for extrapolating the energy to zero
+    // discarded weight (empty to disable). The optimal MPS saved before
+    // these sweeps is kept
+    vector<ubond_t> extrapolation_bond_dims;
+    // number of sweeps for each bond dimension (the first sweep after
+    // truncation still sees environments of the larger bond dimension,
+    // only the last sweep is used)
+    int extrapolation_n_sweeps = 2;
+    // energies and max discarded weights of the extrapolation sweeps
+    vector<double> extrapolation_energies, extrapolation_discarded_weights;
+    // linear fit of energy as a function of discarded weight
+    double extrapolated_energy = 0.0, extrapolation_slope = 0.0;
+    // controlled subspace expansion (3S) for one-site DMRG: the perturbative
+    // noise is the expansion term, with a mixing factor starting from the
+    // noise of each sweep and adjusted at every site by comparing the energy
+    // raised by truncation with the energy lowered by optimization at the
+    // previous site (needs a perturbative noise type)
+    bool subspace_expansion = false;
+    // current mixing factor and the noise of the sweep
+    double expansion_alpha = 0.0, expansion_noise = 0.0;
+    // optimized energy and energy change in optimization at the previous
+    // site (zero change if unknown)
+    double expansion_last_energy = 0.0, expansion_last_gain = 0.0;
     int conn_adjust_step = 2;
+    // after each unordered sweep, move all connection centers at once to
+    // minimize the time of the slowest partition, with the time of sites not
+    // measured in the sweep estimated from bond dimensions (otherwise each
+    // connection center moves at most conn_adjust_step sites)
+    bool conn_adjust_balanced = false;
     bool forward;
     uint8_t iprint = 2;
     NoiseTypes noise_type = NoiseTypes::DensityMatrix;
     TruncationTypes trunc_type = TruncationTypes::Physical;
     DecompositionTypes decomp_type = DecompositionTypes::DensityMatrix;
+    // min size of quantum blocks decomposed by randomized truncated
+    // svd / eigensolver, computing only the kept states (0 to disable)
+    int decomp_rand_min_size = 0;
+    // max number of doubles of perturbed wavefunctions held at once for
+    // reduced perturbative noise with density matrix decomposition, which
+    // are generated in groups and folded into the noise density matrix
+    // (0 to keep all perturbed wavefunctions)
+    size_t noise_stream_memory = 0;
+    // noise density matrix folded in eigs_and_perturb (with unit trace,
+    // nullptr if not streamed)
+    shared_ptr<SparseMatrix<S>> streamed_pdm = nullptr;
     double cutoff = 1E-14;
     double quanta_cutoff = 1E-3;
     bool decomp_last_site = true;
@@ -98,12 +172,88 @@ template <typename S> struct DMRG {
     size_t sweep_max_eff_ham_size = 0;
     double tprt = 0, teig = 0, teff = 0, tmve = 0, tblk = 0, tdm = 0, tsplt = 0,
            tsvd = 0, torth = 0;
+    // if not nullptr, per-site phase times of each sweep are recorded
+    shared_ptr<TimingTree> timing = nullptr;
+    // if true, the Davidson convergence history of each site in the last
+    // sweep is recorded in sweep_davidson_telemetry (in sweep order)
+    bool davidson_telemetry = false;
+    vector<DavidsonTelemetry> sweep_davidson_telemetry;
+    // if true (and para_rule is not nullptr), per-rank phase times of each
+    // site are gathered at the end of each sweep in sweep_load_balance
+    bool load_balance_report = false;
+    LoadBalanceRecorder sweep_load_balance;
     bool print_connection_time = false;
+    // candidate SeqTypes for the Davidson matvec, timed at each site in the
+    // first sweep with a new bond dimension (empty to disable tuning)
+    vector<SeqTypes> tune_seq_types;
+    // number of matvecs timed for each candidate
+    int tune_n_mult = 4;
+    // the fastest SeqTypes for each tuned bond dimension
+    map<ubond_t, SeqTypes> tuned_seq_types;
+    vector<double> tune_seq_times;
+    ubond_t tune_bond_dim = 0;
+    // number of extra Ritz vectors kept for each site, to warm-start the
+    // Davidson solve at the next visit of the same site (zero to disable)
+    // each kept vector costs one wavefunction of heap memory per site
+    // a recycled vector close to an excited state can capture the root
+    // if the guess is poor compared with the gap, so this is for late sweeps
+    int davidson_recycle = 0;
+    // block structure and vectors of the recycled subspace for each site
+    map<int, pair<vector<size_t>, vector<vector<double>>>> recycled_subspaces;
+    // index of the current sweep in solve
+    int current_sweep = 0;
+    // sweep index and first site for resuming an interrupted sweep
+    // (set by load_site_restart or load_sweep_restart, -1 if not resuming)
+    int restart_sweep = -1, restart_site = -1;
+    // if not empty, a JSON record of each completed sweep (energies, bond
+    // dimension, discarded weight and times) is appended to this file by a
+    // background thread (root process only), for monitoring during solve
+    string progress_filename = "";
+    future<void> progress_writer;
+    // one-orbital reduced density matrices from the two-site wavefunction
+    // at each site update (two-site algorithm, root process only), giving
+    // orbital occupations and entropies without a separate Expect sweep
+    // every sweep overwrites the sites it visits, so that after solve they
+    // belong to the last sweep
+    bool store_orbital_rdms = false;
+    // for each site, probabilities of the site basis states (the one-orbital
+    // reduced density matrix is diagonal in this basis by symmetry)
+    vector<vector<double>> orbital_rdms;
+    // density matrix sectors whose weight stays below sector_prune_cutoff
+    // for sector_prune_visits consecutive visits of the same bond are
+    // dropped from the MPS info (0 to disable), so that later contractions
+    // have fewer blocks; noise can bring a sector back at a later visit
+    double sector_prune_cutoff = 0;
+    int sector_prune_visits = 2;
+    // consecutive visits below the cutoff for each (bond, is left block)
+    map<pair<int, bool>, map<S, int>> sector_idle_visits;
     Timer _t, _t2;
     DMRG(const shared_ptr<MovingEnvironment<S>> &me,
          const vector<ubond_t> &bond_dims, const vector<double> &noises)
         : me(me), bond_dims(bond_dims), noises(noises), forward(false) {}
     virtual ~DMRG() = default;
+    // Zero the blocks of sectors idle for sector_prune_visits visits
+    // in the density matrix (never the heaviest one), before truncation
+    void prune_idle_sectors(const shared_ptr<SparseMatrix<S>> &dm, int bond,
+                            bool left) {
+        if (sector_prune_cutoff == 0)
+            return;
+        map<S, int> &visits = sector_idle_visits[make_pair(bond, left)];
+        vector<double> weights(dm->info->n, 0);
+        int imax = 0;
+        for (int k = 0; k < dm->info->n; k++) {
+            MatrixRef mat = (*dm)[k];
+            for (MKL_INT j = 0; j < mat.m; j++)
+                weights[k] += mat(j, j);
+            if (weights[k] > weights[imax])
+                imax = k;
+        }
+        for (int k = 0; k < dm->info->n; k++)
+            if (weights[k] >= sector_prune_cutoff || k == imax)
+                visits.erase(dm->info->quanta[k]);
+            else if (++visits[dm->info->quanta[k]] >= sector_prune_visits)
+                (*dm)[k].clear();
+    }
     struct Iteration {
         vector<double> energies;
         vector<vector<pair<S, double>>> quanta;
@@ -143,6 +293,98 @@ template <typename S> struct DMRG {
             return os;
         }
     };
+    // probabilities of the basis states of site ii in the two-site
+    // wavefunction at sites (i, i + 1), where ii == i or ii == i + 1
+    // the fused left (or right) index of wfn is decomposed into
+    // (left block, site) (or (site, right block)) sectors, which are
+    // orthogonal, so that each probability is a sum of squared sectors
+    void accumulate_orbital_rdm(int i, int ii,
+                                const shared_ptr<SparseMatrix<S>> &wfn) {
+        shared_ptr<MPSInfo<S>> info = me->ket->info;
+        StateInfo<S> m = *info->basis[ii];
+        vector<double> probs(m.n, 0.0);
+        auto sqnorm = [](const double *x, size_t n) {
+            double r = 0.0;
+            for (size_t k = 0; k < n; k++)
+                r += x[k] * x[k];
+            return r;
+        };
+        if (ii == i) {
+            info->load_left_dims(i);
+            StateInfo<S> l = *info->left_dims[i];
+            StateInfo<S> lm =
+                StateInfo<S>::tensor_product(l, m, *info->left_dims_fci[i + 1]);
+            StateInfo<S> clm = StateInfo<S>::get_connection_info(l, m, lm);
+            for (int k = 0; k < wfn->info->n; k++) {
+                S bra = wfn->info->quanta[k].get_bra(wfn->info->delta_quantum);
+                int ib = lm.find_state(bra);
+                int bbed = ib == lm.n - 1 ? clm.n : clm.n_states[ib + 1];
+                size_t p = wfn->info->n_states_total[k];
+                for (int bb = clm.n_states[ib]; bb < bbed; bb++) {
+                    uint16_t ibba = clm.quanta[bb].data >> 16,
+                             ibbb = clm.quanta[bb].data & (0xFFFFU);
+                    size_t lp = (size_t)l.n_states[ibba] * m.n_states[ibbb] *
+                                wfn->info->n_states_ket[k];
+                    probs[ibbb] += sqnorm(wfn->data + p, lp);
+                    p += lp;
+                }
+            }
+            clm.deallocate();
+            lm.deallocate();
+        } else {
+            assert(ii == i + 1);
+            info->load_right_dims(i + 2);
+            StateInfo<S> r = *info->right_dims[i + 2];
+            StateInfo<S> mr =
+                StateInfo<S>::tensor_product(m, r, *info->right_dims_fci[ii]);
+            StateInfo<S> cmr = StateInfo<S>::get_connection_info(m, r, mr);
+            for (int k = 0; k < wfn->info->n; k++) {
+                S ket = -wfn->info->quanta[k].get_ket();
+                int ik = mr.find_state(ket);
+                int kked = ik == mr.n - 1 ? cmr.n : cmr.n_states[ik + 1];
+                const MKL_INT nbra = wfn->info->n_states_bra[k],
+                              nket = wfn->info->n_states_ket[k];
+                const double *pk = wfn->data + wfn->info->n_states_total[k];
+                size_t p = 0;
+                for (int kk = cmr.n_states[ik]; kk < kked; kk++) {
+                    uint16_t ikka = cmr.quanta[kk].data >> 16,
+                             ikkb = cmr.quanta[kk].data & (0xFFFFU);
+                    size_t lp = (size_t)m.n_states[ikka] * r.n_states[ikkb];
+                    for (MKL_INT ip = 0; ip < nbra; ip++)
+                        probs[ikka] += sqnorm(pk + ip * nket + p, lp);
+                    p += lp;
+                }
+            }
+            cmr.deallocate();
+            mr.deallocate();
+        }
+        orbital_rdms.resize(me->n_sites);
+        orbital_rdms[ii] = probs;
+    }
+    // orbital occupation numbers from orbital_rdms
+    vector<double> get_orbital_occupations() const {
+        vector<double> r(orbital_rdms.size(), 0.0);
+        for (size_t ii = 0; ii < orbital_rdms.size(); ii++)
+            for (size_t k = 0; k < orbital_rdms[ii].size(); k++)
+                r[ii] += orbital_rdms[ii][k] *
+                         me->ket->info->basis[ii]->quanta[k].n();
+        return r;
+    }
+    // one-orbital von Neumann entropies from orbital_rdms
+    // for spin-adapted states, the probability of a singly occupied orbital
+    // is shared equally by the two spin states (exact for singlets)
+    vector<double> get_orbital_entropies() const {
+        vector<double> r(orbital_rdms.size(), 0.0);
+        for (size_t ii = 0; ii < orbital_rdms.size(); ii++)
+            for (size_t k = 0; k < orbital_rdms[ii].size(); k++) {
+                const double p = orbital_rdms[ii][k];
+                const int mul =
+                    me->ket->info->basis[ii]->quanta[k].multiplicity();
+                if (p > 0)
+                    r[ii] -= p * log(p / mul);
+            }
+        return r;
+    }
     // one-site single-state dmrg algorithm
     // canonical form for wavefunction: K = left-fused, S = right-fused
     Iteration update_one_dot(int i, bool forward, ubond_t bond_dim,
@@ -217,6 +459,8 @@ template <typename S> struct DMRG {
                                            davidson_conv_thrd, noise, pket);
         else if (me->para_rule != nullptr)
             me->para_rule->comm->barrier();
+        if (subspace_expansion && noise != 0)
+            noise = expansion_alpha;
         if (pket != nullptr)
             sweep_max_pket_size = max(sweep_max_pket_size, pket->total_memory);
         if ((build_pdm || me->para_rule == nullptr ||
@@ -286,6 +530,7 @@ template <typename S> struct DMRG {
                     mps->move_left(me->mpo->tf->opf->cg, me->para_rule);
             }
         }
+        MemoryTagScope mts(frame, "dm");
         if (build_pdm && !skip_decomp) {
             _t.get_time();
             assert(decomp_type == DecompositionTypes::DensityMatrix);
@@ -311,16 +556,24 @@ template <typename S> struct DMRG {
                     _t.get_time();
                     dm = MovingEnvironment<S>::density_matrix(
                         me->ket->info->vacuum, me->ket->tensors[i], forward,
-                        build_pdm ? 0.0 : noise, noise_type, 1.0, pket);
+                        build_pdm || streamed_pdm != nullptr ? 0.0 : noise,
+                        noise_type, 1.0, pket);
                     if (build_pdm)
                         MatrixFunctions::iadd(
                             MatrixRef(dm->data, (MKL_INT)dm->total_memory, 1),
                             MatrixRef(pdm->data, (MKL_INT)pdm->total_memory, 1),
                             1.0);
+                    else if (streamed_pdm != nullptr)
+                        MatrixFunctions::iadd(
+                            MatrixRef(dm->data, (MKL_INT)dm->total_memory, 1),
+                            MatrixRef(streamed_pdm->data,
+                                      (MKL_INT)streamed_pdm->total_memory, 1),
+                            noise);
+                    prune_idle_sectors(dm, forward ? i + 1 : i, forward);
                     tdm += _t.get_time();
                     error = MovingEnvironment<S>::split_density_matrix(
                         dm, me->ket->tensors[i], (int)bond_dim, forward, true,
-                        left, right, cutoff, trunc_type);
+                        left, right, cutoff, trunc_type, decomp_rand_min_size);
                     tsplt += _t.get_time();
                 } else if (decomp_type == DecompositionTypes::SVD ||
                            decomp_type == DecompositionTypes::PureSVD) {
@@ -339,7 +592,9 @@ template <typename S> struct DMRG {
                     error = MovingEnvironment<S>::split_wavefunction_svd(
                         me->ket->info->vacuum, me->ket->tensors[i],
                         (int)bond_dim, forward, true, left, right, cutoff,
-                        trunc_type, decomp_type, pket);
+                        trunc_type, decomp_type, pket,
+                        vector<shared_ptr<SparseMatrix<S>>>(), vector<double>(),
+                        decomp_rand_min_size);
                     tsvd += _t.get_time();
                 } else
                     assert(false);
@@ -440,6 +695,11 @@ template <typename S> struct DMRG {
             pket->deallocate();
             pket->deallocate_infos();
         }
+        if (streamed_pdm != nullptr) {
+            streamed_pdm->deallocate();
+            streamed_pdm->info->deallocate();
+            streamed_pdm = nullptr;
+        }
         if (me->para_rule != nullptr)
             me->para_rule->comm->barrier();
         return Iteration(vector<double>{get<0>(pdi) + me->mpo->const_e}, error,
@@ -450,6 +710,7 @@ template <typename S> struct DMRG {
                              const int i, const double davidson_conv_thrd,
                              const double noise,
                              shared_ptr<SparseMatrixGroup<S>> &pket) {
+        MemoryTagScope mts(frame, "eff_ham");
         tuple<double, int, size_t, double> pdi;
         vector<shared_ptr<SparseMatrix<S>>> ortho_bra;
         _t.get_time();
@@ -472,21 +733,43 @@ template <typename S> struct DMRG {
             }
         }
         torth += _t.get_time();
-        shared_ptr<EffectiveHamiltonian<S>> h_eff = me->eff_ham(
-            fuse_left ? FuseTypes::FuseL : FuseTypes::FuseR, forward, true,
+        shared_ptr<EffectiveHamiltonian<S>> h_eff = preconditioned_eff_ham(
+            fuse_left ? FuseTypes::FuseL : FuseTypes::FuseR, forward,
             me->bra->tensors[i], me->ket->tensors[i]);
         sweep_max_eff_ham_size =
             max(sweep_max_eff_ham_size, h_eff->op->get_total_memory());
+        tune_seq_type(h_eff);
+        vector<shared_ptr<SparseMatrix<S>>> recycle_bra =
+            load_recycled_subspace(i, me->ket->tensors[i]->info);
         teff += _t.get_time();
+        mts.set("davidson");
+        // energy of the guess, which is truncated at the previous site
+        double guess_energy = 0.0;
+        if (subspace_expansion && noise != 0) {
+            const double norm = me->ket->tensors[i]->norm();
+            guess_energy =
+                get<0>(h_eff->expect(0.0, ExpectationAlgorithmTypes::Normal,
+                                     ExpectationTypes::Real, me->para_rule))[0]
+                    .second /
+                (norm * norm);
+        }
         pdi = h_eff->eigs(iprint >= 3, davidson_conv_thrd, davidson_max_iter,
                           davidson_soft_max_iter, davidson_type,
                           davidson_shift - me->mpo->const_e, me->para_rule,
-                          ortho_bra);
+                          ortho_bra, recycle_bra);
+        save_recycled_subspace(i, recycle_bra);
         teig += _t.get_time();
+        mts.set("perturb");
         if (state_specific)
             for (auto &wfn : ortho_bra)
                 wfn->deallocate();
-        if ((noise_type & NoiseTypes::Perturbative) && noise != 0)
+        if (subspace_expansion && noise != 0)
+            update_expansion_alpha(guess_energy, get<0>(pdi));
+        if (can_stream_noise(noise, fuse_left == forward))
+            streamed_pdm = streamed_perturbative_noise(
+                h_eff, forward, i, i,
+                fuse_left ? FuseTypes::FuseL : FuseTypes::FuseR);
+        else if ((noise_type & NoiseTypes::Perturbative) && noise != 0)
             pket = h_eff->perturbative_noise(
                 forward, i, i, fuse_left ? FuseTypes::FuseL : FuseTypes::FuseR,
                 me->ket->info, noise_type, me->para_rule);
@@ -494,10 +777,194 @@ template <typename S> struct DMRG {
         h_eff->deallocate();
         return pdi;
     }
+    // Effective Hamiltonian for Davidson, with the diagonal
+    // from diag_me if it is not nullptr
+    shared_ptr<EffectiveHamiltonian<S>>
+    preconditioned_eff_ham(FuseTypes fuse_type, bool forward,
+                           const shared_ptr<SparseMatrix<S>> &bra,
+                           const shared_ptr<SparseMatrix<S>> &ket) {
+        if (diag_me == nullptr)
+            return me->eff_ham(fuse_type, forward, true, bra, ket);
+        shared_ptr<EffectiveHamiltonian<S>> d_eff =
+            diag_me->eff_ham(fuse_type, forward, true, bra, ket);
+        shared_ptr<SparseMatrix<S>> diag = make_shared<SparseMatrix<S>>(
+            make_shared<VectorAllocator<double>>());
+        diag->allocate(ket->info);
+        diag->copy_data_from(d_eff->diag);
+        d_eff->deallocate();
+        shared_ptr<EffectiveHamiltonian<S>> h_eff =
+            me->eff_ham(fuse_type, forward, false, bra, ket);
+        h_eff->diag = diag;
+        h_eff->compute_diag = true;
+        return h_eff;
+    }
+    // Adjust the mixing factor of subspace expansion: decrease it if the
+    // truncation at the previous site raised the energy by more than 30% of
+    // the energy lowered by its optimization, increase it if by less than 10%
+    // (the factor is kept within 1E-2 to 1E2 times the noise of the sweep)
+    void update_expansion_alpha(double guess_energy, double energy) {
+        if (expansion_last_gain < 0) {
+            const double ratio =
+                (guess_energy - expansion_last_energy) / -expansion_last_gain;
+            if (ratio > 0.3)
+                expansion_alpha *= 0.9;
+            else if (ratio < 0.1)
+                expansion_alpha *= 1.1;
+            expansion_alpha =
+                min(max(expansion_alpha, expansion_noise * 1E-2),
+                    expansion_noise * 1E2);
+        }
+        expansion_last_energy = energy;
+        expansion_last_gain = energy - guess_energy;
+    }
+    // Whether the perturbed wavefunctions can be folded into the noise
+    // density matrix group by group, without keeping all of them
+    bool can_stream_noise(double noise, bool fused_form) const {
+        return noise_stream_memory != 0 && noise != 0 && fused_form &&
+               (noise_type & NoiseTypes::Perturbative) &&
+               (noise_type & NoiseTypes::Reduced) &&
+               !(noise_type & NoiseTypes::Collected) &&
+               decomp_type == DecompositionTypes::DensityMatrix;
+    }
+    // Noise density matrix with unit trace from perturbed wavefunctions
+    // generated in groups of at most noise_stream_memory doubles
+    // (same as the density matrix formed by all perturbed wavefunctions with
+    // noise = 1, nullptr on non-root procs)
+    shared_ptr<SparseMatrix<S>> streamed_perturbative_noise(
+        const shared_ptr<EffectiveHamiltonian<S>> &h_eff, bool forward, int iL,
+        int iR, FuseTypes ftype) {
+        const bool root = me->para_rule == nullptr || me->para_rule->is_root();
+        shared_ptr<SparseMatrix<S>> pdm = nullptr;
+        if (root) {
+            shared_ptr<SparseMatrixInfo<S>> dm_info =
+                make_shared<SparseMatrixInfo<S>>(
+                    make_shared<VectorAllocator<uint32_t>>());
+            dm_info->initialize_dm(
+                vector<shared_ptr<SparseMatrixInfo<S>>>{h_eff->ket->info},
+                me->ket->info->vacuum, forward);
+            pdm = make_shared<SparseMatrix<S>>(
+                make_shared<VectorAllocator<double>>());
+            pdm->allocate(dm_info);
+        }
+        // sum of squared norms of the scaled perturbed wavefunctions
+        double norm2 = 0;
+        int ipk = 0;
+        h_eff->perturbative_noise(
+            forward, iL, iR, ftype, me->ket->info, noise_type, me->para_rule,
+            noise_stream_memory,
+            [this, root, forward, &pdm, &norm2,
+             &ipk](const shared_ptr<SparseMatrixGroup<S>> &pkets) {
+                sweep_max_pket_size =
+                    max(sweep_max_pket_size, pkets->total_memory);
+                if (!root)
+                    return;
+                vector<shared_ptr<SparseMatrix<S>>> mats;
+                for (int j = 0; j < pkets->n; j++, ipk++) {
+                    shared_ptr<SparseMatrix<S>> mat = (*pkets)[j];
+                    const double mat_norm = mat->norm();
+                    if (!(noise_type & NoiseTypes::Unscaled) &&
+                        abs(mat_norm) > TINY)
+                        mat->iscale(1 / mat_norm), norm2 += 1;
+                    else
+                        norm2 += mat_norm * mat_norm;
+                    // the first one is skipped as in density_matrix
+                    if (ipk != 0)
+                        mats.push_back(mat);
+                }
+                OperatorFunctions<S>::trans_product_batch(mats, pdm, forward);
+            });
+        if (root && sqrt(norm2) > TINY)
+            pdm->iscale(1 / norm2);
+        return pdm;
+    }
+    // block structure of a wavefunction, as the key of the recycled subspace
+    static vector<size_t>
+    recycle_signature(const shared_ptr<SparseMatrixInfo<S>> &info) {
+        vector<size_t> sig;
+        sig.reserve(info->n * 3);
+        for (int k = 0; k < info->n; k++) {
+            sig.push_back(info->quanta[k].hash());
+            sig.push_back(info->n_states_bra[k]);
+            sig.push_back(info->n_states_ket[k]);
+        }
+        return sig;
+    }
+    // Recycled Davidson subspace for site i, filled from the previous
+    // visit if the wavefunction block structure is unchanged
+    vector<shared_ptr<SparseMatrix<S>>>
+    load_recycled_subspace(int i, const shared_ptr<SparseMatrixInfo<S>> &info) {
+        vector<shared_ptr<SparseMatrix<S>>> rvs;
+        if (davidson_recycle <= 0)
+            return rvs;
+        shared_ptr<VectorAllocator<double>> d_alloc =
+            make_shared<VectorAllocator<double>>();
+        auto it = recycled_subspaces.find(i);
+        const bool reuse = it != recycled_subspaces.end() &&
+                           it->second.first == recycle_signature(info);
+        rvs.resize(davidson_recycle);
+        for (int j = 0; j < davidson_recycle; j++) {
+            rvs[j] = make_shared<SparseMatrix<S>>(d_alloc);
+            rvs[j]->allocate(info);
+            if (reuse && j < (int)it->second.second.size())
+                memcpy(rvs[j]->data, it->second.second[j].data(),
+                       sizeof(double) * rvs[j]->total_memory);
+        }
+        return rvs;
+    }
+    void save_recycled_subspace(
+        int i, const vector<shared_ptr<SparseMatrix<S>>> &rvs) {
+        if (rvs.size() == 0)
+            return;
+        auto &rs = recycled_subspaces[i];
+        rs.first = recycle_signature(rvs[0]->info);
+        rs.second.resize(rvs.size());
+        for (size_t j = 0; j < rvs.size(); j++) {
+            rs.second[j].assign(rvs[j]->data,
+                                rvs[j]->data + rvs[j]->total_memory);
+            rvs[j]->deallocate();
+        }
+    }
+    // Time the candidate SeqTypes for the effective Hamiltonian in the
+    // first sweep of a bond dimension, or use the selected one after that
+    void tune_seq_type(const shared_ptr<EffectiveHamiltonian<S>> &h_eff) {
+        if (tune_seq_types.size() == 0)
+            return;
+        auto it = tuned_seq_types.find(tune_bond_dim);
+        if (it != tuned_seq_types.end())
+            h_eff->tf->opf->seq->mode = it->second;
+        else {
+            vector<double> tms = h_eff->time_seq_types(
+                tune_seq_types, tune_n_mult, me->para_rule);
+            tune_seq_times.resize(tms.size(), 0.0);
+            for (size_t j = 0; j < tms.size(); j++)
+                tune_seq_times[j] += tms[j];
+        }
+    }
+    // Select the fastest SeqTypes after the tuning sweep
+    void select_seq_type() {
+        if (tune_seq_times.size() == 0)
+            return;
+        size_t ix = min_element(tune_seq_times.begin(), tune_seq_times.end()) -
+                    tune_seq_times.begin();
+        tuned_seq_types[tune_bond_dim] = tune_seq_types[ix];
+        if (iprint >= 1) {
+            cout << "Tuned SeqType = " << Threading::seq_type_name(
+                                              tune_seq_types[ix]);
+            cout << fixed << setprecision(3) << " (";
+            for (size_t j = 0; j < tune_seq_times.size(); j++)
+                cout << (j == 0 ? "" : " ")
+                     << Threading::seq_type_name(tune_seq_types[j]) << " = "
+                     << tune_seq_times[j];
+            cout << ") for bond dimension = " << (uint32_t)tune_bond_dim
+                 << endl;
+        }
+        tune_seq_times.clear();
+    }
     // two-site single-state dmrg algorithm
     // canonical form for wavefunction: C = center
     Iteration update_two_dot(int i, bool forward, ubond_t bond_dim,
                              double noise, double davidson_conv_thrd) {
+        HardwareCounterScope hcs("update");
         frame->activate(0);
         if (me->ket->tensors[i] != nullptr &&
             me->ket->tensors[i + 1] != nullptr)
@@ -523,10 +990,11 @@ template <typename S> struct DMRG {
         shared_ptr<SparseMatrix<S>> pdm = nullptr;
         bool build_pdm = noise != 0 && (noise_type & NoiseTypes::Collected);
         // effective hamiltonian
-        if (davidson_soft_max_iter != 0 || noise != 0)
+        if (davidson_soft_max_iter != 0 || noise != 0) {
+            HardwareCounterScope hcs_eigs("eigs");
             pdi = two_dot_eigs_and_perturb(forward, i, davidson_conv_thrd,
                                            noise, pket);
-        else if (me->para_rule != nullptr)
+        } else if (me->para_rule != nullptr)
             me->para_rule->comm->barrier();
         if (pket != nullptr)
             sweep_max_pket_size = max(sweep_max_pket_size, pket->total_memory);
@@ -553,6 +1021,13 @@ template <typename S> struct DMRG {
                 MovingEnvironment<S>::propagate_wfn(
                     i, me->n_sites, mps, forward, me->mpo->tf->opf->cg);
         }
+        MemoryTagScope mts(frame, "dm");
+        HardwareCounterScope hcs_decomp("decomp");
+        if (store_orbital_rdms &&
+            (me->para_rule == nullptr || me->para_rule->is_root())) {
+            accumulate_orbital_rdm(i, i, old_wfn);
+            accumulate_orbital_rdm(i, i + 1, old_wfn);
+        }
         if (build_pdm) {
             _t.get_time();
             assert(decomp_type == DecompositionTypes::DensityMatrix);
@@ -571,17 +1046,25 @@ template <typename S> struct DMRG {
                 _t.get_time();
                 dm = MovingEnvironment<S>::density_matrix(
                     me->ket->info->vacuum, old_wfn, forward,
-                    build_pdm ? 0.0 : noise, noise_type, 1.0, pket);
+                    build_pdm || streamed_pdm != nullptr ? 0.0 : noise,
+                    noise_type, 1.0, pket);
                 if (build_pdm)
                     MatrixFunctions::iadd(
                         MatrixRef(dm->data, (MKL_INT)dm->total_memory, 1),
                         MatrixRef(pdm->data, (MKL_INT)pdm->total_memory, 1),
                         1.0);
+                else if (streamed_pdm != nullptr)
+                    MatrixFunctions::iadd(
+                        MatrixRef(dm->data, (MKL_INT)dm->total_memory, 1),
+                        MatrixRef(streamed_pdm->data,
+                                  (MKL_INT)streamed_pdm->total_memory, 1),
+                        noise);
+                prune_idle_sectors(dm, i + 1, forward);
                 tdm += _t.get_time();
                 error = MovingEnvironment<S>::split_density_matrix(
                     dm, old_wfn, (int)bond_dim, forward, true,
                     me->ket->tensors[i], me->ket->tensors[i + 1], cutoff,
-                    trunc_type);
+                    trunc_type, decomp_rand_min_size);
                 tsplt += _t.get_time();
             } else if (decomp_type == DecompositionTypes::SVD ||
                        decomp_type == DecompositionTypes::PureSVD) {
@@ -600,7 +1083,9 @@ template <typename S> struct DMRG {
                 error = MovingEnvironment<S>::split_wavefunction_svd(
                     me->ket->info->vacuum, old_wfn, (int)bond_dim, forward,
                     true, me->ket->tensors[i], me->ket->tensors[i + 1], cutoff,
-                    trunc_type, decomp_type, pket);
+                    trunc_type, decomp_type, pket,
+                    vector<shared_ptr<SparseMatrix<S>>>(), vector<double>(),
+                    decomp_rand_min_size);
                 tsvd += _t.get_time();
             } else
                 assert(false);
@@ -663,6 +1148,11 @@ template <typename S> struct DMRG {
             pket->deallocate();
             pket->deallocate_infos();
         }
+        if (streamed_pdm != nullptr) {
+            streamed_pdm->deallocate();
+            streamed_pdm->info->deallocate();
+            streamed_pdm = nullptr;
+        }
         if (me->para_rule != nullptr)
             me->para_rule->comm->barrier();
         return Iteration(vector<double>{get<0>(pdi) + me->mpo->const_e}, error,
@@ -671,6 +1161,7 @@ template <typename S> struct DMRG {
     virtual tuple<double, int, size_t, double> two_dot_eigs_and_perturb(
         const bool forward, const int i, const double davidson_conv_thrd,
         const double noise, shared_ptr<SparseMatrixGroup<S>> &pket) {
+        MemoryTagScope mts(frame, "eff_ham");
         tuple<double, int, size_t, double> pdi;
         vector<shared_ptr<SparseMatrix<S>>> ortho_bra;
         _t.get_time();
@@ -693,20 +1184,29 @@ template <typename S> struct DMRG {
         }
         torth += _t.get_time();
         shared_ptr<EffectiveHamiltonian<S>> h_eff =
-            me->eff_ham(FuseTypes::FuseLR, forward, true, me->bra->tensors[i],
-                        me->ket->tensors[i]);
+            preconditioned_eff_ham(FuseTypes::FuseLR, forward,
+                                   me->bra->tensors[i], me->ket->tensors[i]);
         sweep_max_eff_ham_size =
             max(sweep_max_eff_ham_size, h_eff->op->get_total_memory());
+        tune_seq_type(h_eff);
+        vector<shared_ptr<SparseMatrix<S>>> recycle_bra =
+            load_recycled_subspace(i, me->ket->tensors[i]->info);
         teff += _t.get_time();
+        mts.set("davidson");
         pdi = h_eff->eigs(iprint >= 3, davidson_conv_thrd, davidson_max_iter,
                           davidson_soft_max_iter, davidson_type,
                           davidson_shift - me->mpo->const_e, me->para_rule,
-                          ortho_bra);
+                          ortho_bra, recycle_bra);
+        save_recycled_subspace(i, recycle_bra);
         teig += _t.get_time();
+        mts.set("perturb");
         if (state_specific)
             for (auto &wfn : ortho_bra)
                 wfn->deallocate();
-        if ((noise_type & NoiseTypes::Perturbative) && noise != 0)
+        if (can_stream_noise(noise, true))
+            streamed_pdm = streamed_perturbative_noise(h_eff, forward, i, i + 1,
+                                                       FuseTypes::FuseLR);
+        else if ((noise_type & NoiseTypes::Perturbative) && noise != 0)
             pket = h_eff->perturbative_noise(forward, i, i + 1,
                                              FuseTypes::FuseLR, me->ket->info,
                                              noise_type, me->para_rule);
@@ -801,6 +1301,7 @@ template <typename S> struct DMRG {
                 }
             }
         }
+        MemoryTagScope mts(frame, "dm");
         if (build_pdm) {
             _t.get_time();
             assert(decomp_type == DecompositionTypes::DensityMatrix);
@@ -951,6 +1452,7 @@ template <typename S> struct DMRG {
         const double davidson_conv_thrd, const double noise,
         shared_ptr<SparseMatrixGroup<S>> &pket,
         vector<vector<pair<S, double>>> &mps_quanta) {
+        MemoryTagScope mts(frame, "eff_ham");
         tuple<vector<double>, int, size_t, double> pdi;
         shared_ptr<MultiMPS<S>> mket =
             dynamic_pointer_cast<MultiMPS<S>>(me->ket);
@@ -961,6 +1463,7 @@ template <typename S> struct DMRG {
         sweep_max_eff_ham_size =
             max(sweep_max_eff_ham_size, h_eff->op->get_total_memory());
         teff += _t.get_time();
+        mts.set("davidson");
         pdi = h_eff->eigs(iprint >= 3, davidson_conv_thrd, davidson_max_iter,
                           davidson_type, davidson_shift - me->mpo->const_e,
                           me->para_rule);
@@ -974,6 +1477,7 @@ template <typename S> struct DMRG {
                 mps_quanta[i].end());
         }
         teig += _t.get_time();
+        mts.set("perturb");
         if ((noise_type & NoiseTypes::Perturbative) && noise != 0)
             pket = h_eff->perturbative_noise(
                 forward, i, i, fuse_left ? FuseTypes::FuseL : FuseTypes::FuseR,
@@ -1010,6 +1514,7 @@ template <typename S> struct DMRG {
             me->para_rule->comm->barrier();
         if (pket != nullptr)
             sweep_max_pket_size = max(sweep_max_pket_size, pket->total_memory);
+        MemoryTagScope mts(frame, "dm");
         if (build_pdm) {
             _t.get_time();
             assert(decomp_type == DecompositionTypes::DensityMatrix);
@@ -1122,6 +1627,7 @@ template <typename S> struct DMRG {
         const bool forward, const int i, const double davidson_conv_thrd,
         const double noise, shared_ptr<SparseMatrixGroup<S>> &pket,
         vector<vector<pair<S, double>>> &mps_quanta) {
+        MemoryTagScope mts(frame, "eff_ham");
         tuple<vector<double>, int, size_t, double> pdi;
         shared_ptr<MultiMPS<S>> mket =
             dynamic_pointer_cast<MultiMPS<S>>(me->ket);
@@ -1131,6 +1637,7 @@ template <typename S> struct DMRG {
         sweep_max_eff_ham_size =
             max(sweep_max_eff_ham_size, h_eff->op->get_total_memory());
         teff += _t.get_time();
+        mts.set("davidson");
         pdi = h_eff->eigs(iprint >= 3, davidson_conv_thrd, davidson_max_iter,
                           davidson_type, davidson_shift - me->mpo->const_e,
                           me->para_rule);
@@ -1144,6 +1651,7 @@ template <typename S> struct DMRG {
                 mps_quanta[i].end());
         }
         teig += _t.get_time();
+        mts.set("perturb");
         if ((noise_type & NoiseTypes::Perturbative) && noise != 0)
             pket = h_eff->perturbative_noise(
                 forward, i, i + 1, FuseTypes::FuseLR, mket->info, mket->weights,
@@ -1152,12 +1660,23 @@ template <typename S> struct DMRG {
         h_eff->deallocate();
         return pdi;
     }
+    // Davidson threshold for the next site
+    double site_davidson_conv_thrd(double noise,
+                                   double davidson_conv_thrd) const {
+        if (davidson_adaptive_factor == 0 || davidson_last_error < 0)
+            return davidson_conv_thrd;
+        double thrd =
+            davidson_adaptive_factor * max(davidson_last_error, noise);
+        return max(davidson_conv_thrd, min(davidson_adaptive_max_thrd, thrd));
+    }
     virtual Iteration blocking(int i, bool forward, ubond_t bond_dim,
                                double noise, double davidson_conv_thrd) {
         _t2.get_time();
         me->move_to(i);
         for (auto &xme : ext_mes)
             xme->move_to(i);
+        if (diag_me != nullptr)
+            diag_me->move_to(i);
         tmve += _t2.get_time();
         assert(me->dot == 1 || me->dot == 2);
         Iteration it(vector<double>(), 0, 0, 0);
@@ -1184,6 +1703,299 @@ template <typename S> struct DMRG {
         tblk += _t2.get_time();
         return it;
     }
+    template <typename T>
+    static void save_restart_vector(ostream &ofs, const vector<T> &v) {
+        size_t sz = v.size();
+        ofs.write((char *)&sz, sizeof(sz));
+        if (sz != 0)
+            ofs.write((char *)v.data(), sizeof(T) * sz);
+    }
+    template <typename T>
+    static void load_restart_vector(istream &ifs, vector<T> &v) {
+        size_t sz = 0;
+        ifs.read((char *)&sz, sizeof(sz));
+        v.resize(sz);
+        if (sz != 0)
+            ifs.read((char *)v.data(), sizeof(T) * sz);
+    }
+    template <typename T>
+    static void save_restart_vectors(ostream &ofs,
+                                     const vector<vector<T>> &v) {
+        size_t sz = v.size();
+        ofs.write((char *)&sz, sizeof(sz));
+        for (const auto &x : v)
+            save_restart_vector(ofs, x);
+    }
+    template <typename T>
+    static void load_restart_vectors(istream &ifs, vector<vector<T>> &v) {
+        size_t sz = 0;
+        ifs.read((char *)&sz, sizeof(sz));
+        v.resize(sz);
+        for (auto &x : v)
+            load_restart_vector(ifs, x);
+    }
+    string get_site_restart_filename(const string &dir) const {
+        return dir + "/" + frame->prefix + ".DMRG.SWEEP." + me->tag;
+    }
+    // Save MPS, environments and sweep state into frame->restart_dir_site,
+    // so that the current sweep can be resumed at next_site
+    void save_site_restart(bool forward, int next_site) {
+        const string &dir = frame->restart_dir_site;
+        const string filename = get_site_restart_filename(dir);
+        const bool is_root = me->para_rule == nullptr || me->para_rule->is_root();
+        frame->wait_save_files();
+        if (is_root) {
+            if (!Parsing::path_exists(dir))
+                Parsing::mkdir(dir);
+            // an incomplete checkpoint has no sweep state file
+            if (Parsing::file_exists(filename))
+                Parsing::remove_file(filename);
+            me->ket->save_data();
+            me->ket->info->copy_mutable(dir);
+            me->ket->copy_data(dir);
+        }
+        if (me->para_rule != nullptr)
+            me->para_rule->comm->barrier();
+        if (frame->restart_site_distributed)
+            me->save_distributed_environments(dir);
+        else
+            me->save_environments(dir);
+        if (me->para_rule != nullptr)
+            me->para_rule->comm->barrier();
+        if (is_root) {
+            ofstream ofs(filename.c_str(), ios::binary);
+            if (!ofs.good())
+                throw runtime_error("DMRG::save_site_restart on '" +
+                                    filename + "' failed.");
+            int n_sites = me->n_sites;
+            uint8_t fw = forward;
+            ofs.write((char *)&n_sites, sizeof(n_sites));
+            ofs.write((char *)&current_sweep, sizeof(current_sweep));
+            ofs.write((char *)&fw, sizeof(fw));
+            ofs.write((char *)&next_site, sizeof(next_site));
+            ofs.write((char *)&davidson_last_error,
+                      sizeof(davidson_last_error));
+            ofs.write((char *)&sweep_cumulative_nflop,
+                      sizeof(sweep_cumulative_nflop));
+            ofs.write((char *)&sweep_davidson_mults,
+                      sizeof(sweep_davidson_mults));
+            save_restart_vectors(ofs, sweep_energies);
+            save_restart_vector(ofs, sweep_discarded_weights);
+            save_restart_vectors(ofs, sweep_quanta);
+            save_restart_vectors(ofs, energies);
+            save_restart_vector(ofs, discarded_weights);
+            size_t nq = mps_quanta.size();
+            ofs.write((char *)&nq, sizeof(nq));
+            for (const auto &q : mps_quanta)
+                save_restart_vectors(ofs, q);
+            save_restart_vector(ofs, davidson_mults);
+            if (!ofs.good())
+                throw runtime_error("DMRG::save_site_restart on '" +
+                                    filename + "' failed.");
+            ofs.close();
+        }
+        if (me->para_rule != nullptr)
+            me->para_rule->comm->barrier();
+    }
+    // Load the sweep state saved by save_site_restart in dir, so that the
+    // next solve resumes the interrupted sweep. The MPS should be loaded
+    // from dir and me->load_environments(dir) should be used instead of
+    // me->init_environments. Returns false if there is no complete
+    // checkpoint in dir
+    bool load_site_restart(const string &dir) {
+        const string filename = get_site_restart_filename(dir);
+        if (!Parsing::file_exists(filename))
+            return false;
+        ifstream ifs(filename.c_str(), ios::binary);
+        if (!ifs.good())
+            throw runtime_error("DMRG::load_site_restart on '" + filename +
+                                "' failed.");
+        int n_sites = 0;
+        uint8_t fw = 0;
+        ifs.read((char *)&n_sites, sizeof(n_sites));
+        if (n_sites != me->n_sites)
+            throw runtime_error("DMRG::load_site_restart: number of sites "
+                                "does not match.");
+        ifs.read((char *)&restart_sweep, sizeof(restart_sweep));
+        ifs.read((char *)&fw, sizeof(fw));
+        ifs.read((char *)&restart_site, sizeof(restart_site));
+        ifs.read((char *)&davidson_last_error, sizeof(davidson_last_error));
+        ifs.read((char *)&sweep_cumulative_nflop,
+                 sizeof(sweep_cumulative_nflop));
+        ifs.read((char *)&sweep_davidson_mults, sizeof(sweep_davidson_mults));
+        load_restart_vectors(ifs, sweep_energies);
+        load_restart_vector(ifs, sweep_discarded_weights);
+        load_restart_vectors(ifs, sweep_quanta);
+        load_restart_vectors(ifs, energies);
+        load_restart_vector(ifs, discarded_weights);
+        size_t nq = 0;
+        ifs.read((char *)&nq, sizeof(nq));
+        mps_quanta.resize(nq);
+        for (auto &q : mps_quanta)
+            load_restart_vectors(ifs, q);
+        load_restart_vector(ifs, davidson_mults);
+        if (ifs.fail() || ifs.bad())
+            throw runtime_error("DMRG::load_site_restart on '" + filename +
+                                "' failed.");
+        ifs.close();
+        forward = fw;
+        return true;
+    }
+    string get_sweep_restart_filename(const string &dir) const {
+        return dir + "/" + frame->prefix + ".DMRG.SCHEDULE." + me->tag;
+    }
+    // Save the state after a completed sweep (index of the next sweep,
+    // direction, energies) into dir, next to the MPS copied there by sweep
+    void save_sweep_restart(const string &dir, int next_sweep,
+                            bool forward) const {
+        if (me->para_rule != nullptr && !me->para_rule->is_root())
+            return;
+        const string filename = get_sweep_restart_filename(dir);
+        ofstream ofs(filename.c_str(), ios::binary);
+        if (!ofs.good())
+            throw runtime_error("DMRG::save_sweep_restart on '" + filename +
+                                "' failed.");
+        int n_sites = me->n_sites;
+        uint8_t fw = forward;
+        ofs.write((char *)&n_sites, sizeof(n_sites));
+        ofs.write((char *)&next_sweep, sizeof(next_sweep));
+        ofs.write((char *)&fw, sizeof(fw));
+        ofs.write((char *)&davidson_last_error, sizeof(davidson_last_error));
+        save_restart_vectors(ofs, energies);
+        save_restart_vector(ofs, discarded_weights);
+        size_t nq = mps_quanta.size();
+        ofs.write((char *)&nq, sizeof(nq));
+        for (const auto &q : mps_quanta)
+            save_restart_vectors(ofs, q);
+        save_restart_vector(ofs, davidson_mults);
+        if (!ofs.good())
+            throw runtime_error("DMRG::save_sweep_restart on '" + filename +
+                                "' failed.");
+        ofs.close();
+    }
+    // Load the state saved by save_sweep_restart in dir, so that the next
+    // solve continues the schedule at the saved sweep index (with the
+    // energies of the completed sweeps). The MPS should be loaded from dir.
+    // Returns the index of the next sweep, or -1 if there is no state in dir
+    int load_sweep_restart(const string &dir) {
+        const string filename = get_sweep_restart_filename(dir);
+        if (!Parsing::file_exists(filename))
+            return -1;
+        ifstream ifs(filename.c_str(), ios::binary);
+        if (!ifs.good())
+            throw runtime_error("DMRG::load_sweep_restart on '" + filename +
+                                "' failed.");
+        int n_sites = 0;
+        uint8_t fw = 0;
+        ifs.read((char *)&n_sites, sizeof(n_sites));
+        if (n_sites != me->n_sites)
+            throw runtime_error("DMRG::load_sweep_restart: number of sites "
+                                "does not match.");
+        ifs.read((char *)&restart_sweep, sizeof(restart_sweep));
+        ifs.read((char *)&fw, sizeof(fw));
+        ifs.read((char *)&davidson_last_error, sizeof(davidson_last_error));
+        load_restart_vectors(ifs, energies);
+        load_restart_vector(ifs, discarded_weights);
+        size_t nq = 0;
+        ifs.read((char *)&nq, sizeof(nq));
+        mps_quanta.resize(nq);
+        for (auto &q : mps_quanta)
+            load_restart_vectors(ifs, q);
+        load_restart_vector(ifs, davidson_mults);
+        if (ifs.fail() || ifs.bad())
+            throw runtime_error("DMRG::load_sweep_restart on '" + filename +
+                                "' failed.");
+        ifs.close();
+        forward = fw;
+        restart_site = -1;
+        return restart_sweep;
+    }
+    static void append_progress_record(const string &filename,
+                                       const string &record) {
+        ofstream ofs(filename.c_str(), ios::app);
+        if (!ofs.good())
+            throw runtime_error("DMRG::append_progress_record on '" +
+                                filename + "' failed.");
+        ofs << record << flush;
+        ofs.close();
+    }
+    // Wait until the last progress record is written
+    void wait_progress() {
+        if (progress_writer.valid())
+            progress_writer.get();
+    }
+    // Append the record of a completed sweep to progress_filename
+    // asynchronously (records are kept in order)
+    void save_sweep_progress(int iw, bool forward, double energy_difference,
+                             double tsweep, double telapsed) {
+        if (progress_filename == "" ||
+            (me->para_rule != nullptr && !me->para_rule->is_root()))
+            return;
+        stringstream ss;
+        ss << setprecision(16);
+        ss << "{\"type\": \"sweep\", \"tag\": \"" << me->tag
+           << "\", \"sweep\": " << iw
+           << ", \"forward\": " << (forward ? "true" : "false")
+           << ", \"bond_dim\": " << (uint32_t)bond_dims[iw]
+           << ", \"noise\": " << noises[iw] << ", \"energies\": [";
+        for (size_t i = 0; i < energies.back().size(); i++)
+            ss << (i == 0 ? "" : ", ") << energies.back()[i];
+        ss << "], \"energy_difference\": ";
+        if (energies.size() >= 2)
+            ss << energy_difference;
+        else
+            ss << "null";
+        ss << ", \"discarded_weight\": " << discarded_weights.back()
+           << ", \"davidson_mults\": " << davidson_mults.back()
+           << ", \"time_sweep\": " << tsweep
+           << ", \"time_elapsed\": " << telapsed << "}" << endl;
+        wait_progress();
+        progress_writer = async(launch::async, &DMRG::append_progress_record,
+                                progress_filename, ss.str());
+    }
+    // cumulative phase times for the load balance report: eigs, decomp,
+    // env (moving environments), comm (communication and idle) and
+    // compute (site time without comm, added per site)
+    vector<double> load_balance_counters() const {
+        const shared_ptr<ParallelCommunicator<S>> &comm = me->para_rule->comm;
+        return vector<double>{teig, tdm + tsplt + tsvd, tmve,
+                              comm->tcomm + comm->tidle + comm->twait, tblk};
+    }
+    // summary of the Davidson convergence history of the last sweep
+    string davidson_telemetry_summary() const {
+        int n_iters = 0, n_restarts = 0, n_recomputes = 0, imax = 0;
+        double tmult = 0, min_gap = 0;
+        for (size_t i = 0; i < sweep_davidson_telemetry.size(); i++) {
+            const DavidsonTelemetry &t = sweep_davidson_telemetry[i];
+            n_iters += t.n_iters(), tmult += t.tmult();
+            n_restarts += t.n_restarts, n_recomputes += t.n_recomputes;
+            if (t.n_iters() > sweep_davidson_telemetry[imax].n_iters())
+                imax = (int)i;
+            if (t.gap != 0 && (min_gap == 0 || t.gap < min_gap))
+                min_gap = t.gap;
+        }
+        stringstream ss;
+        ss << " | Davidson: Niter = " << n_iters
+           << " | Nrst = " << n_restarts << " | Nrecomp = " << n_recomputes
+           << " | Tmult = " << fixed << setprecision(3) << tmult
+           << " | MaxNiter = " << sweep_davidson_telemetry[imax].n_iters()
+           << " (site #" << imax << ")"
+           << " | MinGap = " << scientific << setprecision(2) << min_gap;
+        return ss.str();
+    }
+    // cumulative phase times, recorded per site in timing
+    vector<pair<string, double>> timing_counters() const {
+        vector<pair<string, double>> r = {
+            {"move_env", tmve},        {"update", tblk},
+            {"update/eff_ham", teff},  {"update/davidson", teig},
+            {"update/perturb", tprt},  {"update/decomp", tdm},
+            {"update/split", tsplt},   {"update/svd", tsvd},
+            {"update/orth", torth}};
+        vector<pair<string, double>> rx =
+            sweep_timing_counters<S>(me->para_rule);
+        r.insert(r.end(), rx.begin(), rx.end());
+        return r;
+    }
     // one standard DMRG sweep
     virtual tuple<vector<double>, double, vector<vector<pair<S, double>>>>
     sweep(bool forward, ubond_t bond_dim, double noise,
@@ -1191,6 +2003,10 @@ template <typename S> struct DMRG {
         teff = teig = tprt = tblk = tmve = tdm = tsplt = tsvd = torth = 0;
         frame->twrite = frame->tread = frame->tasync = 0;
         frame->fpwrite = frame->fpread = 0;
+        kernel_counters_().reset();
+        hardware_counters_().reset();
+        if (frame->io_monitor != nullptr)
+            frame->io_monitor->reset();
         if (frame->fp_codec != nullptr)
             frame->fp_codec->ndata = frame->fp_codec->ncpsd = 0;
         if (me->para_rule != nullptr && iprint >= 2) {
@@ -1201,20 +2017,40 @@ template <typename S> struct DMRG {
         me->prepare();
         for (auto &xme : ext_mes)
             xme->prepare();
-        sweep_energies.clear();
-        sweep_discarded_weights.clear();
-        sweep_quanta.clear();
-        sweep_cumulative_nflop = 0;
+        if (diag_me != nullptr)
+            diag_me->prepare();
+        if (restart_site == -1) {
+            sweep_energies.clear();
+            sweep_discarded_weights.clear();
+            sweep_quanta.clear();
+            sweep_cumulative_nflop = 0;
+            sweep_davidson_mults = 0;
+            sweep_davidson_telemetry.clear();
+            sweep_load_balance.clear(
+                vector<string>{"eigs", "decomp", "env", "comm", "compute"});
+        }
+        if (subspace_expansion && me->dot == 1) {
+            if (!(noise_type & NoiseTypes::Perturbative))
+                throw runtime_error(
+                    "subspace expansion requires perturbative noise.");
+            expansion_alpha = expansion_noise = noise;
+            expansion_last_gain = 0.0;
+        }
         sweep_max_pket_size = 0;
         sweep_max_eff_ham_size = 0;
         frame->reset_peak_used_memory();
         vector<int> sweep_range;
+        const int first_site = restart_site == -1 ? me->center : restart_site;
+        restart_site = -1;
         if (forward)
-            for (int it = me->center; it < me->n_sites - me->dot + 1; it++)
+            for (int it = first_site; it < me->n_sites - me->dot + 1; it++)
                 sweep_range.push_back(it);
         else
-            for (int it = me->center; it >= 0; it--)
+            for (int it = first_site; it >= 0; it--)
                 sweep_range.push_back(it);
+        int n_done_sites = 0;
+        if (timing != nullptr)
+            timing->clear(), timing->begin("sweep");
 
         Timer t;
         for (auto i : sweep_range) {
@@ -1230,12 +2066,55 @@ template <typename S> struct DMRG {
                 cout.flush();
             }
             t.get_time();
-            Iteration r =
-                blocking(i, forward, bond_dim, noise, davidson_conv_thrd);
+            const double site_thrd =
+                site_davidson_conv_thrd(noise, davidson_conv_thrd);
+            if (me->para_rule != nullptr) {
+                me->para_rule->comm->trace_sweep = current_sweep;
+                me->para_rule->comm->trace_site = i;
+            }
+            if (frame->mem_tags != nullptr)
+                frame->mem_tags->site = i;
+            vector<pair<string, double>> tcs;
+            if (timing != nullptr) {
+                timing->begin("site " + Parsing::to_string(i));
+                tcs = timing_counters();
+            }
+            if (davidson_telemetry)
+                MatrixFunctions::davidson_telemetry() =
+                    make_shared<DavidsonTelemetry>();
+            const bool record_lb =
+                load_balance_report && me->para_rule != nullptr;
+            vector<double> lbcs;
+            if (record_lb)
+                lbcs = load_balance_counters();
+            Iteration r = blocking(i, forward, bond_dim, noise, site_thrd);
+            if (record_lb) {
+                vector<double> dt = load_balance_counters();
+                for (size_t k = 0; k < dt.size(); k++)
+                    dt[k] -= lbcs[k];
+                dt.back() -= dt[3];
+                sweep_load_balance.add(i, dt);
+            }
+            if (davidson_telemetry) {
+                sweep_davidson_telemetry.push_back(
+                    *MatrixFunctions::davidson_telemetry());
+                MatrixFunctions::davidson_telemetry() = nullptr;
+            }
+            if (timing != nullptr)
+                timing->add(tcs, timing_counters()), timing->end();
             sweep_cumulative_nflop += r.nflop;
-            if (iprint >= 2)
-                cout << r << " T = " << setw(4) << fixed << setprecision(2)
-                     << fixed << t.get_time() << endl;
+            sweep_davidson_mults += r.ndav;
+            davidson_last_error = r.error;
+            if (iprint >= 2) {
+                cout << r;
+                if (davidson_telemetry)
+                    cout << sweep_davidson_telemetry.back();
+                if (davidson_adaptive_factor != 0)
+                    cout << " Dthrd = " << scientific << setprecision(2)
+                         << site_thrd;
+                cout << " T = " << setw(4) << fixed << setprecision(2) << fixed
+                     << t.get_time() << endl;
+            }
             sweep_energies.push_back(r.energies);
             sweep_discarded_weights.push_back(r.error);
             sweep_quanta.push_back(r.quanta);
@@ -1271,7 +2150,13 @@ template <typename S> struct DMRG {
                         me->para_rule->comm->barrier();
                 }
             }
+            // mid-sweep checkpoint (not for extra environments)
+            if (frame->restart_dir_site != "" && ext_mes.size() == 0 &&
+                i != sweep_range.back() &&
+                ++n_done_sites % max(frame->restart_site_interval, 1) == 0)
+                save_site_restart(forward, forward ? i + 1 : i - 1);
         }
+        frame->wait_save_files();
         size_t idx =
             min_element(sweep_energies.begin(), sweep_energies.end(),
                         [](const vector<double> &x, const vector<double> &y) {
@@ -1282,6 +2167,11 @@ template <typename S> struct DMRG {
             (me->para_rule == nullptr || me->para_rule->is_root())) {
             if (!Parsing::path_exists(frame->restart_dir))
                 Parsing::mkdir(frame->restart_dir);
+            // the saved state no longer matches the mps
+            if (Parsing::file_exists(
+                    get_sweep_restart_filename(frame->restart_dir)))
+                Parsing::remove_file(
+                    get_sweep_restart_filename(frame->restart_dir));
             me->ket->info->copy_mutable(frame->restart_dir);
             me->ket->copy_data(frame->restart_dir);
         }
@@ -1294,6 +2184,14 @@ template <typename S> struct DMRG {
             me->ket->info->copy_mutable(rdps);
             me->ket->copy_data(rdps);
         }
+        if (me->para_rule != nullptr)
+            me->para_rule->comm->trace_site = -1;
+        if (frame->mem_tags != nullptr)
+            frame->mem_tags->site = -1;
+        if (timing != nullptr)
+            timing->end(), timing->save();
+        if (load_balance_report && me->para_rule != nullptr)
+            sweep_load_balance.gather(me->para_rule->comm);
         double max_dw = *max_element(sweep_discarded_weights.begin(),
                                      sweep_discarded_weights.end());
         return make_tuple(sweep_energies[idx], max_dw, sweep_quanta[idx]);
@@ -1343,11 +2241,22 @@ template <typename S> struct DMRG {
             else
                 sout << " Site = " << setw(4) << i << " .. ";
             t.get_time();
-            Iteration r =
-                blocking(i, forward, bond_dim, noise, davidson_conv_thrd);
+            const double site_thrd =
+                site_davidson_conv_thrd(noise, davidson_conv_thrd);
+            if (me->para_rule != nullptr) {
+                me->para_rule->comm->trace_sweep = current_sweep;
+                me->para_rule->comm->trace_site = i;
+            }
+            Iteration r = blocking(i, forward, bond_dim, noise, site_thrd);
             sweep_cumulative_nflop += r.nflop;
+            sweep_davidson_mults += r.ndav;
+            davidson_last_error = r.error;
             sweep_time[i] = t.get_time();
-            sout << r << " T = " << setw(4) << fixed << setprecision(2)
+            sout << r;
+            if (davidson_adaptive_factor != 0)
+                sout << " Dthrd = " << scientific << setprecision(2)
+                     << site_thrd;
+            sout << " T = " << setw(4) << fixed << setprecision(2)
                  << sweep_time[i] << endl;
             if (iprint >= 2)
                 cout << sout.rdbuf();
@@ -1447,6 +2356,107 @@ template <typename S> struct DMRG {
             cout << sout.rdbuf();
         }
     }
+    // connection centers minimizing the max time of partitions in the next
+    // unordered sweep, based on the time of each site in sweep_time
+    // each center stays between its old neighbours and is fixed if the
+    // connection is not in fused form; ties are broken by fewer moved sites
+    vector<int> balance_conn_centers(ubond_t bond_dim) const {
+        shared_ptr<ParallelMPS<S>> para_mps =
+            dynamic_pointer_cast<ParallelMPS<S>>(me->ket);
+        const shared_ptr<MPSInfo<S>> &info = para_mps->info;
+        const vector<int> &ccs = para_mps->conn_centers;
+        const int n_sites = me->n_sites, nc = para_mps->ncenter;
+        const int ns = (int)sweep_time.size();
+        // cost model of two-dot blocks: O(ml * mr * dl * dr * (ml + mr))
+        vector<double> site_cost(ns, 0);
+        double tmeas = 0, tmodel = 0;
+        for (int i = 0; i < ns; i++) {
+            double ml = min((double)bond_dim,
+                            (double)info->left_dims_fci[i]->n_states_total);
+            double mr = min((double)bond_dim,
+                            (double)info->right_dims_fci[i + me->dot]
+                                ->n_states_total);
+            double d = 1;
+            for (int j = i; j < i + me->dot; j++)
+                d *= info->basis[j]->n_states_total;
+            double model = ml * mr * d * (ml + mr);
+            site_cost[i] = model;
+            if (sweep_time[i] != 0)
+                tmeas += sweep_time[i], tmodel += model;
+        }
+        for (int i = 0; i < ns; i++)
+            if (sweep_time[i] != 0)
+                site_cost[i] = sweep_time[i];
+            else if (tmodel != 0)
+                site_cost[i] *= tmeas / tmodel;
+        vector<double> psum(ns + 1, 0);
+        for (int i = 0; i < ns; i++)
+            psum[i + 1] = psum[i] + site_cost[i];
+        // time of partition of sites [pi, pj)
+        auto part_cost = [&psum, ns](int pi, int pj) {
+            return psum[min(max(pj - 1, pi), ns)] - psum[min(pi, ns)];
+        };
+        vector<int> lcc(nc), hcc(nc);
+        for (int ip = 0; ip < nc; ip++) {
+            int cc = ccs[ip];
+            if (para_mps->canonical_form[cc - 1] == 'L' ||
+                para_mps->canonical_form[cc - 1] == 'R')
+                lcc[ip] = hcc[ip] = cc;
+            else {
+                lcc[ip] = (ip == 0 ? 0 : ccs[ip - 1]) + 2;
+                hcc[ip] = (ip == nc - 1 ? n_sites : ccs[ip + 1]) - 2;
+                lcc[ip] = min(lcc[ip], cc), hcc[ip] = max(hcc[ip], cc);
+            }
+        }
+        // (max time, number of moved sites) of the first ip + 1 partitions
+        // with the ip-th center at lcc[ip] + k
+        typedef pair<double, int> cost_t;
+        vector<vector<cost_t>> f(nc);
+        vector<vector<int>> prev(nc);
+        for (int ip = 0; ip < nc; ip++) {
+            f[ip].resize(hcc[ip] - lcc[ip] + 1,
+                         make_pair(numeric_limits<double>::max(), 0));
+            prev[ip].resize(f[ip].size(), -1);
+            for (int c = lcc[ip]; c <= hcc[ip]; c++) {
+                cost_t &fc = f[ip][c - lcc[ip]];
+                int dc = abs(c - ccs[ip]);
+                if (ip == 0) {
+                    fc = make_pair(part_cost(0, c), dc);
+                    continue;
+                }
+                for (int cp = lcc[ip - 1]; cp <= min(hcc[ip - 1], c - 2);
+                     cp++) {
+                    const cost_t &fp = f[ip - 1][cp - lcc[ip - 1]];
+                    if (prev[ip - 1][cp - lcc[ip - 1]] == -2)
+                        continue;
+                    cost_t x = make_pair(max(fp.first, part_cost(cp, c)),
+                                         fp.second + dc);
+                    if (prev[ip][c - lcc[ip]] == -1 || x < fc)
+                        fc = x, prev[ip][c - lcc[ip]] = cp;
+                }
+                // no feasible previous center
+                if (prev[ip][c - lcc[ip]] == -1)
+                    prev[ip][c - lcc[ip]] = -2;
+            }
+        }
+        int cbest = -1;
+        cost_t fbest;
+        for (int c = lcc[nc - 1]; c <= hcc[nc - 1]; c++) {
+            if (prev[nc - 1][c - lcc[nc - 1]] == -2)
+                continue;
+            const cost_t &fc = f[nc - 1][c - lcc[nc - 1]];
+            cost_t x = make_pair(max(fc.first, part_cost(c, n_sites)),
+                                 fc.second);
+            if (cbest == -1 || x < fbest)
+                fbest = x, cbest = c;
+        }
+        if (cbest == -1)
+            return ccs;
+        vector<int> r(nc);
+        for (int ip = nc - 1; ip >= 0; ip--)
+            r[ip] = cbest, cbest = prev[ip][cbest - lcc[ip]];
+        return r;
+    }
     // one unordered DMRG sweep (multi-center MPS required)
     tuple<vector<double>, double, vector<vector<pair<S, double>>>>
     unordered_sweep(bool forward, ubond_t bond_dim, double noise,
@@ -1457,6 +2467,7 @@ template <typename S> struct DMRG {
         teff = teig = tprt = tblk = tmve = tdm = tsplt = tsvd = torth = 0;
         frame->twrite = frame->tread = frame->tasync = 0;
         frame->fpwrite = frame->fpread = 0;
+        kernel_counters_().reset();
         if (frame->fp_codec != nullptr)
             frame->fp_codec->ndata = frame->fp_codec->ncpsd = 0;
         if (para_mps->rule != nullptr && iprint >= 2) {
@@ -1474,6 +2485,7 @@ template <typename S> struct DMRG {
         sweep_discarded_weights.clear();
         sweep_quanta.clear();
         sweep_cumulative_nflop = 0;
+        sweep_davidson_mults = 0;
         sweep_max_pket_size = 0;
         sweep_max_eff_ham_size = 0;
         frame->reset_peak_used_memory();
@@ -1511,7 +2523,10 @@ template <typename S> struct DMRG {
         }
         vector<int> new_conn_centers = para_mps->conn_centers;
         vector<int> old_conn_centers = para_mps->conn_centers;
-        for (int ip = 0; ip < para_mps->ncenter; ip++) {
+        if (conn_adjust_balanced)
+            new_conn_centers = balance_conn_centers(bond_dim);
+        for (int ip = 0; ip < para_mps->ncenter && !conn_adjust_balanced;
+             ip++) {
             me->center = para_mps->conn_centers[ip] - 1;
             if (para_mps->canonical_form[me->center] == 'L' ||
                 para_mps->canonical_form[me->center] == 'R')
@@ -1608,6 +2623,11 @@ template <typename S> struct DMRG {
             para_mps->save_data();
             if (!Parsing::path_exists(frame->restart_dir))
                 Parsing::mkdir(frame->restart_dir);
+            // the saved state no longer matches the mps
+            if (Parsing::file_exists(
+                    get_sweep_restart_filename(frame->restart_dir)))
+                Parsing::remove_file(
+                    get_sweep_restart_filename(frame->restart_dir));
             para_mps->info->copy_mutable(frame->restart_dir);
             para_mps->copy_data(frame->restart_dir);
         }
@@ -1626,6 +2646,73 @@ template <typename S> struct DMRG {
                                      sweep_discarded_weights.end());
         return make_tuple(sweep_energies[idx], max_dw, sweep_quanta[idx]);
     }
+    // sweeps with extrapolation_bond_dims after solve and linear
+    // extrapolation of energy to zero discarded weight
+    // returns the extrapolated energy
+    double extrapolate(bool forward) {
+        shared_ptr<ParallelMPS<S>> para_mps =
+            me->ket->get_type() == MPSTypes::MultiCenter
+                ? dynamic_pointer_cast<ParallelMPS<S>>(me->ket)
+                : nullptr;
+        const double dav_thrd =
+            davidson_conv_thrds.size() == 0 ? 1E-9 : davidson_conv_thrds.back();
+        const string rdo = frame->restart_dir_optimal_mps;
+        const string rdops = frame->restart_dir_optimal_mps_per_sweep;
+        frame->restart_dir_optimal_mps = "";
+        frame->restart_dir_optimal_mps_per_sweep = "";
+        extrapolation_energies.clear();
+        extrapolation_discarded_weights.clear();
+        for (ubond_t bdim : extrapolation_bond_dims) {
+            if (has_abort_file())
+                break;
+            tune_bond_dim = bdim;
+            double energy = 0, dw = 0;
+            for (int iw = 0; iw < max(extrapolation_n_sweeps, 1); iw++) {
+                auto sweep_results =
+                    para_mps != nullptr
+                        ? unordered_sweep(forward, bdim, 0.0, dav_thrd)
+                        : sweep(forward, bdim, 0.0, dav_thrd);
+                energy = get<0>(sweep_results)[0];
+                dw = get<1>(sweep_results);
+                forward = !forward;
+            }
+            extrapolation_energies.push_back(energy);
+            extrapolation_discarded_weights.push_back(dw);
+            if (iprint >= 1)
+                cout << "Extrapolation | Bond dimension = " << setw(4)
+                     << (uint32_t)bdim << fixed << setprecision(10)
+                     << " | E = " << setw(18) << extrapolation_energies.back()
+                     << " | DW = " << setw(6) << setprecision(2) << scientific
+                     << extrapolation_discarded_weights.back() << endl;
+        }
+        frame->restart_dir_optimal_mps = rdo;
+        frame->restart_dir_optimal_mps_per_sweep = rdops;
+        this->forward = forward;
+        const size_t n = extrapolation_energies.size();
+        double sx = 0, sy = 0, sxx = 0, sxy = 0;
+        for (size_t i = 0; i < n; i++) {
+            const double x = extrapolation_discarded_weights[i],
+                         y = extrapolation_energies[i];
+            sx += x, sy += y, sxx += x * x, sxy += x * y;
+        }
+        const double det = n * sxx - sx * sx;
+        if (n >= 2 && det != 0) {
+            extrapolation_slope = (n * sxy - sx * sy) / det;
+            extrapolated_energy = (sy - extrapolation_slope * sx) / n;
+        } else {
+            extrapolation_slope = 0.0;
+            extrapolated_energy =
+                n != 0 ? extrapolation_energies.back()
+                       : (energies.size() != 0 ? energies.back()[0] : 0.0);
+        }
+        if (iprint >= 1)
+            cout << "Extrapolated energy = " << fixed << setw(18)
+                 << setprecision(10) << extrapolated_energy
+                 << " | Slope = " << scientific << setprecision(2)
+                 << extrapolation_slope << endl
+                 << endl;
+        return extrapolated_energy;
+    }
     // energy optimization using multiple DMRG sweeps
     double solve(int n_sweeps, bool forward = true, double tol = 1E-6) {
         if (bond_dims.size() < n_sweeps)
@@ -1644,12 +2731,21 @@ template <typename S> struct DMRG {
         Timer start, current;
         start.get_time();
         current.get_time();
-        energies.clear();
-        discarded_weights.clear();
-        mps_quanta.clear();
-        bool converged;
-        double energy_difference;
-        for (int iw = 0; iw < n_sweeps; iw++) {
+        // resuming an interrupted sweep from load_site_restart
+        const int first_sweep = max(restart_sweep, 0);
+        if (restart_sweep == -1) {
+            energies.clear();
+            discarded_weights.clear();
+            mps_quanta.clear();
+            davidson_mults.clear();
+            davidson_last_error = -1.0;
+        } else
+            forward = this->forward;
+        restart_sweep = -1;
+        bool converged = false;
+        double energy_difference = 0;
+        for (int iw = first_sweep; iw < n_sweeps; iw++) {
+            current_sweep = iw;
             if (iprint >= 1)
                 cout << "Sweep = " << setw(4) << iw
                      << " | Direction = " << setw(8)
@@ -1659,15 +2755,18 @@ template <typename S> struct DMRG {
                      << setw(9) << setprecision(2) << noises[iw]
                      << " | Dav threshold = " << scientific << setw(9)
                      << setprecision(2) << davidson_conv_thrds[iw] << endl;
+            tune_bond_dim = bond_dims[iw];
             auto sweep_results =
                 para_mps != nullptr
                     ? unordered_sweep(forward, bond_dims[iw], noises[iw],
                                       davidson_conv_thrds[iw])
                     : sweep(forward, bond_dims[iw], noises[iw],
                             davidson_conv_thrds[iw]);
+            select_seq_type();
             energies.push_back(get<0>(sweep_results));
             discarded_weights.push_back(get<1>(sweep_results));
             mps_quanta.push_back(get<2>(sweep_results));
+            davidson_mults.push_back(sweep_davidson_mults);
             if (energies.size() >= 2)
                 energy_difference = energies[energies.size() - 1].back() -
                                     energies[energies.size() - 2].back();
@@ -1676,7 +2775,17 @@ template <typename S> struct DMRG {
                         noises[iw] == noises.back() &&
                         bond_dims[iw] == bond_dims.back();
             forward = !forward;
+            // the mps of this sweep has been copied into these dirs
+            if (frame->restart_dir != "")
+                save_sweep_restart(frame->restart_dir, iw + 1, forward);
+            if (frame->restart_dir_per_sweep != "")
+                save_sweep_restart(frame->restart_dir_per_sweep + "." +
+                                       Parsing::to_string(
+                                           (int)energies.size() - 1),
+                                   iw + 1, forward);
             double tswp = current.get_time();
+            save_sweep_progress(iw, !forward, energy_difference, tswp,
+                                current.current - start.current);
             if (iprint >= 1) {
                 cout << "Time elapsed = " << fixed << setw(10)
                      << setprecision(3) << current.current - start.current;
@@ -1699,8 +2808,16 @@ template <typename S> struct DMRG {
                     cout << "Time sweep = " << setw(12) << tswp;
                     cout << " | "
                          << Parsing::to_size_string(sweep_cumulative_nflop,
-                                                    "FLOP/SWP")
-                         << endl;
+                                                    "FLOP/SWP");
+                    if (davidson_adaptive_factor != 0)
+                        cout << " | Ndav = " << sweep_davidson_mults;
+                    cout << endl;
+                    if (davidson_telemetry &&
+                        sweep_davidson_telemetry.size() != 0)
+                        cout << davidson_telemetry_summary() << endl;
+                    if (load_balance_report && me->para_rule != nullptr &&
+                        me->para_rule->is_root())
+                        cout << sweep_load_balance.report();
                     if (para_mps != nullptr && para_mps->rule != nullptr) {
                         shared_ptr<ParallelCommunicator<S>> comm =
                             para_mps->rule->comm;
@@ -1747,6 +2864,11 @@ template <typename S> struct DMRG {
                          << Parsing::to_size_string(sweep_max_pket_size *
                                                     sizeof(double))
                          << endl;
+                    if (frame->mem_tags != nullptr)
+                        sout << *frame->mem_tags << endl;
+                    if (frame->mem_tags != nullptr &&
+                        frame->mem_tags->timeline_stride != 0)
+                        sout << frame->mem_tags->peak_report() << endl;
                     sout << " | Tread = " << frame->tread
                          << " | Twrite = " << frame->twrite
                          << " | Tfpread = " << frame->fpread
@@ -1759,6 +2881,12 @@ template <typename S> struct DMRG {
                              << Parsing::to_size_string(frame->fp_codec->ncpsd *
                                                         8);
                     sout << " | Tasync = " << frame->tasync << endl;
+                    if (frame->io_monitor != nullptr)
+                        sout << frame->io_monitor->report();
+                    if (kernel_counters_().enabled)
+                        sout << kernel_counters_().summary();
+                    if (hardware_counters_().enabled)
+                        sout << hardware_counters_().summary();
                     sout << " | Trot = " << me->trot << " | Tctr = " << me->tctr
                          << " | Tint = " << me->tint << " | Tmid = " << me->tmid
                          << " | Tdctr = " << me->tdctr
@@ -1785,6 +2913,9 @@ template <typename S> struct DMRG {
         if (!converged && iprint > 0 && tol != 0)
             cout << "ATTENTION: DMRG is not converged to desired tolerance of "
                  << scientific << tol << endl;
+        if (extrapolation_bond_dims.size() != 0)
+            extrapolate(forward);
+        wait_progress();
         return energies.back()[0];
     }
 };
@@ -1856,6 +2987,8 @@ template <typename S> struct Linear {
     size_t sweep_max_eff_ham_size = 0;
     double tprt = 0, tmult = 0, teff = 0, tmve = 0, tblk = 0, tdm = 0,
            tsplt = 0, tsvd = 0;
+    // if not nullptr, per-site phase times of each sweep are recorded
+    shared_ptr<TimingTree> timing = nullptr;
     Timer _t, _t2;
     bool precondition_cg = true;
     // number of eigenvalues solved using harmonic Davidson
@@ -1882,6 +3015,15 @@ template <typename S> struct Linear {
     double gf_extra_eta = 0;
     // calculated GF for extra frequencies and ext_mpss
     vector<vector<vector<double>>> gf_extra_ext_targets;
+    // if true, the GCROT subspace of one frequency starts the solve of the
+    // next frequency at the same site (gf_extra_omegas, then gf_omega)
+    bool gf_recycle = false;
+    // frequencies solved at every site together with gf_omega
+    // (two-site GreensFunction only), sharing the environments and
+    // the bra basis, with one solution per frequency at the current site
+    vector<double> gf_multi_omegas;
+    // calculated GF for gf_multi_omegas at the last visited site
+    vector<vector<double>> gf_multi_targets;
     Linear(const shared_ptr<MovingEnvironment<S>> &lme,
            const shared_ptr<MovingEnvironment<S>> &rme,
            const shared_ptr<MovingEnvironment<S>> &tme,
@@ -1952,6 +3094,9 @@ template <typename S> struct Linear {
                              double minres_conv_thrd) {
         const shared_ptr<MovingEnvironment<S>> &me = rme;
         assert(me->bra != me->ket);
+        if (gf_multi_omegas.size() != 0)
+            throw runtime_error(
+                "Linear: gf_multi_omegas requires two-site sweeps!");
         frame->activate(0);
         bool fuse_left = i <= me->fuse_center;
         vector<shared_ptr<MPS<S>>> mpss = {me->bra, me->ket};
@@ -2087,6 +3232,7 @@ template <typename S> struct Linear {
                        eq_type == EquationTypes::GreensFunctionSquared) {
                 tuple<pair<double, double>, pair<int, int>, size_t, double>
                     lpdi;
+                ComplexGCROTRecycle recycle;
                 if (gf_extra_omegas_at_site == i &&
                     gf_extra_omegas.size() != 0) {
                     gf_extra_targets.resize(gf_extra_omegas.size());
@@ -2112,7 +3258,8 @@ template <typename S> struct Linear {
                                 gf_extra_eta == 0 ? gf_eta : gf_extra_eta,
                                 real_bra, gcrotmk_size, iprint >= 3,
                                 minres_conv_thrd, minres_max_iter,
-                                minres_soft_max_iter, me->para_rule);
+                                minres_soft_max_iter, me->para_rule,
+                                gf_recycle ? &recycle : nullptr);
                         if (tme != nullptr || ext_tmes.size() != 0) {
                             memcpy(extra_bras.data() +
                                        j * 2 * l_eff->bra->total_memory,
@@ -2143,7 +3290,8 @@ template <typename S> struct Linear {
                     lpdi = l_eff->greens_function(
                         lme->mpo->const_e, gf_omega, gf_eta, real_bra,
                         gcrotmk_size, iprint >= 3, minres_conv_thrd,
-                        minres_max_iter, minres_soft_max_iter, me->para_rule);
+                        minres_max_iter, minres_soft_max_iter, me->para_rule,
+                        gf_recycle ? &recycle : nullptr);
                 targets =
                     vector<double>{get<0>(lpdi).first, get<0>(lpdi).second};
                 get<1>(pdi).first += get<1>(lpdi).first;
@@ -2712,7 +3860,7 @@ template <typename S> struct Linear {
         get<3>(pdi) = get<3>(mpdi);
         tmult += _t.get_time();
         vector<double> targets = {get<0>(pdi)};
-        vector<double> extra_bras;
+        vector<double> extra_bras, multi_bras;
         h_eff->deallocate();
         if (eq_type == EquationTypes::FitAddition ||
             eq_type == EquationTypes::PerturbativeCompression) {
@@ -2774,6 +3922,7 @@ template <typename S> struct Linear {
                        eq_type == EquationTypes::GreensFunctionSquared) {
                 tuple<pair<double, double>, pair<int, int>, size_t, double>
                     lpdi;
+                ComplexGCROTRecycle recycle;
                 if (gf_extra_omegas_at_site == i &&
                     gf_extra_omegas.size() != 0) {
                     gf_extra_targets.resize(gf_extra_omegas.size());
@@ -2799,7 +3948,8 @@ template <typename S> struct Linear {
                                 gf_extra_eta == 0 ? gf_eta : gf_extra_eta,
                                 real_bra, gcrotmk_size, iprint >= 3,
                                 minres_conv_thrd, minres_max_iter,
-                                minres_soft_max_iter, me->para_rule);
+                                minres_soft_max_iter, me->para_rule,
+                                gf_recycle ? &recycle : nullptr);
                         if (tme != nullptr || ext_tmes.size() != 0) {
                             memcpy(extra_bras.data() +
                                        j * 2 * l_eff->bra->total_memory,
@@ -2821,21 +3971,62 @@ template <typename S> struct Linear {
                            l_eff->bra->total_memory * sizeof(double));
                     tmp.deallocate();
                 }
-                if (eq_type == EquationTypes::GreensFunctionSquared)
-                    lpdi = l_eff->greens_function_squared(
-                        lme->mpo->const_e, gf_omega, gf_eta, real_bra,
-                        cg_n_harmonic_projection, iprint >= 3, minres_conv_thrd,
-                        minres_max_iter, minres_soft_max_iter, me->para_rule);
-                else
-                    lpdi = l_eff->greens_function(
-                        lme->mpo->const_e, gf_omega, gf_eta, real_bra,
-                        gcrotmk_size, iprint >= 3, minres_conv_thrd,
-                        minres_max_iter, minres_soft_max_iter, me->para_rule);
-                targets =
-                    vector<double>{get<0>(lpdi).first, get<0>(lpdi).second};
-                get<1>(pdi).first += get<1>(lpdi).first;
-                get<1>(pdi).second += get<1>(lpdi).second;
-                get<2>(pdi) += get<2>(lpdi), get<3>(pdi) += get<3>(lpdi);
+                if (gf_multi_omegas.size() != 0) {
+                    if (eq_type != EquationTypes::GreensFunction)
+                        throw runtime_error("Linear: gf_multi_omegas requires "
+                                            "EquationTypes::GreensFunction!");
+                    // all frequencies are solved with the same [H_eff],
+                    // starting from the bra of gf_omega
+                    const size_t nw = gf_multi_omegas.size();
+                    const MKL_INT n = (MKL_INT)l_eff->bra->total_memory;
+                    vector<double> omegas = {gf_omega};
+                    omegas.insert(omegas.end(), gf_multi_omegas.begin(),
+                                  gf_multi_omegas.end());
+                    multi_bras.resize((size_t)n * 2 * nw);
+                    vector<MatrixRef> rbras = {MatrixRef(real_bra->data, n, 1)};
+                    vector<MatrixRef> ibras = {
+                        MatrixRef(l_eff->bra->data, n, 1)};
+                    for (size_t j = 0; j < nw; j++) {
+                        ibras.push_back(MatrixRef(
+                            multi_bras.data() + j * 2 * n, n, 1));
+                        rbras.push_back(MatrixRef(
+                            multi_bras.data() + (j * 2 + 1) * n, n, 1));
+                        memcpy(ibras.back().data, l_eff->bra->data,
+                               n * sizeof(double));
+                    }
+                    auto mpdi = l_eff->greens_function_multi(
+                        lme->mpo->const_e, omegas, gf_eta, rbras, ibras,
+                        iprint >= 3, minres_conv_thrd, minres_max_iter,
+                        minres_soft_max_iter, me->para_rule);
+                    targets = vector<double>{get<0>(mpdi)[0].first,
+                                             get<0>(mpdi)[0].second};
+                    gf_multi_targets.resize(nw);
+                    for (size_t j = 0; j < nw; j++)
+                        gf_multi_targets[j] =
+                            vector<double>{get<0>(mpdi)[j + 1].first,
+                                           get<0>(mpdi)[j + 1].second};
+                    get<1>(pdi).first += get<1>(mpdi).first;
+                    get<1>(pdi).second += get<1>(mpdi).second;
+                    get<2>(pdi) += get<2>(mpdi), get<3>(pdi) += get<3>(mpdi);
+                } else {
+                    if (eq_type == EquationTypes::GreensFunctionSquared)
+                        lpdi = l_eff->greens_function_squared(
+                            lme->mpo->const_e, gf_omega, gf_eta, real_bra,
+                            cg_n_harmonic_projection, iprint >= 3,
+                            minres_conv_thrd, minres_max_iter,
+                            minres_soft_max_iter, me->para_rule);
+                    else
+                        lpdi = l_eff->greens_function(
+                            lme->mpo->const_e, gf_omega, gf_eta, real_bra,
+                            gcrotmk_size, iprint >= 3, minres_conv_thrd,
+                            minres_max_iter, minres_soft_max_iter,
+                            me->para_rule, gf_recycle ? &recycle : nullptr);
+                    targets = vector<double>{get<0>(lpdi).first,
+                                             get<0>(lpdi).second};
+                    get<1>(pdi).first += get<1>(lpdi).first;
+                    get<1>(pdi).second += get<1>(lpdi).second;
+                    get<2>(pdi) += get<2>(lpdi), get<3>(pdi) += get<3>(lpdi);
+                }
             } else
                 assert(false);
             tmult += _t.get_time();
@@ -2905,6 +4096,29 @@ template <typename S> struct Linear {
                     t_eff->bra->data = tbra_bak;
                     t_eff->ket->data = tket_bak;
                 }
+            for (size_t j = 0; j < gf_multi_targets.size() &&
+                               multi_bras.size() != 0;
+                 j++) {
+                double *tbra_bak = t_eff->bra->data;
+                double *tket_bak = t_eff->ket->data;
+                for (int k = 1; k >= 0; k--) {
+                    // k = 1: imag part at j * 2; k = 0: real part at j * 2 + 1
+                    double *ptr = multi_bras.data() +
+                                  (j * 2 + 1 - k) * real_bra->total_memory;
+                    if (tme->bra->tensors[i] == me->bra->tensors[i])
+                        t_eff->bra->data = ptr;
+                    if (tme->ket->tensors[i] == me->bra->tensors[i])
+                        t_eff->ket->data = ptr;
+                    tpdi = t_eff->expect(tme->mpo->const_e, algo_type, ex_type,
+                                         tme->para_rule);
+                    gf_multi_targets[j][k] = get<0>(tpdi)[0].second;
+                    get<1>(pdi).first++;
+                    get<2>(pdi) += get<1>(tpdi);
+                    get<3>(pdi) += get<2>(tpdi);
+                }
+                t_eff->bra->data = tbra_bak;
+                t_eff->ket->data = tket_bak;
+            }
             tmult += _t.get_time();
             t_eff->deallocate();
         }
@@ -3028,6 +4242,18 @@ template <typename S> struct Linear {
         int bra_mmps = 0;
         if ((noise_type & NoiseTypes::Perturbative) && noise != 0)
             assert(pbra != nullptr);
+        // the bra basis is shared by all frequencies of gf_multi_omegas
+        vector<shared_ptr<SparseMatrix<S>>> multi_wfns;
+        double multi_weight = 1.0;
+        if (multi_bras.size() != 0) {
+            for (size_t j = 0; j < gf_multi_omegas.size() * 2; j++) {
+                multi_wfns.push_back(make_shared<SparseMatrix<S>>());
+                multi_wfns.back()->allocate(real_bra->info,
+                                            multi_bras.data() +
+                                                j * real_bra->total_memory);
+            }
+            multi_weight = 1.0 / (gf_multi_omegas.size() + 1);
+        }
         if (me->para_rule == nullptr || me->para_rule->is_root()) {
             for (auto &mps : mpss) {
                 shared_ptr<SparseMatrix<S>> old_wfn = mps->tensors[i];
@@ -3052,7 +4278,7 @@ template <typename S> struct Linear {
                             mps->info->vacuum, old_wfn, forward, 0.0,
                             NoiseTypes::None);
                     } else {
-                        double weight = 1 - right_weight;
+                        double weight = (1 - right_weight) * multi_weight;
                         if (real_bra != nullptr)
                             weight *= complex_weights[1];
                         dm = MovingEnvironment<S>::density_matrix(
@@ -3066,10 +4292,16 @@ template <typename S> struct Linear {
                                           1),
                                 1.0);
                         if (real_bra != nullptr) {
-                            weight = complex_weights[0] * (1 - right_weight);
+                            weight = complex_weights[0] * (1 - right_weight) *
+                                     multi_weight;
                             MovingEnvironment<S>::density_matrix_add_wfn(
                                 dm, real_bra, forward, weight);
                         }
+                        for (size_t j = 0; j < multi_wfns.size(); j++)
+                            MovingEnvironment<S>::density_matrix_add_wfn(
+                                dm, multi_wfns[j], forward,
+                                complex_weights[1 - j % 2] *
+                                    (1 - right_weight) * multi_weight);
                         if (right_weight != 0)
                             MovingEnvironment<S>::density_matrix_add_wfn(
                                 dm, right_bra, forward, right_weight);
@@ -3095,13 +4327,19 @@ template <typename S> struct Linear {
                                 MovingEnvironment<S>::scale_perturbative_noise(
                                     noise, noise_type, pbra);
                         }
-                        vector<double> weights = {1};
+                        vector<double> weights = {sqrt(multi_weight)};
                         vector<shared_ptr<SparseMatrix<S>>> xwfns = {};
                         if (real_bra != nullptr) {
-                            weights = vector<double>{sqrt(complex_weights[1]),
-                                                     sqrt(complex_weights[0])};
+                            weights = vector<double>{
+                                sqrt(complex_weights[1] * multi_weight),
+                                sqrt(complex_weights[0] * multi_weight)};
                             xwfns.push_back(real_bra);
                         }
+                        for (size_t j = 0; j < multi_wfns.size(); j++) {
+                            weights.push_back(sqrt(complex_weights[1 - j % 2] *
+                                                   multi_weight));
+                            xwfns.push_back(multi_wfns[j]);
+                        }
                         if (right_weight != 0) {
                             for (auto w : weights)
                                 w = sqrt(w * w * (1 - right_weight));
@@ -3213,12 +4451,69 @@ template <typename S> struct Linear {
         tblk += _t2.get_time();
         return it;
     }
+    // cumulative phase times, recorded per site in timing
+    vector<pair<string, double>> timing_counters() const {
+        vector<pair<string, double>> r = {
+            {"move_env", tmve},       {"update", tblk},
+            {"update/eff_ham", teff}, {"update/mult", tmult},
+            {"update/perturb", tprt}, {"update/decomp", tdm},
+            {"update/split", tsplt},  {"update/svd", tsvd}};
+        vector<pair<string, double>> rx =
+            sweep_timing_counters<S>(rme->para_rule);
+        r.insert(r.end(), rx.begin(), rx.end());
+        return r;
+    }
+    // index of the site target used as the sweep result
+    size_t optimal_target_index() const {
+        size_t idx = -1;
+        switch (conv_type) {
+        case ConvergenceTypes::MiddleSite:
+            idx = sweep_targets.size() / 2;
+            break;
+        case ConvergenceTypes::LastMinimal:
+            idx = min_element(
+                      sweep_targets.begin(), sweep_targets.end(),
+                      [](const vector<double> &x, const vector<double> &y) {
+                          return x.back() < y.back();
+                      }) -
+                  sweep_targets.begin();
+            break;
+        case ConvergenceTypes::LastMaximal:
+            idx = min_element(
+                      sweep_targets.begin(), sweep_targets.end(),
+                      [](const vector<double> &x, const vector<double> &y) {
+                          return x.back() > y.back();
+                      }) -
+                  sweep_targets.begin();
+            break;
+        case ConvergenceTypes::FirstMinimal:
+            idx = min_element(
+                      sweep_targets.begin(), sweep_targets.end(),
+                      [](const vector<double> &x, const vector<double> &y) {
+                          return x[0] < y[0];
+                      }) -
+                  sweep_targets.begin();
+            break;
+        case ConvergenceTypes::FirstMaximal:
+            idx = min_element(
+                      sweep_targets.begin(), sweep_targets.end(),
+                      [](const vector<double> &x, const vector<double> &y) {
+                          return x[0] > y[0];
+                      }) -
+                  sweep_targets.begin();
+            break;
+        default:
+            assert(false);
+        }
+        return idx;
+    }
     tuple<vector<double>, double> sweep(bool forward, ubond_t bra_bond_dim,
                                         ubond_t ket_bond_dim, double noise,
                                         double minres_conv_thrd) {
         teff = tmult = tprt = tblk = tmve = tdm = tsplt = tsvd = 0;
         frame->twrite = frame->tread = frame->tasync = 0;
         frame->fpwrite = frame->fpread = 0;
+        kernel_counters_().reset();
         if (frame->fp_codec != nullptr)
             frame->fp_codec->ndata = frame->fp_codec->ncpsd = 0;
         if (lme != nullptr && lme->para_rule != nullptr) {
@@ -3246,6 +4541,8 @@ template <typename S> struct Linear {
         else
             for (int it = rme->center; it >= 0; it--)
                 sweep_range.push_back(it);
+        if (timing != nullptr)
+            timing->clear(), timing->begin("sweep");
 
         Timer t;
         for (auto i : sweep_range) {
@@ -3261,8 +4558,17 @@ template <typename S> struct Linear {
                 cout.flush();
             }
             t.get_time();
+            if (frame->mem_tags != nullptr)
+                frame->mem_tags->site = i;
+            vector<pair<string, double>> tcs;
+            if (timing != nullptr) {
+                timing->begin("site " + Parsing::to_string(i));
+                tcs = timing_counters();
+            }
             Iteration r = blocking(i, forward, bra_bond_dim, ket_bond_dim,
                                    noise, minres_conv_thrd);
+            if (timing != nullptr)
+                timing->add(tcs, timing_counters()), timing->end();
             sweep_cumulative_nflop += r.nflop;
             if (iprint >= 2)
                 cout << r << " T = " << setw(4) << fixed << setprecision(2)
@@ -3271,50 +4577,7 @@ template <typename S> struct Linear {
             sweep_discarded_weights.push_back(r.error);
             if (frame->restart_dir_optimal_mps != "" ||
                 frame->restart_dir_optimal_mps_per_sweep != "") {
-                size_t midx = -1;
-                switch (conv_type) {
-                case ConvergenceTypes::MiddleSite:
-                    midx = sweep_targets.size() / 2;
-                    break;
-                case ConvergenceTypes::LastMinimal:
-                    midx =
-                        min_element(sweep_targets.begin(), sweep_targets.end(),
-                                    [](const vector<double> &x,
-                                       const vector<double> &y) {
-                                        return x.back() < y.back();
-                                    }) -
-                        sweep_targets.begin();
-                    break;
-                case ConvergenceTypes::LastMaximal:
-                    midx =
-                        min_element(sweep_targets.begin(), sweep_targets.end(),
-                                    [](const vector<double> &x,
-                                       const vector<double> &y) {
-                                        return x.back() > y.back();
-                                    }) -
-                        sweep_targets.begin();
-                    break;
-                case ConvergenceTypes::FirstMinimal:
-                    midx =
-                        min_element(sweep_targets.begin(), sweep_targets.end(),
-                                    [](const vector<double> &x,
-                                       const vector<double> &y) {
-                                        return x[0] < y[0];
-                                    }) -
-                        sweep_targets.begin();
-                    break;
-                case ConvergenceTypes::FirstMaximal:
-                    midx =
-                        min_element(sweep_targets.begin(), sweep_targets.end(),
-                                    [](const vector<double> &x,
-                                       const vector<double> &y) {
-                                        return x[0] > y[0];
-                                    }) -
-                        sweep_targets.begin();
-                    break;
-                default:
-                    assert(false);
-                }
+                size_t midx = optimal_target_index();
                 if (midx == sweep_targets.size() - 1) {
                     if (rme->para_rule == nullptr ||
                         rme->para_rule->is_root()) {
@@ -3340,46 +4603,11 @@ template <typename S> struct Linear {
                 }
             }
         }
-        size_t idx = -1;
-        switch (conv_type) {
-        case ConvergenceTypes::MiddleSite:
-            idx = sweep_targets.size() / 2;
-            break;
-        case ConvergenceTypes::LastMinimal:
-            idx = min_element(
-                      sweep_targets.begin(), sweep_targets.end(),
-                      [](const vector<double> &x, const vector<double> &y) {
-                          return x.back() < y.back();
-                      }) -
-                  sweep_targets.begin();
-            break;
-        case ConvergenceTypes::LastMaximal:
-            idx = min_element(
-                      sweep_targets.begin(), sweep_targets.end(),
-                      [](const vector<double> &x, const vector<double> &y) {
-                          return x.back() > y.back();
-                      }) -
-                  sweep_targets.begin();
-            break;
-        case ConvergenceTypes::FirstMinimal:
-            idx = min_element(
-                      sweep_targets.begin(), sweep_targets.end(),
-                      [](const vector<double> &x, const vector<double> &y) {
-                          return x[0] < y[0];
-                      }) -
-                  sweep_targets.begin();
-            break;
-        case ConvergenceTypes::FirstMaximal:
-            idx = min_element(
-                      sweep_targets.begin(), sweep_targets.end(),
-                      [](const vector<double> &x, const vector<double> &y) {
-                          return x[0] > y[0];
-                      }) -
-                  sweep_targets.begin();
-            break;
-        default:
-            assert(false);
-        }
+        if (frame->mem_tags != nullptr)
+            frame->mem_tags->site = -1;
+        if (timing != nullptr)
+            timing->end(), timing->save();
+        size_t idx = optimal_target_index();
         if (frame->restart_dir != "" &&
             (rme->para_rule == nullptr || rme->para_rule->is_root())) {
             if (!Parsing::path_exists(frame->restart_dir))
@@ -3400,6 +4628,197 @@ template <typename S> struct Linear {
                                      sweep_discarded_weights.end());
         return make_tuple(sweep_targets[idx], max_dw);
     }
+    // one sweep over a range of sites in multi-center bra and ket
+    void partial_sweep(int ip, bool forward, bool connect,
+                       ubond_t bra_bond_dim, ubond_t ket_bond_dim,
+                       double noise, double minres_conv_thrd) {
+        const shared_ptr<MovingEnvironment<S>> &me = rme;
+        assert(me->ket->get_type() == MPSTypes::MultiCenter);
+        shared_ptr<ParallelMPS<S>> para_mps =
+            dynamic_pointer_cast<ParallelMPS<S>>(me->ket);
+        int a = ip == 0 ? 0 : para_mps->conn_centers[ip - 1];
+        int b =
+            ip == para_mps->ncenter ? me->n_sites : para_mps->conn_centers[ip];
+        if (connect) {
+            a = para_mps->conn_centers[ip] - 1;
+            b = a + me->dot;
+        } else
+            forward ^= ip & 1;
+        if (para_mps->canonical_form[a] == 'C' ||
+            para_mps->canonical_form[a] == 'K')
+            me->center = a;
+        else if (para_mps->canonical_form[b - 1] == 'C' ||
+                 para_mps->canonical_form[b - 1] == 'S')
+            me->center = b - me->dot;
+        else if (para_mps->canonical_form[b - 2] == 'C' ||
+                 para_mps->canonical_form[b - 2] == 'K')
+            me->center = b - me->dot;
+        else
+            assert(false);
+        me->partial_prepare(a, b);
+        vector<int> sweep_range;
+        if (forward)
+            for (int it = me->center; it < b - me->dot + 1; it++)
+                sweep_range.push_back(it);
+        else
+            for (int it = me->center; it >= a; it--)
+                sweep_range.push_back(it);
+        Timer t;
+        for (auto i : sweep_range) {
+            stringstream sout;
+            check_signal_()();
+            sout << " " << (connect ? "CON" : "PAR") << setw(4) << ip;
+            sout << " " << (forward ? "-->" : "<--");
+            if (me->dot == 2)
+                sout << " Site = " << setw(4) << i << "-" << setw(4) << i + 1
+                     << " .. ";
+            else
+                sout << " Site = " << setw(4) << i << " .. ";
+            t.get_time();
+            Iteration r = blocking(i, forward, bra_bond_dim, ket_bond_dim,
+                                   noise, minres_conv_thrd);
+            sweep_cumulative_nflop += r.nflop;
+            sout << r << " T = " << setw(4) << fixed << setprecision(2)
+                 << t.get_time() << endl;
+            if (iprint >= 2)
+                cout << sout.rdbuf();
+            sweep_targets[i] = r.targets;
+            sweep_discarded_weights[i] = r.error;
+        }
+        if (me->dot == 2 && !connect) {
+            if (forward)
+                me->left_contract_rotate_unordered(me->center + 1);
+            else
+                me->right_contract_rotate_unordered(me->center - 1);
+        }
+    }
+    // update one connection site in multi-center bra and ket
+    void connection_sweep(int ip, ubond_t bra_bond_dim, ubond_t ket_bond_dim,
+                          double noise, double minres_conv_thrd) {
+        const shared_ptr<MovingEnvironment<S>> &me = rme;
+        vector<shared_ptr<ParallelMPS<S>>> para_mpss = me->get_para_mpss();
+        shared_ptr<ParallelMPS<S>> para_mps = para_mpss[0];
+        shared_ptr<CG<S>> cg = me->mpo->tf->opf->cg;
+        me->center = para_mps->conn_centers[ip] - 1;
+        for (auto &xmps : para_mpss)
+            if (xmps->canonical_form[me->center] == 'C' &&
+                xmps->canonical_form[me->center + 1] == 'C')
+                xmps->canonical_form[me->center] = 'K',
+                xmps->canonical_form[me->center + 1] = 'S';
+            else if (xmps->canonical_form[me->center] == 'S' &&
+                     xmps->canonical_form[me->center + 1] == 'K') {
+                xmps->flip_fused_form(me->center, cg, me->para_rule);
+                xmps->flip_fused_form(me->center + 1, cg, me->para_rule);
+            }
+        if (para_mps->canonical_form[me->center] == 'K' &&
+            para_mps->canonical_form[me->center + 1] == 'S') {
+            for (auto &xmps : para_mpss)
+                xmps->para_merge(ip, me->para_rule);
+            partial_sweep(ip, true, true, bra_bond_dim, ket_bond_dim, noise,
+                          minres_conv_thrd); // LK
+            me->left_contract_rotate_unordered(me->center + 1);
+            for (auto &xmps : para_mpss) {
+                xmps->canonical_form[me->center + 1] = 'K';
+                xmps->flip_fused_form(me->center + 1, cg,
+                                      me->para_rule); // LS
+                xmps->center = me->center + 1;
+            }
+            vector<shared_ptr<SparseMatrix<S>>> rmats;
+            for (auto &xmps : para_mpss)
+                rmats.push_back(xmps->para_split(ip, me->para_rule)); // KR
+            me->right_contract_rotate_unordered(me->center - 1);
+            // if root proc saves tensor too early,
+            // right_contract_rotate in other proc will have problems
+            if (me->para_rule != nullptr)
+                me->para_rule->comm->barrier();
+            if (me->para_rule == nullptr || me->para_rule->is_root())
+                for (size_t k = 0; k < para_mpss.size(); k++) {
+                    para_mpss[k]->tensors[me->center + 1] = rmats[k];
+                    para_mpss[k]->save_tensor(me->center + 1); // KS
+                }
+            if (me->para_rule != nullptr)
+                me->para_rule->comm->barrier();
+            for (auto &xmps : para_mpss) {
+                xmps->flip_fused_form(me->center, cg, me->para_rule);
+                xmps->flip_fused_form(me->center + 1, cg,
+                                      me->para_rule); // SK
+            }
+        }
+    }
+    // one unordered sweep fitting bra to mpo |ket>, with bra and ket
+    // multi-center MPS having the same connection centers;
+    // partitions in different groups of ParallelMPS::rule are fitted
+    // concurrently and the connection sites are updated afterwards
+    tuple<vector<double>, double>
+    unordered_sweep(bool forward, ubond_t bra_bond_dim, ubond_t ket_bond_dim,
+                    double noise, double minres_conv_thrd) {
+        if (lme != nullptr || tme != nullptr || ext_tmes.size() != 0)
+            throw runtime_error("Linear: unordered sweep is only implemented "
+                                "for compression without lme and tme!");
+        vector<shared_ptr<ParallelMPS<S>>> para_mpss = rme->get_para_mpss();
+        shared_ptr<ParallelMPS<S>> para_mps = para_mpss[0];
+        if (para_mpss.size() != 2)
+            throw runtime_error(
+                "Linear: unordered sweep requires multi-center bra and ket!");
+        teff = tmult = tprt = tblk = tmve = tdm = tsplt = tsvd = 0;
+        frame->twrite = frame->tread = frame->tasync = 0;
+        frame->fpwrite = frame->fpread = 0;
+        kernel_counters_().reset();
+        if (frame->fp_codec != nullptr)
+            frame->fp_codec->ndata = frame->fp_codec->ncpsd = 0;
+        sweep_targets.clear();
+        sweep_discarded_weights.clear();
+        sweep_cumulative_nflop = 0;
+        sweep_max_pket_size = 0;
+        sweep_max_eff_ham_size = 0;
+        frame->reset_peak_used_memory();
+        sweep_targets.resize(rme->n_sites - rme->dot + 1);
+        sweep_discarded_weights.resize(rme->n_sites - rme->dot + 1, 0);
+        para_mps->enable_parallel_writing();
+        for (auto &xmps : para_mpss)
+            xmps->set_ref_canonical_form();
+        for (int ip = 0; ip < para_mps->ncenter; ip++)
+            if (para_mps->rule == nullptr ||
+                ip % para_mps->rule->comm->ngroup ==
+                    para_mps->rule->comm->group)
+                connection_sweep(ip, bra_bond_dim, ket_bond_dim, noise,
+                                 minres_conv_thrd);
+        for (auto &xmps : para_mpss)
+            xmps->sync_canonical_form();
+        for (int ip = 0; ip <= para_mps->ncenter; ip++)
+            if (para_mps->rule == nullptr ||
+                ip % para_mps->rule->comm->ngroup ==
+                    para_mps->rule->comm->group)
+                partial_sweep(ip, forward, false, bra_bond_dim, ket_bond_dim,
+                              noise, minres_conv_thrd);
+        for (auto &xmps : para_mpss)
+            xmps->sync_canonical_form();
+        for (int ip = 0; ip < para_mps->ncenter; ip++)
+            if (para_mps->rule == nullptr ||
+                ip % para_mps->rule->comm->ngroup ==
+                    para_mps->rule->comm->group)
+                connection_sweep(ip, bra_bond_dim, ket_bond_dim, noise,
+                                 minres_conv_thrd);
+        for (auto &xmps : para_mpss)
+            xmps->sync_canonical_form();
+        if (para_mps->rule != nullptr) {
+            // sites of other groups are filled by the reduction
+            double ntg = 0;
+            for (auto &x : sweep_targets)
+                ntg = max(ntg, (double)x.size());
+            para_mps->rule->comm->allreduce_max(&ntg, 1);
+            for (auto &x : sweep_targets)
+                if (x.size() == 0)
+                    x.resize((size_t)ntg, numeric_limits<double>::max());
+            para_mps->rule->comm->allreduce_min(sweep_targets);
+            para_mps->rule->comm->allreduce_max(sweep_discarded_weights);
+        }
+        para_mps->disable_parallel_writing();
+        size_t idx = optimal_target_index();
+        double max_dw = *max_element(sweep_discarded_weights.begin(),
+                                     sweep_discarded_weights.end());
+        return make_tuple(sweep_targets[idx], max_dw);
+    }
     double solve(int n_sweeps, bool forward = true, double tol = 1E-6) {
         if (bra_bond_dims.size() < n_sweeps)
             bra_bond_dims.resize(n_sweeps, bra_bond_dims.back());
@@ -3434,8 +4853,12 @@ template <typename S> struct Linear {
                 cout << endl;
             }
             auto sweep_results =
-                sweep(forward, bra_bond_dims[iw], ket_bond_dims[iw], noises[iw],
-                      minres_conv_thrds[iw]);
+                rme->ket->get_type() == MPSTypes::MultiCenter
+                    ? unordered_sweep(forward, bra_bond_dims[iw],
+                                      ket_bond_dims[iw], noises[iw],
+                                      minres_conv_thrds[iw])
+                    : sweep(forward, bra_bond_dims[iw], ket_bond_dims[iw],
+                            noises[iw], minres_conv_thrds[iw]);
             targets.push_back(get<0>(sweep_results));
             discarded_weights.push_back(get<1>(sweep_results));
             if (targets.size() >= 2)
@@ -3527,6 +4950,8 @@ template <typename S> struct Linear {
                              << Parsing::to_size_string(frame->fp_codec->ncpsd *
                                                         8);
                     cout << " | Tasync = " << frame->tasync << endl;
+                    if (kernel_counters_().enabled)
+                        cout << kernel_counters_().summary();
                     if (lme != nullptr)
                         cout << " | Trot = " << lme->trot
                              << " | Tctr = " << lme->tctr
@@ -3612,11 +5037,31 @@ template <typename S, typename FL = double> struct Expect {
     double beta = 0.0;
     // partition function (for thermal-averaged MultiMPS)
     typename PartitionWeights<FL>::type partition_weights;
+    // for MultiMPS: also compute < bra[ib] | O | ket[ik] > for all pairs
+    // of roots in the same sweep, stored at [ib * nket + ik]
+    bool transition = false;
+    vector<vector<pair<shared_ptr<OpExpr<S>>, vector<FL>>>>
+        transition_expectations;
+    // if not nullptr, per-site phase times of each sweep are recorded
+    shared_ptr<TimingTree> timing = nullptr;
+    // if true (two-site, bra == ket, Hamiltonian MPO), a propagating sweep
+    // over all sites also gives the two-site energy variance
+    // || P2 (H - E) |psi> ||^2 (root process only), where P2 projects onto
+    // the two-site tangent space of the MPS. It is a lower bound of the
+    // energy variance, obtained with one extra matvec per site instead of
+    // the MPO of H^2. The bond dimensions should not truncate the MPS
+    bool compute_variance = false;
+    // two-site energy variance and energy of the last sweep
+    double two_site_variance = 0.0, variance_energy = 0.0;
+    // sum of the squared norms of the two-site minus one-site projections
+    // of H |psi> in the current sweep
+    double variance_sum = 0.0;
     Expect(const shared_ptr<MovingEnvironment<S>> &me, ubond_t bra_bond_dim,
            ubond_t ket_bond_dim)
         : me(me), bra_bond_dim(bra_bond_dim), ket_bond_dim(ket_bond_dim),
           forward(false) {
         expectations.resize(me->n_sites - me->dot + 1);
+        transition_expectations.resize(me->n_sites - me->dot + 1);
         partition_weights = PartitionWeights<FL>::get_partition_weights();
     }
     Expect(const shared_ptr<MovingEnvironment<S>> &me, ubond_t bra_bond_dim,
@@ -3845,6 +5290,17 @@ template <typename S, typename FL = double> struct Expect {
                         me->ket->tensors[i]);
         auto pdi =
             h_eff->expect(me->mpo->const_e, algo_type, ex_type, me->para_rule);
+        // H |psi> for the two-site variance
+        shared_ptr<SparseMatrix<S>> hket = nullptr;
+        if (compute_variance && propagate) {
+            assert(me->bra == me->ket);
+            hket = make_shared<SparseMatrix<S>>(
+                make_shared<VectorAllocator<double>>());
+            hket->allocate(me->ket->tensors[i]->info);
+            h_eff->bra = hket;
+            h_eff->multiply(me->mpo->const_e, me->para_rule);
+            h_eff->bra = me->bra->tensors[i];
+        }
         h_eff->deallocate();
         vector<shared_ptr<SparseMatrix<S>>> old_wfns =
             me->bra == me->ket
@@ -3869,6 +5325,10 @@ template <typename S, typename FL = double> struct Expect {
                         bra_error = error;
                     else
                         ket_error = error;
+                    if (hket != nullptr)
+                        accumulate_variance(i, forward, old_wfn, hket,
+                                            mps->tensors[i],
+                                            mps->tensors[i + 1]);
                     shared_ptr<StateInfo<S>> info = nullptr;
                     if (forward) {
                         info =
@@ -3914,6 +5374,8 @@ template <typename S, typename FL = double> struct Expect {
                 }
             }
         }
+        if (hket != nullptr)
+            hket->deallocate();
         for (auto &old_wfn : old_wfns) {
             old_wfn->info->deallocate();
             old_wfn->deallocate();
@@ -3928,6 +5390,84 @@ template <typename S, typename FL = double> struct Expect {
         return Iteration(expectations, bra_error, ket_error, get<1>(pdi),
                          get<2>(pdi));
     }
+    // Squared norm of the two-site wavefunction with the left site
+    // (trace_right) or the right site projected onto the renormalized
+    // basis of the rotation matrix
+    static double projected_norm_squared(const shared_ptr<SparseMatrix<S>> &wfn,
+                                         const shared_ptr<SparseMatrix<S>> &rot,
+                                         bool trace_right) {
+        double r = 0.0;
+        for (int iw = 0; iw < wfn->info->n; iw++) {
+            const S q =
+                trace_right
+                    ? wfn->info->quanta[iw].get_bra(wfn->info->delta_quantum)
+                    : -wfn->info->quanta[iw].get_ket();
+            const int ir = rot->info->find_state(q);
+            if (ir == -1)
+                continue;
+            MatrixRef mwfn = (*wfn)[iw], mrot = (*rot)[ir];
+            MatrixRef tmp(nullptr, trace_right ? mrot.n : mwfn.m,
+                          trace_right ? mwfn.n : mrot.m);
+            tmp.allocate();
+            if (trace_right)
+                MatrixFunctions::multiply(mrot, true, mwfn, false, tmp, 1.0,
+                                          0.0);
+            else
+                MatrixFunctions::multiply(mwfn, false, mrot, true, tmp, 1.0,
+                                          0.0);
+            const double norm = MatrixFunctions::norm(tmp);
+            r += norm * norm;
+            tmp.deallocate();
+        }
+        return r;
+    }
+    // The projector onto the two-site tangent space is the sum of
+    // projectors of all two-site windows minus those of the one-site
+    // windows shared by neighboring two-site windows
+    // left and right are the split tensors of wfn
+    void accumulate_variance(int i, bool forward,
+                             const shared_ptr<SparseMatrix<S>> &wfn,
+                             const shared_ptr<SparseMatrix<S>> &hwfn,
+                             const shared_ptr<SparseMatrix<S>> &left,
+                             const shared_ptr<SparseMatrix<S>> &right) {
+        MatrixRef mwfn(wfn->data, (MKL_INT)wfn->total_memory, 1);
+        MatrixRef mhwfn(hwfn->data, (MKL_INT)hwfn->total_memory, 1);
+        const double norm = MatrixFunctions::norm(mwfn);
+        const double hnorm = MatrixFunctions::norm(mhwfn);
+        const double n2 = norm * norm;
+        variance_energy = MatrixFunctions::dot(mwfn, mhwfn) / n2;
+        variance_sum += hnorm * hnorm / n2;
+        if (forward && i + 2 < me->n_sites)
+            variance_sum -= projected_norm_squared(hwfn, left, true) / n2;
+        else if (!forward && i > 0)
+            variance_sum -= projected_norm_squared(hwfn, right, false) / n2;
+    }
+    // thermal average of the expectations of all roots of a MultiMPS
+    // with transition, < bra[ib] | O | ket[ik] > are also stored at site i
+    vector<pair<shared_ptr<OpExpr<S>>, FL>> multi_expectations(
+        int i,
+        const vector<pair<shared_ptr<OpExpr<S>>, vector<double>>> &pdi) {
+        vector<pair<shared_ptr<OpExpr<S>>, FL>> expectations(pdi.size());
+        // stride of the diagonal elements
+        const size_t nd =
+            transition
+                ? dynamic_pointer_cast<MultiMPS<S>>(me->ket)->nroots + 1
+                : 1;
+        for (size_t k = 0; k < pdi.size(); k++) {
+            typename PartitionWeights<FL>::type::value_type x = 0.0;
+            for (size_t l = 0; l < partition_weights.size(); l++)
+                x += partition_weights[l] * pdi[k].second[l * nd];
+            expectations[k] = make_pair(pdi[k].first, (FL)x);
+        }
+        if (transition) {
+            transition_expectations[i].resize(pdi.size());
+            for (size_t k = 0; k < pdi.size(); k++)
+                transition_expectations[i][k] = make_pair(
+                    pdi[k].first,
+                    vector<FL>(pdi[k].second.begin(), pdi[k].second.end()));
+        }
+        return expectations;
+    }
     Iteration update_multi_one_dot(int i, bool forward, bool propagate,
                                    ubond_t bra_bond_dim, ubond_t ket_bond_dim) {
         shared_ptr<MultiMPS<S>> mket =
@@ -3976,8 +5516,8 @@ template <typename S, typename FL = double> struct Expect {
         shared_ptr<EffectiveHamiltonian<S, MultiMPS<S>>> h_eff =
             me->multi_eff_ham(fuse_left ? FuseTypes::FuseL : FuseTypes::FuseR,
                               forward, false);
-        auto pdi =
-            h_eff->expect(me->mpo->const_e, algo_type, ex_type, me->para_rule);
+        auto pdi = h_eff->expect(me->mpo->const_e, algo_type, ex_type,
+                                 me->para_rule, transition);
         h_eff->deallocate();
         double bra_error = 0.0, ket_error = 0.0;
         if (me->para_rule == nullptr || me->para_rule->is_root()) {
@@ -4138,14 +5678,8 @@ template <typename S, typename FL = double> struct Expect {
         }
         if (me->para_rule != nullptr)
             me->para_rule->comm->barrier();
-        vector<pair<shared_ptr<OpExpr<S>>, FL>> expectations(
-            get<0>(pdi).size());
-        for (size_t k = 0; k < get<0>(pdi).size(); k++) {
-            typename PartitionWeights<FL>::type::value_type x = 0.0;
-            for (size_t l = 0; l < partition_weights.size(); l++)
-                x += partition_weights[l] * get<0>(pdi)[k].second[l];
-            expectations[k] = make_pair(get<0>(pdi)[k].first, (FL)x);
-        }
+        vector<pair<shared_ptr<OpExpr<S>>, FL>> expectations =
+            multi_expectations(i, get<0>(pdi));
         return Iteration(expectations, bra_error, ket_error, get<1>(pdi),
                          get<2>(pdi));
     }
@@ -4171,8 +5705,8 @@ template <typename S, typename FL = double> struct Expect {
         }
         shared_ptr<EffectiveHamiltonian<S, MultiMPS<S>>> h_eff =
             me->multi_eff_ham(FuseTypes::FuseLR, forward, false);
-        auto pdi =
-            h_eff->expect(me->mpo->const_e, algo_type, ex_type, me->para_rule);
+        auto pdi = h_eff->expect(me->mpo->const_e, algo_type, ex_type,
+                                 me->para_rule, transition);
         h_eff->deallocate();
         vector<vector<shared_ptr<SparseMatrixGroup<S>>>> old_wfnss =
             me->bra == me->ket
@@ -4263,14 +5797,8 @@ template <typename S, typename FL = double> struct Expect {
         }
         if (me->para_rule != nullptr)
             me->para_rule->comm->barrier();
-        vector<pair<shared_ptr<OpExpr<S>>, FL>> expectations(
-            get<0>(pdi).size());
-        for (size_t k = 0; k < get<0>(pdi).size(); k++) {
-            typename PartitionWeights<FL>::type::value_type x = 0.0;
-            for (size_t l = 0; l < partition_weights.size(); l++)
-                x += partition_weights[l] * get<0>(pdi)[k].second[l];
-            expectations[k] = make_pair(get<0>(pdi)[k].first, (FL)x);
-        }
+        vector<pair<shared_ptr<OpExpr<S>>, FL>> expectations =
+            multi_expectations(i, get<0>(pdi));
         return Iteration(expectations, bra_error, ket_error, get<1>(pdi),
                          get<2>(pdi));
     }
@@ -4308,6 +5836,15 @@ template <typename S, typename FL = double> struct Expect {
         else
             for (int it = me->center; it >= 0; it--)
                 sweep_range.push_back(it);
+        if (timing != nullptr)
+            timing->clear(), timing->begin("sweep");
+        if (compute_variance) {
+            if (me->dot != 2 ||
+                (int)sweep_range.size() != me->n_sites - me->dot + 1)
+                throw runtime_error("Expect: two-site variance needs a "
+                                    "two-site sweep over all sites.");
+            variance_sum = 0.0;
+        }
 
         Timer t;
         for (auto i : sweep_range) {
@@ -4323,19 +5860,44 @@ template <typename S, typename FL = double> struct Expect {
                 cout.flush();
             }
             t.get_time();
+            vector<pair<string, double>> tcs;
+            if (timing != nullptr) {
+                timing->begin("site " + Parsing::to_string(i));
+                tcs = sweep_timing_counters<S>(me->para_rule);
+                timing->begin("move_env");
+                me->move_to(i);
+                timing->end();
+                timing->begin("update");
+            }
             Iteration r =
                 blocking(i, forward, true, bra_bond_dim, ket_bond_dim);
+            if (timing != nullptr) {
+                timing->end();
+                timing->add(tcs, sweep_timing_counters<S>(me->para_rule));
+                timing->end();
+            }
             if (iprint >= 2)
                 cout << r << " T = " << setw(4) << fixed << setprecision(2)
                      << t.get_time() << endl;
             expectations[i] = r.expectations;
         }
+        if (compute_variance) {
+            two_site_variance =
+                variance_sum - variance_energy * variance_energy;
+            if (iprint >= 1)
+                cout << "Two-site variance = " << scientific << setw(15)
+                     << setprecision(8) << two_site_variance << fixed << endl;
+        }
+        if (timing != nullptr)
+            timing->end(), timing->save();
     }
     FL solve(bool propagate, bool forward = true) {
         Timer start, current;
         start.get_time();
         for (auto &x : expectations)
             x.clear();
+        for (auto &x : transition_expectations)
+            x.clear();
         if (propagate) {
             if (iprint >= 1) {
                 cout << "Expectation | Direction = " << setw(8)
@@ -4385,6 +5947,26 @@ template <typename S, typename FL = double> struct Expect {
             n_physical_sites = me->n_sites;
         return PDM2MPOQC<S>::get_matrix(expectations, n_physical_sites);
     }
+    // packed symmetry-unique 2pdm, see PDM2MPOQC::get_matrix_packed
+    shared_ptr<GTensor<FL>> get_2pdm_packed(uint16_t n_physical_sites = 0U) {
+        if (n_physical_sites == 0U)
+            n_physical_sites = me->n_sites;
+        return PDM2MPOQC<S>::get_matrix_packed(expectations, n_physical_sites);
+    }
+    // 1pdm from the 2pdm expectations of the last sweep (partial trace),
+    // so that no separate PDM1MPOQC sweep is needed when both are required
+    GMatrix<FL> get_1pdm_spatial_from_2pdm(uint16_t n_physical_sites = 0U) {
+        if (n_physical_sites == 0U)
+            n_physical_sites = me->n_sites;
+        return PDM2MPOQC<S>::get_matrix_pdm1_spatial(
+            expectations, n_physical_sites, me->ket->info->target.n());
+    }
+    GMatrix<FL> get_1pdm_from_2pdm(uint16_t n_physical_sites = 0U) {
+        if (n_physical_sites == 0U)
+            n_physical_sites = me->n_sites;
+        return PDM2MPOQC<S>::get_matrix_pdm1(expectations, n_physical_sites,
+                                             me->ket->info->target.n());
+    }
     // number of particle correlation
     // s == 0: pure spin; s == 1: mixed spin
     GMatrix<FL> get_1npc_spatial(uint8_t s, uint16_t n_physical_sites = 0U) {
@@ -4400,6 +5982,199 @@ template <typename S, typename FL = double> struct Expect {
             n_physical_sites = me->n_sites;
         return NPC1MPOQC<S>::get_matrix(s, expectations, n_physical_sites);
     }
+    // < bra[ib] | O | ket[ik] > from the last sweep with transition
+    vector<vector<pair<shared_ptr<OpExpr<S>>, FL>>>
+    get_transition_expectations(int ib, int ik) const {
+        if (!transition)
+            throw runtime_error("Expect: transition expectations not computed.");
+        const int nk = dynamic_pointer_cast<MultiMPS<S>>(me->ket)->nroots;
+        vector<vector<pair<shared_ptr<OpExpr<S>>, FL>>> r(
+            transition_expectations.size());
+        for (size_t i = 0; i < transition_expectations.size(); i++)
+            for (auto &x : transition_expectations[i])
+                r[i].push_back(make_pair(x.first, x.second[ib * nk + ik]));
+        return r;
+    }
+    // transition density matrices between roots ib (bra) and ik (ket)
+    GMatrix<FL> get_transition_1pdm_spatial(int ib, int ik,
+                                            uint16_t n_physical_sites = 0U) {
+        if (n_physical_sites == 0U)
+            n_physical_sites = me->n_sites;
+        return PDM1MPOQC<S>::get_matrix_spatial(
+            get_transition_expectations(ib, ik), n_physical_sites);
+    }
+    GMatrix<FL> get_transition_1pdm(int ib, int ik,
+                                    uint16_t n_physical_sites = 0U) {
+        if (n_physical_sites == 0U)
+            n_physical_sites = me->n_sites;
+        return PDM1MPOQC<S>::get_matrix(get_transition_expectations(ib, ik),
+                                        n_physical_sites);
+    }
+    shared_ptr<GTensor<FL>>
+    get_transition_2pdm_spatial(int ib, int ik,
+                                uint16_t n_physical_sites = 0U) {
+        if (n_physical_sites == 0U)
+            n_physical_sites = me->n_sites;
+        return PDM2MPOQC<S>::get_transition_matrix_spatial(
+            get_transition_expectations(ib, ik), n_physical_sites);
+    }
+};
+
+// Kernel polynomial (Chebyshev) expansion of the spectral function
+// A(omega) = <psi|delta(omega - H)|psi> for all frequencies at once
+// Moments mu[n] = <psi|T_n(H')|psi> with H' = (H - center) / width are
+// obtained from the Chebyshev recursion of compressed MPSs
+// |t_{n+1}> = 2 H' |t_n> - |t_{n-1}>, |t_1> = H' |t_0>, |t_0> = |psi>
+// using mu[2n] = 2 <t_n|t_n> - mu[0] and mu[2n+1] = 2 <t_{n+1}|t_n> - mu[1]
+// The spectrum of H must be within [center - width, center + width]
+template <typename S> struct ChebyshevSpectral {
+    // mpo = H; impo = identity
+    shared_ptr<MPO<S>> mpo, impo;
+    // |t_0>
+    shared_ptr<MPS<S>> mps;
+    double center, width;
+    vector<ubond_t> bond_dims;
+    vector<double> noises;
+    // moments of the expansion
+    vector<double> moments;
+    // number of sweeps and convergence threshold for each compression
+    int n_sweeps = 4;
+    double tol = 1E-8;
+    NoiseTypes noise_type = NoiseTypes::DensityMatrix;
+    DecompositionTypes decomp_type = DecompositionTypes::DensityMatrix;
+    TruncationTypes trunc_type = TruncationTypes::Physical;
+    double cutoff = 1E-14;
+    uint8_t iprint = 2;
+    // MPS tags are tag + "-0", tag + "-1" and tag + "-2"
+    string tag = "CHEB";
+    ChebyshevSpectral(const shared_ptr<MPO<S>> &mpo,
+                      const shared_ptr<MPO<S>> &impo,
+                      const shared_ptr<MPS<S>> &mps, double center,
+                      double width, const vector<ubond_t> &bond_dims,
+                      const vector<double> &noises = vector<double>())
+        : mpo(mpo), impo(impo), mps(mps), center(center), width(width),
+          bond_dims(bond_dims), noises(noises) {}
+    virtual ~ChebyshevSpectral() = default;
+    // <bra|ket> (at the current center)
+    double overlap(const shared_ptr<MPS<S>> &bra,
+                   const shared_ptr<MPS<S>> &ket) const {
+        shared_ptr<MovingEnvironment<S>> me =
+            make_shared<MovingEnvironment<S>>(impo, bra, ket, tag + "-OVLP");
+        me->init_environments(false);
+        shared_ptr<Expect<S>> ex = make_shared<Expect<S>>(
+            me, bra->info->bond_dim, ket->info->bond_dim);
+        ex->iprint = 0;
+        return ex->solve(false, ket->center == 0);
+    }
+    // |bra> = rmpo |ket> + |tket> (|tket> is optional)
+    // the initial guess for |bra> is a copy of |ket>
+    shared_ptr<MPS<S>> fit(const shared_ptr<MPO<S>> &rmpo,
+                           const shared_ptr<MPS<S>> &ket,
+                           const shared_ptr<MPS<S>> &tket, int islot) const {
+        shared_ptr<MPS<S>> bra = ket->deep_copy(tag + "-" + to_string(islot));
+        shared_ptr<MovingEnvironment<S>> rme =
+            make_shared<MovingEnvironment<S>>(rmpo, bra, ket, tag + "-RHS");
+        rme->init_environments(iprint >= 2);
+        shared_ptr<MovingEnvironment<S>> tme = nullptr;
+        if (tket != nullptr) {
+            tme = make_shared<MovingEnvironment<S>>(impo, bra, tket,
+                                                    tag + "-TGT");
+            tme->init_environments(iprint >= 2);
+        }
+        shared_ptr<Linear<S>> linear = make_shared<Linear<S>>(
+            nullptr, rme, tme, bond_dims, bond_dims, noises);
+        linear->eq_type = tket != nullptr
+                              ? EquationTypes::FitAddition
+                              : EquationTypes::PerturbativeCompression;
+        linear->noise_type = noise_type;
+        linear->decomp_type = decomp_type;
+        linear->trunc_type = trunc_type;
+        // |tket> is swept together with |bra>; keep its bond dimension
+        if (tket != nullptr)
+            linear->target_ket_bond_dim = (int)tket->info->bond_dim;
+        linear->cutoff = cutoff;
+        linear->iprint = iprint >= 2 ? iprint - 1 : 0;
+        linear->solve(n_sweeps, ket->center == 0, tol);
+        return bra;
+    }
+    // Compute n_moments moments
+    // Only |t_n> up to n = n_moments / 2 are formed
+    vector<double> solve(int n_moments) {
+        Timer start;
+        start.get_time();
+        moments.assign(max(n_moments, 0), 0.0);
+        if (n_moments == 0)
+            return moments;
+        // |u_n> = c_n |t_n> with c_{n+1} = -c_{n-1} and c_0 = c_1 = 1,
+        // so that |u_{n+1}> = c_{n+1} c_n 2 H' |u_n> + |u_{n-1}>
+        // which only needs H' scaled by +/- 2 and no scaled identity
+        shared_ptr<MPO<S>> hmpo = (1.0 / width) * mpo;
+        hmpo->const_e = (mpo->const_e - center) / width;
+        shared_ptr<MPO<S>> pmpo = (2.0 / width) * mpo;
+        pmpo->const_e = 2.0 * (mpo->const_e - center) / width;
+        shared_ptr<MPO<S>> mmpo = (-2.0 / width) * mpo;
+        mmpo->const_e = -2.0 * (mpo->const_e - center) / width;
+        shared_ptr<MPS<S>> uprev = nullptr, ucur = mps;
+        int cprev = 0, ccur = 1;
+        moments[0] = overlap(mps, mps);
+        for (int n = 0; 2 * n + 1 < n_moments; n++) {
+            if (n != 0 && 2 * n < n_moments)
+                moments[2 * n] = 2 * overlap(ucur, ucur) - moments[0];
+            // |u_{n+1}>
+            shared_ptr<MPS<S>> unext;
+            int cnext = n == 0 ? 1 : -cprev;
+            if (n == 0)
+                unext = fit(hmpo, ucur, nullptr, (n + 1) % 3);
+            else
+                unext = fit(cnext * ccur == 1 ? pmpo : mmpo, ucur, uprev,
+                            (n + 1) % 3);
+            double ovlp = cnext * ccur * overlap(unext, ucur);
+            moments[2 * n + 1] = n == 0 ? ovlp : 2 * ovlp - moments[1];
+            uprev = ucur, ucur = unext;
+            cprev = ccur, ccur = cnext;
+            if (iprint >= 1)
+                cout << "Chebyshev | n = " << setw(5) << n + 1
+                     << " | Moments = " << setw(5) << min(2 * n + 2, n_moments)
+                     << " | Last = " << scientific << setw(15)
+                     << setprecision(8) << moments[2 * n + 1]
+                     << " | Tmoment = " << fixed << setw(10)
+                     << setprecision(3) << start.get_time() << endl;
+        }
+        // the last even moment
+        if (n_moments % 2 == 1 && n_moments != 1)
+            moments[n_moments - 1] = 2 * overlap(ucur, ucur) - moments[0];
+        return moments;
+    }
+    // Jackson kernel damping factors for n moments
+    static vector<double> jackson_kernel(int n) {
+        vector<double> g(n);
+        const double q = M_PI / (n + 1);
+        for (int k = 0; k < n; k++)
+            g[k] = ((n - k + 1) * cos(q * k) + sin(q * k) / tan(q)) / (n + 1);
+        return g;
+    }
+    // A(omega) from the moments, with Jackson damping if jackson is true
+    vector<double> spectral_function(const vector<double> &omegas,
+                                     bool jackson = true) const {
+        const int n = (int)moments.size();
+        vector<double> g =
+            jackson ? jackson_kernel(n) : vector<double>(n, 1.0);
+        vector<double> r(omegas.size(), 0.0);
+        for (size_t iw = 0; iw < omegas.size(); iw++) {
+            const double x = (omegas[iw] - center) / width;
+            if (n == 0 || abs(x) >= 1)
+                continue;
+            // T_{k+1}(x) = 2 x T_k(x) - T_{k-1}(x)
+            double tp = 1, tc = x, f = g[0] * moments[0];
+            for (int k = 1; k < n; k++) {
+                f += 2 * g[k] * moments[k] * tc;
+                double tn = 2 * x * tc - tp;
+                tp = tc, tc = tn;
+            }
+            r[iw] = f / (M_PI * width * sqrt(1 - x * x));
+        }
+        return r;
+    }
 };
 
 } // namespace block2
@@ -24,11 +24,14 @@
 #include "../core/matrix.hpp"
 #include "../core/sparse_matrix.hpp"
 #include "moving_environment.hpp"
+#include "sweep_algorithm.hpp"
 #include <cassert>
 #include <cstdint>
 #include <cstring>
+#include <fstream>
 #include <iomanip>
 #include <iostream>
+#include <limits>
 #include <memory>
 #include <string>
 #include <tuple>
@@ -77,7 +80,24 @@ template <typename S> struct TDDMRG {
     double cutoff = 1E-14;
     bool decomp_last_site = true;
     bool hermitian = true; //!< Whether the Hamiltonian is Hermitian (symmetric)
+    // number of Krylov vectors generated per orthogonalization round in the
+    // exponential Krylov solver (1 for the one-vector-per-step process)
+    int krylov_s_step = 1;
+    // adaptive time step: after each time step, beta is rescaled by the
+    // smallest step factor suggested by the local error estimates of the
+    // sweep (Krylov estimate for the exponential, embedded midpoint rule for
+    // RK4), clamped to [step_factor_min, step_factor_max] and
+    // [step_min, step_max] (no bound if zero)
+    bool adaptive_step = false;
+    double step_tol = 1E-6; //!< Local error tolerance of RK4 steps
+    double step_factor_min = 0.2, step_factor_max = 5.0;
+    double step_min = 0.0, step_max = 0.0;
+    double sweep_step_factor = 1.0; //!< Step factor of the last sweep
+    vector<double> betas; //!< Time steps taken in the last solve
+    double next_beta = 0.0; //!< Time step suggested for the next solve
     size_t sweep_cumulative_nflop = 0;
+    // if not nullptr, per-site phase times of each sweep are recorded
+    shared_ptr<TimingTree> timing = nullptr;
     TDDMRG(const shared_ptr<MovingEnvironment<S>> &me,
            const vector<ubond_t> &bond_dims,
            const vector<double> &noises = vector<double>())
@@ -165,7 +185,8 @@ template <typename S> struct TDDMRG {
             pdi = lvmt.second;
         } else
             pdi = l_eff->expo_apply(-beta, me->mpo->const_e, hermitian,
-                                    iprint >= 3, me->para_rule);
+                                    iprint >= 3, me->para_rule, krylov_s_step,
+                                    &sweep_step_factor);
         if ((noise_type & NoiseTypes::Perturbative) && noise != 0)
             pbra = l_eff->perturbative_noise(
                 forward, i, i, fuse_left ? FuseTypes::FuseL : FuseTypes::FuseR,
@@ -448,7 +469,8 @@ template <typename S> struct TDDMRG {
             pdi = lvmt.second;
         } else
             pdi = l_eff->expo_apply(-beta, me->mpo->const_e, hermitian,
-                                    iprint >= 3, me->para_rule);
+                                    iprint >= 3, me->para_rule, krylov_s_step,
+                                    &sweep_step_factor);
         if ((noise_type & NoiseTypes::Perturbative) && noise != 0)
             pbra = l_eff->perturbative_noise(forward, i, i + 1,
                                              FuseTypes::FuseLR, lme->bra->info,
@@ -608,6 +630,7 @@ template <typename S> struct TDDMRG {
         rme->prepare();
         vector<double> energies, normsqs;
         sweep_cumulative_nflop = 0;
+        sweep_step_factor = numeric_limits<double>::infinity();
         frame->reset_peak_used_memory();
         vector<int> sweep_range;
         double largest_error = 0.0;
@@ -617,6 +640,8 @@ template <typename S> struct TDDMRG {
         else
             for (int it = rme->center; it >= 0; it--)
                 sweep_range.push_back(it);
+        if (timing != nullptr)
+            timing->clear(), timing->begin("sweep");
         Timer t;
         for (auto i : sweep_range) {
             check_signal_()();
@@ -631,8 +656,23 @@ template <typename S> struct TDDMRG {
                 cout.flush();
             }
             t.get_time();
+            vector<pair<string, double>> tcs;
+            if (timing != nullptr) {
+                timing->begin("site " + Parsing::to_string(i));
+                tcs = sweep_timing_counters<S>(rme->para_rule);
+                timing->begin("move_env");
+                lme->move_to(i);
+                rme->move_to(i);
+                timing->end();
+                timing->begin("update");
+            }
             Iteration r = blocking(i, forward, advance, beta, bond_dim,
                                    advance ? 0 : noise);
+            if (timing != nullptr) {
+                timing->end();
+                timing->add(tcs, sweep_timing_counters<S>(rme->para_rule));
+                timing->end();
+            }
             sweep_cumulative_nflop += r.nflop;
             if (iprint >= 2)
                 cout << r << " T = " << setw(4) << fixed << setprecision(2)
@@ -641,6 +681,8 @@ template <typename S> struct TDDMRG {
             normsqs.push_back(r.normsq);
             largest_error = max(largest_error, r.error);
         }
+        if (timing != nullptr)
+            timing->end(), timing->save();
         return make_tuple(energies.back(), normsqs.back(), largest_error);
     }
     void normalize() {
@@ -687,8 +729,10 @@ template <typename S> struct TDDMRG {
         energies.clear();
         normsqs.clear();
         discarded_weights.clear();
+        betas.clear();
         for (int iw = 0; iw < n_sweeps; iw++) {
             init_moving_environments();
+            double step_factor = numeric_limits<double>::infinity();
             for (int isw = 0; isw < n_sub_sweeps; isw++) {
                 if (iprint >= 1) {
                     cout << "Sweep = " << setw(4) << iw;
@@ -707,6 +751,7 @@ template <typename S> struct TDDMRG {
                 }
                 auto sweep_results = sweep(forward, isw == n_sub_sweeps - 1,
                                            beta, bond_dims[iw], noises[iw]);
+                step_factor = min(step_factor, sweep_step_factor);
                 forward = !forward;
                 double tswp = current.get_time();
                 if (iprint >= 1) {
@@ -750,10 +795,32 @@ template <typename S> struct TDDMRG {
             }
             me = lme;
             normalize();
+            betas.push_back(beta);
+            if (adaptive_step)
+                beta = adapt_step(beta, step_factor);
         }
+        next_beta = beta;
         this->forward = forward;
         return energies.back();
     }
+    // rescale the time step by the step factor from the error estimates
+    double adapt_step(double beta, double step_factor) const {
+        if (me->para_rule != nullptr)
+            me->para_rule->comm->broadcast(&step_factor, 1,
+                                           me->para_rule->comm->root);
+        double x = abs(beta) *
+                   min(max(step_factor, step_factor_min), step_factor_max);
+        if (step_max != 0)
+            x = min(x, step_max);
+        x = max(x, step_min);
+        if (iprint >= 1)
+            cout << "Step factor = " << scientific << setw(9)
+                 << setprecision(2) << step_factor << " | Next "
+                 << ((mode & TETypes::ImagTE) ? "Beta" : "Tau") << " = "
+                 << fixed << setw(10) << setprecision(5)
+                 << (beta < 0 ? -x : x) << endl;
+        return beta < 0 ? -x : x;
+    }
 };
 
 // Imaginary/Real Time Evolution
@@ -776,6 +843,33 @@ template <typename S> struct TimeEvolution {
     double cutoff = 1E-14;
     bool normalize_mps = true;
     bool hermitian = true; //!< Whether the Hamiltonian is Hermitian (symmetric)
+    // number of Krylov vectors generated per orthogonalization round in the
+    // exponential Krylov solver (1 for the one-vector-per-step process)
+    int krylov_s_step = 1;
+    // adaptive time step: after each time step, beta is rescaled by the
+    // smallest step factor suggested by the local error estimates of the
+    // sweep (Krylov estimate for TangentSpace, embedded midpoint rule for
+    // RK4), clamped to [step_factor_min, step_factor_max] and
+    // [step_min, step_max] (no bound if zero)
+    bool adaptive_step = false;
+    double step_tol = 1E-6; //!< Local error tolerance of RK4 steps
+    double step_factor_min = 0.2, step_factor_max = 5.0;
+    double step_min = 0.0, step_max = 0.0;
+    double sweep_step_factor = 1.0; //!< Step factor of the last sweep
+    vector<complex<double>> betas; //!< Time steps taken in the last solve
+    complex<double> next_beta = 0.0; //!< Time step suggested for next solve
+    complex<double> total_beta = 0.0; //!< Accumulated time of all steps
+    // observables evaluated at each center before its update in the first
+    // sweep of every time step, so that no separate Expect sweep is needed
+    // (in RK4 mode this is the state at total_beta; in TangentSpace mode the
+    // sites already passed in the sweep are propagated by one more step);
+    // the moving environment of each Expect must use the evolved MPS as
+    // both bra and ket (with the same dot), and its blocks are moved along
+    // with every sweep
+    vector<shared_ptr<Expect<S>>> observables;
+    // file the observables are appended to (empty for no output), one line
+    // of total_beta, observable index, site, operator and value per term
+    string observables_filename = "";
     size_t sweep_cumulative_nflop = 0;
     TimeEvolution(const shared_ptr<MovingEnvironment<S>> &me,
                   const vector<ubond_t> &bond_dims,
@@ -856,19 +950,23 @@ template <typename S> struct TimeEvolution {
             memcpy(tmp.data, h_eff->ket->data,
                    h_eff->ket->total_memory * sizeof(double));
             pdi = h_eff->expo_apply(-beta, me->mpo->const_e, hermitian,
-                                    iprint >= 3, me->para_rule);
+                                    iprint >= 3, me->para_rule, krylov_s_step,
+                                    &sweep_step_factor);
             memcpy(h_eff->ket->data, tmp.data,
                    h_eff->ket->total_memory * sizeof(double));
             tmp.deallocate();
             auto pdp =
-                h_eff->rk4_apply(-beta, me->mpo->const_e, false, me->para_rule);
+                h_eff->rk4_apply(-beta, me->mpo->const_e, false, me->para_rule,
+                                 &sweep_step_factor, step_tol);
             pdpf = pdp.first;
         } else if (effective_mode == TETypes::TangentSpace)
             pdi = h_eff->expo_apply(-beta, me->mpo->const_e, hermitian,
-                                    iprint >= 3, me->para_rule);
+                                    iprint >= 3, me->para_rule, krylov_s_step,
+                                    &sweep_step_factor);
         else if (effective_mode == TETypes::RK4) {
             auto pdp =
-                h_eff->rk4_apply(-beta, me->mpo->const_e, false, me->para_rule);
+                h_eff->rk4_apply(-beta, me->mpo->const_e, false, me->para_rule,
+                                 &sweep_step_factor, step_tol);
             pdpf = pdp.first;
             pdi = pdp.second;
         }
@@ -1005,7 +1103,8 @@ template <typename S> struct TimeEvolution {
                 shared_ptr<EffectiveHamiltonian<S>> k_eff = me->eff_ham(
                     FuseTypes::NoFuseL, forward, true, right, right);
                 auto pdk = k_eff->expo_apply(beta, me->mpo->const_e, hermitian,
-                                             iprint >= 3, me->para_rule);
+                                             iprint >= 3, me->para_rule,
+                                             krylov_s_step);
                 k_eff->deallocate();
                 if (me->para_rule == nullptr || me->para_rule->is_root()) {
                     if (normalize_mps)
@@ -1023,7 +1122,8 @@ template <typename S> struct TimeEvolution {
                 shared_ptr<EffectiveHamiltonian<S>> k_eff =
                     me->eff_ham(FuseTypes::NoFuseR, forward, true, left, left);
                 auto pdk = k_eff->expo_apply(beta, me->mpo->const_e, hermitian,
-                                             iprint >= 3, me->para_rule);
+                                             iprint >= 3, me->para_rule,
+                                             krylov_s_step);
                 k_eff->deallocate();
                 if (me->para_rule == nullptr || me->para_rule->is_root()) {
                     if (normalize_mps)
@@ -1134,19 +1234,23 @@ template <typename S> struct TimeEvolution {
             memcpy(tmp.data, h_eff->ket->data,
                    h_eff->ket->total_memory * sizeof(double));
             pdi = h_eff->expo_apply(-beta, me->mpo->const_e, hermitian,
-                                    iprint >= 3, me->para_rule);
+                                    iprint >= 3, me->para_rule, krylov_s_step,
+                                    &sweep_step_factor);
             memcpy(h_eff->ket->data, tmp.data,
                    h_eff->ket->total_memory * sizeof(double));
             tmp.deallocate();
             auto pdp =
-                h_eff->rk4_apply(-beta, me->mpo->const_e, false, me->para_rule);
+                h_eff->rk4_apply(-beta, me->mpo->const_e, false, me->para_rule,
+                                 &sweep_step_factor, step_tol);
             pdpf = pdp.first;
         } else if (effective_mode == TETypes::TangentSpace)
             pdi = h_eff->expo_apply(-beta, me->mpo->const_e, hermitian,
-                                    iprint >= 3, me->para_rule);
+                                    iprint >= 3, me->para_rule, krylov_s_step,
+                                    &sweep_step_factor);
         else if (effective_mode == TETypes::RK4) {
             auto pdp =
-                h_eff->rk4_apply(-beta, me->mpo->const_e, false, me->para_rule);
+                h_eff->rk4_apply(-beta, me->mpo->const_e, false, me->para_rule,
+                                 &sweep_step_factor, step_tol);
             pdpf = pdp.first;
             pdi = pdp.second;
         }
@@ -1244,7 +1348,8 @@ template <typename S> struct TimeEvolution {
                 me->eff_ham(FuseTypes::FuseR, forward, true,
                             me->bra->tensors[i + 1], me->ket->tensors[i + 1]);
             auto pdk = k_eff->expo_apply(beta, me->mpo->const_e, hermitian,
-                                         iprint >= 3, me->para_rule);
+                                         iprint >= 3, me->para_rule,
+                                         krylov_s_step);
             k_eff->deallocate();
             if (me->para_rule == nullptr || me->para_rule->is_root()) {
                 if (normalize_mps)
@@ -1261,7 +1366,8 @@ template <typename S> struct TimeEvolution {
                 me->eff_ham(FuseTypes::FuseL, forward, true,
                             me->bra->tensors[i], me->ket->tensors[i]);
             auto pdk = k_eff->expo_apply(beta, me->mpo->const_e, hermitian,
-                                         iprint >= 3, me->para_rule);
+                                         iprint >= 3, me->para_rule,
+                                         krylov_s_step);
             k_eff->deallocate();
             if (me->para_rule == nullptr || me->para_rule->is_root()) {
                 if (normalize_mps)
@@ -1344,7 +1450,7 @@ template <typename S> struct TimeEvolution {
             memcpy(tmp_im.data, h_eff->ket[1]->data,
                    h_eff->ket[1]->total_memory * sizeof(double));
             pdi = h_eff->expo_apply(-beta, me->mpo->const_e, iprint >= 3,
-                                    me->para_rule);
+                                    me->para_rule, &sweep_step_factor);
             memcpy(h_eff->ket[0]->data, tmp_re.data,
                    h_eff->ket[0]->total_memory * sizeof(double));
             memcpy(h_eff->ket[1]->data, tmp_im.data,
@@ -1352,14 +1458,16 @@ template <typename S> struct TimeEvolution {
             tmp_im.deallocate();
             tmp_re.deallocate();
             auto pdp =
-                h_eff->rk4_apply(-beta, me->mpo->const_e, false, me->para_rule);
+                h_eff->rk4_apply(-beta, me->mpo->const_e, false, me->para_rule,
+                                 &sweep_step_factor, step_tol);
             pdpf = pdp.first;
         } else if (effective_mode == TETypes::TangentSpace)
             pdi = h_eff->expo_apply(-beta, me->mpo->const_e, iprint >= 3,
-                                    me->para_rule);
+                                    me->para_rule, &sweep_step_factor);
         else if (effective_mode == TETypes::RK4) {
             auto pdp =
-                h_eff->rk4_apply(-beta, me->mpo->const_e, false, me->para_rule);
+                h_eff->rk4_apply(-beta, me->mpo->const_e, false, me->para_rule,
+                                 &sweep_step_factor, step_tol);
             pdpf = pdp.first;
             pdi = pdp.second;
         }
@@ -1695,7 +1803,7 @@ template <typename S> struct TimeEvolution {
             memcpy(tmp_im.data, h_eff->ket[1]->data,
                    h_eff->ket[1]->total_memory * sizeof(double));
             pdi = h_eff->expo_apply(-beta, me->mpo->const_e, iprint >= 3,
-                                    me->para_rule);
+                                    me->para_rule, &sweep_step_factor);
             memcpy(h_eff->ket[0]->data, tmp_re.data,
                    h_eff->ket[0]->total_memory * sizeof(double));
             memcpy(h_eff->ket[1]->data, tmp_im.data,
@@ -1703,14 +1811,16 @@ template <typename S> struct TimeEvolution {
             tmp_im.deallocate();
             tmp_re.deallocate();
             auto pdp =
-                h_eff->rk4_apply(-beta, me->mpo->const_e, false, me->para_rule);
+                h_eff->rk4_apply(-beta, me->mpo->const_e, false, me->para_rule,
+                                 &sweep_step_factor, step_tol);
             pdpf = pdp.first;
         } else if (effective_mode == TETypes::TangentSpace)
             pdi = h_eff->expo_apply(-beta, me->mpo->const_e, iprint >= 3,
-                                    me->para_rule);
+                                    me->para_rule, &sweep_step_factor);
         else if (effective_mode == TETypes::RK4) {
             auto pdp =
-                h_eff->rk4_apply(-beta, me->mpo->const_e, false, me->para_rule);
+                h_eff->rk4_apply(-beta, me->mpo->const_e, false, me->para_rule,
+                                 &sweep_step_factor, step_tol);
             pdpf = pdp.first;
             pdi = pdp.second;
         }
@@ -1887,12 +1997,39 @@ template <typename S> struct TimeEvolution {
             }
         }
     }
+    // evaluate the observables at center i and write them to os (if any)
+    void measure(int i, bool forward, ostream *os = nullptr) {
+        for (size_t k = 0; k < observables.size(); k++) {
+            const shared_ptr<Expect<S>> &ex = observables[k];
+            assert(ex->me->ket == me->ket && ex->me->bra == me->ket);
+            typename Expect<S>::Iteration r = ex->blocking(
+                i, forward, false, ex->bra_bond_dim, ex->ket_bond_dim);
+            if (os != nullptr)
+                for (auto &x : r.expectations)
+                    *os << total_beta << " " << setw(4) << k << " "
+                        << setw(4) << i << " " << x.first << " " << setw(20)
+                        << x.second << endl;
+            ex->expectations[i] = r.expectations;
+        }
+    }
     tuple<double, double, double> sweep(bool forward, bool advance,
                                         complex<double> beta, ubond_t bond_dim,
-                                        double noise) {
+                                        double noise, bool measure = false) {
+        unique_ptr<ofstream> ofs;
+        if (measure && observables_filename != "" &&
+            (me->para_rule == nullptr || me->para_rule->is_root())) {
+            ofs.reset(new ofstream(observables_filename.c_str(), ios::app));
+            if (!ofs->good())
+                throw runtime_error("TimeEvolution::sweep on '" +
+                                    observables_filename + "' failed.");
+            *ofs << scientific << setprecision(12);
+        }
         me->prepare();
+        for (auto &ex : observables)
+            ex->me->prepare();
         vector<double> energies, normsqs;
         sweep_cumulative_nflop = 0;
+        sweep_step_factor = numeric_limits<double>::infinity();
         vector<int> sweep_range;
         double largest_error = 0.0;
         if (forward)
@@ -1916,6 +2053,12 @@ template <typename S> struct TimeEvolution {
                 cout.flush();
             }
             t.get_time();
+            // observable blocks are moved in every sweep to stay in step
+            if (measure)
+                this->measure(i, forward, ofs.get());
+            else
+                for (auto &ex : observables)
+                    ex->me->move_to(i);
             Iteration r = blocking(i, forward, advance, beta, bond_dim, noise);
             sweep_cumulative_nflop += r.nflop;
             if (iprint >= 2)
@@ -1925,6 +2068,12 @@ template <typename S> struct TimeEvolution {
             normsqs.push_back(r.normsq);
             largest_error = max(largest_error, r.error);
         }
+        if (ofs != nullptr) {
+            if (!ofs->good())
+                throw runtime_error("TimeEvolution::sweep on '" +
+                                    observables_filename + "' failed.");
+            ofs->close();
+        }
         return make_tuple(energies.back(), normsqs.back(), largest_error);
     }
     void normalize() {
@@ -1974,7 +2123,9 @@ template <typename S> struct TimeEvolution {
         energies.clear();
         normsqs.clear();
         discarded_weights.clear();
+        betas.clear();
         for (int iw = 0; iw < n_sweeps; iw++) {
+            double step_factor = numeric_limits<double>::infinity();
             for (int isw = 0; isw < n_sub_sweeps; isw++) {
                 if (iprint >= 1) {
                     cout << "Sweep = " << setw(4) << iw;
@@ -1990,7 +2141,9 @@ template <typename S> struct TimeEvolution {
                          << setprecision(2) << noises[iw] << endl;
                 }
                 auto r = sweep(forward, isw == n_sub_sweeps - 1, beta,
-                               bond_dims[iw], noises[iw]);
+                               bond_dims[iw], noises[iw],
+                               isw == 0 && observables.size() != 0);
+                step_factor = min(step_factor, sweep_step_factor);
                 forward = !forward;
                 double tswp = current.get_time();
                 if (iprint >= 1) {
@@ -2018,10 +2171,300 @@ template <typename S> struct TimeEvolution {
             }
             if (normalize_mps)
                 normalize();
+            betas.push_back(beta);
+            total_beta += beta;
+            if (adaptive_step)
+                beta = adapt_step(beta, step_factor);
         }
+        next_beta = beta;
         this->forward = forward;
         return energies.back();
     }
+    // rescale the time step by the step factor from the error estimates
+    complex<double> adapt_step(complex<double> beta, double step_factor) const {
+        if (me->para_rule != nullptr)
+            me->para_rule->comm->broadcast(&step_factor, 1,
+                                           me->para_rule->comm->root);
+        double x = abs(beta) *
+                   min(max(step_factor, step_factor_min), step_factor_max);
+        if (step_max != 0)
+            x = min(x, step_max);
+        x = max(x, step_min);
+        complex<double> r = abs(beta) == 0 ? beta : beta * (x / abs(beta));
+        if (iprint >= 1)
+            cout << "Step factor = " << scientific << setw(9)
+                 << setprecision(2) << step_factor << " | Next Beta = "
+                 << fixed << setw(15) << setprecision(5) << r << endl;
+        return r;
+    }
+};
+
+// Global Krylov imaginary time evolution
+// The Krylov vectors are MPS generated by the Lanczos recurrence, each
+// fitted with Linear from H applied to the previous two vectors, and the
+// exponential is formed in the (small) Krylov subspace
+template <typename S> struct GlobalKrylovTE {
+    // mpo = H; impo = identity (must support scalar multiplication,
+    // as a SimplifiedMPO does)
+    shared_ptr<MPO<S>> mpo, impo;
+    // the time-evolved state (replaced after each step)
+    shared_ptr<MPS<S>> mps;
+    vector<ubond_t> bond_dims;
+    vector<double> noises;
+    vector<double> energies;
+    vector<double> normsqs;
+    // number of Krylov vectors per time step
+    int n_krylov = 4;
+    // number of sweeps and convergence threshold for each fitting
+    // (the fitted norm can converge well before the state does,
+    // so by default all sweeps are done)
+    int n_sweeps = 6;
+    double tol = 0.0;
+    // the recurrence stops early if the norm of the new vector is smaller
+    double krylov_break_tol = 1E-10;
+    // the fittings have no left-hand-side environment,
+    // so perturbative noise cannot be used
+    NoiseTypes noise_type = NoiseTypes::DensityMatrix;
+    DecompositionTypes decomp_type = DecompositionTypes::DensityMatrix;
+    TruncationTypes trunc_type = TruncationTypes::Physical;
+    double cutoff = 1E-14;
+    bool normalize_mps = true;
+    uint8_t iprint = 2;
+    // MPS tags are tag + "-K1", ... for Krylov vectors
+    // and tag + "-S0", tag + "-S1", tag + "-S2" for evolved states
+    string tag = "GKRY";
+    GlobalKrylovTE(const shared_ptr<MPO<S>> &mpo,
+                   const shared_ptr<MPO<S>> &impo,
+                   const shared_ptr<MPS<S>> &mps,
+                   const vector<ubond_t> &bond_dims,
+                   const vector<double> &noises = vector<double>())
+        : mpo(mpo), impo(impo), mps(mps), bond_dims(bond_dims),
+          noises(noises) {}
+    virtual ~GlobalKrylovTE() = default;
+    // <bra|xmpo|ket> (at the current center)
+    double expect(const shared_ptr<MPO<S>> &xmpo, const shared_ptr<MPS<S>> &bra,
+                  const shared_ptr<MPS<S>> &ket) const {
+        shared_ptr<MovingEnvironment<S>> me =
+            make_shared<MovingEnvironment<S>>(xmpo, bra, ket, tag + "-EX");
+        me->init_environments(false);
+        shared_ptr<Expect<S>> ex = make_shared<Expect<S>>(
+            me, bra->info->bond_dim, ket->info->bond_dim);
+        ex->iprint = 0;
+        return ex->solve(false, ket->center == 0);
+    }
+    // |bra> = rmpo |ket> + tmpo |tket> (the second term is optional)
+    // the initial guess for |bra> is a copy of |ket>
+    // all MPS are returned to the end they started from, so that any
+    // pair of Krylov vectors can be combined later
+    shared_ptr<MPS<S>> fit(const shared_ptr<MPO<S>> &rmpo,
+                           const shared_ptr<MPS<S>> &ket,
+                           const shared_ptr<MPO<S>> &tmpo,
+                           const shared_ptr<MPS<S>> &tket,
+                           const string &bra_tag) const {
+        shared_ptr<MPS<S>> bra = ket->deep_copy(bra_tag);
+        const int center = ket->center;
+        shared_ptr<MovingEnvironment<S>> rme =
+            make_shared<MovingEnvironment<S>>(rmpo, bra, ket, tag + "-RHS");
+        rme->init_environments(iprint >= 2);
+        shared_ptr<MovingEnvironment<S>> tme = nullptr;
+        if (tket != nullptr) {
+            tme = make_shared<MovingEnvironment<S>>(tmpo, bra, tket,
+                                                    tag + "-TGT");
+            tme->init_environments(iprint >= 2);
+        }
+        shared_ptr<Linear<S>> linear = make_shared<Linear<S>>(
+            nullptr, rme, tme, bond_dims, bond_dims, noises);
+        linear->eq_type = tket != nullptr
+                              ? EquationTypes::FitAddition
+                              : EquationTypes::PerturbativeCompression;
+        linear->noise_type = noise_type;
+        linear->decomp_type = decomp_type;
+        linear->trunc_type = trunc_type;
+        // |tket> is swept together with |bra>; keep its bond dimension
+        if (tket != nullptr)
+            linear->target_ket_bond_dim = (int)tket->info->bond_dim;
+        linear->cutoff = cutoff;
+        linear->iprint = iprint >= 2 ? iprint - 1 : 0;
+        linear->solve(n_sweeps, ket->center == 0, tol);
+        if (ket->center != center)
+            linear->solve(1, ket->center == 0, 0);
+        return bra;
+    }
+    // |mps> = exp(-beta H) |mps>
+    // returns the energy of the new state
+    double step(double beta) {
+        Timer t;
+        t.get_time();
+        // |v_k> = s_k |phi_k>
+        vector<shared_ptr<MPS<S>>> phis(1, mps);
+        vector<double> alphas, betas, ss;
+        const double norm = sqrt(expect(impo, mps, mps));
+        ss.push_back(1.0 / norm);
+        for (int k = 0; k < n_krylov; k++) {
+            const double alpha = ss[k] * ss[k] * expect(mpo, phis[k], phis[k]);
+            alphas.push_back(alpha);
+            if (k == n_krylov - 1)
+                break;
+            // |phi_{k+1}> = a (H - alpha_k) |phi_k> + |phi_{k-1}>
+            // = (H - alpha_k) |v_k> - beta_{k-1} |v_{k-1}> divided by g
+            const double g = k == 0 ? ss[0] : -betas[k - 1] * ss[k - 1];
+            const double a = ss[k] / g;
+            shared_ptr<MPO<S>> rmpo = a * mpo;
+            rmpo->const_e = a * (mpo->const_e - alpha);
+            shared_ptr<MPS<S>> phi =
+                fit(rmpo, phis[k], impo, k == 0 ? nullptr : phis[k - 1],
+                    tag + "-K" + to_string(k + 1));
+            const double xbeta = abs(g) * sqrt(expect(impo, phi, phi));
+            if (xbeta < krylov_break_tol)
+                break;
+            betas.push_back(xbeta);
+            ss.push_back(g / xbeta);
+            phis.push_back(phi);
+        }
+        // exp(-beta T) e_0 for the tridiagonal T = U^T diag(w) U
+        const int m = (int)alphas.size();
+        vector<double> tmat((size_t)m * m, 0.0), w(m), c(m, 0.0);
+        for (int k = 0; k < m; k++) {
+            tmat[k * m + k] = alphas[k];
+            if (k + 1 < m)
+                tmat[k * m + k + 1] = tmat[(k + 1) * m + k] = betas[k];
+        }
+        MatrixFunctions::eigs(MatrixRef(tmat.data(), m, m),
+                              DiagonalMatrix(w.data(), m));
+        // the lowest eigenvalue is factored out of the exponential
+        for (int j = 0; j < m; j++) {
+            const double f = exp(-beta * (w[j] - w[0])) * tmat[j * m];
+            for (int i = 0; i < m; i++)
+                c[i] += tmat[j * m + i] * f;
+        }
+        double cnorm = 0;
+        for (int i = 0; i < m; i++)
+            cnorm += c[i] * c[i];
+        const double scale =
+            normalize_mps ? 1.0 / sqrt(cnorm) : norm * exp(-beta * w[0]);
+        // |mps> = sum_i c_i s_i |phi_i>
+        shared_ptr<MPS<S>> r = nullptr;
+        for (int i = m - 1; i >= 0; i--) {
+            // a tag different from those of all MPS still to be added
+            // (only phis[0] and r can have such a tag)
+            string r_tag;
+            for (int j = 0; j < 3; j++) {
+                r_tag = tag + "-S" + to_string(j);
+                if (r_tag != phis[0]->info->tag &&
+                    (r == nullptr || r_tag != r->info->tag))
+                    break;
+            }
+            shared_ptr<MPO<S>> rmpo = (scale * c[i] * ss[i]) * impo;
+            if (r == nullptr && i == 0)
+                r = fit(rmpo, phis[i], nullptr, nullptr, r_tag);
+            else if (r == nullptr) {
+                r = fit(rmpo, phis[i], (scale * c[i - 1] * ss[i - 1]) * impo,
+                        phis[i - 1], r_tag);
+                i--;
+            } else
+                r = fit(rmpo, phis[i], impo, r, r_tag);
+        }
+        mps = r;
+        normsqs.push_back(expect(impo, mps, mps));
+        energies.push_back(expect(mpo, mps, mps) / normsqs.back());
+        if (iprint >= 1)
+            cout << "Global Krylov | Nkrylov = " << setw(3) << m
+                 << " | E = " << fixed << setw(17) << setprecision(10)
+                 << energies.back() << " | Norm^2 = " << setw(15)
+                 << setprecision(10) << normsqs.back()
+                 << " | Tstep = " << setw(10) << setprecision(3)
+                 << t.get_time() << endl;
+        return energies.back();
+    }
+    // n_steps steps of exp(-beta H)
+    double solve(int n_steps, double beta) {
+        for (int i = 0; i < n_steps; i++)
+            step(beta);
+        return energies.size() == 0 ? 0.0 : energies.back();
+    }
+};
+
+// Finite temperature by purification (ancilla MPS)
+// |psi(beta)> = exp(-beta H / 2) |psi(0)> is evolved from the thermal limit
+// state in steps of beta, with one TimeEvolution (and so one set of
+// environments of me) kept across all steps. Thermodynamic quantities are
+// recorded after each step from the energies of all steps so far:
+//   ln Z(beta) = log_z0 - int_0^beta E dbeta (trapezoidal rule),
+//   F = -ln Z / beta,  S = beta (E - F),
+//   C = -beta^2 dE/dbeta (backward difference)
+// (the norm of the state is not used for ln Z, since with the tangent space
+// method its error is first order in the time step)
+template <typename S> struct FiniteTemperature {
+    // me: H with the evolved (ancilla) MPS as both bra and ket
+    shared_ptr<TimeEvolution<S>> te;
+    // the first step starts from a bond dimension one state,
+    // so it is done in init_mode (with several sub-sweeps) by default
+    TETypes mode, init_mode = TETypes::RK4;
+    int n_sub_sweeps, init_n_sub_sweeps = 6;
+    // ln Z at infinite temperature (the log of the number of states
+    // represented by the thermal limit state)
+    double log_z0 = 0.0;
+    // current inverse temperature and ln Z
+    double beta = 0.0, log_z = 0.0;
+    vector<double> betas, energies, free_energies, entropies, heat_capacities;
+    uint8_t iprint = 1;
+    FiniteTemperature(const shared_ptr<MovingEnvironment<S>> &me,
+                      const vector<ubond_t> &bond_dims,
+                      TETypes mode = TETypes::TangentSpace,
+                      int n_sub_sweeps = 1)
+        : te(make_shared<TimeEvolution<S>>(me, bond_dims, mode,
+                                           n_sub_sweeps)),
+          mode(mode), n_sub_sweeps(n_sub_sweeps) {}
+    virtual ~FiniteTemperature() = default;
+    // energy of the current state, using the environments of te
+    double energy() const {
+        shared_ptr<Expect<S>> ex = make_shared<Expect<S>>(
+            te->me, te->me->ket->info->bond_dim, te->me->ket->info->bond_dim);
+        ex->iprint = 0;
+        return ex->solve(false, te->me->ket->center == 0);
+    }
+    // record the thermodynamic quantities at the current beta
+    void record(double energy) {
+        double cv = 0.0;
+        if (betas.size() == 0)
+            log_z = log_z0;
+        else {
+            log_z -= 0.5 * (beta - betas.back()) * (energy + energies.back());
+            if (beta != betas.back())
+                cv = -beta * beta * (energy - energies.back()) /
+                     (beta - betas.back());
+        }
+        betas.push_back(beta);
+        energies.push_back(energy);
+        free_energies.push_back(
+            beta == 0.0 ? -numeric_limits<double>::infinity() : -log_z / beta);
+        entropies.push_back(beta * energy + log_z);
+        heat_capacities.push_back(cv);
+        if (iprint >= 1)
+            cout << "Finite Temperature | Beta = " << fixed << setw(12)
+                 << setprecision(5) << beta << " | E = " << setw(17)
+                 << setprecision(10) << energy << " | F = " << setw(17)
+                 << free_energies.back() << " | S = " << setw(14)
+                 << entropies.back() << " | C = " << setw(14)
+                 << heat_capacities.back() << endl;
+    }
+    // n_steps steps of dbeta (the MPS is evolved by dbeta / 2 per step);
+    // with te->adaptive_step, later steps use the adapted step size
+    double solve(int n_steps, double dbeta) {
+        if (betas.size() == 0)
+            record(energy());
+        for (int i = 0; i < n_steps; i++) {
+            const bool init = te->total_beta == 0.0;
+            te->mode = init ? init_mode : mode;
+            te->n_sub_sweeps = init ? init_n_sub_sweeps : n_sub_sweeps;
+            te->solve(1, dbeta / 2, te->me->ket->center == 0);
+            beta += 2.0 * te->betas.back().real();
+            if (te->adaptive_step)
+                dbeta = 2.0 * te->next_beta.real();
+            record(te->energies.back());
+        }
+        return energies.back();
+    }
 };
 
 } // namespace block2
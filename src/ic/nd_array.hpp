@@ -23,18 +23,25 @@
 
 #pragma once
 
+#include "../core/matrix.hpp"
 #include "../core/threading.hpp"
 #include "../core/utils.hpp"
 #ifdef _HAS_INTEL_MKL
 #include "mkl.h"
 #endif
 #include <algorithm>
+#include <atomic>
 #include <cassert>
 #include <cmath>
 #include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <functional>
 #include <iomanip>
 #include <limits>
+#include <map>
 #include <memory>
+#include <mutex>
 #include <numeric>
 #include <set>
 #include <vector>
@@ -114,6 +121,89 @@ struct NDArraySlice {
     }
 };
 
+// Size-class pool of NDArray storage for short-lived temporaries
+// Buffers freed while an NDArrayPoolScope is active are kept and reused,
+// avoiding page faults from repeated large allocations.
+// Cached buffers are released when the last scope ends
+struct NDArrayPool {
+    mutex mtx;
+    map<size_t, vector<vector<double> *>> free_lists;
+    atomic<int> n_scopes;
+    // max number of doubles kept in free lists
+    size_t max_cached = numeric_limits<size_t>::max(), cached = 0;
+    NDArrayPool() : n_scopes(0) {}
+    // never destroyed, as buffers may be returned during static destruction
+    static NDArrayPool &instance() {
+        static NDArrayPool *pool = new NDArrayPool();
+        return *pool;
+    }
+    // n rounded up to m * 2^k with 4 <= m < 8 (at most 25% padding)
+    static size_t size_class(size_t n) {
+        if (n <= 8)
+            return 8;
+        int k = 0;
+        for (size_t x = n; x >= 8; x >>= 1)
+            k++;
+        return ((n + ((size_t)1 << k) - 1) >> k) << k;
+    }
+    bool active() const { return n_scopes.load() != 0; }
+    // storage is not initialized when it is reused
+    shared_ptr<vector<double>> allocate(size_t n) {
+        const size_t sz = size_class(n);
+        vector<double> *v = nullptr;
+        {
+            lock_guard<mutex> lock(mtx);
+            auto it = free_lists.find(sz);
+            if (it != free_lists.end() && it->second.size() != 0) {
+                v = it->second.back(), it->second.pop_back();
+                cached -= sz;
+            }
+        }
+        if (v == nullptr)
+            v = new vector<double>(sz);
+        return shared_ptr<vector<double>>(
+            v, [](vector<double> *x) { NDArrayPool::instance().release(x); });
+    }
+    void release(vector<double> *v) {
+        if (active()) {
+            lock_guard<mutex> lock(mtx);
+            if (active() && cached + v->size() <= max_cached) {
+                free_lists[v->size()].push_back(v);
+                cached += v->size();
+                return;
+            }
+        }
+        delete v;
+    }
+    void enter() { n_scopes++; }
+    void leave() {
+        if (--n_scopes == 0)
+            clear();
+    }
+    void clear() {
+        lock_guard<mutex> lock(mtx);
+        for (auto &fl : free_lists)
+            for (auto &v : fl.second)
+                delete v;
+        free_lists.clear();
+        cached = 0;
+    }
+};
+
+// RAII scope in which NDArray temporaries are drawn from NDArrayPool
+struct NDArrayPoolScope {
+    NDArrayPoolScope() { NDArrayPool::instance().enter(); }
+    ~NDArrayPoolScope() { NDArrayPool::instance().leave(); }
+    NDArrayPoolScope(const NDArrayPoolScope &) = delete;
+    NDArrayPoolScope &operator=(const NDArrayPoolScope &) = delete;
+};
+
+// Order of pairwise contractions in NDArray::einsum
+// Linear: left to right; Greedy: smallest intermediate first;
+// Optimal: exhaustive search for fewest flops; Auto: Optimal for
+// at most five operands, Greedy otherwise
+enum struct EinsumPathTypes : uint8_t { Linear, Greedy, Optimal, Auto };
+
 struct NDArray {
     shared_ptr<vector<double>> vdata;
     vector<MKL_INT> shape;
@@ -136,6 +226,33 @@ struct NDArray {
     NDArray(const vector<MKL_INT> &shape, const vector<ssize_t> &strides,
             double *data)
         : shape(shape), strides(strides), data(data), vdata(nullptr) {}
+    // uninitialized array for temporaries, using NDArrayPool when active
+    // (strides must be a permutation of C order when given)
+    static NDArray empty(const vector<MKL_INT> &shape,
+                         const vector<ssize_t> &strides = {}) {
+        NDArray r(shape, strides, nullptr);
+        if (strides.size() == 0) {
+            r.strides.resize(shape.size());
+            ssize_t cur = 1;
+            for (int i = r.ndim() - 1; i >= 0; cur *= shape[i--])
+                r.strides[i] = cur;
+        }
+        NDArrayPool &pool = NDArrayPool::instance();
+        r.vdata = pool.active() ? pool.allocate(r.size())
+                                : make_shared<vector<double>>(r.size());
+        r.data = r.vdata->data();
+        return r;
+    }
+    // zero-copy view of a dense tensor (such as a 2pdm from PDM2MPOQC or a
+    // 3pdm from PDM3Stream), sharing ownership of its storage
+    static NDArray from_tensor(const shared_ptr<GTensor<double>> &t) {
+        NDArray r(t->shape, vector<ssize_t>(t->shape.size()), t->data.data());
+        ssize_t cur = 1;
+        for (int i = r.ndim() - 1; i >= 0; cur *= r.shape[i--])
+            r.strides[i] = cur;
+        r.vdata = shared_ptr<vector<double>>(t, &t->data);
+        return r;
+    }
     NDArray(const vector<MKL_INT> &shape, const vector<double> &xdata)
         : NDArray(shape) {
         memcpy(data, xdata.data(), sizeof(double) * xdata.size());
@@ -298,15 +415,27 @@ struct NDArray {
         for (int i = idx_at; i < dim; i++)
             size_right *= shape[i];
         size_t size_left = size() / size_right;
-        NDArray r(new_shape);
+        NDArray r = NDArray::empty(new_shape);
         int ntg = threading->activate_global();
+        if (size_left >= (size_t)ntg) {
 #pragma omp parallel for schedule(static) num_threads(ntg)
-        for (size_t i = 0; i < size_left; i++) {
-            const double *__restrict__ a_data = data + i * size_right;
-            double rr = 0;
-            for (size_t j = 0; j < size_right; j++)
-                rr += a_data[j];
-            r.data[i] = rr;
+            for (size_t i = 0; i < size_left; i++) {
+                const double *__restrict__ a_data = data + i * size_right;
+                double rr = 0;
+                for (size_t j = 0; j < size_right; j++)
+                    rr += a_data[j];
+                r.data[i] = rr;
+            }
+        } else {
+            // few long rows: parallelize inside each row
+            for (size_t i = 0; i < size_left; i++) {
+                const double *__restrict__ a_data = data + i * size_right;
+                double rr = 0;
+#pragma omp parallel for schedule(static) num_threads(ntg) reduction(+ : rr)
+                for (size_t j = 0; j < size_right; j++)
+                    rr += a_data[j];
+                r.data[i] = rr;
+            }
         }
         threading->activate_normal();
         return r;
@@ -335,7 +464,26 @@ struct NDArray {
         assert(size() == 1);
         return data[0];
     }
+    // elements occupy one contiguous block (C order modulo permutation)
+    // so that elementwise operations can run over the flat data
+    bool is_dense() const {
+        for (auto &st : strides)
+            if (st < 0)
+                return false;
+        return max_size() == size();
+    }
     double norm() const {
+        if (is_dense()) {
+            const size_t n = size();
+            const double *__restrict__ a = data;
+            double r = 0;
+            int ntg = threading->activate_global();
+#pragma omp parallel for simd schedule(static) num_threads(ntg) reduction(+ : r)
+            for (size_t i = 0; i < n; i++)
+                r += a[i] * a[i];
+            threading->activate_normal();
+            return sqrt(r);
+        }
         NDArray r;
         vector<int> idx(ndim());
         for (int i = 0; i < ndim(); i++)
@@ -346,53 +494,80 @@ struct NDArray {
     NDArray to_c_order() const {
         if (is_c_order())
             return *this;
-        NDArray r(shape);
+        NDArray r = NDArray::empty(shape);
         NDArray::transpose(*this, r);
         return r;
     }
-    NDArray operator-() const {
-        NDArray r(shape, strides);
-        size_t sz = size();
-        for (size_t i = 0; i < sz; i++)
-            r.data[i] = -data[linear_index(i)];
+    NDArray operator-() const { return *this * (-1.0); }
+    NDArray operator*(double alpha) const {
+        if (is_dense()) {
+            NDArray r = NDArray::empty(shape, strides);
+            const size_t n = size();
+            const double *__restrict__ a = data;
+            double *__restrict__ c = r.data;
+            int ntg = threading->activate_global();
+#pragma omp parallel for simd schedule(static) num_threads(ntg)
+            for (size_t i = 0; i < n; i++)
+                c[i] = alpha * a[i];
+            threading->activate_normal();
+            return r;
+        }
+        NDArray r = NDArray::empty(shape);
+        NDArray::transpose(*this, r, {}, alpha, 0.0);
         return r;
     }
-    NDArray operator-(const NDArray &other) const { return *this + (-other); }
+    friend NDArray operator*(double alpha, const NDArray &x) {
+        return x * alpha;
+    }
+    NDArray operator-(const NDArray &other) const {
+        return axpby(1.0, *this, -1.0, other);
+    }
     NDArray operator+(const NDArray &other) const {
-        assert(ndim() == other.ndim());
-        int dim = ndim();
+        return axpby(1.0, *this, 1.0, other);
+    }
+    // alpha * x + beta * y in one pass (dims of size one are broadcast)
+    static NDArray axpby(double alpha, const NDArray &x, double beta,
+                         const NDArray &y) {
+        assert(x.ndim() == y.ndim());
+        int dim = x.ndim();
         bool same_stride = true;
-        NDArray r(shape, strides);
+        NDArray r(x.shape, x.strides);
         for (int i = 0; i < dim; i++) {
-            if (strides[i] != 0 && other.strides[i] != 0) {
-                assert(shape[i] == other.shape[i]);
-                same_stride = same_stride && strides[i] == other.strides[i];
-            } else if (strides[i] != 0)
+            if (x.strides[i] != 0 && y.strides[i] != 0) {
+                assert(x.shape[i] == y.shape[i]);
+                same_stride = same_stride && x.strides[i] == y.strides[i];
+            } else if (x.strides[i] != 0)
                 same_stride = false;
-            else if (other.strides[i] != 0) {
-                r.shape[i] = other.shape[i];
-                r.strides[i] = other.strides[i];
+            else if (y.strides[i] != 0) {
+                r.shape[i] = y.shape[i];
+                r.strides[i] = y.strides[i];
                 same_stride = false;
             }
         }
-        if (same_stride) {
-            // const double x = 1.0;
-            // MKL_INT n = (MKL_INT)r.size(), inc = 1;
-            // memcpy(r.data, data, sizeof(double) * n);
-            // dgemm("N", "N", &inc, &n, &inc, &x, &x, &inc, other.data, &inc,
-            // &x, r.data, &inc);
+        if (same_stride && x.is_dense()) {
+            const size_t n = r.size();
+            const double *__restrict__ a = x.data, *__restrict__ b = y.data;
+            double *__restrict__ c = r.data;
+            int ntg = threading->activate_global();
+#pragma omp parallel for simd schedule(static) num_threads(ntg)
+            for (size_t i = 0; i < n; i++)
+                c[i] = alpha * a[i] + beta * b[i];
+            threading->activate_normal();
+        } else if (same_stride) {
+            // strides with gaps: the result is in C order
+            r = NDArray(x.shape);
             const size_t r_size = r.size();
             for (size_t i = 0; i < r_size; i++) {
-                size_t ii = linear_index(i);
-                r.data[ii] = data[ii] + other.data[ii];
+                size_t ii = x.linear_index(i);
+                r.data[i] = alpha * x.data[ii] + beta * y.data[ii];
             }
         } else {
             size_t cur = 1;
             for (int i = r.ndim() - 1; i >= 0; cur *= r.shape[i--])
                 if (r.strides[i] != 0)
                     r.strides[i] = cur;
-            transpose(*this, r, {}, 1.0, 0.0);
-            transpose(other, r, {}, 1.0, 1.0);
+            transpose(x, r, {}, alpha, 0.0);
+            transpose(y, r, {}, beta, 1.0);
         }
         return r;
     }
@@ -454,7 +629,46 @@ struct NDArray {
         }
         threading->activate_normal();
     }
-    // outpur br is sorted original br idx in a
+    // fuse dims (outer to inner) into one strided dim (no copy)
+    // stride is zero if the fused extent is one
+    static bool fuse_dims(const NDArray &x, const vector<int> &dims,
+                          MKL_INT &extent, ssize_t &stride) {
+        extent = 1, stride = 0;
+        for (int i = (int)dims.size() - 1; i >= 0; i--) {
+            if (x.shape[dims[i]] == 1)
+                continue;
+            if (extent == 1) {
+                if (x.strides[dims[i]] <= 0)
+                    return false;
+                stride = x.strides[dims[i]];
+            } else if (x.strides[dims[i]] != stride * extent)
+                return false;
+            extent *= x.shape[dims[i]];
+        }
+        return true;
+    }
+    // whether x can be used as a BLAS matrix with the given row and col dims
+    static bool matrix_layout(const NDArray &x, const vector<int> &rows,
+                              const vector<int> &cols, bool &row_major,
+                              MKL_INT &ld) {
+        MKL_INT nr, nc;
+        ssize_t sr, sc;
+        if (!fuse_dims(x, rows, nr, sr) || !fuse_dims(x, cols, nc, sc))
+            return false;
+        if ((nc == 1 || sc == 1) && (nr == 1 || sr >= nc)) {
+            row_major = true;
+            ld = nr == 1 ? max(nc, (MKL_INT)1) : (MKL_INT)sr;
+            return true;
+        } else if ((nr == 1 || sr == 1) && (nc == 1 || sc >= nr)) {
+            row_major = false;
+            ld = nc == 1 ? max(nr, (MKL_INT)1) : (MKL_INT)sc;
+            return true;
+        }
+        return false;
+    }
+    // output dims of c: br (sorted by idx in a), free a, free b
+    // operands are passed to (batched) GEMM using their strides,
+    // and only copied when the strides cannot be mapped to a matrix
     static void tensordot(const NDArray &a, const NDArray &b, NDArray &c,
                           const vector<int> &idxa, const vector<int> &idxb,
                           const vector<int> &br_idxa = {},
@@ -464,141 +678,263 @@ struct NDArray {
         assert(br_idxa.size() == br_idxb.size());
         int nctr = (int)idxa.size(), nbr = (int)br_idxa.size();
         int ndima = a.ndim(), ndimb = b.ndim();
-        vector<int> idx, ridx, idxax(idxa.size() + br_idxa.size()),
-            idxbx(idxb.size() + br_idxb.size());
-        NDArray ax = a.reorder_c(idx);
-        ridx.resize(idx.size());
-        for (int i = 0; i < ndima; i++)
-            ridx[idx[i]] = i;
+        vector<int> br_order(nbr), ctr_order_a(nctr), ctr_order_b(nctr);
         for (int i = 0; i < nbr; i++)
-            idxax[i] = ridx[br_idxa[i]];
+            br_order[i] = i;
+        sort(br_order.begin(), br_order.end(),
+             [&br_idxa](int i, int j) { return br_idxa[i] < br_idxa[j]; });
         for (int i = 0; i < nctr; i++)
-            idxax[i + nbr] = ridx[idxa[i]];
-        NDArray bx = b.reorder_c(idx);
-        ridx.resize(idx.size());
-        for (int i = 0; i < ndimb; i++)
-            ridx[idx[i]] = i;
-        for (int i = 0; i < nbr; i++)
-            idxbx[i] = ridx[br_idxb[i]];
+            ctr_order_a[i] = ctr_order_b[i] = i;
+        stable_sort(ctr_order_a.begin(), ctr_order_a.end(),
+                    [&a, &idxa](int i, int j) {
+                        return a.strides[idxa[i]] > a.strides[idxa[j]];
+                    });
+        stable_sort(ctr_order_b.begin(), ctr_order_b.end(),
+                    [&b, &idxb](int i, int j) {
+                        return b.strides[idxb[i]] > b.strides[idxb[j]];
+                    });
+        vector<int> a_br(nbr), b_br(nbr), a_out, b_out;
+        vector<int> a_ctr(nctr), b_ctr(nctr);
+        vector<int> xa(ndima, 0), xb(ndimb, 0);
+        MKL_INT a_free_dim = 1, b_free_dim = 1, ctr_dim = 1, br_dim = 1;
+        for (int i = 0; i < nbr; i++) {
+            a_br[i] = br_idxa[br_order[i]], b_br[i] = br_idxb[br_order[i]];
+            xa[a_br[i]] = xb[b_br[i]] = -1, br_dim *= a.shape[a_br[i]];
+        }
         for (int i = 0; i < nctr; i++)
-            idxbx[i + nbr] = ridx[idxb[i]];
+            xa[idxa[i]] = xb[idxb[i]] = -1, ctr_dim *= a.shape[idxa[i]];
+        for (int i = 0; i < ndima; i++)
+            if (xa[i] != -1)
+                a_out.push_back(i), a_free_dim *= a.shape[i];
+        for (int i = 0; i < ndimb; i++)
+            if (xb[i] != -1)
+                b_out.push_back(i), b_free_dim *= b.shape[i];
         assert(c.is_c_order());
-        int outa[ndima - nctr - nbr], outb[ndimb - nctr - nbr];
-        MKL_INT a_free_dim = 1, b_free_dim = 1, ctr_dim = 1, br_dim = 1;
-        set<int> idxa_set(idxax.begin(), idxax.end());
-        set<int> idxb_set(idxbx.begin(), idxbx.end());
-        for (int i = 0, ioa = 0; i < ndima; i++)
-            if (!idxa_set.count(i))
-                outa[ioa] = i, a_free_dim *= ax.shape[i], ioa++;
-        for (int i = 0, iob = 0; i < ndimb; i++)
-            if (!idxb_set.count(i))
-                outb[iob] = i, b_free_dim *= bx.shape[i], iob++;
-        int trans_a = 0, trans_b = 0;
 
-        int ctr_idx[nctr + nbr];
-        for (int i = 0; i < nbr; i++)
-            ctr_idx[i] = i, br_dim *= ax.shape[idxax[i]];
-        for (int i = nbr; i < nbr + nctr; i++)
-            ctr_idx[i] = i, ctr_dim *= ax.shape[idxax[i]];
-        sort(ctr_idx, ctr_idx + nbr,
-             [&idxax](int a, int b) { return idxax[a] < idxax[b]; });
-        sort(ctr_idx + nbr, ctr_idx + nbr + nctr,
-             [&idxax](int a, int b) { return idxax[a] < idxax[b]; });
-
-        // checking whether permutation is necessary
-        if (!ax.is_c_order())
-            trans_a = 0;
-        else if (nbr != 0 &&
-                 (idxax[ctr_idx[0]] != 0 || idxax[ctr_idx[nbr - 1]] != nbr - 1))
-            trans_a = 0;
-        else if (nctr == 0)
-            trans_a = 1;
-        else if (idxax[ctr_idx[nbr]] == nbr &&
-                 idxax[ctr_idx[nbr + nctr - 1]] == nbr + nctr - 1)
-            trans_a = 1;
-        else if (idxax[ctr_idx[nbr]] == ndima - nctr &&
-                 idxax[ctr_idx[nbr + nctr - 1]] == ndima - 1)
-            trans_a = -1;
-
-        if (!bx.is_c_order())
-            trans_b = 0;
-        else if (nbr != 0 && !(idxbx[ctr_idx[0]] == 0 &&
-                               idxbx[ctr_idx[nbr - 1]] == nbr - 1))
-            trans_b = 0;
-        else if (nctr == 0)
-            trans_b = 1;
-        else if (idxbx[ctr_idx[nbr]] == nbr &&
-                 idxbx[ctr_idx[nbr + nctr - 1]] == nbr + nctr - 1)
-            trans_b = 1;
-        else if (idxbx[ctr_idx[nbr]] == ndimb - nctr &&
-                 idxbx[ctr_idx[nbr + nctr - 1]] == ndimb - 1)
-            trans_b = -1;
+        // choose the order of contracted dims with the least copying
+        // a is (free a) x (ctr), b is (ctr) x (free b)
+        bool a_ok = false, b_ok = false, a_rm = false, b_rm = false;
+        MKL_INT lda = 0, ldb = 0;
+        size_t best_cost = numeric_limits<size_t>::max();
+        for (const vector<int> *ctr_order : {&ctr_order_a, &ctr_order_b}) {
+            vector<int> actr(nctr), bctr(nctr);
+            for (int i = 0; i < nctr; i++)
+                actr[i] = idxa[(*ctr_order)[i]],
+                bctr[i] = idxb[(*ctr_order)[i]];
+            bool xa_rm, xb_rm;
+            MKL_INT xlda, xldb;
+            bool xa_ok = matrix_layout(a, a_out, actr, xa_rm, xlda);
+            bool xb_ok = matrix_layout(b, bctr, b_out, xb_rm, xldb);
+            size_t cost = (xa_ok ? 0 : a.size()) + (xb_ok ? 0 : b.size());
+            if (cost < best_cost) {
+                best_cost = cost, a_ctr = actr, b_ctr = bctr;
+                a_ok = xa_ok, b_ok = xb_ok, a_rm = xa_rm, b_rm = xb_rm;
+                lda = xlda, ldb = xldb;
+            }
+        }
 
-        // permute or reshape
-        if (trans_a == 0) {
-            vector<int> perm_a(ndima);
+        // permute to (br, ctr, free) when unavoidable
+        NDArray ax = a, bx = b;
+        if (!a_ok) {
+            vector<int> perm_a;
+            perm_a.reserve(ndima);
+            perm_a.insert(perm_a.end(), a_br.begin(), a_br.end());
+            perm_a.insert(perm_a.end(), a_ctr.begin(), a_ctr.end());
+            perm_a.insert(perm_a.end(), a_out.begin(), a_out.end());
             vector<MKL_INT> new_shape_a(ndima);
-            for (int i = 0; i < nbr + nctr; i++)
-                perm_a[i] = idxax[ctr_idx[i]];
-            for (int i = nbr + nctr; i < ndima; i++)
-                perm_a[i] = outa[i - nctr - nbr];
             for (int i = 0; i < ndima; i++)
-                new_shape_a[i] = ax.shape[perm_a[i]];
-            NDArray axx(new_shape_a);
-            transpose(ax, axx, perm_a);
-            ax = axx;
-            trans_a = 1;
+                new_shape_a[i] = a.shape[perm_a[i]];
+            ax = NDArray::empty(new_shape_a);
+            transpose(a, ax, perm_a);
+            for (int i = 0; i < ndima; i++)
+                (i < nbr ? a_br[i]
+                         : (i < nbr + nctr ? a_ctr[i - nbr]
+                                           : a_out[i - nbr - nctr])) = i;
+            a_ok = matrix_layout(ax, a_out, a_ctr, a_rm, lda);
+            assert(a_ok);
         }
-
-        if (trans_b == 0) {
-            vector<int> perm_b(ndimb);
+        if (!b_ok) {
+            vector<int> perm_b;
+            perm_b.reserve(ndimb);
+            perm_b.insert(perm_b.end(), b_br.begin(), b_br.end());
+            perm_b.insert(perm_b.end(), b_ctr.begin(), b_ctr.end());
+            perm_b.insert(perm_b.end(), b_out.begin(), b_out.end());
             vector<MKL_INT> new_shape_b(ndimb);
-            for (int i = 0; i < nbr + nctr; i++)
-                perm_b[i] = idxbx[ctr_idx[i]];
-            for (int i = nbr + nctr; i < ndimb; i++)
-                perm_b[i] = outb[i - nctr - nbr];
             for (int i = 0; i < ndimb; i++)
-                new_shape_b[i] = bx.shape[perm_b[i]];
-            NDArray bxx(new_shape_b);
-            transpose(bx, bxx, perm_b);
-            bx = bxx;
-            trans_b = 1;
+                new_shape_b[i] = b.shape[perm_b[i]];
+            bx = NDArray::empty(new_shape_b);
+            transpose(b, bx, perm_b);
+            for (int i = 0; i < ndimb; i++)
+                (i < nbr ? b_br[i]
+                         : (i < nbr + nctr ? b_ctr[i - nbr]
+                                           : b_out[i - nbr - nctr])) = i;
+            b_ok = matrix_layout(bx, b_ctr, b_out, b_rm, ldb);
+            assert(b_ok);
         }
 
-        const MKL_INT ldb = trans_b == 1 ? b_free_dim : ctr_dim;
-        const MKL_INT lda = trans_a == -1 ? ctr_dim : a_free_dim;
-        const MKL_INT ldc = b_free_dim;
-
+        const MKL_INT ldc = max(b_free_dim, (MKL_INT)1);
+        const char *ta = a_rm ? "n" : "t", *tb = b_rm ? "n" : "t";
         if (nbr == 0) {
             threading->activate_global_mkl();
-            dgemm(trans_b == 1 ? "n" : "t", trans_a == -1 ? "n" : "t",
-                  &b_free_dim, &a_free_dim, &ctr_dim, &alpha, bx.data, &ldb,
-                  ax.data, &lda, &beta, c.data, &ldc);
+            dgemm(tb, ta, &b_free_dim, &a_free_dim, &ctr_dim, &alpha, bx.data,
+                  &ldb, ax.data, &lda, &beta, c.data, &ldc);
             threading->activate_normal();
         } else {
-            const ssize_t stride_a = ax.strides[nbr - 1];
-            const ssize_t stride_b = bx.strides[nbr - 1];
-            const ssize_t stride_c = c.strides[nbr - 1];
             int ntg = threading->activate_global();
 #pragma omp parallel for schedule(static) num_threads(ntg)
-            for (MKL_INT ibr = 0; ibr < br_dim; ibr++)
-                dgemm(trans_b == 1 ? "n" : "t", trans_a == -1 ? "n" : "t",
-                      &b_free_dim, &a_free_dim, &ctr_dim, &alpha,
-                      bx.data + stride_b * ibr, &ldb, ax.data + stride_a * ibr,
-                      &lda, &beta, c.data + stride_c * ibr, &ldc);
+            for (MKL_INT ibr = 0; ibr < br_dim; ibr++) {
+                ssize_t offset_a = 0, offset_b = 0, offset_c = 0, jx = ibr;
+                for (int i = nbr - 1; i >= 0; jx /= c.shape[i--]) {
+                    const ssize_t j = jx % c.shape[i];
+                    offset_a += j * ax.strides[a_br[i]];
+                    offset_b += j * bx.strides[b_br[i]];
+                    offset_c += j * c.strides[i];
+                }
+                dgemm(tb, ta, &b_free_dim, &a_free_dim, &ctr_dim, &alpha,
+                      bx.data + offset_b, &ldb, ax.data + offset_a, &lda,
+                      &beta, c.data + offset_c, &ldc);
+            }
             threading->activate_normal();
-
-            vector<int> perm_c(c.strides.size());
-            for (int i = 0; i < (int)perm_c.size(); i++)
-                perm_c[i] = i;
-            sort(perm_c.data(), perm_c.data() + nbr,
-                 [&idx, &idxax, &ctr_idx](int a, int b) {
-                     return idx[idxax[ctr_idx[a]]] < idx[idxax[ctr_idx[b]]];
-                 });
-            c = c.transpose(perm_c);
         }
     }
-    static NDArray einsum(const string &script, const vector<NDArray> &arrs) {
+    // script of the result of contracting sa and sb
+    // (broadcast indices in order of sa, then free indices of sa and sb)
+    // count is the number of remaining occurrences of each index
+    static string einsum_pair_script(const string &sa, const string &sb,
+                                     const vector<int> &count) {
+        stringstream sr, ss;
+        for (char c : sa)
+            if (sb.find(c) == string::npos)
+                ss << c;
+            else if (count[(uint8_t)c] != 2)
+                sr << c;
+        for (char c : sb)
+            if (sa.find(c) == string::npos)
+                ss << c;
+        return sr.str() + ss.str();
+    }
+    static double einsum_size(const string &s, const vector<MKL_INT> &extents) {
+        double r = 1;
+        for (char c : s)
+            r *= (double)extents[(uint8_t)c];
+        return r;
+    }
+    // number of multiply-adds for contracting sa and sb
+    static double einsum_pair_flops(const string &sa, const string &sb,
+                                    const vector<MKL_INT> &extents) {
+        double r = einsum_size(sa, extents);
+        for (char c : sb)
+            if (sa.find(c) == string::npos)
+                r *= (double)extents[(uint8_t)c];
+        return r;
+    }
+    // contract operands i and j, the result is appended to the end
+    static void einsum_pair_apply(vector<string> &scripts, vector<int> &count,
+                                  int i, int j) {
+        string r = einsum_pair_script(scripts[i], scripts[j], count);
+        for (char c : scripts[i])
+            if (scripts[j].find(c) != string::npos)
+                count[(uint8_t)c] -= count[(uint8_t)c] == 2 ? 2 : 1;
+        scripts.erase(scripts.begin() + max(i, j));
+        scripts.erase(scripts.begin() + min(i, j));
+        scripts.push_back(r);
+    }
+    static void einsum_optimal_path(vector<string> &scripts, vector<int> &count,
+                                    const vector<MKL_INT> &extents,
+                                    vector<pair<int, int>> &path, double flops,
+                                    vector<pair<int, int>> &best_path,
+                                    double &best_flops) {
+        if (scripts.size() <= 1) {
+            if (flops < best_flops)
+                best_flops = flops, best_path = path;
+            return;
+        }
+        for (int i = 0; i < (int)scripts.size(); i++)
+            for (int j = i + 1; j < (int)scripts.size(); j++) {
+                double xflops =
+                    flops + einsum_pair_flops(scripts[i], scripts[j], extents);
+                if (xflops >= best_flops)
+                    continue;
+                vector<string> xscripts = scripts;
+                vector<int> xcount = count;
+                einsum_pair_apply(xscripts, xcount, i, j);
+                path.push_back(make_pair(i, j));
+                einsum_optimal_path(xscripts, xcount, extents, path, xflops,
+                                    best_path, best_flops);
+                path.pop_back();
+            }
+    }
+    // order of pairwise contractions, in the convention of opt_einsum
+    // scripts must not have repeated or internally summed indices
+    static vector<pair<int, int>>
+    einsum_path(vector<string> scripts, vector<int> count,
+                const vector<MKL_INT> &extents,
+                EinsumPathTypes path_type = EinsumPathTypes::Auto) {
+        vector<pair<int, int>> path;
+        const int n = (int)scripts.size();
+        if (path_type == EinsumPathTypes::Auto)
+            path_type = n <= 5 ? EinsumPathTypes::Optimal
+                               : EinsumPathTypes::Greedy;
+        if (n <= 1)
+            return path;
+        else if (path_type == EinsumPathTypes::Linear) {
+            path.push_back(make_pair(0, 1));
+            for (int i = 2; i < n; i++)
+                path.push_back(make_pair(n - i, 0));
+        } else if (path_type == EinsumPathTypes::Optimal) {
+            double best_flops = numeric_limits<double>::max();
+            vector<pair<int, int>> cur_path;
+            einsum_optimal_path(scripts, count, extents, cur_path, 0,
+                                path, best_flops);
+        } else {
+            // greedy: smallest growth of memory, then smallest flops
+            // outer products are only used when nothing is shared
+            while (scripts.size() > 1) {
+                int bi = -1, bj = -1;
+                double best_mem = 0, best_flops = 0;
+                bool any_shared = false;
+                for (int i = 0; i < (int)scripts.size() && !any_shared; i++)
+                    for (int j = i + 1; j < (int)scripts.size(); j++)
+                        if (scripts[i].find_first_of(scripts[j]) !=
+                            string::npos) {
+                            any_shared = true;
+                            break;
+                        }
+                for (int i = 0; i < (int)scripts.size(); i++)
+                    for (int j = i + 1; j < (int)scripts.size(); j++) {
+                        if (any_shared && scripts[i].find_first_of(
+                                              scripts[j]) == string::npos)
+                            continue;
+                        string r =
+                            einsum_pair_script(scripts[i], scripts[j], count);
+                        double mem = einsum_size(r, extents) -
+                                     einsum_size(scripts[i], extents) -
+                                     einsum_size(scripts[j], extents);
+                        double flops =
+                            einsum_pair_flops(scripts[i], scripts[j], extents);
+                        if (bi == -1 || mem < best_mem ||
+                            (mem == best_mem && flops < best_flops))
+                            bi = i, bj = j, best_mem = mem, best_flops = flops;
+                    }
+                path.push_back(make_pair(bi, bj));
+                einsum_pair_apply(scripts, count, bi, bj);
+            }
+        }
+        return path;
+    }
+    // cached contraction paths, keyed by script, shapes and path type
+    static map<string, vector<pair<int, int>>> &einsum_path_cache() {
+        static map<string, vector<pair<int, int>>> cache;
+        return cache;
+    }
+    static mutex &einsum_path_cache_mutex() {
+        static mutex mtx;
+        return mtx;
+    }
+    static NDArray
+    einsum(const string &script, const vector<NDArray> &arrs,
+           EinsumPathTypes path_type = EinsumPathTypes::Auto) {
+        NDArrayPoolScope pool_scope;
         // explicit mode has '->'
         bool explicit_mode = false;
         string result;
@@ -751,7 +1087,6 @@ struct NDArray {
         // for (int iop = 0; iop < operands.size() - 1; iop++)
         //     cout << operands[iop] << ",";
         // cout << operands.back() << "->" << result << endl;
-        // allow possible reorder in future
         vector<string> gscripts = operands;
         vector<NDArray> garrs = arrs;
         // now char_count representes the count of each index
@@ -804,7 +1139,7 @@ struct NDArray {
                         perm[kk++] = ii;
                 NDArray tmp = garrs[i].transpose(perm);
                 if (!tmp.is_c_order()) {
-                    NDArray tmp2(tmp.shape);
+                    NDArray tmp2 = NDArray::empty(tmp.shape);
                     NDArray::transpose(tmp, tmp2);
                     tmp = tmp2;
                 }
@@ -812,62 +1147,97 @@ struct NDArray {
                 gscripts[i] = newss.str();
             }
         }
+        // find contraction path
+        stringstream path_key;
+        path_key << script << ";" << (int)path_type;
+        for (auto &arr : arrs) {
+            path_key << ";";
+            for (auto &sh : arr.shape)
+                path_key << sh << ",";
+        }
+        vector<pair<int, int>> path;
+        {
+            lock_guard<mutex> lock(einsum_path_cache_mutex());
+            auto &cache = einsum_path_cache();
+            auto it = cache.find(path_key.str());
+            if (it != cache.end())
+                path = it->second;
+            else {
+                vector<MKL_INT> extents(_MAX_CHAR, 1);
+                for (int i = 0; i < (int)gscripts.size(); i++)
+                    for (int j = 0; j < gscripts[i].length(); j++)
+                        extents[(uint8_t)gscripts[i][j]] = garrs[i].shape[j];
+                path = cache[path_key.str()] = einsum_path(
+                    gscripts,
+                    vector<int>(char_count, char_count + _MAX_CHAR), extents,
+                    path_type);
+            }
+        }
         // perform tensordot
         vector<int> idxa, idxb, br_idxa, br_idxb;
         vector<MKL_INT> new_sh, new_br;
-        for (int i = 1; i < (int)gscripts.size(); i++) {
+        for (auto &pij : path) {
+            const int ia = pij.first, ib = pij.second;
             idxa.clear(), idxb.clear();
             br_idxa.clear(), br_idxb.clear();
             new_sh.clear(), new_br.clear();
             memset(char_map, 0, sizeof(int) * _MAX_CHAR);
-            for (int j = 0; j < gscripts[0].length(); j++)
-                char_map[gscripts[0][j]]++;
-            for (int j = 0; j < gscripts[i].length(); j++)
-                char_map[gscripts[i][j]]++;
+            for (int j = 0; j < gscripts[ia].length(); j++)
+                char_map[gscripts[ia][j]]++;
+            for (int j = 0; j < gscripts[ib].length(); j++)
+                char_map[gscripts[ib][j]]++;
             stringstream newss, newsr;
-            for (int j = 0; j < gscripts[0].length(); j++)
-                if (char_map[gscripts[0][j]] > 1) {
-                    if (char_map[gscripts[0][j]] == char_count[gscripts[0][j]])
+            for (int j = 0; j < gscripts[ia].length(); j++)
+                if (char_map[gscripts[ia][j]] > 1) {
+                    if (char_map[gscripts[ia][j]] ==
+                        char_count[gscripts[ia][j]])
                         idxa.push_back(j);
                     else
-                        br_idxa.push_back(j), newsr << gscripts[0][j],
-                            new_br.push_back(garrs[0].shape[j]);
+                        br_idxa.push_back(j), newsr << gscripts[ia][j],
+                            new_br.push_back(garrs[ia].shape[j]);
                 } else
-                    newss << gscripts[0][j],
-                        new_sh.push_back(garrs[0].shape[j]);
-            for (int j = 0; j < gscripts[i].length(); j++)
-                if (char_map[gscripts[i][j]] > 1) {
-                    if (char_map[gscripts[i][j]] == char_count[gscripts[i][j]])
+                    newss << gscripts[ia][j],
+                        new_sh.push_back(garrs[ia].shape[j]);
+            for (int j = 0; j < gscripts[ib].length(); j++)
+                if (char_map[gscripts[ib][j]] > 1) {
+                    if (char_map[gscripts[ib][j]] ==
+                        char_count[gscripts[ib][j]])
                         idxb.push_back(j);
                     else
                         br_idxb.push_back(j);
                 } else
-                    newss << gscripts[i][j],
-                        new_sh.push_back(garrs[i].shape[j]);
+                    newss << gscripts[ib][j],
+                        new_sh.push_back(garrs[ib].shape[j]);
             memset(char_map, -1, sizeof(int) * _MAX_CHAR);
             for (int j = 0; j < idxa.size(); j++)
-                char_map[gscripts[0][idxa[j]]] = j;
+                char_map[gscripts[ia][idxa[j]]] = j;
             for (int j = 0; j < br_idxa.size(); j++)
-                char_map[gscripts[0][br_idxa[j]]] = j;
+                char_map[gscripts[ia][br_idxa[j]]] = j;
             sort(idxb.begin(), idxb.end(),
-                 [&char_map, &gscripts, i](int a, int b) {
-                     return char_map[gscripts[i][a]] < char_map[gscripts[i][b]];
+                 [&char_map, &gscripts, ib](int a, int b) {
+                     return char_map[gscripts[ib][a]] <
+                            char_map[gscripts[ib][b]];
                  });
             sort(br_idxb.begin(), br_idxb.end(),
-                 [&char_map, &gscripts, i](int a, int b) {
-                     return char_map[gscripts[i][a]] < char_map[gscripts[i][b]];
+                 [&char_map, &gscripts, ib](int a, int b) {
+                     return char_map[gscripts[ib][a]] <
+                            char_map[gscripts[ib][b]];
                  });
             new_br.insert(new_br.end(), new_sh.begin(), new_sh.end());
-            NDArray tmp(new_br);
-            NDArray::tensordot(garrs[0], garrs[i], tmp, idxa, idxb, br_idxa,
-                               br_idxb);
+            NDArray tmp = NDArray::empty(new_br);
+            NDArray::tensordot(garrs[ia], garrs[ib], tmp, idxa, idxb,
+                               br_idxa, br_idxb);
             // remove contracted and broadcast index count
             for (auto &x : idxa)
-                char_count[gscripts[0][x]] -= 2;
+                char_count[gscripts[ia][x]] -= 2;
             for (auto &x : br_idxa)
-                char_count[gscripts[0][x]]--;
-            garrs[0] = tmp;
-            gscripts[0] = newsr.str() + newss.str();
+                char_count[gscripts[ia][x]]--;
+            garrs.erase(garrs.begin() + max(ia, ib));
+            garrs.erase(garrs.begin() + min(ia, ib));
+            gscripts.erase(gscripts.begin() + max(ia, ib));
+            gscripts.erase(gscripts.begin() + min(ia, ib));
+            garrs.push_back(tmp);
+            gscripts.push_back(newsr.str() + newss.str());
         }
         // final transpose (no copy)
         assert(gscripts[0].size() == result.size());
@@ -884,4 +1254,208 @@ struct NDArray {
     }
 };
 
+// n-dimensional array stored as tiles in a scratch file (out-of-core)
+// each tile is a C-order NDArray in a fixed-size slot of the file
+// tiles at the upper edges are smaller when the shape is not divisible
+struct BlockedNDArray {
+    vector<MKL_INT> shape, tile_shape;
+    string filename;
+    BlockedNDArray() {}
+    // create a zero array (as a sparse file)
+    BlockedNDArray(const vector<MKL_INT> &shape,
+                   const vector<MKL_INT> &tile_shape, const string &filename)
+        : shape(shape), tile_shape(tile_shape), filename(filename) {
+        assert(shape.size() == tile_shape.size());
+        ofstream ofs(filename.c_str(), ios::binary | ios::trunc);
+        if (!ofs.good())
+            throw runtime_error("BlockedNDArray on '" + filename +
+                                "' failed.");
+        const size_t total = n_tiles() * max_tile_size() * sizeof(double);
+        if (total != 0) {
+            ofs.seekp(total - 1);
+            ofs.put(0);
+        }
+        if (!ofs.good())
+            throw runtime_error("BlockedNDArray on '" + filename +
+                                "' failed.");
+        ofs.close();
+    }
+    int ndim() const { return (int)shape.size(); }
+    // number of tiles along each dim
+    vector<MKL_INT> grid() const {
+        vector<MKL_INT> r(ndim());
+        for (int i = 0; i < ndim(); i++)
+            r[i] = (shape[i] + tile_shape[i] - 1) / tile_shape[i];
+        return r;
+    }
+    size_t n_tiles() const {
+        vector<MKL_INT> g = grid();
+        return accumulate(g.cbegin(), g.cend(), (size_t)1,
+                          multiplies<size_t>());
+    }
+    size_t max_tile_size() const {
+        return accumulate(tile_shape.cbegin(), tile_shape.cend(), (size_t)1,
+                          multiplies<size_t>());
+    }
+    static vector<MKL_INT> unravel(size_t i, const vector<MKL_INT> &g) {
+        vector<MKL_INT> r(g.size());
+        for (int k = (int)g.size() - 1; k >= 0; i /= g[k], k--)
+            r[k] = (MKL_INT)(i % g[k]);
+        return r;
+    }
+    size_t tile_id(const vector<MKL_INT> &tidx) const {
+        vector<MKL_INT> g = grid();
+        size_t r = 0;
+        for (int i = 0; i < ndim(); i++)
+            r = r * g[i] + tidx[i];
+        return r;
+    }
+    vector<MKL_INT> tile_extents(const vector<MKL_INT> &tidx) const {
+        vector<MKL_INT> r(ndim());
+        for (int i = 0; i < ndim(); i++)
+            r[i] = min(tile_shape[i], shape[i] - tidx[i] * tile_shape[i]);
+        return r;
+    }
+    NDArray read_tile(const vector<MKL_INT> &tidx) const {
+        NDArray r = NDArray::empty(tile_extents(tidx));
+        ifstream ifs(filename.c_str(), ios::binary);
+        ifs.seekg(tile_id(tidx) * max_tile_size() * sizeof(double));
+        ifs.read((char *)r.data, sizeof(double) * r.size());
+        if (!ifs.good())
+            throw runtime_error("BlockedNDArray::read_tile on '" + filename +
+                                "' failed.");
+        ifs.close();
+        return r;
+    }
+    void write_tile(const vector<MKL_INT> &tidx, const NDArray &x) const {
+        assert(x.shape == tile_extents(tidx));
+        NDArray xc = x.to_c_order();
+        fstream fs(filename.c_str(), ios::binary | ios::in | ios::out);
+        fs.seekp(tile_id(tidx) * max_tile_size() * sizeof(double));
+        fs.write((char *)xc.data, sizeof(double) * xc.size());
+        if (!fs.good())
+            throw runtime_error("BlockedNDArray::write_tile on '" + filename +
+                                "' failed.");
+        fs.close();
+    }
+    // view (no copy) of the part of x covered by one tile
+    NDArray tile_view(const NDArray &x, const vector<MKL_INT> &tidx) const {
+        ssize_t offset = 0;
+        for (int i = 0; i < ndim(); i++)
+            offset += x.strides[i] * tidx[i] * tile_shape[i];
+        NDArray r(tile_extents(tidx), x.strides, x.data + offset);
+        r.vdata = x.vdata;
+        return r;
+    }
+    static BlockedNDArray from_array(const NDArray &x,
+                                     const vector<MKL_INT> &tile_shape,
+                                     const string &filename) {
+        BlockedNDArray r(x.shape, tile_shape, filename);
+        const vector<MKL_INT> g = r.grid();
+        for (size_t it = 0, nt = r.n_tiles(); it < nt; it++) {
+            vector<MKL_INT> tidx = unravel(it, g);
+            r.write_tile(tidx, r.tile_view(x, tidx));
+        }
+        return r;
+    }
+    NDArray to_array() const {
+        NDArray r = NDArray::empty(shape);
+        const vector<MKL_INT> g = grid();
+        for (size_t it = 0, nt = n_tiles(); it < nt; it++) {
+            vector<MKL_INT> tidx = unravel(it, g);
+            NDArray tile = read_tile(tidx), view = tile_view(r, tidx);
+            for (size_t i = 0, sz = tile.size(); i < sz; i++)
+                view.data[view.linear_index(i)] = tile.data[i];
+        }
+        return r;
+    }
+    // delete the scratch file
+    void remove() const { std::remove(filename.c_str()); }
+    // c = alpha * a . b + beta * c, with output dims of c: free a, free b
+    // the contracted dims of a and b (and the output dims of c) must use
+    // the same tile extents. For each tile row of free a indices,
+    // the panel of a tiles is read once and kept in memory,
+    // while tiles of b are streamed from disk; so the peak memory is
+    // about one row of a tiles, one b tile and one c tile
+    static void tensordot(const BlockedNDArray &a, const BlockedNDArray &b,
+                          const BlockedNDArray &c, const vector<int> &idxa,
+                          const vector<int> &idxb, double alpha = 1.0,
+                          double beta = 0.0) {
+        assert(idxa.size() == idxb.size());
+        const int nctr = (int)idxa.size();
+        vector<bool> ctra(a.ndim(), false), ctrb(b.ndim(), false);
+        for (int i = 0; i < nctr; i++) {
+            if (a.shape[idxa[i]] != b.shape[idxb[i]] ||
+                a.tile_shape[idxa[i]] != b.tile_shape[idxb[i]])
+                throw runtime_error("BlockedNDArray::tensordot: shape or tile "
+                                    "shape of contracted dims do not match.");
+            ctra[idxa[i]] = ctrb[idxb[i]] = true;
+        }
+        vector<int> outa, outb;
+        for (int i = 0; i < a.ndim(); i++)
+            if (!ctra[i])
+                outa.push_back(i);
+        for (int i = 0; i < b.ndim(); i++)
+            if (!ctrb[i])
+                outb.push_back(i);
+        if ((int)(outa.size() + outb.size()) != c.ndim())
+            throw runtime_error(
+                "BlockedNDArray::tensordot: wrong number of output dims.");
+        for (int i = 0; i < c.ndim(); i++) {
+            const BlockedNDArray &x = i < (int)outa.size() ? a : b;
+            const int ix = i < (int)outa.size() ? outa[i]
+                                                : outb[i - (int)outa.size()];
+            if (c.shape[i] != x.shape[ix] ||
+                c.tile_shape[i] != x.tile_shape[ix])
+                throw runtime_error("BlockedNDArray::tensordot: shape or tile "
+                                    "shape of output dims do not match.");
+        }
+        const vector<MKL_INT> ga = a.grid(), gb = b.grid();
+        vector<MKL_INT> gfa, gfb, gctr;
+        for (auto &i : outa)
+            gfa.push_back(ga[i]);
+        for (auto &i : outb)
+            gfb.push_back(gb[i]);
+        for (auto &i : idxa)
+            gctr.push_back(ga[i]);
+        auto grid_size = [](const vector<MKL_INT> &g) -> size_t {
+            return accumulate(g.cbegin(), g.cend(), (size_t)1,
+                              multiplies<size_t>());
+        };
+        const size_t nfa = grid_size(gfa), nfb = grid_size(gfb),
+                     nk = grid_size(gctr);
+        vector<MKL_INT> tidxa(a.ndim()), tidxb(b.ndim()), tidxc(c.ndim());
+        NDArrayPoolScope pool_scope;
+        vector<NDArray> apanel(nk);
+        for (size_t ifa = 0; ifa < nfa; ifa++) {
+            vector<MKL_INT> xfa = unravel(ifa, gfa);
+            for (int i = 0; i < (int)outa.size(); i++)
+                tidxa[outa[i]] = tidxc[i] = xfa[i];
+            for (size_t k = 0; k < nk; k++) {
+                vector<MKL_INT> xk = unravel(k, gctr);
+                for (int i = 0; i < nctr; i++)
+                    tidxa[idxa[i]] = xk[i];
+                apanel[k] = a.read_tile(tidxa);
+            }
+            for (size_t ifb = 0; ifb < nfb; ifb++) {
+                vector<MKL_INT> xfb = unravel(ifb, gfb);
+                for (int i = 0; i < (int)outb.size(); i++)
+                    tidxb[outb[i]] = tidxc[i + outa.size()] = xfb[i];
+                NDArray tc = beta == 0.0
+                                 ? NDArray::empty(c.tile_extents(tidxc))
+                                 : c.read_tile(tidxc);
+                for (size_t k = 0; k < nk; k++) {
+                    vector<MKL_INT> xk = unravel(k, gctr);
+                    for (int i = 0; i < nctr; i++)
+                        tidxb[idxb[i]] = xk[i];
+                    NDArray::tensordot(apanel[k], b.read_tile(tidxb), tc, idxa,
+                                       idxb, {}, {}, alpha,
+                                       k == 0 ? beta : 1.0);
+                }
+                c.write_tile(tidxc, tc);
+            }
+        }
+    }
+};
+
 } // namespace block2
@@ -35,6 +35,7 @@
 #include <set>
 #include <sstream>
 #include <string>
+#include <unordered_map>
 #include <unordered_set>
 #include <vector>
 
@@ -350,6 +351,13 @@ struct WickTensor {
                           : (type == other.type ? indices < other.indices
                                                 : type < other.type));
     }
+    size_t hash() const noexcept {
+        size_t h = std::hash<string>{}(name) ^ (size_t)type;
+        for (auto &wi : indices)
+            h ^= (wi.hash() ^ (size_t)wi.types) + 0x9E3779B9 + (h << 6) +
+                 (h >> 2);
+        return h;
+    }
     WickTensor operator*(const WickPermutation &perm) const noexcept {
         vector<WickIndex> xindices(indices.size());
         for (int i = 0; i < (int)indices.size(); i++)
@@ -439,17 +447,46 @@ struct WickTensor {
             name, WickIndex::add_types(vector<WickIndex>{index}, idx_map),
             WickPermutation::non_symmetric(), WickTensorTypes::DestroyOperator);
     }
+    // the canonical permutation only depends on name, type, perms and the
+    // relative order of indices, so it is memoized using these as key
     WickTensor sort(double &factor) const {
-        WickTensor x = *this;
-        bool neg = false;
+        static thread_local unordered_map<string, int> cache;
+        string key = name;
+        key.reserve(name.length() + 2 + indices.size() +
+                    perms.size() * (indices.size() + 1));
+        key.push_back('\0');
+        key.push_back((char)type);
+        // number of smaller indices keeps the order relations of indices
+        for (auto &wi : indices) {
+            char rank = 0;
+            for (auto &wj : indices)
+                rank += wj < wi;
+            key.push_back(rank);
+        }
         for (auto &perm : perms) {
-            WickTensor z = *this * perm;
-            if (z.indices < x.indices)
-                x = z, neg = perm.negative;
+            key.push_back((char)perm.negative);
+            for (auto &d : perm.data)
+                key.push_back((char)d);
         }
-        if (neg)
+        auto it = cache.find(key);
+        int ip = -1;
+        if (it != cache.end())
+            ip = it->second;
+        else {
+            vector<WickIndex> xindices = indices, zindices(indices.size());
+            for (int i = 0; i < (int)perms.size(); i++) {
+                for (int j = 0; j < (int)indices.size(); j++)
+                    zindices[j] = indices[perms[i].data[j]];
+                if (zindices < xindices)
+                    xindices = zindices, ip = i;
+            }
+            cache[key] = ip;
+        }
+        if (ip == -1)
+            return *this;
+        if (perms[ip].negative)
             factor = -factor;
-        return x;
+        return *this * perms[ip];
     }
     vector<pair<map<WickIndex, int>, int>>
     sort_gen_maps(const WickTensor &ref, const set<WickIndex> &ctr_idxs,
@@ -752,6 +789,17 @@ struct WickString {
     WickString operator*(double d) const noexcept {
         return WickString(tensors, ctr_indices, factor * d);
     }
+    // hash ignoring factor, consistent with abs_equal_to
+    // only meaningful after canonicalization by quick_sort
+    size_t abs_hash() const noexcept {
+        size_t h = (tensors.size() << 8) ^ ctr_indices.size();
+        for (auto &wt : tensors)
+            h ^= wt.hash() + 0x9E3779B9 + (h << 6) + (h >> 2);
+        for (auto &wi : ctr_indices)
+            h ^= (wi.hash() ^ (size_t)wi.types) + 0x9E3779B9 + (h << 6) +
+                 (h >> 2);
+        return h;
+    }
     WickString abs() const { return WickString(tensors, ctr_indices); }
     bool group_less(const WickString &other) const noexcept {
         const static vector<WickTensorTypes> wtts = {
@@ -1207,13 +1255,15 @@ struct WickExpr {
     }
     WickExpr normal_order_impl(int max_unctr = -1, bool no_ctr = false) const {
         int ntg = threading->activate_global();
-        vector<WickExpr> r(ntg);
-#pragma omp parallel for schedule(static) num_threads(ntg)
-        for (int k = 0; k < (int)terms.size(); k++) {
-            int tid = threading->get_thread_id();
-            WickExpr rr = normal_order_impl_new(terms[k], max_unctr, no_ctr);
-            r[tid].terms.insert(r[tid].terms.end(), rr.terms.begin(),
-                                rr.terms.end());
+        vector<WickExpr> r(terms.size());
+        // with few (long) operator strings, parallelize inside each string
+        if ((int)terms.size() < ntg * 2) {
+            for (int k = 0; k < (int)terms.size(); k++)
+                r[k] = normal_order_impl_new(terms[k], max_unctr, no_ctr, ntg);
+        } else {
+#pragma omp parallel for schedule(dynamic) num_threads(ntg)
+            for (int k = 0; k < (int)terms.size(); k++)
+                r[k] = normal_order_impl_new(terms[k], max_unctr, no_ctr);
         }
         threading->activate_normal();
         WickExpr rx;
@@ -1396,9 +1446,11 @@ struct WickExpr {
         }
         return r;
     }
+    // n_threads > 1: top-level contraction branches are traversed in parallel
     static WickExpr normal_order_impl_new(const WickString &x,
                                           int max_unctr = -1,
-                                          bool no_ctr = false) {
+                                          bool no_ctr = false,
+                                          int n_threads = 1) {
         WickExpr r;
         bool cd_type = any_of(
             x.tensors.begin(), x.tensors.end(), [](const WickTensor &wt) {
@@ -1412,7 +1464,7 @@ struct WickExpr {
         assert(!cd_type || !sf_type);
         vector<WickTensor> cd_tensors, ot_tensors;
         vector<int> cd_idx_map, n_inactive_idxs;
-        int init_sign = 0, final_sign = 0;
+        int init_sign = 0;
         cd_tensors.reserve(x.tensors.size());
         ot_tensors.reserve(x.tensors.size());
         for (auto &wt : x.tensors)
@@ -1471,10 +1523,7 @@ struct WickExpr {
             n_inactive_idxs[i] += n_inactive_idxs[i + 1];
         vector<pair<int, int>> que;
         vector<pair<int, int>> cur_idxs(cd_tensors.size());
-        vector<int8_t> cur_idxs_mask(cd_tensors.size(), 0);
-        vector<int8_t> inactive_mask(cd_tensors.size(), 0);
         vector<int> tensor_idxs(cd_tensors.size()), rev_idxs(cd_tensors.size());
-        vector<int> cd_idx_map_rev(cd_tensors.size());
         vector<int> acc_sign(cd_tensors.size() + 1);
         if (max_unctr != 0 || cd_tensors.size() % 2 == 0) {
             que.push_back(make_pair(-1, -1));
@@ -1506,124 +1555,165 @@ struct WickExpr {
                         acc_sign[0] ^= (rev_idxs[j] < rev_idxs[i]);
             }
         }
-        // depth-first tree traverse
-        while (!que.empty()) {
-            int l = que.back().first, j = que.back().second, k = 0;
-            que.pop_back();
-            int a, b, c, d, n_inact = 0;
-            double inact_fac = 1.0;
-            if (l != -1) {
-                cur_idxs[l] = ctr_idxs[j];
-                k = ctr_cd_idxs[ctr_idxs[j].first + 1];
-            }
-            acc_sign[l + 2] = acc_sign[l + 1];
-            ot_tensors.resize(ot_count + l + 1);
-            memset(cur_idxs_mask.data(), 0,
-                   sizeof(int8_t) * cur_idxs_mask.size());
-            if (sf_type) {
-                memcpy(cd_idx_map_rev.data(), cd_idx_map.data(),
-                       sizeof(int) * cd_idx_map.size());
-                memset(inactive_mask.data(), 0,
-                       sizeof(int8_t) * inactive_mask.size());
-            }
-            if (l != -1) {
-                tie(c, d) = cur_idxs[l];
-                bool skip = false;
-                acc_sign[l + 2] ^= ((c ^ d) & 1) ^ 1;
-                // add contraction crossing sign from c/d
-                for (int i = 0; i < l && !skip; i++) {
-                    tie(a, b) = cur_idxs[i];
-                    skip |= (b == d || b == c || a == d);
-                    cur_idxs_mask[a] = cur_idxs_mask[b] = 1;
-                    acc_sign[l + 2] ^= ((a < c && b > c && b < d) ||
-                                        (a > c && a < d && b > d));
+        // depth-first tree traverse from the nodes in que
+        // only the root node is visited if single is true
+        auto traverse = [&](vector<pair<int, int>> &que,
+                            vector<pair<int, int>> &cur_idxs,
+                            vector<int> &rev_idxs, vector<int> &acc_sign,
+                            vector<WickTensor> &ot_tensors, WickExpr &r,
+                            bool single) {
+            vector<int8_t> cur_idxs_mask(cd_tensors.size(), 0);
+            vector<int8_t> inactive_mask(cd_tensors.size(), 0);
+            vector<int> cd_idx_map_rev(cd_tensors.size());
+            int final_sign = 0;
+            for (int n_visited = 0; !que.empty() && !(single && n_visited == 1);
+                 n_visited++) {
+                int l = que.back().first, j = que.back().second, k = 0;
+                que.pop_back();
+                int a, b, c, d, n_inact = 0;
+                double inact_fac = 1.0;
+                if (l != -1) {
+                    cur_idxs[l] = ctr_idxs[j];
+                    k = ctr_cd_idxs[ctr_idxs[j].first + 1];
                 }
-                if (skip)
-                    continue;
-                cur_idxs_mask[c] = cur_idxs_mask[d] = 1;
+                acc_sign[l + 2] = acc_sign[l + 1];
+                ot_tensors.resize(ot_count + l + 1);
+                memset(cur_idxs_mask.data(), 0,
+                       sizeof(int8_t) * cur_idxs_mask.size());
                 if (sf_type) {
-                    n_inact = 0;
-                    for (int i = 0; i < l; i++) {
+                    memcpy(cd_idx_map_rev.data(), cd_idx_map.data(),
+                           sizeof(int) * cd_idx_map.size());
+                    memset(inactive_mask.data(), 0,
+                           sizeof(int8_t) * inactive_mask.size());
+                }
+                if (l != -1) {
+                    tie(c, d) = cur_idxs[l];
+                    bool skip = false;
+                    acc_sign[l + 2] ^= ((c ^ d) & 1) ^ 1;
+                    // add contraction crossing sign from c/d
+                    for (int i = 0; i < l && !skip; i++) {
                         tie(a, b) = cur_idxs[i];
-                        inactive_mask[a] |=
-                            n_inactive_idxs[a] - n_inactive_idxs[a + 1];
-                        inactive_mask[b] |=
-                            n_inactive_idxs[b] - n_inactive_idxs[b + 1];
-                        inactive_mask[cd_idx_map_rev[a]] |= inactive_mask[a];
-                        inactive_mask[cd_idx_map_rev[b]] |= inactive_mask[b];
-                        n_inact += n_inactive_idxs[a] - n_inactive_idxs[a + 1];
+                        skip |= (b == d || b == c || a == d);
+                        cur_idxs_mask[a] = cur_idxs_mask[b] = 1;
+                        acc_sign[l + 2] ^= ((a < c && b > c && b < d) ||
+                                            (a > c && a < d && b > d));
+                    }
+                    if (skip)
+                        continue;
+                    cur_idxs_mask[c] = cur_idxs_mask[d] = 1;
+                    if (sf_type) {
+                        n_inact = 0;
+                        for (int i = 0; i < l; i++) {
+                            tie(a, b) = cur_idxs[i];
+                            inactive_mask[a] |=
+                                n_inactive_idxs[a] - n_inactive_idxs[a + 1];
+                            inactive_mask[b] |=
+                                n_inactive_idxs[b] - n_inactive_idxs[b + 1];
+                            inactive_mask[cd_idx_map_rev[a]] |=
+                                inactive_mask[a];
+                            inactive_mask[cd_idx_map_rev[b]] |=
+                                inactive_mask[b];
+                            n_inact +=
+                                n_inactive_idxs[a] - n_inactive_idxs[a + 1];
+                            inact_fac *= 1 << ((cd_idx_map_rev[a] == b) &
+                                               inactive_mask[a]);
+                            cd_idx_map_rev[cd_idx_map_rev[a]] =
+                                cd_idx_map_rev[b];
+                            cd_idx_map_rev[cd_idx_map_rev[b]] =
+                                cd_idx_map_rev[a];
+                        }
+                        inactive_mask[c] |=
+                            n_inactive_idxs[c] - n_inactive_idxs[c + 1];
+                        inactive_mask[d] |=
+                            n_inactive_idxs[d] - n_inactive_idxs[d + 1];
+                        inactive_mask[cd_idx_map_rev[c]] |= inactive_mask[c];
+                        inactive_mask[cd_idx_map_rev[d]] |= inactive_mask[d];
+                        n_inact += n_inactive_idxs[c] - n_inactive_idxs[c + 1];
+                        // inactive must be all contracted
+                        if (n_inact + n_inactive_idxs[c + 1] <
+                            n_inactive_idxs[0])
+                            continue;
                         inact_fac *=
-                            1 << ((cd_idx_map_rev[a] == b) & inactive_mask[a]);
-                        cd_idx_map_rev[cd_idx_map_rev[a]] = cd_idx_map_rev[b];
-                        cd_idx_map_rev[cd_idx_map_rev[b]] = cd_idx_map_rev[a];
+                            1 << ((cd_idx_map_rev[c] == d) & inactive_mask[c]);
+                        cd_idx_map_rev[cd_idx_map_rev[c]] = cd_idx_map_rev[d];
+                        cd_idx_map_rev[cd_idx_map_rev[d]] = cd_idx_map_rev[c];
+                    } else {
+                        // remove tensor reorder sign for c/d
+                        acc_sign[l + 2] ^= (rev_idxs[d] < rev_idxs[c]);
+                        for (int i = 0; i < (int)rev_idxs.size(); i++)
+                            if (!cur_idxs_mask[i]) {
+                                acc_sign[l + 2] ^=
+                                    (rev_idxs[max(c, i)] < rev_idxs[min(c, i)]);
+                                acc_sign[l + 2] ^=
+                                    (rev_idxs[max(d, i)] < rev_idxs[min(d, i)]);
+                            }
                     }
-                    inactive_mask[c] |=
-                        n_inactive_idxs[c] - n_inactive_idxs[c + 1];
-                    inactive_mask[d] |=
-                        n_inactive_idxs[d] - n_inactive_idxs[d + 1];
-                    inactive_mask[cd_idx_map_rev[c]] |= inactive_mask[c];
-                    inactive_mask[cd_idx_map_rev[d]] |= inactive_mask[d];
-                    n_inact += n_inactive_idxs[c] - n_inactive_idxs[c + 1];
-                    // inactive must be all contracted
-                    if (n_inact + n_inactive_idxs[c + 1] < n_inactive_idxs[0])
+                    ot_tensors[ot_count + l] =
+                        WickTensor::kronecker_delta(
+                            vector<WickIndex>{cd_tensors[c].indices[0],
+                                              cd_tensors[d].indices[0]});
+                }
+                // push next contraction order to queue
+                if (!no_ctr)
+                    for (; k < (int)ctr_idxs.size(); k++)
+                        que.push_back(make_pair(l + 1, k));
+                if (max_unctr != -1 &&
+                    cd_tensors.size() - (l + l + 2) > max_unctr)
+                    continue;
+                if (sf_type) {
+                    if (n_inact < n_inactive_idxs[0])
                         continue;
-                    inact_fac *=
-                        1 << ((cd_idx_map_rev[c] == d) & inactive_mask[c]);
-                    cd_idx_map_rev[cd_idx_map_rev[c]] = cd_idx_map_rev[d];
-                    cd_idx_map_rev[cd_idx_map_rev[d]] = cd_idx_map_rev[c];
-                } else {
-                    // remove tensor reorder sign for c/d
-                    acc_sign[l + 2] ^= (rev_idxs[d] < rev_idxs[c]);
-                    for (int i = 0; i < (int)rev_idxs.size(); i++)
-                        if (!cur_idxs_mask[i]) {
-                            acc_sign[l + 2] ^=
-                                (rev_idxs[max(c, i)] < rev_idxs[min(c, i)]);
-                            acc_sign[l + 2] ^=
-                                (rev_idxs[max(d, i)] < rev_idxs[min(d, i)]);
+                    int sf_n = cd_tensors.size() / 2, tn = sf_n - l - 1;
+                    vector<WickIndex> wis(tn * 2);
+                    for (int i = 0, k = 0; i < (int)tensor_idxs.size(); i++)
+                        if (!cur_idxs_mask[tensor_idxs[i]] &&
+                            cd_tensors[tensor_idxs[i]].type ==
+                                WickTensorTypes::CreationOperator) {
+                            rev_idxs[k] = tensor_idxs[i];
+                            rev_idxs[k + tn] = cd_idx_map_rev[tensor_idxs[i]];
+                            k++;
                         }
+                    for (int i = 0; i < tn + tn; i++)
+                        wis[i] = cd_tensors[rev_idxs[i]].indices[0];
+                    // sign for reversing destroy operator
+                    final_sign = ((tn - 1) & 1) ^ (((tn - 1) & 2) >> 1);
+                    // sign for reordering tensors to the normal order
+                    for (int i = 0; i < (int)(tn + tn); i++)
+                        for (int j = i + 1; j < (int)(tn + tn); j++)
+                            final_sign ^= (rev_idxs[j] < rev_idxs[i]);
+                    if (wis.size() != 0)
+                        ot_tensors.push_back(WickTensor::spin_free(wis));
+                } else {
+                    for (int i = 0; i < (int)tensor_idxs.size(); i++)
+                        if (!cur_idxs_mask[tensor_idxs[i]])
+                            ot_tensors.push_back(cd_tensors[tensor_idxs[i]]);
                 }
-                ot_tensors[ot_count + l] =
-                    WickTensor::kronecker_delta(vector<WickIndex>{
-                        cd_tensors[c].indices[0], cd_tensors[d].indices[0]});
+                r.terms.push_back(WickString(
+                    ot_tensors, x.ctr_indices,
+                    inact_fac * ((acc_sign[l + 2] ^ final_sign) ? -x.factor
+                                                                : x.factor)));
             }
-            // push next contraction order to queue
-            if (!no_ctr)
-                for (; k < (int)ctr_idxs.size(); k++)
-                    que.push_back(make_pair(l + 1, k));
-            if (max_unctr != -1 && cd_tensors.size() - (l + l + 2) > max_unctr)
-                continue;
-            if (sf_type) {
-                if (n_inact < n_inactive_idxs[0])
-                    continue;
-                int sf_n = cd_tensors.size() / 2, tn = sf_n - l - 1;
-                vector<WickIndex> wis(tn * 2);
-                for (int i = 0, k = 0; i < (int)tensor_idxs.size(); i++)
-                    if (!cur_idxs_mask[tensor_idxs[i]] &&
-                        cd_tensors[tensor_idxs[i]].type ==
-                            WickTensorTypes::CreationOperator) {
-                        rev_idxs[k] = tensor_idxs[i];
-                        rev_idxs[k + tn] = cd_idx_map_rev[tensor_idxs[i]];
-                        k++;
-                    }
-                for (int i = 0; i < tn + tn; i++)
-                    wis[i] = cd_tensors[rev_idxs[i]].indices[0];
-                // sign for reversing destroy operator
-                final_sign = ((tn - 1) & 1) ^ (((tn - 1) & 2) >> 1);
-                // sign for reordering tensors to the normal order
-                for (int i = 0; i < (int)(tn + tn); i++)
-                    for (int j = i + 1; j < (int)(tn + tn); j++)
-                        final_sign ^= (rev_idxs[j] < rev_idxs[i]);
-                if (wis.size() != 0)
-                    ot_tensors.push_back(WickTensor::spin_free(wis));
-            } else {
-                for (int i = 0; i < (int)tensor_idxs.size(); i++)
-                    if (!cur_idxs_mask[tensor_idxs[i]])
-                        ot_tensors.push_back(cd_tensors[tensor_idxs[i]]);
+        };
+        if (n_threads <= 1 || que.empty())
+            traverse(que, cur_idxs, rev_idxs, acc_sign, ot_tensors, r, false);
+        else {
+            // the root leaves all top-level branches in que
+            traverse(que, cur_idxs, rev_idxs, acc_sign, ot_tensors, r, true);
+            const vector<pair<int, int>> branches = que;
+            vector<WickExpr> rs(branches.size());
+#pragma omp parallel for schedule(dynamic) num_threads(n_threads)
+            for (int ib = 0; ib < (int)branches.size(); ib++) {
+                vector<pair<int, int>> xque = {branches[ib]};
+                vector<pair<int, int>> xcur_idxs = cur_idxs;
+                vector<int> xrev_idxs = rev_idxs, xacc_sign = acc_sign;
+                vector<WickTensor> xot_tensors = ot_tensors;
+                traverse(xque, xcur_idxs, xrev_idxs, xacc_sign, xot_tensors,
+                         rs[ib], false);
             }
-            r.terms.push_back(WickString(
-                ot_tensors, x.ctr_indices,
-                inact_fac *
-                    ((acc_sign[l + 2] ^ final_sign) ? -x.factor : x.factor)));
+            // same order as the serial traverse (last branch first)
+            for (int ib = (int)branches.size() - 1; ib >= 0; ib--)
+                r.terms.insert(r.terms.end(), rs[ib].terms.begin(),
+                               rs[ib].terms.end());
         }
         return r;
     }
@@ -1701,22 +1791,33 @@ struct WickExpr {
     }
     WickExpr simplify_merge() const {
         vector<WickString> sorted(terms.size());
+        vector<size_t> hashes(terms.size());
         vector<pair<int, double>> ridxs;
         int ntg = threading->activate_global();
-#pragma omp parallel for schedule(static) num_threads(ntg)
-        for (int k = 0; k < (int)terms.size(); k++)
+#pragma omp parallel for schedule(dynamic) num_threads(ntg)
+        for (int k = 0; k < (int)terms.size(); k++) {
             sorted[k] = terms[k].abs().quick_sort();
+            hashes[k] = sorted[k].abs_hash();
+        }
         threading->activate_normal();
+        // canonical hash -> indices in ridxs (chained for collisions)
+        unordered_map<size_t, vector<int>> ridx_map;
+        ridx_map.reserve(terms.size());
         for (int i = 0; i < (int)terms.size(); i++) {
             bool found = false;
-            for (int j = 0; j < (int)ridxs.size() && !found; j++)
+            vector<int> &jxs = ridx_map[hashes[i]];
+            for (int jx = 0; jx < (int)jxs.size() && !found; jx++) {
+                const int j = jxs[jx];
                 if (sorted[i].abs_equal_to(sorted[ridxs[j].first])) {
                     found = true;
                     ridxs[j].second += terms[i].factor * sorted[i].factor *
                                        sorted[ridxs[j].first].factor;
                 }
-            if (!found)
+            }
+            if (!found) {
+                jxs.push_back((int)ridxs.size());
                 ridxs.push_back(make_pair(i, terms[i].factor));
+            }
         }
         WickExpr r;
         for (auto &m : ridxs) {
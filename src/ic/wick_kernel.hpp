@@ -0,0 +1,346 @@
+
+/*
+ * block2: Efficient MPO implementation of quantum chemistry DMRG
+ * Copyright (C) 2020-2021 Huanchen Zhai <hczhai@caltech.edu>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+/** Native evaluation of Wick expressions as pairwise tensor contractions. */
+
+#pragma once
+
+#include "nd_array.hpp"
+#include "wick.hpp"
+#include <limits>
+#include <map>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+namespace block2 {
+
+// One contraction of one or two operands (einsum script)
+// Operand id >= 0 is the result of an earlier step
+// Operand id < 0 is the input tensor (-id - 1)
+struct WickKernelStep {
+    static const int none = numeric_limits<int>::min();
+    int a, b;
+    string script;
+    WickKernelStep(int a, int b, const string &script)
+        : a(a), b(b), script(script) {}
+};
+
+// A WickExpr compiled into an ordered list of pairwise contractions
+// Intermediates shared by several terms are only computed once
+struct WickKernel {
+    // names of input tensors, in the convention of WickExpr::to_einsum
+    vector<string> inputs;
+    vector<WickKernelStep> steps;
+    // (operand id, factor) of each term, accumulated into the result
+    // operand id is WickKernelStep::none for constant terms
+    vector<pair<int, double>> terms;
+    // (input id, axis) for the extent of each output index
+    vector<pair<int, int>> out_src;
+    vector<MKL_INT> out_extents;
+    WickKernel() {}
+    static string input_name(const WickTensor &wt) {
+        string r = wt.name;
+        if (wt.type == WickTensorTypes::KroneckerDelta ||
+            wt.type == WickTensorTypes::Tensor)
+            for (auto &wi : wt.indices)
+                r += to_str(wi.types);
+        return r;
+    }
+    static MKL_INT
+    type_extent(WickIndexTypes types,
+                const map<WickIndexTypes, MKL_INT> &type_extents) {
+        if (type_extents.count(types))
+            return type_extents.at(types);
+        MKL_INT r = 0;
+        for (auto &te : type_extents)
+            if (te.first != WickIndexTypes::None &&
+                (te.first & types) == te.first &&
+                !((uint8_t)te.first & ((uint8_t)te.first - 1)))
+                r += te.second;
+        return r == 0 ? 1 : r;
+    }
+    // relabel characters by order of first appearance in ref
+    static string relabel(const string &x, const string &ref) {
+        string r = x;
+        for (auto &c : r)
+            c = (char)('a' + ref.find(c));
+        return r;
+    }
+    // distinct characters by order of first appearance
+    static string unique_chars(const string &x) {
+        string r;
+        for (char c : x)
+            if (r.find(c) == string::npos)
+                r.push_back(c);
+        return r;
+    }
+    static string operand_key(int id, const string &script) {
+        return to_string(id) + ":" + relabel(script, script);
+    }
+    // x: result tensor, only its indices are used
+    // type_extents: dimension of each index space, for choosing the path
+    static WickKernel
+    compile(const WickExpr &expr, const WickTensor &x,
+            const map<WickIndexTypes, MKL_INT> &type_extents,
+            EinsumPathTypes path_type = EinsumPathTypes::Auto) {
+        const string labels =
+            "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ";
+        WickKernel r;
+        map<string, int> input_map, step_map;
+        r.out_src.resize(x.indices.size(), make_pair(-1, -1));
+        r.out_extents.resize(x.indices.size());
+        for (int i = 0; i < (int)x.indices.size(); i++)
+            r.out_extents[i] = type_extent(x.indices[i].types, type_extents);
+        for (auto &term : expr.terms) {
+            if (term.tensors.size() == 0) {
+                r.terms.push_back(
+                    make_pair((int)WickKernelStep::none, term.factor));
+                continue;
+            }
+            map<WickIndex, char> mp;
+            vector<MKL_INT> extents(256, 1);
+            auto get_label = [&mp, &labels, &extents,
+                              &type_extents](const WickIndex &wi) -> char {
+                if (!mp.count(wi)) {
+                    if (mp.size() == labels.length())
+                        throw runtime_error(
+                            "WickKernel: too many indices in one term");
+                    char c = labels[mp.size()];
+                    mp[wi] = c;
+                    extents[(uint8_t)c] = type_extent(wi.types, type_extents);
+                }
+                return mp.at(wi);
+            };
+            vector<pair<int, string>> nodes;
+            vector<int> count(256, 0);
+            for (auto &wt : term.tensors) {
+                string name = input_name(wt);
+                if (!input_map.count(name)) {
+                    input_map[name] = (int)r.inputs.size();
+                    r.inputs.push_back(name);
+                }
+                const int iid = input_map.at(name);
+                string script;
+                for (int k = 0; k < (int)wt.indices.size(); k++) {
+                    script.push_back(get_label(wt.indices[k]));
+                    for (int j = 0; j < (int)x.indices.size(); j++)
+                        if (r.out_src[j].first == -1 &&
+                            x.indices[j] == wt.indices[k])
+                            r.out_src[j] = make_pair(iid, k);
+                }
+                nodes.push_back(make_pair(-iid - 1, script));
+            }
+            string out_script;
+            for (auto &wi : x.indices) {
+                if (!mp.count(wi))
+                    throw runtime_error("WickKernel: output index " + wi.name +
+                                        " does not appear in a term");
+                out_script.push_back(mp.at(wi));
+            }
+            for (auto &nd : nodes)
+                for (char c : unique_chars(nd.second))
+                    count[(uint8_t)c]++;
+            for (char c : out_script)
+                count[(uint8_t)c]++;
+            // key of one step, invariant under renaming of indices
+            auto step_key = [](int ia, const string &sa, int ib,
+                               const string &sb, const string &sr) -> string {
+                string ref = sa + sb, key = operand_key(ia, sa);
+                if (ib != WickKernelStep::none)
+                    key += "," + to_string(ib) + ":" + relabel(sb, ref);
+                return key + "->" + relabel(sr, ref);
+            };
+            // result script of contracting nodes i and j (in canonical order)
+            auto pair_result = [&nodes, &count, &out_script](
+                                   int i, int j, pair<int, string> &na,
+                                   pair<int, string> &nb) -> string {
+                na = nodes[i], nb = nodes[j];
+                if (operand_key(nb.first, nb.second) <
+                    operand_key(na.first, na.second))
+                    swap(na, nb);
+                if (nodes.size() == 2)
+                    return out_script;
+                string sr;
+                for (char c : unique_chars(na.second + nb.second)) {
+                    int k = count[(uint8_t)c];
+                    k -= na.second.find(c) != string::npos;
+                    k -= nb.second.find(c) != string::npos;
+                    if (k != 0)
+                        sr.push_back(c);
+                }
+                return sr;
+            };
+            if (nodes.size() == 1) {
+                const int ia = nodes[0].first;
+                const string &sa = nodes[0].second;
+                if (sa != out_script) {
+                    string key = step_key(ia, sa, WickKernelStep::none, "",
+                                          out_script);
+                    if (!step_map.count(key)) {
+                        step_map[key] = (int)r.steps.size();
+                        r.steps.push_back(WickKernelStep(
+                            ia, WickKernelStep::none, sa + "->" + out_script));
+                    }
+                    nodes[0].first = step_map.at(key);
+                }
+            }
+            pair<int, string> na, nb;
+            while (nodes.size() > 1) {
+                // prefer the most expensive intermediate that already exists
+                int bi = -1, bj = -1;
+                double best_flops = -1;
+                for (int i = 0; i < (int)nodes.size(); i++)
+                    for (int j = i + 1; j < (int)nodes.size(); j++) {
+                        string sr = pair_result(i, j, na, nb);
+                        if (!step_map.count(step_key(na.first, na.second,
+                                                     nb.first, nb.second, sr)))
+                            continue;
+                        double flops = NDArray::einsum_pair_flops(
+                            unique_chars(na.second), unique_chars(nb.second),
+                            extents);
+                        if (flops > best_flops)
+                            bi = i, bj = j, best_flops = flops;
+                    }
+                // otherwise follow the optimized path of remaining operands
+                if (bi == -1) {
+                    vector<string> uscripts;
+                    for (auto &nd : nodes)
+                        uscripts.push_back(unique_chars(nd.second));
+                    pair<int, int> pij = NDArray::einsum_path(
+                        uscripts, count, extents, path_type)[0];
+                    bi = pij.first, bj = pij.second;
+                }
+                string sr = pair_result(bi, bj, na, nb);
+                string key = step_key(na.first, na.second, nb.first, nb.second,
+                                      sr);
+                if (!step_map.count(key)) {
+                    step_map[key] = (int)r.steps.size();
+                    r.steps.push_back(
+                        WickKernelStep(na.first, nb.first,
+                                       na.second + "," + nb.second + "->" + sr));
+                }
+                for (char c : unique_chars(na.second + nb.second)) {
+                    count[(uint8_t)c] -= na.second.find(c) != string::npos;
+                    count[(uint8_t)c] -= nb.second.find(c) != string::npos;
+                    count[(uint8_t)c] += sr.find(c) != string::npos;
+                }
+                nodes.erase(nodes.begin() + max(bi, bj));
+                nodes.erase(nodes.begin() + min(bi, bj));
+                nodes.push_back(make_pair(step_map.at(key), sr));
+            }
+            r.terms.push_back(make_pair(nodes[0].first, term.factor));
+        }
+        return r;
+    }
+    // number of pairwise contractions without sharing intermediates
+    static size_t n_unshared_steps(const WickExpr &expr) {
+        size_t r = 0;
+        for (auto &term : expr.terms)
+            r += term.tensors.size() > 1 ? term.tensors.size() - 1 : 0;
+        return r;
+    }
+    NDArray evaluate(const map<string, NDArray> &tensors) const {
+        // intermediates of all steps reuse storage from one pool
+        NDArrayPoolScope pool_scope;
+        vector<NDArray> xinputs(inputs.size());
+        for (int i = 0; i < (int)inputs.size(); i++) {
+            auto it = tensors.find(inputs[i]);
+            if (it == tensors.end())
+                throw runtime_error("WickKernel: missing input tensor " +
+                                    inputs[i]);
+            xinputs[i] = it->second;
+        }
+        vector<MKL_INT> shape = out_extents;
+        for (int i = 0; i < (int)out_src.size(); i++)
+            if (out_src[i].first != -1)
+                shape[i] = xinputs[out_src[i].first].shape[out_src[i].second];
+        NDArray out(shape);
+        memset(out.data, 0, sizeof(double) * out.size());
+        // release intermediates after their last use
+        vector<int> n_uses(steps.size(), 0);
+        vector<vector<int>> step_terms(steps.size());
+        for (auto &st : steps) {
+            if (st.a >= 0)
+                n_uses[st.a]++;
+            if (st.b >= 0)
+                n_uses[st.b]++;
+        }
+        for (int i = 0; i < (int)terms.size(); i++)
+            if (terms[i].first >= 0)
+                n_uses[terms[i].first]++, step_terms[terms[i].first].push_back(i);
+        auto accumulate = [&out](const NDArray &x, double factor) {
+            if (out.ndim() == 0)
+                out.data[0] += factor * x.item();
+            else
+                NDArray::transpose(x, out, {}, factor, 1.0);
+        };
+        for (auto &t : terms)
+            if (t.first == WickKernelStep::none) {
+                for (size_t k = 0; k < out.size(); k++)
+                    out.data[k] += t.second;
+            } else if (t.first < 0)
+                accumulate(xinputs[-t.first - 1], t.second);
+        vector<NDArray> results(steps.size());
+        auto operand = [&xinputs, &results](int id) -> const NDArray & {
+            return id < 0 ? xinputs[-id - 1] : results[id];
+        };
+        for (int i = 0; i < (int)steps.size(); i++) {
+            const WickKernelStep &st = steps[i];
+            if (st.b == WickKernelStep::none)
+                results[i] = NDArray::einsum(st.script, {operand(st.a)},
+                                             EinsumPathTypes::Linear);
+            else
+                results[i] = NDArray::einsum(
+                    st.script, {operand(st.a), operand(st.b)},
+                    EinsumPathTypes::Linear);
+            for (auto &it : step_terms[i])
+                accumulate(results[i], terms[it].second), n_uses[i]--;
+            for (int id : {st.a, st.b})
+                if (id >= 0 && --n_uses[id] == 0)
+                    results[id] = NDArray();
+            if (n_uses[i] == 0)
+                results[i] = NDArray();
+        }
+        return out;
+    }
+    friend ostream &operator<<(ostream &os, const WickKernel &wk) {
+        auto name = [&wk](int id) -> string {
+            return id < 0 ? wk.inputs[-id - 1] : "_" + to_string(id);
+        };
+        for (int i = 0; i < (int)wk.steps.size(); i++) {
+            const WickKernelStep &st = wk.steps[i];
+            os << "_" << i << " = einsum('" << st.script << "', "
+               << name(st.a);
+            if (st.b != WickKernelStep::none)
+                os << ", " << name(st.b);
+            os << ")" << endl;
+        }
+        for (auto &t : wk.terms)
+            os << "r += " << t.second << " * "
+               << (t.first == WickKernelStep::none ? "1" : name(t.first))
+               << endl;
+        return os;
+    }
+};
+
+} // namespace block2
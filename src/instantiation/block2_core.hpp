@@ -45,6 +45,21 @@
 #include "../core/tensor_functions.hpp"
 #include <cstdint>
 
+// Symmetries explicitly instantiated in the current unit. By default all
+// enabled symmetries are instantiated together. With -DSPLIT_TMPL=ON, each
+// unit is compiled once per symmetry with only one _TMPL_* macro defined.
+#if !defined(_TMPL_SZ) && !defined(_TMPL_SU2) && !defined(_TMPL_SZK) &&       \
+    !defined(_TMPL_SU2K)
+#ifdef _USE_SU2SZ
+#define _TMPL_SZ
+#define _TMPL_SU2
+#endif
+#ifdef _USE_KSYMM
+#define _TMPL_SZK
+#define _TMPL_SU2K
+#endif
+#endif
+
 // allocator.hpp
 extern template struct block2::StackAllocator<uint32_t>;
 extern template struct block2::StackAllocator<double>;
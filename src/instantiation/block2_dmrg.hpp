@@ -24,11 +24,13 @@
 #include "../dmrg/archived_mpo.hpp"
 #include "../dmrg/determinant.hpp"
 #include "../dmrg/effective_hamiltonian.hpp"
+#include "../dmrg/general_mpo.hpp"
 #include "../dmrg/moving_environment.hpp"
 #include "../dmrg/mpo.hpp"
 #include "../dmrg/mpo_fusing.hpp"
 #include "../dmrg/mpo_simplification.hpp"
 #include "../dmrg/mps.hpp"
+#include "../dmrg/mps_trajectory.hpp"
 #include "../dmrg/mps_unfused.hpp"
 #include "../dmrg/parallel_mpo.hpp"
 #include "../dmrg/parallel_mps.hpp"
@@ -40,6 +42,7 @@
 #include "../dmrg/qc_parallel_rule.hpp"
 #include "../dmrg/qc_pdm1.hpp"
 #include "../dmrg/qc_pdm2.hpp"
+#include "../dmrg/qc_pdm3.hpp"
 #include "../dmrg/qc_rule.hpp"
 #include "../dmrg/qc_sum_mpo.hpp"
 #include "../dmrg/state_averaged.hpp"
@@ -73,6 +76,9 @@ extern template struct block2::LinearEffectiveHamiltonian<block2::SU2>;
 extern template struct block2::EffectiveHamiltonian<
     block2::SU2, block2::MultiMPS<block2::SU2>>;
 
+// general_mpo.hpp
+extern template struct block2::GeneralMPO<block2::SZ>;
+
 // moving_environment.hpp
 extern template struct block2::MovingEnvironment<block2::SZ>;
 extern template struct block2::MovingEnvironment<block2::SU2>;
@@ -116,6 +122,10 @@ extern template struct block2::MPS<block2::SU2>;
 extern template struct block2::TransMPSInfo<block2::SZ, block2::SU2>;
 extern template struct block2::TransMPSInfo<block2::SU2, block2::SZ>;
 
+// mps_trajectory.hpp
+extern template struct block2::MPSTrajectory<block2::SZ>;
+extern template struct block2::MPSTrajectory<block2::SU2>;
+
 // mps_unfused.hpp
 extern template struct block2::SparseTensor<block2::SZ>;
 extern template struct block2::UnfusedMPS<block2::SZ>;
@@ -189,6 +199,9 @@ extern template struct block2::PDM1MPOQC<block2::SU2>;
 extern template struct block2::PDM2MPOQC<block2::SZ>;
 extern template struct block2::PDM2MPOQC<block2::SU2>;
 
+// qc_pdm3.hpp
+extern template struct block2::PDM3Stream<block2::SZ>;
+
 // qc_rule.hpp
 extern template struct block2::RuleQC<block2::SZ>;
 extern template struct block2::AntiHermitianRuleQC<block2::SZ>;
@@ -210,17 +223,23 @@ extern template struct block2::MultiMPS<block2::SU2>;
 extern template struct block2::DMRG<block2::SZ>;
 extern template struct block2::Linear<block2::SZ>;
 extern template struct block2::Expect<block2::SZ>;
+extern template struct block2::ChebyshevSpectral<block2::SZ>;
 
 extern template struct block2::DMRG<block2::SU2>;
 extern template struct block2::Linear<block2::SU2>;
 extern template struct block2::Expect<block2::SU2>;
+extern template struct block2::ChebyshevSpectral<block2::SU2>;
 
 // sweep_algorithm_td.hpp
 extern template struct block2::TDDMRG<block2::SZ>;
 extern template struct block2::TimeEvolution<block2::SZ>;
+extern template struct block2::GlobalKrylovTE<block2::SZ>;
+extern template struct block2::FiniteTemperature<block2::SZ>;
 
 extern template struct block2::TDDMRG<block2::SU2>;
 extern template struct block2::TimeEvolution<block2::SU2>;
+extern template struct block2::GlobalKrylovTE<block2::SU2>;
+extern template struct block2::FiniteTemperature<block2::SU2>;
 
 #ifdef _USE_KSYMM
 
@@ -250,6 +269,9 @@ extern template struct block2::LinearEffectiveHamiltonian<block2::SU2K>;
 extern template struct block2::EffectiveHamiltonian<
     block2::SU2K, block2::MultiMPS<block2::SU2K>>;
 
+// general_mpo.hpp
+extern template struct block2::GeneralMPO<block2::SZK>;
+
 // moving_environment.hpp
 extern template struct block2::MovingEnvironment<block2::SZK>;
 extern template struct block2::MovingEnvironment<block2::SU2K>;
@@ -293,6 +315,10 @@ extern template struct block2::MPS<block2::SU2K>;
 extern template struct block2::TransMPSInfo<block2::SZK, block2::SU2K>;
 extern template struct block2::TransMPSInfo<block2::SU2K, block2::SZK>;
 
+// mps_trajectory.hpp
+extern template struct block2::MPSTrajectory<block2::SZK>;
+extern template struct block2::MPSTrajectory<block2::SU2K>;
+
 // mps_unfused.hpp
 extern template struct block2::SparseTensor<block2::SZK>;
 extern template struct block2::UnfusedMPS<block2::SZK>;
@@ -366,6 +392,9 @@ extern template struct block2::PDM1MPOQC<block2::SU2K>;
 extern template struct block2::PDM2MPOQC<block2::SZK>;
 extern template struct block2::PDM2MPOQC<block2::SU2K>;
 
+// qc_pdm3.hpp
+extern template struct block2::PDM3Stream<block2::SZK>;
+
 // qc_rule.hpp
 extern template struct block2::RuleQC<block2::SZK>;
 extern template struct block2::AntiHermitianRuleQC<block2::SZK>;
@@ -387,16 +416,22 @@ extern template struct block2::MultiMPS<block2::SU2K>;
 extern template struct block2::DMRG<block2::SZK>;
 extern template struct block2::Linear<block2::SZK>;
 extern template struct block2::Expect<block2::SZK>;
+extern template struct block2::ChebyshevSpectral<block2::SZK>;
 
 extern template struct block2::DMRG<block2::SU2K>;
 extern template struct block2::Linear<block2::SU2K>;
 extern template struct block2::Expect<block2::SU2K>;
+extern template struct block2::ChebyshevSpectral<block2::SU2K>;
 
 // sweep_algorithm_td.hpp
 extern template struct block2::TDDMRG<block2::SZK>;
 extern template struct block2::TimeEvolution<block2::SZK>;
+extern template struct block2::GlobalKrylovTE<block2::SZK>;
+extern template struct block2::FiniteTemperature<block2::SZK>;
 
 extern template struct block2::TDDMRG<block2::SU2K>;
 extern template struct block2::TimeEvolution<block2::SU2K>;
+extern template struct block2::GlobalKrylovTE<block2::SU2K>;
+extern template struct block2::FiniteTemperature<block2::SU2K>;
 
 #endif
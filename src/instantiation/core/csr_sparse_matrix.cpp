@@ -20,5 +20,9 @@
 
 #include "../block2_core.hpp"
 
+#ifdef _TMPL_SZ
 template struct block2::CSRSparseMatrix<block2::SZ>;
+#endif
+#ifdef _TMPL_SU2
 template struct block2::CSRSparseMatrix<block2::SU2>;
+#endif
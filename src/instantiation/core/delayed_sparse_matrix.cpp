@@ -20,13 +20,25 @@
 
 #include "../block2_core.hpp"
 
+#ifdef _TMPL_SZ
 template struct block2::DelayedSparseMatrix<block2::SZ>;
+#endif
+#ifdef _TMPL_SU2
 template struct block2::DelayedSparseMatrix<block2::SU2>;
+#endif
+#ifdef _TMPL_SZ
 template struct block2::DelayedSparseMatrix<block2::SZ,
                                             block2::SparseMatrix<block2::SZ>>;
+#endif
+#ifdef _TMPL_SU2
 template struct block2::DelayedSparseMatrix<block2::SU2,
                                             block2::SparseMatrix<block2::SU2>>;
+#endif
+#ifdef _TMPL_SZ
 template struct block2::DelayedSparseMatrix<
     block2::SZ, block2::CSRSparseMatrix<block2::SZ>>;
+#endif
+#ifdef _TMPL_SU2
 template struct block2::DelayedSparseMatrix<
     block2::SU2, block2::CSRSparseMatrix<block2::SU2>>;
+#endif
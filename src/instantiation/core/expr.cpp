@@ -20,16 +20,20 @@
 
 #include "../block2_core.hpp"
 
+#ifdef _TMPL_SZ
 template struct block2::OpExpr<block2::SZ>;
 template struct block2::OpElement<block2::SZ>;
 template struct block2::OpElementRef<block2::SZ>;
 template struct block2::OpProduct<block2::SZ>;
 template struct block2::OpSumProd<block2::SZ>;
 template struct block2::OpSum<block2::SZ>;
+#endif
 
+#ifdef _TMPL_SU2
 template struct block2::OpExpr<block2::SU2>;
 template struct block2::OpElement<block2::SU2>;
 template struct block2::OpElementRef<block2::SU2>;
 template struct block2::OpProduct<block2::SU2>;
 template struct block2::OpSumProd<block2::SU2>;
 template struct block2::OpSum<block2::SU2>;
+#endif
@@ -20,9 +20,17 @@
 
 #include "../block2_core.hpp"
 
+#ifdef _TMPL_SZ
 template struct block2::Hamiltonian<block2::SZ>;
+#endif
+#ifdef _TMPL_SU2
 template struct block2::Hamiltonian<block2::SU2>;
+#endif
+#ifdef _TMPL_SZ
 template struct block2::DelayedSparseMatrix<block2::SZ,
                                             block2::Hamiltonian<block2::SZ>>;
+#endif
+#ifdef _TMPL_SU2
 template struct block2::DelayedSparseMatrix<block2::SU2,
                                             block2::Hamiltonian<block2::SU2>>;
+#endif
@@ -20,8 +20,12 @@
 
 #include "../block2_core.hpp"
 
+#ifdef _TMPL_SZ
 template struct block2::OperatorTensor<block2::SZ>;
 template struct block2::DelayedOperatorTensor<block2::SZ>;
+#endif
 
+#ifdef _TMPL_SU2
 template struct block2::OperatorTensor<block2::SU2>;
 template struct block2::DelayedOperatorTensor<block2::SU2>;
+#endif
@@ -21,6 +21,10 @@
 #include "../block2_core.hpp"
 
 #ifdef _HAS_MPI
+#ifdef _TMPL_SZ
 template struct block2::MPICommunicator<block2::SZ>;
+#endif
+#ifdef _TMPL_SU2
 template struct block2::MPICommunicator<block2::SU2>;
+#endif
 #endif
\ No newline at end of file
@@ -20,10 +20,14 @@
 
 #include "../block2_core.hpp"
 
+#ifdef _TMPL_SZ
 template struct block2::SparseMatrixInfo<block2::SZ>;
 template struct block2::SparseMatrix<block2::SZ>;
 template struct block2::SparseMatrixGroup<block2::SZ>;
+#endif
 
+#ifdef _TMPL_SU2
 template struct block2::SparseMatrixInfo<block2::SU2>;
 template struct block2::SparseMatrix<block2::SU2>;
 template struct block2::SparseMatrixGroup<block2::SU2>;
+#endif
@@ -20,11 +20,19 @@
 
 #include "../block2_core.hpp"
 
+#ifdef _TMPL_SZ
 template struct block2::StateInfo<block2::SZ>;
 template struct block2::StateProbability<block2::SZ>;
+#endif
 
+#ifdef _TMPL_SU2
 template struct block2::StateInfo<block2::SU2>;
 template struct block2::StateProbability<block2::SU2>;
+#endif
 
+#ifdef _TMPL_SZ
 template struct block2::TransStateInfo<block2::SZ, block2::SU2>;
+#endif
+#ifdef _TMPL_SU2
 template struct block2::TransStateInfo<block2::SU2, block2::SZ>;
+#endif
@@ -20,12 +20,16 @@
 
 #include "../block2_core.hpp"
 
+#ifdef _TMPL_SZ
 template struct block2::Symbolic<block2::SZ>;
 template struct block2::SymbolicRowVector<block2::SZ>;
 template struct block2::SymbolicColumnVector<block2::SZ>;
 template struct block2::SymbolicMatrix<block2::SZ>;
+#endif
 
+#ifdef _TMPL_SU2
 template struct block2::Symbolic<block2::SU2>;
 template struct block2::SymbolicRowVector<block2::SU2>;
 template struct block2::SymbolicColumnVector<block2::SU2>;
 template struct block2::SymbolicMatrix<block2::SU2>;
+#endif
@@ -20,13 +20,25 @@
 
 #include "../block2_core.hpp"
 
+#ifdef _TMPL_SZK
 template struct block2::DelayedSparseMatrix<block2::SZK>;
+#endif
+#ifdef _TMPL_SU2K
 template struct block2::DelayedSparseMatrix<block2::SU2K>;
+#endif
+#ifdef _TMPL_SZK
 template struct block2::DelayedSparseMatrix<block2::SZK,
                                             block2::SparseMatrix<block2::SZK>>;
+#endif
+#ifdef _TMPL_SU2K
 template struct block2::DelayedSparseMatrix<block2::SU2K,
                                             block2::SparseMatrix<block2::SU2K>>;
+#endif
+#ifdef _TMPL_SZK
 template struct block2::DelayedSparseMatrix<
     block2::SZK, block2::CSRSparseMatrix<block2::SZK>>;
+#endif
+#ifdef _TMPL_SU2K
 template struct block2::DelayedSparseMatrix<
     block2::SU2K, block2::CSRSparseMatrix<block2::SU2K>>;
+#endif
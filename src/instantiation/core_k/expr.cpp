@@ -20,16 +20,20 @@
 
 #include "../block2_core.hpp"
 
+#ifdef _TMPL_SZK
 template struct block2::OpExpr<block2::SZK>;
 template struct block2::OpElement<block2::SZK>;
 template struct block2::OpElementRef<block2::SZK>;
 template struct block2::OpProduct<block2::SZK>;
 template struct block2::OpSumProd<block2::SZK>;
 template struct block2::OpSum<block2::SZK>;
+#endif
 
+#ifdef _TMPL_SU2K
 template struct block2::OpExpr<block2::SU2K>;
 template struct block2::OpElement<block2::SU2K>;
 template struct block2::OpElementRef<block2::SU2K>;
 template struct block2::OpProduct<block2::SU2K>;
 template struct block2::OpSumProd<block2::SU2K>;
 template struct block2::OpSum<block2::SU2K>;
+#endif
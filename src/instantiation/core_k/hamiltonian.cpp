@@ -20,9 +20,17 @@
 
 #include "../block2_core.hpp"
 
+#ifdef _TMPL_SZK
 template struct block2::Hamiltonian<block2::SZK>;
+#endif
+#ifdef _TMPL_SU2K
 template struct block2::Hamiltonian<block2::SU2K>;
+#endif
+#ifdef _TMPL_SZK
 template struct block2::DelayedSparseMatrix<block2::SZK,
                                             block2::Hamiltonian<block2::SZK>>;
+#endif
+#ifdef _TMPL_SU2K
 template struct block2::DelayedSparseMatrix<block2::SU2K,
                                             block2::Hamiltonian<block2::SU2K>>;
+#endif
@@ -20,8 +20,12 @@
 
 #include "../block2_core.hpp"
 
+#ifdef _TMPL_SZK
 template struct block2::OperatorTensor<block2::SZK>;
 template struct block2::DelayedOperatorTensor<block2::SZK>;
+#endif
 
+#ifdef _TMPL_SU2K
 template struct block2::OperatorTensor<block2::SU2K>;
 template struct block2::DelayedOperatorTensor<block2::SU2K>;
+#endif
@@ -21,6 +21,10 @@
 #include "../block2_core.hpp"
 
 #ifdef _HAS_MPI
+#ifdef _TMPL_SZK
 template struct block2::MPICommunicator<block2::SZK>;
+#endif
+#ifdef _TMPL_SU2K
 template struct block2::MPICommunicator<block2::SU2K>;
+#endif
 #endif
\ No newline at end of file
@@ -20,5 +20,9 @@
 
 #include "../block2_core.hpp"
 
+#ifdef _TMPL_SZK
 template struct block2::ParallelTensorFunctions<block2::SZK>;
+#endif
+#ifdef _TMPL_SU2K
 template struct block2::ParallelTensorFunctions<block2::SU2K>;
+#endif
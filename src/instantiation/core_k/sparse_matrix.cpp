@@ -20,10 +20,14 @@
 
 #include "../block2_core.hpp"
 
+#ifdef _TMPL_SZK
 template struct block2::SparseMatrixInfo<block2::SZK>;
 template struct block2::SparseMatrix<block2::SZK>;
 template struct block2::SparseMatrixGroup<block2::SZK>;
+#endif
 
+#ifdef _TMPL_SU2K
 template struct block2::SparseMatrixInfo<block2::SU2K>;
 template struct block2::SparseMatrix<block2::SU2K>;
 template struct block2::SparseMatrixGroup<block2::SU2K>;
+#endif
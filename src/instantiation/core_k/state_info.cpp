@@ -20,11 +20,19 @@
 
 #include "../block2_core.hpp"
 
+#ifdef _TMPL_SZK
 template struct block2::StateInfo<block2::SZK>;
 template struct block2::StateProbability<block2::SZK>;
+#endif
 
+#ifdef _TMPL_SU2K
 template struct block2::StateInfo<block2::SU2K>;
 template struct block2::StateProbability<block2::SU2K>;
+#endif
 
+#ifdef _TMPL_SZK
 template struct block2::TransStateInfo<block2::SZK, block2::SU2K>;
+#endif
+#ifdef _TMPL_SU2K
 template struct block2::TransStateInfo<block2::SU2K, block2::SZK>;
+#endif
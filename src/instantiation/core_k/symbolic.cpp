@@ -20,12 +20,16 @@
 
 #include "../block2_core.hpp"
 
+#ifdef _TMPL_SZK
 template struct block2::Symbolic<block2::SZK>;
 template struct block2::SymbolicRowVector<block2::SZK>;
 template struct block2::SymbolicColumnVector<block2::SZK>;
 template struct block2::SymbolicMatrix<block2::SZK>;
+#endif
 
+#ifdef _TMPL_SU2K
 template struct block2::Symbolic<block2::SU2K>;
 template struct block2::SymbolicRowVector<block2::SU2K>;
 template struct block2::SymbolicColumnVector<block2::SU2K>;
 template struct block2::SymbolicMatrix<block2::SU2K>;
+#endif
@@ -20,10 +20,14 @@
 
 #include "../block2_dmrg.hpp"
 
+#ifdef _TMPL_SZ
 template struct block2::DeterminantTRIE<block2::SZ>;
 template struct block2::DeterminantQC<block2::SZ>;
 template struct block2::DeterminantMPSInfo<block2::SZ>;
+#endif
 
+#ifdef _TMPL_SU2
 template struct block2::DeterminantTRIE<block2::SU2>;
 template struct block2::DeterminantQC<block2::SU2>;
 template struct block2::DeterminantMPSInfo<block2::SU2>;
+#endif
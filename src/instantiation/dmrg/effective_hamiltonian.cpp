@@ -20,14 +20,18 @@
 
 #include "../block2_dmrg.hpp"
 
+#ifdef _TMPL_SZ
 template struct block2::EffectiveHamiltonian<block2::SZ,
                                              block2::MPS<block2::SZ>>;
 template struct block2::LinearEffectiveHamiltonian<block2::SZ>;
 template struct block2::EffectiveHamiltonian<block2::SZ,
                                              block2::MultiMPS<block2::SZ>>;
+#endif
 
+#ifdef _TMPL_SU2
 template struct block2::EffectiveHamiltonian<block2::SU2,
                                              block2::MPS<block2::SU2>>;
 template struct block2::LinearEffectiveHamiltonian<block2::SU2>;
 template struct block2::EffectiveHamiltonian<block2::SU2,
                                              block2::MultiMPS<block2::SU2>>;
+#endif
@@ -20,14 +20,18 @@
 
 #include "../block2_dmrg.hpp"
 
+#ifdef _TMPL_SZ
 template struct block2::MPOSchemer<block2::SZ>;
 template struct block2::MPO<block2::SZ>;
 template struct block2::DiagonalMPO<block2::SZ>;
 template struct block2::AncillaMPO<block2::SZ>;
 template struct block2::IdentityAddedMPO<block2::SZ>;
+#endif
 
+#ifdef _TMPL_SU2
 template struct block2::MPOSchemer<block2::SU2>;
 template struct block2::MPO<block2::SU2>;
 template struct block2::DiagonalMPO<block2::SU2>;
 template struct block2::AncillaMPO<block2::SU2>;
 template struct block2::IdentityAddedMPO<block2::SU2>;
+#endif
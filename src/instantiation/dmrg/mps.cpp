@@ -20,19 +20,27 @@
 
 #include "../block2_dmrg.hpp"
 
+#ifdef _TMPL_SZ
 template struct block2::MPSInfo<block2::SZ>;
 template struct block2::DynamicMPSInfo<block2::SZ>;
 template struct block2::CASCIMPSInfo<block2::SZ>;
 template struct block2::MRCIMPSInfo<block2::SZ>;
 template struct block2::AncillaMPSInfo<block2::SZ>;
 template struct block2::MPS<block2::SZ>;
+#endif
 
+#ifdef _TMPL_SU2
 template struct block2::MPSInfo<block2::SU2>;
 template struct block2::DynamicMPSInfo<block2::SU2>;
 template struct block2::CASCIMPSInfo<block2::SU2>;
 template struct block2::MRCIMPSInfo<block2::SU2>;
 template struct block2::AncillaMPSInfo<block2::SU2>;
 template struct block2::MPS<block2::SU2>;
+#endif
 
+#ifdef _TMPL_SZ
 template struct block2::TransMPSInfo<block2::SZ, block2::SU2>;
+#endif
+#ifdef _TMPL_SU2
 template struct block2::TransMPSInfo<block2::SU2, block2::SZ>;
+#endif
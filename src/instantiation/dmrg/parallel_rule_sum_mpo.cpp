@@ -20,10 +20,14 @@
 
 #include "../block2_dmrg.hpp"
 
+#ifdef _TMPL_SZ
 template struct block2::ParallelRuleSumMPO<block2::SZ>;
 template struct block2::SumMPORule<block2::SZ>;
 template struct block2::ParallelFCIDUMP<block2::SZ>;
+#endif
 
+#ifdef _TMPL_SU2
 template struct block2::ParallelRuleSumMPO<block2::SU2>;
 template struct block2::SumMPORule<block2::SU2>;
 template struct block2::ParallelFCIDUMP<block2::SU2>;
+#endif
@@ -20,6 +20,7 @@
 
 #include "../block2_dmrg.hpp"
 
+#ifdef _TMPL_SZ
 template struct block2::ParallelRuleQC<block2::SZ>;
 template struct block2::ParallelRuleOneBodyQC<block2::SZ>;
 template struct block2::ParallelRulePDM1QC<block2::SZ>;
@@ -27,7 +28,9 @@ template struct block2::ParallelRulePDM2QC<block2::SZ>;
 template struct block2::ParallelRuleNPDMQC<block2::SZ>;
 template struct block2::ParallelRuleSiteQC<block2::SZ>;
 template struct block2::ParallelRuleIdentity<block2::SZ>;
+#endif
 
+#ifdef _TMPL_SU2
 template struct block2::ParallelRuleQC<block2::SU2>;
 template struct block2::ParallelRuleOneBodyQC<block2::SU2>;
 template struct block2::ParallelRulePDM1QC<block2::SU2>;
@@ -35,3 +38,4 @@ template struct block2::ParallelRulePDM2QC<block2::SU2>;
 template struct block2::ParallelRuleNPDMQC<block2::SU2>;
 template struct block2::ParallelRuleSiteQC<block2::SU2>;
 template struct block2::ParallelRuleIdentity<block2::SU2>;
+#endif
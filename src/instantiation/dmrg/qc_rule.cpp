@@ -20,8 +20,12 @@
 
 #include "../block2_dmrg.hpp"
 
+#ifdef _TMPL_SZ
 template struct block2::RuleQC<block2::SZ>;
 template struct block2::AntiHermitianRuleQC<block2::SZ>;
+#endif
 
+#ifdef _TMPL_SU2
 template struct block2::RuleQC<block2::SU2>;
 template struct block2::AntiHermitianRuleQC<block2::SU2>;
+#endif
@@ -20,8 +20,12 @@
 
 #include "../block2_dmrg.hpp"
 
+#ifdef _TMPL_SZ
 template struct block2::MultiMPSInfo<block2::SZ>;
 template struct block2::MultiMPS<block2::SZ>;
+#endif
 
+#ifdef _TMPL_SU2
 template struct block2::MultiMPSInfo<block2::SU2>;
 template struct block2::MultiMPS<block2::SU2>;
+#endif
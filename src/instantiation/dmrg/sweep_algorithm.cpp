@@ -20,10 +20,16 @@
 
 #include "../block2_dmrg.hpp"
 
+#ifdef _TMPL_SZ
 template struct block2::DMRG<block2::SZ>;
 template struct block2::Linear<block2::SZ>;
 template struct block2::Expect<block2::SZ>;
+template struct block2::ChebyshevSpectral<block2::SZ>;
+#endif
 
+#ifdef _TMPL_SU2
 template struct block2::DMRG<block2::SU2>;
 template struct block2::Linear<block2::SU2>;
 template struct block2::Expect<block2::SU2>;
+template struct block2::ChebyshevSpectral<block2::SU2>;
+#endif
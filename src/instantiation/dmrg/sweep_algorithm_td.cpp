@@ -20,8 +20,16 @@
 
 #include "../block2_dmrg.hpp"
 
+#ifdef _TMPL_SZ
 template struct block2::TDDMRG<block2::SZ>;
 template struct block2::TimeEvolution<block2::SZ>;
+template struct block2::GlobalKrylovTE<block2::SZ>;
+template struct block2::FiniteTemperature<block2::SZ>;
+#endif
 
+#ifdef _TMPL_SU2
 template struct block2::TDDMRG<block2::SU2>;
 template struct block2::TimeEvolution<block2::SU2>;
+template struct block2::GlobalKrylovTE<block2::SU2>;
+template struct block2::FiniteTemperature<block2::SU2>;
+#endif
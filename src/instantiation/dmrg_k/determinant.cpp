@@ -20,10 +20,14 @@
 
 #include "../block2_dmrg.hpp"
 
+#ifdef _TMPL_SZK
 template struct block2::DeterminantTRIE<block2::SZK>;
 template struct block2::DeterminantQC<block2::SZK>;
 template struct block2::DeterminantMPSInfo<block2::SZK>;
+#endif
 
+#ifdef _TMPL_SU2K
 template struct block2::DeterminantTRIE<block2::SU2K>;
 template struct block2::DeterminantQC<block2::SU2K>;
 template struct block2::DeterminantMPSInfo<block2::SU2K>;
+#endif
@@ -20,14 +20,18 @@
 
 #include "../block2_dmrg.hpp"
 
+#ifdef _TMPL_SZK
 template struct block2::EffectiveHamiltonian<block2::SZK,
                                              block2::MPS<block2::SZK>>;
 template struct block2::LinearEffectiveHamiltonian<block2::SZK>;
 template struct block2::EffectiveHamiltonian<block2::SZK,
                                              block2::MultiMPS<block2::SZK>>;
+#endif
 
+#ifdef _TMPL_SU2K
 template struct block2::EffectiveHamiltonian<block2::SU2K,
                                              block2::MPS<block2::SU2K>>;
 template struct block2::LinearEffectiveHamiltonian<block2::SU2K>;
 template struct block2::EffectiveHamiltonian<block2::SU2K,
                                              block2::MultiMPS<block2::SU2K>>;
+#endif
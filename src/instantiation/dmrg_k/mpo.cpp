@@ -20,14 +20,18 @@
 
 #include "../block2_dmrg.hpp"
 
+#ifdef _TMPL_SZK
 template struct block2::MPOSchemer<block2::SZK>;
 template struct block2::MPO<block2::SZK>;
 template struct block2::DiagonalMPO<block2::SZK>;
 template struct block2::AncillaMPO<block2::SZK>;
 template struct block2::IdentityAddedMPO<block2::SZK>;
+#endif
 
+#ifdef _TMPL_SU2K
 template struct block2::MPOSchemer<block2::SU2K>;
 template struct block2::MPO<block2::SU2K>;
 template struct block2::DiagonalMPO<block2::SU2K>;
 template struct block2::AncillaMPO<block2::SU2K>;
 template struct block2::IdentityAddedMPO<block2::SU2K>;
+#endif
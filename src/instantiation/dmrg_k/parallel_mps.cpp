@@ -20,5 +20,9 @@
 
 #include "../block2_dmrg.hpp"
 
+#ifdef _TMPL_SZK
 template struct block2::ParallelMPS<block2::SZK>;
+#endif
+#ifdef _TMPL_SU2K
 template struct block2::ParallelMPS<block2::SU2K>;
+#endif
@@ -20,10 +20,14 @@
 
 #include "../block2_dmrg.hpp"
 
+#ifdef _TMPL_SZK
 template struct block2::IdentityMPO<block2::SZK>;
 template struct block2::SiteMPO<block2::SZK>;
 template struct block2::MPOQC<block2::SZK>;
+#endif
 
+#ifdef _TMPL_SU2K
 template struct block2::IdentityMPO<block2::SU2K>;
 template struct block2::SiteMPO<block2::SU2K>;
 template struct block2::MPOQC<block2::SU2K>;
+#endif
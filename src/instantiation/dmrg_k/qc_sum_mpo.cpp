@@ -20,4 +20,6 @@
 
 #include "../block2_dmrg.hpp"
 
+#ifdef _TMPL_SZK
 template struct block2::SumMPOQC<block2::SZK>;
+#endif
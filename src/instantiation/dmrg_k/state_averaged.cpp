@@ -20,8 +20,12 @@
 
 #include "../block2_dmrg.hpp"
 
+#ifdef _TMPL_SZK
 template struct block2::MultiMPSInfo<block2::SZK>;
 template struct block2::MultiMPS<block2::SZK>;
+#endif
 
+#ifdef _TMPL_SU2K
 template struct block2::MultiMPSInfo<block2::SU2K>;
 template struct block2::MultiMPS<block2::SU2K>;
+#endif
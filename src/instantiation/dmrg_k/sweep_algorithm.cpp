@@ -20,10 +20,16 @@
 
 #include "../block2_dmrg.hpp"
 
+#ifdef _TMPL_SZK
 template struct block2::DMRG<block2::SZK>;
 template struct block2::Linear<block2::SZK>;
 template struct block2::Expect<block2::SZK>;
+template struct block2::ChebyshevSpectral<block2::SZK>;
+#endif
 
+#ifdef _TMPL_SU2K
 template struct block2::DMRG<block2::SU2K>;
 template struct block2::Linear<block2::SU2K>;
 template struct block2::Expect<block2::SU2K>;
+template struct block2::ChebyshevSpectral<block2::SU2K>;
+#endif
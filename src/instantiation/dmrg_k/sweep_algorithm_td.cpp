@@ -20,8 +20,16 @@
 
 #include "../block2_dmrg.hpp"
 
+#ifdef _TMPL_SZK
 template struct block2::TDDMRG<block2::SZK>;
 template struct block2::TimeEvolution<block2::SZK>;
+template struct block2::GlobalKrylovTE<block2::SZK>;
+template struct block2::FiniteTemperature<block2::SZK>;
+#endif
 
+#ifdef _TMPL_SU2K
 template struct block2::TDDMRG<block2::SU2K>;
 template struct block2::TimeEvolution<block2::SU2K>;
+template struct block2::GlobalKrylovTE<block2::SU2K>;
+template struct block2::FiniteTemperature<block2::SU2K>;
+#endif
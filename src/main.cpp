@@ -52,6 +52,81 @@ map<string, string> read_input(const string &filename) {
     return params;
 }
 
+// options of the data frame (stack memory and scratch files)
+const vector<string> frame_option_keys = {
+    "memory",           "scratch",
+    "huge_pages",       "stack_align",
+    "thread_arenas",    "memory_tags",
+    "mmap_scratch",     "zero_copy_save",
+    "direct_io",        "prefetch",
+    "async_mps_save",   "restart_dir_site",
+    "ram_cache",        "restart_site_interval",
+    "spill_scratch",    "restart_site_distributed",
+    "numa_first_touch", "n_threads"};
+
+// data frame options of the previous job (service mode)
+string last_frame_key = "";
+
+void set_frame_options(const map<string, string> &params) {
+    // transparent huge pages and aligned arrays for stack memory
+    if (params.count("huge_pages") != 0 &&
+        !!Parsing::to_int(params.at("huge_pages")))
+        frame_()->use_huge_pages();
+    if (params.count("stack_align") != 0)
+        frame_()->set_alignment(
+            (size_t)Parsing::to_int(params.at("stack_align")));
+
+    // per-thread stacks for temporaries in parallel tasks
+    if (params.count("thread_arenas") != 0)
+        frame_()->thread_arenas = !!Parsing::to_int(params.at("thread_arenas"));
+
+    // attribute stack memory to parts of the sweep
+    if (params.count("memory_tags") != 0 &&
+        !!Parsing::to_int(params.at("memory_tags")))
+        frame_()->track_memory_tags();
+
+    // map renormalized operator files directly into stack memory
+    if (params.count("mmap_scratch") != 0)
+        frame_()->mmap_scratch = !!Parsing::to_int(params.at("mmap_scratch"));
+
+    // write renormalized operators directly from stack memory
+    if (params.count("zero_copy_save") != 0)
+        frame_()->zero_copy_save =
+            !!Parsing::to_int(params.at("zero_copy_save"));
+    if (params.count("direct_io") != 0)
+        frame_()->direct_io = !!Parsing::to_int(params.at("direct_io"));
+
+    // read environments of the next site in background
+    if (params.count("prefetch") != 0)
+        frame_()->prefetch_buffering = !!Parsing::to_int(params.at("prefetch"));
+
+    // write mps tensors in background during sweeps
+    if (params.count("async_mps_save") != 0)
+        frame_()->async_mps_save =
+            !!Parsing::to_int(params.at("async_mps_save"));
+
+    // save mps, environments and sweep state in the middle of sweeps
+    if (params.count("restart_dir_site") != 0)
+        frame_()->restart_dir_site = params.at("restart_dir_site");
+    if (params.count("restart_site_interval") != 0)
+        frame_()->restart_site_interval =
+            Parsing::to_int(params.at("restart_site_interval"));
+    if (params.count("restart_site_distributed") != 0)
+        frame_()->restart_site_distributed =
+            !!Parsing::to_int(params.at("restart_site_distributed"));
+
+    // tiered scratch storage: memory / scratch folder / spill folder
+    if (params.count("ram_cache") != 0)
+        frame_()->ram_cache_size =
+            (size_t)Parsing::to_double(params.at("ram_cache"));
+    if (params.count("spill_scratch") != 0) {
+        vector<string> xspill =
+            Parsing::split(params.at("spill_scratch"), " ", true);
+        frame_()->spill_dir = xspill[0];
+        frame_()->local_disk_size = (size_t)Parsing::to_double(xspill[1]);
+    }
+}
+
 template <typename S> void run(const map<string, string> &params) {
 
     size_t memory = 4ULL << 30;
@@ -62,9 +137,26 @@ template <typename S> void run(const map<string, string> &params) {
     if (params.count("scratch") != 0)
         scratch = params.at("scratch");
 
-    frame_() = make_shared<DataFrame>((size_t)(0.1 * memory),
-                                      (size_t)(0.9 * memory), scratch);
-    frame_()->use_main_stack = false;
+    // in service mode, the stacks of the previous job are reused
+    // when all data frame options are the same
+    stringstream sfk;
+    for (auto &k : frame_option_keys)
+        if (params.count(k) != 0)
+            sfk << k << " = " << params.at(k) << endl;
+    const bool reuse_frame =
+        frame_() != nullptr && sfk.str() == last_frame_key;
+    if (reuse_frame) {
+        frame_()->reset_state();
+        frame_()->mps_dir = frame_()->save_dir;
+        cout << "data frame reused" << endl;
+    } else {
+        frame_() = nullptr;
+        frame_() = make_shared<DataFrame>((size_t)(0.1 * memory),
+                                          (size_t)(0.9 * memory), scratch);
+        frame_()->use_main_stack = false;
+        set_frame_options(params);
+        last_frame_key = sfk.str();
+    }
 
     // random scratch file prefix to avoid conflicts
     if (params.count("prefix") != 0 && params.at("prefix") != "auto")
@@ -76,6 +168,15 @@ template <typename S> void run(const map<string, string> &params) {
         frame_()->prefix = ss.str();
     }
 
+    // copy mps and sweep schedule state after each sweep
+    // into restart_dir (and restart_dir_per_sweep.<sweep index>)
+    frame_()->restart_dir =
+        params.count("restart_dir") != 0 ? params.at("restart_dir") : "";
+    frame_()->restart_dir_per_sweep =
+        params.count("restart_dir_per_sweep") != 0
+            ? params.at("restart_dir_per_sweep")
+            : "";
+
     if (params.count("rand_seed") != 0)
         Random::rand_seed(Parsing::to_int(params.at("rand_seed")));
     else
@@ -122,6 +223,9 @@ template <typename S> void run(const map<string, string> &params) {
 
     if (params.count("fcidump") != 0) {
         fcidump->read(params.at("fcidump"));
+        // convert to binary format for faster reading in later runs
+        if (params.count("fcidump_save_binary") != 0)
+            fcidump->save_data(params.at("fcidump_save_binary"));
     } else {
         cerr << "'ficudmp' parameter not found!" << endl;
         abort();
@@ -136,6 +240,27 @@ template <typename S> void run(const map<string, string> &params) {
     if (params.count("ipg") != 0)
         fcidump->params["isym"] = params.at("ipg");
 
+    // fold the frozen core of the casci active space into the integrals,
+    // so that only active orbitals are kept as sites
+    bool casci_folded = false;
+    if (params.count("casci") != 0 && params.count("casci_fold") != 0 &&
+        !!Parsing::to_int(params.at("casci_fold"))) {
+        vector<string> xcasci = Parsing::split(params.at("casci"), " ", true);
+        int n_active = Parsing::to_int(xcasci[0]);
+        int n_frozen = (fcidump->n_elec() - Parsing::to_int(xcasci[1])) / 2;
+        if (occs.size() == fcidump->n_sites())
+            occs = vector<double>(occs.begin() + n_frozen,
+                                  occs.begin() + n_frozen + n_active);
+        shared_ptr<FCIDUMP> fcidump_cas =
+            fcidump->fold_frozen_core(n_frozen, n_active);
+        fcidump->deallocate();
+        fcidump = fcidump_cas;
+        casci_folded = true;
+        cout << "casci folded: frozen = " << n_frozen
+             << " active = " << n_active << " core energy = " << fixed
+             << setprecision(12) << fcidump->e() << endl;
+    }
+
     if (params.count("n_threads") != 0) {
         int n_threads = Parsing::to_int(params.at("n_threads"));
         threading_() = make_shared<Threading>(
@@ -146,6 +271,23 @@ template <typename S> void run(const map<string, string> &params) {
         cout << *threading_() << endl;
     }
 
+    if (params.count("small_gemm_size") != 0)
+        threading_()->small_gemm_size =
+            Parsing::to_int(params.at("small_gemm_size"));
+
+    if (params.count("reduce_chunk") != 0)
+        threading_()->reduce_chunk =
+            (size_t)Parsing::to_long_long(params.at("reduce_chunk"));
+
+    if (params.count("deterministic_slots") != 0)
+        threading_()->deterministic_slots =
+            Parsing::to_int(params.at("deterministic_slots"));
+
+    // spread stack memory over the NUMA nodes of the working threads
+    if (!reuse_frame && params.count("numa_first_touch") != 0 &&
+        !!Parsing::to_int(params.at("numa_first_touch")))
+        frame_()->first_touch(threading_()->n_threads_op);
+
     vector<uint8_t> orbsym = fcidump->orb_sym<uint8_t>();
     transform(orbsym.begin(), orbsym.end(), orbsym.begin(),
               PointGroup::swap_pg(pg));
@@ -162,6 +304,22 @@ template <typename S> void run(const map<string, string> &params) {
     shared_ptr<HamiltonianQC<S>> hamil = make_shared<HamiltonianQC<S>>
             (vacuum, norb, orbsym, fcidump);
 
+    // drop small two-electron integrals
+    if (params.count("integral_cutoff") != 0) {
+        pair<size_t, double> pdrop = hamil->set_v_cutoff(
+            Parsing::to_double(params.at("integral_cutoff")));
+        cout << "integral cutoff = " << scientific << setprecision(2)
+             << hamil->v_cutoff << " dropped = " << pdrop.first
+             << " dropped norm = " << setprecision(5) << pdrop.second << endl;
+        cout << fixed;
+    }
+
+    // dense pair-matrix copy of two-electron integrals for MPO construction
+    if (params.count("expand_integrals") != 0) {
+        fcidump->expand_integrals();
+        cout << "expanded integrals = " << fcidump->vexp->size() << endl;
+    }
+
     hamil->opf->seq->mode = SeqTypes::Simple;
 
     if (params.count("seq_type") != 0) {
@@ -177,6 +335,11 @@ template <typename S> void run(const map<string, string> &params) {
         }
     }
 
+    // davidson residual above which matvec uses single precision
+    if (params.count("single_prec_thrd") != 0)
+        hamil->opf->seq->single_prec_thrd =
+            Parsing::to_double(params.at("single_prec_thrd"));
+
     QCTypes qc_type = QCTypes::Conventional;
 
     if (params.count("qc_type") != 0) {
@@ -202,11 +365,58 @@ template <typename S> void run(const map<string, string> &params) {
 
     shared_ptr<MPO<S>> mpo;
 
-    if (params.count("load_mpo") != 0) {
-        string fn = params.at("load_mpo");
+    // automatic mpo cache: the final mpo is stored in the folder mpo_cache,
+    // named by a hash of the integrals, orbital symmetries and mpo options,
+    // and loaded instead of constructed when all of them match
+    string mpo_cache_fn = "", mpo_cache_key = "";
+    bool mpo_cache_hit = false;
+    if (params.count("mpo_cache") != 0 && params.count("load_mpo") == 0) {
+        if (params.count("stream_mpo") != 0)
+            throw runtime_error("stream_mpo cannot be used with mpo_cache.");
+        stringstream ss;
+        ss << "fcidump = " << hex << fcidump->content_hash() << dec << endl;
+        ss << "su2 = " << (int)is_same<S, SU2>::value << endl;
+        ss << "bond integer size = " << sizeof(ubond_t) << endl;
+        ss << "mkl integer size = " << sizeof(MKL_INT) << endl;
+        ss << "orbsym =";
+        for (auto x : orbsym)
+            ss << " " << (int)x;
+        ss << endl;
+        vector<string> keys = {"qc_type",         "trans_center",
+                               "integral_cutoff", "fused",
+                               "mrci-fused",      "sparse_mpo",
+                               "auto_sparse_mpo"};
+        // the automatic fusing plan depends on the bond dimensions
+        if (params.count("fused") != 0)
+            keys.push_back("bond_dims");
+        for (auto &k : keys)
+            if (params.count(k) != 0)
+                ss << k << " = " << params.at(k) << endl;
+        mpo_cache_key = ss.str();
+        const string dir = params.at("mpo_cache");
+        if (!Parsing::path_exists(dir))
+            Parsing::mkdir(dir);
+        stringstream sf;
+        sf << dir << "/MPO." << hex << setw(16) << setfill('0')
+           << Parsing::hash_bytes(mpo_cache_key.data(), mpo_cache_key.size());
+        mpo_cache_fn = sf.str();
+        if (Parsing::file_exists(mpo_cache_fn) &&
+            Parsing::file_exists(mpo_cache_fn + ".KEY")) {
+            ifstream ifs((mpo_cache_fn + ".KEY").c_str());
+            stringstream sk;
+            sk << ifs.rdbuf();
+            mpo_cache_hit = sk.str() == mpo_cache_key;
+        }
+        cout << "MPO cache " << (mpo_cache_hit ? "hit" : "miss") << " : "
+             << mpo_cache_fn << endl;
+    }
+
+    if (params.count("load_mpo") != 0 || mpo_cache_hit) {
+        string fn = mpo_cache_hit ? mpo_cache_fn : params.at("load_mpo");
         mpo = make_shared<MPO<S>>(0);
         cout << "MPO loading start" << endl;
-        mpo->load_data(fn);
+        // lazy loading: site tensors and symbols are read when visited
+        mpo->load_data(fn, params.count("lazy_mpo") != 0);
         if (mpo->sparse_form.find('S') == string::npos)
             mpo->tf = make_shared<TensorFunctions<S>>(hamil->opf);
         else
@@ -223,7 +433,17 @@ template <typename S> void run(const map<string, string> &params) {
     } else {
         // MPO construction
         cout << "MPO start" << endl;
-        mpo = make_shared<MPOQC<S>>(hamil, qc_type, trans_center);
+        // streaming: site data is archived as soon as it is built
+        string stream_fn = "";
+        if (params.count("stream_mpo") != 0) {
+            if (params.count("fused") != 0 || params.count("mrci-fused") != 0 ||
+                params.count("save_mpo") != 0)
+                throw runtime_error(
+                    "stream_mpo cannot be used with fused or save_mpo.");
+            stream_fn = frame_()->save_dir + "/" + frame_()->prefix_distri +
+                        ".AR.STREAM.MPO";
+        }
+        mpo = make_shared<MPOQC<S>>(hamil, qc_type, trans_center, stream_fn);
         cout << "MPO end .. T = " << t.get_time() << endl;
 
         if (params.count("fused") != 0 || params.count("mrci-fused") != 0) {
@@ -242,14 +462,34 @@ template <typename S> void run(const map<string, string> &params) {
             } else {
                 vector<string> xfused =
                     Parsing::split(params.at("fused"), " ", true);
-                if (xfused.size() == 1)
+                fusing_mps_info = make_shared<MPSInfo<S>>(
+                    hamil->n_sites, hamil->vacuum, target, hamil->basis);
+                if (xfused[0] == "auto") {
+                    // fuse edge sites whose fci dims are below the bond dim
+                    uint32_t max_bdim = 500;
+                    if (params.count("bond_dims") != 0) {
+                        max_bdim = 0;
+                        for (auto x : Parsing::split(params.at("bond_dims"),
+                                                     " ", true))
+                            max_bdim = max(max_bdim,
+                                           (uint32_t)Parsing::to_int(x));
+                    }
+                    size_t max_op_size = (size_t)1 << 27;
+                    if (xfused.size() > 1)
+                        max_op_size = (size_t)Parsing::to_double(xfused[1]);
+                    tie(n_extl, n_extr) = FusedMPO<S>::plan_edge_fusion(
+                        mpo, fusing_mps_info,
+                        (ubond_t)min(max_bdim,
+                                     (uint32_t)numeric_limits<ubond_t>::max()),
+                        max_op_size);
+                    cout << "MPO fusing plan = " << n_extl << " " << n_extr
+                         << endl;
+                } else if (xfused.size() == 1)
                     n_extr = Parsing::to_int(xfused[0]);
                 else {
                     n_extl = Parsing::to_int(xfused[0]);
                     n_extr = Parsing::to_int(xfused[1]);
                 }
-                fusing_mps_info = make_shared<MPSInfo<S>>(
-                    hamil->n_sites, hamil->vacuum, target, hamil->basis);
             }
 
             double sparsity = 1.1;
@@ -264,7 +504,9 @@ template <typename S> void run(const map<string, string> &params) {
             cout << "MPO fusing left start" << endl;
             for (int i = 0; i < n_extl - 1; i++) {
                 cout << "fusing left .. " << i + 1 << " / " << n_extl << endl;
-                mpo = make_shared<FusedMPO<S>>(mpo, hamil->basis, 0, 1);
+                mpo = make_shared<FusedMPO<S>>(
+                    mpo, hamil->basis, 0, 1,
+                    fusing_mps_info->left_dims_fci[i + 2]);
                 if (i == 10) {
                     for (auto &op : mpo->tensors[0]->ops) {
                         shared_ptr<CSRSparseMatrix<S>> smat =
@@ -325,6 +567,13 @@ template <typename S> void run(const map<string, string> &params) {
         cout << "MPO simplification end .. T = " << t.get_time() << endl;
     }
 
+    if (params.count("auto_sparse_mpo") != 0) {
+        double sparsity = Parsing::to_double(params.at("auto_sparse_mpo"));
+        size_t n_csr = mpo->auto_sparse_form(sparsity);
+        cout << "MPO sparse form = " << mpo->sparse_form << " (" << n_csr
+             << " CSR operators) .. T = " << t.get_time() << endl;
+    }
+
     if (params.count("save_mpo") != 0) {
         string fn = params.at("save_mpo");
         cout << "MPO saving start" << endl;
@@ -332,6 +581,18 @@ template <typename S> void run(const map<string, string> &params) {
         cout << "MPO saving end .. T = " << t.get_time() << endl;
     }
 
+    // write to a temporary file first so that an interrupted run
+    // never leaves an incomplete mpo behind a valid key
+    if (mpo_cache_fn != "" && !mpo_cache_hit) {
+        cout << "MPO cache saving start" << endl;
+        mpo->save_data(mpo_cache_fn + ".TMP");
+        Parsing::rename_file(mpo_cache_fn + ".TMP", mpo_cache_fn);
+        ofstream ofs((mpo_cache_fn + ".KEY").c_str());
+        ofs << mpo_cache_key;
+        ofs.close();
+        cout << "MPO cache saving end .. T = " << t.get_time() << endl;
+    }
+
     if (params.count("print_mpo") != 0)
         cout << mpo->get_blocking_formulas() << endl;
 
@@ -344,12 +605,18 @@ template <typename S> void run(const map<string, string> &params) {
 
     if (params.count("print_mpo_dims") != 0) {
         cout << "left mpo dims = ";
-        for (int i = 0; i < norb; i++)
+        for (int i = 0; i < norb; i++) {
+            mpo->load_left_operators(i);
             cout << mpo->left_operator_names[i]->data.size() << " ";
+            mpo->unload_left_operators(i);
+        }
         cout << endl;
         cout << "right mpo dims = ";
-        for (int i = 0; i < norb; i++)
+        for (int i = 0; i < norb; i++) {
+            mpo->load_right_operators(i);
             cout << mpo->right_operator_names[i]->data.size() << " ";
+            mpo->unload_right_operators(i);
+        }
         cout << endl;
     }
 
@@ -386,7 +653,7 @@ template <typename S> void run(const map<string, string> &params) {
 
     shared_ptr<MPSInfo<S>> mps_info = nullptr;
 
-    if (params.count("casci") != 0) {
+    if (params.count("casci") != 0 && !casci_folded) {
         // active sites, active electrons
         vector<string> xcasci = Parsing::split(params.at("casci"), " ", true);
         mps_info = make_shared<CASCIMPSInfo<S>>(
@@ -416,8 +683,52 @@ template <typename S> void run(const map<string, string> &params) {
     if (params.count("occ_bias") != 0)
         bias = Parsing::to_double(params.at("occ_bias"));
 
-    if (params.count("load_mps") != 0) {
-        mps_info->tag = params.at("load_mps");
+    // resume the interrupted sweep saved in restart_dir_site
+    const bool restart_site = params.count("restart_site") != 0 &&
+                              !!Parsing::to_int(params.at("restart_site"));
+    // resume the sweep schedule after the last completed sweep in
+    // restart_dir (auto), or at the given sweep index from the copy made
+    // in restart_dir_per_sweep after the previous sweep
+    int restart_sweep = -1;
+    string restart_sweep_dir = "";
+    if (params.count("restart_sweep") != 0) {
+        if (params.at("restart_sweep") == "auto")
+            restart_sweep_dir = frame_()->restart_dir;
+        else {
+            restart_sweep = Parsing::to_int(params.at("restart_sweep"));
+            if (restart_sweep < 1 || frame_()->restart_dir_per_sweep == "")
+                throw runtime_error("restart_sweep = <sweep index> requires "
+                                    "sweep index >= 1 and "
+                                    "restart_dir_per_sweep.");
+            restart_sweep_dir = frame_()->restart_dir_per_sweep + "." +
+                                Parsing::to_string(restart_sweep - 1);
+        }
+        if (restart_sweep_dir == "")
+            throw runtime_error("restart_sweep = auto requires restart_dir.");
+        if (!Parsing::path_exists(restart_sweep_dir))
+            throw runtime_error("cannot find sweep restart dir " +
+                                restart_sweep_dir);
+        if (restart_site)
+            throw runtime_error(
+                "restart_sweep cannot be used with restart_site.");
+        // file names in restart dirs and scratch depend on the prefix
+        if (params.count("prefix") == 0 || params.at("prefix") == "auto")
+            throw runtime_error("restart_sweep requires the prefix of the "
+                                "interrupted run.");
+    }
+    const bool load_mps =
+        params.count("load_mps") != 0 || restart_sweep_dir != "";
+    const string load_mps_tag =
+        params.count("load_mps") != 0 ? params.at("load_mps") : "KET";
+
+    const string mps_dir = frame_()->mps_dir;
+    if (restart_site)
+        frame_()->mps_dir = frame_()->restart_dir_site;
+    else if (restart_sweep_dir != "")
+        frame_()->mps_dir = restart_sweep_dir;
+
+    if (load_mps) {
+        mps_info->tag = load_mps_tag;
         mps_info->load_mutable();
     } else if (occs.size() == 0)
         mps_info->set_bond_dimension(bdims[0]);
@@ -455,10 +766,37 @@ template <typename S> void run(const map<string, string> &params) {
 
     if (params.count("dot") != 0)
         dot = Parsing::to_int(params.at("dot"));
+
+    // predict stack memory for the largest bond dimension and stop
+    if (params.count("dry_run") != 0) {
+        mps_info->set_bond_dimension(
+            *max_element(bdims.begin(), bdims.end()));
+        vector<vector<size_t>> mem = mpo->estimate_stack_memory(mps_info, dot);
+        vector<size_t> peak(4, 0);
+        cout << "predicted stack memory (main / secondary) :" << endl;
+        for (size_t i = 0; i < mem.size(); i++) {
+            cout << " Site = " << setw(4) << i << " | Dmem = "
+                 << Parsing::to_size_string(mem[i][0]) << " / "
+                 << Parsing::to_size_string(mem[i][1]) << " | Imem = "
+                 << Parsing::to_size_string(mem[i][2]) << " / "
+                 << Parsing::to_size_string(mem[i][3]) << endl;
+            for (int j = 0; j < 4; j++)
+                peak[j] = max(peak[j], mem[i][j]);
+        }
+        cout << "predicted peak | Dmem = " << Parsing::to_size_string(peak[0])
+             << " / " << Parsing::to_size_string(peak[1])
+             << " | Imem = " << Parsing::to_size_string(peak[2]) << " / "
+             << Parsing::to_size_string(peak[3]) << endl;
+        mps_info->deallocate();
+        mpo->deallocate();
+        hamil->deallocate();
+        fcidump->deallocate();
+        return;
+    }
     shared_ptr<MPS<S>> mps = nullptr;
 
-    if (params.count("load_mps") != 0) {
-        mps_info->tag = params.at("load_mps");
+    if (load_mps) {
+        mps_info->tag = load_mps_tag;
         mps = make_shared<MPS<S>>(mps_info);
         mps->load_data();
         mps->load_mutable();
@@ -469,6 +807,7 @@ template <typename S> void run(const map<string, string> &params) {
         mps->random_canonicalize();
     }
 
+    frame_()->mps_dir = mps_dir;
     mps->save_mutable();
     mps->deallocate();
     mps_info->save_mutable();
@@ -480,9 +819,25 @@ template <typename S> void run(const map<string, string> &params) {
 
     shared_ptr<MovingEnvironment<S>> me =
         make_shared<MovingEnvironment<S>>(mpo, mps, mps, "DMRG");
+    if (params.count("screening_cutoff") != 0)
+        me->screening_cutoff =
+            Parsing::to_double(params.at("screening_cutoff"));
+    // with sweep restart, partitions left in scratch by an interrupted run
+    // are reused when resuming if their signatures still match
+    if (params.count("reuse_environments") != 0)
+        me->reuse_environments =
+            !!Parsing::to_int(params.at("reuse_environments"));
+    else if (frame_()->restart_dir != "" ||
+             frame_()->restart_dir_per_sweep != "" || restart_sweep_dir != "")
+        me->reuse_environments = true;
     t.get_time();
     cout << "INIT start" << endl;
-    me->init_environments(iprint >= 2);
+    if (restart_site && frame_()->restart_site_distributed)
+        me->load_distributed_environments(frame_()->restart_dir_site);
+    else if (restart_site)
+        me->load_environments(frame_()->restart_dir_site);
+    else
+        me->init_environments(iprint >= 2);
     cout << "INIT end .. T = " << t.get_time() << endl;
 
     int n_sweeps = 30;
@@ -501,6 +856,21 @@ template <typename S> void run(const map<string, string> &params) {
     shared_ptr<DMRG<S>> dmrg = make_shared<DMRG<S>>(me, bdims, noises);
     dmrg->davidson_conv_thrds = davidson_conv_thrds;
     dmrg->iprint = iprint;
+    if (restart_site &&
+        !dmrg->load_site_restart(frame_()->restart_dir_site))
+        throw runtime_error("no mid-sweep checkpoint found in " +
+                            frame_()->restart_dir_site);
+    if (restart_sweep_dir != "") {
+        const int next_sweep = dmrg->load_sweep_restart(restart_sweep_dir);
+        if (next_sweep == -1)
+            throw runtime_error("no sweep schedule state found in " +
+                                restart_sweep_dir);
+        if (restart_sweep != -1 && next_sweep != restart_sweep)
+            throw runtime_error("sweep schedule state in " +
+                                restart_sweep_dir + " is not for sweep " +
+                                Parsing::to_string(restart_sweep));
+        cout << "resume at sweep = " << next_sweep << endl;
+    }
 
     if (params.count("noise_type") != 0) {
         if (params.at("noise_type") == "density_matrix")
@@ -550,6 +920,82 @@ template <typename S> void run(const map<string, string> &params) {
     if (params.count("cutoff") != 0)
         dmrg->cutoff = Parsing::to_double(params.at("cutoff"));
 
+    // quantum blocks at least this large only compute the kept states
+    if (params.count("decomp_rand_min_size") != 0)
+        dmrg->decomp_rand_min_size =
+            Parsing::to_int(params.at("decomp_rand_min_size"));
+
+    // perturbed wavefunctions held at once (in doubles) for reduced noise
+    if (params.count("noise_stream_memory") != 0)
+        dmrg->noise_stream_memory =
+            (size_t)Parsing::to_long_long(params.at("noise_stream_memory"));
+
+    // add one correction vector per unconverged root in each iteration
+    if (params.count("davidson_block") != 0 &&
+        !!Parsing::to_int(params.at("davidson_block")))
+        dmrg->davidson_type = dmrg->davidson_type | DavidsonTypes::Block;
+
+    // use thick-restart lanczos instead of davidson
+    if (params.count("davidson_lanczos") != 0 &&
+        !!Parsing::to_int(params.at("davidson_lanczos")))
+        dmrg->davidson_type = dmrg->davidson_type | DavidsonTypes::Lanczos;
+
+    // use chebyshev-filtered subspace iteration instead of davidson
+    // (for many roots)
+    if (params.count("davidson_chebyshev") != 0 &&
+        !!Parsing::to_int(params.at("davidson_chebyshev")))
+        dmrg->davidson_type = dmrg->davidson_type | DavidsonTypes::Chebyshev;
+
+    // refine the davidson correction by solving the jacobi-davidson
+    // correction equation with a few inner gcrot steps
+    if (params.count("davidson_jacobi") != 0 &&
+        !!Parsing::to_int(params.at("davidson_jacobi")))
+        dmrg->davidson_type =
+            dmrg->davidson_type | DavidsonTypes::JacobiDavidson;
+
+    // warm-start davidson at each site with this number of extra ritz
+    // vectors from the previous visit
+    if (params.count("davidson_recycle") != 0)
+        dmrg->davidson_recycle = Parsing::to_int(params.at("davidson_recycle"));
+
+    // davidson threshold at each site from the previous discarded weight
+    if (params.count("subspace_expansion") != 0)
+        dmrg->subspace_expansion =
+            !!Parsing::to_int(params.at("subspace_expansion"));
+    if (params.count("davidson_adaptive_factor") != 0)
+        dmrg->davidson_adaptive_factor =
+            Parsing::to_double(params.at("davidson_adaptive_factor"));
+    if (params.count("davidson_adaptive_max_thrd") != 0)
+        dmrg->davidson_adaptive_max_thrd =
+            Parsing::to_double(params.at("davidson_adaptive_max_thrd"));
+
+    // select the fastest of these seq types in the first sweep of each
+    // bond dimension
+    if (params.count("tune_seq_types") != 0) {
+        for (auto &x : Parsing::split(params.at("tune_seq_types"), " ", true))
+            if (x == "none")
+                dmrg->tune_seq_types.push_back(SeqTypes::None);
+            else if (x == "simple")
+                dmrg->tune_seq_types.push_back(SeqTypes::Simple);
+            else if (x == "auto")
+                dmrg->tune_seq_types.push_back(SeqTypes::Auto);
+            else if (x == "tasked")
+                dmrg->tune_seq_types.push_back(SeqTypes::Tasked);
+            else {
+                cerr << "unknown seq type : " << x << endl;
+                abort();
+            }
+    }
+
+    // extra sweeps with decreasing bond dimensions for extrapolation
+    if (params.count("extrapolation_bond_dims") != 0)
+        for (auto &x :
+             Parsing::split(params.at("extrapolation_bond_dims"), " ", true))
+            dmrg->extrapolation_bond_dims.push_back((ubond_t)Parsing::to_int(x));
+    if (params.count("extrapolation_n_sweeps") != 0)
+        dmrg->extrapolation_n_sweeps =
+            Parsing::to_int(params.at("extrapolation_n_sweeps"));
+
     dmrg->solve(n_sweeps, forward, tol);
 
     mps->save_data();
@@ -561,27 +1007,83 @@ template <typename S> void run(const map<string, string> &params) {
 
     frame_()->activate(0);
     assert(ialloc_()->used == 0 && dalloc_()->used == 0);
-    frame_() = nullptr;
+}
+
+template <typename S>
+bool run_job(const string &input, const map<string, string> &params) {
+    try {
+        run<S>(params);
+        return true;
+    } catch (const exception &e) {
+        cerr << "job " << input << " failed : " << e.what() << endl;
+        // stack memory may still be in use
+        frame_() = nullptr;
+        return false;
+    }
 }
 
 int main(int argc, char *argv[]) {
 
-    if (argc != 2) {
+    // service mode: block2 --queue <file> runs the input files listed in
+    // the file (one per line, read until end of file, "-" for stdin) in one
+    // process, reusing stack memory and threads between the jobs
+    const bool service = argc == 3 && string(argv[1]) == "--queue";
+    if (argc != 2 && !service) {
         cout << "usage : block2 <input filename>" << endl;
+        cout << "        block2 --queue <queue filename or ->" << endl;
         abort();
     }
+    ifstream ifs;
+    if (service && string(argv[2]) != "-") {
+        ifs.open(argv[2]);
+        if (!ifs.good())
+            throw runtime_error("reading on '" + string(argv[2]) +
+                                "' failed.");
+    }
+    istream &queue = service && string(argv[2]) == "-" ? cin : ifs;
+    // next input filename in the queue (empty at the end)
+    auto next_input = [&queue]() {
+        string line;
+        while (getline(queue, line)) {
+            Parsing::trim(line);
+            if (line != "" && line[0] != '#')
+                return line;
+        }
+        return string();
+    };
+
+    int n_jobs = 0, n_failed = 0;
+    for (string input = service ? next_input() : string(argv[1]); input != "";
+         input = service ? next_input() : string(), n_jobs++) {
+        if (service) {
+            cout << "JOB " << n_jobs << " : " << input << endl;
+            // threading options are set per job
+            threading_() = make_shared<Threading>();
+        }
 
-    string input = argv[1];
+        if (service && !Parsing::file_exists(input)) {
+            cerr << "cannot find input file : " << input << endl;
+            n_failed++;
+            continue;
+        }
 
-    auto params = read_input(input);
+        auto params = read_input(input);
 
-    if (params.count("su2") == 0 || !!Parsing::to_int(params.at("su2"))) {
-        cout << "SPIN-ADAPTED" << endl;
-        run<SU2>(params);
-    } else {
-        cout << "NON-SPIN-ADAPTED" << endl;
-        run<SZ>(params);
+        bool ok;
+        if (params.count("su2") == 0 || !!Parsing::to_int(params.at("su2"))) {
+            cout << "SPIN-ADAPTED" << endl;
+            ok = service ? run_job<SU2>(input, params)
+                         : (run<SU2>(params), true);
+        } else {
+            cout << "NON-SPIN-ADAPTED" << endl;
+            ok = service ? run_job<SZ>(input, params) : (run<SZ>(params), true);
+        }
+        n_failed += !ok;
     }
+    frame_() = nullptr;
+
+    if (service)
+        cout << "JOBS = " << n_jobs << " FAILED = " << n_failed << endl;
 
-    return 0;
+    return n_failed == 0 ? 0 : 1;
 }
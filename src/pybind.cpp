@@ -53,8 +53,16 @@ PYBIND11_MODULE(block2, m) {
             throw py::error_already_set();
     };
 
+#ifdef _USE_SU2SZ
     py::module m_su2 = m.def_submodule("su2", "Spin-adapted.");
     py::module m_sz = m.def_submodule("sz", "Non-spin-adapted.");
+#endif
+#ifdef _USE_KSYMM
+    py::module m_su2k =
+        m.def_submodule("su2k", "Spin-adapted with k symmetry.");
+    py::module m_szk =
+        m.def_submodule("szk", "Non-spin-adapted with k symmetry.");
+#endif
     bind_data<>(m);
 
 #ifdef _USE_CORE
@@ -63,16 +71,14 @@ PYBIND11_MODULE(block2, m) {
     bind_matrix<>(m);
     bind_symmetry<>(m);
 
+#ifdef _USE_SU2SZ
     bind_core<SU2>(m_su2, "SU2");
     bind_core<SZ>(m_sz, "SZ");
     bind_trans_state_info<SU2, SZ>(m_su2, "sz");
     bind_trans_state_info<SZ, SU2>(m_sz, "su2");
     bind_trans_state_info_spin_specific<SU2, SZ>(m_su2, "sz");
+#endif
 #ifdef _USE_KSYMM
-    py::module m_su2k =
-        m.def_submodule("su2k", "Spin-adapted with k symmetry.");
-    py::module m_szk =
-        m.def_submodule("szk", "Non-spin-adapted with k symmetry.");
     bind_core<SU2K>(m_su2k, "SU2K");
     bind_core<SZK>(m_szk, "SZK");
     bind_trans_state_info<SU2K, SZK>(m_su2k, "szk");
@@ -84,11 +90,13 @@ PYBIND11_MODULE(block2, m) {
 #ifdef _USE_DMRG
     bind_dmrg_types<>(m);
     bind_dmrg_io<>(m);
+#ifdef _USE_SU2SZ
     bind_dmrg<SU2>(m_su2, "SU2");
     bind_dmrg<SZ>(m_sz, "SZ");
     bind_trans_mps<SU2, SZ>(m_su2, "sz");
     bind_trans_mps<SZ, SU2>(m_sz, "su2");
     bind_trans_mps_spin_specific<SU2, SZ>(m_su2, "sz");
+#endif
 #ifdef _USE_KSYMM
     bind_dmrg<SU2K>(m_su2k, "SU2K");
     bind_dmrg<SZK>(m_szk, "SZK");
@@ -112,8 +120,10 @@ PYBIND11_MODULE(block2, m) {
 #endif
 
 #ifdef _USE_SP_DMRG
+#ifdef _USE_SU2SZ
     bind_sp_dmrg<SU2>(m_su2);
     bind_sp_dmrg<SZ>(m_sz);
+#endif
 #ifdef _USE_KSYMM
     bind_sp_dmrg<SU2K>(m_su2k);
     bind_sp_dmrg<SZK>(m_szk);
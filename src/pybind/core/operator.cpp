@@ -20,6 +20,10 @@
 
 #include "../pybind_core.hpp"
 
+#ifdef _TMPL_SZ
 template void bind_operator<SZ>(py::module &m);
+#endif
+#ifdef _TMPL_SU2
 template void bind_operator<SU2>(py::module &m);
+#endif
 
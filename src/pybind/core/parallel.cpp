@@ -20,5 +20,9 @@
 
 #include "../pybind_core.hpp"
 
+#ifdef _TMPL_SZ
 template void bind_parallel<SZ>(py::module &m);
+#endif
+#ifdef _TMPL_SU2
 template void bind_parallel<SU2>(py::module &m);
+#endif
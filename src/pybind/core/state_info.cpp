@@ -20,5 +20,9 @@
 
 #include "../pybind_core.hpp"
 
+#ifdef _TMPL_SZ
 template void bind_state_info<SZ>(py::module &m, const string &name);
+#endif
+#ifdef _TMPL_SU2
 template void bind_state_info<SU2>(py::module &m, const string &name);
+#endif
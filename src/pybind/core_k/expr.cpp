@@ -20,5 +20,9 @@
 
 #include "../pybind_core.hpp"
 
+#ifdef _TMPL_SZK
 template void bind_expr<SZK>(py::module &m);
+#endif
+#ifdef _TMPL_SU2K
 template void bind_expr<SU2K>(py::module &m);
+#endif
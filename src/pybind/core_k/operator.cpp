@@ -20,6 +20,10 @@
 
 #include "../pybind_core.hpp"
 
+#ifdef _TMPL_SZK
 template void bind_operator<SZK>(py::module &m);
+#endif
+#ifdef _TMPL_SU2K
 template void bind_operator<SU2K>(py::module &m);
+#endif
 
@@ -20,5 +20,9 @@
 
 #include "../pybind_core.hpp"
 
+#ifdef _TMPL_SZK
 template void bind_parallel<SZK>(py::module &m);
+#endif
+#ifdef _TMPL_SU2K
 template void bind_parallel<SU2K>(py::module &m);
+#endif
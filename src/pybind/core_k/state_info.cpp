@@ -20,5 +20,9 @@
 
 #include "../pybind_core.hpp"
 
+#ifdef _TMPL_SZK
 template void bind_state_info<SZK>(py::module &m, const string &name);
+#endif
+#ifdef _TMPL_SU2K
 template void bind_state_info<SU2K>(py::module &m, const string &name);
+#endif
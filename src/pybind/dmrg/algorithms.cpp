@@ -20,6 +20,10 @@
 
 #include "../pybind_dmrg.hpp"
 
+#ifdef _TMPL_SZ
 template void bind_algorithms<SZ>(py::module &m);
+#endif
+#ifdef _TMPL_SU2
 template void bind_algorithms<SU2>(py::module &m);
+#endif
 
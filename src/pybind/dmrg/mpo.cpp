@@ -20,5 +20,9 @@
 
 #include "../pybind_dmrg.hpp"
 
+#ifdef _TMPL_SZ
 template void bind_mpo<SZ>(py::module &m);
+#endif
+#ifdef _TMPL_SU2
 template void bind_mpo<SU2>(py::module &m);
+#endif
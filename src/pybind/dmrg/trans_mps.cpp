@@ -20,8 +20,14 @@
 
 #include "../pybind_dmrg.hpp"
 
+#ifdef _TMPL_SU2
 template void bind_trans_mps<SU2, SZ>(py::module &m, const string &aux_name);
+#endif
+#ifdef _TMPL_SZ
 template void bind_trans_mps<SZ, SU2>(py::module &m, const string &aux_name);
+#endif
+#ifdef _TMPL_SU2
 template auto bind_trans_mps_spin_specific<SU2, SZ>(py::module &m,
                                                 const string &aux_name)
     -> decltype(typename SU2::is_su2_t(typename SZ::is_sz_t()));
+#endif
@@ -20,6 +20,10 @@
 
 #include "../pybind_dmrg.hpp"
 
+#ifdef _TMPL_SZK
 template void bind_algorithms<SZK>(py::module &m);
+#endif
+#ifdef _TMPL_SU2K
 template void bind_algorithms<SU2K>(py::module &m);
+#endif
 
@@ -20,5 +20,9 @@
 
 #include "../pybind_dmrg.hpp"
 
+#ifdef _TMPL_SZK
 template void bind_partition<SZK>(py::module &m);
+#endif
+#ifdef _TMPL_SU2K
 template void bind_partition<SU2K>(py::module &m);
+#endif
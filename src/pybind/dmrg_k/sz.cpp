@@ -20,5 +20,7 @@
 
 #include "../pybind_dmrg.hpp"
 
+#ifdef _TMPL_SZK
 template auto bind_spin_specific<SZK>(py::module &m)
     -> decltype(typename SZK::is_sz_t());
+#endif
@@ -20,8 +20,14 @@
 
 #include "../pybind_dmrg.hpp"
 
+#ifdef _TMPL_SU2K
 template void bind_trans_mps<SU2K, SZK>(py::module &m, const string &aux_name);
+#endif
+#ifdef _TMPL_SZK
 template void bind_trans_mps<SZK, SU2K>(py::module &m, const string &aux_name);
+#endif
+#ifdef _TMPL_SU2K
 template auto bind_trans_mps_spin_specific<SU2K, SZK>(py::module &m,
                                                       const string &aux_name)
     -> decltype(typename SU2K::is_su2_t(typename SZK::is_sz_t()));
+#endif
@@ -54,6 +54,20 @@ template <typename S> void bind_big_site(py::module &m) {
                       const shared_ptr<ParallelRule<S>> &>())
         .def_readwrite("big_site", &ParallelBigSite<S>::big_site)
         .def_readwrite("rule", &ParallelBigSite<S>::rule);
+
+    py::class_<MappedBigSite<S>, shared_ptr<MappedBigSite<S>>, BigSite<S>>(
+        m, "MappedBigSite")
+        .def(py::init<const shared_ptr<BigSite<S>> &, const string &,
+                      const string &>())
+        .def_readwrite("big_site", &MappedBigSite<S>::big_site)
+        .def_readwrite("directory", &MappedBigSite<S>::directory)
+        .def_readwrite("key", &MappedBigSite<S>::key)
+        .def_readwrite("read_only", &MappedBigSite<S>::read_only)
+        .def_readwrite("n_loaded", &MappedBigSite<S>::n_loaded)
+        .def_readwrite("n_built", &MappedBigSite<S>::n_built)
+        .def_static("integral_hash", &MappedBigSite<S>::integral_hash)
+        .def_static("make_key", &MappedBigSite<S>::make_key)
+        .def("get_filename", &MappedBigSite<S>::get_filename);
 }
 
 template <typename S> void bind_sci_big_site_fock(py::module &m) {
@@ -129,6 +143,16 @@ template <typename S> void bind_sci_big_site_fock(py::module &m) {
 
 template <typename S> void bind_csf_big_site(py::module &m) {
 
+    py::class_<CSFCouplingCache, shared_ptr<CSFCouplingCache>>(
+        m, "CSFCouplingCache")
+        .def(py::init<>())
+        .def("size", &CSFCouplingCache::size)
+        .def("clear", &CSFCouplingCache::clear)
+        .def("save_data", (void (CSFCouplingCache::*)(const string &) const) &
+                              CSFCouplingCache::save_data)
+        .def("load_data", (void (CSFCouplingCache::*)(const string &)) &
+                              CSFCouplingCache::load_data);
+
     py::class_<CSFSpace<S>, shared_ptr<CSFSpace<S>>>(m, "CSFSpace")
         .def(py::init<int, int, bool, const std::vector<uint8_t> &>())
         .def("get_config", &CSFSpace<S>::get_config)
@@ -150,6 +174,7 @@ template <typename S> void bind_csf_big_site(py::module &m) {
         .def_readwrite("combinatorics", &CSFSpace<S>::combinatorics)
         .def_readwrite("basis", &CSFSpace<S>::basis)
         .def_readwrite("cg", &CSFSpace<S>::cg)
+        .def_readwrite("coupling_cache", &CSFSpace<S>::coupling_cache)
         .def_readwrite("n_orbs", &CSFSpace<S>::n_orbs)
         .def_readwrite("n_max_elec", &CSFSpace<S>::n_max_elec)
         .def_readwrite("n_max_unpaired", &CSFSpace<S>::n_max_unpaired)
@@ -185,7 +210,9 @@ template <typename S> void bind_hamiltonian_big_site(py::module &m) {
         .def_readwrite("n_orbs_left", &HamiltonianQCBigSite<S>::n_orbs_left)
         .def_readwrite("n_orbs_right", &HamiltonianQCBigSite<S>::n_orbs_right)
         .def_readwrite("n_orbs_cas", &HamiltonianQCBigSite<S>::n_orbs_cas)
-        .def_readwrite("full_hamil", &HamiltonianQCBigSite<S>::full_hamil);
+        .def_readwrite("full_hamil", &HamiltonianQCBigSite<S>::full_hamil)
+        .def_readwrite("csr_expected_calls",
+                       &HamiltonianQCBigSite<S>::csr_expected_calls);
 }
 
 template <typename S> void bind_dmrg_big_site(py::module &m) {
@@ -264,6 +291,8 @@ template <typename S> void bind_dmrg_big_site(py::module &m) {
             "RAS ACPF2 mode: Big sites on both ends")
         .def_readwrite("smallest_energy", &DMRGBigSiteAQCC<S>::smallest_energy)
         .def_readwrite("max_aqcc_iter", &DMRGBigSiteAQCC<S>::max_aqcc_iter)
+        .def_readwrite("incremental_shift",
+                       &DMRGBigSiteAQCC<S>::incremental_shift)
         .def_readwrite("g_factor", &DMRGBigSiteAQCC<S>::g_factor)
         .def_readwrite("g_factor2", &DMRGBigSiteAQCC<S>::g_factor2)
         .def_readwrite("ACPF2_mode", &DMRGBigSiteAQCC<S>::ACPF2_mode)
@@ -172,6 +172,23 @@ auto bind_cg(py::module &m) -> decltype(typename S::is_sz_t()) {
         .def("wigner_9j", &CG<S>::wigner_9j, py::arg("tja"), py::arg("tjb"),
              py::arg("tjc"), py::arg("tjd"), py::arg("tje"), py::arg("tjf"),
              py::arg("tjg"), py::arg("tjh"), py::arg("tji"))
+        .def(
+            "wigner_6j_batch",
+            [](CG<S> *self, const vector<int> &tjs) {
+                vector<long double> r(tjs.size() / 6);
+                self->wigner_6j_batch(r.size(), tjs.data(), r.data());
+                return r;
+            },
+            py::arg("tjs"))
+        .def(
+            "wigner_9j_batch",
+            [](CG<S> *self, const vector<int> &tjs) {
+                vector<long double> r(tjs.size() / 9);
+                self->wigner_9j_batch(r.size(), tjs.data(), r.data());
+                return r;
+            },
+            py::arg("tjs"))
+        .def_static("clear_cache", &CG<S>::clear_cache)
         .def("racah", &CG<S>::racah, py::arg("ta"), py::arg("tb"),
              py::arg("tc"), py::arg("td"), py::arg("te"), py::arg("tf"))
         .def("transpose_cg", &CG<S>::transpose_cg, py::arg("td"), py::arg("tl"),
@@ -198,6 +215,23 @@ auto bind_cg(py::module &m) -> decltype(typename S::is_su2_t()) {
         .def("wigner_9j", &CG<S>::wigner_9j, py::arg("tja"), py::arg("tjb"),
              py::arg("tjc"), py::arg("tjd"), py::arg("tje"), py::arg("tjf"),
              py::arg("tjg"), py::arg("tjh"), py::arg("tji"))
+        .def(
+            "wigner_6j_batch",
+            [](CG<S> *self, const vector<int> &tjs) {
+                vector<long double> r(tjs.size() / 6);
+                self->wigner_6j_batch(r.size(), tjs.data(), r.data());
+                return r;
+            },
+            py::arg("tjs"))
+        .def(
+            "wigner_9j_batch",
+            [](CG<S> *self, const vector<int> &tjs) {
+                vector<long double> r(tjs.size() / 9);
+                self->wigner_9j_batch(r.size(), tjs.data(), r.data());
+                return r;
+            },
+            py::arg("tjs"))
+        .def_static("clear_cache", &CG<S>::clear_cache)
         .def("racah", &CG<S>::racah, py::arg("ta"), py::arg("tb"),
              py::arg("tc"), py::arg("td"), py::arg("te"), py::arg("tf"))
         .def("transpose_cg", &CG<S>::transpose_cg, py::arg("td"), py::arg("tl"),
@@ -385,6 +419,7 @@ template <typename S> void bind_state_info(py::module &m, const string &name) {
         .def("deep_copy", &StateInfo<S>::deep_copy)
         .def("collect", &StateInfo<S>::collect,
              py::arg("target") = S(S::invalid))
+        .def("build_index", &StateInfo<S>::build_index)
         .def("find_state", &StateInfo<S>::find_state)
         .def_static("tensor_product_ref",
                     (StateInfo<S>(*)(const StateInfo<S> &, const StateInfo<S> &,
@@ -464,6 +499,12 @@ template <typename S> void bind_sparse(py::module &m) {
              py::arg("start") = 0)
         .def_property_readonly("total_memory",
                                &SparseMatrixInfo<S>::get_total_memory)
+        .def_readonly("block_permuted", &SparseMatrixInfo<S>::block_permuted)
+        .def("set_block_order", &SparseMatrixInfo<S>::set_block_order,
+             py::arg("order"))
+        .def("get_block_order", &SparseMatrixInfo<S>::get_block_order)
+        .def("get_bra_major_block_order",
+             &SparseMatrixInfo<S>::get_bra_major_block_order)
         .def("allocate", &SparseMatrixInfo<S>::allocate, py::arg("length"),
              py::arg("ptr") = nullptr)
         .def("extract_state_info", &SparseMatrixInfo<S>::extract_state_info,
@@ -483,16 +524,44 @@ template <typename S> void bind_sparse(py::module &m) {
         .def_readwrite("factor", &SparseMatrix<S>::factor)
         .def_readwrite("total_memory", &SparseMatrix<S>::total_memory)
         .def("get_type", &SparseMatrix<S>::get_type)
+        // zero-copy view, keeping the SparseMatrix object alive
+        // the view is invalid after deallocate
         .def_property(
             "data",
             [](SparseMatrix<S> *self) {
-                return py::array_t<double>(self->total_memory, self->data);
+                return py::array_t<double>(self->total_memory, self->data,
+                                           py::cast(self));
             },
             [](SparseMatrix<S> *self, const py::array_t<double> &v) {
                 assert(v.size() == self->total_memory);
-                memcpy(self->data, v.data(),
-                       sizeof(double) * self->total_memory);
+                if (v.data() != self->data)
+                    memcpy(self->data, v.data(),
+                           sizeof(double) * self->total_memory);
             })
+        // use the memory of a numpy array as data without copying
+        // the array is kept alive by the SparseMatrix object
+        .def(
+            "wrap_data",
+            [](SparseMatrix<S> *self,
+               const shared_ptr<SparseMatrixInfo<S>> &info,
+               py::array_t<double, py::array::c_style> &v) {
+                if ((size_t)v.size() != info->get_total_memory())
+                    throw runtime_error("SparseMatrix:wrap_data size "
+                                        "mismatch.");
+                // external pointer, not deallocated by the SparseMatrix
+                self->alloc = nullptr;
+                self->allocate(info, v.mutable_data());
+            },
+            py::arg("info"), py::arg("data").noconvert(),
+            py::keep_alive<1, 3>())
+        .def("block",
+             [](SparseMatrix<S> *self, int idx) {
+                 MatrixRef mat = (*self)[idx];
+                 return py::array_t<double>(
+                     {(ssize_t)mat.m, (ssize_t)mat.n},
+                     {sizeof(double) * (ssize_t)mat.n, sizeof(double)},
+                     mat.data, py::cast(self));
+             })
         .def("clear", &SparseMatrix<S>::clear)
         .def("load_data",
              (void (SparseMatrix<S>::*)(
@@ -519,12 +588,16 @@ template <typename S> void bind_sparse(py::module &m) {
              py::arg("length"))
         .def("trace", &SparseMatrix<S>::trace)
         .def("norm", &SparseMatrix<S>::norm)
-        .def("__getitem__",
-             [](SparseMatrix<S> *self, int idx) { return (*self)[idx]; })
+        .def(
+            "__getitem__",
+            [](SparseMatrix<S> *self, int idx) { return (*self)[idx]; },
+            py::keep_alive<0, 1>())
         .def("__setitem__",
              [](SparseMatrix<S> *self, int idx, const py::array_t<double> &v) {
                  assert(v.size() == (*self)[idx].size());
-                 memcpy((*self)[idx].data, v.data(), sizeof(double) * v.size());
+                 if (v.data() != (*self)[idx].data)
+                     memcpy((*self)[idx].data, v.data(),
+                            sizeof(double) * v.size());
              })
         .def("left_split",
              [](SparseMatrix<S> *self, ubond_t bond_dim) {
@@ -605,6 +678,7 @@ template <typename S> void bind_sparse(py::module &m) {
         .def_readwrite("filename", &ArchivedSparseMatrix<S>::filename)
         .def_readwrite("offset", &ArchivedSparseMatrix<S>::offset)
         .def("load_archive", &ArchivedSparseMatrix<S>::load_archive)
+        .def("prefetch_archive", &ArchivedSparseMatrix<S>::prefetch_archive)
         .def("save_archive", &ArchivedSparseMatrix<S>::save_archive);
 
     py::class_<DelayedSparseMatrix<S>, shared_ptr<DelayedSparseMatrix<S>>,
@@ -626,6 +700,16 @@ template <typename S> void bind_sparse(py::module &m) {
         .def_readwrite("mat", &DelayedSparseMatrix<S, CSRSparseMatrix<S>>::mat)
         .def(py::init<const shared_ptr<CSRSparseMatrix<S>> &>());
 
+    py::class_<DelayedSparseMatrixCache<S>,
+               shared_ptr<DelayedSparseMatrixCache<S>>>(
+        m, "DelayedSparseMatrixCache")
+        .def(py::init<size_t>())
+        .def_readwrite("max_memory", &DelayedSparseMatrixCache<S>::max_memory)
+        .def_readonly("used", &DelayedSparseMatrixCache<S>::used)
+        .def_readonly("n_hits", &DelayedSparseMatrixCache<S>::n_hits)
+        .def_readonly("n_misses", &DelayedSparseMatrixCache<S>::n_misses)
+        .def("clear", &DelayedSparseMatrixCache<S>::clear);
+
     py::class_<DelayedSparseMatrix<S, OpExpr<S>>,
                shared_ptr<DelayedSparseMatrix<S, OpExpr<S>>>,
                DelayedSparseMatrix<S>>(m, "DelayedOpExprSparseMatrix")
@@ -675,12 +759,14 @@ template <typename S> void bind_sparse(py::module &m) {
         .def_property(
             "data",
             [](SparseMatrixGroup<S> *self) {
-                return py::array_t<double>(self->total_memory, self->data);
+                return py::array_t<double>(self->total_memory, self->data,
+                                           py::cast(self));
             },
             [](SparseMatrixGroup<S> *self, const py::array_t<double> &v) {
                 assert(v.size() == self->total_memory);
-                memcpy(self->data, v.data(),
-                       sizeof(double) * self->total_memory);
+                if (v.data() != self->data)
+                    memcpy(self->data, v.data(),
+                           sizeof(double) * self->total_memory);
             })
         .def("load_data", &SparseMatrixGroup<S>::load_data, py::arg("filename"),
              py::arg("load_info") = false, py::arg("i_alloc") = nullptr)
@@ -716,8 +802,10 @@ template <typename S> void bind_sparse(py::module &m) {
                  self->right_svd(qs, l, s, r);
                  return make_tuple(qs, l, s, r);
              })
-        .def("__getitem__",
-             [](SparseMatrixGroup<S> *self, int idx) { return (*self)[idx]; });
+        .def(
+            "__getitem__",
+            [](SparseMatrixGroup<S> *self, int idx) { return (*self)[idx]; },
+            py::keep_alive<0, 1>());
 
     py::bind_vector<vector<shared_ptr<SparseMatrixGroup<S>>>>(
         m, "VectorSpMatGroup");
@@ -803,6 +891,8 @@ template <typename S> void bind_operator(py::module &m) {
              py::arg("cexprs") = nullptr, py::arg("delayed") = OpNamesSet())
         .def("tensor_product_multi_multiply",
              &TensorFunctions<S>::tensor_product_multi_multiply)
+        .def("tensor_product_multi_multiply_panel",
+             &TensorFunctions<S>::tensor_product_multi_multiply_panel)
         .def("tensor_product_multiply",
              &TensorFunctions<S>::tensor_product_multiply)
         .def("tensor_product_diagonal",
@@ -858,6 +948,7 @@ template <typename S> void bind_hamiltonian(py::module &m) {
         .def_readwrite("basis", &Hamiltonian<S>::basis)
         .def_readwrite("site_op_infos", &Hamiltonian<S>::site_op_infos)
         .def_readwrite("delayed", &Hamiltonian<S>::delayed)
+        .def_readwrite("delayed_cache", &Hamiltonian<S>::delayed_cache)
         .def_static("combine_orb_sym", &Hamiltonian<S>::combine_orb_sym)
         .def("get_n_orbs_left", &Hamiltonian<S>::get_n_orbs_left)
         .def("get_n_orbs_right", &Hamiltonian<S>::get_n_orbs_right)
@@ -883,14 +974,33 @@ template <typename S> void bind_parallel(py::module &m) {
         .def_readwrite("tcomm", &ParallelCommunicator<S>::tcomm)
         .def_readwrite("para_type", &ParallelCommunicator<S>::para_type)
         .def("get_parallel_type", &ParallelCommunicator<S>::get_parallel_type)
+        .def_readwrite("trace_sweep", &ParallelCommunicator<S>::trace_sweep)
+        .def_readwrite("trace_site", &ParallelCommunicator<S>::trace_site)
         .def("barrier", &ParallelCommunicator<S>::barrier)
-        .def("split", &ParallelCommunicator<S>::split);
+        .def("split", &ParallelCommunicator<S>::split)
+        .def("get_node_rank", &ParallelCommunicator<S>::get_node_rank)
+        .def("read_node_shared_fcidump",
+             [](const shared_ptr<ParallelCommunicator<S>> &self,
+                const shared_ptr<FCIDUMP> &fcidump, const string &filename) {
+                 fcidump->read_node_shared(filename, self);
+             });
 
 #ifdef _HAS_MPI
     py::class_<MPICommunicator<S>, shared_ptr<MPICommunicator<S>>,
                ParallelCommunicator<S>>(m, "MPICommunicator")
         .def(py::init<>())
-        .def(py::init<int>());
+        .def(py::init<int>())
+        .def_readwrite("codec", &MPICommunicator<S>::codec)
+        .def_readwrite("compress_min_len",
+                       &MPICommunicator<S>::compress_min_len)
+        .def_readwrite("hierarchical", &MPICommunicator<S>::hierarchical)
+        .def_readwrite("hierarchical_min_len",
+                       &MPICommunicator<S>::hierarchical_min_len)
+        .def_readwrite("ranks_per_node", &MPICommunicator<S>::ranks_per_node)
+        .def_readwrite("reproducible", &MPICommunicator<S>::reproducible)
+        .def_readwrite("trace", &MPICommunicator<S>::trace)
+        .def("start_trace", &MPICommunicator<S>::start_trace)
+        .def("write_trace", &MPICommunicator<S>::write_trace);
 #endif
 
     py::class_<ParallelRule<S>, shared_ptr<ParallelRule<S>>>(m, "ParallelRule")
@@ -899,6 +1009,9 @@ template <typename S> void bind_parallel(py::module &m) {
                       ParallelCommTypes>())
         .def_readwrite("comm", &ParallelRule<S>::comm)
         .def_readwrite("comm_type", &ParallelRule<S>::comm_type)
+        .def_readwrite("record_costs", &ParallelRule<S>::record_costs)
+        .def_readwrite("dynamic_tasks", &ParallelRule<S>::dynamic_tasks)
+        .def_readwrite("dynamic_chunk", &ParallelRule<S>::dynamic_chunk)
         .def("get_parallel_type", &ParallelRule<S>::get_parallel_type)
         .def("set_partition", &ParallelRule<S>::set_partition)
         .def("split", &ParallelRule<S>::split)
@@ -1155,16 +1268,27 @@ template <typename S = void> void bind_types(py::module &m) {
         .def(py::self & py::self)
         .def(py::self | py::self);
 
+    py::bind_vector<vector<SeqTypes>>(m, "VectorSeqTypes");
+
+    py::enum_<GEMMBackendTypes>(m, "GEMMBackendTypes", py::arithmetic())
+        .value("Host", GEMMBackendTypes::Host)
+        .value("External", GEMMBackendTypes::External);
+
     py::enum_<DavidsonTypes>(m, "DavidsonTypes", py::arithmetic())
         .value("GreaterThan", DavidsonTypes::GreaterThan)
         .value("LessThan", DavidsonTypes::LessThan)
         .value("CloseTo", DavidsonTypes::CloseTo)
+        .value("Lanczos", DavidsonTypes::Lanczos)
         .value("Harmonic", DavidsonTypes::Harmonic)
         .value("HarmonicGreaterThan", DavidsonTypes::HarmonicGreaterThan)
         .value("HarmonicLessThan", DavidsonTypes::HarmonicLessThan)
         .value("HarmonicCloseTo", DavidsonTypes::HarmonicCloseTo)
         .value("DavidsonPrecond", DavidsonTypes::DavidsonPrecond)
         .value("NoPrecond", DavidsonTypes::NoPrecond)
+        .value("Block", DavidsonTypes::Block)
+        .value("Chebyshev", DavidsonTypes::Chebyshev)
+        .value("JacobiDavidson", DavidsonTypes::JacobiDavidson)
+        .value("Distributed", DavidsonTypes::Distributed)
         .value("Normal", DavidsonTypes::Normal)
         .def(py::self & py::self)
         .def(py::self | py::self);
@@ -1198,6 +1322,7 @@ template <typename S = void> void bind_types(py::module &m) {
     py::enum_<ParallelCommTypes>(m, "ParallelCommTypes", py::arithmetic())
         .value("Nothing", ParallelCommTypes::None)
         .value("NonBlocking", ParallelCommTypes::NonBlocking)
+        .value("OneSided", ParallelCommTypes::OneSided)
         .def(py::self & py::self)
         .def(py::self | py::self);
 
@@ -1289,6 +1414,70 @@ template <typename S = void> void bind_io(py::module &m) {
         .def_readwrite("used", &StackAllocator<double>::used)
         .def_readwrite("shift", &StackAllocator<double>::shift);
 
+    py::class_<StackMemoryTags, shared_ptr<StackMemoryTags>>(m,
+                                                          "StackMemoryTags")
+        .def(py::init<>())
+        .def_readonly("names", &StackMemoryTags::names)
+        .def_readonly("used", &StackMemoryTags::used)
+        .def_readonly("peak", &StackMemoryTags::peak)
+        .def_readwrite("current", &StackMemoryTags::current)
+        .def("get", &StackMemoryTags::get)
+        .def("reset_peak", &StackMemoryTags::reset_peak)
+        .def_readwrite("site", &StackMemoryTags::site)
+        .def_readonly("total", &StackMemoryTags::total)
+        .def_readonly("timeline_stride", &StackMemoryTags::timeline_stride)
+        .def("start_timeline", &StackMemoryTags::start_timeline,
+             py::arg("stride") = (size_t)1)
+        .def("peak_report", &StackMemoryTags::peak_report)
+        .def("timeline_csv",
+             [](StackMemoryTags *self) {
+                 stringstream ss;
+                 self->write_timeline(ss);
+                 return ss.str();
+             })
+        .def("__repr__", [](StackMemoryTags *self) {
+            stringstream ss;
+            ss << *self;
+            return ss.str();
+        });
+
+    py::enum_<ScratchFileTypes>(m, "ScratchFileTypes", py::arithmetic())
+        .value("Left", ScratchFileTypes::Left)
+        .value("Right", ScratchFileTypes::Right)
+        .value("MPS", ScratchFileTypes::MPS)
+        .value("Other", ScratchFileTypes::Other);
+
+    py::class_<IOMonitor::Stats>(m, "IOMonitorStats")
+        .def(py::init<>())
+        .def_readonly("count", &IOMonitor::Stats::count)
+        .def_readonly("bytes", &IOMonitor::Stats::bytes)
+        .def_readonly("n_slow", &IOMonitor::Stats::n_slow)
+        .def_readonly("time", &IOMonitor::Stats::time)
+        .def_readonly("max_time", &IOMonitor::Stats::max_time)
+        .def("bandwidth", &IOMonitor::Stats::bandwidth);
+
+    py::class_<IOMonitor, shared_ptr<IOMonitor>>(m, "IOMonitor")
+        .def(py::init<>())
+        .def(py::init<double>())
+        .def_readwrite("min_bandwidth", &IOMonitor::min_bandwidth)
+        .def_readwrite("min_bytes", &IOMonitor::min_bytes)
+        .def_readwrite("max_warnings", &IOMonitor::max_warnings)
+        .def_readonly("n_warnings", &IOMonitor::n_warnings)
+        .def_static("file_type", &IOMonitor::file_type)
+        .def("stats",
+             [](IOMonitor *self, ScratchFileTypes t, bool write) {
+                 return self->stats[(int)t][write];
+             })
+        .def_readonly("files", &IOMonitor::files)
+        .def("reset", &IOMonitor::reset)
+        .def("clear", &IOMonitor::clear)
+        .def("report", &IOMonitor::report)
+        .def("files_csv", [](IOMonitor *self) {
+            stringstream ss;
+            self->write_csv(ss);
+            return ss.str();
+        });
+
     struct Global {};
 
     py::class_<FPCodec<double>, shared_ptr<FPCodec<double>>>(m, "DoubleFPCodec")
@@ -1296,6 +1485,7 @@ template <typename S = void> void bind_io(py::module &m) {
         .def(py::init<double, size_t>())
         .def_readwrite("ndata", &FPCodec<double>::ndata)
         .def_readwrite("ncpsd", &FPCodec<double>::ncpsd)
+        .def_readwrite("indexed", &FPCodec<double>::indexed)
         .def("encode",
              [](FPCodec<double> *self, py::array_t<double> arr) {
                  double *tmp = new double[arr.size() + 2];
@@ -1342,6 +1532,20 @@ template <typename S = void> void bind_io(py::module &m) {
                  self->read_array(ss, arx.mutable_data(), arr_len);
                  return arx;
              })
+        .def("read_array_range",
+             [](FPCodec<double> *self, py::array_t<double> arr, size_t start,
+                size_t n) {
+                 size_t arr_len = arr.mutable_data()[0];
+                 stringstream ss;
+                 ss.write((char *)(arr.mutable_data() + 1),
+                          (arr.size() - 1) * sizeof(double));
+                 py::array_t<double> arx = py::array_t<double>(n);
+                 ss.clear();
+                 ss.seekg(0);
+                 self->read_array_range(ss, arr_len, start, n,
+                                        arx.mutable_data());
+                 return arx;
+             })
         .def("save",
              [](FPCodec<double> *self, const string &filename,
                 py::array_t<double> arr) {
@@ -1429,6 +1633,25 @@ template <typename S = void> void bind_io(py::module &m) {
                  self->fft(arx.mutable_data(), arx.size(), false);
                  return arx;
              })
+        .def(
+            "fft_batch",
+            [](FFT *self,
+               const py::array_t<complex<double>, py::array::c_style |
+                                                      py::array::forcecast>
+                   &arr,
+               bool forth) {
+                assert(arr.ndim() == 2);
+                py::array_t<complex<double>> arx =
+                    py::array_t<complex<double>>(
+                        {(ssize_t)arr.shape()[0], (ssize_t)arr.shape()[1]});
+                memcpy(arx.mutable_data(), arr.data(),
+                       arr.size() * sizeof(complex<double>));
+                self->fft_batch(arx.mutable_data(), arx.shape()[0],
+                                arx.shape()[1], forth);
+                return arx;
+            },
+            py::arg("arr"), py::arg("forth") = true)
+        .def("clear", &FFT::clear)
         .def_static("fftshift",
                     [](const py::array_t<complex<double>> &arr) {
                         py::array_t<complex<double>> arx =
@@ -1499,6 +1722,11 @@ template <typename S = void> void bind_io(py::module &m) {
                        &DataFrame::restart_dir_optimal_mps)
         .def_readwrite("restart_dir_optimal_mps_per_sweep",
                        &DataFrame::restart_dir_optimal_mps_per_sweep)
+        .def_readwrite("restart_dir_site", &DataFrame::restart_dir_site)
+        .def_readwrite("restart_site_interval",
+                       &DataFrame::restart_site_interval)
+        .def_readwrite("restart_site_distributed",
+                       &DataFrame::restart_site_distributed)
         .def_readwrite("prefix", &DataFrame::prefix)
         .def_readwrite("prefix_distri", &DataFrame::prefix_distri)
         .def_readwrite("prefix_can_write", &DataFrame::prefix_can_write)
@@ -1517,9 +1745,31 @@ template <typename S = void> void bind_io(py::module &m) {
         .def_readwrite("peak_used_memory", &DataFrame::peak_used_memory)
         .def_readwrite("load_buffering", &DataFrame::load_buffering)
         .def_readwrite("save_buffering", &DataFrame::save_buffering)
+        .def_readwrite("prefetch_buffering", &DataFrame::prefetch_buffering)
+        .def_readwrite("async_mps_save", &DataFrame::async_mps_save)
+        .def_readwrite("max_prefetch", &DataFrame::max_prefetch)
         .def_readwrite("use_main_stack", &DataFrame::use_main_stack)
         .def_readwrite("minimal_disk_usage", &DataFrame::minimal_disk_usage)
         .def_readwrite("fp_codec", &DataFrame::fp_codec)
+        .def_readwrite("mmap_scratch", &DataFrame::mmap_scratch)
+        .def_readwrite("thread_arenas", &DataFrame::thread_arenas)
+        .def_readonly("mem_tags", &DataFrame::mem_tags)
+        .def("track_memory_tags", &DataFrame::track_memory_tags)
+        .def("track_memory_timeline", &DataFrame::track_memory_timeline,
+             py::arg("stride") = (size_t)1)
+        .def_readonly("io_monitor", &DataFrame::io_monitor)
+        .def("monitor_io", &DataFrame::monitor_io,
+             py::arg("min_bandwidth") = 0.0)
+        .def_readwrite("zero_copy_save", &DataFrame::zero_copy_save)
+        .def_readwrite("direct_io", &DataFrame::direct_io)
+        .def_readwrite("ram_cache_size", &DataFrame::ram_cache_size)
+        .def_readwrite("local_disk_size", &DataFrame::local_disk_size)
+        .def_readwrite("spill_dir", &DataFrame::spill_dir)
+        .def("remove_data", &DataFrame::remove_data)
+        .def_readonly("huge_pages", &DataFrame::huge_pages)
+        .def("use_huge_pages", &DataFrame::use_huge_pages)
+        .def("set_alignment", &DataFrame::set_alignment, py::arg("n_bytes"))
+        .def("first_touch", &DataFrame::first_touch, py::arg("n_threads") = 0)
         .def("update_peak_used_memory", &DataFrame::update_peak_used_memory)
         .def("reset_peak_used_memory", &DataFrame::reset_peak_used_memory)
         .def("activate", &DataFrame::activate)
@@ -1556,6 +1806,10 @@ template <typename S = void> void bind_io(py::module &m) {
         .def(py::init<ThreadingTypes, int, int, int, int>())
         .def_readwrite("type", &Threading::type)
         .def_readwrite("seq_type", &Threading::seq_type)
+        .def_readwrite("gemm_backend", &Threading::gemm_backend)
+        .def_readwrite("small_gemm_size", &Threading::small_gemm_size)
+        .def_readwrite("reduce_chunk", &Threading::reduce_chunk)
+        .def_readwrite("deterministic_slots", &Threading::deterministic_slots)
         .def_readwrite("n_threads_op", &Threading::n_threads_op)
         .def_readwrite("n_threads_quanta", &Threading::n_threads_quanta)
         .def_readwrite("n_threads_mkl", &Threading::n_threads_mkl)
@@ -1579,6 +1833,14 @@ template <typename S = void> void bind_io(py::module &m) {
     py::bind_vector<vector<shared_ptr<StackAllocator<double>>>>(
         m, "VectorDoubleStackAllocator");
 
+    py::class_<ArchiveIO, shared_ptr<ArchiveIO>>(m, "ArchiveIO")
+        .def(py::init<>())
+        .def(py::init<size_t, int>(), py::arg("max_write_bytes"),
+             py::arg("max_prefetch") = 16)
+        .def_readwrite("max_write_bytes", &ArchiveIO::max_write_bytes)
+        .def_readwrite("max_prefetch", &ArchiveIO::max_prefetch)
+        .def("wait", &ArchiveIO::wait);
+
     py::class_<Global>(m, "Global")
         .def_property_static(
             "ialloc", [](py::object) { return ialloc_(); },
@@ -1595,7 +1857,10 @@ template <typename S = void> void bind_io(py::module &m) {
             [](py::object, shared_ptr<DataFrame> fr) { frame_() = fr; })
         .def_property_static(
             "threading", [](py::object) { return threading_(); },
-            [](py::object, shared_ptr<Threading> th) { threading_() = th; });
+            [](py::object, shared_ptr<Threading> th) { threading_() = th; })
+        .def_property_static(
+            "archive_io", [](py::object) { return archive_io_(); },
+            [](py::object, shared_ptr<ArchiveIO> aio) { archive_io_() = aio; });
 
     py::class_<Random, shared_ptr<Random>>(m, "Random")
         .def_static("rand_seed", &Random::rand_seed, py::arg("i") = 0U)
@@ -1609,6 +1874,132 @@ template <typename S = void> void bind_io(py::module &m) {
                                                         data.size(), a, b);
                     });
 
+    py::enum_<KernelTypes>(m, "KernelTypes", py::arithmetic())
+        .value("GEMM", KernelTypes::GEMM)
+        .value("BatchGEMM", KernelTypes::BatchGEMM)
+        .value("Eigs", KernelTypes::Eigs)
+        .value("SVD", KernelTypes::SVD)
+        .value("Read", KernelTypes::Read)
+        .value("Write", KernelTypes::Write);
+
+    py::class_<KernelCounters, unique_ptr<KernelCounters, py::nodelete>>(
+        m, "KernelCounters")
+        .def_static("enable",
+                    [](bool enabled) {
+                        kernel_counters_().enabled = enabled;
+                    },
+                    py::arg("enabled") = true)
+        .def_static("enabled", []() { return kernel_counters_().enabled; })
+        .def_static("reset", []() { kernel_counters_().reset(); })
+        .def_static("calls",
+                    [](KernelTypes k) {
+                        return (uint64_t)kernel_counters_().calls[(int)k];
+                    })
+        .def_static("flop",
+                    [](KernelTypes k) {
+                        return (uint64_t)kernel_counters_().flop[(int)k];
+                    })
+        .def_static("bytes",
+                    [](KernelTypes k) {
+                        return (uint64_t)kernel_counters_().bytes[(int)k];
+                    })
+        .def_static("time",
+                    [](KernelTypes k) { return kernel_counters_().time(k); })
+        .def_static("summary", []() { return kernel_counters_().summary(); });
+
+    py::enum_<HardwareEvents>(m, "HardwareEvents", py::arithmetic())
+        .value("Cycles", HardwareEvents::Cycles)
+        .value("Instructions", HardwareEvents::Instructions)
+        .value("LLCMisses", HardwareEvents::LLCMisses);
+
+    py::class_<HardwareCounters, unique_ptr<HardwareCounters, py::nodelete>>(
+        m, "HardwareCounters")
+        .def_static("supported", &HardwareCounters::supported)
+        .def_static("start", []() { return hardware_counters_().start(); })
+        .def_static("stop", []() { hardware_counters_().stop(); })
+        .def_static("enabled", []() { return hardware_counters_().enabled; })
+        .def_static("reset", []() { hardware_counters_().reset(); })
+        .def_static("phases",
+                    []() {
+                        vector<string> r;
+                        for (auto &ph : hardware_counters_().phases)
+                            r.push_back(ph.name);
+                        return r;
+                    })
+        .def_static("time",
+                    [](const string &name) {
+                        HardwareCounters &hc = hardware_counters_();
+                        return hc.phases[hc.phase(name)].time;
+                    })
+        .def_static("value",
+                    [](const string &name, HardwareEvents k) {
+                        HardwareCounters &hc = hardware_counters_();
+                        return hc.phases[hc.phase(name)].values[(int)k];
+                    })
+        .def_static("summary",
+                    []() { return hardware_counters_().summary(); });
+
+    py::class_<EventTracer, unique_ptr<EventTracer, py::nodelete>>(
+        m, "EventTracer")
+        .def_static("start",
+                    [](size_t capacity) {
+                        tracer_().capacity = capacity;
+                        tracer_().start();
+                    },
+                    py::arg("capacity") = (size_t)1 << 16)
+        .def_static("stop", []() { tracer_().stop(); })
+        .def_static("enabled", []() { return tracer_().enabled; })
+        .def_static("size", []() { return tracer_().size(); })
+        .def_static("save",
+                    [](const string &filename, int pid) {
+                        tracer_().save(filename, pid);
+                    },
+                    py::arg("filename"), py::arg("pid") = 0);
+
+    py::class_<DavidsonTelemetry, shared_ptr<DavidsonTelemetry>>(
+        m, "DavidsonTelemetry")
+        .def(py::init<>())
+        .def_readwrite("residuals", &DavidsonTelemetry::residuals)
+        .def_readwrite("eigvals", &DavidsonTelemetry::eigvals)
+        .def_readwrite("tmults", &DavidsonTelemetry::tmults)
+        .def_readwrite("roots", &DavidsonTelemetry::roots)
+        .def_readwrite("subspaces", &DavidsonTelemetry::subspaces)
+        .def_readwrite("n_solves", &DavidsonTelemetry::n_solves)
+        .def_readwrite("n_restarts", &DavidsonTelemetry::n_restarts)
+        .def_readwrite("n_recomputes", &DavidsonTelemetry::n_recomputes)
+        .def_readwrite("gap", &DavidsonTelemetry::gap)
+        .def_property_readonly("n_iters", &DavidsonTelemetry::n_iters)
+        .def_property_readonly("tmult", &DavidsonTelemetry::tmult)
+        .def("__repr__", [](DavidsonTelemetry *self) {
+            stringstream ss;
+            ss << *self;
+            return ss.str();
+        });
+
+    py::class_<LoadBalanceRecorder, shared_ptr<LoadBalanceRecorder>>(
+        m, "LoadBalanceRecorder")
+        .def(py::init<>())
+        .def(py::init<const vector<string> &>())
+        .def_readwrite("phases", &LoadBalanceRecorder::phases)
+        .def_readwrite("sites", &LoadBalanceRecorder::sites)
+        .def_readwrite("times", &LoadBalanceRecorder::times)
+        .def_readwrite("all_times", &LoadBalanceRecorder::all_times)
+        .def_readwrite("n_ranks", &LoadBalanceRecorder::n_ranks)
+        .def("time", &LoadBalanceRecorder::time)
+        .def("imbalance", &LoadBalanceRecorder::imbalance)
+        .def("report", &LoadBalanceRecorder::report, py::arg("n_worst") = 3);
+
+    py::class_<TimingTree, shared_ptr<TimingTree>>(m, "TimingTree")
+        .def(py::init<>())
+        .def(py::init<const string &, bool>(), py::arg("filename"),
+             py::arg("csv") = false)
+        .def_readwrite("filename", &TimingTree::filename)
+        .def_readwrite("csv", &TimingTree::csv)
+        .def_readwrite("isweep", &TimingTree::isweep)
+        .def("clear", &TimingTree::clear)
+        .def("to_json", &TimingTree::to_json)
+        .def("to_csv", &TimingTree::to_csv);
+
     py::class_<Parsing, shared_ptr<Parsing>>(m, "Parsing")
         .def_static("to_size_string", &Parsing::to_size_string,
                     py::arg("i") = (size_t)0U, py::arg("suffix") = "B");
@@ -1689,6 +2080,14 @@ template <typename S = void> void bind_matrix(py::module &m) {
         .def("deallocate", &ComplexMatrixRef::deallocate,
              py::arg("alloc") = nullptr);
 
+    py::class_<ComplexGCROTRecycle, shared_ptr<ComplexGCROTRecycle>>(
+        m, "ComplexGCROTRecycle")
+        .def(py::init<>())
+        .def_readwrite("ncs", &ComplexGCROTRecycle::ncs)
+        .def_readwrite("n", &ComplexGCROTRecycle::n)
+        .def_readwrite("shift", &ComplexGCROTRecycle::shift)
+        .def("clear", &ComplexGCROTRecycle::clear);
+
     py::class_<CSRMatrixRef, shared_ptr<CSRMatrixRef>>(m, "CSRMatrix")
         .def(py::init<>())
         .def(py::init<MKL_INT, MKL_INT>())
@@ -1810,10 +2209,39 @@ template <typename S = void> void bind_matrix(py::module &m) {
                                    {(ssize_t)self->n}, {sizeof(double)});
         });
 
+    py::class_<VExpandedInt, shared_ptr<VExpandedInt>>(m, "VExpandedInt")
+        .def(py::init<uint16_t, bool>())
+        .def_readonly("n", &VExpandedInt::n)
+        .def_readonly("m", &VExpandedInt::m)
+        .def_readonly("pidx", &VExpandedInt::pidx)
+        .def_readonly("offsets", &VExpandedInt::offsets)
+        .def("__call__",
+             [](VExpandedInt *self, uint16_t i, uint16_t j, uint16_t k,
+                uint16_t l) { return (*self)(i, j, k, l); })
+        .def("__call__",
+             [](VExpandedInt *self, uint8_t sl, uint8_t sr, uint16_t i,
+                uint16_t j, uint16_t k, uint16_t l) {
+                 return (*self)(sl, sr, i, j, k, l);
+             })
+        .def("size", &VExpandedInt::size);
+
     py::class_<FCIDUMP, shared_ptr<FCIDUMP>>(m, "FCIDUMP")
         .def(py::init<>())
-        .def("read", &FCIDUMP::read)
-        .def("write", &FCIDUMP::write)
+        .def("read", &FCIDUMP::read,
+             py::call_guard<py::gil_scoped_release>())
+        .def("write", &FCIDUMP::write, py::arg("filename"),
+             py::arg("binary") = false, py::arg("compress_level") = -1)
+        .def("write_text",
+             [](FCIDUMP *self) {
+                 stringstream ss;
+                 self->write_text(ss);
+                 return ss.str();
+             })
+        .def_static("is_binary", &FCIDUMP::is_binary)
+        .def("load_data",
+             (void (FCIDUMP::*)(const string &)) & FCIDUMP::load_data)
+        .def("save_data",
+             (void (FCIDUMP::*)(const string &) const) & FCIDUMP::save_data)
         .def("initialize_h1e",
              [](FCIDUMP *self, uint16_t n_sites, uint16_t n_elec, uint16_t twos,
                 uint16_t isym, double e, const py::array_t<double> &t) {
@@ -1910,6 +2338,8 @@ template <typename S = void> void bind_matrix(py::module &m) {
             "        i, j, k, l : spatial indices\n"
             "        sij, skl : spin indices (0=alpha, 1=beta)")
         .def("det_energy", &FCIDUMP::det_energy)
+        .def("expand_integrals", &FCIDUMP::expand_integrals)
+        .def_readwrite("vexp", &FCIDUMP::vexp)
         .def("exchange_matrix", &FCIDUMP::exchange_matrix)
         .def("abs_exchange_matrix", &FCIDUMP::abs_exchange_matrix)
         .def("h1e_matrix", &FCIDUMP::h1e_matrix)
@@ -1921,6 +2351,8 @@ template <typename S = void> void bind_matrix(py::module &m) {
              (void (FCIDUMP::*)(const vector<uint16_t> &)) & FCIDUMP::reorder)
         .def("rotate", &FCIDUMP::rotate)
         .def("deep_copy", &FCIDUMP::deep_copy)
+        .def("fold_frozen_core", &FCIDUMP::fold_frozen_core,
+             py::arg("n_core"), py::arg("n_active"))
         .def_static("array_reorder", &FCIDUMP::reorder<double>)
         .def_static("array_reorder", &FCIDUMP::reorder<uint8_t>)
         .def_property("orb_sym", &FCIDUMP::orb_sym<uint8_t>,
@@ -2094,6 +2526,42 @@ template <typename S = void> void bind_matrix(py::module &m) {
             }
         });
 
+    py::class_<DFFCIDUMP, shared_ptr<DFFCIDUMP>, FCIDUMP>(m, "DFFCIDUMP")
+        .def(py::init<>())
+        .def(py::init<double>())
+        .def_readwrite("cutoff", &DFFCIDUMP::cutoff)
+        .def_property_readonly("n_aux",
+                               [](DFFCIDUMP *self) {
+                                   return self->dfs.size() == 0
+                                              ? 0
+                                              : self->dfs[0].n_aux;
+                               })
+        .def("initialize_su2",
+             [](DFFCIDUMP *self, uint16_t n_sites, uint16_t n_elec,
+                uint16_t twos, uint16_t isym, double e,
+                const py::array_t<double> &t, const py::array_t<double> &l) {
+                 self->initialize_df_su2(n_sites, n_elec, twos, isym, e,
+                                         t.data(), t.size(), l.data(),
+                                         l.size());
+             })
+        .def("initialize_sz",
+             [](DFFCIDUMP *self, uint16_t n_sites, uint16_t n_elec,
+                uint16_t twos, uint16_t isym, double e, const py::tuple &t,
+                const py::tuple &l) {
+                 assert(t.size() == 2 && l.size() == 2);
+                 py::array_t<double> ta = t[0].cast<py::array_t<double>>();
+                 py::array_t<double> tb = t[1].cast<py::array_t<double>>();
+                 py::array_t<double> la = l[0].cast<py::array_t<double>>();
+                 py::array_t<double> lb = l[1].cast<py::array_t<double>>();
+                 self->initialize_df_sz(n_sites, n_elec, twos, isym, e,
+                                        ta.data(), ta.size(), tb.data(),
+                                        tb.size(), la.data(), la.size(),
+                                        lb.data(), lb.size());
+             })
+        .def("initialize_cholesky", &DFFCIDUMP::initialize_cholesky,
+             py::arg("fcidump"), py::arg("cutoff") = 1E-8)
+        .def("to_fcidump", &DFFCIDUMP::to_fcidump);
+
     py::class_<DyallFCIDUMP, shared_ptr<DyallFCIDUMP>, FCIDUMP>(m,
                                                                 "DyallFCIDUMP")
         .def(py::init<const shared_ptr<FCIDUMP> &, uint16_t, uint16_t>())
@@ -2138,7 +2606,8 @@ template <typename S = void> void bind_matrix(py::module &m) {
         m, "HubbardKSpaceFCIDUMP")
         .def(py::init<uint16_t, double, double>())
         .def_readwrite("const_u", &HubbardKSpaceFCIDUMP::const_u)
-        .def_readwrite("const_t", &HubbardKSpaceFCIDUMP::const_t);
+        .def_readwrite("const_t", &HubbardKSpaceFCIDUMP::const_t)
+        .def("conserved", &HubbardKSpaceFCIDUMP::conserved);
 
     py::class_<BatchGEMMSeq, shared_ptr<BatchGEMMSeq>>(m, "BatchGEMMSeq")
         .def_readwrite("batch", &BatchGEMMSeq::batch)
@@ -2146,6 +2615,9 @@ template <typename S = void> void bind_matrix(py::module &m) {
         .def_readwrite("refs", &BatchGEMMSeq::refs)
         .def_readwrite("cumulative_nflop", &BatchGEMMSeq::cumulative_nflop)
         .def_readwrite("mode", &BatchGEMMSeq::mode)
+        .def_readwrite("single_prec_thrd", &BatchGEMMSeq::single_prec_thrd)
+        .def_readwrite("single_prec", &BatchGEMMSeq::single_prec)
+        .def_readwrite("reuse_work", &BatchGEMMSeq::reuse_work)
         .def(py::init<>())
         .def(py::init<size_t>())
         .def(py::init<size_t, SeqTypes>())
@@ -47,12 +47,32 @@ auto bind_spin_specific(py::module &m) -> decltype(typename S::is_su2_t()) {
 
     py::class_<PDM2MPOQC<S>, shared_ptr<PDM2MPOQC<S>>, MPO<S>>(m, "PDM2MPOQC")
         .def(py::init<const shared_ptr<Hamiltonian<S>> &>(), py::arg("hamil"))
+        .def(py::init<const shared_ptr<Hamiltonian<S>> &, bool>(),
+             py::arg("hamil"), py::arg("symm_unique"))
         .def("get_matrix", &PDM2MPOQC<S>::template get_matrix<double>)
         .def("get_matrix", &PDM2MPOQC<S>::template get_matrix<complex<double>>)
         .def("get_matrix_spatial",
              &PDM2MPOQC<S>::template get_matrix_spatial<double>)
         .def("get_matrix_spatial",
-             &PDM2MPOQC<S>::template get_matrix_spatial<complex<double>>);
+             &PDM2MPOQC<S>::template get_matrix_spatial<complex<double>>)
+        .def("get_matrix_packed",
+             &PDM2MPOQC<S>::template get_matrix_packed<double>)
+        .def("get_matrix_packed",
+             &PDM2MPOQC<S>::template get_matrix_packed<complex<double>>)
+        .def("get_transition_matrix_spatial",
+             &PDM2MPOQC<S>::template get_transition_matrix_spatial<double>)
+        .def("get_transition_matrix_spatial",
+             &PDM2MPOQC<S>::template get_transition_matrix_spatial<
+                 complex<double>>)
+        .def_static("unpack_matrix",
+                    &PDM2MPOQC<S>::template unpack_matrix<double>)
+        .def_static("unpack_matrix",
+                    &PDM2MPOQC<S>::template unpack_matrix<complex<double>>)
+        .def_static("unpack_matrix_spatial",
+                    &PDM2MPOQC<S>::template unpack_matrix_spatial<double>)
+        .def_static(
+            "unpack_matrix_spatial",
+            &PDM2MPOQC<S>::template unpack_matrix_spatial<complex<double>>);
 }
 
 template <typename S>
@@ -66,18 +86,96 @@ auto bind_spin_specific(py::module &m) -> decltype(typename S::is_sz_t()) {
         .def(py::init<const shared_ptr<Hamiltonian<S>> &>(), py::arg("hamil"))
         .def(py::init<const shared_ptr<Hamiltonian<S>> &, uint16_t>(),
              py::arg("hamil"), py::arg("mask"))
+        .def(py::init<const shared_ptr<Hamiltonian<S>> &, uint16_t, bool>(),
+             py::arg("hamil"), py::arg("mask"), py::arg("symm_unique"))
         .def("get_matrix", &PDM2MPOQC<S>::template get_matrix<double>)
         .def("get_matrix", &PDM2MPOQC<S>::template get_matrix<complex<double>>)
         .def("get_matrix_spatial",
              &PDM2MPOQC<S>::template get_matrix_spatial<double>)
         .def("get_matrix_spatial",
-             &PDM2MPOQC<S>::template get_matrix_spatial<complex<double>>);
+             &PDM2MPOQC<S>::template get_matrix_spatial<complex<double>>)
+        .def("get_matrix_packed",
+             &PDM2MPOQC<S>::template get_matrix_packed<double>)
+        .def("get_matrix_packed",
+             &PDM2MPOQC<S>::template get_matrix_packed<complex<double>>)
+        .def("get_transition_matrix",
+             &PDM2MPOQC<S>::template get_transition_matrix<double>)
+        .def("get_transition_matrix",
+             &PDM2MPOQC<S>::template get_transition_matrix<complex<double>>)
+        .def("get_transition_matrix_spatial",
+             &PDM2MPOQC<S>::template get_transition_matrix_spatial<double>)
+        .def("get_transition_matrix_spatial",
+             &PDM2MPOQC<S>::template get_transition_matrix_spatial<
+                 complex<double>>)
+        .def_static("unpack_matrix",
+                    &PDM2MPOQC<S>::template unpack_matrix<double>)
+        .def_static("unpack_matrix",
+                    &PDM2MPOQC<S>::template unpack_matrix<complex<double>>)
+        .def_static("unpack_matrix_spatial",
+                    &PDM2MPOQC<S>::template unpack_matrix_spatial<double>)
+        .def_static(
+            "unpack_matrix_spatial",
+            &PDM2MPOQC<S>::template unpack_matrix_spatial<complex<double>>);
+
+    py::class_<PDM3Stream<S>, shared_ptr<PDM3Stream<S>>>(m, "PDM3Stream")
+        .def(py::init<const shared_ptr<Hamiltonian<S>> &,
+                      const shared_ptr<MPS<S>> &, ubond_t>(),
+             py::arg("hamil"), py::arg("mps"), py::arg("bond_dim"))
+        .def(py::init<const shared_ptr<Hamiltonian<S>> &,
+                      const shared_ptr<MPS<S>> &, ubond_t, const string &>(),
+             py::arg("hamil"), py::arg("mps"), py::arg("bond_dim"),
+             py::arg("filename"))
+        .def_readwrite("hamil", &PDM3Stream<S>::hamil)
+        .def_readwrite("mps", &PDM3Stream<S>::mps)
+        .def_readwrite("pdm2_mpo", &PDM3Stream<S>::pdm2_mpo)
+        .def_readwrite("bond_dim", &PDM3Stream<S>::bond_dim)
+        .def_readwrite("n_sweeps", &PDM3Stream<S>::n_sweeps)
+        .def_readwrite("cutoff", &PDM3Stream<S>::cutoff)
+        .def_readwrite("filename", &PDM3Stream<S>::filename)
+        .def_readwrite("tag", &PDM3Stream<S>::tag)
+        .def_readwrite("proc_id", &PDM3Stream<S>::proc_id)
+        .def_readwrite("n_procs", &PDM3Stream<S>::n_procs)
+        .def_readwrite("iprint", &PDM3Stream<S>::iprint)
+        .def_static("n_pairs", &PDM3Stream<S>::n_pairs)
+        .def_static("pair_index", &PDM3Stream<S>::pair_index)
+        .def("chunk_filename", &PDM3Stream<S>::chunk_filename)
+        .def("get_phi", &PDM3Stream<S>::get_phi)
+        .def("compute_chunk", &PDM3Stream<S>::compute_chunk)
+        .def("save_chunk", &PDM3Stream<S>::save_chunk)
+        .def("load_chunk", &PDM3Stream<S>::load_chunk)
+        .def("solve", &PDM3Stream<S>::solve,
+             py::call_guard<py::gil_scoped_release>())
+        .def("get_matrix_spatial", &PDM3Stream<S>::get_matrix_spatial)
+        .def("deallocate", &PDM3Stream<S>::deallocate);
 
     py::class_<SumMPOQC<S>, shared_ptr<SumMPOQC<S>>, MPO<S>>(m, "SumMPOQC")
         .def_readwrite("ts", &SumMPOQC<S>::ts)
         .def(py::init<const shared_ptr<HamiltonianQC<S>> &,
                       const vector<uint16_t> &>(),
              py::arg("hamil"), py::arg("pts"));
+
+    py::class_<GeneralMPO<S>, shared_ptr<GeneralMPO<S>>, MPO<S>>(m,
+                                                               "GeneralMPO")
+        .def_readwrite("n_dropped_terms", &GeneralMPO<S>::n_dropped_terms)
+        .def(py::init<const shared_ptr<Hamiltonian<S>> &,
+                      const vector<string> &, const vector<vector<uint16_t>> &,
+                      const vector<vector<uint8_t>> &, const vector<double> &,
+                      double, double>(),
+             py::arg("hamil"), py::arg("exprs"), py::arg("sites"),
+             py::arg("spins"), py::arg("coeffs"), py::arg("cutoff") = 1E-14,
+             py::arg("const_e") = 0.0)
+        .def_static(
+            "fcidump_terms",
+            [](const shared_ptr<FCIDUMP> &fcidump, double cutoff) {
+                vector<string> exprs;
+                vector<vector<uint16_t>> sites;
+                vector<vector<uint8_t>> spins;
+                vector<double> coeffs;
+                GeneralMPO<S>::fcidump_terms(fcidump, exprs, sites, spins,
+                                             coeffs, cutoff);
+                return py::make_tuple(exprs, sites, spins, coeffs);
+            },
+            py::arg("fcidump"), py::arg("cutoff") = 0.0);
 }
 
 template <typename S> void bind_mps(py::module &m) {
@@ -241,9 +339,12 @@ template <typename S> void bind_mps(py::module &m) {
         .def("get_type", &MPS<S>::get_type)
         .def("initialize", &MPS<S>::initialize, py::arg("info"),
              py::arg("init_left") = true, py::arg("init_right") = true)
+        .def("initialize_tensor", &MPS<S>::initialize_tensor, py::arg("info"),
+             py::arg("i"), py::arg("form"))
         .def("fill_thermal_limit", &MPS<S>::fill_thermal_limit)
         .def("canonicalize", &MPS<S>::canonicalize)
         .def("dynamic_canonicalize", &MPS<S>::dynamic_canonicalize)
+        .def("compact", &MPS<S>::compact, py::arg("cutoff") = 1E-14)
         .def("random_canonicalize", &MPS<S>::random_canonicalize)
         .def("from_singlet_embedding_wfn", &MPS<S>::from_singlet_embedding_wfn,
              py::arg("cg"), py::arg("para_rule") = nullptr)
@@ -330,7 +431,13 @@ template <typename S> void bind_mps(py::module &m) {
         .def("initialize", &UnfusedMPS<S>::initialize)
         .def("finalize", &UnfusedMPS<S>::finalize)
         .def("resolve_singlet_embedding",
-             &UnfusedMPS<S>::resolve_singlet_embedding);
+             &UnfusedMPS<S>::resolve_singlet_embedding)
+        .def_static("resolve_singlet_embedding_info",
+                    &UnfusedMPS<S>::resolve_singlet_embedding_info,
+                    py::arg("info"), py::arg("twosz"))
+        .def_static("resolve_singlet_embedding_tensor",
+                    &UnfusedMPS<S>::resolve_singlet_embedding_tensor,
+                    py::arg("i"), py::arg("spt"), py::arg("lq"));
 
     py::class_<DeterminantTRIE<S>, shared_ptr<DeterminantTRIE<S>>>(
         m, "DeterminantTRIE")
@@ -351,7 +458,10 @@ template <typename S> void bind_mps(py::module &m) {
         .def("__getitem__", &DeterminantTRIE<S>::operator[], py::arg("idx"))
         .def("get_state_occupation", &DeterminantTRIE<S>::get_state_occupation)
         .def("evaluate", &DeterminantTRIE<S>::evaluate, py::arg("mps"),
-             py::arg("cutoff") = 0.0);
+             py::arg("cutoff") = 0.0)
+        .def("construct_mps",
+             &DeterminantTRIE<S>::template construct_mps<S>, py::arg("info"),
+             py::arg("cutoff") = 1E-14);
 }
 
 template <typename S> void bind_partition(py::module &m) {
@@ -419,13 +529,28 @@ template <typename S> void bind_partition(py::module &m) {
         .def("multiply", &EffectiveHamiltonian<S>::multiply)
         .def("inverse_multiply", &EffectiveHamiltonian<S>::inverse_multiply)
         .def("greens_function", &EffectiveHamiltonian<S>::greens_function)
+        .def("greens_function_multi",
+             &EffectiveHamiltonian<S>::greens_function_multi)
         .def("expect", &EffectiveHamiltonian<S>::expect)
-        .def("rk4_apply", &EffectiveHamiltonian<S>::rk4_apply, py::arg("beta"),
-             py::arg("const_e"), py::arg("eval_energy") = false,
-             py::arg("para_rule") = nullptr)
-        .def("expo_apply", &EffectiveHamiltonian<S>::expo_apply,
-             py::arg("beta"), py::arg("const_e"), py::arg("symmetric"),
-             py::arg("iprint") = false, py::arg("para_rule") = nullptr)
+        .def(
+            "rk4_apply",
+            [](EffectiveHamiltonian<S> *self, double beta, double const_e,
+               bool eval_energy, const shared_ptr<ParallelRule<S>> &para_rule) {
+                return self->rk4_apply(beta, const_e, eval_energy, para_rule);
+            },
+            py::arg("beta"), py::arg("const_e"), py::arg("eval_energy") = false,
+            py::arg("para_rule") = nullptr)
+        .def(
+            "expo_apply",
+            [](EffectiveHamiltonian<S> *self, double beta, double const_e,
+               bool symmetric, bool iprint,
+               const shared_ptr<ParallelRule<S>> &para_rule, int s_step) {
+                return self->expo_apply(beta, const_e, symmetric, iprint,
+                                        para_rule, s_step);
+            },
+            py::arg("beta"), py::arg("const_e"), py::arg("symmetric"),
+            py::arg("iprint") = false, py::arg("para_rule") = nullptr,
+            py::arg("s_step") = 1)
         .def("deallocate", &EffectiveHamiltonian<S>::deallocate);
 
     py::bind_vector<vector<shared_ptr<EffectiveHamiltonian<S>>>>(
@@ -492,14 +617,30 @@ template <typename S> void bind_partition(py::module &m) {
         .def("__call__", &EffectiveHamiltonian<S, MultiMPS<S>>::operator(),
              py::arg("b"), py::arg("c"), py::arg("idx") = 0,
              py::arg("factor") = 1.0, py::arg("all_reduce") = true)
+        .def("multiply_panel",
+             &EffectiveHamiltonian<S, MultiMPS<S>>::multiply_panel,
+             py::arg("bs"), py::arg("cs"), py::arg("idx") = 0,
+             py::arg("factor") = 1.0, py::arg("all_reduce") = true)
         .def("eigs", &EffectiveHamiltonian<S, MultiMPS<S>>::eigs)
         .def("expect", &EffectiveHamiltonian<S, MultiMPS<S>>::expect)
-        .def("rk4_apply", &EffectiveHamiltonian<S, MultiMPS<S>>::rk4_apply,
-             py::arg("beta"), py::arg("const_e"),
-             py::arg("eval_energy") = false, py::arg("para_rule") = nullptr)
-        .def("expo_apply", &EffectiveHamiltonian<S, MultiMPS<S>>::expo_apply,
-             py::arg("beta"), py::arg("const_e"), py::arg("iprint") = false,
-             py::arg("para_rule") = nullptr)
+        .def(
+            "rk4_apply",
+            [](EffectiveHamiltonian<S, MultiMPS<S>> *self,
+               complex<double> beta, double const_e, bool eval_energy,
+               const shared_ptr<ParallelRule<S>> &para_rule) {
+                return self->rk4_apply(beta, const_e, eval_energy, para_rule);
+            },
+            py::arg("beta"), py::arg("const_e"), py::arg("eval_energy") = false,
+            py::arg("para_rule") = nullptr)
+        .def(
+            "expo_apply",
+            [](EffectiveHamiltonian<S, MultiMPS<S>> *self,
+               complex<double> beta, double const_e, bool iprint,
+               const shared_ptr<ParallelRule<S>> &para_rule) {
+                return self->expo_apply(beta, const_e, iprint, para_rule);
+            },
+            py::arg("beta"), py::arg("const_e"), py::arg("iprint") = false,
+            py::arg("para_rule") = nullptr)
         .def("deallocate", &EffectiveHamiltonian<S, MultiMPS<S>>::deallocate);
 
     py::class_<MovingEnvironment<S>, shared_ptr<MovingEnvironment<S>>>(
@@ -525,6 +666,17 @@ template <typename S> void bind_partition(py::module &m) {
         .def_readwrite("fuse_center", &MovingEnvironment<S>::fuse_center)
         .def_readwrite("save_partition_info",
                        &MovingEnvironment<S>::save_partition_info)
+        .def_readwrite("reuse_environments",
+                       &MovingEnvironment<S>::reuse_environments)
+        .def("get_environment_key", &MovingEnvironment<S>::get_environment_key)
+        .def("import_partitions", &MovingEnvironment<S>::import_partitions)
+        .def_readwrite("screening_cutoff",
+                       &MovingEnvironment<S>::screening_cutoff)
+        .def("screen_operators", &MovingEnvironment<S>::screen_operators)
+        .def_readwrite("left_signatures",
+                       &MovingEnvironment<S>::left_signatures)
+        .def_readwrite("right_signatures",
+                       &MovingEnvironment<S>::right_signatures)
         .def_readwrite("cached_opt", &MovingEnvironment<S>::cached_opt)
         .def_readwrite("cached_info", &MovingEnvironment<S>::cached_info)
         .def_readwrite("cached_contraction",
@@ -573,6 +725,12 @@ template <typename S> void bind_partition(py::module &m) {
              })
         .def("init_environments", &MovingEnvironment<S>::init_environments,
              py::arg("iprint") = false)
+        .def("save_environments", &MovingEnvironment<S>::save_environments)
+        .def("load_environments", &MovingEnvironment<S>::load_environments)
+        .def("save_distributed_environments",
+             &MovingEnvironment<S>::save_distributed_environments)
+        .def("load_distributed_environments",
+             &MovingEnvironment<S>::load_distributed_environments)
         .def("finalize_environments",
              &MovingEnvironment<S>::finalize_environments,
              py::arg("renormalize_ops") = true)
@@ -580,6 +738,7 @@ template <typename S> void bind_partition(py::module &m) {
         .def("move_to", &MovingEnvironment<S>::move_to, py::arg("i"),
              py::arg("preserve_data") = false)
         .def("partial_prepare", &MovingEnvironment<S>::partial_prepare)
+        .def("get_para_mpss", &MovingEnvironment<S>::get_para_mpss)
         .def("get_left_archive_filename",
              &MovingEnvironment<S>::get_left_archive_filename)
         .def("get_middle_archive_filename",
@@ -731,16 +890,30 @@ template <typename S> void bind_partition(py::module &m) {
 }
 
 template <typename S> void bind_qc_hamiltonian(py::module &m) {
+    py::class_<HamiltonianQCSiteOps<S>, shared_ptr<HamiltonianQCSiteOps<S>>>(
+        m, "HamiltonianQCSiteOps")
+        .def(py::init<>())
+        .def_readonly("n_refs", &HamiltonianQCSiteOps<S>::n_refs)
+        .def("empty", &HamiltonianQCSiteOps<S>::empty);
+
     py::class_<HamiltonianQC<S>, shared_ptr<HamiltonianQC<S>>, Hamiltonian<S>>(
         m, "HamiltonianQC")
         .def(py::init<>())
         .def(py::init<S, int, const vector<typename S::pg_t> &,
                       const shared_ptr<FCIDUMP> &>())
+        .def(py::init<S, int, const vector<typename S::pg_t> &,
+                      const shared_ptr<FCIDUMP> &,
+                      const shared_ptr<HamiltonianQCSiteOps<S>> &>(),
+             py::arg("vacuum"), py::arg("n_sites"), py::arg("orb_sym"),
+             py::arg("fcidump"), py::arg("site_ops"))
         .def_readwrite("fcidump", &HamiltonianQC<S>::fcidump)
+        .def_readwrite("site_ops", &HamiltonianQC<S>::site_ops)
         .def_property(
             "mu", [](HamiltonianQC<S> *self) { return self->mu; },
             [](HamiltonianQC<S> *self, double mu) { self->set_mu(mu); })
         .def_readwrite("op_prims", &HamiltonianQC<S>::op_prims)
+        .def_readwrite("v_cutoff", &HamiltonianQC<S>::v_cutoff)
+        .def("set_v_cutoff", &HamiltonianQC<S>::set_v_cutoff, py::arg("cutoff"))
         .def("v", &HamiltonianQC<S>::v)
         .def("t", &HamiltonianQC<S>::t)
         .def("e", &HamiltonianQC<S>::e)
@@ -779,13 +952,20 @@ void bind_expect(py::module &m, const string &name) {
         .def_readwrite("beta", &Expect<S, FL>::beta)
         .def_readwrite("partition_weights", &Expect<S, FL>::partition_weights)
         .def_readwrite("me", &Expect<S, FL>::me)
+        .def_readwrite("timing", &Expect<S, FL>::timing)
         .def_readwrite("bra_bond_dim", &Expect<S, FL>::bra_bond_dim)
         .def_readwrite("ket_bond_dim", &Expect<S, FL>::ket_bond_dim)
         .def_readwrite("expectations", &Expect<S, FL>::expectations)
+        .def_readwrite("transition", &Expect<S, FL>::transition)
+        .def_readwrite("transition_expectations",
+                       &Expect<S, FL>::transition_expectations)
         .def_readwrite("forward", &Expect<S, FL>::forward)
         .def_readwrite("trunc_type", &Expect<S, FL>::trunc_type)
         .def_readwrite("ex_type", &Expect<S, FL>::ex_type)
         .def_readwrite("algo_type", &Expect<S, FL>::algo_type)
+        .def_readwrite("compute_variance", &Expect<S, FL>::compute_variance)
+        .def_readwrite("two_site_variance", &Expect<S, FL>::two_site_variance)
+        .def_readwrite("variance_energy", &Expect<S, FL>::variance_energy)
         .def("update_one_dot", &Expect<S, FL>::update_one_dot)
         .def("update_multi_one_dot", &Expect<S, FL>::update_multi_one_dot)
         .def("update_two_dot", &Expect<S, FL>::update_two_dot)
@@ -793,7 +973,8 @@ void bind_expect(py::module &m, const string &name) {
         .def("blocking", &Expect<S, FL>::blocking)
         .def("sweep", &Expect<S, FL>::sweep)
         .def("solve", &Expect<S, FL>::solve, py::arg("propagate"),
-             py::arg("forward") = true)
+             py::arg("forward") = true,
+             py::call_guard<py::gil_scoped_release>())
         .def("get_1pdm_spatial", &Expect<S, FL>::get_1pdm_spatial,
              py::arg("n_physical_sites") = (uint16_t)0U)
         .def("get_1pdm", &Expect<S, FL>::get_1pdm,
@@ -802,10 +983,29 @@ void bind_expect(py::module &m, const string &name) {
              py::arg("n_physical_sites") = (uint16_t)0U)
         .def("get_2pdm", &Expect<S, FL>::get_2pdm,
              py::arg("n_physical_sites") = (uint16_t)0U)
+        .def("get_2pdm_packed", &Expect<S, FL>::get_2pdm_packed,
+             py::arg("n_physical_sites") = (uint16_t)0U)
+        .def("get_1pdm_spatial_from_2pdm",
+             &Expect<S, FL>::get_1pdm_spatial_from_2pdm,
+             py::arg("n_physical_sites") = (uint16_t)0U)
+        .def("get_1pdm_from_2pdm", &Expect<S, FL>::get_1pdm_from_2pdm,
+             py::arg("n_physical_sites") = (uint16_t)0U)
         .def("get_1npc_spatial", &Expect<S, FL>::get_1npc_spatial, py::arg("s"),
              py::arg("n_physical_sites") = (uint16_t)0U)
         .def("get_1npc", &Expect<S, FL>::get_1npc, py::arg("s"),
-             py::arg("n_physical_sites") = (uint16_t)0U);
+             py::arg("n_physical_sites") = (uint16_t)0U)
+        .def("get_transition_expectations",
+             &Expect<S, FL>::get_transition_expectations, py::arg("ib"),
+             py::arg("ik"))
+        .def("get_transition_1pdm_spatial",
+             &Expect<S, FL>::get_transition_1pdm_spatial, py::arg("ib"),
+             py::arg("ik"), py::arg("n_physical_sites") = (uint16_t)0U)
+        .def("get_transition_1pdm", &Expect<S, FL>::get_transition_1pdm,
+             py::arg("ib"), py::arg("ik"),
+             py::arg("n_physical_sites") = (uint16_t)0U)
+        .def("get_transition_2pdm_spatial",
+             &Expect<S, FL>::get_transition_2pdm_spatial, py::arg("ib"),
+             py::arg("ik"), py::arg("n_physical_sites") = (uint16_t)0U);
 }
 
 template <typename S> void bind_algorithms(py::module &m) {
@@ -834,6 +1034,14 @@ template <typename S> void bind_algorithms(py::module &m) {
         .def_readwrite("cutoff", &DMRG<S>::cutoff)
         .def_readwrite("quanta_cutoff", &DMRG<S>::quanta_cutoff)
         .def_readwrite("me", &DMRG<S>::me)
+        .def_readwrite("timing", &DMRG<S>::timing)
+        .def_readwrite("davidson_telemetry", &DMRG<S>::davidson_telemetry)
+        .def_readwrite("sweep_davidson_telemetry",
+                       &DMRG<S>::sweep_davidson_telemetry)
+        .def("davidson_telemetry_summary",
+             &DMRG<S>::davidson_telemetry_summary)
+        .def_readwrite("load_balance_report", &DMRG<S>::load_balance_report)
+        .def_readwrite("sweep_load_balance", &DMRG<S>::sweep_load_balance)
         .def_readwrite("ext_mes", &DMRG<S>::ext_mes)
         .def_readwrite("ext_mpss", &DMRG<S>::ext_mpss)
         .def_readwrite("state_specific", &DMRG<S>::state_specific)
@@ -845,7 +1053,33 @@ template <typename S> void bind_algorithms(py::module &m) {
                        &DMRG<S>::davidson_soft_max_iter)
         .def_readwrite("davidson_shift", &DMRG<S>::davidson_shift)
         .def_readwrite("davidson_type", &DMRG<S>::davidson_type)
+        .def_readwrite("diag_me", &DMRG<S>::diag_me)
+        .def_readwrite("davidson_recycle", &DMRG<S>::davidson_recycle)
+        .def_readwrite("davidson_adaptive_factor",
+                       &DMRG<S>::davidson_adaptive_factor)
+        .def_readwrite("subspace_expansion", &DMRG<S>::subspace_expansion)
+        .def_readwrite("expansion_alpha", &DMRG<S>::expansion_alpha)
+        .def_readwrite("expansion_noise", &DMRG<S>::expansion_noise)
+        .def("update_expansion_alpha", &DMRG<S>::update_expansion_alpha)
+        .def_readwrite("davidson_adaptive_max_thrd",
+                       &DMRG<S>::davidson_adaptive_max_thrd)
+        .def_readwrite("davidson_mults", &DMRG<S>::davidson_mults)
+        .def_readwrite("extrapolation_bond_dims",
+                       &DMRG<S>::extrapolation_bond_dims)
+        .def_readwrite("extrapolation_n_sweeps",
+                       &DMRG<S>::extrapolation_n_sweeps)
+        .def_readwrite("extrapolation_energies",
+                       &DMRG<S>::extrapolation_energies)
+        .def_readwrite("extrapolation_discarded_weights",
+                       &DMRG<S>::extrapolation_discarded_weights)
+        .def_readwrite("extrapolated_energy", &DMRG<S>::extrapolated_energy)
+        .def_readwrite("extrapolation_slope", &DMRG<S>::extrapolation_slope)
+        .def("extrapolate", &DMRG<S>::extrapolate)
         .def_readwrite("conn_adjust_step", &DMRG<S>::conn_adjust_step)
+        .def_readwrite("conn_adjust_balanced", &DMRG<S>::conn_adjust_balanced)
+        .def("balance_conn_centers", &DMRG<S>::balance_conn_centers)
+        .def_readwrite("tune_seq_types", &DMRG<S>::tune_seq_types)
+        .def_readwrite("tune_n_mult", &DMRG<S>::tune_n_mult)
         .def_readwrite("energies", &DMRG<S>::energies)
         .def_readwrite("discarded_weights", &DMRG<S>::discarded_weights)
         .def_readwrite("mps_quanta", &DMRG<S>::mps_quanta)
@@ -856,6 +1090,8 @@ template <typename S> void bind_algorithms(py::module &m) {
         .def_readwrite("forward", &DMRG<S>::forward)
         .def_readwrite("noise_type", &DMRG<S>::noise_type)
         .def_readwrite("trunc_type", &DMRG<S>::trunc_type)
+        .def_readwrite("decomp_rand_min_size", &DMRG<S>::decomp_rand_min_size)
+        .def_readwrite("noise_stream_memory", &DMRG<S>::noise_stream_memory)
         .def_readwrite("decomp_type", &DMRG<S>::decomp_type)
         .def_readwrite("decomp_last_site", &DMRG<S>::decomp_last_site)
         .def_readwrite("sweep_cumulative_nflop",
@@ -863,6 +1099,16 @@ template <typename S> void bind_algorithms(py::module &m) {
         .def_readwrite("sweep_max_pket_size", &DMRG<S>::sweep_max_pket_size)
         .def_readwrite("sweep_max_eff_ham_size",
                        &DMRG<S>::sweep_max_eff_ham_size)
+        .def_readwrite("store_orbital_rdms", &DMRG<S>::store_orbital_rdms)
+        .def_readwrite("orbital_rdms", &DMRG<S>::orbital_rdms)
+        .def_readwrite("sector_prune_cutoff", &DMRG<S>::sector_prune_cutoff)
+        .def_readwrite("sector_prune_visits", &DMRG<S>::sector_prune_visits)
+        .def_readwrite("progress_filename", &DMRG<S>::progress_filename)
+        .def("wait_progress", &DMRG<S>::wait_progress)
+        .def("clear_sector_idle_visits",
+             [](DMRG<S> *self) { self->sector_idle_visits.clear(); })
+        .def("get_orbital_occupations", &DMRG<S>::get_orbital_occupations)
+        .def("get_orbital_entropies", &DMRG<S>::get_orbital_entropies)
         .def("update_two_dot", &DMRG<S>::update_two_dot)
         .def("update_one_dot", &DMRG<S>::update_one_dot)
         .def("update_multi_two_dot", &DMRG<S>::update_multi_two_dot)
@@ -872,8 +1118,11 @@ template <typename S> void bind_algorithms(py::module &m) {
         .def("connection_sweep", &DMRG<S>::connection_sweep)
         .def("unordered_sweep", &DMRG<S>::unordered_sweep)
         .def("sweep", &DMRG<S>::sweep)
+        .def("save_site_restart", &DMRG<S>::save_site_restart)
+        .def("load_site_restart", &DMRG<S>::load_site_restart)
         .def("solve", &DMRG<S>::solve, py::arg("n_sweeps"),
-             py::arg("forward") = true, py::arg("tol") = 1E-6);
+             py::arg("forward") = true, py::arg("tol") = 1E-6,
+             py::call_guard<py::gil_scoped_release>());
 
     py::class_<typename TDDMRG<S>::Iteration,
                shared_ptr<typename TDDMRG<S>::Iteration>>(m, "TDDMRGIteration")
@@ -898,6 +1147,7 @@ template <typename S> void bind_algorithms(py::module &m) {
         .def(py::init<const shared_ptr<MovingEnvironment<S>> &,
                       const vector<ubond_t> &>())
         .def_readwrite("me", &TDDMRG<S>::me)
+        .def_readwrite("timing", &TDDMRG<S>::timing)
         .def_readwrite("lme", &TDDMRG<S>::lme)
         .def_readwrite("rme", &TDDMRG<S>::rme)
         .def_readwrite("iprint", &TDDMRG<S>::iprint)
@@ -916,6 +1166,16 @@ template <typename S> void bind_algorithms(py::module &m) {
         .def_readwrite("decomp_type", &TDDMRG<S>::decomp_type)
         .def_readwrite("decomp_last_site", &TDDMRG<S>::decomp_last_site)
         .def_readwrite("hermitian", &TDDMRG<S>::hermitian)
+        .def_readwrite("krylov_s_step", &TDDMRG<S>::krylov_s_step)
+        .def_readwrite("adaptive_step", &TDDMRG<S>::adaptive_step)
+        .def_readwrite("step_tol", &TDDMRG<S>::step_tol)
+        .def_readwrite("step_factor_min", &TDDMRG<S>::step_factor_min)
+        .def_readwrite("step_factor_max", &TDDMRG<S>::step_factor_max)
+        .def_readwrite("step_min", &TDDMRG<S>::step_min)
+        .def_readwrite("step_max", &TDDMRG<S>::step_max)
+        .def_readwrite("sweep_step_factor", &TDDMRG<S>::sweep_step_factor)
+        .def_readwrite("betas", &TDDMRG<S>::betas)
+        .def_readwrite("next_beta", &TDDMRG<S>::next_beta)
         .def_readwrite("sweep_cumulative_nflop",
                        &TDDMRG<S>::sweep_cumulative_nflop)
         .def("update_one_dot", &TDDMRG<S>::update_one_dot)
@@ -923,8 +1183,10 @@ template <typename S> void bind_algorithms(py::module &m) {
         .def("blocking", &TDDMRG<S>::blocking)
         .def("sweep", &TDDMRG<S>::sweep)
         .def("normalize", &TDDMRG<S>::normalize)
+        .def("adapt_step", &TDDMRG<S>::adapt_step)
         .def("solve", &TDDMRG<S>::solve, py::arg("n_sweeps"), py::arg("beta"),
-             py::arg("forward") = true, py::arg("tol") = 1E-6);
+             py::arg("forward") = true, py::arg("tol") = 1E-6,
+             py::call_guard<py::gil_scoped_release>());
 
     py::class_<typename TimeEvolution<S>::Iteration,
                shared_ptr<typename TimeEvolution<S>::Iteration>>(
@@ -970,6 +1232,20 @@ template <typename S> void bind_algorithms(py::module &m) {
         .def_readwrite("decomp_type", &TimeEvolution<S>::decomp_type)
         .def_readwrite("normalize_mps", &TimeEvolution<S>::normalize_mps)
         .def_readwrite("hermitian", &TimeEvolution<S>::hermitian)
+        .def_readwrite("krylov_s_step", &TimeEvolution<S>::krylov_s_step)
+        .def_readwrite("adaptive_step", &TimeEvolution<S>::adaptive_step)
+        .def_readwrite("step_tol", &TimeEvolution<S>::step_tol)
+        .def_readwrite("step_factor_min", &TimeEvolution<S>::step_factor_min)
+        .def_readwrite("step_factor_max", &TimeEvolution<S>::step_factor_max)
+        .def_readwrite("step_min", &TimeEvolution<S>::step_min)
+        .def_readwrite("step_max", &TimeEvolution<S>::step_max)
+        .def_readwrite("sweep_step_factor", &TimeEvolution<S>::sweep_step_factor)
+        .def_readwrite("betas", &TimeEvolution<S>::betas)
+        .def_readwrite("next_beta", &TimeEvolution<S>::next_beta)
+        .def_readwrite("total_beta", &TimeEvolution<S>::total_beta)
+        .def_readwrite("observables", &TimeEvolution<S>::observables)
+        .def_readwrite("observables_filename",
+                       &TimeEvolution<S>::observables_filename)
         .def_readwrite("sweep_cumulative_nflop",
                        &TimeEvolution<S>::sweep_cumulative_nflop)
         .def("update_one_dot", &TimeEvolution<S>::update_one_dot)
@@ -977,10 +1253,120 @@ template <typename S> void bind_algorithms(py::module &m) {
         .def("update_multi_one_dot", &TimeEvolution<S>::update_multi_one_dot)
         .def("update_multi_two_dot", &TimeEvolution<S>::update_multi_two_dot)
         .def("blocking", &TimeEvolution<S>::blocking)
-        .def("sweep", &TimeEvolution<S>::sweep)
+        .def(
+            "measure",
+            [](TimeEvolution<S> *self, int i, bool forward) {
+                self->measure(i, forward);
+            },
+            py::arg("i"), py::arg("forward"))
+        .def("sweep", &TimeEvolution<S>::sweep, py::arg("forward"),
+             py::arg("advance"), py::arg("beta"), py::arg("bond_dim"),
+             py::arg("noise"), py::arg("measure") = false)
         .def("normalize", &TimeEvolution<S>::normalize)
+        .def("adapt_step", &TimeEvolution<S>::adapt_step)
         .def("solve", &TimeEvolution<S>::solve, py::arg("n_sweeps"),
-             py::arg("beta"), py::arg("forward") = true, py::arg("tol") = 1E-6);
+             py::arg("beta"), py::arg("forward") = true, py::arg("tol") = 1E-6,
+             py::call_guard<py::gil_scoped_release>());
+
+    py::class_<GlobalKrylovTE<S>, shared_ptr<GlobalKrylovTE<S>>>(
+        m, "GlobalKrylovTE")
+        .def(py::init<const shared_ptr<MPO<S>> &, const shared_ptr<MPO<S>> &,
+                      const shared_ptr<MPS<S>> &, const vector<ubond_t> &>())
+        .def(py::init<const shared_ptr<MPO<S>> &, const shared_ptr<MPO<S>> &,
+                      const shared_ptr<MPS<S>> &, const vector<ubond_t> &,
+                      const vector<double> &>())
+        .def_readwrite("mpo", &GlobalKrylovTE<S>::mpo)
+        .def_readwrite("impo", &GlobalKrylovTE<S>::impo)
+        .def_readwrite("mps", &GlobalKrylovTE<S>::mps)
+        .def_readwrite("bond_dims", &GlobalKrylovTE<S>::bond_dims)
+        .def_readwrite("noises", &GlobalKrylovTE<S>::noises)
+        .def_readwrite("energies", &GlobalKrylovTE<S>::energies)
+        .def_readwrite("normsqs", &GlobalKrylovTE<S>::normsqs)
+        .def_readwrite("n_krylov", &GlobalKrylovTE<S>::n_krylov)
+        .def_readwrite("n_sweeps", &GlobalKrylovTE<S>::n_sweeps)
+        .def_readwrite("tol", &GlobalKrylovTE<S>::tol)
+        .def_readwrite("krylov_break_tol", &GlobalKrylovTE<S>::krylov_break_tol)
+        .def_readwrite("noise_type", &GlobalKrylovTE<S>::noise_type)
+        .def_readwrite("decomp_type", &GlobalKrylovTE<S>::decomp_type)
+        .def_readwrite("trunc_type", &GlobalKrylovTE<S>::trunc_type)
+        .def_readwrite("cutoff", &GlobalKrylovTE<S>::cutoff)
+        .def_readwrite("normalize_mps", &GlobalKrylovTE<S>::normalize_mps)
+        .def_readwrite("iprint", &GlobalKrylovTE<S>::iprint)
+        .def_readwrite("tag", &GlobalKrylovTE<S>::tag)
+        .def("expect", &GlobalKrylovTE<S>::expect)
+        .def("fit", &GlobalKrylovTE<S>::fit)
+        .def("step", &GlobalKrylovTE<S>::step, py::arg("beta"))
+        .def("solve", &GlobalKrylovTE<S>::solve, py::arg("n_steps"),
+             py::arg("beta"), py::call_guard<py::gil_scoped_release>());
+
+    py::class_<FiniteTemperature<S>, shared_ptr<FiniteTemperature<S>>>(
+        m, "FiniteTemperature")
+        .def(py::init<const shared_ptr<MovingEnvironment<S>> &,
+                      const vector<ubond_t> &>())
+        .def(py::init<const shared_ptr<MovingEnvironment<S>> &,
+                      const vector<ubond_t> &, TETypes>())
+        .def(py::init<const shared_ptr<MovingEnvironment<S>> &,
+                      const vector<ubond_t> &, TETypes, int>())
+        .def_readwrite("te", &FiniteTemperature<S>::te)
+        .def_readwrite("mode", &FiniteTemperature<S>::mode)
+        .def_readwrite("init_mode", &FiniteTemperature<S>::init_mode)
+        .def_readwrite("n_sub_sweeps", &FiniteTemperature<S>::n_sub_sweeps)
+        .def_readwrite("init_n_sub_sweeps",
+                       &FiniteTemperature<S>::init_n_sub_sweeps)
+        .def_readwrite("log_z0", &FiniteTemperature<S>::log_z0)
+        .def_readwrite("beta", &FiniteTemperature<S>::beta)
+        .def_readwrite("log_z", &FiniteTemperature<S>::log_z)
+        .def_readwrite("betas", &FiniteTemperature<S>::betas)
+        .def_readwrite("energies", &FiniteTemperature<S>::energies)
+        .def_readwrite("free_energies", &FiniteTemperature<S>::free_energies)
+        .def_readwrite("entropies", &FiniteTemperature<S>::entropies)
+        .def_readwrite("heat_capacities",
+                       &FiniteTemperature<S>::heat_capacities)
+        .def_readwrite("iprint", &FiniteTemperature<S>::iprint)
+        .def("energy", &FiniteTemperature<S>::energy)
+        .def("record", &FiniteTemperature<S>::record)
+        .def("solve", &FiniteTemperature<S>::solve, py::arg("n_steps"),
+             py::arg("dbeta"), py::call_guard<py::gil_scoped_release>());
+
+    py::class_<MPSTrajectory<S>, shared_ptr<MPSTrajectory<S>>>(m,
+                                                              "MPSTrajectory")
+        .def(py::init<const string &>())
+        .def(py::init<const string &, bool>())
+        .def(py::init<const string &, bool,
+                      const shared_ptr<FPCodec<double>> &>())
+        .def_readwrite("filename", &MPSTrajectory<S>::filename)
+        .def_readwrite("codec", &MPSTrajectory<S>::codec)
+        .def_readwrite("last_raw_size", &MPSTrajectory<S>::last_raw_size)
+        .def_readwrite("last_stored_size",
+                       &MPSTrajectory<S>::last_stored_size)
+        .def_property_readonly("n_snapshots",
+                               [](MPSTrajectory<S> *self) {
+                                   return self->snapshots.size();
+                               })
+        .def("save",
+             (void (MPSTrajectory<S>::*)(const shared_ptr<MPS<S>> &,
+                                         complex<double>, complex<double>,
+                                         bool, TETypes, int, double, double)) &
+                 MPSTrajectory<S>::save,
+             py::arg("mps"), py::arg("time") = 0.0,
+             py::arg("next_beta") = 0.0, py::arg("forward") = true,
+             py::arg("mode") = TETypes::TangentSpace,
+             py::arg("n_sub_sweeps") = 1, py::arg("energy") = 0.0,
+             py::arg("normsq") = 1.0)
+        .def("save", (void (MPSTrajectory<S>::*)(
+                         const shared_ptr<TimeEvolution<S>> &)) &
+                         MPSTrajectory<S>::save)
+        .def("restore",
+             (void (MPSTrajectory<S>::*)(int, const shared_ptr<MPS<S>> &,
+                                         const shared_ptr<ParallelRule<S>> &)
+                  const) &
+                 MPSTrajectory<S>::restore,
+             py::arg("isnap"), py::arg("mps"), py::arg("para_rule") = nullptr)
+        .def("restore",
+             (void (MPSTrajectory<S>::*)(int,
+                                         const shared_ptr<TimeEvolution<S>> &)
+                  const) &
+                 MPSTrajectory<S>::restore);
 
     py::class_<typename Linear<S>::Iteration,
                shared_ptr<typename Linear<S>::Iteration>>(m, "LinearIteration")
@@ -1022,6 +1408,7 @@ template <typename S> void bind_algorithms(py::module &m) {
                       const shared_ptr<MovingEnvironment<S>> &,
                       const vector<ubond_t> &, const vector<ubond_t> &,
                       const vector<double> &>())
+        .def_readwrite("timing", &Linear<S>::timing)
         .def_readwrite("iprint", &Linear<S>::iprint)
         .def_readwrite("cutoff", &Linear<S>::cutoff)
         .def_readwrite("lme", &Linear<S>::lme)
@@ -1071,17 +1458,56 @@ template <typename S> void bind_algorithms(py::module &m) {
                        &Linear<S>::gf_extra_omegas_at_site)
         .def_readwrite("gf_extra_eta", &Linear<S>::gf_extra_eta)
         .def_readwrite("gf_extra_ext_targets", &Linear<S>::gf_extra_ext_targets)
+        .def_readwrite("gf_recycle", &Linear<S>::gf_recycle)
+        .def_readwrite("gf_multi_omegas", &Linear<S>::gf_multi_omegas)
+        .def_readwrite("gf_multi_targets", &Linear<S>::gf_multi_targets)
         .def_readwrite("right_weight", &Linear<S>::right_weight)
         .def_readwrite("complex_weights", &Linear<S>::complex_weights)
         .def("update_one_dot", &Linear<S>::update_one_dot)
         .def("update_two_dot", &Linear<S>::update_two_dot)
         .def("blocking", &Linear<S>::blocking)
         .def("sweep", &Linear<S>::sweep)
+        .def("partial_sweep", &Linear<S>::partial_sweep)
+        .def("connection_sweep", &Linear<S>::connection_sweep)
+        .def("unordered_sweep", &Linear<S>::unordered_sweep)
         .def("solve", &Linear<S>::solve, py::arg("n_sweeps"),
-             py::arg("forward") = true, py::arg("tol") = 1E-6);
+             py::arg("forward") = true, py::arg("tol") = 1E-6,
+             py::call_guard<py::gil_scoped_release>());
 
     bind_expect<S, double>(m, "Expect");
     bind_expect<S, complex<double>>(m, "ComplexExpect");
+
+    py::class_<ChebyshevSpectral<S>, shared_ptr<ChebyshevSpectral<S>>>(
+        m, "ChebyshevSpectral")
+        .def(py::init<const shared_ptr<MPO<S>> &, const shared_ptr<MPO<S>> &,
+                      const shared_ptr<MPS<S>> &, double, double,
+                      const vector<ubond_t> &>())
+        .def(py::init<const shared_ptr<MPO<S>> &, const shared_ptr<MPO<S>> &,
+                      const shared_ptr<MPS<S>> &, double, double,
+                      const vector<ubond_t> &, const vector<double> &>())
+        .def_readwrite("mpo", &ChebyshevSpectral<S>::mpo)
+        .def_readwrite("impo", &ChebyshevSpectral<S>::impo)
+        .def_readwrite("mps", &ChebyshevSpectral<S>::mps)
+        .def_readwrite("center", &ChebyshevSpectral<S>::center)
+        .def_readwrite("width", &ChebyshevSpectral<S>::width)
+        .def_readwrite("bond_dims", &ChebyshevSpectral<S>::bond_dims)
+        .def_readwrite("noises", &ChebyshevSpectral<S>::noises)
+        .def_readwrite("moments", &ChebyshevSpectral<S>::moments)
+        .def_readwrite("n_sweeps", &ChebyshevSpectral<S>::n_sweeps)
+        .def_readwrite("tol", &ChebyshevSpectral<S>::tol)
+        .def_readwrite("noise_type", &ChebyshevSpectral<S>::noise_type)
+        .def_readwrite("decomp_type", &ChebyshevSpectral<S>::decomp_type)
+        .def_readwrite("trunc_type", &ChebyshevSpectral<S>::trunc_type)
+        .def_readwrite("cutoff", &ChebyshevSpectral<S>::cutoff)
+        .def_readwrite("iprint", &ChebyshevSpectral<S>::iprint)
+        .def_readwrite("tag", &ChebyshevSpectral<S>::tag)
+        .def("overlap", &ChebyshevSpectral<S>::overlap)
+        .def("fit", &ChebyshevSpectral<S>::fit)
+        .def("solve", &ChebyshevSpectral<S>::solve, py::arg("n_moments"),
+             py::call_guard<py::gil_scoped_release>())
+        .def_static("jackson_kernel", &ChebyshevSpectral<S>::jackson_kernel)
+        .def("spectral_function", &ChebyshevSpectral<S>::spectral_function,
+             py::arg("omegas"), py::arg("jackson") = true);
 }
 
 template <typename S> void bind_parallel_dmrg(py::module &m) {
@@ -1129,7 +1555,10 @@ template <typename S> void bind_parallel_dmrg(py::module &m) {
                ParallelRule<S>>(m, "ParallelRuleQC")
         .def(py::init<const shared_ptr<ParallelCommunicator<S>> &>())
         .def(py::init<const shared_ptr<ParallelCommunicator<S>> &,
-                      ParallelCommTypes>());
+                      ParallelCommTypes>())
+        .def_readwrite("pair_owners", &ParallelRuleQC<S>::pair_owners)
+        .def_readwrite("pair_costs", &ParallelRuleQC<S>::pair_costs)
+        .def("rebalance", &ParallelRuleQC<S>::rebalance);
 
     py::class_<ParallelRuleOneBodyQC<S>, shared_ptr<ParallelRuleOneBodyQC<S>>,
                ParallelRule<S>>(m, "ParallelRuleOneBodyQC")
@@ -1181,6 +1610,13 @@ template <typename S> void bind_parallel_dmrg(py::module &m) {
         .def(py::init<int, const shared_ptr<ParallelRule<S>> &>())
         .def(py::init<const shared_ptr<MPO<S>> &,
                       const shared_ptr<ParallelRule<S>> &>());
+
+    m.def("ga_opt_islands", &OrbitalOrdering::ga_opt_islands<S>,
+          py::arg("n_sites"), py::arg("kmat"), py::arg("comm"),
+          py::arg("n_generations") = 10000, py::arg("n_configs") = 54,
+          py::arg("n_elite") = 5, py::arg("clone_rate") = 0.1,
+          py::arg("mutate_rate") = 0.1, py::arg("n_migrate_gens") = 100,
+          py::arg("n_migrants") = 2);
 }
 
 template <typename S> void bind_mpo(py::module &m) {
@@ -1221,7 +1657,25 @@ template <typename S> void bind_mpo(py::module &m) {
         .def_readwrite("archive_marks", &MPO<S>::archive_marks)
         .def_readwrite("archive_schemer_mark", &MPO<S>::archive_schemer_mark)
         .def_readwrite("archive_filename", &MPO<S>::archive_filename)
+        .def("init_archive", &MPO<S>::init_archive)
+        .def("load_tensor", &MPO<S>::load_tensor)
+        .def("save_tensor", &MPO<S>::save_tensor)
+        .def("unload_tensor", &MPO<S>::unload_tensor)
+        .def("load_schemer", &MPO<S>::load_schemer)
+        .def("save_schemer", &MPO<S>::save_schemer)
+        .def("unload_schemer", &MPO<S>::unload_schemer)
+        .def("load_left_operators", &MPO<S>::load_left_operators)
+        .def("save_left_operators", &MPO<S>::save_left_operators)
+        .def("unload_left_operators", &MPO<S>::unload_left_operators)
+        .def("load_right_operators", &MPO<S>::load_right_operators)
+        .def("save_right_operators", &MPO<S>::save_right_operators)
+        .def("unload_right_operators", &MPO<S>::unload_right_operators)
+        .def("load_middle_operators", &MPO<S>::load_middle_operators)
+        .def("save_middle_operators", &MPO<S>::save_middle_operators)
+        .def("unload_middle_operators", &MPO<S>::unload_middle_operators)
         .def("reduce_data", &MPO<S>::reduce_data)
+        .def("auto_sparse_form", &MPO<S>::auto_sparse_form,
+             py::arg("sparsity"))
         .def("load_data",
              (void (MPO<S>::*)(const string &, bool)) & MPO<S>::load_data,
              py::arg("filename"), py::arg("minimal") = false)
@@ -1232,6 +1686,8 @@ template <typename S> void bind_mpo(py::module &m) {
         .def("get_parallel_type", &MPO<S>::get_parallel_type)
         .def("estimate_storage", &MPO<S>::estimate_storage, py::arg("info"),
              py::arg("dot"))
+        .def("estimate_stack_memory", &MPO<S>::estimate_stack_memory,
+             py::arg("info"), py::arg("dot"), py::arg("n_wfn") = 2)
         .def("deallocate", &MPO<S>::deallocate)
         .def("deep_copy", &MPO<S>::deep_copy)
         .def("__neg__",
@@ -1276,7 +1732,21 @@ template <typename S> void bind_mpo(py::module &m) {
                       uint16_t>())
         .def(py::init<const shared_ptr<MPO<S>> &,
                       const vector<shared_ptr<StateInfo<S>>> &, uint16_t,
-                      uint16_t, const shared_ptr<StateInfo<S>> &>());
+                      uint16_t, const shared_ptr<StateInfo<S>> &>())
+        .def_static("estimated_op_size", &FusedMPO<S>::estimated_op_size)
+        .def_static("plan_edge_fusion", &FusedMPO<S>::plan_edge_fusion,
+                    py::arg("mpo"), py::arg("info"), py::arg("max_bond_dim"),
+                    py::arg("max_op_size"), py::arg("min_sites") = 4)
+        .def_static(
+            "fuse_edges",
+            [](const shared_ptr<MPO<S>> &mpo,
+               vector<shared_ptr<StateInfo<S>>> basis, int n_extl, int n_extr,
+               const shared_ptr<MPSInfo<S>> &info) {
+                return FusedMPO<S>::fuse_edges(mpo, basis, n_extl, n_extr,
+                                               info);
+            },
+            py::arg("mpo"), py::arg("basis"), py::arg("n_extl"),
+            py::arg("n_extr"), py::arg("info") = nullptr);
 
     py::class_<IdentityMPO<S>, shared_ptr<IdentityMPO<S>>, MPO<S>>(
         m, "IdentityMPO")
@@ -1305,9 +1775,17 @@ template <typename S> void bind_mpo(py::module &m) {
 
     py::class_<MPOQC<S>, shared_ptr<MPOQC<S>>, MPO<S>>(m, "MPOQC")
         .def_readwrite("mode", &MPOQC<S>::mode)
-        .def(py::init<const shared_ptr<HamiltonianQC<S>> &>())
-        .def(py::init<const shared_ptr<HamiltonianQC<S>> &, QCTypes>())
-        .def(py::init<const shared_ptr<HamiltonianQC<S>> &, QCTypes, int>());
+        .def(py::init<const shared_ptr<HamiltonianQC<S>> &>(),
+             py::call_guard<py::gil_scoped_release>())
+        .def(py::init<const shared_ptr<HamiltonianQC<S>> &, QCTypes>(),
+             py::call_guard<py::gil_scoped_release>())
+        .def(py::init<const shared_ptr<HamiltonianQC<S>> &, QCTypes, int>(),
+             py::call_guard<py::gil_scoped_release>())
+        .def(py::init<const shared_ptr<HamiltonianQC<S>> &, QCTypes, int,
+                      const string &>(),
+             py::arg("hamil"), py::arg("mode"), py::arg("trans_center"),
+             py::arg("archive_filename"),
+             py::call_guard<py::gil_scoped_release>());
 
     py::class_<PDM1MPOQC<S>, shared_ptr<PDM1MPOQC<S>>, MPO<S>>(m, "PDM1MPOQC")
         .def(py::init<const shared_ptr<Hamiltonian<S>> &>())
@@ -1321,6 +1799,9 @@ template <typename S> void bind_mpo(py::module &m) {
 
     py::class_<NPC1MPOQC<S>, shared_ptr<NPC1MPOQC<S>>, MPO<S>>(m, "NPC1MPOQC")
         .def(py::init<const shared_ptr<Hamiltonian<S>> &>())
+        .def(py::init<const shared_ptr<Hamiltonian<S>> &,
+                      const vector<pair<int, int>> &>(),
+             py::arg("hamil"), py::arg("pairs"))
         .def("get_matrix", &NPC1MPOQC<S>::template get_matrix<double>)
         .def("get_matrix", &NPC1MPOQC<S>::template get_matrix<complex<double>>)
         .def("get_matrix_spatial",
@@ -1377,6 +1858,9 @@ auto bind_trans_mps_spin_specific(py::module &m, const string &aux_name)
           &TransSparseTensor<S, T>::forward);
     m.def(("trans_unfused_mps_to_" + aux_name).c_str(),
           &TransUnfusedMPS<S, T>::forward);
+    m.def(("trans_mps_to_" + aux_name).c_str(),
+          &TransUnfusedMPS<S, T>::transform, py::arg("mps"), py::arg("xtag"),
+          py::arg("cg"), py::arg("resolve") = false, py::arg("twosz") = 0);
 }
 
 template <typename S = void> void bind_dmrg_types(py::module &m) {
@@ -1482,6 +1966,27 @@ template <typename S = void> void bind_dmrg_io(py::module &m) {
     m.def("read_occ", &read_occ);
     m.def("write_occ", &write_occ);
 
+    py::class_<OrbitalGraph, shared_ptr<OrbitalGraph>>(m, "OrbitalGraph")
+        .def(py::init<>())
+        .def(py::init<int>())
+        .def_readwrite("n", &OrbitalGraph::n)
+        .def_readwrite("rows", &OrbitalGraph::rows)
+        .def_readwrite("cols", &OrbitalGraph::cols)
+        .def_readwrite("vals", &OrbitalGraph::vals)
+        .def_readwrite("degrees", &OrbitalGraph::degrees)
+        .def_static("from_matrix", &OrbitalGraph::from_matrix,
+                    py::arg("n_sites"), py::arg("kmat"),
+                    py::arg("cutoff") = 1E-12)
+        .def_static("from_edges", &OrbitalGraph::from_edges, py::arg("n"),
+                    py::arg("is"), py::arg("js"), py::arg("ws"))
+        .def("nnz", &OrbitalGraph::nnz)
+        .def("laplacian", &OrbitalGraph::laplacian)
+        .def("coarsen", [](OrbitalGraph *self) {
+            vector<int> cmap;
+            OrbitalGraph gc = self->coarsen(cmap);
+            return make_pair(gc, cmap);
+        });
+
     py::class_<OrbitalOrdering, shared_ptr<OrbitalOrdering>>(m,
                                                              "OrbitalOrdering")
         .def_static("exp_trans", &OrbitalOrdering::exp_trans, py::arg("mat"))
@@ -1489,6 +1994,12 @@ template <typename S = void> void bind_dmrg_io(py::module &m) {
                     py::arg("kmat"), py::arg("ord") = vector<uint16_t>())
         .def_static("fiedler", &OrbitalOrdering::fiedler, py::arg("n_sites"),
                     py::arg("kmat"))
+        .def_static("sparse_fiedler", &OrbitalOrdering::sparse_fiedler,
+                    py::arg("n_sites"), py::arg("kmat"),
+                    py::arg("cutoff") = 1E-12, py::arg("coarse_size") = 0)
+        .def_static("graph_fiedler", &OrbitalOrdering::graph_fiedler,
+                    py::arg("g"), py::arg("coarse_size") = 0,
+                    py::arg("refine_iter") = 100)
         .def_static("ga_opt", &OrbitalOrdering::ga_opt, py::arg("n_sites"),
                     py::arg("kmat"), py::arg("n_generations") = 10000,
                     py::arg("n_configs") = 54, py::arg("n_elite") = 5,
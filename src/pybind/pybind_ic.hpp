@@ -35,6 +35,20 @@ PYBIND11_MAKE_OPAQUE(vector<WickTensor>);
 PYBIND11_MAKE_OPAQUE(vector<WickString>);
 
 template <typename S = void> void bind_nd_array(py::module &m) {
+    py::enum_<EinsumPathTypes>(m, "EinsumPathTypes", py::arithmetic())
+        .value("Linear", EinsumPathTypes::Linear)
+        .value("Greedy", EinsumPathTypes::Greedy)
+        .value("Optimal", EinsumPathTypes::Optimal)
+        .value("Auto", EinsumPathTypes::Auto);
+
+    py::class_<NDArrayPool, unique_ptr<NDArrayPool, py::nodelete>>(
+        m, "NDArrayPool")
+        .def_static("enter", []() { NDArrayPool::instance().enter(); })
+        .def_static("leave", []() { NDArrayPool::instance().leave(); })
+        .def_static("clear", []() { NDArrayPool::instance().clear(); })
+        .def_static("active",
+                    []() { return NDArrayPool::instance().active(); });
+
     py::class_<NDArray, shared_ptr<NDArray>>(m, "NDArray",
                                              py::buffer_protocol())
         .def_readwrite("shape", &NDArray::shape)
@@ -82,12 +96,18 @@ template <typename S = void> void bind_nd_array(py::module &m) {
                         vector<MKL_INT> shapes = {t};
                         return NDArray::random(shapes);
                     })
+        .def_static("from_tensor", &NDArray::from_tensor, py::arg("t"))
         .def_static("einsum",
-                    [](const string &script, py::args &args) {
+                    [](const string &script, py::args &args,
+                       py::kwargs &kwargs) {
                         vector<NDArray> xarrs;
                         for (auto &x : args)
                             xarrs.push_back(x.cast<NDArray>());
-                        return NDArray::einsum(script, xarrs);
+                        EinsumPathTypes path_type = EinsumPathTypes::Auto;
+                        if (kwargs.contains("optimize"))
+                            path_type =
+                                kwargs["optimize"].cast<EinsumPathTypes>();
+                        return NDArray::einsum(script, xarrs, path_type);
                     })
         .def("transpose",
              [](NDArray *self, const py::tuple &t) {
@@ -159,7 +179,13 @@ template <typename S = void> void bind_nd_array(py::module &m) {
                      return py::cast(self->slice(idxs));
              })
         .def(py::self + py::self)
+        .def(py::self - py::self)
+        .def(py::self * double())
+        .def(double() * py::self)
         .def(-py::self)
+        .def("is_dense", &NDArray::is_dense)
+        .def("norm", &NDArray::norm)
+        .def_static("axpby", &NDArray::axpby)
         .def_buffer([](NDArray *self) -> py::buffer_info {
             vector<ssize_t> shape(self->ndim()), strides(self->ndim());
             for (int i = 0; i < self->ndim(); i++)
@@ -169,6 +195,47 @@ template <typename S = void> void bind_nd_array(py::module &m) {
                                    py::format_descriptor<double>::format(),
                                    self->ndim(), shape, strides);
         });
+
+    py::class_<BlockedNDArray, shared_ptr<BlockedNDArray>>(m,
+                                                           "BlockedNDArray")
+        .def(py::init<const vector<MKL_INT> &, const vector<MKL_INT> &,
+                      const string &>())
+        .def_readwrite("shape", &BlockedNDArray::shape)
+        .def_readwrite("tile_shape", &BlockedNDArray::tile_shape)
+        .def_readwrite("filename", &BlockedNDArray::filename)
+        .def_property_readonly("ndim", &BlockedNDArray::ndim)
+        .def("grid", &BlockedNDArray::grid)
+        .def("read_tile", &BlockedNDArray::read_tile)
+        .def("write_tile", &BlockedNDArray::write_tile)
+        .def_static("from_array", &BlockedNDArray::from_array)
+        .def("to_array", &BlockedNDArray::to_array)
+        .def("remove", &BlockedNDArray::remove)
+        .def_static("tensordot", &BlockedNDArray::tensordot, py::arg("a"),
+                    py::arg("b"), py::arg("c"), py::arg("idxa"),
+                    py::arg("idxb"), py::arg("alpha") = 1.0,
+                    py::arg("beta") = 0.0);
+
+    py::class_<WickKernelStep>(m, "WickKernelStep")
+        .def_readwrite("a", &WickKernelStep::a)
+        .def_readwrite("b", &WickKernelStep::b)
+        .def_readwrite("script", &WickKernelStep::script);
+
+    py::class_<WickKernel, shared_ptr<WickKernel>>(m, "WickKernel")
+        .def(py::init<>())
+        .def_readwrite("inputs", &WickKernel::inputs)
+        .def_readwrite("steps", &WickKernel::steps)
+        .def_readwrite("terms", &WickKernel::terms)
+        .def_static("input_name", &WickKernel::input_name)
+        .def_static("compile", &WickKernel::compile, py::arg("expr"),
+                    py::arg("x"), py::arg("type_extents"),
+                    py::arg("path_type") = EinsumPathTypes::Auto)
+        .def_static("n_unshared_steps", &WickKernel::n_unshared_steps)
+        .def("evaluate", &WickKernel::evaluate)
+        .def("__repr__", [](WickKernel *self) {
+            stringstream ss;
+            ss << *self;
+            return ss.str();
+        });
 }
 
 template <typename S = void> void bind_wick(py::module &m) {
@@ -44,6 +44,8 @@ template <typename S> void bind_sp_dmrg(py::module &m) {
         .def_readwrite("pinfos_qvpsi0", &StochasticPDMRG<S>::pinfos_qvpsi0)
         .def_readwrite("norm_qvpsi0", &StochasticPDMRG<S>::norm_qvpsi0)
         .def_readwrite("n_sites", &StochasticPDMRG<S>::n_sites)
+        .def_readwrite("batch_size", &StochasticPDMRG<S>::batch_size)
+        .def_readwrite("proc_id", &StochasticPDMRG<S>::proc_id)
         .def("energy_zeroth",
              [](StochasticPDMRG<S> *self, const shared_ptr<FCIDUMP> &fcidump,
                 py::array_t<double> &e_pqqp, py::array_t<double> &e_pqpq,
@@ -66,5 +68,6 @@ template <typename S> void bind_sp_dmrg(py::module &m) {
              })
         .def("sampling", &StochasticPDMRG<S>::sampling)
         .def("overlap", &StochasticPDMRG<S>::overlap)
+        .def("batch_overlap", &StochasticPDMRG<S>::batch_overlap)
         .def("parallel_sampling", &StochasticPDMRG<S>::parallel_sampling);
 }
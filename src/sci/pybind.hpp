@@ -105,6 +105,7 @@ template <typename S> void bind_hamiltonian_sci(py::module &m) {
         .def_readwrite("useRuleQC", &HamiltonianQCSCI<S>::useRuleQC)
         .def_readwrite("ruleQC", &HamiltonianQCSCI<S>::ruleQC)
         .def_readwrite("parallelRule", &HamiltonianQCSCI<S>::parallelRule)
+        .def_readwrite("parallelFill", &HamiltonianQCSCI<S>::parallelFill)
         .def_readwrite("fcidump", &HamiltonianQCSCI<S>::fcidump)
         .def_readwrite("mu", &HamiltonianQCSCI<S>::mu)
         .def("v", &HamiltonianQCSCI<S>::v)
@@ -192,6 +193,7 @@ template <typename S> void bind_mpo_sci(py::module &m) {
                       double>(), "RAS ACPF2 mode: Big sites on both ends")
         .def_readwrite("smallest_energy", &DMRGSCIAQCC<S>::smallest_energy)
         .def_readwrite("max_aqcc_iter", &DMRGSCIAQCC<S>::max_aqcc_iter)
+        .def_readwrite("incremental_shift", &DMRGSCIAQCC<S>::incremental_shift)
         .def_readwrite("g_factor", &DMRGSCIAQCC<S>::g_factor)
         .def_readwrite("g_factor2", &DMRGSCIAQCC<S>::g_factor2)
         .def_readwrite("ACPF2_mode", &DMRGSCIAQCC<S>::ACPF2_mode)
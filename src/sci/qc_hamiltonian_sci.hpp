@@ -28,6 +28,7 @@
 #include "hamiltonian_sci.hpp"
 #include <algorithm>
 #include <cassert>
+#include <functional>
 #include <map>
 #include <memory>
 #include <utility>
@@ -98,6 +99,8 @@ public:
     bool useRuleQC = true; // Use RuleQC for big sites
     mutable std::shared_ptr<Rule<S>> ruleQC = nullptr; // Will be changed in const method
     std::shared_ptr<ParallelRuleQC<S>> parallelRule = nullptr; // Enable it for big site in useRuleQC
+    bool parallelFill = true; // Fill big site operators in parallel; the
+                              //  sciWrapper fillOp_* must be thread safe
     HamiltonianQCSCI(const S vacuum, const int nOrbTot, const vector<uint8_t> &orb_sym,
         const shared_ptr<FCIDUMP> &fcidump,
         const std::shared_ptr<sci::AbstractSciWrapper<S>> &sciWrapperLeft = nullptr,
@@ -412,6 +415,7 @@ public:
                         "HamiltonianQCSCI: sciWrapper states were not sorted according to StateInfo sort");
             }
         }
+        bas.build_index();
     }
 
 
@@ -598,12 +602,75 @@ public:
             site_op_infos[iSite] =
                 vector<pair<S, shared_ptr<SparseMatrixInfo<S>>>>(info.begin(),
                                                                  info.end());
-            for (auto &p : site_op_infos[iSite]) {
-                p.second = make_shared<SparseMatrixInfo<S>>();
-                auto &bas = *basis[iSite];
-                p.second->initialize(bas, bas, p.first, p.first.is_fermion());
+        }
+        // The big sites have many quanta and many delta quantum numbers.
+        // The infos are built in parallel with per-thread allocators and are
+        // then copied to the stack in the serial order.
+        vector<pair<int, int>> idx;
+        for (int iSite = 0; iSite < n_sites; ++iSite)
+            for (int j = 0; j < (int)site_op_infos[iSite].size(); j++)
+                idx.push_back(make_pair(iSite, j));
+        vector<shared_ptr<SparseMatrixInfo<S>>> tmp_infos(idx.size());
+        int ntg = threading->activate_global();
+#pragma omp parallel num_threads(ntg)
+        {
+            shared_ptr<VectorAllocator<uint32_t>> i_alloc =
+                make_shared<VectorAllocator<uint32_t>>();
+#pragma omp for schedule(dynamic)
+            for (int k = 0; k < (int)idx.size(); k++) {
+                const S q = site_op_infos[idx[k].first][idx[k].second].first;
+                const auto &bas = *basis[idx[k].first];
+                tmp_infos[k] = make_shared<SparseMatrixInfo<S>>(i_alloc);
+                tmp_infos[k]->initialize(bas, bas, q, q.is_fermion());
+            }
+        }
+        threading->activate_normal();
+        for (size_t k = 0; k < idx.size(); k++)
+            site_op_infos[idx[k].first][idx[k].second].second =
+                make_shared<SparseMatrixInfo<S>>(
+                    tmp_infos[k]->deep_copy(ialloc));
+    }
+    // Estimated cost of filling one operator, from the number of
+    // determinants (or determinant pairs) visited.
+    static size_t op_cost(const CSRSparseMatrix<S> &mat, bool pairLoop) {
+        size_t cost = 1;
+        for (int i = 0; i < mat.info->n; ++i)
+            cost += pairLoop ? (size_t)mat.info->n_states_bra[i] *
+                                   mat.info->n_states_ket[i]
+                             : (size_t)mat.info->n_states_ket[i];
+        return cost;
+    }
+    template <typename G> static size_t group_cost(const G &groups) {
+        size_t cost = 0;
+        for (const auto &pairs : groups)
+            cost += op_cost(pairs.second.at(0).mat, true) * pairs.second.size();
+        return cost;
+    }
+    // Operators of one name and delta quantum number share the loop over
+    // determinant pairs, so such a group is only split into chunks when
+    // it is larger than its share of the total cost.
+    template <typename G, typename F>
+    static void add_group_tasks(vector<pair<size_t, function<void()>>> &tasks,
+                                G &groups, F fill, size_t totCost, int ntg) {
+        typedef typename G::mapped_type entries_t;
+        for (auto &pairs : groups) {
+            const entries_t &entries = pairs.second;
+            const size_t nEntries = entries.size();
+            const size_t cost = op_cost(entries.at(0).mat, true);
+            const size_t nChunks = std::min(
+                nEntries, cost * nEntries * ntg / totCost + (size_t)1);
+            for (size_t ic = 0; ic < nChunks; ++ic) {
+                entries_t chunk(
+                    entries.begin() + nEntries * ic / nChunks,
+                    entries.begin() + nEntries * (ic + 1) / nChunks);
+                const S deltaQN = pairs.first;
+                tasks.emplace_back(cost * chunk.size(),
+                                   [fill, deltaQN, chunk]() mutable {
+                                       fill(deltaQN, chunk);
+                                   });
             }
         }
+        groups.clear();
     }
     void get_site_ops_big_site(const std::shared_ptr<sci::AbstractSciWrapper<S>>& sciWrapper,
         unordered_map<shared_ptr<OpExpr<S>>, shared_ptr<SparseMatrix<S>>>
@@ -623,6 +690,10 @@ public:
         if(useRuleQC and ruleQC == nullptr){
             ruleQC = std::make_shared<RuleQC<S>>();
         }
+        // Filling each operator (or each chunk of a group of operators) is an
+        // independent task with a cost estimated from the number of
+        // determinants it visits. Every task fills its own CSR matrices.
+        vector<pair<size_t, function<void()>>> tasks;
         for (auto &p : ops) {
             shared_ptr<OpElement<S>> pop = dynamic_pointer_cast<OpElement<S>>(p.first);
             OpElement<S> &op = *pop;
@@ -674,7 +745,10 @@ public:
             }
             switch (op.name) {
             case OpNames::I:
-                sciWrapper->fillOp_I(mat);
+                tasks.emplace_back(op_cost(mat, false),
+                                   [&sciWrapper, &mat]() {
+                                       sciWrapper->fillOp_I(mat);
+                                   });
                 break;
             case OpNames::N:
                 sciWrapper->fillOp_N(mat);
@@ -683,13 +757,22 @@ public:
                 sciWrapper->fillOp_NN(mat);
                 break;
             case OpNames::H:
-                sciWrapper->fillOp_H(mat);
+                tasks.emplace_back(op_cost(mat, true),
+                                   [&sciWrapper, &mat]() {
+                                       sciWrapper->fillOp_H(mat);
+                                   });
                 break;
             case OpNames::C:
-                sciWrapper->fillOp_C(delta_qn, mat, ii);
+                tasks.emplace_back(op_cost(mat, false),
+                                   [&sciWrapper, &mat, delta_qn, ii]() {
+                                       sciWrapper->fillOp_C(delta_qn, mat, ii);
+                                   });
                 break;
             case OpNames::D:
-                sciWrapper->fillOp_D(delta_qn, mat, ii);
+                tasks.emplace_back(op_cost(mat, false),
+                                   [&sciWrapper, &mat, delta_qn, ii]() {
+                                       sciWrapper->fillOp_D(delta_qn, mat, ii);
+                                   });
                 break;
             case OpNames::R:
                 opsR[delta_qn].emplace_back(mat,ii);
@@ -698,13 +781,25 @@ public:
                 opsRD[delta_qn].emplace_back(mat,ii);
                 break;
             case OpNames::A:
-                sciWrapper->fillOp_A(delta_qn, mat, ii, jj);
+                tasks.emplace_back(op_cost(mat, false),
+                                   [&sciWrapper, &mat, delta_qn, ii, jj]() {
+                                       sciWrapper->fillOp_A(delta_qn, mat, ii,
+                                                            jj);
+                                   });
                 break;
             case OpNames::AD:
-                sciWrapper->fillOp_AD(delta_qn, mat, ii, jj);
+                tasks.emplace_back(op_cost(mat, false),
+                                   [&sciWrapper, &mat, delta_qn, ii, jj]() {
+                                       sciWrapper->fillOp_AD(delta_qn, mat, ii,
+                                                             jj);
+                                   });
                 break;
             case OpNames::B:
-                sciWrapper->fillOp_B(delta_qn, mat, ii, jj);
+                tasks.emplace_back(op_cost(mat, false),
+                                   [&sciWrapper, &mat, delta_qn, ii, jj]() {
+                                       sciWrapper->fillOp_B(delta_qn, mat, ii,
+                                                            jj);
+                                   });
                 break;
             case OpNames::P:
                 opsP[delta_qn].emplace_back(mat,ii,jj);
@@ -719,26 +814,56 @@ public:
                 assert(false);
             }
         }
-        for(auto& pairs: opsR){
-            sciWrapper->fillOp_R(pairs.first, pairs.second);
-            pairs.second.clear(); pairs.second.shrink_to_fit();
-        }
-        for(auto& pairs: opsRD){
-            sciWrapper->fillOp_RD(pairs.first, pairs.second);
-            pairs.second.clear(); pairs.second.shrink_to_fit();
-        }
-        for(auto& pairs: opsP){
-            sciWrapper->fillOp_P(pairs.first, pairs.second);
-            pairs.second.clear(); pairs.second.shrink_to_fit();
-        }
-        for(auto& pairs: opsPD){
-            sciWrapper->fillOp_PD(pairs.first, pairs.second);
-            pairs.second.clear(); pairs.second.shrink_to_fit();
-        }
-        for(auto& pairs: opsQ){
-            sciWrapper->fillOp_Q(pairs.first, pairs.second);
-            pairs.second.clear(); pairs.second.shrink_to_fit();
-        }
+        int ntg = parallelFill ? threading->activate_global() : 1;
+#ifdef _SCI_USE_OMP_ON
+        ntg = 1; // the loops within each operator are parallelized instead
+#endif
+        size_t totCost = 1;
+        for (const auto &t : tasks)
+            totCost += t.first;
+        totCost += group_cost(opsR) + group_cost(opsRD) + group_cost(opsP) +
+                   group_cost(opsPD) + group_cost(opsQ);
+        add_group_tasks(
+            tasks, opsR,
+            [&sciWrapper](const S &q, vector<fillTuple1> &e) {
+                sciWrapper->fillOp_R(q, e);
+            },
+            totCost, ntg);
+        add_group_tasks(
+            tasks, opsRD,
+            [&sciWrapper](const S &q, vector<fillTuple1> &e) {
+                sciWrapper->fillOp_RD(q, e);
+            },
+            totCost, ntg);
+        add_group_tasks(
+            tasks, opsP,
+            [&sciWrapper](const S &q, vector<fillTuple2> &e) {
+                sciWrapper->fillOp_P(q, e);
+            },
+            totCost, ntg);
+        add_group_tasks(
+            tasks, opsPD,
+            [&sciWrapper](const S &q, vector<fillTuple2> &e) {
+                sciWrapper->fillOp_PD(q, e);
+            },
+            totCost, ntg);
+        add_group_tasks(
+            tasks, opsQ,
+            [&sciWrapper](const S &q, vector<fillTuple2> &e) {
+                sciWrapper->fillOp_Q(q, e);
+            },
+            totCost, ntg);
+        // largest first, so that the dynamic schedule ends balanced
+        stable_sort(tasks.begin(), tasks.end(),
+                    [](const pair<size_t, function<void()>> &a,
+                       const pair<size_t, function<void()>> &b) {
+                        return a.first > b.first;
+                    });
+#pragma omp parallel for schedule(dynamic) num_threads(ntg)
+        for (int it = 0; it < (int)tasks.size(); ++it)
+            tasks[it].second();
+        if (parallelFill)
+            threading->activate_normal();
         if (sci_finalize)
             sciWrapper->finalize();
 
@@ -311,6 +311,10 @@ template <typename S> struct DMRGSCIAQCC : DMRGSCI<S> {
                            // be fully converged as we do sweeps anyways.
     double smallest_energy =
         numeric_limits<double>::max(); // Smallest energy during sweep
+    // If true, the shift on the last site is converged self-consistently
+    // inside one Davidson run (the sigma vectors of H and the shifted
+    // operators are kept separately), instead of re-solving for each shift
+    bool incremental_shift = true;
 
     /** Frozen/CAS mode: Only one big site at the end
      * => ME + S * SME  **/
@@ -388,30 +392,32 @@ template <typename S> struct DMRGSCIAQCC : DMRGSCI<S> {
         ext_mes.push_back(sme4);
     }
 
+    // Coefficients of H and the shifted operators for the given delta_e
+    vector<double> get_aqcc_coeffs(double delta_e) const {
+        const auto shift = (1. - g_factor) * delta_e;
+        const auto shift2 = (1. - g_factor2) * delta_e;
+        if (not RAS_mode)
+            return ACPF2_mode ? vector<double>{1.0, shift, shift2}
+                              : vector<double>{1.0, shift};
+        else
+            return ACPF2_mode
+                       ? vector<double>{1.0, shift, -shift, shift2, -shift2}
+                       : vector<double>{1.0, shift, -shift};
+    }
     shared_ptr<LinearEffectiveHamiltonian<S>>
     get_aqcc_eff(shared_ptr<EffectiveHamiltonian<S>> h_eff,
                  shared_ptr<EffectiveHamiltonian<S>> d_eff1,
                  shared_ptr<EffectiveHamiltonian<S>> d_eff2,
                  shared_ptr<EffectiveHamiltonian<S>> d_eff3,
                  shared_ptr<EffectiveHamiltonian<S>> d_eff4) {
-        const auto shift = (1. - g_factor) * delta_e;
-        const auto shift2 = (1. - g_factor2) * delta_e;
-        shared_ptr<LinearEffectiveHamiltonian<S>> aqcc_eff;
-        if (not RAS_mode) {
-            aqcc_eff = h_eff + shift * d_eff1;
-            if (ACPF2_mode) {
-                aqcc_eff = h_eff + shift * d_eff1 + shift2 * d_eff2;
-            } else {
-                aqcc_eff = h_eff + shift * d_eff1;
-            }
-        } else {
-            if (ACPF2_mode) {
-                aqcc_eff = h_eff + shift * (d_eff1 - d_eff2) +
-                           shift2 * (d_eff3 - d_eff4);
-            } else {
-                aqcc_eff = h_eff + shift * (d_eff1 - d_eff2);
-            }
-        }
+        vector<shared_ptr<EffectiveHamiltonian<S>>> h_effs{h_eff, d_eff1};
+        if (RAS_mode or ACPF2_mode)
+            h_effs.push_back(d_eff2);
+        if (RAS_mode and ACPF2_mode)
+            h_effs.push_back(d_eff3), h_effs.push_back(d_eff4);
+        shared_ptr<LinearEffectiveHamiltonian<S>> aqcc_eff =
+            make_shared<LinearEffectiveHamiltonian<S>>(
+                h_effs, get_aqcc_coeffs(delta_e));
         sweep_max_eff_ham_size =
             max(sweep_max_eff_ham_size, aqcc_eff->get_op_total_memory());
         return aqcc_eff;
@@ -520,7 +526,33 @@ template <typename S> struct DMRGSCIAQCC : DMRGSCI<S> {
             if (iprint >= 2) {
                 cout << endl;
             }
-            for (int itAQCC = 0; itAQCC < max_aqcc_iter; ++itAQCC) {
+            if (incremental_shift) {
+                auto aqcc_eff =
+                    get_aqcc_eff(h_eff, d_eff1, d_eff2, d_eff3, d_eff4);
+                const double const_e = me->mpo->const_e;
+                pdi = aqcc_eff->eigs_self_consistent(
+                    [this, const_e](double e) {
+                        return get_aqcc_coeffs(e + const_e - ref_energy);
+                    },
+                    (smallest_energy == numeric_limits<double>::max()
+                         ? ref_energy
+                         : smallest_energy) -
+                        const_e,
+                    iprint >= 3,
+                    davidson_conv_thrd, davidson_max_iter,
+                    davidson_soft_max_iter, me->para_rule);
+                smallest_energy = std::get<0>(pdi) + const_e;
+                delta_e = smallest_energy - ref_energy;
+                if (iprint >= 2)
+                    cout << "\tAQCC: E=" << fixed << setw(17)
+                         << setprecision(10) << smallest_energy
+                         << " Delta=" << fixed << setw(17) << setprecision(10)
+                         << delta_e << " nDav=" << setw(3) << std::get<1>(pdi)
+                         << "; init Delta=" << fixed << setw(17)
+                         << setprecision(10) << last_delta_e << endl;
+            }
+            for (int itAQCC = 0; itAQCC < max_aqcc_iter && !incremental_shift;
+                 ++itAQCC) {
                 //
                 // Shift non-reference ops
                 //
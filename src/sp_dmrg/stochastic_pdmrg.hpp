@@ -29,6 +29,8 @@
 #include <algorithm>
 #include <array>
 #include <limits>
+#include <map>
+#include <random>
 #include <set>
 #include <stack>
 #include <tuple>
@@ -47,6 +49,328 @@ using namespace std;
 
 namespace block2 {
 
+// A batch of walkers advancing through the sites of an unfused MPS together.
+// Walkers sharing the same left quantum number are stored as rows of one
+// dense matrix, so that each site step is a GEMM over the whole group
+// instead of one vector-matrix product per walker.
+template <typename S> struct StochasticWalkers {
+    struct Group {
+        vector<int> idx;
+        vector<double> mat;
+        MKL_INT m = 0;
+    };
+    map<S, Group> groups;
+    StochasticWalkers(int n_walkers, S q0) {
+        Group &g = groups[q0];
+        g.m = 1;
+        g.idx.resize(n_walkers);
+        for (int iw = 0; iw < n_walkers; iw++)
+            g.idx[iw] = iw;
+        g.mat.assign(n_walkers, 1.0);
+    }
+    // find_block(d, bra, ket) returns the site tensor block (or nullptr)
+    // for physical state d and left quantum bra, and sets ket.
+    // select(iw, cp) picks the physical state of walker iw from the squared
+    // norms cp of all possible continuations.
+    template <typename FB, typename FS>
+    void sample_step(uint8_t phys_dim, FB &&find_block, FS &&select) {
+        map<S, Group> next;
+        vector<S> kets(phys_dim);
+        vector<vector<double>> ws(phys_dim);
+        vector<MKL_INT> ns(phys_dim);
+        vector<double> cp(phys_dim);
+        for (auto &gq : groups) {
+            Group &g = gq.second;
+            const MKL_INT nw = (MKL_INT)g.idx.size();
+            for (uint8_t d = 0; d < phys_dim; d++) {
+                Tensor *t = find_block(d, gq.first, kets[d]);
+                ns[d] = 0;
+                if (t == nullptr)
+                    continue;
+                MatrixRef tm = t->ref();
+                assert(tm.m == g.m);
+                ns[d] = tm.n;
+                ws[d].resize((size_t)nw * tm.n);
+                MatrixFunctions::multiply(MatrixRef(g.mat.data(), nw, g.m),
+                                          false, tm, false,
+                                          MatrixRef(ws[d].data(), nw, tm.n),
+                                          1.0, 0.0);
+            }
+            for (MKL_INT iw = 0; iw < nw; iw++) {
+                for (uint8_t d = 0; d < phys_dim; d++) {
+                    const double *pw = ws[d].data() + iw * ns[d];
+                    cp[d] = 0;
+                    for (MKL_INT k = 0; k < ns[d]; k++)
+                        cp[d] += pw[k] * pw[k];
+                }
+                const uint8_t d = select(g.idx[iw], cp.data());
+                Group &h = next[kets[d]];
+                h.m = ns[d];
+                h.idx.push_back(g.idx[iw]);
+                h.mat.insert(h.mat.end(), ws[d].data() + iw * ns[d],
+                             ws[d].data() + (iw + 1) * ns[d]);
+            }
+        }
+        groups = move(next);
+    }
+    // replace walkers by their children, where child ic continues walker
+    // parents[ic] with physical state ds[ic] (a walker may have any number
+    // of children, so that common prefixes are contracted only once)
+    template <typename FB>
+    void branch_step(FB &&find_block, const vector<int> &parents,
+                     const vector<uint8_t> &ds) {
+        // location (group, row) of each parent walker
+        // walkers with zero overlap have already been dropped
+        const int np =
+            parents.size() == 0
+                ? 0
+                : *max_element(parents.begin(), parents.end()) + 1;
+        vector<pair<Group *, MKL_INT>> loc(np, make_pair(nullptr, 0));
+        vector<pair<const S *, Group *>> gs;
+        for (auto &gq : groups) {
+            gs.push_back(make_pair(&gq.first, &gq.second));
+            for (MKL_INT iw = 0; iw < (MKL_INT)gq.second.idx.size(); iw++)
+                if (gq.second.idx[iw] < np)
+                    loc[gq.second.idx[iw]] = make_pair(&gq.second, iw);
+        }
+        // children of each (group, physical state)
+        map<pair<Group *, uint8_t>, vector<int>> buckets;
+        for (int ic = 0; ic < (int)parents.size(); ic++)
+            if (loc[parents[ic]].first != nullptr)
+                buckets[make_pair(loc[parents[ic]].first, ds[ic])].push_back(
+                    ic);
+        map<Group *, S> gq_map;
+        for (auto &gp : gs)
+            gq_map[gp.second] = *gp.first;
+        map<S, Group> next;
+        vector<double> xmat;
+        for (auto &bk : buckets) {
+            Group &g = *bk.first.first;
+            const uint8_t d = bk.first.second;
+            S ket;
+            Tensor *t = find_block(d, gq_map.at(&g), ket);
+            if (t == nullptr)
+                continue;
+            MatrixRef tm = t->ref();
+            assert(tm.m == g.m);
+            const MKL_INT nw = (MKL_INT)bk.second.size();
+            xmat.resize((size_t)nw * g.m);
+            for (MKL_INT ir = 0; ir < nw; ir++)
+                memcpy(xmat.data() + ir * g.m,
+                       g.mat.data() + loc[parents[bk.second[ir]]].second * g.m,
+                       sizeof(double) * g.m);
+            Group &h = next[ket];
+            h.m = tm.n;
+            const size_t hsz = h.mat.size();
+            h.mat.resize(hsz + (size_t)nw * tm.n);
+            MatrixFunctions::multiply(MatrixRef(xmat.data(), nw, g.m), false,
+                                      tm, false,
+                                      MatrixRef(h.mat.data() + hsz, nw, tm.n),
+                                      1.0, 0.0);
+            h.idx.insert(h.idx.end(), bk.second.begin(), bk.second.end());
+        }
+        groups = move(next);
+    }
+    // norms of <D|psi> for site state strings dets[idet * n_sites + i_site]
+    // in [ist, ied). The determinants are visited in lexicographic order as
+    // leaves of a TRIE, and the partial left contraction of each distinct
+    // prefix is computed only once (as in DeterminantTRIE::evaluate).
+    // find_block(i_site, d, bra, ket) returns site tensor blocks
+    template <typename FB>
+    static void prefix_overlaps(FB &&find_block, S q0, int n_sites,
+                                const vector<uint8_t> &dets, int ist, int ied,
+                                vector<double> &r) {
+        const int nd = ied - ist;
+        if (nd <= 0)
+            return;
+        vector<int> order(nd);
+        for (int k = 0; k < nd; k++)
+            order[k] = ist + k;
+        const uint8_t *pd = dets.data();
+        sort(order.begin(), order.end(), [pd, n_sites](int a, int b) {
+            return memcmp(pd + (size_t)a * n_sites, pd + (size_t)b * n_sites,
+                          n_sites) < 0;
+        });
+        // node[k] = TRIE node (at the current depth) of determinant order[k]
+        vector<int> node(nd, 0), parents;
+        vector<uint8_t> ds;
+        StochasticWalkers<S> walkers(1, q0);
+        for (int i_site = 0; i_site < n_sites; i_site++) {
+            parents.clear(), ds.clear();
+            for (int k = 0; k < nd; k++) {
+                const uint8_t d = pd[(size_t)order[k] * n_sites + i_site];
+                if (k == 0 || node[k] != parents.back() || d != ds.back())
+                    parents.push_back(node[k]), ds.push_back(d);
+                node[k] = (int)parents.size() - 1;
+            }
+            walkers.branch_step(
+                [&find_block, i_site](uint8_t d, S bra, S &ket) -> Tensor * {
+                    return find_block(i_site, d, bra, ket);
+                },
+                parents, ds);
+        }
+        vector<double> rn(parents.size(), 0.0);
+        walkers.final_norms(rn);
+        for (int k = 0; k < nd; k++)
+            r[order[k]] = rn[node[k]];
+    }
+    // norms of the final (right vacuum) vectors of all walkers
+    void final_norms(vector<double> &r) const {
+        for (auto &gq : groups)
+            for (size_t iw = 0; iw < gq.second.idx.size(); iw++)
+                r[gq.second.idx[iw]] = MatrixFunctions::norm(MatrixRef(
+                    (double *)gq.second.mat.data() + iw * gq.second.m, 1,
+                    gq.second.m));
+    }
+    static double det_energy(const shared_ptr<FCIDUMP> &fcidump,
+                             const uint8_t *det, int n_sites) {
+        double det_ener = 0;
+        for (uint16_t i = 0; i < n_sites; i++)
+            for (uint8_t si = 0; si < 2; si++)
+                if (det[i] & (si + 1)) {
+                    det_ener += fcidump->t(si, i, i);
+                    for (uint16_t j = 0; j < n_sites; j++)
+                        for (uint8_t sj = 0; sj < 2; sj++)
+                            if (det[j] & (sj + 1)) {
+                                det_ener +=
+                                    0.5 * fcidump->v(si, sj, i, i, j, j);
+                                if (si == sj)
+                                    det_ener -=
+                                        0.5 * fcidump->v(si, sj, i, j, j, i);
+                            }
+                }
+        return det_ener + fcidump->const_e;
+    }
+    // norms of <D|Psi^(0)> (ityp == 1) or <D|QV|Psi^(0)> (ityp == 0) for
+    // determinants given one after another in the format of overlap
+    template <typename SP>
+    static vector<double> batch_overlap(const SP &sp, int ityp,
+                                        const vector<uint8_t> &det_strings) {
+        const int n_sites = sp.n_sites;
+        const int nd = (int)(det_strings.size() / (2 * n_sites));
+        assert(det_strings.size() == (size_t)nd * 2 * n_sites);
+        const vector<shared_ptr<SparseTensor<S>>> &tensors =
+            ityp == 1 ? sp.tensors_psi0 : sp.tensors_qvpsi0;
+        const S q0 = (ityp == 1 ? sp.pinfos_psi0 : sp.pinfos_qvpsi0)[0][0]
+                         ->quanta[0];
+        vector<uint8_t> dets((size_t)nd * n_sites);
+        for (size_t k = 0; k < dets.size(); k++)
+            dets[k] = det_strings[2 * k] + (det_strings[2 * k + 1] << 1);
+        vector<double> r(nd, 0.0);
+        int ntg = threading->activate_global();
+        // contiguous chunks of determinants, so that only prefixes shared
+        // across chunk boundaries are contracted more than once
+        const int nchunk = min(ntg, max(nd, 1));
+#pragma omp parallel for schedule(static, 1) num_threads(ntg)
+        for (int ic = 0; ic < nchunk; ic++)
+            prefix_overlaps(
+                [&tensors](int i_site, uint8_t d, S bra, S &ket) -> Tensor * {
+                    return SP::find_block(tensors[i_site], d, bra, ket);
+                },
+                q0, n_sites, dets, (int)((size_t)nd * ic / nchunk),
+                (int)((size_t)nd * (ic + 1) / nchunk), r);
+        threading->activate_normal();
+        return r;
+    }
+    // batched and threaded sampling shared by all symmetry types
+    // ityp == 0: sampling a determinant for C term
+    //      return H00, H00sq
+    // ityp == 1: sampling a determinant for A,B term
+    //      return H11, H11sq, H10, H10sq
+    // Each batch of walkers uses its own random stream seeded by
+    // (seed, proc_id, batch index), so that results are independent of the
+    // number of threads and different MPI ranks draw different samples.
+    template <typename SP>
+    static vector<double>
+    parallel_sampling(const SP &sp, int n_sample, int ityp,
+                      const shared_ptr<FCIDUMP> &fcidump) {
+        vector<double> r(ityp == 0 ? 2 : 4, 0);
+        const int n_sites = sp.n_sites, nb = max(sp.batch_size, 1);
+        const uint8_t phys_dim = sp.phys_dim;
+        const int n_batch = (n_sample + nb - 1) / nb;
+        const S q0 = sp.pinfos_psi0[0][0]->quanta[0];
+        assert(sp.pinfos_psi0[0][0]->n == 1 && sp.pinfos_qvpsi0[0][0]->n == 1);
+        int ntg = threading->activate_global();
+        unsigned rand_sd =
+            (unsigned)Random::rand_int(0, numeric_limits<int>::max());
+        vector<vector<double>> brr(n_batch, vector<double>(r.size(), 0));
+        const vector<shared_ptr<SparseTensor<S>>> &tsample =
+            ityp == 0 ? sp.tensors_psi0 : sp.tensors_qvpsi0;
+#pragma omp parallel for schedule(dynamic) num_threads(ntg)
+        for (int ib = 0; ib < n_batch; ib++) {
+            const int nw = min(nb, n_sample - ib * nb);
+            seed_seq sseq{rand_sd, (unsigned)sp.proc_id, (unsigned)ib};
+            RandomMT rand_mt;
+            rand_mt.rng.seed(sseq);
+            vector<double> rand((size_t)nw * n_sites), rnormsq(nw, 0);
+            rand_mt.fill_rand_double(rand.data(), rand.size());
+            // dets[iw * n_sites + i_site]
+            vector<uint8_t> dets((size_t)nw * n_sites);
+            StochasticWalkers<S> walkers(nw, q0);
+            // sample psi0 / qvpsi0
+            for (int i_site = 0; i_site < n_sites; i_site++) {
+                auto fb = [&tsample, i_site](uint8_t d, S bra,
+                                             S &ket) -> Tensor * {
+                    return SP::find_block(tsample[i_site], d, bra, ket);
+                };
+                auto fs = [&](int iw, const double *cp) -> uint8_t {
+                    double acc = 0, tot = 0;
+                    for (uint8_t d = 0; d < phys_dim; d++)
+                        tot += cp[d];
+                    const double rx = rand[(size_t)iw * n_sites + i_site];
+                    for (uint8_t d = 0; d < phys_dim; d++) {
+                        acc += cp[d];
+                        if (rx < acc / tot) {
+                            rnormsq[iw] = cp[d];
+                            dets[(size_t)iw * n_sites + i_site] = d;
+                            return d;
+                        }
+                    }
+                    rnormsq[iw] = cp[phys_dim - 1];
+                    return dets[(size_t)iw * n_sites + i_site] = phys_dim - 1;
+                };
+                walkers.sample_step(phys_dim, fb, fs);
+            }
+            vector<double> snorm;
+            if (ityp == 1) {
+                // overlap psi0 (sampled determinants are often repeated)
+                snorm.resize(nw);
+                prefix_overlaps(
+                    [&sp](int i_site, uint8_t d, S bra, S &ket) -> Tensor * {
+                        return SP::find_block(sp.tensors_psi0[i_site], d, bra,
+                                              ket);
+                    },
+                    q0, n_sites, dets, 0, nw, snorm);
+            }
+            vector<double> &rr = brr[ib];
+            for (int iw = 0; iw < nw; iw++) {
+                const double det_ener = det_energy(
+                    fcidump, dets.data() + (size_t)iw * n_sites, n_sites);
+                if (ityp == 0) {
+                    rr[0] += 1 / det_ener;
+                    rr[1] += 1 / (det_ener * det_ener);
+                } else {
+                    const double norm_qvpsi0 = sp.norm_qvpsi0;
+                    rr[0] += norm_qvpsi0 / det_ener;
+                    rr[1] += norm_qvpsi0 * norm_qvpsi0 / (det_ener * det_ener);
+                    const double tmp = norm_qvpsi0 * snorm[iw] /
+                                       (sqrt(rnormsq[iw]) * det_ener);
+                    rr[2] += tmp;
+                    rr[3] += tmp * tmp;
+                }
+            }
+        }
+        for (int j = 0; j < (int)r.size(); j++) {
+            for (int ib = 0; ib < n_batch; ib++)
+                r[j] += brr[ib][j];
+            if (n_sample != 0)
+                r[j] /= n_sample;
+        }
+        threading->activate_normal();
+        return r;
+    }
+};
+
 template <typename, typename = void> struct StochasticPDMRG;
 
 // stochastic perturbative DMRG
@@ -58,6 +382,10 @@ template <typename S> struct StochasticPDMRG<S, typename S::is_sz_t> {
     vector<vector<shared_ptr<SparseMatrixInfo<S>>>> pinfos_psi0, pinfos_qvpsi0;
     int n_sites;
     uint8_t phys_dim;
+    // number of walkers advancing together in parallel_sampling
+    int batch_size = 64;
+    // rank index used to decorrelate random streams of different processes
+    int proc_id = 0;
     StochasticPDMRG() {}
     StochasticPDMRG(const shared_ptr<UnfusedMPS<S>> &mps_psi0,
                     const shared_ptr<UnfusedMPS<S>> &mps_qvpsi0,
@@ -219,151 +547,32 @@ template <typename S> struct StochasticPDMRG<S, typename S::is_sz_t> {
         }
         return 0;
     }
-    void
-    gen_tmp_mats(const vector<vector<shared_ptr<SparseMatrixInfo<S>>>> &pinfos,
-                 const vector<shared_ptr<SparseTensor<S>>> &tensors,
-                 vector<vector<shared_ptr<SparseMatrix<S>>>> &pmats) const {
-        pmats.resize(n_sites + 1);
-        shared_ptr<VectorAllocator<double>> dd_alloc =
-            make_shared<VectorAllocator<double>>();
-        for (int i_site = 0; i_site < n_sites + 1; i_site++) {
-            pmats[i_site].resize(pinfos[i_site].size());
-            for (uint8_t d = 0; d < (uint8_t)pinfos[i_site].size(); d++) {
-                pmats[i_site][d] = make_shared<SparseMatrix<S>>(dd_alloc);
-                pmats[i_site][d]->allocate(pinfos[i_site][d]);
+    // tensor block for physical state d and left quantum bra
+    static Tensor *find_block(const shared_ptr<SparseTensor<S>> &ts,
+                              uint8_t d, S bra, S &ket) {
+        for (auto &m : ts->data[d])
+            if (m.first.first == bra) {
+                ket = m.first.second;
+                return m.second.get();
             }
-        }
-        for (size_t j = 0; j < pmats[0][0]->total_memory; j++)
-            pmats[0][0]->data[j] = 1.0;
+        return nullptr;
     }
-    // parallelized sampling using openmp
+    // batched overlap of many determinants, sharing common prefixes
+    // ityp == 0: <Psi^(0)|VQ|D>
+    // ityp == 1: <Psi^(0)|D>
+    vector<double> batch_overlap(int ityp,
+                                 const vector<uint8_t> &det_strings) const {
+        return StochasticWalkers<S>::batch_overlap(*this, ityp, det_strings);
+    }
+    // batched parallel sampling using openmp
     // ityp == 0: sampling a determinant for C term
     //      return H00, H00sq
     // ityp == 1: sampling a determinant for A,B term
     //      return H11, H11sq, H10, H10sq
     vector<double> parallel_sampling(int n_sample, int ityp,
                                      const shared_ptr<FCIDUMP> &fcidump) const {
-        vector<double> r(ityp == 0 ? 2 : 4, 0);
-        int ntg = threading->activate_global();
-        unsigned rand_sd =
-            (unsigned)Random::rand_int(0, numeric_limits<int>::max());
-        vector<vector<double>> prr(ntg, r);
-#pragma omp parallel num_threads(ntg)
-        {
-            vector<vector<vector<shared_ptr<SparseMatrix<S>>>>> pmats;
-            vector<const vector<shared_ptr<SparseTensor<S>>> *> tensors;
-            int tid = threading->get_thread_id();
-            RandomMT rand_mt((unsigned)(rand_sd + tid));
-            if (ityp == 0) {
-                pmats.resize(1);
-                tensors.push_back(&tensors_psi0);
-                gen_tmp_mats(pinfos_psi0, tensors_psi0, pmats[0]);
-            } else {
-                pmats.resize(2);
-                tensors.push_back(&tensors_qvpsi0);
-                tensors.push_back(&tensors_psi0);
-                gen_tmp_mats(pinfos_qvpsi0, tensors_qvpsi0, pmats[0]);
-                gen_tmp_mats(pinfos_psi0, tensors_psi0, pmats[1]);
-            }
-            vector<double> rand(n_sites);
-            vector<uint8_t> det_string(n_sites);
-            vector<double> cp(phys_dim), accp(phys_dim + 1, 0);
-            vector<shared_ptr<SparseMatrix<S>>> ptrs_save(phys_dim);
-            shared_ptr<SparseMatrix<S>> ptrs;
-            vector<double> &rr = prr[tid];
-#pragma omp for schedule(static)
-            for (int i_sample = 0; i_sample < n_sample; i_sample++) {
-                rand_mt.fill_rand_double((double *)rand.data(), n_sites);
-                double det_ener = 0, rnormsq = 0, snorm = 0;
-                ptrs = pmats[0][0][0];
-                // sample psi0 / qvpsi0
-                for (int i_site = 0; i_site < n_sites; i_site++) {
-                    for (uint8_t d = 0; d < phys_dim; d++) {
-                        shared_ptr<SparseMatrix<S>> pmp = ptrs;
-                        shared_ptr<SparseMatrix<S>> cmp =
-                            pmats[0][i_site + 1][d];
-                        cmp->clear();
-                        for (auto &m : (*tensors[0])[i_site]->data[d]) {
-                            S bra = m.first.first, ket = m.first.second;
-                            if (pmp->info->find_state(bra) == -1)
-                                continue;
-                            MatrixFunctions::multiply((*pmp)[bra], false,
-                                                      m.second->ref(), false,
-                                                      (*cmp)[ket], 1.0, 1.0);
-                        }
-                        double tmp = cmp->norm();
-                        cp[d] = tmp * tmp;
-                        ptrs_save[d] = cmp;
-                    }
-                    for (uint8_t d = 0; d < phys_dim; d++)
-                        accp[d + 1] = accp[d] + cp[d];
-                    for (uint8_t d = 0; d < phys_dim; d++) {
-                        accp[d + 1] /= accp[phys_dim];
-                        if (rand[i_site] < accp[d + 1]) {
-                            ptrs = ptrs_save[d];
-                            rnormsq = cp[d];
-                            det_string[i_site] = d;
-                            break;
-                        }
-                    }
-                }
-                for (uint16_t i = 0; i < n_sites; i++)
-                    for (uint8_t si = 0; si < 2; si++)
-                        if (det_string[i] & (si + 1)) {
-                            det_ener += fcidump->t(si, i, i);
-                            for (uint16_t j = 0; j < n_sites; j++)
-                                for (uint8_t sj = 0; sj < 2; sj++)
-                                    if (det_string[j] & (sj + 1)) {
-                                        det_ener += 0.5 * fcidump->v(si, sj, i,
-                                                                     i, j, j);
-                                        if (si == sj)
-                                            det_ener -=
-                                                0.5 *
-                                                fcidump->v(si, sj, i, j, j, i);
-                                    }
-                        }
-                det_ener += fcidump->const_e;
-                if (ityp == 0) {
-                    rr[0] += 1 / det_ener;
-                    rr[1] += 1 / (det_ener * det_ener);
-                } else {
-                    rr[0] += norm_qvpsi0 / det_ener;
-                    rr[1] += norm_qvpsi0 * norm_qvpsi0 / (det_ener * det_ener);
-                    ptrs = pmats[1][0][0];
-                    // overlap psi0
-                    for (int i_site = 0; i_site < n_sites; i_site++) {
-                        const uint8_t d = det_string[i_site];
-                        shared_ptr<SparseMatrix<S>> pmp = ptrs;
-                        shared_ptr<SparseMatrix<S>> cmp =
-                            pmats[1][i_site + 1][d];
-                        cmp->clear();
-                        for (auto &m : (*tensors[1])[i_site]->data[d]) {
-                            S bra = m.first.first, ket = m.first.second;
-                            if (pmp->info->find_state(bra) == -1)
-                                continue;
-                            MatrixFunctions::multiply((*pmp)[bra], false,
-                                                      m.second->ref(), false,
-                                                      (*cmp)[ket], 1.0, 1.0);
-                        }
-                        ptrs = cmp;
-                        if (i_site == n_sites - 1)
-                            snorm = cmp->norm();
-                    }
-                    const double tmp =
-                        norm_qvpsi0 * snorm / (sqrt(rnormsq) * det_ener);
-                    rr[2] += tmp;
-                    rr[3] += tmp * tmp;
-                }
-            }
-        }
-        for (int j = 0; j < (int)r.size(); j++) {
-            for (int ip = 0; ip < ntg; ip++)
-                r[j] += prr[ip][j];
-            if (n_sample != 0)
-                r[j] /= n_sample;
-        }
-        threading->activate_normal();
-        return r;
+        return StochasticWalkers<S>::parallel_sampling(*this, n_sample, ityp,
+                                                       fcidump);
     }
     double energy_zeroth(const shared_ptr<FCIDUMP> &fcidump, MatrixRef e_pqqp,
                          MatrixRef e_pqpq, MatrixRef pdm1) {
@@ -391,6 +600,10 @@ template <typename S> struct StochasticPDMRG<S, typename S::is_su2_t> {
     vector<vector<shared_ptr<SparseMatrixInfo<S>>>> pinfos_psi0, pinfos_qvpsi0;
     int n_sites;
     uint8_t phys_dim;
+    // number of walkers advancing together in parallel_sampling
+    int batch_size = 64;
+    // rank index used to decorrelate random streams of different processes
+    int proc_id = 0;
     StochasticPDMRG() {}
     StochasticPDMRG(const shared_ptr<UnfusedMPS<S>> &mps_psi0,
                     const shared_ptr<UnfusedMPS<S>> &mps_qvpsi0,
@@ -562,161 +775,39 @@ template <typename S> struct StochasticPDMRG<S, typename S::is_su2_t> {
         }
         return 0;
     }
-    void
-    gen_tmp_mats(const vector<vector<shared_ptr<SparseMatrixInfo<S>>>> &pinfos,
-                 const vector<shared_ptr<SparseTensor<S>>> &tensors,
-                 vector<vector<shared_ptr<SparseMatrix<S>>>> &pmats) const {
-        pmats.resize(n_sites + 1);
-        shared_ptr<VectorAllocator<double>> dd_alloc =
-            make_shared<VectorAllocator<double>>();
-        for (int i_site = 0; i_site < n_sites + 1; i_site++) {
-            pmats[i_site].resize(pinfos[i_site].size());
-            for (uint8_t d = 0; d < (uint8_t)pinfos[i_site].size(); d++) {
-                pmats[i_site][d] = make_shared<SparseMatrix<S>>(dd_alloc);
-                pmats[i_site][d]->allocate(pinfos[i_site][d]);
-            }
+    // tensor block for physical state d and left quantum bra
+    // d == 1 / 2: singly occupied with increasing / decreasing spin
+    static Tensor *find_block(const shared_ptr<SparseTensor<S>> &ts,
+                              uint8_t d, S bra, S &ket) {
+        int dd = d >= 2 ? d - 1 : d;
+        for (auto &m : ts->data[dd]) {
+            if (m.first.first != bra)
+                continue;
+            S mket = m.first.second;
+            if (dd == 1 && !((d == 1 && mket.twos() > bra.twos()) ||
+                             (d == 2 && mket.twos() < bra.twos())))
+                continue;
+            ket = mket;
+            return m.second.get();
         }
-        for (size_t j = 0; j < pmats[0][0]->total_memory; j++)
-            pmats[0][0]->data[j] = 1.0;
+        return nullptr;
+    }
+    // batched overlap of many determinants, sharing common prefixes
+    // ityp == 0: <Psi^(0)|VQ|D>
+    // ityp == 1: <Psi^(0)|D>
+    vector<double> batch_overlap(int ityp,
+                                 const vector<uint8_t> &det_strings) const {
+        return StochasticWalkers<S>::batch_overlap(*this, ityp, det_strings);
     }
-    // parallelized sampling using openmp
+    // batched parallel sampling using openmp
     // ityp == 0: sampling a determinant for C term
     //      return H00, H00sq
     // ityp == 1: sampling a determinant for A,B term
     //      return H11, H11sq, H10, H10sq
     vector<double> parallel_sampling(int n_sample, int ityp,
                                      const shared_ptr<FCIDUMP> &fcidump) const {
-        vector<double> r(ityp == 0 ? 2 : 4, 0);
-        int ntg = threading->activate_global();
-        unsigned rand_sd =
-            (unsigned)Random::rand_int(0, numeric_limits<int>::max());
-        vector<vector<double>> prr(ntg, r);
-#pragma omp parallel num_threads(ntg)
-        {
-            vector<vector<vector<shared_ptr<SparseMatrix<S>>>>> pmats;
-            vector<const vector<shared_ptr<SparseTensor<S>>> *> tensors;
-            int tid = threading->get_thread_id();
-            RandomMT rand_mt((unsigned)(rand_sd + tid));
-            if (ityp == 0) {
-                pmats.resize(1);
-                tensors.push_back(&tensors_psi0);
-                gen_tmp_mats(pinfos_psi0, tensors_psi0, pmats[0]);
-            } else {
-                pmats.resize(2);
-                tensors.push_back(&tensors_qvpsi0);
-                tensors.push_back(&tensors_psi0);
-                gen_tmp_mats(pinfos_qvpsi0, tensors_qvpsi0, pmats[0]);
-                gen_tmp_mats(pinfos_psi0, tensors_psi0, pmats[1]);
-            }
-            vector<double> rand(n_sites);
-            vector<uint8_t> det_string(n_sites);
-            vector<double> cp(phys_dim), accp(phys_dim + 1, 0);
-            vector<shared_ptr<SparseMatrix<S>>> ptrs_save(phys_dim);
-            shared_ptr<SparseMatrix<S>> ptrs;
-            vector<double> &rr = prr[tid];
-#pragma omp for schedule(static)
-            for (int i_sample = 0; i_sample < n_sample; i_sample++) {
-                rand_mt.fill_rand_double((double *)rand.data(), n_sites);
-                double det_ener = 0, rnormsq = 0, snorm = 0;
-                ptrs = pmats[0][0][0];
-                // sample psi0 / qvpsi0
-                for (int i_site = 0; i_site < n_sites; i_site++) {
-                    for (uint8_t d = 0; d < phys_dim; d++) {
-                        int dd = d >= 2 ? d - 1 : d;
-                        shared_ptr<SparseMatrix<S>> pmp = ptrs;
-                        shared_ptr<SparseMatrix<S>> cmp =
-                            pmats[0][i_site + 1][d];
-                        cmp->clear();
-                        for (auto &m : (*tensors[0])[i_site]->data[dd]) {
-                            S bra = m.first.first, ket = m.first.second;
-                            if (dd == 1 &&
-                                !((d == 1 && ket.twos() > bra.twos()) ||
-                                  (d == 2 && ket.twos() < bra.twos())))
-                                continue;
-                            if (pmp->info->find_state(bra) == -1)
-                                continue;
-                            MatrixFunctions::multiply((*pmp)[bra], false,
-                                                      m.second->ref(), false,
-                                                      (*cmp)[ket], 1.0, 1.0);
-                        }
-                        double tmp = cmp->norm();
-                        cp[d] = tmp * tmp;
-                        ptrs_save[d] = cmp;
-                    }
-                    for (uint8_t d = 0; d < phys_dim; d++)
-                        accp[d + 1] = accp[d] + cp[d];
-                    for (uint8_t d = 0; d < phys_dim; d++) {
-                        accp[d + 1] /= accp[phys_dim];
-                        if (rand[i_site] < accp[d + 1]) {
-                            ptrs = ptrs_save[d];
-                            rnormsq = cp[d];
-                            det_string[i_site] = d;
-                            break;
-                        }
-                    }
-                }
-                for (uint16_t i = 0; i < n_sites; i++)
-                    for (uint8_t si = 0; si < 2; si++)
-                        if (det_string[i] & (si + 1)) {
-                            det_ener += fcidump->t(si, i, i);
-                            for (uint16_t j = 0; j < n_sites; j++)
-                                for (uint8_t sj = 0; sj < 2; sj++)
-                                    if (det_string[j] & (sj + 1)) {
-                                        det_ener += 0.5 * fcidump->v(si, sj, i,
-                                                                     i, j, j);
-                                        if (si == sj)
-                                            det_ener -=
-                                                0.5 *
-                                                fcidump->v(si, sj, i, j, j, i);
-                                    }
-                        }
-                det_ener += fcidump->const_e;
-                if (ityp == 0) {
-                    rr[0] += 1 / det_ener;
-                    rr[1] += 1 / (det_ener * det_ener);
-                } else {
-                    rr[0] += norm_qvpsi0 / det_ener;
-                    rr[1] += norm_qvpsi0 * norm_qvpsi0 / (det_ener * det_ener);
-                    ptrs = pmats[1][0][0];
-                    // overlap psi0
-                    for (int i_site = 0; i_site < n_sites; i_site++) {
-                        const uint8_t d = det_string[i_site];
-                        int dd = d >= 2 ? d - 1 : d;
-                        shared_ptr<SparseMatrix<S>> pmp = ptrs;
-                        shared_ptr<SparseMatrix<S>> cmp =
-                            pmats[1][i_site + 1][d];
-                        cmp->clear();
-                        for (auto &m : (*tensors[1])[i_site]->data[dd]) {
-                            S bra = m.first.first, ket = m.first.second;
-                            if (dd == 1 &&
-                                !((d == 1 && ket.twos() > bra.twos()) ||
-                                  (d == 2 && ket.twos() < bra.twos())))
-                                continue;
-                            if (pmp->info->find_state(bra) == -1)
-                                continue;
-                            MatrixFunctions::multiply((*pmp)[bra], false,
-                                                      m.second->ref(), false,
-                                                      (*cmp)[ket], 1.0, 1.0);
-                        }
-                        ptrs = cmp;
-                        if (i_site == n_sites - 1)
-                            snorm = cmp->norm();
-                    }
-                    const double tmp =
-                        norm_qvpsi0 * snorm / (sqrt(rnormsq) * det_ener);
-                    rr[2] += tmp;
-                    rr[3] += tmp * tmp;
-                }
-            }
-        }
-        for (int j = 0; j < (int)r.size(); j++) {
-            for (int ip = 0; ip < ntg; ip++)
-                r[j] += prr[ip][j];
-            if (n_sample != 0)
-                r[j] /= n_sample;
-        }
-        threading->activate_normal();
-        return r;
+        return StochasticWalkers<S>::parallel_sampling(*this, n_sample, ityp,
+                                                       fcidump);
     }
     double energy_zeroth(const shared_ptr<FCIDUMP> &fcidump, MatrixRef e_pqqp,
                          MatrixRef e_pqpq, MatrixRef pdm1) {
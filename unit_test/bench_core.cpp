@@ -0,0 +1,85 @@
+
+#include "block2_core.hpp"
+#include <benchmark/benchmark.h>
+
+using namespace block2;
+
+class BenchCore : public benchmark::Fixture {
+  public:
+    size_t isize = 1L << 20;
+    size_t dsize = 1L << 28;
+    void SetUp(const benchmark::State &state) override {
+        Random::rand_seed(0);
+        frame_() = make_shared<DataFrame>(isize, dsize, "nodex");
+        threading_() = make_shared<Threading>(
+            ThreadingTypes::OperatorBatchedGEMM | ThreadingTypes::Global, 8,
+            8, 1);
+    }
+    void TearDown(const benchmark::State &state) override {
+        frame_()->activate(0);
+        assert(ialloc_()->used == 0 && dalloc_()->used == 0);
+        frame_() = nullptr;
+    }
+};
+
+BENCHMARK_DEFINE_F(BenchCore, FCIDUMPRead)(benchmark::State &state) {
+    for (auto _ : state) {
+        shared_ptr<FCIDUMP> fcidump = make_shared<FCIDUMP>();
+        fcidump->read("data/N2.CAS.PVDZ.T0.FCIDUMP");
+        benchmark::DoNotOptimize(fcidump->e());
+        fcidump->deallocate();
+    }
+}
+BENCHMARK_REGISTER_F(BenchCore, FCIDUMPRead)->Unit(benchmark::kMillisecond);
+
+// diagonalization of one density matrix block in the decomposition step
+BENCHMARK_DEFINE_F(BenchCore, DensityMatrixEigs)(benchmark::State &state) {
+    const MKL_INT n = (MKL_INT)state.range(0);
+    MatrixRef a(dalloc_()->allocate(n * n), n, n);
+    MatrixRef x(dalloc_()->allocate(n * n), n, n);
+    DiagonalMatrix w(dalloc_()->allocate(n), n);
+    Random::fill_rand_double(x.data, x.size());
+    // positive semi-definite as a density matrix
+    MatrixFunctions::multiply(x, false, x, true, a, 1.0, 0.0);
+    MatrixRef b(dalloc_()->allocate(n * n), n, n);
+    for (auto _ : state) {
+        MatrixFunctions::copy(b, a);
+        MatrixFunctions::eigs(b, w);
+        benchmark::DoNotOptimize(w.data[0]);
+    }
+    b.deallocate();
+    w.deallocate();
+    x.deallocate();
+    a.deallocate();
+}
+BENCHMARK_REGISTER_F(BenchCore, DensityMatrixEigs)
+    ->Arg(250)
+    ->Arg(500)
+    ->Arg(1000)
+    ->Unit(benchmark::kMillisecond);
+
+// c = bra.T * a * ket, the kernel of blocking and rotation
+BENCHMARK_DEFINE_F(BenchCore, Rotate)(benchmark::State &state) {
+    const MKL_INT m = (MKL_INT)state.range(0), k = m * 4;
+    MatrixRef a(dalloc_()->allocate(k * k), k, k);
+    MatrixRef c(dalloc_()->allocate(m * m), m, m);
+    MatrixRef l(dalloc_()->allocate(k * m), k, m);
+    MatrixRef r(dalloc_()->allocate(k * m), k, m);
+    Random::fill_rand_double(a.data, a.size());
+    Random::fill_rand_double(l.data, l.size());
+    Random::fill_rand_double(r.data, r.size());
+    size_t nflop = 0;
+    for (auto _ : state)
+        nflop += MatrixFunctions::rotate(a, c, l, true, r, false, 1.0);
+    state.counters["FLOPS"] =
+        benchmark::Counter((double)nflop, benchmark::Counter::kIsRate);
+    r.deallocate();
+    l.deallocate();
+    c.deallocate();
+    a.deallocate();
+}
+BENCHMARK_REGISTER_F(BenchCore, Rotate)
+    ->Arg(100)
+    ->Arg(250)
+    ->Arg(500)
+    ->Unit(benchmark::kMillisecond);
@@ -0,0 +1,113 @@
+
+#include "block2_core.hpp"
+#include "block2_dmrg.hpp"
+#include <benchmark/benchmark.h>
+
+using namespace block2;
+
+class BenchDMRGN2PVDZ : public benchmark::Fixture {
+  public:
+    size_t isize = 1L << 24;
+    size_t dsize = 1L << 32;
+    shared_ptr<FCIDUMP> fcidump;
+    shared_ptr<HamiltonianQC<SU2>> hamil;
+    void SetUp(const benchmark::State &state) override {
+        Random::rand_seed(0);
+        frame_() = make_shared<DataFrame>(isize, dsize, "nodex");
+        frame_()->use_main_stack = false;
+        frame_()->minimal_disk_usage = true;
+        threading_() = make_shared<Threading>(
+            ThreadingTypes::OperatorBatchedGEMM | ThreadingTypes::Global, 8, 8,
+            1);
+        threading_()->seq_type = SeqTypes::Tasked;
+        fcidump = make_shared<FCIDUMP>();
+        PGTypes pg = PGTypes::D2H;
+        fcidump->read("data/N2.CAS.PVDZ.T0.FCIDUMP");
+        vector<uint8_t> orbsym = fcidump->orb_sym<uint8_t>();
+        transform(orbsym.begin(), orbsym.end(), orbsym.begin(),
+                  PointGroup::swap_pg(pg));
+        hamil = make_shared<HamiltonianQC<SU2>>(SU2(0), fcidump->n_sites(),
+                                                orbsym, fcidump);
+    }
+    void TearDown(const benchmark::State &state) override {
+        hamil->deallocate();
+        fcidump->deallocate();
+        frame_()->activate(0);
+        assert(ialloc_()->used == 0 && dalloc_()->used == 0);
+        frame_() = nullptr;
+    }
+    shared_ptr<MPO<SU2>> build_mpo() const {
+        shared_ptr<MPO<SU2>> mpo =
+            make_shared<MPOQC<SU2>>(hamil, QCTypes::Conventional);
+        return make_shared<SimplifiedMPO<SU2>>(
+            mpo, make_shared<RuleQC<SU2>>(), true, true,
+            OpNamesSet({OpNames::R, OpNames::RD}));
+    }
+};
+
+BENCHMARK_DEFINE_F(BenchDMRGN2PVDZ, MPOConstruction)
+(benchmark::State &state) {
+    for (auto _ : state) {
+        shared_ptr<MPO<SU2>> mpo = build_mpo();
+        benchmark::DoNotOptimize(mpo->n_sites);
+        mpo->deallocate();
+    }
+}
+BENCHMARK_REGISTER_F(BenchDMRGN2PVDZ, MPOConstruction)
+    ->Unit(benchmark::kMillisecond);
+
+// one two-site sweep at fixed bond dimension (range 0), after warm-up
+// sweeps; the counters split the time per sweep into Davidson (matvec),
+// decomposition, environment blocking/rotation and the whole site update
+BENCHMARK_DEFINE_F(BenchDMRGN2PVDZ, Sweep)(benchmark::State &state) {
+    const ubond_t bond_dim = (ubond_t)state.range(0);
+    shared_ptr<MPO<SU2>> mpo = build_mpo();
+    SU2 target(fcidump->n_elec(), fcidump->twos(),
+               PointGroup::swap_pg(PGTypes::D2H)(fcidump->isym()));
+    shared_ptr<MPSInfo<SU2>> mps_info = make_shared<MPSInfo<SU2>>(
+        hamil->n_sites, hamil->vacuum, target, hamil->basis);
+    mps_info->set_bond_dimension(bond_dim);
+    shared_ptr<MPS<SU2>> mps = make_shared<MPS<SU2>>(hamil->n_sites, 0, 2);
+    mps->initialize(mps_info);
+    mps->random_canonicalize();
+    mps->save_mutable();
+    mps->deallocate();
+    mps_info->save_mutable();
+    mps_info->deallocate_mutable();
+    shared_ptr<MovingEnvironment<SU2>> me =
+        make_shared<MovingEnvironment<SU2>>(mpo, mps, mps, "DMRG");
+    me->init_environments(false);
+    me->delayed_contraction = OpNamesSet::normal_ops();
+    me->cached_contraction = true;
+    vector<ubond_t> bdims = {bond_dim};
+    vector<double> noises = {1E-6, 1E-6, 1E-7, 0.0};
+    shared_ptr<DMRG<SU2>> dmrg = make_shared<DMRG<SU2>>(me, bdims, noises);
+    dmrg->iprint = 0;
+    dmrg->decomp_type = DecompositionTypes::DensityMatrix;
+    dmrg->noise_type = NoiseTypes::ReducedPerturbative;
+    dmrg->solve(4, mps->center == 0, 0.0);
+    dmrg->noises = vector<double>{0.0};
+    double teig = 0, tdm = 0, tmve = 0, tblk = 0, energy = 0;
+    size_t nflop = 0;
+    for (auto _ : state) {
+        energy = dmrg->solve(1, mps->center == 0, 0.0);
+        teig += dmrg->teig, tdm += dmrg->tdm, tmve += dmrg->tmve;
+        tblk += dmrg->tblk, nflop += dmrg->sweep_cumulative_nflop;
+    }
+    state.counters["T_davidson"] =
+        benchmark::Counter(teig, benchmark::Counter::kAvgIterations);
+    state.counters["T_decomp"] =
+        benchmark::Counter(tdm, benchmark::Counter::kAvgIterations);
+    state.counters["T_blocking"] =
+        benchmark::Counter(tmve, benchmark::Counter::kAvgIterations);
+    state.counters["T_update"] =
+        benchmark::Counter(tblk, benchmark::Counter::kAvgIterations);
+    state.counters["matvec_GFLOPS"] = teig == 0 ? 0.0 : nflop / teig * 1E-9;
+    state.counters["energy"] = energy;
+    mps_info->deallocate();
+    mpo->deallocate();
+}
+BENCHMARK_REGISTER_F(BenchDMRGN2PVDZ, Sweep)
+    ->Arg(250)
+    ->Unit(benchmark::kSecond)
+    ->Iterations(2);
@@ -294,3 +294,816 @@ TEST_F(TestDMRGN2STO3G, TestSZ) {
     hamil->deallocate();
     fcidump->deallocate();
 }
+
+TEST_F(TestDMRGN2STO3G, TestSU2NonBlocking) {
+
+    shared_ptr<FCIDUMP> fcidump = make_shared<FCIDUMP>();
+    PGTypes pg = PGTypes::D2H;
+    string filename = "data/N2.STO3G.FCIDUMP";
+    fcidump->read(filename);
+    vector<uint8_t> orbsym = fcidump->orb_sym<uint8_t>();
+    transform(orbsym.begin(), orbsym.end(), orbsym.begin(),
+              PointGroup::swap_pg(pg));
+
+    SU2 vacuum(0);
+    SU2 target(fcidump->n_elec(), fcidump->twos(),
+               PointGroup::swap_pg(pg)(fcidump->isym()));
+    double energy_std = -107.654122447525;
+
+    // reduction of compiled matvec is only overlapped without seq
+    threading_()->seq_type = SeqTypes::None;
+
+    int norb = fcidump->n_sites();
+    shared_ptr<HamiltonianQC<SU2>> hamil =
+        make_shared<HamiltonianQC<SU2>>(vacuum, norb, orbsym, fcidump);
+
+#ifdef _HAS_MPI
+    shared_ptr<ParallelCommunicator<SU2>> para_comm =
+        make_shared<MPICommunicator<SU2>>();
+#else
+    shared_ptr<ParallelCommunicator<SU2>> para_comm =
+        make_shared<ParallelCommunicator<SU2>>(1, 0, 0);
+#endif
+    shared_ptr<ParallelRule<SU2>> para_rule = make_shared<ParallelRuleQC<SU2>>(
+        para_comm, ParallelCommTypes::NonBlocking);
+
+    shared_ptr<MPO<SU2>> mpo =
+        make_shared<MPOQC<SU2>>(hamil, QCTypes::Conventional);
+    mpo = make_shared<SimplifiedMPO<SU2>>(mpo, make_shared<RuleQC<SU2>>(),
+                                          true);
+    mpo = make_shared<ParallelMPO<SU2>>(mpo, para_rule);
+
+    ubond_t bond_dim = 200;
+    vector<ubond_t> bdims = {bond_dim};
+    vector<double> noises = {1E-8, 1E-9, 0.0};
+
+    shared_ptr<MPSInfo<SU2>> mps_info =
+        make_shared<MPSInfo<SU2>>(norb, vacuum, target, hamil->basis);
+    mps_info->set_bond_dimension(bond_dim);
+    shared_ptr<MPS<SU2>> mps = make_shared<MPS<SU2>>(norb, 0, 2);
+    mps->initialize(mps_info);
+    mps->random_canonicalize();
+    mps->save_mutable();
+    mps->deallocate();
+    mps_info->save_mutable();
+    mps_info->deallocate_mutable();
+
+    shared_ptr<MovingEnvironment<SU2>> me =
+        make_shared<MovingEnvironment<SU2>>(mpo, mps, mps, "DMRG");
+    me->init_environments(false);
+    shared_ptr<DMRG<SU2>> dmrg = make_shared<DMRG<SU2>>(me, bdims, noises);
+    dmrg->iprint = 0;
+    double energy = dmrg->solve(10, mps->center == 0, 1E-8);
+    cout << "== SU2 NONBLOCKING == E = " << fixed << setw(22)
+         << setprecision(12) << energy << " error = " << scientific
+         << setprecision(3) << setw(10) << (energy - energy_std) << endl;
+    EXPECT_LT(abs(energy - energy_std), 1E-7);
+
+    threading_()->seq_type = SeqTypes::Tasked;
+    mps_info->deallocate();
+    mpo->deallocate();
+    hamil->deallocate();
+    fcidump->deallocate();
+}
+
+TEST_F(TestDMRGN2STO3G, TestSU2OneSided) {
+
+#ifdef _HAS_MPI
+    shared_ptr<ParallelCommunicator<SU2>> para_comm =
+        make_shared<MPICommunicator<SU2>>();
+#else
+    shared_ptr<ParallelCommunicator<SU2>> para_comm =
+        make_shared<ParallelCommunicator<SU2>>(1, 0, 0);
+#endif
+    // each proc gets the arrays of all other procs, except arrays of proc 0
+    const int n = 1000;
+    vector<vector<double>> arrs(para_comm->size, vector<double>(n, 0.0));
+    vector<double *> datas(para_comm->size);
+    vector<size_t> lens(para_comm->size, n);
+    vector<int> owners(para_comm->size);
+    for (int ip = 0; ip < para_comm->size; ip++) {
+        if (ip == para_comm->rank)
+            for (int i = 0; i < n; i++)
+                arrs[ip][i] = sin(i * 0.37 + ip);
+        datas[ip] = ip == 0 && para_comm->rank != 0 ? nullptr : arrs[ip].data();
+        owners[ip] = ip;
+    }
+    para_comm->fetch(datas, lens, owners);
+    for (int ip = 0; ip < para_comm->size; ip++)
+        for (int i = 0; i < n; i++)
+            EXPECT_EQ(arrs[ip][i], ip == 0 && para_comm->rank != 0
+                                       ? 0.0
+                                       : sin(i * 0.37 + ip));
+
+    shared_ptr<FCIDUMP> fcidump = make_shared<FCIDUMP>();
+    PGTypes pg = PGTypes::D2H;
+    string filename = "data/N2.STO3G.FCIDUMP";
+    fcidump->read(filename);
+    vector<uint8_t> orbsym = fcidump->orb_sym<uint8_t>();
+    transform(orbsym.begin(), orbsym.end(), orbsym.begin(),
+              PointGroup::swap_pg(pg));
+
+    SU2 vacuum(0);
+    SU2 target(fcidump->n_elec(), fcidump->twos(),
+               PointGroup::swap_pg(pg)(fcidump->isym()));
+    double energy_std = -107.654122447525;
+
+    int norb = fcidump->n_sites();
+    shared_ptr<HamiltonianQC<SU2>> hamil =
+        make_shared<HamiltonianQC<SU2>>(vacuum, norb, orbsym, fcidump);
+    shared_ptr<ParallelRule<SU2>> para_rule = make_shared<ParallelRuleQC<SU2>>(
+        para_comm, ParallelCommTypes::OneSided);
+
+    shared_ptr<MPO<SU2>> mpo =
+        make_shared<MPOQC<SU2>>(hamil, QCTypes::Conventional);
+    mpo = make_shared<SimplifiedMPO<SU2>>(mpo, make_shared<RuleQC<SU2>>(),
+                                          true);
+    mpo = make_shared<ParallelMPO<SU2>>(mpo, para_rule);
+
+    ubond_t bond_dim = 200;
+    vector<ubond_t> bdims = {bond_dim};
+    vector<double> noises = {1E-8, 1E-9, 0.0};
+
+    shared_ptr<MPSInfo<SU2>> mps_info =
+        make_shared<MPSInfo<SU2>>(norb, vacuum, target, hamil->basis);
+    mps_info->set_bond_dimension(bond_dim);
+    shared_ptr<MPS<SU2>> mps = make_shared<MPS<SU2>>(norb, 0, 2);
+    mps->initialize(mps_info);
+    mps->random_canonicalize();
+    mps->save_mutable();
+    mps->deallocate();
+    mps_info->save_mutable();
+    mps_info->deallocate_mutable();
+
+    shared_ptr<MovingEnvironment<SU2>> me =
+        make_shared<MovingEnvironment<SU2>>(mpo, mps, mps, "DMRG");
+    me->init_environments(false);
+    shared_ptr<DMRG<SU2>> dmrg = make_shared<DMRG<SU2>>(me, bdims, noises);
+    dmrg->iprint = 0;
+    double energy = dmrg->solve(10, mps->center == 0, 1E-8);
+    cout << "== SU2 ONE SIDED == E = " << fixed << setw(22)
+         << setprecision(12) << energy << " error = " << scientific
+         << setprecision(3) << setw(10) << (energy - energy_std) << endl;
+    EXPECT_LT(abs(energy - energy_std), 1E-7);
+
+    mps_info->deallocate();
+    mpo->deallocate();
+    hamil->deallocate();
+    fcidump->deallocate();
+}
+
+TEST_F(TestDMRGN2STO3G, TestSU2Rebalance) {
+
+    shared_ptr<FCIDUMP> fcidump = make_shared<FCIDUMP>();
+    PGTypes pg = PGTypes::D2H;
+    string filename = "data/N2.STO3G.FCIDUMP";
+    fcidump->read(filename);
+    vector<uint8_t> orbsym = fcidump->orb_sym<uint8_t>();
+    transform(orbsym.begin(), orbsym.end(), orbsym.begin(),
+              PointGroup::swap_pg(pg));
+
+    SU2 vacuum(0);
+    SU2 target(fcidump->n_elec(), fcidump->twos(),
+               PointGroup::swap_pg(pg)(fcidump->isym()));
+    double energy_std = -107.654122447525;
+
+    int norb = fcidump->n_sites();
+    shared_ptr<HamiltonianQC<SU2>> hamil =
+        make_shared<HamiltonianQC<SU2>>(vacuum, norb, orbsym, fcidump);
+
+#ifdef _HAS_MPI
+    shared_ptr<ParallelCommunicator<SU2>> para_comm =
+        make_shared<MPICommunicator<SU2>>();
+#else
+    shared_ptr<ParallelCommunicator<SU2>> para_comm =
+        make_shared<ParallelCommunicator<SU2>>(1, 0, 0);
+#endif
+    shared_ptr<ParallelRuleQC<SU2>> para_rule =
+        make_shared<ParallelRuleQC<SU2>>(para_comm);
+    para_rule->record_costs = true;
+
+    shared_ptr<MPO<SU2>> mpo =
+        make_shared<MPOQC<SU2>>(hamil, QCTypes::Conventional);
+    mpo = make_shared<SimplifiedMPO<SU2>>(mpo, make_shared<RuleQC<SU2>>(),
+                                          true);
+    shared_ptr<MPO<SU2>> para_mpo =
+        make_shared<ParallelMPO<SU2>>(mpo, para_rule);
+
+    ubond_t bond_dim = 200;
+    vector<ubond_t> bdims = {bond_dim};
+    vector<double> noises = {1E-8, 1E-9, 0.0};
+
+    shared_ptr<MPSInfo<SU2>> mps_info =
+        make_shared<MPSInfo<SU2>>(norb, vacuum, target, hamil->basis);
+    mps_info->set_bond_dimension(bond_dim);
+    shared_ptr<MPS<SU2>> mps = make_shared<MPS<SU2>>(norb, 0, 2);
+    mps->initialize(mps_info);
+    mps->random_canonicalize();
+    mps->save_mutable();
+    mps->deallocate();
+    mps_info->save_mutable();
+    mps_info->deallocate_mutable();
+
+    // first sweep with cyclic owners
+    shared_ptr<MovingEnvironment<SU2>> me =
+        make_shared<MovingEnvironment<SU2>>(para_mpo, mps, mps, "DMRG");
+    me->init_environments(false);
+    shared_ptr<DMRG<SU2>> dmrg = make_shared<DMRG<SU2>>(me, bdims, noises);
+    dmrg->iprint = 0;
+    dmrg->solve(1, mps->center == 0, 0.0);
+
+    para_rule->record_costs = false;
+    para_rule->rebalance();
+    EXPECT_TRUE(para_rule->pair_costs.empty());
+    EXPECT_GT(para_rule->pair_owners.size(), 0);
+    EXPECT_LE(para_rule->pair_owners.size(), (size_t)(norb * (norb + 1) / 2));
+    for (int x : para_rule->pair_owners)
+        EXPECT_TRUE(x >= 0 && x < para_comm->size);
+
+    // subsequent sweeps with measured owners
+    para_mpo = make_shared<ParallelMPO<SU2>>(mpo, para_rule);
+    me = make_shared<MovingEnvironment<SU2>>(para_mpo, mps, mps, "DMRG");
+    me->init_environments(false);
+    dmrg = make_shared<DMRG<SU2>>(me, bdims, noises);
+    dmrg->iprint = 0;
+    double energy = dmrg->solve(10, mps->center == 0, 1E-8);
+    cout << "== SU2 REBALANCE == E = " << fixed << setw(22)
+         << setprecision(12) << energy << " error = " << scientific
+         << setprecision(3) << setw(10) << (energy - energy_std) << endl;
+    EXPECT_LT(abs(energy - energy_std), 1E-7);
+
+    mps_info->deallocate();
+    mpo->deallocate();
+    hamil->deallocate();
+    fcidump->deallocate();
+}
+
+TEST_F(TestDMRGN2STO3G, TestSU2Distributed) {
+    shared_ptr<FCIDUMP> fcidump = make_shared<FCIDUMP>();
+    PGTypes pg = PGTypes::D2H;
+    string filename = "data/N2.STO3G.FCIDUMP";
+    fcidump->read(filename);
+    vector<uint8_t> orbsym = fcidump->orb_sym<uint8_t>();
+    transform(orbsym.begin(), orbsym.end(), orbsym.begin(),
+              PointGroup::swap_pg(pg));
+
+    SU2 vacuum(0);
+    SU2 target(fcidump->n_elec(), fcidump->twos(),
+               PointGroup::swap_pg(pg)(fcidump->isym()));
+    double energy_std = -107.654122447525;
+
+#ifdef _HAS_MPI
+    shared_ptr<ParallelCommunicator<SU2>> para_comm =
+        make_shared<MPICommunicator<SU2>>();
+#else
+    shared_ptr<ParallelCommunicator<SU2>> para_comm =
+        make_shared<ParallelCommunicator<SU2>>(1, 0, 0);
+#endif
+    shared_ptr<ParallelRule<SU2>> para_rule =
+        make_shared<ParallelRuleQC<SU2>>(para_comm);
+
+    int norb = fcidump->n_sites();
+    for (SeqTypes seq_type : {SeqTypes::Tasked, SeqTypes::None}) {
+        threading_()->seq_type = seq_type;
+        shared_ptr<HamiltonianQC<SU2>> hamil =
+            make_shared<HamiltonianQC<SU2>>(vacuum, norb, orbsym, fcidump);
+
+        shared_ptr<MPO<SU2>> mpo =
+            make_shared<MPOQC<SU2>>(hamil, QCTypes::Conventional);
+        mpo = make_shared<SimplifiedMPO<SU2>>(mpo, make_shared<RuleQC<SU2>>(),
+                                              true);
+        mpo = make_shared<ParallelMPO<SU2>>(mpo, para_rule);
+
+        ubond_t bond_dim = 200;
+        vector<ubond_t> bdims = {bond_dim};
+        vector<double> noises = {1E-8, 1E-9, 0.0};
+
+        shared_ptr<MPSInfo<SU2>> mps_info =
+            make_shared<MPSInfo<SU2>>(norb, vacuum, target, hamil->basis);
+        mps_info->set_bond_dimension(bond_dim);
+        shared_ptr<MPS<SU2>> mps = make_shared<MPS<SU2>>(norb, 0, 2);
+        mps->initialize(mps_info);
+        mps->random_canonicalize();
+        mps->save_mutable();
+        mps->deallocate();
+        mps_info->save_mutable();
+        mps_info->deallocate_mutable();
+
+        shared_ptr<MovingEnvironment<SU2>> me =
+            make_shared<MovingEnvironment<SU2>>(mpo, mps, mps, "DMRG");
+        me->init_environments(false);
+        shared_ptr<DMRG<SU2>> dmrg = make_shared<DMRG<SU2>>(me, bdims, noises);
+        dmrg->iprint = 0;
+        dmrg->davidson_type = DavidsonTypes::Distributed;
+        double energy = dmrg->solve(10, mps->center == 0, 1E-8);
+        cout << "== SU2 DISTRIBUTED " << (int)seq_type
+             << " == E = " << fixed << setw(22) << setprecision(12) << energy
+             << " error = " << scientific << setprecision(3) << setw(10)
+             << (energy - energy_std) << endl;
+        EXPECT_LT(abs(energy - energy_std), 1E-7);
+
+        mps_info->deallocate();
+        mpo->deallocate();
+        hamil->deallocate();
+    }
+
+    threading_()->seq_type = SeqTypes::Tasked;
+    fcidump->deallocate();
+}
+
+TEST_F(TestDMRGN2STO3G, TestSU2NodeSharedIntegrals) {
+    string filename = "data/N2.STO3G.FCIDUMP";
+    PGTypes pg = PGTypes::D2H;
+
+#ifdef _HAS_MPI
+    shared_ptr<ParallelCommunicator<SU2>> para_comm =
+        make_shared<MPICommunicator<SU2>>();
+#else
+    shared_ptr<ParallelCommunicator<SU2>> para_comm =
+        make_shared<ParallelCommunicator<SU2>>(1, 0, 0);
+#endif
+    shared_ptr<FCIDUMP> fcidump_ref = make_shared<FCIDUMP>();
+    fcidump_ref->read(filename);
+    shared_ptr<FCIDUMP> fcidump = make_shared<FCIDUMP>();
+    fcidump->read_node_shared(filename, para_comm);
+
+    EXPECT_TRUE(fcidump->vdata == nullptr && fcidump->shared_data != nullptr);
+    EXPECT_EQ(fcidump->params, fcidump_ref->params);
+    EXPECT_EQ(fcidump->total_memory, fcidump_ref->total_memory);
+    EXPECT_EQ(fcidump->e(), fcidump_ref->e());
+    int norb = fcidump->n_sites();
+    ASSERT_EQ(norb, fcidump_ref->n_sites());
+    for (uint16_t i = 0; i < norb; i++)
+        for (uint16_t j = 0; j < norb; j++) {
+            EXPECT_EQ(fcidump->t(i, j), fcidump_ref->t(i, j));
+            for (uint16_t k = 0; k < norb; k++)
+                for (uint16_t l = 0; l < norb; l++)
+                    EXPECT_EQ(fcidump->v(i, j, k, l),
+                              fcidump_ref->v(i, j, k, l));
+        }
+    fcidump_ref->deallocate();
+
+    vector<uint8_t> orbsym = fcidump->orb_sym<uint8_t>();
+    transform(orbsym.begin(), orbsym.end(), orbsym.begin(),
+              PointGroup::swap_pg(pg));
+
+    SU2 vacuum(0);
+    SU2 target(fcidump->n_elec(), fcidump->twos(),
+               PointGroup::swap_pg(pg)(fcidump->isym()));
+    double energy_std = -107.654122447525;
+
+    shared_ptr<HamiltonianQC<SU2>> hamil =
+        make_shared<HamiltonianQC<SU2>>(vacuum, norb, orbsym, fcidump);
+    shared_ptr<ParallelRule<SU2>> para_rule =
+        make_shared<ParallelRuleQC<SU2>>(para_comm);
+
+    shared_ptr<MPO<SU2>> mpo =
+        make_shared<MPOQC<SU2>>(hamil, QCTypes::Conventional);
+    mpo = make_shared<SimplifiedMPO<SU2>>(mpo, make_shared<RuleQC<SU2>>(),
+                                          true);
+    mpo = make_shared<ParallelMPO<SU2>>(mpo, para_rule);
+
+    ubond_t bond_dim = 200;
+    vector<ubond_t> bdims = {bond_dim};
+    vector<double> noises = {1E-8, 1E-9, 0.0};
+
+    shared_ptr<MPSInfo<SU2>> mps_info =
+        make_shared<MPSInfo<SU2>>(norb, vacuum, target, hamil->basis);
+    mps_info->set_bond_dimension(bond_dim);
+    shared_ptr<MPS<SU2>> mps = make_shared<MPS<SU2>>(norb, 0, 2);
+    mps->initialize(mps_info);
+    mps->random_canonicalize();
+    mps->save_mutable();
+    mps->deallocate();
+    mps_info->save_mutable();
+    mps_info->deallocate_mutable();
+
+    shared_ptr<MovingEnvironment<SU2>> me =
+        make_shared<MovingEnvironment<SU2>>(mpo, mps, mps, "DMRG");
+    me->init_environments(false);
+    shared_ptr<DMRG<SU2>> dmrg = make_shared<DMRG<SU2>>(me, bdims, noises);
+    dmrg->iprint = 0;
+    double energy = dmrg->solve(10, mps->center == 0, 1E-8);
+    cout << "== SU2 NODE SHARED == E = " << fixed << setw(22)
+         << setprecision(12) << energy << " error = " << scientific
+         << setprecision(3) << setw(10) << (energy - energy_std) << endl;
+    EXPECT_LT(abs(energy - energy_std), 1E-7);
+
+    mps_info->deallocate();
+    mpo->deallocate();
+    hamil->deallocate();
+    fcidump->deallocate();
+}
+
+#ifdef _HAS_MPI
+TEST_F(TestDMRGN2STO3G, TestSU2CompressedComm) {
+    shared_ptr<MPICommunicator<SU2>> mpi_comm =
+        make_shared<MPICommunicator<SU2>>();
+    mpi_comm->compress_min_len = 64;
+    for (double prec : {0.0, 1E-12}) {
+        mpi_comm->codec = make_shared<FPCodec<double>>(prec, 1024);
+        const int n = 10000;
+        vector<double> arr(n), arx(n), ary(n, 0.0);
+        for (int i = 0; i < n; i++)
+            arr[i] = sin(i * 0.37 + 1.0) * exp(-i * 1E-3);
+        arx = arr;
+        // data is not changed outside the owner
+        vector<double> arz = arr;
+        mpi_comm->reduce_sum(arx.data(), n, mpi_comm->root);
+        mpi_comm->broadcast(arx.data(), n, mpi_comm->root);
+        for (int i = 0; i < n; i++)
+            EXPECT_NEAR(arx[i], arr[i] * mpi_comm->size, 1E-10);
+        mpi_comm->reduce_sum(arz.data(), n, (mpi_comm->root + 1) %
+                                                mpi_comm->size);
+        if (mpi_comm->rank != (mpi_comm->root + 1) % mpi_comm->size)
+            EXPECT_EQ(arz, arr);
+    }
+    mpi_comm->codec = make_shared<FPCodec<double>>(0.0, 1024);
+
+    shared_ptr<FCIDUMP> fcidump = make_shared<FCIDUMP>();
+    PGTypes pg = PGTypes::D2H;
+    string filename = "data/N2.STO3G.FCIDUMP";
+    fcidump->read(filename);
+    vector<uint8_t> orbsym = fcidump->orb_sym<uint8_t>();
+    transform(orbsym.begin(), orbsym.end(), orbsym.begin(),
+              PointGroup::swap_pg(pg));
+
+    SU2 vacuum(0);
+    SU2 target(fcidump->n_elec(), fcidump->twos(),
+               PointGroup::swap_pg(pg)(fcidump->isym()));
+    double energy_std = -107.654122447525;
+
+    int norb = fcidump->n_sites();
+    shared_ptr<HamiltonianQC<SU2>> hamil =
+        make_shared<HamiltonianQC<SU2>>(vacuum, norb, orbsym, fcidump);
+    shared_ptr<ParallelRule<SU2>> para_rule =
+        make_shared<ParallelRuleQC<SU2>>(mpi_comm);
+
+    shared_ptr<MPO<SU2>> mpo =
+        make_shared<MPOQC<SU2>>(hamil, QCTypes::Conventional);
+    mpo = make_shared<SimplifiedMPO<SU2>>(mpo, make_shared<RuleQC<SU2>>(),
+                                          true);
+    mpo = make_shared<ParallelMPO<SU2>>(mpo, para_rule);
+
+    ubond_t bond_dim = 200;
+    vector<ubond_t> bdims = {bond_dim};
+    vector<double> noises = {1E-8, 1E-9, 0.0};
+
+    shared_ptr<MPSInfo<SU2>> mps_info =
+        make_shared<MPSInfo<SU2>>(norb, vacuum, target, hamil->basis);
+    mps_info->set_bond_dimension(bond_dim);
+    shared_ptr<MPS<SU2>> mps = make_shared<MPS<SU2>>(norb, 0, 2);
+    mps->initialize(mps_info);
+    mps->random_canonicalize();
+    mps->save_mutable();
+    mps->deallocate();
+    mps_info->save_mutable();
+    mps_info->deallocate_mutable();
+
+    shared_ptr<MovingEnvironment<SU2>> me =
+        make_shared<MovingEnvironment<SU2>>(mpo, mps, mps, "DMRG");
+    me->init_environments(false);
+    shared_ptr<DMRG<SU2>> dmrg = make_shared<DMRG<SU2>>(me, bdims, noises);
+    dmrg->iprint = 0;
+    dmrg->noise_type = NoiseTypes::ReducedPerturbative;
+    double energy = dmrg->solve(10, mps->center == 0, 1E-8);
+    cout << "== SU2 COMPRESSED COMM == E = " << fixed << setw(22)
+         << setprecision(12) << energy << " error = " << scientific
+         << setprecision(3) << setw(10) << (energy - energy_std) << endl;
+    EXPECT_LT(abs(energy - energy_std), 1E-7);
+    // the root compresses in broadcast
+    if (mpi_comm->size > 1 && mpi_comm->rank == mpi_comm->root)
+        EXPECT_GT(mpi_comm->codec->ndata, 0);
+
+    mps_info->deallocate();
+    mpo->deallocate();
+    hamil->deallocate();
+    fcidump->deallocate();
+}
+#endif
+
+#ifdef _HAS_MPI
+TEST_F(TestDMRGN2STO3G, TestSU2CommTrace) {
+    shared_ptr<FCIDUMP> fcidump = make_shared<FCIDUMP>();
+    PGTypes pg = PGTypes::D2H;
+    string filename = "data/N2.STO3G.FCIDUMP";
+    fcidump->read(filename);
+    vector<uint8_t> orbsym = fcidump->orb_sym<uint8_t>();
+    transform(orbsym.begin(), orbsym.end(), orbsym.begin(),
+              PointGroup::swap_pg(pg));
+
+    SU2 vacuum(0);
+    SU2 target(fcidump->n_elec(), fcidump->twos(),
+               PointGroup::swap_pg(pg)(fcidump->isym()));
+
+    int norb = fcidump->n_sites();
+    shared_ptr<HamiltonianQC<SU2>> hamil =
+        make_shared<HamiltonianQC<SU2>>(vacuum, norb, orbsym, fcidump);
+    shared_ptr<MPICommunicator<SU2>> mpi_comm =
+        make_shared<MPICommunicator<SU2>>();
+    shared_ptr<ParallelRule<SU2>> para_rule =
+        make_shared<ParallelRuleQC<SU2>>(mpi_comm);
+
+    shared_ptr<MPO<SU2>> mpo =
+        make_shared<MPOQC<SU2>>(hamil, QCTypes::Conventional);
+    mpo = make_shared<SimplifiedMPO<SU2>>(mpo, make_shared<RuleQC<SU2>>(),
+                                          true);
+    mpo = make_shared<ParallelMPO<SU2>>(mpo, para_rule);
+
+    ubond_t bond_dim = 200;
+    vector<ubond_t> bdims = {bond_dim};
+    vector<double> noises = {1E-8, 1E-9, 0.0};
+
+    shared_ptr<MPSInfo<SU2>> mps_info =
+        make_shared<MPSInfo<SU2>>(norb, vacuum, target, hamil->basis);
+    mps_info->set_bond_dimension(bond_dim);
+    shared_ptr<MPS<SU2>> mps = make_shared<MPS<SU2>>(norb, 0, 2);
+    mps->initialize(mps_info);
+    mps->random_canonicalize();
+    mps->save_mutable();
+    mps->deallocate();
+    mps_info->save_mutable();
+    mps_info->deallocate_mutable();
+
+    shared_ptr<MovingEnvironment<SU2>> me =
+        make_shared<MovingEnvironment<SU2>>(mpo, mps, mps, "DMRG");
+    me->init_environments(false);
+    shared_ptr<DMRG<SU2>> dmrg = make_shared<DMRG<SU2>>(me, bdims, noises);
+    dmrg->iprint = 0;
+    mpi_comm->start_trace();
+    dmrg->solve(2, mps->center == 0, 0.0);
+    vector<MPICommunicator<SU2>::TraceEvent> events = mpi_comm->trace_events;
+    string trace_file = frame_()->save_dir + "/comm-trace.json";
+    mpi_comm->write_trace(trace_file);
+
+    EXPECT_FALSE(mpi_comm->trace);
+    ASSERT_GT(events.size(), 0);
+    int n_site_events = 0;
+    for (auto &ev : events) {
+        EXPECT_LE(ev.t_start, ev.t_end);
+        EXPECT_LT(ev.sweep, 2);
+        EXPECT_LT(ev.site, norb);
+        n_site_events += ev.site >= 0 && ev.sweep >= 0;
+    }
+    EXPECT_GT(n_site_events, 0);
+    if (mpi_comm->rank == mpi_comm->root) {
+        ifstream ifs(trace_file.c_str());
+        ASSERT_TRUE(ifs.good());
+        string str((istreambuf_iterator<char>(ifs)),
+                   istreambuf_iterator<char>());
+        EXPECT_EQ(str.substr(0, 16), "{\"traceEvents\":[");
+        EXPECT_EQ(str.substr(str.length() - 4), "\n]}\n");
+        for (int i = 0; i < mpi_comm->size; i++)
+            EXPECT_NE(str.find("\"name\":\"rank " + Parsing::to_string(i)),
+                      string::npos);
+        EXPECT_NE(str.find("\"name\":\"allreduce_sum\""), string::npos);
+    }
+
+    mps_info->deallocate();
+    mpo->deallocate();
+    hamil->deallocate();
+    fcidump->deallocate();
+}
+#endif
+
+#ifdef _HAS_MPI
+TEST_F(TestDMRGN2STO3G, TestSU2HierarchicalComm) {
+    shared_ptr<MPICommunicator<SU2>> mpi_comm =
+        make_shared<MPICommunicator<SU2>>();
+    mpi_comm->hierarchical = true;
+    mpi_comm->hierarchical_min_len = 64;
+    mpi_comm->ranks_per_node = 2;
+    const int n = 10000;
+    vector<double> arr(n), arx(n);
+    for (int i = 0; i < n; i++)
+        arr[i] = sin(i * 0.37 + 1.0) * (mpi_comm->rank + 1);
+    const double fac = mpi_comm->size * (mpi_comm->size + 1) / 2.0;
+    arx = arr;
+    mpi_comm->allreduce_sum(arx.data(), n);
+    for (int i = 0; i < n; i++)
+        EXPECT_NEAR(arx[i], arr[i] / (mpi_comm->rank + 1) * fac, 1E-10);
+    // data is not changed outside the owner
+    for (int owner = 0; owner < mpi_comm->size; owner++) {
+        arx = arr;
+        mpi_comm->reduce_sum(arx.data(), n, owner);
+        if (mpi_comm->rank == owner)
+            for (int i = 0; i < n; i++)
+                EXPECT_NEAR(arx[i], arr[i] / (mpi_comm->rank + 1) * fac,
+                            1E-10);
+        else
+            EXPECT_EQ(arx, arr);
+    }
+
+    shared_ptr<FCIDUMP> fcidump = make_shared<FCIDUMP>();
+    PGTypes pg = PGTypes::D2H;
+    string filename = "data/N2.STO3G.FCIDUMP";
+    fcidump->read(filename);
+    vector<uint8_t> orbsym = fcidump->orb_sym<uint8_t>();
+    transform(orbsym.begin(), orbsym.end(), orbsym.begin(),
+              PointGroup::swap_pg(pg));
+
+    SU2 vacuum(0);
+    SU2 target(fcidump->n_elec(), fcidump->twos(),
+               PointGroup::swap_pg(pg)(fcidump->isym()));
+    double energy_std = -107.654122447525;
+
+    int norb = fcidump->n_sites();
+    shared_ptr<HamiltonianQC<SU2>> hamil =
+        make_shared<HamiltonianQC<SU2>>(vacuum, norb, orbsym, fcidump);
+    shared_ptr<ParallelRule<SU2>> para_rule =
+        make_shared<ParallelRuleQC<SU2>>(mpi_comm);
+
+    shared_ptr<MPO<SU2>> mpo =
+        make_shared<MPOQC<SU2>>(hamil, QCTypes::Conventional);
+    mpo = make_shared<SimplifiedMPO<SU2>>(mpo, make_shared<RuleQC<SU2>>(),
+                                          true);
+    mpo = make_shared<ParallelMPO<SU2>>(mpo, para_rule);
+
+    ubond_t bond_dim = 200;
+    vector<ubond_t> bdims = {bond_dim};
+    vector<double> noises = {1E-8, 1E-9, 0.0};
+
+    shared_ptr<MPSInfo<SU2>> mps_info =
+        make_shared<MPSInfo<SU2>>(norb, vacuum, target, hamil->basis);
+    mps_info->set_bond_dimension(bond_dim);
+    shared_ptr<MPS<SU2>> mps = make_shared<MPS<SU2>>(norb, 0, 2);
+    mps->initialize(mps_info);
+    mps->random_canonicalize();
+    mps->save_mutable();
+    mps->deallocate();
+    mps_info->save_mutable();
+    mps_info->deallocate_mutable();
+
+    shared_ptr<MovingEnvironment<SU2>> me =
+        make_shared<MovingEnvironment<SU2>>(mpo, mps, mps, "DMRG");
+    me->init_environments(false);
+    shared_ptr<DMRG<SU2>> dmrg = make_shared<DMRG<SU2>>(me, bdims, noises);
+    dmrg->iprint = 0;
+    dmrg->noise_type = NoiseTypes::ReducedPerturbative;
+    double energy = dmrg->solve(10, mps->center == 0, 1E-8);
+    cout << "== SU2 HIERARCHICAL COMM == E = " << fixed << setw(22)
+         << setprecision(12) << energy << " error = " << scientific
+         << setprecision(3) << setw(10) << (energy - energy_std) << endl;
+    EXPECT_LT(abs(energy - energy_std), 1E-7);
+
+    mps_info->deallocate();
+    mpo->deallocate();
+    hamil->deallocate();
+    fcidump->deallocate();
+}
+
+TEST_F(TestDMRGN2STO3G, TestReproducibleComm) {
+    shared_ptr<MPICommunicator<SU2>> mpi_comm =
+        make_shared<MPICommunicator<SU2>>();
+    mpi_comm->reproducible = true;
+    const int n = 10007;
+    vector<double> arr(n), arx(n), ars(n);
+    for (int i = 0; i < n; i++) {
+        arr[i] = sin(i * 0.37 + 1.0) * (mpi_comm->rank + 1);
+        // sum in the rank order
+        ars[i] = sin(i * 0.37 + 1.0);
+        for (int r = 1; r < mpi_comm->size; r++)
+            ars[i] += sin(i * 0.37 + 1.0) * (r + 1);
+    }
+    arx = arr;
+    mpi_comm->allreduce_sum(arx.data(), n);
+    EXPECT_EQ(arx, ars);
+    // data is not changed outside the owner
+    for (int owner = 0; owner < mpi_comm->size; owner++) {
+        arx = arr;
+        mpi_comm->reduce_sum(arx.data(), n, owner);
+        if (mpi_comm->rank == owner)
+            EXPECT_EQ(arx, ars);
+        else
+            EXPECT_EQ(arx, arr);
+    }
+}
+
+static int n_distributed_restart_test_sites = 0;
+
+TEST_F(TestDMRGN2STO3G, TestSU2DistributedRestart) {
+    shared_ptr<FCIDUMP> fcidump = make_shared<FCIDUMP>();
+    PGTypes pg = PGTypes::D2H;
+    string filename = "data/N2.STO3G.FCIDUMP";
+    fcidump->read(filename);
+    vector<uint8_t> orbsym = fcidump->orb_sym<uint8_t>();
+    transform(orbsym.begin(), orbsym.end(), orbsym.begin(),
+              PointGroup::swap_pg(pg));
+
+    SU2 vacuum(0);
+    SU2 target(fcidump->n_elec(), fcidump->twos(),
+               PointGroup::swap_pg(pg)(fcidump->isym()));
+    double energy_std = -107.654122447525;
+
+    int norb = fcidump->n_sites();
+    shared_ptr<HamiltonianQC<SU2>> hamil =
+        make_shared<HamiltonianQC<SU2>>(vacuum, norb, orbsym, fcidump);
+    shared_ptr<MPICommunicator<SU2>> mpi_comm =
+        make_shared<MPICommunicator<SU2>>();
+    shared_ptr<ParallelRule<SU2>> para_rule =
+        make_shared<ParallelRuleQC<SU2>>(mpi_comm);
+
+    shared_ptr<MPO<SU2>> mpo =
+        make_shared<MPOQC<SU2>>(hamil, QCTypes::Conventional);
+    mpo = make_shared<SimplifiedMPO<SU2>>(mpo, make_shared<RuleQC<SU2>>(),
+                                          true);
+    shared_ptr<MPO<SU2>> para_mpo =
+        make_shared<ParallelMPO<SU2>>(mpo, para_rule);
+
+    ubond_t bond_dim = 200;
+    vector<ubond_t> bdims = {bond_dim};
+    vector<double> noises = {1E-8, 1E-9, 0.0};
+    string restart_dir = frame_()->save_dir + "/dist-restart";
+    frame_()->restart_dir_site = restart_dir;
+    frame_()->restart_site_interval = 2;
+    frame_()->restart_site_distributed = true;
+
+    shared_ptr<MPSInfo<SU2>> mps_info =
+        make_shared<MPSInfo<SU2>>(norb, vacuum, target, hamil->basis);
+    mps_info->set_bond_dimension(bond_dim);
+    shared_ptr<MPS<SU2>> mps = make_shared<MPS<SU2>>(norb, 0, 2);
+    mps->initialize(mps_info);
+    mps->random_canonicalize();
+    mps->save_mutable();
+    mps->deallocate();
+    mps_info->save_mutable();
+    mps_info->deallocate_mutable();
+
+    shared_ptr<MovingEnvironment<SU2>> me =
+        make_shared<MovingEnvironment<SU2>>(para_mpo, mps, mps, "DMRG");
+    me->init_environments(false);
+
+    // interrupt the second sweep in the middle
+    shared_ptr<DMRG<SU2>> dmrg = make_shared<DMRG<SU2>>(me, bdims, noises);
+    dmrg->iprint = 0;
+    n_distributed_restart_test_sites = 0;
+    check_signal_() = []() {
+        if (++n_distributed_restart_test_sites == 14)
+            throw runtime_error("interrupted");
+    };
+    EXPECT_THROW(dmrg->solve(10, true, 1E-8), runtime_error);
+    check_signal_() = []() {};
+    frame_()->wait_save_files();
+    frame_()->restart_dir_site = "";
+    mps_info->deallocate();
+    mpi_comm->barrier();
+
+    // resume from the last checkpoint with the given parallel mpo
+    auto resume = [&](const shared_ptr<MPO<SU2>> &xmpo,
+                      const shared_ptr<ParallelCommunicator<SU2>> &comm) {
+        mps_info = make_shared<MPSInfo<SU2>>(norb, vacuum, target,
+                                             hamil->basis);
+        mps = make_shared<MPS<SU2>>(mps_info);
+        string mps_dir = frame_()->mps_dir;
+        frame_()->mps_dir = restart_dir;
+        mps->load_data();
+        mps->load_mutable();
+        mps_info->load_mutable();
+        frame_()->mps_dir = mps_dir;
+        mps->save_mutable();
+        mps->deallocate();
+        mps_info->save_mutable();
+        mps_info->deallocate_mutable();
+        comm->barrier();
+
+        me = make_shared<MovingEnvironment<SU2>>(xmpo, mps, mps, "DMRG");
+        me->load_distributed_environments(restart_dir);
+        dmrg = make_shared<DMRG<SU2>>(me, bdims, noises);
+        dmrg->iprint = 0;
+        EXPECT_TRUE(dmrg->load_site_restart(restart_dir));
+        EXPECT_EQ(dmrg->restart_sweep, 1);
+        double energy = dmrg->solve(10, true, 1E-8);
+        mps_info->deallocate();
+        return energy;
+    };
+
+    // the same number of procs
+    double energy = resume(para_mpo, mpi_comm);
+    cout << "== SU2 DIST RESTART (" << mpi_comm->size << " -> "
+         << mpi_comm->size << ") == E = " << fixed << setw(22)
+         << setprecision(12) << energy << " error = " << scientific
+         << setprecision(3) << setw(10) << (energy - energy_std) << endl;
+    EXPECT_LT(abs(energy - energy_std), 1E-7);
+    mpi_comm->barrier();
+
+    // a single proc
+    if (mpi_comm->rank == mpi_comm->root) {
+        shared_ptr<ParallelCommunicator<SU2>> serial_comm =
+            make_shared<ParallelCommunicator<SU2>>(1, 0, 0);
+        shared_ptr<MPO<SU2>> serial_mpo = make_shared<ParallelMPO<SU2>>(
+            mpo, make_shared<ParallelRuleQC<SU2>>(serial_comm));
+        energy = resume(serial_mpo, serial_comm);
+        cout << "== SU2 DIST RESTART (" << mpi_comm->size
+             << " -> 1) == E = " << fixed << setw(22) << setprecision(12)
+             << energy << " error = " << scientific << setprecision(3)
+             << setw(10) << (energy - energy_std) << endl;
+        EXPECT_LT(abs(energy - energy_std), 1E-7);
+    }
+    mpi_comm->barrier();
+    frame_()->restart_site_distributed = false;
+
+    para_mpo->deallocate();
+    hamil->deallocate();
+    fcidump->deallocate();
+}
+#endif
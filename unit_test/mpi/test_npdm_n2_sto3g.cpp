@@ -540,6 +540,9 @@ TEST_F(TestNPDM, TestSU2) {
         make_shared<ParallelRulePDM1QC<SU2>>(para_comm);
     shared_ptr<ParallelRule<SU2>> pdm2_para_rule =
         make_shared<ParallelRulePDM2QC<SU2>>(para_comm);
+    // NPDM elements are distributed dynamically (the SZ test is static)
+    pdm1_para_rule->dynamic_tasks = true;
+    pdm2_para_rule->dynamic_tasks = true;
 
     // FCI results
     vector<tuple<int, int, double>> one_pdm = {
@@ -0,0 +1,97 @@
+
+#pragma once
+
+#include "block2_core.hpp"
+#include <cstdlib>
+#include <gtest/gtest.h>
+#include <map>
+
+using namespace block2;
+
+// Optional performance regression gate for timed variants of unit tests
+// Enabled by the environment variable BLOCK2_PERF_BASELINE, the baseline
+// file with one "name time gflop" line per timed test. If BLOCK2_PERF_UPDATE
+// is set, the measured values are written into the baseline file. Otherwise
+// a timed test fails when it is slower than its baseline by more than the
+// fraction BLOCK2_PERF_TOLERANCE (default 0.25). The FLOP count is taken from
+// kernel_counters_ during the runs. Timed tests are skipped (and pass) when
+// the gate is not enabled
+struct PerfGate {
+    string filename;
+    bool update = false;
+    double tolerance = 0.25;
+    // name -> (time, GFLOP)
+    map<string, pair<double, double>> baseline;
+    PerfGate() {
+        const char *fn = getenv("BLOCK2_PERF_BASELINE");
+        const char *upd = getenv("BLOCK2_PERF_UPDATE");
+        const char *tol = getenv("BLOCK2_PERF_TOLERANCE");
+        filename = fn == nullptr ? "" : fn;
+        update = upd != nullptr && string(upd) != "0";
+        if (tol != nullptr)
+            tolerance = Parsing::to_double(tol);
+        if (filename != "" && Parsing::file_exists(filename))
+            load();
+    }
+    static PerfGate &instance() {
+        static PerfGate gate;
+        return gate;
+    }
+    bool enabled() const { return filename != ""; }
+    void load() {
+        ifstream ifs(filename.c_str());
+        string name;
+        double t, gflop;
+        while (ifs >> name >> t >> gflop)
+            baseline[name] = make_pair(t, gflop);
+    }
+    void save() const {
+        ofstream ofs(filename.c_str());
+        if (!ofs.good())
+            throw runtime_error("PerfGate::save on '" + filename + "' failed.");
+        ofs << scientific << setprecision(6);
+        for (auto &b : baseline)
+            ofs << b.first << " " << b.second.first << " " << b.second.second
+                << endl;
+    }
+    // run f n_repeats times and compare the best time with the baseline
+    template <typename F> void run(const string &name, F f, int n_repeats = 3) {
+        KernelCounters &kc = kernel_counters_();
+        const bool kc_enabled = kc.enabled;
+        double t_best = 0, gflop = 0;
+        Timer t;
+        for (int i = 0; i < n_repeats; i++) {
+            kc.reset(), kc.enabled = true;
+            t.get_time();
+            f();
+            const double tx = t.get_time();
+            kc.enabled = false;
+            if (i == 0 || tx < t_best)
+                t_best = tx, gflop = kc.total_flop() * 1E-9;
+        }
+        kc.reset(), kc.enabled = kc_enabled;
+        check(name, t_best, gflop);
+    }
+    void check(const string &name, double t, double gflop) {
+        cout << "PERF " << name << " T = " << fixed << setprecision(4) << t
+             << " GFLOP = " << gflop
+             << " GFLOP/s = " << (t == 0 ? 0 : gflop / t);
+        auto it = baseline.find(name);
+        if (it != baseline.end())
+            cout << " (baseline T = " << it->second.first << " GFLOP/s = "
+                 << (it->second.first == 0 ? 0
+                                           : it->second.second /
+                                                 it->second.first)
+                 << ")";
+        cout << endl;
+        if (update) {
+            baseline[name] = make_pair(t, gflop);
+            save();
+        } else if (it != baseline.end())
+            EXPECT_LE(t, it->second.first * (1 + tolerance))
+                << name << " is slower than the baseline in " << filename;
+        else
+            cout << "PERF " << name << " has no baseline in " << filename
+                 << endl;
+    }
+};
@@ -1,5 +1,6 @@
 
 #include "block2_core.hpp"
+#include "perf_gate.hpp"
 #include <gtest/gtest.h>
 
 using namespace block2;
@@ -141,3 +142,446 @@ TEST_F(TestBatchGEMM, TestTensorProduct) {
         dalloc_()->deallocate(a.data, ma * na * nbatch);
     }
 }
+
+TEST_F(TestBatchGEMM, TestPreparedReplay) {
+    shared_ptr<BatchGEMMSeq> seq = make_shared<BatchGEMMSeq>(1 << 24);
+    seq->mode = SeqTypes::Auto;
+    for (int i = 0; i < n_tests / 10; i++) {
+        int ma = Random::rand_int(1, 50), na = Random::rand_int(1, 50);
+        int mc = Random::rand_int(1, 50), nc = Random::rand_int(1, 50);
+        int nbatch = Random::rand_int(1, 20), ncbatch = Random::rand_int(1, 5);
+        MatrixRef l(dalloc_()->allocate(ma * mc), mc, ma);
+        MatrixRef r(dalloc_()->allocate(na * nc), na, nc);
+        Random::fill_rand_double(l.data, l.size());
+        Random::fill_rand_double(r.data, r.size());
+        // record with input and output vectors based at null
+        for (int ii = 0; ii < nbatch; ii++)
+            seq->rotate(MatrixRef((double *)0 + ma * na * ii, ma, na),
+                        MatrixRef((double *)0 + mc * nc * (ii % ncbatch), mc,
+                                  nc),
+                        l, false, r, false, 1.0);
+        seq->prepare();
+        seq->allocate();
+        for (int it = 0; it < 4; it++) {
+            MatrixRef a(dalloc_()->allocate(ma * na * nbatch), ma * nbatch,
+                        na);
+            MatrixRef c(dalloc_()->allocate(mc * nc * ncbatch), mc * ncbatch,
+                        nc);
+            MatrixRef cstd(dalloc_()->allocate(mc * nc), mc, nc);
+            Random::fill_rand_double(a.data, a.size());
+            c.clear();
+            (*seq)(a, c);
+            for (int ic = 0; ic < ncbatch; ic++) {
+                cstd.clear();
+                for (int ii = ic; ii < nbatch; ii += ncbatch)
+                    MatrixFunctions::rotate(
+                        MatrixRef(a.data + ma * na * ii, ma, na), cstd, l,
+                        false, r, false, 1.0);
+                ASSERT_TRUE(MatrixFunctions::all_close(
+                    MatrixRef(c.data + mc * nc * ic, mc, nc), cstd, 1E-10,
+                    0.0));
+            }
+            cstd.deallocate();
+            dalloc_()->deallocate(c.data, mc * nc * ncbatch);
+            dalloc_()->deallocate(a.data, ma * na * nbatch);
+        }
+        seq->deallocate();
+        seq->clear();
+        r.deallocate();
+        l.deallocate();
+    }
+}
+
+static int n_external_batches = 0;
+
+static void counted_dgemm_batch(
+    const CBLAS_LAYOUT Layout, const CBLAS_TRANSPOSE *TransA_Array,
+    const CBLAS_TRANSPOSE *TransB_Array, const MKL_INT *M_Array,
+    const MKL_INT *N_Array, const MKL_INT *K_Array, const double *alpha_Array,
+    const double **A_Array, const MKL_INT *lda_Array, const double **B_Array,
+    const MKL_INT *ldb_Array, const double *beta_Array, double **C_Array,
+    const MKL_INT *ldc_Array, const MKL_INT group_count,
+    const MKL_INT *group_size) {
+    n_external_batches++;
+    cblas_dgemm_batch(Layout, TransA_Array, TransB_Array, M_Array, N_Array,
+                      K_Array, alpha_Array, A_Array, lda_Array, B_Array,
+                      ldb_Array, beta_Array, C_Array, ldc_Array, group_count,
+                      group_size);
+}
+
+TEST_F(TestBatchGEMM, TestExternalBackend) {
+    shared_ptr<BatchGEMMSeq> seq = make_shared<BatchGEMMSeq>(1 << 24);
+    seq->mode = SeqTypes::Simple;
+    threading_()->gemm_backend = GEMMBackendTypes::External;
+    dgemm_batch_backend_() = nullptr;
+    int ma = 20, na = 30, mc = 40, nc = 50;
+    MatrixRef a(dalloc_()->allocate(ma * na), ma, na);
+    MatrixRef c(dalloc_()->allocate(mc * nc), mc, nc);
+    MatrixRef l(dalloc_()->allocate(ma * mc), mc, ma);
+    MatrixRef r(dalloc_()->allocate(na * nc), na, nc);
+    MatrixRef cstd(dalloc_()->allocate(mc * nc), mc, nc);
+    Random::fill_rand_double(l.data, l.size());
+    Random::fill_rand_double(r.data, r.size());
+    Random::fill_rand_double(a.data, a.size());
+    c.clear(), cstd.clear();
+    seq->rotate(a, c, l, false, r, false, 0.5);
+    EXPECT_THROW(seq->simple_perform(), runtime_error);
+    seq->clear();
+    dgemm_batch_backend_() = &counted_dgemm_batch;
+    seq->rotate(a, c, l, false, r, false, 0.5);
+    seq->simple_perform();
+    EXPECT_GT(n_external_batches, 0);
+    MatrixFunctions::rotate(a, cstd, l, false, r, false, 0.5);
+    ASSERT_TRUE(MatrixFunctions::all_close(c, cstd, 1E-10, 0.0));
+    threading_()->gemm_backend = GEMMBackendTypes::Host;
+    dgemm_batch_backend_() = nullptr;
+    cstd.deallocate();
+    r.deallocate();
+    l.deallocate();
+    c.deallocate();
+    a.deallocate();
+}
+
+TEST_F(TestBatchGEMM, TestSmallGEMM) {
+    threading_()->small_gemm_size = 16;
+    for (int i = 0; i < n_tests; i++) {
+        MKL_INT m = Random::rand_int(1, 20), n = Random::rand_int(1, 20);
+        MKL_INT k = Random::rand_int(1, 20);
+        bool conja = Random::rand_int(0, 2), conjb = Random::rand_int(0, 2);
+        double alpha = Random::rand_double(-2, 2);
+        double beta = Random::rand_int(0, 2) ? Random::rand_double(-2, 2) : 0;
+        MatrixRef a(dalloc_()->allocate(m * k), conja ? k : m, conja ? m : k);
+        MatrixRef b(dalloc_()->allocate(k * n), conjb ? n : k, conjb ? k : n);
+        MatrixRef c(dalloc_()->allocate(m * n), m, n);
+        MatrixRef cstd(dalloc_()->allocate(m * n), m, n);
+        Random::fill_rand_double(a.data, a.size());
+        Random::fill_rand_double(b.data, b.size());
+        Random::fill_rand_double(c.data, c.size());
+        copy(c.data, c.data + c.size(), cstd.data);
+        small_dgemm(conja, conjb, m, n, k, alpha, a.data, a.n, b.data, b.n,
+                    beta, c.data, c.n);
+        MatrixFunctions::multiply(a, conja, b, conjb, cstd, alpha, beta);
+        ASSERT_TRUE(MatrixFunctions::all_close(c, cstd, 1E-10, 0.0));
+        // mixed small and large groups in one batch
+        BatchGEMM batch;
+        MatrixRef x(dalloc_()->allocate(m * 40), m, 40);
+        MatrixRef y(dalloc_()->allocate(40 * n), 40, n);
+        MatrixRef z(dalloc_()->allocate(m * n), m, n);
+        MatrixRef zstd(dalloc_()->allocate(m * n), m, n);
+        Random::fill_rand_double(x.data, x.size());
+        Random::fill_rand_double(y.data, y.size());
+        c.clear(), cstd.clear(), z.clear(), zstd.clear();
+        batch.multiply(a, conja, b, conjb, c, alpha, 0.0);
+        batch.multiply(x, false, y, false, z, alpha, 0.0);
+        batch.multiply(b, !conjb, a, !conja, cstd.flip_dims(), alpha, 0.0);
+        batch.perform();
+        MatrixFunctions::multiply(x, false, y, false, zstd, alpha, 0.0);
+        ASSERT_TRUE(MatrixFunctions::all_close(z, zstd, 1E-10, 0.0));
+        for (MKL_INT ic = 0; ic < m; ic++)
+            for (MKL_INT jc = 0; jc < n; jc++)
+                ASSERT_LT(abs(c(ic, jc) - cstd.data[jc * m + ic]), 1E-10);
+        zstd.deallocate();
+        z.deallocate();
+        y.deallocate();
+        x.deallocate();
+        cstd.deallocate();
+        c.deallocate();
+        b.deallocate();
+        a.deallocate();
+    }
+    threading_()->small_gemm_size = 0;
+}
+
+TEST_F(TestBatchGEMM, TestSinglePrecision) {
+    shared_ptr<BatchGEMMSeq> seq = make_shared<BatchGEMMSeq>(1 << 24);
+    seq->mode = SeqTypes::Auto;
+    for (int i = 0; i < n_tests / 10; i++) {
+        int ma = Random::rand_int(1, 50), na = Random::rand_int(1, 50);
+        int mc = Random::rand_int(1, 50), nc = Random::rand_int(1, 50);
+        int nbatch = Random::rand_int(1, 20), ncbatch = Random::rand_int(1, 5);
+        MatrixRef l(dalloc_()->allocate(ma * mc), mc, ma);
+        MatrixRef r(dalloc_()->allocate(na * nc), na, nc);
+        Random::fill_rand_double(l.data, l.size());
+        Random::fill_rand_double(r.data, r.size());
+        for (int ii = 0; ii < nbatch; ii++)
+            seq->rotate(MatrixRef((double *)0 + ma * na * ii, ma, na),
+                        MatrixRef((double *)0 + mc * nc * (ii % ncbatch), mc,
+                                  nc),
+                        l, false, r, false, 1.0);
+        seq->prepare();
+        seq->allocate();
+        MatrixRef a(dalloc_()->allocate(ma * na * nbatch), ma * nbatch, na);
+        MatrixRef c(dalloc_()->allocate(mc * nc * ncbatch), mc * ncbatch, nc);
+        MatrixRef cstd(dalloc_()->allocate(mc * nc * ncbatch), mc * ncbatch,
+                       nc);
+        for (int it = 0; it < 3; it++) {
+            Random::fill_rand_double(a.data, a.size());
+            c.clear(), cstd.clear();
+            seq->single_prec = false;
+            (*seq)(a, cstd);
+            seq->single_prec = true;
+            (*seq)(a, c);
+            ASSERT_TRUE(MatrixFunctions::all_close(c, cstd, 1E-3, 1E-5));
+        }
+        seq->single_prec = false;
+        cstd.deallocate();
+        c.deallocate();
+        a.deallocate();
+        seq->deallocate();
+        seq->clear();
+        r.deallocate();
+        l.deallocate();
+    }
+}
+
+TEST_F(TestBatchGEMM, TestWorkStealing) {
+    const int ntg = 4;
+    for (int i = 0; i < n_tests; i++) {
+        size_t n = Random::rand_int(0, 1000);
+        vector<size_t> costs(n);
+        for (size_t j = 0; j < n; j++)
+            costs[j] = Random::rand_int(0, 2) ? Random::rand_int(1, 10)
+                                              : Random::rand_int(1, 10000);
+        WorkStealingSchedule sched(costs, ntg);
+        vector<int> counts(n, 0);
+#pragma omp parallel num_threads(ntg)
+        {
+#ifdef _OPENMP
+            int tid = omp_get_thread_num();
+#else
+            int tid = 0;
+#endif
+            for (size_t j = 0; sched.next(tid, j);)
+#pragma omp atomic
+                counts[j]++;
+        }
+        for (size_t j = 0; j < n; j++)
+            ASSERT_EQ(counts[j], 1);
+    }
+}
+
+TEST_F(TestBatchGEMM, TestTasked) {
+    shared_ptr<BatchGEMMSeq> seq = make_shared<BatchGEMMSeq>(0);
+    seq->mode = SeqTypes::Tasked;
+    threading_()->n_threads_op = 4;
+    for (int i = 0; i < n_tests / 10; i++) {
+        int ma = Random::rand_int(1, 50), na = Random::rand_int(1, 50);
+        int mc = Random::rand_int(1, 50), nc = Random::rand_int(1, 50);
+        int nbatch = Random::rand_int(1, 20), ncbatch = Random::rand_int(1, 5);
+        MatrixRef l(dalloc_()->allocate(ma * mc), mc, ma);
+        MatrixRef r(dalloc_()->allocate(na * nc), na, nc);
+        Random::fill_rand_double(l.data, l.size());
+        Random::fill_rand_double(r.data, r.size());
+        for (int ii = 0; ii < nbatch; ii++)
+            seq->rotate(MatrixRef((double *)0 + ma * na * ii, ma, na),
+                        MatrixRef((double *)0 + mc * nc * (ii % ncbatch), mc,
+                                  nc),
+                        l, false, r, false, 1.0);
+        MatrixRef a(dalloc_()->allocate(ma * na * nbatch), ma * nbatch, na);
+        MatrixRef c(dalloc_()->allocate(mc * nc * ncbatch), mc * ncbatch, nc);
+        MatrixRef cstd(dalloc_()->allocate(mc * nc), mc, nc);
+        Random::fill_rand_double(a.data, a.size());
+        c.clear();
+        (*seq)(a, c);
+        for (int ic = 0; ic < ncbatch; ic++) {
+            cstd.clear();
+            for (int ii = ic; ii < nbatch; ii += ncbatch)
+                MatrixFunctions::rotate(MatrixRef(a.data + ma * na * ii, ma, na),
+                                        cstd, l, false, r, false, 1.0);
+            ASSERT_TRUE(MatrixFunctions::all_close(
+                MatrixRef(c.data + mc * nc * ic, mc, nc), cstd, 1E-10, 0.0));
+        }
+        cstd.deallocate();
+        c.deallocate();
+        a.deallocate();
+        seq->clear();
+        r.deallocate();
+        l.deallocate();
+    }
+    threading_()->n_threads_op = 1;
+}
+
+TEST_F(TestBatchGEMM, TestTaskedDeterministic) {
+    threading_()->deterministic_slots = 4;
+    for (int i = 0; i < n_tests / 10; i++) {
+        shared_ptr<BatchGEMMSeq> seq =
+            make_shared<BatchGEMMSeq>(0, SeqTypes::Tasked);
+        int ma = Random::rand_int(1, 50), na = Random::rand_int(1, 50);
+        int mc = Random::rand_int(1, 50), nc = Random::rand_int(1, 50);
+        int nbatch = Random::rand_int(1, 40), ncbatch = Random::rand_int(1, 5);
+        MatrixRef l(dalloc_()->allocate(ma * mc), mc, ma);
+        MatrixRef r(dalloc_()->allocate(na * nc), na, nc);
+        Random::fill_rand_double(l.data, l.size());
+        Random::fill_rand_double(r.data, r.size());
+        for (int ii = 0; ii < nbatch; ii++)
+            seq->rotate(MatrixRef((double *)0 + ma * na * ii, ma, na),
+                        MatrixRef((double *)0 + mc * nc * (ii % ncbatch), mc,
+                                  nc),
+                        l, false, r, false, 1.0);
+        const int csz = mc * nc * ncbatch;
+        MatrixRef a(dalloc_()->allocate(ma * na * nbatch), ma * nbatch, na);
+        MatrixRef c(dalloc_()->allocate(csz * 3), csz * 3, 1);
+        Random::fill_rand_double(a.data, a.size());
+        c.clear();
+        // results are bitwise identical for any number of threads
+        for (int it = 0; it < 3; it++) {
+            threading_()->n_threads_op = it * 2 + 1;
+            (*seq)(a, MatrixRef(c.data + csz * it, csz, 1));
+        }
+        for (int it = 1; it < 3; it++)
+            ASSERT_EQ(memcmp(c.data, c.data + csz * it, sizeof(double) * csz),
+                      0);
+        c.deallocate();
+        a.deallocate();
+        seq->clear();
+        r.deallocate();
+        l.deallocate();
+    }
+    threading_()->n_threads_op = 1;
+    threading_()->deterministic_slots = 0;
+}
+
+TEST_F(TestBatchGEMM, TestChunkedReduce) {
+    for (int i = 0; i < n_tests; i++) {
+        int nx = Random::rand_int(1, 10), ntg = Random::rand_int(1, 5);
+        size_t n = Random::rand_int(0, 2000);
+        size_t chunk = Random::rand_int(1, 300);
+        MatrixRef x(dalloc_()->allocate(n * nx), (MKL_INT)n * nx, 1);
+        MatrixRef xstd(dalloc_()->allocate(n), (MKL_INT)n, 1);
+        Random::fill_rand_double(x.data, x.size());
+        xstd.clear();
+        vector<double *> xs(nx);
+        for (int ix = 0; ix < nx; ix++) {
+            xs[ix] = x.data + n * ix;
+            MatrixFunctions::iadd(xstd, MatrixRef(xs[ix], (MKL_INT)n, 1), 1.0);
+        }
+#pragma omp parallel num_threads(ntg)
+        MatrixFunctions::chunked_reduce(xs, n, chunk);
+        ASSERT_TRUE(MatrixFunctions::all_close(MatrixRef(x.data, (MKL_INT)n, 1),
+                                               xstd, 1E-12, 0.0));
+        xstd.deallocate();
+        x.deallocate();
+    }
+}
+
+TEST_F(TestBatchGEMM, TestReuseWork) {
+    for (int i = 0; i < n_tests / 10; i++) {
+        int ma = Random::rand_int(1, 50), na = Random::rand_int(1, 50);
+        int mc = Random::rand_int(1, 50), nc = Random::rand_int(1, 50);
+        int nbatch = Random::rand_int(1, 10), nl = Random::rand_int(1, 10);
+        size_t max_flops = Random::rand_int(0, 2) ? 0 : 1 << 14;
+        bool outer = Random::rand_int(0, 2);
+        MatrixRef a(dalloc_()->allocate(ma * na * nbatch), ma, na);
+        MatrixRef l(dalloc_()->allocate(ma * mc * nl), mc, ma);
+        MatrixRef r(dalloc_()->allocate(na * nc), na, nc);
+        MatrixRef c(dalloc_()->allocate(mc * nc * 2), mc, nc);
+        Random::fill_rand_double(a.data, a.size() * nbatch);
+        Random::fill_rand_double(l.data, l.size() * nl);
+        Random::fill_rand_double(r.data, r.size());
+        size_t nflops[2];
+        for (int ir = 0; ir < 2; ir++) {
+            // all left operators share the intermediate (a x r)
+            shared_ptr<BatchGEMMSeq> seq =
+                make_shared<BatchGEMMSeq>(max_flops, SeqTypes::Auto);
+            seq->reuse_work = ir == 0;
+            MatrixRef xc = c.shift_ptr(mc * nc * ir);
+            xc.clear();
+            for (int j = 0; j < nl * nbatch; j++) {
+                int il = outer ? j / nbatch : j % nl;
+                int ii = outer ? j % nbatch : j / nl;
+                seq->rotate(a.shift_ptr(ma * na * ii), xc,
+                            l.shift_ptr(ma * mc * il), false, r, false,
+                            1.0 + il);
+            }
+            seq->auto_perform();
+            nflops[ir] = seq->cumulative_nflop;
+        }
+        ASSERT_TRUE(MatrixFunctions::all_close(c, c.shift_ptr(mc * nc), 1E-10,
+                                               0.0));
+        ASSERT_LE(nflops[0], nflops[1]);
+        if (nl > 1)
+            ASSERT_LT(nflops[0], nflops[1]);
+        dalloc_()->deallocate(c.data, mc * nc * 2);
+        r.deallocate();
+        dalloc_()->deallocate(l.data, ma * mc * nl);
+        dalloc_()->deallocate(a.data, ma * na * nbatch);
+    }
+}
+
+TEST_F(TestBatchGEMM, TestPanel) {
+    threading_()->n_threads_op = 4;
+    for (int i = 0; i < n_tests / 10; i++) {
+        SeqTypes mode = Random::rand_int(0, 2) ? SeqTypes::Auto
+                                               : SeqTypes::Tasked;
+        shared_ptr<BatchGEMMSeq> seq = make_shared<BatchGEMMSeq>(
+            mode == SeqTypes::Auto ? 1 << 14 : 0, mode);
+        int ma = Random::rand_int(1, 50), na = Random::rand_int(1, 50);
+        int mc = Random::rand_int(1, 50), nc = Random::rand_int(1, 50);
+        int nbatch = Random::rand_int(1, 20), ncbatch = Random::rand_int(1, 5);
+        int nv = Random::rand_int(1, 5);
+        MatrixRef l(dalloc_()->allocate(ma * mc), mc, ma);
+        MatrixRef r(dalloc_()->allocate(na * nc), na, nc);
+        Random::fill_rand_double(l.data, l.size());
+        Random::fill_rand_double(r.data, r.size());
+        for (int ii = 0; ii < nbatch; ii++)
+            seq->rotate(MatrixRef((double *)0 + ma * na * ii, ma, na),
+                        MatrixRef((double *)0 + mc * nc * (ii % ncbatch), mc,
+                                  nc),
+                        l, false, r, false, 1.0);
+        if (mode == SeqTypes::Auto) {
+            seq->prepare();
+            seq->allocate();
+        }
+        const int asz = ma * na * nbatch, csz = mc * nc * ncbatch;
+        MatrixRef a(dalloc_()->allocate(asz * nv), asz * nv, 1);
+        MatrixRef c(dalloc_()->allocate(csz * nv), csz * nv, 1);
+        MatrixRef cstd(dalloc_()->allocate(csz), csz, 1);
+        Random::fill_rand_double(a.data, a.size());
+        c.clear();
+        vector<MatrixRef> as, cs;
+        for (int iv = 0; iv < nv; iv++) {
+            as.push_back(MatrixRef(a.data + asz * iv, asz, 1));
+            cs.push_back(MatrixRef(c.data + csz * iv, csz, 1));
+        }
+        (*seq)(as, cs);
+        for (int iv = 0; iv < nv; iv++) {
+            cstd.clear();
+            (*seq)(as[iv], cstd);
+            ASSERT_TRUE(MatrixFunctions::all_close(cs[iv], cstd, 1E-10, 0.0));
+        }
+        cstd.deallocate();
+        c.deallocate();
+        a.deallocate();
+        seq->deallocate();
+        seq->clear();
+        r.deallocate();
+        l.deallocate();
+    }
+    threading_()->n_threads_op = 1;
+}
+
+TEST_F(TestBatchGEMM, TestTimedRotate) {
+    if (!PerfGate::instance().enabled())
+        return;
+    const int m = 100, nbatch = 50;
+    shared_ptr<BatchGEMMSeq> seq = make_shared<BatchGEMMSeq>(1 << 24);
+    seq->mode = SeqTypes::Auto;
+    MatrixRef a(dalloc_()->allocate(m * m * nbatch), m * nbatch, m);
+    MatrixRef c(dalloc_()->allocate(m * m), m, m);
+    MatrixRef l(dalloc_()->allocate(m * m), m, m);
+    MatrixRef r(dalloc_()->allocate(m * m), m, m);
+    Random::fill_rand_double(a.data, a.size());
+    Random::fill_rand_double(l.data, l.size());
+    Random::fill_rand_double(r.data, r.size());
+    PerfGate::instance().run("batch_gemm_rotate", [&]() {
+        c.clear();
+        for (int ii = 0; ii < nbatch; ii++)
+            seq->rotate(MatrixRef(a.data + m * m * ii, m, m), c, l, true, r,
+                        false, 1.0);
+        seq->auto_perform();
+    });
+    r.deallocate();
+    l.deallocate();
+    c.deallocate();
+    a.deallocate();
+}
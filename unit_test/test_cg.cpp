@@ -307,4 +307,32 @@ TEST_F(TestCG, TestW9jJiZero) {
             sqrt((tf + 1) * (tg + 1)) * cg.wigner_6j(ta, tb, tf, te, td, tg);
         EXPECT_LT(abs(actual - expected), 1E-15);
     }
-}
\ No newline at end of file
+}
+TEST_F(TestCG, TestW6jW9jCache) {
+    CG<SU2>::clear_cache();
+    vector<int> tjs6, tjs9;
+    for (int i = 0; i < n_tests; i++) {
+        // larger 2j are not tabulated
+        int mx = i % 10 == 0 ? 150 : 12;
+        for (int j = 0; j < 6; j++)
+            tjs6.push_back(Random::rand_int(0, mx));
+        for (int j = 0; j < 9; j++)
+            tjs9.push_back(Random::rand_int(0, 12));
+    }
+    vector<long double> r6(n_tests), r9(n_tests);
+    // the second pass reads the values filled by the first one
+    for (int k = 0; k < 2; k++) {
+        cg.wigner_6j_batch(n_tests, tjs6.data(), r6.data());
+        cg.wigner_9j_batch(n_tests, tjs9.data(), r9.data());
+        for (int i = 0; i < n_tests; i++) {
+            const int *a = tjs6.data() + i * 6, *b = tjs9.data() + i * 9;
+            EXPECT_EQ(r6[i], cg.compute_wigner_6j(a[0], a[1], a[2], a[3],
+                                                  a[4], a[5]));
+            EXPECT_LT(abs(r9[i] - cg.compute_wigner_9j(b[0], b[1], b[2], b[3],
+                                                       b[4], b[5], b[6], b[7],
+                                                       b[8])),
+                      1E-15);
+        }
+    }
+    CG<SU2>::clear_cache();
+}
@@ -227,3 +227,116 @@ TEST_F(TestComplexMatrix, TestGCROT) {
         ra.deallocate();
     }
 }
+
+TEST_F(TestComplexMatrix, TestShiftedCOCG) {
+    for (int i = 0; i < n_tests; i++) {
+        MKL_INT m = Random::rand_int(1, 200);
+        int nw = Random::rand_int(1, 5);
+        int nmult = 0, niter = 0;
+        double eta = 0.5;
+        MatrixRef ra(dalloc_()->allocate(m * m), m, m);
+        MatrixRef rax(dalloc_()->allocate(m * m), m, m);
+        MatrixRef rb(dalloc_()->allocate(m), m, 1);
+        ComplexMatrixRef a((complex<double> *)dalloc_()->allocate(m * m * 2), m,
+                           m);
+        ComplexMatrixRef b((complex<double> *)dalloc_()->allocate(m * 2), m, 1);
+        ComplexMatrixRef r((complex<double> *)dalloc_()->allocate(m * 2), m, 1);
+        ComplexMatrixRef xs((complex<double> *)dalloc_()->allocate(m * nw * 2),
+                            m * nw, 1);
+        Random::fill_rand_double(rax.data, rax.size());
+        Random::fill_rand_double(rb.data, rb.size());
+        MatrixFunctions::multiply(rax, false, rax, true, ra, 1.0 / m, 0.0);
+        DiagonalMatrix diag(dalloc_()->allocate(m), m);
+        for (MKL_INT k = 0; k < m; k++)
+            diag(k, k) = ra(k, k);
+        a.clear();
+        ComplexMatrixFunctions::fill_complex(a, ra, MatrixRef(nullptr, m, m));
+        b.clear();
+        ComplexMatrixFunctions::fill_complex(b, rb, MatrixRef(nullptr, m, 1));
+        xs.clear();
+        vector<complex<double>> shifts;
+        vector<ComplexMatrixRef> vxs;
+        for (int j = 0; j < nw; j++) {
+            shifts.push_back(
+                complex<double>(Random::rand_double(-1, 1), eta));
+            vxs.push_back(ComplexMatrixRef(xs.data + m * j, m, 1));
+        }
+        MatMul mop(a);
+        int npanel = 0;
+        auto pop = [&mop, &npanel](const vector<ComplexMatrixRef> &bs,
+                                   const vector<ComplexMatrixRef> &cs) {
+            for (size_t k = 0; k < bs.size(); k++)
+                mop(bs[k], cs[k]);
+            npanel++;
+        };
+        vector<complex<double>> funcs = ComplexMatrixFunctions::shifted_cocg(
+            pop, diag, shifts, vxs, b, nmult, niter, false,
+            (shared_ptr<ParallelCommunicator<SZ>>)nullptr, 1E-16, 10000);
+        EXPECT_EQ(npanel, niter);
+        for (int j = 0; j < nw; j++) {
+            ComplexMatrixFunctions::copy(r, b);
+            ComplexMatrixFunctions::multiply(a, false, vxs[j], false, r, -1.0,
+                                             1.0);
+            ComplexMatrixFunctions::iadd(r, vxs[j], -shifts[j]);
+            EXPECT_LT(ComplexMatrixFunctions::norm(r), 1E-6);
+            EXPECT_LT(abs(funcs[j] - ComplexMatrixFunctions::complex_dot(
+                                         vxs[j], b)),
+                      1E-10);
+        }
+        diag.deallocate();
+        xs.deallocate();
+        r.deallocate();
+        b.deallocate();
+        a.deallocate();
+        rb.deallocate();
+        rax.deallocate();
+        ra.deallocate();
+    }
+}
+
+TEST_F(TestComplexMatrix, TestGCROTRecycle) {
+    for (int i = 0; i < n_tests; i++) {
+        MKL_INT m = Random::rand_int(1, 200);
+        double eta = 0.05;
+        MatrixRef ra(dalloc_()->allocate(m * m), m, m);
+        MatrixRef rax(dalloc_()->allocate(m * m), m, m);
+        MatrixRef rb(dalloc_()->allocate(m), m, 1);
+        ComplexMatrixRef a((complex<double> *)dalloc_()->allocate(m * m * 2), m,
+                           m);
+        ComplexMatrixRef b((complex<double> *)dalloc_()->allocate(m * 2), m, 1);
+        ComplexMatrixRef r((complex<double> *)dalloc_()->allocate(m * 2), m, 1);
+        ComplexMatrixRef x((complex<double> *)dalloc_()->allocate(m * 2), m, 1);
+        Random::fill_rand_double(rax.data, rax.size());
+        Random::fill_rand_double(rb.data, rb.size());
+        MatrixFunctions::multiply(rax, false, rax, true, ra, 1.0 / m, 0.0);
+        a.clear();
+        ComplexMatrixFunctions::fill_complex(a, ra, MatrixRef(nullptr, m, m));
+        b.clear();
+        ComplexMatrixFunctions::fill_complex(b, rb, MatrixRef(nullptr, m, 1));
+        ComplexGCROTRecycle recycle;
+        x.clear();
+        for (int j = 0; j < 3; j++) {
+            complex<double> shift(0.1 * j - 0.5, eta);
+            for (MKL_INT k = 0; k < m; k++)
+                a(k, k) = ra(k, k) + shift;
+            MatMul mop(a);
+            int nmult = 0, niter = 0;
+            ComplexMatrixFunctions::gcrotmk(
+                mop, ComplexDiagonalMatrix(nullptr, 0), x, b, nmult, niter, 20,
+                -1, false, (shared_ptr<ParallelCommunicator<SZ>>)nullptr,
+                1E-14, 10000, -1, &recycle, shift);
+            EXPECT_EQ(recycle.shift, shift);
+            EXPECT_LE(recycle.ncs, 20);
+            ComplexMatrixFunctions::copy(r, b);
+            ComplexMatrixFunctions::multiply(a, false, x, false, r, -1.0, 1.0);
+            EXPECT_LT(ComplexMatrixFunctions::norm(r), 1E-6);
+        }
+        x.deallocate();
+        r.deallocate();
+        b.deallocate();
+        a.deallocate();
+        rb.deallocate();
+        rax.deallocate();
+        ra.deallocate();
+    }
+}
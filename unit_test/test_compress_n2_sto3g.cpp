@@ -13,6 +13,9 @@ class TestLinearN2STO3G : public ::testing::Test {
     template <typename S>
     void test_dmrg(S target, const shared_ptr<HamiltonianQC<S>> &hamil,
                    const string &name, int dot);
+    template <typename S>
+    void test_unordered(S target, const shared_ptr<HamiltonianQC<S>> &hamil,
+                        const string &name);
     void SetUp() override {
         Random::rand_seed(0);
         frame_() = make_shared<DataFrame>(isize, dsize, "nodex");
@@ -175,6 +178,134 @@ void TestLinearN2STO3G::test_dmrg(S target,
     mpo->deallocate();
 }
 
+template <typename S>
+void TestLinearN2STO3G::test_unordered(
+    S target, const shared_ptr<HamiltonianQC<S>> &hamil, const string &name) {
+
+    double energy_std = -107.654122447525;
+
+    Timer t;
+    t.get_time();
+    shared_ptr<MPO<S>> mpo =
+        make_shared<MPOQC<S>>(hamil, QCTypes::Conventional);
+    mpo = make_shared<SimplifiedMPO<S>>(mpo, make_shared<RuleQC<S>>(), true);
+
+    shared_ptr<MPO<S>> ntr_mpo =
+        make_shared<MPOQC<S>>(hamil, QCTypes::Conventional);
+    ntr_mpo = make_shared<SimplifiedMPO<S>>(
+        ntr_mpo, make_shared<NoTransposeRule<S>>(make_shared<RuleQC<S>>()),
+        true);
+
+    shared_ptr<MPO<S>> impo = make_shared<IdentityMPO<S>>(hamil);
+    impo = make_shared<SimplifiedMPO<S>>(impo, make_shared<Rule<S>>());
+
+    ubond_t bond_dim = 200;
+    vector<ubond_t> bdims = {bond_dim};
+    vector<double> noises = {1E-8, 1E-9, 0.0};
+
+    shared_ptr<MPSInfo<S>> mps_info = make_shared<MPSInfo<S>>(
+        hamil->n_sites, hamil->vacuum, target, hamil->basis);
+    mps_info->set_bond_dimension(bond_dim);
+    mps_info->tag = "KET";
+
+    Random::rand_seed(0);
+
+    shared_ptr<MPS<S>> mps = make_shared<MPS<S>>(hamil->n_sites, 0, 2);
+    mps->initialize(mps_info);
+    mps->random_canonicalize();
+    mps->save_mutable();
+    mps->deallocate();
+    mps_info->save_mutable();
+    mps_info->deallocate_mutable();
+
+    shared_ptr<MovingEnvironment<S>> me =
+        make_shared<MovingEnvironment<S>>(mpo, mps, mps, "DMRG");
+    me->init_environments(false);
+    shared_ptr<DMRG<S>> dmrg = make_shared<DMRG<S>>(me, bdims, noises);
+    dmrg->iprint = 0;
+    dmrg->noise_type = NoiseTypes::Perturbative;
+    double energy = dmrg->solve(10, mps->center == 0, 1E-8);
+    EXPECT_LT(abs(energy - energy_std), 1E-7);
+
+    // serial fitting of H |psi>
+    shared_ptr<MPSInfo<S>> bra_info = make_shared<MPSInfo<S>>(
+        hamil->n_sites, hamil->vacuum, target, hamil->basis);
+    bra_info->set_bond_dimension(bond_dim);
+    bra_info->tag = "BRA";
+
+    shared_ptr<MPS<S>> bra =
+        make_shared<MPS<S>>(hamil->n_sites, mps->center, 2);
+    bra->initialize(bra_info);
+    bra->random_canonicalize();
+    bra->save_mutable();
+    bra->deallocate();
+    bra_info->save_mutable();
+    bra_info->deallocate_mutable();
+
+    shared_ptr<MovingEnvironment<S>> sme =
+        make_shared<MovingEnvironment<S>>(ntr_mpo, bra, mps, "COMPRESS");
+    sme->init_environments(false);
+    shared_ptr<Linear<S>> cps = make_shared<Linear<S>>(sme, bdims, bdims);
+    cps->iprint = 0;
+    double norm = cps->solve(6, mps->center == 0, 1E-10);
+
+    EXPECT_LT(abs(norm - abs(energy)), 1E-5);
+
+    // fitting of H |psi> with three partitions
+    shared_ptr<MPSInfo<S>> pbra_info = make_shared<MPSInfo<S>>(
+        hamil->n_sites, hamil->vacuum, target, hamil->basis);
+    pbra_info->set_bond_dimension(bond_dim);
+    pbra_info->tag = "PBRA";
+
+    shared_ptr<MPS<S>> xbra =
+        make_shared<MPS<S>>(hamil->n_sites, mps->center, 2);
+    xbra->initialize(pbra_info);
+    xbra->random_canonicalize();
+    xbra->save_mutable();
+    xbra->deallocate();
+    pbra_info->save_mutable();
+    pbra_info->deallocate_mutable();
+
+    shared_ptr<ParallelMPS<S>> pbra = make_shared<ParallelMPS<S>>(xbra);
+    shared_ptr<ParallelMPS<S>> pket = make_shared<ParallelMPS<S>>(mps);
+    pbra->conn_centers = pket->conn_centers =
+        vector<int>{hamil->n_sites / 3, 2 * hamil->n_sites / 3};
+
+    shared_ptr<MovingEnvironment<S>> pme =
+        make_shared<MovingEnvironment<S>>(ntr_mpo, pbra, pket, "PCOMPRESS");
+    pme->init_environments(false);
+    shared_ptr<Linear<S>> pcps = make_shared<Linear<S>>(pme, bdims, bdims);
+    pcps->iprint = 0;
+    double pnorm = pcps->solve(6, pket->center == 0, 1E-10);
+
+    cout << "== " << name << " (UNORDERED CPS) ==" << setw(20) << target
+         << " NORM = " << fixed << setw(22) << setprecision(12) << pnorm
+         << " error = " << scientific << setprecision(3) << setw(10)
+         << (pnorm - norm) << " T = " << fixed << setw(10) << setprecision(3)
+         << t.get_time() << endl;
+
+    EXPECT_LT(abs(pnorm - norm), 1E-6);
+
+    pme->finalize_environments();
+
+    // < H psi | psi > after stitching the partitions
+    shared_ptr<MovingEnvironment<S>> eme = make_shared<MovingEnvironment<S>>(
+        impo, make_shared<MPS<S>>(*pbra), make_shared<MPS<S>>(*pket),
+        "EXPECT");
+    eme->init_environments(false);
+    shared_ptr<Expect<S>> ex = make_shared<Expect<S>>(eme, bond_dim, bond_dim);
+    double ov = ex->solve(false);
+
+    EXPECT_LT(abs(ov - energy), 1E-5);
+
+    pbra_info->deallocate();
+    bra_info->deallocate();
+    mps_info->deallocate();
+    impo->deallocate();
+    ntr_mpo->deallocate();
+    mpo->deallocate();
+}
+
 TEST_F(TestLinearN2STO3G, TestSU2) {
     shared_ptr<FCIDUMP> fcidump = make_shared<FCIDUMP>();
     PGTypes pg = PGTypes::D2H;
@@ -199,6 +330,29 @@ TEST_F(TestLinearN2STO3G, TestSU2) {
     fcidump->deallocate();
 }
 
+TEST_F(TestLinearN2STO3G, TestSU2Unordered) {
+    shared_ptr<FCIDUMP> fcidump = make_shared<FCIDUMP>();
+    PGTypes pg = PGTypes::D2H;
+    string filename = "data/N2.STO3G.FCIDUMP";
+    fcidump->read(filename);
+    vector<uint8_t> orbsym = fcidump->orb_sym<uint8_t>();
+    transform(orbsym.begin(), orbsym.end(), orbsym.begin(),
+              PointGroup::swap_pg(pg));
+
+    SU2 vacuum(0);
+    SU2 target(fcidump->n_elec(), fcidump->twos(),
+               PointGroup::swap_pg(pg)(fcidump->isym()));
+
+    int norb = fcidump->n_sites();
+    shared_ptr<HamiltonianQC<SU2>> hamil =
+        make_shared<HamiltonianQC<SU2>>(vacuum, norb, orbsym, fcidump);
+
+    test_unordered<SU2>(target, hamil, "SU2/2-site");
+
+    hamil->deallocate();
+    fcidump->deallocate();
+}
+
 TEST_F(TestLinearN2STO3G, TestSZ) {
     shared_ptr<FCIDUMP> fcidump = make_shared<FCIDUMP>();
     PGTypes pg = PGTypes::D2H;
@@ -301,3 +301,41 @@ TEST_F(TestCSFSpace, TestCSFSpace) {
     matg->initialize(info);
     csf_bs->build_site_op(c_ops, {2}, matg, 1);
 }
+
+TEST_F(TestCSFSpace, TestCouplingCache) {
+    shared_ptr<CSFSpace<SU2>> csf_space =
+        make_shared<CSFSpace<SU2>>(4, 8, false);
+    const uint8_t c_ops = 3, d_ops = 2, c2_ops = 1, d2_ops = 0;
+    const vector<pair<uint8_t, vector<uint16_t>>> ops_list = {
+        {c_ops, {1}},
+        {d_ops + (c2_ops << 2), {0, 2}},
+        {d_ops + (c_ops << 2), {1, 3}},
+        {d_ops + (d2_ops << 2) + (c_ops << 4), {1, 2, 2}},
+        {d_ops + (d2_ops << 2) + (c_ops << 4) + (c2_ops << 6), {0, 1, 2, 3}}};
+    auto apply_all = [&csf_space, &ops_list]() {
+        vector<pair<pair<MKL_INT, MKL_INT>, double>> mat;
+        for (auto &ops : ops_list)
+            for (int i = 0; i < csf_space->n_unpaired_idxs.back(); i++)
+                csf_space->cfg_apply_ops(i, ops.first, ops.second, mat, -0.5);
+        return mat;
+    };
+    // first pass fills the cache
+    vector<pair<pair<MKL_INT, MKL_INT>, double>> mat_ref = apply_all();
+    EXPECT_GT(csf_space->coupling_cache->size(), 0);
+    csf_space->coupling_cache->save_data("csf-coupling-cache.tmp");
+    // cached, reloaded cache and no cache
+    for (int icache = 0; icache < 3; icache++) {
+        if (icache == 1) {
+            csf_space->coupling_cache = make_shared<CSFCouplingCache>();
+            csf_space->coupling_cache->load_data("csf-coupling-cache.tmp");
+        } else if (icache == 2)
+            csf_space->coupling_cache = nullptr;
+        vector<pair<pair<MKL_INT, MKL_INT>, double>> mat = apply_all();
+        ASSERT_EQ(mat.size(), mat_ref.size());
+        for (size_t k = 0; k < mat.size(); k++) {
+            EXPECT_EQ(mat[k].first, mat_ref[k].first);
+            EXPECT_LT(abs(mat[k].second - mat_ref[k].second), 1E-12);
+        }
+    }
+    Parsing::remove_file("csf-coupling-cache.tmp");
+}
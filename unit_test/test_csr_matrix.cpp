@@ -127,6 +127,48 @@ TEST_F(TestCSRMatrix, TestMultiply) {
     cout << "MULTI dense T = " << dst << " csr T = " << spt << endl;
 }
 
+TEST_F(TestCSRMatrix, TestSparseMultiply) {
+    for (int i = 0; i < n_tests; i++) {
+        int ma = Random::rand_int(1, 200), na = Random::rand_int(1, 200);
+        int mb = na, nb = Random::rand_int(1, 200);
+        MatrixRef a(dalloc_()->allocate(ma * na), ma, na);
+        MatrixRef b(dalloc_()->allocate(mb * nb), mb, nb);
+        MatrixRef c(dalloc_()->allocate(ma * nb), ma, nb);
+        Random::fill_rand_double(a.data, a.size());
+        Random::fill_rand_double(b.data, b.size());
+        for (size_t k = 0; k < a.size(); k++)
+            if (Random::rand_double() < 0.95)
+                a.data[k] = 0;
+        for (size_t k = 0; k < b.size(); k++)
+            if (Random::rand_double() < 0.95)
+                b.data[k] = 0;
+        double alpha = Random::rand_double();
+        MatrixFunctions::multiply(a, false, b, false, c, alpha, 0.0);
+        CSRMatrixRef ca, cb;
+        ca.from_dense(a);
+        cb.from_dense(b);
+        CSRMatrixFunctions::multiply_parallel_nnz() = i % 2 ? 1 : 1 << 14;
+        MKL_INT nnz = CSRMatrixFunctions::multiply_nnz(ca, false, cb, false);
+        // output allocated in the stack with the predicted size
+        CSRMatrixRef cc(ma, nb, 0, nullptr, nullptr, nullptr);
+        cc.alloc = dalloc_();
+        size_t used = dalloc_()->used;
+        CSRMatrixFunctions::multiply(ca, false, cb, false, cc, alpha, 0.0);
+        ASSERT_EQ(cc.nnz, nnz);
+        ASSERT_EQ(cc.alloc, dalloc_());
+        ASSERT_EQ(dalloc_()->used - used, (size_t)cc.memory_size());
+        MatrixRef stdc(dalloc_()->allocate(ma * nb), ma, nb);
+        cc.to_dense(stdc);
+        ASSERT_TRUE(MatrixFunctions::all_close(stdc, c, 1E-10, 0.0));
+        stdc.deallocate();
+        cc.deallocate();
+        c.deallocate();
+        b.deallocate();
+        a.deallocate();
+    }
+    CSRMatrixFunctions::multiply_parallel_nnz() = 1 << 14;
+}
+
 TEST_F(TestCSRMatrix, TestRotate) {
     Timer t;
     double dst = 0.0, spt = 0.0;
@@ -345,3 +387,67 @@ TEST_F(TestCSRMatrix, TestTensorProduct) {
     }
     cout << "TP dense T = " << dst << " csr T = " << spt / 3 << endl;
 }
+
+static int n_offload_csrmms = 0;
+
+static void counted_csrmm(const CSRMatrixRef &s, bool conjs, const MatrixRef &d,
+                          bool conjd, bool sparse_left, const MatrixRef &c,
+                          double scale, double cfactor) {
+#pragma omp atomic
+    n_offload_csrmms++;
+    MatrixRef sd(nullptr, s.m, s.n);
+    sd.allocate();
+    s.to_dense(sd);
+    if (sparse_left)
+        MatrixFunctions::multiply(sd, conjs, d, conjd, c, scale, cfactor);
+    else
+        MatrixFunctions::multiply(d, conjd, sd, conjs, c, scale, cfactor);
+    sd.deallocate();
+}
+
+TEST_F(TestCSRMatrix, TestCSRMMOffload) {
+    const MKL_INT offload_nnz = 2000;
+    CSRMatrixFunctions::csrmm_offload_nnz() = offload_nnz;
+    csrmm_backend_() = &counted_csrmm;
+    n_offload_csrmms = 0;
+    int n_large = 0;
+    for (int i = 0; i < n_tests; i++) {
+        int ma = Random::rand_int(1, 200), na = Random::rand_int(1, 200);
+        int nb = Random::rand_int(1, 200);
+        bool sparse_left = Random::rand_int(0, 2);
+        bool conja = Random::rand_int(0, 2);
+        bool conjb = Random::rand_int(0, 2);
+        MatrixRef a(dalloc_()->allocate(ma * na), conja ? na : ma,
+                    conja ? ma : na);
+        MatrixRef b(dalloc_()->allocate(na * nb), conjb ? nb : na,
+                    conjb ? na : nb);
+        MatrixRef c(dalloc_()->allocate(ma * nb), ma, nb);
+        MatrixRef stdc(dalloc_()->allocate(ma * nb), ma, nb);
+        fill_sparse_double(a.data, a.size());
+        fill_sparse_double(b.data, b.size());
+        Random::fill_rand_double(c.data, c.size());
+        MatrixFunctions::copy(stdc, c);
+        double alpha = Random::rand_double();
+        double cfactor = Random::rand_double();
+        MatrixFunctions::multiply(a, conja, b, conjb, stdc, alpha, cfactor);
+        CSRMatrixRef cs;
+        cs.from_dense(sparse_left ? a : b);
+        n_large += cs.nnz != cs.size() && cs.nnz >= offload_nnz;
+        if (sparse_left)
+            CSRMatrixFunctions::multiply(cs, conja, b, conjb, c, alpha,
+                                         cfactor);
+        else
+            CSRMatrixFunctions::multiply(a, conja, cs, conjb, c, alpha,
+                                         cfactor);
+        ASSERT_TRUE(MatrixFunctions::all_close(stdc, c, 1E-10, 0.0));
+        cs.deallocate();
+        stdc.deallocate();
+        c.deallocate();
+        b.deallocate();
+        a.deallocate();
+    }
+    EXPECT_GT(n_large, 0);
+    EXPECT_EQ(n_offload_csrmms, n_large);
+    csrmm_backend_() = nullptr;
+    CSRMatrixFunctions::csrmm_offload_nnz() = 0;
+}
@@ -0,0 +1,437 @@
+#include "block2_core.hpp"
+#include "gtest/gtest.h"
+
+using namespace block2;
+
+class TestDataFrame : public ::testing::Test {
+  protected:
+    static const int n_tests = 20;
+    size_t isize = 1L << 24;
+    size_t dsize = 1L << 28;
+    void SetUp() override {
+        Random::rand_seed(0);
+        frame_() = make_shared<DataFrame>(isize, dsize, "nodex");
+    }
+    void TearDown() override {
+        frame_()->activate(0);
+        assert(ialloc_()->used == 0 && dalloc_()->used == 0);
+        frame_() = nullptr;
+    }
+};
+
+TEST_F(TestDataFrame, TestMMapScratch) {
+    for (int i = 0; i < n_tests; i++) {
+        frame_()->mmap_scratch = i % 2 == 1;
+        frame_()->activate(1);
+        size_t ni = Random::rand_int(0, 3000), nd = Random::rand_int(1, 90000);
+        uint32_t *iptr = ialloc_()->allocate(ni);
+        double *dptr = dalloc_()->allocate(nd);
+        vector<uint32_t> iref(ni);
+        vector<double> dref(nd);
+        for (size_t j = 0; j < ni; j++)
+            iptr[j] = iref[j] = (uint32_t)Random::rand_int(0, 1 << 30);
+        Random::fill_rand_double(dref.data(), nd, -1, 1);
+        memcpy(dptr, dref.data(), sizeof(double) * nd);
+        string filename = frame_()->save_dir + "/TEST-DF.TMP";
+        frame_()->save_data(1, filename);
+        frame_()->reset(1);
+        memset(dptr, 0, sizeof(double) * nd);
+        frame_()->load_data(1, filename);
+        EXPECT_EQ(ialloc_()->used, ni);
+        EXPECT_EQ(dalloc_()->used, nd);
+        for (size_t j = 0; j < ni; j++)
+            EXPECT_EQ(iptr[j], iref[j]);
+        EXPECT_TRUE(MatrixFunctions::all_close(MatrixRef(dptr, nd, 1),
+                                               MatrixRef(dref.data(), nd, 1),
+                                               0, 0));
+        // modifying loaded data must not change the file
+        dptr[0] += 1.0;
+        frame_()->reset(1);
+        frame_()->load_data(1, filename);
+        EXPECT_EQ(dptr[0], dref[0]);
+        frame_()->reset(1);
+        Parsing::remove_file(filename);
+    }
+}
+
+TEST_F(TestDataFrame, TestPrefetch) {
+    frame_()->prefetch_buffering = true;
+    vector<vector<double>> drefs(n_tests);
+    for (int i = 0; i < n_tests; i++) {
+        frame_()->activate(1);
+        size_t nd = Random::rand_int(1, 90000);
+        double *dptr = dalloc_()->allocate(nd);
+        drefs[i].resize(nd);
+        Random::fill_rand_double(drefs[i].data(), nd, -1, 1);
+        memcpy(dptr, drefs[i].data(), sizeof(double) * nd);
+        frame_()->save_data(1, frame_()->save_dir + "/TEST-PF." +
+                                   Parsing::to_string(i) + ".TMP");
+        frame_()->reset(1);
+    }
+    for (int i = 0; i < n_tests; i++) {
+        string filename =
+            frame_()->save_dir + "/TEST-PF." + Parsing::to_string(i) + ".TMP";
+        frame_()->prefetch_data(1, filename);
+        if (i + 1 < n_tests)
+            frame_()->prefetch_data(1, frame_()->save_dir + "/TEST-PF." +
+                                           Parsing::to_string(i + 1) + ".TMP");
+        EXPECT_LE((int)frame_()->prefetch_futures[1].size(),
+                  frame_()->max_prefetch);
+        frame_()->load_data(1, filename);
+        EXPECT_EQ(dalloc_()->used, drefs[i].size());
+        EXPECT_TRUE(MatrixFunctions::all_close(
+            MatrixRef(dalloc_()->data, drefs[i].size(), 1),
+            MatrixRef(drefs[i].data(), drefs[i].size(), 1), 0, 0));
+    }
+    frame_()->reset_buffer(1);
+    frame_()->reset(1);
+    for (int i = 0; i < n_tests; i++)
+        Parsing::remove_file(frame_()->save_dir + "/TEST-PF." +
+                             Parsing::to_string(i) + ".TMP");
+}
+
+TEST_F(TestDataFrame, TestAsyncFileSave) {
+    const int n_files = 4;
+    vector<vector<double>> drefs(n_files);
+    auto fn = [](int i) {
+        return frame_()->save_dir + "/TEST-AS." + Parsing::to_string(i) +
+               ".TMP";
+    };
+    for (int i = 0; i < n_tests; i++) {
+        // later writes to the same file must win
+        int k = i % n_files;
+        drefs[k].resize(Random::rand_int(1, 20000));
+        Random::fill_rand_double(drefs[k].data(), drefs[k].size(), -1, 1);
+        shared_ptr<stringstream> ss = make_shared<stringstream>();
+        ss->write((char *)drefs[k].data(), sizeof(double) * drefs[k].size());
+        frame_()->save_file_async(fn(k), ss);
+        if (i % 7 == 6) {
+            frame_()->wait_save_file(fn(k));
+            shared_ptr<stringstream> lss = DataFrame::buffer_load_data(fn(k));
+            ASSERT_TRUE(lss != nullptr);
+            EXPECT_EQ(lss->str(), ss->str());
+        }
+    }
+    frame_()->wait_save_files();
+    EXPECT_EQ(frame_()->mps_save_futures.size(), (size_t)0);
+    for (int k = 0; k < n_files; k++) {
+        shared_ptr<stringstream> lss = DataFrame::buffer_load_data(fn(k));
+        ASSERT_TRUE(lss != nullptr);
+        EXPECT_EQ(lss->str(), string((char *)drefs[k].data(),
+                                     sizeof(double) * drefs[k].size()));
+        Parsing::remove_file(fn(k));
+    }
+}
+
+TEST_F(TestDataFrame, TestTieredStorage) {
+    const size_t nd = 10000, fsz = sizeof(size_t) * 2 + sizeof(double) * nd;
+    frame_()->ram_cache_size = fsz * 3;
+    frame_()->local_disk_size = fsz * 4;
+    frame_()->spill_dir = frame_()->save_dir + "/SPILL";
+    vector<vector<double>> drefs(n_tests);
+    auto fn = [](int i) {
+        return frame_()->save_dir + "/TEST-TS." + Parsing::to_string(i) +
+               ".TMP";
+    };
+    for (int i = 0; i < n_tests; i++) {
+        frame_()->activate(1);
+        double *dptr = dalloc_()->allocate(nd);
+        drefs[i].resize(nd);
+        Random::fill_rand_double(drefs[i].data(), nd, -1, 1);
+        memcpy(dptr, drefs[i].data(), sizeof(double) * nd);
+        frame_()->save_data(1, fn(i));
+        frame_()->reset(1);
+        EXPECT_LE(frame_()->ram_cache_used, frame_()->ram_cache_size);
+        EXPECT_LE(frame_()->local_disk_used, frame_()->local_disk_size);
+    }
+    EXPECT_TRUE(Parsing::link_exists(fn(0)));
+    EXPECT_FALSE(Parsing::link_exists(fn(n_tests - 1)));
+    for (int i = n_tests - 1; i >= 0; i--) {
+        frame_()->load_data(1, fn(i));
+        EXPECT_EQ(dalloc_()->used, nd);
+        EXPECT_TRUE(MatrixFunctions::all_close(
+            MatrixRef(dalloc_()->data, nd, 1),
+            MatrixRef(drefs[i].data(), nd, 1), 0, 0));
+    }
+    frame_()->reset(1);
+    for (int i = 0; i < n_tests; i++) {
+        frame_()->remove_data(fn(i));
+        EXPECT_FALSE(Parsing::file_exists(fn(i)));
+        EXPECT_FALSE(Parsing::file_exists(frame_()->spill_dir + "/" +
+                                          Parsing::get_filename(fn(i))));
+    }
+    EXPECT_EQ(frame_()->ram_cache_used, 0);
+    EXPECT_EQ(frame_()->local_disk_used, 0);
+}
+
+TEST_F(TestDataFrame, TestFirstTouch) {
+    frame_()->activate(0);
+    size_t nd = Random::rand_int(1, 90000);
+    double *dptr = dalloc_()->allocate(nd);
+    vector<double> dref(nd);
+    Random::fill_rand_double(dref.data(), nd, -1, 1);
+    memcpy(dptr, dref.data(), sizeof(double) * nd);
+    frame_()->first_touch();
+    EXPECT_TRUE(MatrixFunctions::all_close(MatrixRef(dptr, nd, 1),
+                                           MatrixRef(dref.data(), nd, 1), 0,
+                                           0));
+    dalloc_()->deallocate(dptr, nd);
+}
+
+TEST_F(TestDataFrame, TestAlignment) {
+    frame_()->use_huge_pages();
+    frame_()->set_alignment(64);
+    for (int i = 0; i < n_tests; i++) {
+        frame_()->activate(i % 2);
+        int n = Random::rand_int(1, 20);
+        vector<double *> ptrs(n);
+        vector<size_t> szs(n);
+        for (int j = 0; j < n; j++) {
+            szs[j] = Random::rand_int(1, 1000);
+            ptrs[j] = dalloc_()->allocate(szs[j]);
+            EXPECT_EQ((size_t)ptrs[j] % 64, 0);
+            memset(ptrs[j], 0, sizeof(double) * szs[j]);
+        }
+        ptrs[n - 1] = dalloc_()->reallocate(ptrs[n - 1], szs[n - 1], 1);
+        szs[n - 1] = 1;
+        for (int j = n - 1; j >= 0; j--)
+            dalloc_()->deallocate(ptrs[j], szs[j]);
+        EXPECT_EQ(dalloc_()->used, 0);
+    }
+    frame_()->set_alignment(8);
+}
+
+TEST_F(TestDataFrame, TestThreadArenas) {
+    for (int i = 0; i < n_tests; i++) {
+        frame_()->activate(1);
+        size_t nd = Random::rand_int(0, 90000);
+        double *dptr = dalloc_()->allocate(nd);
+        int n = Random::rand_int(1, 9);
+        vector<shared_ptr<StackAllocator<double>>> arenas =
+            frame_()->split_free_stack(1, n);
+        ASSERT_EQ((int)arenas.size(), n);
+        for (int k = 0; k < n; k++) {
+            EXPECT_GE(arenas[k]->data, dptr + nd);
+            EXPECT_EQ((size_t)arenas[k]->data % 64, 0);
+            if (k != 0)
+                EXPECT_EQ(arenas[k - 1]->data + arenas[k - 1]->size,
+                          arenas[k]->data);
+        }
+        EXPECT_LE(arenas[n - 1]->data + arenas[n - 1]->size,
+                  dalloc_()->data + dalloc_()->size);
+        dalloc_()->deallocate(dptr, nd);
+    }
+}
+
+TEST_F(TestDataFrame, TestZeroCopySave) {
+    frame_()->zero_copy_save = true;
+    for (int i = 0; i < n_tests; i++) {
+        frame_()->save_buffering = i % 2 == 1;
+        frame_()->mmap_scratch = i % 4 >= 2;
+        frame_()->direct_io = i % 8 >= 4;
+        frame_()->activate(1);
+        size_t ni = Random::rand_int(0, 3000), nd = Random::rand_int(0, 90000);
+        uint32_t *iptr = ialloc_()->allocate(ni);
+        double *dptr = dalloc_()->allocate(nd);
+        vector<uint32_t> iref(ni);
+        vector<double> dref(nd);
+        for (size_t j = 0; j < ni; j++)
+            iptr[j] = iref[j] = (uint32_t)Random::rand_int(0, 1 << 30);
+        Random::fill_rand_double(dref.data(), nd, -1, 1);
+        memcpy(dptr, dref.data(), sizeof(double) * nd);
+        string filename = frame_()->save_dir + "/TEST-ZC.TMP";
+        frame_()->save_data(1, filename);
+        frame_()->reset(1);
+        frame_()->load_data(1, filename);
+        EXPECT_EQ(ialloc_()->used, ni);
+        EXPECT_EQ(dalloc_()->used, nd);
+        for (size_t j = 0; j < ni; j++)
+            EXPECT_EQ(iptr[j], iref[j]);
+        EXPECT_TRUE(MatrixFunctions::all_close(MatrixRef(dptr, nd, 1),
+                                               MatrixRef(dref.data(), nd, 1),
+                                               0, 0));
+        frame_()->reset_buffer(1);
+        frame_()->reset(1);
+        Parsing::remove_file(filename);
+    }
+    frame_()->save_buffering = false;
+    frame_()->mmap_scratch = false;
+}
+
+TEST_F(TestDataFrame, TestMemoryTags) {
+    frame_()->track_memory_tags();
+    shared_ptr<StackMemoryTags> tags = frame_()->mem_tags;
+    frame_()->activate(0);
+    double *pa, *pb, *pc;
+    {
+        MemoryTagScope mts(frame_(), "left_env");
+        pa = dalloc_()->allocate(1000);
+        mts.set("dm");
+        pb = dalloc_()->allocate(3000);
+        {
+            MemoryTagScope mtx(frame_(), "davidson");
+            pc = dalloc_()->allocate(500);
+        }
+        EXPECT_EQ(tags->names[tags->current], "dm");
+    }
+    EXPECT_EQ(tags->current, 0);
+    int ienv = tags->get("left_env"), idm = tags->get("dm"),
+        idav = tags->get("davidson");
+    EXPECT_EQ(tags->used[ienv], 1000 * 8);
+    EXPECT_EQ(tags->used[idm], 3000 * 8);
+    EXPECT_EQ(tags->used[idav], 500 * 8);
+    dalloc_()->deallocate(pc, 500);
+    pb = dalloc_()->reallocate(pb, 3000, 2000);
+    EXPECT_EQ(tags->used[idav], 0);
+    EXPECT_EQ(tags->peak[idav], 500 * 8);
+    EXPECT_EQ(tags->used[idm], 2000 * 8);
+    EXPECT_EQ(tags->peak[idm], 3000 * 8);
+    dalloc_()->deallocate(pb, 2000);
+    dalloc_()->deallocate(pa, 1000);
+    EXPECT_EQ(tags->used[ienv], 0);
+    frame_()->activate(1);
+    dalloc_()->allocate(700);
+    string filename = frame_()->save_dir + "/TEST-MT.TMP";
+    frame_()->save_data(1, filename);
+    frame_()->reset(1);
+    EXPECT_EQ(tags->used[0], 0);
+    {
+        MemoryTagScope mts(frame_(), "right_env");
+        frame_()->load_data(1, filename);
+    }
+    EXPECT_EQ(tags->used[tags->get("right_env")], 700 * 8);
+    frame_()->reset(1);
+    EXPECT_EQ(tags->used[tags->get("right_env")], 0);
+    frame_()->reset_peak_used_memory();
+    EXPECT_EQ(tags->peak[idm], 0);
+    Parsing::remove_file(filename);
+}
+
+TEST_F(TestDataFrame, TestMemoryTimeline) {
+    frame_()->track_memory_timeline();
+    shared_ptr<StackMemoryTags> tags = frame_()->mem_tags;
+    frame_()->activate(0);
+    double *pa, *pb, *pc;
+    uint32_t *pi;
+    {
+        MemoryTagScope mts(frame_(), "left_env");
+        tags->site = 3;
+        pa = dalloc_()->allocate(1000);
+        pi = ialloc_()->allocate(100);
+        mts.set("dm");
+        tags->site = 4;
+        pb = dalloc_()->allocate(3000);
+    }
+    dalloc_()->deallocate(pb, 3000);
+    tags->site = 5;
+    {
+        MemoryTagScope mts(frame_(), "davidson");
+        pc = dalloc_()->allocate(2000);
+        dalloc_()->deallocate(pc, 2000);
+    }
+    ialloc_()->deallocate(pi, 100);
+    dalloc_()->deallocate(pa, 1000);
+    EXPECT_EQ(tags->timeline.size(), 8);
+    EXPECT_EQ(tags->timeline[2].total, 4000 * 8 + 100 * 4);
+    EXPECT_EQ(tags->timeline[1].stack, frame_()->n_frames);
+    EXPECT_EQ(tags->timeline[1].used, 100 * 4);
+    EXPECT_EQ(tags->timeline.back().total, 0);
+    // the peak is reached in the "dm" phase of site 4
+    EXPECT_EQ(tags->peak_sample.total, 4000 * 8 + 100 * 4);
+    EXPECT_EQ(tags->names[tags->peak_sample.tag], "dm");
+    EXPECT_EQ(tags->peak_sample.site, 4);
+    EXPECT_EQ(tags->peak_sample.stack, 0);
+    EXPECT_EQ(tags->peak_used[tags->get("left_env")], 1000 * 8 + 100 * 4);
+    EXPECT_NE(tags->peak_report().find("Tag = dm"), string::npos);
+    stringstream ss;
+    tags->write_timeline(ss);
+    const string csv = ss.str();
+    EXPECT_EQ(count(csv.begin(), csv.end(), '\n'), 9);
+    // sampling mode keeps every 3rd event and the peak
+    tags->start_timeline(3);
+    for (int i = 0; i < 4; i++)
+        dalloc_()->deallocate(dalloc_()->allocate(10 * (i + 1)), 10 * (i + 1));
+    EXPECT_EQ(tags->timeline.size(), 3);
+    EXPECT_EQ(tags->peak_sample.total, 40 * 8);
+}
+
+TEST_F(TestDataFrame, TestIOMonitor) {
+    // every transfer is slower than the threshold
+    frame_()->monitor_io(1E18);
+    shared_ptr<IOMonitor> iom = frame_()->io_monitor;
+    iom->min_bytes = 0, iom->max_warnings = 2;
+    EXPECT_EQ(IOMonitor::file_type("F0.PART.INFO.DMRG.LEFT.3"),
+              ScratchFileTypes::Left);
+    EXPECT_EQ(IOMonitor::file_type("F.MPS.INFO.KET.RIGHT.3"),
+              ScratchFileTypes::MPS);
+    const string fl = frame_()->save_dir + "/F0.PART.DMRG.LEFT.1",
+                 fr = frame_()->save_dir + "/F0.PART.DMRG.RIGHT.2";
+    frame_()->activate(1);
+    dalloc_()->allocate(3000);
+    frame_()->save_data(1, fl);
+    frame_()->save_data(1, fr);
+    const size_t sz = sizeof(size_t) * 2 + sizeof(double) * 3000;
+    frame_()->reset(1);
+    frame_()->load_data(1, fl);
+    frame_()->reset(1);
+    frame_()->load_data(1, fl);
+    frame_()->reset(1);
+    const IOMonitor::Stats &lr =
+        iom->stats[(int)ScratchFileTypes::Left][0];
+    EXPECT_EQ(lr.count, 2);
+    EXPECT_EQ(lr.bytes, 2 * sz);
+    EXPECT_EQ(lr.n_slow, 2);
+    EXPECT_EQ(iom->stats[(int)ScratchFileTypes::Right][1].bytes, sz);
+    EXPECT_EQ(iom->stats[(int)ScratchFileTypes::Right][0].count, 0);
+    EXPECT_EQ(iom->files.size(), 2);
+    EXPECT_EQ(iom->files[fl].second.count, 1);
+    EXPECT_EQ(iom->n_warnings, 2);
+    EXPECT_NE(iom->report().find("IO[left.read] n = 2"), string::npos);
+    EXPECT_EQ(iom->report().find("right.read"), string::npos);
+    stringstream ss;
+    iom->write_csv(ss);
+    const string csv = ss.str();
+    EXPECT_EQ(count(csv.begin(), csv.end(), '\n'), 3);
+    iom->reset();
+    EXPECT_EQ(iom->report(), "");
+    EXPECT_EQ(iom->files.size(), 2);
+    Parsing::remove_file(fl);
+    Parsing::remove_file(fr);
+}
+
+TEST_F(TestDataFrame, TestResetState) {
+    const size_t nd = 10000;
+    frame_()->ram_cache_size = nd * sizeof(double) * 4;
+    frame_()->monitor_io();
+    double *const dstack = frame_()->dallocs[0]->data;
+    string filename = frame_()->save_dir + "/TEST-RS.TMP";
+    frame_()->activate(1);
+    double *dptr = dalloc_()->allocate(nd);
+    Random::fill_rand_double(dptr, nd, -1, 1);
+    frame_()->save_data(1, filename);
+    frame_()->load_data(1, filename);
+    frame_()->activate(0);
+    dalloc_()->allocate(nd);
+    frame_()->update_peak_used_memory();
+    EXPECT_GT(frame_()->ram_cache_used, 0);
+    // all stacks are released, but not deallocated
+    frame_()->reset_state();
+    EXPECT_EQ(frame_()->i_frame, 0);
+    EXPECT_EQ(frame_()->dallocs[0]->data, dstack);
+    for (int i = 0; i < frame_()->n_frames; i++) {
+        EXPECT_EQ(frame_()->dallocs[i]->used, 0);
+        EXPECT_EQ(frame_()->iallocs[i]->used, 0);
+        EXPECT_EQ(frame_()->present_filenames[i], "");
+    }
+    EXPECT_EQ(frame_()->ram_cache_used, 0);
+    EXPECT_TRUE(frame_()->ram_cache.empty());
+    EXPECT_EQ(frame_()->twrite, 0);
+    const int ity = (int)ScratchFileTypes::Other;
+    EXPECT_EQ(frame_()->io_monitor->stats[ity][0].count, 0);
+    EXPECT_EQ(frame_()->io_monitor->stats[ity][1].count, 0);
+    for (auto &x : frame_()->peak_used_memory)
+        EXPECT_EQ(x, 0);
+    // options are kept
+    EXPECT_EQ(frame_()->ram_cache_size, nd * sizeof(double) * 4);
+    frame_()->remove_data(filename);
+}
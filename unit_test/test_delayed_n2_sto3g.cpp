@@ -167,6 +167,49 @@ TEST_F(TestDelayedN2STO3G, TestSU2) {
     fcidump->deallocate();
 }
 
+TEST_F(TestDelayedN2STO3G, TestSU2Cached) {
+    shared_ptr<FCIDUMP> fcidump = make_shared<FCIDUMP>();
+    PGTypes pg = PGTypes::D2H;
+    string filename = "data/N2.STO3G.FCIDUMP";
+    fcidump->read(filename);
+    vector<uint8_t> orbsym = fcidump->orb_sym<uint8_t>();
+    transform(orbsym.begin(), orbsym.end(), orbsym.begin(),
+              PointGroup::swap_pg(pg));
+
+    SU2 vacuum(0);
+
+    vector<vector<SU2>> targets(2);
+    for (int i = 0; i < 2; i++) {
+        targets[i].resize(3);
+        for (int j = 0; j < 3; j++)
+            targets[i][j] = SU2(fcidump->n_elec(), j * 2, i);
+    }
+
+    vector<vector<double>> energies(2);
+    energies[0] = {-107.654122447525, -106.939132859668, -107.031449471627};
+    energies[1] = {-106.959626154680, -106.999600016661, -106.633790589321};
+
+    int norb = fcidump->n_sites();
+    shared_ptr<HamiltonianQC<SU2>> hamil =
+        make_shared<HamiltonianQC<SU2>>(vacuum, norb, orbsym, fcidump);
+    // small enough for evictions
+    hamil->delayed_cache = make_shared<DelayedSparseMatrixCache<SU2>>(1 << 12);
+
+    test_dmrg<SU2>(targets, energies, hamil, "SU2 CACHED",
+                   DecompositionTypes::DensityMatrix,
+                   NoiseTypes::DensityMatrix);
+
+    cout << "cache hits = " << hamil->delayed_cache->n_hits
+         << " misses = " << hamil->delayed_cache->n_misses << endl;
+    EXPECT_GT(hamil->delayed_cache->n_hits, 0);
+    EXPECT_LE(hamil->delayed_cache->used, hamil->delayed_cache->max_memory);
+    hamil->delayed_cache->clear();
+    EXPECT_EQ(hamil->delayed_cache->used, 0);
+
+    hamil->deallocate();
+    fcidump->deallocate();
+}
+
 TEST_F(TestDelayedN2STO3G, TestSZ) {
     shared_ptr<FCIDUMP> fcidump = make_shared<FCIDUMP>();
     PGTypes pg = PGTypes::D2H;
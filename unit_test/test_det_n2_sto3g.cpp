@@ -13,6 +13,8 @@ class TestDETN2STO3G : public ::testing::Test {
     template <typename S>
     void test_dmrg(const S target, const shared_ptr<HamiltonianQC<S>> &hamil,
                    const string &name);
+    void test_su2_to_sz(const SU2 target,
+                        const shared_ptr<HamiltonianQC<SU2>> &hamil);
     void SetUp() override {
         Random::rand_seed(0);
         frame_() = make_shared<DataFrame>(isize, dsize, "nodex");
@@ -146,11 +148,110 @@ void TestDETN2STO3G::test_dmrg(const S target,
         EXPECT_LT(abs(abs(val) - abs(coeffs[i])), 1E-7);
     }
 
+    // coefficients of the given determinants only
+    shared_ptr<DeterminantTRIE<S>> dtrie_sel = dtrie_ref->copy();
+    dtrie_sel->evaluate(make_shared<UnfusedMPS<S>>(mps));
+    for (int i = 0; i < (int)dtrie_sel->size(); i++)
+        EXPECT_LT(abs(abs(dtrie_sel->vals[i]) - abs(coeffs[i])), 1E-7);
+    // initial MPS constructed from the CI vector
+    shared_ptr<MPSInfo<S>> ci_info =
+        make_shared<MPSInfo<S>>(norb, hamil->vacuum, target, hamil->basis);
+    ci_info->tag = "CIKET";
+    ci_info->set_bond_dimension(bond_dim);
+    ci_info->save_mutable();
+    ci_info->deallocate_mutable();
+    shared_ptr<MPS<S>> ci_mps = dtrie->construct_mps(ci_info);
+    EXPECT_EQ(ci_mps->center, norb - 1);
+    shared_ptr<DeterminantTRIE<S>> dtrie_ci = dtrie_ref->copy();
+    dtrie_ci->evaluate(make_shared<UnfusedMPS<S>>(ci_mps));
+    for (int i = 0; i < (int)dtrie_ci->size(); i++)
+        EXPECT_LT(abs(abs(dtrie_ci->vals[i]) - abs(coeffs[i])), 1E-6);
+    ci_info->deallocate();
+
     // deallocate persistent stack memory
     mps_info->deallocate();
     mpo->deallocate();
 }
 
+void TestDETN2STO3G::test_su2_to_sz(
+    const SU2 target, const shared_ptr<HamiltonianQC<SU2>> &hamil) {
+
+    int norb = hamil->n_sites;
+
+    shared_ptr<MPO<SU2>> mpo =
+        make_shared<MPOQC<SU2>>(hamil, QCTypes::Conventional);
+    mpo = make_shared<SimplifiedMPO<SU2>>(mpo, make_shared<RuleQC<SU2>>(),
+                                          true);
+
+    ubond_t bond_dim = 200;
+
+    shared_ptr<MPSInfo<SU2>> mps_info =
+        make_shared<MPSInfo<SU2>>(norb, hamil->vacuum, target, hamil->basis);
+    mps_info->set_bond_dimension(bond_dim);
+
+    Random::rand_seed(0);
+    shared_ptr<MPS<SU2>> mps = make_shared<MPS<SU2>>(norb, 0, 2);
+    mps->initialize(mps_info);
+    mps->random_canonicalize();
+
+    mps->save_mutable();
+    mps->deallocate();
+    mps_info->save_mutable();
+    mps_info->deallocate_mutable();
+
+    shared_ptr<MovingEnvironment<SU2>> me =
+        make_shared<MovingEnvironment<SU2>>(mpo, mps, mps, "DMRG");
+    me->init_environments(false);
+
+    vector<ubond_t> bdims = {bond_dim};
+    vector<double> noises = {1E-8, 0.0};
+    shared_ptr<DMRG<SU2>> dmrg = make_shared<DMRG<SU2>>(me, bdims, noises);
+    dmrg->iprint = 1;
+    dmrg->solve(10, true, 1E-13);
+
+    SZ targetz(target.n(), target.twos(), target.pg());
+
+    // streaming transformation
+    shared_ptr<MPS<SZ>> zmps =
+        TransUnfusedMPS<SU2, SZ>::transform(mps, "ZKET", mpo->tf->opf->cg);
+
+    // in-memory transformation
+    shared_ptr<MPS<SZ>> zmps_ref =
+        TransUnfusedMPS<SU2, SZ>::forward(make_shared<UnfusedMPS<SU2>>(mps),
+                                          "ZREF", mpo->tf->opf->cg)
+            ->finalize();
+
+    EXPECT_EQ(zmps->canonical_form, mps->canonical_form);
+    EXPECT_EQ(zmps->center, mps->center);
+    EXPECT_EQ(zmps->info->target, targetz);
+
+    shared_ptr<DeterminantTRIE<SU2>> dtrie =
+        make_shared<DeterminantTRIE<SU2>>(mps->n_sites, true);
+    shared_ptr<DeterminantTRIE<SZ>> dtriez =
+        make_shared<DeterminantTRIE<SZ>>(mps->n_sites, true);
+    shared_ptr<DeterminantTRIE<SZ>> dtriez_ref =
+        make_shared<DeterminantTRIE<SZ>>(mps->n_sites, true);
+
+    vector<uint8_t> ref = {0, 0, 0, 3, 3, 3, 3, 3, 3, 3};
+    do {
+        dtrie->push_back(ref);
+        dtriez->push_back(ref);
+        dtriez_ref->push_back(ref);
+    } while (next_permutation(ref.begin(), ref.end()));
+
+    dtrie->evaluate(make_shared<UnfusedMPS<SU2>>(mps));
+    dtriez->evaluate(make_shared<UnfusedMPS<SZ>>(zmps));
+    dtriez_ref->evaluate(make_shared<UnfusedMPS<SZ>>(zmps_ref));
+
+    for (int i = 0; i < (int)dtrie->size(); i++) {
+        EXPECT_LT(abs(abs(dtriez->vals[i]) - abs(dtrie->vals[i])), 1E-10);
+        EXPECT_LT(abs(dtriez->vals[i] - dtriez_ref->vals[i]), 1E-12);
+    }
+
+    mps_info->deallocate();
+    mpo->deallocate();
+}
+
 TEST_F(TestDETN2STO3G, TestSZ) {
     shared_ptr<FCIDUMP> fcidump = make_shared<FCIDUMP>();
     PGTypes pg = PGTypes::D2H;
@@ -192,3 +293,24 @@ TEST_F(TestDETN2STO3G, TestSU2) {
     hamil->deallocate();
     fcidump->deallocate();
 }
+
+TEST_F(TestDETN2STO3G, TestSU2ToSZ) {
+    shared_ptr<FCIDUMP> fcidump = make_shared<FCIDUMP>();
+    PGTypes pg = PGTypes::D2H;
+    string filename = "data/N2.STO3G.FCIDUMP";
+    fcidump->read(filename);
+    vector<uint8_t> orbsym = fcidump->orb_sym<uint8_t>();
+    transform(orbsym.begin(), orbsym.end(), orbsym.begin(),
+              PointGroup::swap_pg(pg));
+
+    SU2 vacuum(0);
+    SU2 target(fcidump->n_elec(), fcidump->twos(),
+               PointGroup::swap_pg(pg)(fcidump->isym()));
+    shared_ptr<HamiltonianQC<SU2>> hamil = make_shared<HamiltonianQC<SU2>>(
+        vacuum, fcidump->n_sites(), orbsym, fcidump);
+
+    test_su2_to_sz(target, hamil);
+
+    hamil->deallocate();
+    fcidump->deallocate();
+}
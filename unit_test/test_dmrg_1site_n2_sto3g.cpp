@@ -14,7 +14,8 @@ class TestOneSiteDMRGN2STO3G : public ::testing::Test {
     void test_dmrg(const vector<vector<S>> &targets,
                    const vector<vector<double>> &energies,
                    const shared_ptr<HamiltonianQC<S>> &hamil,
-                   const string &name, DecompositionTypes dt, NoiseTypes nt);
+                   const string &name, DecompositionTypes dt, NoiseTypes nt,
+                   bool expansion = false);
     void SetUp() override {
         cout << "BOND INTEGER SIZE = " << sizeof(ubond_t) << endl;
         Random::rand_seed(0);
@@ -37,7 +38,7 @@ template <typename S>
 void TestOneSiteDMRGN2STO3G::test_dmrg(
     const vector<vector<S>> &targets, const vector<vector<double>> &energies,
     const shared_ptr<HamiltonianQC<S>> &hamil, const string &name,
-    DecompositionTypes dt, NoiseTypes nt) {
+    DecompositionTypes dt, NoiseTypes nt, bool expansion) {
     Timer t;
     t.get_time();
     // MPO construction
@@ -93,6 +94,7 @@ void TestOneSiteDMRGN2STO3G::test_dmrg(
             dmrg->iprint = 0;
             dmrg->decomp_type = dt;
             dmrg->noise_type = nt;
+            dmrg->subspace_expansion = expansion;
             dmrg->davidson_soft_max_iter = 4000;
             double energy = dmrg->solve(10, mps->center == 0, 1E-8);
 
@@ -172,6 +174,9 @@ TEST_F(TestOneSiteDMRGN2STO3G, TestSU2) {
                    NoiseTypes::ReducedPerturbative);
     test_dmrg<SU2>(targets, energies, hamil, "SU2 SVD RED PERT",
                    DecompositionTypes::SVD, NoiseTypes::ReducedPerturbative);
+    test_dmrg<SU2>(targets, energies, hamil, "SU2 RED PERT 3S",
+                   DecompositionTypes::DensityMatrix,
+                   NoiseTypes::ReducedPerturbative, true);
 
     hamil->deallocate();
     fcidump->deallocate();
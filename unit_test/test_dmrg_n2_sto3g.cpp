@@ -1,6 +1,7 @@
 
 #include "block2_core.hpp"
 #include "block2_dmrg.hpp"
+#include "perf_gate.hpp"
 #include <gtest/gtest.h>
 
 using namespace block2;
@@ -14,7 +15,8 @@ class TestDMRGN2STO3G : public ::testing::Test {
     void test_dmrg(const vector<vector<S>> &targets,
                    const vector<vector<double>> &energies,
                    const shared_ptr<HamiltonianQC<S>> &hamil,
-                   const string &name, DecompositionTypes dt, NoiseTypes nt);
+                   const string &name, DecompositionTypes dt, NoiseTypes nt,
+                   size_t noise_stream_memory = 0);
     void SetUp() override {
         cout << "BOND INTEGER SIZE = " << sizeof(ubond_t) << endl;
         Random::rand_seed(0);
@@ -39,7 +41,7 @@ void TestDMRGN2STO3G::test_dmrg(const vector<vector<S>> &targets,
                                 const vector<vector<double>> &energies,
                                 const shared_ptr<HamiltonianQC<S>> &hamil,
                                 const string &name, DecompositionTypes dt,
-                                NoiseTypes nt) {
+                                NoiseTypes nt, size_t noise_stream_memory) {
     Timer t;
     t.get_time();
     // MPO construction
@@ -95,6 +97,7 @@ void TestDMRGN2STO3G::test_dmrg(const vector<vector<S>> &targets,
             dmrg->iprint = 0;
             dmrg->decomp_type = dt;
             dmrg->noise_type = nt;
+            dmrg->noise_stream_memory = noise_stream_memory;
             dmrg->davidson_soft_max_iter = 4000;
             double energy = dmrg->solve(10, mps->center == 0, 1E-8);
 
@@ -180,6 +183,44 @@ TEST_F(TestDMRGN2STO3G, TestSU2) {
     test_dmrg<SU2>(targets, energies, hamil, "SU2 SVD RED PERT LM",
                    DecompositionTypes::SVD,
                    NoiseTypes::ReducedPerturbativeLowMem);
+    test_dmrg<SU2>(targets, energies, hamil, "SU2 RED PERT STREAM",
+                   DecompositionTypes::DensityMatrix,
+                   NoiseTypes::ReducedPerturbative, 1000);
+    test_dmrg<SU2>(targets, energies, hamil, "SU2 RED PERT LM STREAM",
+                   DecompositionTypes::DensityMatrix,
+                   NoiseTypes::ReducedPerturbativeLowMem, 1000);
+
+    hamil->deallocate();
+    fcidump->deallocate();
+}
+
+TEST_F(TestDMRGN2STO3G, TestTimedSU2) {
+    if (!PerfGate::instance().enabled())
+        return;
+
+    shared_ptr<FCIDUMP> fcidump = make_shared<FCIDUMP>();
+    PGTypes pg = PGTypes::D2H;
+    string filename = "data/N2.STO3G.FCIDUMP";
+    fcidump->read(filename);
+    vector<uint8_t> orbsym = fcidump->orb_sym<uint8_t>();
+    transform(orbsym.begin(), orbsym.end(), orbsym.begin(),
+              PointGroup::swap_pg(pg));
+
+    vector<vector<SU2>> targets = {{SU2(fcidump->n_elec(), 0, 0)}};
+    vector<vector<double>> energies = {{-107.654122447525}};
+
+    int norb = fcidump->n_sites();
+    shared_ptr<HamiltonianQC<SU2>> hamil =
+        make_shared<HamiltonianQC<SU2>>(SU2(0), norb, orbsym, fcidump);
+
+    PerfGate::instance().run(
+        "dmrg_n2_sto3g_su2",
+        [&]() {
+            test_dmrg<SU2>(targets, energies, hamil, "SU2 TIMED",
+                           DecompositionTypes::DensityMatrix,
+                           NoiseTypes::DensityMatrix);
+        },
+        1);
 
     hamil->deallocate();
     fcidump->deallocate();
@@ -255,3 +296,1040 @@ TEST_F(TestDMRGN2STO3G, TestSZ) {
     hamil->deallocate();
     fcidump->deallocate();
 }
+
+static int n_restart_test_sites = 0;
+
+TEST_F(TestDMRGN2STO3G, TestSU2SiteRestart) {
+
+    shared_ptr<FCIDUMP> fcidump = make_shared<FCIDUMP>();
+    PGTypes pg = PGTypes::D2H;
+    string filename = "data/N2.STO3G.FCIDUMP";
+    fcidump->read(filename);
+    vector<uint8_t> orbsym = fcidump->orb_sym<uint8_t>();
+    transform(orbsym.begin(), orbsym.end(), orbsym.begin(),
+              PointGroup::swap_pg(pg));
+
+    SU2 vacuum(0);
+    SU2 target(fcidump->n_elec(), 0, 0);
+    double energy_std = -107.654122447525;
+
+    int norb = fcidump->n_sites();
+    shared_ptr<HamiltonianQC<SU2>> hamil =
+        make_shared<HamiltonianQC<SU2>>(vacuum, norb, orbsym, fcidump);
+
+    shared_ptr<MPO<SU2>> mpo =
+        make_shared<MPOQC<SU2>>(hamil, QCTypes::Conventional);
+    mpo = make_shared<SimplifiedMPO<SU2>>(
+        mpo, make_shared<RuleQC<SU2>>(), true, true,
+        OpNamesSet({OpNames::R, OpNames::RD}));
+
+    ubond_t bond_dim = 200;
+    vector<ubond_t> bdims = {bond_dim};
+    vector<double> noises = {1E-8, 1E-9, 0.0};
+    string restart_dir = frame_()->save_dir + "/site-restart";
+    frame_()->restart_dir_site = restart_dir;
+    frame_()->restart_site_interval = 2;
+
+    shared_ptr<MPSInfo<SU2>> mps_info = make_shared<MPSInfo<SU2>>(
+        hamil->n_sites, hamil->vacuum, target, hamil->basis);
+    mps_info->set_bond_dimension(bond_dim);
+    shared_ptr<MPS<SU2>> mps = make_shared<MPS<SU2>>(hamil->n_sites, 0, 2);
+    mps->initialize(mps_info);
+    mps->random_canonicalize();
+    mps->save_mutable();
+    mps->deallocate();
+    mps_info->save_mutable();
+    mps_info->deallocate_mutable();
+
+    shared_ptr<MovingEnvironment<SU2>> me =
+        make_shared<MovingEnvironment<SU2>>(mpo, mps, mps, "DMRG");
+    me->init_environments(false);
+    me->delayed_contraction = OpNamesSet::normal_ops();
+    me->cached_contraction = true;
+
+    // interrupt the second sweep in the middle
+    shared_ptr<DMRG<SU2>> dmrg = make_shared<DMRG<SU2>>(me, bdims, noises);
+    dmrg->iprint = 0;
+    dmrg->davidson_soft_max_iter = 4000;
+    n_restart_test_sites = 0;
+    check_signal_() = []() {
+        if (++n_restart_test_sites == 14)
+            throw runtime_error("interrupted");
+    };
+    EXPECT_THROW(dmrg->solve(10, true, 1E-8), runtime_error);
+    check_signal_() = []() {};
+    frame_()->wait_save_files();
+    mps_info->deallocate();
+
+    // resume from the last checkpoint
+    mps_info = make_shared<MPSInfo<SU2>>(hamil->n_sites, hamil->vacuum,
+                                         target, hamil->basis);
+    mps = make_shared<MPS<SU2>>(mps_info);
+    string mps_dir = frame_()->mps_dir;
+    frame_()->mps_dir = restart_dir;
+    mps->load_data();
+    mps->load_mutable();
+    mps_info->load_mutable();
+    frame_()->mps_dir = mps_dir;
+    mps->save_mutable();
+    mps->deallocate();
+    mps_info->save_mutable();
+    mps_info->deallocate_mutable();
+
+    me = make_shared<MovingEnvironment<SU2>>(mpo, mps, mps, "DMRG");
+    me->delayed_contraction = OpNamesSet::normal_ops();
+    me->cached_contraction = true;
+    me->load_environments(restart_dir);
+
+    dmrg = make_shared<DMRG<SU2>>(me, bdims, noises);
+    dmrg->iprint = 0;
+    dmrg->davidson_soft_max_iter = 4000;
+    EXPECT_TRUE(dmrg->load_site_restart(restart_dir));
+    EXPECT_EQ(dmrg->restart_sweep, 1);
+    double energy = dmrg->solve(10, true, 1E-8);
+    frame_()->restart_dir_site = "";
+
+    mps_info->deallocate();
+    mpo->deallocate();
+
+    EXPECT_LT(abs(energy - energy_std), 1E-7);
+
+    hamil->deallocate();
+    fcidump->deallocate();
+}
+
+TEST_F(TestDMRGN2STO3G, TestSU2SweepRestart) {
+
+    shared_ptr<FCIDUMP> fcidump = make_shared<FCIDUMP>();
+    PGTypes pg = PGTypes::D2H;
+    string filename = "data/N2.STO3G.FCIDUMP";
+    fcidump->read(filename);
+    vector<uint8_t> orbsym = fcidump->orb_sym<uint8_t>();
+    transform(orbsym.begin(), orbsym.end(), orbsym.begin(),
+              PointGroup::swap_pg(pg));
+
+    SU2 vacuum(0);
+    SU2 target(fcidump->n_elec(), 0, 0);
+    double energy_std = -107.654122447525;
+
+    int norb = fcidump->n_sites();
+    shared_ptr<HamiltonianQC<SU2>> hamil =
+        make_shared<HamiltonianQC<SU2>>(vacuum, norb, orbsym, fcidump);
+
+    shared_ptr<MPO<SU2>> mpo =
+        make_shared<MPOQC<SU2>>(hamil, QCTypes::Conventional);
+    mpo = make_shared<SimplifiedMPO<SU2>>(
+        mpo, make_shared<RuleQC<SU2>>(), true, true,
+        OpNamesSet({OpNames::R, OpNames::RD}));
+
+    ubond_t bond_dim = 200;
+    vector<ubond_t> bdims = {bond_dim};
+    vector<double> noises = {1E-8, 1E-9, 0.0};
+    string restart_dir = frame_()->save_dir + "/sweep-restart";
+    frame_()->restart_dir = restart_dir;
+
+    shared_ptr<MPSInfo<SU2>> mps_info = make_shared<MPSInfo<SU2>>(
+        hamil->n_sites, hamil->vacuum, target, hamil->basis);
+    mps_info->set_bond_dimension(bond_dim);
+    shared_ptr<MPS<SU2>> mps = make_shared<MPS<SU2>>(hamil->n_sites, 0, 2);
+    mps->initialize(mps_info);
+    mps->random_canonicalize();
+    mps->save_mutable();
+    mps->deallocate();
+    mps_info->save_mutable();
+    mps_info->deallocate_mutable();
+
+    shared_ptr<MovingEnvironment<SU2>> me =
+        make_shared<MovingEnvironment<SU2>>(mpo, mps, mps, "DMRG");
+    me->reuse_environments = true;
+    me->init_environments(false);
+    me->delayed_contraction = OpNamesSet::normal_ops();
+    me->cached_contraction = true;
+
+    // first two sweeps of the schedule
+    shared_ptr<DMRG<SU2>> dmrg = make_shared<DMRG<SU2>>(me, bdims, noises);
+    dmrg->iprint = 0;
+    dmrg->davidson_soft_max_iter = 4000;
+    dmrg->solve(2, true, 0);
+    vector<vector<double>> energies = dmrg->energies;
+    mps_info->deallocate();
+
+    // resume at the third sweep
+    mps_info = make_shared<MPSInfo<SU2>>(hamil->n_sites, hamil->vacuum,
+                                         target, hamil->basis);
+    mps = make_shared<MPS<SU2>>(mps_info);
+    string mps_dir = frame_()->mps_dir;
+    frame_()->mps_dir = restart_dir;
+    mps->load_data();
+    mps->load_mutable();
+    mps_info->load_mutable();
+    frame_()->mps_dir = mps_dir;
+    mps->save_mutable();
+    mps->deallocate();
+    mps_info->save_mutable();
+    mps_info->deallocate_mutable();
+
+    me = make_shared<MovingEnvironment<SU2>>(mpo, mps, mps, "DMRG");
+    me->reuse_environments = true;
+    me->init_environments(false);
+    me->delayed_contraction = OpNamesSet::normal_ops();
+    me->cached_contraction = true;
+
+    dmrg = make_shared<DMRG<SU2>>(me, bdims, noises);
+    dmrg->iprint = 0;
+    dmrg->davidson_soft_max_iter = 4000;
+    EXPECT_EQ(dmrg->load_sweep_restart(frame_()->save_dir), -1);
+    EXPECT_EQ(dmrg->load_sweep_restart(restart_dir), 2);
+    EXPECT_EQ(dmrg->forward, true);
+    EXPECT_TRUE(dmrg->energies == energies);
+    string progress_filename = frame_()->save_dir + "/progress.jsonl";
+    dmrg->progress_filename = progress_filename;
+    double energy = dmrg->solve(10, true, 1E-8);
+    EXPECT_GT(dmrg->energies.size(), 2);
+    EXPECT_TRUE(dmrg->energies[1] == energies[1]);
+    // one progress record for each resumed sweep
+    ifstream ifs(progress_filename.c_str());
+    vector<string> records;
+    for (string line; getline(ifs, line);)
+        records.push_back(line);
+    ifs.close();
+    EXPECT_EQ(records.size(), dmrg->energies.size() - 2);
+    EXPECT_NE(records[0].find("\"sweep\": 2,"), string::npos);
+    frame_()->restart_dir = "";
+
+    mps_info->deallocate();
+    mpo->deallocate();
+
+    EXPECT_LT(abs(energy - energy_std), 1E-7);
+
+    hamil->deallocate();
+    fcidump->deallocate();
+}
+
+TEST_F(TestDMRGN2STO3G, TestSU2ReuseEnvironments) {
+
+    shared_ptr<FCIDUMP> fcidump = make_shared<FCIDUMP>();
+    PGTypes pg = PGTypes::D2H;
+    string filename = "data/N2.STO3G.FCIDUMP";
+    fcidump->read(filename);
+    vector<uint8_t> orbsym = fcidump->orb_sym<uint8_t>();
+    transform(orbsym.begin(), orbsym.end(), orbsym.begin(),
+              PointGroup::swap_pg(pg));
+
+    SU2 vacuum(0);
+    SU2 target(fcidump->n_elec(), 0, 0);
+    double energy_std = -107.654122447525;
+
+    int norb = fcidump->n_sites();
+    shared_ptr<HamiltonianQC<SU2>> hamil =
+        make_shared<HamiltonianQC<SU2>>(vacuum, norb, orbsym, fcidump);
+
+    shared_ptr<MPO<SU2>> mpo =
+        make_shared<MPOQC<SU2>>(hamil, QCTypes::Conventional);
+    mpo = make_shared<SimplifiedMPO<SU2>>(
+        mpo, make_shared<RuleQC<SU2>>(), true, true,
+        OpNamesSet({OpNames::R, OpNames::RD}));
+
+    ubond_t bond_dim = 200;
+    vector<ubond_t> bdims = {bond_dim};
+    vector<double> noises = {1E-8, 1E-9, 0.0};
+    frame_()->minimal_disk_usage = false;
+
+    shared_ptr<MPSInfo<SU2>> mps_info = make_shared<MPSInfo<SU2>>(
+        hamil->n_sites, hamil->vacuum, target, hamil->basis);
+    mps_info->set_bond_dimension(bond_dim);
+    shared_ptr<MPS<SU2>> mps = make_shared<MPS<SU2>>(hamil->n_sites, 0, 2);
+    mps->initialize(mps_info);
+    mps->random_canonicalize();
+    mps->save_mutable();
+    mps->deallocate();
+    mps_info->save_mutable();
+    mps_info->deallocate_mutable();
+
+    shared_ptr<MovingEnvironment<SU2>> me =
+        make_shared<MovingEnvironment<SU2>>(mpo, mps, mps, "DMRG");
+    me->reuse_environments = true;
+    me->init_environments(false);
+    me->delayed_contraction = OpNamesSet::normal_ops();
+    me->cached_contraction = true;
+
+    shared_ptr<DMRG<SU2>> dmrg = make_shared<DMRG<SU2>>(me, bdims, noises);
+    dmrg->iprint = 0;
+    dmrg->davidson_soft_max_iter = 4000;
+    double energy = dmrg->solve(10, true, 1E-8);
+    EXPECT_LT(abs(energy - energy_std), 1E-7);
+
+    // all blocks on disk match the converged mps
+    me = make_shared<MovingEnvironment<SU2>>(mpo, mps, mps, "DMRG");
+    me->reuse_environments = true;
+    me->init_environments(false);
+    EXPECT_EQ(me->tctr + me->trot, 0.0);
+    me->delayed_contraction = OpNamesSet::normal_ops();
+    me->cached_contraction = true;
+
+    dmrg = make_shared<DMRG<SU2>>(me, bdims, vector<double>{0.0});
+    dmrg->iprint = 0;
+    dmrg->davidson_soft_max_iter = 4000;
+    energy = dmrg->solve(1, mps->center == 0, 1E-8);
+    EXPECT_LT(abs(energy - energy_std), 1E-7);
+
+    // the blocks are shared with environments of other tags
+    me = make_shared<MovingEnvironment<SU2>>(mpo, mps, mps, "EXPECT");
+    me->reuse_environments = true;
+    me->init_environments(false);
+    EXPECT_EQ(me->tctr + me->trot, 0.0);
+
+    shared_ptr<Expect<SU2>> expect =
+        make_shared<Expect<SU2>>(me, bond_dim, bond_dim);
+    expect->iprint = 0;
+    energy = expect->solve(false, mps->center == 0);
+    EXPECT_LT(abs(energy - energy_std), 1E-7);
+
+    mps_info->deallocate();
+    mpo->deallocate();
+    hamil->deallocate();
+    fcidump->deallocate();
+}
+
+TEST_F(TestDMRGN2STO3G, TestSU2Extrapolation) {
+
+    shared_ptr<FCIDUMP> fcidump = make_shared<FCIDUMP>();
+    PGTypes pg = PGTypes::D2H;
+    string filename = "data/N2.STO3G.FCIDUMP";
+    fcidump->read(filename);
+    vector<uint8_t> orbsym = fcidump->orb_sym<uint8_t>();
+    transform(orbsym.begin(), orbsym.end(), orbsym.begin(),
+              PointGroup::swap_pg(pg));
+
+    SU2 vacuum(0);
+    SU2 target(fcidump->n_elec(), 0, 0);
+    double energy_std = -107.654122447525;
+
+    int norb = fcidump->n_sites();
+    shared_ptr<HamiltonianQC<SU2>> hamil =
+        make_shared<HamiltonianQC<SU2>>(vacuum, norb, orbsym, fcidump);
+
+    shared_ptr<MPO<SU2>> mpo =
+        make_shared<MPOQC<SU2>>(hamil, QCTypes::Conventional);
+    mpo = make_shared<SimplifiedMPO<SU2>>(
+        mpo, make_shared<RuleQC<SU2>>(), true, true,
+        OpNamesSet({OpNames::R, OpNames::RD}));
+
+    ubond_t bond_dim = 200;
+    vector<ubond_t> bdims = {bond_dim};
+    vector<double> noises = {1E-8, 1E-9, 0.0};
+
+    shared_ptr<MPSInfo<SU2>> mps_info = make_shared<MPSInfo<SU2>>(
+        hamil->n_sites, hamil->vacuum, target, hamil->basis);
+    mps_info->set_bond_dimension(bond_dim);
+    shared_ptr<MPS<SU2>> mps = make_shared<MPS<SU2>>(hamil->n_sites, 0, 2);
+    mps->initialize(mps_info);
+    mps->random_canonicalize();
+    mps->save_mutable();
+    mps->deallocate();
+    mps_info->save_mutable();
+    mps_info->deallocate_mutable();
+
+    shared_ptr<MovingEnvironment<SU2>> me =
+        make_shared<MovingEnvironment<SU2>>(mpo, mps, mps, "DMRG");
+    me->init_environments(false);
+    me->delayed_contraction = OpNamesSet::normal_ops();
+    me->cached_contraction = true;
+
+    shared_ptr<DMRG<SU2>> dmrg = make_shared<DMRG<SU2>>(me, bdims, noises);
+    dmrg->iprint = 0;
+    dmrg->davidson_soft_max_iter = 4000;
+    dmrg->extrapolation_bond_dims = vector<ubond_t>{12, 8, 6};
+    double energy = dmrg->solve(10, true, 1E-8);
+    EXPECT_LT(abs(energy - energy_std), 1E-7);
+
+    ASSERT_EQ(dmrg->extrapolation_energies.size(), 3);
+    for (int i = 0; i < 3; i++) {
+        EXPECT_GT(dmrg->extrapolation_discarded_weights[i], 0.0);
+        EXPECT_GT(dmrg->extrapolation_energies[i], energy_std);
+    }
+    EXPECT_GT(dmrg->extrapolation_slope, 0.0);
+    EXPECT_LT(abs(dmrg->extrapolated_energy - energy_std),
+              abs(dmrg->extrapolation_energies[0] - energy_std));
+
+    mps_info->deallocate();
+    mpo->deallocate();
+    hamil->deallocate();
+    fcidump->deallocate();
+}
+
+TEST_F(TestDMRGN2STO3G, TestSU2Screening) {
+
+    shared_ptr<FCIDUMP> fcidump = make_shared<FCIDUMP>();
+    PGTypes pg = PGTypes::D2H;
+    string filename = "data/N2.STO3G.FCIDUMP";
+    fcidump->read(filename);
+    vector<uint8_t> orbsym = fcidump->orb_sym<uint8_t>();
+    transform(orbsym.begin(), orbsym.end(), orbsym.begin(),
+              PointGroup::swap_pg(pg));
+
+    SU2 vacuum(0);
+    SU2 target(fcidump->n_elec(), 0, 0);
+    double energy_std = -107.654122447525;
+
+    int norb = fcidump->n_sites();
+    shared_ptr<HamiltonianQC<SU2>> hamil =
+        make_shared<HamiltonianQC<SU2>>(vacuum, norb, orbsym, fcidump);
+
+    shared_ptr<MPO<SU2>> mpo =
+        make_shared<MPOQC<SU2>>(hamil, QCTypes::Conventional);
+    mpo = make_shared<SimplifiedMPO<SU2>>(
+        mpo, make_shared<RuleQC<SU2>>(), true, true,
+        OpNamesSet({OpNames::R, OpNames::RD}));
+
+    ubond_t bond_dim = 200;
+    vector<ubond_t> bdims = {bond_dim};
+    vector<double> noises = {1E-8, 1E-9, 0.0};
+
+    shared_ptr<MPSInfo<SU2>> mps_info = make_shared<MPSInfo<SU2>>(
+        hamil->n_sites, hamil->vacuum, target, hamil->basis);
+    mps_info->set_bond_dimension(bond_dim);
+    shared_ptr<MPS<SU2>> mps = make_shared<MPS<SU2>>(hamil->n_sites, 0, 2);
+    mps->initialize(mps_info);
+    mps->random_canonicalize();
+    mps->save_mutable();
+    mps->deallocate();
+    mps_info->save_mutable();
+    mps_info->deallocate_mutable();
+
+    shared_ptr<MovingEnvironment<SU2>> me =
+        make_shared<MovingEnvironment<SU2>>(mpo, mps, mps, "DMRG");
+    me->screening_cutoff = 1E-12;
+    me->init_environments(false);
+    me->delayed_contraction = OpNamesSet::normal_ops();
+    me->cached_contraction = true;
+
+    shared_ptr<DMRG<SU2>> dmrg = make_shared<DMRG<SU2>>(me, bdims, noises);
+    dmrg->iprint = 0;
+    dmrg->davidson_soft_max_iter = 4000;
+    double energy = dmrg->solve(10, true, 1E-8);
+
+    size_t n_dropped = 0;
+    for (int i = 0; i < me->n_sites; i++) {
+        if (me->envs[i]->left != nullptr)
+            for (auto &p : me->envs[i]->left->ops)
+                n_dropped += p.second->factor == 0.0;
+        if (me->envs[i]->right != nullptr)
+            for (auto &p : me->envs[i]->right->ops)
+                n_dropped += p.second->factor == 0.0;
+    }
+    EXPECT_GT(n_dropped, 0);
+
+    mps_info->deallocate();
+    mpo->deallocate();
+
+    EXPECT_LT(abs(energy - energy_std), 1E-7);
+
+    hamil->deallocate();
+    fcidump->deallocate();
+}
+
+TEST_F(TestDMRGN2STO3G, TestSU2IntegralCutoff) {
+
+    shared_ptr<FCIDUMP> fcidump = make_shared<FCIDUMP>();
+    PGTypes pg = PGTypes::D2H;
+    string filename = "data/N2.STO3G.FCIDUMP";
+    fcidump->read(filename);
+    vector<uint8_t> orbsym = fcidump->orb_sym<uint8_t>();
+    transform(orbsym.begin(), orbsym.end(), orbsym.begin(),
+              PointGroup::swap_pg(pg));
+
+    SU2 vacuum(0);
+    SU2 target(fcidump->n_elec(), 0, 0);
+    double energy_std = -107.654122447525;
+
+    int norb = fcidump->n_sites();
+    shared_ptr<HamiltonianQC<SU2>> hamil =
+        make_shared<HamiltonianQC<SU2>>(vacuum, norb, orbsym, fcidump);
+
+    size_t n_ops_ref = 0, n_ops = 0;
+    shared_ptr<MPO<SU2>> mpo =
+        make_shared<MPOQC<SU2>>(hamil, QCTypes::Conventional);
+    mpo = make_shared<SimplifiedMPO<SU2>>(
+        mpo, make_shared<RuleQC<SU2>>(), true, true,
+        OpNamesSet({OpNames::R, OpNames::RD}));
+    for (int i = 0; i < norb; i++)
+        n_ops_ref += mpo->left_operator_names[i]->data.size() +
+                     mpo->right_operator_names[i]->data.size();
+    mpo->deallocate();
+
+    pair<size_t, double> pdrop = hamil->set_v_cutoff(1E-2);
+    cout << "dropped = " << pdrop.first << " norm = " << pdrop.second << endl;
+    EXPECT_GT(pdrop.first, 0);
+    EXPECT_GT(pdrop.second, 0.0);
+
+    mpo = make_shared<MPOQC<SU2>>(hamil, QCTypes::Conventional);
+    mpo = make_shared<SimplifiedMPO<SU2>>(
+        mpo, make_shared<RuleQC<SU2>>(), true, true,
+        OpNamesSet({OpNames::R, OpNames::RD}));
+    for (int i = 0; i < norb; i++)
+        n_ops += mpo->left_operator_names[i]->data.size() +
+                 mpo->right_operator_names[i]->data.size();
+    cout << "operators = " << n_ops << " / " << n_ops_ref << endl;
+    EXPECT_LT(n_ops, n_ops_ref);
+
+    ubond_t bond_dim = 200;
+    vector<ubond_t> bdims = {bond_dim};
+    vector<double> noises = {1E-8, 1E-9, 0.0};
+
+    shared_ptr<MPSInfo<SU2>> mps_info = make_shared<MPSInfo<SU2>>(
+        hamil->n_sites, hamil->vacuum, target, hamil->basis);
+    mps_info->set_bond_dimension(bond_dim);
+    shared_ptr<MPS<SU2>> mps = make_shared<MPS<SU2>>(hamil->n_sites, 0, 2);
+    mps->initialize(mps_info);
+    mps->random_canonicalize();
+    mps->save_mutable();
+    mps->deallocate();
+    mps_info->save_mutable();
+    mps_info->deallocate_mutable();
+
+    shared_ptr<MovingEnvironment<SU2>> me =
+        make_shared<MovingEnvironment<SU2>>(mpo, mps, mps, "DMRG");
+    me->init_environments(false);
+
+    shared_ptr<DMRG<SU2>> dmrg = make_shared<DMRG<SU2>>(me, bdims, noises);
+    dmrg->iprint = 0;
+    double energy = dmrg->solve(10, true, 1E-8);
+    cout << "E = " << fixed << setw(22) << setprecision(12) << energy
+         << " error = " << scientific << setprecision(3) << setw(10)
+         << (energy - energy_std) << endl;
+
+    mps_info->deallocate();
+    mpo->deallocate();
+
+    EXPECT_LT(abs(energy - energy_std), pdrop.second);
+
+    hamil->deallocate();
+    fcidump->deallocate();
+}
+
+TEST_F(TestDMRGN2STO3G, TestSU2LazyMPO) {
+
+    shared_ptr<FCIDUMP> fcidump = make_shared<FCIDUMP>();
+    PGTypes pg = PGTypes::D2H;
+    string filename = "data/N2.STO3G.FCIDUMP";
+    fcidump->read(filename);
+    vector<uint8_t> orbsym = fcidump->orb_sym<uint8_t>();
+    transform(orbsym.begin(), orbsym.end(), orbsym.begin(),
+              PointGroup::swap_pg(pg));
+
+    SU2 vacuum(0);
+    SU2 target(fcidump->n_elec(), 0, 0);
+    double energy_std = -107.654122447525;
+
+    int norb = fcidump->n_sites();
+    shared_ptr<HamiltonianQC<SU2>> hamil =
+        make_shared<HamiltonianQC<SU2>>(vacuum, norb, orbsym, fcidump);
+
+    shared_ptr<MPO<SU2>> mpo =
+        make_shared<MPOQC<SU2>>(hamil, QCTypes::Conventional);
+    mpo = make_shared<SimplifiedMPO<SU2>>(
+        mpo, make_shared<RuleQC<SU2>>(), true, true,
+        OpNamesSet({OpNames::R, OpNames::RD}));
+    string mpo_filename = frame_()->save_dir + "/LAZY.MPO";
+    mpo->save_data(mpo_filename);
+
+    shared_ptr<MPO<SU2>> lmpo = make_shared<MPO<SU2>>(0);
+    lmpo->load_data(mpo_filename, true);
+    lmpo->tf = mpo->tf;
+    EXPECT_EQ(lmpo->n_sites, mpo->n_sites);
+    EXPECT_EQ(lmpo->schemer->left_trans_site, mpo->schemer->left_trans_site);
+    EXPECT_EQ(lmpo->basis.size(), mpo->basis.size());
+    for (int i = 0; i < norb; i++) {
+        EXPECT_TRUE(lmpo->tensors[i] == nullptr);
+        EXPECT_TRUE(lmpo->left_operator_names[i] == nullptr);
+        lmpo->load_left_operators(i);
+        lmpo->load_tensor(i);
+        EXPECT_EQ(lmpo->left_operator_names[i]->data.size(),
+                  mpo->left_operator_names[i]->data.size());
+        EXPECT_EQ(lmpo->tensors[i]->ops.size(), mpo->tensors[i]->ops.size());
+        lmpo->unload_tensor(i);
+        lmpo->unload_left_operators(i);
+    }
+    mpo->deallocate();
+
+    ubond_t bond_dim = 200;
+    vector<ubond_t> bdims = {bond_dim};
+    vector<double> noises = {1E-8, 1E-9, 0.0};
+
+    shared_ptr<MPSInfo<SU2>> mps_info = make_shared<MPSInfo<SU2>>(
+        hamil->n_sites, hamil->vacuum, target, hamil->basis);
+    mps_info->set_bond_dimension(bond_dim);
+    shared_ptr<MPS<SU2>> mps = make_shared<MPS<SU2>>(hamil->n_sites, 0, 2);
+    mps->initialize(mps_info);
+    mps->random_canonicalize();
+    mps->save_mutable();
+    mps->deallocate();
+    mps_info->save_mutable();
+    mps_info->deallocate_mutable();
+
+    shared_ptr<MovingEnvironment<SU2>> me =
+        make_shared<MovingEnvironment<SU2>>(lmpo, mps, mps, "DMRG");
+    me->init_environments(false);
+
+    shared_ptr<DMRG<SU2>> dmrg = make_shared<DMRG<SU2>>(me, bdims, noises);
+    dmrg->iprint = 0;
+    double energy = dmrg->solve(10, true, 1E-8);
+
+    mps_info->deallocate();
+    lmpo->deallocate();
+
+    EXPECT_LT(abs(energy - energy_std), 1E-7);
+
+    hamil->deallocate();
+    fcidump->deallocate();
+}
+
+TEST_F(TestDMRGN2STO3G, TestSU2ArchivedMPO) {
+
+    // archived operators are released right after use
+    threading_()->seq_type = SeqTypes::None;
+
+    shared_ptr<FCIDUMP> fcidump = make_shared<FCIDUMP>();
+    PGTypes pg = PGTypes::D2H;
+    string filename = "data/N2.STO3G.FCIDUMP";
+    fcidump->read(filename);
+    vector<uint8_t> orbsym = fcidump->orb_sym<uint8_t>();
+    transform(orbsym.begin(), orbsym.end(), orbsym.begin(),
+              PointGroup::swap_pg(pg));
+
+    SU2 vacuum(0);
+    SU2 target(fcidump->n_elec(), 0, 0);
+    double energy_std = -107.654122447525;
+
+    int norb = fcidump->n_sites();
+    shared_ptr<HamiltonianQC<SU2>> hamil =
+        make_shared<HamiltonianQC<SU2>>(vacuum, norb, orbsym, fcidump);
+
+    // small bounds for exercising the waiting paths
+    archive_io_() = make_shared<ArchiveIO>((size_t)1 << 16, 4);
+
+    shared_ptr<MPO<SU2>> mpo =
+        make_shared<MPOQC<SU2>>(hamil, QCTypes::Conventional);
+    mpo = make_shared<SimplifiedMPO<SU2>>(
+        mpo, make_shared<RuleQC<SU2>>(), true, true,
+        OpNamesSet({OpNames::R, OpNames::RD}));
+    mpo = make_shared<ArchivedMPO<SU2>>(mpo);
+
+    ubond_t bond_dim = 200;
+    vector<ubond_t> bdims = {bond_dim};
+    vector<double> noises = {1E-8, 1E-9, 0.0};
+
+    shared_ptr<MPSInfo<SU2>> mps_info = make_shared<MPSInfo<SU2>>(
+        hamil->n_sites, hamil->vacuum, target, hamil->basis);
+    mps_info->set_bond_dimension(bond_dim);
+    shared_ptr<MPS<SU2>> mps = make_shared<MPS<SU2>>(hamil->n_sites, 0, 2);
+    mps->initialize(mps_info);
+    mps->random_canonicalize();
+    mps->save_mutable();
+    mps->deallocate();
+    mps_info->save_mutable();
+    mps_info->deallocate_mutable();
+
+    shared_ptr<MovingEnvironment<SU2>> me =
+        make_shared<MovingEnvironment<SU2>>(mpo, mps, mps, "DMRG");
+    me->init_environments(false);
+
+    shared_ptr<DMRG<SU2>> dmrg = make_shared<DMRG<SU2>>(me, bdims, noises);
+    dmrg->iprint = 0;
+    double energy = dmrg->solve(10, true, 1E-8);
+
+    archive_io_() = nullptr;
+    mps_info->deallocate();
+    mpo->deallocate();
+
+    EXPECT_LT(abs(energy - energy_std), 1E-7);
+
+    hamil->deallocate();
+    fcidump->deallocate();
+}
+
+TEST_F(TestDMRGN2STO3G, TestSU2StreamMPO) {
+
+    shared_ptr<FCIDUMP> fcidump = make_shared<FCIDUMP>();
+    PGTypes pg = PGTypes::D2H;
+    string filename = "data/N2.STO3G.FCIDUMP";
+    fcidump->read(filename);
+    vector<uint8_t> orbsym = fcidump->orb_sym<uint8_t>();
+    transform(orbsym.begin(), orbsym.end(), orbsym.begin(),
+              PointGroup::swap_pg(pg));
+
+    SU2 vacuum(0);
+    SU2 target(fcidump->n_elec(), 0, 0);
+    double energy_std = -107.654122447525;
+
+    int norb = fcidump->n_sites();
+    shared_ptr<HamiltonianQC<SU2>> hamil =
+        make_shared<HamiltonianQC<SU2>>(vacuum, norb, orbsym, fcidump);
+
+    shared_ptr<MPO<SU2>> mpo_ref =
+        make_shared<MPOQC<SU2>>(hamil, QCTypes::Conventional);
+    mpo_ref = make_shared<SimplifiedMPO<SU2>>(
+        mpo_ref, make_shared<RuleQC<SU2>>(), true);
+
+    shared_ptr<MPO<SU2>> mpo = make_shared<MPOQC<SU2>>(
+        hamil, QCTypes::Conventional, -1,
+        frame_()->save_dir + "/STREAM.MPO");
+    for (int i = 0; i < norb; i++)
+        EXPECT_TRUE(mpo->tensors[i] == nullptr);
+    mpo = make_shared<SimplifiedMPO<SU2>>(mpo, make_shared<RuleQC<SU2>>(),
+                                          true);
+    for (int i = 0; i < norb; i++) {
+        EXPECT_TRUE(mpo->tensors[i] == nullptr);
+        EXPECT_TRUE(mpo->left_operator_names[i] == nullptr);
+        EXPECT_TRUE(mpo->right_operator_exprs[i] == nullptr);
+        mpo->load_left_operators(i);
+        mpo->load_right_operators(i);
+        EXPECT_EQ(mpo->left_operator_names[i]->data.size(),
+                  mpo_ref->left_operator_names[i]->data.size());
+        EXPECT_EQ(mpo->right_operator_names[i]->data.size(),
+                  mpo_ref->right_operator_names[i]->data.size());
+        EXPECT_EQ(mpo->left_operator_exprs[i]->data.size(),
+                  mpo_ref->left_operator_exprs[i]->data.size());
+        mpo->unload_left_operators(i);
+        mpo->unload_right_operators(i);
+    }
+    mpo_ref->deallocate();
+
+    ubond_t bond_dim = 200;
+    vector<ubond_t> bdims = {bond_dim};
+    vector<double> noises = {1E-8, 1E-9, 0.0};
+
+    shared_ptr<MPSInfo<SU2>> mps_info = make_shared<MPSInfo<SU2>>(
+        hamil->n_sites, hamil->vacuum, target, hamil->basis);
+    mps_info->set_bond_dimension(bond_dim);
+    shared_ptr<MPS<SU2>> mps = make_shared<MPS<SU2>>(hamil->n_sites, 0, 2);
+    mps->initialize(mps_info);
+    mps->random_canonicalize();
+    mps->save_mutable();
+    mps->deallocate();
+    mps_info->save_mutable();
+    mps_info->deallocate_mutable();
+
+    shared_ptr<MovingEnvironment<SU2>> me =
+        make_shared<MovingEnvironment<SU2>>(mpo, mps, mps, "DMRG");
+    me->init_environments(false);
+
+    shared_ptr<DMRG<SU2>> dmrg = make_shared<DMRG<SU2>>(me, bdims, noises);
+    dmrg->iprint = 0;
+    double energy = dmrg->solve(10, true, 1E-8);
+
+    mps_info->deallocate();
+    mpo->deallocate();
+
+    EXPECT_LT(abs(energy - energy_std), 1E-7);
+
+    hamil->deallocate();
+    fcidump->deallocate();
+}
+
+TEST_F(TestDMRGN2STO3G, TestSU2CompiledMultiply) {
+
+    shared_ptr<FCIDUMP> fcidump = make_shared<FCIDUMP>();
+    PGTypes pg = PGTypes::D2H;
+    string filename = "data/N2.STO3G.FCIDUMP";
+    fcidump->read(filename);
+    vector<uint8_t> orbsym = fcidump->orb_sym<uint8_t>();
+    transform(orbsym.begin(), orbsym.end(), orbsym.begin(),
+              PointGroup::swap_pg(pg));
+
+    SU2 vacuum(0);
+    SU2 target(fcidump->n_elec(), 0, 0);
+
+    int norb = fcidump->n_sites();
+    shared_ptr<HamiltonianQC<SU2>> hamil =
+        make_shared<HamiltonianQC<SU2>>(vacuum, norb, orbsym, fcidump);
+
+    shared_ptr<MPO<SU2>> mpo =
+        make_shared<MPOQC<SU2>>(hamil, QCTypes::Conventional);
+    mpo = make_shared<SimplifiedMPO<SU2>>(mpo, make_shared<RuleQC<SU2>>(),
+                                          true);
+    mpo->tf->opf->seq->mode = SeqTypes::None;
+
+    ubond_t bond_dim = 200;
+    shared_ptr<MPSInfo<SU2>> mps_info = make_shared<MPSInfo<SU2>>(
+        hamil->n_sites, hamil->vacuum, target, hamil->basis);
+    mps_info->set_bond_dimension(bond_dim);
+    shared_ptr<MPS<SU2>> mps = make_shared<MPS<SU2>>(hamil->n_sites, 0, 2);
+    mps->initialize(mps_info);
+    mps->random_canonicalize();
+    mps->save_mutable();
+    mps->deallocate();
+    mps_info->save_mutable();
+    mps_info->deallocate_mutable();
+
+    shared_ptr<MovingEnvironment<SU2>> me =
+        make_shared<MovingEnvironment<SU2>>(mpo, mps, mps, "DMRG");
+    me->init_environments(false);
+    me->move_to(0);
+    mps->load_tensor(0);
+
+    shared_ptr<EffectiveHamiltonian<SU2>> h_eff = me->eff_ham(
+        FuseTypes::FuseLR, true, false, mps->tensors[0], mps->tensors[0]);
+    MatrixRef b(mps->tensors[0]->data, (MKL_INT)mps->tensors[0]->total_memory,
+                1);
+    MatrixRef cx(nullptr, b.m, 1), cy(nullptr, b.m, 1);
+    cx.allocate();
+    cy.allocate();
+    cx.clear();
+    cy.clear();
+    (*h_eff)(b, cx);
+    EXPECT_EQ(h_eff->programs.size(), 1);
+    EXPECT_TRUE(h_eff->programs.at(0) != nullptr);
+    EXPECT_GT(h_eff->programs.at(0)->instrs.size(), 0);
+    EffectiveHamiltonian<SU2>::compiled_multiply() = false;
+    (*h_eff)(b, cy);
+    EffectiveHamiltonian<SU2>::compiled_multiply() = true;
+    double max_diff = 0;
+    for (MKL_INT i = 0; i < b.m; i++)
+        max_diff = max(max_diff, abs(cx.data[i] - cy.data[i]));
+    EXPECT_GT(MatrixFunctions::norm(cy), 1E-3);
+    EXPECT_LT(max_diff, 1E-12);
+    cy.deallocate();
+    cx.deallocate();
+    h_eff->deallocate();
+    mps->unload_tensor(0);
+
+    mps_info->deallocate();
+    mpo->deallocate();
+    hamil->deallocate();
+    fcidump->deallocate();
+}
+
+TEST_F(TestDMRGN2STO3G, TestSU2PooledMPO) {
+
+    shared_ptr<FCIDUMP> fcidump = make_shared<FCIDUMP>();
+    PGTypes pg = PGTypes::D2H;
+    string filename = "data/N2.STO3G.FCIDUMP";
+    fcidump->read(filename);
+    vector<uint8_t> orbsym = fcidump->orb_sym<uint8_t>();
+    transform(orbsym.begin(), orbsym.end(), orbsym.begin(),
+              PointGroup::swap_pg(pg));
+
+    SU2 vacuum(0);
+
+    int norb = fcidump->n_sites();
+    shared_ptr<HamiltonianQC<SU2>> hamil =
+        make_shared<HamiltonianQC<SU2>>(vacuum, norb, orbsym, fcidump);
+
+    shared_ptr<MPO<SU2>> mpo =
+        make_shared<MPOQC<SU2>>(hamil, QCTypes::Conventional);
+    mpo = make_shared<SimplifiedMPO<SU2>>(mpo, make_shared<RuleQC<SU2>>(),
+                                          true);
+    string mpo_filename = frame_()->save_dir + "/POOLED.MPO";
+    mpo->save_data(mpo_filename);
+
+    shared_ptr<MPO<SU2>> lmpo = make_shared<MPO<SU2>>(0);
+    lmpo->load_data(mpo_filename);
+    EXPECT_TRUE(lmpo->op_pool == nullptr);
+    EXPECT_EQ(lmpo->get_blocking_formulas(), mpo->get_blocking_formulas());
+
+    // equal elements of all loaded symbolics are one shared object
+    size_t n_elems = 0;
+    unordered_map<OpElement<SU2>, OpElement<SU2> *> uniq;
+    bool shared = true;
+    for (int i = 0; i < norb; i++)
+        for (auto &x : lmpo->left_operator_exprs[i]->data)
+            if (x->get_type() == OpTypes::Sum)
+                for (auto &p :
+                     dynamic_pointer_cast<OpSum<SU2>>(x)->strings)
+                    for (auto &a : {p->a, p->b})
+                        if (a != nullptr) {
+                            n_elems++;
+                            auto it = uniq.emplace(*a, a.get()).first;
+                            shared = shared && (it->second == a.get() ||
+                                                it->second->q_label !=
+                                                    a->q_label);
+                        }
+    EXPECT_TRUE(shared);
+    EXPECT_LT(uniq.size(), n_elems);
+
+    lmpo->tf = mpo->tf;
+    for (int i = 0; i < norb; i++)
+        EXPECT_EQ(lmpo->tensors[i]->ops.size(), mpo->tensors[i]->ops.size());
+    mpo->deallocate();
+    lmpo->deallocate();
+    hamil->deallocate();
+    fcidump->deallocate();
+}
+
+TEST_F(TestDMRGN2STO3G, TestSU2DiagonalPreconditioner) {
+
+    shared_ptr<FCIDUMP> fcidump = make_shared<FCIDUMP>();
+    PGTypes pg = PGTypes::D2H;
+    string filename = "data/N2.STO3G.FCIDUMP";
+    fcidump->read(filename);
+    vector<uint8_t> orbsym = fcidump->orb_sym<uint8_t>();
+    transform(orbsym.begin(), orbsym.end(), orbsym.begin(),
+              PointGroup::swap_pg(pg));
+
+    SU2 vacuum(0);
+    SU2 target(fcidump->n_elec(), 0, 0);
+    double energy_std = -107.654122447525;
+
+    int norb = fcidump->n_sites();
+    shared_ptr<HamiltonianQC<SU2>> hamil =
+        make_shared<HamiltonianQC<SU2>>(vacuum, norb, orbsym, fcidump);
+
+    shared_ptr<MPO<SU2>> mpo =
+        make_shared<MPOQC<SU2>>(hamil, QCTypes::Conventional);
+    mpo =
+        make_shared<SimplifiedMPO<SU2>>(mpo, make_shared<RuleQC<SU2>>(), true);
+
+    // diagonal part of H in the occupation number basis
+    shared_ptr<MPO<SU2>> dmpo = make_shared<DiagonalMPO<SU2>>(
+        make_shared<MPOQC<SU2>>(hamil, QCTypes::Conventional));
+    dmpo =
+        make_shared<SimplifiedMPO<SU2>>(dmpo, make_shared<RuleQC<SU2>>(), true);
+    size_t n_ops = 0, n_dops = 0;
+    for (int i = 0; i < norb; i++) {
+        n_ops += mpo->left_operator_names[i]->data.size();
+        n_dops += dmpo->left_operator_names[i]->data.size();
+    }
+    cout << "operators = " << n_dops << " / " << n_ops << endl;
+    EXPECT_LT(n_dops, n_ops);
+
+    ubond_t bond_dim = 200;
+    vector<ubond_t> bdims = {bond_dim};
+    vector<double> noises = {1E-8, 1E-9, 0.0};
+
+    shared_ptr<MPSInfo<SU2>> mps_info = make_shared<MPSInfo<SU2>>(
+        hamil->n_sites, hamil->vacuum, target, hamil->basis);
+    mps_info->set_bond_dimension(bond_dim);
+    shared_ptr<MPS<SU2>> mps = make_shared<MPS<SU2>>(hamil->n_sites, 0, 2);
+    mps->initialize(mps_info);
+    mps->random_canonicalize();
+    mps->save_mutable();
+    mps->deallocate();
+    mps_info->save_mutable();
+    mps_info->deallocate_mutable();
+
+    shared_ptr<MovingEnvironment<SU2>> me =
+        make_shared<MovingEnvironment<SU2>>(mpo, mps, mps, "DMRG");
+    me->init_environments(false);
+    shared_ptr<MovingEnvironment<SU2>> dme =
+        make_shared<MovingEnvironment<SU2>>(dmpo, mps, mps, "DIAG");
+    dme->init_environments(false);
+
+    shared_ptr<DMRG<SU2>> dmrg = make_shared<DMRG<SU2>>(me, bdims, noises);
+    dmrg->diag_me = dme;
+    dmrg->iprint = 0;
+    double energy = dmrg->solve(10, true, 1E-8);
+    cout << "E = " << fixed << setw(22) << setprecision(12) << energy
+         << " error = " << scientific << setprecision(3) << setw(10)
+         << (energy - energy_std) << endl;
+
+    EXPECT_LT(abs(energy - energy_std), 1E-7);
+
+    mps_info->deallocate();
+    dmpo->deallocate();
+    mpo->deallocate();
+    hamil->deallocate();
+    fcidump->deallocate();
+}
+
+TEST_F(TestDMRGN2STO3G, TestSU2TwoSiteVariance) {
+
+    shared_ptr<FCIDUMP> fcidump = make_shared<FCIDUMP>();
+    PGTypes pg = PGTypes::D2H;
+    string filename = "data/N2.STO3G.FCIDUMP";
+    fcidump->read(filename);
+    vector<uint8_t> orbsym = fcidump->orb_sym<uint8_t>();
+    transform(orbsym.begin(), orbsym.end(), orbsym.begin(),
+              PointGroup::swap_pg(pg));
+
+    SU2 vacuum(0);
+    SU2 target(fcidump->n_elec(), 0, 0);
+
+    int norb = fcidump->n_sites();
+    shared_ptr<HamiltonianQC<SU2>> hamil =
+        make_shared<HamiltonianQC<SU2>>(vacuum, norb, orbsym, fcidump);
+
+    shared_ptr<MPO<SU2>> mpo =
+        make_shared<MPOQC<SU2>>(hamil, QCTypes::Conventional);
+    mpo =
+        make_shared<SimplifiedMPO<SU2>>(mpo, make_shared<RuleQC<SU2>>(), true);
+    shared_ptr<MPO<SU2>> ntr_mpo =
+        make_shared<MPOQC<SU2>>(hamil, QCTypes::Conventional);
+    ntr_mpo = make_shared<SimplifiedMPO<SU2>>(
+        ntr_mpo,
+        make_shared<NoTransposeRule<SU2>>(make_shared<RuleQC<SU2>>()), true);
+
+    // truncated ground state
+    ubond_t bond_dim = 8, bra_bond_dim = 500;
+    vector<ubond_t> bdims = {bond_dim};
+    vector<double> noises = {1E-6, 0.0};
+
+    shared_ptr<MPSInfo<SU2>> mps_info = make_shared<MPSInfo<SU2>>(
+        hamil->n_sites, hamil->vacuum, target, hamil->basis);
+    mps_info->set_bond_dimension(bond_dim);
+    shared_ptr<MPS<SU2>> mps = make_shared<MPS<SU2>>(hamil->n_sites, 0, 2);
+    mps->initialize(mps_info);
+    mps->random_canonicalize();
+    mps->save_mutable();
+    mps->deallocate();
+    mps_info->save_mutable();
+    mps_info->deallocate_mutable();
+
+    shared_ptr<MovingEnvironment<SU2>> me =
+        make_shared<MovingEnvironment<SU2>>(mpo, mps, mps, "DMRG");
+    me->init_environments(false);
+    shared_ptr<DMRG<SU2>> dmrg = make_shared<DMRG<SU2>>(me, bdims, noises);
+    dmrg->iprint = 0;
+    dmrg->solve(10, true, 1E-10);
+
+    // two-site variance
+    shared_ptr<MovingEnvironment<SU2>> eme =
+        make_shared<MovingEnvironment<SU2>>(mpo, mps, mps, "EXPECT");
+    eme->init_environments(false);
+    double energy =
+        make_shared<Expect<SU2>>(eme, bond_dim, bond_dim)->solve(false);
+    shared_ptr<Expect<SU2>> ex =
+        make_shared<Expect<SU2>>(eme, bond_dim, bond_dim);
+    ex->compute_variance = true;
+    ex->solve(true, mps->center == 0);
+    double var2 = ex->two_site_variance;
+
+    // variance from the compressed H |psi>
+    shared_ptr<MPSInfo<SU2>> bra_info = make_shared<MPSInfo<SU2>>(
+        hamil->n_sites, hamil->vacuum, target, hamil->basis);
+    bra_info->set_bond_dimension(bra_bond_dim);
+    bra_info->tag = "BRA";
+    shared_ptr<MPS<SU2>> bra =
+        make_shared<MPS<SU2>>(hamil->n_sites, mps->center, 2);
+    bra->initialize(bra_info);
+    bra->random_canonicalize();
+    bra->save_mutable();
+    bra->deallocate();
+    bra_info->save_mutable();
+    bra_info->deallocate_mutable();
+
+    shared_ptr<MovingEnvironment<SU2>> sme =
+        make_shared<MovingEnvironment<SU2>>(ntr_mpo, bra, mps, "COMPRESS");
+    sme->init_environments(false);
+    shared_ptr<Linear<SU2>> cps = make_shared<Linear<SU2>>(
+        sme, vector<ubond_t>{bra_bond_dim}, bdims);
+    cps->iprint = 0;
+    double norm = cps->solve(10, mps->center == 0, 1E-12);
+    double var = norm * norm - energy * energy;
+
+    cout << "E = " << fixed << setw(22) << setprecision(12) << energy
+         << " VAR = " << scientific << setprecision(6) << var
+         << " 2-SITE VAR = " << var2 << endl;
+
+    EXPECT_LT(abs(ex->variance_energy - energy), 1E-8);
+    EXPECT_GT(var2, 0.0);
+    EXPECT_LT(var2, var + 1E-6);
+
+    bra_info->deallocate();
+    mps_info->deallocate();
+    ntr_mpo->deallocate();
+    mpo->deallocate();
+    hamil->deallocate();
+    fcidump->deallocate();
+}
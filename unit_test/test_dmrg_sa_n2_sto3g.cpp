@@ -198,3 +198,49 @@ TEST_F(TestDMRGN2STO3GSA, TestSZ) {
     hamil->deallocate();
     fcidump->deallocate();
 }
+
+TEST_F(TestDMRGN2STO3GSA, TestSU2NoSeq) {
+
+    // roots are multiplied as one panel by the effective Hamiltonian
+    threading_()->seq_type = SeqTypes::None;
+
+    shared_ptr<FCIDUMP> fcidump = make_shared<FCIDUMP>();
+    PGTypes pg = PGTypes::D2H;
+    string filename = "data/N2.STO3G.FCIDUMP";
+    fcidump->read(filename);
+    vector<uint8_t> orbsym = fcidump->orb_sym<uint8_t>();
+    transform(orbsym.begin(), orbsym.end(), orbsym.begin(),
+              PointGroup::swap_pg(pg));
+
+    SU2 vacuum(0);
+
+    vector<SU2> targets;
+    int ne = fcidump->n_elec() / 2;
+    for (int i = 0; i < 8; i++)
+        for (int na = ne - 1; na <= ne + 1; na++)
+            for (int nb = ne - 1; nb <= ne + 1; nb++)
+                if (na - nb >= 0)
+                    targets.push_back(SU2(na + nb, na - nb, i));
+
+    vector<double> energies = {
+        -107.654122447525, // < N=14 S=0 PG=0 >
+        -107.356943001688, // < N=14 S=1 PG=2|3 >
+        -107.356943001688, // < N=14 S=1 PG=2|3 >
+        -107.343458537273, // < N=14 S=1 PG=5 >
+        -107.319813793867, // < N=15 S=1/2 PG=2|3 >
+        -107.319813793866, // < N=15 S=1/2 PG=2|3 >
+        -107.306744734757, // < N=14 S=0 PG=2|3 >
+        -107.306744734756, // < N=14 S=0 PG=2|3 >
+        -107.279409754727, // < N=14 S=1 PG=4|5 >
+        -107.279409754727  // < N=14 S=1 PG=4|5 >
+    };
+
+    int norb = fcidump->n_sites();
+    shared_ptr<HamiltonianQC<SU2>> hamil =
+        make_shared<HamiltonianQC<SU2>>(vacuum, norb, orbsym, fcidump);
+
+    test_dmrg<SU2>(targets, energies, hamil, "SU2", 200, 10);
+
+    hamil->deallocate();
+    fcidump->deallocate();
+}
@@ -14,7 +14,8 @@ class TestDMRGUnorderedN2STO3G : public ::testing::Test {
     void test_dmrg(const vector<vector<S>> &targets,
                    const vector<vector<double>> &energies,
                    const shared_ptr<HamiltonianQC<S>> &hamil,
-                   const string &name, DecompositionTypes dt, NoiseTypes nt);
+                   const string &name, DecompositionTypes dt, NoiseTypes nt,
+                   bool balanced = false);
     void SetUp() override {
         cout << "BOND INTEGER SIZE = " << sizeof(ubond_t) << endl;
         cout << "MKL INTEGER SIZE = " << sizeof(MKL_INT) << endl;
@@ -40,7 +41,7 @@ template <typename S>
 void TestDMRGUnorderedN2STO3G::test_dmrg(
     const vector<vector<S>> &targets, const vector<vector<double>> &energies,
     const shared_ptr<HamiltonianQC<S>> &hamil, const string &name,
-    DecompositionTypes dt, NoiseTypes nt) {
+    DecompositionTypes dt, NoiseTypes nt, bool balanced) {
 
     Timer t;
     t.get_time();
@@ -101,6 +102,7 @@ void TestDMRGUnorderedN2STO3G::test_dmrg(
             dmrg->decomp_type = dt;
             dmrg->noise_type = nt;
             dmrg->davidson_soft_max_iter = 4000;
+            dmrg->conn_adjust_balanced = balanced;
             double energy = dmrg->solve(10, mps->center == 0, 1E-8);
 
             cout << "== PAR " << name << " ==" << setw(20) << target
@@ -197,6 +199,9 @@ TEST_F(TestDMRGUnorderedN2STO3G, TestSU2) {
                    NoiseTypes::ReducedPerturbative);
     test_dmrg<SU2>(targets, energies, hamil, "SU2 SVD RED PERT",
                    DecompositionTypes::SVD, NoiseTypes::ReducedPerturbative);
+    test_dmrg<SU2>(targets, energies, hamil, "SU2 BALANCED",
+                   DecompositionTypes::DensityMatrix,
+                   NoiseTypes::DensityMatrix, true);
 
     hamil->deallocate();
     fcidump->deallocate();
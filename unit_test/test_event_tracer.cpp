@@ -0,0 +1,59 @@
+
+#include "block2_core.hpp"
+#include <gtest/gtest.h>
+
+using namespace block2;
+
+class TestEventTracer : public ::testing::Test {
+  protected:
+    void SetUp() override {}
+    void TearDown() override { tracer_().stop(); }
+};
+
+TEST_F(TestEventTracer, TestThreads) {
+    EventTracer &tr = tracer_();
+    {
+        // disabled by default
+        TracerScope ts("ignored");
+    }
+    EXPECT_EQ(tr.size(), 0);
+    tr.capacity = 8;
+    tr.start();
+    {
+        TracerScope ts("outer", 7);
+        const int nt = 4;
+#pragma omp parallel for schedule(static) num_threads(nt)
+        for (int i = 0; i < nt * 2; i++)
+            TracerScope tsi("task", i);
+    }
+    // the ring buffer keeps the last 8 events of this thread
+    for (int i = 0; i < 20; i++)
+        TracerScope tsi("repeated", i);
+    tr.stop();
+    {
+        TracerScope ts("stopped");
+    }
+    // one ring per thread, the main thread keeps the last 8 of its events
+    EXPECT_EQ(tr.rings.size(), 4);
+    size_t n = 0;
+    for (auto &rg : tr.rings)
+        n += rg->n;
+    EXPECT_EQ(n, 8 + 1 + 20);
+    EXPECT_EQ(tr.size(), 8 + 3 * 2);
+    stringstream ss;
+    tr.write_json(ss, 3);
+    const string json = ss.str();
+    EXPECT_EQ(json.find("ignored"), string::npos);
+    EXPECT_EQ(json.find("stopped"), string::npos);
+    EXPECT_EQ(json.find("\"outer\""), string::npos);
+    EXPECT_NE(json.find("\"repeated\",\"ph\":\"X\",\"pid\":3"),
+              string::npos);
+    EXPECT_NE(json.find("\"arg\":19}"), string::npos);
+    EXPECT_EQ(json.find("\"arg\":11}"), string::npos);
+    EXPECT_EQ(count(json.begin(), json.end(), '{'),
+              1 + 2 * (tr.size() + tr.rings.size()));
+    // restarting clears all events
+    tr.start();
+    EXPECT_EQ(tr.size(), 0);
+    tr.stop();
+}
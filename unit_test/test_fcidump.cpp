@@ -49,6 +49,59 @@ TEST_F(TestFCIDUMP, TestRead) {
     fcidump.deallocate();
 }
 
+TEST_F(TestFCIDUMP, TestBinaryRead) {
+    FCIDUMP fcidump;
+    string filename = "data/CR2.SVP.FCIDUMP";
+    fcidump.read(filename);
+    EXPECT_FALSE(FCIDUMP::is_binary(filename));
+    string bin_filename = frame_()->save_dir + "/CR2.SVP.FCIDUMP.BIN";
+    fcidump.save_data(bin_filename);
+    EXPECT_TRUE(FCIDUMP::is_binary(bin_filename));
+    FCIDUMP bin_fcidump;
+    bin_fcidump.read(bin_filename);
+    EXPECT_TRUE(bin_fcidump.params == fcidump.params);
+    EXPECT_EQ(bin_fcidump.uhf, fcidump.uhf);
+    EXPECT_EQ(bin_fcidump.general, fcidump.general);
+    EXPECT_EQ(bin_fcidump.const_e, fcidump.const_e);
+    EXPECT_EQ(bin_fcidump.total_memory, fcidump.total_memory);
+    EXPECT_TRUE(equal(bin_fcidump.data,
+                      bin_fcidump.data + bin_fcidump.total_memory,
+                      fcidump.data));
+    EXPECT_EQ(bin_fcidump.vs[0](0, 2, 1, 1), fcidump.vs[0](1, 1, 2, 0));
+    EXPECT_EQ(bin_fcidump.ts[0](0, 3), fcidump.ts[0](3, 0));
+    bin_fcidump.deallocate();
+    fcidump.deallocate();
+}
+
+TEST_F(TestFCIDUMP, TestWrite) {
+    FCIDUMP fcidump;
+    fcidump.read("data/CR2.SVP.FCIDUMP");
+    vector<string> filenames = {"CR2.SVP.FCIDUMP.TXT", "CR2.SVP.FCIDUMP.BIN"};
+#ifdef _HAS_ZLIB
+    filenames.push_back("CR2.SVP.FCIDUMP.gz");
+#endif
+#ifdef _HAS_ZSTD
+    filenames.push_back("CR2.SVP.FCIDUMP.zst");
+#endif
+    for (size_t i = 0; i < filenames.size(); i++)
+        for (bool binary : {false, true}) {
+            string filename = frame_()->save_dir + "/" + filenames[i];
+            if (i == 0 && binary)
+                continue;
+            fcidump.write(filename, binary || i == 1);
+            FCIDUMP wfcidump;
+            wfcidump.read(filename);
+            EXPECT_TRUE(wfcidump.params == fcidump.params);
+            EXPECT_EQ(wfcidump.total_memory, fcidump.total_memory);
+            EXPECT_EQ(wfcidump.const_e, fcidump.const_e);
+            EXPECT_TRUE(equal(wfcidump.data,
+                              wfcidump.data + wfcidump.total_memory,
+                              fcidump.data));
+            wfcidump.deallocate();
+        }
+    fcidump.deallocate();
+}
+
 TEST_F(TestFCIDUMP, TestCompressedRead) {
     CompressedFCIDUMP fcidump(5E-16);
     string filename = "data/CR2.SVP.FCIDUMP";
@@ -75,3 +128,344 @@ TEST_F(TestFCIDUMP, TestCompressedRead) {
     EXPECT_EQ(fcidump.cps_vs[0](0, 2, 1, 1), fcidump.cps_vs[0](1, 1, 2, 0));
     fcidump.deallocate();
 }
+
+TEST_F(TestFCIDUMP, TestDFRead) {
+    shared_ptr<FCIDUMP> fcidump = make_shared<FCIDUMP>();
+    string filename = "data/N2.STO3G.FCIDUMP";
+    fcidump->read(filename);
+    shared_ptr<DFFCIDUMP> df_fcidump = make_shared<DFFCIDUMP>(1E-14);
+    df_fcidump->read(filename);
+    const uint16_t n = fcidump->n_sites();
+    EXPECT_EQ(df_fcidump->n_sites(), n);
+    EXPECT_LE(df_fcidump->dfs[0].n_aux, (uint32_t)n * (n + 1) / 2);
+    EXPECT_EQ(df_fcidump->e(), fcidump->e());
+    // a general linear transformation, to check rotate
+    vector<double> rot_mat((size_t)n * n);
+    for (uint16_t i = 0; i < n; i++)
+        for (uint16_t j = 0; j < n; j++)
+            rot_mat[i * n + j] = (i == j) + 0.1 * Random::rand_double(-1, 1);
+    vector<uint16_t> ord(n);
+    for (uint16_t i = 0; i < n; i++)
+        ord[i] = (i * 3 + 1) % n;
+    vector<double> vkl((size_t)n * n);
+    for (int it = 0; it < 3; it++) {
+        if (it == 1)
+            fcidump->reorder(ord), df_fcidump->reorder(ord);
+        else if (it == 2)
+            fcidump->rotate(rot_mat), df_fcidump->rotate(rot_mat);
+        for (uint16_t i = 0; i < n; i++)
+            for (uint16_t j = 0; j < n; j++) {
+                EXPECT_LT(abs(df_fcidump->t(i, j) - fcidump->t(i, j)), 1E-12);
+                df_fcidump->v_block(i, j, vkl.data());
+                for (uint16_t k = 0; k < n; k++)
+                    for (uint16_t l = 0; l < n; l++) {
+                        EXPECT_LT(abs(df_fcidump->v(i, j, k, l) -
+                                      fcidump->v(i, j, k, l)),
+                                  1E-7);
+                        EXPECT_LT(abs(vkl[k * n + l] -
+                                      df_fcidump->v(i, j, k, l)),
+                                  1E-12);
+                    }
+            }
+    }
+    shared_ptr<FCIDUMP> full_fcidump = df_fcidump->to_fcidump();
+    for (uint16_t i = 0; i < n; i++)
+        for (uint16_t j = 0; j < n; j++)
+            for (uint16_t k = 0; k < n; k++)
+                for (uint16_t l = 0; l < n; l++)
+                    EXPECT_LT(abs(full_fcidump->v(1, 0, i, j, k, l) -
+                                  df_fcidump->v(1, 0, i, j, k, l)),
+                              1E-12);
+    full_fcidump->deallocate();
+    df_fcidump->deallocate();
+    fcidump->deallocate();
+}
+
+TEST_F(TestFCIDUMP, TestCompressedBlock) {
+    shared_ptr<FCIDUMP> fcidump = make_shared<FCIDUMP>();
+    shared_ptr<CompressedFCIDUMP> cps_fcidump =
+        make_shared<CompressedFCIDUMP>(1E-13);
+    string filename = "data/CR2.SVP.FCIDUMP";
+    fcidump->read(filename);
+    cps_fcidump->read(filename);
+    const uint16_t n = fcidump->n_sites();
+    size_t n_wrong = 0;
+    int ntg = threading_()->activate_global();
+#pragma omp parallel num_threads(ntg) reduction(+ : n_wrong)
+    {
+        vector<double> vkl((size_t)n * n);
+#pragma omp for schedule(dynamic)
+        for (int i = 0; i < (int)n; i++)
+            for (uint16_t j = 0; j < n; j++) {
+                cps_fcidump->v_block((uint16_t)i, j, vkl.data());
+                for (uint16_t k = 0; k < n; k++)
+                    for (uint16_t l = 0; l < n; l++)
+                        n_wrong += vkl[k * n + l] !=
+                                       cps_fcidump->v((uint16_t)i, j, k, l) ||
+                                   abs(vkl[k * n + l] -
+                                       fcidump->v((uint16_t)i, j, k, l)) >
+                                       1E-12;
+            }
+    }
+    threading_()->activate_normal();
+    EXPECT_EQ(n_wrong, 0);
+    cps_fcidump->deallocate();
+    fcidump->deallocate();
+}
+
+TEST_F(TestFCIDUMP, TestRotateReorder) {
+    shared_ptr<FCIDUMP> fcidump = make_shared<FCIDUMP>();
+    fcidump->read("data/N2.STO3G.FCIDUMP");
+    const uint16_t n = fcidump->n_sites();
+    const size_t m = (size_t)n * (n + 1) / 2, n4 = (size_t)n * n * n * n;
+    // UHF integrals with 4-fold mixed spin part
+    vector<double> ta(m), tb(m), va(m * (m + 1) / 2), vb(va.size()), vab(m * m);
+    for (auto x : {&ta, &tb, &va, &vb, &vab})
+        for (auto &y : *x)
+            y = Random::rand_double(-1, 1);
+    shared_ptr<FCIDUMP> uhf_fcidump = make_shared<FCIDUMP>();
+    uhf_fcidump->initialize_sz(n, fcidump->n_elec(), 0, 0, 0.0, ta.data(),
+                               m, tb.data(), m, va.data(), va.size(),
+                               vb.data(), vb.size(), vab.data(), vab.size());
+    // general integrals without permutational symmetry
+    vector<double> tg((size_t)n * n), vg(n4);
+    for (auto x : {&tg, &vg})
+        for (auto &y : *x)
+            y = Random::rand_double(-1, 1);
+    shared_ptr<FCIDUMP> gen_fcidump = make_shared<FCIDUMP>();
+    gen_fcidump->initialize_su2(n, fcidump->n_elec(), 0, 0, 0.0, tg.data(),
+                                tg.size(), vg.data(), vg.size());
+    vector<double> rot_mat((size_t)n * n);
+    for (uint16_t i = 0; i < n; i++)
+        for (uint16_t j = 0; j < n; j++)
+            rot_mat[i * n + j] = (i == j) + 0.1 * Random::rand_double(-1, 1);
+    vector<uint16_t> ord(n);
+    for (uint16_t i = 0; i < n; i++)
+        ord[i] = (i * 3 + 1) % n;
+    // reference: one index at a time with plain loops
+    auto ref_rotate = [n, n4, &rot_mat](vector<double> &x) {
+        vector<double> y(n4);
+        const size_t st[4] = {(size_t)n * n * n, (size_t)n * n, (size_t)n, 1};
+        for (int d = 0; d < 4; d++) {
+            for (size_t ijkl = 0; ijkl < n4; ijkl++) {
+                const size_t p = ijkl / st[d] % n, x0 = ijkl - p * st[d];
+                y[ijkl] = 0;
+                for (uint16_t q = 0; q < n; q++)
+                    y[ijkl] += x[x0 + q * st[d]] * rot_mat[q * n + p];
+            }
+            x.swap(y);
+        }
+    };
+    for (auto &fd : {fcidump, uhf_fcidump, gen_fcidump}) {
+        const int ns = fd->uhf ? 2 : 1;
+        vector<vector<double>> vref(ns * ns, vector<double>(n4)),
+            tref(ns, vector<double>((size_t)n * n));
+        for (int sl = 0; sl < ns; sl++)
+            for (int sr = 0; sr < ns; sr++)
+                for (size_t ijkl = 0; ijkl < n4; ijkl++)
+                    vref[sl * ns + sr][ijkl] =
+                        fd->v(sl, sr, ijkl / n / n / n, ijkl / n / n % n,
+                              ijkl / n % n, ijkl % n);
+        for (int s = 0; s < ns; s++)
+            for (size_t ij = 0; ij < (size_t)n * n; ij++)
+                tref[s][ij] = fd->t(s, ij / n, ij % n);
+        shared_ptr<FCIDUMP> rd = fd->deep_copy();
+        rd->reorder(ord);
+        fd->rotate(rot_mat);
+        const vector<vector<double>> vorig = vref;
+        for (auto &x : vref)
+            ref_rotate(x);
+        for (int sl = 0; sl < ns; sl++)
+            for (int sr = 0; sr < ns; sr++)
+                for (uint16_t i = 0; i < n; i++)
+                    for (uint16_t j = 0; j < n; j++)
+                        for (uint16_t k = 0; k < n; k++)
+                            for (uint16_t l = 0; l < n; l++) {
+                                EXPECT_LT(abs(fd->v(sl, sr, i, j, k, l) -
+                                              vref[sl * ns + sr]
+                                                  [(((size_t)i * n + j) * n +
+                                                    k) * n + l]),
+                                          1E-12);
+                                EXPECT_EQ(rd->v(sl, sr, i, j, k, l),
+                                          vorig[sl * ns + sr]
+                                               [(((size_t)ord[i] * n +
+                                                  ord[j]) * n + ord[k]) * n +
+                                                ord[l]]);
+                            }
+        for (int s = 0; s < ns; s++)
+            for (uint16_t i = 0; i < n; i++)
+                for (uint16_t j = 0; j < n; j++) {
+                    double x = 0;
+                    for (uint16_t p = 0; p < n; p++)
+                        for (uint16_t q = 0; q < n; q++)
+                            x += rot_mat[p * n + i] * tref[s][p * n + q] *
+                                 rot_mat[q * n + j];
+                    EXPECT_LT(abs(fd->t(s, i, j) - x), 1E-12);
+                }
+        rd->deallocate();
+        fd->deallocate();
+    }
+}
+
+TEST_F(TestFCIDUMP, TestExpandedIntegrals) {
+    shared_ptr<FCIDUMP> fcidump = make_shared<FCIDUMP>();
+    fcidump->read("data/N2.STO3G.FCIDUMP");
+    const uint16_t n = fcidump->n_sites();
+    const size_t m = (size_t)n * (n + 1) / 2, n4 = (size_t)n * n * n * n;
+    vector<double> ta(m), tb(m), va(m * (m + 1) / 2), vb(va.size()), vab(m * m);
+    for (auto x : {&ta, &tb, &va, &vb, &vab})
+        for (auto &y : *x)
+            y = Random::rand_double(-1, 1);
+    shared_ptr<FCIDUMP> uhf_fcidump = make_shared<FCIDUMP>();
+    uhf_fcidump->initialize_sz(n, fcidump->n_elec(), 0, 0, 0.0, ta.data(),
+                               m, tb.data(), m, va.data(), va.size(),
+                               vb.data(), vb.size(), vab.data(), vab.size());
+    vector<double> tg((size_t)n * n), vg(n4);
+    for (auto x : {&tg, &vg})
+        for (auto &y : *x)
+            y = Random::rand_double(-1, 1);
+    shared_ptr<FCIDUMP> gen_fcidump = make_shared<FCIDUMP>();
+    gen_fcidump->initialize_su2(n, fcidump->n_elec(), 0, 0, 0.0, tg.data(),
+                                tg.size(), vg.data(), vg.size());
+    vector<uint8_t> iocc(n, 0);
+    for (uint16_t i = 0; i < fcidump->n_elec() / 2; i++)
+        iocc[i] = 2;
+    for (auto &fd : {fcidump, uhf_fcidump, gen_fcidump}) {
+        const double e_ref = fd->det_energy(iocc, 0, n);
+        fd->expand_integrals();
+        ASSERT_NE(fd->vexp, nullptr);
+        for (uint8_t sl = 0; sl < 2; sl++)
+            for (uint8_t sr = 0; sr < 2; sr++)
+                for (uint16_t i = 0; i < n; i++)
+                    for (uint16_t j = 0; j < n; j++)
+                        for (uint16_t k = 0; k < n; k++)
+                            for (uint16_t l = 0; l < n; l++)
+                                EXPECT_EQ((*fd->vexp)(sl, sr, i, j, k, l),
+                                          fd->v(sl, sr, i, j, k, l));
+        EXPECT_LT(abs(fd->det_energy(iocc, 0, n) - e_ref), 1E-12);
+        // expanded view is dropped when integrals change
+        vector<uint16_t> ord(n);
+        for (uint16_t i = 0; i < n; i++)
+            ord[i] = n - 1 - i;
+        fd->reorder(ord);
+        EXPECT_EQ(fd->vexp, nullptr);
+        fd->deallocate();
+    }
+}
+
+TEST_F(TestFCIDUMP, TestHubbardKSpace) {
+    const uint16_t n = 12;
+    shared_ptr<HubbardKSpaceFCIDUMP> fcidump =
+        make_shared<HubbardKSpaceFCIDUMP>(n, 1.0, 4.0);
+    // momentum-conserving iteration visits exactly the nonzero elements
+    map<array<uint16_t, 6>, double> vmap;
+    fcidump->for_each_v([&vmap](uint8_t sl, uint8_t sr, uint16_t i,
+                                uint16_t j, uint16_t k, uint16_t l, double x) {
+        vmap[array<uint16_t, 6>{sl, sr, i, j, k, l}] = x;
+    });
+    EXPECT_EQ(vmap.size(), (size_t)4 * n * n * n);
+    size_t nnz = 0;
+    vector<double> r((size_t)n * n);
+    for (uint8_t sl = 0; sl < 2; sl++)
+        for (uint8_t sr = 0; sr < 2; sr++)
+            for (uint16_t i = 0; i < n; i++)
+                for (uint16_t j = 0; j < n; j++) {
+                    fcidump->v_block(sl, sr, i, j, r.data());
+                    for (uint16_t k = 0; k < n; k++)
+                        for (uint16_t l = 0; l < n; l++) {
+                            double x = fcidump->v(sl, sr, i, j, k, l);
+                            EXPECT_EQ(r[(size_t)k * n + l], x);
+                            if (x != 0.0) {
+                                nnz++;
+                                EXPECT_EQ(
+                                    (i + n - j + k + n - l) % n, 0);
+                                EXPECT_EQ((vmap[array<uint16_t, 6>{
+                                              sl, sr, i, j, k, l}]),
+                                          x);
+                            }
+                        }
+                }
+    EXPECT_EQ(nnz, vmap.size());
+    size_t nt = 0;
+    fcidump->for_each_t([&](uint8_t s, uint16_t i, uint16_t j, double x) {
+        EXPECT_EQ(i, j);
+        EXPECT_LT(abs(x + 2.0 * cos(2 * M_PI * i / n + M_PI)), 1E-14);
+        nt++;
+    });
+    EXPECT_LE(nt, (size_t)2 * n);
+}
+
+TEST_F(TestFCIDUMP, TestFoldFrozenCore) {
+    shared_ptr<FCIDUMP> fcidump = make_shared<FCIDUMP>();
+    fcidump->read("data/N2.STO3G.FCIDUMP");
+    const uint16_t n = fcidump->n_sites(), nc = 2, na = 6;
+    const size_t m = (size_t)n * (n + 1) / 2;
+    vector<double> ta(m), tb(m), va(m * (m + 1) / 2), vb(va.size()), vab(m * m);
+    for (auto x : {&ta, &tb, &va, &vb, &vab})
+        for (auto &y : *x)
+            y = Random::rand_double(-1, 1);
+    shared_ptr<FCIDUMP> uhf_fcidump = make_shared<FCIDUMP>();
+    uhf_fcidump->initialize_sz(n, fcidump->n_elec(), 0, 0, 0.0, ta.data(),
+                               m, tb.data(), m, va.data(), va.size(),
+                               vb.data(), vb.size(), vab.data(), vab.size());
+    uhf_fcidump->params["orbsym"] = fcidump->params["orbsym"];
+    for (auto &fd : {fcidump, uhf_fcidump}) {
+        shared_ptr<FCIDUMP> fdc = fd->fold_frozen_core(nc, na);
+        EXPECT_EQ(fdc->n_sites(), na);
+        EXPECT_EQ(fdc->n_elec(), fd->n_elec() - 2 * nc);
+        EXPECT_EQ(fdc->uhf, fd->uhf);
+        vector<uint8_t> orbsym = fd->orb_sym<uint8_t>();
+        vector<uint8_t> act_orbsym = fdc->orb_sym<uint8_t>();
+        EXPECT_TRUE(equal(act_orbsym.begin(), act_orbsym.end(),
+                          orbsym.begin() + nc));
+        for (uint8_t sl = 0; sl < 2; sl++)
+            for (uint8_t sr = 0; sr < 2; sr++)
+                for (uint16_t i = 0; i < na; i++)
+                    for (uint16_t j = 0; j < na; j++)
+                        for (uint16_t k = 0; k < na; k++)
+                            for (uint16_t l = 0; l < na; l++)
+                                EXPECT_EQ(fdc->v(sl, sr, i, j, k, l),
+                                          fd->v(sl, sr, i + nc, j + nc, k + nc,
+                                                l + nc));
+        // energy of determinants with doubly occupied core
+        for (int it = 0; it < 20; it++) {
+            vector<uint8_t> occ(n * 2, 0), act_occ(na * 2);
+            for (uint16_t i = 0; i < nc * 2; i++)
+                occ[i] = 1;
+            for (uint16_t i = 0; i < na * 2; i++)
+                occ[nc * 2 + i] = act_occ[i] = Random::rand_int(0, 2);
+            EXPECT_LT(abs(fd->det_energy(occ, 0, n) + fd->e() -
+                          fdc->det_energy(act_occ, 0, na) - fdc->e()),
+                      1E-10);
+        }
+        fdc->deallocate();
+        fd->deallocate();
+    }
+}
+
+TEST_F(TestFCIDUMP, TestContentHash) {
+    FCIDUMP fcidump;
+    fcidump.read("data/N2.STO3G.FCIDUMP");
+    string bin_filename = frame_()->save_dir + "/N2.STO3G.FCIDUMP.BIN";
+    fcidump.save_data(bin_filename);
+    FCIDUMP bin_fcidump;
+    bin_fcidump.read(bin_filename);
+    // same integrals from text and binary files
+    EXPECT_EQ(bin_fcidump.content_hash(), fcidump.content_hash());
+    // electron number is not part of the hash
+    bin_fcidump.params["nelec"] = "12";
+    EXPECT_EQ(bin_fcidump.content_hash(), fcidump.content_hash());
+    bin_fcidump.ts[0](0, 0) += 1E-12;
+    EXPECT_NE(bin_fcidump.content_hash(), fcidump.content_hash());
+    bin_fcidump.ts[0](0, 0) = fcidump.ts[0](0, 0);
+    bin_fcidump.const_e += 1.0;
+    EXPECT_NE(bin_fcidump.content_hash(), fcidump.content_hash());
+    // the hash does not depend on the alignment of the data
+    string x = "abcdefghijklmnopq";
+    EXPECT_EQ(Parsing::hash_bytes(x.data() + 1, 11),
+              Parsing::hash_bytes(string(x, 1, 11).data(), 11));
+    EXPECT_NE(Parsing::hash_bytes(x.data(), 11),
+              Parsing::hash_bytes(x.data(), 12));
+    bin_fcidump.deallocate();
+    fcidump.deallocate();
+}
@@ -37,3 +37,33 @@ TEST_F(TestFFT, TestFFT) {
             ComplexMatrixRef(arx.data(), n, 1), 1E-12, 1E-5));
     }
 }
+
+TEST_F(TestFFT, TestFFTBatch) {
+    FFT fft;
+    FFT2 fft2;
+    DFT dft;
+    for (int i = 0; i < n_tests / 10; i++) {
+        int n = Random::rand_int(1, i < n_tests / 20 ? 12 : 500);
+        int n_batch = Random::rand_int(1, 5);
+        // the same instance is reused, so that cached plans are tested
+        if (i % 2 == 0)
+            fft.init(n), fft2.init(n);
+        vector<complex<double>> arr(n * n_batch), arx, ary;
+        Random::fill_rand_double((double *)arr.data(), n * n_batch * 2);
+        arx = arr, ary = arr;
+        for (int forth = 1; forth >= 0; forth--) {
+            fft.fft_batch(arx.data(), n_batch, n, forth);
+            fft2.fft_batch(ary.data(), n_batch, n, forth);
+            for (int ib = 0; ib < n_batch; ib++)
+                dft.fft(arr.data() + ib * n, n, forth);
+            ASSERT_TRUE(MatrixFunctions::all_close(
+                ComplexMatrixRef(arr.data(), n * n_batch, 1),
+                ComplexMatrixRef(arx.data(), n * n_batch, 1), 1E-12, 1E-5));
+            ASSERT_TRUE(MatrixFunctions::all_close(
+                ComplexMatrixRef(arr.data(), n * n_batch, 1),
+                ComplexMatrixRef(ary.data(), n * n_batch, 1), 1E-12, 1E-5));
+        }
+    }
+    fft.clear();
+    EXPECT_EQ(fft.plans.size(), 0);
+}
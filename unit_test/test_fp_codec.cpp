@@ -1,6 +1,7 @@
 
 #include "block2_core.hpp"
 #include "gtest/gtest.h"
+#include "perf_gate.hpp"
 
 using namespace block2;
 
@@ -35,6 +36,65 @@ TEST_F(TestFPCodec, TestDoubleFPCodec) {
     }
 }
 
+TEST_F(TestFPCodec, TestIndexedFPCodec) {
+    for (int i = 0; i < n_tests; i++) {
+        int n;
+        if (i < n_tests * 10 / 100)
+            n = Random::rand_int(1, 12);
+        else
+            n = Random::rand_int(1, 50000);
+        int chunk_size = Random::rand_int(1, 1 + n * 4 / 3);
+        vector<double> arr(n), arx(n);
+        if (Random::rand_int(0, 10) != 0)
+            Random::fill_rand_double(arr.data(), n, -5, 5);
+        FPCodec<double> fpc(1E-8, chunk_size);
+        fpc.indexed = i % 2 == 0;
+        fpc.n_parallel_chunks = Random::rand_int(1, 10);
+        stringstream ss;
+        fpc.write_array(ss, arr.data(), n);
+        fpc.write_array(ss, arr.data(), n);
+        ss.clear();
+        ss.seekg(0);
+        fpc.n_parallel_chunks = Random::rand_int(1, 10);
+        fpc.read_array(ss, arx.data(), n);
+        EXPECT_TRUE(MatrixFunctions::all_close(
+            MatrixRef(arr.data(), n, 1), MatrixRef(arx.data(), n, 1), 2E-8, 0));
+        int st = Random::rand_int(0, n), nr = Random::rand_int(0, n - st + 1);
+        vector<double> ary(nr);
+        fpc.read_array_range(ss, n, st, nr, ary.data());
+        EXPECT_TRUE(MatrixFunctions::all_close(MatrixRef(arr.data() + st, nr, 1),
+                                               MatrixRef(ary.data(), nr, 1),
+                                               2E-8, 0));
+        EXPECT_EQ((size_t)ss.tellg(), ss.str().length());
+    }
+}
+
+TEST_F(TestFPCodec, TestMemoryFPCodec) {
+    for (int i = 0; i < n_tests; i++) {
+        int n;
+        if (i < n_tests * 10 / 100)
+            n = Random::rand_int(1, 12);
+        else
+            n = Random::rand_int(1, 50000);
+        int chunk_size = Random::rand_int(1, 1 + n * 4 / 3);
+        vector<double> arr(n), arx(n), cpsd;
+        if (Random::rand_int(0, 10) != 0)
+            Random::fill_rand_double(arr.data(), n, -5, 5);
+        // zero precision is lossless
+        FPCodec<double> fpc(i % 2 == 0 ? 1E-8 : 0.0, chunk_size);
+        size_t cplen = fpc.encode_array(arr.data(), n, cpsd);
+        EXPECT_LE(cplen, cpsd.size());
+        cpsd.resize(cplen);
+        fpc.decode_array(cpsd.data(), n, arx.data());
+        if (i % 2 == 0)
+            EXPECT_TRUE(MatrixFunctions::all_close(MatrixRef(arr.data(), n, 1),
+                                                   MatrixRef(arx.data(), n, 1),
+                                                   2E-8, 0));
+        else
+            EXPECT_EQ(arr, arx);
+    }
+}
+
 TEST_F(TestFPCodec, TestFloatFPCodec) {
     for (int i = 0; i < n_tests; i++) {
         int n;
@@ -146,3 +206,21 @@ TEST_F(TestFPCodec, TestFloatCompressedVector) {
         }
     }
 }
+
+TEST_F(TestFPCodec, TestTimedDoubleFPCodec) {
+    if (!PerfGate::instance().enabled())
+        return;
+    const int n = 1 << 22;
+    vector<double> arr(n), arx(n);
+    Random::fill_rand_double(arr.data(), n, -5, 5);
+    FPCodec<double> fpc(1E-8, 1024);
+    PerfGate::instance().run("fp_codec_double", [&]() {
+        stringstream ss;
+        fpc.write_array(ss, arr.data(), n);
+        ss.clear();
+        ss.seekg(0);
+        fpc.read_array(ss, arx.data(), n);
+    });
+    EXPECT_TRUE(MatrixFunctions::all_close(
+        MatrixRef(arr.data(), n, 1), MatrixRef(arx.data(), n, 1), 2E-8, 0));
+}
@@ -260,3 +260,144 @@ TEST_F(TestFusedMPON2STO3G, TestSZ) {
     hamil->deallocate();
     fcidump->deallocate();
 }
+
+TEST_F(TestFusedMPON2STO3G, TestSU2AutoFusion) {
+    shared_ptr<FCIDUMP> fcidump = make_shared<FCIDUMP>();
+    PGTypes pg = PGTypes::D2H;
+    string filename = "data/N2.STO3G.FCIDUMP";
+    fcidump->read(filename);
+    vector<uint8_t> orbsym = fcidump->orb_sym<uint8_t>();
+    transform(orbsym.begin(), orbsym.end(), orbsym.begin(),
+              PointGroup::swap_pg(pg));
+
+    SU2 vacuum(0);
+    SU2 target(fcidump->n_elec(), 0, 0);
+    double energy_std = -107.654122447525;
+
+    int norb = fcidump->n_sites();
+    shared_ptr<HamiltonianQC<SU2>> hamil =
+        make_shared<HamiltonianQC<SU2>>(vacuum, norb, orbsym, fcidump);
+
+    ubond_t bond_dim = 200;
+    shared_ptr<MPO<SU2>> mpo =
+        make_shared<MPOQC<SU2>>(hamil, QCTypes::Conventional);
+    shared_ptr<MPSInfo<SU2>> fusing_mps_info = make_shared<MPSInfo<SU2>>(
+        hamil->n_sites, hamil->vacuum, target, hamil->basis);
+
+    int n_extl, n_extr;
+    tie(n_extl, n_extr) = FusedMPO<SU2>::plan_edge_fusion(
+        mpo, fusing_mps_info, bond_dim, (size_t)1 << 24);
+    cout << "FUSING PLAN = " << n_extl << " " << n_extr << endl;
+    EXPECT_GT(n_extl, 1);
+    EXPECT_GT(n_extr, 1);
+    EXPECT_GE(norb - n_extl - n_extr + 2, 4);
+
+    // a tight storage limit disables fusion
+    pair<int, int> no_fusing =
+        FusedMPO<SU2>::plan_edge_fusion(mpo, fusing_mps_info, bond_dim, 1);
+    EXPECT_EQ(no_fusing.first, 1);
+    EXPECT_EQ(no_fusing.second, 1);
+
+    mpo = FusedMPO<SU2>::fuse_edges(mpo, hamil->basis, n_extl, n_extr,
+                                    fusing_mps_info);
+    hamil->n_sites = mpo->n_sites;
+    fusing_mps_info->deallocate();
+    EXPECT_EQ(mpo->n_sites, norb - n_extl - n_extr + 2);
+
+    mpo = make_shared<SimplifiedMPO<SU2>>(mpo, make_shared<RuleQC<SU2>>(),
+                                          true);
+
+    vector<ubond_t> bdims = {bond_dim};
+    vector<double> noises = {1E-8, 1E-9, 0.0};
+
+    shared_ptr<MPSInfo<SU2>> mps_info = make_shared<MPSInfo<SU2>>(
+        hamil->n_sites, hamil->vacuum, target, hamil->basis);
+    mps_info->set_bond_dimension(bond_dim);
+    shared_ptr<MPS<SU2>> mps = make_shared<MPS<SU2>>(hamil->n_sites, 0, 2);
+    mps->initialize(mps_info);
+    mps->random_canonicalize();
+    mps->save_mutable();
+    mps->deallocate();
+    mps_info->save_mutable();
+    mps_info->deallocate_mutable();
+
+    shared_ptr<MovingEnvironment<SU2>> me =
+        make_shared<MovingEnvironment<SU2>>(mpo, mps, mps, "DMRG");
+    me->init_environments(false);
+
+    shared_ptr<DMRG<SU2>> dmrg = make_shared<DMRG<SU2>>(me, bdims, noises);
+    dmrg->iprint = 0;
+    double energy = dmrg->solve(10, mps->center == 0, 1E-8);
+    cout << "E = " << fixed << setw(22) << setprecision(12) << energy
+         << " error = " << scientific << setprecision(3) << setw(10)
+         << (energy - energy_std) << endl;
+    EXPECT_LT(abs(energy - energy_std), 1E-7);
+
+    mps_info->deallocate();
+    mpo->deallocate();
+}
+
+TEST_F(TestFusedMPON2STO3G, TestSU2AutoSparse) {
+    shared_ptr<FCIDUMP> fcidump = make_shared<FCIDUMP>();
+    PGTypes pg = PGTypes::D2H;
+    string filename = "data/N2.STO3G.FCIDUMP";
+    fcidump->read(filename);
+    vector<uint8_t> orbsym = fcidump->orb_sym<uint8_t>();
+    transform(orbsym.begin(), orbsym.end(), orbsym.begin(),
+              PointGroup::swap_pg(pg));
+
+    SU2 vacuum(0);
+    SU2 target(fcidump->n_elec(), 0, 0);
+    double energy_std = -107.654122447525;
+
+    int norb = fcidump->n_sites();
+    shared_ptr<HamiltonianQC<SU2>> hamil =
+        make_shared<HamiltonianQC<SU2>>(vacuum, norb, orbsym, fcidump);
+
+    ubond_t bond_dim = 200;
+    shared_ptr<MPO<SU2>> mpo =
+        make_shared<MPOQC<SU2>>(hamil, QCTypes::Conventional);
+    mpo = FusedMPO<SU2>::fuse_edges(mpo, hamil->basis, 4, 4);
+    hamil->n_sites = mpo->n_sites;
+
+    size_t n_csr = mpo->auto_sparse_form(0.9);
+    cout << "SPARSE FORM = " << mpo->sparse_form << " N_CSR = " << n_csr
+         << endl;
+    EXPECT_GT(n_csr, 0);
+    EXPECT_EQ(mpo->sparse_form[0], 'S');
+    EXPECT_EQ(mpo->sparse_form[mpo->n_sites - 1], 'S');
+    EXPECT_NE(mpo->sparse_form.find('N'), string::npos);
+    EXPECT_EQ(mpo->tf->opf->get_type(), SparseMatrixTypes::CSR);
+
+    mpo = make_shared<SimplifiedMPO<SU2>>(mpo, make_shared<RuleQC<SU2>>(),
+                                          true);
+
+    vector<ubond_t> bdims = {bond_dim};
+    vector<double> noises = {1E-8, 1E-9, 0.0};
+
+    shared_ptr<MPSInfo<SU2>> mps_info = make_shared<MPSInfo<SU2>>(
+        hamil->n_sites, hamil->vacuum, target, hamil->basis);
+    mps_info->set_bond_dimension(bond_dim);
+    shared_ptr<MPS<SU2>> mps = make_shared<MPS<SU2>>(hamil->n_sites, 0, 2);
+    mps->initialize(mps_info);
+    mps->random_canonicalize();
+    mps->save_mutable();
+    mps->deallocate();
+    mps_info->save_mutable();
+    mps_info->deallocate_mutable();
+
+    shared_ptr<MovingEnvironment<SU2>> me =
+        make_shared<MovingEnvironment<SU2>>(mpo, mps, mps, "DMRG");
+    me->init_environments(false);
+
+    shared_ptr<DMRG<SU2>> dmrg = make_shared<DMRG<SU2>>(me, bdims, noises);
+    dmrg->iprint = 0;
+    double energy = dmrg->solve(10, mps->center == 0, 1E-8);
+    cout << "E = " << fixed << setw(22) << setprecision(12) << energy
+         << " error = " << scientific << setprecision(3) << setw(10)
+         << (energy - energy_std) << endl;
+    EXPECT_LT(abs(energy - energy_std), 1E-7);
+
+    mps_info->deallocate();
+    mpo->deallocate();
+}
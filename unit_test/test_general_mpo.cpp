@@ -0,0 +1,121 @@
+
+#include "block2_core.hpp"
+#include "block2_dmrg.hpp"
+#include <gtest/gtest.h>
+
+using namespace block2;
+
+class TestGeneralMPON2STO3G : public ::testing::Test {
+  protected:
+    size_t isize = 1L << 24;
+    size_t dsize = 1L << 32;
+    void SetUp() override {
+        Random::rand_seed(0);
+        frame_() = make_shared<DataFrame>(isize, dsize, "nodex");
+        frame_()->use_main_stack = false;
+        frame_()->minimal_disk_usage = true;
+        threading_() = make_shared<Threading>(
+            ThreadingTypes::OperatorBatchedGEMM | ThreadingTypes::Global, 8, 8,
+            1);
+        threading_()->seq_type = SeqTypes::Tasked;
+        cout << *threading_() << endl;
+    }
+    void TearDown() override {
+        frame_()->activate(0);
+        assert(ialloc_()->used == 0 && dalloc_()->used == 0);
+        frame_() = nullptr;
+    }
+};
+
+TEST_F(TestGeneralMPON2STO3G, TestSZ) {
+    shared_ptr<FCIDUMP> fcidump = make_shared<FCIDUMP>();
+    PGTypes pg = PGTypes::D2H;
+    string filename = "data/N2.STO3G.FCIDUMP";
+    fcidump->read(filename);
+    vector<uint8_t> orbsym = fcidump->orb_sym<uint8_t>();
+    transform(orbsym.begin(), orbsym.end(), orbsym.begin(),
+              PointGroup::swap_pg(pg));
+
+    SZ vacuum(0);
+    SZ target(fcidump->n_elec(), 0, 0);
+    double energy_std = -107.654122447525;
+
+    int norb = fcidump->n_sites();
+    shared_ptr<HamiltonianQC<SZ>> hamil =
+        make_shared<HamiltonianQC<SZ>>(vacuum, norb, orbsym, fcidump);
+
+    // H = sum t_ij C_is D_js + 1/2 sum v_ijkl C_is C_kt D_lt D_js
+    vector<string> exprs;
+    vector<vector<uint16_t>> sites;
+    vector<vector<uint8_t>> spins;
+    vector<double> coeffs;
+    for (uint16_t i = 0; i < norb; i++)
+        for (uint16_t j = 0; j < norb; j++)
+            for (uint8_t s = 0; s < 2; s++) {
+                exprs.push_back("CD");
+                sites.push_back({i, j});
+                spins.push_back({s, s});
+                coeffs.push_back(fcidump->t(s, i, j));
+            }
+    for (uint16_t i = 0; i < norb; i++)
+        for (uint16_t j = 0; j < norb; j++)
+            for (uint16_t k = 0; k < norb; k++)
+                for (uint16_t l = 0; l < norb; l++)
+                    for (uint8_t s = 0; s < 2; s++)
+                        for (uint8_t t = 0; t < 2; t++) {
+                            exprs.push_back("CCDD");
+                            sites.push_back({i, k, l, j});
+                            spins.push_back({s, t, t, s});
+                            coeffs.push_back(0.5 *
+                                             fcidump->v(s, t, i, j, k, l));
+                        }
+
+    Timer tx;
+    tx.get_time();
+    shared_ptr<MPO<SZ>> mpo = make_shared<GeneralMPO<SZ>>(
+        hamil, exprs, sites, spins, coeffs, 1E-13, fcidump->e());
+    cout << "MPO end .. T = " << tx.get_time() << endl;
+    shared_ptr<MPO<SZ>> mpo_qc =
+        make_shared<MPOQC<SZ>>(hamil, QCTypes::Conventional);
+    for (int i = 0; i < norb - 1; i++) {
+        cout << "BOND " << setw(4) << i << " GENERAL = " << setw(6)
+             << mpo->left_operator_names[i]->data.size()
+             << " QC = " << setw(6)
+             << mpo_qc->left_operator_names[i]->data.size() << endl;
+        EXPECT_LE(mpo->left_operator_names[i]->data.size(),
+                  mpo_qc->left_operator_names[i]->data.size());
+    }
+    mpo_qc->deallocate();
+
+    mpo = make_shared<SimplifiedMPO<SZ>>(mpo, make_shared<Rule<SZ>>(), true);
+
+    ubond_t bond_dim = 200;
+    vector<ubond_t> bdims = {bond_dim};
+    vector<double> noises = {1E-8, 1E-9, 0.0};
+
+    shared_ptr<MPSInfo<SZ>> mps_info =
+        make_shared<MPSInfo<SZ>>(norb, vacuum, target, hamil->basis);
+    mps_info->set_bond_dimension(bond_dim);
+    shared_ptr<MPS<SZ>> mps = make_shared<MPS<SZ>>(norb, 0, 2);
+    mps->initialize(mps_info);
+    mps->random_canonicalize();
+    mps->save_mutable();
+    mps->deallocate();
+    mps_info->save_mutable();
+    mps_info->deallocate_mutable();
+
+    shared_ptr<MovingEnvironment<SZ>> me =
+        make_shared<MovingEnvironment<SZ>>(mpo, mps, mps, "DMRG");
+    me->init_environments(false);
+    shared_ptr<DMRG<SZ>> dmrg = make_shared<DMRG<SZ>>(me, bdims, noises);
+    dmrg->iprint = 0;
+    double energy = dmrg->solve(10, mps->center == 0, 1E-8);
+    cout << "E = " << fixed << setw(22) << setprecision(12) << energy
+         << " error = " << scientific << setprecision(3) << setw(10)
+         << (energy - energy_std) << endl;
+    EXPECT_LT(abs(energy - energy_std), 1E-7);
+
+    mps_info->deallocate();
+    mpo->deallocate();
+    hamil->deallocate();
+}
@@ -14,6 +14,16 @@ class TestMatrix : public ::testing::Test {
             MatrixFunctions::multiply(a, false, b, false, c, 1.0, 0.0);
         }
     };
+    struct PanelMatMul : MatMul {
+        int n_panel = 0, n_mult = 0;
+        PanelMatMul(const MatrixRef &a) : MatMul(a) {}
+        void multiply_panel(const vector<MatrixRef> &bs,
+                            const vector<MatrixRef> &cs) {
+            n_panel++, n_mult += (int)bs.size();
+            for (size_t i = 0; i < bs.size(); i++)
+                (*this)(bs[i], cs[i]);
+        }
+    };
     size_t isize = 1L << 24;
     size_t dsize = 1L << 28;
     void SetUp() override {
@@ -169,6 +179,66 @@ TEST_F(TestMatrix, TestThreeRotate) {
     }
 }
 
+TEST_F(TestMatrix, TestTiledThreeRotate) {
+    shared_ptr<BatchGEMMSeq> seq = make_shared<BatchGEMMSeq>(0, SeqTypes::None);
+    const int sz = 100;
+    const size_t tile_size = MatrixFunctions::rotate_tile_size();
+    for (int i = 0; i < n_tests; i++) {
+        MatrixFunctions::rotate_tile_size() = Random::rand_int(1, 2000);
+        MKL_INT ii = Random::rand_int(0, 2);
+        bool ll = Random::rand_int(0, 2);
+        MKL_INT mda = Random::rand_int(1, sz), nda = Random::rand_int(1, sz);
+        MKL_INT mdb = Random::rand_int(1, sz), ndb = Random::rand_int(1, sz);
+        MKL_INT mx = Random::rand_int(1, sz), nx = Random::rand_int(1, sz);
+        if (ii == 0)
+            mda = nda = 1;
+        else
+            mdb = ndb = 1;
+        MKL_INT mdc = mda * mdb, ndc = nda * ndb;
+        bool conjk = Random::rand_int(0, 2), conjb = Random::rand_int(0, 2);
+        MatrixRef da(dalloc_()->allocate(mda * nda), mda, nda);
+        MatrixRef db(dalloc_()->allocate(mdb * ndb), mdb, ndb);
+        MatrixRef dc(dalloc_()->allocate(mdc * ndc), mdc, ndc);
+        MatrixRef x(dalloc_()->allocate(mx * nx), mx, nx);
+        MKL_INT mb = ll ? mdc : mx, nb = ll ? ndc : nx;
+        MKL_INT mk = ll ? mx : mdc, nk = ll ? nx : ndc;
+        MatrixRef a(dalloc_()->allocate(nb * mk), nb, mk);
+        MatrixRef c(dalloc_()->allocate(mb * nk), mb, nk);
+        MatrixRef cc(dalloc_()->allocate(mb * nk), mb, nk);
+        Random::fill_rand_double(da.data, da.size());
+        Random::fill_rand_double(db.data, db.size());
+        Random::fill_rand_double(x.data, x.size());
+        Random::fill_rand_double(a.data, a.size());
+        if (conjb)
+            ll ? (dc = dc.flip_dims()) : (x = x.flip_dims());
+        if (conjk)
+            !ll ? (dc = dc.flip_dims()) : (x = x.flip_dims());
+        if (ll ? conjb : conjk)
+            da = da.flip_dims(), db = db.flip_dims();
+        dc.clear();
+        MatrixFunctions::tensor_product(da, false, db, false, dc, 1.0, 0);
+        // reference without tiles
+        c.clear(), cc.clear();
+        seq->rotate(a, cc, ll ? dc : x, conjb, ll ? x : dc, conjk, 2.0);
+        seq->simple_perform();
+        MatrixFunctions::rotate(a, c, ll ? dc : x, conjb, ll ? x : dc, conjk,
+                                2.0);
+        ASSERT_TRUE(MatrixFunctions::all_close(c, cc, 1E-10, 1E-10));
+        c.clear();
+        MatrixFunctions::three_rotate(a, c, ll ? dc : x, conjb, ll ? x : dc,
+                                      conjk, da, false, db, false, ll, 2.0, 0);
+        ASSERT_TRUE(MatrixFunctions::all_close(c, cc, 1E-10, 1E-10));
+        cc.deallocate();
+        c.deallocate();
+        a.deallocate();
+        x.deallocate();
+        dc.deallocate();
+        db.deallocate();
+        da.deallocate();
+    }
+    MatrixFunctions::rotate_tile_size() = tile_size;
+}
+
 TEST_F(TestMatrix, TestThreeTensorProductDiagonal) {
     shared_ptr<BatchGEMM> batch = make_shared<BatchGEMM>();
     for (int i = 0; i < n_tests; i++) {
@@ -326,6 +396,43 @@ TEST_F(TestMatrix, TestExponential) {
     }
 }
 
+TEST_F(TestMatrix, TestExponentialSStep) {
+    for (int i = 0; i < n_tests; i++) {
+        MKL_INT n = Random::rand_int(1, 300);
+        int s_step = Random::rand_int(2, 7);
+        bool symmetric = Random::rand_int(0, 2);
+        double t = Random::rand_double(-0.1, 0.1);
+        double consta = Random::rand_double(-2.0, 2.0);
+        MatrixRef a(dalloc_()->allocate(n * n), n, n);
+        MatrixRef aa(dalloc_()->allocate(n), n, 1);
+        MatrixRef v(dalloc_()->allocate(n), n, 1);
+        MatrixRef w(dalloc_()->allocate(n), n, 1);
+        Random::fill_rand_double(a.data, a.size());
+        Random::fill_rand_double(v.data, v.size());
+        for (MKL_INT ki = 0; ki < n; ki++) {
+            if (symmetric)
+                for (MKL_INT kj = 0; kj < ki; kj++)
+                    a(kj, ki) = a(ki, kj);
+            w(ki, 0) = v(ki, 0);
+            aa(ki, 0) = a(ki, ki);
+        }
+        double anorm = MatrixFunctions::norm(aa);
+        MatMul mop(a);
+        // one-vector-per-step process as reference
+        MatrixFunctions::expo_apply(
+            mop, t, anorm, v, consta, symmetric, false,
+            (shared_ptr<ParallelCommunicator<SZ>>)nullptr, 1E-8);
+        MatrixFunctions::expo_apply(
+            mop, t, anorm, w, consta, symmetric, false,
+            (shared_ptr<ParallelCommunicator<SZ>>)nullptr, 1E-8, 20, s_step);
+        ASSERT_TRUE(MatrixFunctions::all_close(v, w, 1E-6, 0.0));
+        w.deallocate();
+        v.deallocate();
+        aa.deallocate();
+        a.deallocate();
+    }
+}
+
 TEST_F(TestMatrix, TestHarmonicDavidson) {
     // this test is not very stable
     Random::rand_seed(1234);
@@ -456,6 +563,295 @@ TEST_F(TestMatrix, TestDavidson) {
     }
 }
 
+TEST_F(TestMatrix, TestDavidsonTelemetry) {
+    const MKL_INT n = 150, k = 2;
+    int ndav = 0;
+    MatrixRef a(dalloc_()->allocate(n * n), n, n);
+    DiagonalMatrix aa(dalloc_()->allocate(n), n);
+    DiagonalMatrix ww(dalloc_()->allocate(n), n);
+    vector<MatrixRef> bs(k, MatrixRef(nullptr, n, 1));
+    Random::fill_rand_double(a.data, a.size());
+    for (MKL_INT ki = 0; ki < n; ki++) {
+        for (MKL_INT kj = 0; kj < ki; kj++)
+            a(kj, ki) = a(ki, kj);
+        aa(ki, ki) = a(ki, ki);
+    }
+    for (int i = 0; i < k; i++) {
+        bs[i].allocate();
+        bs[i].clear();
+        bs[i].data[i] = 1;
+    }
+    shared_ptr<DavidsonTelemetry> tel = make_shared<DavidsonTelemetry>();
+    MatrixFunctions::davidson_telemetry() = tel;
+    MatMul mop(a);
+    vector<double> vw = MatrixFunctions::davidson(
+        mop, aa, bs, 0, DavidsonTypes::Normal, ndav, false,
+        (shared_ptr<ParallelCommunicator<SZ>>)nullptr, 1E-8, n * k * 2, -1,
+        k * 2, k + 4);
+    MatrixFunctions::davidson_telemetry() = nullptr;
+    EXPECT_EQ(tel->n_solves, 1);
+    EXPECT_EQ(tel->n_iters(), ndav);
+    EXPECT_EQ((int)tel->tmults.size(), ndav);
+    EXPECT_GT(tel->n_restarts, 0);
+    for (int i = 0; i < ndav; i++)
+        EXPECT_LE(tel->subspaces[i], k + 4);
+    // the last residual converges the last root
+    EXPECT_LT(tel->residuals.back(), 1E-8);
+    EXPECT_EQ(tel->roots.back(), k - 1);
+    EXPECT_NEAR(tel->eigvals.back(), vw[k - 1], 1E-10);
+    // gap to the first unconverged Ritz value is an estimate from above
+    MatrixFunctions::eigs(a, ww);
+    EXPECT_GE(tel->gap, ww.data[k] - ww.data[k - 1] - 1E-10);
+    for (int i = k - 1; i >= 0; i--)
+        bs[i].deallocate();
+    ww.deallocate();
+    aa.deallocate();
+    a.deallocate();
+}
+
+TEST_F(TestMatrix, TestJacobiDavidson) {
+    for (int i = 0; i < n_tests; i++) {
+        MKL_INT n = Random::rand_int(1, 200);
+        MKL_INT k = min(n, (MKL_INT)Random::rand_int(1, 4));
+        int ndav = 0;
+        MatrixRef a(dalloc_()->allocate(n * n), n, n);
+        DiagonalMatrix aa(dalloc_()->allocate(n), n);
+        DiagonalMatrix ww(dalloc_()->allocate(n), n);
+        vector<MatrixRef> bs(k, MatrixRef(nullptr, n, 1));
+        Random::fill_rand_double(a.data, a.size());
+        for (MKL_INT ki = 0; ki < n; ki++) {
+            for (MKL_INT kj = 0; kj < ki; kj++)
+                a(kj, ki) = a(ki, kj);
+            a(ki, ki) += ki;
+            aa(ki, ki) = a(ki, ki);
+        }
+        for (int i = 0; i < k; i++) {
+            bs[i].allocate();
+            bs[i].clear();
+            bs[i].data[i] = 1;
+        }
+        MatMul mop(a);
+        vector<double> vw = MatrixFunctions::davidson(
+            mop, aa, bs, 0,
+            DavidsonTypes::Normal | DavidsonTypes::JacobiDavidson, ndav, false,
+            (shared_ptr<ParallelCommunicator<SZ>>)nullptr, 1E-8, n * k * 20,
+            -1, k * 2, max((MKL_INT)5, k + 10));
+        ASSERT_EQ((int)vw.size(), k);
+        DiagonalMatrix w(&vw[0], k);
+        MatrixFunctions::eigs(a, ww);
+        DiagonalMatrix w2(ww.data, k);
+        ASSERT_TRUE(MatrixFunctions::all_close(w, w2, 1E-6, 0.0));
+        for (int i = 0; i < k; i++)
+            ASSERT_TRUE(
+                MatrixFunctions::all_close(
+                    bs[i], MatrixRef(a.data + a.n * i, a.n, 1), 1E-3, 0.0) ||
+                MatrixFunctions::all_close(bs[i],
+                                           MatrixRef(a.data + a.n * i, a.n, 1),
+                                           1E-3, 0.0, -1.0));
+        for (int i = k - 1; i >= 0; i--)
+            bs[i].deallocate();
+        ww.deallocate();
+        aa.deallocate();
+        a.deallocate();
+    }
+}
+
+TEST_F(TestMatrix, TestBlockDavidson) {
+    for (int i = 0; i < n_tests; i++) {
+        MKL_INT n = Random::rand_int(1, 200);
+        MKL_INT k = min(n, (MKL_INT)Random::rand_int(1, 10));
+        int ndav = 0;
+        MatrixRef a(dalloc_()->allocate(n * n), n, n);
+        DiagonalMatrix aa(dalloc_()->allocate(n), n);
+        DiagonalMatrix ww(dalloc_()->allocate(n), n);
+        vector<MatrixRef> bs(k, MatrixRef(nullptr, n, 1));
+        Random::fill_rand_double(a.data, a.size());
+        for (MKL_INT ki = 0; ki < n; ki++) {
+            for (MKL_INT kj = 0; kj < ki; kj++)
+                a(kj, ki) = a(ki, kj);
+            aa(ki, ki) = a(ki, ki);
+        }
+        for (int i = 0; i < k; i++) {
+            bs[i].allocate();
+            bs[i].clear();
+            bs[i].data[i] = 1;
+        }
+        PanelMatMul mop(a);
+        vector<double> vw = MatrixFunctions::davidson(
+            mop, aa, bs, 0, DavidsonTypes::Block, ndav, false,
+            (shared_ptr<ParallelCommunicator<SZ>>)nullptr, 1E-8, n * k * 2, -1,
+            k * 2, max((MKL_INT)5, k * 2 + 10));
+        ASSERT_EQ((int)vw.size(), k);
+        ASSERT_LE(mop.n_panel, ndav);
+        DiagonalMatrix w(&vw[0], k);
+        MatrixFunctions::eigs(a, ww);
+        DiagonalMatrix w2(ww.data, k);
+        ASSERT_TRUE(MatrixFunctions::all_close(w, w2, 1E-6, 0.0));
+        for (int i = 0; i < k; i++)
+            ASSERT_TRUE(
+                MatrixFunctions::all_close(
+                    bs[i], MatrixRef(a.data + a.n * i, a.n, 1), 1E-3, 0.0) ||
+                MatrixFunctions::all_close(bs[i],
+                                           MatrixRef(a.data + a.n * i, a.n, 1),
+                                           1E-3, 0.0, -1.0));
+        for (int i = k - 1; i >= 0; i--)
+            bs[i].deallocate();
+        ww.deallocate();
+        aa.deallocate();
+        a.deallocate();
+    }
+}
+
+TEST_F(TestMatrix, TestRecycledDavidson) {
+    for (int i = 0; i < n_tests; i++) {
+        MKL_INT n = Random::rand_int(3, 200);
+        int nr = min((int)n - 1, 2);
+        int ndav = 0, ndav_recycled = 0;
+        MatrixRef a(dalloc_()->allocate(n * n), n, n);
+        DiagonalMatrix aa(dalloc_()->allocate(n), n);
+        DiagonalMatrix ww(dalloc_()->allocate(n), n);
+        vector<MatrixRef> bs(1, MatrixRef(nullptr, n, 1));
+        vector<MatrixRef> rvs(nr, MatrixRef(nullptr, n, 1));
+        Random::fill_rand_double(a.data, a.size());
+        // well separated lowest eigenvalues
+        for (MKL_INT ki = 0; ki < n; ki++) {
+            for (MKL_INT kj = 0; kj < ki; kj++)
+                a(kj, ki) = a(ki, kj);
+            a(ki, ki) += ki;
+            aa(ki, ki) = a(ki, ki);
+        }
+        bs[0].allocate();
+        for (int j = 0; j < nr; j++) {
+            rvs[j].allocate();
+            rvs[j].clear();
+        }
+        MatMul mop(a);
+        // cold start, the recycled vectors are all zero
+        bs[0].clear();
+        bs[0].data[0] = 1;
+        vector<double> vw = MatrixFunctions::davidson(
+            mop, aa, bs, 0, DavidsonTypes::Normal, ndav, false,
+            (shared_ptr<ParallelCommunicator<SZ>>)nullptr, 1E-8, n * 4, -1, 2,
+            12, vector<MatrixRef>(), rvs);
+        for (int j = 0; j < nr; j++) {
+            ASSERT_LT(abs(MatrixFunctions::dot(rvs[j], bs[0])), 1E-6);
+            ASSERT_LT(abs(MatrixFunctions::dot(rvs[j], rvs[j]) - 1.0), 1E-6);
+        }
+        // warm start from the recycled subspace and a perturbed guess
+        bs[0].data[0] += 0.1;
+        vector<double> vwr = MatrixFunctions::davidson(
+            mop, aa, bs, 0, DavidsonTypes::Normal, ndav_recycled, false,
+            (shared_ptr<ParallelCommunicator<SZ>>)nullptr, 1E-8, n * 4, -1, 2,
+            12, vector<MatrixRef>(), rvs);
+        ASSERT_LE(ndav_recycled, ndav);
+        MatrixFunctions::eigs(a, ww);
+        ASSERT_LT(abs(vw[0] - ww.data[0]), 1E-6);
+        ASSERT_LT(abs(vwr[0] - ww.data[0]), 1E-6);
+        ASSERT_TRUE(
+            MatrixFunctions::all_close(bs[0], MatrixRef(a.data, a.n, 1), 1E-3,
+                                       0.0) ||
+            MatrixFunctions::all_close(bs[0], MatrixRef(a.data, a.n, 1), 1E-3,
+                                       0.0, -1.0));
+        for (int j = nr - 1; j >= 0; j--)
+            rvs[j].deallocate();
+        bs[0].deallocate();
+        ww.deallocate();
+        aa.deallocate();
+        a.deallocate();
+    }
+}
+
+TEST_F(TestMatrix, TestThickRestartLanczos) {
+    for (int i = 0; i < n_tests; i++) {
+        MKL_INT n = Random::rand_int(1, 200);
+        MKL_INT k = min(n, (MKL_INT)Random::rand_int(1, 5));
+        int ndav = 0;
+        MatrixRef a(dalloc_()->allocate(n * n), n, n);
+        DiagonalMatrix aa(dalloc_()->allocate(n), n);
+        DiagonalMatrix ww(dalloc_()->allocate(n), n);
+        vector<MatrixRef> bs(k, MatrixRef(nullptr, n, 1));
+        Random::fill_rand_double(a.data, a.size());
+        for (MKL_INT ki = 0; ki < n; ki++) {
+            for (MKL_INT kj = 0; kj < ki; kj++)
+                a(kj, ki) = a(ki, kj);
+            aa(ki, ki) = a(ki, ki);
+        }
+        for (int i = 0; i < k; i++) {
+            bs[i].allocate();
+            Random::fill_rand_double(bs[i].data, bs[i].size());
+        }
+        MatMul mop(a);
+        vector<double> vw = MatrixFunctions::harmonic_davidson(
+            mop, aa, bs, 0, DavidsonTypes::Lanczos, ndav, false,
+            (shared_ptr<ParallelCommunicator<SZ>>)nullptr, 1E-10, n * k * 50,
+            -1, 2, max((MKL_INT)5, k * 4));
+        ASSERT_EQ((int)vw.size(), k);
+        DiagonalMatrix w(&vw[0], k);
+        MatrixFunctions::eigs(a, ww);
+        DiagonalMatrix w2(ww.data, k);
+        ASSERT_TRUE(MatrixFunctions::all_close(w, w2, 1E-6, 0.0));
+        for (int i = 0; i < k; i++)
+            ASSERT_TRUE(
+                MatrixFunctions::all_close(
+                    bs[i], MatrixRef(a.data + a.n * i, a.n, 1), 1E-3, 0.0) ||
+                MatrixFunctions::all_close(bs[i],
+                                           MatrixRef(a.data + a.n * i, a.n, 1),
+                                           1E-3, 0.0, -1.0));
+        for (int i = k - 1; i >= 0; i--)
+            bs[i].deallocate();
+        ww.deallocate();
+        aa.deallocate();
+        a.deallocate();
+    }
+}
+
+TEST_F(TestMatrix, TestChebyshevFilter) {
+    for (int i = 0; i < n_tests; i++) {
+        MKL_INT n = Random::rand_int(1, 200);
+        MKL_INT k = min(n, (MKL_INT)Random::rand_int(1, 10));
+        int ndav = 0;
+        MatrixRef a(dalloc_()->allocate(n * n), n, n);
+        DiagonalMatrix aa(dalloc_()->allocate(n), n);
+        DiagonalMatrix ww(dalloc_()->allocate(n), n);
+        vector<MatrixRef> bs(k, MatrixRef(nullptr, n, 1));
+        Random::fill_rand_double(a.data, a.size());
+        for (MKL_INT ki = 0; ki < n; ki++) {
+            for (MKL_INT kj = 0; kj < ki; kj++)
+                a(kj, ki) = a(ki, kj);
+            a(ki, ki) += ki * 0.1;
+            aa(ki, ki) = a(ki, ki);
+        }
+        for (int i = 0; i < k; i++) {
+            bs[i].allocate();
+            bs[i].clear();
+            bs[i].data[i] = 1;
+        }
+        PanelMatMul mop(a);
+        vector<double> vw = MatrixFunctions::harmonic_davidson(
+            mop, aa, bs, 0, DavidsonTypes::Chebyshev, ndav, false,
+            (shared_ptr<ParallelCommunicator<SZ>>)nullptr, 1E-10, n * k * 50,
+            -1, 2);
+        ASSERT_EQ((int)vw.size(), k);
+        ASSERT_LE(mop.n_panel, ndav);
+        DiagonalMatrix w(&vw[0], k);
+        MatrixFunctions::eigs(a, ww);
+        DiagonalMatrix w2(ww.data, k);
+        ASSERT_TRUE(MatrixFunctions::all_close(w, w2, 1E-6, 0.0));
+        for (int i = 0; i < k; i++)
+            ASSERT_TRUE(
+                MatrixFunctions::all_close(
+                    bs[i], MatrixRef(a.data + a.n * i, a.n, 1), 1E-3, 0.0) ||
+                MatrixFunctions::all_close(bs[i],
+                                           MatrixRef(a.data + a.n * i, a.n, 1),
+                                           1E-3, 0.0, -1.0));
+        for (int i = k - 1; i >= 0; i--)
+            bs[i].deallocate();
+        ww.deallocate();
+        aa.deallocate();
+        a.deallocate();
+    }
+}
+
 TEST_F(TestMatrix, TestMinRes) {
     for (int i = 0; i < n_tests; i++) {
         MKL_INT m = Random::rand_int(1, 200);
@@ -685,6 +1081,173 @@ TEST_F(TestMatrix, TestSVD) {
     }
 }
 
+static int n_offload_eigs = 0, n_offload_svds = 0;
+
+static void counted_dsyev(MKL_INT n, double *a, double *w) {
+    n_offload_eigs++;
+    MKL_INT lwork = 34 * n, info = 0;
+    vector<double> work(lwork);
+    dsyev("V", "U", &n, a, &n, w, work.data(), &lwork, &info);
+    assert(info == 0);
+}
+
+static void counted_dgesvd(MKL_INT m, MKL_INT n, double *a, double *s,
+                           double *u, double *vt) {
+    n_offload_svds++;
+    MKL_INT k = min(m, n), lwork = 34 * max(m, n), info = 0;
+    vector<double> work(lwork);
+    dgesvd("S", "S", &m, &n, a, &m, s, u, &m, vt, &k, work.data(), &lwork,
+           &info);
+    assert(info == 0);
+}
+
+TEST_F(TestMatrix, TestLAPACKOffload) {
+    const MKL_INT offload_size = 50;
+    MatrixFunctions::lapack_offload_size() = offload_size;
+    dsyev_backend_() = &counted_dsyev;
+    dgesvd_backend_() = &counted_dgesvd;
+    n_offload_eigs = n_offload_svds = 0;
+    int n_large_eigs = 0, n_large_svds = 0;
+    for (int i = 0; i < n_tests; i++) {
+        MKL_INT m = Random::rand_int(1, 100);
+        MKL_INT n = Random::rand_int(1, 100);
+        MKL_INT k = min(m, n);
+        n_large_eigs += m >= offload_size;
+        n_large_svds += k >= offload_size;
+        MatrixRef a(dalloc_()->allocate(m * m), m, m);
+        MatrixRef ap(dalloc_()->allocate(m * m), m, m);
+        DiagonalMatrix w(dalloc_()->allocate(m), m);
+        DiagonalMatrix wp(dalloc_()->allocate(m), m);
+        Random::fill_rand_double(a.data, a.size());
+        MatrixFunctions::copy(ap, a);
+        MatrixFunctions::eigs(a, w);
+        MatrixFunctions::lapack_offload_size() = 0;
+        MatrixFunctions::eigs(ap, wp);
+        MatrixFunctions::lapack_offload_size() = offload_size;
+        ASSERT_TRUE(MatrixFunctions::all_close(w, wp, 1E-12, 0.0));
+        ASSERT_TRUE(MatrixFunctions::all_close(a, ap, 1E-12, 0.0));
+        wp.deallocate();
+        w.deallocate();
+        ap.deallocate();
+        a.deallocate();
+        MatrixRef b(dalloc_()->allocate(m * n), m, n);
+        MatrixRef bp(dalloc_()->allocate(m * n), m, n);
+        MatrixRef l(dalloc_()->allocate(m * k), m, k);
+        MatrixRef lp(dalloc_()->allocate(m * k), m, k);
+        MatrixRef r(dalloc_()->allocate(k * n), k, n);
+        MatrixRef rp(dalloc_()->allocate(k * n), k, n);
+        MatrixRef s(dalloc_()->allocate(k), 1, k);
+        MatrixRef sp(dalloc_()->allocate(k), 1, k);
+        Random::fill_rand_double(b.data, b.size());
+        MatrixFunctions::copy(bp, b);
+        MatrixFunctions::svd(b, l, s, r);
+        MatrixFunctions::lapack_offload_size() = 0;
+        MatrixFunctions::svd(bp, lp, sp, rp);
+        MatrixFunctions::lapack_offload_size() = offload_size;
+        ASSERT_TRUE(MatrixFunctions::all_close(s, sp, 1E-12, 0.0));
+        ASSERT_TRUE(MatrixFunctions::all_close(l, lp, 1E-12, 0.0));
+        ASSERT_TRUE(MatrixFunctions::all_close(r, rp, 1E-12, 0.0));
+        sp.deallocate();
+        s.deallocate();
+        rp.deallocate();
+        r.deallocate();
+        lp.deallocate();
+        l.deallocate();
+        bp.deallocate();
+        b.deallocate();
+    }
+    EXPECT_EQ(n_offload_eigs, n_large_eigs);
+    EXPECT_EQ(n_offload_svds, n_large_svds);
+    MatrixFunctions::lapack_offload_size() = 0;
+    dsyev_backend_() = nullptr;
+    dgesvd_backend_() = nullptr;
+}
+
+TEST_F(TestMatrix, TestTruncatedSVD) {
+    for (int i = 0; i < n_tests; i++) {
+        MKL_INT m = Random::rand_int(1, 200);
+        MKL_INT n = Random::rand_int(1, 200);
+        MKL_INT k = min(m, n), nk = Random::rand_int(1, k + 1);
+        MKL_INT r = min(k, nk + (MKL_INT)Random::rand_int(0, 5));
+        MatrixRef x(dalloc_()->allocate(m * r), m, r);
+        MatrixRef y(dalloc_()->allocate(r * n), r, n);
+        MatrixRef a(dalloc_()->allocate(m * n), m, n);
+        MatrixRef l(dalloc_()->allocate(m * nk), m, nk);
+        MatrixRef s(dalloc_()->allocate(nk), 1, nk);
+        MatrixRef rr(dalloc_()->allocate(nk * n), nk, n);
+        MatrixRef ls(dalloc_()->allocate(m * nk), m, nk);
+        MatrixRef xa(dalloc_()->allocate(m * n), m, n);
+        // low rank matrix, so that the randomized range is exact
+        Random::fill_rand_double(x.data, x.size());
+        Random::fill_rand_double(y.data, y.size());
+        MatrixFunctions::multiply(x, false, y, false, a, 1.0, 0.0);
+        double tail = MatrixFunctions::truncated_svd(a, l, s, rr);
+        for (MKL_INT j = 1; j < nk; j++)
+            ASSERT_GE(s.data[j - 1], s.data[j]);
+        MatrixFunctions::copy(ls, l);
+        for (MKL_INT j = 0; j < nk; j++)
+            MatrixFunctions::iscale(MatrixRef(ls.data + j, m, 1), s.data[j],
+                                    nk);
+        // the discarded part is a - l * s * r
+        MatrixFunctions::copy(xa, a);
+        MatrixFunctions::multiply(ls, false, rr, false, xa, -1.0, 1.0);
+        ASSERT_LT(abs(MatrixFunctions::dot(xa, xa) - tail),
+                  1E-8 * max(1.0, MatrixFunctions::dot(a, a)));
+        if (nk == r)
+            ASSERT_LT(tail, 1E-8 * max(1.0, MatrixFunctions::dot(a, a)));
+        xa.deallocate();
+        ls.deallocate();
+        rr.deallocate();
+        s.deallocate();
+        l.deallocate();
+        a.deallocate();
+        y.deallocate();
+        x.deallocate();
+    }
+}
+
+TEST_F(TestMatrix, TestTruncatedEigs) {
+    for (int i = 0; i < n_tests; i++) {
+        MKL_INT n = Random::rand_int(1, 200);
+        MKL_INT nk = Random::rand_int(1, n + 1);
+        MatrixRef x(dalloc_()->allocate(n * n), n, n);
+        MatrixRef a(dalloc_()->allocate(n * n), n, n);
+        MatrixRef af(dalloc_()->allocate(n * n), n, n);
+        MatrixRef v(dalloc_()->allocate(nk * n), nk, n);
+        DiagonalMatrix w(dalloc_()->allocate(nk), nk);
+        DiagonalMatrix ww(dalloc_()->allocate(n), n);
+        // positive semi-definite matrix with fast decaying spectrum
+        Random::fill_rand_double(x.data, x.size());
+        for (MKL_INT j = 0; j < n; j++)
+            MatrixFunctions::iscale(MatrixRef(x.data + j * n, 1, n),
+                                    pow(0.5, j));
+        MatrixFunctions::multiply(x, true, x, false, a, 1.0, 0.0);
+        MatrixFunctions::copy(af, a);
+        double tail = MatrixFunctions::truncated_eigs(a, v, w);
+        MatrixFunctions::eigs(af, ww);
+        double trace = 0;
+        for (MKL_INT j = 0; j < n; j++)
+            trace += a(j, j);
+        for (MKL_INT j = 0; j < nk; j++) {
+            ASSERT_LT(abs(w.data[j] - ww.data[n - nk + j]),
+                      1E-8 * max(1.0, trace));
+            ASSERT_LT(abs(MatrixFunctions::dot(MatrixRef(v.data + j * n, 1, n),
+                                               MatrixRef(v.data + j * n, 1, n)) -
+                          1.0),
+                      1E-8);
+        }
+        for (MKL_INT j = 0; j < n - nk; j++)
+            tail -= ww.data[j];
+        ASSERT_LT(abs(tail), 1E-8 * max(1.0, trace));
+        ww.deallocate();
+        w.deallocate();
+        v.deallocate();
+        af.deallocate();
+        a.deallocate();
+        x.deallocate();
+    }
+}
+
 TEST_F(TestMatrix, TestQR) {
     for (int i = 0; i < n_tests; i++) {
         MKL_INT m = Random::rand_int(1, 200);
@@ -25,14 +25,33 @@ class TestNDArray : public ::testing::Test {
             EXPECT_EQ(x.data[i], z[zi]);
         }
     }
+    // view = 0: C order; 1: reversed strides; 2: padded last dim
+    static NDArray random_view(const vector<MKL_INT> &shape, int view) {
+        if (view == 0 || shape.size() == 0)
+            return NDArray::random(shape);
+        else if (view == 1) {
+            vector<MKL_INT> rshape(shape.rbegin(), shape.rend());
+            vector<int> perm(shape.size());
+            for (int i = 0; i < (int)perm.size(); i++)
+                perm[i] = (int)perm.size() - 1 - i;
+            return NDArray::random(rshape).transpose(perm);
+        } else {
+            vector<MKL_INT> pshape = shape;
+            pshape.back() += 3;
+            vector<NDArraySlice> sl(shape.size());
+            sl.back() = NDArraySlice(0, shape.back());
+            return NDArray::random(pshape).slice(sl);
+        }
+    }
     static void check_tensordot(const vector<MKL_INT> &ash,
                                 const vector<MKL_INT> &bsh,
                                 const vector<int> &aidx,
                                 const vector<int> &bidx,
                                 const vector<int> &br_aidx = {},
-                                const vector<int> &br_bidx = {}) {
-        NDArray a = NDArray::random(ash);
-        NDArray b = NDArray::random(bsh);
+                                const vector<int> &br_bidx = {},
+                                int view = 0) {
+        NDArray a = random_view(ash, view);
+        NDArray b = random_view(bsh, view == 0 ? 0 : 3 - view);
         size_t ctr_size = 1, br_size = 1;
         assert(aidx.size() == bidx.size());
         assert(br_aidx.size() == br_bidx.size());
@@ -213,6 +232,35 @@ TEST_F(TestNDArray, TestSum) {
     check_sum({12, 15, 5, 10, 4, 9}, {2, 0, 4});
 }
 
+TEST_F(TestNDArray, TestElementwise) {
+    Random::rand_seed(1234);
+
+    // view 0: dense; 1: dense with reversed strides; 2: padded (not dense)
+    for (int view = 0; view <= 2; view++) {
+        NDArray x = random_view({13, 7, 29}, view);
+        NDArray y = random_view({13, 7, 29}, view);
+        EXPECT_EQ(x.is_dense(), view != 2);
+        NDArray z = NDArray::axpby(0.5, x, -2.0, y);
+        NDArray w = x - y, v = -x, u = 3.0 * x;
+        double xnorm = 0;
+        for (size_t i = 0; i < x.size(); i++) {
+            vector<MKL_INT> idx = z.decompose_linear_index(i);
+            EXPECT_NEAR(z[idx], 0.5 * x[idx] - 2.0 * y[idx], 1E-12);
+            EXPECT_NEAR(w[idx], x[idx] - y[idx], 1E-12);
+            EXPECT_NEAR(v[idx], -x[idx], 1E-12);
+            EXPECT_NEAR(u[idx], 3.0 * x[idx], 1E-12);
+            xnorm += x[idx] * x[idx];
+        }
+        EXPECT_NEAR(x.norm(), sqrt(xnorm), 1E-10);
+    }
+    // total sum uses the parallel reduction path
+    NDArray d = NDArray::random({100000});
+    double dsum = 0;
+    for (size_t i = 0; i < d.size(); i++)
+        dsum += d.data[i];
+    EXPECT_NEAR(d.sum(0).item(), dsum, 1E-8);
+}
+
 TEST_F(TestNDArray, TestTensordot) {
     Random::rand_seed(1234);
 
@@ -280,6 +328,33 @@ TEST_F(TestNDArray, TestTensordot) {
                     {1, 4, 0, 3});
 }
 
+TEST_F(TestNDArray, TestTensordotStrided) {
+    Random::rand_seed(1234);
+
+    for (int view = 1; view <= 2; view++) {
+        check_tensordot({4, 25}, {34, 4}, {}, {}, {0}, {1}, view);
+        check_tensordot({25, 34, 3}, {3, 34}, {1}, {1}, {2}, {0}, view);
+        check_tensordot({4, 25, 5, 34}, {4, 34, 5, 41}, {3}, {1}, {0, 2},
+                        {0, 2}, view);
+        check_tensordot({32, 6, 27}, {27, 32, 6}, {2, 0}, {0, 1}, {1}, {2},
+                        view);
+        check_tensordot({8, 2, 2, 3, 7, 3, 4}, {3, 2, 3, 4, 8, 2, 7},
+                        {6, 0, 4}, {3, 4, 6}, {3, 5, 1, 2}, {0, 2, 1, 5},
+                        view);
+
+        check_tensordot({25, 34}, {34, 41}, {1}, {0}, {}, {}, view);
+        check_tensordot({25, 34}, {25, 9}, {0}, {0}, {}, {}, view);
+        check_tensordot({9, 34}, {25, 9}, {0}, {1}, {}, {}, view);
+        check_tensordot({23, 41}, {5, 3}, {}, {}, {}, {}, view);
+        check_tensordot({32, 27}, {27, 32}, {1, 0}, {0, 1}, {}, {}, view);
+        check_tensordot({4, 27, 9}, {4, 9}, {2, 0}, {1, 0}, {}, {}, view);
+        check_tensordot({8, 7, 66}, {4, 8, 7, 66, 11}, {1, 2}, {2, 3}, {}, {},
+                        view);
+        check_tensordot({4, 5, 3, 7, 9}, {3, 7, 8, 5, 4}, {3, 0, 2, 1},
+                        {1, 4, 0, 3}, {}, {}, view);
+    }
+}
+
 TEST_F(TestNDArray, TestEinsum) {
 
     NDArray ref, a, b, c, d;
@@ -1599,4 +1674,114 @@ TEST_F(TestNDArray, TestEinsum) {
 
     diff = (NDArray::einsum("ijkl,xiky,lyp,px->jl", {a, b, c, d}) - ref).norm();
     EXPECT_LT(diff, 1E-12);
-}
\ No newline at end of file
+}
+TEST_F(TestNDArray, TestEinsumPath) {
+    Random::rand_seed(1234);
+
+    vector<int> count(256, 0);
+    vector<MKL_INT> extents(256, 1);
+    for (char c : string("ijjkkl"))
+        count[c]++;
+    count['i']++, count['l']++;
+    extents['i'] = extents['j'] = extents['k'] = 100, extents['l'] = 2;
+    vector<pair<int, int>> path = NDArray::einsum_path(
+        {"ij", "jk", "kl"}, count, extents, EinsumPathTypes::Optimal);
+    ASSERT_EQ(path.size(), 2);
+    EXPECT_EQ(path[0], make_pair(1, 2));
+    path = NDArray::einsum_path({"ij", "jk", "kl"}, count, extents,
+                                EinsumPathTypes::Greedy);
+    ASSERT_EQ(path.size(), 2);
+    EXPECT_EQ(path[0], make_pair(1, 2));
+
+    NDArray a = NDArray::random({7, 6, 5});
+    NDArray b = NDArray::random({5, 9});
+    NDArray c = NDArray::random({9, 4, 7});
+    NDArray d = NDArray::random({4, 3});
+    NDArray e = NDArray::random({3, 6, 8});
+    NDArray f = NDArray::random({8, 2});
+    const string script = "ijk,kl,lmi,mn,njo,op->ip";
+    NDArray ref = NDArray::einsum(script, {a, b, c, d, e, f},
+                                  EinsumPathTypes::Linear);
+    for (auto pt : {EinsumPathTypes::Greedy, EinsumPathTypes::Optimal,
+                    EinsumPathTypes::Auto}) {
+        // second call uses the cached path
+        for (int i = 0; i < 2; i++) {
+            NDArray r = NDArray::einsum(script, {a, b, c, d, e, f}, pt);
+            EXPECT_LT((r - ref).norm(), 1E-10);
+        }
+    }
+    NDArray r = NDArray::einsum("ijk,kl,lmi->jm", {a, b, c});
+    NDArray rr = NDArray::einsum(
+        "ijl,lmi->jm", {NDArray::einsum("ijk,kl->ijl", {a, b}), c});
+    EXPECT_LT((r - rr).norm(), 1E-10);
+}
+
+TEST_F(TestNDArray, TestBlockedTensordot) {
+    Random::rand_seed(1234);
+
+    NDArray a = NDArray::random({7, 5, 6}), b = NDArray::random({6, 4, 5});
+    NDArray c({7, 4});
+    NDArray::tensordot(a, b, c, {1, 2}, {2, 0});
+    BlockedNDArray ba = BlockedNDArray::from_array(a, {3, 2, 4}, "blk_a.tmp");
+    BlockedNDArray bb = BlockedNDArray::from_array(b, {4, 3, 2}, "blk_b.tmp");
+    EXPECT_LT((ba.to_array() - a).norm(), 1E-12);
+    BlockedNDArray bc({7, 4}, {3, 3}, "blk_c.tmp");
+    BlockedNDArray::tensordot(ba, bb, bc, {1, 2}, {2, 0});
+    EXPECT_LT((bc.to_array() - c).norm(), 1E-10);
+    // accumulate
+    BlockedNDArray::tensordot(ba, bb, bc, {1, 2}, {2, 0}, 2.0, 1.0);
+    NDArray c3 = bc.to_array();
+    for (size_t i = 0; i < c.size(); i++)
+        EXPECT_NEAR(c3.data[i], 3.0 * c.data[i], 1E-10);
+    // outer product
+    NDArray d({7, 5, 6, 6, 4, 5});
+    NDArray::tensordot(a, b, d, {}, {});
+    BlockedNDArray bd({7, 5, 6, 6, 4, 5}, {3, 2, 4, 4, 3, 2}, "blk_d.tmp");
+    BlockedNDArray::tensordot(ba, bb, bd, {}, {});
+    EXPECT_LT((bd.to_array() - d).norm(), 1E-10);
+    ba.remove(), bb.remove(), bc.remove(), bd.remove();
+}
+
+TEST_F(TestNDArray, TestPool) {
+    Random::rand_seed(1234);
+
+    EXPECT_EQ(NDArrayPool::size_class(9), 10);
+    EXPECT_EQ(NDArrayPool::size_class(100), 112);
+    EXPECT_EQ(NDArrayPool::size_class(128), 128);
+    NDArray a = NDArray::random({6, 7, 8}), b = NDArray::random({8, 5, 6});
+    NDArray ref = NDArray::einsum("ijk,kli->jl", {a, b});
+    EXPECT_FALSE(NDArrayPool::instance().active());
+    {
+        NDArrayPoolScope scope;
+        EXPECT_TRUE(NDArrayPool::instance().active());
+        double *p = NDArray::empty({6, 7, 8}).data;
+        // storage of a freed temporary is reused
+        NDArray x = NDArray::empty({7, 6, 8});
+        EXPECT_EQ(x.data, p);
+        for (int i = 0; i < 3; i++) {
+            NDArray r = NDArray::einsum("ijk,kli->jl", {a, b});
+            EXPECT_LT((r - ref).norm(), 1E-12);
+        }
+    }
+    EXPECT_FALSE(NDArrayPool::instance().active());
+    EXPECT_EQ(NDArrayPool::instance().cached, 0);
+}
+
+TEST_F(TestNDArray, TestFromTensor) {
+    Random::rand_seed(1234);
+
+    shared_ptr<GTensor<double>> t =
+        make_shared<GTensor<double>>(vector<MKL_INT>{3, 4, 5, 6});
+    for (size_t i = 0; i < t->size(); i++)
+        t->data[i] = Random::rand_double();
+    vector<double> ref = t->data;
+    NDArray a = NDArray::from_tensor(t);
+    EXPECT_EQ(a.data, t->data.data());
+    EXPECT_TRUE(a.is_c_order());
+    // storage stays alive after the tensor is released
+    t.reset();
+    for (size_t i = 0; i < ref.size(); i++)
+        EXPECT_EQ(a.data[i], ref[i]);
+    NDArray b = NDArray::einsum("ijkl->jlik", {a});
+    EXPECT_EQ((b[{1, 2, 0, 3}]), ref[((0 * 4 + 1) * 5 + 3) * 6 + 2]);
+}
@@ -553,6 +553,13 @@ TEST_F(TestNPDM, TestSU2) {
         OpNamesSet({OpNames::R, OpNames::RD}));
     cout << "2PDM MPO simplification end .. T = " << t.get_time() << endl;
 
+    // symmetry-unique 2PDM MPO construction
+    shared_ptr<MPO<SU2>> pu2mpo =
+        make_shared<PDM2MPOQC<SU2>>(hamil, true);
+    pu2mpo = make_shared<SimplifiedMPO<SU2>>(
+        pu2mpo, make_shared<RuleQC<SU2>>(), true, true,
+        OpNamesSet({OpNames::R, OpNames::RD}));
+
     // 1NPC MPO construction
     cout << "1NPC MPO start" << endl;
     shared_ptr<MPO<SU2>> nmpo = make_shared<NPC1MPOQC<SU2>>(hamil);
@@ -601,6 +608,7 @@ TEST_F(TestNPDM, TestSU2) {
         shared_ptr<DMRG<SU2>> dmrg = make_shared<DMRG<SU2>>(me, bdims, noises);
         dmrg->iprint = 2;
         dmrg->noise_type = NoiseTypes::Perturbative;
+        dmrg->store_orbital_rdms = dot == 2;
         dmrg->solve(10, true, 1E-12);
 
         // 1PDM ME
@@ -617,6 +625,18 @@ TEST_F(TestNPDM, TestSU2) {
         expect->solve(true, dmrg->forward);
 
         MatrixRef dm = expect->get_1pdm_spatial();
+
+        // occupations accumulated during the last DMRG sweep
+        if (dot == 2) {
+            vector<double> occs = dmrg->get_orbital_occupations();
+            vector<double> ents = dmrg->get_orbital_entropies();
+            EXPECT_EQ((int)occs.size(), dm.m);
+            for (int i = 0; i < dm.m; i++) {
+                EXPECT_LT(abs(occs[i] - dm(i, i)), 1E-6);
+                EXPECT_GE(ents[i], 0.0);
+            }
+        }
+
         int k = 0;
         for (int i = 0; i < dm.m; i++)
             for (int j = 0; j < dm.n; j++)
@@ -736,6 +756,24 @@ TEST_F(TestNPDM, TestSU2) {
              << " max error = " << scientific << setprecision(3) << setw(10)
              << max_error << endl;
 
+        // 1PDM from the same 2PDM sweep
+        dm = expect->get_1pdm_from_2pdm();
+        max_error = 0.0;
+        for (auto &x : one_pdm)
+            for (int p = 0; p < 2; p++) {
+                int i = get<0>(x) * 2 + p, j = get<1>(x) * 2 + p;
+                max_error = max(max_error, abs(dm(i, j) - get<2>(x) / 2));
+                dm(i, j) = 0.0;
+            }
+        for (int i = 0; i < dm.m; i++)
+            for (int j = 0; j < dm.n; j++)
+                max_error = max(max_error, abs(dm(i, j)));
+        cout << "== SU2 1PDM FROM 2PDM / " << dot << "-site =="
+             << " max error = " << scientific << setprecision(3) << setw(10)
+             << max_error << endl;
+        EXPECT_LT(max_error, 1E-6);
+        dm.deallocate();
+
         m[0] = m[1] = m[2] = 0;
         max_error = 0.0;
         dm2 = expect->get_2pdm_spatial();
@@ -775,6 +813,23 @@ TEST_F(TestNPDM, TestSU2) {
              << " max error = " << scientific << setprecision(3) << setw(10)
              << max_error << endl;
 
+        // symmetry-unique 2PDM
+        shared_ptr<MovingEnvironment<SU2>> pu2me =
+            make_shared<MovingEnvironment<SU2>>(pu2mpo, mps, mps, "2PDMU");
+        pu2me->init_environments(false);
+        shared_ptr<Expect<SU2>> uexpect =
+            make_shared<Expect<SU2>>(pu2me, bond_dim, bond_dim);
+        uexpect->solve(true, mps->center == 0);
+        shared_ptr<Tensor> udm2 = PDM2MPOQC<SU2>::unpack_matrix_spatial(
+            uexpect->get_2pdm_packed(), (uint16_t)dm2->shape[0]);
+        max_error = 0.0;
+        for (size_t i = 0; i < dm2->data.size(); i++)
+            max_error = max(max_error, abs(udm2->data[i] - dm2->data[i]));
+        cout << "== SU2 2PDM UNIQUE / " << dot << "-site =="
+             << " max error = " << scientific << setprecision(3) << setw(10)
+             << max_error << endl;
+        EXPECT_LT(max_error, 1E-7);
+
         // 1NPC ME
         shared_ptr<MovingEnvironment<SU2>> nme =
             make_shared<MovingEnvironment<SU2>>(nmpo, mps, mps, "1NPC");
@@ -844,6 +899,109 @@ TEST_F(TestNPDM, TestSU2) {
     fcidump->deallocate();
 }
 
+TEST_F(TestNPDM, TestSU2SharedSiteOps) {
+    shared_ptr<FCIDUMP> fcidump = make_shared<FCIDUMP>();
+    string filename = "data/N2.STO3G.FCIDUMP"; // E = -107.65412235
+    fcidump->read(filename);
+    vector<uint8_t> orbsym = fcidump->orb_sym<uint8_t>();
+    transform(orbsym.begin(), orbsym.end(), orbsym.begin(),
+              PointGroup::swap_d2h);
+    SU2 vacuum(0);
+    SU2 target(fcidump->n_elec(), fcidump->twos(),
+               PointGroup::swap_d2h(fcidump->isym()));
+    int norb = fcidump->n_sites();
+
+    // energy and 1PDM Hamiltonians share site operators
+    shared_ptr<HamiltonianQCSiteOps<SU2>> site_ops =
+        make_shared<HamiltonianQCSiteOps<SU2>>();
+    shared_ptr<HamiltonianQC<SU2>> hamil = make_shared<HamiltonianQC<SU2>>(
+        vacuum, norb, orbsym, fcidump, site_ops);
+    size_t i_used = ialloc_()->used, d_used = dalloc_()->used;
+    shared_ptr<HamiltonianQC<SU2>> phamil = make_shared<HamiltonianQC<SU2>>(
+        vacuum, norb, orbsym, fcidump, site_ops);
+    EXPECT_EQ(site_ops->n_refs, 2);
+    EXPECT_EQ(ialloc_()->used, i_used);
+    EXPECT_EQ(dalloc_()->used, d_used);
+    EXPECT_EQ(phamil->basis[0], hamil->basis[0]);
+    EXPECT_EQ(phamil->op_prims.at(orbsym[0])[0].at(OpNames::I),
+              hamil->op_prims.at(orbsym[0])[0].at(OpNames::I));
+
+    // FCI results
+    vector<tuple<int, int, double>> one_pdm = {
+        {0, 0, 1.999989282592},  {0, 1, -0.000025398134},
+        {0, 2, 0.000238560621},  {1, 0, -0.000025398134},
+        {1, 1, 1.991431489457},  {1, 2, -0.005641787787},
+        {2, 0, 0.000238560621},  {2, 1, -0.005641787787},
+        {2, 2, 1.985471515555},  {3, 3, 1.999992764813},
+        {3, 4, -0.000236022833}, {3, 5, 0.000163863520},
+        {4, 3, -0.000236022833}, {4, 4, 1.986371259953},
+        {4, 5, 0.018363506969},  {5, 3, 0.000163863520},
+        {5, 4, 0.018363506969},  {5, 5, 0.019649294772},
+        {6, 6, 1.931412559660},  {7, 7, 0.077134636900},
+        {8, 8, 1.931412559108},  {9, 9, 0.077134637190}};
+
+    shared_ptr<MPO<SU2>> mpo =
+        make_shared<MPOQC<SU2>>(hamil, QCTypes::Conventional);
+    mpo =
+        make_shared<SimplifiedMPO<SU2>>(mpo, make_shared<RuleQC<SU2>>(), true);
+    shared_ptr<MPO<SU2>> pmpo = make_shared<PDM1MPOQC<SU2>>(phamil);
+    pmpo = make_shared<SimplifiedMPO<SU2>>(
+        pmpo, make_shared<RuleQC<SU2>>(), true, true,
+        OpNamesSet({OpNames::R, OpNames::RD}));
+
+    ubond_t bond_dim = 200;
+    shared_ptr<MPSInfo<SU2>> mps_info =
+        make_shared<MPSInfo<SU2>>(norb, vacuum, target, hamil->basis);
+    mps_info->set_bond_dimension(bond_dim);
+    shared_ptr<MPS<SU2>> mps = make_shared<MPS<SU2>>(norb, 0, 2);
+    mps->initialize(mps_info);
+    mps->random_canonicalize();
+    mps->save_mutable();
+    mps->deallocate();
+    mps_info->save_mutable();
+    mps_info->deallocate_mutable();
+
+    shared_ptr<MovingEnvironment<SU2>> me =
+        make_shared<MovingEnvironment<SU2>>(mpo, mps, mps, "DMRG");
+    me->init_environments(false);
+    vector<ubond_t> bdims = {bond_dim};
+    vector<double> noises = {1E-8, 0};
+    shared_ptr<DMRG<SU2>> dmrg = make_shared<DMRG<SU2>>(me, bdims, noises);
+    dmrg->iprint = 1;
+    double energy = dmrg->solve(10, true, 1E-12);
+    EXPECT_LT(abs(energy - -107.654122447525), 1E-7);
+
+    shared_ptr<MovingEnvironment<SU2>> pme =
+        make_shared<MovingEnvironment<SU2>>(pmpo, mps, mps, "1PDM");
+    pme->init_environments(false);
+    shared_ptr<Expect<SU2>> expect =
+        make_shared<Expect<SU2>>(pme, bond_dim, bond_dim);
+    expect->solve(true, dmrg->forward);
+
+    MatrixRef dm = expect->get_1pdm_spatial();
+    int k = 0;
+    for (int i = 0; i < dm.m; i++)
+        for (int j = 0; j < dm.n; j++)
+            if (abs(dm(i, j)) > TINY) {
+                EXPECT_EQ(i, get<0>(one_pdm[k]));
+                EXPECT_EQ(j, get<1>(one_pdm[k]));
+                EXPECT_LT(abs(dm(i, j) - get<2>(one_pdm[k])), 1E-6);
+                k++;
+            }
+    EXPECT_EQ(k, (int)one_pdm.size());
+    dm.deallocate();
+
+    mps_info->deallocate();
+    pmpo->deallocate();
+    mpo->deallocate();
+    // site operators are deallocated with the last Hamiltonian
+    hamil->deallocate();
+    EXPECT_EQ(site_ops->n_refs, 1);
+    phamil->deallocate();
+    EXPECT_TRUE(site_ops->empty());
+    fcidump->deallocate();
+}
+
 TEST_F(TestNPDM, TestSZ) {
     shared_ptr<FCIDUMP> fcidump = make_shared<FCIDUMP>();
     string filename = "data/N2.STO3G.FCIDUMP"; // E = -107.65412235
@@ -919,6 +1077,13 @@ TEST_F(TestNPDM, TestSZ) {
         make_shared<SimplifiedMPO<SZ>>(p2mpo, make_shared<RuleQC<SZ>>(), true);
     cout << "2PDM MPO simplification end .. T = " << t.get_time() << endl;
 
+    // symmetry-unique 2PDM MPO construction
+    shared_ptr<MPO<SZ>> pu2mpo =
+        make_shared<PDM2MPOQC<SZ>>(hamil, PDM2MPOQC<SZ>::s_all, true);
+    pu2mpo = make_shared<SimplifiedMPO<SZ>>(
+        pu2mpo, make_shared<RuleQC<SZ>>(), true, true,
+        OpNamesSet({OpNames::R, OpNames::RD}));
+
     // 1NPC MPO construction
     cout << "1NPC MPO start" << endl;
     shared_ptr<MPO<SZ>> nmpo = make_shared<NPC1MPOQC<SZ>>(hamil);
@@ -964,6 +1129,7 @@ TEST_F(TestNPDM, TestSZ) {
         shared_ptr<DMRG<SZ>> dmrg = make_shared<DMRG<SZ>>(me, bdims, noises);
         dmrg->iprint = 2;
         dmrg->noise_type = NoiseTypes::Perturbative;
+        dmrg->store_orbital_rdms = dot == 2;
         dmrg->solve(10, true, 1E-12);
 
         // 1PDM ME
@@ -980,6 +1146,18 @@ TEST_F(TestNPDM, TestSZ) {
         expect->solve(true, mps->center == 0);
 
         MatrixRef dm = expect->get_1pdm_spatial();
+
+        // occupations accumulated during the last DMRG sweep
+        if (dot == 2) {
+            vector<double> occs = dmrg->get_orbital_occupations();
+            vector<double> ents = dmrg->get_orbital_entropies();
+            EXPECT_EQ((int)occs.size(), dm.m);
+            for (int i = 0; i < dm.m; i++) {
+                EXPECT_LT(abs(occs[i] - dm(i, i)), 1E-6);
+                EXPECT_GE(ents[i], 0.0);
+            }
+        }
+
         int k = 0;
         for (int i = 0; i < dm.m; i++)
             for (int j = 0; j < dm.n; j++)
@@ -1099,6 +1277,24 @@ TEST_F(TestNPDM, TestSZ) {
              << " max error = " << scientific << setprecision(3) << setw(10)
              << max_error << endl;
 
+        // 1PDM from the same 2PDM sweep
+        dm = expect->get_1pdm_from_2pdm();
+        max_error = 0.0;
+        for (auto &x : one_pdm)
+            for (int p = 0; p < 2; p++) {
+                int i = get<0>(x) * 2 + p, j = get<1>(x) * 2 + p;
+                max_error = max(max_error, abs(dm(i, j) - get<2>(x) / 2));
+                dm(i, j) = 0.0;
+            }
+        for (int i = 0; i < dm.m; i++)
+            for (int j = 0; j < dm.n; j++)
+                max_error = max(max_error, abs(dm(i, j)));
+        cout << "== SZ 1PDM FROM 2PDM / " << dot << "-site =="
+             << " max error = " << scientific << setprecision(3) << setw(10)
+             << max_error << endl;
+        EXPECT_LT(max_error, 1E-6);
+        dm.deallocate();
+
         m[0] = m[1] = m[2] = 0;
         max_error = 0.0;
         dm2 = expect->get_2pdm_spatial();
@@ -1138,6 +1334,58 @@ TEST_F(TestNPDM, TestSZ) {
              << " max error = " << scientific << setprecision(3) << setw(10)
              << max_error << endl;
 
+        // symmetry-unique 2PDM
+        shared_ptr<MovingEnvironment<SZ>> pu2me =
+            make_shared<MovingEnvironment<SZ>>(pu2mpo, mps, mps, "2PDMU");
+        pu2me->init_environments(false);
+        shared_ptr<Expect<SZ>> uexpect =
+            make_shared<Expect<SZ>>(pu2me, bond_dim, bond_dim);
+        uexpect->solve(true, mps->center == 0);
+        shared_ptr<Tensor> udm2 = PDM2MPOQC<SZ>::unpack_matrix_spatial(
+            uexpect->get_2pdm_packed(), (uint16_t)dm2->shape[0]);
+        max_error = 0.0;
+        for (size_t i = 0; i < dm2->data.size(); i++)
+            max_error = max(max_error, abs(udm2->data[i] - dm2->data[i]));
+        cout << "== SZ 2PDM UNIQUE / " << dot << "-site =="
+             << " max error = " << scientific << setprecision(3) << setw(10)
+             << max_error << endl;
+        EXPECT_LT(max_error, 1E-7);
+
+        // streamed 3PDM
+        if (dot == 2) {
+            shared_ptr<PDM3Stream<SZ>> pdm3 =
+                make_shared<PDM3Stream<SZ>>(hamil, mps, bond_dim);
+            pdm3->iprint = 0;
+            pdm3->solve();
+            shared_ptr<Tensor> dm3 = pdm3->get_matrix_spatial();
+            pdm3->deallocate();
+            const int ns = (int)dm2->shape[0];
+            const double n_elec = mps->info->target.n();
+            max_error = 0.0;
+            for (int i = 0; i < ns; i++)
+                for (int j = 0; j < ns; j++)
+                    for (int k = 0; k < ns; k++)
+                        for (int l = 0; l < ns; l++) {
+                            double v = 0.0;
+                            for (int c = 0; c < ns; c++)
+                                v += (*dm3)({i, j, c, c, k, l});
+                            max_error =
+                                max(max_error,
+                                    abs(v - (n_elec - 2) *
+                                                (*dm2)({i, j, k, l})));
+                            for (int c = 0; c < ns; c++)
+                                for (int d = 0; d < ns; d++)
+                                    max_error = max(
+                                        max_error,
+                                        abs((*dm3)({i, j, c, d, k, l}) -
+                                            (*dm3)({l, k, d, c, j, i})));
+                        }
+            cout << "== SZ 3PDM STREAM / " << dot << "-site =="
+                 << " max error = " << scientific << setprecision(3)
+                 << setw(10) << max_error << endl;
+            EXPECT_LT(max_error, 1E-6);
+        }
+
         // 1NPC ME
         shared_ptr<MovingEnvironment<SZ>> nme =
             make_shared<MovingEnvironment<SZ>>(nmpo, mps, mps, "1NPC");
@@ -1256,6 +1504,28 @@ TEST_F(TestNPDM, TestSZ) {
 
         EXPECT_EQ(kx, (int)one_npc_mixed_spatial.size());
 
+        // 1NPC for selected site pairs only
+        vector<pair<int, int>> pairs = {{0, 3}, {2, 2}, {9, 1}, {5, 9}};
+        shared_ptr<MPO<SZ>> snmpo = make_shared<NPC1MPOQC<SZ>>(hamil, pairs);
+        snmpo = make_shared<SimplifiedMPO<SZ>>(snmpo, make_shared<Rule<SZ>>(),
+                                               true);
+        EXPECT_LT(snmpo->left_operator_names[4]->data.size(),
+                  nmpo->left_operator_names[4]->data.size());
+        shared_ptr<MovingEnvironment<SZ>> snme =
+            make_shared<MovingEnvironment<SZ>>(snmpo, mps, mps, "1NPC-SEL");
+        snme->init_environments(false);
+        expect = make_shared<Expect<SZ>>(snme, bond_dim, bond_dim);
+        expect->solve(true, mps->center == 0);
+        MatrixRef dms = expect->get_1npc_spatial(1);
+        for (auto &pq : pairs) {
+            EXPECT_LT(abs(dms(pq.first, pq.second) - dmy(pq.first, pq.second)),
+                      1E-10);
+            EXPECT_LT(abs(dms(pq.second, pq.first) - dmy(pq.second, pq.first)),
+                      1E-10);
+        }
+        dms.deallocate();
+        snmpo->deallocate();
+
         dmy.deallocate();
 
         // deallocate persistent stack memory
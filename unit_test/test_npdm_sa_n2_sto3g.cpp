@@ -112,6 +112,7 @@ void TestNPDMN2STO3GSA::test_dmrg(const vector<S> &targets,
         pmpo, make_shared<NoTransposeRule<S>>(make_shared<RuleQC<S>>()), true);
     cout << "1PDM MPO simplification end .. T = " << t.get_time() << endl;
 
+    vector<vector<double>> dms;
     for (int iroot = 0; iroot < nroots; iroot++)
         for (int jroot = 0; jroot <= iroot; jroot++) {
             cout << jroot << " -> " << iroot << endl;
@@ -136,6 +137,31 @@ void TestNPDMN2STO3GSA::test_dmrg(const vector<S> &targets,
             MatrixRef dm = S(1, 1, 0).multiplicity() != 1
                                ? expect->get_1pdm_spatial()
                                : expect->get_1pdm();
+            dms.push_back(vector<double>(dm.data, dm.data + dm.size()));
+            dm.deallocate();
+        }
+
+    // all transition 1PDMs in one sweep
+    shared_ptr<MovingEnvironment<S>> pme =
+        make_shared<MovingEnvironment<S>>(pmpo, mps, mps, "1PDMTR");
+    pme->init_environments(false);
+    shared_ptr<Expect<S>> expect =
+        make_shared<Expect<S>>(pme, bond_dim, bond_dim);
+    expect->transition = true;
+    expect->solve(true, mps->center == 0);
+    for (int iroot = 0, ij = 0; iroot < nroots; iroot++)
+        for (int jroot = 0; jroot <= iroot; jroot++, ij++) {
+            MatrixRef dm =
+                S(1, 1, 0).multiplicity() != 1
+                    ? expect->get_transition_1pdm_spatial(iroot, jroot)
+                    : expect->get_transition_1pdm(iroot, jroot);
+            double max_error = 0.0;
+            for (size_t k = 0; k < dm.size(); k++)
+                max_error = max(max_error, abs(dm.data[k] - dms[ij][k]));
+            cout << "== " << name << " (SA) == TRANSITION 1PDM " << jroot
+                 << " -> " << iroot << " max error = " << scientific
+                 << setprecision(3) << setw(10) << max_error << endl;
+            EXPECT_LT(max_error, 1E-7);
             dm.deallocate();
         }
 
@@ -114,3 +114,37 @@ TEST_F(TestOperator, TestExpr) {
     EXPECT_TRUE(zero == 0.0 * (a + c + e));
     EXPECT_TRUE((a + c + e) * (-0.5) == (-0.5) * (a + c + e));
 }
+
+TEST_F(TestOperator, TestExprInterner) {
+    shared_ptr<OpExpr<SZ>> a = ops[2], b = ops[3], c = ops[4];
+    shared_ptr<OpExpr<SZ>> x = a * b + 0.5 * (c * a);
+    shared_ptr<OpExpr<SZ>> y = a * b + 0.5 * (c * a);
+    shared_ptr<OpExpr<SZ>> z = a * c;
+    string xs = to_str(x), ys = to_str(y), zs = to_str(z);
+    OpExprInterner<SZ> interner;
+    x = interner.intern(x);
+    y = interner.intern(y);
+    z = interner.intern(z);
+    EXPECT_EQ(to_str(x), xs);
+    EXPECT_EQ(to_str(y), ys);
+    EXPECT_EQ(to_str(z), zs);
+    vector<shared_ptr<OpProduct<SZ>>> &xp =
+        dynamic_pointer_cast<OpSum<SZ>>(x)->strings;
+    vector<shared_ptr<OpProduct<SZ>>> &yp =
+        dynamic_pointer_cast<OpSum<SZ>>(y)->strings;
+    shared_ptr<OpProduct<SZ>> zp = dynamic_pointer_cast<OpProduct<SZ>>(z);
+    // equal products and operators are shared
+    EXPECT_EQ(xp[0].get(), yp[0].get());
+    EXPECT_EQ(xp[1].get(), yp[1].get());
+    EXPECT_EQ(xp[0]->a.get(), xp[1]->b.get());
+    EXPECT_EQ(xp[0]->a.get(), zp->a.get());
+    EXPECT_EQ(xp[1]->a.get(), zp->b.get());
+    EXPECT_NE(xp[0].get(), zp.get());
+    EXPECT_TRUE(x == y);
+    EXPECT_FALSE(x == z);
+    // operators differing only by factor are not shared
+    shared_ptr<OpElement<SZ>> p =
+        dynamic_pointer_cast<OpElement<SZ>>(interner.intern(a * 2.0));
+    EXPECT_NE(p.get(), xp[0]->a.get());
+    EXPECT_EQ(p->factor, 2.0);
+}
@@ -11,6 +11,10 @@ class TestQ : public ::testing::Test {
     void TearDown() override {}
 };
 
+typedef SZPacked<8, 8, 0, 0, 3, uint32_t> SZPackedShort;
+typedef SZPacked<10, 10, 4, 4, 3, uint32_t> SZPackedK;
+typedef SZPacked<16, 16, 14, 14, 4> SZPackedLong;
+
 template <typename S> struct QZLabel {
     const static int nmin, nmax, tsmin, tsmax, pgmin, pgmax, kmin, kmax;
     int n, twos, pg, k, kmod;
@@ -446,6 +450,33 @@ template <> const int QZLabel<SZLZ>::pgmax = 1023;
 template <> const int QZLabel<SZLZ>::kmin = 0;
 template <> const int QZLabel<SZLZ>::kmax = 0;
 
+template <> const int QZLabel<SZPackedShort>::nmin = -128;
+template <> const int QZLabel<SZPackedShort>::nmax = 127;
+template <> const int QZLabel<SZPackedShort>::tsmin = -128;
+template <> const int QZLabel<SZPackedShort>::tsmax = 127;
+template <> const int QZLabel<SZPackedShort>::pgmin = 0;
+template <> const int QZLabel<SZPackedShort>::pgmax = 7;
+template <> const int QZLabel<SZPackedShort>::kmin = 0;
+template <> const int QZLabel<SZPackedShort>::kmax = 0;
+
+template <> const int QZLabel<SZPackedK>::nmin = -512;
+template <> const int QZLabel<SZPackedK>::nmax = 511;
+template <> const int QZLabel<SZPackedK>::tsmin = -512;
+template <> const int QZLabel<SZPackedK>::tsmax = 511;
+template <> const int QZLabel<SZPackedK>::pgmin = 0;
+template <> const int QZLabel<SZPackedK>::pgmax = 7;
+template <> const int QZLabel<SZPackedK>::kmin = 0;
+template <> const int QZLabel<SZPackedK>::kmax = 15;
+
+template <> const int QZLabel<SZPackedLong>::nmin = -32768;
+template <> const int QZLabel<SZPackedLong>::nmax = 32767;
+template <> const int QZLabel<SZPackedLong>::tsmin = -32768;
+template <> const int QZLabel<SZPackedLong>::tsmax = 32767;
+template <> const int QZLabel<SZPackedLong>::pgmin = 0;
+template <> const int QZLabel<SZPackedLong>::pgmax = 15;
+template <> const int QZLabel<SZPackedLong>::kmin = 0;
+template <> const int QZLabel<SZPackedLong>::kmax = 16383;
+
 template <> const int QULabel<SU2Short>::nmin = -128;
 template <> const int QULabel<SU2Short>::nmax = 127;
 template <> const int QULabel<SU2Short>::tsmin = 0;
@@ -516,6 +547,34 @@ TEST_F(TestQ, TestSZLZ) {
         QZLabel<SZLZ>::check();
 }
 
+TEST_F(TestQ, TestSZPackedShort) {
+    for (int i = 0; i < n_tests; i++)
+        QZLabel<SZPackedShort>::check();
+}
+
+TEST_F(TestQ, TestSZPackedK) {
+    for (int i = 0; i < n_tests; i++)
+        QZLabel<SZPackedK>::check();
+}
+
+TEST_F(TestQ, TestSZPackedLong) {
+    for (int i = 0; i < n_tests; i++)
+        QZLabel<SZPackedLong>::check();
+}
+
+TEST_F(TestQ, TestSZPackedLayout) {
+    for (int i = 0; i < 100000; i++) {
+        QZLabel<SZKLong> qq(Random::rand_int(0, 2) ? Random::rand_int(1, 64)
+                                                   : 0);
+        SZKLong q(qq.n, qq.twos, qq.kmod, qq.k, qq.pg);
+        SZPackedLong p(qq.n, qq.twos, qq.kmod, qq.k, qq.pg);
+        EXPECT_EQ(p.data, q.data);
+        SZLongLong ql(qq.n, qq.twos, qq.pg);
+        SZPacked<16, 16, 0, 0, 16> pl(qq.n, qq.twos, qq.pg);
+        EXPECT_EQ(pl.data, ql.data);
+    }
+}
+
 TEST_F(TestQ, TestSU2Short) {
     for (int i = 0; i < n_tests; i++)
         QULabel<SU2Short>::check();
@@ -540,3 +599,96 @@ TEST_F(TestQ, TestSU2LZ) {
     for (int i = 0; i < n_tests; i++)
         QULabel<SU2LZ>::check();
 }
+
+template <typename S> void check_state_info_index() {
+    for (int it = 0; it < 100; it++) {
+        StateInfo<S> info;
+        info.allocate(Random::rand_int(0, 500));
+        for (int i = 0; i < info.n; i++) {
+            int n = Random::rand_int(0, 40), twos = Random::rand_int(0, 20);
+            info.quanta[i] = S(n, (twos & (~1)) | (n & 1), i & 7);
+            info.n_states[i] = 1;
+        }
+        info.sort_states();
+        info.collect();
+        StateInfo<S> indexed = info;
+        indexed.build_index();
+        EXPECT_EQ(indexed.index != nullptr,
+                  info.n >= QuantaIndex<S>::min_size());
+        for (int i = 0; i < 1000; i++) {
+            int n = Random::rand_int(0, 40), twos = Random::rand_int(0, 20);
+            S q(n, (twos & (~1)) | (n & 1), Random::rand_int(0, 8));
+            EXPECT_EQ(indexed.find_state(q), info.find_state(q));
+        }
+        for (int i = 0; i < info.n; i++)
+            EXPECT_EQ(indexed.find_state(info.quanta[i]), i);
+    }
+}
+
+TEST_F(TestQ, TestStateInfoIndex) {
+    check_state_info_index<SZ>();
+    check_state_info_index<SU2>();
+}
+
+template <typename S> StateInfo<S> rand_state_info(int nmax) {
+    StateInfo<S> info;
+    info.allocate(Random::rand_int(1, nmax));
+    for (int i = 0; i < info.n; i++) {
+        int n = Random::rand_int(0, 12), twos = Random::rand_int(0, 8);
+        info.quanta[i] = S(n, (twos & (~1)) | (n & 1), Random::rand_int(0, 4));
+        info.n_states[i] = Random::rand_int(0, 4);
+    }
+    info.sort_states();
+    return info;
+}
+
+template <typename S> void check_state_info_tensor_product() {
+    for (int it = 0; it < 200; it++) {
+        StateInfo<S> a = rand_state_info<S>(30), b = rand_state_info<S>(10);
+        int n = Random::rand_int(0, 24), twos = Random::rand_int(0, 8);
+        S target(n, (twos & (~1)) | (n & 1), 0);
+        StateInfo<S> c = StateInfo<S>::tensor_product(a, b, target);
+        // reference: full outer product, then sort and collect
+        StateInfo<S> x;
+        int nx = 0;
+        for (int i = 0; i < a.n; i++)
+            for (int j = 0; j < b.n; j++)
+                nx += (a.quanta[i] + b.quanta[j]).count();
+        x.allocate(nx);
+        for (int i = 0, ix = 0; i < a.n; i++)
+            for (int j = 0; j < b.n; j++) {
+                S qc = a.quanta[i] + b.quanta[j];
+                for (int k = 0; k < qc.count(); k++, ix++)
+                    x.quanta[ix] = qc[k],
+                    x.n_states[ix] = a.n_states[i] * b.n_states[j];
+            }
+        x.sort_states();
+        x.collect(target);
+        ASSERT_EQ(c.n, x.n);
+        EXPECT_EQ(c.n_states_total, x.n_states_total);
+        for (int i = 0; i < c.n; i++) {
+            EXPECT_EQ(c.quanta[i], x.quanta[i]);
+            EXPECT_EQ(c.n_states[i], x.n_states[i]);
+        }
+        StateInfo<S> ci = StateInfo<S>::get_connection_info(a, b, c);
+        for (int ic = 0; ic < c.n; ic++) {
+            int iab = ci.n_states[ic];
+            int jab = ic == c.n - 1 ? ci.n : ci.n_states[ic + 1];
+            for (int k = iab; k < jab; k++) {
+                int i = ci.quanta[k].data >> 16, j = ci.quanta[k].data & 0xFFFF;
+                S qc = a.quanta[i] + b.quanta[j];
+                bool found = false;
+                for (int kk = 0; kk < qc.count(); kk++)
+                    found = found || qc[kk] == c.quanta[ic];
+                EXPECT_TRUE(found);
+                if (k != iab)
+                    EXPECT_LT(ci.quanta[k - 1].data, ci.quanta[k].data);
+            }
+        }
+    }
+}
+
+TEST_F(TestQ, TestStateInfoTensorProduct) {
+    check_state_info_tensor_product<SZ>();
+    check_state_info_tensor_product<SU2>();
+}
@@ -0,0 +1,145 @@
+
+#include "block2_core.hpp"
+#include <gtest/gtest.h>
+
+using namespace block2;
+
+class TestTimingTree : public ::testing::Test {
+  protected:
+    void SetUp() override {}
+    void TearDown() override {}
+};
+
+TEST_F(TestTimingTree, TestTree) {
+    TimingTree tt;
+    tt.begin("sweep");
+    for (int i = 0; i < 3; i++) {
+        tt.begin("site " + Parsing::to_string(i % 2));
+        vector<pair<string, double>> before = {{"update", 1.0},
+                                               {"update/davidson", 0.5},
+                                               {"io/read", 0.0}};
+        vector<pair<string, double>> after = {{"update", 2.0},
+                                              {"update/davidson", 1.25},
+                                              {"io/read", 0.0}};
+        tt.add(before, after);
+        tt.end();
+    }
+    tt.end();
+    // root, sweep, site 0, site 1, update, davidson (twice each)
+    EXPECT_EQ(tt.nodes.size(), 8);
+    EXPECT_EQ(tt.nodes[0].children.size(), 1);
+    const TimingTree::Node &sweep = tt.nodes[tt.nodes[0].children[0]];
+    EXPECT_EQ(sweep.name, "sweep");
+    EXPECT_EQ(sweep.count, 1);
+    EXPECT_EQ(sweep.children.size(), 2);
+    const TimingTree::Node &site0 = tt.nodes[sweep.children[0]];
+    EXPECT_EQ(site0.name, "site 0");
+    EXPECT_EQ(site0.count, 2);
+    EXPECT_EQ(site0.children.size(), 1);
+    const TimingTree::Node &upd = tt.nodes[site0.children[0]];
+    EXPECT_EQ(upd.name, "update");
+    EXPECT_DOUBLE_EQ(upd.time, 2.0);
+    EXPECT_DOUBLE_EQ(tt.nodes[upd.children[0]].time, 1.5);
+    string csv = tt.to_csv();
+    EXPECT_NE(csv.find("sweep/site 1/update/davidson,1,0.750000"),
+              string::npos);
+    string json = tt.to_json();
+    EXPECT_EQ(count(json.begin(), json.end(), '{'), 8);
+    EXPECT_EQ(count(json.begin(), json.end(), '}'), 8);
+}
+
+TEST_F(TestTimingTree, TestKernelCounters) {
+    frame_() = make_shared<DataFrame>(1L << 20, 1L << 24, "nodex");
+    KernelCounters &kc = kernel_counters_();
+    kc.reset(), kc.enabled = true;
+    const MKL_INT m = 10, k = 20, n = 30;
+    MatrixRef a(dalloc_()->allocate(m * k), m, k);
+    MatrixRef b(dalloc_()->allocate(k * n), k, n);
+    MatrixRef c(dalloc_()->allocate(m * n), m, n);
+    Random::fill_rand_double(a.data, a.size());
+    Random::fill_rand_double(b.data, b.size());
+    TimingTree tt;
+    tt.begin("gemm");
+    MatrixFunctions::multiply(a, false, b, false, c, 1.0, 0.0);
+    tt.end();
+    MatrixRef x(dalloc_()->allocate(n * n), n, n);
+    DiagonalMatrix w(dalloc_()->allocate(n), n);
+    MatrixFunctions::multiply(c, true, c, false, x, 1.0, 0.0);
+    MatrixFunctions::eigs(x, w);
+    kc.enabled = false;
+    MatrixFunctions::multiply(a, false, b, false, c, 1.0, 0.0);
+    EXPECT_EQ(kc.calls[(int)KernelTypes::GEMM], 2);
+    EXPECT_EQ(kc.flop[(int)KernelTypes::GEMM], 2 * m * n * k + 2 * n * n * m);
+    EXPECT_EQ(kc.bytes[(int)KernelTypes::GEMM],
+              8 * (m * k + k * n + 2 * m * n) + 8 * (2 * m * n + 2 * n * n));
+    EXPECT_EQ(kc.calls[(int)KernelTypes::Eigs], 1);
+    EXPECT_EQ(kc.flop[(int)KernelTypes::Eigs], 9 * n * n * n);
+    EXPECT_EQ(tt.nodes[1].flop, 2 * m * n * k);
+    EXPECT_NE(kc.summary().find("eigs"), string::npos);
+    EXPECT_EQ(kc.summary().find("svd"), string::npos);
+    kc.reset();
+    EXPECT_EQ(kc.total_flop(), 0);
+    w.deallocate();
+    x.deallocate();
+    c.deallocate();
+    b.deallocate();
+    a.deallocate();
+    frame_() = nullptr;
+}
+
+TEST_F(TestTimingTree, TestHardwareCounters) {
+    HardwareCounters &hc = hardware_counters_();
+    hc.reset();
+    // not compiled in, or not permitted by perf_event_paranoid
+    if (!hc.start()) {
+        EXPECT_FALSE(hc.enabled);
+        {
+            HardwareCounterScope hcs("loop");
+        }
+        EXPECT_EQ(hc.phases.size(), 0);
+        EXPECT_EQ(hc.summary(), "");
+        return;
+    }
+    volatile double x = 0;
+    for (int it = 0; it < 2; it++) {
+        HardwareCounterScope hcs("loop");
+        for (int i = 0; i < 1000000; i++)
+            x = x + 1E-3 * i;
+    }
+    hc.stop();
+    ASSERT_EQ(hc.phases.size(), 1);
+    const HardwareCounters::Phase &ph = hc.phases[0];
+    EXPECT_EQ(ph.count, 2);
+    EXPECT_GT(ph.time, 0);
+    EXPECT_GT(ph.values[(int)HardwareEvents::Cycles], 0);
+    // at least one instruction per iteration
+    EXPECT_GT(ph.values[(int)HardwareEvents::Instructions], 2E6);
+    EXPECT_NE(hc.summary().find("loop"), string::npos);
+    hc.reset();
+}
+
+TEST_F(TestTimingTree, TestLoadBalance) {
+    LoadBalanceRecorder lb(vector<string>{"eigs", "compute"});
+    lb.add(3, vector<double>{1.0, 2.0});
+    lb.add(4, vector<double>{2.0, 4.0});
+    lb.gather(shared_ptr<ParallelCommunicator<SZ>>(nullptr));
+    EXPECT_EQ(lb.all_times, lb.times);
+    EXPECT_DOUBLE_EQ(lb.imbalance(1), 1.0);
+    // as gathered from two ranks, rank 1 being slow at site 4
+    lb.n_ranks = 2;
+    lb.all_times = vector<double>{1.0, 2.0, 2.0, 4.0, 1.0, 2.0, 2.0, 8.0};
+    EXPECT_DOUBLE_EQ(lb.time(1, 1, 1), 8.0);
+    EXPECT_DOUBLE_EQ(lb.imbalance(0), 1.0);
+    EXPECT_DOUBLE_EQ(lb.imbalance(1), 10.0 * 2 / 16.0);
+    double mean;
+    vector<int> slowest;
+    EXPECT_DOUBLE_EQ(lb.critical_path(1, mean, slowest), 10.0);
+    EXPECT_DOUBLE_EQ(mean, 8.0);
+    EXPECT_EQ(slowest, (vector<int>{0, 1}));
+    const string r = lb.report(1);
+    EXPECT_NE(r.find("compute = 1.250"), string::npos);
+    EXPECT_NE(r.find("efficiency = 0.800"), string::npos);
+    EXPECT_NE(r.find("Worst sites: 4 (1.333, rank 1)"), string::npos);
+    lb.clear();
+    EXPECT_EQ(lb.report(), "");
+}
@@ -0,0 +1,86 @@
+
+#include "ic/wick_kernel.hpp"
+#include <gtest/gtest.h>
+
+using namespace block2;
+
+class TestWickKernel : public ::testing::Test {
+  protected:
+    map<WickIndexTypes, MKL_INT> type_extents;
+    void SetUp() override {
+        Random::rand_seed(0);
+        type_extents[WickIndexTypes::Inactive] = 3;
+        type_extents[WickIndexTypes::External] = 5;
+    }
+    void TearDown() override {}
+    map<string, NDArray> random_inputs(const WickKernel &wk,
+                                       const WickExpr &expr) const {
+        map<string, NDArray> r;
+        for (auto &term : expr.terms)
+            for (auto &wt : term.tensors) {
+                string name = WickKernel::input_name(wt);
+                if (r.count(name))
+                    continue;
+                vector<MKL_INT> shape;
+                for (auto &wi : wt.indices)
+                    shape.push_back(
+                        WickKernel::type_extent(wi.types, type_extents));
+                r[name] = NDArray::random(shape);
+            }
+        EXPECT_EQ(r.size(), wk.inputs.size());
+        return r;
+    }
+    // evaluate term by term using multi-operand einsum
+    NDArray reference(const WickExpr &expr, const WickTensor &x,
+                      const map<string, NDArray> &inputs) const {
+        vector<MKL_INT> shape;
+        for (auto &wi : x.indices)
+            shape.push_back(WickKernel::type_extent(wi.types, type_extents));
+        NDArray r(shape);
+        memset(r.data, 0, sizeof(double) * r.size());
+        for (auto &term : expr.terms) {
+            map<WickIndex, char> mp;
+            stringstream ss;
+            vector<NDArray> arrs;
+            for (int i = 0; i < (int)term.tensors.size(); i++) {
+                for (auto &wi : term.tensors[i].indices) {
+                    if (!mp.count(wi))
+                        mp[wi] = (char)('a' + mp.size());
+                    ss << mp[wi];
+                }
+                ss << (i == (int)term.tensors.size() - 1 ? "->" : ",");
+                arrs.push_back(
+                    inputs.at(WickKernel::input_name(term.tensors[i])));
+            }
+            for (auto &wi : x.indices)
+                ss << mp.at(wi);
+            NDArray::transpose(
+                NDArray::einsum(ss.str(), arrs, EinsumPathTypes::Linear), r,
+                {}, term.factor, 1.0);
+        }
+        return r;
+    }
+};
+
+TEST_F(TestWickKernel, TestCCSD) {
+    WickCCSD wccsd;
+    WickExpr t1_eq = wccsd.t1_equations(), t2_eq = wccsd.t2_equations();
+    WickTensor x1 =
+        WickTensor::parse("r[ia]", wccsd.idx_map, wccsd.perm_map);
+    WickTensor x2 =
+        WickTensor::parse("r[ijab]", wccsd.idx_map, wccsd.perm_map);
+    for (auto &p : vector<pair<WickExpr, WickTensor>>{
+             make_pair(t1_eq, x1), make_pair(t2_eq, x2)}) {
+        WickKernel wk = WickKernel::compile(p.first, p.second, type_extents);
+        map<string, NDArray> inputs = random_inputs(wk, p.first);
+        NDArray r = wk.evaluate(inputs);
+        NDArray r_ref = reference(p.first, p.second, inputs);
+        EXPECT_EQ(r.shape, r_ref.shape);
+        EXPECT_LT((r - r_ref).norm(), 1E-10);
+        // intermediates are shared between terms
+        size_t n_pair_steps = 0;
+        for (auto &st : wk.steps)
+            n_pair_steps += st.b != WickKernelStep::none;
+        EXPECT_LT(n_pair_steps, WickKernel::n_unshared_steps(p.first));
+    }
+}